@@ -0,0 +1,796 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "hal/hal_cputime.h"
+#include "console/console.h"
+#include "shell/shell.h"
+#include "stats/stats.h"
+#include "log/log.h"
+
+/* BLE */
+#include "nimble/ble.h"
+#include "nimble/hci_common.h"
+#include "host/ble_hs.h"
+#include "host/ble_hs_adv.h"
+#include "host/ble_att.h"
+#include "host/ble_gap.h"
+#include "host/ble_gatt.h"
+#include "controller/ble_ll.h"
+#include "transport/ram/ble_hci_ram.h"
+#include "store/ram/ble_store_ram.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+
+#include "newtmgr/newtmgr.h"
+
+#include "blebench.h"
+
+/*
+ * Central side of the BLE benchmark; drives the measurements against one
+ * or more blebench_prph peripherals. From the shell:
+ *
+ *     bench conn <n>       connect to n peripherals, timing connection setup
+ *     bench lat <count>    time <count> back-to-back reads of echo
+ *     bench write <secs>   write-without-response to sink on all connections
+ *     bench notify <secs>  subscribe to source on all connections
+ *     bench disc           disconnect everything
+ *
+ * Results are printed on the console, and kept in the "blebench" stats
+ * group for reading with "stat blebench" or newtmgr.
+ */
+
+/** Mbuf settings. */
+#define MBUF_NUM_MBUFS      (24)
+#define MBUF_BUF_SIZE       OS_ALIGN(BLE_MBUF_PAYLOAD_SIZE, 4)
+#define MBUF_MEMBLOCK_SIZE  (MBUF_BUF_SIZE + BLE_MBUF_MEMBLOCK_OVERHEAD)
+#define MBUF_MEMPOOL_SIZE   OS_MEMPOOL_SIZE(MBUF_NUM_MBUFS, MBUF_MEMBLOCK_SIZE)
+
+static os_membuf_t blebench_mbuf_mpool_data[MBUF_MEMPOOL_SIZE];
+static struct os_mbuf_pool blebench_mbuf_pool;
+static struct os_mempool blebench_mbuf_mpool;
+
+/** Log data. */
+static struct log_handler blebench_log_console_handler;
+static struct log blebench_log;
+#define BLEBENCH_LOG(lvl, ...) \
+    LOG_ ## lvl(&blebench_log, LOG_MODULE_PERUSER, __VA_ARGS__)
+
+/** Priority of the nimble host and controller tasks. */
+#define BLE_LL_TASK_PRI             (OS_TASK_PRI_HIGHEST)
+
+#define BLEBENCH_TASK_PRIO          1
+#define BLEBENCH_STACK_SIZE         (OS_STACK_ALIGN(336))
+static struct os_eventq blebench_evq;
+static struct os_task blebench_task;
+static bssnz_t os_stack_t blebench_stack[BLEBENCH_STACK_SIZE];
+
+#define SHELL_TASK_PRIO             (3)
+#define SHELL_MAX_INPUT_LEN         (128)
+#define SHELL_TASK_STACK_SIZE       (OS_STACK_ALIGN(384))
+static bssnz_t os_stack_t shell_stack[SHELL_TASK_STACK_SIZE];
+
+#define NEWTMGR_TASK_PRIO           (4)
+#define NEWTMGR_TASK_STACK_SIZE     (OS_STACK_ALIGN(512))
+static bssnz_t os_stack_t newtmgr_stack[NEWTMGR_TASK_STACK_SIZE];
+
+/** Our global device address (public) */
+uint8_t g_dev_addr[BLE_DEV_ADDR_LEN] = {0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c};
+
+/** Our random address (in case we need it) */
+uint8_t g_random_addr[BLE_DEV_ADDR_LEN];
+
+/*
+ * Times are in microseconds, throughputs in bytes per second. Histograms
+ * have power of two buckets.
+ */
+STATS_SECT_START(blebench_stats)
+    STATS_SECT_ENTRY(conns)
+    STATS_SECT_ENTRY(conn_fails)
+    STATS_SECT_ENTRY(conn_setup_us)
+    STATS_SECT_HIST(conn_setup_hist)
+    STATS_SECT_ENTRY(lat_min_us)
+    STATS_SECT_ENTRY(lat_avg_us)
+    STATS_SECT_ENTRY(lat_max_us)
+    STATS_SECT_HIST(lat_hist)
+    STATS_SECT_ENTRY(write_bps)
+    STATS_SECT_ENTRY(write_bytes)
+    STATS_SECT_ENTRY(notify_bps)
+    STATS_SECT_ENTRY(notify_bytes)
+STATS_SECT_END
+
+static STATS_SECT_DECL(blebench_stats) blebench_stats;
+
+STATS_NAME_START(blebench_stats)
+    STATS_NAME(blebench_stats, conns)
+    STATS_NAME(blebench_stats, conn_fails)
+    STATS_NAME(blebench_stats, conn_setup_us)
+    STATS_NAME_HIST(blebench_stats, conn_setup_hist)
+    STATS_NAME(blebench_stats, lat_min_us)
+    STATS_NAME(blebench_stats, lat_avg_us)
+    STATS_NAME(blebench_stats, lat_max_us)
+    STATS_NAME_HIST(blebench_stats, lat_hist)
+    STATS_NAME(blebench_stats, write_bps)
+    STATS_NAME(blebench_stats, write_bytes)
+    STATS_NAME(blebench_stats, notify_bps)
+    STATS_NAME(blebench_stats, notify_bytes)
+STATS_NAME_END(blebench_stats)
+
+struct blebench_conn {
+    uint16_t handle;
+    uint16_t svc_start;
+    uint16_t svc_end;
+    uint16_t sink;
+    uint16_t source;
+    uint16_t echo;
+    uint16_t mtu;
+    uint8_t ready;
+    uint32_t setup_us;
+    uint32_t bytes;
+};
+
+static struct blebench_conn blebench_conns[BLEBENCH_MAX_CONNS];
+static int blebench_conn_cnt;
+static int blebench_conn_want;
+static uint32_t blebench_conn_start;
+
+#define BLEBENCH_IDLE           0
+#define BLEBENCH_LAT            1
+#define BLEBENCH_WRITE          2
+#define BLEBENCH_NOTIFY         3
+
+static struct {
+    uint8_t mode;
+    os_time_t end;
+    uint32_t secs;
+    uint32_t lat_left;
+    uint32_t lat_cnt;
+    uint32_t lat_start;
+    uint32_t lat_sum;
+    uint32_t lat_min;
+    uint32_t lat_max;
+} blebench_run;
+
+static struct os_callout_func blebench_timer;
+
+static uint8_t blebench_data[BLE_ATT_MTU_MAX];
+
+static int blebench_gap_event(struct ble_gap_event *event, void *arg);
+static int blebench_shell_cmd(int argc, char **argv);
+
+static struct shell_cmd blebench_cmd = {
+    .sc_cmd = "bench",
+    .sc_cmd_func = blebench_shell_cmd,
+};
+
+static struct blebench_conn *
+blebench_conn_find(uint16_t handle)
+{
+    int i;
+
+    for (i = 0; i < blebench_conn_cnt; i++) {
+        if (blebench_conns[i].handle == handle) {
+            return &blebench_conns[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+blebench_scan(void)
+{
+    struct ble_gap_disc_params disc_params;
+    int rc;
+
+    if (blebench_conn_cnt >= blebench_conn_want || ble_gap_disc_active()) {
+        return;
+    }
+    memset(&disc_params, 0, sizeof disc_params);
+    disc_params.filter_duplicates = 1;
+    disc_params.passive = 1;
+
+    rc = ble_gap_disc(BLE_ADDR_TYPE_PUBLIC, BLE_HS_FOREVER, &disc_params,
+                      blebench_gap_event, NULL);
+    if (rc != 0) {
+        BLEBENCH_LOG(ERROR, "error starting scan; rc=%d\n", rc);
+    }
+}
+
+/**
+ * Connect to peripherals advertising the benchmark service.
+ */
+static int
+blebench_should_connect(const struct ble_gap_disc_desc *disc)
+{
+    const uint8_t *uuid;
+    int i;
+
+    if (disc->event_type != BLE_HCI_ADV_RPT_EVTYPE_ADV_IND &&
+        disc->event_type != BLE_HCI_ADV_RPT_EVTYPE_DIR_IND) {
+        return 0;
+    }
+    for (i = 0; i < disc->fields->num_uuids128; i++) {
+        uuid = (uint8_t *)disc->fields->uuids128 + i * 16;
+        if (!memcmp(uuid, BLEBENCH_SVC_UUID, 16)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void
+blebench_connect(const struct ble_gap_disc_desc *disc)
+{
+    int rc;
+
+    if (!blebench_should_connect(disc)) {
+        return;
+    }
+    rc = ble_gap_disc_cancel();
+    if (rc != 0) {
+        return;
+    }
+
+    blebench_conn_start = cputime_get32();
+    rc = ble_gap_connect(BLE_ADDR_TYPE_PUBLIC, disc->addr_type, disc->addr,
+                         30000, NULL, blebench_gap_event, NULL);
+    if (rc != 0) {
+        STATS_INC(blebench_stats, conn_fails);
+        blebench_scan();
+    }
+}
+
+static int
+blebench_on_chr(uint16_t conn_handle, const struct ble_gatt_error *error,
+                const struct ble_gatt_chr *chr, void *arg)
+{
+    struct blebench_conn *bc;
+
+    bc = blebench_conn_find(conn_handle);
+    if (!bc) {
+        return 0;
+    }
+    if (error->status == 0) {
+        if (!memcmp(chr->uuid128, BLEBENCH_CHR_SINK_UUID, 16)) {
+            bc->sink = chr->val_handle;
+        } else if (!memcmp(chr->uuid128, BLEBENCH_CHR_SOURCE_UUID, 16)) {
+            bc->source = chr->val_handle;
+        } else if (!memcmp(chr->uuid128, BLEBENCH_CHR_ECHO_UUID, 16)) {
+            bc->echo = chr->val_handle;
+        }
+        return 0;
+    }
+    if (error->status == BLE_HS_EDONE && bc->sink && bc->source && bc->echo) {
+        bc->ready = 1;
+        console_printf("conn %d ready; setup=%lu us mtu=%d\n", bc->handle,
+                       (unsigned long)bc->setup_us, bc->mtu);
+    } else {
+        console_printf("conn %d discovery failed; status=%d\n", bc->handle,
+                       error->status);
+        ble_gap_terminate(conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+    }
+    return 0;
+}
+
+static int
+blebench_on_svc(uint16_t conn_handle, const struct ble_gatt_error *error,
+                const struct ble_gatt_svc *service, void *arg)
+{
+    struct blebench_conn *bc;
+    int rc;
+
+    bc = blebench_conn_find(conn_handle);
+    if (!bc) {
+        return 0;
+    }
+    if (error->status == 0) {
+        bc->svc_start = service->start_handle;
+        bc->svc_end = service->end_handle;
+        return 0;
+    }
+    rc = BLE_HS_ENOENT;
+    if (error->status == BLE_HS_EDONE && bc->svc_start) {
+        rc = ble_gattc_disc_all_chrs(conn_handle, bc->svc_start, bc->svc_end,
+                                     blebench_on_chr, NULL);
+    }
+    if (rc) {
+        console_printf("conn %d discovery failed; rc=%d\n", bc->handle, rc);
+        ble_gap_terminate(conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+    }
+    return 0;
+}
+
+static int
+blebench_on_mtu(uint16_t conn_handle, const struct ble_gatt_error *error,
+                uint16_t mtu, void *arg)
+{
+    struct blebench_conn *bc;
+
+    bc = blebench_conn_find(conn_handle);
+    if (!bc) {
+        return 0;
+    }
+    if (error->status == 0) {
+        bc->mtu = mtu;
+    }
+    ble_gattc_disc_svc_by_uuid(conn_handle, BLEBENCH_SVC_UUID,
+                               blebench_on_svc, NULL);
+    return 0;
+}
+
+static struct blebench_conn *
+blebench_conn_first_ready(void)
+{
+    int i;
+
+    for (i = 0; i < blebench_conn_cnt; i++) {
+        if (blebench_conns[i].ready) {
+            return &blebench_conns[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+blebench_lat_done(void)
+{
+    uint32_t avg;
+
+    blebench_run.mode = BLEBENCH_IDLE;
+    if (!blebench_run.lat_cnt) {
+        console_printf("lat: no responses\n");
+        return;
+    }
+    avg = blebench_run.lat_sum / blebench_run.lat_cnt;
+    blebench_stats.STATS_SECT_VAR(lat_min_us) = blebench_run.lat_min;
+    blebench_stats.STATS_SECT_VAR(lat_avg_us) = avg;
+    blebench_stats.STATS_SECT_VAR(lat_max_us) = blebench_run.lat_max;
+    console_printf("lat: %lu reads; min=%lu avg=%lu max=%lu us\n",
+                   (unsigned long)blebench_run.lat_cnt,
+                   (unsigned long)blebench_run.lat_min, (unsigned long)avg,
+                   (unsigned long)blebench_run.lat_max);
+}
+
+static int blebench_on_read(uint16_t conn_handle,
+                            const struct ble_gatt_error *error,
+                            struct ble_gatt_attr *attr, void *arg);
+
+/*
+ * Issue the next read of echo; the next one goes out from the completion
+ * callback of the previous, so each sample is one ATT round trip.
+ */
+static void
+blebench_lat_next(void)
+{
+    struct blebench_conn *bc;
+
+    bc = blebench_conn_first_ready();
+    if (!bc || !blebench_run.lat_left) {
+        blebench_lat_done();
+        return;
+    }
+    blebench_run.lat_left--;
+    blebench_run.lat_start = cputime_get32();
+    if (ble_gattc_read(bc->handle, bc->echo, blebench_on_read, NULL)) {
+        blebench_lat_done();
+    }
+}
+
+static int
+blebench_on_read(uint16_t conn_handle, const struct ble_gatt_error *error,
+                 struct ble_gatt_attr *attr, void *arg)
+{
+    uint32_t us;
+
+    us = cputime_get32() - blebench_run.lat_start;
+    if (blebench_run.mode != BLEBENCH_LAT) {
+        return 0;
+    }
+    if (error->status == 0) {
+        blebench_run.lat_cnt++;
+        blebench_run.lat_sum += us;
+        if (us < blebench_run.lat_min) {
+            blebench_run.lat_min = us;
+        }
+        if (us > blebench_run.lat_max) {
+            blebench_run.lat_max = us;
+        }
+        STATS_HIST_ADD(blebench_stats, lat_hist, us);
+    }
+    blebench_lat_next();
+    return 0;
+}
+
+/*
+ * Queue MTU sized writes to every connection until the host runs out of
+ * buffers.
+ */
+static void
+blebench_write_pump(void)
+{
+    struct blebench_conn *bc;
+    uint16_t len;
+    int i;
+
+    for (i = 0; i < blebench_conn_cnt; i++) {
+        bc = &blebench_conns[i];
+        if (!bc->ready) {
+            continue;
+        }
+        len = ble_att_mtu(bc->handle) - 3;
+        while (!ble_gattc_write_no_rsp_flat(bc->handle, bc->sink,
+                                            blebench_data, len)) {
+            bc->bytes += len;
+        }
+    }
+}
+
+static void
+blebench_subscribe(int on)
+{
+    struct blebench_conn *bc;
+    uint8_t val[2];
+    int i;
+
+    /* The CCCD directly follows the value of source on the peripheral. */
+    val[0] = on;
+    val[1] = 0;
+    for (i = 0; i < blebench_conn_cnt; i++) {
+        bc = &blebench_conns[i];
+        if (bc->ready) {
+            ble_gattc_write_flat(bc->handle, bc->source + 1, val, sizeof(val),
+                                 NULL, NULL);
+        }
+    }
+}
+
+static void
+blebench_tput_done(void)
+{
+    struct blebench_conn *bc;
+    uint32_t total;
+    uint32_t bps;
+    int i;
+
+    if (blebench_run.mode == BLEBENCH_NOTIFY) {
+        blebench_subscribe(0);
+    }
+    total = 0;
+    for (i = 0; i < blebench_conn_cnt; i++) {
+        bc = &blebench_conns[i];
+        if (!bc->ready) {
+            continue;
+        }
+        console_printf("  conn %d: %lu bytes/s\n", bc->handle,
+                       (unsigned long)(bc->bytes / blebench_run.secs));
+        total += bc->bytes;
+    }
+    bps = total / blebench_run.secs;
+    if (blebench_run.mode == BLEBENCH_WRITE) {
+        blebench_stats.STATS_SECT_VAR(write_bps) = bps;
+        STATS_INCN(blebench_stats, write_bytes, total);
+        console_printf("write: ");
+    } else {
+        blebench_stats.STATS_SECT_VAR(notify_bps) = bps;
+        STATS_INCN(blebench_stats, notify_bytes, total);
+        console_printf("notify: ");
+    }
+    console_printf("%lu bytes in %lu s; %lu bytes/s\n", (unsigned long)total,
+                   (unsigned long)blebench_run.secs, (unsigned long)bps);
+    blebench_run.mode = BLEBENCH_IDLE;
+}
+
+static void
+blebench_tick(void *arg)
+{
+    switch (blebench_run.mode) {
+    case BLEBENCH_LAT:
+        blebench_lat_next();
+        return;
+    case BLEBENCH_WRITE:
+    case BLEBENCH_NOTIFY:
+        if (OS_TIME_TICK_GEQ(os_time_get(), blebench_run.end)) {
+            blebench_tput_done();
+            return;
+        }
+        if (blebench_run.mode == BLEBENCH_WRITE) {
+            blebench_write_pump();
+        }
+        os_callout_reset(&blebench_timer.cf_c, 1);
+        return;
+    default:
+        return;
+    }
+}
+
+/*
+ * Starts a run; the run itself is driven from the blebench task.
+ */
+static int
+blebench_start(int mode, uint32_t arg)
+{
+    int i;
+
+    if (blebench_run.mode != BLEBENCH_IDLE) {
+        console_printf("busy\n");
+        return -1;
+    }
+    if (!blebench_conn_first_ready()) {
+        console_printf("no connections\n");
+        return -1;
+    }
+    if (arg == 0) {
+        arg = 1;
+    }
+    memset(&blebench_run, 0, sizeof(blebench_run));
+    for (i = 0; i < blebench_conn_cnt; i++) {
+        blebench_conns[i].bytes = 0;
+    }
+    if (mode == BLEBENCH_LAT) {
+        blebench_run.lat_left = arg;
+        blebench_run.lat_min = UINT32_MAX;
+    } else {
+        blebench_run.secs = arg;
+        blebench_run.end = os_time_get() + arg * OS_TICKS_PER_SEC;
+        if (mode == BLEBENCH_NOTIFY) {
+            blebench_subscribe(1);
+        }
+    }
+    blebench_run.mode = mode;
+    os_callout_reset(&blebench_timer.cf_c, 0);
+    return 0;
+}
+
+static int
+blebench_shell_cmd(int argc, char **argv)
+{
+    uint32_t arg;
+    int i;
+
+    if (argc < 2) {
+        goto usage;
+    }
+    arg = (argc > 2) ? strtoul(argv[2], NULL, 0) : 0;
+
+    if (!strcmp(argv[1], "conn")) {
+        if (arg == 0 || arg > BLEBENCH_MAX_CONNS) {
+            arg = BLEBENCH_MAX_CONNS;
+        }
+        blebench_conn_want = arg;
+        blebench_scan();
+        return 0;
+    } else if (!strcmp(argv[1], "lat")) {
+        return blebench_start(BLEBENCH_LAT, arg);
+    } else if (!strcmp(argv[1], "write")) {
+        return blebench_start(BLEBENCH_WRITE, arg);
+    } else if (!strcmp(argv[1], "notify")) {
+        return blebench_start(BLEBENCH_NOTIFY, arg);
+    } else if (!strcmp(argv[1], "disc")) {
+        blebench_conn_want = 0;
+        for (i = 0; i < blebench_conn_cnt; i++) {
+            ble_gap_terminate(blebench_conns[i].handle,
+                              BLE_ERR_REM_USER_CONN_TERM);
+        }
+        return 0;
+    }
+usage:
+    console_printf("bench conn|lat|write|notify|disc [n]\n");
+    return -1;
+}
+
+static int
+blebench_gap_event(struct ble_gap_event *event, void *arg)
+{
+    struct blebench_conn *bc;
+    uint32_t us;
+    int rc;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_DISC:
+        blebench_connect(&event->disc);
+        return 0;
+
+    case BLE_GAP_EVENT_CONNECT:
+        if (event->connect.status != 0) {
+            STATS_INC(blebench_stats, conn_fails);
+            blebench_scan();
+            return 0;
+        }
+        us = cputime_get32() - blebench_conn_start;
+        STATS_INC(blebench_stats, conns);
+        blebench_stats.STATS_SECT_VAR(conn_setup_us) = us;
+        STATS_HIST_ADD(blebench_stats, conn_setup_hist, us);
+
+        assert(blebench_conn_cnt < BLEBENCH_MAX_CONNS);
+        bc = &blebench_conns[blebench_conn_cnt++];
+        memset(bc, 0, sizeof(*bc));
+        bc->handle = event->connect.conn_handle;
+        bc->setup_us = us;
+        bc->mtu = BLE_ATT_MTU_DFLT;
+
+        rc = ble_gattc_exchange_mtu(bc->handle, blebench_on_mtu, NULL);
+        if (rc) {
+            ble_gattc_disc_svc_by_uuid(bc->handle, BLEBENCH_SVC_UUID,
+                                       blebench_on_svc, NULL);
+        }
+        blebench_scan();
+        return 0;
+
+    case BLE_GAP_EVENT_DISCONNECT:
+        bc = blebench_conn_find(event->disconnect.conn.conn_handle);
+        if (bc) {
+            *bc = blebench_conns[--blebench_conn_cnt];
+        }
+        console_printf("conn %d down; reason=%d\n",
+                       event->disconnect.conn.conn_handle,
+                       event->disconnect.reason);
+        blebench_scan();
+        return 0;
+
+    case BLE_GAP_EVENT_NOTIFY_RX:
+        if (blebench_run.mode == BLEBENCH_NOTIFY) {
+            bc = blebench_conn_find(event->notify_rx.conn_handle);
+            if (bc) {
+                bc->bytes += OS_MBUF_PKTLEN(event->notify_rx.om);
+            }
+        }
+        return 0;
+
+    default:
+        return 0;
+    }
+}
+
+static void
+blebench_on_reset(int reason)
+{
+    BLEBENCH_LOG(ERROR, "Resetting state; reason=%d\n", reason);
+}
+
+static void
+blebench_task_handler(void *unused)
+{
+    struct os_event *ev;
+    struct os_callout_func *cf;
+    int rc;
+
+    rc = ble_hs_start();
+    assert(rc == 0);
+
+    while (1) {
+        ev = os_eventq_get(&blebench_evq);
+        switch (ev->ev_type) {
+        case OS_EVENT_T_TIMER:
+            cf = (struct os_callout_func *)ev;
+            assert(cf->cf_func);
+            cf->cf_func(CF_ARG(cf));
+            break;
+        default:
+            assert(0);
+            break;
+        }
+    }
+}
+
+/**
+ * main
+ *
+ * The main function for the project. This function initializes the os, calls
+ * init_tasks to initialize tasks (and possibly other objects), then starts the
+ * OS. We should not return from os start.
+ *
+ * @return int NOTE: this function should never return!
+ */
+int
+main(void)
+{
+    struct ble_hci_ram_cfg hci_cfg;
+    struct ble_hs_cfg cfg;
+    int rc;
+
+    os_init();
+
+    rc = cputime_init(1000000);
+    assert(rc == 0);
+
+    rc = os_mempool_init(&blebench_mbuf_mpool, MBUF_NUM_MBUFS,
+                         MBUF_MEMBLOCK_SIZE, blebench_mbuf_mpool_data,
+                         "blebench_mbuf_data");
+    assert(rc == 0);
+
+    rc = os_mbuf_pool_init(&blebench_mbuf_pool, &blebench_mbuf_mpool,
+                           MBUF_MEMBLOCK_SIZE, MBUF_NUM_MBUFS);
+    assert(rc == 0);
+
+    rc = os_msys_register(&blebench_mbuf_pool);
+    assert(rc == 0);
+
+    log_init();
+    log_console_handler_init(&blebench_log_console_handler);
+    log_register("blebench", &blebench_log, &blebench_log_console_handler);
+
+    rc = shell_task_init(SHELL_TASK_PRIO, shell_stack, SHELL_TASK_STACK_SIZE,
+                         SHELL_MAX_INPUT_LEN);
+    assert(rc == 0);
+
+    rc = shell_cmd_register(&blebench_cmd);
+    assert(rc == 0);
+
+    rc = nmgr_task_init(NEWTMGR_TASK_PRIO, newtmgr_stack,
+                        NEWTMGR_TASK_STACK_SIZE);
+    assert(rc == 0);
+
+    rc = stats_module_init();
+    assert(rc == 0);
+
+    rc = stats_init_and_reg(STATS_HDR(blebench_stats),
+                            STATS_SIZE_INIT_PARMS(blebench_stats,
+                                                  STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(blebench_stats),
+                            "blebench");
+    assert(rc == 0);
+
+    os_eventq_init(&blebench_evq);
+    os_callout_func_init(&blebench_timer, &blebench_evq, blebench_tick, NULL);
+
+    os_task_init(&blebench_task, "blebench", blebench_task_handler,
+                 NULL, BLEBENCH_TASK_PRIO, OS_WAIT_FOREVER,
+                 blebench_stack, BLEBENCH_STACK_SIZE);
+
+    rc = ble_ll_init(BLE_LL_TASK_PRI, MBUF_NUM_MBUFS, BLE_MBUF_PAYLOAD_SIZE);
+    assert(rc == 0);
+
+    hci_cfg = ble_hci_ram_cfg_dflt;
+    rc = ble_hci_ram_init(&hci_cfg);
+    assert(rc == 0);
+
+    cfg = ble_hs_cfg_dflt;
+    cfg.max_hci_bufs = hci_cfg.num_evt_hi_bufs + hci_cfg.num_evt_lo_bufs;
+    cfg.max_connections = BLEBENCH_MAX_CONNS;
+    cfg.reset_cb = blebench_on_reset;
+    cfg.store_read_cb = ble_store_ram_read;
+    cfg.store_write_cb = ble_store_ram_write;
+    cfg.store_delete_cb = ble_store_ram_delete;
+
+    rc = ble_svc_gap_init(&cfg);
+    assert(rc == 0);
+
+    rc = ble_svc_gatt_init(&cfg);
+    assert(rc == 0);
+
+    rc = ble_hs_init(&blebench_evq, &cfg);
+    assert(rc == 0);
+
+    rc = ble_att_set_preferred_mtu(BLE_ATT_MTU_MAX);
+    assert(rc == 0);
+
+    rc = ble_svc_gap_device_name_set("blebench-cent");
+    assert(rc == 0);
+
+    os_start();
+
+    /* os start should never return. If it does, this should be an error */
+    assert(0);
+
+    return 0;
+}
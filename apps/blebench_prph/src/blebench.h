@@ -0,0 +1,51 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLEBENCH_
+#define H_BLEBENCH_
+
+/*
+ * Shared between blebench_prph and blebench_cent; keep the two copies
+ * the same.
+ *
+ * The benchmark service has three characteristics:
+ *     o sink: written to by the central with write-without-response;
+ *       peripheral counts what arrives.
+ *     o source: peripheral notifies it as fast as it can while the central
+ *       is subscribed.
+ *     o echo: small value the central reads back-to-back to time ATT
+ *       round trips.
+ */
+
+/* 7c9a0000-3d3b-4c42-9d4e-5b1a3c1e0b10 */
+#define BLEBENCH_UUID128(__last)                                            \
+    ((const uint8_t[16]) {                                                  \
+        0x10, 0x0b, 0x1e, 0x3c, 0x1a, 0x5b, 0x4e, 0x9d,                     \
+        0x42, 0x4c, 0x3b, 0x3d, (__last), 0x00, 0x9a, 0x7c                  \
+    })
+
+#define BLEBENCH_SVC_UUID           BLEBENCH_UUID128(0x00)
+#define BLEBENCH_CHR_SINK_UUID      BLEBENCH_UUID128(0x01)
+#define BLEBENCH_CHR_SOURCE_UUID    BLEBENCH_UUID128(0x02)
+#define BLEBENCH_CHR_ECHO_UUID      BLEBENCH_UUID128(0x03)
+
+/* Connections either side keeps track of. */
+#define BLEBENCH_MAX_CONNS          4
+
+#endif
@@ -0,0 +1,478 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "hal/hal_cputime.h"
+#include "console/console.h"
+#include "shell/shell.h"
+#include "stats/stats.h"
+#include "log/log.h"
+
+/* BLE */
+#include "nimble/ble.h"
+#include "host/ble_hs.h"
+#include "host/ble_hs_adv.h"
+#include "host/ble_hs_mbuf.h"
+#include "host/ble_att.h"
+#include "host/ble_gap.h"
+#include "host/ble_gatt.h"
+#include "controller/ble_ll.h"
+#include "transport/ram/ble_hci_ram.h"
+#include "store/ram/ble_store_ram.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+
+#include "newtmgr/newtmgr.h"
+#include "nmgrble/newtmgr_ble.h"
+
+#include "blebench.h"
+
+/*
+ * Peripheral side of the BLE benchmark. Advertises the benchmark service
+ * and accepts connections up to BLEBENCH_MAX_CONNS. Counts what is
+ * written to the sink characteristic, and streams notifications of the
+ * source characteristic to subscribed centrals. Counters are in the
+ * "blebench" stats group, so they can be read with the shell "stat"
+ * command or over newtmgr.
+ */
+
+/** Mbuf settings. */
+#define MBUF_NUM_MBUFS      (24)
+#define MBUF_BUF_SIZE       OS_ALIGN(BLE_MBUF_PAYLOAD_SIZE, 4)
+#define MBUF_MEMBLOCK_SIZE  (MBUF_BUF_SIZE + BLE_MBUF_MEMBLOCK_OVERHEAD)
+#define MBUF_MEMPOOL_SIZE   OS_MEMPOOL_SIZE(MBUF_NUM_MBUFS, MBUF_MEMBLOCK_SIZE)
+
+static os_membuf_t blebench_mbuf_mpool_data[MBUF_MEMPOOL_SIZE];
+static struct os_mbuf_pool blebench_mbuf_pool;
+static struct os_mempool blebench_mbuf_mpool;
+
+/** Log data. */
+static struct log_handler blebench_log_console_handler;
+static struct log blebench_log;
+#define BLEBENCH_LOG(lvl, ...) \
+    LOG_ ## lvl(&blebench_log, LOG_MODULE_PERUSER, __VA_ARGS__)
+
+/** Priority of the nimble host and controller tasks. */
+#define BLE_LL_TASK_PRI             (OS_TASK_PRI_HIGHEST)
+
+#define BLEBENCH_TASK_PRIO          1
+#define BLEBENCH_STACK_SIZE         (OS_STACK_ALIGN(336))
+static struct os_eventq blebench_evq;
+static struct os_task blebench_task;
+static bssnz_t os_stack_t blebench_stack[BLEBENCH_STACK_SIZE];
+
+#define SHELL_TASK_PRIO             (3)
+#define SHELL_MAX_INPUT_LEN         (128)
+#define SHELL_TASK_STACK_SIZE       (OS_STACK_ALIGN(384))
+static bssnz_t os_stack_t shell_stack[SHELL_TASK_STACK_SIZE];
+
+#define NEWTMGR_TASK_PRIO           (4)
+#define NEWTMGR_TASK_STACK_SIZE     (OS_STACK_ALIGN(512))
+static bssnz_t os_stack_t newtmgr_stack[NEWTMGR_TASK_STACK_SIZE];
+
+/** Our global device address (public) */
+uint8_t g_dev_addr[BLE_DEV_ADDR_LEN] = {0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b};
+
+/** Our random address (in case we need it) */
+uint8_t g_random_addr[BLE_DEV_ADDR_LEN];
+
+STATS_SECT_START(blebench_stats)
+    STATS_SECT_ENTRY(conns)
+    STATS_SECT_ENTRY(disconns)
+    STATS_SECT_ENTRY(sink_pkts)
+    STATS_SECT_ENTRY(sink_bytes)
+    STATS_SECT_ENTRY(src_pkts)
+    STATS_SECT_ENTRY(src_bytes)
+    STATS_SECT_ENTRY(src_stalls)
+    STATS_SECT_ENTRY(echo_reads)
+STATS_SECT_END
+
+static STATS_SECT_DECL(blebench_stats) blebench_stats;
+
+STATS_NAME_START(blebench_stats)
+    STATS_NAME(blebench_stats, conns)
+    STATS_NAME(blebench_stats, disconns)
+    STATS_NAME(blebench_stats, sink_pkts)
+    STATS_NAME(blebench_stats, sink_bytes)
+    STATS_NAME(blebench_stats, src_pkts)
+    STATS_NAME(blebench_stats, src_bytes)
+    STATS_NAME(blebench_stats, src_stalls)
+    STATS_NAME(blebench_stats, echo_reads)
+STATS_NAME_END(blebench_stats)
+
+/* Connections that are subscribed to source. */
+static struct {
+    uint16_t handle;
+    uint8_t notify;
+} blebench_conns[BLEBENCH_MAX_CONNS];
+static int blebench_conn_cnt;
+
+static uint16_t blebench_src_handle;
+static struct os_callout_func blebench_pump_timer;
+
+static int blebench_gap_event(struct ble_gap_event *event, void *arg);
+static int blebench_chr_access(uint16_t conn_handle, uint16_t attr_handle,
+                               struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+static const struct ble_gatt_svc_def blebench_svcs[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid128 = BLEBENCH_SVC_UUID,
+        .characteristics = (struct ble_gatt_chr_def[]) { {
+            .uuid128 = BLEBENCH_CHR_SINK_UUID,
+            .access_cb = blebench_chr_access,
+            .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP,
+        }, {
+            .uuid128 = BLEBENCH_CHR_SOURCE_UUID,
+            .access_cb = blebench_chr_access,
+            .flags = BLE_GATT_CHR_F_NOTIFY,
+            .val_handle = &blebench_src_handle,
+        }, {
+            .uuid128 = BLEBENCH_CHR_ECHO_UUID,
+            .access_cb = blebench_chr_access,
+            .flags = BLE_GATT_CHR_F_READ,
+        }, {
+            0,
+        } },
+    },
+    {
+        0,
+    },
+};
+
+static int
+blebench_chr_access(uint16_t conn_handle, uint16_t attr_handle,
+                    struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    static const uint8_t echo_val[4] = { 'p', 'o', 'n', 'g' };
+
+    switch (ctxt->op) {
+    case BLE_GATT_ACCESS_OP_WRITE_CHR:
+        STATS_INC(blebench_stats, sink_pkts);
+        STATS_INCN(blebench_stats, sink_bytes, OS_MBUF_PKTLEN(ctxt->om));
+        return 0;
+
+    case BLE_GATT_ACCESS_OP_READ_CHR:
+        STATS_INC(blebench_stats, echo_reads);
+        if (os_mbuf_append(ctxt->om, echo_val, sizeof(echo_val))) {
+            return BLE_ATT_ERR_INSUFFICIENT_RES;
+        }
+        return 0;
+
+    default:
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+/*
+ * Queue MTU sized notifications to every subscribed connection until
+ * buffers run out, then try again on the next tick.
+ */
+static void
+blebench_pump(void *arg)
+{
+    struct os_mbuf *om;
+    uint16_t len;
+    int active;
+    int i;
+
+    active = 0;
+    for (i = 0; i < blebench_conn_cnt; i++) {
+        if (!blebench_conns[i].notify) {
+            continue;
+        }
+        active = 1;
+        len = ble_att_mtu(blebench_conns[i].handle) - 3;
+        while (1) {
+            om = ble_hs_mbuf_att_pkt();
+            if (!om) {
+                break;
+            }
+            if (os_mbuf_extend(om, len) == NULL) {
+                os_mbuf_free_chain(om);
+                break;
+            }
+            if (ble_gattc_notify_custom(blebench_conns[i].handle,
+                                        blebench_src_handle, om)) {
+                break;
+            }
+            STATS_INC(blebench_stats, src_pkts);
+            STATS_INCN(blebench_stats, src_bytes, len);
+        }
+        STATS_INC(blebench_stats, src_stalls);
+    }
+    if (active) {
+        os_callout_reset(&blebench_pump_timer.cf_c, 1);
+    }
+}
+
+static int
+blebench_conn_idx(uint16_t handle)
+{
+    int i;
+
+    for (i = 0; i < blebench_conn_cnt; i++) {
+        if (blebench_conns[i].handle == handle) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void
+blebench_advertise(void)
+{
+    struct ble_gap_adv_params adv_params;
+    struct ble_hs_adv_fields fields;
+    int rc;
+
+    if (blebench_conn_cnt >= BLEBENCH_MAX_CONNS || ble_gap_adv_active()) {
+        return;
+    }
+
+    memset(&fields, 0, sizeof fields);
+    fields.flags_is_present = 1;
+    fields.flags = 0;
+    fields.uuids128 = (void *)BLEBENCH_SVC_UUID;
+    fields.num_uuids128 = 1;
+    fields.uuids128_is_complete = 1;
+
+    rc = ble_gap_adv_set_fields(&fields);
+    if (rc != 0) {
+        BLEBENCH_LOG(ERROR, "error setting advertisement data; rc=%d\n", rc);
+        return;
+    }
+
+    memset(&adv_params, 0, sizeof adv_params);
+    adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+    adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+    rc = ble_gap_adv_start(BLE_ADDR_TYPE_PUBLIC, 0, NULL, BLE_HS_FOREVER,
+                           &adv_params, blebench_gap_event, NULL);
+    if (rc != 0) {
+        BLEBENCH_LOG(ERROR, "error enabling advertisement; rc=%d\n", rc);
+    }
+}
+
+static int
+blebench_gap_event(struct ble_gap_event *event, void *arg)
+{
+    int idx;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_CONNECT:
+        if (event->connect.status == 0) {
+            STATS_INC(blebench_stats, conns);
+            assert(blebench_conn_cnt < BLEBENCH_MAX_CONNS);
+            blebench_conns[blebench_conn_cnt].handle =
+              event->connect.conn_handle;
+            blebench_conns[blebench_conn_cnt].notify = 0;
+            blebench_conn_cnt++;
+            BLEBENCH_LOG(INFO, "connected; handle=%d conns=%d\n",
+                         event->connect.conn_handle, blebench_conn_cnt);
+        }
+        /* Keep advertising until all connection slots are taken. */
+        blebench_advertise();
+        return 0;
+
+    case BLE_GAP_EVENT_DISCONNECT:
+        STATS_INC(blebench_stats, disconns);
+        idx = blebench_conn_idx(event->disconnect.conn.conn_handle);
+        if (idx >= 0) {
+            blebench_conns[idx] = blebench_conns[--blebench_conn_cnt];
+        }
+        BLEBENCH_LOG(INFO, "disconnected; reason=%d conns=%d\n",
+                     event->disconnect.reason, blebench_conn_cnt);
+        blebench_advertise();
+        return 0;
+
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        if (event->subscribe.attr_handle != blebench_src_handle) {
+            return 0;
+        }
+        idx = blebench_conn_idx(event->subscribe.conn_handle);
+        if (idx >= 0) {
+            blebench_conns[idx].notify = event->subscribe.cur_notify;
+            if (blebench_conns[idx].notify) {
+                blebench_pump(NULL);
+            }
+        }
+        return 0;
+    }
+
+    return 0;
+}
+
+static void
+blebench_on_reset(int reason)
+{
+    BLEBENCH_LOG(ERROR, "Resetting state; reason=%d\n", reason);
+}
+
+static void
+blebench_on_sync(void)
+{
+    blebench_advertise();
+}
+
+static void
+blebench_task_handler(void *unused)
+{
+    struct os_event *ev;
+    struct os_callout_func *cf;
+    int rc;
+
+    rc = ble_hs_start();
+    assert(rc == 0);
+
+    while (1) {
+        ev = os_eventq_get(&blebench_evq);
+
+        /* Check if the event is a nmgr ble mqueue event */
+        rc = nmgr_ble_proc_mq_evt(ev);
+        if (!rc) {
+            continue;
+        }
+
+        switch (ev->ev_type) {
+        case OS_EVENT_T_TIMER:
+            cf = (struct os_callout_func *)ev;
+            assert(cf->cf_func);
+            cf->cf_func(CF_ARG(cf));
+            break;
+        default:
+            assert(0);
+            break;
+        }
+    }
+}
+
+/**
+ * main
+ *
+ * The main function for the project. This function initializes the os, calls
+ * init_tasks to initialize tasks (and possibly other objects), then starts the
+ * OS. We should not return from os start.
+ *
+ * @return int NOTE: this function should never return!
+ */
+int
+main(void)
+{
+    struct ble_hci_ram_cfg hci_cfg;
+    struct ble_hs_cfg cfg;
+    int rc;
+
+    os_init();
+
+    rc = cputime_init(1000000);
+    assert(rc == 0);
+
+    rc = os_mempool_init(&blebench_mbuf_mpool, MBUF_NUM_MBUFS,
+                         MBUF_MEMBLOCK_SIZE, blebench_mbuf_mpool_data,
+                         "blebench_mbuf_data");
+    assert(rc == 0);
+
+    rc = os_mbuf_pool_init(&blebench_mbuf_pool, &blebench_mbuf_mpool,
+                           MBUF_MEMBLOCK_SIZE, MBUF_NUM_MBUFS);
+    assert(rc == 0);
+
+    rc = os_msys_register(&blebench_mbuf_pool);
+    assert(rc == 0);
+
+    log_init();
+    log_console_handler_init(&blebench_log_console_handler);
+    log_register("blebench", &blebench_log, &blebench_log_console_handler);
+
+    rc = shell_task_init(SHELL_TASK_PRIO, shell_stack, SHELL_TASK_STACK_SIZE,
+                         SHELL_MAX_INPUT_LEN);
+    assert(rc == 0);
+
+    rc = nmgr_task_init(NEWTMGR_TASK_PRIO, newtmgr_stack,
+                        NEWTMGR_TASK_STACK_SIZE);
+    assert(rc == 0);
+
+    rc = stats_module_init();
+    assert(rc == 0);
+
+    rc = stats_init_and_reg(STATS_HDR(blebench_stats),
+                            STATS_SIZE_INIT_PARMS(blebench_stats,
+                                                  STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(blebench_stats),
+                            "blebench");
+    assert(rc == 0);
+
+    os_eventq_init(&blebench_evq);
+    os_callout_func_init(&blebench_pump_timer, &blebench_evq, blebench_pump,
+                         NULL);
+
+    os_task_init(&blebench_task, "blebench", blebench_task_handler,
+                 NULL, BLEBENCH_TASK_PRIO, OS_WAIT_FOREVER,
+                 blebench_stack, BLEBENCH_STACK_SIZE);
+
+    rc = ble_ll_init(BLE_LL_TASK_PRI, MBUF_NUM_MBUFS, BLE_MBUF_PAYLOAD_SIZE);
+    assert(rc == 0);
+
+    hci_cfg = ble_hci_ram_cfg_dflt;
+    rc = ble_hci_ram_init(&hci_cfg);
+    assert(rc == 0);
+
+    cfg = ble_hs_cfg_dflt;
+    cfg.max_hci_bufs = hci_cfg.num_evt_hi_bufs + hci_cfg.num_evt_lo_bufs;
+    cfg.max_connections = BLEBENCH_MAX_CONNS;
+    cfg.reset_cb = blebench_on_reset;
+    cfg.sync_cb = blebench_on_sync;
+    cfg.store_read_cb = ble_store_ram_read;
+    cfg.store_write_cb = ble_store_ram_write;
+
+    rc = ble_svc_gap_init(&cfg);
+    assert(rc == 0);
+
+    rc = ble_svc_gatt_init(&cfg);
+    assert(rc == 0);
+
+    rc = nmgr_ble_gatt_svr_init(&blebench_evq, &cfg);
+    assert(rc == 0);
+
+    rc = ble_gatts_count_cfg(blebench_svcs, &cfg);
+    assert(rc == 0);
+
+    rc = ble_gatts_add_svcs(blebench_svcs);
+    assert(rc == 0);
+
+    rc = ble_hs_init(&blebench_evq, &cfg);
+    assert(rc == 0);
+
+    /* Larger MTU means fewer ATT headers per byte of payload. */
+    rc = ble_att_set_preferred_mtu(BLE_ATT_MTU_MAX);
+    assert(rc == 0);
+
+    rc = ble_svc_gap_device_name_set("blebench");
+    assert(rc == 0);
+
+    os_start();
+
+    /* os start should never return. If it does, this should be an error */
+    assert(0);
+
+    return 0;
+}
@@ -590,6 +590,7 @@ main(void)
     cfg.sync_cb = blecent_on_sync;
     cfg.store_read_cb = ble_store_ram_read;
     cfg.store_write_cb = ble_store_ram_write;
+    cfg.store_delete_cb = ble_store_ram_delete;
 
     /* Initialize GATT services. */
     rc = ble_svc_gap_init(&cfg);
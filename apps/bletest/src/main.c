@@ -51,6 +51,10 @@
 /* RAM HCI transport. */
 #include "transport/ram/ble_hci_ram.h"
 
+#ifdef ARCH_sim
+#include <mcu/mcu_sim.h>
+#endif
+
 /* XXX: An app should not include private headers from a library.  The bletest
  * app uses some of nimble's internal details for logging.
  */
@@ -136,7 +140,14 @@ os_membuf_t g_mbuf_buffer[MBUF_MEMPOOL_SIZE];
 
 /* Test packet config */
 #define BLETEST_CFG_RAND_PKT_SIZE       (1)
+
+/* Use data length extension on connections (0: 27 byte PDUs only) */
+#define BLETEST_CFG_DLE                 (1)
+#if (BLETEST_CFG_DLE == 1)
 #define BLETEST_CFG_SUGG_DEF_TXOCTETS   (251)
+#else
+#define BLETEST_CFG_SUGG_DEF_TXOCTETS   (27)
+#endif
 #define BLETEST_CFG_SUGG_DEF_TXTIME     \
     BLE_TX_DUR_USECS_M(BLETEST_CFG_SUGG_DEF_TXOCTETS + 4)
 
@@ -145,6 +156,10 @@ os_membuf_t g_mbuf_buffer[MBUF_MEMPOOL_SIZE];
     #define BLETEST_CONCURRENT_CONN_TEST    (1)
 #endif
 
+/* Throughput test: packets in flight per connection and report interval */
+#define BLETEST_CFG_THRPUT_WINDOW       (4)
+#define BLETEST_CFG_THRPUT_RPT_SECS     (10)
+
 /* BLETEST variables */
 #undef BLETEST_ADV_PKT_NUM
 #define BLETEST_MAX_PKT_SIZE            (247)
@@ -165,9 +180,6 @@ uint8_t g_last_handle_used;
 uint8_t g_bletest_led_state;
 uint32_t g_bletest_led_rate;
 uint32_t g_bletest_next_led_time;
-uint16_t g_bletest_handle;
-uint16_t g_bletest_completed_pkts;
-uint16_t g_bletest_outstanding_pkts;
 uint16_t g_bletest_ltk_reply_handle;
 uint32_t g_bletest_hw_id[4];
 struct hci_create_conn g_cc;
@@ -222,17 +234,62 @@ uint32_t g_bletest_IVs = 0xDEAFBABE;
 #endif
 
 #if (BLETEST_THROUGHPUT_TEST == 1)
+/* Per connection throughput test counters (indexed by handle - 1) */
+struct bletest_thrput
+{
+    uint16_t completed_pkts;
+    uint16_t outstanding_pkts;
+    uint32_t rpt_pkts;
+};
+struct bletest_thrput g_bletest_thrput[BLETEST_CFG_CONCURRENT_CONNS];
+uint32_t g_bletest_thrput_rpt_time;
+
+/**
+ * Called by the link layer when a data packet has been acknowledged by the
+ * peer.
+ *
+ * @param handle Connection handle
+ */
 void
 bletest_completed_pkt(uint16_t handle)
 {
     os_sr_t sr;
 
     OS_ENTER_CRITICAL(sr);
-    if (handle == g_bletest_handle) {
-        ++g_bletest_completed_pkts;
+    if ((handle != 0) && (handle <= BLETEST_CFG_CONCURRENT_CONNS)) {
+        ++g_bletest_thrput[handle - 1].completed_pkts;
     }
     OS_EXIT_CRITICAL(sr);
 }
+
+#if (BLETEST_CFG_ROLE == BLETEST_ROLE_ADVERTISER)
+/**
+ * Print the goodput (L2CAP payload bits acknowledged per second) of each
+ * connection since the last report and reset the counters.
+ */
+static void
+bletest_thrput_report(void)
+{
+    int i;
+    uint32_t bps;
+    struct bletest_thrput *bt;
+    struct ble_ll_conn_sm *connsm;
+
+    for (i = 0; i < g_bletest_current_conns; ++i) {
+        bt = &g_bletest_thrput[i];
+        connsm = ble_ll_conn_find_active_conn(i + 1);
+        if (connsm) {
+            bps = (bt->rpt_pkts * BLETEST_PKT_SIZE * 8) /
+                  BLETEST_CFG_THRPUT_RPT_SECS;
+            console_printf("handle=%d dle=%d eff_tx_octets=%u pkts=%lu "
+                           "goodput=%lu bps\n", i + 1, BLETEST_CFG_DLE,
+                           connsm->eff_max_tx_octets,
+                           (unsigned long)bt->rpt_pkts, (unsigned long)bps);
+        }
+        bt->rpt_pkts = 0;
+    }
+}
+#endif
 #endif
 
 #ifdef BLETEST_ADV_PKT_NUM
@@ -674,6 +731,7 @@ bletest_execute_advertiser(void)
 #if (BLETEST_THROUGHPUT_TEST == 1)
     os_sr_t sr;
     uint16_t completed_pkts;
+    struct bletest_thrput *bt;
 #endif
 
     /* See if we should start advertising again */
@@ -687,7 +745,8 @@ bletest_execute_advertiser(void)
             /* Set next os time to 10 seconds after 1st connection */
             if (g_next_os_time == 0) {
                 g_next_os_time = os_time_get() + (10 * OS_TICKS_PER_SEC);
-                g_bletest_handle = handle;
+                g_bletest_thrput_rpt_time = g_next_os_time +
+                    (BLETEST_CFG_THRPUT_RPT_SECS * OS_TICKS_PER_SEC);
             }
 #endif
 
@@ -813,25 +872,35 @@ bletest_execute_advertiser(void)
 
     /* See if it is time to start throughput testing */
     if ((int32_t)(os_time_get() - g_next_os_time) >= 0) {
+        for (handle = 1; handle <= g_bletest_current_conns; ++handle) {
+            bt = &g_bletest_thrput[handle - 1];
 
-        /* Keep window full */
-        OS_ENTER_CRITICAL(sr);
-        completed_pkts = g_bletest_completed_pkts;
-        g_bletest_completed_pkts = 0;
-        OS_EXIT_CRITICAL(sr);
+            OS_ENTER_CRITICAL(sr);
+            completed_pkts = bt->completed_pkts;
+            bt->completed_pkts = 0;
+            OS_EXIT_CRITICAL(sr);
 
-        assert(g_bletest_outstanding_pkts >= completed_pkts);
-        g_bletest_outstanding_pkts -= completed_pkts;
+            assert(bt->outstanding_pkts >= completed_pkts);
+            bt->outstanding_pkts -= completed_pkts;
+            bt->rpt_pkts += completed_pkts;
+
+            if (!ble_ll_conn_find_active_conn(handle)) {
+                continue;
+            }
+
+            /* Keep window full */
+            while (bt->outstanding_pkts < BLETEST_CFG_THRPUT_WINDOW) {
+                om = bletest_get_packet();
+                if (!om) {
+                    break;
+                }
 
-        while (g_bletest_outstanding_pkts < 20) {
-            om = bletest_get_packet();
-            if (om) {
                 /* set payload length */
                 pktlen = BLETEST_PKT_SIZE;
                 om->om_len = BLETEST_PKT_SIZE + 4;
 
                 /* Put the HCI header in the mbuf */
-                htole16(om->om_data, g_bletest_handle);
+                htole16(om->om_data, handle);
                 htole16(om->om_data + 2, om->om_len);
 
                 /* Place L2CAP header in packet */
@@ -847,11 +916,18 @@ bletest_execute_advertiser(void)
 
                 /* Add length */
                 OS_MBUF_PKTHDR(om)->omp_len = om->om_len;
-                ble_hci_trans_hs_acl_data_send(om);
+                ble_hci_trans_hs_acl_tx(om);
 
-                ++g_bletest_outstanding_pkts;
+                ++bt->outstanding_pkts;
             }
         }
+
+        /* Report goodput periodically */
+        if ((int32_t)(os_time_get() - g_bletest_thrput_rpt_time) >= 0) {
+            bletest_thrput_report();
+            g_bletest_thrput_rpt_time +=
+                BLETEST_CFG_THRPUT_RPT_SECS * OS_TICKS_PER_SEC;
+        }
     }
 #endif /* XXX: throughput test */
 }
@@ -1056,7 +1132,7 @@ bletest_task_handler(void *arg)
  * @return int NOTE: this function should never return!
  */
 int
-main(void)
+main(int argc, char **argv)
 {
     int i;
     int rc;
@@ -1066,6 +1142,10 @@ main(void)
     struct nffs_area_desc descs[NFFS_AREA_MAX];
 #endif
 
+#ifdef ARCH_sim
+    mcu_sim_parse_args(argc, argv);
+#endif
+
     /* Initialize OS */
     os_init();
 
@@ -37,6 +37,7 @@
 #include "nimble/nimble_opt.h"
 #include "nimble/ble_hci_trans.h"
 #include "controller/ble_ll.h"
+#include "controller/ble_hw.h"
 #include "host/ble_hs.h"
 #include "host/ble_hs_adv.h"
 #include "host/ble_uuid.h"
@@ -1568,6 +1569,34 @@ bletiny_on_reset(int reason)
     console_printf("Error: Resetting state; reason=%d\n", reason);
 }
 
+/**
+ * Runs security manager AES through the controller's encryption block (the
+ * ECB peripheral on nRF5x).  If the hardware is unavailable, the host falls
+ * back to its software implementation.
+ */
+static int
+bletiny_sm_aes(const uint8_t *key, const uint8_t *plaintext,
+               uint8_t *enc_data)
+{
+    struct ble_encryption_block ecb;
+    os_sr_t sr;
+    int rc;
+
+    memcpy(ecb.key, key, sizeof ecb.key);
+    memcpy(ecb.plain_text, plaintext, sizeof ecb.plain_text);
+
+    /* The link layer also uses the ECB from interrupt context. */
+    OS_ENTER_CRITICAL(sr);
+    rc = ble_hw_encrypt_block(&ecb);
+    OS_EXIT_CRITICAL(sr);
+    if (rc != 0) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    memcpy(enc_data, ecb.cipher_text, sizeof ecb.cipher_text);
+    return 0;
+}
+
 /**
  * BLE test task
  *
@@ -1715,8 +1744,10 @@ main(void)
     cfg.max_hci_bufs = hci_cfg.num_evt_hi_bufs + hci_cfg.num_evt_lo_bufs;
     cfg.max_gattc_procs = 2;
     cfg.reset_cb = bletiny_on_reset;
+    cfg.sm_aes_cb = bletiny_sm_aes;
     cfg.store_read_cb = ble_store_ram_read;
     cfg.store_write_cb = ble_store_ram_write;
+    cfg.store_delete_cb = ble_store_ram_delete;
     cfg.gatts_register_cb = gatt_svr_register_cb;
 
     /* Initialize GATT services. */
@@ -191,6 +191,7 @@ bleuart_gap_event(struct ble_gap_event *event, void *arg)
 
     case BLE_GAP_EVENT_DISCONNECT:
         /* Connection terminated; resume advertising. */
+        bleuart_set_conn_handle(BLE_HS_CONN_HANDLE_NONE);
         bleuart_advertise();
         return 0;
     }
@@ -339,7 +340,7 @@ main(void)
     rc = ble_hs_init(&bleuart_evq, &cfg);
     assert(rc == 0);
 
-    bleuart_init(MAX_CONSOLE_INPUT);
+    bleuart_init(&bleuart_evq, MAX_CONSOLE_INPUT);
 
     nmgr_task_init(NEWTMGR_TASK_PRIO, newtmgr_stack, NEWTMGR_TASK_STACK_SIZE);
     imgmgr_module_init();
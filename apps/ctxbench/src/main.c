@@ -0,0 +1,196 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "console/console.h"
+#include <mcu/cortex_m0.h>
+#include <assert.h>
+
+/*
+ * SysTick is run as a free-running down-counter clocked by the core, which
+ * gives cycle counts on parts without a DWT cycle counter.  The OS tick
+ * must therefore come from another timer (the RTC on nrf51).
+ */
+#define BENCH_CYCLES()              (SysTick->VAL)
+#define BENCH_ELAPSED(__s, __e)     (((__s) - (__e)) & SysTick_LOAD_RELOAD_Msk)
+
+#define BENCH_ITERS                 (1000)
+
+/* Ping task: runs the benchmarks and reports the results. */
+#define PING_TASK_PRIO              (1)
+#define PING_STACK_SIZE             OS_STACK_ALIGN(256)
+struct os_task ping_task;
+os_stack_t ping_stack[PING_STACK_SIZE];
+
+/* Pong task: the other end of the context switch benchmark. */
+#define PONG_TASK_PRIO              (2)
+#define PONG_STACK_SIZE             OS_STACK_ALIGN(128)
+struct os_task pong_task;
+os_stack_t pong_stack[PONG_STACK_SIZE];
+
+static struct os_sem ping_sem;
+static struct os_sem pong_sem;
+
+static void
+bench_timer_init(void)
+{
+    SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+/* Cycles taken by the loop itself, subtracted from the results below. */
+static uint32_t
+bench_loop(void)
+{
+    uint32_t start;
+    int i;
+
+    start = BENCH_CYCLES();
+    for (i = 0; i < BENCH_ITERS; i++) {
+        __asm__ volatile ("" : : : "memory");
+    }
+
+    return (BENCH_ELAPSED(start, BENCH_CYCLES()));
+}
+
+/* Inlined OS_ENTER_CRITICAL() / OS_EXIT_CRITICAL() pairs. */
+static uint32_t
+bench_critical_inline(void)
+{
+    uint32_t start;
+    os_sr_t sr;
+    int i;
+
+    start = BENCH_CYCLES();
+    for (i = 0; i < BENCH_ITERS; i++) {
+        OS_ENTER_CRITICAL(sr);
+        OS_EXIT_CRITICAL(sr);
+    }
+
+    return (BENCH_ELAPSED(start, BENCH_CYCLES()));
+}
+
+/* The same through the out-of-line functions, as before they were inlined. */
+static uint32_t
+bench_critical_call(void)
+{
+    uint32_t start;
+    os_sr_t sr;
+    int i;
+
+    start = BENCH_CYCLES();
+    for (i = 0; i < BENCH_ITERS; i++) {
+        sr = os_arch_save_sr();
+        os_arch_restore_sr(sr);
+    }
+
+    return (BENCH_ELAPSED(start, BENCH_CYCLES()));
+}
+
+/*
+ * Ping-pong with the lower priority pong task; each iteration is two
+ * context switches plus a semaphore release and pend on each side.
+ */
+static uint32_t
+bench_ctx_sw(void)
+{
+    uint32_t start;
+    int i;
+
+    start = BENCH_CYCLES();
+    for (i = 0; i < BENCH_ITERS; i++) {
+        os_sem_release(&pong_sem);
+        os_sem_pend(&ping_sem, OS_TIMEOUT_NEVER);
+    }
+
+    return (BENCH_ELAPSED(start, BENCH_CYCLES()));
+}
+
+static void
+pong_task_handler(void *arg)
+{
+    while (1) {
+        os_sem_pend(&pong_sem, OS_TIMEOUT_NEVER);
+        os_sem_release(&ping_sem);
+    }
+}
+
+static void
+ping_task_handler(void *arg)
+{
+    uint32_t loop;
+    uint32_t inl;
+    uint32_t call;
+    uint32_t ctx;
+
+    bench_timer_init();
+
+    while (1) {
+        loop = bench_loop();
+        inl = bench_critical_inline() - loop;
+        call = bench_critical_call() - loop;
+        ctx = bench_ctx_sw() - loop;
+
+        /* Results are in hundredths of a cycle per iteration. */
+        console_printf("critical inline=%lu call=%lu ctx_sw round trip=%lu\n",
+                (unsigned long)(inl * 100 / BENCH_ITERS),
+                (unsigned long)(call * 100 / BENCH_ITERS),
+                (unsigned long)(ctx * 100 / BENCH_ITERS));
+
+        os_time_delay(OS_TICKS_PER_SEC);
+    }
+}
+
+/**
+ * main
+ *
+ * The main function for the project. This function initializes the os,
+ * the console and the benchmark tasks, then starts the OS. We should not
+ * return from os start.
+ *
+ * @return int NOTE: this function should never return!
+ */
+int
+main(void)
+{
+    int rc;
+
+    os_init();
+
+    rc = console_init(NULL);
+    assert(rc == 0);
+
+    os_sem_init(&ping_sem, 0);
+    os_sem_init(&pong_sem, 0);
+
+    os_task_init(&ping_task, "ping", ping_task_handler, NULL,
+            PING_TASK_PRIO, OS_WAIT_FOREVER, ping_stack, PING_STACK_SIZE);
+
+    os_task_init(&pong_task, "pong", pong_task_handler, NULL,
+            PONG_TASK_PRIO, OS_WAIT_FOREVER, pong_stack, PONG_STACK_SIZE);
+
+    os_start();
+
+    /* os start should never return. If it does, this should be an error */
+    assert(0);
+
+    return rc;
+}
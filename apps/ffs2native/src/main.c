@@ -43,6 +43,7 @@
 static struct log_handler nffs_log_console_handler;
 struct log nffs_log;
 static const char *copy_in_dir;
+static const char *romfs_out;
 static const char *progname;
 static int print_verbose;
 
@@ -97,6 +98,7 @@ struct nffs_disk_V0object {
 #define ndo_disk_V0block    ndo_un_V0obj.ndo_disk_V0block
 
 static void usage(int rc);
+int romfs_gen(const char *src_dir, const char *out_file);
 
 static void
 copyfs(FILE *fp)
@@ -245,7 +247,7 @@ print_nffs_area(int idx)
     /*
      * XXX Enhance to print but not restore unsupported formats
      */
-    if (!nffs_area_is_current_version(&darea)) {
+    if (!nffs_area_is_supported_version(&darea)) {
         printf("Area format is not supported!\n");
         return;
     }
@@ -574,7 +576,7 @@ print_nffs_file_flash(char *flash_area, size_t size)
                    nda->nda_gc_seq,
                    nda->nda_ver,
                    nda->nda_id,
-                   nda->nda_ver != NFFS_AREA_VER ? " (V0)" : "",
+                   nda->nda_ver == NFFS_AREA_VER_0 ? " (V0)" : "",
                    nad_cnt == file_scratch_idx ? " (Scratch)" : "");
 
             if (nffs_version == 0) {
@@ -586,7 +588,7 @@ print_nffs_file_flash(char *flash_area, size_t size)
             while (off + objsz < area_descs[nad_cnt].nad_length) {
                 if (nffs_version == 0) {
                     off += print_nffs_flash_V0object(&area_descs[nad_cnt], off);
-                } else if (nffs_version == NFFS_AREA_VER) {
+                } else {
                     off += print_nffs_flash_object(&area_descs[nad_cnt], off);
                 }
             }
@@ -615,13 +617,15 @@ printfs(void)
 static void
 usage(int rc)
 {
-    printf("%s [-v][-c]|[-d dir][-s][-f flash_file]\n", progname);
+    printf("%s [-v][-c]|[-d dir][-s][-f flash_file]|[-d dir -r romfs_file]\n",
+      progname);
     printf("  Tool for operating on simulator flash image file\n");
     printf("   -c: ...\n");
     printf("   -v: verbose\n");
     printf("   -d: use dir as root for NFFS portion and create flash image\n");
     printf("   -f: flash_file is the name of the flash image file\n");
     printf("   -s: use flash area layout in flash image file\n");
+    printf("   -r: with -d, write a read-only romfs image of dir instead\n");
     exit(rc);
 }
 
@@ -639,7 +643,7 @@ main(int argc, char **argv)
     progname = argv[0];
     force_version = -1;
 
-    while ((ch = getopt(argc, argv, "c:d:f:sv01")) != -1) {
+    while ((ch = getopt(argc, argv, "c:d:f:r:sv01")) != -1) {
         switch (ch) {
         case 'c':
             fp = fopen(optarg, "rb");
@@ -656,6 +660,9 @@ main(int argc, char **argv)
         case 'f':
             native_flash_file = optarg;
             break;
+        case 'r':
+            romfs_out = optarg;
+            break;
         case 'v':
             print_verbose++;
             break;
@@ -671,6 +678,13 @@ main(int argc, char **argv)
         }
     }
 
+    if (romfs_out) {
+        if (!copy_in_dir) {
+            usage(1);
+        }
+        return romfs_gen(copy_in_dir, romfs_out) ? 1 : 0;
+    }
+
     os_init();
     if (standalone == 0) {
         rc = flash_area_to_nffs_desc(FLASH_AREA_NFFS, &cnt, area_descs);
@@ -0,0 +1,225 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Builds a romfs image from a directory tree on the host.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <romfs/romfs.h>
+
+struct romfs_gen_node {
+    char *name;
+    int name_len;
+    int is_dir;
+    char *path;
+    uint32_t size;
+    struct romfs_gen_node **kids;
+    int nkids;
+};
+
+static int romfs_gen_cnt;
+
+static int
+romfs_gen_cmp(const void *a, const void *b)
+{
+    const struct romfs_gen_node *na = *(struct romfs_gen_node **)a;
+    const struct romfs_gen_node *nb = *(struct romfs_gen_node **)b;
+    int len;
+    int rc;
+
+    len = na->name_len < nb->name_len ? na->name_len : nb->name_len;
+    rc = memcmp(na->name, nb->name, len);
+    if (rc == 0) {
+        rc = na->name_len - nb->name_len;
+    }
+    return rc;
+}
+
+static struct romfs_gen_node *
+romfs_gen_scan(const char *path, const char *name)
+{
+    struct romfs_gen_node *node;
+    struct dirent *entry;
+    struct stat st;
+    char sub[1024];
+    DIR *dr;
+
+    if (stat(path, &st)) {
+        perror(path);
+        return NULL;
+    }
+    if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) {
+        return NULL;
+    }
+
+    node = calloc(1, sizeof(*node));
+    assert(node);
+    node->name = strdup(name);
+    node->name_len = strlen(name);
+    node->path = strdup(path);
+    romfs_gen_cnt++;
+
+    if (!S_ISDIR(st.st_mode)) {
+        node->size = st.st_size;
+        return node;
+    }
+
+    node->is_dir = 1;
+    dr = opendir(path);
+    if (!dr) {
+        perror(path);
+        return node;
+    }
+    while ((entry = readdir(dr))) {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) {
+            continue;
+        }
+        snprintf(sub, sizeof(sub), "%s/%s", path, entry->d_name);
+        node->kids = realloc(node->kids,
+          (node->nkids + 1) * sizeof(node->kids[0]));
+        assert(node->kids);
+        node->kids[node->nkids] = romfs_gen_scan(sub, entry->d_name);
+        if (node->kids[node->nkids]) {
+            node->nkids++;
+        }
+    }
+    closedir(dr);
+
+    qsort(node->kids, node->nkids, sizeof(node->kids[0]), romfs_gen_cmp);
+    return node;
+}
+
+static uint32_t
+romfs_gen_align(uint32_t off)
+{
+    return (off + 3) & ~3;
+}
+
+/*
+ * Writes the image for the tree at src_dir to out_file.  Entries are laid
+ * out breadth-first, so that the children of each directory are
+ * consecutive; then come the names, then the file data, each file 4-byte
+ * aligned.
+ */
+int
+romfs_gen(const char *src_dir, const char *out_file)
+{
+    struct romfs_gen_node **order;
+    struct romfs_gen_node *node;
+    struct romfs_hdr *hdr;
+    struct romfs_ent *ent;
+    uint32_t name_off;
+    uint32_t data_off;
+    uint32_t next;
+    uint8_t *img;
+    FILE *fp;
+    int i;
+    int j;
+
+    romfs_gen_cnt = 0;
+    node = romfs_gen_scan(src_dir, "");
+    if (!node || !node->is_dir) {
+        fprintf(stderr, "%s: not a directory\n", src_dir);
+        return -1;
+    }
+
+    order = calloc(romfs_gen_cnt, sizeof(order[0]));
+    assert(order);
+    order[0] = node;
+    next = 1;
+    name_off = sizeof(*hdr) + romfs_gen_cnt * sizeof(*ent);
+    data_off = name_off;
+    for (i = 0; i < romfs_gen_cnt; i++) {
+        node = order[i];
+        data_off += node->name_len;
+        for (j = 0; j < node->nkids; j++) {
+            order[next++] = node->kids[j];
+        }
+    }
+    assert(next == romfs_gen_cnt);
+    for (i = 0; i < romfs_gen_cnt; i++) {
+        if (!order[i]->is_dir) {
+            data_off = romfs_gen_align(data_off) + order[i]->size;
+        }
+    }
+
+    img = calloc(1, romfs_gen_align(data_off));
+    assert(img);
+    hdr = (struct romfs_hdr *)img;
+    hdr->rh_magic = ROMFS_MAGIC;
+    hdr->rh_version = ROMFS_VERSION;
+    hdr->rh_num_ents = romfs_gen_cnt;
+    hdr->rh_img_len = romfs_gen_align(data_off);
+
+    ent = (struct romfs_ent *)(hdr + 1);
+    data_off = name_off;
+    for (i = 0; i < romfs_gen_cnt; i++) {
+        data_off += order[i]->name_len;
+    }
+    next = 1;
+    for (i = 0; i < romfs_gen_cnt; i++, ent++) {
+        node = order[i];
+        ent->re_name_off = name_off;
+        ent->re_name_len = node->name_len;
+        memcpy(img + name_off, node->name, node->name_len);
+        name_off += node->name_len;
+
+        if (node->is_dir) {
+            ent->re_flags = ROMFS_ENT_DIR;
+            ent->re_off = node->nkids ? next : 0;
+            ent->re_len = node->nkids;
+            next += node->nkids;
+        } else {
+            data_off = romfs_gen_align(data_off);
+            ent->re_off = data_off;
+            ent->re_len = node->size;
+            fp = fopen(node->path, "rb");
+            if (!fp || fread(img + data_off, 1, node->size, fp) != node->size) {
+                perror(node->path);
+                return -1;
+            }
+            fclose(fp);
+            data_off += node->size;
+        }
+    }
+
+    fp = fopen(out_file, "wb");
+    if (!fp) {
+        perror(out_file);
+        return -1;
+    }
+    if (fwrite(img, 1, hdr->rh_img_len, fp) != hdr->rh_img_len) {
+        perror(out_file);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    printf("romfs image %s: %d entries, %u bytes\n", out_file,
+      romfs_gen_cnt, (unsigned)hdr->rh_img_len);
+    free(img);
+    return 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "console/console.h"
+#include <string.h>
+#include <assert.h>
+#if defined(__ARM_ARCH_6M__)
+#include <mcu/cortex_m0.h>
+#else
+#include <mcu/cortex_m4.h>
+#endif
+
+#if defined(__ARM_ARCH_6M__)
+/*
+ * No DWT cycle counter on M0; SysTick is run as a free-running
+ * down-counter instead, so the OS tick must come from another timer
+ * (the RTC on nrf51).
+ */
+#define BENCH_CYCLES()              (SysTick->VAL)
+#define BENCH_ELAPSED(__s, __e)     (((__s) - (__e)) & SysTick_LOAD_RELOAD_Msk)
+#else
+#define BENCH_CYCLES()              (DWT->CYCCNT)
+#define BENCH_ELAPSED(__s, __e)     ((__e) - (__s))
+#endif
+
+#define BENCH_ITERS                 (64)
+#define BENCH_BUF_SZ                (1024 + 4)
+
+#define BENCH_TASK_PRIO             (1)
+#define BENCH_STACK_SIZE            OS_STACK_ALIGN(256)
+struct os_task bench_task;
+os_stack_t bench_stack[BENCH_STACK_SIZE];
+
+static uint32_t bench_src[BENCH_BUF_SZ / 4];
+static uint32_t bench_dst[BENCH_BUF_SZ / 4];
+
+static const int bench_sizes[] = { 4, 16, 64, 256, 1024 };
+
+/*
+ * Called through pointers, so that compiler can't replace the calls with
+ * inline code of its own.
+ */
+static void *(*volatile bench_memcpy)(void *, const void *, size_t) = memcpy;
+static void *(*volatile bench_memset)(void *, int, size_t) = memset;
+static int (*volatile bench_memcmp)(const void *, const void *, size_t) =
+    memcmp;
+
+static void
+bench_timer_init(void)
+{
+#if defined(__ARM_ARCH_6M__)
+    SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#else
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/*
+ * Runs one function BENCH_ITERS times, returns cycles per call.
+ * op: 0 = memcpy, 1 = memset, 2 = memcmp (of identical buffers, so
+ * the whole length gets compared).
+ */
+static uint32_t
+bench_run(int op, int len, int src_off, int dst_off)
+{
+    uint8_t *src = (uint8_t *)bench_src + src_off;
+    uint8_t *dst = (uint8_t *)bench_dst + dst_off;
+    uint32_t start;
+    uint32_t empty;
+    int i;
+
+    start = BENCH_CYCLES();
+    for (i = 0; i < BENCH_ITERS; i++) {
+        __asm__ volatile ("" : : : "memory");
+    }
+    empty = BENCH_ELAPSED(start, BENCH_CYCLES());
+
+    if (op == 2) {
+        memcpy(dst, src, len);
+    }
+    start = BENCH_CYCLES();
+    for (i = 0; i < BENCH_ITERS; i++) {
+        switch (op) {
+        case 0:
+            bench_memcpy(dst, src, len);
+            break;
+        case 1:
+            bench_memset(dst, i, len);
+            break;
+        default:
+            bench_memcmp(dst, src, len);
+            break;
+        }
+    }
+    return (BENCH_ELAPSED(start, BENCH_CYCLES()) - empty) / BENCH_ITERS;
+}
+
+static void
+bench_task_handler(void *arg)
+{
+    static const char *names[] = { "memcpy", "memset", "memcmp" };
+    uint32_t aligned;
+    uint32_t unaligned;
+    int op;
+    int i;
+
+    bench_timer_init();
+    for (i = 0; i < sizeof(bench_src); i++) {
+        ((uint8_t *)bench_src)[i] = i;
+    }
+
+    while (1) {
+        for (op = 0; op < 3; op++) {
+            for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]);
+                 i++) {
+                aligned = bench_run(op, bench_sizes[i], 0, 0);
+                unaligned = bench_run(op, bench_sizes[i], 1, 2);
+
+                /* Results are in hundredths of a byte per cycle. */
+                console_printf("%s %4d: aligned %lu cyc %lu b/c, "
+                  "unaligned %lu cyc %lu b/c\n",
+                  names[op], bench_sizes[i],
+                  (unsigned long)aligned,
+                  (unsigned long)(bench_sizes[i] * 100 / (aligned + 1)),
+                  (unsigned long)unaligned,
+                  (unsigned long)(bench_sizes[i] * 100 / (unaligned + 1)));
+            }
+        }
+        os_time_delay(5 * OS_TICKS_PER_SEC);
+    }
+}
+
+/**
+ * main
+ *
+ * The main function for the project. This function initializes the os,
+ * the console and the benchmark task, then starts the OS. We should not
+ * return from os start.
+ *
+ * @return int NOTE: this function should never return!
+ */
+int
+main(void)
+{
+    int rc;
+
+    os_init();
+
+    rc = console_init(NULL);
+    assert(rc == 0);
+
+    os_task_init(&bench_task, "bench", bench_task_handler, NULL,
+            BENCH_TASK_PRIO, OS_WAIT_FOREVER, bench_stack, BENCH_STACK_SIZE);
+
+    os_start();
+
+    /* os start should never return. If it does, this should be an error */
+    assert(0);
+
+    return rc;
+}
@@ -0,0 +1,424 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "os/os.h"
+#include "bsp/bsp.h"
+#include "hal/hal_cputime.h"
+#include "hal/hal_gpio.h"
+#include "console/console.h"
+#include "shell/shell.h"
+#include "stats/stats.h"
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Kernel latency benchmarks, timed with hal_cputime at 1 MHz so they run
+ * unchanged on any MCU with a cputime driver:
+ *
+ *  - isr_task: a cputime timer interrupt posts an event, until the
+ *    waiting task runs. BENCH_GPIO_PIN is set in the interrupt and
+ *    cleared by the task, so the same interval can be measured on a
+ *    scope at better than cputime resolution. isr_entry is from the
+ *    programmed timer expiry to the start of the interrupt handler.
+ *  - sem_rt: semaphore ping-pong round trip with a lower priority task.
+ *  - mutex: handoff from a lower priority owner to the waiting task.
+ *  - callout: deviation of the interval between 1 tick callouts from
+ *    the nominal tick length.
+ *
+ * Results are printed every round, and kept in the "osbench" stats group
+ * ("stat osbench" on the shell). Times are in microseconds, except for
+ * the averages which are in nanoseconds; histograms have power of two
+ * buckets.
+ */
+
+#ifndef BENCH_GPIO_PIN
+#define BENCH_GPIO_PIN              LED_BLINK_PIN
+#endif
+
+#define BENCH_ITERS                 (1000)
+#define BENCH_CALLOUT_ITERS         (OS_TICKS_PER_SEC)
+
+/* Bench task: runs the benchmarks and takes the latency measurements. */
+#define BENCH_TASK_PRIO             (1)
+#define BENCH_STACK_SIZE            OS_STACK_ALIGN(256)
+static struct os_task bench_task;
+static os_stack_t bench_stack[BENCH_STACK_SIZE];
+
+/* Peer task: the other end of the semaphore and mutex handoffs. */
+#define PEER_TASK_PRIO              (2)
+#define PEER_STACK_SIZE             OS_STACK_ALIGN(128)
+static struct os_task peer_task;
+static os_stack_t peer_stack[PEER_STACK_SIZE];
+
+#define SHELL_TASK_PRIO             (3)
+#define SHELL_MAX_INPUT_LEN         (128)
+#define SHELL_TASK_STACK_SIZE       OS_STACK_ALIGN(384)
+static os_stack_t shell_stack[SHELL_TASK_STACK_SIZE];
+
+STATS_SECT_START(osbench_stats)
+    STATS_SECT_ENTRY(rounds)
+    STATS_SECT_ENTRY(isr_entry_max)
+    STATS_SECT_ENTRY(isr_task_min)
+    STATS_SECT_ENTRY(isr_task_avg_ns)
+    STATS_SECT_ENTRY(isr_task_max)
+    STATS_SECT_HIST(isr_task_hist)
+    STATS_SECT_ENTRY(sem_rt_min)
+    STATS_SECT_ENTRY(sem_rt_avg_ns)
+    STATS_SECT_ENTRY(sem_rt_max)
+    STATS_SECT_ENTRY(mutex_min)
+    STATS_SECT_ENTRY(mutex_avg_ns)
+    STATS_SECT_ENTRY(mutex_max)
+    STATS_SECT_HIST(mutex_hist)
+    STATS_SECT_ENTRY(callout_jitter_max)
+    STATS_SECT_HIST(callout_jitter_hist)
+STATS_SECT_END
+
+static STATS_SECT_DECL(osbench_stats) osbench_stats;
+
+STATS_NAME_START(osbench_stats)
+    STATS_NAME(osbench_stats, rounds)
+    STATS_NAME(osbench_stats, isr_entry_max)
+    STATS_NAME(osbench_stats, isr_task_min)
+    STATS_NAME(osbench_stats, isr_task_avg_ns)
+    STATS_NAME(osbench_stats, isr_task_max)
+    STATS_NAME_HIST(osbench_stats, isr_task_hist)
+    STATS_NAME(osbench_stats, sem_rt_min)
+    STATS_NAME(osbench_stats, sem_rt_avg_ns)
+    STATS_NAME(osbench_stats, sem_rt_max)
+    STATS_NAME(osbench_stats, mutex_min)
+    STATS_NAME(osbench_stats, mutex_avg_ns)
+    STATS_NAME(osbench_stats, mutex_max)
+    STATS_NAME_HIST(osbench_stats, mutex_hist)
+    STATS_NAME(osbench_stats, callout_jitter_max)
+    STATS_NAME_HIST(osbench_stats, callout_jitter_hist)
+STATS_NAME_END(osbench_stats)
+
+#define OSBENCH_GET(__var)          (osbench_stats.STATS_SECT_VAR(__var))
+#define OSBENCH_SET(__var, __val)   (OSBENCH_GET(__var) = (__val))
+
+/* Min/max/total of one round of samples. */
+struct bench_acc {
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;
+};
+
+static struct os_eventq bench_evq;
+static struct os_event bench_isr_ev = {
+    .ev_type = OS_EVENT_T_PERUSER,
+};
+static struct cpu_timer bench_timer;
+static volatile uint32_t bench_isr_time;
+static uint32_t bench_isr_entry_max;
+
+static struct os_sem bench_sem;
+static struct os_sem peer_sem;
+static struct os_mutex bench_mutex;
+static volatile uint32_t bench_mutex_time;
+
+#define PEER_CMD_SEM                (1)
+#define PEER_CMD_MUTEX              (2)
+static volatile int peer_cmd;
+
+static struct os_callout_func bench_callout;
+static uint32_t bench_callout_last;
+static int bench_callout_left;
+
+static void
+bench_acc_init(struct bench_acc *acc)
+{
+    acc->min = UINT32_MAX;
+    acc->max = 0;
+    acc->sum = 0;
+}
+
+static void
+bench_acc_add(struct bench_acc *acc, uint32_t val)
+{
+    if (val < acc->min) {
+        acc->min = val;
+    }
+    if (val > acc->max) {
+        acc->max = val;
+    }
+    acc->sum += val;
+}
+
+static uint32_t
+bench_acc_avg_ns(struct bench_acc *acc, int cnt)
+{
+    return (uint32_t)(((uint64_t)acc->sum * 1000) / cnt);
+}
+
+static void
+bench_timer_isr(void *arg)
+{
+    uint32_t now;
+
+    now = cputime_get32();
+    hal_gpio_set(BENCH_GPIO_PIN);
+    if (now - bench_timer.cputime > bench_isr_entry_max) {
+        bench_isr_entry_max = now - bench_timer.cputime;
+    }
+    bench_isr_time = now;
+    os_eventq_put(&bench_evq, &bench_isr_ev);
+}
+
+/*
+ * Interrupt to task. The task is blocked on its event queue when the
+ * timer fires, and the idle task is running.
+ */
+static void
+bench_isr_task(void)
+{
+    struct bench_acc acc;
+    struct os_event *ev;
+    uint32_t t;
+    int i;
+
+    bench_acc_init(&acc);
+    bench_isr_entry_max = 0;
+    for (i = 0; i < BENCH_ITERS; i++) {
+        cputime_timer_start(&bench_timer, cputime_get32() + 100);
+        ev = os_eventq_get(&bench_evq);
+        t = cputime_get32() - bench_isr_time;
+        hal_gpio_clear(BENCH_GPIO_PIN);
+        assert(ev == &bench_isr_ev);
+
+        bench_acc_add(&acc, t);
+        STATS_HIST_ADD(osbench_stats, isr_task_hist, t);
+    }
+
+    OSBENCH_SET(isr_entry_max, bench_isr_entry_max);
+    OSBENCH_SET(isr_task_min, acc.min);
+    OSBENCH_SET(isr_task_avg_ns,
+              bench_acc_avg_ns(&acc, BENCH_ITERS));
+    OSBENCH_SET(isr_task_max, acc.max);
+}
+
+/*
+ * Semaphore ping-pong with the lower priority peer task; each iteration is
+ * two context switches plus a release and pend on each side.
+ */
+static void
+bench_sem_rt(void)
+{
+    struct bench_acc acc;
+    uint32_t start;
+    uint32_t t;
+    int i;
+
+    bench_acc_init(&acc);
+    peer_cmd = PEER_CMD_SEM;
+    for (i = 0; i < BENCH_ITERS; i++) {
+        start = cputime_get32();
+        os_sem_release(&peer_sem);
+        os_sem_pend(&bench_sem, OS_TIMEOUT_NEVER);
+        t = cputime_get32() - start;
+        bench_acc_add(&acc, t);
+    }
+
+    OSBENCH_SET(sem_rt_min, acc.min);
+    OSBENCH_SET(sem_rt_avg_ns,
+              bench_acc_avg_ns(&acc, BENCH_ITERS));
+    OSBENCH_SET(sem_rt_max, acc.max);
+}
+
+/*
+ * Mutex handoff. The peer takes the mutex, the bench task blocks on it
+ * (raising the peer to its priority), and the peer releases it; measured
+ * from just before the release until the bench task owns the mutex.
+ */
+static void
+bench_mutex_handoff(void)
+{
+    struct bench_acc acc;
+    uint32_t t;
+    int i;
+
+    bench_acc_init(&acc);
+    peer_cmd = PEER_CMD_MUTEX;
+    for (i = 0; i < BENCH_ITERS; i++) {
+        /* Peer takes the mutex, and lets us know. */
+        os_sem_release(&peer_sem);
+        os_sem_pend(&bench_sem, OS_TIMEOUT_NEVER);
+
+        os_mutex_pend(&bench_mutex, OS_TIMEOUT_NEVER);
+        t = cputime_get32() - bench_mutex_time;
+        os_mutex_release(&bench_mutex);
+
+        bench_acc_add(&acc, t);
+        STATS_HIST_ADD(osbench_stats, mutex_hist, t);
+    }
+
+    OSBENCH_SET(mutex_min, acc.min);
+    OSBENCH_SET(mutex_avg_ns,
+              bench_acc_avg_ns(&acc, BENCH_ITERS));
+    OSBENCH_SET(mutex_max, acc.max);
+}
+
+static void
+peer_task_handler(void *arg)
+{
+    while (1) {
+        os_sem_pend(&peer_sem, OS_TIMEOUT_NEVER);
+        if (peer_cmd == PEER_CMD_SEM) {
+            os_sem_release(&bench_sem);
+        } else {
+            os_mutex_pend(&bench_mutex, OS_TIMEOUT_NEVER);
+            os_sem_release(&bench_sem);
+
+            /* Runs again once the bench task blocks on the mutex. */
+            bench_mutex_time = cputime_get32();
+            os_mutex_release(&bench_mutex);
+        }
+    }
+}
+
+static void
+bench_callout_cb(void *arg)
+{
+    uint32_t now;
+    uint32_t nominal;
+    uint32_t jitter;
+
+    now = cputime_get32();
+    nominal = cputime_usecs_to_ticks(1000000 / OS_TICKS_PER_SEC);
+    if (bench_callout_last) {
+        jitter = now - bench_callout_last;
+        jitter = jitter > nominal ? jitter - nominal : nominal - jitter;
+        STATS_HIST_ADD(osbench_stats, callout_jitter_hist, jitter);
+        if (jitter > OSBENCH_GET(callout_jitter_max)) {
+            OSBENCH_SET(callout_jitter_max, jitter);
+        }
+    }
+    bench_callout_last = now;
+    if (--bench_callout_left > 0) {
+        os_callout_reset(&bench_callout.cf_c, 1);
+    }
+}
+
+/* Callouts fire from the tick; time a second's worth of 1 tick callouts. */
+static void
+bench_callout_jitter(void)
+{
+    struct os_callout_func *cf;
+    struct os_event *ev;
+
+    OSBENCH_SET(callout_jitter_max, 0);
+    bench_callout_last = 0;
+    bench_callout_left = BENCH_CALLOUT_ITERS;
+    os_callout_reset(&bench_callout.cf_c, 1);
+    while (bench_callout_left > 0) {
+        ev = os_eventq_get(&bench_evq);
+        assert(ev->ev_type == OS_EVENT_T_TIMER);
+        cf = (struct os_callout_func *)ev;
+        cf->cf_func(CF_ARG(cf));
+    }
+}
+
+static void
+bench_task_handler(void *arg)
+{
+    while (1) {
+        bench_isr_task();
+        bench_sem_rt();
+        bench_mutex_handoff();
+        bench_callout_jitter();
+        STATS_INC(osbench_stats, rounds);
+
+        console_printf("isr_task min=%lu avg=%lu.%03lu max=%lu us "
+                       "(entry max=%lu)\n",
+          (unsigned long)OSBENCH_GET(isr_task_min),
+          (unsigned long)OSBENCH_GET(isr_task_avg_ns) / 1000,
+          (unsigned long)OSBENCH_GET(isr_task_avg_ns) % 1000,
+          (unsigned long)OSBENCH_GET(isr_task_max),
+          (unsigned long)OSBENCH_GET(isr_entry_max));
+        console_printf("sem_rt min=%lu avg=%lu.%03lu max=%lu us\n",
+          (unsigned long)OSBENCH_GET(sem_rt_min),
+          (unsigned long)OSBENCH_GET(sem_rt_avg_ns) / 1000,
+          (unsigned long)OSBENCH_GET(sem_rt_avg_ns) % 1000,
+          (unsigned long)OSBENCH_GET(sem_rt_max));
+        console_printf("mutex min=%lu avg=%lu.%03lu max=%lu us\n",
+          (unsigned long)OSBENCH_GET(mutex_min),
+          (unsigned long)OSBENCH_GET(mutex_avg_ns) / 1000,
+          (unsigned long)OSBENCH_GET(mutex_avg_ns) % 1000,
+          (unsigned long)OSBENCH_GET(mutex_max));
+        console_printf("callout jitter max=%lu us\n",
+          (unsigned long)OSBENCH_GET(callout_jitter_max));
+
+        os_time_delay(OS_TICKS_PER_SEC);
+    }
+}
+
+/**
+ * main
+ *
+ * The main function for the project. This function initializes the os,
+ * the console and the benchmark tasks, then starts the OS. We should not
+ * return from os start.
+ *
+ * @return int NOTE: this function should never return!
+ */
+int
+main(void)
+{
+    int rc;
+
+    os_init();
+
+    rc = cputime_init(1000000);
+    assert(rc == 0);
+
+    rc = hal_gpio_init_out(BENCH_GPIO_PIN, 0);
+    assert(rc == 0);
+
+    shell_task_init(SHELL_TASK_PRIO, shell_stack, SHELL_TASK_STACK_SIZE,
+                    SHELL_MAX_INPUT_LEN);
+
+    stats_module_init();
+
+    rc = stats_init_and_reg(STATS_HDR(osbench_stats),
+                            STATS_SIZE_INIT_PARMS(osbench_stats,
+                                                  STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(osbench_stats),
+                            "osbench");
+    assert(rc == 0);
+
+    os_eventq_init(&bench_evq);
+    cputime_timer_init(&bench_timer, bench_timer_isr, NULL);
+    os_callout_func_init(&bench_callout, &bench_evq, bench_callout_cb, NULL);
+
+    os_sem_init(&bench_sem, 0);
+    os_sem_init(&peer_sem, 0);
+    os_mutex_init(&bench_mutex);
+
+    os_task_init(&bench_task, "bench", bench_task_handler, NULL,
+            BENCH_TASK_PRIO, OS_WAIT_FOREVER, bench_stack, BENCH_STACK_SIZE);
+
+    os_task_init(&peer_task, "peer", peer_task_handler, NULL,
+            PEER_TASK_PRIO, OS_WAIT_FOREVER, peer_stack, PEER_STACK_SIZE);
+
+    os_start();
+
+    /* os start should never return. If it does, this should be an error */
+    assert(0);
+
+    return rc;
+}
@@ -20,6 +20,7 @@
 #include <bsp/bsp.h>
 #include <hal/hal_gpio.h>
 #include <hal/hal_flash.h>
+#include <hal/hal_cputime.h>
 #include <console/console.h>
 #include <shell/shell.h>
 #include <log/log.h>
@@ -48,6 +49,7 @@
 #include <reboot/log_reboot.h>
 #include <os/os_time.h>
 #include <id/id.h>
+#include <bootinit/bootinit.h>
 
 #ifdef ARCH_sim
 #include <mcu/mcu_sim.h>
@@ -135,6 +137,9 @@ static int test_conf_commit(void);
 static int test_conf_export(void (*export_func)(char *name, char *val),
   enum conf_export_tgt tgt);
 
+static struct bootinit_deferred flash_test_deferred =
+    BOOTINIT_DEFERRED("flash_test", flash_test_init, 10);
+
 static struct conf_handler test_conf_handler = {
     .ch_name = "test",
     .ch_get = test_conf_get,
@@ -212,6 +217,7 @@ task1_handler(void *arg)
     } else {
         console_printf("\nSlinky\n");
     }
+    bootinit_ready();
 
     while (1) {
         t = os_sched_get_current_task();
@@ -239,6 +245,9 @@ task2_handler(void *arg)
 {
     struct os_task *t;
 
+    /* Lowest priority task; finish the deferred parts of startup. */
+    bootinit_defer_run();
+
     while (1) {
         /* just for debug; task 2 should be the running task */
         t = os_sched_get_current_task();
@@ -358,6 +367,10 @@ main(int argc, char **argv)
     mcu_sim_parse_args(argc, argv);
 #endif
 
+    /* Boot timeline is timestamped with cputime. */
+    rc = cputime_init(1000000);
+    assert(rc == 0);
+
     conf_init();
     rc = conf_register(&test_conf_handler);
     assert(rc == 0);
@@ -365,9 +378,9 @@ main(int argc, char **argv)
     log_init();
     cbmem_init(&cbmem, cbmem_buf, MAX_CBMEM_BUF);
     log_cbmem_handler_init(&log_cbmem_handler, &cbmem);
-    log_register("log", &my_log, &log_cbmem_handler);
+    BOOTINIT_STEP("log", log_register("log", &my_log, &log_cbmem_handler));
 
-    os_init();
+    BOOTINIT_STEP("os_init", os_init());
 
     rc = os_mempool_init(&default_mbuf_mpool, DEFAULT_MBUF_MPOOL_NBUFS,
             DEFAULT_MBUF_MPOOL_BUF_LEN, default_mbuf_mpool_data,
@@ -385,9 +398,9 @@ main(int argc, char **argv)
     assert(rc == 0);
 
 #ifdef NFFS_PRESENT
-    setup_for_nffs();
+    BOOTINIT_STEP("nffs", setup_for_nffs());
 #elif FCB_PRESENT
-    setup_for_fcb();
+    BOOTINIT_STEP("fcb", setup_for_fcb());
 #endif
 
     id_init();
@@ -397,6 +410,7 @@ main(int argc, char **argv)
 
     nmgr_task_init(NEWTMGR_TASK_PRIO, newtmgr_stack, NEWTMGR_TASK_STACK_SIZE);
     imgmgr_module_init();
+    bootinit_module_init();
 
     stats_module_init();
 
@@ -406,11 +420,12 @@ main(int argc, char **argv)
 
     stats_register("gpio_toggle", STATS_HDR(g_stats_gpio_toggle));
 
-    flash_test_init();
+    /* Flash test commands are not needed to start; add them later. */
+    bootinit_defer(&flash_test_deferred);
 
     reboot_init_handler(LOG_TYPE_STORAGE, 10);
 
-    conf_load();
+    BOOTINIT_STEP("conf_load", conf_load());
 
     log_reboot(HARD_REBOOT);
 
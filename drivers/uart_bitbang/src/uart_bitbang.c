@@ -33,18 +33,30 @@
 
 /*
  * Async UART as a bitbanger.
- * Cannot run very fast, as it relies on cputimer to time sampling and
- * bit tx start times.
+ * TX relies on cputimer to time bit start times.
+ * RX timestamps edges of the RX line in the GPIO interrupt, and decodes
+ * a byte from those once it is complete. This way sampling accuracy does
+ * not depend on how promptly timer callbacks run.
  */
+#define UART_BITBANG_EDGES      32      /* must be power of 2 */
+
+struct uart_bitbang_edge {
+    uint32_t time;              /* cputime when edge was seen */
+    uint8_t level;              /* pin level at that time */
+};
+
 struct uart_bitbang {
     int ub_bittime;             /* number of cputimer ticks per bit */
     struct {
         int pin;                /* RX pin */
         struct cpu_timer timer;
         uint32_t start;         /* cputime when byte rx started */
-        uint8_t byte;           /* receiving this byte */
-        uint8_t bits;           /* how many bits we've seen */
-        int false_irq;
+        uint8_t byte;           /* received byte */
+        uint8_t active;         /* start bit seen, waiting for stop */
+        uint8_t head;           /* edges written by GPIO irq */
+        uint8_t tail;           /* edges consumed by decoder */
+        struct uart_bitbang_edge edges[UART_BITBANG_EDGES];
+        int overflow;           /* edges dropped due to full buffer */
     } ub_rx;
     struct {
         int pin;                /* TX pin */
@@ -114,65 +126,123 @@ uart_bitbang_tx_timer(void *arg)
     cputime_timer_start(&ub->ub_tx.timer, next);
 }
 
+#define UART_BITBANG_EDGE_INC(idx)  (((idx) + 1) & (UART_BITBANG_EDGES - 1))
+
+/*
+ * Look for a falling edge among the logged ones, and start decoding a byte
+ * from there. Edges before it are leftovers from previous byte, or noise.
+ */
 static void
-uart_bitbang_rx_timer(void *arg)
+uart_bitbang_rx_sync(struct uart_bitbang *ub)
 {
-    struct uart_bitbang *ub = (struct uart_bitbang *)arg;
-    int val;
+    struct uart_bitbang_edge *e;
 
-    val = hal_gpio_read(ub->ub_rx.pin);
+    while (ub->ub_rx.tail != ub->ub_rx.head) {
+        e = &ub->ub_rx.edges[ub->ub_rx.tail];
+        ub->ub_rx.tail = UART_BITBANG_EDGE_INC(ub->ub_rx.tail);
+        if (e->level == 0) {
+            ub->ub_rx.start = e->time;
+            ub->ub_rx.active = 1;
 
-    if (val) {
-        ub->ub_rx.byte = 0x80 | (ub->ub_rx.byte >> 1);
-    } else {
-        ub->ub_rx.byte = (ub->ub_rx.byte >> 1);
-    }
-    if (ub->ub_rx.bits == 7) {
-        val = ub->ub_rx_func(ub->ub_func_arg, ub->ub_rx.byte);
-        if (val) {
-            ub->ub_rx_stall = 1;
-        } else {
             /*
-             * Re-enable GPIO IRQ after we've sampled last bit. STOP bit
-             * is ignored.
+             * Decode when we're in the middle of STOP bit.
              */
-            hal_gpio_irq_enable(ub->ub_rx.pin);
+            cputime_timer_start(&ub->ub_rx.timer, e->time +
+              (ub->ub_bittime * 9) + (ub->ub_bittime >> 1));
+            return;
         }
-    } else {
-        ub->ub_rx.bits++;
-        cputime_timer_start(&ub->ub_rx.timer,
-          ub->ub_rx.start + (ub->ub_bittime * (ub->ub_rx.bits + 1)) +
-          (ub->ub_bittime >> 1));
     }
 }
 
 /*
- * Byte RX starts when we get transition from high to low.
- * We disable RX irq after we've seen start until end of RX of one byte.
+ * Consume edges up to given time. Returns the line level at that time.
+ */
+static int
+uart_bitbang_rx_level(struct uart_bitbang *ub, uint32_t time, int level)
+{
+    struct uart_bitbang_edge *e;
+
+    while (ub->ub_rx.tail != ub->ub_rx.head) {
+        e = &ub->ub_rx.edges[ub->ub_rx.tail];
+        if ((int32_t)(e->time - time) > 0) {
+            break;
+        }
+        level = e->level;
+        ub->ub_rx.tail = UART_BITBANG_EDGE_INC(ub->ub_rx.tail);
+    }
+    return level;
+}
+
+/*
+ * Byte is complete. Data bits are taken to be the line level in the middle
+ * of each bit, which is the level after the last edge before that. STOP
+ * bit is ignored.
  */
 static void
-uart_bitbang_isr(void *arg)
+uart_bitbang_rx_timer(void *arg)
 {
     struct uart_bitbang *ub = (struct uart_bitbang *)arg;
     uint32_t time;
+    int level;
+    int i;
+    int rc;
 
-    time = cputime_get32();
-    if (ub->ub_rx.start - time < (9 * ub->ub_bittime)) {
-        ++ub->ub_rx.false_irq;
+    level = 0;
+    ub->ub_rx.byte = 0;
+    time = ub->ub_rx.start + ub->ub_bittime + (ub->ub_bittime >> 1);
+    for (i = 0; i < 8; i++) {
+        level = uart_bitbang_rx_level(ub, time, level);
+        if (level) {
+            ub->ub_rx.byte |= 1 << i;
+        }
+        time += ub->ub_bittime;
+    }
+    uart_bitbang_rx_level(ub, time, level);
+    ub->ub_rx.active = 0;
+
+    rc = ub->ub_rx_func(ub->ub_func_arg, ub->ub_rx.byte);
+    if (rc) {
+        /*
+         * Stop listening until upper layer takes this byte.
+         */
+        ub->ub_rx_stall = 1;
+        hal_gpio_irq_disable(ub->ub_rx.pin);
+        ub->ub_rx.tail = ub->ub_rx.head;
         return;
     }
-    ub->ub_rx.start = time;
-    ub->ub_rx.byte = 0;
-    ub->ub_rx.bits = 0;
 
     /*
-     * We try to sample in the middle of a bit. First sample is taken
-     * 1.5 bittimes after beginning of start bit.
+     * Next byte might have started already, if we got to run late.
      */
-    cputime_timer_start(&ub->ub_rx.timer, time +
-      ub->ub_bittime + (ub->ub_bittime >> 1));
+    uart_bitbang_rx_sync(ub);
+}
 
-    hal_gpio_irq_disable(ub->ub_rx.pin);
+/*
+ * Log time and level of every edge of RX line. Decoding starts from the
+ * first falling edge, which is the START bit.
+ */
+static void
+uart_bitbang_isr(void *arg)
+{
+    struct uart_bitbang *ub = (struct uart_bitbang *)arg;
+    struct uart_bitbang_edge *e;
+    uint32_t time;
+    uint8_t next;
+
+    time = cputime_get32();
+    next = UART_BITBANG_EDGE_INC(ub->ub_rx.head);
+    if (next == ub->ub_rx.tail) {
+        ++ub->ub_rx.overflow;
+        return;
+    }
+    e = &ub->ub_rx.edges[ub->ub_rx.head];
+    e->time = time;
+    e->level = hal_gpio_read(ub->ub_rx.pin);
+    ub->ub_rx.head = next;
+
+    if (!ub->ub_rx.active) {
+        uart_bitbang_rx_sync(ub);
+    }
 }
 
 void
@@ -240,6 +310,7 @@ uart_bitbang_start_rx(int port)
         if (rc == 0) {
             OS_ENTER_CRITICAL(sr);
             ub->ub_rx_stall = 0;
+            ub->ub_rx.tail = ub->ub_rx.head;
             OS_EXIT_CRITICAL(sr);
 
             /*
@@ -284,7 +355,11 @@ uart_bitbang_config(int port, int32_t baudrate, uint8_t databits,
 
     assert(ub->ub_rx.pin != ub->ub_tx.pin); /* make sure it's initialized */
 
-    if (baudrate > 19200) {
+    /*
+     * Limited by how quickly edge interrupts are taken; an edge must be
+     * logged before the next one comes.
+     */
+    if (baudrate > 38400) {
         return -1;
     }
     ub->ub_bittime = ub->ub_cputimer_freq / baudrate;
@@ -296,8 +371,11 @@ uart_bitbang_config(int port, int32_t baudrate, uint8_t databits,
         return -1;
     }
 
+    ub->ub_rx.active = 0;
+    ub->ub_rx.head = 0;
+    ub->ub_rx.tail = 0;
     if (hal_gpio_irq_init(ub->ub_rx.pin, uart_bitbang_isr, ub,
-        GPIO_TRIG_FALLING, GPIO_PULL_UP)) {
+        GPIO_TRIG_BOTH, GPIO_PULL_UP)) {
         return -1;
     }
     hal_gpio_irq_enable(ub->ub_rx.pin);
@@ -318,6 +396,7 @@ uart_bitbang_close(int port)
     ub->ub_open = 0;
     ub->ub_txing = 0;
     ub->ub_rx_stall = 0;
+    ub->ub_rx.active = 0;
     cputime_timer_stop(&ub->ub_tx.timer);
     cputime_timer_stop(&ub->ub_rx.timer);
     OS_EXIT_CRITICAL(sr);
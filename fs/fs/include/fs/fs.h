@@ -29,14 +29,59 @@
 struct fs_file;
 struct fs_dir;
 struct fs_dirent;
+struct os_mbuf;
+
+/*
+ * One buffer in a scatter / gather request.
+ */
+struct fs_iovec {
+    void *fi_base;
+    uint32_t fi_len;
+};
+
+/*
+ * Directory entry returned by fs_readdir_batch().  Names longer than
+ * FS_DIRENT_INFO_NAME_MAX are truncated; fdi_name_len is the full length.
+ */
+#ifndef FS_DIRENT_INFO_NAME_MAX
+#define FS_DIRENT_INFO_NAME_MAX 32
+#endif
+
+struct fs_dirent_info {
+    uint32_t fdi_size;          /* File length; 0 for directories */
+    uint8_t fdi_is_dir;
+    uint8_t fdi_name_len;
+    char fdi_name[FS_DIRENT_INFO_NAME_MAX + 1];
+};
+
+/*
+ * Position within a directory listing.  Records the name of the last entry
+ * returned, so it stays valid while entries are added or removed, and across
+ * fs_closedir() / fs_opendir().  Zero it to start from the first entry.
+ */
+#define FS_CURSOR_NAME_MAX      255
+
+struct fs_dir_cursor {
+    uint32_t fdc_hint;          /* FS specific, speeds up resuming */
+    uint8_t fdc_name_len;       /* 0 if at start of directory */
+    char fdc_name[FS_CURSOR_NAME_MAX];
+};
 
 int fs_open(const char *filename, uint8_t access_flags, struct fs_file **);
 int fs_close(struct fs_file *);
 int fs_read(struct fs_file *, uint32_t len, void *out_data, uint32_t *out_len);
 int fs_write(struct fs_file *, const void *data, int len);
+int fs_readv(struct fs_file *, const struct fs_iovec *iov, int iovcnt,
+  uint32_t *out_len);
+int fs_writev(struct fs_file *, const struct fs_iovec *iov, int iovcnt);
+int fs_read_mbuf(struct fs_file *, uint32_t len, struct os_mbuf *om,
+  uint32_t *out_len);
+int fs_write_mbuf(struct fs_file *, const struct os_mbuf *om);
+int fs_flush(struct fs_file *);
 int fs_seek(struct fs_file *, uint32_t offset);
 uint32_t fs_getpos(const struct fs_file *);
 int fs_filelen(const struct fs_file *, uint32_t *out_len);
+int fs_preallocate(struct fs_file *, uint32_t len);
 
 int fs_unlink(const char *filename);
 int fs_rename(const char *from, const char *to);
@@ -48,6 +93,8 @@ int fs_closedir(struct fs_dir *);
 int fs_dirent_name(const struct fs_dirent *, size_t max_len,
   char *out_name, uint8_t *out_name_len);
 int fs_dirent_is_dir(const struct fs_dirent *);
+int fs_readdir_batch(struct fs_dir *, struct fs_dir_cursor *,
+  struct fs_dirent_info *entries, int max_entries, int *out_cnt);
 
 /*
  * File access flags.
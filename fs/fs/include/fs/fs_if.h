@@ -30,10 +30,12 @@ struct fs_ops {
     int (*f_read)(struct fs_file *file, uint32_t len, void *out_data,
       uint32_t *out_len);
     int (*f_write)(struct fs_file *file, const void *data, int len);
+    int (*f_flush)(struct fs_file *file);
 
     int (*f_seek)(struct fs_file *file, uint32_t offset);
     uint32_t (*f_getpos)(const struct fs_file *file);
     int (*f_filelen)(const struct fs_file *file, uint32_t *out_len);
+    int (*f_preallocate)(struct fs_file *file, uint32_t len);
 
     int (*f_unlink)(const char *filename);
     int (*f_rename)(const char *from, const char *to);
@@ -46,13 +48,36 @@ struct fs_ops {
     int (*f_dirent_name)(const struct fs_dirent *dirent, size_t max_len,
       char *out_name, uint8_t *out_name_len);
     int (*f_dirent_is_dir)(const struct fs_dirent *dirent);
+    int (*f_readdir_batch)(struct fs_dir *dir, struct fs_dir_cursor *cursor,
+      struct fs_dirent_info *entries, int max_entries, int *out_cnt);
 
     const char *f_name;
 };
 
 /*
- * Currently allow only one type of FS, starts at root.
+ * File, directory and directory entry handles of every file system must
+ * start with this.  fs/fs fills it in when handing out the handle, and uses
+ * it to route calls on the handle to the file system which created it.
+ */
+struct fs_hdl {
+    const struct fs_ops *fh_ops;
+};
+
+/*
+ * Registers the root file system.  Paths which are not under a mount point
+ * go to it.
  */
 int fs_register(const struct fs_ops *);
 
+/*
+ * Mounts an additional file system at path prefix, e.g. "/rom".  Paths under
+ * it are passed to the file system with the prefix stripped.  Mount points
+ * are not listed when reading their parent directory.
+ */
+#ifndef FS_MOUNT_MAX
+#define FS_MOUNT_MAX            2
+#endif
+
+int fs_mount(const char *prefix, const struct fs_ops *);
+
 #endif
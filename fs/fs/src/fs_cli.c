@@ -70,6 +70,8 @@ fs_ls_dir(const char *name)
     console_printf("\t%6s %s\n", "dir", name);
 }
 
+#define FS_LS_BATCH     4
+
 static int
 fs_ls_cmd(int argc, char **argv)
 {
@@ -77,10 +79,12 @@ fs_ls_cmd(int argc, char **argv)
     char *path;
     struct fs_file *file;
     struct fs_dir *dir;
-    struct fs_dirent *dirent;
+    struct fs_dir_cursor cursor;
+    struct fs_dirent_info entries[FS_LS_BATCH];
     char name[64];
     int plen;
-    uint8_t namelen;
+    int cnt;
+    int i;
 
     switch (argc) {
     case 1:
@@ -111,24 +115,21 @@ fs_ls_cmd(int argc, char **argv)
 
     rc = fs_opendir(path, &dir);
     if (rc == 0) {
+        memset(&cursor, 0, sizeof(cursor));
         do {
-            rc = fs_readdir(dir, &dirent);
-            if (rc) {
-                break;
-            }
-            if (fs_dirent_name(dirent, sizeof(name) - plen, &name[plen],
-                &namelen)) {
-                break;
-            }
-            rc = fs_open(name, FS_ACCESS_READ, &file);
-            if (rc == 0) {
-                fs_ls_file(name, file);
-                fs_close(file);
-            } else {
-                fs_ls_dir(name);
+            rc = fs_readdir_batch(dir, &cursor, entries, FS_LS_BATCH, &cnt);
+            for (i = 0; i < cnt; i++) {
+                strncpy(&name[plen], entries[i].fdi_name, sizeof(name) - plen);
+                name[sizeof(name) - 1] = '\0';
+                if (entries[i].fdi_is_dir) {
+                    fs_ls_dir(name);
+                } else {
+                    console_printf("\t%6lu %s\n",
+                      (unsigned long)entries[i].fdi_size, name);
+                }
+                file_cnt++;
             }
-            file_cnt++;
-        } while (1);
+        } while (rc == 0);
         fs_closedir(dir);
         goto done;
     }
@@ -23,30 +23,62 @@
 int
 fs_opendir(const char *path, struct fs_dir **out_dir)
 {
-    return fs_root_ops->f_opendir(path, out_dir);
+    const struct fs_ops *ops;
+    int rc;
+
+    ops = fs_ops_for_path(&path);
+    if (!ops) {
+        return FS_EUNINIT;
+    }
+    rc = ops->f_opendir(path, out_dir);
+    if (rc == 0) {
+        FS_HDL_SET(*out_dir, ops);
+    }
+    return rc;
 }
 
 int
 fs_readdir(struct fs_dir *dir, struct fs_dirent **out_dirent)
 {
-    return fs_root_ops->f_readdir(dir, out_dirent);
+    int rc;
+
+    rc = FS_HDL_OPS(dir)->f_readdir(dir, out_dirent);
+    if (rc == 0) {
+        FS_HDL_SET(*out_dirent, FS_HDL_OPS(dir));
+    }
+    return rc;
 }
 
 int
 fs_closedir(struct fs_dir *dir)
 {
-    return fs_root_ops->f_closedir(dir);
+    if (!dir) {
+        return 0;
+    }
+    return FS_HDL_OPS(dir)->f_closedir(dir);
 }
 
 int
 fs_dirent_name(const struct fs_dirent *dirent, size_t max_len,
   char *out_name, uint8_t *out_name_len)
 {
-    return fs_root_ops->f_dirent_name(dirent, max_len, out_name, out_name_len);
+    return FS_HDL_OPS(dirent)->f_dirent_name(dirent, max_len, out_name,
+      out_name_len);
 }
 
 int
 fs_dirent_is_dir(const struct fs_dirent *dirent)
 {
-    return fs_root_ops->f_dirent_is_dir(dirent);
+    return FS_HDL_OPS(dirent)->f_dirent_is_dir(dirent);
+}
+
+int
+fs_readdir_batch(struct fs_dir *dir, struct fs_dir_cursor *cursor,
+  struct fs_dirent_info *entries, int max_entries, int *out_cnt)
+{
+    if (!FS_HDL_OPS(dir)->f_readdir_batch) {
+        return FS_EINVAL;
+    }
+    return FS_HDL_OPS(dir)->f_readdir_batch(dir, cursor, entries, max_entries,
+      out_cnt);
 }
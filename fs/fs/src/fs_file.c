@@ -16,6 +16,7 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <os/os.h>
 #include <fs/fs.h>
 #include <fs/fs_if.h>
 
@@ -24,47 +25,277 @@
 int
 fs_open(const char *filename, uint8_t access_flags, struct fs_file **out_file)
 {
-    return fs_root_ops->f_open(filename, access_flags, out_file);
+    const struct fs_ops *ops;
+    int rc;
+
+    ops = fs_ops_for_path(&filename);
+    if (!ops) {
+        return FS_EUNINIT;
+    }
+    rc = ops->f_open(filename, access_flags, out_file);
+    if (rc == 0) {
+        FS_HDL_SET(*out_file, ops);
+    }
+    return rc;
 }
 
 int
 fs_close(struct fs_file *file)
 {
-    return fs_root_ops->f_close(file);
+    if (!file) {
+        return 0;
+    }
+    return FS_HDL_OPS(file)->f_close(file);
 }
 
 int
 fs_read(struct fs_file *file, uint32_t len, void *out_data, uint32_t *out_len)
 {
-    return fs_root_ops->f_read(file, len, out_data, out_len);
+    return FS_HDL_OPS(file)->f_read(file, len, out_data, out_len);
 }
 
 int
 fs_write(struct fs_file *file, const void *data, int len)
 {
-    return fs_root_ops->f_write(file, data, len);
+    return FS_HDL_OPS(file)->f_write(file, data, len);
+}
+
+/**
+ * Reads from a file into a sequence of buffers.  Each buffer is filled
+ * before the next one is started.  Reading stops early when the end of the
+ * file is reached.
+ *
+ * @param file                  The file to read from.
+ * @param iov                   The buffers to read into.
+ * @param iovcnt                The number of entries in the iov array.
+ * @param out_len               On success, the total number of bytes read
+ *                                  gets written here.  Pass NULL if you
+ *                                  don't care.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+fs_readv(struct fs_file *file, const struct fs_iovec *iov, int iovcnt,
+         uint32_t *out_len)
+{
+    uint32_t total;
+    uint32_t len;
+    int rc;
+    int i;
+
+    total = 0;
+    for (i = 0; i < iovcnt; i++) {
+        rc = FS_HDL_OPS(file)->f_read(file, iov[i].fi_len, iov[i].fi_base,
+                                      &len);
+        if (rc != 0) {
+            goto done;
+        }
+
+        total += len;
+        if (len < iov[i].fi_len) {
+            break;
+        }
+    }
+
+    rc = 0;
+
+done:
+    if (out_len != NULL) {
+        *out_len = total;
+    }
+    return rc;
+}
+
+/**
+ * Writes a sequence of buffers to a file, in order.
+ *
+ * @param file                  The file to write to.
+ * @param iov                   The buffers to write.
+ * @param iovcnt                The number of entries in the iov array.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+fs_writev(struct fs_file *file, const struct fs_iovec *iov, int iovcnt)
+{
+    int rc;
+    int i;
+
+    for (i = 0; i < iovcnt; i++) {
+        rc = FS_HDL_OPS(file)->f_write(file, iov[i].fi_base, iov[i].fi_len);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Reads from a file and appends the data to an mbuf chain.  Data is read
+ * straight into the trailing space of each mbuf.  More mbufs are taken
+ * from the chain's pool as needed.  Any packet header length is updated.
+ *
+ * @param file                  The file to read from.
+ * @param len                   The maximum number of bytes to read.
+ * @param om                    The mbuf chain to append to.
+ * @param out_len               On success, the number of bytes read gets
+ *                                  written here.  Pass NULL if you don't
+ *                                  care.
+ *
+ * @return                      0 on success;
+ *                              FS_ENOMEM if the mbuf pool is exhausted;
+ *                              other nonzero on failure.
+ */
+int
+fs_read_mbuf(struct fs_file *file, uint32_t len, struct os_mbuf *om,
+             uint32_t *out_len)
+{
+    struct os_mbuf *last;
+    struct os_mbuf *new;
+    uint32_t total;
+    uint32_t chunk_len;
+    uint32_t read_len;
+    int rc;
+
+    if (om == NULL) {
+        return FS_EINVAL;
+    }
+
+    last = om;
+    while (SLIST_NEXT(last, om_next) != NULL) {
+        last = SLIST_NEXT(last, om_next);
+    }
+
+    total = 0;
+    while (total < len) {
+        if (OS_MBUF_TRAILINGSPACE(last) == 0) {
+            new = os_mbuf_get(om->om_omp, 0);
+            if (new == NULL) {
+                rc = FS_ENOMEM;
+                goto done;
+            }
+            SLIST_NEXT(last, om_next) = new;
+            last = new;
+        }
+
+        chunk_len = OS_MBUF_TRAILINGSPACE(last);
+        if (chunk_len > len - total) {
+            chunk_len = len - total;
+        }
+
+        rc = FS_HDL_OPS(file)->f_read(file, chunk_len,
+                                 last->om_data + last->om_len, &read_len);
+        if (rc != 0) {
+            goto done;
+        }
+
+        last->om_len += read_len;
+        total += read_len;
+        if (read_len < chunk_len) {
+            break;
+        }
+    }
+
+    rc = 0;
+
+done:
+    if (OS_MBUF_IS_PKTHDR(om)) {
+        OS_MBUF_PKTHDR(om)->omp_len += total;
+    }
+    if (out_len != NULL) {
+        *out_len = total;
+    }
+    return rc;
+}
+
+/**
+ * Writes the contents of an mbuf chain to a file.  Each mbuf's data is
+ * passed to the file system directly.
+ *
+ * @param file                  The file to write to.
+ * @param om                    The mbuf chain to write.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+fs_write_mbuf(struct fs_file *file, const struct os_mbuf *om)
+{
+    int rc;
+
+    for (; om != NULL; om = SLIST_NEXT(om, om_next)) {
+        if (om->om_len == 0) {
+            continue;
+        }
+
+        rc = FS_HDL_OPS(file)->f_write(file, om->om_data, om->om_len);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+int
+fs_flush(struct fs_file *file)
+{
+    if (FS_HDL_OPS(file)->f_flush == NULL) {
+        return 0;
+    }
+    return FS_HDL_OPS(file)->f_flush(file);
 }
 
 int
 fs_seek(struct fs_file *file, uint32_t offset)
 {
-    return fs_root_ops->f_seek(file, offset);
+    return FS_HDL_OPS(file)->f_seek(file, offset);
 }
 
 uint32_t
 fs_getpos(const struct fs_file *file)
 {
-    return fs_root_ops->f_getpos(file);
+    return FS_HDL_OPS(file)->f_getpos(file);
 }
 
 int
 fs_filelen(const struct fs_file *file, uint32_t *out_len)
 {
-    return fs_root_ops->f_filelen(file, out_len);
+    return FS_HDL_OPS(file)->f_filelen(file, out_len);
+}
+
+/**
+ * Sets aside space for the next len bytes written to a file through this
+ * handle, so that filling it in does not stall on the file system making
+ * room.  A new call replaces the previous reservation; a len of 0 releases
+ * it.  The reservation is released when the file is closed.
+ *
+ * @param file                  The file to reserve space for.
+ * @param len                   The number of bytes to reserve.
+ *
+ * @return                      0 on success;
+ *                              FS_EFULL if there is not enough free space;
+ *                              FS_EINVAL if the file system does not
+ *                                  support preallocation;
+ *                              other nonzero on failure.
+ */
+int
+fs_preallocate(struct fs_file *file, uint32_t len)
+{
+    if (!FS_HDL_OPS(file)->f_preallocate) {
+        return FS_EINVAL;
+    }
+    return FS_HDL_OPS(file)->f_preallocate(file, len);
 }
 
 int
 fs_unlink(const char *filename)
 {
-    return fs_root_ops->f_unlink(filename);
+    const struct fs_ops *ops;
+
+    ops = fs_ops_for_path(&filename);
+    if (!ops) {
+        return FS_EUNINIT;
+    }
+    return ops->f_unlink(filename);
 }
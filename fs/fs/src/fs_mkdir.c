@@ -24,11 +24,27 @@
 int
 fs_rename(const char *from, const char *to)
 {
-    return fs_root_ops->f_rename(from, to);
+    const struct fs_ops *ops;
+
+    ops = fs_ops_for_path(&from);
+    if (!ops) {
+        return FS_EUNINIT;
+    }
+    if (fs_ops_for_path(&to) != ops) {
+        /* Cannot move between file systems. */
+        return FS_EINVAL;
+    }
+    return ops->f_rename(from, to);
 }
 
 int
 fs_mkdir(const char *path)
 {
-    return fs_root_ops->f_mkdir(path);
+    const struct fs_ops *ops;
+
+    ops = fs_ops_for_path(&path);
+    if (!ops) {
+        return FS_EUNINIT;
+    }
+    return ops->f_mkdir(path);
 }
@@ -16,12 +16,20 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <string.h>
+
 #include <fs/fs.h>
 #include <fs/fs_if.h>
 #include "fs_priv.h"
 
 const struct fs_ops *fs_root_ops = NULL;
 
+static struct {
+    const char *fm_prefix;
+    uint8_t fm_len;
+    const struct fs_ops *fm_ops;
+} fs_mounts[FS_MOUNT_MAX];
+
 int
 fs_register(const struct fs_ops *fops)
 {
@@ -36,3 +44,60 @@ fs_register(const struct fs_ops *fops)
 
     return FS_EOK;
 }
+
+int
+fs_mount(const char *prefix, const struct fs_ops *fops)
+{
+    int len;
+    int i;
+
+    len = strlen(prefix);
+    while (len > 0 && prefix[len - 1] == '/') {
+        len--;
+    }
+    if (len == 0 || len > UINT8_MAX) {
+        return FS_EINVAL;
+    }
+
+    for (i = 0; i < FS_MOUNT_MAX; i++) {
+        if (fs_mounts[i].fm_ops && fs_mounts[i].fm_len == len &&
+          !memcmp(fs_mounts[i].fm_prefix, prefix, len)) {
+            return FS_EEXIST;
+        }
+    }
+    for (i = 0; i < FS_MOUNT_MAX; i++) {
+        if (!fs_mounts[i].fm_ops) {
+            fs_mounts[i].fm_prefix = prefix;
+            fs_mounts[i].fm_len = len;
+            fs_mounts[i].fm_ops = fops;
+            return FS_EOK;
+        }
+    }
+    return FS_ENOMEM;
+}
+
+/*
+ * Picks the file system for path.  If it is under a mount point, path is
+ * advanced past the prefix.
+ */
+const struct fs_ops *
+fs_ops_for_path(const char **path)
+{
+    const char *p;
+    int len;
+    int i;
+
+    p = *path;
+    for (i = 0; i < FS_MOUNT_MAX; i++) {
+        if (!fs_mounts[i].fm_ops) {
+            continue;
+        }
+        len = fs_mounts[i].fm_len;
+        if (!strncmp(p, fs_mounts[i].fm_prefix, len) &&
+          (p[len] == '/' || p[len] == '\0')) {
+            *path = p[len] ? p + len : "/";
+            return fs_mounts[i].fm_ops;
+        }
+    }
+    return fs_root_ops;
+}
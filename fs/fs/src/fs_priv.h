@@ -22,6 +22,11 @@
 struct fs_ops;
 extern const struct fs_ops *fs_root_ops;
 
+const struct fs_ops *fs_ops_for_path(const char **path);
+
+#define FS_HDL_OPS(hdl)         (((const struct fs_hdl *)(hdl))->fh_ops)
+#define FS_HDL_SET(hdl, ops)    (((struct fs_hdl *)(hdl))->fh_ops = (ops))
+
 #ifdef SHELL_PRESENT
 void fs_cli_init(void);
 #endif /* SHELL_PRESENT */
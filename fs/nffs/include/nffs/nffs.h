@@ -22,6 +22,7 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include "os/os.h"
 
 #define NFFS_FILENAME_MAX_LEN   256  /* Does not require null terminator. */
 #define NFFS_MAX_AREAS          256
@@ -44,6 +45,56 @@ struct nffs_config {
 
     /** Data block cache size; default=64. */
     uint32_t nc_num_cache_blocks;
+
+    /**
+     * Number of data blocks to read ahead when a sequential read misses the
+     * block cache; at most 8; default=4.
+     */
+    uint32_t nc_cache_readahead;
+
+    /**
+     * Whether to write an index checkpoint after each garbage collection
+     * cycle (0/1); default=0.
+     */
+    uint32_t nc_gc_checkpoint;
+
+    /**
+     * Number of areas' worth of free space the background garbage collection
+     * task tries to maintain; 0 disables background collection; default=0.
+     */
+    uint32_t nc_gc_free_areas;
+
+    /**
+     * Maximum number of hash table slots the background garbage collection
+     * task processes per step; default=32.
+     */
+    uint32_t nc_gc_step_slots;
+
+    /**
+     * Size of each open file's write-back buffer, which coalesces small
+     * appends into full-size data blocks; 0 disables write buffering;
+     * default=0.
+     */
+    uint32_t nc_write_buf_size;
+
+    /**
+     * Age after which the background task flushes buffered data, in OS
+     * ticks; default=OS_TICKS_PER_SEC.
+     */
+    uint32_t nc_write_buf_itvl;
+
+    /**
+     * Maximum number of data blocks a single write puts to flash while
+     * holding the nffs lock.  Longer writes release the lock in between, so
+     * that operations on other files get a turn; default=4.
+     */
+    uint32_t nc_write_lock_blocks;
+
+    /**
+     * Delay between runs of the background task, in OS ticks;
+     * default=OS_TICKS_PER_SEC / 10.
+     */
+    uint32_t nc_task_itvl;
 };
 
 extern struct nffs_config nffs_config;
@@ -54,8 +105,22 @@ struct nffs_area_desc {
     uint8_t nad_flash_id;   /* Logical flash id */
 };
 
+/*
+ * A run of file data which can be read in place, see nffs_file_mmap().
+ */
+struct nffs_mmap_seg {
+    const void *nms_data;
+    uint32_t nms_len;
+};
+
+struct fs_file;
+
 int nffs_init(void);
 int nffs_detect(const struct nffs_area_desc *area_descs);
 int nffs_format(const struct nffs_area_desc *area_descs);
+int nffs_checkpoint(void);
+int nffs_file_mmap(struct fs_file *file, uint32_t offset,
+                   struct nffs_mmap_seg *segs, int max_segs, int *out_cnt);
+int nffs_task_init(uint8_t prio, os_stack_t *stack, uint16_t stack_size);
 
 #endif
@@ -22,4 +22,9 @@
 
 int nffs_test_all(void);
 
+/* Areas used by nffs_bench_all(); NULL picks from the flash map. */
+struct nffs_area_desc;
+extern const struct nffs_area_desc *nffs_bench_area_descs;
+int nffs_bench_all(void);
+
 #endif
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "hal/hal_flash.h"
+#include "os/os.h"
 #include "os/os_mempool.h"
 #include "os/os_mutex.h"
 #include "os/os_malloc.h"
@@ -36,6 +37,7 @@ uint16_t nffs_block_max_data_sz;
 struct nffs_area_desc *nffs_current_area_descs;
 
 struct os_mempool nffs_file_pool;
+struct os_mempool nffs_wb_pool;
 struct os_mempool nffs_dir_pool;
 struct os_mempool nffs_inode_entry_pool;
 struct os_mempool nffs_block_entry_pool;
@@ -43,6 +45,7 @@ struct os_mempool nffs_cache_inode_pool;
 struct os_mempool nffs_cache_block_pool;
 
 void *nffs_file_mem;
+void *nffs_wb_mem;
 void *nffs_inode_mem;
 void *nffs_block_entry_mem;
 void *nffs_cache_inode_mem;
@@ -52,8 +55,28 @@ void *nffs_dir_mem;
 struct nffs_inode_entry *nffs_root_dir;
 struct nffs_inode_entry *nffs_lost_found_dir;
 
+STATS_SECT_DECL(nffs_stats) nffs_stats;
+STATS_NAME_START(nffs_stats)
+    STATS_NAME(nffs_stats, area_erases)
+    STATS_NAME(nffs_stats, area_erase_cnt_min)
+    STATS_NAME(nffs_stats, area_erase_cnt_max)
+    STATS_NAME(nffs_stats, path_cache_hits)
+    STATS_NAME(nffs_stats, path_cache_misses)
+STATS_NAME_END(nffs_stats)
+
 static struct os_mutex nffs_mutex;
 
+/*
+ * Tasks blocked in nffs_wait_writer().  Each waiter has its own semaphore so
+ * that a wakeup cannot be consumed by a task that started waiting later.
+ */
+struct nffs_writer_wait {
+    struct os_sem nww_sem;
+    SLIST_ENTRY(nffs_writer_wait) nww_next;
+};
+static SLIST_HEAD(, nffs_writer_wait) nffs_writer_waits;
+static struct os_task nffs_task;
+
 static struct log_handler nffs_log_console_handler;
 struct log nffs_log;
 
@@ -63,9 +86,11 @@ static int nffs_close(struct fs_file *fs_file);
 static int nffs_read(struct fs_file *fs_file, uint32_t len, void *out_data,
   uint32_t *out_len);
 static int nffs_write(struct fs_file *fs_file, const void *data, int len);
+static int nffs_flush(struct fs_file *fs_file);
 static int nffs_seek(struct fs_file *fs_file, uint32_t offset);
 static uint32_t nffs_getpos(const struct fs_file *fs_file);
 static int nffs_file_len(const struct fs_file *fs_file, uint32_t *out_len);
+static int nffs_preallocate(struct fs_file *fs_file, uint32_t len);
 static int nffs_unlink(const char *path);
 static int nffs_rename(const char *from, const char *to);
 static int nffs_mkdir(const char *path);
@@ -75,16 +100,21 @@ static int nffs_closedir(struct fs_dir *dir);
 static int nffs_dirent_name(const struct fs_dirent *fs_dirent, size_t max_len,
   char *out_name, uint8_t *out_name_len);
 static int nffs_dirent_is_dir(const struct fs_dirent *fs_dirent);
+static int nffs_readdir_batch(struct fs_dir *fs_dir,
+  struct fs_dir_cursor *cursor, struct fs_dirent_info *entries,
+  int max_entries, int *out_cnt);
 
 static const struct fs_ops nffs_ops = {
     .f_open = nffs_open,
     .f_close = nffs_close,
     .f_read = nffs_read,
     .f_write = nffs_write,
+    .f_flush = nffs_flush,
 
     .f_seek = nffs_seek,
     .f_getpos = nffs_getpos,
     .f_filelen = nffs_file_len,
+    .f_preallocate = nffs_preallocate,
 
     .f_unlink = nffs_unlink,
     .f_rename = nffs_rename,
@@ -96,6 +126,7 @@ static const struct fs_ops nffs_ops = {
 
     .f_dirent_name = nffs_dirent_name,
     .f_dirent_is_dir = nffs_dirent_is_dir,
+    .f_readdir_batch = nffs_readdir_batch,
 
     .f_name = "nffs"
 };
@@ -118,12 +149,68 @@ nffs_unlock(void)
     assert(rc == 0 || rc == OS_NOT_STARTED);
 }
 
+/**
+ * Waits for a write to the specified file to complete.  Long writes release
+ * the nffs lock between pieces; other accesses to the same file wait here
+ * until the whole write is done.  Called with the lock held; the lock is
+ * released while waiting.
+ */
+static void
+nffs_wait_writer(struct nffs_inode_entry *inode_entry)
+{
+    struct nffs_writer_wait wait;
+
+    while (inode_entry->nie_writing) {
+        os_sem_init(&wait.nww_sem, 0);
+        SLIST_INSERT_HEAD(&nffs_writer_waits, &wait, nww_next);
+        nffs_unlock();
+        os_sem_pend(&wait.nww_sem, OS_WAIT_FOREVER);
+        nffs_lock();
+    }
+}
+
+/**
+ * Marks a long write as complete and wakes every task waiting for a writer;
+ * each rechecks the file it is waiting on.  Called with the lock held.
+ */
 static void
+nffs_writer_done(struct nffs_inode_entry *inode_entry)
+{
+    struct nffs_writer_wait *wait;
+
+    inode_entry->nie_writing = 0;
+    while ((wait = SLIST_FIRST(&nffs_writer_waits)) != NULL) {
+        SLIST_REMOVE_HEAD(&nffs_writer_waits, nww_next);
+        os_sem_release(&wait->nww_sem);
+    }
+}
+
+static int
 nffs_stats_init(void)
 {
+    int rc;
+
     nffs_hashcnt_ins = 0;
     nffs_hashcnt_rm = 0;
     nffs_object_count = 0;
+    nffs_cache_block_hits = 0;
+    nffs_cache_block_misses = 0;
+    nffs_cache_block_readaheads = 0;
+
+    /* nffs may be initialized more than once; only register the first
+     * time.
+     */
+    if (stats_group_find("nffs") == NULL) {
+        rc = stats_init_and_reg(
+            STATS_HDR(nffs_stats),
+            STATS_SIZE_INIT_PARMS(nffs_stats, STATS_SIZE_32),
+            STATS_NAME_INIT_PARMS(nffs_stats), "nffs");
+        if (rc != 0) {
+            return FS_EOS;
+        }
+    }
+
+    return 0;
 }
 
 /**
@@ -258,12 +345,46 @@ nffs_file_len(const struct fs_file *fs_file, uint32_t *out_len)
     const struct nffs_file *file = (const struct nffs_file *)fs_file;
 
     nffs_lock();
+    nffs_wait_writer(file->nf_inode_entry);
     rc = nffs_inode_data_len(file->nf_inode_entry, out_len);
+    if (rc == 0) {
+        *out_len += file->nf_wb_len;
+    }
     nffs_unlock();
 
     return rc;
 }
 
+/**
+ * Sets aside free space for the next len bytes written through the specified
+ * file handle; see nffs_file_preallocate().
+ *
+ * @param file              The file to reserve space for.
+ * @param len               The number of bytes to reserve.
+ *
+ * @return                  0 on success; nonzero on failure.
+ */
+static int
+nffs_preallocate(struct fs_file *fs_file, uint32_t len)
+{
+    int rc;
+    struct nffs_file *file = (struct nffs_file *)fs_file;
+
+    nffs_lock();
+    nffs_wait_writer(file->nf_inode_entry);
+
+    if (!nffs_misc_ready()) {
+        rc = FS_EUNINIT;
+        goto done;
+    }
+
+    rc = nffs_file_preallocate(file, len);
+
+done:
+    nffs_unlock();
+    return rc;
+}
+
 /**
  * Reads data from the specified file.  If more data is requested than remains
  * in the file, all available data is retrieved and a success code is returned.
@@ -284,6 +405,7 @@ nffs_read(struct fs_file *fs_file, uint32_t len, void *out_data,
     struct nffs_file *file = (struct nffs_file *)fs_file;
 
     nffs_lock();
+    nffs_wait_writer(file->nf_inode_entry);
     rc = nffs_file_read(file, len, out_data, out_len);
     nffs_unlock();
 
@@ -292,6 +414,10 @@ nffs_read(struct fs_file *fs_file, uint32_t len, void *out_data,
 
 /**
  * Writes the supplied data to the current offset of the specified file handle.
+ * Long writes are done a few data blocks at a time, and the nffs lock is
+ * released in between, so that a large write does not hold up access to
+ * other files.  Accesses to the file being written wait until the write
+ * completes.
  *
  * @param file              The file to write to.
  * @param data              The data to write.
@@ -302,22 +428,72 @@ nffs_read(struct fs_file *fs_file, uint32_t len, void *out_data,
 static int
 nffs_write(struct fs_file *fs_file, const void *data, int len)
 {
+    struct nffs_inode_entry *inode_entry;
+    const uint8_t *ptr;
+    int chunk_len;
     int rc;
     struct nffs_file *file = (struct nffs_file *)fs_file;
 
     nffs_lock();
 
+    inode_entry = file->nf_inode_entry;
+    nffs_wait_writer(inode_entry);
+
     if (!nffs_misc_ready()) {
         rc = FS_EUNINIT;
         goto done;
     }
 
-    rc = nffs_write_to_file(file, data, len);
-    if (rc != 0) {
+    inode_entry->nie_writing = 1;
+    ptr = data;
+    while (1) {
+        chunk_len = nffs_config.nc_write_lock_blocks * nffs_block_max_data_sz;
+        if (chunk_len > len) {
+            chunk_len = len;
+        }
+        rc = nffs_write_to_file(file, ptr, chunk_len);
+        if (rc != 0 || chunk_len == len) {
+            break;
+        }
+        ptr += chunk_len;
+        len -= chunk_len;
+
+        nffs_unlock();
+        nffs_lock();
+
+        if (!nffs_misc_ready()) {
+            rc = FS_EUNINIT;
+            break;
+        }
+    }
+    nffs_writer_done(inode_entry);
+
+done:
+    nffs_unlock();
+    return rc;
+}
+
+/**
+ * Writes any data buffered for the specified file handle to flash.
+ *
+ * @param file              The file to flush.
+ *
+ * @return                  0 on success; nonzero on failure.
+ */
+static int
+nffs_flush(struct fs_file *fs_file)
+{
+    int rc;
+    struct nffs_file *file = (struct nffs_file *)fs_file;
+
+    nffs_lock();
+
+    if (!nffs_misc_ready()) {
+        rc = FS_EUNINIT;
         goto done;
     }
 
-    rc = 0;
+    rc = nffs_write_flush(file);
 
 done:
     nffs_unlock();
@@ -492,6 +668,39 @@ nffs_readdir(struct fs_dir *fs_dir, struct fs_dirent **out_fs_dirent)
     return rc;
 }
 
+/**
+ * Reads a batch of entries from an open directory, along with their types
+ * and sizes.  Reading resumes after the entry last recorded in the cursor;
+ * the cursor only holds that entry's name, so it can be kept across
+ * nffs_closedir() / nffs_opendir() and remains valid when files are created
+ * or unlinked in the meantime.  Entries are returned in filename order.
+ *
+ * @param dir                   The directory to read from.
+ * @param cursor                Position to resume from; zeroed to start at the
+ *                                  first entry.  Updated on return.
+ * @param entries               Array to fill with entry info.
+ * @param max_entries           Size of the entries array.
+ * @param out_cnt               On return, the number of entries filled in.
+ *
+ * @return                      0 on success;
+ *                              FS_ENOENT if there are no more entries;
+ *                              other nonzero on error.
+ */
+static int
+nffs_readdir_batch(struct fs_dir *fs_dir, struct fs_dir_cursor *cursor,
+                   struct fs_dirent_info *entries, int max_entries,
+                   int *out_cnt)
+{
+    int rc;
+    struct nffs_dir *dir = (struct nffs_dir *)fs_dir;
+
+    nffs_lock();
+    rc = nffs_dir_read_batch(dir, cursor, entries, max_entries, out_cnt);
+    nffs_unlock();
+
+    return rc;
+}
+
 /**
  * Closes the specified directory handle.
  *
@@ -617,6 +826,143 @@ nffs_detect(const struct nffs_area_desc *area_descs)
     return rc;
 }
 
+/**
+ * Writes an index checkpoint of the file system to the scratch area.  The
+ * next call to nffs_detect() loads the checkpoint and only reads the objects
+ * written after it, rather than every object in flash.  This should be called
+ * before a clean shutdown, once all files have been closed.
+ *
+ * @return                  0 on success;
+ *                          FS_EFULL if the checkpoint does not fit in the
+ *                              scratch area;
+ *                          FS_EUNEXP if an unlinked file is still open;
+ *                          other nonzero on failure.
+ */
+int
+nffs_checkpoint(void)
+{
+    int rc;
+
+    nffs_lock();
+
+    if (!nffs_misc_ready()) {
+        rc = FS_EUNINIT;
+        goto done;
+    }
+
+    rc = nffs_ckpt_write();
+
+done:
+    nffs_unlock();
+    return rc;
+}
+
+/**
+ * Gets direct pointers to a file's contents in flash, so that read-only data
+ * can be used without copying it to RAM.  Segments are returned in file
+ * order, starting at the specified offset, one per data block.  If more than max_segs segments are
+ * needed, call again with the offset following the last one.
+ *
+ * The pointers stay valid only while the file system is not modified:
+ * writing any file can cause garbage collection to move or erase blocks.
+ *
+ * @param file              The file to map; must be open for reading.
+ * @param offset            File offset to start at.
+ * @param segs              Array to fill with data segments.
+ * @param max_segs          Size of the segs array.
+ * @param out_cnt           On success, the number of segments filled in; 0
+ *                              at end of file.
+ *
+ * @return                  0 on success;
+ *                          FS_EINVAL if the file is not an NFFS file, or
+ *                              the flash holding it is not memory-mapped;
+ *                          FS_EOFFSET if offset is beyond end of file;
+ *                          other nonzero on failure.
+ */
+int
+nffs_file_mmap(struct fs_file *fs_file, uint32_t offset,
+               struct nffs_mmap_seg *segs, int max_segs, int *out_cnt)
+{
+    int rc;
+    struct nffs_file *file = (struct nffs_file *)fs_file;
+
+    if (file->nf_hdl.fh_ops != &nffs_ops) {
+        return FS_EINVAL;
+    }
+
+    nffs_lock();
+
+    if (!nffs_misc_ready()) {
+        rc = FS_EUNINIT;
+        goto done;
+    }
+
+    if (!(file->nf_access_flags & FS_ACCESS_READ)) {
+        rc = FS_EACCESS;
+        goto done;
+    }
+
+    nffs_wait_writer(file->nf_inode_entry);
+    rc = nffs_write_flush(file);
+    if (rc != 0) {
+        goto done;
+    }
+
+    rc = nffs_inode_mmap(file->nf_inode_entry, offset, segs, max_segs,
+                         out_cnt);
+
+done:
+    nffs_unlock();
+    return rc;
+}
+
+static void
+nffs_task_handler(void *arg)
+{
+    while (1) {
+        os_time_delay(nffs_config.nc_task_itvl);
+
+        nffs_lock();
+        if (nffs_misc_ready()) {
+            nffs_write_flush_aged(nffs_config.nc_write_buf_itvl);
+            nffs_gc_idle_step(nffs_config.nc_gc_step_slots);
+        }
+        nffs_unlock();
+    }
+}
+
+/**
+ * Starts the nffs background task.  The task wakes up every nc_task_itvl
+ * ticks and:
+ *     o Flushes write-back buffers holding data older than
+ *       nc_write_buf_itvl ticks.
+ *     o Performs a bounded amount of garbage collection work, such that
+ *       nc_gc_free_areas areas' worth of space is kept free in advance of
+ *       writes.  Each step holds the nffs lock for at most nc_gc_step_slots
+ *       hash table slots' worth of copying, or a single area erase.
+ * The task should be given a low priority so that it only runs when the
+ * system is otherwise idle.
+ *
+ * @param prio              The priority of the background task.
+ * @param stack             The stack for the background task.
+ * @param stack_size        The size of the stack, in os_stack_t units.
+ *
+ * @return                  0 on success; nonzero on error.
+ */
+int
+nffs_task_init(uint8_t prio, os_stack_t *stack, uint16_t stack_size)
+{
+    int rc;
+
+    rc = os_task_init(&nffs_task, "nffs", nffs_task_handler, NULL,
+                      prio, OS_WAIT_FOREVER, stack, stack_size);
+    if (rc != 0) {
+        return FS_EOS;
+    }
+
+    return 0;
+}
+
 /**
  * Initializes internal nffs memory and data structures.  This must be called
  * before any nffs operations are attempted.
@@ -632,13 +978,18 @@ nffs_init(void)
 
     nffs_cache_clear();
 
-    nffs_stats_init();
+    rc = nffs_stats_init();
+    if (rc != 0) {
+        return rc;
+    }
 
     rc = os_mutex_init(&nffs_mutex);
     if (rc != 0) {
         return FS_EOS;
     }
 
+    SLIST_INIT(&nffs_writer_waits);
+
     free(nffs_file_mem);
     nffs_file_mem = malloc(
         OS_MEMPOOL_BYTES(nffs_config.nc_num_files, sizeof (struct nffs_file)));
@@ -646,6 +997,17 @@ nffs_init(void)
         return FS_ENOMEM;
     }
 
+    free(nffs_wb_mem);
+    nffs_wb_mem = NULL;
+    if (nffs_config.nc_write_buf_size > 0) {
+        nffs_wb_mem = malloc(
+            OS_MEMPOOL_BYTES(nffs_config.nc_num_files,
+                             nffs_config.nc_write_buf_size));
+        if (nffs_wb_mem == NULL) {
+            return FS_ENOMEM;
+        }
+    }
+
     free(nffs_inode_mem);
     nffs_inode_mem = malloc(
         OS_MEMPOOL_BYTES(nffs_config.nc_num_inodes,
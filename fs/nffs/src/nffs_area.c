@@ -28,7 +28,6 @@ nffs_area_set_magic(struct nffs_disk_area *disk_area)
     disk_area->nda_magic[0] = NFFS_AREA_MAGIC0;
     disk_area->nda_magic[1] = NFFS_AREA_MAGIC1;
     disk_area->nda_magic[2] = NFFS_AREA_MAGIC2;
-    disk_area->nda_magic[3] = NFFS_AREA_MAGIC3;
 }
 
 int
@@ -37,7 +36,8 @@ nffs_area_magic_is_set(const struct nffs_disk_area *disk_area)
     return disk_area->nda_magic[0] == NFFS_AREA_MAGIC0 &&
            disk_area->nda_magic[1] == NFFS_AREA_MAGIC1 &&
            disk_area->nda_magic[2] == NFFS_AREA_MAGIC2 &&
-           disk_area->nda_magic[3] == NFFS_AREA_MAGIC3;
+           (disk_area->nda_ver != NFFS_AREA_VER_1 ||
+            disk_area->nda_erase_cnt == NFFS_AREA_MAGIC3);
 }
 
 int
@@ -53,6 +53,31 @@ nffs_area_is_current_version(const struct nffs_disk_area *disk_area)
     return disk_area->nda_ver == NFFS_AREA_VER;
 }
 
+/**
+ * Indicates whether an area header can be restored.  Version 1 areas differ
+ * from the current version only in lacking an erase count.
+ */
+int
+nffs_area_is_supported_version(const struct nffs_disk_area *disk_area)
+{
+    return disk_area->nda_ver == NFFS_AREA_VER_1 ||
+           disk_area->nda_ver == NFFS_AREA_VER;
+}
+
+/**
+ * Returns the erase count recorded in an area header.  Version 1 headers
+ * predate erase counting; their areas are treated as never erased.
+ */
+uint32_t
+nffs_area_erase_cnt(const struct nffs_disk_area *disk_area)
+{
+    if (disk_area->nda_ver == NFFS_AREA_VER_1) {
+        return 0;
+    }
+
+    return disk_area->nda_erase_cnt;
+}
+
 void
 nffs_area_to_disk(const struct nffs_area *area,
                   struct nffs_disk_area *out_disk_area)
@@ -60,6 +85,7 @@ nffs_area_to_disk(const struct nffs_area *area,
     memset(out_disk_area, 0, sizeof *out_disk_area);
     nffs_area_set_magic(out_disk_area);
     out_disk_area->nda_length = area->na_length;
+    out_disk_area->nda_erase_cnt = area->na_erase_cnt;
     out_disk_area->nda_ver = NFFS_AREA_VER;
     out_disk_area->nda_gc_seq = area->na_gc_seq;
     out_disk_area->nda_id = area->na_id;
@@ -116,3 +142,32 @@ nffs_area_find_corrupt_scratch(uint16_t *out_good_idx, uint16_t *out_bad_idx)
 
     return FS_ENOENT;
 }
+
+/**
+ * Recalculates the wear statistics from the erase counts of all areas.
+ */
+void
+nffs_area_update_wear_stats(void)
+{
+    uint32_t min;
+    uint32_t max;
+    int i;
+
+    min = UINT32_MAX;
+    max = 0;
+    for (i = 0; i < nffs_num_areas; i++) {
+        if (nffs_areas[i].na_erase_cnt < min) {
+            min = nffs_areas[i].na_erase_cnt;
+        }
+        if (nffs_areas[i].na_erase_cnt > max) {
+            max = nffs_areas[i].na_erase_cnt;
+        }
+    }
+
+    if (nffs_num_areas == 0) {
+        min = 0;
+    }
+
+    nffs_stats.STATS_SECT_VAR(area_erase_cnt_min) = min;
+    nffs_stats.STATS_SECT_VAR(area_erase_cnt_max) = max;
+}
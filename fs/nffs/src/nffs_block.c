@@ -444,6 +444,25 @@ nffs_block_read_data(const struct nffs_block *block, uint16_t offset,
     return 0;
 }
 
+/**
+ * Returns a pointer to the block's data in memory-mapped flash, or NULL if
+ * the flash is not memory-mapped.
+ */
+const void *
+nffs_block_mmap_data(const struct nffs_block *block, uint16_t offset,
+                     uint16_t length)
+{
+    uint32_t area_offset;
+    uint8_t area_idx;
+
+    nffs_flash_loc_expand(block->nb_hash_entry->nhe_flash_loc,
+                         &area_idx, &area_offset);
+    area_offset += sizeof (struct nffs_disk_block);
+    area_offset += offset;
+
+    return nffs_flash_mmap(area_idx, area_offset, length);
+}
+
 int
 nffs_block_is_dummy(struct nffs_hash_entry *entry)
 {
@@ -26,7 +26,14 @@ TAILQ_HEAD(nffs_cache_inode_list, nffs_cache_inode);
 static struct nffs_cache_inode_list nffs_cache_inode_list =
     TAILQ_HEAD_INITIALIZER(nffs_cache_inode_list);
 
-static void nffs_cache_reclaim_blocks(void);
+/** Every cached block, regardless of owner; LRU at tail. */
+TAILQ_HEAD(nffs_cache_block_lru, nffs_cache_block);
+static struct nffs_cache_block_lru nffs_cache_block_lru =
+    TAILQ_HEAD_INITIALIZER(nffs_cache_block_lru);
+
+uint32_t nffs_cache_block_hits;
+uint32_t nffs_cache_block_misses;
+uint32_t nffs_cache_block_readaheads;
 
 static struct nffs_cache_block *
 nffs_cache_block_alloc(void)
@@ -49,14 +56,106 @@ nffs_cache_block_free(struct nffs_cache_block *entry)
     }
 }
 
+/**
+ * Removes a block from its inode's list and from the LRU list, and frees it.
+ */
+static void
+nffs_cache_block_remove(struct nffs_cache_block *cache_block)
+{
+    TAILQ_REMOVE(&cache_block->ncb_cache_inode->nci_block_list, cache_block,
+                 ncb_link);
+    TAILQ_REMOVE(&nffs_cache_block_lru, cache_block, ncb_lru_link);
+    nffs_cache_block_free(cache_block);
+}
+
+/**
+ * Marks a cached block as the most recently used.
+ */
+static void
+nffs_cache_block_touch(struct nffs_cache_block *cache_block)
+{
+    TAILQ_REMOVE(&nffs_cache_block_lru, cache_block, ncb_lru_link);
+    TAILQ_INSERT_HEAD(&nffs_cache_block_lru, cache_block, ncb_lru_link);
+}
+
+/**
+ * Evicts the least recently used cached block.  Each inode's cached blocks
+ * must remain contiguous, so blocks can only be removed from the ends of an
+ * inode's list:
+ *     o If the LRU block belongs to the inode that is currently having blocks
+ *       added, the block at the opposite end of that inode's list is evicted
+ *       instead.
+ *     o Otherwise, the LRU block is evicted along with every block that
+ *       precedes it in its inode's list.
+ *
+ * @param cur_inode             The inode blocks are being added to; null if
+ *                                  none.
+ * @param at_tail               Whether blocks are being added to the tail
+ *                                  (1) or the head (0) of cur_inode's list.
+ * @param only_other            If set, this function fails rather than
+ *                                  evicting one of cur_inode's blocks.
+ *
+ * @return                      0 on success;
+ *                              FS_ENOMEM if no block could be evicted.
+ */
+static int
+nffs_cache_reclaim_block(struct nffs_cache_inode *cur_inode, int at_tail,
+                         int only_other)
+{
+    struct nffs_cache_inode *cache_inode;
+    struct nffs_cache_block *cache_block;
+    struct nffs_cache_block *victim;
+
+    victim = TAILQ_LAST(&nffs_cache_block_lru, nffs_cache_block_lru);
+    if (victim == NULL) {
+        return FS_ENOMEM;
+    }
+
+    cache_inode = victim->ncb_cache_inode;
+    if (cache_inode == cur_inode) {
+        if (only_other) {
+            return FS_ENOMEM;
+        }
+
+        if (at_tail) {
+            victim = TAILQ_FIRST(&cache_inode->nci_block_list);
+        } else {
+            victim = TAILQ_LAST(&cache_inode->nci_block_list,
+                                nffs_cache_block_list);
+        }
+        nffs_cache_block_remove(victim);
+        return 0;
+    }
+
+    do {
+        cache_block = TAILQ_FIRST(&cache_inode->nci_block_list);
+        nffs_cache_block_remove(cache_block);
+    } while (cache_block != victim);
+
+    return 0;
+}
+
+/**
+ * Allocates a cached block that is about to be added to the specified inode's
+ * list, evicting other blocks if necessary.
+ *
+ * @param cur_inode             The inode the block will be added to.
+ * @param at_tail               Whether the block will be added to the tail
+ *                                  (1) or the head (0) of the inode's list.
+ *
+ * @return                      The allocated block.
+ */
 static struct nffs_cache_block *
-nffs_cache_block_acquire(void)
+nffs_cache_block_acquire(struct nffs_cache_inode *cur_inode, int at_tail)
 {
     struct nffs_cache_block *cache_block;
+    int rc;
 
     cache_block = nffs_cache_block_alloc();
     if (cache_block == NULL) {
-        nffs_cache_reclaim_blocks();
+        rc = nffs_cache_reclaim_block(cur_inode, at_tail, 0);
+        assert(rc == 0);
+
         cache_block = nffs_cache_block_alloc();
     }
 
@@ -103,8 +202,7 @@ nffs_cache_inode_free_blocks(struct nffs_cache_inode *cache_inode)
     struct nffs_cache_block *cache_block;
 
     while ((cache_block = TAILQ_FIRST(&cache_inode->nci_block_list)) != NULL) {
-        TAILQ_REMOVE(&cache_inode->nci_block_list, cache_block, ncb_link);
-        nffs_cache_block_free(cache_block);
+        nffs_cache_block_remove(cache_block);
     }
 }
 
@@ -214,22 +312,6 @@ nffs_cache_inode_range(const struct nffs_cache_inode *cache_inode,
                cache_block->ncb_block.nb_data_len;
 }
 
-static void
-nffs_cache_reclaim_blocks(void)
-{
-    struct nffs_cache_inode *cache_inode;
-
-    TAILQ_FOREACH_REVERSE(cache_inode, &nffs_cache_inode_list,
-                          nffs_cache_inode_list, nci_link) {
-        if (!TAILQ_EMPTY(&cache_inode->nci_block_list)) {
-            nffs_cache_inode_free_blocks(cache_inode);
-            return;
-        }
-    }
-
-    assert(0);
-}
-
 void
 nffs_cache_inode_delete(const struct nffs_inode_entry *inode_entry)
 {
@@ -253,6 +335,9 @@ nffs_cache_inode_ensure(struct nffs_cache_inode **out_cache_inode,
 
     cache_inode = nffs_cache_inode_find(inode_entry);
     if (cache_inode != NULL) {
+        /* Keep the inode list sorted by recency of use. */
+        TAILQ_REMOVE(&nffs_cache_inode_list, cache_inode, nci_link);
+        TAILQ_INSERT_HEAD(&nffs_cache_inode_list, cache_inode, nci_link);
         rc = 0;
         goto done;
     }
@@ -340,10 +425,49 @@ nffs_cache_insert_block(struct nffs_cache_inode *cache_inode,
     } else {
         TAILQ_INSERT_HEAD(&cache_inode->nci_block_list, cache_block, ncb_link);
     }
+    TAILQ_INSERT_HEAD(&nffs_cache_block_lru, cache_block, ncb_lru_link);
+    cache_block->ncb_cache_inode = cache_inode;
 
     nffs_cache_log_insert_block(cache_inode, cache_block, tail);
 }
 
+/**
+ * Caches blocks that follow the end of the specified inode's cached list.
+ * Read-ahead never evicts any of the inode's own cached blocks; it stops
+ * early if the cache is full of them.
+ *
+ * @param cache_inode           The cached inode to extend.
+ * @param blocks                The blocks to cache, in reverse file order
+ *                                  (i.e., the last element immediately
+ *                                  follows the end of the cache).
+ * @param starts                The file offset of each block.
+ * @param count                 The number of blocks to cache.
+ */
+static void
+nffs_cache_readahead(struct nffs_cache_inode *cache_inode,
+                     const struct nffs_block *blocks, const uint32_t *starts,
+                     int count)
+{
+    struct nffs_cache_block *cache_block;
+    int i;
+
+    for (i = count - 1; i >= 0; i--) {
+        cache_block = nffs_cache_block_alloc();
+        if (cache_block == NULL) {
+            if (nffs_cache_reclaim_block(cache_inode, 1, 1) != 0) {
+                return;
+            }
+            cache_block = nffs_cache_block_alloc();
+            assert(cache_block != NULL);
+        }
+
+        cache_block->ncb_block = blocks[i];
+        cache_block->ncb_file_offset = starts[i];
+        nffs_cache_insert_block(cache_inode, cache_block, 1);
+        nffs_cache_block_readaheads++;
+    }
+}
+
 /**
  * Finds the data block containing the specified offset within a file inode.
  * If the block is not yet cached, it gets cached as a result of this
@@ -363,6 +487,12 @@ nffs_cache_insert_block(struct nffs_cache_inode *cache_inode,
  *      b. Else, clear the cache, and populate it with the single entry
  *         corresponding to the requested block.
  *
+ * In cases 1 and 3a, the access looks sequential, so up to nc_cache_readahead
+ * of the blocks that follow the requested block are cached as well.  Finding
+ * a block beyond the end of the cache requires walking the block chain
+ * backwards from the end of the file; the blocks passed over on the way are
+ * the ones that get read ahead.
+ *
  * @param cache_inode           The cached file inode to seek within.
  * @param seek_offset           The file offset to seek to.
  * @param out_cache_block       On success, the requested cached block gets
@@ -375,6 +505,8 @@ int
 nffs_cache_seek(struct nffs_cache_inode *cache_inode, uint32_t seek_offset,
                 struct nffs_cache_block **out_cache_block)
 {
+    struct nffs_block ra_blocks[NFFS_CACHE_READAHEAD_MAX];
+    uint32_t ra_starts[NFFS_CACHE_READAHEAD_MAX];
     struct nffs_cache_block *cache_block;
     struct nffs_hash_entry *last_cached_entry;
     struct nffs_hash_entry *block_entry;
@@ -384,13 +516,24 @@ nffs_cache_seek(struct nffs_cache_inode *cache_inode, uint32_t seek_offset,
     uint32_t cache_end;
     uint32_t block_start;
     uint32_t block_end;
+    int ra_count;
+    int ra_max;
+    int hit;
     int rc;
+    int i;
 
     /* Empty files have no blocks that can be cached. */
     if (cache_inode->nci_file_size == 0) {
         return FS_ENOENT;
     }
 
+    ra_max = nffs_config.nc_cache_readahead;
+    if (ra_max > NFFS_CACHE_READAHEAD_MAX) {
+        ra_max = NFFS_CACHE_READAHEAD_MAX;
+    }
+    ra_count = 0;
+    hit = 0;
+
     nffs_cache_inode_range(cache_inode, &cache_start, &cache_end);
     if (cache_end != 0 && seek_offset < cache_start) {
         /* Seeking prior to cache.  Iterate backwards from cache start. */
@@ -404,6 +547,7 @@ nffs_cache_seek(struct nffs_cache_inode *cache_inode, uint32_t seek_offset,
                                  nffs_cache_block_list);
         block_entry = cache_block->ncb_block.nb_hash_entry;
         block_end = cache_end;
+        hit = 1;
     } else {
         /* Seeking beyond end of cache.  Iterate backwards from file end.  If
          * sought-after block is adjacent to cache end, its cache entry will
@@ -423,10 +567,11 @@ nffs_cache_seek(struct nffs_cache_inode *cache_inode, uint32_t seek_offset,
              * cache block and prepend it to the cache.
              */
             assert(cache_block == NULL);
-            cache_block = nffs_cache_block_acquire();
+            cache_block = nffs_cache_block_acquire(cache_inode, 0);
             rc = nffs_cache_block_populate(cache_block, block_entry,
                                            block_end);
             if (rc != 0) {
+                nffs_cache_block_free(cache_block);
                 return rc;
             }
 
@@ -463,7 +608,7 @@ nffs_cache_seek(struct nffs_cache_inode *cache_inode, uint32_t seek_offset,
                  * erase the current cache and populate it with this single
                  * block.
                  */
-                cache_block = nffs_cache_block_acquire();
+                cache_block = nffs_cache_block_acquire(cache_inode, 1);
                 cache_block->ncb_block = block;
                 cache_block->ncb_file_offset = block_start;
 
@@ -473,9 +618,24 @@ nffs_cache_seek(struct nffs_cache_inode *cache_inode, uint32_t seek_offset,
 
                     nffs_cache_insert_block(cache_inode, cache_block, 1);
                 } else {
+                    if (last_cached_entry != NULL) {
+                        /* Random access; don't read ahead. */
+                        ra_count = 0;
+                    }
                     nffs_cache_inode_free_blocks(cache_inode);
                     nffs_cache_insert_block(cache_inode, cache_block, 0);
                 }
+
+                nffs_cache_readahead(cache_inode, ra_blocks, ra_starts,
+                                     ra_count);
+            } else {
+                nffs_cache_block_touch(cache_block);
+            }
+
+            if (hit) {
+                nffs_cache_block_hits++;
+            } else {
+                nffs_cache_block_misses++;
             }
 
             if (out_cache_block != NULL) {
@@ -488,6 +648,18 @@ nffs_cache_seek(struct nffs_cache_inode *cache_inode, uint32_t seek_offset,
         if (cache_block != NULL) {
             cache_block = TAILQ_PREV(cache_block, nffs_cache_block_list,
                                      ncb_link);
+        } else if (ra_max > 0) {
+            /* Remember the blocks closest to the one being sought. */
+            if (ra_count == ra_max) {
+                for (i = 1; i < ra_count; i++) {
+                    ra_blocks[i - 1] = ra_blocks[i];
+                    ra_starts[i - 1] = ra_starts[i];
+                }
+                ra_count--;
+            }
+            ra_blocks[ra_count] = block;
+            ra_starts[ra_count] = block_start;
+            ra_count++;
         }
         block_entry = pred_entry;
         block_end = block_start;
@@ -0,0 +1,590 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "nffs/nffs.h"
+#include "nffs_priv.h"
+
+/*
+ * An index checkpoint is a snapshot of the RAM representation of the file
+ * system: every inode and data block entry, the links between them, and the
+ * write offset of each area.  It lets a mount skip the full scan of every
+ * object on flash; only the objects written after the checkpoint get
+ * replayed.
+ *
+ * The checkpoint lives in the scratch area, after the area header.  Garbage
+ * collection needs an erased scratch area, so the scratch area is erased
+ * before it is used if it contains a checkpoint.  A checkpoint is only valid
+ * if its tail is intact, its CRC matches, and every area recorded in it still
+ * has the same location, ID, and garbage collection sequence number.
+ */
+
+struct nffs_ckpt_cursor {
+    uint32_t nck_offset;    /* Offset within the scratch area. */
+    uint16_t nck_crc;       /* Running CRC of everything before the tail. */
+    uint16_t nck_buf_len;   /* Bytes pending in nffs_flash_buf (write). */
+};
+
+static int
+nffs_ckpt_flush(struct nffs_ckpt_cursor *cursor)
+{
+    int rc;
+
+    if (cursor->nck_buf_len == 0) {
+        return 0;
+    }
+
+    rc = nffs_flash_write(nffs_scratch_area_idx, cursor->nck_offset,
+                          nffs_flash_buf, cursor->nck_buf_len);
+    if (rc != 0) {
+        return rc;
+    }
+
+    cursor->nck_offset += cursor->nck_buf_len;
+    cursor->nck_buf_len = 0;
+
+    return 0;
+}
+
+/**
+ * Appends a record to the checkpoint being written.  Records are gathered in
+ * the flash buffer so that flash is written in large chunks.
+ */
+static int
+nffs_ckpt_append(struct nffs_ckpt_cursor *cursor, const void *data,
+                 uint16_t len, int in_crc)
+{
+    int rc;
+
+    assert(len <= sizeof nffs_flash_buf);
+
+    if (cursor->nck_buf_len + len > sizeof nffs_flash_buf) {
+        rc = nffs_ckpt_flush(cursor);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    memcpy(nffs_flash_buf + cursor->nck_buf_len, data, len);
+    cursor->nck_buf_len += len;
+    if (in_crc) {
+        cursor->nck_crc = crc16_ccitt(cursor->nck_crc, data, len);
+    }
+
+    return 0;
+}
+
+static int
+nffs_ckpt_read(struct nffs_ckpt_cursor *cursor, void *data, uint16_t len)
+{
+    int rc;
+
+    rc = nffs_flash_read(nffs_scratch_area_idx, cursor->nck_offset, data, len);
+    if (rc != 0) {
+        return rc;
+    }
+
+    cursor->nck_offset += len;
+    cursor->nck_crc = crc16_ccitt(cursor->nck_crc, data, len);
+
+    return 0;
+}
+
+/**
+ * Indicates whether an entry can be recorded in a checkpoint.  Dummy
+ * entries, deleted inodes, and inodes that are not in the directory tree
+ * (e.g., an unlinked file that is still open) make the RAM representation
+ * unsuitable for a snapshot.
+ */
+static int
+nffs_ckpt_entry_is_clean(struct nffs_hash_entry *entry)
+{
+    struct nffs_inode_entry *inode_entry;
+
+    if (entry->nhe_flash_loc == NFFS_FLASH_LOC_NONE) {
+        return 0;
+    }
+
+    if (nffs_hash_id_is_inode(entry->nhe_id)) {
+        inode_entry = (struct nffs_inode_entry *)entry;
+        if (!nffs_inode_getflags(inode_entry, NFFS_INODE_FLAG_INTREE)) {
+            return 0;
+        }
+        if (nffs_inode_getflags(inode_entry, NFFS_INODE_FLAG_DUMMY |
+                                             NFFS_INODE_FLAG_DUMMYLSTBLK |
+                                             NFFS_INODE_FLAG_DELETED)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void
+nffs_ckpt_entry_fill(struct nffs_disk_ckpt_entry *disk_entry,
+                     struct nffs_hash_entry *entry)
+{
+    struct nffs_inode_entry *inode_entry;
+    struct nffs_inode_entry *child;
+
+    disk_entry->ndce_id = entry->nhe_id;
+    disk_entry->ndce_flash_loc = entry->nhe_flash_loc;
+    disk_entry->ndce_link = NFFS_ID_NONE;
+    disk_entry->ndce_sibling = NFFS_ID_NONE;
+
+    if (!nffs_hash_id_is_inode(entry->nhe_id)) {
+        return;
+    }
+
+    inode_entry = (struct nffs_inode_entry *)entry;
+    if (nffs_hash_id_is_dir(entry->nhe_id)) {
+        child = SLIST_FIRST(&inode_entry->nie_child_list);
+        if (child != NULL) {
+            disk_entry->ndce_link = child->nie_hash_entry.nhe_id;
+        }
+    } else if (inode_entry->nie_last_block_entry != NULL) {
+        disk_entry->ndce_link = inode_entry->nie_last_block_entry->nhe_id;
+    }
+
+    child = SLIST_NEXT(inode_entry, nie_sibling_next);
+    if (child != NULL) {
+        disk_entry->ndce_sibling = child->nie_hash_entry.nhe_id;
+    }
+}
+
+/**
+ * Writes an index checkpoint of the current RAM representation to the
+ * scratch area, replacing any existing checkpoint.
+ *
+ * @return                      0 on success;
+ *                              FS_EFULL if the checkpoint does not fit in the
+ *                                  scratch area;
+ *                              FS_EUNEXP if the RAM representation contains
+ *                                  objects that cannot be checkpointed, or
+ *                                  if a garbage collection cycle is using
+ *                                  the scratch area;
+ *                              other nonzero on failure.
+ */
+int
+nffs_ckpt_write(void)
+{
+    struct nffs_disk_ckpt_entry disk_entry;
+    struct nffs_disk_ckpt_area disk_area;
+    struct nffs_disk_ckpt_tail disk_tail;
+    struct nffs_ckpt_cursor cursor;
+    struct nffs_disk_ckpt disk_ckpt;
+    struct nffs_hash_entry *entry;
+    struct nffs_area *scratch;
+    struct nffs_area *area;
+    uint32_t count;
+    uint32_t size;
+    int rc;
+    int i;
+
+    if (nffs_scratch_area_idx == NFFS_AREA_ID_NONE) {
+        return FS_ECORRUPT;
+    }
+    if (nffs_gc_area_idx != NFFS_AREA_ID_NONE) {
+        return FS_EUNEXP;
+    }
+    scratch = nffs_areas + nffs_scratch_area_idx;
+
+    size = sizeof (struct nffs_disk_area) + sizeof disk_ckpt +
+           nffs_num_areas * sizeof disk_area +
+           nffs_hash_count * sizeof disk_entry + sizeof disk_tail;
+    if (size > scratch->na_length) {
+        return FS_EFULL;
+    }
+
+    /* Keep the existing checkpoint if a new one cannot be written. */
+    NFFS_HASH_FOREACH(entry, i) {
+        if (!nffs_ckpt_entry_is_clean(entry)) {
+            return FS_EUNEXP;
+        }
+    }
+
+    if (scratch->na_cur > NFFS_AREA_OFFSET_ID) {
+        rc = nffs_format_area(nffs_scratch_area_idx, 1);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    memset(&cursor, 0, sizeof cursor);
+    cursor.nck_offset = sizeof (struct nffs_disk_area);
+
+    memset(&disk_ckpt, 0, sizeof disk_ckpt);
+    disk_ckpt.ndc_magic = NFFS_CKPT_MAGIC;
+    disk_ckpt.ndc_num_entries = nffs_hash_count;
+    disk_ckpt.ndc_next_dir_id = nffs_hash_next_dir_id;
+    disk_ckpt.ndc_next_file_id = nffs_hash_next_file_id;
+    disk_ckpt.ndc_next_block_id = nffs_hash_next_block_id;
+    disk_ckpt.ndc_block_max_data_sz = nffs_block_max_data_sz;
+    disk_ckpt.ndc_num_areas = nffs_num_areas;
+    rc = nffs_ckpt_append(&cursor, &disk_ckpt, sizeof disk_ckpt, 1);
+    if (rc != 0) {
+        return rc;
+    }
+
+    for (i = 0; i < nffs_num_areas; i++) {
+        area = nffs_areas + i;
+
+        memset(&disk_area, 0, sizeof disk_area);
+        disk_area.ndca_offset = area->na_offset;
+        disk_area.ndca_length = area->na_length;
+        disk_area.ndca_cur = area->na_cur;
+        disk_area.ndca_id = area->na_id;
+        disk_area.ndca_gc_seq = area->na_gc_seq;
+        rc = nffs_ckpt_append(&cursor, &disk_area, sizeof disk_area, 1);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    count = 0;
+    NFFS_HASH_FOREACH(entry, i) {
+        nffs_ckpt_entry_fill(&disk_entry, entry);
+        rc = nffs_ckpt_append(&cursor, &disk_entry, sizeof disk_entry, 1);
+        if (rc != 0) {
+            return rc;
+        }
+        count++;
+    }
+    assert(count == nffs_hash_count);
+
+    /* The tail is written last; until it is, the checkpoint is invalid. */
+    rc = nffs_ckpt_flush(&cursor);
+    if (rc != 0) {
+        return rc;
+    }
+
+    memset(&disk_tail, 0, sizeof disk_tail);
+    disk_tail.ndct_magic = NFFS_CKPT_TAIL_MAGIC;
+    disk_tail.ndct_crc16 = cursor.nck_crc;
+    rc = nffs_ckpt_append(&cursor, &disk_tail, sizeof disk_tail, 0);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return nffs_ckpt_flush(&cursor);
+}
+
+static int
+nffs_ckpt_area_matches(const struct nffs_disk_ckpt_area *disk_area, int idx)
+{
+    const struct nffs_area *area;
+
+    area = nffs_areas + idx;
+    if (disk_area->ndca_offset != area->na_offset ||
+        disk_area->ndca_length != area->na_length ||
+        disk_area->ndca_id != (area->na_id & 0xff) ||
+        disk_area->ndca_gc_seq != area->na_gc_seq) {
+
+        return 0;
+    }
+
+    if (idx != nffs_scratch_area_idx &&
+        (disk_area->ndca_cur < sizeof (struct nffs_disk_area) ||
+         disk_area->ndca_cur > area->na_length)) {
+
+        return 0;
+    }
+
+    return 1;
+}
+
+static int
+nffs_ckpt_entry_is_valid(const struct nffs_disk_ckpt_entry *disk_entry)
+{
+    uint32_t area_offset;
+    uint8_t area_idx;
+
+    if (!nffs_hash_id_is_inode(disk_entry->ndce_id) &&
+        !nffs_hash_id_is_block(disk_entry->ndce_id)) {
+
+        return 0;
+    }
+
+    nffs_flash_loc_expand(disk_entry->ndce_flash_loc, &area_idx, &area_offset);
+    if (area_idx >= nffs_num_areas || area_idx == nffs_scratch_area_idx ||
+        area_offset >= nffs_areas[area_idx].na_length) {
+
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Checks the checkpoint in the scratch area without changing any state.
+ *
+ * @param out_disk_ckpt         On success, the checkpoint header gets written
+ *                                  here.
+ * @param out_end               On success, the offset just past the
+ *                                  checkpoint gets written here.
+ *
+ * @return                      0 if the checkpoint is valid;
+ *                              FS_ECORRUPT if it is invalid or stale;
+ *                              other nonzero on failure.
+ */
+static int
+nffs_ckpt_validate(struct nffs_disk_ckpt *out_disk_ckpt, uint32_t *out_end)
+{
+    struct nffs_disk_ckpt_entry disk_entry;
+    struct nffs_disk_ckpt_area disk_area;
+    struct nffs_disk_ckpt_tail disk_tail;
+    struct nffs_ckpt_cursor cursor;
+    uint16_t crc;
+    uint32_t i;
+    int rc;
+
+    memset(&cursor, 0, sizeof cursor);
+    cursor.nck_offset = sizeof (struct nffs_disk_area);
+
+    rc = nffs_ckpt_read(&cursor, out_disk_ckpt, sizeof *out_disk_ckpt);
+    if (rc != 0) {
+        return rc;
+    }
+    if (out_disk_ckpt->ndc_magic != NFFS_CKPT_MAGIC ||
+        out_disk_ckpt->ndc_num_areas != nffs_num_areas) {
+
+        return FS_ECORRUPT;
+    }
+
+    for (i = 0; i < nffs_num_areas; i++) {
+        rc = nffs_ckpt_read(&cursor, &disk_area, sizeof disk_area);
+        if (rc != 0) {
+            return rc;
+        }
+        if (!nffs_ckpt_area_matches(&disk_area, i)) {
+            return FS_ECORRUPT;
+        }
+    }
+
+    for (i = 0; i < out_disk_ckpt->ndc_num_entries; i++) {
+        rc = nffs_ckpt_read(&cursor, &disk_entry, sizeof disk_entry);
+        if (rc != 0) {
+            return rc == FS_EOFFSET ? FS_ECORRUPT : rc;
+        }
+        if (!nffs_ckpt_entry_is_valid(&disk_entry)) {
+            return FS_ECORRUPT;
+        }
+    }
+
+    crc = cursor.nck_crc;
+    rc = nffs_ckpt_read(&cursor, &disk_tail, sizeof disk_tail);
+    if (rc != 0) {
+        return rc == FS_EOFFSET ? FS_ECORRUPT : rc;
+    }
+    if (disk_tail.ndct_magic != NFFS_CKPT_TAIL_MAGIC ||
+        disk_tail.ndct_crc16 != crc) {
+
+        return FS_ECORRUPT;
+    }
+
+    *out_end = cursor.nck_offset;
+    return 0;
+}
+
+static int
+nffs_ckpt_restore_entry(const struct nffs_disk_ckpt_entry *disk_entry)
+{
+    struct nffs_inode_entry *inode_entry;
+    struct nffs_hash_entry *entry;
+    int rc;
+
+    if (nffs_hash_find(disk_entry->ndce_id) != NULL) {
+        return FS_ECORRUPT;
+    }
+
+    if (nffs_hash_id_is_inode(disk_entry->ndce_id)) {
+        inode_entry = nffs_inode_entry_alloc();
+        if (inode_entry == NULL) {
+            return FS_ENOMEM;
+        }
+        inode_entry->nie_refcnt = 1;
+        nffs_inode_setflags(inode_entry, NFFS_INODE_FLAG_INTREE);
+        entry = &inode_entry->nie_hash_entry;
+    } else {
+        entry = nffs_block_entry_alloc();
+        if (entry == NULL) {
+            return FS_ENOMEM;
+        }
+    }
+    entry->nhe_id = disk_entry->ndce_id;
+    entry->nhe_flash_loc = disk_entry->ndce_flash_loc;
+
+    rc = nffs_hash_insert(entry);
+    if (rc != 0) {
+        if (nffs_hash_id_is_inode(entry->nhe_id)) {
+            nffs_inode_entry_free((struct nffs_inode_entry *)entry);
+        } else {
+            nffs_block_entry_free(entry);
+        }
+        return rc;
+    }
+
+    return 0;
+}
+
+static int
+nffs_ckpt_restore_links(const struct nffs_disk_ckpt_entry *disk_entry)
+{
+    struct nffs_inode_entry *inode_entry;
+    struct nffs_inode_entry *sibling;
+    struct nffs_inode_entry *child;
+    struct nffs_hash_entry *block;
+
+    if (!nffs_hash_id_is_inode(disk_entry->ndce_id)) {
+        return 0;
+    }
+    inode_entry = nffs_hash_find_inode(disk_entry->ndce_id);
+    assert(inode_entry != NULL);
+
+    if (disk_entry->ndce_link != NFFS_ID_NONE) {
+        if (nffs_hash_id_is_dir(disk_entry->ndce_id)) {
+            if (!nffs_hash_id_is_inode(disk_entry->ndce_link)) {
+                return FS_ECORRUPT;
+            }
+            child = nffs_hash_find_inode(disk_entry->ndce_link);
+            if (child == NULL) {
+                return FS_ECORRUPT;
+            }
+            SLIST_FIRST(&inode_entry->nie_child_list) = child;
+        } else {
+            if (!nffs_hash_id_is_block(disk_entry->ndce_link)) {
+                return FS_ECORRUPT;
+            }
+            block = nffs_hash_find_block(disk_entry->ndce_link);
+            if (block == NULL) {
+                return FS_ECORRUPT;
+            }
+            inode_entry->nie_last_block_entry = block;
+        }
+    }
+
+    if (disk_entry->ndce_sibling != NFFS_ID_NONE) {
+        if (!nffs_hash_id_is_inode(disk_entry->ndce_sibling)) {
+            return FS_ECORRUPT;
+        }
+        sibling = nffs_hash_find_inode(disk_entry->ndce_sibling);
+        if (sibling == NULL) {
+            return FS_ECORRUPT;
+        }
+        SLIST_NEXT(inode_entry, nie_sibling_next) = sibling;
+    }
+
+    return 0;
+}
+
+/**
+ * Loads the RAM representation from the checkpoint in the scratch area.  On
+ * success, the write offset of each area is set to where the checkpoint left
+ * off; the caller must restore the objects written after that point.  The
+ * area headers must already have been read.
+ *
+ * @param out_block_max_data_sz On success, the maximum data block size in
+ *                                  effect when the checkpoint was written gets
+ *                                  written here.
+ *
+ * @return                      0 on success;
+ *                              FS_ENOENT if there is no checkpoint;
+ *                              FS_ECORRUPT if the checkpoint is invalid or
+ *                                  stale; the RAM state is unchanged;
+ *                              other nonzero on failure, in which case the
+ *                                  RAM state is partially populated.
+ */
+int
+nffs_ckpt_restore(uint16_t *out_block_max_data_sz)
+{
+    struct nffs_disk_ckpt_entry disk_entry;
+    struct nffs_disk_ckpt_area disk_area;
+    struct nffs_ckpt_cursor cursor;
+    struct nffs_disk_ckpt disk_ckpt;
+    struct nffs_area *scratch;
+    uint32_t entries_offset;
+    uint32_t end;
+    uint32_t i;
+    int pass;
+    int rc;
+
+    if (nffs_scratch_area_idx == NFFS_AREA_ID_NONE) {
+        return FS_ENOENT;
+    }
+    scratch = nffs_areas + nffs_scratch_area_idx;
+
+    /* The restore process marks a scratch area that has anything written
+     * after its header as full, so that it gets erased before it is used.
+     */
+    if (scratch->na_cur <= NFFS_AREA_OFFSET_ID) {
+        return FS_ENOENT;
+    }
+
+    rc = nffs_ckpt_validate(&disk_ckpt, &end);
+    if (rc != 0) {
+        return rc;
+    }
+    scratch->na_cur = end;
+
+    memset(&cursor, 0, sizeof cursor);
+    cursor.nck_offset = sizeof (struct nffs_disk_area) + sizeof disk_ckpt;
+    for (i = 0; i < nffs_num_areas; i++) {
+        rc = nffs_ckpt_read(&cursor, &disk_area, sizeof disk_area);
+        if (rc != 0) {
+            return rc;
+        }
+        if (i != nffs_scratch_area_idx) {
+            nffs_areas[i].na_cur = disk_area.ndca_cur;
+        }
+    }
+    entries_offset = cursor.nck_offset;
+
+    /* Create every entry first, then link them together. */
+    for (pass = 0; pass < 2; pass++) {
+        cursor.nck_offset = entries_offset;
+        for (i = 0; i < disk_ckpt.ndc_num_entries; i++) {
+            rc = nffs_ckpt_read(&cursor, &disk_entry, sizeof disk_entry);
+            if (rc != 0) {
+                return rc;
+            }
+
+            if (pass == 0) {
+                rc = nffs_ckpt_restore_entry(&disk_entry);
+            } else {
+                rc = nffs_ckpt_restore_links(&disk_entry);
+            }
+            if (rc != 0) {
+                return rc;
+            }
+        }
+    }
+
+    nffs_root_dir = nffs_hash_find_inode(NFFS_ID_ROOT_DIR);
+    if (nffs_root_dir == NULL) {
+        return FS_ECORRUPT;
+    }
+
+    nffs_hash_next_dir_id = disk_ckpt.ndc_next_dir_id;
+    nffs_hash_next_file_id = disk_ckpt.ndc_next_file_id;
+    nffs_hash_next_block_id = disk_ckpt.ndc_next_block_id;
+    *out_block_max_data_sz = disk_ckpt.ndc_block_max_data_sz;
+
+    return 0;
+}
@@ -17,6 +17,7 @@
  * under the License.
  */
 
+#include "os/os.h"
 #include "nffs/nffs.h"
 
 struct nffs_config nffs_config;
@@ -28,6 +29,11 @@ const struct nffs_config nffs_config_dflt = {
     .nc_num_cache_inodes = 4,
     .nc_num_cache_blocks = 64,
     .nc_num_dirs = 4,
+    .nc_cache_readahead = 4,
+    .nc_gc_step_slots = 32,
+    .nc_write_buf_itvl = OS_TICKS_PER_SEC,
+    .nc_write_lock_blocks = 4,
+    .nc_task_itvl = OS_TICKS_PER_SEC / 10,
 };
 
 void
@@ -51,4 +57,20 @@ nffs_config_init(void)
     if (nffs_config.nc_num_dirs == 0) {
         nffs_config.nc_num_dirs = nffs_config_dflt.nc_num_dirs;
     }
+    if (nffs_config.nc_cache_readahead == 0) {
+        nffs_config.nc_cache_readahead = nffs_config_dflt.nc_cache_readahead;
+    }
+    if (nffs_config.nc_gc_step_slots == 0) {
+        nffs_config.nc_gc_step_slots = nffs_config_dflt.nc_gc_step_slots;
+    }
+    if (nffs_config.nc_write_buf_itvl == 0) {
+        nffs_config.nc_write_buf_itvl = nffs_config_dflt.nc_write_buf_itvl;
+    }
+    if (nffs_config.nc_write_lock_blocks == 0) {
+        nffs_config.nc_write_lock_blocks =
+            nffs_config_dflt.nc_write_lock_blocks;
+    }
+    if (nffs_config.nc_task_itvl == 0) {
+        nffs_config.nc_task_itvl = nffs_config_dflt.nc_task_itvl;
+    }
 }
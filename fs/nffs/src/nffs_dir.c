@@ -22,6 +22,9 @@
 #include "nffs_priv.h"
 #include "nffs/nffs.h"
 
+/* Holds one filename while a batch read fills in the cursor. */
+static char nffs_dir_name_buf[NFFS_FILENAME_MAX_LEN + 1];
+
 static struct nffs_dir *
 nffs_dir_alloc(void)
 {
@@ -109,6 +112,144 @@ nffs_dir_read(struct nffs_dir *dir, struct nffs_dirent **out_dirent)
     return 0;
 }
 
+/**
+ * Finds the child of the directory that follows the cursor position.
+ * Children are kept sorted by name, so this is the first child whose name
+ * sorts after the cursor name.  If the last returned entry is still in
+ * place, its successor is used directly instead of scanning the list.
+ */
+static int
+nffs_dir_cursor_seek(struct nffs_dir *dir, const struct fs_dir_cursor *cursor,
+                     struct nffs_inode_entry **out_next)
+{
+    struct nffs_inode_entry *parent;
+    struct nffs_inode_entry *cur;
+    struct nffs_inode inode;
+    int cmp;
+    int rc;
+
+    parent = dir->nd_parent_inode_entry;
+    if (cursor->fdc_name_len == 0) {
+        *out_next = SLIST_FIRST(&parent->nie_child_list);
+        return 0;
+    }
+
+    if (nffs_hash_id_is_inode(cursor->fdc_hint)) {
+        cur = nffs_hash_find_inode(cursor->fdc_hint);
+        if (cur != NULL &&
+            nffs_inode_getflags(cur, NFFS_INODE_FLAG_INTREE)) {
+
+            rc = nffs_inode_from_entry(&inode, cur);
+            if (rc == 0 && inode.ni_parent == parent) {
+                rc = nffs_inode_filename_cmp_ram(&inode, cursor->fdc_name,
+                                                 cursor->fdc_name_len, &cmp);
+                if (rc != 0) {
+                    return rc;
+                }
+                if (cmp == 0) {
+                    *out_next = SLIST_NEXT(cur, nie_sibling_next);
+                    return 0;
+                }
+            }
+        }
+    }
+
+    SLIST_FOREACH(cur, &parent->nie_child_list, nie_sibling_next) {
+        rc = nffs_inode_from_entry(&inode, cur);
+        if (rc != 0) {
+            return rc;
+        }
+
+        rc = nffs_inode_filename_cmp_ram(&inode, cursor->fdc_name,
+                                         cursor->fdc_name_len, &cmp);
+        if (rc != 0) {
+            return rc;
+        }
+
+        if (cmp > 0) {
+            break;
+        }
+    }
+
+    *out_next = cur;
+    return 0;
+}
+
+/**
+ * Reads up to max_entries directory entries, starting after the cursor
+ * position, and advances the cursor past them.
+ *
+ * @return                      0 if at least one entry was read;
+ *                              FS_ENOENT if there are no more entries;
+ *                              other nonzero on error.
+ */
+int
+nffs_dir_read_batch(struct nffs_dir *dir, struct fs_dir_cursor *cursor,
+                    struct fs_dirent_info *entries, int max_entries,
+                    int *out_cnt)
+{
+    struct nffs_inode_entry *child;
+    struct fs_dirent_info *info;
+    uint32_t id;
+    uint8_t name_len;
+    int cnt;
+    int rc;
+
+    *out_cnt = 0;
+
+    rc = nffs_dir_cursor_seek(dir, cursor, &child);
+    if (rc != 0) {
+        return rc;
+    }
+
+    for (cnt = 0; cnt < max_entries && child != NULL; cnt++) {
+        info = entries + cnt;
+        id = child->nie_hash_entry.nhe_id;
+
+        /* Full name goes to the cursor, then a prefix of it to the entry. */
+        rc = nffs_inode_read_filename(child, sizeof cursor->fdc_name + 1,
+                                      nffs_dir_name_buf, &name_len);
+        if (rc != 0) {
+            break;
+        }
+        if (name_len > FS_CURSOR_NAME_MAX) {
+            name_len = FS_CURSOR_NAME_MAX;
+        }
+
+        info->fdi_is_dir = nffs_hash_id_is_dir(id);
+        if (info->fdi_is_dir) {
+            info->fdi_size = 0;
+        } else {
+            rc = nffs_inode_data_len(child, &info->fdi_size);
+            if (rc != 0) {
+                break;
+            }
+        }
+        info->fdi_name_len = name_len;
+        if (name_len > FS_DIRENT_INFO_NAME_MAX) {
+            name_len = FS_DIRENT_INFO_NAME_MAX;
+        }
+        memcpy(info->fdi_name, nffs_dir_name_buf, name_len);
+        info->fdi_name[name_len] = '\0';
+
+        memcpy(cursor->fdc_name, nffs_dir_name_buf, info->fdi_name_len);
+        cursor->fdc_name_len = info->fdi_name_len;
+        cursor->fdc_hint = id;
+
+        child = SLIST_NEXT(child, nie_sibling_next);
+    }
+
+    *out_cnt = cnt;
+    if (rc != 0) {
+        return rc;
+    }
+    if (cnt == 0) {
+        return FS_ENOENT;
+    }
+
+    return 0;
+}
+
 int
 nffs_dir_close(struct nffs_dir *dir)
 {
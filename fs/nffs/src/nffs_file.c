@@ -41,6 +41,13 @@ nffs_file_free(struct nffs_file *file)
     int rc;
 
     if (file != NULL) {
+        if (file->nf_wb_buf != NULL) {
+            rc = os_memblock_put(&nffs_wb_pool, file->nf_wb_buf);
+            if (rc != 0) {
+                return FS_EOS;
+            }
+        }
+
         rc = os_memblock_put(&nffs_file_pool, file);
         if (rc != 0) {
             return FS_EOS;
@@ -114,9 +121,15 @@ nffs_file_new(struct nffs_inode_entry *parent, const char *filename,
     inode_entry->nie_refcnt = 1;
     inode_entry->nie_last_block_entry = NULL;
 
+    rc = nffs_hash_insert(&inode_entry->nie_hash_entry);
+    if (rc != 0) {
+        goto err;
+    }
+
     if (parent != NULL) {
         rc = nffs_inode_add_child(parent, inode_entry);
         if (rc != 0) {
+            nffs_hash_remove(&inode_entry->nie_hash_entry);
             goto err;
         }
     } else {
@@ -124,7 +137,6 @@ nffs_file_new(struct nffs_inode_entry *parent, const char *filename,
         nffs_inode_setflags(inode_entry, NFFS_INODE_FLAG_INTREE);
     }
 
-    nffs_hash_insert(&inode_entry->nie_hash_entry);
     *out_inode_entry = inode_entry;
 
     return 0;
@@ -211,9 +223,18 @@ nffs_file_open(struct nffs_file **out_file, const char *path,
             goto err;
         }
 
-        if (access_flags & FS_ACCESS_TRUNCATE) {
-            /* The user is truncating the file.  Unlink the old file and create
-             * a new one in its place.
+        if (access_flags & FS_ACCESS_TRUNCATE && inode->nie_refcnt <= 1) {
+            /* The user is truncating a file which is not open elsewhere.
+             * Drop its data and keep the inode.
+             */
+            rc = nffs_inode_truncate(inode);
+            if (rc != 0) {
+                goto err;
+            }
+            file->nf_inode_entry = inode;
+        } else if (access_flags & FS_ACCESS_TRUNCATE) {
+            /* Other handles keep the old contents.  Unlink the old file and
+             * create a new one in its place.
              */
             nffs_path_unlink(path);
             rc = nffs_file_new(parent, parser.npp_token, parser.npp_token_len,
@@ -243,6 +264,11 @@ nffs_file_open(struct nffs_file **out_file, const char *path,
     nffs_inode_inc_refcnt(file->nf_inode_entry);
     file->nf_access_flags = access_flags;
 
+    /* Small writes get coalesced if there is a write-back buffer to spare. */
+    if (access_flags & FS_ACCESS_WRITE && nffs_config.nc_write_buf_size > 0) {
+        file->nf_wb_buf = os_memblock_get(&nffs_wb_pool);
+    }
+
     *out_file = file;
 
     return 0;
@@ -268,6 +294,11 @@ nffs_file_seek(struct nffs_file *file, uint32_t offset)
     uint32_t len;
     int rc;
 
+    rc = nffs_write_flush(file);
+    if (rc != 0) {
+        return rc;
+    }
+
     rc = nffs_inode_data_len(file->nf_inode_entry, &len);
     if (rc != 0) {
         return rc;
@@ -309,6 +340,11 @@ nffs_file_read(struct nffs_file *file, uint32_t len, void *out_data,
         return FS_EACCESS;
     }
 
+    rc = nffs_write_flush(file);
+    if (rc != 0) {
+        return rc;
+    }
+
     rc = nffs_inode_read(file->nf_inode_entry, file->nf_offset, len, out_data,
                         &bytes_read);
     if (rc != 0) {
@@ -326,7 +362,8 @@ nffs_file_read(struct nffs_file *file, uint32_t len, void *out_data,
 /**
  * Closes the specified file and invalidates the file handle.  If the file has
  * already been unlinked, and this is the last open handle to the file, this
- * operation causes the file to be deleted.
+ * operation causes the file to be deleted.  Buffered data is written to flash
+ * first; if that fails, the handle remains open.
  *
  * @param file              The file handle to close.
  *
@@ -337,6 +374,14 @@ nffs_file_close(struct nffs_file *file)
 {
     int rc;
 
+    rc = nffs_write_flush(file);
+    if (rc != 0) {
+        return rc;
+    }
+
+    nffs_prealloc_space -= file->nf_prealloc;
+    file->nf_prealloc = 0;
+
     rc = nffs_inode_dec_refcnt(file->nf_inode_entry);
     if (rc != 0) {
         return rc;
@@ -349,3 +394,70 @@ nffs_file_close(struct nffs_file *file)
 
     return 0;
 }
+
+/**
+ * Sets aside enough free space to write the specified number of bytes to a
+ * file without garbage collection.  Garbage collection is performed now, if
+ * necessary.  Until the space is used up or released, other writes leave it
+ * alone, and idle garbage collection is put off.  The estimate assumes the
+ * data gets written in full blocks, as happens when writes are large or
+ * buffered; smaller unbuffered writes use up the space sooner.
+ *
+ * @param file              The file to reserve space for.
+ * @param len               The number of bytes that will be written; 0
+ *                              releases the reservation.
+ *
+ * @return                  0 on success;
+ *                          FS_EFULL if not enough space can be freed;
+ *                          nonzero on other failure.
+ */
+int
+nffs_file_preallocate(struct nffs_file *file, uint32_t len)
+{
+    struct nffs_inode inode;
+    uint32_t block_len;
+    uint32_t num_blocks;
+    uint32_t space;
+    int rc;
+
+    if (!(file->nf_access_flags & FS_ACCESS_WRITE)) {
+        return FS_EACCESS;
+    }
+
+    /* A new reservation replaces the old one. */
+    nffs_prealloc_space -= file->nf_prealloc;
+    file->nf_prealloc = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    rc = nffs_inode_from_entry(&inode, file->nf_inode_entry);
+    if (rc != 0) {
+        return rc;
+    }
+
+    block_len = nffs_block_max_data_sz;
+    if (file->nf_wb_buf != NULL && nffs_config.nc_write_buf_size < block_len) {
+        block_len = nffs_config.nc_write_buf_size;
+    }
+
+    /* Each appended block is followed by an updated copy of the inode.
+     * Data still in the write-back buffer is on its way to flash too.
+     */
+    len += file->nf_wb_len;
+    num_blocks = (len + block_len - 1) / block_len;
+    space = len + num_blocks * (sizeof (struct nffs_disk_block) +
+                                sizeof (struct nffs_disk_inode) +
+                                inode.ni_filename_len);
+
+    rc = nffs_misc_make_space(nffs_prealloc_space + space);
+    if (rc != 0) {
+        return rc;
+    }
+
+    file->nf_prealloc = space;
+    nffs_prealloc_space += space;
+
+    return 0;
+}
@@ -63,6 +63,34 @@ nffs_flash_read(uint8_t area_idx, uint32_t area_offset, void *data,
     return 0;
 }
 
+/**
+ * Returns a pointer through which a chunk of flash can be read in place.
+ *
+ * @param area_idx              The index of the area to map.
+ * @param area_offset           The offset within the area.
+ * @param len                   The number of bytes to map.
+ *
+ * @return                      Pointer to the data; NULL if the range is
+ *                                  invalid or the flash is not
+ *                                  memory-mapped.
+ */
+const void *
+nffs_flash_mmap(uint8_t area_idx, uint32_t area_offset, uint32_t len)
+{
+    const struct nffs_area *area;
+
+    assert(area_idx < nffs_num_areas);
+
+    area = nffs_areas + area_idx;
+
+    if (area_offset + len > area->na_length) {
+        return NULL;
+    }
+
+    return hal_flash_mmap(area->na_flash_id, area->na_offset + area_offset,
+                          len);
+}
+
 /**
  * Writes a chunk of data to flash.
  *
@@ -106,6 +134,101 @@ nffs_flash_write(uint8_t area_idx, uint32_t area_offset, const void *data,
     return 0;
 }
 
+/**
+ * Lets other tasks run while an area is being erased.  Before the OS has
+ * started there is nothing else to run, so the erase simply spins.
+ */
+static void
+nffs_flash_erase_wait(void *arg)
+{
+    if (os_started()) {
+        os_time_delay(1);
+    }
+}
+
+/**
+ * Erases a run of consecutive areas with a single flash operation.  The areas
+ * must reside in the same flash device and be contiguous in it.  The calling
+ * task sleeps while the flash is busy, rather than spinning; the caller
+ * continues to hold the nffs lock.
+ *
+ * @param area_idx              The index of the first area to erase.
+ * @param num_areas             The number of areas to erase.
+ *
+ * @return                      0 on success;
+ *                              FS_EHW on flash error.
+ */
+int
+nffs_flash_erase_run(uint8_t area_idx, uint8_t num_areas)
+{
+    const struct nffs_area *first;
+    const struct nffs_area *last;
+    int rc;
+
+    assert(num_areas > 0);
+    assert(area_idx + num_areas <= nffs_num_areas);
+
+    first = nffs_areas + area_idx;
+    last = first + num_areas - 1;
+
+    assert(last->na_flash_id == first->na_flash_id);
+    assert(last->na_offset >= first->na_offset);
+
+    rc = hal_flash_erase_wait(first->na_flash_id, first->na_offset,
+                              last->na_offset + last->na_length -
+                                  first->na_offset,
+                              nffs_flash_erase_wait, NULL);
+    if (rc != 0) {
+        return FS_EHW;
+    }
+
+    return 0;
+}
+
+/**
+ * Erases an entire area.
+ *
+ * @param area_idx              The index of the area to erase.
+ *
+ * @return                      0 on success;
+ *                              FS_EHW on flash error.
+ */
+int
+nffs_flash_erase(uint8_t area_idx)
+{
+    return nffs_flash_erase_run(area_idx, 1);
+}
+
+/**
+ * Determines whether an area is entirely erased.
+ *
+ * @param area_idx              The index of the area to check.
+ * @param out_erased            On success, 1 is written here if the area is
+ *                                  erased; 0 otherwise.
+ *
+ * @return                      0 on success;
+ *                              FS_EHW on flash error.
+ */
+int
+nffs_flash_is_erased(uint8_t area_idx, int *out_erased)
+{
+    const struct nffs_area *area;
+    int rc;
+
+    assert(area_idx < nffs_num_areas);
+
+    area = nffs_areas + area_idx;
+
+    rc = hal_flash_is_erased(area->na_flash_id, area->na_offset,
+                             area->na_length);
+    if (rc < 0) {
+        return FS_EHW;
+    }
+
+    *out_erased = rc;
+    return 0;
+}
+
 /**
  * Copies a chunk of data from one region of flash to another.
  *
@@ -25,8 +25,8 @@
 
 /**
  * Turns a scratch area into a non-scratch area.  If the specified area is not
- * actually a scratch area, this function falls back to a slower full format
- * operation.
+ * actually a scratch area, or if it holds an index checkpoint, this function
+ * falls back to a slower full format operation.
  */
 int
 nffs_format_from_scratch_area(uint8_t area_idx, uint8_t area_id)
@@ -41,7 +41,9 @@ nffs_format_from_scratch_area(uint8_t area_idx, uint8_t area_id)
     }
 
     nffs_areas[area_idx].na_id = area_id;
-    if (!nffs_area_is_scratch(&disk_area)) {
+    if (!nffs_area_is_scratch(&disk_area) ||
+        nffs_areas[area_idx].na_cur > NFFS_AREA_OFFSET_ID) {
+
         rc = nffs_format_area(area_idx, 0);
         if (rc != 0) {
             return rc;
@@ -59,10 +61,10 @@ nffs_format_from_scratch_area(uint8_t area_idx, uint8_t area_id)
 }
 
 /**
- * Formats a single scratch area.
+ * Writes the header of a freshly erased area.
  */
-int
-nffs_format_area(uint8_t area_idx, int is_scratch)
+static int
+nffs_format_area_hdr(uint8_t area_idx, int is_scratch)
 {
     struct nffs_disk_area disk_area;
     struct nffs_area *area;
@@ -70,11 +72,6 @@ nffs_format_area(uint8_t area_idx, int is_scratch)
     int rc;
 
     area = nffs_areas + area_idx;
-
-    rc = hal_flash_erase(area->na_flash_id, area->na_offset, area->na_length);
-    if (rc != 0) {
-        return FS_EHW;
-    }
     area->na_cur = 0;
 
     nffs_area_to_disk(area, &disk_area);
@@ -94,9 +91,115 @@ nffs_format_area(uint8_t area_idx, int is_scratch)
     return 0;
 }
 
+/**
+ * Formats a single scratch area.
+ */
+int
+nffs_format_area(uint8_t area_idx, int is_scratch)
+{
+    int rc;
+
+    rc = nffs_flash_erase(area_idx);
+    if (rc != 0) {
+        return rc;
+    }
+    nffs_areas[area_idx].na_erase_cnt++;
+
+    STATS_INC(nffs_stats, area_erases);
+    nffs_area_update_wear_stats();
+
+    return nffs_format_area_hdr(area_idx, is_scratch);
+}
+
+/**
+ * Indicates whether the area following the specified one can be erased in the
+ * same flash operation, i.e., it directly follows it in the same device.
+ */
+static int
+nffs_format_area_adjacent(uint8_t area_idx)
+{
+    const struct nffs_area *area;
+
+    area = nffs_areas + area_idx;
+    return area_idx + 1 < nffs_num_areas &&
+           area[1].na_flash_id == area->na_flash_id &&
+           area[1].na_offset == area->na_offset + area->na_length;
+}
+
+/**
+ * Erases every area that is not already blank.  Runs of adjacent areas are
+ * erased with a single flash operation.  Areas that are already blank (e.g.,
+ * fresh from the factory) are left alone and their erase counts are not
+ * incremented.
+ *
+ * @return                  0 on success; nonzero on failure.
+ */
+static int
+nffs_format_erase_areas(void)
+{
+    int run_start;
+    int is_erased;
+    int rc;
+    int i;
+
+    run_start = -1;
+    for (i = 0; i < nffs_num_areas; i++) {
+        rc = nffs_flash_is_erased(i, &is_erased);
+        if (rc != 0) {
+            return rc;
+        }
+
+        if (!is_erased) {
+            if (run_start == -1) {
+                run_start = i;
+            }
+            nffs_areas[i].na_erase_cnt++;
+            STATS_INC(nffs_stats, area_erases);
+        }
+
+        if (run_start != -1 && (is_erased || !nffs_format_area_adjacent(i))) {
+            rc = nffs_flash_erase_run(run_start,
+                                      i - run_start + !is_erased);
+            if (rc != 0) {
+                return rc;
+            }
+            run_start = -1;
+        }
+    }
+
+    nffs_area_update_wear_stats();
+
+    return 0;
+}
+
+/**
+ * Reads the erase count from an area's existing header, so that wear history
+ * survives a reformat.  An area without a valid header is assumed to be new.
+ */
+static uint32_t
+nffs_format_read_erase_cnt(uint8_t area_idx)
+{
+    struct nffs_disk_area disk_area;
+    int rc;
+
+    rc = nffs_flash_read(area_idx, 0, &disk_area, sizeof disk_area);
+    if (rc != 0) {
+        return 0;
+    }
+
+    if (!nffs_area_magic_is_set(&disk_area) ||
+        !nffs_area_is_supported_version(&disk_area) ||
+        disk_area.nda_length != nffs_areas[area_idx].na_length) {
+
+        return 0;
+    }
+
+    return nffs_area_erase_cnt(&disk_area);
+}
+
 /**
  * Erases all the specified areas and initializes them with a clean nffs
- * file system.
+ * file system.  Areas which are already blank are not erased again.
  *
  * @param area_descs        The set of areas to format.
  *
@@ -112,19 +215,11 @@ nffs_format_full(const struct nffs_area_desc *area_descs)
     /* Start from a clean state. */
     nffs_misc_reset();
 
-    /* Select largest area to be the initial scratch area. */
-    nffs_scratch_area_idx = 0;
     for (i = 1; area_descs[i].nad_length != 0; i++) {
         if (i >= NFFS_MAX_AREAS) {
             rc = FS_EINVAL;
             goto err;
         }
-
-        if (area_descs[i].nad_length >
-            area_descs[nffs_scratch_area_idx].nad_length) {
-
-            nffs_scratch_area_idx = i;
-        }
     }
 
     rc = nffs_misc_set_num_areas(i);
@@ -138,14 +233,38 @@ nffs_format_full(const struct nffs_area_desc *area_descs)
         nffs_areas[i].na_flash_id = area_descs[i].nad_flash_id;
         nffs_areas[i].na_cur = 0;
         nffs_areas[i].na_gc_seq = 0;
+        nffs_areas[i].na_erase_cnt = nffs_format_read_erase_cnt(i);
+    }
+
+    /* Select largest area to be the initial scratch area.  Among areas of
+     * equal size, pick the least worn.
+     */
+    nffs_scratch_area_idx = 0;
+    for (i = 1; i < nffs_num_areas; i++) {
+        if (nffs_areas[i].na_length >
+                nffs_areas[nffs_scratch_area_idx].na_length ||
+            (nffs_areas[i].na_length ==
+                nffs_areas[nffs_scratch_area_idx].na_length &&
+             nffs_areas[i].na_erase_cnt <
+                nffs_areas[nffs_scratch_area_idx].na_erase_cnt)) {
+
+            nffs_scratch_area_idx = i;
+        }
+    }
 
+    rc = nffs_format_erase_areas();
+    if (rc != 0) {
+        goto err;
+    }
+
+    for (i = 0; i < nffs_num_areas; i++) {
         if (i == nffs_scratch_area_idx) {
             nffs_areas[i].na_id = NFFS_AREA_ID_NONE;
         } else {
             nffs_areas[i].na_id = i;
         }
 
-        rc = nffs_format_area(i, i == nffs_scratch_area_idx);
+        rc = nffs_format_area_hdr(i, i == nffs_scratch_area_idx);
         if (rc != 0) {
             goto err;
         }
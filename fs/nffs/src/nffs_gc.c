@@ -31,6 +31,26 @@
  */
 unsigned int nffs_gc_count;
 
+/**
+ * The index of the source area of an unfinished incremental garbage
+ * collection cycle, or NFFS_AREA_ID_NONE if no cycle is in progress.  While a
+ * cycle is in progress, the scratch area is the destination area and must not
+ * be used for anything else.
+ */
+uint8_t nffs_gc_area_idx = NFFS_AREA_ID_NONE;
+
+/** The next hash table slot the incremental cycle will process. */
+static uint32_t nffs_gc_next_slot;
+
+/** The hash table size when nffs_gc_next_slot was last updated. */
+static uint32_t nffs_gc_hash_size;
+
+/** Consecutive idle-time cycles that did not reclaim any space. */
+static uint8_t nffs_gc_idle_fruitless;
+
+/** Bytes written to non-scratch areas after the last idle-time cycle. */
+static uint32_t nffs_gc_idle_used;
+
 static int
 nffs_gc_copy_object(struct nffs_hash_entry *entry, uint16_t object_size,
                     uint8_t to_area_idx)
@@ -78,7 +98,30 @@ nffs_gc_copy_inode(struct nffs_inode_entry *inode_entry, uint8_t to_area_idx)
 }
 
 /**
- * Selects the most appropriate area for garbage collection.
+ * Compares the wear of two areas.  Erase counts that differ by less than
+ * NFFS_GC_WEAR_THRESHOLD are considered equal, so that areas are normally
+ * collected in round-robin order.
+ *
+ * @return                  <0 if a is less worn than b;
+ *                          >0 if a is more worn than b;
+ *                          0 if their wear is about the same.
+ */
+static int
+nffs_gc_wear_diff(const struct nffs_area *a, const struct nffs_area *b)
+{
+    if (a->na_erase_cnt + NFFS_GC_WEAR_THRESHOLD <= b->na_erase_cnt) {
+        return -1;
+    }
+    if (b->na_erase_cnt + NFFS_GC_WEAR_THRESHOLD <= a->na_erase_cnt) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Selects the most appropriate area for garbage collection.  Larger areas are
+ * preferred, then areas that are significantly less worn, then areas that
+ * were collected least recently.
  *
  * @return                  The ID of the area to garbage collect.
  */
@@ -101,6 +144,13 @@ nffs_gc_select_area(void)
             best_area_idx = i;
         } else if (best_area_idx == nffs_scratch_area_idx) {
             best_area_idx = i;
+        } else if (nffs_gc_wear_diff(area, nffs_areas + best_area_idx) != 0) {
+            /* Prefer the least worn area.  The collected area gets erased
+             * at the end of the cycle, so this evens out the erase counts.
+             */
+            if (nffs_gc_wear_diff(area, nffs_areas + best_area_idx) < 0) {
+                best_area_idx = i;
+            }
         } else {
             diff = nffs_areas[i].na_gc_seq -
                    nffs_areas[best_area_idx].na_gc_seq;
@@ -396,6 +446,158 @@ nffs_gc_inode_blocks(struct nffs_inode_entry *inode_entry,
     return 0;
 }
 
+/**
+ * Starts a garbage collection cycle: selects the source area and turns the
+ * scratch area into the destination area.
+ */
+static int
+nffs_gc_start(void)
+{
+    uint8_t from_area_idx;
+    int rc;
+
+    from_area_idx = nffs_gc_select_area();
+
+    rc = nffs_format_from_scratch_area(nffs_scratch_area_idx,
+                                       nffs_areas[from_area_idx].na_id);
+    if (rc != 0) {
+        return rc;
+    }
+
+    nffs_gc_area_idx = from_area_idx;
+    nffs_gc_next_slot = 0;
+    nffs_gc_hash_size = nffs_hash_size;
+
+    return 0;
+}
+
+/**
+ * Copies the objects resident in the source area of the current cycle to the
+ * destination area, processing at most max_slots hash table slots.
+ *
+ * @param max_slots             The maximum number of slots to process.
+ * @param out_done              On success, indicates whether every slot has
+ *                                  been processed.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+static int
+nffs_gc_copy_slots(uint32_t max_slots, int *out_done)
+{
+    struct nffs_inode_entry *inode_entry;
+    struct nffs_hash_entry *entry;
+    uint32_t area_offset;
+    uint8_t area_idx;
+    int rc;
+
+    /* If the hash table was resized since the last step, the slot index is
+     * meaningless; start over.  Objects that were already copied are no
+     * longer in the source area, so they do not get copied twice.
+     */
+    if (nffs_gc_hash_size != nffs_hash_size) {
+        nffs_gc_next_slot = 0;
+        nffs_gc_hash_size = nffs_hash_size;
+    }
+
+    /* Removing entries leaves tombstones in the hash table, so the blocks
+     * that get collated away do not disturb the iteration.
+     */
+    while (max_slots > 0 && nffs_gc_next_slot < nffs_hash_size) {
+        entry = nffs_hash[nffs_gc_next_slot].nhs_entry;
+        nffs_gc_next_slot++;
+        max_slots--;
+
+        if (entry == NULL || !nffs_hash_id_is_inode(entry->nhe_id)) {
+            continue;
+        }
+
+        /* The inode gets copied if it is in the source area. */
+        nffs_flash_loc_expand(entry->nhe_flash_loc, &area_idx, &area_offset);
+        inode_entry = (struct nffs_inode_entry *)entry;
+        if (area_idx == nffs_gc_area_idx) {
+            rc = nffs_gc_copy_inode(inode_entry, nffs_scratch_area_idx);
+            if (rc != 0) {
+                return rc;
+            }
+        }
+
+        /* If the inode is a file, all constituent data blocks that are
+         * resident in the source area get copied.
+         */
+        if (nffs_hash_id_is_file(entry->nhe_id)) {
+            rc = nffs_gc_inode_blocks(inode_entry, nffs_gc_area_idx,
+                                      nffs_scratch_area_idx, NULL);
+            if (rc != 0) {
+                return rc;
+            }
+        }
+    }
+
+    *out_done = nffs_gc_next_slot >= nffs_hash_size;
+
+    return 0;
+}
+
+/**
+ * Completes the current garbage collection cycle by turning the source area
+ * into the new scratch area.
+ */
+static int
+nffs_gc_finish(uint8_t *out_area_idx)
+{
+    struct nffs_area *from_area;
+    struct nffs_area *to_area;
+    uint8_t from_area_idx;
+    int rc;
+
+    from_area_idx = nffs_gc_area_idx;
+    from_area = nffs_areas + from_area_idx;
+    to_area = nffs_areas + nffs_scratch_area_idx;
+
+    /* The amount of written data should never increase as a result of a gc
+     * cycle.
+     */
+    assert(to_area->na_cur <= from_area->na_cur);
+
+    /* Turn the source area into the new scratch area. */
+    from_area->na_gc_seq++;
+    rc = nffs_format_area(from_area_idx, 1);
+    if (rc != 0) {
+        return rc;
+    }
+
+    if (out_area_idx != NULL) {
+        *out_area_idx = nffs_scratch_area_idx;
+    }
+
+    nffs_scratch_area_idx = from_area_idx;
+    nffs_gc_area_idx = NFFS_AREA_ID_NONE;
+
+    /* Garbage collection renders the cache invalid:
+     *     o All cached blocks are now invalid; drop them.
+     *     o Flash locations of inodes may have changed; the cached inodes need
+     *       updated to reflect this.
+     */
+    rc = nffs_cache_inode_refresh();
+    if (rc != 0) {
+        return rc;
+    }
+
+    /* Increment the garbage collection counter so that client code knows to
+     * reset its pointers to cached objects.
+     */
+    nffs_gc_count++;
+
+    /* The new scratch area is empty; use it to hold an index checkpoint.  A
+     * failure here only means the next mount does a full scan.
+     */
+    if (nffs_config.nc_gc_checkpoint) {
+        nffs_ckpt_write();
+    }
+
+    return 0;
+}
+
 /**
  * Triggers a garbage collection cycle.  This is implemented as follows:
  *
@@ -438,6 +640,9 @@ nffs_gc_inode_blocks(struct nffs_inode_entry *inode_entry,
  *     occurred.  This is done by inspecting the nffs_gc_count variable before
  *     and after calling the function.
  *
+ *     If an incremental cycle started by nffs_gc_idle_step() is in progress,
+ *     this function completes it rather than starting a new one.
+ *
  * @param out_area_idx      On success, the ID of the cleaned up area gets
  *                              written here.  Pass null if you do not need
  *                              this information.
@@ -447,97 +652,161 @@ nffs_gc_inode_blocks(struct nffs_inode_entry *inode_entry,
 int
 nffs_gc(uint8_t *out_area_idx)
 {
-    struct nffs_hash_entry *entry;
-    struct nffs_hash_entry *next;
-    struct nffs_area *from_area;
-    struct nffs_area *to_area;
-    struct nffs_inode_entry *inode_entry;
-    uint32_t area_offset;
-    uint8_t from_area_idx;
-    uint8_t area_idx;
+    int done;
     int rc;
-    int i;
 
-    from_area_idx = nffs_gc_select_area();
-    from_area = nffs_areas + from_area_idx;
-    to_area = nffs_areas + nffs_scratch_area_idx;
+    /* Complete an unfinished incremental cycle rather than start over. */
+    if (nffs_gc_area_idx == NFFS_AREA_ID_NONE) {
+        rc = nffs_gc_start();
+        if (rc != 0) {
+            return rc;
+        }
+    }
 
-    rc = nffs_format_from_scratch_area(nffs_scratch_area_idx,
-                                       from_area->na_id);
+    rc = nffs_gc_copy_slots(UINT32_MAX, &done);
     if (rc != 0) {
         return rc;
     }
+    assert(done);
 
-    for (i = 0; i < NFFS_HASH_SIZE; i++) {
-        entry = SLIST_FIRST(nffs_hash + i);
-        while (entry != NULL) {
-            next = SLIST_NEXT(entry, nhe_next);
-
-            if (nffs_hash_id_is_inode(entry->nhe_id)) {
-                /* The inode gets copied if it is in the source area. */
-                nffs_flash_loc_expand(entry->nhe_flash_loc,
-                                      &area_idx, &area_offset);
-                inode_entry = (struct nffs_inode_entry *)entry;
-                if (area_idx == from_area_idx) {
-                    rc = nffs_gc_copy_inode(inode_entry,
-                                            nffs_scratch_area_idx);
-                    if (rc != 0) {
-                        return rc;
-                    }
-                }
+    return nffs_gc_finish(out_area_idx);
+}
 
-                /* If the inode is a file, all constituent data blocks that are
-                 * resident in the source area get copied.
-                 */
-                if (nffs_hash_id_is_file(entry->nhe_id)) {
-                    rc = nffs_gc_inode_blocks(inode_entry, from_area_idx,
-                                              nffs_scratch_area_idx, &next);
-                    if (rc != 0) {
-                        return rc;
-                    }
-                }
-            }
+/**
+ * Indicates whether the non-scratch areas are short of free space; i.e.,
+ * whether they have less than nc_gc_free_areas areas' worth of free space
+ * left.
+ */
+static int
+nffs_gc_space_is_low(void)
+{
+    uint32_t total_len;
+    uint32_t free_space;
+    uint32_t wanted;
+    int i;
 
-            entry = next;
+    total_len = 0;
+    free_space = 0;
+    for (i = 0; i < nffs_num_areas; i++) {
+        if (i != nffs_scratch_area_idx) {
+            total_len += nffs_areas[i].na_length;
+            free_space += nffs_area_free_space(nffs_areas + i);
         }
     }
 
-    /* The amount of written data should never increase as a result of a gc
-     * cycle.
-     */
-    assert(to_area->na_cur <= from_area->na_cur);
+    wanted = nffs_config.nc_gc_free_areas * (total_len / (nffs_num_areas - 1));
+    return free_space < wanted;
+}
 
-    /* Turn the source area into the new scratch area. */
-    from_area->na_gc_seq++;
-    rc = nffs_format_area(from_area_idx, 1);
+/**
+ * Performs a bounded amount of garbage collection work.  This is intended to
+ * be called periodically while the system is otherwise idle.  Each call
+ * either:
+ *     o Starts a new cycle, if the free space in the non-scratch areas has
+ *       fallen below nc_gc_free_areas areas' worth;
+ *     o Copies the live objects referenced by at most max_slots hash table
+ *       slots out of the area being collected; or
+ *     o Completes the current cycle by turning the collected area into the
+ *       new scratch area.
+ *
+ * Objects written between steps go to the other areas, so regular file
+ * system operations may be interleaved freely with calls to this function.
+ * If one of them needs to garbage collect synchronously, it completes the
+ * unfinished cycle first.
+ *
+ * Once enough cycles have passed without reclaiming any space (every area is
+ * full of live data), no new cycle is started until the amount of written
+ * data changes.  Nothing is done while any file holds preallocated space.
+ *
+ * @param max_slots             The maximum number of hash table slots to
+ *                                  process.
+ *
+ * @return                      0 on success; nonzero on failure.  On
+ *                                  success, nffs_gc_area_idx indicates
+ *                                  whether a cycle is still in progress.
+ */
+int
+nffs_gc_idle_step(uint32_t max_slots)
+{
+    uint32_t used;
+    int done;
+    int rc;
+
+    if (nffs_prealloc_space > 0) {
+        return 0;
+    }
+
+    if (nffs_gc_area_idx == NFFS_AREA_ID_NONE) {
+        if (nffs_config.nc_gc_free_areas == 0 || nffs_num_areas < 2) {
+            return 0;
+        }
+
+        used = nffs_misc_used_space();
+        if (used != nffs_gc_idle_used) {
+            nffs_gc_idle_fruitless = 0;
+        }
+        if (nffs_gc_idle_fruitless >= nffs_num_areas - 1) {
+            return 0;
+        }
+
+        if (!nffs_gc_space_is_low()) {
+            return 0;
+        }
+
+        nffs_gc_idle_used = used;
+        rc = nffs_gc_start();
+        if (rc != 0) {
+            return rc;
+        }
+
+        return 0;
+    }
+
+    rc = nffs_gc_copy_slots(max_slots, &done);
     if (rc != 0) {
         return rc;
     }
 
-    if (out_area_idx != NULL) {
-        *out_area_idx = nffs_scratch_area_idx;
-    }
+    if (!done) {
+        /* Cached blocks may refer to objects that were just moved. */
+        rc = nffs_cache_inode_refresh();
+        if (rc != 0) {
+            return rc;
+        }
 
-    nffs_scratch_area_idx = from_area_idx;
+        return 0;
+    }
 
-    /* Garbage collection renders the cache invalid:
-     *     o All cached blocks are now invalid; drop them.
-     *     o Flash locations of inodes may have changed; the cached inodes need
-     *       updated to reflect this.
-     */
-    rc = nffs_cache_inode_refresh();
+    rc = nffs_gc_finish(NULL);
     if (rc != 0) {
         return rc;
     }
 
-    /* Increment the garbage collection counter so that client code knows to
-     * reset its pointers to cached objects.
-     */
-    nffs_gc_count++;
+    used = nffs_misc_used_space();
+    if (used < nffs_gc_idle_used) {
+        nffs_gc_idle_fruitless = 0;
+    } else if (nffs_gc_idle_fruitless < UINT8_MAX) {
+        nffs_gc_idle_fruitless++;
+    }
+    nffs_gc_idle_used = used;
 
     return 0;
 }
 
+/**
+ * Abandons any unfinished incremental garbage collection cycle.  This must be
+ * called whenever the RAM representation is discarded.
+ */
+void
+nffs_gc_reset(void)
+{
+    nffs_gc_area_idx = NFFS_AREA_ID_NONE;
+    nffs_gc_next_slot = 0;
+    nffs_gc_hash_size = 0;
+    nffs_gc_idle_fruitless = 0;
+    nffs_gc_idle_used = 0;
+}
+
 /**
  * Repeatedly performs garbage collection cycles until there is enough free
  * space to accommodate an object of the specified size.  If there still isn't
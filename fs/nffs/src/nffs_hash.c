@@ -20,15 +20,46 @@
 #include <stddef.h>
 #include <string.h>
 #include <assert.h>
+#include "os/os_malloc.h"
 #include "nffs/nffs.h"
 #include "nffs_priv.h"
 
-struct nffs_hash_list *nffs_hash;
+/*
+ * The hash table is open-addressed with linear probing.  Each slot holds an
+ * object ID next to the pointer to its entry, so a probe sequence is a walk
+ * over contiguous memory that only dereferences the entry that matches.
+ *
+ * Removed entries leave a tombstone (an ID with a NULL entry) behind so that
+ * entries further along the probe sequence stay reachable, and so that
+ * removing entries while iterating over the table is safe.  Tombstones are
+ * reused by later inserts and dropped when the table is rebuilt.
+ *
+ * The table grows by doubling when more than three quarters of its slots are
+ * in use.  After a full restore it is rebuilt to fit the objects that were
+ * found.
+ */
+
+struct nffs_hash_slot *nffs_hash;
+
+/** Number of slots; always a power of two. */
+uint32_t nffs_hash_size;
+
+/** Number of entries in the table. */
+uint32_t nffs_hash_count;
+
+/** Number of slots holding an entry or a tombstone. */
+static uint32_t nffs_hash_used;
+
+/** Log2 of nffs_hash_size. */
+static uint8_t nffs_hash_bits;
 
 uint32_t nffs_hash_next_dir_id;
 uint32_t nffs_hash_next_file_id;
 uint32_t nffs_hash_next_block_id;
 
+#define NFFS_HASH_SLOT_IS_EMPTY(slot)   ((slot)->nhs_id == NFFS_HASH_ENTRY_NONE)
+#define NFFS_HASH_OVER_LOAD(used, size) ((used) * 4 > (size) * 3)
+
 int
 nffs_hash_id_is_dir(uint32_t id)
 {
@@ -53,57 +84,129 @@ nffs_hash_id_is_block(uint32_t id)
     return id >= NFFS_ID_BLOCK_MIN && id < NFFS_ID_BLOCK_MAX;
 }
 
-static int
+/**
+ * Fibonacci hashing: IDs are allocated sequentially from three ranges, and
+ * the multiply spreads each range evenly over the table.
+ */
+static uint32_t
 nffs_hash_fn(uint32_t id)
 {
-    return id % NFFS_HASH_SIZE;
+    return (id * 2654435769u) >> (32 - nffs_hash_bits);
 }
 
-static struct nffs_hash_entry *
-nffs_hash_find_reorder(uint32_t id)
+static struct nffs_hash_slot *
+nffs_hash_find_slot(uint32_t id)
 {
-    struct nffs_hash_entry *entry;
-    struct nffs_hash_entry *prev;
-    struct nffs_hash_list *list;
-    int idx;
-
-    idx = nffs_hash_fn(id);
-    list = nffs_hash + idx;
-
-    prev = NULL;
-    SLIST_FOREACH(entry, list, nhe_next) {
-        if (entry->nhe_id == id) {
-            /* Put entry at the front of the list. */
-            if (prev != NULL) {
-                SLIST_NEXT(prev, nhe_next) = SLIST_NEXT(entry, nhe_next);
-                SLIST_INSERT_HEAD(list, entry, nhe_next);
-            }
-            return entry;
+    struct nffs_hash_slot *slot;
+    uint32_t mask;
+    uint32_t idx;
+
+    mask = nffs_hash_size - 1;
+    for (idx = nffs_hash_fn(id); ; idx = (idx + 1) & mask) {
+        slot = nffs_hash + idx;
+        if (NFFS_HASH_SLOT_IS_EMPTY(slot)) {
+            return NULL;
         }
+        if (slot->nhs_id == id && slot->nhs_entry != NULL) {
+            return slot;
+        }
+    }
+}
 
-        prev = entry;
+/**
+ * Places an entry in a table known not to contain it, reusing the first
+ * tombstone on its probe sequence if there is one.
+ */
+static void
+nffs_hash_place(struct nffs_hash_entry *entry)
+{
+    struct nffs_hash_slot *slot;
+    uint32_t mask;
+    uint32_t idx;
+
+    mask = nffs_hash_size - 1;
+    for (idx = nffs_hash_fn(entry->nhe_id); ; idx = (idx + 1) & mask) {
+        slot = nffs_hash + idx;
+        if (slot->nhs_entry == NULL) {
+            break;
+        }
     }
 
-    return NULL;
+    if (NFFS_HASH_SLOT_IS_EMPTY(slot)) {
+        nffs_hash_used++;
+    }
+    slot->nhs_id = entry->nhe_id;
+    slot->nhs_entry = entry;
+    nffs_hash_count++;
 }
 
-struct nffs_hash_entry *
-nffs_hash_find(uint32_t id)
+/**
+ * Rebuilds the hash table with room for at least the specified number of
+ * entries, dropping all tombstones.  The table keeps at least
+ * NFFS_HASH_MIN_SIZE slots.
+ *
+ * @param min_count             The number of entries to make room for.
+ *
+ * @return                      0 on success; FS_ENOMEM on failure, in which
+ *                                  case the table is left unchanged.
+ */
+int
+nffs_hash_resize(uint32_t min_count)
 {
-    struct nffs_hash_entry *entry;
-    struct nffs_hash_list *list;
-    int idx;
+    struct nffs_hash_slot *old_hash;
+    uint32_t old_size;
+    uint32_t size;
+    uint32_t i;
+    uint8_t bits;
+
+    /* Size the table to be at most half full. */
+    bits = 0;
+    size = 1;
+    while (size < NFFS_HASH_MIN_SIZE || size < min_count * 2) {
+        size <<= 1;
+        bits++;
+    }
 
-    idx = nffs_hash_fn(id);
-    list = nffs_hash + idx;
+    old_hash = nffs_hash;
+    old_size = nffs_hash_size;
 
-    SLIST_FOREACH(entry, list, nhe_next) {
-        if (entry->nhe_id == id) {
-            return entry;
+    nffs_hash = malloc(size * sizeof *nffs_hash);
+    if (nffs_hash == NULL) {
+        nffs_hash = old_hash;
+        return FS_ENOMEM;
+    }
+
+    for (i = 0; i < size; i++) {
+        nffs_hash[i].nhs_id = NFFS_HASH_ENTRY_NONE;
+        nffs_hash[i].nhs_entry = NULL;
+    }
+    nffs_hash_size = size;
+    nffs_hash_bits = bits;
+    nffs_hash_count = 0;
+    nffs_hash_used = 0;
+
+    for (i = 0; i < old_size; i++) {
+        if (old_hash[i].nhs_entry != NULL) {
+            nffs_hash_place(old_hash[i].nhs_entry);
         }
     }
 
-    return NULL;
+    free(old_hash);
+
+    return 0;
+}
+
+struct nffs_hash_entry *
+nffs_hash_find(uint32_t id)
+{
+    struct nffs_hash_slot *slot;
+
+    slot = nffs_hash_find_slot(id);
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    return slot->nhs_entry;
 }
 
 struct nffs_inode_entry *
@@ -113,7 +216,7 @@ nffs_hash_find_inode(uint32_t id)
 
     assert(nffs_hash_id_is_inode(id));
 
-    entry = nffs_hash_find_reorder(id);
+    entry = nffs_hash_find(id);
     return (struct nffs_inode_entry *)entry;
 }
 
@@ -124,7 +227,7 @@ nffs_hash_find_block(uint32_t id)
 
     assert(nffs_hash_id_is_block(id));
 
-    entry = nffs_hash_find_reorder(id);
+    entry = nffs_hash_find(id);
     return entry;
 }
 
@@ -144,18 +247,32 @@ nffs_hash_id_is_dummy(uint32_t id)
     return 0;
 }
 
-void
+/**
+ * Inserts an entry into the hash table, growing the table if it is getting
+ * full.
+ *
+ * @param entry                 The entry to insert.
+ *
+ * @return                      0 on success; FS_ENOMEM if the table is full
+ *                                  and could not be grown.
+ */
+int
 nffs_hash_insert(struct nffs_hash_entry *entry)
 {
-    struct nffs_hash_list *list;
     struct nffs_inode_entry *nie;
-    int idx;
+    int rc;
 
     assert(nffs_hash_find(entry->nhe_id) == NULL);
-    idx = nffs_hash_fn(entry->nhe_id);
-    list = nffs_hash + idx;
 
-    SLIST_INSERT_HEAD(list, entry, nhe_next);
+    if (NFFS_HASH_OVER_LOAD(nffs_hash_used + 1, nffs_hash_size)) {
+        rc = nffs_hash_resize(nffs_hash_count + 1);
+        if (rc != 0 && nffs_hash_used + 1 >= nffs_hash_size) {
+            /* At least one empty slot must remain to end probe sequences. */
+            return rc;
+        }
+    }
+
+    nffs_hash_place(entry);
     nffs_hashcnt_ins++;
 
     if (nffs_hash_id_is_inode(entry->nhe_id)) {
@@ -165,14 +282,15 @@ nffs_hash_insert(struct nffs_hash_entry *entry)
     } else {
         assert(nffs_hash_find(entry->nhe_id));
     }
+
+    return 0;
 }
 
 void
 nffs_hash_remove(struct nffs_hash_entry *entry)
 {
-    struct nffs_hash_list *list;
     struct nffs_inode_entry *nie = NULL;
-    int idx;
+    struct nffs_hash_slot *slot;
 
     if (nffs_hash_id_is_inode(entry->nhe_id)) {
         nie = nffs_hash_find_inode(entry->nhe_id);
@@ -182,10 +300,14 @@ nffs_hash_remove(struct nffs_hash_entry *entry)
         assert(nffs_hash_find(entry->nhe_id));
     }
 
-    idx = nffs_hash_fn(entry->nhe_id);
-    list = nffs_hash + idx;
+    slot = nffs_hash_find_slot(entry->nhe_id);
+    assert(slot != NULL && slot->nhs_entry == entry);
 
-    SLIST_REMOVE(list, entry, nffs_hash_entry, nhe_next);
+    /* Leave a tombstone; the table is never shrunk here, so that iteration
+     * over it may remove entries.
+     */
+    slot->nhs_entry = NULL;
+    nffs_hash_count--;
     nffs_hashcnt_rm++;
 
     if (nffs_hash_id_is_inode(entry->nhe_id) && nie) {
@@ -197,18 +319,9 @@ nffs_hash_remove(struct nffs_hash_entry *entry)
 int
 nffs_hash_init(void)
 {
-    int i;
-
     free(nffs_hash);
+    nffs_hash = NULL;
+    nffs_hash_size = 0;
 
-    nffs_hash = malloc(NFFS_HASH_SIZE * sizeof *nffs_hash);
-    if (nffs_hash == NULL) {
-        return FS_ENOMEM;
-    }
-
-    for (i = 0; i < NFFS_HASH_SIZE; i++) {
-        SLIST_INIT(nffs_hash + i);
-    }
-
-    return 0;
+    return nffs_hash_resize(0);
 }
@@ -54,6 +54,7 @@ nffs_inode_entry_free(struct nffs_inode_entry *inode_entry)
 {
     if (inode_entry != NULL) {
         assert(nffs_hash_id_is_inode(inode_entry->nie_hash_entry.nhe_id));
+        nffs_path_cache_remove(inode_entry);
         os_memblock_put(&nffs_inode_entry_pool, inode_entry);
     }
 }
@@ -571,6 +572,8 @@ nffs_inode_rename(struct nffs_inode_entry *inode_entry,
         return FS_EINVAL;
     }
 
+    nffs_path_cache_remove(inode_entry);
+
     rc = nffs_inode_from_entry(&inode, inode_entry);
     if (rc != 0) {
         return rc;
@@ -635,8 +638,9 @@ nffs_inode_rename(struct nffs_inode_entry *inode_entry,
     return 0;
 }
 
-int
-nffs_inode_update(struct nffs_inode_entry *inode_entry)
+static int
+nffs_inode_write_update(struct nffs_inode_entry *inode_entry,
+                        uint32_t lastblock_id)
 {
     struct nffs_disk_inode disk_inode;
     struct nffs_inode inode;
@@ -683,8 +687,7 @@ nffs_inode_update(struct nffs_inode_entry *inode_entry)
     disk_inode.ndi_flags = 0;
     disk_inode.ndi_filename_len = filename_len;
 
-    assert(nffs_hash_id_is_block(inode_entry->nie_last_block_entry->nhe_id));
-    disk_inode.ndi_lastblock_id = inode_entry->nie_last_block_entry->nhe_id;
+    disk_inode.ndi_lastblock_id = lastblock_id;
 
     nffs_crc_disk_inode_fill(&disk_inode, filename);
 
@@ -703,6 +706,48 @@ nffs_inode_update(struct nffs_inode_entry *inode_entry)
     return 0;
 }
 
+int
+nffs_inode_update(struct nffs_inode_entry *inode_entry)
+{
+    assert(nffs_hash_id_is_block(inode_entry->nie_last_block_entry->nhe_id));
+    return nffs_inode_write_update(inode_entry,
+                                   inode_entry->nie_last_block_entry->nhe_id);
+}
+
+/**
+ * Discards all data in a file, keeping its inode.  A new version of the inode
+ * without a last block is written; the old data blocks are dropped from RAM
+ * and left on disk for garbage collection.  The restore sweep recognizes them
+ * as no longer part of the file.
+ *
+ * @param inode_entry           The file to truncate.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+nffs_inode_truncate(struct nffs_inode_entry *inode_entry)
+{
+    int rc;
+
+    assert(nffs_hash_id_is_file(inode_entry->nie_hash_entry.nhe_id));
+
+    if (inode_entry->nie_last_block_entry == NULL) {
+        return 0;
+    }
+
+    /* The blocks stay linked in RAM until the new inode is on disk, so that a
+     * garbage collection cycle triggered by the write still copies them.
+     */
+    rc = nffs_inode_write_update(inode_entry, NFFS_ID_NONE);
+    if (rc != 0) {
+        return rc;
+    }
+
+    nffs_cache_inode_delete(inode_entry);
+
+    return nffs_inode_delete_blocks_from_ram(inode_entry);
+}
+
 static int
 nffs_inode_read_filename_chunk(const struct nffs_inode *inode,
                                uint8_t filename_offset, void *buf, int len)
@@ -766,6 +811,7 @@ nffs_inode_read_filename(struct nffs_inode_entry *inode_entry, size_t max_len,
     }
 
     out_name[read_len] = '\0';
+    *out_full_len = inode.ni_filename_len;
 
     return 0;
 }
@@ -828,6 +874,7 @@ nffs_inode_remove_child(struct nffs_inode *child)
     parent = child->ni_parent;
     assert(parent != NULL);
     assert(nffs_hash_id_is_dir(parent->nie_hash_entry.nhe_id));
+    nffs_path_cache_remove(child->ni_inode_entry);
     SLIST_REMOVE(&parent->nie_child_list, child->ni_inode_entry,
                  nffs_inode_entry, nie_sibling_next);
     SLIST_NEXT(child->ni_inode_entry, nie_sibling_next) = NULL;
@@ -1114,6 +1161,69 @@ nffs_inode_read(struct nffs_inode_entry *inode_entry, uint32_t offset,
     return 0;
 }
 
+/**
+ * Fills in pointers to the file's data in memory-mapped flash, starting at
+ * the specified offset; one segment per data block.
+ *
+ * @return                      0 on success;
+ *                              FS_EOFFSET if offset is beyond end of file;
+ *                              FS_EINVAL if the flash is not memory-mapped;
+ *                              other nonzero on failure.
+ */
+int
+nffs_inode_mmap(struct nffs_inode_entry *inode_entry, uint32_t offset,
+                struct nffs_mmap_seg *segs, int max_segs, int *out_cnt)
+{
+    struct nffs_cache_inode *cache_inode;
+    struct nffs_cache_block *cache_block;
+    const void *data;
+    uint16_t block_off;
+    uint16_t chunk_sz;
+    int cnt;
+    int rc;
+
+    *out_cnt = 0;
+
+    rc = nffs_cache_inode_ensure(&cache_inode, inode_entry);
+    if (rc != 0) {
+        return rc;
+    }
+
+    if (offset > cache_inode->nci_file_size) {
+        return FS_EOFFSET;
+    }
+
+    cnt = 0;
+    cache_block = NULL;
+    while (cnt < max_segs && offset < cache_inode->nci_file_size) {
+        if (cache_block == NULL) {
+            rc = nffs_cache_seek(cache_inode, offset, &cache_block);
+            if (rc != 0) {
+                return rc;
+            }
+        }
+
+        block_off = offset - cache_block->ncb_file_offset;
+        chunk_sz = cache_block->ncb_block.nb_data_len - block_off;
+
+        data = nffs_block_mmap_data(&cache_block->ncb_block, block_off,
+                                    chunk_sz);
+        if (data == NULL) {
+            return FS_EINVAL;
+        }
+
+        segs[cnt].nms_data = data;
+        segs[cnt].nms_len = chunk_sz;
+        cnt++;
+
+        offset += chunk_sz;
+        cache_block = TAILQ_NEXT(cache_block, ncb_link);
+    }
+
+    *out_cnt = cnt;
+    return 0;
+}
+
 static int
 nffs_inode_unlink_from_ram_priv(struct nffs_inode *inode,
                                 int ignore_corruption,
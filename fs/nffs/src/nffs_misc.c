@@ -22,6 +22,12 @@
 #include "nffs/nffs.h"
 #include "nffs_priv.h"
 
+/** Free space set aside by nffs_file_preallocate(), summed over all files. */
+uint32_t nffs_prealloc_space;
+
+/** The part of nffs_prealloc_space the current write may draw on. */
+uint32_t nffs_prealloc_own;
+
 /**
  * Determines if the file system contains a valid root directory.  For the root
  * directory to be valid, it must be present and have the following traits:
@@ -190,9 +196,93 @@ nffs_misc_reserve_space_area(uint8_t area_idx, uint16_t space,
     return FS_EFULL;
 }
 
+/**
+ * Calculates the number of bytes written to the non-scratch areas.
+ */
+uint32_t
+nffs_misc_used_space(void)
+{
+    uint32_t used;
+    int i;
+
+    used = 0;
+    for (i = 0; i < nffs_num_areas; i++) {
+        if (i != nffs_scratch_area_idx) {
+            used += nffs_areas[i].na_cur;
+        }
+    }
+
+    return used;
+}
+
+/**
+ * Calculates how much free space can be filled without garbage collection.
+ * Objects are placed first-fit and never span areas, so up to one maximum
+ * size object's worth at the end of each area may go unused; that much is
+ * not counted.
+ */
+static uint32_t
+nffs_misc_free_space(void)
+{
+    uint32_t free_space;
+    uint32_t avail;
+    uint32_t slack;
+    int i;
+
+    slack = sizeof (struct nffs_disk_block) + nffs_block_max_data_sz;
+
+    free_space = 0;
+    for (i = 0; i < nffs_num_areas; i++) {
+        if (i != nffs_scratch_area_idx && i != nffs_gc_area_idx) {
+            avail = nffs_area_free_space(nffs_areas + i);
+            if (avail > slack) {
+                free_space += avail - slack;
+            }
+        }
+    }
+
+    return free_space;
+}
+
+/**
+ * Garbage collects until the specified amount of free space can be filled
+ * without further garbage collection.
+ *
+ * @param space                 The number of bytes of free space required.
+ *
+ * @return                      0 on success;
+ *                              FS_EFULL if the necessary space could not be
+ *                                  freed;
+ *                              nonzero on other failure.
+ */
+int
+nffs_misc_make_space(uint32_t space)
+{
+    int rc;
+    int i;
+
+    for (i = 0; i < nffs_num_areas; i++) {
+        if (nffs_misc_free_space() >= space) {
+            return 0;
+        }
+
+        rc = nffs_gc(NULL);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    if (nffs_misc_free_space() >= space) {
+        return 0;
+    }
+    return FS_EFULL;
+}
+
 /**
  * Finds an area that can accommodate an object of the specified size.  If no
  * such area exists, this function performs a garbage collection cycle.
+ * Space preallocated for other files is left alone; if taking it would be
+ * the only way to fit the object, garbage collection is performed first.
  *
  * @param space                 The number of bytes of free space required.
  * @param out_area_idx          On success, the index of the suitable area gets
@@ -210,9 +300,19 @@ nffs_misc_reserve_space(uint16_t space,
     int rc;
     int i;
 
-    /* Find the first area with sufficient free space. */
+    if (nffs_prealloc_space > nffs_prealloc_own) {
+        rc = nffs_misc_make_space(nffs_prealloc_space - nffs_prealloc_own +
+                                  space);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    /* Find the first area with sufficient free space.  The area being
+     * garbage collected is about to be erased, so it is skipped as well.
+     */
     for (i = 0; i < nffs_num_areas; i++) {
-        if (i != nffs_scratch_area_idx) {
+        if (i != nffs_scratch_area_idx && i != nffs_gc_area_idx) {
             rc = nffs_misc_reserve_space_area(i, space, out_area_offset);
             if (rc == 0) {
                 *out_area_idx = i;
@@ -360,6 +460,8 @@ nffs_misc_reset(void)
     int rc;
 
     nffs_cache_clear();
+    nffs_gc_reset();
+    nffs_path_cache_clear();
 
     rc = os_mempool_init(&nffs_file_pool, nffs_config.nc_num_files,
                          sizeof (struct nffs_file), nffs_file_mem,
@@ -368,6 +470,16 @@ nffs_misc_reset(void)
         return FS_EOS;
     }
 
+    if (nffs_config.nc_write_buf_size > 0) {
+        rc = os_mempool_init(&nffs_wb_pool, nffs_config.nc_num_files,
+                             nffs_config.nc_write_buf_size, nffs_wb_mem,
+                             "nffs_wb_pool");
+        if (rc != 0) {
+            return FS_EOS;
+        }
+    }
+    nffs_write_reset();
+
     rc = os_mempool_init(&nffs_inode_entry_pool, nffs_config.nc_num_inodes,
                          sizeof (struct nffs_inode_entry), nffs_inode_mem,
                          "nffs_inode_entry_pool");
@@ -423,6 +535,9 @@ nffs_misc_reset(void)
     nffs_hash_next_dir_id = NFFS_ID_DIR_MIN;
     nffs_hash_next_block_id = NFFS_ID_BLOCK_MIN;
 
+    nffs_prealloc_space = 0;
+    nffs_prealloc_own = 0;
+
     return 0;
 }
 
@@ -65,16 +65,115 @@ nffs_path_parser_new(struct nffs_path_parser *parser, const char *path)
     parser->npp_off = 0;
 }
 
+struct nffs_path_cache_entry {
+    struct nffs_inode_entry *npce_parent;
+    struct nffs_inode_entry *npce_child;
+    uint32_t npce_hash;
+};
+
+/** Direct-mapped cache of recently resolved path components. */
+static struct nffs_path_cache_entry nffs_path_cache[NFFS_PATH_CACHE_SIZE];
+
+static uint32_t
+nffs_path_cache_hash(const struct nffs_inode_entry *parent,
+                     const char *name, int name_len)
+{
+    uint32_t hash;
+    int i;
+
+    /* FNV-1a over the parent ID followed by the component name. */
+    hash = 2166136261u ^ parent->nie_hash_entry.nhe_id;
+    hash *= 16777619u;
+    for (i = 0; i < name_len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * Removes every cached path component that refers to the specified inode,
+ * either as the parent or as the child.  This must be called whenever an
+ * inode is removed from its parent's child list, renamed, or freed.
+ */
+void
+nffs_path_cache_remove(const struct nffs_inode_entry *inode_entry)
+{
+    struct nffs_path_cache_entry *entry;
+    int i;
+
+    for (i = 0; i < NFFS_PATH_CACHE_SIZE; i++) {
+        entry = nffs_path_cache + i;
+        if (entry->npce_parent == inode_entry ||
+            entry->npce_child == inode_entry) {
+
+            memset(entry, 0, sizeof *entry);
+        }
+    }
+}
+
+void
+nffs_path_cache_clear(void)
+{
+    memset(nffs_path_cache, 0, sizeof nffs_path_cache);
+}
+
+static int
+nffs_path_cache_find(struct nffs_inode_entry *parent,
+                     const char *name, int name_len, uint32_t hash,
+                     struct nffs_inode_entry **out_inode_entry)
+{
+    struct nffs_path_cache_entry *entry;
+    struct nffs_inode inode;
+    int cmp;
+    int rc;
+
+    entry = nffs_path_cache + hash % NFFS_PATH_CACHE_SIZE;
+    if (entry->npce_parent != parent || entry->npce_hash != hash) {
+        return FS_ENOENT;
+    }
+
+    /* Guard against hash collisions by comparing the actual name. */
+    rc = nffs_inode_from_entry(&inode, entry->npce_child);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = nffs_inode_filename_cmp_ram(&inode, name, name_len, &cmp);
+    if (rc != 0) {
+        return rc;
+    }
+    if (cmp != 0) {
+        return FS_ENOENT;
+    }
+
+    *out_inode_entry = entry->npce_child;
+    return 0;
+}
+
 static int
 nffs_path_find_child(struct nffs_inode_entry *parent,
                      const char *name, int name_len,
                      struct nffs_inode_entry **out_inode_entry)
 {
+    struct nffs_path_cache_entry *entry;
     struct nffs_inode_entry *cur;
     struct nffs_inode inode;
+    uint32_t hash;
     int cmp;
     int rc;
 
+    hash = nffs_path_cache_hash(parent, name, name_len);
+    rc = nffs_path_cache_find(parent, name, name_len, hash, out_inode_entry);
+    if (rc != FS_ENOENT) {
+        if (rc == 0) {
+            STATS_INC(nffs_stats, path_cache_hits);
+        }
+        return rc;
+    }
+    STATS_INC(nffs_stats, path_cache_misses);
+
     SLIST_FOREACH(cur, &parent->nie_child_list, nie_sibling_next) {
         rc = nffs_inode_from_entry(&inode, cur);
         if (rc != 0) {
@@ -87,6 +186,11 @@ nffs_path_find_child(struct nffs_inode_entry *parent,
         }
 
         if (cmp == 0) {
+            entry = nffs_path_cache + hash % NFFS_PATH_CACHE_SIZE;
+            entry->npce_parent = parent;
+            entry->npce_child = cur;
+            entry->npce_hash = hash;
+
             *out_inode_entry = cur;
             return 0;
         }
@@ -26,9 +26,15 @@
 #include "os/os_mempool.h"
 #include "nffs/nffs.h"
 #include "fs/fs.h"
+#include "fs/fs_if.h"
 #include "util/crc16.h"
+#include "stats/stats.h"
 
-#define NFFS_HASH_SIZE               256
+#define NFFS_HASH_MIN_SIZE           256
+
+#define NFFS_CACHE_READAHEAD_MAX     8
+
+#define NFFS_PATH_CACHE_SIZE         16
 
 #define NFFS_ID_DIR_MIN              0
 #define NFFS_ID_DIR_MAX              0x10000000
@@ -47,22 +53,33 @@
 #define NFFS_AREA_MAGIC3             0xb185fc8e
 #define NFFS_BLOCK_MAGIC             0x53ba23b9
 #define NFFS_INODE_MAGIC             0x925f8bc0
+#define NFFS_CKPT_MAGIC              0x3c9e51d7
+#define NFFS_CKPT_TAIL_MAGIC         0x8a4f26e3
 
 #define NFFS_AREA_ID_NONE            0xff
 #define NFFS_AREA_VER_0                 0
 #define NFFS_AREA_VER_1              1
-#define NFFS_AREA_VER                NFFS_AREA_VER_1
+#define NFFS_AREA_VER_2              2
+#define NFFS_AREA_VER                NFFS_AREA_VER_2
 #define NFFS_AREA_OFFSET_ID          23
 
+/** Erase count difference at which GC starts favoring the less worn area. */
+#define NFFS_GC_WEAR_THRESHOLD       16
+
 #define NFFS_SHORT_FILENAME_LEN      3
 
 #define NFFS_BLOCK_MAX_DATA_SZ_MAX   2048
 
-/** On-disk representation of an area header. */
+/**
+ * On-disk representation of an area header.  Version 2 reuses the fourth
+ * magic word of a version 1 header for the erase count, so the layout and the
+ * offset of every other field are unchanged.
+ */
 struct nffs_disk_area {
-    uint32_t nda_magic[4];  /* NFFS_AREA_MAGIC{0,1,2,3} */
+    uint32_t nda_magic[3];  /* NFFS_AREA_MAGIC{0,1,2} */
+    uint32_t nda_erase_cnt; /* Erase count; NFFS_AREA_MAGIC3 in version 1. */
     uint32_t nda_length;    /* Total size of area, in bytes. */
-    uint8_t nda_ver;        /* Current nffs version: 0 */
+    uint8_t nda_ver;        /* Current nffs version: 2 */
     uint8_t nda_gc_seq;     /* Garbage collection count. */
     uint8_t reserved8;
     uint8_t nda_id;         /* 0xff if scratch area. */
@@ -99,6 +116,48 @@ struct nffs_disk_block {
 
 #define NFFS_DISK_BLOCK_OFFSET_CRC  18
 
+/**
+ * On-disk representation of an index checkpoint header.  A checkpoint is a
+ * snapshot of the RAM representation, written to the scratch area directly
+ * after the area header.  The header is followed by ndc_num_areas area
+ * records, ndc_num_entries entry records, and a tail.
+ */
+struct nffs_disk_ckpt {
+    uint32_t ndc_magic;             /* NFFS_CKPT_MAGIC */
+    uint32_t ndc_num_entries;       /* Number of inodes and blocks. */
+    uint32_t ndc_next_dir_id;
+    uint32_t ndc_next_file_id;
+    uint32_t ndc_next_block_id;
+    uint16_t ndc_block_max_data_sz;
+    uint8_t ndc_num_areas;
+    uint8_t reserved8;
+};
+
+/** State of one area at the time a checkpoint was written. */
+struct nffs_disk_ckpt_area {
+    uint32_t ndca_offset;   /* Flash offset of start of area. */
+    uint32_t ndca_length;   /* Total size of area, in bytes. */
+    uint32_t ndca_cur;      /* Objects after this offset are replayed. */
+    uint8_t ndca_id;
+    uint8_t ndca_gc_seq;
+    uint16_t reserved16;
+};
+
+/** One inode or data block in a checkpoint. */
+struct nffs_disk_ckpt_entry {
+    uint32_t ndce_id;
+    uint32_t ndce_flash_loc;
+    uint32_t ndce_link;     /* Dir: first child; file: last block. */
+    uint32_t ndce_sibling;  /* Inode: next sibling in parent's list. */
+};
+
+/** Terminates a checkpoint; a checkpoint without a valid tail is ignored. */
+struct nffs_disk_ckpt_tail {
+    uint32_t ndct_magic;    /* NFFS_CKPT_TAIL_MAGIC */
+    uint16_t ndct_crc16;    /* Covers header, areas, and entries. */
+    uint16_t reserved16;
+};
+
 /**
  * What gets stored in the hash table.  Each entry represents a data block or
  * an inode.
@@ -113,6 +172,12 @@ struct nffs_hash_entry {
 SLIST_HEAD(nffs_hash_list, nffs_hash_entry);
 SLIST_HEAD(nffs_inode_list, nffs_inode_entry);
 
+/** A slot in the open-addressed hash table. */
+struct nffs_hash_slot {
+    uint32_t nhs_id;                    /* NFFS_HASH_ENTRY_NONE if empty. */
+    struct nffs_hash_entry *nhs_entry;  /* NULL if empty or removed. */
+};
+
 /** Each inode hash entry is actually one of these. */
 struct nffs_inode_entry {
     struct nffs_hash_entry nie_hash_entry;
@@ -124,7 +189,8 @@ struct nffs_inode_entry {
     };
     uint8_t nie_refcnt;
     uint8_t nie_flags;
-    uint16_t reserved16;
+    uint8_t nie_writing;    /* A write is in progress; see nffs_write(). */
+    uint8_t reserved8;
 };
 
 #define    NFFS_INODE_FLAG_FREE        0x00
@@ -162,15 +228,28 @@ struct nffs_block {
 };
 
 struct nffs_file {
+    struct fs_hdl nf_hdl;               /* Must be first. */
     struct nffs_inode_entry *nf_inode_entry;
     uint32_t nf_offset;
     uint8_t nf_access_flags;
+    uint32_t nf_prealloc;       /* Space set aside for this handle's writes. */
+
+    /* Write-back buffer; null if writes to this file are not buffered.  The
+     * buffered data immediately precedes nf_offset.
+     */
+    uint8_t *nf_wb_buf;
+    uint16_t nf_wb_len;
+    os_time_t nf_wb_time;       /* When the first buffered byte was written. */
+    SLIST_ENTRY(nffs_file) nf_wb_next;
 };
 
+SLIST_HEAD(nffs_file_list, nffs_file);
+
 struct nffs_area {
     uint32_t na_offset;
     uint32_t na_length;
     uint32_t na_cur;
+    uint32_t na_erase_cnt;
     uint16_t na_id;
     uint8_t na_gc_seq;
     uint8_t na_flash_id;
@@ -213,6 +292,8 @@ struct nffs_path_parser {
 /** Represents a single cached data block. */
 struct nffs_cache_block {
     TAILQ_ENTRY(nffs_cache_block) ncb_link; /* Next / prev cached block. */
+    TAILQ_ENTRY(nffs_cache_block) ncb_lru_link; /* Sorted; LRU at tail. */
+    struct nffs_cache_inode *ncb_cache_inode;   /* Owning cached inode. */
     struct nffs_block ncb_block;            /* Full data block. */
     uint32_t ncb_file_offset;               /* File offset of this block. */
 };
@@ -228,10 +309,12 @@ struct nffs_cache_inode {
 };
 
 struct nffs_dirent {
+    struct fs_hdl nde_hdl;              /* Must be first. */
     struct nffs_inode_entry *nde_inode_entry;
 };
 
 struct nffs_dir {
+    struct fs_hdl nd_hdl;               /* Must be first. */
     struct nffs_inode_entry *nd_parent_inode_entry;
     struct nffs_dirent nd_dirent;
 };
@@ -240,13 +323,28 @@ uint32_t nffs_hashcnt_ins;
 uint32_t nffs_hashcnt_rm;
 uint32_t nffs_object_count;
 
+STATS_SECT_START(nffs_stats)
+    STATS_SECT_ENTRY(area_erases)
+    STATS_SECT_ENTRY(area_erase_cnt_min)
+    STATS_SECT_ENTRY(area_erase_cnt_max)
+    STATS_SECT_ENTRY(path_cache_hits)
+    STATS_SECT_ENTRY(path_cache_misses)
+STATS_SECT_END
+extern STATS_SECT_DECL(nffs_stats) nffs_stats;
+
+extern uint32_t nffs_cache_block_hits;
+extern uint32_t nffs_cache_block_misses;
+extern uint32_t nffs_cache_block_readaheads;
+
 extern void *nffs_file_mem;
+extern void *nffs_wb_mem;
 extern void *nffs_block_entry_mem;
 extern void *nffs_inode_mem;
 extern void *nffs_cache_inode_mem;
 extern void *nffs_cache_block_mem;
 extern void *nffs_dir_mem;
 extern struct os_mempool nffs_file_pool;
+extern struct os_mempool nffs_wb_pool;
 extern struct os_mempool nffs_dir_pool;
 extern struct os_mempool nffs_inode_entry_pool;
 extern struct os_mempool nffs_block_entry_pool;
@@ -260,12 +358,17 @@ extern uint8_t nffs_num_areas;
 extern uint8_t nffs_scratch_area_idx;
 extern uint16_t nffs_block_max_data_sz;
 extern unsigned int nffs_gc_count;
+extern uint32_t nffs_prealloc_space;
+extern uint32_t nffs_prealloc_own;
+extern uint8_t nffs_gc_area_idx;
 extern struct nffs_area_desc *nffs_current_area_descs;
 
 #define NFFS_FLASH_BUF_SZ        256
 extern uint8_t nffs_flash_buf[NFFS_FLASH_BUF_SZ];
 
-extern struct nffs_hash_list *nffs_hash;
+extern struct nffs_hash_slot *nffs_hash;
+extern uint32_t nffs_hash_size;
+extern uint32_t nffs_hash_count;
 extern struct nffs_inode_entry *nffs_root_dir;
 extern struct nffs_inode_entry *nffs_lost_found_dir;
 
@@ -275,11 +378,14 @@ extern struct log nffs_log;
 int nffs_area_magic_is_set(const struct nffs_disk_area *disk_area);
 int nffs_area_is_scratch(const struct nffs_disk_area *disk_area);
 int nffs_area_is_current_version(const struct nffs_disk_area *disk_area);
+int nffs_area_is_supported_version(const struct nffs_disk_area *disk_area);
+uint32_t nffs_area_erase_cnt(const struct nffs_disk_area *disk_area);
 void nffs_area_to_disk(const struct nffs_area *area,
                        struct nffs_disk_area *out_disk_area);
 uint32_t nffs_area_free_space(const struct nffs_area *area);
 int nffs_area_find_corrupt_scratch(uint16_t *out_good_idx,
                                    uint16_t *out_bad_idx);
+void nffs_area_update_wear_stats(void);
 
 /* @block */
 struct nffs_hash_entry *nffs_block_entry_alloc(void);
@@ -305,6 +411,8 @@ int nffs_block_from_hash_entry(struct nffs_block *out_block,
                                struct nffs_hash_entry *entry);
 int nffs_block_read_data(const struct nffs_block *block, uint16_t offset,
                          uint16_t length, void *dst);
+const void *nffs_block_mmap_data(const struct nffs_block *block,
+                                 uint16_t offset, uint16_t length);
 int nffs_block_is_dummy(struct nffs_hash_entry *entry);
 
 /* @cache */
@@ -318,6 +426,10 @@ int nffs_cache_seek(struct nffs_cache_inode *cache_inode, uint32_t to,
                     struct nffs_cache_block **out_cache_block);
 void nffs_cache_clear(void);
 
+/* @ckpt */
+int nffs_ckpt_write(void);
+int nffs_ckpt_restore(uint16_t *out_block_max_data_sz);
+
 /* @crc */
 int nffs_crc_flash(uint16_t initial_crc, uint8_t area_idx,
                    uint32_t area_offset, uint32_t len, uint16_t *out_crc);
@@ -338,6 +450,9 @@ void nffs_config_init(void);
 int nffs_dir_open(const char *path, struct nffs_dir **out_dir);
 int nffs_dir_read(struct nffs_dir *dir, struct nffs_dirent **out_dirent);
 int nffs_dir_close(struct nffs_dir *dir);
+int nffs_dir_read_batch(struct nffs_dir *dir, struct fs_dir_cursor *cursor,
+                        struct fs_dirent_info *entries, int max_entries,
+                        int *out_cnt);
 
 /* @file */
 int nffs_file_open(struct nffs_file **out_file, const char *filename,
@@ -346,6 +461,7 @@ int nffs_file_seek(struct nffs_file *file, uint32_t offset);
 int nffs_file_read(struct nffs_file *file, uint32_t len, void *out_data,
                    uint32_t *out_len);
 int nffs_file_close(struct nffs_file *file);
+int nffs_file_preallocate(struct nffs_file *file, uint32_t len);
 int nffs_file_new(struct nffs_inode_entry *parent, const char *filename,
                   uint8_t filename_len, int is_dir,
                   struct nffs_inode_entry **out_inode_entry);
@@ -358,6 +474,8 @@ int nffs_format_full(const struct nffs_area_desc *area_descs);
 /* @gc */
 int nffs_gc(uint8_t *out_area_idx);
 int nffs_gc_until(uint32_t space, uint8_t *out_area_idx);
+int nffs_gc_idle_step(uint32_t max_slots);
+void nffs_gc_reset(void);
 
 /* @flash */
 struct nffs_area *nffs_flash_find_area(uint16_t logical_id);
@@ -365,6 +483,10 @@ int nffs_flash_read(uint8_t area_idx, uint32_t offset,
                     void *data, uint32_t len);
 int nffs_flash_write(uint8_t area_idx, uint32_t offset,
                      const void *data, uint32_t len);
+const void *nffs_flash_mmap(uint8_t area_idx, uint32_t offset, uint32_t len);
+int nffs_flash_erase(uint8_t area_idx);
+int nffs_flash_erase_run(uint8_t area_idx, uint8_t num_areas);
+int nffs_flash_is_erased(uint8_t area_idx, int *out_erased);
 int nffs_flash_copy(uint8_t area_id_from, uint32_t offset_from,
                     uint8_t area_id_to, uint32_t offset_to,
                     uint32_t len);
@@ -380,8 +502,9 @@ int nffs_hash_id_is_block(uint32_t id);
 struct nffs_hash_entry *nffs_hash_find(uint32_t id);
 struct nffs_inode_entry *nffs_hash_find_inode(uint32_t id);
 struct nffs_hash_entry *nffs_hash_find_block(uint32_t id);
-void nffs_hash_insert(struct nffs_hash_entry *entry);
+int nffs_hash_insert(struct nffs_hash_entry *entry);
 void nffs_hash_remove(struct nffs_hash_entry *entry);
+int nffs_hash_resize(uint32_t min_count);
 int nffs_hash_init(void);
 int nffs_hash_entry_is_dummy(struct nffs_hash_entry *he);
 int nffs_hash_id_is_dummy(uint32_t id);
@@ -403,6 +526,7 @@ int nffs_inode_rename(struct nffs_inode_entry *inode_entry,
                       struct nffs_inode_entry *new_parent,
                       const char *new_filename);
 int nffs_inode_update(struct nffs_inode_entry *inode_entry);
+int nffs_inode_truncate(struct nffs_inode_entry *inode_entry);
 void nffs_inode_insert_block(struct nffs_inode *inode,
                              struct nffs_block *block);
 int nffs_inode_read_disk(uint8_t area_idx, uint32_t offset,
@@ -427,6 +551,8 @@ int nffs_inode_filename_cmp_flash(const struct nffs_inode *inode1,
                                   int *result);
 int nffs_inode_read(struct nffs_inode_entry *inode_entry, uint32_t offset,
                     uint32_t len, void *data, uint32_t *out_len);
+int nffs_inode_mmap(struct nffs_inode_entry *inode_entry, uint32_t offset,
+                    struct nffs_mmap_seg *segs, int max_segs, int *out_cnt);
 int nffs_inode_seek(struct nffs_inode_entry *inode_entry, uint32_t offset,
                     uint32_t length, struct nffs_seek_info *out_seek_info);
 int nffs_inode_from_entry(struct nffs_inode *out_inode,
@@ -446,6 +572,8 @@ int nffs_inode_getflags(struct nffs_inode_entry *entry, uint8_t flag);
 int nffs_misc_gc_if_oom(void *resource, int *out_rc);
 int nffs_misc_reserve_space(uint16_t space,
                             uint8_t *out_area_idx, uint32_t *out_area_offset);
+uint32_t nffs_misc_used_space(void);
+int nffs_misc_make_space(uint32_t space);
 int nffs_misc_set_num_areas(uint8_t num_areas);
 int nffs_misc_validate_root_dir(void);
 int nffs_misc_validate_scratch(void);
@@ -457,6 +585,8 @@ int nffs_misc_ready(void);
 /* @path */
 int nffs_path_parse_next(struct nffs_path_parser *parser);
 void nffs_path_parser_new(struct nffs_path_parser *parser, const char *path);
+void nffs_path_cache_remove(const struct nffs_inode_entry *inode_entry);
+void nffs_path_cache_clear(void);
 int nffs_path_find(struct nffs_path_parser *parser,
                    struct nffs_inode_entry **out_inode_entry,
                    struct nffs_inode_entry **out_parent);
@@ -472,13 +602,19 @@ int nffs_restore_full(const struct nffs_area_desc *area_descs);
 
 /* @write */
 int nffs_write_to_file(struct nffs_file *file, const void *data, int len);
+int nffs_write_flush(struct nffs_file *file);
+int nffs_write_flush_aged(os_time_t max_age);
+void nffs_write_reset(void);
 
 
-#define NFFS_HASH_FOREACH(entry, i, next)                               \
-    for ((i) = 0; (i) < NFFS_HASH_SIZE; (i)++)                          \
-        for ((entry) = SLIST_FIRST(nffs_hash + (i));                    \
-             (entry) && (((next)) = SLIST_NEXT((entry), nhe_next), 1);  \
-             (entry) = ((next)))
+/**
+ * Iterates over every entry in the hash table.  The current entry may be
+ * removed from the table during iteration; inserting entries may resize the
+ * table and must not be done.
+ */
+#define NFFS_HASH_FOREACH(entry, i)                                     \
+    for ((i) = 0; (i) < nffs_hash_size; (i)++)                          \
+        if (((entry) = nffs_hash[(i)].nhs_entry) != NULL)
 
 #define NFFS_FLASH_LOC_NONE  nffs_flash_loc(NFFS_AREA_ID_NONE, 0)
 
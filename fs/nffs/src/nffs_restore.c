@@ -19,6 +19,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "hal/hal_flash.h"
 #include "os/os_mempool.h"
@@ -33,18 +34,31 @@
  */
 static uint16_t nffs_restore_largest_block_data_len;
 
+/**
+ * The ID of the first data block of a file, collected by the sweep.  Blocks
+ * of the file with lower IDs were dropped when it was truncated.
+ */
+struct nffs_restore_chain {
+    uint32_t nrc_inode_id;
+    uint32_t nrc_first_id;      /* NFFS_ID_NONE if the file is empty. */
+};
+
 /**
  * Checks that each block a chain of data blocks was properly restored.
  *
  * @param last_block_entry      The entry corresponding to the last block in
  *                                  the chain.
+ * @param out_first_id          On success, the ID of the first block in the
+ *                                  chain gets written here; NFFS_ID_NONE if
+ *                                  the chain is empty.
  *
  * @return                      0 if the block chain is OK;
  *                              FS_ECORRUPT if corruption is detected;
  *                              nonzero on other error.
  */
 static int
-nffs_restore_validate_block_chain(struct nffs_hash_entry *last_block_entry)
+nffs_restore_validate_block_chain(struct nffs_hash_entry *last_block_entry,
+                                  uint32_t *out_first_id)
 {
     struct nffs_disk_block disk_block;
     struct nffs_hash_entry *cur;
@@ -54,6 +68,7 @@ nffs_restore_validate_block_chain(struct nffs_hash_entry *last_block_entry)
     int rc;
 
     cur = last_block_entry;
+    *out_first_id = NFFS_ID_NONE;
 
     while (cur != NULL) {
         if (nffs_hash_entry_is_dummy(cur)) {
@@ -72,6 +87,7 @@ nffs_restore_validate_block_chain(struct nffs_hash_entry *last_block_entry)
             return rc;
         }
 
+        *out_first_id = cur->nhe_id;
         cur = block.nb_prev;
     }
 
@@ -159,11 +175,13 @@ nffs_restore_migrate_orphan_children(struct nffs_inode_entry *inode_entry)
 
 static int
 nffs_restore_should_sweep_inode_entry(struct nffs_inode_entry *inode_entry,
-                                      int *out_should_sweep)
+                                      int *out_should_sweep,
+                                      uint32_t *out_first_id)
 {
     struct nffs_inode inode;
     int rc;
 
+    *out_first_id = NFFS_ID_NONE;
 
     /*
      * if this inode was tagged to have a dummy block entry and the
@@ -242,7 +260,7 @@ nffs_restore_should_sweep_inode_entry(struct nffs_inode_entry *inode_entry,
      */
     if (nffs_hash_id_is_file(inode_entry->nie_hash_entry.nhe_id)) {
         rc = nffs_restore_validate_block_chain(
-                inode_entry->nie_last_block_entry);
+                inode_entry->nie_last_block_entry, out_first_id);
         if (rc == FS_ECORRUPT) {
             *out_should_sweep = 6;
             return 0;
@@ -260,6 +278,77 @@ nffs_restore_should_sweep_inode_entry(struct nffs_inode_entry *inode_entry,
     return 0;
 }
 
+static int
+nffs_restore_chain_cmp(const void *a, const void *b)
+{
+    const struct nffs_restore_chain *chain_a = a;
+    const struct nffs_restore_chain *chain_b = b;
+
+    if (chain_a->nrc_inode_id < chain_b->nrc_inode_id) {
+        return -1;
+    }
+    if (chain_a->nrc_inode_id > chain_b->nrc_inode_id) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Deletes the data blocks which are not part of a file: dummy blocks which
+ * were never restored, blocks whose inode or predecessor is missing, and
+ * blocks dropped when their file was truncated (see nffs_inode_truncate()).
+ * Block IDs increase along a file's chain, so a block with a lower ID than
+ * the first block of its file was dropped.
+ *
+ * @param chains                The start of each file's block chain, sorted
+ *                                  by inode ID.
+ * @param num_chains            The number of entries in chains.
+ */
+static void
+nffs_restore_sweep_blocks(const struct nffs_restore_chain *chains,
+                          int num_chains)
+{
+    const struct nffs_restore_chain *chain;
+    struct nffs_restore_chain key;
+    struct nffs_hash_entry *entry;
+    struct nffs_block block;
+    int del;
+    int rc;
+    int i;
+
+    /* Deleting a block can invalidate one that was already visited (its
+     * successor), so repeat until a pass deletes nothing.
+     */
+    do {
+        del = 0;
+        NFFS_HASH_FOREACH(entry, i) {
+            if (!nffs_hash_id_is_block(entry->nhe_id)) {
+                continue;
+            }
+
+            if (nffs_hash_id_is_dummy(entry->nhe_id)) {
+                del = 1;
+                nffs_block_delete_from_ram(entry);
+                continue;
+            }
+
+            rc = nffs_block_from_hash_entry(&block, entry);
+            if (rc == 0) {
+                key.nrc_inode_id = block.nb_inode_entry->nie_hash_entry.nhe_id;
+                chain = bsearch(&key, chains, num_chains, sizeof *chains,
+                                nffs_restore_chain_cmp);
+                if (chain != NULL && entry->nhe_id < chain->nrc_first_id) {
+                    rc = FS_ECORRUPT;
+                }
+            }
+            if (rc != 0 && rc != FS_ENOENT) {
+                del = 1;
+                nffs_block_delete_from_ram(entry);
+            }
+        }
+    } while (del);
+}
+
 /**
  * Performs a sweep of the RAM representation at the end of a successful
  * restore.  The sweep phase performs the following actions of each inode in
@@ -270,91 +359,109 @@ nffs_restore_should_sweep_inode_entry(struct nffs_inode_entry *inode_entry,
  *     3. Else, a CRC check is performed on each of the inode's constituent
  *        blocks.  If corruption is detected, the inode is fully deleted from
  *        RAM.
+ * Finally, data blocks which are not part of any file are deleted from RAM.
  *
  * @return                      0 on success; nonzero on failure.
  */
 int
 nffs_restore_sweep(void)
 {
+    struct nffs_restore_chain *chains;
     struct nffs_inode_entry *inode_entry;
     struct nffs_hash_entry *entry;
-    struct nffs_hash_entry *next;
-    struct nffs_hash_list *list;
     struct nffs_inode inode;
-    struct nffs_block block;
+    uint32_t hash_size;
+    uint32_t first_id;
+    int num_chains;
     int del = 0;
     int rc;
     int i;
 
-    /* Iterate through every object in the hash table, deleting all inodes that
-     * should be removed.
+    /* If a dummy inode directory exists, the file system is corrupt.  Move
+     * each such directory's children inodes to the lost+found directory.
+     * This creates directories, so it is done before anything is deleted;
+     * if an insert causes the hash table to be resized, start over.
+     * Migrating a directory's children a second time is a no-op.
      */
-    for (i = 0; i < NFFS_HASH_SIZE; i++) {
-        list = nffs_hash + i;
-
-        entry = SLIST_FIRST(list);
-        while (entry != NULL) {
-            next = SLIST_NEXT(entry, nhe_next);
-            if (nffs_hash_id_is_inode(entry->nhe_id)) {
+    do {
+        hash_size = nffs_hash_size;
+        NFFS_HASH_FOREACH(entry, i) {
+            if (nffs_hash_id_is_dir(entry->nhe_id)) {
                 inode_entry = (struct nffs_inode_entry *)entry;
-
-                /*
-                 * If this is a dummy inode directory, the file system
-                 * is corrupt.  Move the directory's children inodes to
-                 * the lost+found directory.
-                 */
                 rc = nffs_restore_migrate_orphan_children(inode_entry);
                 if (rc != 0) {
                     return rc;
                 }
-
-                /* Determine if this inode needs to be deleted. */
-                rc = nffs_restore_should_sweep_inode_entry(inode_entry, &del);
-                if (rc != 0) {
-                    return rc;
+                if (nffs_hash_size != hash_size) {
+                    break;
                 }
+            }
+        }
+    } while (nffs_hash_size != hash_size);
 
-                rc = nffs_inode_from_entry(&inode, inode_entry);
-                if (rc != 0 && rc != FS_ENOENT) {
-                    return rc;
-                }
+    /* Make room to record where each file's block chain starts. */
+    num_chains = 0;
+    NFFS_HASH_FOREACH(entry, i) {
+        if (nffs_hash_id_is_file(entry->nhe_id)) {
+            num_chains++;
+        }
+    }
+    chains = malloc((num_chains + 1) * sizeof *chains);
+    if (chains == NULL) {
+        return FS_ENOMEM;
+    }
+    num_chains = 0;
 
-                if (del) {
-
-                    /* Remove the inode and all its children from RAM.  We
-                     * expect some file system corruption; the children are
-                     * subject to garbage collection and may not exist in the
-                     * hash.  Remove what is actually present and ignore
-                     * corruption errors.
-                     */
-                    rc = nffs_inode_unlink_from_ram_corrupt_ok(&inode, &next);
-                    if (rc != 0) {
-                        return rc;
-                    }
-                    next = SLIST_FIRST(list);
-                }
-            } else if (nffs_hash_id_is_block(entry->nhe_id)) {
-                if (nffs_hash_id_is_dummy(entry->nhe_id)) {
-                    del = 1;
-                    nffs_block_delete_from_ram(entry);
-                } else {
-                    rc = nffs_block_from_hash_entry(&block, entry);
-                    if (rc != 0 && rc != FS_ENOENT) {
-                        del = 1;
-                        nffs_block_delete_from_ram(entry);
-                    }
-                }
-                if (del) {
-                    del = 0;
-                    next = SLIST_FIRST(list);
-                }
-            }
+    /* Iterate through every inode in the hash table, deleting all inodes that
+     * should be removed, along with their blocks and children.  Deleted
+     * entries leave tombstones in the table, so the iteration is unaffected
+     * by what gets removed.
+     */
+    NFFS_HASH_FOREACH(entry, i) {
+        if (!nffs_hash_id_is_inode(entry->nhe_id)) {
+            continue;
+        }
+        inode_entry = (struct nffs_inode_entry *)entry;
 
-            entry = next;
+        /* Determine if this inode needs to be deleted. */
+        rc = nffs_restore_should_sweep_inode_entry(inode_entry, &del,
+                                                   &first_id);
+        if (rc != 0) {
+            free(chains);
+            return rc;
+        }
+
+        rc = nffs_inode_from_entry(&inode, inode_entry);
+        if (rc != 0 && rc != FS_ENOENT) {
+            goto done;
+        }
+
+        if (del) {
+            del = 0;
+
+            /* Remove the inode and all its children from RAM.  We expect some
+             * file system corruption; the children are subject to garbage
+             * collection and may not exist in the hash.  Remove what is
+             * actually present and ignore corruption errors.
+             */
+            rc = nffs_inode_unlink_from_ram_corrupt_ok(&inode, NULL);
+            if (rc != 0) {
+                goto done;
+            }
+        } else if (nffs_hash_id_is_file(entry->nhe_id)) {
+            chains[num_chains].nrc_inode_id = entry->nhe_id;
+            chains[num_chains].nrc_first_id = first_id;
+            num_chains++;
         }
     }
 
-    return 0;
+    qsort(chains, num_chains, sizeof *chains, nffs_restore_chain_cmp);
+    nffs_restore_sweep_blocks(chains, num_chains);
+    rc = 0;
+
+done:
+    free(chains);
+    return rc;
 }
 
 /**
@@ -375,6 +482,7 @@ nffs_restore_dummy_inode(uint32_t id,
                          struct nffs_inode_entry **out_inode_entry)
 {
     struct nffs_inode_entry *inode_entry;
+    int rc;
 
     inode_entry = nffs_inode_entry_alloc();
     if (inode_entry == NULL) {
@@ -386,7 +494,11 @@ nffs_restore_dummy_inode(uint32_t id,
     inode_entry->nie_last_block_entry = NULL; /* lastblock not available yet */
     nffs_inode_setflags(inode_entry, NFFS_INODE_FLAG_DUMMY);
 
-    nffs_hash_insert(&inode_entry->nie_hash_entry);
+    rc = nffs_hash_insert(&inode_entry->nie_hash_entry);
+    if (rc != 0) {
+        nffs_inode_entry_free(inode_entry);
+        return rc;
+    }
 
     *out_inode_entry = inode_entry;
 
@@ -609,7 +721,10 @@ nffs_restore_inode(const struct nffs_disk_inode *disk_inode, uint8_t area_idx,
                               nffs_flash_loc(area_idx, area_offset);
         inode_entry->nie_last_block_entry = NULL; /* for now */
 
-        nffs_hash_insert(&inode_entry->nie_hash_entry);
+        rc = nffs_hash_insert(&inode_entry->nie_hash_entry);
+        if (rc != 0) {
+            goto err;
+        }
     }
 
     /*
@@ -630,6 +745,17 @@ nffs_restore_inode(const struct nffs_disk_inode *disk_inode, uint8_t area_idx,
             nffs_inode_setflags(inode_entry, NFFS_INODE_FLAG_DELETED);
         }
 
+        /*
+         * This version of the inode determines the last block; an older
+         * version may have named a block the file no longer has (the file
+         * was truncated).
+         */
+        if (!new_inode &&
+            nffs_hash_id_is_file(inode_entry->nie_hash_entry.nhe_id)) {
+            inode_entry->nie_last_block_entry = NULL;
+            nffs_inode_unsetflags(inode_entry, NFFS_INODE_FLAG_DUMMYLSTBLK);
+        }
+
         /*
          * Inode has a lastblock on disk.
          * Add reference to last block entry if in hash table
@@ -663,8 +789,13 @@ nffs_restore_inode(const struct nffs_disk_inode *disk_inode, uint8_t area_idx,
                 lastblock_entry->nhe_id = disk_inode->ndi_lastblock_id;
                 lastblock_entry->nhe_flash_loc = NFFS_FLASH_LOC_NONE;
                 inode_entry->nie_last_block_entry = lastblock_entry;
+                rc = nffs_hash_insert(lastblock_entry);
+                if (rc != 0) {
+                    inode_entry->nie_last_block_entry = NULL;
+                    nffs_block_entry_free(lastblock_entry);
+                    goto err;
+                }
                 nffs_inode_setflags(inode_entry, NFFS_INODE_FLAG_DUMMYLSTBLK);
-                nffs_hash_insert(lastblock_entry);
 
                 if (lastblock_entry->nhe_id >= nffs_hash_next_block_id) {
                     nffs_hash_next_block_id = lastblock_entry->nhe_id + 1;
@@ -866,7 +997,10 @@ nffs_restore_block(const struct nffs_disk_block *disk_block, uint8_t area_idx,
 
         /* The block is ready to be inserted into the hash. */
 
-        nffs_hash_insert(entry);
+        rc = nffs_hash_insert(entry);
+        if (rc != 0) {
+            goto err;
+        }
 
         if (disk_block->ndb_id >= nffs_hash_next_block_id) {
             nffs_hash_next_block_id = disk_block->ndb_id + 1;
@@ -1026,7 +1160,7 @@ nffs_restore_disk_object_size(const struct nffs_disk_object *disk_object)
 
 /**
  * Reads the specified area from disk and loads its contents into the RAM
- * representation.
+ * representation.  Reading starts at the area's current write offset.
  *
  * @param area_idx              The index of the area to read.
  *
@@ -1041,7 +1175,6 @@ nffs_restore_area_contents(int area_idx)
 
     area = nffs_areas + area_idx;
 
-    area->na_cur = sizeof (struct nffs_disk_area);
     while (1) {
         rc = nffs_restore_disk_object(area_idx, area->na_cur,  &disk_object);
         switch (rc) {
@@ -1111,7 +1244,7 @@ nffs_restore_detect_one_area(uint8_t flash_id, uint32_t area_offset,
         return FS_ECORRUPT;
     }
 
-    if (!nffs_area_is_current_version(out_disk_area)) {
+    if (!nffs_area_is_supported_version(out_disk_area)) {
         return FS_EUNEXP;
     }
 
@@ -1130,7 +1263,6 @@ nffs_restore_corrupt_scratch(void)
 {
     struct nffs_inode_entry *inode_entry;
     struct nffs_hash_entry *entry;
-    struct nffs_hash_entry *next;
     uint32_t area_offset;
     uint16_t good_idx;
     uint16_t bad_idx;
@@ -1154,32 +1286,26 @@ nffs_restore_corrupt_scratch(void)
     }
 
     /* Invalidate all objects resident in the bad area. */
-    for (i = 0; i < NFFS_HASH_SIZE; i++) {
-        entry = SLIST_FIRST(&nffs_hash[i]);
-        while (entry != NULL) {
-            next = SLIST_NEXT(entry, nhe_next);
-
-            nffs_flash_loc_expand(entry->nhe_flash_loc,
-                                 &area_idx, &area_offset);
-            if (area_idx == bad_idx) {
-                if (nffs_hash_id_is_block(entry->nhe_id)) {
-                    rc = nffs_block_delete_from_ram(entry);
-                    if (rc != 0) {
-                        return rc;
-                    }
-                } else {
-                    inode_entry = (struct nffs_inode_entry *)entry;
-                    nffs_inode_setflags(inode_entry, NFFS_INODE_FLAG_OBSOLETE);
+    NFFS_HASH_FOREACH(entry, i) {
+        nffs_flash_loc_expand(entry->nhe_flash_loc,
+                             &area_idx, &area_offset);
+        if (area_idx == bad_idx) {
+            if (nffs_hash_id_is_block(entry->nhe_id)) {
+                rc = nffs_block_delete_from_ram(entry);
+                if (rc != 0) {
+                    return rc;
                 }
+            } else {
+                inode_entry = (struct nffs_inode_entry *)entry;
+                nffs_inode_setflags(inode_entry, NFFS_INODE_FLAG_OBSOLETE);
             }
-
-            entry = next;
         }
     }
 
     /* Now that the objects in the scratch area have been invalidated, reload
      * everything from the good area.
      */
+    nffs_areas[good_idx].na_cur = sizeof (struct nffs_disk_area);
     rc = nffs_restore_area_contents(good_idx);
     if (rc != 0) {
         return rc;
@@ -1204,13 +1330,12 @@ nffs_log_contents(void)
 
     struct nffs_inode_entry *inode_entry;
     struct nffs_hash_entry *entry;
-    struct nffs_hash_entry *next;
     struct nffs_block block;
     struct nffs_inode inode;
     int rc;
     int i;
 
-    NFFS_HASH_FOREACH(entry, i, next) {
+    NFFS_HASH_FOREACH(entry, i) {
         if (nffs_hash_id_is_block(entry->nhe_id)) {
             rc = nffs_block_from_hash_entry(&block, entry);
             assert(rc == 0 || rc == FS_ENOENT);
@@ -1269,27 +1394,54 @@ nffs_log_contents(void)
 }
 
 /**
- * Searches for a valid nffs file system among the specified areas.  This
- * function succeeds if a file system is detected among any subset of the
- * supplied areas.  If the area set does not contain a valid file system,
- * a new one can be created via a call to nffs_format().
+ * Checks whether anything has been written to the scratch area after its
+ * header (i.e., an index checkpoint).  If so, the area is marked as full so
+ * that it gets erased before it is used.
+ */
+static int
+nffs_restore_scratch_cur(uint8_t area_idx)
+{
+    uint32_t word;
+    int rc;
+
+    nffs_areas[area_idx].na_cur = NFFS_AREA_OFFSET_ID;
+
+    rc = nffs_flash_read(area_idx, sizeof (struct nffs_disk_area),
+                         &word, sizeof word);
+    if (rc != 0) {
+        return rc;
+    }
+    if (word != 0xffffffff) {
+        nffs_areas[area_idx].na_cur = nffs_areas[area_idx].na_length;
+    }
+
+    return 0;
+}
+
+/**
+ * Restores the file system from the specified areas.
  *
- * @param area_descs        The area set to search.  This array must be
- *                              terminated with a 0-length area.
+ * @param area_descs        The area set to search.
+ * @param use_ckpt          Whether to load an index checkpoint, if one is
+ *                              present, instead of reading every object.
+ * @param out_used_ckpt     On return, 1 gets written here if a checkpoint
+ *                              was loaded (even partially); 0 otherwise.
  *
- * @return                  0 on success;
- *                          FS_ECORRUPT if no valid file system was detected;
- *                          other nonzero on error.
+ * @return                  0 on success; nonzero on failure.
  */
-int
-nffs_restore_full(const struct nffs_area_desc *area_descs)
+static int
+nffs_restore_full_priv(const struct nffs_area_desc *area_descs, int use_ckpt,
+                       int *out_used_ckpt)
 {
     struct nffs_disk_area disk_area;
+    uint16_t ckpt_block_max_data_sz;
     int cur_area_idx;
     int use_area;
     int rc;
     int i;
 
+    *out_used_ckpt = 0;
+
     /* Start from a clean state. */
     rc = nffs_misc_reset();
     if (rc) {
@@ -1344,19 +1496,53 @@ nffs_restore_full(const struct nffs_area_desc *area_descs)
             nffs_areas[cur_area_idx].na_length = area_descs[i].nad_length;
             nffs_areas[cur_area_idx].na_flash_id = area_descs[i].nad_flash_id;
             nffs_areas[cur_area_idx].na_gc_seq = disk_area.nda_gc_seq;
+            nffs_areas[cur_area_idx].na_erase_cnt =
+                nffs_area_erase_cnt(&disk_area);
             nffs_areas[cur_area_idx].na_id = disk_area.nda_id;
 
             if (disk_area.nda_id == NFFS_AREA_ID_NONE) {
-                nffs_areas[cur_area_idx].na_cur = NFFS_AREA_OFFSET_ID;
                 nffs_scratch_area_idx = cur_area_idx;
+                rc = nffs_restore_scratch_cur(cur_area_idx);
+                if (rc != 0) {
+                    goto err;
+                }
             } else {
                 nffs_areas[cur_area_idx].na_cur =
                     sizeof (struct nffs_disk_area);
-                nffs_restore_area_contents(cur_area_idx);
             }
         }
     }
 
+    /* No area carries an nffs header; the medium is blank or holds something
+     * else.  There is nothing to restore, so don't bother searching for a
+     * checkpoint or a scratch area candidate.
+     */
+    if (nffs_num_areas == 0) {
+        rc = FS_ECORRUPT;
+        goto err;
+    }
+
+    /* If there is a valid index checkpoint, load it; only the objects
+     * written after it need to be read.
+     */
+    if (use_ckpt) {
+        rc = nffs_ckpt_restore(&ckpt_block_max_data_sz);
+        if (rc == 0) {
+            *out_used_ckpt = 1;
+            nffs_restore_largest_block_data_len = ckpt_block_max_data_sz;
+        } else if (rc != FS_ENOENT && rc != FS_ECORRUPT) {
+            *out_used_ckpt = 1;
+            goto err;
+        }
+    }
+
+    /* Read the contents of each area from flash. */
+    for (i = 0; i < nffs_num_areas; i++) {
+        if (i != nffs_scratch_area_idx) {
+            nffs_restore_area_contents(i);
+        }
+    }
+
     /* All areas have been restored from flash. */
 
     if (nffs_scratch_area_idx == NFFS_AREA_ID_NONE) {
@@ -1395,6 +1581,14 @@ nffs_restore_full(const struct nffs_area_desc *area_descs)
      */
     nffs_restore_sweep();
 
+    /* Size the hash table to fit the objects that were found; this also drops
+     * the tombstones left by the sweep.  On failure the existing table is
+     * kept, so the error is not fatal.
+     */
+    nffs_hash_resize(nffs_hash_count);
+
+    nffs_area_update_wear_stats();
+
     /* Set the maximum data block size according to the size of the smallest
      * area.
      */
@@ -1412,3 +1606,34 @@ err:
     nffs_misc_reset();
     return rc;
 }
+
+/**
+ * Searches for a valid nffs file system among the specified areas.  This
+ * function succeeds if a file system is detected among any subset of the
+ * supplied areas.  If the area set does not contain a valid file system,
+ * a new one can be created via a call to nffs_format().
+ *
+ * If the scratch area contains a valid index checkpoint, the RAM
+ * representation is loaded from it and only the objects written afterwards are
+ * read from flash.  If that fails, the file system is restored from scratch.
+ *
+ * @param area_descs        The area set to search.  This array must be
+ *                              terminated with a 0-length area.
+ *
+ * @return                  0 on success;
+ *                          FS_ECORRUPT if no valid file system was detected;
+ *                          other nonzero on error.
+ */
+int
+nffs_restore_full(const struct nffs_area_desc *area_descs)
+{
+    int used_ckpt;
+    int rc;
+
+    rc = nffs_restore_full_priv(area_descs, 1, &used_ckpt);
+    if (rc != 0 && used_ckpt) {
+        rc = nffs_restore_full_priv(area_descs, 0, &used_ckpt);
+    }
+
+    return rc;
+}
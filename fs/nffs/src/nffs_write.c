@@ -18,10 +18,15 @@
  */
 
 #include <assert.h>
+#include <string.h>
 #include "testutil/testutil.h"
 #include "nffs/nffs.h"
 #include "nffs_priv.h"
 
+/** Open files with data in their write-back buffers. */
+static struct nffs_file_list nffs_write_wb_list =
+    SLIST_HEAD_INITIALIZER(nffs_write_wb_list);
+
 static int
 nffs_write_fill_crc16_overwrite(struct nffs_disk_block *disk_block,
                                 uint8_t src_area_idx, uint32_t src_area_offset,
@@ -243,7 +248,11 @@ nffs_write_append(struct nffs_cache_inode *cache_inode, const void *data,
 
     entry->nhe_id = disk_block.ndb_id;
     entry->nhe_flash_loc = nffs_flash_loc(area_idx, area_offset);
-    nffs_hash_insert(entry);
+    rc = nffs_hash_insert(entry);
+    if (rc != 0) {
+        nffs_block_entry_free(entry);
+        return rc;
+    }
 
     inode_entry->nie_last_block_entry = entry;
 
@@ -372,7 +381,179 @@ nffs_write_chunk(struct nffs_inode_entry *inode_entry, uint32_t file_offset,
 }
 
 /**
- * Writes a chunk of contiguous data to a file.
+ * Writes a chunk of data on behalf of an open file.  The write may draw on the
+ * space preallocated for the file; whatever it takes is deducted from the
+ * file's share.  If garbage collection happened anyway, the estimate the
+ * preallocation was based on did not hold, and the rest of it is released.
+ */
+static int
+nffs_write_file_chunk(struct nffs_file *file, uint32_t file_offset,
+                      const void *data, uint16_t data_len)
+{
+    unsigned int gc_count;
+    uint32_t used;
+    int rc;
+
+    if (file->nf_prealloc == 0) {
+        return nffs_write_chunk(file->nf_inode_entry, file_offset, data,
+                                data_len);
+    }
+
+    gc_count = nffs_gc_count;
+    used = nffs_misc_used_space();
+    nffs_prealloc_own = file->nf_prealloc;
+
+    rc = nffs_write_chunk(file->nf_inode_entry, file_offset, data, data_len);
+
+    nffs_prealloc_own = 0;
+    used = nffs_misc_used_space() - used;
+    if (gc_count != nffs_gc_count || used > file->nf_prealloc) {
+        used = file->nf_prealloc;
+    }
+    file->nf_prealloc -= used;
+    nffs_prealloc_space -= used;
+
+    return rc;
+}
+
+/**
+ * Calculates the capacity of a write-back buffer.  A buffer never holds more
+ * than a single full-size data block.
+ */
+static uint16_t
+nffs_write_wb_cap(void)
+{
+    if (nffs_config.nc_write_buf_size < nffs_block_max_data_sz) {
+        return nffs_config.nc_write_buf_size;
+    } else {
+        return nffs_block_max_data_sz;
+    }
+}
+
+/**
+ * Writes the contents of a file's write-back buffer to flash as a single data
+ * block.  If the file was opened in append mode, the data is appended to the
+ * current end of the file; otherwise, it is written at the offset it was
+ * buffered for.  On failure, the data remains buffered.
+ *
+ * @param file                  The file to flush.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+nffs_write_flush(struct nffs_file *file)
+{
+    struct nffs_cache_inode *cache_inode;
+    uint32_t offset;
+    int rc;
+
+    if (file->nf_wb_len == 0) {
+        return 0;
+    }
+
+    rc = nffs_cache_inode_ensure(&cache_inode, file->nf_inode_entry);
+    if (rc != 0) {
+        return rc;
+    }
+
+    if (file->nf_access_flags & FS_ACCESS_APPEND) {
+        offset = cache_inode->nci_file_size;
+    } else {
+        offset = file->nf_offset - file->nf_wb_len;
+    }
+
+    rc = nffs_write_file_chunk(file, offset, file->nf_wb_buf,
+                               file->nf_wb_len);
+    if (rc != 0) {
+        return rc;
+    }
+
+    file->nf_offset = offset + file->nf_wb_len;
+    file->nf_wb_len = 0;
+    SLIST_REMOVE(&nffs_write_wb_list, file, nffs_file, nf_wb_next);
+
+    return 0;
+}
+
+/**
+ * Flushes every write-back buffer that holds data older than the specified
+ * age.
+ *
+ * @param max_age               The maximum age of buffered data, in OS
+ *                                  ticks.
+ *
+ * @return                      0 on success; nonzero if any buffer could not
+ *                                  be flushed.
+ */
+int
+nffs_write_flush_aged(os_time_t max_age)
+{
+    struct nffs_file *file;
+    struct nffs_file *next;
+    os_time_t now;
+    int rc;
+
+    rc = 0;
+    now = os_time_get();
+    for (file = SLIST_FIRST(&nffs_write_wb_list);
+         file != NULL;
+         file = next) {
+
+        next = SLIST_NEXT(file, nf_wb_next);
+        if (OS_TIME_TICK_GEQ(now, file->nf_wb_time + max_age)) {
+            if (nffs_write_flush(file) != 0) {
+                rc = FS_EHW;
+            }
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * Forgets about every write-back buffer.  This must be called whenever the
+ * file pool is reset.
+ */
+void
+nffs_write_reset(void)
+{
+    SLIST_INIT(&nffs_write_wb_list);
+}
+
+/**
+ * Adds data to the end of a file's write-back buffer.
+ *
+ * @return                      The number of bytes buffered.
+ */
+static uint16_t
+nffs_write_buffer(struct nffs_file *file, const uint8_t *data, int len)
+{
+    uint16_t chunk_size;
+    uint16_t cap;
+
+    cap = nffs_write_wb_cap();
+    if (len > cap - file->nf_wb_len) {
+        chunk_size = cap - file->nf_wb_len;
+    } else {
+        chunk_size = len;
+    }
+
+    if (file->nf_wb_len == 0) {
+        file->nf_wb_time = os_time_get();
+        SLIST_INSERT_HEAD(&nffs_write_wb_list, file, nf_wb_next);
+    }
+
+    memcpy(file->nf_wb_buf + file->nf_wb_len, data, chunk_size);
+    file->nf_wb_len += chunk_size;
+    file->nf_offset += chunk_size;
+
+    return chunk_size;
+}
+
+/**
+ * Writes a chunk of contiguous data to a file.  If the file has a write-back
+ * buffer, data written to the end of the file is held in RAM until a full
+ * block's worth has accumulated or the buffer is flushed.
  *
  * @param file                  The file to write to.
  * @param data                  The data to write.
@@ -386,6 +567,7 @@ nffs_write_to_file(struct nffs_file *file, const void *data, int len)
     struct nffs_cache_inode *cache_inode;
     const uint8_t *data_ptr;
     uint16_t chunk_size;
+    int at_end;
     int rc;
 
     if (!(file->nf_access_flags & FS_ACCESS_WRITE)) {
@@ -405,20 +587,48 @@ nffs_write_to_file(struct nffs_file *file, const void *data, int len)
      * seek position.
      */
     if (file->nf_access_flags & FS_ACCESS_APPEND) {
-        file->nf_offset = cache_inode->nci_file_size;
+        file->nf_offset = cache_inode->nci_file_size + file->nf_wb_len;
+    }
+
+    /* Only writes to the end of the file get buffered.  Buffered data must
+     * reach flash before anything else is written.
+     */
+    at_end = file->nf_offset == cache_inode->nci_file_size + file->nf_wb_len;
+    if (!at_end) {
+        rc = nffs_write_flush(file);
+        if (rc != 0) {
+            return rc;
+        }
     }
 
     /* Write data as a sequence of blocks. */
     data_ptr = data;
     while (len > 0) {
+        /* Coalesce writes smaller than a full buffer. */
+        if (file->nf_wb_buf != NULL && at_end &&
+            (file->nf_wb_len > 0 || len < nffs_write_wb_cap())) {
+
+            chunk_size = nffs_write_buffer(file, data_ptr, len);
+            len -= chunk_size;
+            data_ptr += chunk_size;
+
+            if (file->nf_wb_len == nffs_write_wb_cap()) {
+                rc = nffs_write_flush(file);
+                if (rc != 0) {
+                    return rc;
+                }
+            }
+            continue;
+        }
+
         if (len > nffs_block_max_data_sz) {
             chunk_size = nffs_block_max_data_sz;
         } else {
             chunk_size = len;
         }
 
-        rc = nffs_write_chunk(file->nf_inode_entry, file->nf_offset, data_ptr,
-                              chunk_size);
+        rc = nffs_write_file_chunk(file, file->nf_offset, data_ptr,
+                                   chunk_size);
         if (rc != 0) {
             return rc;
         }
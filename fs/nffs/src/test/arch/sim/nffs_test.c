@@ -576,7 +576,6 @@ nffs_test_assert_system_once(const struct nffs_test_file_desc *root_dir)
 {
     struct nffs_inode_entry *inode_entry;
     struct nffs_hash_entry *entry;
-    struct nffs_hash_entry *next;
     int i;
 
     nffs_test_num_touched_entries = 0;
@@ -584,7 +583,7 @@ nffs_test_assert_system_once(const struct nffs_test_file_desc *root_dir)
     nffs_test_assert_branch_touched(nffs_root_dir);
 
     /* Ensure no orphaned inodes or blocks. */
-    NFFS_HASH_FOREACH(entry, i, next) {
+    NFFS_HASH_FOREACH(entry, i) {
         TEST_ASSERT(entry->nhe_flash_loc != NFFS_FLASH_LOC_NONE);
         if (nffs_hash_id_is_inode(entry->nhe_id)) {
             inode_entry = (void *)entry;
@@ -629,6 +628,17 @@ nffs_test_assert_system(const struct nffs_test_file_desc *root_dir,
 
     /* Ensure file system is still as expected. */
     nffs_test_assert_system_once(root_dir);
+
+    /* Write an index checkpoint and restore from it. */
+    rc = nffs_checkpoint();
+    TEST_ASSERT(rc == 0);
+    rc = nffs_misc_reset();
+    TEST_ASSERT(rc == 0);
+    rc = nffs_detect(area_descs);
+    TEST_ASSERT(rc == 0);
+
+    /* Ensure file system is still as expected. */
+    nffs_test_assert_system_once(root_dir);
 }
 
 static void
@@ -916,6 +926,135 @@ TEST_CASE(nffs_test_rename)
     nffs_test_assert_system(expected_system, nffs_area_descs);
 }
 
+TEST_CASE(nffs_test_readv_mbuf)
+{
+    struct os_mempool mempool;
+    struct os_mbuf_pool mbuf_pool;
+    os_membuf_t membuf[OS_MEMPOOL_SIZE(6, 64 + sizeof (struct os_mbuf))];
+    struct fs_iovec iov[3];
+    struct fs_file *file;
+    struct os_mbuf *hog;
+    struct os_mbuf *om;
+    struct os_mbuf *cur;
+    uint8_t data[300];
+    uint8_t buf[300];
+    uint32_t len;
+    int rc;
+    int i;
+
+    /*** Setup. */
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+
+    rc = os_mempool_init(&mempool, 6, 64 + sizeof (struct os_mbuf), membuf,
+                         "nffs_test_mbuf");
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = os_mbuf_pool_init(&mbuf_pool, &mempool, 64 + sizeof (struct os_mbuf),
+                           6);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i;
+    }
+
+    /*** Gather write. */
+    rc = fs_open("/myfile.txt", FS_ACCESS_WRITE, &file);
+    TEST_ASSERT(rc == 0);
+    iov[0].fi_base = data;
+    iov[0].fi_len = 10;
+    iov[1].fi_base = data + 10;
+    iov[1].fi_len = 0;
+    iov[2].fi_base = data + 10;
+    iov[2].fi_len = 90;
+    rc = fs_writev(file, iov, 3);
+    TEST_ASSERT(rc == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_assert_contents("/myfile.txt", (char *)data, 100);
+
+    /*** Scatter read; stops at end of file. */
+    rc = fs_open("/myfile.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == 0);
+    iov[0].fi_base = buf;
+    iov[0].fi_len = 40;
+    iov[1].fi_base = buf + 40;
+    iov[1].fi_len = 80;
+    iov[2].fi_base = buf + 120;
+    iov[2].fi_len = 10;
+    rc = fs_readv(file, iov, 3, &len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(len == 100);
+    TEST_ASSERT(memcmp(buf, data, 100) == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    /*** Write an mbuf chain. */
+    om = os_mbuf_get_pkthdr(&mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = os_mbuf_append(om, data, 200);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(SLIST_NEXT(om, om_next) != NULL);
+
+    rc = fs_open("/myfile.txt", FS_ACCESS_WRITE | FS_ACCESS_APPEND, &file);
+    TEST_ASSERT(rc == 0);
+    rc = fs_write_mbuf(file, om);
+    TEST_ASSERT(rc == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+    os_mbuf_free_chain(om);
+
+    memcpy(buf, data, 100);
+    memcpy(buf + 100, data, 200);
+    nffs_test_util_assert_contents("/myfile.txt", (char *)buf, 300);
+
+    /*** Read into an mbuf chain. */
+    om = os_mbuf_get_pkthdr(&mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = os_mbuf_append(om, "x", 1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = fs_open("/myfile.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == 0);
+    rc = fs_seek(file, 50);
+    TEST_ASSERT(rc == 0);
+    rc = fs_read_mbuf(file, 1000, om, &len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(len == 250);
+    TEST_ASSERT(OS_MBUF_PKTLEN(om) == 251);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    len = 0;
+    for (cur = om; cur != NULL; cur = SLIST_NEXT(cur, om_next)) {
+        len += cur->om_len;
+    }
+    TEST_ASSERT(len == 251);
+    rc = os_mbuf_copydata(om, 0, 251, data);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(data[0] == 'x');
+    TEST_ASSERT(memcmp(data + 1, buf + 50, 250) == 0);
+    os_mbuf_free_chain(om);
+
+    /*** Running out of mbufs is reported. */
+    hog = os_mbuf_get(&mbuf_pool, 0);
+    TEST_ASSERT_FATAL(hog != NULL);
+    rc = os_mbuf_append(hog, data, 150);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    om = os_mbuf_get_pkthdr(&mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = fs_open("/myfile.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == 0);
+    rc = fs_read_mbuf(file, 1000, om, &len);
+    TEST_ASSERT(rc == FS_ENOMEM);
+    TEST_ASSERT(len == OS_MBUF_PKTLEN(om));
+    TEST_ASSERT(len < 300);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+    os_mbuf_free_chain(om);
+    os_mbuf_free_chain(hog);
+}
+
 TEST_CASE(nffs_test_truncate)
 {
     struct fs_file *file;
@@ -969,6 +1108,186 @@ TEST_CASE(nffs_test_truncate)
     nffs_test_assert_system(expected_system, nffs_area_descs);
 }
 
+static int
+nffs_test_util_hash_block_count(void)
+{
+    struct nffs_hash_entry *entry;
+    int count;
+    int i;
+
+    count = 0;
+    NFFS_HASH_FOREACH(entry, i) {
+        if (nffs_hash_id_is_block(entry->nhe_id)) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+TEST_CASE(nffs_test_truncate_in_place)
+{
+    static char data[NFFS_BLOCK_MAX_DATA_SZ_MAX * 2 + 10];
+    struct nffs_file *nfile;
+    struct fs_file *file2;
+    struct fs_file *file;
+    uint32_t inode_id;
+    int rc;
+    int i;
+
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i;
+    }
+    nffs_test_util_create_file("/myfile.txt", data, sizeof data);
+
+    /* Truncating keeps the inode and drops the data blocks. */
+    rc = fs_open("/myfile.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == 0);
+    inode_id = ((struct nffs_file *)file)->nf_inode_entry->nie_hash_entry.nhe_id;
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_open("/myfile.txt", FS_ACCESS_WRITE | FS_ACCESS_TRUNCATE, &file);
+    TEST_ASSERT(rc == 0);
+    nfile = (struct nffs_file *)file;
+    TEST_ASSERT(nfile->nf_inode_entry->nie_hash_entry.nhe_id == inode_id);
+    TEST_ASSERT(nfile->nf_inode_entry->nie_last_block_entry == NULL);
+    TEST_ASSERT(nffs_test_util_hash_block_count() == 0);
+    nffs_test_util_assert_file_len(file, 0);
+
+    rc = fs_write(file, "1234", 4);
+    TEST_ASSERT(rc == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_assert_contents("/myfile.txt", "1234", 4);
+
+    /* The dropped blocks are still on disk; they must not come back. */
+    rc = nffs_detect(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_assert_contents("/myfile.txt", "1234", 4);
+    TEST_ASSERT(nffs_test_util_hash_block_count() == 1);
+
+    /* Nor when the file is left empty. */
+    rc = fs_open("/myfile.txt", FS_ACCESS_WRITE | FS_ACCESS_TRUNCATE, &file);
+    TEST_ASSERT(rc == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+    rc = nffs_detect(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_assert_contents("/myfile.txt", "", 0);
+    TEST_ASSERT(nffs_test_util_hash_block_count() == 0);
+
+    /* A file that is open elsewhere gets replaced instead; the other handle
+     * keeps reading the old contents.
+     */
+    nffs_test_util_create_file("/myfile.txt", data, sizeof data);
+    rc = fs_open("/myfile.txt", FS_ACCESS_READ, &file2);
+    TEST_ASSERT(rc == 0);
+    rc = fs_open("/myfile.txt", FS_ACCESS_WRITE | FS_ACCESS_TRUNCATE, &file);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(((struct nffs_file *)file)->nf_inode_entry !=
+                ((struct nffs_file *)file2)->nf_inode_entry);
+    rc = fs_write(file, "abc", 3);
+    TEST_ASSERT(rc == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_assert_file_len(file2, sizeof data);
+    rc = fs_close(file2);
+    TEST_ASSERT(rc == 0);
+
+    struct nffs_test_file_desc *expected_system =
+        (struct nffs_test_file_desc[]) { {
+            .filename = "",
+            .is_dir = 1,
+            .children = (struct nffs_test_file_desc[]) { {
+                .filename = "myfile.txt",
+                .contents = "abc",
+                .contents_len = 3,
+            }, {
+                .filename = NULL,
+            } },
+    } };
+
+    nffs_test_assert_system(expected_system, nffs_area_descs);
+}
+
+TEST_CASE(nffs_test_preallocate)
+{
+    static char junk[13 * 1024];
+    static char data[6 * 1024];
+    struct fs_file *file;
+    unsigned int gc_count;
+    uint32_t off;
+    uint32_t len;
+    int rc;
+    int i;
+
+    static const struct nffs_area_desc area_descs_three[] = {
+        { 0x00000000, 16 * 1024 },
+        { 0x00004000, 16 * 1024 },
+        { 0x00008000, 16 * 1024 },
+        { 0, 0 },
+    };
+
+    rc = nffs_format(area_descs_three);
+    TEST_ASSERT(rc == 0);
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i * 3;
+    }
+
+    /* Leave most of the space taken up by garbage. */
+    nffs_test_util_create_file("/junk.txt", junk, sizeof junk);
+    nffs_test_util_create_file("/junk.txt", junk, sizeof junk);
+
+    rc = fs_open("/rec.txt", FS_ACCESS_READ | FS_ACCESS_WRITE, &file);
+    TEST_ASSERT(rc == 0);
+
+    /* Garbage collection happens up front, not while the file fills. */
+    rc = fs_preallocate(file, sizeof data);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_prealloc_space > 0);
+
+    gc_count = nffs_gc_count;
+    for (off = 0; off < sizeof data; off += len) {
+        len = sizeof data - off;
+        if (len > nffs_block_max_data_sz) {
+            len = nffs_block_max_data_sz;
+        }
+        rc = fs_write(file, data + off, len);
+        TEST_ASSERT(rc == 0);
+
+        /* Other writes have to leave the reserved space alone. */
+        nffs_test_util_create_file("/other.txt", "x", 1);
+    }
+    TEST_ASSERT(nffs_gc_count == gc_count);
+
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_prealloc_space == 0);
+    nffs_test_util_assert_contents("/rec.txt", data, sizeof data);
+
+    /* More than the disk holds. */
+    rc = fs_open("/rec.txt", FS_ACCESS_WRITE | FS_ACCESS_APPEND, &file);
+    TEST_ASSERT(rc == 0);
+    rc = fs_preallocate(file, 64 * 1024);
+    TEST_ASSERT(rc == FS_EFULL);
+    TEST_ASSERT(nffs_prealloc_space == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    /* Read-only handles cannot reserve space. */
+    rc = fs_open("/rec.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == 0);
+    rc = fs_preallocate(file, 1);
+    TEST_ASSERT(rc == FS_EACCESS);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+}
+
 TEST_CASE(nffs_test_append)
 {
     struct fs_file *file;
@@ -1783,6 +2102,44 @@ TEST_CASE(nffs_test_large_write)
     nffs_test_assert_system(expected_system, area_descs_two);
 }
 
+TEST_CASE(nffs_test_write_lock_blocks)
+{
+    static char data[NFFS_BLOCK_MAX_DATA_SZ_MAX * 3 + 100];
+    struct nffs_file *nfile;
+    struct fs_file *file;
+    uint32_t lock_blocks;
+    int rc;
+    int i;
+
+    /*** Setup. */
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i * 7;
+    }
+
+    /* A write done a block at a time is laid out the same as a single one. */
+    lock_blocks = nffs_config.nc_write_lock_blocks;
+    nffs_config.nc_write_lock_blocks = 1;
+
+    rc = fs_open("/myfile.txt", FS_ACCESS_WRITE, &file);
+    TEST_ASSERT(rc == 0);
+    rc = fs_write(file, data, sizeof data);
+    TEST_ASSERT(rc == 0);
+    nfile = (struct nffs_file *)file;
+    TEST_ASSERT(nfile->nf_inode_entry->nie_writing == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    nffs_config.nc_write_lock_blocks = lock_blocks;
+
+    nffs_test_util_assert_contents("/myfile.txt", data, sizeof data);
+    TEST_ASSERT(nffs_test_util_block_count("/myfile.txt") ==
+                (sizeof data + nffs_block_max_data_sz - 1) /
+                nffs_block_max_data_sz);
+}
+
 TEST_CASE(nffs_test_many_children)
 {
     int rc;
@@ -1837,6 +2194,296 @@ TEST_CASE(nffs_test_many_children)
     nffs_test_assert_system(expected_system, nffs_area_descs);
 }
 
+TEST_CASE(nffs_test_path_cache)
+{
+    struct fs_file *file;
+    uint32_t misses;
+    uint32_t hits;
+    int rc;
+    int i;
+
+    /*** Setup. */
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_mkdir("/dir1");
+    TEST_ASSERT(rc == 0);
+    rc = fs_mkdir("/dir1/dir2");
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_create_file("/dir1/dir2/a", "aaa", 3);
+    nffs_test_util_create_file("/dir1/dir2/b", "bbb", 3);
+
+    /*** Repeated lookups of the same path are served from the cache. */
+    nffs_test_util_assert_contents("/dir1/dir2/a", "aaa", 3);
+    hits = nffs_stats.STATS_SECT_VAR(path_cache_hits);
+    misses = nffs_stats.STATS_SECT_VAR(path_cache_misses);
+    for (i = 0; i < 10; i++) {
+        rc = fs_open("/dir1/dir2/a", FS_ACCESS_READ, &file);
+        TEST_ASSERT(rc == 0);
+        rc = fs_close(file);
+        TEST_ASSERT(rc == 0);
+    }
+    TEST_ASSERT(nffs_stats.STATS_SECT_VAR(path_cache_hits) == hits + 30);
+    TEST_ASSERT(nffs_stats.STATS_SECT_VAR(path_cache_misses) == misses);
+
+    /*** Renaming a directory invalidates paths through it. */
+    rc = fs_rename("/dir1/dir2", "/dir1/dir3");
+    TEST_ASSERT(rc == 0);
+    rc = fs_open("/dir1/dir2/a", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == FS_ENOENT);
+    nffs_test_util_assert_contents("/dir1/dir3/a", "aaa", 3);
+
+    /*** Renaming a file onto another invalidates the clobbered entry. */
+    nffs_test_util_assert_contents("/dir1/dir3/b", "bbb", 3);
+    rc = fs_rename("/dir1/dir3/a", "/dir1/dir3/b");
+    TEST_ASSERT(rc == 0);
+    rc = fs_open("/dir1/dir3/a", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == FS_ENOENT);
+    nffs_test_util_assert_contents("/dir1/dir3/b", "aaa", 3);
+
+    /*** Unlinking and recreating a file resolves to the new inode. */
+    rc = fs_unlink("/dir1/dir3/b");
+    TEST_ASSERT(rc == 0);
+    rc = fs_open("/dir1/dir3/b", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == FS_ENOENT);
+    nffs_test_util_create_file("/dir1/dir3/b", "new", 3);
+    nffs_test_util_assert_contents("/dir1/dir3/b", "new", 3);
+
+    struct nffs_test_file_desc *expected_system =
+        (struct nffs_test_file_desc[]) { {
+            .filename = "",
+            .is_dir = 1,
+            .children = (struct nffs_test_file_desc[]) { {
+                .filename = "dir1",
+                .is_dir = 1,
+                .children = (struct nffs_test_file_desc[]) { {
+                    .filename = "dir3",
+                    .is_dir = 1,
+                    .children = (struct nffs_test_file_desc[]) { {
+                        .filename = "b",
+                        .contents = "new",
+                        .contents_len = 3,
+                    }, {
+                        .filename = NULL,
+                    } },
+                }, {
+                    .filename = NULL,
+                } },
+            }, {
+                .filename = NULL,
+            } },
+    } };
+
+    nffs_test_assert_system(expected_system, nffs_area_descs);
+}
+
+TEST_CASE(nffs_test_hash_resize)
+{
+    char filename[32];
+    int rc;
+    int i;
+
+    /*** Setup. */
+    nffs_config.nc_num_inodes = 1024;
+
+    rc = nffs_init();
+    TEST_ASSERT(rc == 0);
+
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_hash_size == NFFS_HASH_MIN_SIZE);
+
+    /* Create enough inodes to force the hash table to grow. */
+    for (i = 0; i < 300; i++) {
+        snprintf(filename, sizeof filename, "/file%d", i);
+        nffs_test_util_create_file(filename, NULL, 0);
+    }
+    TEST_ASSERT(nffs_hash_size > NFFS_HASH_MIN_SIZE);
+
+    /* Root directory, lost+found, and the files. */
+    TEST_ASSERT(nffs_hash_count == 302);
+    for (i = 0; i < 300; i++) {
+        snprintf(filename, sizeof filename, "/file%d", i);
+        rc = fs_unlink(filename);
+        TEST_ASSERT(rc == 0);
+    }
+    TEST_ASSERT(nffs_hash_count == 2);
+
+    /* Restoring the now-empty file system sizes the table back down. */
+    struct nffs_test_file_desc *expected_system =
+        (struct nffs_test_file_desc[]) { {
+            .filename = "",
+            .is_dir = 1,
+    } };
+
+    nffs_test_assert_system(expected_system, nffs_area_descs);
+    TEST_ASSERT(nffs_hash_size == NFFS_HASH_MIN_SIZE);
+}
+
+TEST_CASE(nffs_test_checkpoint)
+{
+    struct fs_file *file;
+    uint32_t obj_count;
+    int rc;
+
+    /*** Setup. */
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_mkdir("/mydir");
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_create_file("/mydir/a.txt", "aaaa", 4);
+    nffs_test_util_create_file("/mydir/b.txt", "bbbb", 4);
+    nffs_test_util_create_file("/c.txt", "cccc", 4);
+    nffs_test_util_append_file("/c.txt", "dd", 2);
+
+    /* An unlinked file that is still open cannot be checkpointed. */
+    rc = fs_open("/mydir/b.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == 0);
+    rc = fs_unlink("/mydir/b.txt");
+    TEST_ASSERT(rc == 0);
+    rc = nffs_checkpoint();
+    TEST_ASSERT(rc == FS_EUNEXP);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    rc = nffs_checkpoint();
+    TEST_ASSERT(rc == 0);
+
+    /* Objects written after the checkpoint get replayed. */
+    nffs_test_util_append_file("/mydir/a.txt", "e", 1);
+    rc = fs_rename("/c.txt", "/mydir/c.txt");
+    TEST_ASSERT(rc == 0);
+
+    /* Only the replayed objects are read from flash: the new block and inode
+     * for a.txt, and the moved c.txt inode.
+     */
+    obj_count = nffs_object_count;
+    rc = nffs_detect(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_object_count - obj_count == 3);
+
+    struct nffs_test_file_desc *expected_system =
+        (struct nffs_test_file_desc[]) { {
+            .filename = "",
+            .is_dir = 1,
+            .children = (struct nffs_test_file_desc[]) { {
+                .filename = "mydir",
+                .is_dir = 1,
+                .children = (struct nffs_test_file_desc[]) { {
+                    .filename = "a.txt",
+                    .contents = "aaaae",
+                    .contents_len = 5,
+                }, {
+                    .filename = "c.txt",
+                    .contents = "ccccdd",
+                    .contents_len = 6,
+                }, {
+                    .filename = NULL,
+                } },
+            }, {
+                .filename = NULL,
+            } },
+    } };
+
+    nffs_test_assert_system(expected_system, nffs_area_descs);
+
+    /* A garbage collection cycle erases the checkpoint.  Unless a new one is
+     * written after the cycle, the next mount falls back to a full scan.
+     */
+    rc = nffs_gc(NULL);
+    TEST_ASSERT(rc == 0);
+    obj_count = nffs_object_count;
+    rc = nffs_detect(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+    if (nffs_config.nc_gc_checkpoint) {
+        TEST_ASSERT(nffs_object_count == obj_count);
+    } else {
+        TEST_ASSERT(nffs_object_count - obj_count > 3);
+    }
+    nffs_test_assert_system_once(expected_system);
+}
+
+TEST_CASE(nffs_test_write_buf)
+{
+    struct fs_file *file2;
+    struct fs_file *file;
+    uint32_t len;
+    char contents[200];
+    char buf[4];
+    uint16_t cap;
+    int rc;
+    int i;
+
+    /*** Setup. */
+    nffs_config.nc_write_buf_size = 64;
+
+    rc = nffs_init();
+    TEST_ASSERT(rc == 0);
+
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+
+    cap = nffs_block_max_data_sz < 64 ? nffs_block_max_data_sz : 64;
+    for (i = 0; i < sizeof contents; i++) {
+        contents[i] = 'a' + i % 26;
+    }
+
+    /* Small appends are coalesced into full blocks. */
+    rc = fs_open("/log", FS_ACCESS_READ | FS_ACCESS_WRITE | FS_ACCESS_APPEND,
+                 &file);
+    TEST_ASSERT(rc == 0);
+    for (i = 0; i < 20; i++) {
+        rc = fs_write(file, contents + i * 10, 10);
+        TEST_ASSERT(rc == 0);
+    }
+    TEST_ASSERT(fs_getpos(file) == 200);
+    rc = fs_filelen(file, &len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(len == 200);
+    TEST_ASSERT(nffs_test_util_block_count("/log") == 200 / cap);
+
+    /* The buffer is written out on an explicit flush. */
+    rc = fs_flush(file);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_test_util_block_count("/log") == (200 + cap - 1) / cap);
+    nffs_test_util_assert_contents("/log", contents, 200);
+
+    /* Reading through the writing handle sees the buffered data. */
+    rc = fs_write(file, "x", 1);
+    TEST_ASSERT(rc == 0);
+    rc = fs_seek(file, 199);
+    TEST_ASSERT(rc == 0);
+    rc = fs_read(file, sizeof buf, buf, &len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(len == 2);
+    TEST_ASSERT(buf[0] == contents[199] && buf[1] == 'x');
+
+    /* Aged buffers are flushed by the background task. */
+    rc = fs_open("/log2", FS_ACCESS_WRITE, &file2);
+    TEST_ASSERT(rc == 0);
+    rc = fs_write(file2, "abc", 3);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_test_util_block_count("/log2") == 0);
+    rc = nffs_write_flush_aged(0);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_test_util_block_count("/log2") == 1);
+
+    /* Closing a file flushes it. */
+    rc = fs_write(file2, "def", 3);
+    TEST_ASSERT(rc == 0);
+    rc = fs_close(file2);
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_assert_contents("/log2", "abcdef", 6);
+
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    nffs_config.nc_write_buf_size = 0;
+    rc = nffs_init();
+    TEST_ASSERT(rc == 0);
+}
+
 TEST_CASE(nffs_test_gc)
 {
     int rc;
@@ -1873,15 +2520,124 @@ TEST_CASE(nffs_test_gc)
         .data_len = 1,
     } };
 
-
-    rc = nffs_format(area_descs_two);
-    TEST_ASSERT(rc == 0);
-
-    nffs_test_util_create_file_blocks("/myfile.txt", blocks, 8);
-
-    nffs_gc(NULL);
-
-    nffs_test_util_assert_block_count("/myfile.txt", 1);
+
+    rc = nffs_format(area_descs_two);
+    TEST_ASSERT(rc == 0);
+
+    nffs_test_util_create_file_blocks("/myfile.txt", blocks, 8);
+
+    nffs_gc(NULL);
+
+    nffs_test_util_assert_block_count("/myfile.txt", 1);
+}
+
+TEST_CASE(nffs_test_gc_incremental)
+{
+    unsigned int gc_count;
+    char b_contents[128];
+    char contents[16];
+    int b_len;
+    int len;
+    int rc;
+    int i;
+
+    static const struct nffs_area_desc area_descs_uniform[] = {
+        { 0x00000000, 2 * 1024 },
+        { 0x00020000, 2 * 1024 },
+        { 0x00040000, 2 * 1024 },
+        { 0x00060000, 2 * 1024 },
+        { 0x00080000, 2 * 1024 },
+        { 0, 0 },
+    };
+
+    /*** Setup. */
+    rc = nffs_format(area_descs_uniform);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_mkdir("/mydir");
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_create_file("/mydir/b", "1234", 4);
+    memcpy(b_contents, "1234", 4);
+    b_len = 4;
+
+    /* Leave garbage behind by repeatedly overwriting a file. */
+    for (i = 0; i < 40; i++) {
+        len = snprintf(contents, sizeof contents, "contents%d", i);
+        nffs_test_util_create_file("/a.txt", contents, len);
+    }
+
+    /* Nothing happens while background collection is disabled. */
+    TEST_ASSERT(nffs_config.nc_gc_free_areas == 0);
+    gc_count = nffs_gc_count;
+    rc = nffs_gc_idle_step(1);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_gc_area_idx == NFFS_AREA_ID_NONE);
+    TEST_ASSERT(nffs_gc_count == gc_count);
+
+    /* Interleave single-slot steps with writes. */
+    nffs_config.nc_gc_free_areas = 3;
+    for (i = 0; i < 1024; i++) {
+        rc = nffs_gc_idle_step(1);
+        TEST_ASSERT(rc == 0);
+        if (i % 64 == 0) {
+            nffs_test_util_append_file("/mydir/b", "5", 1);
+            b_contents[b_len++] = '5';
+        }
+    }
+    TEST_ASSERT(nffs_gc_count > gc_count);
+
+    /* A synchronous collection completes an unfinished cycle. */
+    for (i = 0; nffs_gc_area_idx == NFFS_AREA_ID_NONE; i++) {
+        TEST_ASSERT_FATAL(i < 64);
+        nffs_test_util_append_file("/mydir/b", "6", 1);
+        b_contents[b_len++] = '6';
+        rc = nffs_gc_idle_step(1);
+        TEST_ASSERT(rc == 0);
+    }
+    gc_count = nffs_gc_count;
+    rc = nffs_gc(NULL);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_gc_area_idx == NFFS_AREA_ID_NONE);
+    TEST_ASSERT(nffs_gc_count == gc_count + 1);
+
+    /* Once collection stops reclaiming space, no new cycles get started. */
+    for (i = 0; i < 4096; i++) {
+        rc = nffs_gc_idle_step(NFFS_HASH_MIN_SIZE);
+        TEST_ASSERT(rc == 0);
+    }
+    TEST_ASSERT(nffs_gc_area_idx == NFFS_AREA_ID_NONE);
+    gc_count = nffs_gc_count;
+    rc = nffs_gc_idle_step(NFFS_HASH_MIN_SIZE);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_gc_count == gc_count);
+    TEST_ASSERT(nffs_gc_area_idx == NFFS_AREA_ID_NONE);
+
+    nffs_config.nc_gc_free_areas = 0;
+
+    struct nffs_test_file_desc *expected_system =
+        (struct nffs_test_file_desc[]) { {
+            .filename = "",
+            .is_dir = 1,
+            .children = (struct nffs_test_file_desc[]) { {
+                .filename = "a.txt",
+                .contents = "contents39",
+                .contents_len = 10,
+            }, {
+                .filename = "mydir",
+                .is_dir = 1,
+                .children = (struct nffs_test_file_desc[]) { {
+                    .filename = "b",
+                    .contents = b_contents,
+                    .contents_len = b_len,
+                }, {
+                    .filename = NULL,
+                } },
+            }, {
+                .filename = NULL,
+            } },
+    } };
+
+    nffs_test_assert_system(expected_system, area_descs_uniform);
 }
 
 TEST_CASE(nffs_test_wear_level)
@@ -1923,6 +2679,227 @@ TEST_CASE(nffs_test_wear_level)
     }
 }
 
+TEST_CASE(nffs_test_wear_erase_cnt)
+{
+    struct nffs_disk_area disk_area;
+    uint32_t erase_cnts[5];
+    uint32_t min_cnt;
+    uint32_t max_cnt;
+    uint32_t erases;
+    int worn_idx;
+    int rc;
+    int i;
+
+    static const struct nffs_area_desc area_descs_uniform[] = {
+        { 0x00000000, 2 * 1024 },
+        { 0x00020000, 2 * 1024 },
+        { 0x00040000, 2 * 1024 },
+        { 0x00060000, 2 * 1024 },
+        { 0x00080000, 2 * 1024 },
+        { 0, 0 },
+    };
+
+    /*** Setup. */
+    rc = nffs_format(area_descs_uniform);
+    TEST_ASSERT(rc == 0);
+
+    /* Erase counts survive a reformat. */
+    for (i = 0; i < nffs_num_areas; i++) {
+        erase_cnts[i] = nffs_areas[i].na_erase_cnt;
+    }
+    erases = nffs_stats.STATS_SECT_VAR(area_erases);
+    rc = nffs_format(area_descs_uniform);
+    TEST_ASSERT(rc == 0);
+    for (i = 0; i < nffs_num_areas; i++) {
+        TEST_ASSERT(nffs_areas[i].na_erase_cnt == erase_cnts[i] + 1);
+    }
+    TEST_ASSERT(nffs_stats.STATS_SECT_VAR(area_erases) ==
+                erases + nffs_num_areas);
+
+    /* A heavily worn area is skipped by garbage collection until the others
+     * catch up.
+     */
+    for (i = 0; i < nffs_num_areas; i++) {
+        nffs_areas[i].na_erase_cnt = 100;
+    }
+    worn_idx = (nffs_scratch_area_idx + 1) % nffs_num_areas;
+    nffs_areas[worn_idx].na_erase_cnt += 2 * NFFS_GC_WEAR_THRESHOLD;
+    for (i = 0; i < nffs_num_areas * 2; i++) {
+        rc = nffs_gc(NULL);
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(nffs_scratch_area_idx != worn_idx);
+    }
+    TEST_ASSERT(nffs_areas[worn_idx].na_erase_cnt ==
+                100 + 2 * NFFS_GC_WEAR_THRESHOLD);
+
+    /* The other areas were rotated evenly.  A checkpoint written after each
+     * cycle costs the scratch area one more erase.
+     */
+    min_cnt = UINT32_MAX;
+    max_cnt = 0;
+    for (i = 0; i < nffs_num_areas; i++) {
+        if (i != worn_idx) {
+            if (nffs_areas[i].na_erase_cnt < min_cnt) {
+                min_cnt = nffs_areas[i].na_erase_cnt;
+            }
+            if (nffs_areas[i].na_erase_cnt > max_cnt) {
+                max_cnt = nffs_areas[i].na_erase_cnt;
+            }
+        }
+    }
+    TEST_ASSERT(min_cnt > 100);
+    TEST_ASSERT(max_cnt - min_cnt <= (nffs_config.nc_gc_checkpoint ? 2 : 1));
+    TEST_ASSERT(nffs_stats.STATS_SECT_VAR(area_erase_cnt_max) ==
+                100 + 2 * NFFS_GC_WEAR_THRESHOLD);
+    TEST_ASSERT(nffs_stats.STATS_SECT_VAR(area_erase_cnt_min) == min_cnt);
+
+    /* Erase counts are persisted in the area headers. */
+    for (i = 0; i < nffs_num_areas; i++) {
+        erase_cnts[i] = nffs_areas[i].na_erase_cnt;
+        if (i != worn_idx) {
+            rc = nffs_flash_read(i, 0, &disk_area, sizeof disk_area);
+            TEST_ASSERT(rc == 0);
+            TEST_ASSERT(disk_area.nda_erase_cnt == erase_cnts[i]);
+        }
+    }
+
+    rc = nffs_detect(area_descs_uniform);
+    TEST_ASSERT(rc == 0);
+    for (i = 0; i < nffs_num_areas; i++) {
+        if (i != worn_idx) {
+            TEST_ASSERT(nffs_areas[i].na_erase_cnt == erase_cnts[i]);
+        }
+    }
+}
+
+TEST_CASE(nffs_test_format_blank)
+{
+    uint32_t erases;
+    int rc;
+    int i;
+
+    static const struct nffs_area_desc area_descs_blank[] = {
+        { 0x00000000, 16 * 1024 },
+        { 0x00004000, 16 * 1024 },
+        { 0x00008000, 16 * 1024 },
+        { 0x0000c000, 16 * 1024 },
+        { 0, 0 },
+    };
+
+    /*** Setup. */
+    rc = hal_flash_erase(0, 0, 64 * 1024);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(hal_flash_is_erased(0, 0, 64 * 1024) == 1);
+
+    /* Nothing to detect on a blank medium. */
+    rc = nffs_detect(area_descs_blank);
+    TEST_ASSERT(rc == FS_ECORRUPT);
+
+    /* Formatting blank flash doesn't erase it again. */
+    erases = nffs_stats.STATS_SECT_VAR(area_erases);
+    rc = nffs_format(area_descs_blank);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_stats.STATS_SECT_VAR(area_erases) == erases);
+    for (i = 0; i < nffs_num_areas; i++) {
+        TEST_ASSERT(nffs_areas[i].na_erase_cnt == 0);
+        TEST_ASSERT(hal_flash_is_erased(0, nffs_areas[i].na_offset, 16) == 0);
+    }
+
+    nffs_test_util_create_file("/myfile.txt", "0123456789", 10);
+
+    /* Formatted areas do get erased. */
+    rc = nffs_format(area_descs_blank);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_stats.STATS_SECT_VAR(area_erases) ==
+                erases + nffs_num_areas);
+    for (i = 0; i < nffs_num_areas; i++) {
+        TEST_ASSERT(nffs_areas[i].na_erase_cnt == 1);
+    }
+
+    rc = nffs_detect(area_descs_blank);
+    TEST_ASSERT(rc == 0);
+    rc = fs_unlink("/myfile.txt");
+    TEST_ASSERT(rc == FS_ENOENT);
+}
+
+TEST_CASE(nffs_test_restore_v1)
+{
+    struct nffs_disk_area *disk_area;
+    struct nffs_disk_area hdr;
+    uint8_t *buf;
+    int rc;
+    int i;
+
+    static const struct nffs_area_desc area_descs_v1[] = {
+        { 0x00000000, 16 * 1024 },
+        { 0x00004000, 16 * 1024 },
+        { 0x00008000, 16 * 1024 },
+        { 0x0000c000, 16 * 1024 },
+        { 0, 0 },
+    };
+
+    /*** Setup. */
+    rc = nffs_format(area_descs_v1);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_mkdir("/mydir");
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_create_file("/mydir/a.txt", "aaaa", 4);
+    nffs_test_util_create_file("/b.txt", "0123456789", 10);
+
+    /* Rewrite every area header as version 1: the fourth magic word in place
+     * of the erase count.
+     */
+    buf = malloc(16 * 1024);
+    TEST_ASSERT(buf != NULL);
+    for (i = 0; area_descs_v1[i].nad_length != 0; i++) {
+        rc = hal_flash_read(area_descs_v1[i].nad_flash_id,
+                            area_descs_v1[i].nad_offset, buf,
+                            area_descs_v1[i].nad_length);
+        TEST_ASSERT(rc == 0);
+
+        disk_area = (struct nffs_disk_area *)buf;
+        disk_area->nda_erase_cnt = NFFS_AREA_MAGIC3;
+        disk_area->nda_ver = NFFS_AREA_VER_1;
+
+        rc = hal_flash_erase(area_descs_v1[i].nad_flash_id,
+                             area_descs_v1[i].nad_offset,
+                             area_descs_v1[i].nad_length);
+        TEST_ASSERT(rc == 0);
+        rc = hal_flash_write(area_descs_v1[i].nad_flash_id,
+                             area_descs_v1[i].nad_offset, buf,
+                             area_descs_v1[i].nad_length);
+        TEST_ASSERT(rc == 0);
+    }
+    free(buf);
+
+    /* A version 1 image restores with its files intact and no wear history. */
+    rc = nffs_detect(area_descs_v1);
+    TEST_ASSERT(rc == 0);
+    for (i = 0; i < nffs_num_areas; i++) {
+        TEST_ASSERT(nffs_areas[i].na_erase_cnt == 0);
+    }
+    nffs_test_util_assert_contents("/mydir/a.txt", "aaaa", 4);
+    nffs_test_util_assert_contents("/b.txt", "0123456789", 10);
+
+    /* Garbage collection upgrades areas one at a time; a mix of versions
+     * still restores.
+     */
+    rc = nffs_gc(NULL);
+    TEST_ASSERT(rc == 0);
+    rc = nffs_flash_read(nffs_scratch_area_idx, 0, &hdr, sizeof hdr);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(nffs_area_is_current_version(&hdr));
+    TEST_ASSERT(hdr.nda_erase_cnt != 0);
+    TEST_ASSERT(hdr.nda_erase_cnt ==
+                nffs_areas[nffs_scratch_area_idx].na_erase_cnt);
+
+    rc = nffs_detect(area_descs_v1);
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_assert_contents("/mydir/a.txt", "aaaa", 4);
+    nffs_test_util_assert_contents("/b.txt", "0123456789", 10);
+}
+
 TEST_CASE(nffs_test_corrupt_scratch)
 {
     int non_scratch_id;
@@ -2377,16 +3354,16 @@ TEST_CASE(nffs_test_cache_large_file)
     TEST_ASSERT(rc == 0);
     nffs_test_util_assert_cache_range("/myfile.txt", 0, 0);
 
-    /* Cache first block. */
+    /* Cache first block; the second block gets read ahead. */
     rc = fs_seek(file, nffs_block_max_data_sz * 0);
     TEST_ASSERT(rc == 0);
     rc = fs_read(file, 1, &b, NULL);
     TEST_ASSERT(rc == 0);
     nffs_test_util_assert_cache_range("/myfile.txt",
                                      nffs_block_max_data_sz * 0,
-                                     nffs_block_max_data_sz * 1);
+                                     nffs_block_max_data_sz * 2);
 
-    /* Cache second block. */
+    /* Second block is already cached. */
     rc = fs_seek(file, nffs_block_max_data_sz * 1);
     TEST_ASSERT(rc == 0);
     rc = fs_read(file, 1, &b, NULL);
@@ -2396,7 +3373,9 @@ TEST_CASE(nffs_test_cache_large_file)
                                      nffs_block_max_data_sz * 2);
 
 
-    /* Cache fourth block; prior cache should get erased. */
+    /* Cache fourth block; prior cache should get erased.  This is not a
+     * sequential access, so nothing is read ahead.
+     */
     rc = fs_seek(file, nffs_block_max_data_sz * 3);
     TEST_ASSERT(rc == 0);
     rc = fs_read(file, 1, &b, NULL);
@@ -2427,6 +3406,59 @@ TEST_CASE(nffs_test_cache_large_file)
     TEST_ASSERT(rc == 0);
 }
 
+TEST_CASE(nffs_test_cache_readahead)
+{
+    static char data[NFFS_BLOCK_MAX_DATA_SZ_MAX * 20];
+    struct fs_file *file;
+    uint32_t misses;
+    uint32_t hits;
+    uint32_t len;
+    char *buf;
+    int rc;
+    int i;
+
+    /*** Setup. */
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i;
+    }
+    nffs_test_util_create_file("/myfile.txt", data,
+                               nffs_block_max_data_sz * 20);
+    nffs_test_util_assert_block_count("/myfile.txt", 20);
+    nffs_cache_clear();
+
+    buf = malloc(nffs_block_max_data_sz);
+    TEST_ASSERT_FATAL(buf != NULL);
+
+    /* Stream the file one block at a time.  Each miss reads the next four
+     * blocks ahead.
+     */
+    nffs_config.nc_cache_readahead = 4;
+    hits = nffs_cache_block_hits;
+    misses = nffs_cache_block_misses;
+
+    rc = fs_open("/myfile.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == 0);
+    for (i = 0; i < 20; i++) {
+        rc = fs_read(file, nffs_block_max_data_sz, buf, &len);
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(len == nffs_block_max_data_sz);
+        TEST_ASSERT(memcmp(buf, data + i * len, len) == 0);
+    }
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT(nffs_cache_block_misses - misses == 4);
+    TEST_ASSERT(nffs_cache_block_hits - hits == 16);
+    nffs_test_util_assert_cache_range("/myfile.txt", 0,
+                                      nffs_block_max_data_sz * 20);
+
+    nffs_config.nc_cache_readahead = 1;
+    free(buf);
+}
+
 TEST_CASE(nffs_test_readdir)
 {
     struct fs_dirent *dirent;
@@ -2531,6 +3563,133 @@ TEST_CASE(nffs_test_readdir)
     TEST_ASSERT(rc == FS_ENOENT);
 }
 
+TEST_CASE(nffs_test_readdir_batch)
+{
+    struct fs_dirent_info entries[2];
+    struct fs_dir_cursor cursor;
+    struct fs_dir *dir;
+    int cnt;
+    int rc;
+
+    /*** Setup. */
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = fs_mkdir("/mydir");
+    TEST_ASSERT_FATAL(rc == 0);
+
+    nffs_test_util_create_file("/mydir/b", "bbbb", 4);
+    nffs_test_util_create_file("/mydir/a", "aaaaaa", 6);
+    nffs_test_util_create_file("/mydir/d", "d", 1);
+    rc = fs_mkdir("/mydir/c");
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = fs_opendir("/mydir", &dir);
+    TEST_ASSERT_FATAL(rc == 0);
+    memset(&cursor, 0, sizeof cursor);
+
+    /* First batch; names, types and sizes. */
+    rc = fs_readdir_batch(dir, &cursor, entries, 2, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(cnt == 2);
+    TEST_ASSERT(strcmp(entries[0].fdi_name, "a") == 0);
+    TEST_ASSERT(entries[0].fdi_name_len == 1);
+    TEST_ASSERT(entries[0].fdi_is_dir == 0);
+    TEST_ASSERT(entries[0].fdi_size == 6);
+    TEST_ASSERT(strcmp(entries[1].fdi_name, "b") == 0);
+    TEST_ASSERT(entries[1].fdi_size == 4);
+
+    /* Cursor survives closing the directory and inserts around it. */
+    rc = fs_closedir(dir);
+    TEST_ASSERT(rc == 0);
+    nffs_test_util_create_file("/mydir/0", "0", 1);
+    nffs_test_util_create_file("/mydir/bb", "bb", 2);
+    rc = fs_opendir("/mydir", &dir);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = fs_readdir_batch(dir, &cursor, entries, 2, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(cnt == 2);
+    TEST_ASSERT(strcmp(entries[0].fdi_name, "bb") == 0);
+    TEST_ASSERT(entries[0].fdi_size == 2);
+    TEST_ASSERT(strcmp(entries[1].fdi_name, "c") == 0);
+    TEST_ASSERT(entries[1].fdi_is_dir == 1);
+    TEST_ASSERT(entries[1].fdi_size == 0);
+
+    /* Last returned entry removed; resume from the next name. */
+    rc = fs_unlink("/mydir/c");
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_readdir_batch(dir, &cursor, entries, 2, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(cnt == 1);
+    TEST_ASSERT(strcmp(entries[0].fdi_name, "d") == 0);
+    TEST_ASSERT(entries[0].fdi_size == 1);
+
+    rc = fs_readdir_batch(dir, &cursor, entries, 2, &cnt);
+    TEST_ASSERT(rc == FS_ENOENT);
+    TEST_ASSERT(cnt == 0);
+
+    rc = fs_closedir(dir);
+    TEST_ASSERT(rc == 0);
+}
+
+TEST_CASE(nffs_test_mmap)
+{
+    struct nffs_test_block_desc *blocks = (struct nffs_test_block_desc[]) { {
+        .data = "abcdefgh",
+        .data_len = 8,
+    }, {
+        .data = "ijklmnop",
+        .data_len = 8,
+    }, {
+        .data = "qrst",
+        .data_len = 4,
+    } };
+
+    struct nffs_mmap_seg segs[4];
+    struct fs_file *file;
+    int cnt;
+    int rc;
+
+    /*** Setup. */
+    rc = nffs_format(nffs_area_descs);
+    TEST_ASSERT(rc == 0);
+
+    nffs_test_util_create_file_blocks("/myfile.txt", blocks, 3);
+    rc = fs_open("/myfile.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Whole file; one segment per block. */
+    rc = nffs_file_mmap(file, 0, segs, 4, &cnt);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT_FATAL(cnt == 3);
+    TEST_ASSERT(segs[0].nms_len == 8);
+    TEST_ASSERT(memcmp(segs[0].nms_data, "abcdefgh", 8) == 0);
+    TEST_ASSERT(segs[1].nms_len == 8);
+    TEST_ASSERT(memcmp(segs[1].nms_data, "ijklmnop", 8) == 0);
+    TEST_ASSERT(segs[2].nms_len == 4);
+    TEST_ASSERT(memcmp(segs[2].nms_data, "qrst", 4) == 0);
+
+    /*** Start in the middle of a block, limited segment count. */
+    rc = nffs_file_mmap(file, 10, segs, 1, &cnt);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT_FATAL(cnt == 1);
+    TEST_ASSERT(segs[0].nms_len == 6);
+    TEST_ASSERT(memcmp(segs[0].nms_data, "klmnop", 6) == 0);
+
+    /*** End of file. */
+    rc = nffs_file_mmap(file, 20, segs, 4, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cnt == 0);
+
+    rc = nffs_file_mmap(file, 21, segs, 4, &cnt);
+    TEST_ASSERT(rc == FS_EOFFSET);
+
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+}
+
 TEST_CASE(nffs_test_split_file)
 {
     static char data[24 * 1024];
@@ -2651,11 +3810,13 @@ TEST_SUITE(nffs_suite_cache)
     memset(&nffs_config, 0, sizeof nffs_config);
     nffs_config.nc_num_cache_inodes = 4;
     nffs_config.nc_num_cache_blocks = 64;
+    nffs_config.nc_cache_readahead = 1;
 
     rc = nffs_init();
     TEST_ASSERT(rc == 0);
 
     nffs_test_cache_large_file();
+    nffs_test_cache_readahead();
 }
 
 static void
@@ -2670,8 +3831,11 @@ nffs_test_gen(void)
     nffs_test_mkdir();
     nffs_test_rename();
     nffs_test_truncate();
+    nffs_test_truncate_in_place();
+    nffs_test_preallocate();
     nffs_test_append();
     nffs_test_read();
+    nffs_test_readv_mbuf();
     nffs_test_open();
     nffs_test_overwrite_one();
     nffs_test_overwrite_two();
@@ -2679,9 +3843,18 @@ nffs_test_gen(void)
     nffs_test_overwrite_many();
     nffs_test_long_filename();
     nffs_test_large_write();
+    nffs_test_write_lock_blocks();
     nffs_test_many_children();
+    nffs_test_path_cache();
+    nffs_test_hash_resize();
+    nffs_test_checkpoint();
+    nffs_test_write_buf();
     nffs_test_gc();
+    nffs_test_gc_incremental();
     nffs_test_wear_level();
+    nffs_test_wear_erase_cnt();
+    nffs_test_format_blank();
+    nffs_test_restore_v1();
     nffs_test_corrupt_scratch();
     nffs_test_incomplete_block();
     nffs_test_corrupt_block();
@@ -2689,6 +3862,8 @@ nffs_test_gen(void)
     nffs_test_large_system();
     nffs_test_lost_found();
     nffs_test_readdir();
+    nffs_test_readdir_batch();
+    nffs_test_mmap();
     nffs_test_split_file();
     nffs_test_gc_on_oom();
 }
@@ -2704,7 +3879,9 @@ TEST_SUITE(gen_4_32)
 {
     nffs_config.nc_num_cache_inodes = 4;
     nffs_config.nc_num_cache_blocks = 32;
+    nffs_config.nc_gc_checkpoint = 1;
     nffs_test_gen();
+    nffs_config.nc_gc_checkpoint = 0;
 }
 
 TEST_SUITE(gen_32_1024)
@@ -2885,26 +4062,19 @@ print_nffs_flash_areas(int verbose)
     }
 }
 
-static int
-nffs_hash_fn(uint32_t id)
-{
-    return id % NFFS_HASH_SIZE;
-}
-
 void
 print_hashlist(struct nffs_hash_entry *he)
 {
-    struct nffs_hash_list *list;
-    int idx = nffs_hash_fn(he->nhe_id);
-    list = nffs_hash + idx;
+    uint32_t i;
 
-    SLIST_FOREACH(he, list, nhe_next) {
-        printf("hash_entry %s 0x%x: id 0x%x flash_loc 0x%x next 0x%x\n",
+    for (i = 0; i < nffs_hash_size; i++) {
+        if (nffs_hash[i].nhs_entry == he) {
+            printf("hash_entry %s slot %u 0x%x: id 0x%x flash_loc 0x%x\n",
                    nffs_hash_id_is_inode(he->nhe_id) ? "inode" : "block",
-                   (unsigned int)he,
-                   he->nhe_id, he->nhe_flash_loc,
-                   (unsigned int)he->nhe_next.sle_next);
-   }
+                   (unsigned int)i, (unsigned int)he,
+                   he->nhe_id, he->nhe_flash_loc);
+        }
+    }
 }
 
 void
@@ -2912,7 +4082,6 @@ print_hash(void)
 {
     int i;
     struct nffs_hash_entry *he;
-    struct nffs_hash_entry *next;
     struct nffs_inode ni;
     struct nffs_disk_inode di;
     struct nffs_block nb;
@@ -2921,12 +4090,11 @@ print_hash(void)
     uint8_t area_idx;
     int rc;
 
-    NFFS_HASH_FOREACH(he, i, next) {
+    NFFS_HASH_FOREACH(he, i) {
         if (nffs_hash_id_is_inode(he->nhe_id)) {
-            printf("hash_entry inode %d 0x%x: id 0x%x flash_loc 0x%x next 0x%x\n",
+            printf("hash_entry inode %d 0x%x: id 0x%x flash_loc 0x%x\n",
                    i, (unsigned int)he,
-                   he->nhe_id, he->nhe_flash_loc,
-                   (unsigned int)he->nhe_next.sle_next);
+                   he->nhe_id, he->nhe_flash_loc);
             if (he->nhe_id == NFFS_ID_ROOT_DIR) {
                 continue;
             }
@@ -3163,22 +4331,16 @@ print_hash_entries(int verbose)
 {
     int i;
     struct nffs_hash_entry *he;
-    struct nffs_hash_entry *next;
 
     printf("\nnffs_hash_entries:\n");
-    for (i = 0; i < NFFS_HASH_SIZE; i++) {
-        he = SLIST_FIRST(nffs_hash + i);
-        while (he != NULL) {
-            next = SLIST_NEXT(he, nhe_next);
-            if (nffs_hash_id_is_inode(he->nhe_id)) {
-                print_nffs_hash_inode(he, verbose);
-            } else if (nffs_hash_id_is_block(he->nhe_id)) {
-                print_nffs_hash_block(he, verbose);
-            } else {
-                printf("UNKNOWN type hash entry %d: id 0x%x loc 0x%x\n",
-                       i, he->nhe_id, he->nhe_flash_loc);
-            }
-            he = next;
+    NFFS_HASH_FOREACH(he, i) {
+        if (nffs_hash_id_is_inode(he->nhe_id)) {
+            print_nffs_hash_inode(he, verbose);
+        } else if (nffs_hash_id_is_block(he->nhe_id)) {
+            print_nffs_hash_block(he, verbose);
+        } else {
+            printf("UNKNOWN type hash entry %d: id 0x%x loc 0x%x\n",
+                   i, he->nhe_id, he->nhe_flash_loc);
         }
     }
 }
@@ -3187,10 +4349,9 @@ void
 print_nffs_hashlist(int verbose)
 {
     struct nffs_hash_entry *he;
-    struct nffs_hash_entry *next;
     int i;
 
-    NFFS_HASH_FOREACH(he, i, next) {
+    NFFS_HASH_FOREACH(he, i) {
         if (nffs_hash_id_is_inode(he->nhe_id)) {
             print_nffs_hash_inode(he, verbose);
         } else if (nffs_hash_id_is_block(he->nhe_id)) {
@@ -3244,6 +4405,12 @@ main(void)
 
     nffs_test_all();
 
+    memset(&nffs_config, 0, sizeof nffs_config);
+    nffs_config.nc_num_inodes = 1024;
+    nffs_config.nc_num_blocks = 1024;
+    nffs_init();
+    nffs_bench_all();
+
     return tu_any_failed;
 }
 
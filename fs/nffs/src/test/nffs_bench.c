@@ -0,0 +1,333 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "hal/hal_flash.h"
+#include "hal/flash_map.h"
+#include "testutil/testutil.h"
+#include "fs/fs.h"
+#include "nffs/nffs.h"
+#include "nffs/nffs_test.h"
+#include "nffs_priv.h"
+
+/*
+ * NFFS benchmarks: mount, sequential and random read and write, append
+ * latency and garbage collection pauses. Runs against the areas in
+ * nffs_bench_area_descs if set, else against FLASH_AREA_NFFS of the flash
+ * map; on sim, with neither, against a fixed layout in the flash
+ * simulator. Contents of these areas are destroyed.
+ *
+ * Results depend on nffs_config, which the caller sets up (and calls
+ * nffs_init()) before nffs_bench_all(); e.g. to compare cache sizes.
+ * Unbuffered appends take a block each, so nc_num_blocks must be larger
+ * than NFFS_BENCH_SAMPLES.
+ * Data and access patterns are generated from a fixed seed, so runs with
+ * the same configuration do the same flash operations.
+ */
+
+#ifndef NFFS_BENCH_FILE_SIZE
+#define NFFS_BENCH_FILE_SIZE    (16 * 1024)
+#endif
+
+/* Size of each read and write call. */
+#ifndef NFFS_BENCH_CHUNK
+#define NFFS_BENCH_CHUNK        256
+#endif
+
+#ifndef NFFS_BENCH_RUNS
+#define NFFS_BENCH_RUNS         9
+#endif
+
+/* Number of per operation samples taken in latency cases. */
+#ifndef NFFS_BENCH_SAMPLES
+#define NFFS_BENCH_SAMPLES      128
+#endif
+
+#ifndef NFFS_BENCH_APPEND_LEN
+#define NFFS_BENCH_APPEND_LEN   32
+#endif
+
+#ifndef NFFS_BENCH_MOUNT_FILES
+#define NFFS_BENCH_MOUNT_FILES  32
+#endif
+
+#define NFFS_BENCH_MAX_AREAS    16
+
+const struct nffs_area_desc *nffs_bench_area_descs;
+
+static struct nffs_area_desc nffs_bench_descs[NFFS_BENCH_MAX_AREAS + 1];
+static const struct nffs_area_desc *nffs_bench_areas;
+
+static uint8_t nffs_bench_buf[NFFS_BENCH_CHUNK];
+static uint32_t nffs_bench_samples[NFFS_BENCH_SAMPLES];
+static uint32_t nffs_bench_seed;
+
+#ifdef ARCH_sim
+static const struct nffs_area_desc nffs_bench_sim_descs[] = {
+        { 0x00000000, 16 * 1024 },
+        { 0x00004000, 16 * 1024 },
+        { 0x00008000, 16 * 1024 },
+        { 0x0000c000, 16 * 1024 },
+        { 0x00010000, 64 * 1024 },
+        { 0, 0 },
+};
+#endif
+
+static uint32_t
+nffs_bench_rand(void)
+{
+    nffs_bench_seed = nffs_bench_seed * 1103515245 + 12345;
+    return nffs_bench_seed >> 8;
+}
+
+static void
+nffs_bench_fill(uint8_t *buf, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = nffs_bench_rand();
+    }
+}
+
+static const struct nffs_area_desc *
+nffs_bench_layout(void)
+{
+    int cnt;
+
+    if (nffs_bench_area_descs) {
+        return nffs_bench_area_descs;
+    }
+    cnt = NFFS_BENCH_MAX_AREAS;
+    if (flash_area_to_nffs_desc(FLASH_AREA_NFFS, &cnt,
+                                nffs_bench_descs) == 0 && cnt > 1) {
+        memset(&nffs_bench_descs[cnt], 0, sizeof(nffs_bench_descs[0]));
+        return nffs_bench_descs;
+    }
+#ifdef ARCH_sim
+    return nffs_bench_sim_descs;
+#else
+    return NULL;
+#endif
+}
+
+static void
+nffs_bench_setup(void)
+{
+    int rc;
+
+    nffs_bench_seed = 1;
+    rc = nffs_format(nffs_bench_areas);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static void
+nffs_bench_write_file(const char *name, int size)
+{
+    struct fs_file *file;
+    int len;
+    int rc;
+
+    rc = fs_open(name, FS_ACCESS_WRITE | FS_ACCESS_TRUNCATE, &file);
+    TEST_ASSERT_FATAL(rc == 0);
+    while (size > 0) {
+        len = size < NFFS_BENCH_CHUNK ? size : NFFS_BENCH_CHUNK;
+        nffs_bench_fill(nffs_bench_buf, len);
+        rc = fs_write(file, nffs_bench_buf, len);
+        TEST_ASSERT_FATAL(rc == 0);
+        size -= len;
+    }
+    rc = fs_close(file);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+/*
+ * Rewrite a NFFS_BENCH_FILE_SIZE file in NFFS_BENCH_CHUNK writes. Each run
+ * leaves the previous contents as garbage, so later runs include
+ * collection cycles, as a long running system would.
+ */
+TEST_BENCH(nffs_bench_seq_write, NFFS_BENCH_RUNS)
+{
+    nffs_bench_write_file("/bench", NFFS_BENCH_FILE_SIZE);
+}
+
+/* Read the file back in NFFS_BENCH_CHUNK reads. */
+TEST_BENCH(nffs_bench_seq_read, NFFS_BENCH_RUNS)
+{
+    struct fs_file *file;
+    uint32_t total;
+    uint32_t len;
+    int rc;
+
+    rc = fs_open("/bench", FS_ACCESS_READ, &file);
+    TEST_ASSERT_FATAL(rc == 0);
+    total = 0;
+    do {
+        rc = fs_read(file, NFFS_BENCH_CHUNK, nffs_bench_buf, &len);
+        TEST_ASSERT_FATAL(rc == 0);
+        total += len;
+    } while (len == NFFS_BENCH_CHUNK);
+    TEST_ASSERT(total == NFFS_BENCH_FILE_SIZE);
+    fs_close(file);
+}
+
+/* NFFS_BENCH_FILE_SIZE / NFFS_BENCH_CHUNK reads at random offsets. */
+TEST_BENCH(nffs_bench_rand_read, NFFS_BENCH_RUNS)
+{
+    struct fs_file *file;
+    uint32_t off;
+    uint32_t len;
+    int rc;
+    int i;
+
+    rc = fs_open("/bench", FS_ACCESS_READ, &file);
+    TEST_ASSERT_FATAL(rc == 0);
+    for (i = 0; i < NFFS_BENCH_FILE_SIZE / NFFS_BENCH_CHUNK; i++) {
+        off = nffs_bench_rand() % (NFFS_BENCH_FILE_SIZE - NFFS_BENCH_CHUNK);
+        rc = fs_seek(file, off);
+        TEST_ASSERT_FATAL(rc == 0);
+        rc = fs_read(file, NFFS_BENCH_CHUNK, nffs_bench_buf, &len);
+        TEST_ASSERT_FATAL(rc == 0 && len == NFFS_BENCH_CHUNK);
+    }
+    fs_close(file);
+}
+
+/* Latency distribution of NFFS_BENCH_APPEND_LEN appends. */
+TEST_CASE(nffs_bench_append)
+{
+    struct fs_file *file;
+    uint32_t start;
+    int rc;
+    int i;
+
+    nffs_bench_setup();
+
+    rc = fs_open("/log", FS_ACCESS_WRITE | FS_ACCESS_APPEND, &file);
+    TEST_ASSERT_FATAL(rc == 0);
+    for (i = 0; i < NFFS_BENCH_SAMPLES; i++) {
+        nffs_bench_fill(nffs_bench_buf, NFFS_BENCH_APPEND_LEN);
+        start = tu_arch_bench_time();
+        rc = fs_write(file, nffs_bench_buf, NFFS_BENCH_APPEND_LEN);
+        nffs_bench_samples[i] = tu_arch_bench_time() - start;
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    tu_bench_report(nffs_bench_samples, NFFS_BENCH_SAMPLES);
+}
+
+static void
+nffs_bench_populate(void)
+{
+    char name[16];
+    int rc;
+    int i;
+
+    nffs_bench_setup();
+
+    rc = fs_mkdir("/dir");
+    TEST_ASSERT_FATAL(rc == 0);
+    for (i = 0; i < NFFS_BENCH_MOUNT_FILES; i++) {
+        sprintf(name, "/dir/f%d", i);
+        nffs_bench_write_file(name, NFFS_BENCH_CHUNK * (1 + i % 4));
+    }
+}
+
+static void
+nffs_bench_mount_samples(void)
+{
+    uint32_t start;
+    int rc;
+    int i;
+
+    for (i = 0; i < NFFS_BENCH_RUNS; i++) {
+        start = tu_arch_bench_time();
+        rc = nffs_detect(nffs_bench_areas);
+        nffs_bench_samples[i] = tu_arch_bench_time() - start;
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    tu_bench_report(nffs_bench_samples, NFFS_BENCH_RUNS);
+}
+
+/* Mount with a full scan of NFFS_BENCH_MOUNT_FILES files. */
+TEST_CASE(nffs_bench_mount)
+{
+    nffs_bench_populate();
+    nffs_bench_mount_samples();
+}
+
+/* Same, restoring from a checkpoint. */
+TEST_CASE(nffs_bench_mount_ckpt)
+{
+    int rc;
+
+    nffs_bench_populate();
+    rc = nffs_checkpoint();
+    TEST_ASSERT_FATAL(rc == 0);
+    nffs_bench_mount_samples();
+}
+
+/*
+ * Pause of each collection cycle, with the file system partially filled
+ * with live data, and the rest with garbage.
+ */
+TEST_CASE(nffs_bench_gc)
+{
+    uint32_t start;
+    int cnt;
+    int rc;
+    int i;
+
+    nffs_bench_populate();
+    for (i = 0; i < 4; i++) {
+        nffs_bench_write_file("/dir/f0", NFFS_BENCH_FILE_SIZE / 2);
+    }
+
+    for (cnt = 0; nffs_bench_areas[cnt].nad_length != 0; cnt++);
+    cnt *= 2;
+    if (cnt > NFFS_BENCH_SAMPLES) {
+        cnt = NFFS_BENCH_SAMPLES;
+    }
+    for (i = 0; i < cnt; i++) {
+        start = tu_arch_bench_time();
+        rc = nffs_gc(NULL);
+        nffs_bench_samples[i] = tu_arch_bench_time() - start;
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    tu_bench_report(nffs_bench_samples, cnt);
+}
+
+TEST_SUITE(nffs_bench_all)
+{
+    nffs_bench_areas = nffs_bench_layout();
+    if (!nffs_bench_areas) {
+        return;
+    }
+
+    nffs_bench_setup();
+    nffs_bench_seq_write();
+    nffs_bench_seq_read();
+    nffs_bench_rand_read();
+    nffs_bench_append();
+    nffs_bench_mount();
+    nffs_bench_mount_ckpt();
+    nffs_bench_gc();
+}
@@ -0,0 +1,78 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_ROMFS_
+#define H_ROMFS_
+
+#include <inttypes.h>
+
+/*
+ * Image layout.  All fields are little-endian; the image must be 4-byte
+ * aligned in memory.
+ *
+ * struct romfs_hdr
+ * struct romfs_ent[rh_num_ents]
+ * names and file data, referenced by offset from the start of the image
+ *
+ * Entry 0 is the root directory.  The children of a directory are
+ * consecutive entries, sorted by name: bytewise over the shorter length,
+ * then shorter name first.  Lookups are a binary search at each level, and
+ * nothing is kept in RAM per file.
+ */
+#define ROMFS_MAGIC             0x53464f52      /* "ROFS" */
+#define ROMFS_VERSION           1
+
+struct romfs_hdr {
+    uint32_t rh_magic;
+    uint16_t rh_version;
+    uint16_t _pad;
+    uint32_t rh_num_ents;
+    uint32_t rh_img_len;        /* Whole image, including this header */
+};
+
+#define ROMFS_ENT_DIR           0x0001
+
+/*
+ * For files, re_off is the image offset of the data and re_len its length.
+ * For directories, re_off is the index of the first child entry and re_len
+ * the number of children.
+ */
+struct romfs_ent {
+    uint32_t re_name_off;       /* Image offset of name, no null-terminator */
+    uint32_t re_off;
+    uint32_t re_len;
+    uint16_t re_name_len;
+    uint16_t re_flags;
+};
+
+#ifndef ROMFS_MAX_FILES
+#define ROMFS_MAX_FILES         4
+#endif
+
+#ifndef ROMFS_MAX_DIRS
+#define ROMFS_MAX_DIRS          4
+#endif
+
+struct fs_file;
+
+int romfs_mount(const void *img, const char *prefix);
+int romfs_file_mmap(struct fs_file *file, const void **out_data,
+  uint32_t *out_len);
+
+#endif
@@ -0,0 +1,550 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+
+#include <os/os.h>
+#include <fs/fs.h>
+#include <fs/fs_if.h>
+
+#include "romfs/romfs.h"
+
+struct romfs_file {
+    struct fs_hdl rf_hdl;               /* Must be first. */
+    const struct romfs_ent *rf_ent;
+    uint32_t rf_pos;
+};
+
+struct romfs_dirent {
+    struct fs_hdl rde_hdl;              /* Must be first. */
+    const struct romfs_ent *rde_ent;
+};
+
+struct romfs_dir {
+    struct fs_hdl rd_hdl;               /* Must be first. */
+    const struct romfs_ent *rd_ent;
+    uint32_t rd_next;                   /* Index of next child to return */
+    struct romfs_dirent rd_dirent;
+};
+
+static int romfs_open(const char *path, uint8_t access_flags,
+  struct fs_file **out_file);
+static int romfs_close(struct fs_file *fs_file);
+static int romfs_read(struct fs_file *fs_file, uint32_t len, void *out_data,
+  uint32_t *out_len);
+static int romfs_write(struct fs_file *fs_file, const void *data, int len);
+static int romfs_seek(struct fs_file *fs_file, uint32_t offset);
+static uint32_t romfs_getpos(const struct fs_file *fs_file);
+static int romfs_file_len(const struct fs_file *fs_file, uint32_t *out_len);
+static int romfs_unlink(const char *path);
+static int romfs_rename(const char *from, const char *to);
+static int romfs_mkdir(const char *path);
+static int romfs_opendir(const char *path, struct fs_dir **out_fs_dir);
+static int romfs_readdir(struct fs_dir *fs_dir,
+  struct fs_dirent **out_fs_dirent);
+static int romfs_closedir(struct fs_dir *fs_dir);
+static int romfs_dirent_name(const struct fs_dirent *fs_dirent,
+  size_t max_len, char *out_name, uint8_t *out_name_len);
+static int romfs_dirent_is_dir(const struct fs_dirent *fs_dirent);
+static int romfs_readdir_batch(struct fs_dir *fs_dir,
+  struct fs_dir_cursor *cursor, struct fs_dirent_info *entries,
+  int max_entries, int *out_cnt);
+
+static const struct fs_ops romfs_ops = {
+    .f_open = romfs_open,
+    .f_close = romfs_close,
+    .f_read = romfs_read,
+    .f_write = romfs_write,
+
+    .f_seek = romfs_seek,
+    .f_getpos = romfs_getpos,
+    .f_filelen = romfs_file_len,
+
+    .f_unlink = romfs_unlink,
+    .f_rename = romfs_rename,
+    .f_mkdir = romfs_mkdir,
+
+    .f_opendir = romfs_opendir,
+    .f_readdir = romfs_readdir,
+    .f_closedir = romfs_closedir,
+
+    .f_dirent_name = romfs_dirent_name,
+    .f_dirent_is_dir = romfs_dirent_is_dir,
+    .f_readdir_batch = romfs_readdir_batch,
+
+    .f_name = "romfs"
+};
+
+static const uint8_t *romfs_img;
+static const struct romfs_ent *romfs_ents;
+
+OS_MEMPOOL_DECLARE(romfs_file_pool, ROMFS_MAX_FILES,
+  sizeof(struct romfs_file));
+OS_MEMPOOL_DECLARE(romfs_dir_pool, ROMFS_MAX_DIRS, sizeof(struct romfs_dir));
+
+static int
+romfs_is_dir(const struct romfs_ent *ent)
+{
+    return (ent->re_flags & ROMFS_ENT_DIR) != 0;
+}
+
+static int
+romfs_name_cmp(const struct romfs_ent *ent, const char *name, int len)
+{
+    int rc;
+
+    rc = memcmp(romfs_img + ent->re_name_off, name,
+      ent->re_name_len < len ? ent->re_name_len : len);
+    if (rc == 0) {
+        rc = ent->re_name_len - len;
+    }
+    return rc;
+}
+
+/*
+ * Returns the index of the first child of dir whose name does not sort
+ * before name.  Index is one past the last child if there is no such entry.
+ */
+static uint32_t
+romfs_child_lower_bound(const struct romfs_ent *dir, const char *name,
+  int len)
+{
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t mid;
+
+    lo = dir->re_off;
+    hi = dir->re_off + dir->re_len;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (romfs_name_cmp(&romfs_ents[mid], name, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static const struct romfs_ent *
+romfs_lookup(const char *path)
+{
+    const struct romfs_ent *ent;
+    const char *end;
+    uint32_t idx;
+    int len;
+
+    ent = &romfs_ents[0];
+    while (1) {
+        while (*path == '/') {
+            path++;
+        }
+        if (*path == '\0') {
+            return ent;
+        }
+        if (!romfs_is_dir(ent)) {
+            return NULL;
+        }
+
+        end = strchr(path, '/');
+        len = end ? end - path : strlen(path);
+
+        idx = romfs_child_lower_bound(ent, path, len);
+        if (idx >= ent->re_off + ent->re_len ||
+          romfs_name_cmp(&romfs_ents[idx], path, len) != 0) {
+            return NULL;
+        }
+        ent = &romfs_ents[idx];
+        path += len;
+    }
+}
+
+/*
+ * Checks that every offset in the image stays within it, so that lookups
+ * need no further bounds checks.
+ */
+static int
+romfs_check(const struct romfs_hdr *hdr)
+{
+    const struct romfs_ent *ent;
+    uint32_t i;
+
+    if (hdr->rh_magic != ROMFS_MAGIC || hdr->rh_version != ROMFS_VERSION) {
+        return FS_EUNEXP;
+    }
+    if (hdr->rh_img_len < sizeof(*hdr) || hdr->rh_num_ents == 0 ||
+      hdr->rh_num_ents > (hdr->rh_img_len - sizeof(*hdr)) / sizeof(*ent)) {
+        return FS_ECORRUPT;
+    }
+
+    ent = (const struct romfs_ent *)(hdr + 1);
+    if (!romfs_is_dir(&ent[0])) {
+        return FS_ECORRUPT;
+    }
+    for (i = 0; i < hdr->rh_num_ents; i++, ent++) {
+        if (ent->re_name_off > hdr->rh_img_len ||
+          ent->re_name_len > hdr->rh_img_len - ent->re_name_off) {
+            return FS_ECORRUPT;
+        }
+        if (romfs_is_dir(ent)) {
+            if (ent->re_len != 0 && (ent->re_off <= i ||
+                ent->re_off > hdr->rh_num_ents ||
+                ent->re_len > hdr->rh_num_ents - ent->re_off)) {
+                return FS_ECORRUPT;
+            }
+        } else if (ent->re_off > hdr->rh_img_len ||
+          ent->re_len > hdr->rh_img_len - ent->re_off) {
+            return FS_ECORRUPT;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Makes a romfs image available through the fs API.  The image is accessed
+ * in place, so it must stay mapped, e.g. in internal flash.
+ *
+ * @param img                   The image; 4-byte aligned.
+ * @param prefix                Mount point, e.g. "/rom".  "/" registers
+ *                                  romfs as the root file system.
+ *
+ * @return                      0 on success;
+ *                              FS_EUNEXP if there is no romfs image at img;
+ *                              FS_ECORRUPT if the image is inconsistent;
+ *                              FS_EEXIST if an image is already mounted;
+ *                              other nonzero on failure.
+ */
+int
+romfs_mount(const void *img, const char *prefix)
+{
+    const struct romfs_hdr *hdr;
+    int rc;
+
+    if (romfs_img) {
+        return FS_EEXIST;
+    }
+
+    hdr = img;
+    rc = romfs_check(hdr);
+    if (rc) {
+        return rc;
+    }
+
+    rc = OS_MEMPOOL_INIT(romfs_file_pool, ROMFS_MAX_FILES,
+      sizeof(struct romfs_file));
+    if (rc) {
+        return FS_EOS;
+    }
+    rc = OS_MEMPOOL_INIT(romfs_dir_pool, ROMFS_MAX_DIRS,
+      sizeof(struct romfs_dir));
+    if (rc) {
+        return FS_EOS;
+    }
+
+    romfs_img = img;
+    romfs_ents = (const struct romfs_ent *)(hdr + 1);
+
+    if (!strcmp(prefix, "/")) {
+        rc = fs_register(&romfs_ops);
+    } else {
+        rc = fs_mount(prefix, &romfs_ops);
+    }
+    if (rc) {
+        romfs_img = NULL;
+    }
+    return rc;
+}
+
+/**
+ * Returns a pointer to the whole contents of a romfs file, so that it can be
+ * used without copying.
+ */
+int
+romfs_file_mmap(struct fs_file *fs_file, const void **out_data,
+  uint32_t *out_len)
+{
+    struct romfs_file *file = (struct romfs_file *)fs_file;
+
+    if (file->rf_hdl.fh_ops != &romfs_ops) {
+        return FS_EINVAL;
+    }
+    *out_data = romfs_img + file->rf_ent->re_off;
+    *out_len = file->rf_ent->re_len;
+    return 0;
+}
+
+static int
+romfs_open(const char *path, uint8_t access_flags, struct fs_file **out_file)
+{
+    const struct romfs_ent *ent;
+    struct romfs_file *file;
+
+    if (access_flags & (FS_ACCESS_WRITE | FS_ACCESS_APPEND |
+        FS_ACCESS_TRUNCATE)) {
+        return FS_EACCESS;
+    }
+
+    ent = romfs_lookup(path);
+    if (!ent) {
+        return FS_ENOENT;
+    }
+    if (romfs_is_dir(ent)) {
+        return FS_EINVAL;
+    }
+
+    file = os_memblock_get(&romfs_file_pool);
+    if (!file) {
+        return FS_ENOMEM;
+    }
+    file->rf_ent = ent;
+    file->rf_pos = 0;
+
+    *out_file = (struct fs_file *)file;
+    return 0;
+}
+
+static int
+romfs_close(struct fs_file *fs_file)
+{
+    if (!fs_file) {
+        return 0;
+    }
+    if (os_memblock_put(&romfs_file_pool, fs_file)) {
+        return FS_EOS;
+    }
+    return 0;
+}
+
+static int
+romfs_read(struct fs_file *fs_file, uint32_t len, void *out_data,
+  uint32_t *out_len)
+{
+    struct romfs_file *file = (struct romfs_file *)fs_file;
+    uint32_t left;
+
+    left = file->rf_ent->re_len - file->rf_pos;
+    if (len > left) {
+        len = left;
+    }
+    memcpy(out_data, romfs_img + file->rf_ent->re_off + file->rf_pos, len);
+    file->rf_pos += len;
+
+    if (out_len) {
+        *out_len = len;
+    }
+    return 0;
+}
+
+static int
+romfs_write(struct fs_file *fs_file, const void *data, int len)
+{
+    return FS_EACCESS;
+}
+
+static int
+romfs_seek(struct fs_file *fs_file, uint32_t offset)
+{
+    struct romfs_file *file = (struct romfs_file *)fs_file;
+
+    if (offset > file->rf_ent->re_len) {
+        return FS_EOFFSET;
+    }
+    file->rf_pos = offset;
+    return 0;
+}
+
+static uint32_t
+romfs_getpos(const struct fs_file *fs_file)
+{
+    const struct romfs_file *file = (const struct romfs_file *)fs_file;
+
+    return file->rf_pos;
+}
+
+static int
+romfs_file_len(const struct fs_file *fs_file, uint32_t *out_len)
+{
+    const struct romfs_file *file = (const struct romfs_file *)fs_file;
+
+    *out_len = file->rf_ent->re_len;
+    return 0;
+}
+
+static int
+romfs_unlink(const char *path)
+{
+    return FS_EACCESS;
+}
+
+static int
+romfs_rename(const char *from, const char *to)
+{
+    return FS_EACCESS;
+}
+
+static int
+romfs_mkdir(const char *path)
+{
+    return FS_EACCESS;
+}
+
+static int
+romfs_opendir(const char *path, struct fs_dir **out_fs_dir)
+{
+    const struct romfs_ent *ent;
+    struct romfs_dir *dir;
+
+    ent = romfs_lookup(path);
+    if (!ent) {
+        return FS_ENOENT;
+    }
+    if (!romfs_is_dir(ent)) {
+        return FS_EINVAL;
+    }
+
+    dir = os_memblock_get(&romfs_dir_pool);
+    if (!dir) {
+        return FS_ENOMEM;
+    }
+    dir->rd_ent = ent;
+    dir->rd_next = ent->re_off;
+    dir->rd_dirent.rde_ent = NULL;
+
+    *out_fs_dir = (struct fs_dir *)dir;
+    return 0;
+}
+
+static int
+romfs_readdir(struct fs_dir *fs_dir, struct fs_dirent **out_fs_dirent)
+{
+    struct romfs_dir *dir = (struct romfs_dir *)fs_dir;
+
+    if (dir->rd_next >= dir->rd_ent->re_off + dir->rd_ent->re_len) {
+        *out_fs_dirent = NULL;
+        return FS_ENOENT;
+    }
+    dir->rd_dirent.rde_ent = &romfs_ents[dir->rd_next++];
+
+    *out_fs_dirent = (struct fs_dirent *)&dir->rd_dirent;
+    return 0;
+}
+
+static int
+romfs_closedir(struct fs_dir *fs_dir)
+{
+    if (!fs_dir) {
+        return 0;
+    }
+    if (os_memblock_put(&romfs_dir_pool, fs_dir)) {
+        return FS_EOS;
+    }
+    return 0;
+}
+
+static int
+romfs_dirent_name(const struct fs_dirent *fs_dirent, size_t max_len,
+  char *out_name, uint8_t *out_name_len)
+{
+    const struct romfs_dirent *dirent = (const struct romfs_dirent *)fs_dirent;
+    const struct romfs_ent *ent;
+    size_t len;
+
+    ent = dirent->rde_ent;
+    len = ent->re_name_len;
+    if (len > max_len - 1) {
+        len = max_len - 1;
+    }
+    memcpy(out_name, romfs_img + ent->re_name_off, len);
+    out_name[len] = '\0';
+    *out_name_len = ent->re_name_len;
+    return 0;
+}
+
+static int
+romfs_dirent_is_dir(const struct fs_dirent *fs_dirent)
+{
+    const struct romfs_dirent *dirent = (const struct romfs_dirent *)fs_dirent;
+
+    return romfs_is_dir(dirent->rde_ent);
+}
+
+/*
+ * The image does not change while mounted, so the cursor hint is simply the
+ * index of the last entry returned.  The name is used if the hint does not
+ * belong to this directory.
+ */
+static int
+romfs_readdir_batch(struct fs_dir *fs_dir, struct fs_dir_cursor *cursor,
+  struct fs_dirent_info *entries, int max_entries, int *out_cnt)
+{
+    struct romfs_dir *dir = (struct romfs_dir *)fs_dir;
+    const struct romfs_ent *ent;
+    struct fs_dirent_info *info;
+    uint32_t first;
+    uint32_t end;
+    uint32_t idx;
+    int len;
+    int cnt;
+
+    first = dir->rd_ent->re_off;
+    end = first + dir->rd_ent->re_len;
+    if (cursor->fdc_name_len == 0) {
+        idx = first;
+    } else if (cursor->fdc_hint >= first && cursor->fdc_hint < end &&
+      romfs_name_cmp(&romfs_ents[cursor->fdc_hint], cursor->fdc_name,
+        cursor->fdc_name_len) == 0) {
+        idx = cursor->fdc_hint + 1;
+    } else {
+        idx = romfs_child_lower_bound(dir->rd_ent, cursor->fdc_name,
+          cursor->fdc_name_len);
+        if (idx < end && romfs_name_cmp(&romfs_ents[idx], cursor->fdc_name,
+            cursor->fdc_name_len) == 0) {
+            idx++;
+        }
+    }
+
+    for (cnt = 0; cnt < max_entries && idx < end; cnt++, idx++) {
+        ent = &romfs_ents[idx];
+        info = &entries[cnt];
+
+        info->fdi_is_dir = romfs_is_dir(ent);
+        info->fdi_size = info->fdi_is_dir ? 0 : ent->re_len;
+        len = ent->re_name_len;
+        if (len > FS_CURSOR_NAME_MAX) {
+            len = FS_CURSOR_NAME_MAX;
+        }
+        info->fdi_name_len = len;
+        if (len > FS_DIRENT_INFO_NAME_MAX) {
+            len = FS_DIRENT_INFO_NAME_MAX;
+        }
+        memcpy(info->fdi_name, romfs_img + ent->re_name_off, len);
+        info->fdi_name[len] = '\0';
+
+        memcpy(cursor->fdc_name, romfs_img + ent->re_name_off,
+          info->fdi_name_len);
+        cursor->fdc_name_len = info->fdi_name_len;
+        cursor->fdc_hint = idx;
+    }
+
+    *out_cnt = cnt;
+    if (cnt == 0) {
+        return FS_ENOENT;
+    }
+    return 0;
+}
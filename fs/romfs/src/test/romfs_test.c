@@ -0,0 +1,286 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <os/os.h>
+#include <testutil/testutil.h>
+#include <fs/fs.h>
+
+#include "romfs/romfs.h"
+
+/*
+ * /a.txt           "hello"
+ * /dir/b           "0123456789"
+ * /dir/sub/
+ * /z               ""
+ */
+#define ROMFS_TEST_NUM_ENTS     6
+
+static uint32_t romfs_test_img[128];
+
+static uint32_t
+romfs_test_add(uint32_t *off, const char *data, int len)
+{
+    uint32_t start;
+
+    start = *off;
+    memcpy((uint8_t *)romfs_test_img + start, data, len);
+    *off += len;
+    return start;
+}
+
+static void
+romfs_test_ent(struct romfs_ent *ent, uint32_t *off, const char *name,
+  uint32_t ent_off, uint32_t len, uint16_t flags)
+{
+    ent->re_name_off = romfs_test_add(off, name, strlen(name));
+    ent->re_name_len = strlen(name);
+    ent->re_off = ent_off;
+    ent->re_len = len;
+    ent->re_flags = flags;
+}
+
+static void
+romfs_test_build(void)
+{
+    struct romfs_hdr *hdr;
+    struct romfs_ent *ent;
+    uint32_t off;
+
+    memset(romfs_test_img, 0, sizeof(romfs_test_img));
+    hdr = (struct romfs_hdr *)romfs_test_img;
+    ent = (struct romfs_ent *)(hdr + 1);
+    off = sizeof(*hdr) + ROMFS_TEST_NUM_ENTS * sizeof(*ent);
+
+    romfs_test_ent(&ent[0], &off, "", 1, 3, ROMFS_ENT_DIR);
+    romfs_test_ent(&ent[1], &off, "a.txt",
+      romfs_test_add(&off, "hello", 5), 5, 0);
+    romfs_test_ent(&ent[2], &off, "dir", 4, 2, ROMFS_ENT_DIR);
+    romfs_test_ent(&ent[3], &off, "z", off, 0, 0);
+    romfs_test_ent(&ent[4], &off, "b",
+      romfs_test_add(&off, "0123456789", 10), 10, 0);
+    romfs_test_ent(&ent[5], &off, "sub", 0, 0, ROMFS_ENT_DIR);
+
+    hdr->rh_magic = ROMFS_MAGIC;
+    hdr->rh_version = ROMFS_VERSION;
+    hdr->rh_num_ents = ROMFS_TEST_NUM_ENTS;
+    hdr->rh_img_len = off;
+}
+
+static void
+romfs_test_assert_name(struct fs_dirent *dirent, const char *name)
+{
+    char buf[16];
+    uint8_t len;
+    int rc;
+
+    rc = fs_dirent_name(dirent, sizeof(buf), buf, &len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(len == strlen(name));
+    TEST_ASSERT(strcmp(buf, name) == 0);
+}
+
+TEST_CASE(romfs_test_mount)
+{
+    struct romfs_hdr *hdr;
+    struct romfs_ent *ent;
+    int rc;
+
+    romfs_test_build();
+    hdr = (struct romfs_hdr *)romfs_test_img;
+    ent = (struct romfs_ent *)(hdr + 1);
+
+    hdr->rh_magic++;
+    rc = romfs_mount(romfs_test_img, "/rom");
+    TEST_ASSERT(rc == FS_EUNEXP);
+    hdr->rh_magic--;
+
+    /* Child range past the end of the index. */
+    ent[2].re_len = 3;
+    rc = romfs_mount(romfs_test_img, "/rom");
+    TEST_ASSERT(rc == FS_ECORRUPT);
+    ent[2].re_len = 2;
+
+    /* File data past the end of the image. */
+    ent[1].re_len = hdr->rh_img_len;
+    rc = romfs_mount(romfs_test_img, "/rom");
+    TEST_ASSERT(rc == FS_ECORRUPT);
+    ent[1].re_len = 5;
+
+    rc = romfs_mount(romfs_test_img, "/rom");
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = romfs_mount(romfs_test_img, "/rom2");
+    TEST_ASSERT(rc == FS_EEXIST);
+}
+
+TEST_CASE(romfs_test_read)
+{
+    struct fs_file *file;
+    const void *data;
+    uint32_t len;
+    char buf[16];
+    int rc;
+
+    rc = fs_open("/rom/a.txt", FS_ACCESS_READ, &file);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = fs_filelen(file, &len);
+    TEST_ASSERT(rc == 0 && len == 5);
+
+    rc = fs_read(file, sizeof(buf), buf, &len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(len == 5 && memcmp(buf, "hello", 5) == 0);
+
+    rc = fs_seek(file, 3);
+    TEST_ASSERT(rc == 0);
+    rc = fs_read(file, sizeof(buf), buf, &len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(len == 2 && memcmp(buf, "lo", 2) == 0);
+    TEST_ASSERT(fs_getpos(file) == 5);
+
+    rc = fs_seek(file, 6);
+    TEST_ASSERT(rc == FS_EOFFSET);
+
+    rc = fs_write(file, "x", 1);
+    TEST_ASSERT(rc == FS_EACCESS);
+
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_open("/rom/dir//b", FS_ACCESS_READ, &file);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = romfs_file_mmap(file, &data, &len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(len == 10 && memcmp(data, "0123456789", 10) == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_open("/rom/z", FS_ACCESS_READ, &file);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = fs_read(file, sizeof(buf), buf, &len);
+    TEST_ASSERT(rc == 0 && len == 0);
+    rc = fs_close(file);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_open("/rom/a.txt", FS_ACCESS_WRITE, &file);
+    TEST_ASSERT(rc == FS_EACCESS);
+    rc = fs_open("/rom/a", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == FS_ENOENT);
+    rc = fs_open("/rom/a.txt/b", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == FS_ENOENT);
+    rc = fs_open("/rom/dir", FS_ACCESS_READ, &file);
+    TEST_ASSERT(rc == FS_EINVAL);
+
+    rc = fs_unlink("/rom/a.txt");
+    TEST_ASSERT(rc == FS_EACCESS);
+    rc = fs_mkdir("/rom/new");
+    TEST_ASSERT(rc == FS_EACCESS);
+    rc = fs_rename("/rom/a.txt", "/rom/b.txt");
+    TEST_ASSERT(rc == FS_EACCESS);
+}
+
+TEST_CASE(romfs_test_readdir)
+{
+    struct fs_dirent_info entries[2];
+    struct fs_dir_cursor cursor;
+    struct fs_dirent *dirent;
+    struct fs_dir *dir;
+    int cnt;
+    int rc;
+
+    rc = fs_opendir("/rom", &dir);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = fs_readdir(dir, &dirent);
+    TEST_ASSERT_FATAL(rc == 0);
+    romfs_test_assert_name(dirent, "a.txt");
+    TEST_ASSERT(fs_dirent_is_dir(dirent) == 0);
+
+    rc = fs_readdir(dir, &dirent);
+    TEST_ASSERT_FATAL(rc == 0);
+    romfs_test_assert_name(dirent, "dir");
+    TEST_ASSERT(fs_dirent_is_dir(dirent) == 1);
+
+    rc = fs_readdir(dir, &dirent);
+    TEST_ASSERT_FATAL(rc == 0);
+    romfs_test_assert_name(dirent, "z");
+
+    rc = fs_readdir(dir, &dirent);
+    TEST_ASSERT(rc == FS_ENOENT);
+
+    /* Batches; cursor resumes after "dir". */
+    memset(&cursor, 0, sizeof(cursor));
+    rc = fs_readdir_batch(dir, &cursor, entries, 2, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(cnt == 2);
+    TEST_ASSERT(strcmp(entries[0].fdi_name, "a.txt") == 0);
+    TEST_ASSERT(entries[0].fdi_size == 5);
+    TEST_ASSERT(strcmp(entries[1].fdi_name, "dir") == 0);
+    TEST_ASSERT(entries[1].fdi_is_dir == 1);
+
+    /* Hint from another directory; falls back to the name. */
+    cursor.fdc_hint = 5;
+    rc = fs_readdir_batch(dir, &cursor, entries, 2, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT_FATAL(cnt == 1);
+    TEST_ASSERT(strcmp(entries[0].fdi_name, "z") == 0);
+    TEST_ASSERT(entries[0].fdi_size == 0);
+
+    rc = fs_readdir_batch(dir, &cursor, entries, 2, &cnt);
+    TEST_ASSERT(rc == FS_ENOENT && cnt == 0);
+
+    rc = fs_closedir(dir);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_opendir("/rom/dir/sub/", &dir);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = fs_readdir(dir, &dirent);
+    TEST_ASSERT(rc == FS_ENOENT);
+    rc = fs_closedir(dir);
+    TEST_ASSERT(rc == 0);
+
+    rc = fs_opendir("/rom/a.txt", &dir);
+    TEST_ASSERT(rc == FS_EINVAL);
+    rc = fs_opendir("/rom/nodir", &dir);
+    TEST_ASSERT(rc == FS_ENOENT);
+}
+
+TEST_SUITE(romfs_test_all)
+{
+    romfs_test_mount();
+    romfs_test_read();
+    romfs_test_readdir();
+}
+
+#ifdef MYNEWT_SELFTEST
+
+int
+main(int argc, char **argv)
+{
+    tu_config.tc_print_results = 1;
+    tu_init();
+
+    romfs_test_all();
+
+    return tu_any_failed;
+}
+#endif
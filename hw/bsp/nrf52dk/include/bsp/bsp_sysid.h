@@ -23,10 +23,12 @@
 extern "C" {
 #endif
 
-/* stub until this BSP gets new HAL */
 enum system_device_id  
 {
     RESERVED,
+    NRF52DK_SPI0,                       /* SPIM0 on Arduino header D11-D13 */
+    NRF52DK_ADC_A0,                     /* SAADC on Arduino header A0 */
+    NRF52DK_PWM_LED1,                   /* PWM0 on LED1 */
 };
 
 #ifdef __cplusplus
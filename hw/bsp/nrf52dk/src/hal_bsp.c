@@ -21,6 +21,9 @@
 
 #include "bsp/bsp.h"
 #include <hal/hal_bsp.h>
+#include <hal/hal_spi_int.h>
+#include <hal/hal_adc_int.h>
+#include <hal/hal_pwm_int.h>
 #include "mcu/nrf52_hal.h"
 
 static const struct nrf52_uart_cfg uart_cfg = {
@@ -30,6 +33,23 @@ static const struct nrf52_uart_cfg uart_cfg = {
     .suc_pin_cts = 7
 };
 
+static const struct nrf52_spi_cfg spi0_cfg = {
+    .ssc_pin_sck = 25,
+    .ssc_pin_mosi = 23,
+    .ssc_pin_miso = 24
+};
+
+/* Arduino A0 is P0.03/AIN1. */
+static const struct nrf52_adc_cfg adc_a0_cfg = {
+    .nac_ain = 1,
+    .nac_timer = 2,
+    .nac_ppi_chan = 0
+};
+
+static const struct nrf52_pwm_cfg pwm_led1_cfg = {
+    .npc_pin = LED_BLINK_PIN
+};
+
 /*
  * What memory to include in coredump.
  */
@@ -64,3 +84,54 @@ bsp_core_dump(int *area_cnt)
     *area_cnt = sizeof(dump_cfg) / sizeof(dump_cfg[0]);
     return dump_cfg;
 }
+
+struct hal_spi *
+bsp_get_hal_spi(enum system_device_id sysid)
+{
+    static struct hal_spi *spi0;
+
+    switch (sysid) {
+    case NRF52DK_SPI0:
+        if (!spi0) {
+            spi0 = nrf52_spi_create(0, &spi0_cfg);
+        }
+        return spi0;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+struct hal_adc *
+bsp_get_hal_adc(enum system_device_id sysid)
+{
+    static struct hal_adc *adc;
+
+    switch (sysid) {
+    case NRF52DK_ADC_A0:
+        if (!adc) {
+            adc = nrf52_adc_create(&adc_a0_cfg);
+        }
+        return adc;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+struct hal_pwm *
+bsp_get_hal_pwm_driver(enum system_device_id sysid)
+{
+    static struct hal_pwm *pwm;
+
+    switch (sysid) {
+    case NRF52DK_PWM_LED1:
+        if (!pwm) {
+            pwm = nrf52_pwm_create(0, &pwm_led1_cfg);
+        }
+        return pwm;
+    default:
+        break;
+    }
+    return NULL;
+}
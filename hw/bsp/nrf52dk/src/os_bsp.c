@@ -16,8 +16,13 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <os/os.h>
 #include <hal/flash_map.h>
 #include <hal/hal_bsp.h>
+#if OS_IDLE_STATES
+#include <bsp/cmsis_nvic.h>
+#include <mcu/nrf52_bitfields.h>
+#endif
 
 static struct flash_area bsp_flash_areas[] = {
     [FLASH_AREA_BOOTLOADER] = {
@@ -50,6 +55,49 @@ static struct flash_area bsp_flash_areas[] = {
 
 void _close(int fd);
 
+#if OS_IDLE_STATES
+/*
+ * Once started, the 64MHz crystal oscillator runs until told to stop, and
+ * accounts for most of the sleep current. Stop it while idle, and restart
+ * it on wakeup if it was running. cputime timers and the radio need an
+ * accurate clock, so this state isn't used while they are active.
+ */
+static uint8_t bsp_hfxo_stopped;
+
+static int
+bsp_idle_hfxo_enter(const struct os_idle_state *ois, os_time_t ticks)
+{
+    if (NRF_CLOCK->HFCLKSTAT & CLOCK_HFCLKSTAT_SRC_Msk) {
+        NRF_CLOCK->TASKS_HFCLKSTOP = 1;
+        bsp_hfxo_stopped = 1;
+    }
+    return 0;
+}
+
+static void
+bsp_idle_hfxo_exit(const struct os_idle_state *ois)
+{
+    if (bsp_hfxo_stopped) {
+        NRF_CLOCK->EVENTS_HFCLKSTARTED = 0;
+        NRF_CLOCK->TASKS_HFCLKSTART = 1;
+        while (!NRF_CLOCK->EVENTS_HFCLKSTARTED) {
+        }
+        bsp_hfxo_stopped = 0;
+    }
+}
+
+static const struct os_idle_state bsp_idle_states[] = {
+    {
+        .ois_name = "hfxo_off",
+        .ois_latency = 400,             /* HFXO startup */
+        .ois_residency = 5000,
+        .ois_wake = 0,
+        .ois_enter = bsp_idle_hfxo_enter,
+        .ois_exit = bsp_idle_hfxo_exit
+    }
+};
+#endif
+
 /*
  * Returns the flash map slot where the currently active image is located.
  * If executing from internal flash from fixed location, that slot would
@@ -75,4 +123,9 @@ bsp_init(void)
 
     flash_area_init(bsp_flash_areas,
       sizeof(bsp_flash_areas) / sizeof(bsp_flash_areas[0]));
+
+#if OS_IDLE_STATES
+    os_idle_states_set(bsp_idle_states,
+      sizeof(bsp_idle_states) / sizeof(bsp_idle_states[0]));
+#endif
 }
@@ -23,10 +23,12 @@
 extern "C" {
 #endif
 
-/* stub until this BSP gets new HAL */
 enum system_device_id  
 {
     RESERVED,
+    E407_SPI1,                          /* SPI1 on UEXT connector */
+    E407_ADC1,                          /* ADC1 on PC0 */
+    E407_DAC1,                          /* DAC channel 1 on PA4 */
 };
 
 #ifdef __cplusplus
@@ -19,6 +19,9 @@
 #include "hal/hal_bsp.h"
 #include "hal/hal_gpio.h"
 #include "hal/hal_flash_int.h"
+#include "hal/hal_spi_int.h"
+#include "hal/hal_adc_int.h"
+#include "hal/hal_dac_int.h"
 #include "mcu/stm32f407xx.h"
 #include "mcu/stm32f4xx_hal_gpio_ex.h"
 #include "mcu/stm32f4_bsp.h"
@@ -35,10 +38,57 @@ static const struct stm32f4_uart_cfg uart_cfg[UART_CNT] = {
         .suc_pin_rts = 34,
         .suc_pin_cts = 35,
         .suc_pin_af = GPIO_AF8_USART6,
-        .suc_irqn = USART6_IRQn
+        .suc_irqn = USART6_IRQn,
+        .suc_dma_rx = DMA2_Stream1,
+        .suc_dma_tx = DMA2_Stream6,
+        .suc_dma_chan = 5,
+        .suc_dma_rcc_dev = RCC_AHB1ENR_DMA2EN,
+        .suc_dma_rx_irqn = DMA2_Stream1_IRQn
     }
 };
 
+static const struct stm32f4_spi_cfg spi1_cfg = {
+    .ssc_spi = SPI1,
+    .ssc_rcc_reg = &RCC->APB2ENR,
+    .ssc_rcc_dev = RCC_APB2ENR_SPI1EN,
+    .ssc_pin_sck = 5,
+    .ssc_pin_miso = 6,
+    .ssc_pin_mosi = 21,
+    .ssc_pin_af = GPIO_AF5_SPI1,
+    .ssc_dma_rx = DMA2_Stream0,
+    .ssc_dma_tx = DMA2_Stream3,
+    .ssc_dma_chan = 3,
+    .ssc_dma_rcc_dev = RCC_AHB1ENR_DMA2EN,
+    .ssc_dma_rx_irqn = DMA2_Stream0_IRQn
+};
+
+/* PC0 is ADC123_IN10. DMA2 Stream0 is taken by SPI1, so use Stream4. */
+static const struct stm32f4_adc_cfg adc1_cfg = {
+    .sac_adc = ADC1,
+    .sac_rcc_dev = RCC_APB2ENR_ADC1EN,
+    .sac_pin = 32,
+    .sac_chan = 10,
+    .sac_tim = TIM2,
+    .sac_tim_rcc_dev = RCC_APB1ENR_TIM2EN,
+    .sac_extsel = 6,                            /* TIM2_TRGO */
+    .sac_dma = DMA2_Stream4,
+    .sac_dma_chan = 0,
+    .sac_dma_rcc_dev = RCC_AHB1ENR_DMA2EN,
+    .sac_dma_irqn = DMA2_Stream4_IRQn
+};
+
+/* DAC1 requests are on DMA1 Stream5, channel 7. */
+static const struct stm32f4_dac_cfg dac1_cfg = {
+    .sdc_chan = 1,
+    .sdc_tim = TIM6,
+    .sdc_tim_rcc_dev = RCC_APB1ENR_TIM6EN,
+    .sdc_tsel = 0,                              /* TIM6_TRGO */
+    .sdc_dma = DMA1_Stream5,
+    .sdc_dma_chan = 7,
+    .sdc_dma_rcc_dev = RCC_AHB1ENR_DMA1EN,
+    .sdc_dma_irqn = DMA1_Stream5_IRQn
+};
+
 static const struct bsp_mem_dump dump_cfg[] = {
     [0] = {
         .bmd_start = &_ram_start,
@@ -75,3 +125,54 @@ bsp_core_dump(int *area_cnt)
     *area_cnt = sizeof(dump_cfg) / sizeof(dump_cfg[0]);
     return dump_cfg;
 }
+
+struct hal_spi *
+bsp_get_hal_spi(enum system_device_id sysid)
+{
+    static struct hal_spi *spi1;
+
+    switch (sysid) {
+    case E407_SPI1:
+        if (!spi1) {
+            spi1 = stm32f4_spi_create(0, &spi1_cfg);
+        }
+        return spi1;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+struct hal_adc *
+bsp_get_hal_adc(enum system_device_id sysid)
+{
+    static struct hal_adc *adc1;
+
+    switch (sysid) {
+    case E407_ADC1:
+        if (!adc1) {
+            adc1 = stm32f4_adc_create(0, &adc1_cfg);
+        }
+        return adc1;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+struct hal_dac *
+bsp_get_hal_dac(enum system_device_id sysid)
+{
+    static struct hal_dac *dac1;
+
+    switch (sysid) {
+    case E407_DAC1:
+        if (!dac1) {
+            dac1 = stm32f4_dac_create(&dac1_cfg);
+        }
+        return dac1;
+    default:
+        break;
+    }
+    return NULL;
+}
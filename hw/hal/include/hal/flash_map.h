@@ -42,6 +42,7 @@ extern "C" {
  * and match the target offset specified in download script.
  */
 #include <inttypes.h>
+#include "hal/hal_flash.h"
 
 struct flash_area {
     uint8_t fa_flash_id;
@@ -82,6 +83,8 @@ int flash_area_read(const struct flash_area *, uint32_t off, void *dst,
 int flash_area_write(const struct flash_area *, uint32_t off, void *src,
   uint32_t len);
 int flash_area_erase(const struct flash_area *, uint32_t off, uint32_t len);
+int flash_area_erase_wait(const struct flash_area *, uint32_t off,
+  uint32_t len, hal_flash_wait_fn *wait_fn, void *wait_arg);
 
 /*
  * Alignment restriction for flash writes.
@@ -26,6 +26,9 @@ extern "C" {
 
 /* for the pin descriptor enum */
 #include <bsp/bsp_sysid.h>
+#include <inttypes.h>
+#include <os/queue.h>
+#include <os/os_eventq.h>
 
 /* This is the device for an ADC. The application using the ADC device
  * does not need to know the definition of this device and can operate
@@ -65,6 +68,43 @@ int hal_adc_get_ref_mv(struct hal_adc *padc);
  */
 int hal_adc_to_mv(struct hal_adc *padc, int val);
 
+struct hal_adc_stream;
+
+/* Called from interrupt context when <buf> holds buf_cnt new samples */
+typedef void (*hal_adc_stream_cb)(struct hal_adc_stream *st, int16_t *buf);
+
+/* Continuous sampling, driven by a hardware timer, into a pair of buffers.
+ * While one buffer is being filled by DMA, the other one belongs to the
+ * application; it must be done with it before the next one fills up.
+ * Set up by the caller, and left alone while sampling is on.
+ */
+struct hal_adc_stream {
+    uint32_t rate;              /* samples per second */
+    int16_t *bufs[2];           /* filled alternately */
+    uint16_t buf_cnt;           /* samples per buffer */
+
+    /* Buffer full notification; either or both may be used. */
+    hal_adc_stream_cb cb;
+    void *cb_arg;
+    struct os_eventq *evq;      /* ev is posted here with ev_arg set to the
+                                 * full buffer; caller sets ev_type */
+    struct os_event ev;
+
+    /* Times a buffer filled up while ev was still queued */
+    uint32_t overruns;
+};
+
+/* Starts continuous sampling as described by <st>. Only one stream per
+ * ADC peripheral can be active at a time.
+ * Returns 0 on success, negative on error, or if not supported by driver.
+ */
+int hal_adc_stream_start(struct hal_adc *padc, struct hal_adc_stream *st);
+
+/* Stops continuous sampling. Contents of the buffer being filled are
+ * discarded. Returns 0 on success, negative on error.
+ */
+int hal_adc_stream_stop(struct hal_adc *padc);
+
 
 #ifdef __cplusplus
 }
@@ -26,6 +26,7 @@ extern "C" {
 
 #include <inttypes.h>
 #include <bsp/bsp_sysid.h>
+#include <hal/hal_adc.h>
 
 
 struct hal_adc;
@@ -37,6 +38,10 @@ struct hal_adc_funcs {
     int (*hadc_read)            (struct hal_adc *padc);
     int (*hadc_get_bits)         (struct hal_adc *padc);
     int (*hadc_get_ref_mv)       (struct hal_adc *padc);
+
+    /* Optional; continuous sampling */
+    int (*hadc_stream_start)     (struct hal_adc *padc, struct hal_adc_stream *st);
+    int (*hadc_stream_stop)      (struct hal_adc *padc);
 };
 
 /* This is the internal device representation for a hal_adc device.
@@ -59,6 +64,9 @@ struct hal_adc {
     const struct hal_adc_funcs  *driver_api;
 };
 
+/* Called by drivers from interrupt context when <buf> of a stream is full */
+void hal_adc_stream_done(struct hal_adc_stream *st, int16_t *buf);
+
 /* The  BSP must implement this factory to get devices for the
  * application.  */
 extern struct hal_adc *
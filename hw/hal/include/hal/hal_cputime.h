@@ -46,12 +46,24 @@ extern "C" {
 struct cpu_timer;
 typedef void (*cputimer_func)(void *arg);
 
-/* CPU timer */
+/*
+ * CPU timer. Timers sharing the cputime output compare are kept in a heap;
+ * the maximum number of them running at once is HAL_CPUTIME_MAX_TIMERS
+ * (default 16), which can be overridden by the project, target or bsp.
+ * Starting another one fails. Timers with a dedicated output compare do not
+ * count against the limit.
+ */
+#ifndef HAL_CPUTIME_MAX_TIMERS
+#define HAL_CPUTIME_MAX_TIMERS      (16)
+#endif
+
 struct cpu_timer {
     cputimer_func   cb;
     void            *arg;
     uint32_t        cputime;
-    TAILQ_ENTRY(cpu_timer) link;
+    uint16_t        heap_idx;   /* Position in the timer heap */
+    uint8_t         ocmp;       /* Dedicated output compare; 0 if shared */
+    uint8_t         running;
 };
 
 /* CPUTIME data. */
@@ -188,6 +200,26 @@ void cputime_delay_usecs(uint32_t usecs);
  */
 void cputime_timer_init(struct cpu_timer *timer, cputimer_func fp, void *arg);
 
+/**
+ * cputime timer init dedicated
+ *
+ * Initializes a timer and gives it an output compare channel of its own, if
+ * the hardware has one to spare. The timer's callback is then executed
+ * directly from the channel's interrupt; it is not delayed by other timers
+ * expiring at the same time. If no channel is available, the timer shares
+ * the cputime output compare like any other timer. Channels are never
+ * released. Must be called after cputime_init().
+ *
+ * @param timer The timer to initialize. Cannot be NULL.
+ * @param fp    The timer callback function. Cannot be NULL.
+ * @param arg   Pointer to data object to pass to timer.
+ *
+ * @return int 0 if the timer got a dedicated channel; -1 if it shares the
+ *         cputime output compare.
+ */
+int cputime_timer_init_dedicated(struct cpu_timer *timer, cputimer_func fp,
+                                 void *arg);
+
 /**
  * cputime timer start
  *
@@ -196,8 +228,11 @@ void cputime_timer_init(struct cpu_timer *timer, cputimer_func fp, void *arg);
  *
  * @param timer     Pointer to timer to start. Cannot be NULL.
  * @param cputime   The cputime at which the timer should expire.
+ *
+ * @return int 0 on success; -1 if HAL_CPUTIME_MAX_TIMERS shared timers are
+ *         already running. The timer is not started in that case.
  */
-void cputime_timer_start(struct cpu_timer *timer, uint32_t cputime);
+int cputime_timer_start(struct cpu_timer *timer, uint32_t cputime);
 
 /**
  * cputimer timer relative
@@ -207,8 +242,10 @@ void cputime_timer_start(struct cpu_timer *timer, uint32_t cputime);
  *
  * @param timer Pointer to timer. Cannot be NULL.
  * @param usecs The number of usecs from now at which the timer will expire.
+ *
+ * @return int 0 on success; -1 if too many timers are running.
  */
-void cputime_timer_relative(struct cpu_timer *timer, uint32_t usecs);
+int cputime_timer_relative(struct cpu_timer *timer, uint32_t usecs);
 
 /**
  * cputime timer stop
@@ -221,17 +258,40 @@ void cputime_timer_relative(struct cpu_timer *timer, uint32_t usecs);
  */
 void cputime_timer_stop(struct cpu_timer *timer);
 
+/**
+ * cputime next expiry
+ *
+ * Finds the earliest expiration time of all running timers. Used by the
+ * idle task to tell how long the MCU may sleep.
+ *
+ * @param cputime   Filled with the expiration time of the first timer.
+ *
+ * @return int 0 on success; -1 if no timers are running.
+ */
+int cputime_next_expiry(uint32_t *cputime);
+
 /*
  * Used between MCU specific files and generic HAL. Not intended as an API
  * to be called by the user.
  */
 void cputime_chk_expiration(void);
+void cputime_chk_ocmp_expiration(int ocmp);
 
 /*--- HW specific API. These are not intended to be called by user  ---*/
 void cputime_disable_ocmp(void);
 void cputime_set_ocmp(struct cpu_timer *timer);
 int cputime_hw_init(uint32_t clock_freq);
 
+/*
+ * Dedicated output compare channels. Channel 0 is the one driven by
+ * cputime_set_ocmp(); cputime_hw_num_ocmp() returns 1 if the hardware has
+ * no other channel to spare. When a dedicated channel fires, the MCU code
+ * calls cputime_chk_ocmp_expiration() with its number.
+ */
+int cputime_hw_num_ocmp(void);
+void cputime_hw_set_ocmp(int ocmp, uint32_t cputime);
+void cputime_hw_disable_ocmp(int ocmp);
+
 #ifdef __cplusplus
 }
 #endif
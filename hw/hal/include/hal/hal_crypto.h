@@ -0,0 +1,55 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HAL_CRYPTO_
+#define H_HAL_CRYPTO_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+
+/*
+ * Crypto accelerator interface. Implemented by MCUs which have a cipher
+ * and/or random number unit; libraries use it only when built with the
+ * HAL_CRYPTO feature, so MCUs without one need not provide it.
+ *
+ * Every operation may return -1 when the hardware does not support it, or
+ * is busy; callers then fall back to a software implementation.
+ */
+
+/*
+ * Encrypts one 16 byte block with AES-128 in ECB mode. Key, plaintext and
+ * ciphertext are in FIPS-197 byte order. in and out may be the same buffer.
+ * Returns 0 on success.
+ */
+int hal_crypto_aes128_enc(const uint8_t *key, const uint8_t *in, uint8_t *out);
+
+/*
+ * Fills buf with len bytes from the hardware random number generator.
+ * Blocks until all data is available. Returns 0 on success.
+ */
+int hal_crypto_rng(void *buf, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_HAL_CRYPTO_ */
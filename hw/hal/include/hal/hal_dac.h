@@ -26,6 +26,9 @@ extern "C" {
 
 /* for the pin descriptor enum */
 #include <bsp/bsp_sysid.h>
+#include <inttypes.h>
+#include <os/queue.h>
+#include <os/os_eventq.h>
 
 /* This is the device for a Digital to Analog Converter (DAC).
  * The application using the DAC device
@@ -86,6 +89,46 @@ hal_dac_disable(struct hal_dac *pdac);
 int
 hal_dac_to_val(struct hal_dac *pdac, int mvolts);
 
+struct hal_dac_stream;
+
+/* Called from interrupt context when <buf> has been played out, and can
+ * be refilled
+ */
+typedef void (*hal_dac_stream_cb)(struct hal_dac_stream *st, uint16_t *buf);
+
+/* Continuous output of a waveform, paced by a hardware timer, from a pair
+ * of buffers of DAC values. While one buffer is being played by DMA, the
+ * other one belongs to the application; it must be refilled before the
+ * one playing runs out. Set up by the caller, and left alone while playing.
+ */
+struct hal_dac_stream {
+    uint32_t rate;              /* samples per second */
+    uint16_t *bufs[2];          /* played alternately */
+    uint16_t buf_cnt;           /* samples per buffer */
+
+    /* Buffer played notification; either or both may be used. */
+    hal_dac_stream_cb cb;
+    void *cb_arg;
+    struct os_eventq *evq;      /* ev is posted here with ev_arg set to the
+                                 * played buffer; caller sets ev_type */
+    struct os_event ev;
+
+    /* Times a buffer was played out while ev was still queued */
+    uint32_t underruns;
+};
+
+/* Starts playing, first bufs[0], then bufs[1], and so on. Both buffers
+ * must be filled beforehand. Only one stream per DAC can be active at a
+ * time. Returns 0 on success, negative on error, or if not supported by
+ * driver.
+ */
+int hal_dac_stream_start(struct hal_dac *pdac, struct hal_dac_stream *st);
+
+/* Stops playing; the output keeps the last value played. Returns 0 on
+ * success, negative on error.
+ */
+int hal_dac_stream_stop(struct hal_dac *pdac);
+
 
 #ifdef __cplusplus
 }
@@ -25,6 +25,7 @@ extern "C" {
 #endif
 
 #include <bsp/bsp_sysid.h>
+#include <hal/hal_dac.h>
 
 
 struct hal_dac;
@@ -38,6 +39,10 @@ struct hal_dac_funcs {
     int (*hdac_disable)          (struct hal_dac *pdac);
     int (*hdac_get_bits)         (struct hal_dac *pdac);
     int (*hdac_get_ref_mv)       (struct hal_dac *pdac);
+
+    /* Optional; waveform streaming */
+    int (*hdac_stream_start)     (struct hal_dac *pdac, struct hal_dac_stream *st);
+    int (*hdac_stream_stop)      (struct hal_dac *pdac);
 };
 
 /* This is the internal device representation for a hal_dac device.
@@ -60,6 +65,11 @@ struct hal_dac {
     const struct hal_dac_funcs  *driver_api;
 };
 
+/* Called by drivers from interrupt context when <buf> of a stream has
+ * been played
+ */
+void hal_dac_stream_done(struct hal_dac_stream *st, uint16_t *buf);
+
 /* The  BSP must implement this factory to get devices for the
  * application.
  */
@@ -32,6 +32,55 @@ int hal_flash_write(uint8_t flash_id, uint32_t address, const void *src,
   uint32_t num_bytes);
 int hal_flash_erase_sector(uint8_t flash_id, uint32_t sector_address);
 int hal_flash_erase(uint8_t flash_id, uint32_t address, uint32_t num_bytes);
+
+/*
+ * Non-blocking erase.  hal_flash_erase_sector_start() returns once the erase
+ * has been started; hal_flash_busy() returns 1 until it has completed.  On
+ * devices which cannot erase in the background, the start call performs the
+ * whole erase and hal_flash_busy() always returns 0.
+ */
+int hal_flash_erase_sector_start(uint8_t flash_id, uint32_t sector_address);
+int hal_flash_busy(uint8_t flash_id);
+
+/*
+ * Non-blocking read.  hal_flash_read_start() returns once the read has been
+ * started; hal_flash_busy() returns 1 until the data is in dst.  On devices
+ * which cannot read in the background, the start call performs the whole
+ * read.
+ */
+int hal_flash_read_start(uint8_t flash_id, uint32_t address, void *dst,
+  uint32_t num_bytes);
+
+/*
+ * Returns a pointer through which num_bytes at address can be read directly,
+ * or NULL if that part of the flash is not memory-mapped.  Saves copying
+ * through a RAM buffer when only reading.
+ */
+const void *hal_flash_mmap(uint8_t flash_id, uint32_t address,
+  uint32_t num_bytes);
+
+/*
+ * Called while waiting for an erase; typically yields the CPU so that other
+ * tasks can run while the flash is busy.
+ */
+typedef void hal_flash_wait_fn(void *arg);
+
+/*
+ * Like hal_flash_erase(), but calls wait_fn while each sector is being
+ * erased instead of spinning.  wait_fn is never called on devices without
+ * background erase, as their sector erase has completed when it returns.
+ */
+int hal_flash_erase_wait(uint8_t flash_id, uint32_t address,
+  uint32_t num_bytes, hal_flash_wait_fn *wait_fn, void *wait_arg);
+
+/*
+ * Returns 1 if every byte in the range reads as erased (0xff), 0 if not,
+ * -1 on error.  Stops at the first programmed byte, so checking a range
+ * which is in use is cheap.  Memory-mapped flash is checked in place.
+ */
+int hal_flash_is_erased(uint8_t flash_id, uint32_t address,
+  uint32_t num_bytes);
+
 uint8_t hal_flash_align(uint8_t flash_id);
 int hal_flash_init(void);
 
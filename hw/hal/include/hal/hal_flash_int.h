@@ -35,6 +35,27 @@ struct hal_flash_funcs {
     int (*hff_erase_sector)(uint32_t sector_address);
     int (*hff_sector_info)(int idx, uint32_t *address, uint32_t *size);
     int (*hff_init)(void);
+
+    /*
+     * Optional.  Starts erasing a sector and returns without waiting for the
+     * erase to complete; hff_busy reports completion.  Drivers which cannot
+     * erase in the background leave both NULL.
+     */
+    int (*hff_erase_sector_start)(uint32_t sector_address);
+    int (*hff_busy)(void);
+
+    /*
+     * Optional.  Returns a pointer through which the flash can be read
+     * directly, e.g. internal flash in the CPU address space.  NULL if the
+     * range is not memory-mapped.
+     */
+    const void *(*hff_mmap)(uint32_t address, uint32_t num_bytes);
+
+    /*
+     * Optional.  Starts reading and returns without waiting for the data
+     * (e.g. SPI flash with DMA); hff_busy reports completion.
+     */
+    int (*hff_read_start)(uint32_t address, void *dst, uint32_t num_bytes);
 };
 
 struct hal_flash {
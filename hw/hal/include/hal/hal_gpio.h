@@ -24,6 +24,8 @@
 extern "C" {
 #endif
 
+#include <inttypes.h>
+
 /*
  * The "mode" of the gpio. The gpio is either an input, output, or it is
  * "not connected" (the pin specified is not functioning as a gpio)
@@ -137,6 +139,30 @@ int hal_gpio_read(int pin);
  */
 int hal_gpio_toggle(int pin);
 
+/**
+ * gpio port read
+ *
+ * Reads all pins of a port at once. Pins are grouped into ports as
+ * given by HAL_GPIO_PORT() and HAL_GPIO_PORT_BIT() in <hal/hal_gpio_fast.h>.
+ *
+ * @param port Port number
+ *
+ * @return uint32_t Pin levels, pin N of the port in bit N.
+ */
+uint32_t hal_gpio_port_read(int port);
+
+/**
+ * gpio port write
+ *
+ * Writes several output pins of a port with one register access where
+ * the MCU allows it. Pins not in mask are left alone.
+ *
+ * @param port Port number
+ * @param mask Pins to write, pin N of the port in bit N
+ * @param val  Values for those pins
+ */
+void hal_gpio_port_write(int port, uint32_t mask, uint32_t val);
+
 int hal_gpio_irq_init(int pin, gpio_irq_handler_t handler, void *arg,
                       gpio_irq_trig_t trig, gpio_pull_t pull);
 void hal_gpio_irq_release(int pin);
@@ -0,0 +1,43 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HAL_GPIO_FAST_
+#define H_HAL_GPIO_FAST_
+
+#include <hal/hal_gpio.h>
+
+/*
+ * Inlined pin access, for bit-banged buses and such. When pin number is
+ * a compile time constant (e.g. from bsp.h), these compile down to
+ * a single register access. No checking is done on pin number, and pin
+ * must have been set up with hal_gpio_init_out()/hal_gpio_init_in() first.
+ *
+ * MCU provides these in <mcu/mcu_gpio.h>:
+ *
+ * HAL_GPIO_PORT(pin)           port number of pin, for hal_gpio_port_*()
+ * HAL_GPIO_PORT_BIT(pin)       bit of pin within port
+ *
+ * void hal_gpio_fast_set(int pin);
+ * void hal_gpio_fast_clear(int pin);
+ * void hal_gpio_fast_write(int pin, int val);
+ * int hal_gpio_fast_read(int pin);
+ */
+#include <mcu/mcu_gpio.h>
+
+#endif /* H_HAL_GPIO_FAST_ */
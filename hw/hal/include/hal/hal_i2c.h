@@ -22,6 +22,8 @@
 
 #include <inttypes.h>
 #include <bsp/bsp_sysid.h>
+#include <os/queue.h>
+#include <os/os_eventq.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -105,6 +107,43 @@ hal_i2c_master_begin(struct hal_i2c*);
 int
 hal_i2c_master_end(struct hal_i2c*);
 
+struct hal_i2c_txn;
+typedef void (*hal_i2c_txn_cb)(struct hal_i2c_txn *txn, void *arg);
+
+/* An I2C transaction: optional write followed by optional read from the
+ * same device, with a repeated start in between, and a stop at the end.
+ * Filled in by the caller, and owned by the HAL until it completes.
+ */
+struct hal_i2c_txn {
+    uint8_t  address;       /* 7-bit device address, as above */
+    uint16_t wlen;          /* bytes to write first; 0 for read only */
+    uint8_t *wbuf;
+    uint16_t rlen;          /* bytes to read then; 0 for write only */
+    uint8_t *rbuf;
+    int      status;        /* set on completion; 0 or negative error */
+
+    /* Completion notification; either or both may be used. */
+    hal_i2c_txn_cb cb;      /* called with cb_arg, possibly from an ISR */
+    void *cb_arg;
+    struct os_eventq *evq;  /* ev is posted here; caller sets ev_type/arg */
+    struct os_event ev;
+
+    STAILQ_ENTRY(hal_i2c_txn) next;
+};
+
+/* Queues a transaction on the bus, and returns. Transactions on a bus run
+ * one after another in the order they were submitted, so drivers for
+ * different devices can share it without further locking.
+ *
+ * Drivers which support it run the transaction from interrupts. With
+ * others it is run with the blocking API: by this call if the bus is idle,
+ * otherwise by whoever is running the transaction ahead of it. Either way,
+ * completion is reported through txn->cb and/or txn->evq.
+ * Returns 0 if queued, negative on error.
+ */
+int
+hal_i2c_master_txn(struct hal_i2c *, struct hal_i2c_txn *txn);
+
 /* Probes the i2c bus for a device with this address.  THIS API
  * issues a start condition, probes the address using a read
  * command and issues a stop condition.   There is no need to call
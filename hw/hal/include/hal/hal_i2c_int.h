@@ -36,12 +36,24 @@ struct hal_i2c_funcs {
     int (*hi2cm_probe)      (struct hal_i2c *pi2c, uint8_t address);
     int (*hi2cm_start)      (struct hal_i2c *pi2c);
     int (*hi2cm_stop)       (struct hal_i2c *pi2c);
+
+    /* Optional. Starts the whole transaction and returns; driver calls
+     * hal_i2c_txn_done() once it is over. Returns nonzero if it could not
+     * be started. */
+    int (*hi2cm_txn_start)  (struct hal_i2c *pi2c, struct hal_i2c_txn *txn);
 };
 
+/* Drivers must start with this zeroed */
 struct hal_i2c {
     const struct hal_i2c_funcs *driver_api;
+    STAILQ_HEAD(, hal_i2c_txn) txn_q;   /* head is the one in progress */
+    uint8_t txn_busy;
 };
 
+/* Called by driver when transaction started with hi2cm_txn_start is done */
+void
+hal_i2c_txn_done(struct hal_i2c *pi2c, struct hal_i2c_txn *txn, int status);
+
 struct hal_i2c *
 bsp_get_hal_i2c_driver(enum system_device_id sysid);
 
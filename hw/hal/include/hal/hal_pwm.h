@@ -26,6 +26,8 @@ extern "C" {
 
 #include <inttypes.h>
 #include <bsp/bsp_sysid.h>
+#include <os/queue.h>
+#include <os/os_eventq.h>
 
 /* This is an abstract hardware API to Pulse Width Modulators.
  * A Pulse width module produces an output pulse stream with
@@ -75,6 +77,65 @@ hal_pwm_set_frequency(struct hal_pwm *ppwm, uint32_t freq_hz);
  * compute the period of the PWM Its 2^resolution/clock_freq
  */
 
+struct hal_pwm_stream;
+
+/* Called from interrupt context when <buf> has been played out, and can
+ * be refilled
+ */
+typedef void (*hal_pwm_stream_cb)(struct hal_pwm_stream *st, uint16_t *buf);
+
+/* Continuous output of a waveform, one duty cycle per sample, from a pair
+ * of buffers. While one buffer is being played by DMA, the other one
+ * belongs to the application; it must be refilled before the one playing
+ * runs out. Set up by the caller, and left alone while playing.
+ *
+ * Samples are in the PWM driver's own format, which depends on the rate;
+ * hal_pwm_stream_setup() fills in top and mark, after which samples can be
+ * made with hal_pwm_stream_sample().
+ */
+struct hal_pwm_stream {
+    uint32_t rate;              /* samples per second */
+    uint16_t *bufs[2];          /* played alternately */
+    uint16_t buf_cnt;           /* samples per buffer */
+
+    /* Buffer played notification; either or both may be used. */
+    hal_pwm_stream_cb cb;
+    void *cb_arg;
+    struct os_eventq *evq;      /* ev is posted here with ev_arg set to the
+                                 * played buffer; caller sets ev_type */
+    struct os_event ev;
+
+    /* Set by hal_pwm_stream_setup() */
+    uint16_t top;               /* on time of a sample at 100% duty cycle */
+    uint16_t mark;              /* ORed into every sample */
+
+    /* Times a buffer was played out while ev was still queued */
+    uint32_t underruns;
+};
+
+/* Sample with the same fractional duty cycle as in
+ * hal_pwm_enable_duty_cycle().
+ */
+static inline uint16_t
+hal_pwm_stream_sample(const struct hal_pwm_stream *st, uint16_t fraction)
+{
+    return (((uint32_t)fraction * st->top + 32767) / 65535) | st->mark;
+}
+
+/* Fills in the sample format for st->rate. Returns 0 on success, negative
+ * on error, or if not supported by driver.
+ */
+int hal_pwm_stream_setup(struct hal_pwm *ppwm, struct hal_pwm_stream *st);
+
+/* Starts playing, first bufs[0], then bufs[1], and so on. Both buffers
+ * must be filled beforehand. Only one stream per PWM device can be active
+ * at a time. Returns 0 on success, negative on error.
+ */
+int hal_pwm_stream_start(struct hal_pwm *ppwm, struct hal_pwm_stream *st);
+
+/* Stops playing. Returns 0 on success, negative on error. */
+int hal_pwm_stream_stop(struct hal_pwm *ppwm);
+
 
 #ifdef __cplusplus
 }
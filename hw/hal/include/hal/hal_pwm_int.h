@@ -41,12 +41,23 @@ struct hal_pwm_funcs {
     int     (*hpwm_ena_duty)  (struct hal_pwm *ppwm, uint16_t frac_duty);
     int     (*hpwm_set_freq)  (struct hal_pwm *ppwm, uint32_t freq_hz);
 
+    /* Optional; waveform streaming */
+    int     (*hpwm_stream_setup)    (struct hal_pwm *ppwm,
+                                     struct hal_pwm_stream *st);
+    int     (*hpwm_stream_start)    (struct hal_pwm *ppwm,
+                                     struct hal_pwm_stream *st);
+    int     (*hpwm_stream_stop)     (struct hal_pwm *ppwm);
 };
 
 struct hal_pwm {
     const struct hal_pwm_funcs *driver_api;
 };
 
+/* Called by drivers from interrupt context when <buf> of a stream has
+ * been played
+ */
+void hal_pwm_stream_done(struct hal_pwm_stream *st, uint16_t *buf);
+
 struct hal_pwm *
 bsp_get_hal_pwm_driver(enum system_device_id sysid);
 
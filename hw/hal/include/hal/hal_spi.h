@@ -47,6 +47,7 @@ enum hal_spi_word_size{
     HAL_SPI_WORD_SIZE_9BIT,
 };
 
+/* SPI clock rate, in kHz */
 typedef uint32_t hal_spi_baudrate;
 
 /* since one spi device can control multiple devices, some configuration
@@ -78,6 +79,45 @@ hal_spi_config(struct hal_spi *pspi, struct hal_spi_settings *psettings);
 int
 hal_spi_master_transfer(struct hal_spi *psdi, uint16_t tx);
 
+/* Called when a non-blocking transfer completes. len is the number of
+ * words transferred. Called from interrupt context.
+ */
+typedef void (*hal_spi_txrx_cb)(void *arg, int len);
+
+/* Do a blocking master spi transfer of <len> 8-bit words. Data in <txbuf>
+ * is sent while received data is stored in <rxbuf>. If <txbuf> is NULL, 0xff
+ * is sent; if <rxbuf> is NULL, received data is discarded. Drivers using DMA
+ * may require both buffers to be in RAM.
+ * Returns 0 on success, negative on error.
+ */
+int
+hal_spi_txrx(struct hal_spi *pspi, void *txbuf, void *rxbuf, int len);
+
+/* Start a master spi transfer like hal_spi_txrx(), but return without
+ * waiting for it to finish. <cb> is called with <arg> once done; buffers must
+ * stay valid until then. Only one transfer can be in progress at a time.
+ * If the driver has no non-blocking support, the transfer is done before
+ * this returns, and <cb> gets called from the caller's context.
+ * Returns 0 if the transfer was started, negative on error.
+ */
+int
+hal_spi_txrx_nonblock(struct hal_spi *pspi, void *txbuf, void *rxbuf,
+                      int len, hal_spi_txrx_cb cb, void *arg);
+
+/* Set up the buffers for the next transfer of a slave spi. When the master
+ * selects the slave, up to <txlen> 8-bit words from <txbuf> are sent and up
+ * to <rxlen> received words are stored in <rxbuf>; past the end of <txbuf>
+ * the driver's default word is sent, and words beyond <rxlen> are dropped.
+ * <cb> is called with the number of words received once the master ends the
+ * transfer, from interrupt context. Buffers must stay valid until then.
+ * Calling this again before the master selects the slave replaces the
+ * pending setup.
+ * Returns 0 on success, negative on error or if the device is not a slave.
+ */
+int
+hal_spi_slave_txrx(struct hal_spi *pspi, void *txbuf, int txlen,
+                   void *rxbuf, int rxlen, hal_spi_txrx_cb cb, void *arg);
+
 
 #ifdef __cplusplus
 }
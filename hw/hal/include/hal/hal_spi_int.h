@@ -25,6 +25,7 @@ extern "C" {
 #endif
 
 #include <bsp/bsp_sysid.h>
+#include <hal/hal_spi.h>
 
 struct hal_spi;
 
@@ -42,6 +43,16 @@ hal_spi_master_transfer(struct hal_spi *psdi, uint16_t tx);
 struct hal_spi_funcs {
     int (*hspi_config)           (struct hal_spi *pspi, struct hal_spi_settings *psettings);
     int (*hspi_master_transfer)  (struct hal_spi *psdi, uint16_t tx);
+
+    /* Optional; hal_spi_txrx() falls back to one word at a time */
+    int (*hspi_txrx)             (struct hal_spi *pspi, void *txbuf, void *rxbuf, int len);
+    /* Optional; hal_spi_txrx_nonblock() falls back to hal_spi_txrx() */
+    int (*hspi_txrx_nonblock)    (struct hal_spi *pspi, void *txbuf, void *rxbuf, int len,
+                                  hal_spi_txrx_cb cb, void *arg);
+    /* Optional; only slave devices implement this */
+    int (*hspi_slave_txrx)       (struct hal_spi *pspi, void *txbuf, int txlen,
+                                  void *rxbuf, int rxlen, hal_spi_txrx_cb cb,
+                                  void *arg);
 };
 
 /* This is the internal device representation for a hal_spi device.
@@ -57,6 +57,43 @@ typedef int (*hal_uart_rx_char)(void *arg, uint8_t byte);
 int hal_uart_init_cbs(int uart, hal_uart_tx_char tx_func,
   hal_uart_tx_done tx_done, hal_uart_rx_char rx_func, void *arg);
 
+/*
+ * Function prototype for UART driver to ask for the next block of data to
+ * send. tx_len is the number of bytes sent from the block returned by the
+ * previous call (0 on the first call). Driver may send fewer bytes than
+ * asked for; the caller then hands out the remainder on the next call.
+ * Sets *buf to the data and returns its length, or -1 if no more data is
+ * available for TX. Buffer must stay valid until the next call.
+ * Driver must call this with interrupts disabled.
+ */
+typedef int (*hal_uart_tx_block)(void *arg, int tx_len, uint8_t **buf);
+
+/*
+ * Function prototype for UART driver to report incoming data in block mode.
+ * rx_len is the number of bytes received into the buffer returned by the
+ * previous call (0 on the first call, and when resuming after a stall).
+ * Driver may report fewer bytes than asked for; it does so when the line
+ * goes idle with part of the block received, so data trickling in (e.g.
+ * keystrokes) is not held back waiting for the block to fill up. Sets *buf
+ * to where the next data should be received and returns the number of bytes
+ * wanted, or -1 if no more data can be accepted for now.
+ * Driver must call this with interrupts disabled.
+ */
+typedef int (*hal_uart_rx_block)(void *arg, int rx_len, uint8_t **buf);
+
+/**
+ * hal uart init block cbs
+ *
+ * Like hal_uart_init_cbs(), but registers block callbacks. The upper layer
+ * supplies the buffers, which lets a driver with DMA move whole blocks
+ * without taking an interrupt per byte.
+ *
+ * Returns -1 if the driver does not support block mode; caller should then
+ * fall back to hal_uart_init_cbs().
+ */
+int hal_uart_init_block_cbs(int uart, hal_uart_tx_block tx_func,
+  hal_uart_tx_done tx_done, hal_uart_rx_block rx_func, void *arg);
+
 enum hal_uart_parity {
     HAL_UART_PARITY_NONE = 0,	/* no parity */
     HAL_UART_PARITY_ODD = 1,	/* odd parity bit */
@@ -94,8 +131,8 @@ void hal_uart_start_tx(int uart);
  * hal uart start rx
  *
  * Upper layers have consumed some data, and are now ready to receive more.
- * This is meaningful after uart_rx_char callback has returned -1 telling
- * that no more data can be accepted.
+ * This is meaningful after uart_rx_char (or uart_rx_block) callback has
+ * returned -1 telling that no more data can be accepted.
  */
 void hal_uart_start_rx(int uart);
 
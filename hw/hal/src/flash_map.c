@@ -183,6 +183,17 @@ flash_area_erase(const struct flash_area *fa, uint32_t off, uint32_t len)
     return hal_flash_erase(fa->fa_flash_id, fa->fa_off + off, len);
 }
 
+int
+flash_area_erase_wait(const struct flash_area *fa, uint32_t off, uint32_t len,
+  hal_flash_wait_fn *wait_fn, void *wait_arg)
+{
+    if (off > fa->fa_size || off + len > fa->fa_size) {
+        return -1;
+    }
+    return hal_flash_erase_wait(fa->fa_flash_id, fa->fa_off + off, len,
+      wait_fn, wait_arg);
+}
+
 uint8_t
 flash_area_align(const struct flash_area *fa)
 {
@@ -17,6 +17,8 @@
  * under the License.
  */
 #include <inttypes.h>
+#include <stddef.h>
+#include <os/os.h>
 #include <hal/hal_adc.h>
 #include <hal/hal_adc_int.h>
 
@@ -53,6 +55,43 @@ hal_adc_get_ref_mv(struct hal_adc *padc)
     return -1;
 }
 
+int
+hal_adc_stream_start(struct hal_adc *padc, struct hal_adc_stream *st)
+{
+    if (!st || !st->rate || !st->buf_cnt || !st->bufs[0] || !st->bufs[1]) {
+        return -1;
+    }
+    if (padc && padc->driver_api && padc->driver_api->hadc_stream_start) {
+        st->overruns = 0;
+        return padc->driver_api->hadc_stream_start(padc, st);
+    }
+    return -1;
+}
+
+int
+hal_adc_stream_stop(struct hal_adc *padc)
+{
+    if (padc && padc->driver_api && padc->driver_api->hadc_stream_stop) {
+        return padc->driver_api->hadc_stream_stop(padc);
+    }
+    return -1;
+}
+
+void
+hal_adc_stream_done(struct hal_adc_stream *st, int16_t *buf)
+{
+    if (st->cb) {
+        st->cb(st, buf);
+    }
+    if (st->evq) {
+        if (OS_EVENT_QUEUED(&st->ev)) {
+            st->overruns++;
+        }
+        st->ev.ev_arg = buf;
+        os_eventq_put(st->evq, &st->ev);
+    }
+}
+
 /* returns the ADC read value converted to mvolts or negative on error */
 int 
 hal_adc_to_mv(struct hal_adc *padc, int val) 
@@ -31,15 +31,114 @@
  */
 struct cputime_data g_cputime;
 
-/* Queue for timers */
-TAILQ_HEAD(cputime_qhead, cpu_timer) g_cputimer_q;
+/*
+ * Timers sharing the cputime output compare are kept in a binary min-heap
+ * ordered by expiration time, so that starting, stopping and expiring a
+ * timer is O(log n). The heap is an array of timer pointers; each timer
+ * records its own position to allow removal from the middle.
+ */
+
+/* Largest number of dedicated output compare channels supported. */
+#define CPUTIME_MAX_OCMP            (8)
+
+static struct cpu_timer *g_cputimer_heap[HAL_CPUTIME_MAX_TIMERS];
+static uint16_t g_cputimer_heap_cnt;
+
+/* Timers owning a dedicated output compare channel, indexed by channel. */
+static struct cpu_timer *g_cputimer_ocmp[CPUTIME_MAX_OCMP];
+
+static void
+cputime_heap_set(int idx, struct cpu_timer *timer)
+{
+    g_cputimer_heap[idx] = timer;
+    timer->heap_idx = idx;
+}
+
+static void
+cputime_heap_sift_up(int idx)
+{
+    struct cpu_timer *timer;
+    int parent;
+
+    timer = g_cputimer_heap[idx];
+    while (idx > 0) {
+        parent = (idx - 1) / 2;
+        if (!CPUTIME_LT(timer->cputime, g_cputimer_heap[parent]->cputime)) {
+            break;
+        }
+        cputime_heap_set(idx, g_cputimer_heap[parent]);
+        idx = parent;
+    }
+    cputime_heap_set(idx, timer);
+}
+
+static void
+cputime_heap_sift_down(int idx)
+{
+    struct cpu_timer *timer;
+    int child;
+
+    timer = g_cputimer_heap[idx];
+    while (1) {
+        child = 2 * idx + 1;
+        if (child >= g_cputimer_heap_cnt) {
+            break;
+        }
+        if (child + 1 < g_cputimer_heap_cnt &&
+            CPUTIME_LT(g_cputimer_heap[child + 1]->cputime,
+                       g_cputimer_heap[child]->cputime)) {
+            child++;
+        }
+        if (!CPUTIME_LT(g_cputimer_heap[child]->cputime, timer->cputime)) {
+            break;
+        }
+        cputime_heap_set(idx, g_cputimer_heap[child]);
+        idx = child;
+    }
+    cputime_heap_set(idx, timer);
+}
+
+static int
+cputime_heap_insert(struct cpu_timer *timer)
+{
+    if (g_cputimer_heap_cnt >= HAL_CPUTIME_MAX_TIMERS) {
+        return -1;
+    }
+
+    cputime_heap_set(g_cputimer_heap_cnt, timer);
+    g_cputimer_heap_cnt++;
+    cputime_heap_sift_up(timer->heap_idx);
+    return 0;
+}
+
+static void
+cputime_heap_remove(struct cpu_timer *timer)
+{
+    struct cpu_timer *parent;
+    struct cpu_timer *last;
+    int idx;
+
+    idx = timer->heap_idx;
+    g_cputimer_heap_cnt--;
+    if (idx != g_cputimer_heap_cnt) {
+        /* Fill the hole with the last entry and restore heap order. */
+        last = g_cputimer_heap[g_cputimer_heap_cnt];
+        cputime_heap_set(idx, last);
+        parent = g_cputimer_heap[(idx - 1) / 2];
+        if (idx > 0 && CPUTIME_LT(last->cputime, parent->cputime)) {
+            cputime_heap_sift_up(idx);
+        } else {
+            cputime_heap_sift_down(idx);
+        }
+    }
+    timer->running = 0;
+}
 
 /**
  * cputime chk expiration
  *
- * Iterates through the cputimer queue to determine if any timers have expired.
- * If the timer has expired the timer is removed from the queue and the timer
- * callback function is executed.
+ * Removes expired timers from the timer heap and executes their callback
+ * functions.
  *
  */
 void
@@ -49,10 +148,10 @@ cputime_chk_expiration(void)
     struct cpu_timer *timer;
 
     OS_ENTER_CRITICAL(sr);
-    while ((timer = TAILQ_FIRST(&g_cputimer_q)) != NULL) {
+    while (g_cputimer_heap_cnt != 0) {
+        timer = g_cputimer_heap[0];
         if ((int32_t)(cputime_get32() - timer->cputime) >= 0) {
-            TAILQ_REMOVE(&g_cputimer_q, timer, link);
-            timer->link.tqe_prev = NULL;
+            cputime_heap_remove(timer);
             timer->cb(timer->arg);
         } else {
             break;
@@ -60,15 +159,39 @@ cputime_chk_expiration(void)
     }
 
     /* Any timers left on queue? If so, we need to set OCMP */
-    timer = TAILQ_FIRST(&g_cputimer_q);
-    if (timer) {
-        cputime_set_ocmp(timer);
+    if (g_cputimer_heap_cnt != 0) {
+        cputime_set_ocmp(g_cputimer_heap[0]);
     } else {
         cputime_disable_ocmp();
     }
     OS_EXIT_CRITICAL(sr);
 }
 
+/**
+ * cputime ocmp expiration
+ *
+ * Called by the MCU specific code when a dedicated output compare channel
+ * fires. Executes the callback of the timer owning the channel.
+ *
+ * @param ocmp The output compare channel number.
+ */
+void
+cputime_chk_ocmp_expiration(int ocmp)
+{
+    os_sr_t sr;
+    struct cpu_timer *timer;
+
+    OS_ENTER_CRITICAL(sr);
+    timer = g_cputimer_ocmp[ocmp];
+    if (timer != NULL && timer->running &&
+        (int32_t)(cputime_get32() - timer->cputime) >= 0) {
+        cputime_hw_disable_ocmp(ocmp);
+        timer->running = 0;
+        timer->cb(timer->arg);
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
 /**
  * cputime init
  *
@@ -85,7 +208,7 @@ cputime_init(uint32_t clock_freq)
 {
     int rc;
 
-    TAILQ_INIT(&g_cputimer_q);
+    g_cputimer_heap_cnt = 0;
     rc = cputime_hw_init(clock_freq);
     return rc;
 }
@@ -240,7 +363,58 @@ cputime_timer_init(struct cpu_timer *timer, cputimer_func fp, void *arg)
 
     timer->cb = fp;
     timer->arg = arg;
-    timer->link.tqe_prev = (void *) NULL;
+    timer->running = 0;
+    timer->ocmp = 0;
+}
+
+/**
+ * cputime timer init dedicated
+ *
+ * Initializes a timer and gives it an output compare channel of its own, if
+ * the hardware has one to spare. The timer's callback is then executed
+ * directly from the channel's interrupt; it is not delayed by other timers
+ * expiring at the same time. If no channel is available, the timer shares
+ * the cputime output compare like any other timer. Channels are never
+ * released; use this for timers that exist for the lifetime of the system.
+ * Must be called after cputime_init().
+ *
+ * @param timer The timer to initialize. Cannot be NULL.
+ * @param fp    The timer callback function. Cannot be NULL.
+ * @param arg   Pointer to data object to pass to timer.
+ *
+ * @return int 0 if the timer got a dedicated channel; -1 if it shares the
+ *         cputime output compare.
+ */
+int
+cputime_timer_init_dedicated(struct cpu_timer *timer, cputimer_func fp,
+                             void *arg)
+{
+    os_sr_t sr;
+    int num_ocmp;
+    int ocmp;
+    int rc;
+
+    cputime_timer_init(timer, fp, arg);
+
+    num_ocmp = cputime_hw_num_ocmp();
+    if (num_ocmp > CPUTIME_MAX_OCMP) {
+        num_ocmp = CPUTIME_MAX_OCMP;
+    }
+
+    rc = -1;
+    OS_ENTER_CRITICAL(sr);
+    /* Channel 0 is the shared output compare. */
+    for (ocmp = 1; ocmp < num_ocmp; ocmp++) {
+        if (g_cputimer_ocmp[ocmp] == NULL) {
+            g_cputimer_ocmp[ocmp] = timer;
+            timer->ocmp = ocmp;
+            rc = 0;
+            break;
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return rc;
 }
 
 /**
@@ -252,40 +426,42 @@ cputime_timer_init(struct cpu_timer *timer, cputimer_func fp, void *arg)
  *
  * @param timer     Pointer to timer to start. Cannot be NULL.
  * @param cputime   The cputime at which the timer should expire.
+ *
+ * @return int 0 on success; -1 if HAL_CPUTIME_MAX_TIMERS shared timers are
+ *         already running. The timer is not started in that case.
  */
-void
+int
 cputime_timer_start(struct cpu_timer *timer, uint32_t cputime)
 {
-    struct cpu_timer *entry;
     os_sr_t sr;
+    int rc;
 
     assert(timer != NULL);
-    assert(timer->link.tqe_prev == NULL);
+    assert(!timer->running);
 
     /* XXX: should this use a mutex? not sure... */
     OS_ENTER_CRITICAL(sr);
 
+    rc = 0;
     timer->cputime = cputime;
-    if (TAILQ_EMPTY(&g_cputimer_q)) {
-        TAILQ_INSERT_HEAD(&g_cputimer_q, timer, link);
+    if (timer->ocmp != 0) {
+        timer->running = 1;
+        cputime_hw_set_ocmp(timer->ocmp, cputime);
     } else {
-        TAILQ_FOREACH(entry, &g_cputimer_q, link) {
-            if ((int32_t)(timer->cputime - entry->cputime) < 0) {
-                TAILQ_INSERT_BEFORE(entry, timer, link);
-                break;
+        rc = cputime_heap_insert(timer);
+        if (rc == 0) {
+            timer->running = 1;
+
+            /* If this is the head, we need to set new OCMP */
+            if (timer->heap_idx == 0) {
+                cputime_set_ocmp(timer);
             }
         }
-        if (!entry) {
-            TAILQ_INSERT_TAIL(&g_cputimer_q, timer, link);
-        }
-    }
-
-    /* If this is the head, we need to set new OCMP */
-    if (timer == TAILQ_FIRST(&g_cputimer_q)) {
-        cputime_set_ocmp(timer);
     }
 
     OS_EXIT_CRITICAL(sr);
+
+    return rc;
 }
 
 /**
@@ -296,8 +472,10 @@ cputime_timer_start(struct cpu_timer *timer, uint32_t cputime)
  *
  * @param timer Pointer to timer. Cannot be NULL.
  * @param usecs The number of usecs from now at which the timer will expire.
+ *
+ * @return int 0 on success; -1 if too many timers are running.
  */
-void
+int
 cputime_timer_relative(struct cpu_timer *timer, uint32_t usecs)
 {
     uint32_t cputime;
@@ -305,7 +483,7 @@ cputime_timer_relative(struct cpu_timer *timer, uint32_t usecs)
     assert(timer != NULL);
 
     cputime = cputime_get32() + cputime_usecs_to_ticks(usecs);
-    cputime_timer_start(timer, cputime);
+    return cputime_timer_start(timer, cputime);
 }
 
 /**
@@ -322,26 +500,25 @@ cputime_timer_stop(struct cpu_timer *timer)
 {
     os_sr_t sr;
     int reset_ocmp;
-    struct cpu_timer *entry;
 
     assert(timer != NULL);
 
     OS_ENTER_CRITICAL(sr);
 
-    if (timer->link.tqe_prev != NULL) {
-        reset_ocmp = 0;
-        if (timer == TAILQ_FIRST(&g_cputimer_q)) {
+    if (timer->running) {
+        if (timer->ocmp != 0) {
+            cputime_hw_disable_ocmp(timer->ocmp);
+            timer->running = 0;
+        } else {
             /* If first on queue, we will need to reset OCMP */
-            entry = TAILQ_NEXT(timer, link);
-            reset_ocmp = 1;
-        }
-        TAILQ_REMOVE(&g_cputimer_q, timer, link);
-        timer->link.tqe_prev = NULL;
-        if (reset_ocmp) {
-            if (entry) {
-                cputime_set_ocmp(entry);
-            } else {
-                cputime_disable_ocmp();
+            reset_ocmp = timer->heap_idx == 0;
+            cputime_heap_remove(timer);
+            if (reset_ocmp) {
+                if (g_cputimer_heap_cnt != 0) {
+                    cputime_set_ocmp(g_cputimer_heap[0]);
+                } else {
+                    cputime_disable_ocmp();
+                }
             }
         }
     }
@@ -349,3 +526,41 @@ cputime_timer_stop(struct cpu_timer *timer)
     OS_EXIT_CRITICAL(sr);
 }
 
+/**
+ * cputime next expiry
+ *
+ * Finds the earliest expiration time of all running timers.
+ *
+ * @param cputime   Filled with the expiration time of the first timer.
+ *
+ * @return int 0 on success; -1 if no timers are running.
+ */
+int
+cputime_next_expiry(uint32_t *cputime)
+{
+    struct cpu_timer *timer;
+    os_sr_t sr;
+    int found;
+    int i;
+
+    found = 0;
+
+    OS_ENTER_CRITICAL(sr);
+    if (g_cputimer_heap_cnt != 0) {
+        *cputime = g_cputimer_heap[0]->cputime;
+        found = 1;
+    }
+    for (i = 0; i < CPUTIME_MAX_OCMP; i++) {
+        timer = g_cputimer_ocmp[i];
+        if (timer == NULL || !timer->running) {
+            continue;
+        }
+        if (!found || CPUTIME_LT(timer->cputime, *cputime)) {
+            *cputime = timer->cputime;
+            found = 1;
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return found ? 0 : -1;
+}
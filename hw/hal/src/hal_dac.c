@@ -16,6 +16,8 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <stddef.h>
+#include <os/os.h>
 #include <hal/hal_dac.h>
 #include <hal/hal_dac_int.h>
 
@@ -94,3 +96,40 @@ hal_dac_disable(struct hal_dac *pdac)
     }
     return -1;
 }
+
+int
+hal_dac_stream_start(struct hal_dac *pdac, struct hal_dac_stream *st)
+{
+    if (!st || !st->rate || !st->buf_cnt || !st->bufs[0] || !st->bufs[1]) {
+        return -1;
+    }
+    if (pdac && pdac->driver_api && pdac->driver_api->hdac_stream_start) {
+        st->underruns = 0;
+        return pdac->driver_api->hdac_stream_start(pdac, st);
+    }
+    return -1;
+}
+
+int
+hal_dac_stream_stop(struct hal_dac *pdac)
+{
+    if (pdac && pdac->driver_api && pdac->driver_api->hdac_stream_stop) {
+        return pdac->driver_api->hdac_stream_stop(pdac);
+    }
+    return -1;
+}
+
+void
+hal_dac_stream_done(struct hal_dac_stream *st, uint16_t *buf)
+{
+    if (st->cb) {
+        st->cb(st, buf);
+    }
+    if (st->evq) {
+        if (OS_EVENT_QUEUED(&st->ev)) {
+            st->underruns++;
+        }
+        st->ev.ev_arg = buf;
+        os_eventq_put(st->evq, &st->ev);
+    }
+}
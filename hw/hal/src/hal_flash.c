@@ -16,14 +16,188 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <stddef.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <string.h>
+#include <os/os.h>
 #include <bsp/bsp.h>
 
 #include "hal/hal_bsp.h"
 #include "hal/hal_flash.h"
 #include "hal/hal_flash_int.h"
 
+/*
+ * Read cache for flash which is not memory-mapped (e.g. SPI flash), where
+ * every read is a bus transaction.  Reads shorter than a line are served
+ * from HAL_FLASH_CACHE_LINES aligned lines, replaced least recently used.
+ * Lines are invalidated after writes and erases.  Disabled unless the BSP
+ * sets HAL_FLASH_CACHE_LINES in its cflags.
+ */
+#ifndef HAL_FLASH_CACHE_LINES
+#define HAL_FLASH_CACHE_LINES       0
+#endif
+
+#ifndef HAL_FLASH_CACHE_LINE_SZ
+#define HAL_FLASH_CACHE_LINE_SZ     32  /* Power of 2 */
+#endif
+
+#if HAL_FLASH_CACHE_LINES > 0
+struct hal_flash_cache_line {
+    uint32_t hfc_addr;
+    uint32_t hfc_used;              /* When last accessed, for LRU */
+    uint8_t hfc_id;
+    uint8_t hfc_valid:1;
+    uint8_t hfc_busy:1;             /* Being filled */
+    uint8_t hfc_data[HAL_FLASH_CACHE_LINE_SZ];
+};
+
+static struct hal_flash_cache_line hal_flash_cache[HAL_FLASH_CACHE_LINES];
+static uint32_t hal_flash_cache_clock;
+
+/*
+ * Incremented on every invalidation.  A fill which races with a write or
+ * erase sees it change, and does not mark its line valid.
+ */
+static uint32_t hal_flash_cache_gen;
+
+/*
+ * Devices with a background erase in progress, by id modulo 32; their lines
+ * are invalidated again once hal_flash_busy() reports completion.
+ */
+static uint32_t hal_flash_cache_erasing;
+
+static void
+hal_flash_cache_inval(uint8_t id, uint32_t address, uint32_t num_bytes)
+{
+    struct hal_flash_cache_line *line;
+    os_sr_t sr;
+    int i;
+
+    OS_ENTER_CRITICAL(sr);
+    hal_flash_cache_gen++;
+    for (i = 0; i < HAL_FLASH_CACHE_LINES; i++) {
+        line = &hal_flash_cache[i];
+        if (line->hfc_id == id &&
+          line->hfc_addr < address + num_bytes &&
+          line->hfc_addr + HAL_FLASH_CACHE_LINE_SZ > address) {
+            line->hfc_valid = 0;
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+static void
+hal_flash_cache_inval_dev(uint8_t id, const struct hal_flash *hf)
+{
+    hal_flash_cache_inval(id, hf->hf_base_addr, hf->hf_size);
+}
+
+/*
+ * Copies num_bytes at off within the line starting at line_addr.
+ */
+static int
+hal_flash_cache_copy(uint8_t id, const struct hal_flash *hf,
+  uint32_t line_addr, uint32_t off, uint8_t *dst, uint32_t num_bytes)
+{
+    struct hal_flash_cache_line *line;
+    struct hal_flash_cache_line *victim;
+    uint32_t gen;
+    os_sr_t sr;
+    int rc;
+    int i;
+
+    victim = NULL;
+    OS_ENTER_CRITICAL(sr);
+    for (i = 0; i < HAL_FLASH_CACHE_LINES; i++) {
+        line = &hal_flash_cache[i];
+        if (line->hfc_valid && line->hfc_id == id &&
+          line->hfc_addr == line_addr) {
+            memcpy(dst, line->hfc_data + off, num_bytes);
+            line->hfc_used = ++hal_flash_cache_clock;
+            OS_EXIT_CRITICAL(sr);
+            return 0;
+        }
+        if (line->hfc_busy) {
+            continue;
+        }
+        if (!victim || !line->hfc_valid ||
+          (victim->hfc_valid &&
+            (int32_t)(line->hfc_used - victim->hfc_used) < 0)) {
+            victim = line;
+        }
+    }
+    if (victim) {
+        victim->hfc_valid = 0;
+        victim->hfc_busy = 1;
+    }
+    gen = hal_flash_cache_gen;
+    OS_EXIT_CRITICAL(sr);
+
+    if (!victim) {
+        /* All lines being filled by other tasks. */
+        return hf->hf_itf->hff_read(line_addr + off, dst, num_bytes);
+    }
+
+    rc = hf->hf_itf->hff_read(line_addr, victim->hfc_data,
+      HAL_FLASH_CACHE_LINE_SZ);
+    if (rc == 0) {
+        memcpy(dst, victim->hfc_data + off, num_bytes);
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    victim->hfc_busy = 0;
+    if (rc == 0 && gen == hal_flash_cache_gen) {
+        victim->hfc_id = id;
+        victim->hfc_addr = line_addr;
+        victim->hfc_used = ++hal_flash_cache_clock;
+        victim->hfc_valid = 1;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return rc;
+}
+
+static int
+hal_flash_cache_read(uint8_t id, const struct hal_flash *hf,
+  uint32_t address, void *dst, uint32_t num_bytes)
+{
+    uint32_t line_addr;
+    uint32_t off;
+    uint32_t cnt;
+    uint8_t *d;
+    int rc;
+
+    if ((address & ~(HAL_FLASH_CACHE_LINE_SZ - 1)) < hf->hf_base_addr ||
+      ((address + num_bytes + HAL_FLASH_CACHE_LINE_SZ - 1) &
+        ~(HAL_FLASH_CACHE_LINE_SZ - 1)) > hf->hf_base_addr + hf->hf_size) {
+        /* Lines would extend past the device. */
+        return hf->hf_itf->hff_read(address, dst, num_bytes);
+    }
+
+    d = dst;
+    while (num_bytes) {
+        line_addr = address & ~(HAL_FLASH_CACHE_LINE_SZ - 1);
+        off = address - line_addr;
+        cnt = HAL_FLASH_CACHE_LINE_SZ - off;
+        if (cnt > num_bytes) {
+            cnt = num_bytes;
+        }
+        rc = hal_flash_cache_copy(id, hf, line_addr, off, d, cnt);
+        if (rc) {
+            return rc;
+        }
+        address += cnt;
+        d += cnt;
+        num_bytes -= cnt;
+    }
+    return 0;
+}
+#else
+#define hal_flash_cache_inval(id, address, num_bytes)
+#define hal_flash_cache_inval_dev(id, hf)
+#endif
+
 int
 hal_flash_init(void)
 {
@@ -89,14 +263,56 @@ hal_flash_read(uint8_t id, uint32_t address, void *dst, uint32_t num_bytes)
       hal_flash_check_addr(hf, address + num_bytes)) {
         return -1;
     }
+#if HAL_FLASH_CACHE_LINES > 0
+    if (!hf->hf_itf->hff_mmap && num_bytes < HAL_FLASH_CACHE_LINE_SZ) {
+        return hal_flash_cache_read(id, hf, address, dst, num_bytes);
+    }
+#endif
     return hf->hf_itf->hff_read(address, dst, num_bytes);
 }
 
+int
+hal_flash_read_start(uint8_t id, uint32_t address, void *dst,
+  uint32_t num_bytes)
+{
+    const struct hal_flash *hf;
+
+    hf = bsp_flash_dev(id);
+    if (!hf) {
+        return -1;
+    }
+    if (hal_flash_check_addr(hf, address) ||
+      hal_flash_check_addr(hf, address + num_bytes)) {
+        return -1;
+    }
+    if (!hf->hf_itf->hff_read_start) {
+        return hf->hf_itf->hff_read(address, dst, num_bytes);
+    }
+    return hf->hf_itf->hff_read_start(address, dst, num_bytes);
+}
+
+const void *
+hal_flash_mmap(uint8_t id, uint32_t address, uint32_t num_bytes)
+{
+    const struct hal_flash *hf;
+
+    hf = bsp_flash_dev(id);
+    if (!hf || !hf->hf_itf->hff_mmap) {
+        return NULL;
+    }
+    if (hal_flash_check_addr(hf, address) ||
+      hal_flash_check_addr(hf, address + num_bytes)) {
+        return NULL;
+    }
+    return hf->hf_itf->hff_mmap(address, num_bytes);
+}
+
 int
 hal_flash_write(uint8_t id, uint32_t address, const void *src,
   uint32_t num_bytes)
 {
     const struct hal_flash *hf;
+    int rc;
 
     hf = bsp_flash_dev(id);
     if (!hf) {
@@ -106,13 +322,16 @@ hal_flash_write(uint8_t id, uint32_t address, const void *src,
       hal_flash_check_addr(hf, address + num_bytes)) {
         return -1;
     }
-    return hf->hf_itf->hff_write(address, src, num_bytes);
+    rc = hf->hf_itf->hff_write(address, src, num_bytes);
+    hal_flash_cache_inval(id, address, num_bytes);
+    return rc;
 }
 
 int
 hal_flash_erase_sector(uint8_t id, uint32_t sector_address)
 {
     const struct hal_flash *hf;
+    int rc;
 
     hf = bsp_flash_dev(id);
     if (!hf) {
@@ -121,11 +340,125 @@ hal_flash_erase_sector(uint8_t id, uint32_t sector_address)
     if (hal_flash_check_addr(hf, sector_address)) {
         return -1;
     }
-    return hf->hf_itf->hff_erase_sector(sector_address);
+    rc = hf->hf_itf->hff_erase_sector(sector_address);
+    hal_flash_cache_inval_dev(id, hf);
+    return rc;
+}
+
+int
+hal_flash_erase_sector_start(uint8_t id, uint32_t sector_address)
+{
+    const struct hal_flash *hf;
+    int rc;
+
+    hf = bsp_flash_dev(id);
+    if (!hf) {
+        return -1;
+    }
+    if (hal_flash_check_addr(hf, sector_address)) {
+        return -1;
+    }
+    if (!hf->hf_itf->hff_erase_sector_start) {
+        rc = hf->hf_itf->hff_erase_sector(sector_address);
+    } else {
+        rc = hf->hf_itf->hff_erase_sector_start(sector_address);
+#if HAL_FLASH_CACHE_LINES > 0
+        hal_flash_cache_erasing |= 1UL << (id & 31);
+#endif
+    }
+    hal_flash_cache_inval_dev(id, hf);
+    return rc;
+}
+
+int
+hal_flash_busy(uint8_t id)
+{
+    const struct hal_flash *hf;
+
+    int rc;
+
+    hf = bsp_flash_dev(id);
+    if (!hf || !hf->hf_itf->hff_busy) {
+        return 0;
+    }
+    rc = hf->hf_itf->hff_busy();
+#if HAL_FLASH_CACHE_LINES > 0
+    if (!rc && (hal_flash_cache_erasing & (1UL << (id & 31)))) {
+        /* Reads during the erase may have cached stale data. */
+        hal_flash_cache_erasing &= ~(1UL << (id & 31));
+        hal_flash_cache_inval_dev(id, hf);
+    }
+#endif
+    return rc;
+}
+
+#ifndef HAL_FLASH_BLANK_CHUNK
+#define HAL_FLASH_BLANK_CHUNK       32
+#endif
+
+static int
+hal_flash_buf_is_erased(const uint8_t *buf, uint32_t num_bytes)
+{
+    uint32_t i;
+
+    for (i = 0; i < num_bytes; i++) {
+        if (buf[i] != 0xff) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int
+hal_flash_is_erased(uint8_t id, uint32_t address, uint32_t num_bytes)
+{
+    const struct hal_flash *hf;
+    const uint8_t *mapped;
+    uint8_t buf[HAL_FLASH_BLANK_CHUNK];
+    uint32_t cnt;
+
+    hf = bsp_flash_dev(id);
+    if (!hf) {
+        return -1;
+    }
+    if (hal_flash_check_addr(hf, address) ||
+      hal_flash_check_addr(hf, address + num_bytes)) {
+        return -1;
+    }
+
+    if (hf->hf_itf->hff_mmap) {
+        mapped = hf->hf_itf->hff_mmap(address, num_bytes);
+        if (mapped) {
+            return hal_flash_buf_is_erased(mapped, num_bytes);
+        }
+    }
+
+    while (num_bytes) {
+        cnt = num_bytes;
+        if (cnt > sizeof(buf)) {
+            cnt = sizeof(buf);
+        }
+        if (hf->hf_itf->hff_read(address, buf, cnt)) {
+            return -1;
+        }
+        if (!hal_flash_buf_is_erased(buf, cnt)) {
+            return 0;
+        }
+        address += cnt;
+        num_bytes -= cnt;
+    }
+    return 1;
 }
 
 int
 hal_flash_erase(uint8_t id, uint32_t address, uint32_t num_bytes)
+{
+    return hal_flash_erase_wait(id, address, num_bytes, NULL, NULL);
+}
+
+int
+hal_flash_erase_wait(uint8_t id, uint32_t address, uint32_t num_bytes,
+  hal_flash_wait_fn *wait_fn, void *wait_arg)
 {
     const struct hal_flash *hf;
     uint32_t start, size;
@@ -160,8 +493,23 @@ hal_flash_erase(uint8_t id, uint32_t address, uint32_t num_bytes)
              * If some region of eraseable area falls inside sector,
              * erase the sector.
              */
-            if (hf->hf_itf->hff_erase_sector(start)) {
-                return -1;
+            if (!hf->hf_itf->hff_erase_sector_start || !wait_fn) {
+                rc = hf->hf_itf->hff_erase_sector(start);
+                hal_flash_cache_inval(id, start, size);
+                if (rc) {
+                    return -1;
+                }
+            } else {
+                rc = hf->hf_itf->hff_erase_sector_start(start);
+                if (rc == 0) {
+                    while (hf->hf_itf->hff_busy()) {
+                        wait_fn(wait_arg);
+                    }
+                }
+                hal_flash_cache_inval(id, start, size);
+                if (rc) {
+                    return -1;
+                }
             }
         }
     }
@@ -16,6 +16,8 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <stddef.h>
+#include <os/os.h>
 #include <bsp/bsp_sysid.h>
 #include <hal/hal_i2c.h>
 #include <hal/hal_i2c_int.h>
@@ -75,3 +77,116 @@ hal_i2c_master_end(struct hal_i2c *pi2c)
     }
     return -1;
 }
+
+/*
+ * Runs transaction using blocking driver API.
+ */
+static int
+hal_i2c_txn_sync(struct hal_i2c *pi2c, struct hal_i2c_txn *txn)
+{
+    struct hal_i2c_master_data pkt;
+    int rc;
+    int rc2;
+
+    rc = hal_i2c_master_begin(pi2c);
+    if (rc) {
+        return rc;
+    }
+    pkt.address = txn->address;
+    if (txn->wlen) {
+        pkt.len = txn->wlen;
+        pkt.buffer = txn->wbuf;
+        rc = hal_i2c_master_write(pi2c, &pkt);
+    }
+    if (rc == 0 && txn->rlen) {
+        pkt.len = txn->rlen;
+        pkt.buffer = txn->rbuf;
+        rc = hal_i2c_master_read(pi2c, &pkt);
+    }
+    rc2 = hal_i2c_master_end(pi2c);
+    return rc ? rc : rc2;
+}
+
+/*
+ * Removes finished transaction from the head of the queue and reports it.
+ */
+static void
+hal_i2c_txn_complete(struct hal_i2c *pi2c, struct hal_i2c_txn *txn,
+                     int status)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    STAILQ_REMOVE_HEAD(&pi2c->txn_q, next);
+    pi2c->txn_busy = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    txn->status = status;
+    if (txn->cb) {
+        txn->cb(txn, txn->cb_arg);
+    }
+    if (txn->evq) {
+        os_eventq_put(txn->evq, &txn->ev);
+    }
+}
+
+/*
+ * Starts transactions from the head of the queue, unless one is already in
+ * progress. Loops for as long as they complete synchronously.
+ */
+static void
+hal_i2c_txn_run(struct hal_i2c *pi2c)
+{
+    const struct hal_i2c_funcs *api = pi2c->driver_api;
+    struct hal_i2c_txn *txn;
+    os_sr_t sr;
+    int rc;
+
+    while (1) {
+        OS_ENTER_CRITICAL(sr);
+        txn = STAILQ_FIRST(&pi2c->txn_q);
+        if (!txn || pi2c->txn_busy) {
+            OS_EXIT_CRITICAL(sr);
+            return;
+        }
+        pi2c->txn_busy = 1;
+        OS_EXIT_CRITICAL(sr);
+
+        if (api->hi2cm_txn_start) {
+            rc = api->hi2cm_txn_start(pi2c, txn);
+            if (rc == 0) {
+                return;
+            }
+        } else {
+            rc = hal_i2c_txn_sync(pi2c, txn);
+        }
+        hal_i2c_txn_complete(pi2c, txn, rc);
+    }
+}
+
+int
+hal_i2c_master_txn(struct hal_i2c *pi2c, struct hal_i2c_txn *txn)
+{
+    os_sr_t sr;
+
+    if (!pi2c || !pi2c->driver_api || !txn) {
+        return -1;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    if (pi2c->txn_q.stqh_last == NULL) {
+        STAILQ_INIT(&pi2c->txn_q);
+    }
+    STAILQ_INSERT_TAIL(&pi2c->txn_q, txn, next);
+    OS_EXIT_CRITICAL(sr);
+
+    hal_i2c_txn_run(pi2c);
+    return 0;
+}
+
+void
+hal_i2c_txn_done(struct hal_i2c *pi2c, struct hal_i2c_txn *txn, int status)
+{
+    hal_i2c_txn_complete(pi2c, txn, status);
+    hal_i2c_txn_run(pi2c);
+}
@@ -16,7 +16,9 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <stddef.h>
 #include <bsp/bsp_sysid.h>
+#include <os/os.h>
 #include <hal/hal_pwm.h>
 #include <hal/hal_pwm_int.h>
 
@@ -72,3 +74,52 @@ hal_pwm_get_resolution_bits(struct hal_pwm *ppwm) {
     }
     return -1;        
 }
+
+int
+hal_pwm_stream_setup(struct hal_pwm *ppwm, struct hal_pwm_stream *st)
+{
+    if (!st || !st->rate) {
+        return -1;
+    }
+    if (ppwm && ppwm->driver_api && ppwm->driver_api->hpwm_stream_setup) {
+        return ppwm->driver_api->hpwm_stream_setup(ppwm, st);
+    }
+    return -1;
+}
+
+int
+hal_pwm_stream_start(struct hal_pwm *ppwm, struct hal_pwm_stream *st)
+{
+    if (!st || !st->rate || !st->buf_cnt || !st->bufs[0] || !st->bufs[1]) {
+        return -1;
+    }
+    if (ppwm && ppwm->driver_api && ppwm->driver_api->hpwm_stream_start) {
+        st->underruns = 0;
+        return ppwm->driver_api->hpwm_stream_start(ppwm, st);
+    }
+    return -1;
+}
+
+int
+hal_pwm_stream_stop(struct hal_pwm *ppwm)
+{
+    if (ppwm && ppwm->driver_api && ppwm->driver_api->hpwm_stream_stop) {
+        return ppwm->driver_api->hpwm_stream_stop(ppwm);
+    }
+    return -1;
+}
+
+void
+hal_pwm_stream_done(struct hal_pwm_stream *st, uint16_t *buf)
+{
+    if (st->cb) {
+        st->cb(st, buf);
+    }
+    if (st->evq) {
+        if (OS_EVENT_QUEUED(&st->ev)) {
+            st->underruns++;
+        }
+        st->ev.ev_arg = buf;
+        os_eventq_put(st->evq, &st->ev);
+    }
+}
@@ -42,3 +42,67 @@ hal_spi_master_transfer(struct hal_spi *pspi, uint16_t val)
     }
     return -1;
 }
+
+int
+hal_spi_txrx(struct hal_spi *pspi, void *txbuf, void *rxbuf, int len)
+{
+    uint8_t *tx;
+    uint8_t *rx;
+    int rc;
+    int i;
+
+    if (!pspi || !pspi->driver_api || len < 0) {
+        return -1;
+    }
+    if (pspi->driver_api->hspi_txrx) {
+        return pspi->driver_api->hspi_txrx(pspi, txbuf, rxbuf, len);
+    }
+    if (!pspi->driver_api->hspi_master_transfer) {
+        return -1;
+    }
+
+    tx = txbuf;
+    rx = rxbuf;
+    for (i = 0; i < len; i++) {
+        rc = pspi->driver_api->hspi_master_transfer(pspi, tx ? tx[i] : 0xff);
+        if (rc < 0) {
+            return rc;
+        }
+        if (rx) {
+            rx[i] = rc;
+        }
+    }
+    return 0;
+}
+
+int
+hal_spi_txrx_nonblock(struct hal_spi *pspi, void *txbuf, void *rxbuf,
+                      int len, hal_spi_txrx_cb cb, void *arg)
+{
+    int rc;
+
+    if (!pspi || !pspi->driver_api || len < 0) {
+        return -1;
+    }
+    if (pspi->driver_api->hspi_txrx_nonblock) {
+        return pspi->driver_api->hspi_txrx_nonblock(pspi, txbuf, rxbuf, len,
+                                                     cb, arg);
+    }
+    rc = hal_spi_txrx(pspi, txbuf, rxbuf, len);
+    if (rc == 0 && cb) {
+        cb(arg, len);
+    }
+    return rc;
+}
+
+int
+hal_spi_slave_txrx(struct hal_spi *pspi, void *txbuf, int txlen,
+                   void *rxbuf, int rxlen, hal_spi_txrx_cb cb, void *arg)
+{
+    if (!pspi || !pspi->driver_api || !pspi->driver_api->hspi_slave_txrx ||
+      txlen < 0 || rxlen < 0) {
+        return -1;
+    }
+    return pspi->driver_api->hspi_slave_txrx(pspi, txbuf, txlen, rxbuf, rxlen,
+                                             cb, arg);
+}
@@ -155,6 +155,8 @@ TEST_SUITE(flash_map_test_suite)
 
 #ifdef MYNEWT_SELFTEST
 
+int hal_i2c_test_suite(void);
+
 int
 main(int argc, char **argv)
 {
@@ -162,6 +164,7 @@ main(int argc, char **argv)
     tu_init();
 
     flash_map_test_suite();
+    hal_i2c_test_suite();
 
     return tu_any_failed;
 }
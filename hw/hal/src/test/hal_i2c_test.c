@@ -0,0 +1,198 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <os/os.h>
+#include <testutil/testutil.h>
+#include "hal/hal_i2c.h"
+#include "hal/hal_i2c_int.h"
+
+/*
+ * Fake bus; records the driver calls made.
+ */
+static char i2c_test_log[64];
+static int i2c_test_log_off;
+static struct hal_i2c_txn *i2c_test_started;
+static int i2c_test_done_cnt;
+static int i2c_test_done_order[4];
+
+static void
+i2c_test_log_op(char op)
+{
+    if (i2c_test_log_off < (int)sizeof(i2c_test_log) - 1) {
+        i2c_test_log[i2c_test_log_off++] = op;
+    }
+}
+
+static int
+i2c_test_write(struct hal_i2c *pi2c, struct hal_i2c_master_data *ppkt)
+{
+    i2c_test_log_op('w');
+    return ppkt->address == 0x7f ? -1 : 0;
+}
+
+static int
+i2c_test_read(struct hal_i2c *pi2c, struct hal_i2c_master_data *ppkt)
+{
+    i2c_test_log_op('r');
+    memset(ppkt->buffer, ppkt->address, ppkt->len);
+    return 0;
+}
+
+static int
+i2c_test_start(struct hal_i2c *pi2c)
+{
+    i2c_test_log_op('(');
+    return 0;
+}
+
+static int
+i2c_test_stop(struct hal_i2c *pi2c)
+{
+    i2c_test_log_op(')');
+    return 0;
+}
+
+static int
+i2c_test_txn_start(struct hal_i2c *pi2c, struct hal_i2c_txn *txn)
+{
+    TEST_ASSERT(i2c_test_started == NULL);
+    i2c_test_started = txn;
+    return 0;
+}
+
+static const struct hal_i2c_funcs i2c_test_sync_funcs = {
+    .hi2cm_write_data = i2c_test_write,
+    .hi2cm_read_data = i2c_test_read,
+    .hi2cm_start = i2c_test_start,
+    .hi2cm_stop = i2c_test_stop,
+};
+
+static const struct hal_i2c_funcs i2c_test_async_funcs = {
+    .hi2cm_txn_start = i2c_test_txn_start,
+};
+
+static void
+i2c_test_done(struct hal_i2c_txn *txn, void *arg)
+{
+    i2c_test_done_order[i2c_test_done_cnt++] = (int)(intptr_t)arg;
+}
+
+static void
+i2c_test_reset(void)
+{
+    memset(i2c_test_log, 0, sizeof(i2c_test_log));
+    i2c_test_log_off = 0;
+    i2c_test_started = NULL;
+    i2c_test_done_cnt = 0;
+}
+
+static void
+i2c_test_txn_init(struct hal_i2c_txn *txn, uint8_t addr, uint8_t *wbuf,
+                  int wlen, uint8_t *rbuf, int rlen, int id)
+{
+    memset(txn, 0, sizeof(*txn));
+    txn->address = addr;
+    txn->wbuf = wbuf;
+    txn->wlen = wlen;
+    txn->rbuf = rbuf;
+    txn->rlen = rlen;
+    txn->status = 1;
+    txn->cb = i2c_test_done;
+    txn->cb_arg = (void *)(intptr_t)id;
+}
+
+/*
+ * Driver without transaction support; run with blocking calls.
+ */
+TEST_CASE(hal_i2c_test_txn_sync)
+{
+    struct hal_i2c bus = { .driver_api = &i2c_test_sync_funcs };
+    struct hal_i2c_txn txn[3];
+    uint8_t reg = 0x10;
+    uint8_t data[4];
+    int rc;
+
+    i2c_test_reset();
+
+    i2c_test_txn_init(&txn[0], 0x40, &reg, 1, data, sizeof(data), 0);
+    i2c_test_txn_init(&txn[1], 0x41, &reg, 1, NULL, 0, 1);
+    i2c_test_txn_init(&txn[2], 0x7f, &reg, 1, data, sizeof(data), 2);
+
+    rc = hal_i2c_master_txn(&bus, &txn[0]);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(txn[0].status == 0);
+    TEST_ASSERT(data[0] == 0x40 && data[3] == 0x40);
+
+    rc = hal_i2c_master_txn(&bus, &txn[1]);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(txn[1].status == 0);
+
+    /* Write fails; no read, but stop still sent */
+    rc = hal_i2c_master_txn(&bus, &txn[2]);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(txn[2].status == -1);
+
+    TEST_ASSERT(strcmp(i2c_test_log, "(wr)(w)(w)") == 0,
+                "log %s", i2c_test_log);
+    TEST_ASSERT(i2c_test_done_cnt == 3);
+    TEST_ASSERT(STAILQ_EMPTY(&bus.txn_q));
+}
+
+/*
+ * Driver running transactions from interrupts; queued ones must start one
+ * at a time, in order.
+ */
+TEST_CASE(hal_i2c_test_txn_queue)
+{
+    struct hal_i2c bus = { .driver_api = &i2c_test_async_funcs };
+    struct hal_i2c_txn txn[3];
+    struct hal_i2c_txn *cur;
+    int i;
+
+    i2c_test_reset();
+
+    for (i = 0; i < 3; i++) {
+        i2c_test_txn_init(&txn[i], 0x40 + i, NULL, 0, NULL, 0, i);
+        TEST_ASSERT(hal_i2c_master_txn(&bus, &txn[i]) == 0);
+    }
+    TEST_ASSERT(i2c_test_started == &txn[0]);
+    TEST_ASSERT(i2c_test_done_cnt == 0);
+
+    for (i = 0; i < 3; i++) {
+        cur = i2c_test_started;
+        TEST_ASSERT_FATAL(cur == &txn[i]);
+        i2c_test_started = NULL;
+        hal_i2c_txn_done(&bus, cur, -i);
+        TEST_ASSERT(txn[i].status == -i);
+    }
+    TEST_ASSERT(i2c_test_started == NULL);
+    TEST_ASSERT(i2c_test_done_cnt == 3);
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT(i2c_test_done_order[i] == i);
+    }
+    TEST_ASSERT(STAILQ_EMPTY(&bus.txn_q));
+}
+
+TEST_SUITE(hal_i2c_test_suite)
+{
+    hal_i2c_test_txn_sync();
+    hal_i2c_test_txn_queue();
+}
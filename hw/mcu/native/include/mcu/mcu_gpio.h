@@ -17,44 +17,28 @@
  * under the License.
  */
 
-#include <stdint.h>
-#include <assert.h>
-#include <string.h>
-#include "os/os.h"
-#include "nimble/ble.h"
-#include "controller/ble_hw.h"
-#include "controller/ble_ll.h"
+#ifndef H_MCU_GPIO_
+#define H_MCU_GPIO_
 
-/* This is a simple circular buffer for holding N samples of random data */
-struct ble_ll_rnum_data
-{
-    uint8_t rnd_in;
-    uint8_t rnd_out;
-    uint8_t rnd_size;
-    uint8_t _pad;
-};
+#include "hal/hal_gpio.h"
 
-#if (BLE_LL_CFG_FEAT_LE_ENCRYPTION == 1)
-int
-ble_ll_rng_init(void)
-{
-    return 0;
-}
-
-/* Get 'len' bytes of random data */
-int
-ble_ll_rand_data_get(uint8_t *buf, uint8_t len)
-{
-    os_sr_t sr;
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-    while (len != 0) {
-        OS_ENTER_CRITICAL(sr);
+/*
+ * Simulated pins are all on port 0. Nothing to gain from inlining here.
+ */
+#define HAL_GPIO_PORT(pin)              0
+#define HAL_GPIO_PORT_BIT(pin)          (pin)
 
-        OS_EXIT_CRITICAL(sr);
-        --len;
-    }
+#define hal_gpio_fast_set(pin)          hal_gpio_set(pin)
+#define hal_gpio_fast_clear(pin)        hal_gpio_clear(pin)
+#define hal_gpio_fast_write(pin, val)   hal_gpio_write(pin, val)
+#define hal_gpio_fast_read(pin)         hal_gpio_read(pin)
 
-    return 0;
+#ifdef __cplusplus
 }
 #endif
 
+#endif /* H_MCU_GPIO_ */
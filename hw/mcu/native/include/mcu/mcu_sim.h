@@ -19,11 +19,32 @@
 #ifndef __MCU_SIM_H__
 #define __MCU_SIM_H__
 
+#include <inttypes.h>
+
 #define OS_TICKS_PER_SEC    (1000)
 
 extern char *native_flash_file;
 extern char *native_uart_log_file;
 
+/*
+ * Flash simulation. Erase latency is per sector, write latency per 32-bit
+ * word. native_flash_power_fail_at() makes write/erase operation number
+ * 'op' (counting from this call, 1 based) stop half way, as if power was
+ * lost. cb is then called, e.g. to longjmp back to the test; if cb is
+ * NULL, the process exits. Flash operations fail after that until
+ * native_flash_power_on() is called. native_flash_mmap_enable(0) makes
+ * hal_flash_mmap() fail, as it would on flash which is not memory mapped.
+ */
+extern uint32_t native_flash_erase_usecs;
+extern uint32_t native_flash_write_usecs;
+extern uint32_t native_flash_fail_op;
+
+void native_flash_latency(uint32_t erase_usecs, uint32_t write_usecs);
+void native_flash_power_fail_at(uint32_t op, void (*cb)(void));
+void native_flash_power_on(void);
+uint32_t native_flash_op_cnt(void);
+void native_flash_mmap_enable(int enable);
+
 void mcu_sim_parse_args(int argc, char **argv);
 
 #endif /* __MCU_SIM_H__ */
@@ -0,0 +1,85 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef H_NATIVE_AIR_
+#define H_NATIVE_AIR_
+
+#include <inttypes.h>
+#include "os/queue.h"
+
+/*
+ * Virtual air for simulated radios.
+ *
+ * A number of native processes (nodes) share a virtual air and a virtual
+ * clock. Node 0 coordinates: whenever every node is idle it advances the
+ * clock to the earliest wakeup of any node (or the earliest frame delivery)
+ * and hands out the frames that start at that time, applying the configured
+ * loss and latency. No node ever waits for real time, so simulations run as
+ * fast as the nodes can process their events.
+ *
+ * Enabled with the -a option of mcu_sim_parse_args(); see its usage text.
+ */
+
+/* Maximum frame size: PDU header plus maximum payload */
+#define NATIVE_AIR_MAX_PDU      (2 + 255)
+
+struct native_air_frame
+{
+    uint64_t naf_start;         /* Virtual time of first bit (usecs) */
+    uint32_t naf_aa;            /* Access address */
+    uint16_t naf_len;           /* Length of naf_pdu */
+    uint8_t naf_chan;           /* Channel index */
+    uint8_t naf_sender;         /* Node that transmitted the frame */
+    uint8_t naf_pdu[NATIVE_AIR_MAX_PDU];
+};
+
+/* Called, with interrupts disabled, when a frame starts on the air. */
+typedef void (*native_air_rx_func)(struct native_air_frame *frame);
+
+/* Virtual time timer. Callback is called with interrupts disabled. */
+struct native_air_timer
+{
+    uint64_t nat_when;
+    void (*nat_cb)(void *arg);
+    void *nat_arg;
+    uint8_t nat_armed;
+    TAILQ_ENTRY(native_air_timer) nat_next;
+};
+
+/* Configuration, set from command line */
+extern char *native_air_dir;
+extern int native_air_node;
+extern int native_air_nodes;
+extern int native_air_loss_pct;
+extern uint32_t native_air_latency_usecs;
+
+int native_air_init(void);
+int native_air_enabled(void);
+uint64_t native_air_time(void);
+void native_air_set_rx_cb(native_air_rx_func rx_cb);
+int native_air_tx(struct native_air_frame *frame);
+void native_air_timer_init(struct native_air_timer *timer,
+                           void (*cb)(void *arg), void *arg);
+void native_air_timer_start(struct native_air_timer *timer, uint64_t when);
+void native_air_timer_stop(struct native_air_timer *timer);
+
+/* Implemented by native cputime */
+void native_cputime_air_enable(void);
+uint64_t native_cputime_to_air_time(uint32_t cputime);
+
+#endif /* H_NATIVE_AIR_ */
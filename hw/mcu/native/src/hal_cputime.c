@@ -20,6 +20,7 @@
 #include <assert.h>
 #include "os/os.h"
 #include "hal/hal_cputime.h"
+#include "mcu/native_air.h"
 
 /* For native cpu implementation */
 #define NATIVE_CPUTIME_STACK_SIZE   (1024)
@@ -32,9 +33,17 @@ static uint32_t g_native_cputime_cputicks_per_ostick;
 static uint64_t g_native_cputime;
 static uint32_t g_native_cputime_last_ostime;
 
+/* Timer used instead of the os callout when running on virtual air */
+static int g_native_cputime_air;
+static struct native_air_timer g_native_cputime_air_timer;
+
 void
 cputime_disable_ocmp(void)
 {
+    if (g_native_cputime_air) {
+        native_air_timer_stop(&g_native_cputime_air_timer);
+        return;
+    }
     os_callout_stop(&g_native_cputimer.cf_c);
 }
 
@@ -68,6 +77,12 @@ cputime_set_ocmp(struct cpu_timer *timer)
     uint32_t curtime;
     uint32_t osticks;
 
+    if (g_native_cputime_air) {
+        native_air_timer_start(&g_native_cputime_air_timer,
+                               native_cputime_to_air_time(timer->cputime));
+        return;
+    }
+
     curtime = cputime_get32();
     if ((int32_t)(timer->cputime - curtime) < 0) {
         osticks = 0;
@@ -79,6 +94,31 @@ cputime_set_ocmp(struct cpu_timer *timer)
     os_callout_reset(&g_native_cputimer.cf_c, osticks);
 }
 
+/**
+ * cputime hw num ocmp
+ *
+ * All timers share the one callout; there are no dedicated channels.
+ *
+ * @return int The number of output compare channels.
+ */
+int
+cputime_hw_num_ocmp(void)
+{
+    return 1;
+}
+
+void
+cputime_hw_set_ocmp(int ocmp, uint32_t cputime)
+{
+    assert(0);
+}
+
+void
+cputime_hw_disable_ocmp(int ocmp)
+{
+    assert(0);
+}
+
 /**
  * This is the function called when the cputimer fires off.
  *
@@ -194,6 +234,11 @@ cputime_get32(void)
     uint32_t ostime;
     uint32_t delta_osticks;
 
+    if (g_native_cputime_air) {
+        g_native_cputime = native_air_time() * g_cputime.ticks_per_usec;
+        return (uint32_t)g_native_cputime;
+    }
+
     OS_ENTER_CRITICAL(sr);
     ostime = os_time_get();
     delta_osticks = (uint32_t)(ostime - g_native_cputime_last_ostime);
@@ -207,3 +252,38 @@ cputime_get32(void)
 
     return (uint32_t)g_native_cputime;
 }
+
+/**
+ * Runs cputime off the virtual air clock. Timers then expire exactly at
+ * their virtual time instead of at os tick granularity. Called before
+ * cputime is initialized.
+ */
+void
+native_cputime_air_enable(void)
+{
+    native_air_timer_init(&g_native_cputime_air_timer, native_cputimer_cb,
+                          NULL);
+    g_native_cputime_air = 1;
+}
+
+/**
+ * Converts a cputime into virtual air time. Times in the past map to now.
+ *
+ * @param cputime
+ *
+ * @return uint64_t Virtual time (usecs)
+ */
+uint64_t
+native_cputime_to_air_time(uint32_t cputime)
+{
+    int32_t delta;
+    uint64_t now;
+
+    now = native_air_time();
+    delta = (int32_t)(cputime - cputime_get32());
+    if (delta <= 0) {
+        return now;
+    }
+    return now + (delta + g_cputime.ticks_per_usec - 1) /
+                 g_cputime.ticks_per_usec;
+}
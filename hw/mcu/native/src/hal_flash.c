@@ -19,10 +19,14 @@
 
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <assert.h>
 #include <string.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
 #include "hal/hal_flash_int.h"
 #include "mcu/mcu_sim.h"
 
@@ -30,8 +34,30 @@ char *native_flash_file;
 static int file;
 static void *file_loc;
 
+/*
+ * Latencies of flash operations; erase is per sector, write per 32-bit
+ * word. Zero means operations complete immediately.
+ */
+uint32_t native_flash_erase_usecs;
+uint32_t native_flash_write_usecs;
+
+/*
+ * Power loss injection. Write and erase operations are counted, and
+ * the one numbered native_flash_fail_op (1 based) is interrupted half way.
+ * Without a callback the process exits there, leaving the flash file as it
+ * would be after a power cut. With a callback, the callback gets called,
+ * and all flash operations fail until native_flash_power_on().
+ */
+uint32_t native_flash_fail_op;
+static uint32_t native_flash_ops;
+static void (*native_flash_fail_cb)(void);
+static int native_flash_powered_off;
+
+static int native_flash_mmap_off;
+
 static int native_flash_init(void);
 static int native_flash_read(uint32_t address, void *dst, uint32_t length);
+static const void *native_flash_mmap(uint32_t address, uint32_t num_bytes);
 static int native_flash_write(uint32_t address, const void *src,
   uint32_t length);
 static int native_flash_erase_sector(uint32_t sector_address);
@@ -39,6 +65,7 @@ static int native_flash_sector_info(int idx, uint32_t *address, uint32_t *size);
 
 static const struct hal_flash_funcs native_flash_funcs = {
     .hff_read = native_flash_read,
+    .hff_mmap = native_flash_mmap,
     .hff_write = native_flash_write,
     .hff_erase_sector = native_flash_erase_sector,
     .hff_sector_info = native_flash_sector_info,
@@ -77,9 +104,95 @@ flash_native_erase(uint32_t addr, uint32_t len)
     memset(file_loc + addr, 0xff, len);
 }
 
+static void
+flash_native_delay(uint64_t usecs)
+{
+    struct timespec ts;
+
+    if (usecs == 0) {
+        return;
+    }
+    ts.tv_sec = usecs / 1000000;
+    ts.tv_nsec = (usecs % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+}
+
+/*
+ * Counts a write/erase operation. Returns 1 if power is lost during this
+ * operation; caller then does only the first half of it, and calls
+ * flash_native_power_fail().
+ */
+static int
+flash_native_op_start(void)
+{
+    native_flash_ops++;
+    return native_flash_fail_op && native_flash_ops == native_flash_fail_op;
+}
+
+static int
+flash_native_power_fail(void)
+{
+    native_flash_powered_off = 1;
+    if (!native_flash_fail_cb) {
+        _exit(1);
+    }
+    native_flash_fail_cb();
+    return -1;
+}
+
+void
+native_flash_latency(uint32_t erase_usecs, uint32_t write_usecs)
+{
+    native_flash_erase_usecs = erase_usecs;
+    native_flash_write_usecs = write_usecs;
+}
+
+void
+native_flash_power_fail_at(uint32_t op, void (*cb)(void))
+{
+    native_flash_ops = 0;
+    native_flash_fail_op = op;
+    native_flash_fail_cb = cb;
+}
+
+void
+native_flash_power_on(void)
+{
+    native_flash_powered_off = 0;
+    native_flash_fail_op = 0;
+}
+
+uint32_t
+native_flash_op_cnt(void)
+{
+    return native_flash_ops;
+}
+
+void
+native_flash_mmap_enable(int enable)
+{
+    native_flash_mmap_off = !enable;
+}
+
+/*
+ * A forked process (e.g. a test suite run in parallel with others) gets a
+ * private copy of flash, so that it does not see writes made by others.
+ */
+static void
+flash_native_atfork_child(void)
+{
+    void *loc;
+
+    loc = mmap(file_loc, native_flash_dev.hf_size, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_FIXED, file, 0);
+    assert(loc == file_loc);
+}
+
 static void
 flash_native_file_open(char *name)
 {
+    static int atfork_registered;
     int created = 0;
     extern char *tmpnam(char *s);
     extern int ftruncate(int fd, off_t length);
@@ -99,6 +212,10 @@ flash_native_file_open(char *name)
     file_loc = mmap(0, native_flash_dev.hf_size,
           PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
     assert(file_loc != MAP_FAILED);
+    if (!atfork_registered) {
+        pthread_atfork(NULL, NULL, flash_native_atfork_child);
+        atfork_registered = 1;
+    }
     if (created) {
         flash_native_erase(0, native_flash_dev.hf_size);
     }
@@ -116,42 +233,37 @@ static int
 flash_native_write_internal(uint32_t address, const void *src, uint32_t length,
                             int allow_overwrite)
 {
-    static uint8_t buf[256];
-    uint32_t cur;
-    uint32_t end;
-    int chunk_sz;
-    int rc;
-    int i;
+    const uint8_t *loc;
+    int fail;
+    uint32_t i;
 
+    if (native_flash_powered_off) {
+        return -1;
+    }
     if (length == 0) {
         return 0;
     }
 
-    end = address + length;
-
     flash_native_ensure_file_open();
 
-    cur = address;
-    while (cur < end) {
-        if (end - cur < sizeof buf) {
-            chunk_sz = end - cur;
-        } else {
-            chunk_sz = sizeof buf;
+    /* Ensure data is not being overwritten. */
+    if (!allow_overwrite) {
+        loc = (uint8_t *)file_loc + address;
+        for (i = 0; i < length; i++) {
+            assert(loc[i] == 0xff);
         }
-
-        /* Ensure data is not being overwritten. */
-        if (!allow_overwrite) {
-            rc = native_flash_read(cur, buf, chunk_sz);
-            assert(rc == 0);
-            for (i = 0; i < chunk_sz; i++) {
-                assert(buf[i] == 0xff);
-            }
-        }
-
-        cur += chunk_sz;
     }
 
+    fail = flash_native_op_start();
+    if (fail) {
+        length /= 2;
+    }
+    flash_native_delay((uint64_t)native_flash_write_usecs *
+                       ((length + 3) / 4));
     memcpy((char *)file_loc + address, src, length);
+    if (fail) {
+        return flash_native_power_fail();
+    }
 
     return 0;
 }
@@ -173,12 +285,25 @@ flash_native_memset(uint32_t offset, uint8_t c, uint32_t len)
 static int
 native_flash_read(uint32_t address, void *dst, uint32_t length)
 {
+    if (native_flash_powered_off) {
+        return -1;
+    }
     flash_native_ensure_file_open();
     memcpy(dst, (char *)file_loc + address, length);
 
     return 0;
 }
 
+static const void *
+native_flash_mmap(uint32_t address, uint32_t num_bytes)
+{
+    if (native_flash_powered_off || native_flash_mmap_off) {
+        return NULL;
+    }
+    flash_native_ensure_file_open();
+    return (char *)file_loc + address;
+}
+
 static int
 find_area(uint32_t address)
 {
@@ -211,7 +336,11 @@ native_flash_erase_sector(uint32_t sector_address)
 {
     int area_id;
     uint32_t len;
+    int fail;
 
+    if (native_flash_powered_off) {
+        return -1;
+    }
     flash_native_ensure_file_open();
 
     area_id = find_area(sector_address);
@@ -219,7 +348,15 @@ native_flash_erase_sector(uint32_t sector_address)
         return -1;
     }
     len = flash_sector_len(area_id);
+    fail = flash_native_op_start();
+    if (fail) {
+        len /= 2;
+    }
+    flash_native_delay(native_flash_erase_usecs);
     flash_native_erase(sector_address, len);
+    if (fail) {
+        return flash_native_power_fail();
+    }
     return 0;
 }
 
@@ -101,3 +101,35 @@ hal_gpio_toggle(int pin)
     hal_gpio_write(pin, pin_state);
     return pin_state;
 }
+
+uint32_t
+hal_gpio_port_read(int port)
+{
+    uint32_t val;
+    int i;
+
+    val = 0;
+    if (port == 0) {
+        for (i = 0; i < HAL_GPIO_NUM_PINS; i++) {
+            if (hal_gpio[i].val) {
+                val |= 1 << i;
+            }
+        }
+    }
+    return val;
+}
+
+void
+hal_gpio_port_write(int port, uint32_t mask, uint32_t val)
+{
+    int i;
+
+    if (port != 0) {
+        return;
+    }
+    for (i = 0; i < HAL_GPIO_NUM_PINS; i++) {
+        if (mask & (1 << i)) {
+            hal_gpio_write(i, (val >> i) & 1);
+        }
+    }
+}
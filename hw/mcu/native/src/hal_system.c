@@ -23,6 +23,7 @@
 
 #include "hal/hal_system.h"
 #include "mcu/mcu_sim.h"
+#include "mcu/native_air.h"
 
 void
 system_reset(void)
@@ -39,10 +40,22 @@ static void
 usage(char *progname, int rc)
 {
     const char msg[] =
-      "Usage: %s [-f flash_file] [-u uart_log_file]\n"
+      "Usage: %s [-f flash_file [-E usecs] [-W usecs] [-P op]]\n"
+      "       [-u uart_log_file]\n"
+      "       [-a air_dir -n node -N nodes [-l loss_pct] [-d latency_usecs]]\n"
       "     -f flash_file tells where binary flash file is located. It gets\n"
       "        created if it doesn't already exist.\n"
-      "     -u uart_log_file puts all UART data exchanges into a logfile.\n";
+      "     -E usecs latency of flash sector erase.\n"
+      "     -W usecs latency of flash write, per 32-bit word.\n"
+      "     -P op cuts power half way through flash write/erase number op;\n"
+      "        program exits, leaving flash_file as it was at that time.\n"
+      "     -u uart_log_file puts all UART data exchanges into a logfile.\n"
+      "     -a air_dir joins the virtual air with sockets in air_dir. Time\n"
+      "        becomes virtual and runs as fast as all nodes allow.\n"
+      "     -n node number of this node on the air (0 coordinates).\n"
+      "     -N nodes total number of nodes on the air.\n"
+      "     -l loss_pct percentage of frames lost per receiver.\n"
+      "     -d latency_usecs delay of frames on the air.\n";
 
     write(2, msg, strlen(msg));
     exit(rc);
@@ -54,14 +67,38 @@ mcu_sim_parse_args(int argc, char **argv)
     int ch;
     char *progname = argv[0];
 
-    while ((ch = getopt(argc, argv, "hf:u:")) != -1) {
+    while ((ch = getopt(argc, argv, "hf:u:a:n:N:l:d:E:W:P:")) != -1) {
         switch (ch) {
+        case 'a':
+            native_air_dir = optarg;
+            break;
+        case 'n':
+            native_air_node = atoi(optarg);
+            break;
+        case 'N':
+            native_air_nodes = atoi(optarg);
+            break;
+        case 'l':
+            native_air_loss_pct = atoi(optarg);
+            break;
+        case 'd':
+            native_air_latency_usecs = strtoul(optarg, NULL, 0);
+            break;
         case 'f':
             native_flash_file = optarg;
             break;
         case 'u':
             native_uart_log_file = optarg;
             break;
+        case 'E':
+            native_flash_erase_usecs = strtoul(optarg, NULL, 0);
+            break;
+        case 'W':
+            native_flash_write_usecs = strtoul(optarg, NULL, 0);
+            break;
+        case 'P':
+            native_flash_fail_op = strtoul(optarg, NULL, 0);
+            break;
         case 'h':
             usage(progname, 0);
             break;
@@ -70,4 +107,10 @@ mcu_sim_parse_args(int argc, char **argv)
             break;
         }
     }
+
+    if (native_air_dir && native_air_init()) {
+        fprintf(stderr, "%s: cannot join virtual air in %s\n", progname,
+                native_air_dir);
+        exit(1);
+    }
 }
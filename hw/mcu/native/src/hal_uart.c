@@ -346,6 +346,14 @@ hal_uart_init_cbs(int port, hal_uart_tx_char tx_func, hal_uart_tx_done tx_done,
     return 0;
 }
 
+int
+hal_uart_init_block_cbs(int port, hal_uart_tx_block tx_func,
+  hal_uart_tx_done tx_done, hal_uart_rx_block rx_func, void *arg)
+{
+    /* Block mode not supported; caller falls back to per-byte callbacks. */
+    return -1;
+}
+
 int
 hal_uart_config(int port, int32_t baudrate, uint8_t databits, uint8_t stopbits,
   enum hal_uart_parity parity, enum hal_uart_flow_ctl flow_ctl)
@@ -0,0 +1,462 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "os/os.h"
+#include "mcu/native_air.h"
+
+/* Maximum number of nodes sharing the air */
+#define NATIVE_AIR_MAX_NODES        (32)
+
+/* Maximum number of frames in flight (coordinator) or awaiting delivery */
+#define NATIVE_AIR_MAX_FRAMES       (32)
+
+/* Messages exchanged between nodes and the coordinator (node 0) */
+#define NATIVE_AIR_MSG_TX           (1)     /* node -> coord: frame sent */
+#define NATIVE_AIR_MSG_IDLE         (2)     /* node -> coord: idle until */
+#define NATIVE_AIR_MSG_RX           (3)     /* coord -> node: frame starts */
+#define NATIVE_AIR_MSG_RUN          (4)     /* coord -> node: time is now */
+
+struct native_air_msg
+{
+    uint8_t nam_type;
+    uint8_t nam_node;
+    uint64_t nam_time;
+    struct native_air_frame nam_frame;
+};
+
+/* Configuration */
+char *native_air_dir;
+int native_air_node;
+int native_air_nodes = 1;
+int native_air_loss_pct;
+uint32_t native_air_latency_usecs;
+
+static int g_native_air_sock = -1;
+static uint64_t g_native_air_time;
+static native_air_rx_func g_native_air_rx_cb;
+static TAILQ_HEAD(, native_air_timer) g_native_air_timers =
+    TAILQ_HEAD_INITIALIZER(g_native_air_timers);
+
+/* Frames to hand to the local radio once time has been advanced */
+static struct native_air_frame g_native_air_rxq[NATIVE_AIR_MAX_FRAMES];
+static int g_native_air_rxq_cnt;
+
+/* Coordinator state */
+static uint64_t g_native_air_wake[NATIVE_AIR_MAX_NODES];
+static struct native_air_frame g_native_air_txq[NATIVE_AIR_MAX_FRAMES];
+static int g_native_air_txq_cnt;
+static uint32_t g_native_air_seed = 1;
+
+static void
+native_air_addr(struct sockaddr_un *sun, int node)
+{
+    memset(sun, 0, sizeof(*sun));
+    sun->sun_family = AF_UNIX;
+    snprintf(sun->sun_path, sizeof(sun->sun_path), "%s/air%d",
+             native_air_dir, node);
+}
+
+static void
+native_air_send(int node, struct native_air_msg *msg)
+{
+    int rc;
+    struct sockaddr_un sun;
+
+    msg->nam_node = native_air_node;
+    native_air_addr(&sun, node);
+    while (1) {
+        rc = sendto(g_native_air_sock, msg, sizeof(*msg), 0,
+                    (struct sockaddr *)&sun, sizeof(sun));
+        if (rc == sizeof(*msg)) {
+            return;
+        }
+
+        /* Coordinator may not be up yet */
+        if (rc < 0 && (errno == ENOENT || errno == ECONNREFUSED ||
+                       errno == EINTR || errno == ENOBUFS)) {
+            usleep(1000);
+            continue;
+        }
+        fprintf(stderr, "native_air: sendto: %s\n", strerror(errno));
+        exit(1);
+    }
+}
+
+static void
+native_air_recv(struct native_air_msg *msg)
+{
+    int rc;
+
+    do {
+        rc = recv(g_native_air_sock, msg, sizeof(*msg), 0);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc != sizeof(*msg)) {
+        /* Other side is gone; nothing left to simulate */
+        exit(0);
+    }
+}
+
+static void
+native_air_rxq_add(struct native_air_frame *frame)
+{
+    if (g_native_air_rxq_cnt < NATIVE_AIR_MAX_FRAMES) {
+        g_native_air_rxq[g_native_air_rxq_cnt] = *frame;
+        ++g_native_air_rxq_cnt;
+    }
+}
+
+/* Deterministic pseudo-random numbers so runs are repeatable */
+static int
+native_air_lost(void)
+{
+    g_native_air_seed = g_native_air_seed * 1103515245 + 12345;
+    return (int)((g_native_air_seed >> 16) % 100) < native_air_loss_pct;
+}
+
+/**
+ * Coordinator: waits for all other nodes to go idle, advances time to the
+ * earliest wakeup or frame delivery and hands out the frames that start
+ * then.
+ *
+ * @param wake Time at which this node wants to wake up
+ *
+ * @return uint64_t The new virtual time
+ */
+static uint64_t
+native_air_coord_step(uint64_t wake)
+{
+    int i;
+    int node;
+    int pending;
+    uint64_t now;
+    struct native_air_msg msg;
+    struct native_air_frame *frame;
+
+    g_native_air_wake[0] = wake;
+    pending = native_air_nodes - 1;
+    while (pending) {
+        native_air_recv(&msg);
+        switch (msg.nam_type) {
+        case NATIVE_AIR_MSG_TX:
+            if (g_native_air_txq_cnt < NATIVE_AIR_MAX_FRAMES) {
+                g_native_air_txq[g_native_air_txq_cnt] = msg.nam_frame;
+                ++g_native_air_txq_cnt;
+            }
+            break;
+        case NATIVE_AIR_MSG_IDLE:
+            if (msg.nam_node < native_air_nodes) {
+                g_native_air_wake[msg.nam_node] = msg.nam_time;
+                --pending;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    now = g_native_air_wake[0];
+    for (i = 1; i < native_air_nodes; ++i) {
+        if (g_native_air_wake[i] < now) {
+            now = g_native_air_wake[i];
+        }
+    }
+    for (i = 0; i < g_native_air_txq_cnt; ++i) {
+        if (g_native_air_txq[i].naf_start < now) {
+            now = g_native_air_txq[i].naf_start;
+        }
+    }
+
+    /* Deliver frames starting now to everyone but the sender */
+    i = 0;
+    while (i < g_native_air_txq_cnt) {
+        frame = &g_native_air_txq[i];
+        if (frame->naf_start > now) {
+            ++i;
+            continue;
+        }
+
+        for (node = 0; node < native_air_nodes; ++node) {
+            if ((node == frame->naf_sender) || native_air_lost()) {
+                continue;
+            }
+            if (node == 0) {
+                native_air_rxq_add(frame);
+            } else {
+                msg.nam_type = NATIVE_AIR_MSG_RX;
+                msg.nam_frame = *frame;
+                native_air_send(node, &msg);
+            }
+        }
+
+        --g_native_air_txq_cnt;
+        *frame = g_native_air_txq[g_native_air_txq_cnt];
+    }
+
+    msg.nam_type = NATIVE_AIR_MSG_RUN;
+    msg.nam_time = now;
+    for (node = 1; node < native_air_nodes; ++node) {
+        native_air_send(node, &msg);
+    }
+
+    return now;
+}
+
+/**
+ * Node: reports when it wants to wake up and waits for the coordinator to
+ * advance time.
+ *
+ * @param wake Time at which this node wants to wake up
+ *
+ * @return uint64_t The new virtual time
+ */
+static uint64_t
+native_air_node_step(uint64_t wake)
+{
+    struct native_air_msg msg;
+
+    msg.nam_type = NATIVE_AIR_MSG_IDLE;
+    msg.nam_time = wake;
+    native_air_send(0, &msg);
+
+    while (1) {
+        native_air_recv(&msg);
+        switch (msg.nam_type) {
+        case NATIVE_AIR_MSG_RX:
+            native_air_rxq_add(&msg.nam_frame);
+            break;
+        case NATIVE_AIR_MSG_RUN:
+            return msg.nam_time;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * Idle function called by the OS. Advances virtual time to the next event
+ * of any node and runs whatever is due locally.
+ *
+ * @param usecs Maximum amount of time to advance
+ *
+ * @return uint32_t Amount of time advanced
+ */
+static uint32_t
+native_air_idle(uint32_t usecs)
+{
+    int i;
+    uint64_t wake;
+    uint64_t prev;
+    struct native_air_timer *timer;
+
+    prev = g_native_air_time;
+    wake = prev + usecs;
+    timer = TAILQ_FIRST(&g_native_air_timers);
+    if (timer && timer->nat_when < wake) {
+        wake = timer->nat_when;
+        if (wake < prev) {
+            wake = prev;
+        }
+    }
+
+    if (native_air_node == 0) {
+        g_native_air_time = native_air_coord_step(wake);
+    } else {
+        g_native_air_time = native_air_node_step(wake);
+    }
+    assert(g_native_air_time >= prev);
+
+    /* Frames that start now */
+    for (i = 0; i < g_native_air_rxq_cnt; ++i) {
+        if (g_native_air_rx_cb) {
+            g_native_air_rx_cb(&g_native_air_rxq[i]);
+        }
+    }
+    g_native_air_rxq_cnt = 0;
+
+    /* Expired timers */
+    while (1) {
+        timer = TAILQ_FIRST(&g_native_air_timers);
+        if (!timer || timer->nat_when > g_native_air_time) {
+            break;
+        }
+        TAILQ_REMOVE(&g_native_air_timers, timer, nat_next);
+        timer->nat_armed = 0;
+        timer->nat_cb(timer->nat_arg);
+    }
+
+    return (uint32_t)(g_native_air_time - prev);
+}
+
+/**
+ * Joins the virtual air and switches the OS and cputime to virtual time.
+ * Must be called before the OS is started.
+ *
+ * @return int 0 on success; -1 on error.
+ */
+int
+native_air_init(void)
+{
+    int rc;
+    struct sockaddr_un sun;
+
+    if (!native_air_dir || native_air_node < 0 ||
+        native_air_nodes > NATIVE_AIR_MAX_NODES ||
+        native_air_node >= native_air_nodes) {
+        return -1;
+    }
+
+    g_native_air_sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (g_native_air_sock < 0) {
+        return -1;
+    }
+
+    native_air_addr(&sun, native_air_node);
+    unlink(sun.sun_path);
+    rc = bind(g_native_air_sock, (struct sockaddr *)&sun, sizeof(sun));
+    if (rc) {
+        close(g_native_air_sock);
+        g_native_air_sock = -1;
+        return -1;
+    }
+
+    g_native_air_seed += native_air_nodes;
+    native_cputime_air_enable();
+    os_arch_sim_vtime_set(native_air_idle);
+
+    return 0;
+}
+
+int
+native_air_enabled(void)
+{
+    return g_native_air_sock >= 0;
+}
+
+/**
+ * Returns the current virtual time.
+ *
+ * @return uint64_t Virtual time (usecs)
+ */
+uint64_t
+native_air_time(void)
+{
+    return g_native_air_time;
+}
+
+void
+native_air_set_rx_cb(native_air_rx_func rx_cb)
+{
+    g_native_air_rx_cb = rx_cb;
+}
+
+/**
+ * Puts a frame on the air. The frame reaches the other nodes at its start
+ * time plus the configured latency.
+ *
+ * @param frame
+ *
+ * @return int 0 on success; -1 if the frame cannot be sent.
+ */
+int
+native_air_tx(struct native_air_frame *frame)
+{
+    struct native_air_msg msg;
+
+    if (!native_air_enabled() || frame->naf_start < g_native_air_time) {
+        return -1;
+    }
+
+    frame->naf_sender = native_air_node;
+    frame->naf_start += native_air_latency_usecs;
+    if (native_air_node == 0) {
+        if (g_native_air_txq_cnt == NATIVE_AIR_MAX_FRAMES) {
+            return -1;
+        }
+        g_native_air_txq[g_native_air_txq_cnt] = *frame;
+        ++g_native_air_txq_cnt;
+    } else {
+        msg.nam_type = NATIVE_AIR_MSG_TX;
+        msg.nam_time = g_native_air_time;
+        msg.nam_frame = *frame;
+        native_air_send(0, &msg);
+    }
+    return 0;
+}
+
+void
+native_air_timer_init(struct native_air_timer *timer, void (*cb)(void *arg),
+                      void *arg)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->nat_cb = cb;
+    timer->nat_arg = arg;
+}
+
+/**
+ * Starts a timer that expires at the given virtual time. A timer that is
+ * already running is restarted.
+ *
+ * @param timer
+ * @param when Virtual time (usecs)
+ */
+void
+native_air_timer_start(struct native_air_timer *timer, uint64_t when)
+{
+    os_sr_t sr;
+    struct native_air_timer *entry;
+
+    OS_ENTER_CRITICAL(sr);
+    if (timer->nat_armed) {
+        TAILQ_REMOVE(&g_native_air_timers, timer, nat_next);
+    }
+    timer->nat_when = when;
+    timer->nat_armed = 1;
+
+    TAILQ_FOREACH(entry, &g_native_air_timers, nat_next) {
+        if (when < entry->nat_when) {
+            TAILQ_INSERT_BEFORE(entry, timer, nat_next);
+            break;
+        }
+    }
+    if (!entry) {
+        TAILQ_INSERT_TAIL(&g_native_air_timers, timer, nat_next);
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+void
+native_air_timer_stop(struct native_air_timer *timer)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    if (timer->nat_armed) {
+        TAILQ_REMOVE(&g_native_air_timers, timer, nat_next);
+        timer->nat_armed = 0;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
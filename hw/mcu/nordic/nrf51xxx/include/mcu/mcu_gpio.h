@@ -0,0 +1,67 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_MCU_GPIO_
+#define H_MCU_GPIO_
+
+#include "mcu/nrf51.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * All pins are on the one GPIO port.
+ */
+#define HAL_GPIO_PORT(pin)              0
+#define HAL_GPIO_PORT_BIT(pin)          (pin)
+
+static inline void
+hal_gpio_fast_set(int pin)
+{
+    NRF_GPIO->OUTSET = 1UL << pin;
+}
+
+static inline void
+hal_gpio_fast_clear(int pin)
+{
+    NRF_GPIO->OUTCLR = 1UL << pin;
+}
+
+static inline void
+hal_gpio_fast_write(int pin, int val)
+{
+    if (val) {
+        NRF_GPIO->OUTSET = 1UL << pin;
+    } else {
+        NRF_GPIO->OUTCLR = 1UL << pin;
+    }
+}
+
+static inline int
+hal_gpio_fast_read(int pin)
+{
+    return (NRF_GPIO->IN >> pin) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_MCU_GPIO_ */
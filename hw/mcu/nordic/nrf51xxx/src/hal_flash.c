@@ -28,6 +28,7 @@
 #define NRF51_FLASH_SECTOR_SZ	1024
 
 static int nrf51_flash_read(uint32_t address, void *dst, uint32_t num_bytes);
+static const void *nrf51_flash_mmap(uint32_t address, uint32_t num_bytes);
 static int nrf51_flash_write(uint32_t address, const void *src,
   uint32_t num_bytes);
 static int nrf51_flash_erase_sector(uint32_t sector_address);
@@ -36,6 +37,7 @@ static int nrf51_flash_init(void);
 
 static const struct hal_flash_funcs nrf51_flash_funcs = {
     .hff_read = nrf51_flash_read,
+    .hff_mmap = nrf51_flash_mmap,
     .hff_write = nrf51_flash_write,
     .hff_erase_sector = nrf51_flash_erase_sector,
     .hff_sector_info = nrf51_flash_sector_info,
@@ -72,6 +74,12 @@ nrf51_flash_read(uint32_t address, void *dst, uint32_t num_bytes)
     return 0;
 }
 
+static const void *
+nrf51_flash_mmap(uint32_t address, uint32_t num_bytes)
+{
+    return (const void *)address;
+}
+
 /*
  * Flash write is done by writing 4 bytes at a time at a word boundary.
  */
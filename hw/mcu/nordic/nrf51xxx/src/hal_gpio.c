@@ -433,6 +433,35 @@ int hal_gpio_toggle(int pin)
     return pin_state;
 }
 
+/**
+ * gpio port read
+ *
+ * All pins are on one port.
+ */
+uint32_t
+hal_gpio_port_read(int port)
+{
+    if (port != 0) {
+        return 0;
+    }
+    return NRF_GPIO->IN;
+}
+
+/**
+ * gpio port write
+ *
+ * Pins being set change before the ones being cleared.
+ */
+void
+hal_gpio_port_write(int port, uint32_t mask, uint32_t val)
+{
+    if (port != 0) {
+        return;
+    }
+    NRF_GPIO->OUTSET = mask & val;
+    NRF_GPIO->OUTCLR = mask & ~val;
+}
+
 /**
  * gpio irq init
  *
@@ -46,6 +46,54 @@ struct nrf52_uart_cfg {
 };
 const struct nrf52_uart_cfg *bsp_uart_config(void);
 
+/*
+ * SPI master, on SPIM instance 0-2.
+ */
+struct nrf52_spi_cfg {
+    int8_t ssc_pin_sck;
+    int8_t ssc_pin_mosi;
+    int8_t ssc_pin_miso;
+};
+struct hal_spi;
+struct hal_spi *nrf52_spi_create(int spi_num, const struct nrf52_spi_cfg *cfg);
+
+/*
+ * SPI slave, on SPIS instance 0-2. An instance can't be used both as
+ * master and as slave.
+ */
+struct nrf52_spis_cfg {
+    int8_t ssc_pin_sck;
+    int8_t ssc_pin_mosi;
+    int8_t ssc_pin_miso;
+    int8_t ssc_pin_csn;
+};
+struct hal_spi *nrf52_spis_create(int spi_num,
+                                  const struct nrf52_spis_cfg *cfg);
+
+/*
+ * PWM on a single pin, on PWM instance 0-2. Samples of a stream are played
+ * with EasyDMA, one per PWM period.
+ */
+struct nrf52_pwm_cfg {
+    int8_t npc_pin;
+};
+struct hal_pwm;
+struct hal_pwm *nrf52_pwm_create(int pwm_num,
+                                 const struct nrf52_pwm_cfg *cfg);
+
+/*
+ * SAADC on a single analog input. Streaming paces conversions with
+ * TIMER nac_timer (2-4), connected to SAMPLE task via PPI channel
+ * nac_ppi_chan (0-19; 20 and up are used by BLE).
+ */
+struct nrf52_adc_cfg {
+    uint8_t nac_ain;
+    uint8_t nac_timer;
+    uint8_t nac_ppi_chan;
+};
+struct hal_adc;
+struct hal_adc *nrf52_adc_create(const struct nrf52_adc_cfg *cfg);
+
 struct hal_flash;
 extern const struct hal_flash nrf52k_flash_dev;
 
@@ -0,0 +1,247 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stddef.h>
+#include "hal/hal_adc.h"
+#include "hal/hal_adc_int.h"
+#include "bsp/cmsis_nvic.h"
+
+#include "mcu/nrf.h"
+#include "mcu/nrf52_hal.h"
+
+/* Gain 1/6 against the internal 0.6V reference gives 0-3.6V full scale. */
+#define NRF52_ADC_REF_MV        3600
+#define NRF52_ADC_BITS          12
+
+/* TIMERs run off 16MHz HFCLK with prescaler 0. */
+#define NRF52_ADC_TIMER_FREQ    16000000
+
+struct nrf52_hal_adc {
+    struct hal_adc parent;
+    const struct nrf52_adc_cfg *cfg;
+    NRF_TIMER_Type *timer;
+    struct hal_adc_stream *st;
+    uint8_t cur;                        /* index of buffer being filled */
+};
+
+static int nrf52_adc_read(struct hal_adc *padc);
+static int nrf52_adc_get_bits(struct hal_adc *padc);
+static int nrf52_adc_get_ref_mv(struct hal_adc *padc);
+static int nrf52_adc_stream_start(struct hal_adc *padc,
+                                  struct hal_adc_stream *st);
+static int nrf52_adc_stream_stop(struct hal_adc *padc);
+
+static const struct hal_adc_funcs nrf52_adc_funcs = {
+    .hadc_read = nrf52_adc_read,
+    .hadc_get_bits = nrf52_adc_get_bits,
+    .hadc_get_ref_mv = nrf52_adc_get_ref_mv,
+    .hadc_stream_start = nrf52_adc_stream_start,
+    .hadc_stream_stop = nrf52_adc_stream_stop,
+};
+
+/*
+ * There is one SAADC, and it is handed to a single AIN at a time.
+ */
+static struct nrf52_hal_adc nrf52_adc;
+
+/* TIMER0 is used by cputime, TIMER1 by OS tick. */
+static NRF_TIMER_Type * const nrf52_adc_timers[] = {
+    NULL, NULL, NRF_TIMER2, NRF_TIMER3, NRF_TIMER4
+};
+
+static int
+nrf52_adc_get_bits(struct hal_adc *padc)
+{
+    return NRF52_ADC_BITS;
+}
+
+static int
+nrf52_adc_get_ref_mv(struct hal_adc *padc)
+{
+    return NRF52_ADC_REF_MV;
+}
+
+static void
+nrf52_adc_stop_wait(void)
+{
+    NRF_SAADC->EVENTS_STOPPED = 0;
+    NRF_SAADC->TASKS_STOP = 1;
+    while (NRF_SAADC->EVENTS_STOPPED == 0) {
+    }
+    NRF_SAADC->EVENTS_STOPPED = 0;
+}
+
+static int
+nrf52_adc_read(struct hal_adc *padc)
+{
+    struct nrf52_hal_adc *adc = (struct nrf52_hal_adc *)padc;
+    volatile int16_t val;
+
+    if (adc->st) {
+        return -1;
+    }
+    val = 0;
+    NRF_SAADC->RESULT.PTR = (uint32_t)&val;
+    NRF_SAADC->RESULT.MAXCNT = 1;
+    NRF_SAADC->EVENTS_STARTED = 0;
+    NRF_SAADC->EVENTS_END = 0;
+    NRF_SAADC->TASKS_START = 1;
+    while (NRF_SAADC->EVENTS_STARTED == 0) {
+    }
+    NRF_SAADC->TASKS_SAMPLE = 1;
+    while (NRF_SAADC->EVENTS_END == 0) {
+    }
+    nrf52_adc_stop_wait();
+    NRF_SAADC->EVENTS_STARTED = 0;
+    NRF_SAADC->EVENTS_END = 0;
+
+    /* Single ended input can read slightly below zero. */
+    if (val < 0) {
+        return 0;
+    }
+    return val;
+}
+
+/*
+ * RESULT.PTR is latched on TASKS_START, so it can be pointed at the next
+ * buffer as soon as STARTED fires. On END the filled buffer is handed out,
+ * and conversion continues into the other one.
+ */
+static void
+nrf52_adc_irq_handler(void)
+{
+    struct nrf52_hal_adc *adc = &nrf52_adc;
+    struct hal_adc_stream *st;
+    int16_t *buf;
+
+    st = adc->st;
+    if (NRF_SAADC->EVENTS_END) {
+        NRF_SAADC->EVENTS_END = 0;
+        if (st) {
+            buf = st->bufs[adc->cur];
+            adc->cur ^= 1;
+            NRF_SAADC->TASKS_START = 1;
+            hal_adc_stream_done(st, buf);
+        }
+    }
+    if (NRF_SAADC->EVENTS_STARTED) {
+        NRF_SAADC->EVENTS_STARTED = 0;
+        if (st) {
+            NRF_SAADC->RESULT.PTR = (uint32_t)st->bufs[adc->cur ^ 1];
+        }
+    }
+}
+
+static int
+nrf52_adc_stream_start(struct hal_adc *padc, struct hal_adc_stream *st)
+{
+    struct nrf52_hal_adc *adc = (struct nrf52_hal_adc *)padc;
+    const struct nrf52_adc_cfg *cfg = adc->cfg;
+    NRF_TIMER_Type *timer = adc->timer;
+    uint32_t ticks;
+
+    if (adc->st || !timer || st->rate > NRF52_ADC_TIMER_FREQ) {
+        return -1;
+    }
+    ticks = NRF52_ADC_TIMER_FREQ / st->rate;
+
+    adc->st = st;
+    adc->cur = 0;
+
+    timer->TASKS_STOP = 1;
+    timer->TASKS_CLEAR = 1;
+    timer->MODE = TIMER_MODE_MODE_Timer;
+    timer->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    timer->PRESCALER = 0;
+    timer->CC[0] = ticks;
+    timer->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+    timer->EVENTS_COMPARE[0] = 0;
+
+    NRF_PPI->CH[cfg->nac_ppi_chan].EEP = (uint32_t)&timer->EVENTS_COMPARE[0];
+    NRF_PPI->CH[cfg->nac_ppi_chan].TEP = (uint32_t)&NRF_SAADC->TASKS_SAMPLE;
+    NRF_PPI->CHENSET = 1 << cfg->nac_ppi_chan;
+
+    NRF_SAADC->RESULT.PTR = (uint32_t)st->bufs[0];
+    NRF_SAADC->RESULT.MAXCNT = st->buf_cnt;
+    NRF_SAADC->EVENTS_STARTED = 0;
+    NRF_SAADC->EVENTS_END = 0;
+    NRF_SAADC->INTENSET = SAADC_INTENSET_STARTED_Msk | SAADC_INTENSET_END_Msk;
+    NRF_SAADC->TASKS_START = 1;
+
+    timer->TASKS_START = 1;
+    return 0;
+}
+
+static int
+nrf52_adc_stream_stop(struct hal_adc *padc)
+{
+    struct nrf52_hal_adc *adc = (struct nrf52_hal_adc *)padc;
+
+    if (!adc->st) {
+        return -1;
+    }
+    adc->timer->TASKS_STOP = 1;
+    NRF_PPI->CHENCLR = 1 << adc->cfg->nac_ppi_chan;
+    NRF_SAADC->INTENCLR = SAADC_INTENSET_STARTED_Msk | SAADC_INTENSET_END_Msk;
+    nrf52_adc_stop_wait();
+    NRF_SAADC->EVENTS_STARTED = 0;
+    NRF_SAADC->EVENTS_END = 0;
+    NVIC_ClearPendingIRQ(SAADC_IRQn);
+    adc->st = NULL;
+    return 0;
+}
+
+/*
+ * Sets up the SAADC to sample analog input cfg->nac_ain, single ended.
+ * Streaming needs a TIMER and a PPI channel; those are given in cfg.
+ * Returns NULL on error.
+ */
+struct hal_adc *
+nrf52_adc_create(const struct nrf52_adc_cfg *cfg)
+{
+    struct nrf52_hal_adc *adc = &nrf52_adc;
+
+    if (cfg->nac_ain > 7 || cfg->nac_timer >=
+      (int)(sizeof(nrf52_adc_timers) / sizeof(nrf52_adc_timers[0])) ||
+      cfg->nac_ppi_chan >= 20) {
+        return NULL;
+    }
+    adc->cfg = cfg;
+    adc->timer = nrf52_adc_timers[cfg->nac_timer];
+    adc->st = NULL;
+
+    NRF_SAADC->ENABLE = 0;
+    NRF_SAADC->INTENCLR = 0xffffffff;
+    NRF_SAADC->RESOLUTION = SAADC_RESOLUTION_VAL_12bit;
+    NRF_SAADC->OVERSAMPLE = 0;
+    NRF_SAADC->SAMPLERATE = 0;
+    NRF_SAADC->CH[0].PSELP = SAADC_CH_PSELP_PSELP_AnalogInput0 + cfg->nac_ain;
+    NRF_SAADC->CH[0].PSELN = SAADC_CH_PSELN_PSELN_NC;
+    NRF_SAADC->CH[0].CONFIG =
+      (SAADC_CH_CONFIG_GAIN_Gain1_6 << SAADC_CH_CONFIG_GAIN_Pos) |
+      (SAADC_CH_CONFIG_REFSEL_Internal << SAADC_CH_CONFIG_REFSEL_Pos) |
+      (SAADC_CH_CONFIG_TACQ_10us << SAADC_CH_CONFIG_TACQ_Pos);
+    NRF_SAADC->ENABLE = SAADC_ENABLE_ENABLE_Enabled;
+
+    NVIC_SetVector(SAADC_IRQn, (uint32_t)nrf52_adc_irq_handler);
+    NVIC_EnableIRQ(SAADC_IRQn);
+
+    adc->parent.driver_api = &nrf52_adc_funcs;
+    return &adc->parent;
+}
@@ -80,6 +80,32 @@ cputime_set_ocmp(struct cpu_timer *timer)
     }
 }
 
+/**
+ * cputime hw num ocmp
+ *
+ * All TIMER0 compare registers are in use (radio events, counter capture
+ * and the cputime output compare), so there are no dedicated channels.
+ *
+ * @return int The number of output compare channels.
+ */
+int
+cputime_hw_num_ocmp(void)
+{
+    return 1;
+}
+
+void
+cputime_hw_set_ocmp(int ocmp, uint32_t cputime)
+{
+    assert(0);
+}
+
+void
+cputime_hw_disable_ocmp(int ocmp)
+{
+    assert(0);
+}
+
 /**
  * cputime isr
  *
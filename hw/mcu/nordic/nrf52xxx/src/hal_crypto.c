@@ -0,0 +1,113 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "hal/hal_crypto.h"
+
+#include "mcu/nrf.h"
+#include "mcu/nrf52_hal.h"
+
+/* Layout of the memory ECBDATAPTR points to. */
+struct nrf52_ecb_data {
+    uint8_t key[16];
+    uint8_t cleartext[16];
+    uint8_t ciphertext[16];
+};
+
+/*
+ * The ECB unit is shared with the BLE controller (ble_hw_encrypt_block()),
+ * so the whole operation runs with interrupts disabled; it takes ~7us.
+ * CCM and AAR have priority over ECB, and abort it with ERRORECB; the caller
+ * then falls back to software.
+ */
+int
+hal_crypto_aes128_enc(const uint8_t *key, const uint8_t *in, uint8_t *out)
+{
+    struct nrf52_ecb_data ecb;
+    uint32_t sr;
+    int rc;
+
+    memcpy(ecb.key, key, sizeof(ecb.key));
+    memcpy(ecb.cleartext, in, sizeof(ecb.cleartext));
+
+    __HAL_DISABLE_INTERRUPTS(sr);
+
+    NRF_ECB->TASKS_STOPECB = 1;
+    NRF_ECB->EVENTS_ENDECB = 0;
+    NRF_ECB->EVENTS_ERRORECB = 0;
+    NRF_ECB->ECBDATAPTR = (uint32_t)&ecb;
+    NRF_ECB->TASKS_STARTECB = 1;
+
+    while (NRF_ECB->EVENTS_ENDECB == 0 && NRF_ECB->EVENTS_ERRORECB == 0) {
+    }
+    rc = NRF_ECB->EVENTS_ERRORECB ? -1 : 0;
+    NRF_ECB->EVENTS_ENDECB = 0;
+    NRF_ECB->EVENTS_ERRORECB = 0;
+
+    __HAL_ENABLE_INTERRUPTS(sr);
+
+    if (rc == 0) {
+        memcpy(out, ecb.ciphertext, sizeof(ecb.ciphertext));
+    }
+    memset(&ecb, 0, sizeof(ecb));
+
+    return rc;
+}
+
+/*
+ * Polls the RNG. If the BLE controller is running the RNG from its
+ * interrupt (ble_hw_rng_start()), the values belong to it; report busy.
+ */
+int
+hal_crypto_rng(void *buf, int len)
+{
+    uint8_t *p;
+    uint32_t sr;
+    int started;
+
+    __HAL_DISABLE_INTERRUPTS(sr);
+    if (NRF_RNG->INTENSET) {
+        __HAL_ENABLE_INTERRUPTS(sr);
+        return -1;
+    }
+    started = 0;
+    if (NRF_RNG->TASKS_START == 0) {
+        NRF_RNG->CONFIG = 1;    /* bias correction */
+        NRF_RNG->EVENTS_VALRDY = 0;
+        NRF_RNG->TASKS_START = 1;
+        started = 1;
+    }
+    __HAL_ENABLE_INTERRUPTS(sr);
+
+    /* With bias correction a byte takes ~120us; don't block interrupts. */
+    p = buf;
+    while (len > 0) {
+        while (NRF_RNG->EVENTS_VALRDY == 0) {
+        }
+        NRF_RNG->EVENTS_VALRDY = 0;
+        *p++ = (uint8_t)NRF_RNG->VALUE;
+        len--;
+    }
+
+    if (started) {
+        NRF_RNG->TASKS_STOP = 1;
+    }
+
+    return 0;
+}
@@ -28,6 +28,7 @@
 #define NRF52K_FLASH_SECTOR_SZ	4096
 
 static int nrf52k_flash_read(uint32_t address, void *dst, uint32_t num_bytes);
+static const void *nrf52k_flash_mmap(uint32_t address, uint32_t num_bytes);
 static int nrf52k_flash_write(uint32_t address, const void *src,
   uint32_t num_bytes);
 static int nrf52k_flash_erase_sector(uint32_t sector_address);
@@ -36,6 +37,7 @@ static int nrf52k_flash_init(void);
 
 static const struct hal_flash_funcs nrf52k_flash_funcs = {
     .hff_read = nrf52k_flash_read,
+    .hff_mmap = nrf52k_flash_mmap,
     .hff_write = nrf52k_flash_write,
     .hff_erase_sector = nrf52k_flash_erase_sector,
     .hff_sector_info = nrf52k_flash_sector_info,
@@ -72,6 +74,12 @@ nrf52k_flash_read(uint32_t address, void *dst, uint32_t num_bytes)
     return 0;
 }
 
+static const void *
+nrf52k_flash_mmap(uint32_t address, uint32_t num_bytes)
+{
+    return (const void *)address;
+}
+
 /*
  * Flash write is done by writing 4 bytes at a time at a word boundary.
  */
@@ -0,0 +1,353 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stddef.h>
+#include "hal/hal_pwm.h"
+#include "hal/hal_pwm_int.h"
+#include "hal/hal_gpio.h"
+#include "bsp/cmsis_nvic.h"
+
+#include "mcu/nrf.h"
+#include "mcu/nrf52_hal.h"
+#include "mcu/nrf52_bitfields.h"
+
+#define NRF52_PWM_CLK_FREQ      16000000
+#define NRF52_PWM_BITS          15
+#define NRF52_PWM_TOP_MAX       32767
+
+/*
+ * Compare values with bit 15 set start the period high, so the value is
+ * the on time in PWM clock ticks.
+ */
+#define NRF52_PWM_MARK          0x8000
+
+struct nrf52_hal_pwm {
+    struct hal_pwm parent;
+    NRF_PWM_Type *regs;
+    IRQn_Type irqn;
+    const struct nrf52_pwm_cfg *cfg;
+    struct hal_pwm_stream *st;
+    uint8_t prescaler;
+    uint8_t running;
+    uint16_t top;
+    uint16_t duty;              /* played by hal_pwm_enable_duty_cycle() */
+};
+
+static int nrf52_pwm_get_bits(struct hal_pwm *ppwm);
+static int nrf52_pwm_get_clk(struct hal_pwm *ppwm);
+static int nrf52_pwm_disable(struct hal_pwm *ppwm);
+static int nrf52_pwm_ena_duty(struct hal_pwm *ppwm, uint16_t frac_duty);
+static int nrf52_pwm_set_freq(struct hal_pwm *ppwm, uint32_t freq_hz);
+static int nrf52_pwm_stream_setup(struct hal_pwm *ppwm,
+                                  struct hal_pwm_stream *st);
+static int nrf52_pwm_stream_start(struct hal_pwm *ppwm,
+                                  struct hal_pwm_stream *st);
+static int nrf52_pwm_stream_stop(struct hal_pwm *ppwm);
+
+static const struct hal_pwm_funcs nrf52_pwm_funcs = {
+    .hpwm_get_bits = nrf52_pwm_get_bits,
+    .hpwm_get_clk = nrf52_pwm_get_clk,
+    .hpwm_disable = nrf52_pwm_disable,
+    .hpwm_ena_duty = nrf52_pwm_ena_duty,
+    .hpwm_set_freq = nrf52_pwm_set_freq,
+    .hpwm_stream_setup = nrf52_pwm_stream_setup,
+    .hpwm_stream_start = nrf52_pwm_stream_start,
+    .hpwm_stream_stop = nrf52_pwm_stream_stop,
+};
+
+static void nrf52_pwm0_irq(void);
+static void nrf52_pwm1_irq(void);
+static void nrf52_pwm2_irq(void);
+
+static struct nrf52_hal_pwm nrf52_pwms[3];
+static NRF_PWM_Type * const nrf52_pwm_regs[3] = {
+    NRF_PWM0, NRF_PWM1, NRF_PWM2
+};
+static const IRQn_Type nrf52_pwm_irqns[3] = {
+    PWM0_IRQn, PWM1_IRQn, PWM2_IRQn
+};
+static void (* const nrf52_pwm_irqs[3])(void) = {
+    nrf52_pwm0_irq, nrf52_pwm1_irq, nrf52_pwm2_irq
+};
+
+/*
+ * Finds the smallest prescaler which fits a period of freq_hz within
+ * COUNTERTOP. Returns -1 if the frequency is out of range.
+ */
+static int
+nrf52_pwm_period(uint32_t freq_hz, uint8_t *prescaler, uint16_t *top)
+{
+    uint32_t ticks;
+    int p;
+
+    if (freq_hz == 0) {
+        return -1;
+    }
+    for (p = 0; p <= 7; p++) {
+        ticks = (NRF52_PWM_CLK_FREQ >> p) / freq_hz;
+        if (ticks <= NRF52_PWM_TOP_MAX) {
+            if (ticks < 3) {
+                return -1;
+            }
+            *prescaler = p;
+            *top = ticks;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * STOPPED is only generated if the PWM was playing.
+ */
+static void
+nrf52_pwm_stop_wait(struct nrf52_hal_pwm *pwm)
+{
+    NRF_PWM_Type *regs = pwm->regs;
+
+    if (!pwm->running) {
+        return;
+    }
+    pwm->running = 0;
+    regs->EVENTS_STOPPED = 0;
+    regs->TASKS_STOP = 1;
+    while (regs->EVENTS_STOPPED == 0) {
+    }
+    regs->EVENTS_STOPPED = 0;
+}
+
+static int
+nrf52_pwm_get_bits(struct hal_pwm *ppwm)
+{
+    return NRF52_PWM_BITS;
+}
+
+static int
+nrf52_pwm_get_clk(struct hal_pwm *ppwm)
+{
+    struct nrf52_hal_pwm *pwm = (struct nrf52_hal_pwm *)ppwm;
+
+    return NRF52_PWM_CLK_FREQ >> pwm->prescaler;
+}
+
+static int
+nrf52_pwm_disable(struct hal_pwm *ppwm)
+{
+    struct nrf52_hal_pwm *pwm = (struct nrf52_hal_pwm *)ppwm;
+
+    if (pwm->st) {
+        return -1;
+    }
+    nrf52_pwm_stop_wait(pwm);
+    return 0;
+}
+
+/*
+ * A sequence of one value; the PWM keeps playing the last value of a
+ * sequence until stopped.
+ */
+static int
+nrf52_pwm_ena_duty(struct hal_pwm *ppwm, uint16_t frac_duty)
+{
+    struct nrf52_hal_pwm *pwm = (struct nrf52_hal_pwm *)ppwm;
+    NRF_PWM_Type *regs = pwm->regs;
+
+    if (pwm->st) {
+        return -1;
+    }
+    pwm->duty = (((uint32_t)frac_duty * pwm->top + 32767) / 65535) |
+      NRF52_PWM_MARK;
+
+    regs->COUNTERTOP = pwm->top;
+    regs->PRESCALER = pwm->prescaler;
+    regs->LOOP = 0;
+    regs->SHORTS = 0;
+    regs->SEQ[0].PTR = (uint32_t)&pwm->duty;
+    regs->SEQ[0].CNT = 1;
+    regs->SEQ[0].REFRESH = 0;
+    regs->SEQ[0].ENDDELAY = 0;
+    regs->TASKS_SEQSTART[0] = 1;
+    pwm->running = 1;
+    return 0;
+}
+
+static int
+nrf52_pwm_set_freq(struct hal_pwm *ppwm, uint32_t freq_hz)
+{
+    struct nrf52_hal_pwm *pwm = (struct nrf52_hal_pwm *)ppwm;
+
+    if (pwm->st) {
+        return -1;
+    }
+    return nrf52_pwm_period(freq_hz, &pwm->prescaler, &pwm->top);
+}
+
+/*
+ * Every sample lasts one PWM period, so the PWM frequency is the sample
+ * rate.
+ */
+static int
+nrf52_pwm_stream_setup(struct hal_pwm *ppwm, struct hal_pwm_stream *st)
+{
+    uint8_t prescaler;
+    uint16_t top;
+
+    if (nrf52_pwm_period(st->rate, &prescaler, &top)) {
+        return -1;
+    }
+    st->top = top;
+    st->mark = NRF52_PWM_MARK;
+    return 0;
+}
+
+/*
+ * The two buffers are SEQ[0] and SEQ[1]. They are played back to back,
+ * and LOOPSDONE restarts SEQ[0], so playing never stops. SEQEND of a
+ * sequence tells that its buffer can be refilled.
+ */
+static int
+nrf52_pwm_stream_start(struct hal_pwm *ppwm, struct hal_pwm_stream *st)
+{
+    struct nrf52_hal_pwm *pwm = (struct nrf52_hal_pwm *)ppwm;
+    NRF_PWM_Type *regs = pwm->regs;
+    uint8_t prescaler;
+    uint16_t top;
+    int i;
+
+    if (pwm->st || st->buf_cnt > 0x7fff ||
+      nrf52_pwm_period(st->rate, &prescaler, &top)) {
+        return -1;
+    }
+    pwm->st = st;
+
+    nrf52_pwm_stop_wait(pwm);
+    regs->COUNTERTOP = top;
+    regs->PRESCALER = prescaler;
+    for (i = 0; i < 2; i++) {
+        regs->SEQ[i].PTR = (uint32_t)st->bufs[i];
+        regs->SEQ[i].CNT = st->buf_cnt;
+        regs->SEQ[i].REFRESH = 0;
+        regs->SEQ[i].ENDDELAY = 0;
+        regs->EVENTS_SEQEND[i] = 0;
+    }
+    regs->LOOP = 1;
+    regs->SHORTS = PWM_SHORTS_LOOPSDONE_SEQSTART0_Msk;
+    regs->INTENSET = PWM_INTENSET_SEQEND0_Msk | PWM_INTENSET_SEQEND1_Msk;
+    regs->TASKS_SEQSTART[0] = 1;
+    pwm->running = 1;
+    return 0;
+}
+
+static int
+nrf52_pwm_stream_stop(struct hal_pwm *ppwm)
+{
+    struct nrf52_hal_pwm *pwm = (struct nrf52_hal_pwm *)ppwm;
+    NRF_PWM_Type *regs = pwm->regs;
+
+    if (!pwm->st) {
+        return -1;
+    }
+    regs->SHORTS = 0;
+    regs->INTENCLR = PWM_INTENSET_SEQEND0_Msk | PWM_INTENSET_SEQEND1_Msk;
+    nrf52_pwm_stop_wait(pwm);
+    regs->EVENTS_SEQEND[0] = 0;
+    regs->EVENTS_SEQEND[1] = 0;
+    NVIC_ClearPendingIRQ(pwm->irqn);
+    pwm->st = NULL;
+    return 0;
+}
+
+static void
+nrf52_pwm_irq_handler(struct nrf52_hal_pwm *pwm)
+{
+    NRF_PWM_Type *regs = pwm->regs;
+    struct hal_pwm_stream *st;
+    int i;
+
+    st = pwm->st;
+    for (i = 0; i < 2; i++) {
+        if (regs->EVENTS_SEQEND[i]) {
+            regs->EVENTS_SEQEND[i] = 0;
+            if (st) {
+                hal_pwm_stream_done(st, st->bufs[i]);
+            }
+        }
+    }
+}
+
+static void
+nrf52_pwm0_irq(void)
+{
+    nrf52_pwm_irq_handler(&nrf52_pwms[0]);
+}
+
+static void
+nrf52_pwm1_irq(void)
+{
+    nrf52_pwm_irq_handler(&nrf52_pwms[1]);
+}
+
+static void
+nrf52_pwm2_irq(void)
+{
+    nrf52_pwm_irq_handler(&nrf52_pwms[2]);
+}
+
+/*
+ * Sets up PWM instance pwm_num (0-2) to drive a single pin, at 1kHz.
+ * Returns NULL on error.
+ */
+struct hal_pwm *
+nrf52_pwm_create(int pwm_num, const struct nrf52_pwm_cfg *cfg)
+{
+    struct nrf52_hal_pwm *pwm;
+    NRF_PWM_Type *regs;
+
+    if (pwm_num < 0 ||
+      pwm_num >= (int)(sizeof(nrf52_pwms) / sizeof(nrf52_pwms[0]))) {
+        return NULL;
+    }
+    pwm = &nrf52_pwms[pwm_num];
+    regs = nrf52_pwm_regs[pwm_num];
+    pwm->regs = regs;
+    pwm->irqn = nrf52_pwm_irqns[pwm_num];
+    pwm->cfg = cfg;
+    pwm->st = NULL;
+    pwm->running = 0;
+    nrf52_pwm_period(1000, &pwm->prescaler, &pwm->top);
+
+    if (hal_gpio_init_out(cfg->npc_pin, 0)) {
+        return NULL;
+    }
+
+    regs->ENABLE = 0;
+    regs->INTENCLR = 0xffffffff;
+    regs->PSEL.OUT[0] = cfg->npc_pin;
+    regs->PSEL.OUT[1] = 0xffffffff;
+    regs->PSEL.OUT[2] = 0xffffffff;
+    regs->PSEL.OUT[3] = 0xffffffff;
+    regs->MODE = PWM_MODE_UPDOWN_Up;
+    regs->DECODER = PWM_DECODER_LOAD_Common | PWM_DECODER_MODE_RefreshCount;
+    regs->ENABLE = PWM_ENABLE_ENABLE_Enabled;
+
+    NVIC_SetVector(pwm->irqn, (uint32_t)nrf52_pwm_irqs[pwm_num]);
+    NVIC_EnableIRQ(pwm->irqn);
+
+    pwm->parent.driver_api = &nrf52_pwm_funcs;
+    return &pwm->parent;
+}
@@ -0,0 +1,324 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stddef.h>
+#include "hal/hal_spi.h"
+#include "hal/hal_spi_int.h"
+#include "hal/hal_gpio.h"
+#include "bsp/cmsis_nvic.h"
+
+#include "mcu/nrf.h"
+#include "mcu/nrf52_hal.h"
+
+/* RXD.MAXCNT and TXD.MAXCNT are 8 bits wide on nRF52832. */
+#define NRF52_SPIM_DMA_MAXCNT   255
+
+struct nrf52_hal_spi {
+    struct hal_spi parent;
+    NRF_SPIM_Type *regs;
+    IRQn_Type irqn;
+    void (*isr)(void);
+    volatile uint8_t busy;
+    uint8_t *txbuf;
+    uint8_t *rxbuf;
+    int len;
+    int off;
+    int chunk;
+    hal_spi_txrx_cb cb;
+    void *arg;
+};
+
+static int nrf52_spi_config(struct hal_spi *pspi,
+                            struct hal_spi_settings *psettings);
+static int nrf52_spi_master_transfer(struct hal_spi *pspi, uint16_t tx);
+static int nrf52_spi_txrx(struct hal_spi *pspi, void *txbuf, void *rxbuf,
+                          int len);
+static int nrf52_spi_txrx_nonblock(struct hal_spi *pspi, void *txbuf,
+                                   void *rxbuf, int len, hal_spi_txrx_cb cb,
+                                   void *arg);
+
+static const struct hal_spi_funcs nrf52_spi_funcs = {
+    .hspi_config = nrf52_spi_config,
+    .hspi_master_transfer = nrf52_spi_master_transfer,
+    .hspi_txrx = nrf52_spi_txrx,
+    .hspi_txrx_nonblock = nrf52_spi_txrx_nonblock,
+};
+
+static void nrf52_spi0_irq(void);
+static void nrf52_spi1_irq(void);
+static void nrf52_spi2_irq(void);
+
+/*
+ * SPIM0 and SPIM1 share their registers and interrupt with TWIM0/1; don't
+ * use the same instance for both.
+ */
+static struct nrf52_hal_spi nrf52_spis[] = {
+    [0] = {
+        .regs = NRF_SPIM0,
+        .irqn = SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn,
+        .isr = nrf52_spi0_irq
+    },
+    [1] = {
+        .regs = NRF_SPIM1,
+        .irqn = SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn,
+        .isr = nrf52_spi1_irq
+    },
+    [2] = {
+        .regs = NRF_SPIM2,
+        .irqn = SPIM2_SPIS2_SPI2_IRQn,
+        .isr = nrf52_spi2_irq
+    }
+};
+
+static uint32_t
+nrf52_spi_freq(hal_spi_baudrate baudrate)
+{
+    if (baudrate >= 8000) {
+        return SPIM_FREQUENCY_FREQUENCY_M8;
+    } else if (baudrate >= 4000) {
+        return SPIM_FREQUENCY_FREQUENCY_M4;
+    } else if (baudrate >= 2000) {
+        return SPIM_FREQUENCY_FREQUENCY_M2;
+    } else if (baudrate >= 1000) {
+        return SPIM_FREQUENCY_FREQUENCY_M1;
+    } else if (baudrate >= 500) {
+        return SPIM_FREQUENCY_FREQUENCY_K500;
+    } else if (baudrate >= 250) {
+        return SPIM_FREQUENCY_FREQUENCY_K250;
+    } else {
+        return SPIM_FREQUENCY_FREQUENCY_K125;
+    }
+}
+
+static int
+nrf52_spi_config(struct hal_spi *pspi, struct hal_spi_settings *psettings)
+{
+    struct nrf52_hal_spi *spi = (struct nrf52_hal_spi *)pspi;
+    uint32_t cfg;
+
+    if (spi->busy || psettings->word_size != HAL_SPI_WORD_SIZE_8BIT) {
+        return -1;
+    }
+
+    cfg = 0;
+    switch (psettings->data_mode) {
+    case HAL_SPI_MODE0:
+        break;
+    case HAL_SPI_MODE1:
+        cfg |= SPIM_CONFIG_CPHA_Trailing << SPIM_CONFIG_CPHA_Pos;
+        break;
+    case HAL_SPI_MODE2:
+        cfg |= SPIM_CONFIG_CPOL_ActiveLow << SPIM_CONFIG_CPOL_Pos;
+        break;
+    case HAL_SPI_MODE3:
+        cfg |= (SPIM_CONFIG_CPOL_ActiveLow << SPIM_CONFIG_CPOL_Pos) |
+          (SPIM_CONFIG_CPHA_Trailing << SPIM_CONFIG_CPHA_Pos);
+        break;
+    default:
+        return -1;
+    }
+    if (psettings->data_order == HAL_SPI_LSB_FIRST) {
+        cfg |= SPIM_CONFIG_ORDER_LsbFirst << SPIM_CONFIG_ORDER_Pos;
+    }
+
+    spi->regs->CONFIG = cfg;
+    spi->regs->FREQUENCY = nrf52_spi_freq(psettings->baudrate);
+    return 0;
+}
+
+/*
+ * Starts next piece of the transfer; EasyDMA moves at most
+ * NRF52_SPIM_DMA_MAXCNT bytes at a time. Zero length buffer makes SPIM send
+ * ORC, or drop received bytes.
+ */
+static void
+nrf52_spi_start(struct nrf52_hal_spi *spi)
+{
+    NRF_SPIM_Type *regs = spi->regs;
+
+    spi->chunk = spi->len - spi->off;
+    if (spi->chunk > NRF52_SPIM_DMA_MAXCNT) {
+        spi->chunk = NRF52_SPIM_DMA_MAXCNT;
+    }
+    regs->EVENTS_END = 0;
+    if (spi->txbuf) {
+        regs->TXD.PTR = (uint32_t)(spi->txbuf + spi->off);
+        regs->TXD.MAXCNT = spi->chunk;
+    } else {
+        regs->TXD.MAXCNT = 0;
+    }
+    if (spi->rxbuf) {
+        regs->RXD.PTR = (uint32_t)(spi->rxbuf + spi->off);
+        regs->RXD.MAXCNT = spi->chunk;
+    } else {
+        regs->RXD.MAXCNT = 0;
+    }
+    regs->TASKS_START = 1;
+}
+
+static int
+nrf52_spi_setup(struct nrf52_hal_spi *spi, void *txbuf, void *rxbuf, int len,
+                hal_spi_txrx_cb cb, void *arg)
+{
+    uint32_t sr;
+
+    __HAL_DISABLE_INTERRUPTS(sr);
+    if (spi->busy) {
+        __HAL_ENABLE_INTERRUPTS(sr);
+        return -1;
+    }
+    spi->busy = 1;
+    __HAL_ENABLE_INTERRUPTS(sr);
+
+    spi->txbuf = txbuf;
+    spi->rxbuf = rxbuf;
+    spi->len = len;
+    spi->off = 0;
+    spi->cb = cb;
+    spi->arg = arg;
+    return 0;
+}
+
+static int
+nrf52_spi_txrx(struct hal_spi *pspi, void *txbuf, void *rxbuf, int len)
+{
+    struct nrf52_hal_spi *spi = (struct nrf52_hal_spi *)pspi;
+
+    if (nrf52_spi_setup(spi, txbuf, rxbuf, len, NULL, NULL)) {
+        return -1;
+    }
+    while (spi->off < spi->len) {
+        nrf52_spi_start(spi);
+        while (spi->regs->EVENTS_END == 0) {
+        }
+        spi->regs->EVENTS_END = 0;
+        spi->off += spi->chunk;
+    }
+    spi->busy = 0;
+    return 0;
+}
+
+static int
+nrf52_spi_txrx_nonblock(struct hal_spi *pspi, void *txbuf, void *rxbuf,
+                        int len, hal_spi_txrx_cb cb, void *arg)
+{
+    struct nrf52_hal_spi *spi = (struct nrf52_hal_spi *)pspi;
+
+    if (nrf52_spi_setup(spi, txbuf, rxbuf, len, cb, arg)) {
+        return -1;
+    }
+    if (len == 0) {
+        spi->busy = 0;
+        if (cb) {
+            cb(arg, 0);
+        }
+        return 0;
+    }
+    spi->regs->INTENSET = SPIM_INTENSET_END_Msk;
+    nrf52_spi_start(spi);
+    return 0;
+}
+
+static int
+nrf52_spi_master_transfer(struct hal_spi *pspi, uint16_t tx)
+{
+    uint8_t txd;
+    uint8_t rxd;
+
+    txd = tx;
+    if (nrf52_spi_txrx(pspi, &txd, &rxd, 1)) {
+        return -1;
+    }
+    return rxd;
+}
+
+static void
+nrf52_spi_irq_handler(struct nrf52_hal_spi *spi)
+{
+    if (spi->regs->EVENTS_END == 0) {
+        return;
+    }
+    spi->regs->EVENTS_END = 0;
+    spi->off += spi->chunk;
+    if (spi->off < spi->len) {
+        nrf52_spi_start(spi);
+        return;
+    }
+    spi->regs->INTENCLR = SPIM_INTENSET_END_Msk;
+    spi->busy = 0;
+    if (spi->cb) {
+        spi->cb(spi->arg, spi->len);
+    }
+}
+
+static void
+nrf52_spi0_irq(void)
+{
+    nrf52_spi_irq_handler(&nrf52_spis[0]);
+}
+
+static void
+nrf52_spi1_irq(void)
+{
+    nrf52_spi_irq_handler(&nrf52_spis[1]);
+}
+
+static void
+nrf52_spi2_irq(void)
+{
+    nrf52_spi_irq_handler(&nrf52_spis[2]);
+}
+
+/*
+ * Sets up SPIM instance spi_num as master on the given pins. Default
+ * configuration is mode 0, MSB first, 1MHz. Returns NULL on error.
+ */
+struct hal_spi *
+nrf52_spi_create(int spi_num, const struct nrf52_spi_cfg *cfg)
+{
+    struct nrf52_hal_spi *spi;
+    NRF_SPIM_Type *regs;
+
+    if (spi_num < 0 ||
+      spi_num >= (int)(sizeof(nrf52_spis) / sizeof(nrf52_spis[0]))) {
+        return NULL;
+    }
+    spi = &nrf52_spis[spi_num];
+    regs = spi->regs;
+
+    regs->ENABLE = 0;
+    hal_gpio_init_out(cfg->ssc_pin_sck, 0);
+    hal_gpio_init_out(cfg->ssc_pin_mosi, 0);
+    hal_gpio_init_in(cfg->ssc_pin_miso, GPIO_PULL_NONE);
+    regs->PSEL.SCK = cfg->ssc_pin_sck;
+    regs->PSEL.MOSI = cfg->ssc_pin_mosi;
+    regs->PSEL.MISO = cfg->ssc_pin_miso;
+    regs->CONFIG = 0;
+    regs->FREQUENCY = SPIM_FREQUENCY_FREQUENCY_M1;
+    regs->ORC = 0xff;
+    regs->INTENCLR = SPIM_INTENSET_END_Msk;
+    regs->ENABLE = SPIM_ENABLE_ENABLE_Enabled;
+
+    NVIC_SetVector(spi->irqn, (uint32_t)spi->isr);
+    NVIC_EnableIRQ(spi->irqn);
+
+    spi->parent.driver_api = &nrf52_spi_funcs;
+    spi->busy = 0;
+    return &spi->parent;
+}
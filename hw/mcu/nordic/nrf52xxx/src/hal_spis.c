@@ -0,0 +1,225 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stddef.h>
+#include "hal/hal_spi.h"
+#include "hal/hal_spi_int.h"
+#include "hal/hal_gpio.h"
+#include "bsp/cmsis_nvic.h"
+
+#include "mcu/nrf.h"
+#include "mcu/nrf52_hal.h"
+
+/* RXD.MAXCNT and TXD.MAXCNT are 8 bits wide on nRF52832. */
+#define NRF52_SPIS_DMA_MAXCNT   255
+
+/* SEMSTAT value when the CPU owns the buffers. */
+#define NRF52_SPIS_SEMSTAT_CPU  1
+
+struct nrf52_hal_spis {
+    struct hal_spi parent;
+    NRF_SPIS_Type *regs;
+    IRQn_Type irqn;
+    void (*isr)(void);
+    hal_spi_txrx_cb cb;
+    void *arg;
+};
+
+static int nrf52_spis_config(struct hal_spi *pspi,
+                             struct hal_spi_settings *psettings);
+static int nrf52_spis_slave_txrx(struct hal_spi *pspi, void *txbuf,
+                                 int txlen, void *rxbuf, int rxlen,
+                                 hal_spi_txrx_cb cb, void *arg);
+
+static const struct hal_spi_funcs nrf52_spis_funcs = {
+    .hspi_config = nrf52_spis_config,
+    .hspi_slave_txrx = nrf52_spis_slave_txrx,
+};
+
+static void nrf52_spis0_irq(void);
+static void nrf52_spis1_irq(void);
+static void nrf52_spis2_irq(void);
+
+static struct nrf52_hal_spis nrf52_spiss[] = {
+    [0] = {
+        .regs = NRF_SPIS0,
+        .irqn = SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn,
+        .isr = nrf52_spis0_irq
+    },
+    [1] = {
+        .regs = NRF_SPIS1,
+        .irqn = SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn,
+        .isr = nrf52_spis1_irq
+    },
+    [2] = {
+        .regs = NRF_SPIS2,
+        .irqn = SPIM2_SPIS2_SPI2_IRQn,
+        .isr = nrf52_spis2_irq
+    }
+};
+
+/*
+ * Baudrate is set by the master; only mode and bit order apply.
+ */
+static int
+nrf52_spis_config(struct hal_spi *pspi, struct hal_spi_settings *psettings)
+{
+    struct nrf52_hal_spis *spis = (struct nrf52_hal_spis *)pspi;
+    uint32_t cfg;
+
+    if (psettings->word_size != HAL_SPI_WORD_SIZE_8BIT) {
+        return -1;
+    }
+
+    cfg = 0;
+    switch (psettings->data_mode) {
+    case HAL_SPI_MODE0:
+        break;
+    case HAL_SPI_MODE1:
+        cfg |= SPIS_CONFIG_CPHA_Trailing << SPIS_CONFIG_CPHA_Pos;
+        break;
+    case HAL_SPI_MODE2:
+        cfg |= SPIS_CONFIG_CPOL_ActiveLow << SPIS_CONFIG_CPOL_Pos;
+        break;
+    case HAL_SPI_MODE3:
+        cfg |= (SPIS_CONFIG_CPOL_ActiveLow << SPIS_CONFIG_CPOL_Pos) |
+          (SPIS_CONFIG_CPHA_Trailing << SPIS_CONFIG_CPHA_Pos);
+        break;
+    default:
+        return -1;
+    }
+    if (psettings->data_order == HAL_SPI_LSB_FIRST) {
+        cfg |= SPIS_CONFIG_ORDER_LsbFirst << SPIS_CONFIG_ORDER_Pos;
+    }
+
+    spis->regs->CONFIG = cfg;
+    return 0;
+}
+
+/*
+ * The CPU must hold the SPIS semaphore while it sets the buffers. The
+ * END_ACQUIRE shortcut hands it back after every transfer, so this normally
+ * doesn't wait; releasing the semaphore makes the buffers available to the
+ * master.
+ */
+static int
+nrf52_spis_slave_txrx(struct hal_spi *pspi, void *txbuf, int txlen,
+                      void *rxbuf, int rxlen, hal_spi_txrx_cb cb, void *arg)
+{
+    struct nrf52_hal_spis *spis = (struct nrf52_hal_spis *)pspi;
+    NRF_SPIS_Type *regs = spis->regs;
+
+    if (txlen > NRF52_SPIS_DMA_MAXCNT || rxlen > NRF52_SPIS_DMA_MAXCNT) {
+        return -1;
+    }
+
+    if (regs->SEMSTAT != NRF52_SPIS_SEMSTAT_CPU) {
+        regs->EVENTS_ACQUIRED = 0;
+        regs->TASKS_ACQUIRE = 1;
+        while (regs->EVENTS_ACQUIRED == 0) {
+        }
+    }
+    regs->EVENTS_ACQUIRED = 0;
+
+    spis->cb = cb;
+    spis->arg = arg;
+
+    regs->TXD.PTR = (uint32_t)txbuf;
+    regs->TXD.MAXCNT = txbuf ? txlen : 0;
+    regs->RXD.PTR = (uint32_t)rxbuf;
+    regs->RXD.MAXCNT = rxbuf ? rxlen : 0;
+    regs->STATUS = SPIS_STATUS_OVERREAD_Msk | SPIS_STATUS_OVERFLOW_Msk;
+    regs->TASKS_RELEASE = 1;
+    return 0;
+}
+
+static void
+nrf52_spis_irq_handler(struct nrf52_hal_spis *spis)
+{
+    if (spis->regs->EVENTS_END == 0) {
+        return;
+    }
+    spis->regs->EVENTS_END = 0;
+    if (spis->cb) {
+        spis->cb(spis->arg, spis->regs->RXD.AMOUNT);
+    }
+}
+
+static void
+nrf52_spis0_irq(void)
+{
+    nrf52_spis_irq_handler(&nrf52_spiss[0]);
+}
+
+static void
+nrf52_spis1_irq(void)
+{
+    nrf52_spis_irq_handler(&nrf52_spiss[1]);
+}
+
+static void
+nrf52_spis2_irq(void)
+{
+    nrf52_spis_irq_handler(&nrf52_spiss[2]);
+}
+
+/*
+ * Sets up SPIS instance spi_num as slave on the given pins. Default
+ * configuration is mode 0, MSB first. Until the first call to
+ * hal_spi_slave_txrx(), transfers from the master are ignored, and 0xff is
+ * sent. Returns NULL on error.
+ */
+struct hal_spi *
+nrf52_spis_create(int spi_num, const struct nrf52_spis_cfg *cfg)
+{
+    struct nrf52_hal_spis *spis;
+    NRF_SPIS_Type *regs;
+
+    if (spi_num < 0 ||
+      spi_num >= (int)(sizeof(nrf52_spiss) / sizeof(nrf52_spiss[0]))) {
+        return NULL;
+    }
+    spis = &nrf52_spiss[spi_num];
+    regs = spis->regs;
+
+    regs->ENABLE = 0;
+    hal_gpio_init_in(cfg->ssc_pin_sck, GPIO_PULL_NONE);
+    hal_gpio_init_in(cfg->ssc_pin_mosi, GPIO_PULL_NONE);
+    hal_gpio_init_in(cfg->ssc_pin_miso, GPIO_PULL_NONE);
+    hal_gpio_init_in(cfg->ssc_pin_csn, GPIO_PULL_UP);
+    regs->PSEL.SCK = cfg->ssc_pin_sck;
+    regs->PSEL.MOSI = cfg->ssc_pin_mosi;
+    regs->PSEL.MISO = cfg->ssc_pin_miso;
+    regs->PSEL.CSN = cfg->ssc_pin_csn;
+    regs->CONFIG = 0;
+    regs->DEF = 0xff;
+    regs->ORC = 0xff;
+    regs->SHORTS = SPIS_SHORTS_END_ACQUIRE_Msk;
+    regs->INTENCLR = SPIS_INTENSET_ACQUIRED_Msk;
+    regs->INTENSET = SPIS_INTENSET_END_Msk;
+    regs->EVENTS_END = 0;
+    regs->EVENTS_ACQUIRED = 0;
+    regs->ENABLE = SPIS_ENABLE_ENABLE_Enabled;
+
+    NVIC_SetVector(spis->irqn, (uint32_t)spis->isr);
+    NVIC_EnableIRQ(spis->irqn);
+
+    spis->parent.driver_api = &nrf52_spis_funcs;
+    spis->cb = NULL;
+    return &spis->parent;
+}
@@ -18,6 +18,7 @@
  */
 
 #include "hal/hal_uart.h"
+#include "hal/hal_cputime.h"
 #include "bsp/cmsis_nvic.h"
 #include "bsp/bsp.h"
 
@@ -28,11 +29,28 @@
 
 #define UARTE_INT_ENDTX		UARTE_INTEN_ENDTX_Msk
 #define UARTE_INT_ENDRX		UARTE_INTEN_ENDRX_Msk
+#define UARTE_INT_RXTO		UARTE_INTEN_RXTO_Msk
 #define UARTE_CONFIG_PARITY	UARTE_CONFIG_PARITY_Msk
 #define UARTE_CONFIG_HWFC	UARTE_CONFIG_HWFC_Msk
 #define UARTE_ENABLE		UARTE_ENABLE_ENABLE_Enabled
 #define UARTE_DISABLE           UARTE_ENABLE_ENABLE_Disabled
 
+/* RXD.MAXCNT and TXD.MAXCNT are 8 bits wide on nRF52832. */
+#define UARTE_DMA_MAXCNT        255
+
+/*
+ * RXDRDY event of UARTE is missing from nrf52.h.
+ */
+#define UARTE_EVENTS_RXDRDY                                             \
+    (*(volatile uint32_t *)((uint32_t)NRF_UARTE0 + 0x108))
+#define UARTE_INT_RXDRDY        (1UL << 2)
+
+/*
+ * In block mode, a partially filled RX block is handed up once the line
+ * has been idle for this many bit times.
+ */
+#define UARTE_RX_IDLE_BITS      40
+
 /*
  * Only one UART on NRF 52832.
  */
@@ -40,12 +58,18 @@ struct hal_uart {
     uint8_t u_open:1;
     uint8_t u_rx_stall:1;
     uint8_t u_tx_started:1;
+    uint8_t u_block:1;
+    uint8_t u_rx_stopping:1;
     uint8_t u_rx_buf;
     uint8_t u_tx_buf[8];
     hal_uart_rx_char u_rx_func;
     hal_uart_tx_char u_tx_func;
+    hal_uart_rx_block u_rx_block;
+    hal_uart_tx_block u_tx_block;
     hal_uart_tx_done u_tx_done;
     void *u_func_arg;
+    uint32_t u_rx_idle_usecs;
+    struct cpu_timer u_rx_timer;
 };
 static struct hal_uart uart;
 
@@ -66,6 +90,28 @@ hal_uart_init_cbs(int port, hal_uart_tx_char tx_func, hal_uart_tx_done tx_done,
     u->u_tx_func = tx_func;
     u->u_tx_done = tx_done;
     u->u_func_arg = arg;
+    u->u_block = 0;
+    return 0;
+}
+
+int
+hal_uart_init_block_cbs(int port, hal_uart_tx_block tx_func,
+  hal_uart_tx_done tx_done, hal_uart_rx_block rx_func, void *arg)
+{
+    struct hal_uart *u;
+
+    if (port != 0) {
+        return -1;
+    }
+    u = &uart;
+    if (u->u_open) {
+        return -1;
+    }
+    u->u_rx_block = rx_func;
+    u->u_tx_block = tx_func;
+    u->u_tx_done = tx_done;
+    u->u_func_arg = arg;
+    u->u_block = 1;
     return 0;
 }
 
@@ -85,6 +131,107 @@ hal_uart_tx_fill_buf(struct hal_uart *u)
     return i;
 }
 
+/*
+ * Start the next TX DMA transfer. In block mode the data is sent straight
+ * out of the buffer handed out by the upper layer; otherwise it is first
+ * gathered into u_tx_buf a byte at a time. tx_len is the number of bytes
+ * sent by the previous transfer.
+ *
+ * Returns 0 if a transfer was started, -1 if there is nothing to send.
+ */
+static int
+hal_uart_tx_next(struct hal_uart *u, int tx_len)
+{
+    uint8_t *ptr;
+    int len;
+
+    if (u->u_block) {
+        len = u->u_tx_block(u->u_func_arg, tx_len, &ptr);
+        if (len > UARTE_DMA_MAXCNT) {
+            len = UARTE_DMA_MAXCNT;
+        }
+    } else {
+        len = hal_uart_tx_fill_buf(u);
+        ptr = u->u_tx_buf;
+    }
+    if (len <= 0) {
+        return -1;
+    }
+    NRF_UARTE0->TXD.PTR = (uint32_t)ptr;
+    NRF_UARTE0->TXD.MAXCNT = len;
+    NRF_UARTE0->TASKS_STARTTX = 1;
+    return 0;
+}
+
+/*
+ * Start the next RX DMA transfer. In block mode the upper layer tells how
+ * many bytes it wants and where they go, so a whole header or payload is
+ * received with a single interrupt. rx_len is the number of bytes received
+ * by the previous block transfer.
+ *
+ * Returns 0 if a transfer was started, -1 if the upper layer stalled RX.
+ */
+static int
+hal_uart_rx_next(struct hal_uart *u, int rx_len)
+{
+    uint8_t *ptr;
+    int len;
+
+    if (u->u_block) {
+        len = u->u_rx_block(u->u_func_arg, rx_len, &ptr);
+        if (len <= 0) {
+            return -1;
+        }
+        if (len > UARTE_DMA_MAXCNT) {
+            len = UARTE_DMA_MAXCNT;
+        }
+    } else {
+        ptr = &u->u_rx_buf;
+        len = sizeof(u->u_rx_buf);
+    }
+    NRF_UARTE0->RXD.PTR = (uint32_t)ptr;
+    NRF_UARTE0->RXD.MAXCNT = len;
+    if (u->u_block) {
+        /*
+         * First byte of the block arms idle timer.
+         */
+        UARTE_EVENTS_RXDRDY = 0;
+        NRF_UARTE0->INTENSET = UARTE_INT_RXDRDY;
+    }
+    if (!u->u_rx_stopping) {
+        NRF_UARTE0->TASKS_STARTRX = 1;
+    }
+    return 0;
+}
+
+/*
+ * Cut the RX block short; ENDRX follows with what was received so far.
+ * Receiver is restarted on RXTO.
+ */
+static void
+hal_uart_rx_idle_stop(struct hal_uart *u)
+{
+    u->u_rx_stopping = 1;
+    NRF_UARTE0->TASKS_STOPRX = 1;
+}
+
+/*
+ * Called by cputime with interrupts disabled. If nothing has arrived since
+ * the previous check, the line is idle.
+ */
+static void
+hal_uart_rx_timer_cb(void *arg)
+{
+    struct hal_uart *u = (struct hal_uart *)arg;
+
+    if (UARTE_EVENTS_RXDRDY) {
+        UARTE_EVENTS_RXDRDY = 0;
+        cputime_timer_relative(&u->u_rx_timer, u->u_rx_idle_usecs);
+    } else {
+        hal_uart_rx_idle_stop(u);
+    }
+}
+
 void
 hal_uart_start_tx(int port)
 {
@@ -98,12 +245,9 @@ hal_uart_start_tx(int port)
     u = &uart;
     __HAL_DISABLE_INTERRUPTS(sr);
     if (u->u_tx_started == 0) {
-        rc = hal_uart_tx_fill_buf(u);
-        if (rc > 0) {
+        rc = hal_uart_tx_next(u, 0);
+        if (rc == 0) {
             NRF_UARTE0->INTENSET = UARTE_INT_ENDTX;
-            NRF_UARTE0->TXD.PTR = (uint32_t)&u->u_tx_buf;
-            NRF_UARTE0->TXD.MAXCNT = rc;
-            NRF_UARTE0->TASKS_STARTTX = 1;
             u->u_tx_started = 1;
         }
     }
@@ -123,10 +267,16 @@ hal_uart_start_rx(int port)
     u = &uart;
     if (u->u_rx_stall) {
         __HAL_DISABLE_INTERRUPTS(sr);
-        rc = u->u_rx_func(u->u_func_arg, u->u_rx_buf);
+        if (u->u_block) {
+            rc = hal_uart_rx_next(u, 0);
+        } else {
+            rc = u->u_rx_func(u->u_func_arg, u->u_rx_buf);
+            if (rc == 0) {
+                NRF_UARTE0->TASKS_STARTRX = 1;
+            }
+        }
         if (rc == 0) {
             u->u_rx_stall = 0;
-            NRF_UARTE0->TASKS_STARTRX = 1;
         }
 
         __HAL_ENABLE_INTERRUPTS(sr);
@@ -174,14 +324,23 @@ uart_irq_handler(void)
     int rc;
 
     u = &uart;
+    if (UARTE_EVENTS_RXDRDY && (NRF_UARTE0->INTEN & UARTE_INT_RXDRDY)) {
+        UARTE_EVENTS_RXDRDY = 0;
+        NRF_UARTE0->INTENCLR = UARTE_INT_RXDRDY;
+        if (g_cputime.ticks_per_usec) {
+            cputime_timer_relative(&u->u_rx_timer, u->u_rx_idle_usecs);
+        } else {
+            /*
+             * No cputime to measure idle time with; hand up data as soon
+             * as it starts arriving.
+             */
+            hal_uart_rx_idle_stop(u);
+        }
+    }
     if (NRF_UARTE0->EVENTS_ENDTX) {
         NRF_UARTE0->EVENTS_ENDTX = 0;
-        rc = hal_uart_tx_fill_buf(u);
-        if (rc > 0) {
-            NRF_UARTE0->TXD.PTR = (uint32_t)&u->u_tx_buf;
-            NRF_UARTE0->TXD.MAXCNT = rc;
-            NRF_UARTE0->TASKS_STARTTX = 1;
-        } else {
+        rc = hal_uart_tx_next(u, NRF_UARTE0->TXD.AMOUNT);
+        if (rc != 0) {
             if (u->u_tx_done) {
                 u->u_tx_done(u->u_func_arg);
             }
@@ -192,10 +351,23 @@ uart_irq_handler(void)
     }
     if (NRF_UARTE0->EVENTS_ENDRX) {
         NRF_UARTE0->EVENTS_ENDRX = 0;
-        rc = u->u_rx_func(u->u_func_arg, u->u_rx_buf);
+        if (u->u_block) {
+            cputime_timer_stop(&u->u_rx_timer);
+            rc = hal_uart_rx_next(u, NRF_UARTE0->RXD.AMOUNT);
+        } else {
+            rc = u->u_rx_func(u->u_func_arg, u->u_rx_buf);
+            if (rc >= 0) {
+                NRF_UARTE0->TASKS_STARTRX = 1;
+            }
+        }
         if (rc < 0) {
             u->u_rx_stall = 1;
-        } else {
+        }
+    }
+    if (NRF_UARTE0->EVENTS_RXTO) {
+        NRF_UARTE0->EVENTS_RXTO = 0;
+        u->u_rx_stopping = 0;
+        if (!u->u_rx_stall) {
             NRF_UARTE0->TASKS_STARTRX = 1;
         }
     }
@@ -312,11 +484,17 @@ hal_uart_config(int port, int32_t baudrate, uint8_t databits, uint8_t stopbits,
     NRF_UARTE0->ENABLE = UARTE_ENABLE;
 
     NRF_UARTE0->INTENSET = UARTE_INT_ENDRX;
-    NRF_UARTE0->RXD.PTR = (uint32_t)&u->u_rx_buf;
-    NRF_UARTE0->RXD.MAXCNT = sizeof(u->u_rx_buf);
-    NRF_UARTE0->TASKS_STARTRX = 1;
-
+    if (u->u_block) {
+        NRF_UARTE0->INTENSET = UARTE_INT_RXTO;
+        u->u_rx_idle_usecs = UARTE_RX_IDLE_BITS * 1000000 / baudrate;
+        cputime_timer_init(&u->u_rx_timer, hal_uart_rx_timer_cb, u);
+    }
+    u->u_rx_stopping = 0;
     u->u_rx_stall = 0;
+    if (hal_uart_rx_next(u, 0) != 0) {
+        u->u_rx_stall = 1;
+    }
+
     u->u_tx_started = 0;
     u->u_open = 1;
 
@@ -334,6 +512,9 @@ hal_uart_close(int port)
         u->u_open = 0;
         NRF_UARTE0->ENABLE = 0;
         NRF_UARTE0->INTENCLR = 0xffffffff;
+        if (u->u_block) {
+            cputime_timer_stop(&u->u_rx_timer);
+        }
         return 0;
     }
     return -1;
@@ -0,0 +1,70 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_MCU_GPIO_
+#define H_MCU_GPIO_
+
+#include "mcu/stm32f4xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 16 pins per port; pin 0 is PA0, pin 16 PB0 and so on. Port register
+ * blocks are 0x400 apart.
+ */
+#define HAL_GPIO_PORT(pin)              (((pin) >> 4) & 0x0F)
+#define HAL_GPIO_PORT_BIT(pin)          ((pin) & 0x0F)
+#define HAL_GPIO_PORT_REGS(pin)                                         \
+    ((GPIO_TypeDef *)(GPIOA_BASE + HAL_GPIO_PORT(pin) * 0x400))
+
+static inline void
+hal_gpio_fast_set(int pin)
+{
+    HAL_GPIO_PORT_REGS(pin)->BSRR = 1UL << HAL_GPIO_PORT_BIT(pin);
+}
+
+static inline void
+hal_gpio_fast_clear(int pin)
+{
+    HAL_GPIO_PORT_REGS(pin)->BSRR = 1UL << (HAL_GPIO_PORT_BIT(pin) + 16);
+}
+
+static inline void
+hal_gpio_fast_write(int pin, int val)
+{
+    if (val) {
+        hal_gpio_fast_set(pin);
+    } else {
+        hal_gpio_fast_clear(pin);
+    }
+}
+
+static inline int
+hal_gpio_fast_read(int pin)
+{
+    return (HAL_GPIO_PORT_REGS(pin)->IDR >> HAL_GPIO_PORT_BIT(pin)) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_MCU_GPIO_ */
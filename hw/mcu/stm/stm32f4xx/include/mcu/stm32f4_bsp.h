@@ -33,14 +33,94 @@ struct stm32f4_uart_cfg {
     int8_t suc_pin_cts;
     uint8_t suc_pin_af;				/* AF selection for this */
     IRQn_Type suc_irqn;				/* NVIC IRQn */
+    /* DMA, for block mode; suc_dma_rx NULL if not used */
+    DMA_Stream_TypeDef *suc_dma_rx;		/* DMA streams */
+    DMA_Stream_TypeDef *suc_dma_tx;
+    uint8_t suc_dma_chan;			/* DMA channel, for both */
+    uint32_t suc_dma_rcc_dev;			/* RCC AHB1 ID of DMA */
+    IRQn_Type suc_dma_rx_irqn;			/* NVIC IRQn of RX stream */
 };
 
 const struct stm32f4_uart_cfg *bsp_uart_config(int port);
 
+/**
+ * BSP specific SPI settings. Transfers use the given DMA streams; check the
+ * DMA request mapping in the reference manual for stream and channel.
+ */
+struct stm32f4_spi_cfg {
+    SPI_TypeDef *ssc_spi;			/* SPI dev registers */
+    volatile uint32_t *ssc_rcc_reg;		/* RCC register to modify */
+    uint32_t ssc_rcc_dev;			/* RCC device ID */
+    int8_t ssc_pin_sck;				/* pins for IO */
+    int8_t ssc_pin_miso;
+    int8_t ssc_pin_mosi;
+    uint8_t ssc_pin_af;				/* AF selection for this */
+    DMA_Stream_TypeDef *ssc_dma_rx;		/* DMA streams */
+    DMA_Stream_TypeDef *ssc_dma_tx;
+    uint8_t ssc_dma_chan;			/* DMA channel, for both */
+    uint32_t ssc_dma_rcc_dev;			/* RCC AHB1 ID of DMA */
+    IRQn_Type ssc_dma_rx_irqn;			/* NVIC IRQn of RX stream */
+};
+
+struct hal_spi;
+struct hal_spi *stm32f4_spi_create(int spi_num,
+  const struct stm32f4_spi_cfg *cfg);
+
+/**
+ * BSP specific ADC settings. One regular channel is converted. Streaming
+ * triggers conversions from TRGO of a timer on APB1, and moves samples
+ * with DMA in double buffer mode.
+ */
+struct stm32f4_adc_cfg {
+    ADC_TypeDef *sac_adc;			/* ADC dev registers */
+    uint32_t sac_rcc_dev;			/* RCC APB2 ID of ADC */
+    int8_t sac_pin;				/* analog input pin */
+    uint8_t sac_chan;				/* ADC channel of the pin */
+    TIM_TypeDef *sac_tim;			/* sample rate timer */
+    uint32_t sac_tim_rcc_dev;			/* RCC APB1 ID of timer */
+    uint8_t sac_extsel;				/* EXTSEL for timer TRGO */
+    DMA_Stream_TypeDef *sac_dma;		/* DMA stream */
+    uint8_t sac_dma_chan;			/* DMA channel */
+    uint32_t sac_dma_rcc_dev;			/* RCC AHB1 ID of DMA */
+    IRQn_Type sac_dma_irqn;			/* NVIC IRQn of stream */
+};
+
+struct hal_adc;
+struct hal_adc *stm32f4_adc_create(int adc_num,
+  const struct stm32f4_adc_cfg *cfg);
+
+/**
+ * BSP specific DAC settings. Streaming triggers conversions from TRGO of a
+ * timer on APB1, and feeds samples with DMA in double buffer mode.
+ */
+struct stm32f4_dac_cfg {
+    uint8_t sdc_chan;				/* 1 (PA4) or 2 (PA5) */
+    TIM_TypeDef *sdc_tim;			/* sample rate timer */
+    uint32_t sdc_tim_rcc_dev;			/* RCC APB1 ID of timer */
+    uint8_t sdc_tsel;				/* TSEL for timer TRGO */
+    DMA_Stream_TypeDef *sdc_dma;		/* DMA stream */
+    uint8_t sdc_dma_chan;			/* DMA channel */
+    uint32_t sdc_dma_rcc_dev;			/* RCC AHB1 ID of DMA */
+    IRQn_Type sdc_dma_irqn;			/* NVIC IRQn of stream */
+};
+
+struct hal_dac;
+struct hal_dac *stm32f4_dac_create(const struct stm32f4_dac_cfg *cfg);
+
 /*
  * Internal API for stm32f4xx mcu specific code.
  */
 int hal_gpio_init_af(int pin, uint8_t af_type, enum gpio_pull pull);
+int hal_gpio_init_analog(int pin);
+
+/* Interrupt flags of a DMA stream, shifted down to bit 0 */
+#define STM32F4_DMA_FLAGS       0x3d
+#define STM32F4_DMA_TCIF        0x20
+#define STM32F4_DMA_ERR         0x0c    /* TEIF, DMEIF */
+uint32_t stm32f4_dma_flags(DMA_Stream_TypeDef *stream);
+void stm32f4_dma_clear(DMA_Stream_TypeDef *stream);
+
+int stm32f4_tim_trgo_start(TIM_TypeDef *tim, uint32_t rate);
 
 struct hal_flash;
 extern struct hal_flash stm32f4_flash_dev;
@@ -0,0 +1,240 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stddef.h>
+#include "hal/hal_adc.h"
+#include "hal/hal_adc_int.h"
+#include "hal/hal_gpio.h"
+#include "bsp/cmsis_nvic.h"
+#include "mcu/stm32f4xx.h"
+#include "mcu/stm32f4_bsp.h"
+
+#define STM32F4_ADC_REF_MV      3300
+#define STM32F4_ADC_BITS        12
+
+/* 84 cycle sample time */
+#define STM32F4_ADC_SMP         4
+
+struct stm32f4_hal_adc {
+    struct hal_adc parent;
+    const struct stm32f4_adc_cfg *cfg;
+    struct hal_adc_stream *st;
+};
+
+static int stm32f4_adc_read(struct hal_adc *padc);
+static int stm32f4_adc_get_bits(struct hal_adc *padc);
+static int stm32f4_adc_get_ref_mv(struct hal_adc *padc);
+static int stm32f4_adc_stream_start(struct hal_adc *padc,
+                                    struct hal_adc_stream *st);
+static int stm32f4_adc_stream_stop(struct hal_adc *padc);
+
+static const struct hal_adc_funcs stm32f4_adc_funcs = {
+    .hadc_read = stm32f4_adc_read,
+    .hadc_get_bits = stm32f4_adc_get_bits,
+    .hadc_get_ref_mv = stm32f4_adc_get_ref_mv,
+    .hadc_stream_start = stm32f4_adc_stream_start,
+    .hadc_stream_stop = stm32f4_adc_stream_stop,
+};
+
+static void stm32f4_adc0_irq(void);
+static void stm32f4_adc1_irq(void);
+static void stm32f4_adc2_irq(void);
+
+static struct stm32f4_hal_adc stm32f4_adcs[3];
+static void (* const stm32f4_adc_irqs[3])(void) = {
+    stm32f4_adc0_irq, stm32f4_adc1_irq, stm32f4_adc2_irq
+};
+
+static int
+stm32f4_adc_get_bits(struct hal_adc *padc)
+{
+    return STM32F4_ADC_BITS;
+}
+
+static int
+stm32f4_adc_get_ref_mv(struct hal_adc *padc)
+{
+    return STM32F4_ADC_REF_MV;
+}
+
+static int
+stm32f4_adc_read(struct hal_adc *padc)
+{
+    struct stm32f4_hal_adc *adc = (struct stm32f4_hal_adc *)padc;
+    ADC_TypeDef *regs = adc->cfg->sac_adc;
+
+    if (adc->st) {
+        return -1;
+    }
+    regs->SR = 0;
+    regs->CR2 |= ADC_CR2_SWSTART;
+    while ((regs->SR & ADC_SR_EOC) == 0) {
+    }
+    return regs->DR;
+}
+
+static int
+stm32f4_adc_stream_start(struct hal_adc *padc, struct hal_adc_stream *st)
+{
+    struct stm32f4_hal_adc *adc = (struct stm32f4_hal_adc *)padc;
+    const struct stm32f4_adc_cfg *cfg = adc->cfg;
+    ADC_TypeDef *regs = cfg->sac_adc;
+    DMA_Stream_TypeDef *dma = cfg->sac_dma;
+
+    if (adc->st) {
+        return -1;
+    }
+    adc->st = st;
+
+    /*
+     * Both buffers are handed to DMA; CT tells which one is being filled.
+     */
+    dma->CR = 0;
+    while (dma->CR & DMA_SxCR_EN) {
+    }
+    stm32f4_dma_clear(dma);
+    dma->PAR = (uint32_t)&regs->DR;
+    dma->M0AR = (uint32_t)st->bufs[0];
+    dma->M1AR = (uint32_t)st->bufs[1];
+    dma->NDTR = st->buf_cnt;
+    dma->FCR = 0;
+    dma->CR = (cfg->sac_dma_chan * DMA_SxCR_CHSEL_0) | DMA_SxCR_DBM |
+      DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC |
+      DMA_SxCR_CIRC | DMA_SxCR_TCIE;
+    dma->CR |= DMA_SxCR_EN;
+
+    regs->SR = 0;
+    regs->CR2 = ADC_CR2_ADON | ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_EXTEN_0 |
+      (cfg->sac_extsel * ADC_CR2_EXTSEL_0);
+
+    if (stm32f4_tim_trgo_start(cfg->sac_tim, st->rate)) {
+        stm32f4_adc_stream_stop(padc);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+stm32f4_adc_stream_stop(struct hal_adc *padc)
+{
+    struct stm32f4_hal_adc *adc = (struct stm32f4_hal_adc *)padc;
+    const struct stm32f4_adc_cfg *cfg = adc->cfg;
+
+    if (!adc->st) {
+        return -1;
+    }
+    cfg->sac_tim->CR1 = 0;
+    cfg->sac_adc->CR2 = ADC_CR2_ADON;
+    cfg->sac_dma->CR &= ~DMA_SxCR_EN;
+    while (cfg->sac_dma->CR & DMA_SxCR_EN) {
+    }
+    stm32f4_dma_clear(cfg->sac_dma);
+    NVIC_ClearPendingIRQ(cfg->sac_dma_irqn);
+    adc->st = NULL;
+    return 0;
+}
+
+static void
+stm32f4_adc_irq_handler(struct stm32f4_hal_adc *adc)
+{
+    DMA_Stream_TypeDef *dma = adc->cfg->sac_dma;
+    struct hal_adc_stream *st;
+    uint32_t flags;
+    int16_t *buf;
+
+    flags = stm32f4_dma_flags(dma);
+    stm32f4_dma_clear(dma);
+    st = adc->st;
+    if (!st || !(flags & STM32F4_DMA_TCIF)) {
+        return;
+    }
+
+    /* DMA has moved on to the other buffer. */
+    if (dma->CR & DMA_SxCR_CT) {
+        buf = st->bufs[0];
+    } else {
+        buf = st->bufs[1];
+    }
+    hal_adc_stream_done(st, buf);
+}
+
+static void
+stm32f4_adc0_irq(void)
+{
+    stm32f4_adc_irq_handler(&stm32f4_adcs[0]);
+}
+
+static void
+stm32f4_adc1_irq(void)
+{
+    stm32f4_adc_irq_handler(&stm32f4_adcs[1]);
+}
+
+static void
+stm32f4_adc2_irq(void)
+{
+    stm32f4_adc_irq_handler(&stm32f4_adcs[2]);
+}
+
+/*
+ * Sets up ADC number adc_num (0-2, ADC1-ADC3) to convert a single channel
+ * at 12 bits. Returns NULL on error.
+ */
+struct hal_adc *
+stm32f4_adc_create(int adc_num, const struct stm32f4_adc_cfg *cfg)
+{
+    struct stm32f4_hal_adc *adc;
+    ADC_TypeDef *regs = cfg->sac_adc;
+
+    if (adc_num < 0 ||
+      adc_num >= (int)(sizeof(stm32f4_adcs) / sizeof(stm32f4_adcs[0])) ||
+      cfg->sac_chan > 18) {
+        return NULL;
+    }
+    adc = &stm32f4_adcs[adc_num];
+
+    RCC->APB2ENR |= cfg->sac_rcc_dev;
+    RCC->APB1ENR |= cfg->sac_tim_rcc_dev;
+    RCC->AHB1ENR |= cfg->sac_dma_rcc_dev;
+    if (hal_gpio_init_analog(cfg->sac_pin)) {
+        return NULL;
+    }
+
+    /* ADC clock is PCLK2 / 4; at most 36MHz. */
+    ADC->CCR = (ADC->CCR & ~ADC_CCR_ADCPRE) | ADC_CCR_ADCPRE_0;
+
+    regs->CR2 = 0;
+    regs->CR1 = 0;
+    if (cfg->sac_chan < 10) {
+        regs->SMPR2 = STM32F4_ADC_SMP << (cfg->sac_chan * 3);
+    } else {
+        regs->SMPR1 = STM32F4_ADC_SMP << ((cfg->sac_chan - 10) * 3);
+    }
+    regs->SQR1 = 0;                             /* one conversion */
+    regs->SQR3 = cfg->sac_chan;
+    regs->CR2 = ADC_CR2_ADON;
+
+    NVIC_SetVector(cfg->sac_dma_irqn, (uint32_t)stm32f4_adc_irqs[adc_num]);
+    NVIC_EnableIRQ(cfg->sac_dma_irqn);
+
+    adc->cfg = cfg;
+    adc->st = NULL;
+    adc->parent.driver_api = &stm32f4_adc_funcs;
+    return &adc->parent;
+}
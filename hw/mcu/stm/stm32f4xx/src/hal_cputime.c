@@ -57,6 +57,60 @@ cputime_set_ocmp(struct cpu_timer *timer)
     }
 }
 
+/*
+ * Compare channels 1-3 of TIM5 are dedicated output compares 1-3; channel 4
+ * is the shared cputime output compare.
+ */
+#define CPUTIME_NUM_OCMP    (4)
+
+static volatile uint32_t * const cputime_ccr[CPUTIME_NUM_OCMP] = {
+    &TIM5->CCR4, &TIM5->CCR1, &TIM5->CCR2, &TIM5->CCR3
+};
+static const uint32_t cputime_ccie[CPUTIME_NUM_OCMP] = {
+    TIM_DIER_CC4IE, TIM_DIER_CC1IE, TIM_DIER_CC2IE, TIM_DIER_CC3IE
+};
+static const uint32_t cputime_ccif[CPUTIME_NUM_OCMP] = {
+    TIM_SR_CC4IF, TIM_SR_CC1IF, TIM_SR_CC2IF, TIM_SR_CC3IF
+};
+static const uint32_t cputime_ccg[CPUTIME_NUM_OCMP] = {
+    TIM_EGR_CC4G, TIM_EGR_CC1G, TIM_EGR_CC2G, TIM_EGR_CC3G
+};
+
+int
+cputime_hw_num_ocmp(void)
+{
+    return CPUTIME_NUM_OCMP;
+}
+
+/**
+ * cputime hw set ocmp
+ *
+ * Set a dedicated output compare channel to the desired cputime.
+ *
+ * NOTE: Must be called with interrupts disabled.
+ *
+ * @param ocmp      Output compare channel (1 - 3)
+ * @param cputime   The cputime at which the channel should fire.
+ */
+void
+cputime_hw_set_ocmp(int ocmp, uint32_t cputime)
+{
+    TIM5->DIER &= ~cputime_ccie[ocmp];
+    *cputime_ccr[ocmp] = cputime;
+    TIM5->SR = ~cputime_ccif[ocmp];
+    TIM5->DIER |= cputime_ccie[ocmp];
+    if ((int32_t)(TIM5->CNT - cputime) >= 0) {
+        /* Force interrupt to occur as we may have missed it */
+        TIM5->EGR = cputime_ccg[ocmp];
+    }
+}
+
+void
+cputime_hw_disable_ocmp(int ocmp)
+{
+    TIM5->DIER &= ~cputime_ccie[ocmp];
+}
+
 /**
  * tim5 isr
  *
@@ -67,6 +121,7 @@ static void
 cputime_isr(void)
 {
     uint32_t sr;
+    int i;
 
     /* Clear the interrupt sources */
     sr = TIM5->SR;
@@ -88,6 +143,14 @@ cputime_isr(void)
             cputime_chk_expiration();
         }
     }
+
+    /* Dedicated output compares */
+    for (i = 1; i < CPUTIME_NUM_OCMP; i++) {
+        if ((sr & cputime_ccif[i]) && (TIM5->DIER & cputime_ccie[i])) {
+            ++g_cputime.ocmp_ints;
+            cputime_chk_ocmp_expiration(i);
+        }
+    }
 }
 
 /**
@@ -153,8 +216,9 @@ cputime_hw_init(uint32_t clock_freq)
     TIM5->CR2 = 0;
     TIM5->SMCR = 0;
 
-    /* Configure compare 4 mode register */
-    TIM5->CCMR2 = TIM5->CCMR2 & 0xFF;
+    /* Configure compare mode registers; all channels are frozen outputs */
+    TIM5->CCMR1 = 0;
+    TIM5->CCMR2 = 0;
 
     /* Set the auto-reload to 0xFFFFFFFF */
     TIM5->ARR = 0xFFFFFFFF;
@@ -164,7 +228,8 @@ cputime_hw_init(uint32_t clock_freq)
     TIM5->EGR |= TIM_EGR_UG;
 
     /* Clear overflow and compare interrupt flags */
-    TIM5->SR = ~(TIM_SR_CC4IF | TIM_SR_UIF);
+    TIM5->SR = ~(TIM_SR_CC1IF | TIM_SR_CC2IF | TIM_SR_CC3IF | TIM_SR_CC4IF |
+                 TIM_SR_UIF);
 
     /* Set isr in vector table and enable interrupt */
     NVIC_SetVector(TIM5_IRQn, (uint32_t)cputime_isr);
@@ -0,0 +1,77 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "hal/hal_crypto.h"
+#include "mcu/stm32f4xx.h"
+
+/*
+ * The CRYP unit only exists on the STM32F415/417 family; the parts
+ * supported here (STM32F407) have the RNG only.
+ */
+int
+hal_crypto_aes128_enc(const uint8_t *key, const uint8_t *in, uint8_t *out)
+{
+    return -1;
+}
+
+/*
+ * RNG is clocked from PLL48CLK; if that is not running, the clock error
+ * flag gets set and we report failure.
+ */
+int
+hal_crypto_rng(void *buf, int len)
+{
+    uint8_t *p;
+    uint32_t val;
+    int cnt;
+    int first;
+
+    first = 0;
+    if ((RNG->CR & RNG_CR_RNGEN) == 0) {
+        RCC->AHB2ENR |= RCC_AHB2ENR_RNGEN;
+        RNG->CR |= RNG_CR_RNGEN;
+        first = 1;
+    }
+
+    p = buf;
+    while (len > 0) {
+        while ((RNG->SR & RNG_SR_DRDY) == 0) {
+            if (RNG->SR & (RNG_SR_SECS | RNG_SR_CECS)) {
+                /*
+                 * Seed error: restart the generator, and let caller retry.
+                 */
+                RNG->CR &= ~RNG_CR_RNGEN;
+                RNG->SR = 0;
+                return -1;
+            }
+        }
+        val = RNG->DR;
+        if (first) {
+            /* First word after enable is not to be used (FIPS 140-2). */
+            first = 0;
+            continue;
+        }
+        cnt = len < (int)sizeof(val) ? len : (int)sizeof(val);
+        memcpy(p, &val, cnt);
+        p += cnt;
+        len -= cnt;
+    }
+    return 0;
+}
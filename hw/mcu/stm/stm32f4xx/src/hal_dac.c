@@ -0,0 +1,258 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stddef.h>
+#include "hal/hal_dac.h"
+#include "hal/hal_dac_int.h"
+#include "hal/hal_gpio.h"
+#include "bsp/cmsis_nvic.h"
+#include "mcu/stm32f4xx.h"
+#include "mcu/stm32f4_bsp.h"
+
+#define STM32F4_DAC_REF_MV      3300
+#define STM32F4_DAC_BITS        12
+#define STM32F4_DAC_MAX         ((1 << STM32F4_DAC_BITS) - 1)
+
+struct stm32f4_hal_dac {
+    struct hal_dac parent;
+    const struct stm32f4_dac_cfg *cfg;
+    volatile uint32_t *dhr;             /* 12-bit right aligned data */
+    volatile uint32_t *dor;
+    uint8_t shift;                      /* of channel bits in CR */
+    struct hal_dac_stream *st;
+};
+
+static int stm32f4_dac_write(struct hal_dac *pdac, int val);
+static int stm32f4_dac_current(struct hal_dac *pdac);
+static int stm32f4_dac_disable(struct hal_dac *pdac);
+static int stm32f4_dac_get_bits(struct hal_dac *pdac);
+static int stm32f4_dac_get_ref_mv(struct hal_dac *pdac);
+static int stm32f4_dac_stream_start(struct hal_dac *pdac,
+                                    struct hal_dac_stream *st);
+static int stm32f4_dac_stream_stop(struct hal_dac *pdac);
+
+static const struct hal_dac_funcs stm32f4_dac_funcs = {
+    .hdac_write = stm32f4_dac_write,
+    .hdac_current = stm32f4_dac_current,
+    .hdac_disable = stm32f4_dac_disable,
+    .hdac_get_bits = stm32f4_dac_get_bits,
+    .hdac_get_ref_mv = stm32f4_dac_get_ref_mv,
+    .hdac_stream_start = stm32f4_dac_stream_start,
+    .hdac_stream_stop = stm32f4_dac_stream_stop,
+};
+
+static void stm32f4_dac1_irq(void);
+static void stm32f4_dac2_irq(void);
+
+/* Channel 1 outputs on PA4, channel 2 on PA5. */
+static struct stm32f4_hal_dac stm32f4_dacs[2];
+static const int8_t stm32f4_dac_pins[2] = { 4, 5 };
+static void (* const stm32f4_dac_irqs[2])(void) = {
+    stm32f4_dac1_irq, stm32f4_dac2_irq
+};
+
+static int
+stm32f4_dac_get_bits(struct hal_dac *pdac)
+{
+    return STM32F4_DAC_BITS;
+}
+
+static int
+stm32f4_dac_get_ref_mv(struct hal_dac *pdac)
+{
+    return STM32F4_DAC_REF_MV;
+}
+
+static int
+stm32f4_dac_write(struct hal_dac *pdac, int val)
+{
+    struct stm32f4_hal_dac *dac = (struct stm32f4_hal_dac *)pdac;
+
+    if (dac->st || val < 0) {
+        return -1;
+    }
+    if (val > STM32F4_DAC_MAX) {
+        val = STM32F4_DAC_MAX;
+    }
+    *dac->dhr = val;
+    DAC->CR = (DAC->CR & ~(0xffff << dac->shift)) | (DAC_CR_EN1 << dac->shift);
+    return 0;
+}
+
+static int
+stm32f4_dac_current(struct hal_dac *pdac)
+{
+    struct stm32f4_hal_dac *dac = (struct stm32f4_hal_dac *)pdac;
+
+    return *dac->dor;
+}
+
+static int
+stm32f4_dac_disable(struct hal_dac *pdac)
+{
+    struct stm32f4_hal_dac *dac = (struct stm32f4_hal_dac *)pdac;
+
+    if (dac->st) {
+        return -1;
+    }
+    DAC->CR &= ~(0xffff << dac->shift);
+    return 0;
+}
+
+/*
+ * Each timer update triggers a transfer from DHR to DOR, and a DMA request
+ * to load the next sample into DHR. DMA runs in double buffer mode; CT
+ * tells which buffer is being played.
+ */
+static int
+stm32f4_dac_stream_start(struct hal_dac *pdac, struct hal_dac_stream *st)
+{
+    struct stm32f4_hal_dac *dac = (struct stm32f4_hal_dac *)pdac;
+    const struct stm32f4_dac_cfg *cfg = dac->cfg;
+    DMA_Stream_TypeDef *dma = cfg->sdc_dma;
+
+    if (dac->st) {
+        return -1;
+    }
+    dac->st = st;
+
+    dma->CR = 0;
+    while (dma->CR & DMA_SxCR_EN) {
+    }
+    stm32f4_dma_clear(dma);
+    dma->PAR = (uint32_t)dac->dhr;
+    dma->M0AR = (uint32_t)st->bufs[0];
+    dma->M1AR = (uint32_t)st->bufs[1];
+    dma->NDTR = st->buf_cnt;
+    dma->FCR = 0;
+    dma->CR = (cfg->sdc_dma_chan * DMA_SxCR_CHSEL_0) | DMA_SxCR_DBM |
+      DMA_SxCR_PL_1 | DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0 | DMA_SxCR_MINC |
+      DMA_SxCR_CIRC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE;
+    dma->CR |= DMA_SxCR_EN;
+
+    DAC->SR = DAC_SR_DMAUDR1 << dac->shift;
+    DAC->CR = (DAC->CR & ~(0xffff << dac->shift)) |
+      ((DAC_CR_EN1 | DAC_CR_TEN1 | DAC_CR_DMAEN1 |
+        (cfg->sdc_tsel * DAC_CR_TSEL1_0)) << dac->shift);
+
+    if (stm32f4_tim_trgo_start(cfg->sdc_tim, st->rate)) {
+        stm32f4_dac_stream_stop(pdac);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+stm32f4_dac_stream_stop(struct hal_dac *pdac)
+{
+    struct stm32f4_hal_dac *dac = (struct stm32f4_hal_dac *)pdac;
+    const struct stm32f4_dac_cfg *cfg = dac->cfg;
+
+    if (!dac->st) {
+        return -1;
+    }
+    cfg->sdc_tim->CR1 = 0;
+    cfg->sdc_dma->CR &= ~DMA_SxCR_EN;
+    while (cfg->sdc_dma->CR & DMA_SxCR_EN) {
+    }
+    stm32f4_dma_clear(cfg->sdc_dma);
+    NVIC_ClearPendingIRQ(cfg->sdc_dma_irqn);
+
+    /* Without the trigger, DHR goes to the output as is. */
+    DAC->CR = (DAC->CR & ~(0xffff << dac->shift)) | (DAC_CR_EN1 << dac->shift);
+    dac->st = NULL;
+    return 0;
+}
+
+static void
+stm32f4_dac_irq_handler(struct stm32f4_hal_dac *dac)
+{
+    DMA_Stream_TypeDef *dma = dac->cfg->sdc_dma;
+    struct hal_dac_stream *st;
+    uint32_t flags;
+    uint16_t *buf;
+
+    flags = stm32f4_dma_flags(dma);
+    stm32f4_dma_clear(dma);
+    st = dac->st;
+    if (!st || !(flags & STM32F4_DMA_TCIF)) {
+        return;
+    }
+
+    /* DMA has moved on to the other buffer. */
+    if (dma->CR & DMA_SxCR_CT) {
+        buf = st->bufs[0];
+    } else {
+        buf = st->bufs[1];
+    }
+    hal_dac_stream_done(st, buf);
+}
+
+static void
+stm32f4_dac1_irq(void)
+{
+    stm32f4_dac_irq_handler(&stm32f4_dacs[0]);
+}
+
+static void
+stm32f4_dac2_irq(void)
+{
+    stm32f4_dac_irq_handler(&stm32f4_dacs[1]);
+}
+
+/*
+ * Sets up DAC channel cfg->sdc_chan (1 or 2), output buffer on. Returns
+ * NULL on error.
+ */
+struct hal_dac *
+stm32f4_dac_create(const struct stm32f4_dac_cfg *cfg)
+{
+    struct stm32f4_hal_dac *dac;
+    int idx;
+
+    if (cfg->sdc_chan < 1 || cfg->sdc_chan > 2) {
+        return NULL;
+    }
+    idx = cfg->sdc_chan - 1;
+    dac = &stm32f4_dacs[idx];
+
+    RCC->APB1ENR |= RCC_APB1ENR_DACEN | cfg->sdc_tim_rcc_dev;
+    RCC->AHB1ENR |= cfg->sdc_dma_rcc_dev;
+    if (hal_gpio_init_analog(stm32f4_dac_pins[idx])) {
+        return NULL;
+    }
+
+    dac->cfg = cfg;
+    dac->st = NULL;
+    if (idx == 0) {
+        dac->dhr = &DAC->DHR12R1;
+        dac->dor = &DAC->DOR1;
+    } else {
+        dac->dhr = &DAC->DHR12R2;
+        dac->dor = &DAC->DOR2;
+    }
+    dac->shift = idx * 16;
+    DAC->CR &= ~(0xffff << dac->shift);
+
+    NVIC_SetVector(cfg->sdc_dma_irqn, (uint32_t)stm32f4_dac_irqs[idx]);
+    NVIC_EnableIRQ(cfg->sdc_dma_irqn);
+
+    dac->parent.driver_api = &stm32f4_dac_funcs;
+    return &dac->parent;
+}
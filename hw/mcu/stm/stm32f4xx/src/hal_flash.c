@@ -24,18 +24,24 @@
 #include "hal/hal_flash_int.h"
 
 static int stm32f4_flash_read(uint32_t address, void *dst, uint32_t num_bytes);
+static const void *stm32f4_flash_mmap(uint32_t address, uint32_t num_bytes);
 static int stm32f4_flash_write(uint32_t address, const void *src,
   uint32_t num_bytes);
 static int stm32f4_flash_erase_sector(uint32_t sector_address);
+static int stm32f4_flash_erase_sector_start(uint32_t sector_address);
+static int stm32f4_flash_busy(void);
 static int stm32f4_flash_sector_info(int idx, uint32_t *address, uint32_t *sz);
 static int stm32f4_flash_init(void);
 
 static const struct hal_flash_funcs stm32f4_flash_funcs = {
     .hff_read = stm32f4_flash_read,
+    .hff_mmap = stm32f4_flash_mmap,
     .hff_write = stm32f4_flash_write,
     .hff_erase_sector = stm32f4_flash_erase_sector,
     .hff_sector_info = stm32f4_flash_sector_info,
-    .hff_init = stm32f4_flash_init
+    .hff_init = stm32f4_flash_init,
+    .hff_erase_sector_start = stm32f4_flash_erase_sector_start,
+    .hff_busy = stm32f4_flash_busy
 };
 
 static const uint32_t stm32f4_flash_sectors[] = {
@@ -73,6 +79,12 @@ stm32f4_flash_read(uint32_t address, void *dst, uint32_t num_bytes)
     return 0;
 }
 
+static const void *
+stm32f4_flash_mmap(uint32_t address, uint32_t num_bytes)
+{
+    return (const void *)address;
+}
+
 static int
 stm32f4_flash_write(uint32_t address, const void *src, uint32_t num_bytes)
 {
@@ -98,20 +110,31 @@ stm32f4_flash_write(uint32_t address, const void *src, uint32_t num_bytes)
     return 0;
 }
 
+/*
+ * Clears the sector erase request once the controller has finished with it.
+ */
 static void
-stm32f4_flash_erase_sector_id(int sector_id)
+stm32f4_flash_erase_done(void)
 {
-    FLASH_Erase_Sector(sector_id, FLASH_VOLTAGE_RANGE_1);
+    FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
 }
 
 static int
-stm32f4_flash_erase_sector(uint32_t sector_address)
+stm32f4_flash_erase_sector_start(uint32_t sector_address)
 {
     int i;
 
     for (i = 0; i < STM32F4_FLASH_NUM_AREAS - 1; i++) {
         if (stm32f4_flash_sectors[i] == sector_address) {
-            stm32f4_flash_erase_sector_id(i);
+            /*
+             * Wait for any previous operation before reprogramming the
+             * control register.
+             */
+            if (FLASH_WaitForLastOperation(HAL_MAX_DELAY) != HAL_OK) {
+                return -1;
+            }
+            stm32f4_flash_erase_done();
+            FLASH_Erase_Sector(i, FLASH_VOLTAGE_RANGE_1);
             return 0;
         }
     }
@@ -119,6 +142,32 @@ stm32f4_flash_erase_sector(uint32_t sector_address)
     return -1;
 }
 
+static int
+stm32f4_flash_busy(void)
+{
+    if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_BSY) != RESET) {
+        return 1;
+    }
+    stm32f4_flash_erase_done();
+    return 0;
+}
+
+static int
+stm32f4_flash_erase_sector(uint32_t sector_address)
+{
+    int rc;
+
+    rc = stm32f4_flash_erase_sector_start(sector_address);
+    if (rc != 0) {
+        return rc;
+    }
+    if (FLASH_WaitForLastOperation(HAL_MAX_DELAY) != HAL_OK) {
+        rc = -1;
+    }
+    stm32f4_flash_erase_done();
+    return rc;
+}
+
 static int
 stm32f4_flash_sector_info(int idx, uint32_t *address, uint32_t *sz)
 {
@@ -459,6 +459,24 @@ hal_gpio_init_af(int pin, uint8_t af_type, enum gpio_pull pull)
     return hal_gpio_init(pin, &gpio);
 }
 
+/**
+ * gpio init analog
+ *
+ * Configure the specified pin as analog input, for ADC.
+ */
+int
+hal_gpio_init_analog(int pin)
+{
+    GPIO_InitTypeDef gpio;
+
+    gpio.Mode = GPIO_MODE_ANALOG;
+    gpio.Speed = GPIO_SPEED_LOW;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Alternate = 0;
+
+    return hal_gpio_init(pin, &gpio);
+}
+
 /**
  * gpio set
  *
@@ -545,6 +563,35 @@ int hal_gpio_toggle(int pin)
     return pin_state;
 }
 
+/**
+ * gpio port read
+ *
+ * Port 0 is GPIOA, 1 is GPIOB and so on.
+ */
+uint32_t
+hal_gpio_port_read(int port)
+{
+    if (port >= HAL_GPIO_NUM_PORTS) {
+        return 0;
+    }
+    return portmap[port]->IDR;
+}
+
+/**
+ * gpio port write
+ *
+ * All pins in mask change at the same time.
+ */
+void
+hal_gpio_port_write(int port, uint32_t mask, uint32_t val)
+{
+    if (port >= HAL_GPIO_NUM_PORTS) {
+        return;
+    }
+    mask &= 0xffff;
+    portmap[port]->BSRR = (mask & val) | ((mask & ~val) << 16);
+}
+
 /**
  * gpio irq init
  *
@@ -21,15 +21,109 @@
 #include <os/os.h>
 #include <hal/hal_os_tick.h>
 
+struct hal_os_tick
+{
+    uint32_t ticks_per_ostick;
+    os_time_t max_idle_ticks;
+};
+
+struct hal_os_tick g_hal_os_tick;
+
 /*
- * XXX implement tickless mode.
+ * Restart SysTick so that it fires after 'cnt' core clocks and then falls
+ * back to the regular OS tick period.
+ *
+ * Writing to VAL clears the counter and the reload from LOAD happens on the
+ * next clock, so by the time LOAD is rewritten below the counter has already
+ * picked up 'cnt'.
  */
+static inline void
+stm32f4_os_tick_restart(uint32_t cnt)
+{
+    SysTick->LOAD = cnt - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = g_hal_os_tick.ticks_per_ostick - 1;
+}
+
 void
 os_tick_idle(os_time_t ticks)
 {
+    uint32_t tpo;
+    uint32_t load;
+    uint32_t remain;
+    uint32_t counted;
+    uint32_t ctrl;
+    os_time_t elapsed;
+
     OS_ASSERT_CRITICAL();
+
+    /*
+     * Stay in periodic mode for short idle durations or if a tick is
+     * already pending; the processor will not stay asleep in either case.
+     */
+    if (ticks < 2 || g_hal_os_tick.max_idle_ticks < 2 ||
+        (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)) {
+        __DSB();
+        __WFI();
+        return;
+    }
+
+    /*
+     * Enter tickless regime during long idle durations.
+     */
+    if (ticks > g_hal_os_tick.max_idle_ticks) {
+        ticks = g_hal_os_tick.max_idle_ticks;
+    }
+    tpo = g_hal_os_tick.ticks_per_ostick;
+
+    /*
+     * Stop the counter and stretch the period to expire at the tick
+     * boundary 'ticks' from now. 'remain' is what is left of the current
+     * tick.
+     */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    remain = SysTick->VAL;
+    if (remain == 0) {
+        remain = tpo;
+    }
+    load = remain + (ticks - 1) * tpo;
+    SysTick->LOAD = load - 1;
+    SysTick->VAL = 0;
+    (void)SysTick->CTRL;            /* clear COUNTFLAG */
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
     __DSB();
     __WFI();
+
+    /*
+     * Figure out how far into the stretched period we got, measured from the
+     * start of the tick that was in progress when we went to sleep.
+     * Reading CTRL clears COUNTFLAG, so sample it once and test the copy.
+     */
+    ctrl = SysTick->CTRL;
+    SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+    counted = tpo - remain;
+    if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) {
+        /*
+         * The full period expired; account for it here rather than in the
+         * pending SysTick interrupt.
+         */
+        SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+        counted += load + (load - 1 - SysTick->VAL);
+    } else {
+        counted += load - 1 - SysTick->VAL;
+    }
+    elapsed = counted / tpo;
+
+    /*
+     * Resume the periodic tick at the next tick boundary and update OS time
+     * before anything else when coming out of the tickless regime.
+     */
+    stm32f4_os_tick_restart(tpo - (counted % tpo));
+    if (elapsed > 0) {
+        os_time_advance(elapsed);
+    }
 }
 
 void
@@ -39,6 +133,14 @@ os_tick_init(uint32_t os_ticks_per_sec, int prio)
 
     reload_val = ((uint64_t)SystemCoreClock / os_ticks_per_sec) - 1;
 
+    g_hal_os_tick.ticks_per_ostick = reload_val + 1;
+
+    /*
+     * The longest tickless period is bounded by the 24-bit SysTick counter.
+     */
+    g_hal_os_tick.max_idle_ticks = (SysTick_LOAD_RELOAD_Msk + 1) /
+      g_hal_os_tick.ticks_per_ostick;
+
     /* Set the system time ticker up */
     SysTick->LOAD = reload_val;
     SysTick->VAL = 0;
@@ -0,0 +1,357 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stddef.h>
+#include "hal/hal_spi.h"
+#include "hal/hal_spi_int.h"
+#include "hal/hal_gpio.h"
+#include "bsp/cmsis_nvic.h"
+#include "mcu/stm32f4xx.h"
+#include "mcu/stm32f4xx_hal_rcc.h"
+#include "mcu/stm32f4_bsp.h"
+
+#define STM32F4_SPI_MAX         3
+
+/* NDTR is 16 bits wide */
+#define STM32F4_SPI_DMA_MAXCNT  0xffff
+
+struct stm32f4_hal_spi {
+    struct hal_spi parent;
+    const struct stm32f4_spi_cfg *cfg;
+    volatile uint8_t busy;
+    uint8_t *txbuf;
+    uint8_t *rxbuf;
+    int len;
+    int off;
+    int chunk;
+    hal_spi_txrx_cb cb;
+    void *arg;
+};
+
+static int stm32f4_spi_config(struct hal_spi *pspi,
+                              struct hal_spi_settings *psettings);
+static int stm32f4_spi_master_transfer(struct hal_spi *pspi, uint16_t tx);
+static int stm32f4_spi_txrx(struct hal_spi *pspi, void *txbuf, void *rxbuf,
+                            int len);
+static int stm32f4_spi_txrx_nonblock(struct hal_spi *pspi, void *txbuf,
+                                     void *rxbuf, int len, hal_spi_txrx_cb cb,
+                                     void *arg);
+
+static const struct hal_spi_funcs stm32f4_spi_funcs = {
+    .hspi_config = stm32f4_spi_config,
+    .hspi_master_transfer = stm32f4_spi_master_transfer,
+    .hspi_txrx = stm32f4_spi_txrx,
+    .hspi_txrx_nonblock = stm32f4_spi_txrx_nonblock,
+};
+
+static struct stm32f4_hal_spi stm32f4_spis[STM32F4_SPI_MAX];
+
+/* Sent when caller gives no TX data, and where RX data goes if not wanted */
+static const uint8_t stm32f4_spi_ff = 0xff;
+static uint8_t stm32f4_spi_sink;
+
+static int
+stm32f4_spi_config(struct hal_spi *pspi, struct hal_spi_settings *psettings)
+{
+    struct stm32f4_hal_spi *spi = (struct stm32f4_hal_spi *)pspi;
+    SPI_TypeDef *regs = spi->cfg->ssc_spi;
+    uint32_t pclk;
+    uint32_t cr1;
+    int br;
+
+    if (spi->busy || psettings->word_size != HAL_SPI_WORD_SIZE_8BIT) {
+        return -1;
+    }
+
+    cr1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI;
+    switch (psettings->data_mode) {
+    case HAL_SPI_MODE0:
+        break;
+    case HAL_SPI_MODE1:
+        cr1 |= SPI_CR1_CPHA;
+        break;
+    case HAL_SPI_MODE2:
+        cr1 |= SPI_CR1_CPOL;
+        break;
+    case HAL_SPI_MODE3:
+        cr1 |= SPI_CR1_CPOL | SPI_CR1_CPHA;
+        break;
+    default:
+        return -1;
+    }
+    if (psettings->data_order == HAL_SPI_LSB_FIRST) {
+        cr1 |= SPI_CR1_LSBFIRST;
+    }
+
+    /*
+     * Fastest clock not above the one asked for; SCK = PCLK / 2^(BR + 1).
+     */
+    if (regs == SPI1) {
+        pclk = HAL_RCC_GetPCLK2Freq();
+    } else {
+        pclk = HAL_RCC_GetPCLK1Freq();
+    }
+    for (br = 0; br < 7; br++) {
+        if ((pclk >> (br + 1)) <= psettings->baudrate * 1000) {
+            break;
+        }
+    }
+    cr1 |= br * SPI_CR1_BR_0;
+
+    regs->CR1 = 0;
+    regs->CR1 = cr1;
+    regs->CR1 = cr1 | SPI_CR1_SPE;
+    return 0;
+}
+
+/*
+ * Starts DMA for next piece of the transfer. SPI clocks out data as TX DMA
+ * feeds it, and the RX stream finishing means the whole piece is done.
+ */
+static void
+stm32f4_spi_start(struct stm32f4_hal_spi *spi, int irq)
+{
+    const struct stm32f4_spi_cfg *cfg = spi->cfg;
+    DMA_Stream_TypeDef *rx = cfg->ssc_dma_rx;
+    DMA_Stream_TypeDef *tx = cfg->ssc_dma_tx;
+    uint32_t cr;
+
+    spi->chunk = spi->len - spi->off;
+    if (spi->chunk > STM32F4_SPI_DMA_MAXCNT) {
+        spi->chunk = STM32F4_SPI_DMA_MAXCNT;
+    }
+
+    stm32f4_dma_clear(rx);
+    stm32f4_dma_clear(tx);
+
+    cr = cfg->ssc_dma_chan * DMA_SxCR_CHSEL_0;
+    rx->PAR = (uint32_t)&cfg->ssc_spi->DR;
+    rx->NDTR = spi->chunk;
+    if (spi->rxbuf) {
+        rx->M0AR = (uint32_t)(spi->rxbuf + spi->off);
+        rx->CR = cr | DMA_SxCR_MINC;
+    } else {
+        rx->M0AR = (uint32_t)&stm32f4_spi_sink;
+        rx->CR = cr;
+    }
+    if (irq) {
+        rx->CR |= DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE;
+    }
+
+    tx->PAR = (uint32_t)&cfg->ssc_spi->DR;
+    tx->NDTR = spi->chunk;
+    if (spi->txbuf) {
+        tx->M0AR = (uint32_t)(spi->txbuf + spi->off);
+        tx->CR = cr | DMA_SxCR_DIR_0 | DMA_SxCR_MINC;
+    } else {
+        tx->M0AR = (uint32_t)&stm32f4_spi_ff;
+        tx->CR = cr | DMA_SxCR_DIR_0;
+    }
+
+    rx->CR |= DMA_SxCR_EN;
+    tx->CR |= DMA_SxCR_EN;
+    cfg->ssc_spi->CR2 |= SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+}
+
+static void
+stm32f4_spi_stop(struct stm32f4_hal_spi *spi)
+{
+    spi->cfg->ssc_dma_tx->CR &= ~DMA_SxCR_EN;
+    spi->cfg->ssc_dma_rx->CR &= ~DMA_SxCR_EN;
+    spi->cfg->ssc_spi->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+    stm32f4_dma_clear(spi->cfg->ssc_dma_rx);
+    stm32f4_dma_clear(spi->cfg->ssc_dma_tx);
+}
+
+static int
+stm32f4_spi_setup(struct stm32f4_hal_spi *spi, void *txbuf, void *rxbuf,
+                  int len, hal_spi_txrx_cb cb, void *arg)
+{
+    uint32_t sr;
+
+    __HAL_DISABLE_INTERRUPTS(sr);
+    if (spi->busy) {
+        __HAL_ENABLE_INTERRUPTS(sr);
+        return -1;
+    }
+    spi->busy = 1;
+    __HAL_ENABLE_INTERRUPTS(sr);
+
+    spi->txbuf = txbuf;
+    spi->rxbuf = rxbuf;
+    spi->len = len;
+    spi->off = 0;
+    spi->cb = cb;
+    spi->arg = arg;
+    return 0;
+}
+
+static int
+stm32f4_spi_txrx(struct hal_spi *pspi, void *txbuf, void *rxbuf, int len)
+{
+    struct stm32f4_hal_spi *spi = (struct stm32f4_hal_spi *)pspi;
+    uint32_t flags;
+    int rc;
+
+    if (stm32f4_spi_setup(spi, txbuf, rxbuf, len, NULL, NULL)) {
+        return -1;
+    }
+    rc = 0;
+    while (spi->off < spi->len) {
+        stm32f4_spi_start(spi, 0);
+        do {
+            flags = stm32f4_dma_flags(spi->cfg->ssc_dma_rx);
+        } while ((flags & (STM32F4_DMA_TCIF | STM32F4_DMA_ERR)) == 0);
+        stm32f4_spi_stop(spi);
+        if (flags & STM32F4_DMA_ERR) {
+            rc = -1;
+            break;
+        }
+        spi->off += spi->chunk;
+    }
+    spi->busy = 0;
+    return rc;
+}
+
+static int
+stm32f4_spi_txrx_nonblock(struct hal_spi *pspi, void *txbuf, void *rxbuf,
+                          int len, hal_spi_txrx_cb cb, void *arg)
+{
+    struct stm32f4_hal_spi *spi = (struct stm32f4_hal_spi *)pspi;
+
+    if (stm32f4_spi_setup(spi, txbuf, rxbuf, len, cb, arg)) {
+        return -1;
+    }
+    if (len == 0) {
+        spi->busy = 0;
+        if (cb) {
+            cb(arg, 0);
+        }
+        return 0;
+    }
+    stm32f4_spi_start(spi, 1);
+    return 0;
+}
+
+static int
+stm32f4_spi_master_transfer(struct hal_spi *pspi, uint16_t tx)
+{
+    struct stm32f4_hal_spi *spi = (struct stm32f4_hal_spi *)pspi;
+    SPI_TypeDef *regs = spi->cfg->ssc_spi;
+
+    if (spi->busy) {
+        return -1;
+    }
+    while ((regs->SR & SPI_SR_TXE) == 0) {
+    }
+    regs->DR = (uint8_t)tx;
+    while ((regs->SR & SPI_SR_RXNE) == 0) {
+    }
+    return (uint8_t)regs->DR;
+}
+
+static void
+stm32f4_spi_irq_handler(struct stm32f4_hal_spi *spi)
+{
+    uint32_t flags;
+    int len;
+
+    flags = stm32f4_dma_flags(spi->cfg->ssc_dma_rx);
+    if ((flags & (STM32F4_DMA_TCIF | STM32F4_DMA_ERR)) == 0) {
+        return;
+    }
+    stm32f4_spi_stop(spi);
+    if ((flags & STM32F4_DMA_ERR) == 0) {
+        spi->off += spi->chunk;
+        if (spi->off < spi->len) {
+            stm32f4_spi_start(spi, 1);
+            return;
+        }
+    }
+    len = spi->off;
+    spi->busy = 0;
+    if (spi->cb) {
+        spi->cb(spi->arg, len);
+    }
+}
+
+static void
+stm32f4_spi0_irq(void)
+{
+    stm32f4_spi_irq_handler(&stm32f4_spis[0]);
+}
+
+static void
+stm32f4_spi1_irq(void)
+{
+    stm32f4_spi_irq_handler(&stm32f4_spis[1]);
+}
+
+static void
+stm32f4_spi2_irq(void)
+{
+    stm32f4_spi_irq_handler(&stm32f4_spis[2]);
+}
+
+static void (* const stm32f4_spi_irqs[STM32F4_SPI_MAX])(void) = {
+    stm32f4_spi0_irq,
+    stm32f4_spi1_irq,
+    stm32f4_spi2_irq
+};
+
+/*
+ * Sets up SPI master described by cfg as driver instance spi_num. Default
+ * configuration is mode 0, MSB first, 1MHz. DMA cannot reach CCM RAM, so
+ * transfer buffers must be in main RAM. Returns NULL on error.
+ */
+struct hal_spi *
+stm32f4_spi_create(int spi_num, const struct stm32f4_spi_cfg *cfg)
+{
+    struct stm32f4_hal_spi *spi;
+    struct hal_spi_settings settings = {
+        .data_mode = HAL_SPI_MODE0,
+        .data_order = HAL_SPI_MSB_FIRST,
+        .word_size = HAL_SPI_WORD_SIZE_8BIT,
+        .baudrate = 1000
+    };
+
+    if (spi_num < 0 || spi_num >= STM32F4_SPI_MAX) {
+        return NULL;
+    }
+    spi = &stm32f4_spis[spi_num];
+    spi->cfg = cfg;
+    spi->busy = 0;
+    spi->parent.driver_api = &stm32f4_spi_funcs;
+
+    *cfg->ssc_rcc_reg |= cfg->ssc_rcc_dev;
+    RCC->AHB1ENR |= cfg->ssc_dma_rcc_dev;
+
+    if (hal_gpio_init_af(cfg->ssc_pin_sck, cfg->ssc_pin_af, GPIO_PULL_NONE) ||
+      hal_gpio_init_af(cfg->ssc_pin_miso, cfg->ssc_pin_af, GPIO_PULL_NONE) ||
+      hal_gpio_init_af(cfg->ssc_pin_mosi, cfg->ssc_pin_af, GPIO_PULL_NONE)) {
+        return NULL;
+    }
+
+    stm32f4_spi_config(&spi->parent, &settings);
+
+    NVIC_SetVector(cfg->ssc_dma_rx_irqn, (uint32_t)stm32f4_spi_irqs[spi_num]);
+    NVIC_EnableIRQ(cfg->ssc_dma_rx_irqn);
+
+    return &spi->parent;
+}
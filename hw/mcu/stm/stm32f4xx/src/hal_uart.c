@@ -31,12 +31,18 @@
 
 struct hal_uart {
     USART_TypeDef *u_regs;
+    const struct stm32f4_uart_cfg *u_cfg;
     uint8_t u_open:1;
     uint8_t u_rx_stall:1;
     uint8_t u_tx_end:1;
+    uint8_t u_block:1;
     uint8_t u_rx_data;
+    uint16_t u_rx_dma_len;		/* block being received, 0 if none */
+    uint16_t u_tx_dma_len;		/* block being sent, 0 if none */
     hal_uart_rx_char u_rx_func;
     hal_uart_tx_char u_tx_func;
+    hal_uart_rx_block u_rx_block;
+    hal_uart_tx_block u_tx_block;
     hal_uart_tx_done u_tx_done;
     void *u_func_arg;
 };
@@ -62,9 +68,153 @@ hal_uart_init_cbs(int port, hal_uart_tx_char tx_func, hal_uart_tx_done tx_done,
     u->u_tx_func = tx_func;
     u->u_tx_done = tx_done;
     u->u_func_arg = arg;
+    u->u_block = 0;
+    return 0;
+}
+
+int
+hal_uart_init_block_cbs(int port, hal_uart_tx_block tx_func,
+  hal_uart_tx_done tx_done, hal_uart_rx_block rx_func, void *arg)
+{
+    const struct stm32f4_uart_cfg *cfg;
+    struct hal_uart *u;
+
+    u = &uarts[port];
+    if (port >= UART_CNT || u->u_open) {
+        return -1;
+    }
+    cfg = bsp_uart_config(port);
+    if (!cfg->suc_dma_rx || !cfg->suc_dma_tx) {
+        /* BSP did not give DMA streams for this port. */
+        return -1;
+    }
+    u->u_rx_block = rx_func;
+    u->u_tx_block = tx_func;
+    u->u_tx_done = tx_done;
+    u->u_func_arg = arg;
+    u->u_block = 1;
     return 0;
 }
 
+static void
+hal_uart_dma_stop(DMA_Stream_TypeDef *dma)
+{
+    dma->CR &= ~DMA_SxCR_EN;
+    while (dma->CR & DMA_SxCR_EN) {
+    }
+    stm32f4_dma_clear(dma);
+}
+
+/*
+ * Start receiving next block with DMA. rx_len is the number of bytes
+ * received into previous block.
+ *
+ * Returns 0 if reception was started, -1 if upper layer stalled RX.
+ */
+static int
+hal_uart_rx_next(struct hal_uart *u, int rx_len)
+{
+    const struct stm32f4_uart_cfg *cfg = u->u_cfg;
+    DMA_Stream_TypeDef *dma = cfg->suc_dma_rx;
+    uint8_t *ptr;
+    int len;
+
+    u->u_rx_dma_len = 0;
+    len = u->u_rx_block(u->u_func_arg, rx_len, &ptr);
+    if (len <= 0) {
+        return -1;
+    }
+    if (len > 0xffff) {
+        len = 0xffff;
+    }
+    dma->PAR = (uint32_t)&u->u_regs->DR;
+    dma->M0AR = (uint32_t)ptr;
+    dma->NDTR = len;
+    dma->FCR = 0;
+    dma->CR = (cfg->suc_dma_chan * DMA_SxCR_CHSEL_0) | DMA_SxCR_PL_1 |
+      DMA_SxCR_MINC | DMA_SxCR_TCIE;
+    dma->CR |= DMA_SxCR_EN;
+    u->u_rx_dma_len = len;
+    return 0;
+}
+
+/*
+ * Start sending next block with DMA; USART TC interrupt tells when it's
+ * out. tx_len is the number of bytes sent from previous block.
+ *
+ * Returns 0 if transmission was started, -1 if there is nothing to send.
+ */
+static int
+hal_uart_tx_next(struct hal_uart *u, int tx_len)
+{
+    const struct stm32f4_uart_cfg *cfg = u->u_cfg;
+    DMA_Stream_TypeDef *dma = cfg->suc_dma_tx;
+    uint8_t *ptr;
+    int len;
+
+    u->u_tx_dma_len = 0;
+    len = u->u_tx_block(u->u_func_arg, tx_len, &ptr);
+    if (len <= 0) {
+        return -1;
+    }
+    if (len > 0xffff) {
+        len = 0xffff;
+    }
+    hal_uart_dma_stop(dma);
+    dma->PAR = (uint32_t)&u->u_regs->DR;
+    dma->M0AR = (uint32_t)ptr;
+    dma->NDTR = len;
+    dma->FCR = 0;
+    dma->CR = (cfg->suc_dma_chan * DMA_SxCR_CHSEL_0) | DMA_SxCR_PL_1 |
+      DMA_SxCR_MINC | DMA_SxCR_DIR_0;
+    u->u_regs->SR = ~USART_SR_TC;
+    dma->CR |= DMA_SxCR_EN;
+    u->u_regs->CR1 |= USART_CR1_TCIE;
+    u->u_tx_dma_len = len;
+    return 0;
+}
+
+/*
+ * Interrupt handling in block mode. RX block is handed up when DMA has
+ * filled it, or when the line goes idle with part of it received.
+ */
+static void
+uart_block_irq_handler(struct hal_uart *u)
+{
+    const struct stm32f4_uart_cfg *cfg = u->u_cfg;
+    USART_TypeDef *regs = u->u_regs;
+    uint32_t isr;
+    int len;
+
+    if (u->u_rx_dma_len &&
+      (stm32f4_dma_flags(cfg->suc_dma_rx) & STM32F4_DMA_TCIF)) {
+        stm32f4_dma_clear(cfg->suc_dma_rx);
+        if (hal_uart_rx_next(u, u->u_rx_dma_len)) {
+            u->u_rx_stall = 1;
+        }
+    }
+
+    isr = regs->SR;
+    if (isr & USART_SR_IDLE) {
+        (void)regs->DR;
+        if (u->u_rx_dma_len && cfg->suc_dma_rx->NDTR != u->u_rx_dma_len) {
+            hal_uart_dma_stop(cfg->suc_dma_rx);
+            len = u->u_rx_dma_len - cfg->suc_dma_rx->NDTR;
+            if (hal_uart_rx_next(u, len)) {
+                u->u_rx_stall = 1;
+            }
+        }
+    }
+    if ((isr & USART_SR_TC) && (regs->CR1 & USART_CR1_TCIE)) {
+        if (hal_uart_tx_next(u, u->u_tx_dma_len)) {
+            regs->CR1 &= ~USART_CR1_TCIE;
+            if (u->u_tx_done) {
+                u->u_tx_done(u->u_func_arg);
+            }
+        }
+    }
+}
+
 static void
 uart_irq_handler(int num)
 {
@@ -79,6 +229,10 @@ uart_irq_handler(int num)
     ui = &uart_irqs[num];
     ++ui->ui_cnt;
     u = ui->ui_uart;
+    if (u->u_block) {
+        uart_block_irq_handler(u);
+        return;
+    }
     regs = u->u_regs;
 
     isr = regs->SR;
@@ -124,10 +278,17 @@ hal_uart_start_rx(int port)
     u = &uarts[port];
     if (u->u_rx_stall) {
         __HAL_DISABLE_INTERRUPTS(sr);
-        rc = u->u_rx_func(u->u_func_arg, u->u_rx_data);
-        if (rc == 0) {
-            u->u_rx_stall = 0;
-            u->u_regs->CR1 |= USART_CR1_RXNEIE;
+        if (u->u_block) {
+            rc = hal_uart_rx_next(u, 0);
+            if (rc == 0) {
+                u->u_rx_stall = 0;
+            }
+        } else {
+            rc = u->u_rx_func(u->u_func_arg, u->u_rx_data);
+            if (rc == 0) {
+                u->u_rx_stall = 0;
+                u->u_regs->CR1 |= USART_CR1_RXNEIE;
+            }
         }
         __HAL_ENABLE_INTERRUPTS(sr);
     }
@@ -141,6 +302,13 @@ hal_uart_start_tx(int port)
 
     u = &uarts[port];
     __HAL_DISABLE_INTERRUPTS(sr);
+    if (u->u_block) {
+        if (u->u_tx_dma_len == 0) {
+            hal_uart_tx_next(u, 0);
+        }
+        __HAL_ENABLE_INTERRUPTS(sr);
+        return;
+    }
     u->u_regs->CR1 &= ~USART_CR1_TCIE;
     u->u_regs->CR1 |= USART_CR1_TXEIE;
     u->u_tx_end = 0;
@@ -159,6 +327,10 @@ hal_uart_blocking_tx(int port, uint8_t data)
     }
     regs = u->u_regs;
 
+    if (u->u_block && u->u_tx_dma_len) {
+        /* Let DMA finish with the current block. */
+        while (u->u_cfg->suc_dma_tx->NDTR);
+    }
     while (!(regs->SR & USART_SR_TXE));
 
     regs->DR = data;
@@ -352,6 +524,14 @@ hal_uart_config(int port, int32_t baudrate, uint8_t databits, uint8_t stopbits,
         hal_gpio_init_af(cfg->suc_pin_cts, cfg->suc_pin_af, 0);
     }
 
+    if (u->u_block) {
+        RCC->AHB1ENR |= cfg->suc_dma_rcc_dev;
+        hal_uart_dma_stop(cfg->suc_dma_rx);
+        hal_uart_dma_stop(cfg->suc_dma_tx);
+        cr3 |= USART_CR3_DMAR | USART_CR3_DMAT;
+    }
+
+    u->u_cfg = cfg;
     u->u_regs = cfg->suc_uart;
     u->u_regs->CR3 = cr3;
     u->u_regs->CR2 = cr2;
@@ -366,7 +546,21 @@ hal_uart_config(int port, int32_t baudrate, uint8_t databits, uint8_t stopbits,
     (void)u->u_regs->SR;
     hal_uart_set_nvic(cfg->suc_irqn, u);
 
-    u->u_regs->CR1 |= (USART_CR1_RXNEIE | USART_CR1_UE);
+    if (u->u_block) {
+        /*
+         * RX stream interrupt goes to the same handler as the USART.
+         */
+        NVIC_SetVector(cfg->suc_dma_rx_irqn, NVIC_GetVector(cfg->suc_irqn));
+        NVIC_EnableIRQ(cfg->suc_dma_rx_irqn);
+        u->u_tx_dma_len = 0;
+        u->u_rx_stall = 0;
+        if (hal_uart_rx_next(u, 0)) {
+            u->u_rx_stall = 1;
+        }
+        u->u_regs->CR1 |= (USART_CR1_IDLEIE | USART_CR1_UE);
+    } else {
+        u->u_regs->CR1 |= (USART_CR1_RXNEIE | USART_CR1_UE);
+    }
     u->u_open = 1;
 
     return 0;
@@ -384,6 +578,13 @@ hal_uart_close(int port)
 
     u->u_open = 0;
     u->u_regs->CR1 = 0;
+    if (u->u_block) {
+        NVIC_DisableIRQ(u->u_cfg->suc_dma_rx_irqn);
+        hal_uart_dma_stop(u->u_cfg->suc_dma_rx);
+        hal_uart_dma_stop(u->u_cfg->suc_dma_tx);
+        u->u_rx_dma_len = 0;
+        u->u_tx_dma_len = 0;
+    }
 
     return 0;
 }
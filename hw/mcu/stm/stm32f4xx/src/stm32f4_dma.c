@@ -0,0 +1,66 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "hal/hal_gpio.h"
+#include "mcu/stm32f4xx.h"
+#include "mcu/stm32f4_bsp.h"
+
+/*
+ * Interrupt flags for streams 0-3 are in LISR/LIFCR, 4-7 in HISR/HIFCR, at
+ * these offsets.
+ */
+static const uint8_t stm32f4_dma_shift[4] = { 0, 6, 16, 22 };
+
+static DMA_TypeDef *
+stm32f4_dma_regs(DMA_Stream_TypeDef *stream, int *idx)
+{
+    uint32_t base;
+
+    base = (uint32_t)stream & ~0xffUL;
+    *idx = ((uint32_t)stream - base - 0x10) / 0x18;
+    return (DMA_TypeDef *)base;
+}
+
+uint32_t
+stm32f4_dma_flags(DMA_Stream_TypeDef *stream)
+{
+    DMA_TypeDef *dma;
+    int idx;
+
+    dma = stm32f4_dma_regs(stream, &idx);
+    if (idx < 4) {
+        return (dma->LISR >> stm32f4_dma_shift[idx]) & STM32F4_DMA_FLAGS;
+    } else {
+        return (dma->HISR >> stm32f4_dma_shift[idx - 4]) & STM32F4_DMA_FLAGS;
+    }
+}
+
+void
+stm32f4_dma_clear(DMA_Stream_TypeDef *stream)
+{
+    DMA_TypeDef *dma;
+    int idx;
+
+    dma = stm32f4_dma_regs(stream, &idx);
+    if (idx < 4) {
+        dma->LIFCR = STM32F4_DMA_FLAGS << stm32f4_dma_shift[idx];
+    } else {
+        dma->HIFCR = STM32F4_DMA_FLAGS << stm32f4_dma_shift[idx - 4];
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "hal/hal_gpio.h"
+#include "mcu/stm32f4xx.h"
+#include "mcu/stm32f4xx_hal_rcc.h"
+#include "mcu/stm32f4_bsp.h"
+
+/*
+ * Timers on APB1 run at twice PCLK1, unless APB1 is not divided.
+ */
+static uint32_t
+stm32f4_tim_apb1_freq(void)
+{
+    uint32_t freq;
+
+    freq = HAL_RCC_GetPCLK1Freq();
+    if (RCC->CFGR & RCC_CFGR_PPRE1_2) {
+        freq *= 2;
+    }
+    return freq;
+}
+
+/*
+ * Starts an APB1 timer with TRGO on update, at <rate> per second. Used to
+ * pace ADC and DAC conversions. Returns -1 if the rate is too high.
+ */
+int
+stm32f4_tim_trgo_start(TIM_TypeDef *tim, uint32_t rate)
+{
+    uint32_t ticks;
+    uint32_t psc;
+
+    ticks = stm32f4_tim_apb1_freq() / rate;
+    if (ticks < 2) {
+        return -1;
+    }
+
+    /* 16-bit timers need the prescaler for low rates. */
+    psc = (ticks - 1) >> 16;
+    tim->CR1 = 0;
+    tim->PSC = psc;
+    tim->ARR = ticks / (psc + 1) - 1;
+    tim->CNT = 0;
+    tim->CR2 = TIM_CR2_MMS_1;                   /* TRGO on update */
+    tim->EGR = TIM_EGR_UG;
+    tim->CR1 = TIM_CR1_CEN;
+    return 0;
+}
@@ -105,6 +105,10 @@ __extern int vsnprintf(char *, size_t n, const char *, va_list);
 __extern int asprintf(char **, const char *, ...);
 __extern int vasprintf(char **, const char *, va_list);
 
+/* Formats to FILE, collecting output in buf and writing it in chunks. */
+__extern size_t vfprintf_buf(FILE *, char *buf, size_t size, const char *,
+                             va_list);
+
 __extern int sscanf(const char *, const char *, ...);
 __extern int vsscanf(const char *, const char *, va_list);
 
@@ -3,12 +3,48 @@
  */
 
 #include <string.h>
+#include <stdint.h>
 
 int memcmp(const void *s1, const void *s2, size_t n)
 {
 	const unsigned char *c1 = s1, *c2 = s2;
 	int d = 0;
 
+#if defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_7M__) || \
+    defined(__ARM_ARCH_7EM__)
+	/*
+	 * Skip over matching words; the byte loop below then finds the
+	 * difference within the word that doesn't match. Cortex-M3/M4
+	 * can load words from unaligned s2.
+	 */
+	if (n >= 8) {
+		while ((uintptr_t)c1 & 3) {
+			d = (int)*c1++ - (int)*c2++;
+			n--;
+			if (d)
+				return d;
+		}
+#if defined(__ARM_ARCH_6M__)
+		if (((uintptr_t)c2 & 3) == 0) {
+			while (n >= 4 &&
+			       *(const uint32_t *)c1 == *(const uint32_t *)c2) {
+				c1 += 4;
+				c2 += 4;
+				n -= 4;
+			}
+		}
+#else
+		while (n >= 4 && *(const uint32_t *)c1 == ((const struct {
+			uint32_t v;
+		} __attribute__((packed)) *)c2)->v) {
+			c1 += 4;
+			c2 += 4;
+			n -= 4;
+		}
+#endif
+	}
+#endif
+
 	while (n--) {
 		d = (int)*c1++ - (int)*c2++;
 		if (d)
@@ -19,6 +19,50 @@ void *memcpy(void *dst, const void *src, size_t n)
 	asm volatile ("cld ; rep ; movsq ; movl %3,%%ecx ; rep ; movsb":"+c"
 		      (nq), "+S"(p), "+D"(q)
 		      :"r"((uint32_t) (n & 7)));
+#elif defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_7M__) || \
+      defined(__ARM_ARCH_7EM__)
+	/*
+	 * Align destination, then move 16 bytes at a time with LDM/STM
+	 * if source is word aligned too. Cortex-M3/M4 can do single
+	 * word loads from unaligned source; M0 falls back to bytes.
+	 */
+	if (n >= 8) {
+		while ((uintptr_t)q & 3) {
+			*q++ = *p++;
+			n--;
+		}
+		if (((uintptr_t)p & 3) == 0) {
+			while (n >= 16) {
+				asm volatile ("ldmia %0!, {r3, r4, r5, r6}\n\t"
+					      "stmia %1!, {r3, r4, r5, r6}"
+					      : "+l" (p), "+l" (q)
+					      :
+					      : "r3", "r4", "r5", "r6", "memory");
+				n -= 16;
+			}
+			while (n >= 4) {
+				*(uint32_t *)q = *(const uint32_t *)p;
+				q += 4;
+				p += 4;
+				n -= 4;
+			}
+		}
+#if !defined(__ARM_ARCH_6M__)
+		else {
+			while (n >= 4) {
+				*(uint32_t *)q = ((const struct {
+					uint32_t v;
+				} __attribute__((packed)) *)p)->v;
+				q += 4;
+				p += 4;
+				n -= 4;
+			}
+		}
+#endif
+	}
+	while (n--) {
+		*q++ = *p++;
+	}
 #else
 	while (n--) {
 		*q++ = *p++;
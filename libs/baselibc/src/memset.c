@@ -20,6 +20,41 @@ void *memset(void *dst, int c, size_t n)
 		      :"+c" (nq), "+D" (q)
 		      : "a" ((unsigned char)c * 0x0101010101010101U),
 			"r" ((uint32_t) n & 7));
+#elif defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_7M__) || \
+      defined(__ARM_ARCH_7EM__)
+	/*
+	 * Align destination, then fill 16 bytes at a time with STM.
+	 */
+	if (n >= 8) {
+		register uint32_t w0 asm("r3");
+		register uint32_t w1 asm("r4");
+		register uint32_t w2 asm("r5");
+		register uint32_t w3 asm("r6");
+
+		while ((uintptr_t)q & 3) {
+			*q++ = c;
+			n--;
+		}
+		w0 = (unsigned char)c * 0x01010101U;
+		w1 = w0;
+		w2 = w0;
+		w3 = w0;
+		while (n >= 16) {
+			asm volatile ("stmia %0!, {%1, %2, %3, %4}"
+				      : "+l" (q)
+				      : "r" (w0), "r" (w1), "r" (w2), "r" (w3)
+				      : "memory");
+			n -= 16;
+		}
+		while (n >= 4) {
+			*(uint32_t *)q = w0;
+			q += 4;
+			n -= 4;
+		}
+	}
+	while (n--) {
+		*q++ = c;
+	}
 #else
 	while (n--) {
 		*q++ = c;
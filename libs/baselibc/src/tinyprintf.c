@@ -58,10 +58,59 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * long specifier is also supported.
  * Otherwise it is ignored, so on 32 bit platforms there is no point to use
  * PRINTF_SUPPORT_LONG because int == long.
+ *
+ * Output is staged in a buffer and handed to the FILE a chunk at a time,
+ * rather than a character at a time.
  */
 
 #include <stdio.h>
 
+#define TFP_CHUNK   32
+
+/* Where formatted output goes. */
+struct tfp_out {
+    FILE *f;            /**< flushed to when buf fills; NULL for plain span */
+    char *buf;
+    size_t size;
+    size_t len;         /**< bytes in buf */
+    size_t cnt;         /**< total produced, including what didn't fit */
+};
+
+static void out_flush(struct tfp_out *o)
+{
+    if (o->f && o->len) {
+        fwrite(o->buf, 1, o->len, o->f);
+        o->len = 0;
+    }
+}
+
+static void out_write(struct tfp_out *o, const char *s, size_t n)
+{
+    size_t k;
+
+    o->cnt += n;
+    while (n) {
+        if (o->len == o->size) {
+            if (!o->f)
+                return;
+            out_flush(o);
+        }
+        k = o->size - o->len;
+        if (k > n)
+            k = n;
+        memcpy(o->buf + o->len, s, k);
+        o->len += k;
+        s += k;
+        n -= k;
+    }
+}
+
+static void out_fill(struct tfp_out *o, char c, int n)
+{
+    while (n-- > 0)
+        out_write(o, &c, 1);
+}
+
 struct param {
     unsigned char width; /**< field width */
     char lz;            /**< Leading zeros */
@@ -72,22 +121,40 @@ struct param {
     char *bf;           /**<  Buffer to output */
 };
 
+/*
+ * Digits are generated from the least significant end; base 10 uses
+ * 32-bit arithmetic once the value fits, and 8/16 use shifts.
+ */
 static void ui2a(unsigned long long int num, struct param *p)
 {
-    int n = 0;
-    unsigned long long int d = 1;
+    static const char lc[] = "0123456789abcdef";
+    static const char uc[] = "0123456789ABCDEF";
+    const char *digits = p->uc ? uc : lc;
+    char tmp[22];
+    char *t = tmp + sizeof(tmp);
     char *bf = p->bf;
-    while (num / d >= p->base)
-        d *= p->base;
-    while (d != 0) {
-        unsigned long long  dgt = num / d;
-        num %= d;
-        d /= p->base;
-        if (n || dgt > 0 || d == 0) {
-            *bf++ = dgt + (dgt < 10 ? '0' : (p->uc ? 'A' : 'a') - 10);
-            ++n;
+    unsigned long n32;
+    int shift;
+
+    if (p->base == 10) {
+        while (num > 0xffffffffULL) {
+            *--t = '0' + num % 10;
+            num /= 10;
         }
+        n32 = num;
+        do {
+            *--t = '0' + n32 % 10;
+            n32 /= 10;
+        } while (n32);
+    } else {
+        shift = (p->base == 16) ? 4 : 3;
+        do {
+            *--t = digits[num & (p->base - 1)];
+            num >>= shift;
+        } while (num);
     }
+    while (t < tmp + sizeof(tmp))
+        *bf++ = *t++;
     *bf = 0;
 }
 
@@ -128,24 +195,15 @@ static char a2i(char ch, const char **src, int base, unsigned char *nump)
     return ch;
 }
 
-static int putf(FILE *putp, char c)
+static void putchw(struct tfp_out *o, struct param *p)
 {
-    if (fputc(c, putp) == EOF)
-        return 0;
-    else
-        return 1;
-}
-
-static unsigned putchw(FILE *putp, struct param *p)
-{
-    unsigned written = 0;
-    char ch;
     int n = p->width;
-    char *bf = p->bf;
+    size_t len;
+
+    len = strlen(p->bf);
 
     /* Number of filling characters */
-    while (*bf++ && n > 0)
-        n--;
+    n -= len;
     if (p->sign)
         n--;
     if (p->alt && p->base == 16)
@@ -154,35 +212,26 @@ static unsigned putchw(FILE *putp, struct param *p)
         n--;
 
     /* Fill with space, before alternate or sign */
-    if (!p->lz) {
-        while (n-- > 0)
-            written += putf(putp, ' ');
-    }
+    if (!p->lz)
+        out_fill(o, ' ', n);
 
     /* print sign */
     if (p->sign)
-        written += putf(putp, '-');
+        out_write(o, "-", 1);
 
     /* Alternate */
     if (p->alt && p->base == 16) {
-        written += putf(putp, '0');
-        written += putf(putp, (p->uc ? 'X' : 'x'));
+        out_write(o, p->uc ? "0X" : "0x", 2);
     } else if (p->alt && p->base == 8) {
-        written += putf(putp, '0');
+        out_write(o, "0", 1);
     }
 
     /* Fill with zeros, after alternate or sign */
-    if (p->lz) {
-        while (n-- > 0)
-            written += putf(putp, '0');
-    }
+    if (p->lz)
+        out_fill(o, '0', n);
 
     /* Put actual buffer */
-    bf = p->bf;
-    while ((ch = *bf++))
-        written += putf(putp, ch);
-    
-    return written;
+    out_write(o, p->bf, len);
 }
 
 static unsigned long long
@@ -224,9 +273,9 @@ intarg(int lng, int sign, va_list *va)
     return val;
 }
 
-size_t tfp_format(FILE *putp, const char *fmt, va_list va)
+static void tfp_format_out(struct tfp_out *o, const char *fmt, va_list *va)
 {
-    size_t written = 0;
+    const char *run;
     struct param p;
     char bf[23];
     char ch;
@@ -236,7 +285,11 @@ size_t tfp_format(FILE *putp, const char *fmt, va_list va)
 
     while ((ch = *(fmt++))) {
         if (ch != '%') {
-            written += putf(putp, ch);
+            /* Literal text is copied a run at a time */
+            run = fmt - 1;
+            while (*fmt && *fmt != '%')
+                fmt++;
+            out_write(o, run, fmt - run);
         } else {
             /* Init parameter struct */
             p.lz = 0;
@@ -279,47 +332,70 @@ size_t tfp_format(FILE *putp, const char *fmt, va_list va)
                 goto abort;
             case 'u':
                 p.base = 10;
-                ui2a(intarg(lng, 0, &va), &p);
-                written += putchw(putp, &p);
+                ui2a(intarg(lng, 0, va), &p);
+                putchw(o, &p);
                 break;
             case 'd':
             case 'i':
                 p.base = 10;
-                i2a(intarg(lng, 1, &va), &p);
-                written += putchw(putp, &p);
+                i2a(intarg(lng, 1, va), &p);
+                putchw(o, &p);
                 break;
             case 'x':
             case 'X':
                 p.base = 16;
                 p.uc = (ch == 'X');
-                ui2a(intarg(lng, 0, &va), &p);
-                written += putchw(putp, &p);
+                ui2a(intarg(lng, 0, va), &p);
+                putchw(o, &p);
                 break;
             case 'o':
                 p.base = 8;
-                ui2a(intarg(lng, 0, &va), &p);
-                written += putchw(putp, &p);
+                ui2a(intarg(lng, 0, va), &p);
+                putchw(o, &p);
                 break;
             case 'c':
-                written += putf(putp, (char)(va_arg(va, int)));
+                ch = va_arg(*va, int);
+                out_write(o, &ch, 1);
                 break;
             case 's':
-                p.bf = va_arg(va, char *);
-                written += putchw(putp, &p);
+                p.bf = va_arg(*va, char *);
+                putchw(o, &p);
                 p.bf = bf;
                 break;
             case '%':
-                written += putf(putp, ch);
+                out_write(o, &ch, 1);
             default:
                 break;
             }
         }
     }
  abort:;
- 
- return written;
 }
 
+/*
+ * Formats to f, using caller supplied buf to collect output into chunks.
+ */
+size_t vfprintf_buf(FILE *f, char *buf, size_t size, const char *fmt,
+                    va_list va)
+{
+    struct tfp_out o = { f, buf, size, 0, 0 };
+    va_list ap;
+
+    va_copy(ap, va);
+    tfp_format_out(&o, fmt, &ap);
+    va_end(ap);
+    out_flush(&o);
+    return o.cnt;
+}
+
+size_t tfp_format(FILE *putp, const char *fmt, va_list va)
+{
+    char buf[TFP_CHUNK];
+
+    return vfprintf_buf(putp, buf, sizeof(buf), fmt, va);
+}
+
+
 int vfprintf(FILE *f, const char *fmt, va_list va)
 {
     return tfp_format(f, fmt, va);
@@ -343,13 +419,19 @@ int printf(const char *fmt, ...)
     return rv;
 }
 
+/* Formats straight into str; no intermediate buffering. */
 int vsnprintf(char *str, size_t size, const char *fmt, va_list va)
 {
-    struct MemFile state;
-    FILE *f = fmemopen_w(&state, str, size - 1);
-    tfp_format(f, fmt, va);
-    *(state.buffer) = '\0';
-    return state.bytes_written;
+    struct tfp_out o = { NULL, str, size ? size - 1 : 0, 0, 0 };
+    va_list ap;
+
+    va_copy(ap, va);
+    tfp_format_out(&o, fmt, &ap);
+    va_end(ap);
+    if (size) {
+        str[o.len] = '\0';
+    }
+    return o.cnt;
 }
 
 int snprintf(char *str, size_t size, const char *fmt, ...)
@@ -20,8 +20,11 @@
 #ifndef _BLEUART_H_
 #define _BLEUART_H_
 
+struct os_eventq;
+struct ble_hs_cfg;
+
 int
-bleuart_init(int max_input);
+bleuart_init(struct os_eventq *evq, int max_input);
 int
 bleuart_svc_register(void);
 int
@@ -19,12 +19,17 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "host/ble_hs.h"
 #include <bleuart/bleuart.h>
 #include <os/endian.h>
 #include <console/console.h>
 
+#ifndef BLEUART_COALESCE_TICKS
+#define BLEUART_COALESCE_TICKS  (OS_TICKS_PER_SEC / 100)
+#endif
+
 /* ble uart attr read handle */
 uint16_t g_bleuart_attr_read_handle;
 
@@ -37,7 +42,19 @@ char *console_buf;
 /* Console max input */
 uint16_t console_max_input;
 
-uint16_t g_console_conn_handle;
+uint16_t g_console_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+
+/*
+ * Console input is collected into bleuart_tx_om until it fills a
+ * notification, a newline is seen, or BLEUART_COALESCE_TICKS pass.
+ * Console RX callback runs in interrupt context; it just posts
+ * bleuart_rx_ev, and the data is moved in the task.
+ */
+static struct os_mbuf *bleuart_tx_om;
+static struct os_eventq *bleuart_evq;
+static struct os_callout_func bleuart_rx_ev;
+static struct os_callout_func bleuart_tx_timer;
+
 /**
  * The vendor specific "bleuart" service consists of one write no-rsp characteristic
  * and one notification only read charateristic
@@ -101,13 +118,16 @@ gatt_svr_chr_access_uart_write(uint16_t conn_handle, uint16_t attr_handle,
                                struct ble_gatt_access_ctxt *ctxt, void *arg)
 {
     struct os_mbuf *om = ctxt->om;
+
     switch (ctxt->op) {
         case BLE_GATT_ACCESS_OP_WRITE_CHR:
-              while(om) {
+              /*
+               * Data is passed through as is, a buffer at a time.
+               */
+              while (om) {
                   console_write((char *)om->om_data, om->om_len);
                   om = SLIST_NEXT(om, om_next);
               }
-              console_write("\n", 1);
               return 0;
         default:
             assert(0);
@@ -140,44 +160,123 @@ err:
     return rc;
 }
 
+static void
+bleuart_tx_send(void)
+{
+    if (OS_MBUF_PKTLEN(bleuart_tx_om)) {
+        ble_gattc_notify_custom(g_console_conn_handle,
+                                g_bleuart_attr_read_handle, bleuart_tx_om);
+    } else {
+        os_mbuf_free_chain(bleuart_tx_om);
+    }
+    bleuart_tx_om = NULL;
+}
+
 /**
- * Reads console and sends data over BLE
+ * Moves console input to notifications. Full notifications, and ones
+ * ending in a newline, are sent right away. If flush is set, partially
+ * filled one is sent as well; otherwise coalescing timer is started for it.
+ *
+ * If there are no mbufs, input is left in the console, and UART RX is held
+ * off until data can be sent.
  */
 static void
-bleuart_uart_read(void)
+bleuart_tx_drain(int flush)
 {
     int rc;
-    int off;
+    int len;
+    int space;
     int full_line;
-    struct os_mbuf *om;
+    uint16_t mtu;
 
-    off = 0;
     while (1) {
-        rc = console_read(console_buf + off,
-                          console_max_input - off, &full_line);
+        mtu = ble_att_mtu(g_console_conn_handle);
+        if (mtu == 0) {
+            /*
+             * Not connected; discard input.
+             */
+            if (bleuart_tx_om) {
+                os_mbuf_free_chain(bleuart_tx_om);
+                bleuart_tx_om = NULL;
+            }
+            do {
+                rc = console_read(console_buf, console_max_input, &full_line);
+            } while (rc > 0 || full_line);
+            return;
+        }
+        if (!bleuart_tx_om) {
+            bleuart_tx_om = ble_hs_mbuf_att_pkt();
+            if (!bleuart_tx_om) {
+                break;
+            }
+        }
+        len = OS_MBUF_PKTLEN(bleuart_tx_om);
+        space = mtu - 3 - len;
+        if (space > console_max_input) {
+            space = console_max_input;
+        }
+
+        /*
+         * Newline is not counted in rc, but there is always room for it.
+         */
+        rc = console_read(console_buf, space, &full_line);
         if (rc <= 0 && !full_line) {
-            continue;
+            break;
+        }
+        if (full_line) {
+            console_buf[rc++] = '\n';
+        }
+        if (os_mbuf_append(bleuart_tx_om, console_buf, rc)) {
+            os_mbuf_free_chain(bleuart_tx_om);
+            bleuart_tx_om = NULL;
+            break;
         }
-        off += rc;
-        if (!full_line) {
-            continue;
+        if (full_line || len + rc == mtu - 3) {
+            bleuart_tx_send();
         }
+    }
 
-        om = ble_hs_mbuf_from_flat(console_buf, off);
-        if (!om) {
+    if (bleuart_tx_om && OS_MBUF_PKTLEN(bleuart_tx_om)) {
+        if (flush) {
+            bleuart_tx_send();
+        } else {
+            os_callout_reset(&bleuart_tx_timer.cf_c, BLEUART_COALESCE_TICKS);
             return;
         }
-        ble_gattc_notify_custom(g_console_conn_handle,
-                                g_bleuart_attr_read_handle, om);
-        off = 0;
-        break;
     }
+    if (!bleuart_tx_om) {
+        /*
+         * Out of mbufs; try again later.
+         */
+        os_callout_reset(&bleuart_tx_timer.cf_c, BLEUART_COALESCE_TICKS);
+    }
+}
+
+static void
+bleuart_rx_ev_cb(void *arg)
+{
+    bleuart_tx_drain(0);
+}
+
+static void
+bleuart_tx_timer_cb(void *arg)
+{
+    bleuart_tx_drain(1);
+}
+
+/**
+ * Console input callback; called from interrupt context.
+ */
+static void
+bleuart_uart_read(void)
+{
+    os_eventq_put(bleuart_evq, &bleuart_rx_ev.cf_c.c_ev);
 }
 
 /**
  * Sets the global connection handle
  *
- * @param connection handle
+ * @param connection handle; BLE_HS_CONN_HANDLE_NONE when disconnected.
  */
 void
 bleuart_set_conn_handle(uint16_t conn_handle) {
@@ -187,18 +286,25 @@ bleuart_set_conn_handle(uint16_t conn_handle) {
 /**
  * BLEuart console initialization
  *
- * @param Maximum input
+ * @param Event queue of the task running the host; console data is
+ *        sent to BLE from there.
+ * @param Size of the console read buffer.
  */
 int
-bleuart_init(int max_input)
+bleuart_init(struct os_eventq *evq, int max_input)
 {
     int rc;
 
-    rc = console_init(bleuart_uart_read);
-    assert(rc == 0);
+    bleuart_evq = evq;
+    os_callout_func_init(&bleuart_rx_ev, evq, bleuart_rx_ev_cb, NULL);
+    os_callout_func_init(&bleuart_tx_timer, evq, bleuart_tx_timer_cb, NULL);
 
     console_buf = malloc(max_input);
     console_max_input = max_input;
     assert(console_buf);
+
+    rc = console_init(bleuart_uart_read);
+    assert(rc == 0);
+
     return 0;
 }
@@ -27,6 +27,9 @@
 #include <hal/flash_map.h>
 #include <hal/hal_flash.h>
 #include <hal/hal_system.h>
+#ifdef BOOT_SERIAL_UART
+#include <hal/hal_uart.h>
+#endif
 
 #include <os/endian.h>
 #include <os/os.h>
@@ -44,12 +47,57 @@
 
 #define BOOT_SERIAL_OUT_MAX	48
 
+/*
+ * Raw upload requests a client may have in flight.
+ */
+#ifdef BOOT_SERIAL_UART
+#define BOOT_SERIAL_WINDOW	2
+#else
+#define BOOT_SERIAL_WINDOW	1
+#endif
+
+#ifndef BOOT_SERIAL_BAUD
+#define BOOT_SERIAL_BAUD	115200
+#endif
+
 static uint32_t curr_off;
 static uint32_t img_size;
 static struct nmgr_hdr *bs_hdr;
+static int bs_out_slip;
 
 static void boot_serial_output(char *data, int len);
 
+#ifdef BOOT_SERIAL_UART
+/*
+ * Receive state. Input is either base64 lines ending in newline, or SLIP
+ * frames, which must start with SLIP_END. Bytes of a request arriving when
+ * there is no free buffer are dropped until the end of that request.
+ */
+#define BS_RX_IDLE		0
+#define BS_RX_LINE		1
+#define BS_RX_SLIP		2
+#define BS_RX_SLIP_ESC		3
+#define BS_RX_DROP_LINE		4
+#define BS_RX_DROP_SLIP		5
+
+static struct {
+    char *buf[2];
+    int len[2];
+    volatile uint8_t full[2];
+    uint8_t slip[2];		/* Buffer holds a SLIP frame */
+    uint8_t cur;		/* Buffer being filled */
+    uint8_t state;
+    int size;
+    struct os_sem sem;
+} bs_rx;
+
+static struct {
+    uint8_t buf[128];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+} bs_tx;
+#endif
+
 /*
  * Looks for 'name' from NULL-terminated json data in buf.
  * Returns pointer to first character of value for that name.
@@ -125,6 +173,77 @@ bs_list(char *buf, int len)
     os_free(ptr);
 }
 
+/*
+ * Write a chunk of image to slot 0. Offset 0 starts a new upload of an
+ * image of size data_len. Chunk at some other offset than expected is
+ * ignored; response tells the client where to continue from.
+ */
+static int
+bs_upload_chunk(uint32_t off, uint32_t data_len, char *data, int len)
+{
+    const struct flash_area *fap = NULL;
+    int rc;
+
+    rc = flash_area_open(FLASH_AREA_IMAGE_0, &fap);
+    if (rc) {
+        return NMGR_ERR_EINVAL;
+    }
+
+    if (off == 0) {
+        curr_off = 0;
+        if (data_len > fap->fa_size) {
+            rc = NMGR_ERR_EINVAL;
+            goto out;
+        }
+        rc = flash_area_erase(fap, 0, fap->fa_size);
+        if (rc) {
+            rc = NMGR_ERR_EINVAL;
+            goto out;
+        }
+        img_size = data_len;
+    }
+    if (off != curr_off) {
+        rc = 0;
+        goto out;
+    }
+    if (curr_off + len > img_size) {
+        rc = NMGR_ERR_EINVAL;
+        goto out;
+    }
+    rc = flash_area_write(fap, curr_off, data, len);
+    if (rc) {
+        rc = NMGR_ERR_EINVAL;
+        goto out;
+    }
+    curr_off += len;
+out:
+    flash_area_close(fap);
+    return rc;
+}
+
+static void
+bs_upload_rsp(int rc, int win)
+{
+    char *ptr;
+    int len;
+
+    ptr = os_malloc(BOOT_SERIAL_OUT_MAX);
+    if (!ptr) {
+        return;
+    }
+    if (rc) {
+        len = snprintf(ptr, BOOT_SERIAL_OUT_MAX, "{\"rc\":%d}", rc);
+    } else if (win) {
+        len = snprintf(ptr, BOOT_SERIAL_OUT_MAX,
+          "{\"rc\":%d,\"off\":%u,\"win\":%d}", rc, (int)curr_off, win);
+    } else {
+        len = snprintf(ptr, BOOT_SERIAL_OUT_MAX, "{\"rc\":%d,\"off\":%u}",
+          rc, (int)curr_off);
+    }
+    boot_serial_output(ptr, len);
+    os_free(ptr);
+}
+
 /*
  * Image upload request.
  */
@@ -134,7 +253,6 @@ bs_upload(char *buf, int len)
     char *ptr;
     char *data_ptr;
     uint32_t off, data_len = 0;
-    const struct flash_area *fap = NULL;
     int rc;
 
     /*
@@ -178,50 +296,28 @@ bs_upload(char *buf, int len)
         goto out;
     }
 
-    rc = flash_area_open(FLASH_AREA_IMAGE_0, &fap);
-    if (rc) {
-        rc = NMGR_ERR_EINVAL;
-        goto out;
-    }
+    rc = bs_upload_chunk(off, data_len, data_ptr, len);
+out:
+    bs_upload_rsp(rc, 0);
+}
 
-    if (off == 0) {
-        curr_off = 0;
-        if (data_len > fap->fa_size) {
-            rc = NMGR_ERR_EINVAL;
-            goto out;
-        }
-        rc = flash_area_erase(fap, 0, fap->fa_size);
-        if (rc) {
-            rc = NMGR_ERR_EINVAL;
-            goto out;
-        }
-        img_size = data_len;
-    }
-    if (off != curr_off) {
-        rc = 0;
-        goto out;
-    }
-    rc = flash_area_write(fap, curr_off, data_ptr, len);
-    if (rc) {
-        rc = NMGR_ERR_EINVAL;
-        goto out;
-    }
-    curr_off += len;
+/*
+ * Raw image upload request; struct imgmgr_upload_cmd followed by data.
+ */
+static void
+bs_upload_raw(char *buf, int len)
+{
+    struct imgmgr_upload_cmd cmd;
+    int rc;
 
-out:
-    ptr = os_malloc(BOOT_SERIAL_OUT_MAX);
-    if (!ptr) {
-        return;
-    }
-    if (rc == 0) {
-        len = snprintf(ptr, BOOT_SERIAL_OUT_MAX, "{\"rc\":%d,\"off\":%u}",
-          rc, (int)curr_off);
+    if (len < sizeof(cmd)) {
+        rc = NMGR_ERR_EINVAL;
     } else {
-        len = snprintf(ptr, BOOT_SERIAL_OUT_MAX, "{\"rc\":%d}", rc);
+        memcpy(&cmd, buf, sizeof(cmd));
+        rc = bs_upload_chunk(ntohl(cmd.iuc_off), ntohl(cmd.iuc_len),
+          buf + sizeof(cmd), len - sizeof(cmd));
     }
-    boot_serial_output(ptr, len);
-    os_free(ptr);
-    flash_area_close(fap);
+    bs_upload_rsp(rc, BOOT_SERIAL_WINDOW);
 }
 
 /*
@@ -248,39 +344,13 @@ bs_reset(char *buf, int len)
 }
 
 /*
- * Parse incoming line of input from console.
- * Expect newtmgr protocol with serial transport.
+ * Handle a request which has passed CRC check. Payload is NUL terminated.
  */
-void
-boot_serial_input(char *buf, int len)
+static void
+boot_serial_dispatch(char *buf, int len)
 {
-    int rc;
-    uint16_t crc;
-    uint16_t expected_len;
     struct nmgr_hdr *hdr;
 
-    if (len < BASE64_ENCODE_SIZE(sizeof(uint16_t) * 2)) {
-        return;
-    }
-    rc = base64_decode(buf, buf);
-    if (rc < 0) {
-        return;
-    }
-    len = rc;
-
-    expected_len = ntohs(*(uint16_t *)buf);
-    buf += sizeof(uint16_t);
-    len -= sizeof(uint16_t);
-
-    len = min(len, expected_len);
-
-    crc = crc16_ccitt(CRC16_INITIAL_CRC, buf, len);
-    if (crc || len <= sizeof(crc)) {
-        return;
-    }
-    len -= sizeof(crc);
-    buf[len] = '\0';
-
     hdr = (struct nmgr_hdr *)buf;
     if (len < sizeof(*hdr) ||
       (hdr->nh_op != NMGR_OP_READ && hdr->nh_op != NMGR_OP_WRITE) ||
@@ -304,6 +374,9 @@ boot_serial_input(char *buf, int len)
         case IMGMGR_NMGR_OP_UPLOAD:
             bs_upload(buf, len);
             break;
+        case IMGMGR_NMGR_OP_UPLOAD_RAW:
+            bs_upload_raw(buf, len);
+            break;
         default:
             break;
         }
@@ -321,6 +394,219 @@ boot_serial_input(char *buf, int len)
     }
 }
 
+/*
+ * Parse incoming line of input from console.
+ * Expect newtmgr protocol with serial transport.
+ */
+void
+boot_serial_input(char *buf, int len)
+{
+    int rc;
+    uint16_t crc;
+    uint16_t expected_len;
+
+    if (len < BASE64_ENCODE_SIZE(sizeof(uint16_t) * 2)) {
+        return;
+    }
+    rc = base64_decode(buf, buf);
+    if (rc < 0) {
+        return;
+    }
+    len = rc;
+
+    expected_len = ntohs(*(uint16_t *)buf);
+    buf += sizeof(uint16_t);
+    len -= sizeof(uint16_t);
+
+    len = min(len, expected_len);
+
+    crc = crc16_ccitt(CRC16_INITIAL_CRC, buf, len);
+    if (crc || len <= sizeof(crc)) {
+        return;
+    }
+    len -= sizeof(crc);
+    buf[len] = '\0';
+
+    bs_out_slip = 0;
+    boot_serial_dispatch(buf, len);
+}
+
+/*
+ * Parse incoming binary frame, SLIP encoding already removed. Frame is
+ * nmgr_hdr, payload and CRC16 over them; no base64, and no length prefix.
+ */
+void
+boot_serial_input_frame(char *buf, int len)
+{
+    if (len <= sizeof(uint16_t) || crc16_ccitt(CRC16_INITIAL_CRC, buf, len)) {
+        return;
+    }
+    len -= sizeof(uint16_t);
+    buf[len] = '\0';
+
+    bs_out_slip = 1;
+    boot_serial_dispatch(buf, len);
+}
+
+#ifdef BOOT_SERIAL_UART
+static int
+bs_tx_char(void *arg)
+{
+    if (bs_tx.head == bs_tx.tail) {
+        return -1;
+    }
+    return bs_tx.buf[bs_tx.tail++ % sizeof(bs_tx.buf)];
+}
+
+static void
+bs_write(const char *data, int len)
+{
+    while (len--) {
+        while ((uint8_t)(bs_tx.head - bs_tx.tail) == sizeof(bs_tx.buf)) {
+            hal_uart_start_tx(CONSOLE_UART);
+            os_time_delay(1);
+        }
+        bs_tx.buf[bs_tx.head % sizeof(bs_tx.buf)] = *data++;
+        bs_tx.head++;
+    }
+    hal_uart_start_tx(CONSOLE_UART);
+}
+
+/*
+ * Request complete; hand the buffer to task, and start filling the other
+ * one.
+ */
+static void
+bs_rx_done(void)
+{
+    uint8_t b;
+
+    b = bs_rx.cur;
+    bs_rx.buf[b][bs_rx.len[b]] = '\0';
+    bs_rx.full[b] = 1;
+    bs_rx.cur = b ^ 1;
+    bs_rx.state = BS_RX_IDLE;
+    os_sem_release(&bs_rx.sem);
+}
+
+static void
+bs_rx_store(uint8_t byte)
+{
+    uint8_t b;
+
+    b = bs_rx.cur;
+    if (bs_rx.len[b] >= bs_rx.size - 1) {
+        bs_rx.state = bs_rx.slip[b] ? BS_RX_DROP_SLIP : BS_RX_DROP_LINE;
+        return;
+    }
+    bs_rx.buf[b][bs_rx.len[b]++] = byte;
+}
+
+/*
+ * Called from UART interrupt.
+ */
+static int
+bs_rx_char(void *arg, uint8_t byte)
+{
+    uint8_t b;
+
+    b = bs_rx.cur;
+    switch (bs_rx.state) {
+    case BS_RX_IDLE:
+        if (byte == '\n' || byte == '\r') {
+            break;
+        }
+        if (bs_rx.full[b]) {
+            bs_rx.state =
+              (byte == SLIP_END) ? BS_RX_DROP_SLIP : BS_RX_DROP_LINE;
+            break;
+        }
+        bs_rx.len[b] = 0;
+        if (byte == SLIP_END) {
+            bs_rx.slip[b] = 1;
+            bs_rx.state = BS_RX_SLIP;
+        } else {
+            bs_rx.slip[b] = 0;
+            bs_rx.state = BS_RX_LINE;
+            bs_rx_store(byte);
+        }
+        break;
+    case BS_RX_LINE:
+        if (byte == '\n') {
+            bs_rx_done();
+        } else {
+            bs_rx_store(byte);
+        }
+        break;
+    case BS_RX_SLIP:
+        if (byte == SLIP_END) {
+            if (bs_rx.len[b]) {
+                bs_rx_done();
+            }
+        } else if (byte == SLIP_ESC) {
+            bs_rx.state = BS_RX_SLIP_ESC;
+        } else {
+            bs_rx_store(byte);
+        }
+        break;
+    case BS_RX_SLIP_ESC:
+        bs_rx.state = BS_RX_SLIP;
+        if (byte == SLIP_ESC_END) {
+            byte = SLIP_END;
+        } else if (byte == SLIP_ESC_ESC) {
+            byte = SLIP_ESC;
+        }
+        bs_rx_store(byte);
+        break;
+    case BS_RX_DROP_LINE:
+        if (byte == '\n') {
+            bs_rx.state = BS_RX_IDLE;
+        }
+        break;
+    case BS_RX_DROP_SLIP:
+        if (byte == SLIP_END) {
+            bs_rx.state = BS_RX_IDLE;
+        }
+        break;
+    }
+    return 0;
+}
+#else
+static void
+bs_write(const char *data, int len)
+{
+    console_write(data, len);
+}
+#endif
+
+static void
+boot_serial_output_slip(char *data, int len)
+{
+    char out[16];
+    int cnt;
+
+    cnt = 0;
+    out[cnt++] = SLIP_END;
+    while (len--) {
+        if (*data == (char)SLIP_END) {
+            out[cnt++] = SLIP_ESC;
+            out[cnt++] = SLIP_ESC_END;
+        } else if (*data == (char)SLIP_ESC) {
+            out[cnt++] = SLIP_ESC;
+            out[cnt++] = SLIP_ESC_ESC;
+        } else {
+            out[cnt++] = *data;
+        }
+        data++;
+        if (cnt >= sizeof(out) - 2) {
+            bs_write(out, cnt);
+            cnt = 0;
+        }
+    }
+    out[cnt++] = SLIP_END;
+    bs_write(out, cnt);
+}
+
 static void
 boot_serial_output(char *data, int len)
 {
@@ -338,7 +624,19 @@ boot_serial_output(char *data, int len)
     crc = crc16_ccitt(crc, data, len);
     crc = htons(crc);
 
-    console_write(pkt_start, sizeof(pkt_start));
+    if (bs_out_slip) {
+        totlen = 0;
+        memcpy(&buf[totlen], bs_hdr, sizeof(*bs_hdr));
+        totlen += sizeof(*bs_hdr);
+        memcpy(&buf[totlen], data, len);
+        totlen += len;
+        memcpy(&buf[totlen], &crc, sizeof(crc));
+        totlen += sizeof(crc);
+        boot_serial_output_slip(buf, totlen);
+        return;
+    }
+
+    bs_write(pkt_start, sizeof(pkt_start));
 
     totlen = len + sizeof(*bs_hdr) + sizeof(crc);
     totlen = htons(totlen);
@@ -352,10 +650,50 @@ boot_serial_output(char *data, int len)
     memcpy(&buf[totlen], &crc, sizeof(crc));
     totlen += sizeof(crc);
     totlen = base64_encode(buf, totlen, encoded_buf, 1);
-    console_write(encoded_buf, totlen);
-    console_write("\n", 1);
+    bs_write(encoded_buf, totlen);
+    bs_write("\n", 1);
 }
 
+#ifdef BOOT_SERIAL_UART
+/*
+ * Task which drives the UART directly, expecting to get image over
+ * serial port either as base64 lines or as SLIP frames.
+ */
+static void
+boot_serial(void *arg)
+{
+    int max_input = (int)arg;
+    uint8_t b;
+    int rc;
+
+    bs_rx.size = max(max_input, BOOT_SERIAL_FRAME_MAX);
+    bs_rx.buf[0] = os_malloc(bs_rx.size);
+    bs_rx.buf[1] = os_malloc(bs_rx.size);
+    assert(bs_rx.buf[0] && bs_rx.buf[1]);
+    os_sem_init(&bs_rx.sem, 0);
+
+    rc = hal_uart_init_cbs(CONSOLE_UART, bs_tx_char, NULL, bs_rx_char, NULL);
+    assert(rc == 0);
+    rc = hal_uart_config(CONSOLE_UART, BOOT_SERIAL_BAUD, 8, 1,
+      HAL_UART_PARITY_NONE, HAL_UART_FLOW_CTL_NONE);
+    assert(rc == 0);
+
+    b = 0;
+    while (1) {
+        os_sem_pend(&bs_rx.sem, OS_TIMEOUT_NEVER);
+        assert(bs_rx.full[b]);
+        if (bs_rx.slip[b]) {
+            boot_serial_input_frame(bs_rx.buf[b], bs_rx.len[b]);
+        } else if (bs_rx.len[b] > 2 &&
+          bs_rx.buf[b][0] == SHELL_NLIP_PKT_START1 &&
+          bs_rx.buf[b][1] == SHELL_NLIP_PKT_START2) {
+            boot_serial_input(&bs_rx.buf[b][2], bs_rx.len[b] - 2);
+        }
+        bs_rx.full[b] = 0;
+        b ^= 1;
+    }
+}
+#else
 /*
  * Task which waits reading console, expecting to get image over
  * serial port.
@@ -393,6 +731,7 @@ boot_serial(void *arg)
         off = 0;
     }
 }
+#endif
 
 int
 boot_serial_task_init(struct os_task *task, uint8_t prio, os_stack_t *stack,
@@ -54,8 +54,37 @@ struct nmgr_hdr {
  */
 #define IMGMGR_NMGR_OP_LIST             0
 #define IMGMGR_NMGR_OP_UPLOAD           1
+#define IMGMGR_NMGR_OP_UPLOAD_RAW       8
+
+/*
+ * Raw upload request; in network byte order, followed by data.
+ */
+struct imgmgr_upload_cmd {
+    uint32_t iuc_off;
+    uint32_t iuc_len;           /* image size, inspected when off = 0 */
+};
+
+/*
+ * Binary frames are SLIP encoded: nmgr_hdr, payload and CRC16 of the two,
+ * delimited by SLIP_END. Responses go out the same way as the request came
+ * in.
+ */
+#define SLIP_END                0300
+#define SLIP_ESC                0333
+#define SLIP_ESC_END            0334
+#define SLIP_ESC_ESC            0335
+
+/*
+ * Size of the receive buffers when boot_serial drives the UART itself.
+ * There are 2, so one frame can be received while the previous one is
+ * being written to flash.
+ */
+#ifndef BOOT_SERIAL_FRAME_MAX
+#define BOOT_SERIAL_FRAME_MAX   2048
+#endif
 
 
 void boot_serial_input(char *buf, int len);
+void boot_serial_input_frame(char *buf, int len);
 
 #endif /*  __BOOTUTIL_SERIAL_PRIV_H__ */
@@ -200,6 +200,61 @@ TEST_CASE(boot_serial_upload_bigger_image)
     }
 }
 
+TEST_CASE(boot_serial_upload_raw_frame)
+{
+    char img[1024];
+    char buf[sizeof(struct nmgr_hdr) + sizeof(struct imgmgr_upload_cmd) +
+      512 + sizeof(uint16_t)];
+    struct imgmgr_upload_cmd *cmd;
+    struct nmgr_hdr *hdr;
+    const struct flash_area *fap;
+    uint16_t crc;
+    int len;
+    int off;
+    int rc;
+    int i;
+
+    for (i = 0; i < sizeof(img); i++) {
+        img[i] = i * 7;
+    }
+
+    for (off = 0; off < sizeof(img); off += 512) {
+        hdr = (struct nmgr_hdr *)buf;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->nh_op = NMGR_OP_WRITE;
+        hdr->nh_group = htons(NMGR_GROUP_ID_IMAGE);
+        hdr->nh_id = IMGMGR_NMGR_OP_UPLOAD_RAW;
+        hdr->nh_len = htons(sizeof(*cmd) + 512);
+
+        cmd = (struct imgmgr_upload_cmd *)(hdr + 1);
+        cmd->iuc_off = htonl(off);
+        cmd->iuc_len = htonl(sizeof(img));
+        memcpy(cmd + 1, &img[off], 512);
+
+        len = sizeof(*hdr) + sizeof(*cmd) + 512;
+        crc = htons(crc16_ccitt(CRC16_INITIAL_CRC, buf, len));
+        memcpy(&buf[len], &crc, sizeof(crc));
+        len += sizeof(crc);
+
+        boot_serial_input_frame(buf, len);
+    }
+
+    /*
+     * Frame with bad CRC is ignored.
+     */
+    buf[sizeof(*hdr)] ^= 1;
+    boot_serial_input_frame(buf, len);
+
+    rc = flash_area_open(FLASH_AREA_IMAGE_0, &fap);
+    assert(rc == 0);
+
+    for (off = 0; off < sizeof(img); off += 256) {
+        rc = flash_area_read(fap, off, buf, 256);
+        assert(rc == 0);
+        assert(!memcmp(buf, &img[off], 256));
+    }
+}
+
 TEST_SUITE(boot_serial_suite)
 {
     boot_serial_setup();
@@ -207,6 +262,7 @@ TEST_SUITE(boot_serial_suite)
     boot_serial_empty_img_msg();
     boot_serial_img_msg();
     boot_serial_upload_bigger_image();
+    boot_serial_upload_raw_frame();
 }
 
 int
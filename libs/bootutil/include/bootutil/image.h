@@ -32,6 +32,7 @@
 #define IMAGE_F_SHA256              0x00000002	/* Image contains hash TLV */
 #define IMAGE_F_PKCS15_RSA2048_SHA256   0x00000004 /* PKCS15 w/RSA and SHA */
 #define IMAGE_F_ECDSA224_SHA256     0x00000008  /* ECDSA256 over SHA256 */
+#define IMAGE_F_LZ4                 0x00000010  /* Body is LZ4 compressed image */
 
 #define IMAGE_HEADER_SIZE           32
 
@@ -42,6 +43,14 @@
 #define IMAGE_TLV_RSA2048           2	/* RSA2048 of hash output */
 #define IMAGE_TLV_ECDSA224          3   /* ECDSA of hash output */
 
+/*
+ * Body of an IMAGE_F_LZ4 image is the image to install, header and TLVs
+ * included, cut into blocks of at most IMAGE_LZ4_BLOCK_SZ bytes. Each block
+ * is compressed on its own in LZ4 block format, and preceded by its
+ * compressed length as 16 bit little endian value.
+ */
+#define IMAGE_LZ4_BLOCK_SZ          2048
+
 struct image_version {
     uint8_t iv_major;
     uint8_t iv_minor;
@@ -73,6 +82,34 @@ struct image_tlv {
     uint16_t it_len;
 };
 
+/*
+ * Delta image. Describes how to build an image out of the one currently
+ * running; struct image_delta_hdr followed by a stream of records. Each
+ * record is an opcode byte followed by a length as unsigned LEB128.
+ *
+ * COPY:   copy <len> bytes from source at the read position, and advance it.
+ * INSERT: <len> bytes of data follow; copy them to output.
+ * ADD:    <len> bytes of data follow; output is source byte at the read
+ *         position plus the data byte. Read position advances by <len>.
+ * SEEK:   move the read position; <len> is zigzag encoded, i.e. signed.
+ *
+ * The output is the complete image, including header and TLVs. All fields
+ * are in little endian byte order.
+ */
+#define IMAGE_DELTA_MAGIC           0x96f3d17a
+
+#define IMAGE_DELTA_OP_COPY         0
+#define IMAGE_DELTA_OP_INSERT       1
+#define IMAGE_DELTA_OP_ADD          2
+#define IMAGE_DELTA_OP_SEEK         3
+
+struct image_delta_hdr {
+    uint32_t idh_magic;
+    uint32_t idh_img_size;      /* Size of the resulting image */
+    uint8_t  idh_src_hash[32];  /* SHA256 TLV of the source image */
+    uint8_t  idh_img_hash[32];  /* SHA256 over all of the resulting image */
+};
+
 _Static_assert(sizeof(struct image_header) == IMAGE_HEADER_SIZE,
                "struct image_header not required size");
 
@@ -240,19 +240,26 @@ boot_read_status(struct boot_status *bs)
     uint8_t flash_id;
     uint32_t off;
 
+    bs->idx = 0;
+    bs->state = 0;
+
     /*
      * Check if boot_img_trailer is in scratch, or at the end of slot0.
+     * The trailer came from slot 1, and tells how many areas the copy
+     * skips.
      */
     boot_slot_magic(0, &bit);
     if (bit.bit_copy_start == BOOT_IMG_MAGIC && bit.bit_copy_done == 0xff) {
         boot_magic_loc(0, &flash_id, &off);
         boot_read_status_bytes(bs, flash_id, off);
+        bs->skip = bit.bit_copy_skip;
         return 1;
     }
     boot_scratch_magic(&bit);
     if (bit.bit_copy_start == BOOT_IMG_MAGIC && bit.bit_copy_done == 0xff) {
         boot_scratch_loc(&flash_id, &off);
         boot_read_status_bytes(bs, flash_id, off);
+        bs->skip = bit.bit_copy_skip;
         return 1;
     }
     return 0;
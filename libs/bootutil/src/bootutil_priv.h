@@ -29,7 +29,15 @@
 #define BOOT_EBADSTATUS 5
 #define BOOT_ENOMEM     6
 
-#define BOOT_TMPBUF_SZ  256
+#define BOOT_TMPBUF_SZ  1024
+
+/*
+ * Size of the buffer used when copying between slots and scratch, if flash
+ * is not memory mapped.
+ */
+#ifndef BOOT_COPY_BUF_SZ
+#define BOOT_COPY_BUF_SZ    4096
+#endif
 
 struct boot_image_location {
     uint8_t bil_flash_id;
@@ -41,6 +49,7 @@ struct boot_image_location {
  */
 struct boot_status {
     uint32_t idx;       /* Which area we're operating on */
+    uint16_t skip;      /* Areas left alone, as recorded in trailer */
     uint8_t elem_sz;    /* Size of the status element to write in bytes */
     uint8_t state;      /* Which part of the swapping process are we at */
 };
@@ -53,9 +62,26 @@ struct boot_img_trailer {
     uint32_t bit_copy_start;
     uint8_t  bit_copy_done;
     uint8_t  bit_img_ok;
-    uint16_t _pad;
+    uint16_t bit_copy_skip;     /* Areas not swapped; 0xffff if unknown */
+};
+
+/*
+ * Record of a successful validation of the image in slot 0. Lives in the
+ * status area just below the copy status bytes, so it is erased along with
+ * them whenever a new image is swapped in.
+ */
+#define BOOT_IMG_VALIDATED_MAGIC    0x7a1d7a1d
+struct boot_img_validated {
+    uint32_t biv_magic;
+    uint32_t _pad;
+    uint8_t  biv_hash[32];      /* SHA256 of the validated image */
 };
 
+int bootutil_img_validate_hash(struct image_header *hdr, uint8_t flash_id,
+  uint32_t addr, uint8_t *tmp_buf, uint32_t tmp_buf_sz,
+  const uint8_t *known_hash, uint8_t *hash_out);
+int bootutil_img_validate_tlvs(struct image_header *hdr, const uint8_t *hash,
+  const uint8_t *tlvs);
 int bootutil_verify_sig(uint8_t *hash, uint32_t hlen, uint8_t *sig, int slen,
     uint8_t key_id);
 
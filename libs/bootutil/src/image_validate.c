@@ -35,13 +35,22 @@
 
 /*
  * Compute SHA256 over the image.
+ *
+ * Memory-mapped flash is hashed in place. Otherwise tmp_buf is split in two
+ * so that, on flash which can read in the background, the next block is
+ * read while the current one is being hashed.
  */
 static int
 bootutil_img_hash(struct image_header *hdr, uint8_t flash_id, uint32_t addr,
   uint8_t *tmp_buf, uint32_t tmp_buf_sz, uint8_t *hash_result)
 {
     mbedtls_sha256_context sha256_ctx;
+    const void *img;
+    uint8_t *cur_buf;
+    uint8_t *next_buf;
+    uint8_t *swap_buf;
     uint32_t blk_sz;
+    uint32_t next_sz;
     uint32_t size;
     uint32_t off;
     int rc;
@@ -49,23 +58,59 @@ bootutil_img_hash(struct image_header *hdr, uint8_t flash_id, uint32_t addr,
     mbedtls_sha256_init(&sha256_ctx);
     mbedtls_sha256_starts(&sha256_ctx, 0);
 
-    size = hdr->ih_img_size + hdr->ih_hdr_size;
-
     /*
      * Hash is computed over image header and image itself. No TLV is
      * included ATM.
      */
     size = hdr->ih_img_size + hdr->ih_hdr_size;
-    for (off = 0; off < size; off += blk_sz) {
-        blk_sz = size - off;
-        if (blk_sz > tmp_buf_sz) {
-            blk_sz = tmp_buf_sz;
+
+    img = hal_flash_mmap(flash_id, addr, size);
+    if (img) {
+        mbedtls_sha256_update(&sha256_ctx, img, size);
+        mbedtls_sha256_finish(&sha256_ctx, hash_result);
+        return 0;
+    }
+
+    tmp_buf_sz /= 2;
+    if (tmp_buf_sz == 0) {
+        return -1;
+    }
+    cur_buf = tmp_buf;
+    next_buf = tmp_buf + tmp_buf_sz;
+
+    off = 0;
+    blk_sz = size;
+    if (blk_sz > tmp_buf_sz) {
+        blk_sz = tmp_buf_sz;
+    }
+    rc = hal_flash_read_start(flash_id, addr, cur_buf, blk_sz);
+    if (rc) {
+        return rc;
+    }
+    while (blk_sz) {
+        while (hal_flash_busy(flash_id)) {
         }
-        rc = hal_flash_read(flash_id, addr + off, tmp_buf, blk_sz);
-        if (rc) {
-            return rc;
+
+        /* Start reading the next block before hashing this one */
+        next_sz = size - off - blk_sz;
+        if (next_sz > tmp_buf_sz) {
+            next_sz = tmp_buf_sz;
         }
-        mbedtls_sha256_update(&sha256_ctx, tmp_buf, blk_sz);
+        if (next_sz) {
+            rc = hal_flash_read_start(flash_id, addr + off + blk_sz, next_buf,
+              next_sz);
+            if (rc) {
+                return rc;
+            }
+        }
+
+        mbedtls_sha256_update(&sha256_ctx, cur_buf, blk_sz);
+
+        swap_buf = cur_buf;
+        cur_buf = next_buf;
+        next_buf = swap_buf;
+        off += blk_sz;
+        blk_sz = next_sz;
     }
     mbedtls_sha256_finish(&sha256_ctx, hash_result);
 
@@ -73,76 +118,96 @@ bootutil_img_hash(struct image_header *hdr, uint8_t flash_id, uint32_t addr,
 }
 
 /*
- * Verify the integrity of the image.
- * Return non-zero if image could not be validated/does not validate.
+ * Check that header has the flags for hash and signature which are
+ * required.
  */
-int
-bootutil_img_validate(struct image_header *hdr, uint8_t flash_id, uint32_t addr,
-  uint8_t *tmp_buf, uint32_t tmp_buf_sz)
+static int
+bootutil_img_flags_ok(struct image_header *hdr)
 {
-    uint32_t off;
-    uint32_t size;
-    uint32_t sha_off = 0;
-#if defined(IMAGE_SIGNATURES_RSA) || defined(IMAGE_SIGNATURES_EC)
-    uint32_t sig_off = 0;
-    uint32_t sig_len = 0;
-#endif
-    struct image_tlv tlv;
-    uint8_t buf[256];
-    uint8_t hash[32];
-    int rc;
-
 #ifdef IMAGE_SIGNATURES_RSA
     if ((hdr->ih_flags & IMAGE_F_PKCS15_RSA2048_SHA256) == 0) {
-        return -1;
+        return 0;
     }
 #endif
 #ifdef IMAGE_SIGNATURES_EC
     if ((hdr->ih_flags & IMAGE_F_ECDSA224_SHA256) == 0) {
-        return -1;
+        return 0;
     }
 #endif
     if ((hdr->ih_flags & IMAGE_F_SHA256) == 0) {
-        return -1;
+        return 0;
     }
+    return 1;
+}
 
-    rc = bootutil_img_hash(hdr, flash_id, addr, tmp_buf, tmp_buf_sz, hash);
-    if (rc) {
-        return rc;
+/*
+ * Read from TLV area; from flash at addr, or from RAM if tlvs is given.
+ */
+static int
+bootutil_tlv_read(uint8_t flash_id, uint32_t addr, const uint8_t *tlvs,
+  uint32_t off, void *dst, uint32_t len)
+{
+    if (tlvs) {
+        memcpy(dst, tlvs + off, len);
+        return 0;
     }
+    return hal_flash_read(flash_id, addr + off, dst, len);
+}
 
-    /*
-     * After image there's TLVs.
-     */
-    off = hdr->ih_img_size + hdr->ih_hdr_size;
-    size = off + hdr->ih_tlv_size;
+/*
+ * Check image hash against the TLVs, and verify signature.
+ */
+static int
+bootutil_img_check_tlvs(struct image_header *hdr, const uint8_t *hash,
+  uint8_t flash_id, uint32_t addr, const uint8_t *tlvs,
+  const uint8_t *known_hash)
+{
+    uint32_t off;
+    uint32_t size;
+    uint32_t sha_off = 0;
+#if defined(IMAGE_SIGNATURES_RSA) || defined(IMAGE_SIGNATURES_EC)
+    uint32_t sig_off = 0;
+    uint32_t sig_len = 0;
+#endif
+    struct image_tlv tlv;
+    uint8_t buf[256];
+    int rc;
 
-    for (; off < size; off += sizeof(tlv) + tlv.it_len) {
-        rc = hal_flash_read(flash_id, addr + off, &tlv, sizeof(tlv));
+    size = hdr->ih_tlv_size;
+
+    for (off = 0; off < size; off += sizeof(tlv) + tlv.it_len) {
+        if (tlvs && off + sizeof(tlv) > size) {
+            return -1;
+        }
+        rc = bootutil_tlv_read(flash_id, addr, tlvs, off, &tlv, sizeof(tlv));
         if (rc) {
             return rc;
         }
+        if (tlvs && off + sizeof(tlv) + tlv.it_len > size) {
+            return -1;
+        }
         if (tlv.it_type == IMAGE_TLV_SHA256) {
-            if (tlv.it_len != sizeof(hash)) {
+            if (tlv.it_len != 32) {
                 return -1;
             }
-            sha_off = addr + off + sizeof(tlv);
+            sha_off = off + sizeof(tlv);
         }
 #ifdef IMAGE_SIGNATURES_RSA
         if (tlv.it_type == IMAGE_TLV_RSA2048) {
             if (tlv.it_len != 256) { /* 2048 bits */
                 return -1;
             }
-            sig_off = addr + off + sizeof(tlv);
+            sig_off = off + sizeof(tlv);
             sig_len = tlv.it_len;
         }
 #endif
 #ifdef IMAGE_SIGNATURES_EC
         if (tlv.it_type == IMAGE_TLV_ECDSA224) {
-            if (tlv.it_len < 64) { /* oids + 2 * 28 bytes */
+            if (tlv.it_len < 64 || tlv.it_len > sizeof(buf)) {
+                /* oids + 2 * 28 bytes */
                 return -1;
             }
-            sig_off = addr + off + sizeof(tlv);
+            sig_off = off + sizeof(tlv);
             sig_len = tlv.it_len;
         }
 #endif
@@ -154,11 +219,11 @@ bootutil_img_validate(struct image_header *hdr, uint8_t flash_id, uint32_t addr,
              */
             return -1;
         }
-        rc = hal_flash_read(flash_id, sha_off, buf, sizeof(hash));
+        rc = bootutil_tlv_read(flash_id, addr, tlvs, sha_off, buf, 32);
         if (rc) {
             return rc;
         }
-        if (memcmp(hash, buf, sizeof(hash))) {
+        if (memcmp(hash, buf, 32)) {
             return -1;
         }
     }
@@ -170,18 +235,86 @@ bootutil_img_validate(struct image_header *hdr, uint8_t flash_id, uint32_t addr,
          */
         return -1;
     }
-    rc = hal_flash_read(flash_id, sig_off, buf, sig_len);
+    rc = bootutil_tlv_read(flash_id, addr, tlvs, sig_off, buf, sig_len);
     if (rc) {
         return -1;
     }
 
-    if (hdr->ih_key_id >= bootutil_key_cnt) {
+    if (!known_hash || memcmp(hash, known_hash, 32)) {
+        if (hdr->ih_key_id >= bootutil_key_cnt) {
+            return -1;
+        }
+        rc = bootutil_verify_sig((uint8_t *)hash, 32, buf, sig_len,
+          hdr->ih_key_id);
+        if (rc) {
+            return -1;
+        }
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Verify the integrity of the image.
+ *
+ * If known_hash is given, and the image hashes to it, the image is known to
+ * have passed signature verification before and that step is skipped. The
+ * image hash is always recomputed, so any change to the image is caught.
+ * If hash_out is given, the computed hash is returned there.
+ *
+ * Return non-zero if image could not be validated/does not validate.
+ */
+int
+bootutil_img_validate_hash(struct image_header *hdr, uint8_t flash_id,
+  uint32_t addr, uint8_t *tmp_buf, uint32_t tmp_buf_sz,
+  const uint8_t *known_hash, uint8_t *hash_out)
+{
+    uint8_t hash[32];
+    int rc;
+
+    if (!bootutil_img_flags_ok(hdr)) {
         return -1;
     }
-    rc = bootutil_verify_sig(hash, sizeof(hash), buf, sig_len, hdr->ih_key_id);
+
+    rc = bootutil_img_hash(hdr, flash_id, addr, tmp_buf, tmp_buf_sz, hash);
     if (rc) {
-        return -1;
+        return rc;
+    }
+
+    /*
+     * After image there's TLVs.
+     */
+    rc = bootutil_img_check_tlvs(hdr, hash, flash_id,
+      addr + hdr->ih_img_size + hdr->ih_hdr_size, NULL, known_hash);
+    if (rc) {
+        return rc;
+    }
+    if (hash_out) {
+        memcpy(hash_out, hash, sizeof(hash));
     }
-#endif
     return 0;
 }
+
+/*
+ * Verify an image which is not in flash; caller has computed the hash
+ * over header and body, and has the TLVs in RAM.
+ *
+ * Return non-zero if image does not validate.
+ */
+int
+bootutil_img_validate_tlvs(struct image_header *hdr, const uint8_t *hash,
+  const uint8_t *tlvs)
+{
+    if (!bootutil_img_flags_ok(hdr)) {
+        return -1;
+    }
+    return bootutil_img_check_tlvs(hdr, hash, 0, 0, tlvs, NULL);
+}
+
+int
+bootutil_img_validate(struct image_header *hdr, uint8_t flash_id, uint32_t addr,
+  uint8_t *tmp_buf, uint32_t tmp_buf_sz)
+{
+    return bootutil_img_validate_hash(hdr, flash_id, addr, tmp_buf, tmp_buf_sz,
+      NULL, NULL);
+}
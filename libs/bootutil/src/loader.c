@@ -23,7 +23,11 @@
 #include <string.h>
 #include <hal/flash_map.h>
 #include <hal/hal_flash.h>
+#include <os/os.h>
 #include <os/os_malloc.h>
+#ifdef BOOTUTIL_LZ4
+#include <mbedtls/sha256.h>
+#endif
 #include "bootutil/loader.h"
 #include "bootutil/image.h"
 #include "bootutil/bootutil_misc.h"
@@ -44,6 +48,9 @@ static struct boot_img {
 
 static struct boot_status boot_state;
 
+/** Buffer for moving data between flash areas. */
+static uint8_t boot_copy_buf[BOOT_COPY_BUF_SZ];
+
 static int boot_erase_area(int area_idx, uint32_t sz);
 static uint32_t boot_copy_sz(int max_idx, int *cnt);
 
@@ -188,6 +195,75 @@ boot_image_check(struct image_header *hdr, struct boot_image_location *loc)
     return 0;
 }
 
+#ifdef BOOTUTIL_VALIDATE_SLOT0
+/*
+ * Location of the validation record of slot 0; just below the area
+ * reserved for copy status.
+ */
+static void
+boot_validated_loc(uint8_t *flash_id, uint32_t *off)
+{
+    boot_magic_loc(0, flash_id, off);
+    *off -= 32 * sizeof(uint32_t) + sizeof(struct boot_img_validated);
+}
+
+/*
+ * Validate image in slot 0 before booting it. Full signature check is done
+ * only once per image; after that the result is recorded in the status
+ * area, and later boots just check that the image still hashes to the same
+ * value.
+ */
+static int
+boot_slot0_check(void)
+{
+    static void *tmpbuf;
+    struct boot_img_validated biv;
+    const uint8_t *known_hash;
+    uint8_t hash[32];
+    uint32_t off;
+    uint8_t flash_id;
+    int i;
+
+    if (!tmpbuf) {
+        tmpbuf = malloc(BOOT_TMPBUF_SZ);
+        if (!tmpbuf) {
+            return BOOT_ENOMEM;
+        }
+    }
+    boot_validated_loc(&flash_id, &off);
+    memset(&biv, 0xff, sizeof(biv));
+    hal_flash_read(flash_id, off, &biv, sizeof(biv));
+
+    if (biv.biv_magic == BOOT_IMG_VALIDATED_MAGIC) {
+        known_hash = biv.biv_hash;
+    } else {
+        known_hash = NULL;
+    }
+    if (bootutil_img_validate_hash(&boot_img[0].hdr, flash_id,
+        boot_img[0].loc.bil_address, tmpbuf, BOOT_TMPBUF_SZ, known_hash,
+        hash)) {
+        return BOOT_EBADIMAGE;
+    }
+    if (known_hash) {
+        return 0;
+    }
+
+    /*
+     * Record the result, but only if the area is still erased; a stale
+     * record can't be overwritten without erasing the image with it.
+     */
+    for (i = 0; i < sizeof(biv); i++) {
+        if (((uint8_t *)&biv)[i] != 0xff) {
+            return 0;
+        }
+    }
+    biv.biv_magic = BOOT_IMG_VALIDATED_MAGIC;
+    memcpy(biv.biv_hash, hash, sizeof(hash));
+    (void)hal_flash_write(flash_id, off, &biv, sizeof(biv));
+    return 0;
+}
+#endif
+
 /**
  * Selects a slot number to boot from.
  *
@@ -220,6 +296,14 @@ boot_select_image_slot(void)
         boot_slot_magic(i, &bit);
         if (bit.bit_copy_start == BOOT_IMG_MAGIC) {
             rc = boot_image_check(&b->hdr, &b->loc);
+#ifndef BOOTUTIL_LZ4
+            if (b->hdr.ih_flags & IMAGE_F_LZ4) {
+                /*
+                 * Can't install compressed images.
+                 */
+                rc = BOOT_EBADIMAGE;
+            }
+#endif
             if (rc) {
                 /*
                  * Image fails integrity check. Erase it.
@@ -236,7 +320,12 @@ boot_select_image_slot(void)
 static int
 boot_status_sz(void)
 {
+#ifdef BOOTUTIL_VALIDATE_SLOT0
+    return sizeof(struct boot_img_trailer) + 32 * sizeof(uint32_t) +
+      sizeof(struct boot_img_validated);
+#else
     return sizeof(struct boot_img_trailer) + 32 * sizeof(uint32_t);
+#endif
 }
 
 /*
@@ -269,6 +358,101 @@ boot_copy_sz(int max_idx, int *cnt)
     return sz;
 }
 
+/*
+ * Offset of area within image slot 0.
+ */
+static uint32_t
+boot_area_off(int idx)
+{
+    const struct flash_area *slot_start;
+
+    slot_start = boot_req->br_area_descs + boot_req->br_slot_areas[0];
+    return slot_start[idx].fa_off - slot_start[0].fa_off;
+}
+
+/*
+ * How much of the image slots has to be swapped; the end of the larger
+ * image. Slots which don't hold a valid image are swapped in full.
+ */
+static uint32_t
+boot_copy_end(void)
+{
+    struct image_header *hdr;
+    uint32_t end;
+    uint32_t sz;
+    int i;
+
+    end = 0;
+    for (i = 0; i < BOOT_NUM_SLOTS; i++) {
+        hdr = &boot_img[i].hdr;
+        if (hdr->ih_magic != IMAGE_MAGIC) {
+            return boot_img[i].area;
+        }
+        sz = IMAGE_SIZE(hdr);
+        if (sz > end) {
+            end = sz;
+        }
+    }
+    return end;
+}
+
+/*
+ * Number of areas moved through scratch in a full swap. If skip is given,
+ * it is set to how many of them, counting down from the one below the
+ * last, lie beyond the end of both images.
+ */
+static int
+boot_copy_cnt(uint16_t *skip)
+{
+    uint32_t copy_end;
+    int area_cnt;
+    int cnt;
+    int i;
+
+    copy_end = 0;
+    if (skip) {
+        copy_end = boot_copy_end();
+        *skip = 0;
+    }
+    for (i = boot_req->br_slot_areas[1], area_cnt = 0; i > 0; area_cnt++) {
+        boot_copy_sz(i, &cnt);
+        i -= cnt;
+        if (skip && area_cnt > 0 && boot_area_off(i) >= copy_end) {
+            (*skip)++;
+        }
+    }
+    return area_cnt;
+}
+
+/*
+ * Records in the trailer of slot 1 how many areas the swap leaves alone.
+ * This is done before anything is erased; the trailer moves with the last
+ * area, first to scratch and then to slot 0, where boot_read_status() finds
+ * it if the swap gets interrupted. The headers can't be used for this when
+ * resuming, as the area holding them might be halfway through its swap.
+ *
+ * Returns the count as stored in flash, so that this copy and any resumed
+ * one agree.
+ */
+static uint16_t
+boot_copy_skip_write(void)
+{
+    struct boot_img_trailer bit;
+    uint16_t skip;
+    uint32_t off;
+    uint8_t flash_id;
+
+    boot_slot_magic(1, &bit);
+    if (bit.bit_copy_skip == 0xffff) {
+        boot_copy_cnt(&skip);
+        boot_magic_loc(1, &flash_id, &off);
+        off += offsetof(struct boot_img_trailer, bit_copy_skip);
+        (void)hal_flash_write(flash_id, off, &skip, sizeof(skip));
+        boot_slot_magic(1, &bit);
+    }
+    return bit.bit_copy_skip;
+}
+
 /**
  * Erase one area.  The destination area must
  * be erased prior to this function being called.
@@ -307,37 +491,46 @@ boot_copy_area(int from_area_idx, int to_area_idx, uint32_t sz)
 {
     const struct flash_area *from_area_desc;
     const struct flash_area *to_area_desc;
+    const void *src;
     uint32_t from_addr;
     uint32_t to_addr;
     uint32_t off;
     int chunk_sz;
     int rc;
 
-    static uint8_t buf[1024];
-
     from_area_desc = boot_req->br_area_descs + from_area_idx;
     to_area_desc = boot_req->br_area_descs + to_area_idx;
 
     assert(to_area_desc->fa_size >= from_area_desc->fa_size);
 
+    /*
+     * If source is memory mapped, write straight from flash in one go.
+     */
+    src = hal_flash_mmap(from_area_desc->fa_flash_id, from_area_desc->fa_off,
+                         sz);
+    if (src) {
+        return hal_flash_write(to_area_desc->fa_flash_id, to_area_desc->fa_off,
+                               src, sz);
+    }
+
     off = 0;
     while (off < sz) {
-        if (sz - off > sizeof buf) {
-            chunk_sz = sizeof buf;
+        if (sz - off > sizeof boot_copy_buf) {
+            chunk_sz = sizeof boot_copy_buf;
         } else {
             chunk_sz = sz - off;
         }
 
         from_addr = from_area_desc->fa_off + off;
-        rc = hal_flash_read(from_area_desc->fa_flash_id, from_addr, buf,
-                            chunk_sz);
+        rc = hal_flash_read(from_area_desc->fa_flash_id, from_addr,
+                            boot_copy_buf, chunk_sz);
         if (rc != 0) {
             return rc;
         }
 
         to_addr = to_area_desc->fa_off + off;
-        rc = hal_flash_write(to_area_desc->fa_flash_id, to_addr, buf,
-                             chunk_sz);
+        rc = hal_flash_write(to_area_desc->fa_flash_id, to_addr,
+                             boot_copy_buf, chunk_sz);
         if (rc != 0) {
             return rc;
         }
@@ -420,6 +613,326 @@ boot_swap_areas(int idx, uint32_t sz, int end_area)
     return 0;
 }
 
+#ifdef BOOTUTIL_LZ4
+#if BOOT_COPY_BUF_SZ < 2 * IMAGE_LZ4_BLOCK_SZ
+#error "BOOT_COPY_BUF_SZ too small for decompressing images"
+#endif
+
+/*
+ * Largest TLV area of compressed image that can be validated before
+ * installing it.
+ */
+#define BOOT_LZ_TLV_SZ      512
+
+/*
+ * State of LZ4 decompression from slot 1 to slot 0. Blocks are compressed
+ * independently, so each one is decoded whole in RAM. The only RAM needed
+ * is boot_copy_buf; the first half buffers input, second half holds the
+ * decoded block.
+ */
+struct boot_lz {
+    uint8_t *in_buf;
+    uint8_t *out_buf;
+    uint32_t in_addr;           /* Next flash address to read */
+    uint32_t in_end;
+    uint32_t in_pos;            /* Read position in in_buf */
+    uint32_t in_len;            /* Bytes in in_buf */
+    uint32_t blk_left;          /* Input left in current block */
+    uint32_t out_addr;          /* Start of output */
+    uint32_t out_off;           /* Bytes produced before current block */
+    uint32_t out_cnt;           /* Bytes in current block */
+    uint32_t out_max;
+    uint8_t in_id;
+    uint8_t out_id;
+};
+
+/*
+ * What is gathered of the image when validating it before install.
+ */
+struct boot_lz_check {
+    mbedtls_sha256_context sha;
+    struct image_header hdr;
+    uint8_t tlvs[BOOT_LZ_TLV_SZ];
+};
+
+static int
+boot_lz_read(struct boot_lz *lz)
+{
+    uint32_t len;
+
+    if (lz->in_pos == lz->in_len) {
+        if (lz->in_addr == lz->in_end) {
+            return -1;
+        }
+        len = min(lz->in_end - lz->in_addr, IMAGE_LZ4_BLOCK_SZ);
+        if (hal_flash_read(lz->in_id, lz->in_addr, lz->in_buf, len)) {
+            return -1;
+        }
+        lz->in_addr += len;
+        lz->in_pos = 0;
+        lz->in_len = len;
+    }
+    return lz->in_buf[lz->in_pos++];
+}
+
+/*
+ * Next byte of the current block.
+ */
+static int
+boot_lz_getc(struct boot_lz *lz)
+{
+    if (lz->blk_left == 0) {
+        return -1;
+    }
+    lz->blk_left--;
+    return boot_lz_read(lz);
+}
+
+static int
+boot_lz_eof(struct boot_lz *lz)
+{
+    return lz->in_pos == lz->in_len && lz->in_addr == lz->in_end;
+}
+
+/*
+ * Length extension; bytes of 255 followed by the last one.
+ */
+static int
+boot_lz_len(struct boot_lz *lz, uint32_t *len)
+{
+    int c;
+
+    do {
+        c = boot_lz_getc(lz);
+        if (c < 0) {
+            return -1;
+        }
+        *len += c;
+    } while (c == 255);
+    return 0;
+}
+
+/*
+ * Decode one block into out_buf.
+ */
+static int
+boot_lz_block(struct boot_lz *lz)
+{
+    uint32_t len;
+    uint32_t off;
+    int tok;
+    int c;
+
+    tok = boot_lz_read(lz);
+    c = boot_lz_read(lz);
+    if (tok < 0 || c < 0) {
+        return -1;
+    }
+    lz->blk_left = tok | (c << 8);
+    lz->out_off += lz->out_cnt;
+    lz->out_cnt = 0;
+
+    while (lz->blk_left) {
+        tok = boot_lz_getc(lz);
+        if (tok < 0) {
+            return -1;
+        }
+        len = tok >> 4;
+        if (len == 15 && boot_lz_len(lz, &len)) {
+            return -1;
+        }
+        if (len > IMAGE_LZ4_BLOCK_SZ - lz->out_cnt) {
+            return -1;
+        }
+        while (len--) {
+            c = boot_lz_getc(lz);
+            if (c < 0) {
+                return -1;
+            }
+            lz->out_buf[lz->out_cnt++] = c;
+        }
+        if (lz->blk_left == 0) {
+            /*
+             * Last sequence has only literals.
+             */
+            break;
+        }
+        off = boot_lz_getc(lz);
+        c = boot_lz_getc(lz);
+        if (c < 0) {
+            return -1;
+        }
+        off |= c << 8;
+        len = tok & 0xf;
+        if (len == 15 && boot_lz_len(lz, &len)) {
+            return -1;
+        }
+        len += 4;
+        if (off == 0 || off > lz->out_cnt ||
+          len > IMAGE_LZ4_BLOCK_SZ - lz->out_cnt) {
+            return -1;
+        }
+        /*
+         * Byte at a time, as source and destination can overlap.
+         */
+        while (len--) {
+            lz->out_buf[lz->out_cnt] = lz->out_buf[lz->out_cnt - off];
+            lz->out_cnt++;
+        }
+    }
+    if (lz->out_cnt == 0 || lz->out_off + lz->out_cnt > lz->out_max) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Hash the decoded block, and pick up header and TLVs from it.
+ */
+static int
+boot_lz_check_block(struct boot_lz *lz, struct boot_lz_check *chk)
+{
+    struct image_header *hdr;
+    uint32_t start;
+    uint32_t end;
+    uint32_t hash_end;
+    uint32_t tlv_end;
+
+    hdr = &chk->hdr;
+    start = lz->out_off;
+    end = start + lz->out_cnt;
+    if (start < sizeof(*hdr)) {
+        memcpy((uint8_t *)hdr + start, lz->out_buf,
+          min(end, sizeof(*hdr)) - start);
+    }
+    if (end < sizeof(*hdr)) {
+        mbedtls_sha256_update(&chk->sha, lz->out_buf, lz->out_cnt);
+        return 0;
+    }
+    if (hdr->ih_magic != IMAGE_MAGIC || hdr->ih_hdr_size < sizeof(*hdr) ||
+      hdr->ih_tlv_size > sizeof(chk->tlvs)) {
+        return -1;
+    }
+    hash_end = hdr->ih_hdr_size + hdr->ih_img_size;
+    tlv_end = hash_end + hdr->ih_tlv_size;
+    if (end > tlv_end) {
+        return -1;
+    }
+    if (start < hash_end) {
+        mbedtls_sha256_update(&chk->sha, lz->out_buf,
+          min(end, hash_end) - start);
+    }
+    if (end > hash_end) {
+        start = max(start, hash_end);
+        memcpy(chk->tlvs + start - hash_end,
+          lz->out_buf + start - lz->out_off, end - start);
+    }
+    return 0;
+}
+
+static void
+boot_lz_init(struct boot_lz *lz)
+{
+    struct boot_img *src;
+    struct boot_img *dst;
+
+    src = &boot_img[1];
+    dst = &boot_img[0];
+    memset(lz, 0, sizeof(*lz));
+    lz->in_buf = boot_copy_buf;
+    lz->out_buf = boot_copy_buf + IMAGE_LZ4_BLOCK_SZ;
+    lz->in_id = src->loc.bil_flash_id;
+    lz->in_addr = src->loc.bil_address + src->hdr.ih_hdr_size;
+    lz->in_end = lz->in_addr + src->hdr.ih_img_size;
+    lz->out_id = dst->loc.bil_flash_id;
+    lz->out_addr = dst->loc.bil_address;
+    lz->out_max = dst->area - boot_status_sz();
+}
+
+/*
+ * Decode the image in slot 1 without writing anything, and validate the
+ * result like an image in flash would be.
+ */
+static int
+boot_lz_validate(void)
+{
+    static struct boot_lz_check chk;
+    struct boot_lz lz;
+    uint8_t hash[32];
+    int rc;
+
+    memset(&chk.hdr, 0xff, sizeof(chk.hdr));
+    mbedtls_sha256_init(&chk.sha);
+    mbedtls_sha256_starts(&chk.sha, 0);
+
+    boot_lz_init(&lz);
+    do {
+        if (boot_lz_block(&lz) || boot_lz_check_block(&lz, &chk)) {
+            return BOOT_EBADIMAGE;
+        }
+    } while (!boot_lz_eof(&lz));
+    mbedtls_sha256_finish(&chk.sha, hash);
+
+    if (lz.out_off + lz.out_cnt != IMAGE_SIZE(&chk.hdr) ||
+      (chk.hdr.ih_flags & IMAGE_F_LZ4)) {
+        return BOOT_EBADIMAGE;
+    }
+    rc = bootutil_img_validate_tlvs(&chk.hdr, hash, chk.tlvs);
+    if (rc) {
+        return BOOT_EBADIMAGE;
+    }
+    return 0;
+}
+
+/**
+ * Installs the compressed image in slot 1 by decompressing it over slot 0.
+ * The body of the image in slot 1 is the complete image to install, header
+ * and TLVs included, compressed.
+ *
+ * The decompressed image is validated before slot 0 is erased; if that
+ * fails, slot 1 is erased and slot 0 is left as it was. Once slot 0 has
+ * been erased there is no going back to the old image. If interrupted
+ * after that, the next boot starts over, as slot 1 is erased only after
+ * the new image in slot 0 has been validated.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+static int
+boot_decompress_image(void)
+{
+    struct boot_lz lz;
+    int rc;
+
+    rc = boot_lz_validate();
+    if (rc) {
+        boot_erase_area(boot_req->br_slot_areas[1], boot_img[1].area);
+        return 0;
+    }
+
+    rc = boot_erase_area(boot_req->br_slot_areas[0], boot_img[0].area);
+    if (rc) {
+        return rc;
+    }
+    boot_lz_init(&lz);
+    do {
+        if (boot_lz_block(&lz)) {
+            return BOOT_EFLASH;
+        }
+        if (hal_flash_write(lz.out_id, lz.out_addr + lz.out_off, lz.out_buf,
+          lz.out_cnt)) {
+            return BOOT_EFLASH;
+        }
+    } while (!boot_lz_eof(&lz));
+
+    boot_read_image_header(&boot_img[0].loc, &boot_img[0].hdr);
+    rc = boot_image_check(&boot_img[0].hdr, &boot_img[0].loc);
+    if (rc) {
+        return rc;
+    }
+    return boot_erase_area(boot_req->br_slot_areas[1], boot_img[1].area);
+}
+#endif
+
 /**
  * Swaps the two images in flash.  If a prior copy operation was interrupted
  * by a system reset, this function completes that operation.
@@ -434,13 +947,31 @@ boot_copy_image(void)
     int end_area = 1;
     int cnt;
     int cur_idx;
+    int skip;
 
-    for (i = boot_req->br_slot_areas[1], cur_idx = 0; i > 0; cur_idx++) {
+    /*
+     * Area with the headers is always swapped. Count which is missing, or
+     * torn by a reset while being written, means everything gets swapped.
+     */
+    skip = boot_state.skip;
+    if (skip >= boot_copy_cnt(NULL) - 1) {
+        skip = 0;
+    }
+    for (i = boot_req->br_slot_areas[1], cur_idx = 0; i > 0; ) {
         sz = boot_copy_sz(i, &cnt);
         i -= cnt;
+        if (!end_area && skip) {
+            /*
+             * Neither image extends this far; nothing worth swapping. Skipped
+             * areas don't count towards status index.
+             */
+            skip--;
+            continue;
+        }
         if (cur_idx >= boot_state.idx) {
             boot_swap_areas(i, sz, end_area);
         }
+        cur_idx++;
         end_area = 0;
     }
     boot_clear_status();
@@ -485,26 +1016,56 @@ boot_go(const struct boot_req *req, struct boot_rsp *rsp)
              */
             return rc;
         }
-    }
 
-    /*
-     * Check if we should initiate copy, or revert back to earlier image.
-     *
-     */
-    slot = boot_select_image_slot();
-    if (slot == -1) {
-        return BOOT_EBADIMAGE;
+        /*
+         * Headers were read mid-swap. Boot the image which was swapped in;
+         * picking the slot again would revert it before it ever ran.
+         */
+        boot_image_info();
+        slot = 0;
+    } else {
+        /*
+         * Check if we should initiate copy, or revert back to earlier image.
+         *
+         */
+        slot = boot_select_image_slot();
+        if (slot == -1) {
+            return BOOT_EBADIMAGE;
+        }
     }
 
+#ifdef BOOTUTIL_LZ4
+    if (slot && (boot_img[slot].hdr.ih_flags & IMAGE_F_LZ4)) {
+        rc = boot_decompress_image();
+        if (rc) {
+            return rc;
+        }
+        slot = 0;
+    }
+#endif
     if (slot) {
         boot_state.idx = 0;
         boot_state.state = 0;
+        boot_state.skip = boot_copy_skip_write();
         rc = boot_copy_image();
         if (rc) {
             return rc;
         }
     }
 
+#ifdef BOOTUTIL_VALIDATE_SLOT0
+    if (slot == 0) {
+        /*
+         * Image in slot 1 was just validated before the swap; check the one
+         * we've been booting all along.
+         */
+        rc = boot_slot0_check();
+        if (rc) {
+            return rc;
+        }
+    }
+#endif
+
     /* Always boot from the primary slot. */
     rsp->br_flash_id = boot_img[0].loc.bil_flash_id;
     rsp->br_image_addr = boot_img[0].loc.bil_address;
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <setjmp.h>
 #include "testutil/testutil.h"
 #include "hal/hal_flash.h"
 #include "hal/flash_map.h"
@@ -35,6 +36,9 @@
 #include "../src/bootutil_priv.h"
 
 #include "mbedtls/sha256.h"
+#ifdef ARCH_sim
+#include <mcu/mcu_sim.h>
+#endif
 
 #define BOOT_TEST_HEADER_SIZE       0x200
 
@@ -396,6 +400,243 @@ boot_test_util_verify_flash(const struct image_header *hdr0, int orig_slot_0,
     }
 }
 
+#ifdef ARCH_sim
+static jmp_buf boot_test_power_jb;
+
+static void
+boot_test_util_power_fail(void)
+{
+    longjmp(boot_test_power_jb, 1);
+}
+
+/*
+ * Runs boot_go() with power lost at flash write/erase number 'op'.
+ * Returns 1 if that happened, 0 if boot_go() finished before it.
+ */
+static int
+boot_test_util_go_fail_at(const struct boot_req *req, struct boot_rsp *rsp,
+                          uint32_t op)
+{
+    int rc;
+
+    native_flash_power_fail_at(op, boot_test_util_power_fail);
+    if (setjmp(boot_test_power_jb)) {
+        native_flash_power_on();
+        return 1;
+    }
+    rc = boot_go(req, rsp);
+    TEST_ASSERT(rc == 0);
+    native_flash_power_on();
+    return 0;
+}
+#endif
+
+#ifdef BOOTUTIL_LZ4
+static int
+boot_test_util_lz4_len(uint8_t *dst, uint32_t len)
+{
+    int cnt;
+
+    cnt = 0;
+    len -= 15;
+    while (len >= 255) {
+        dst[cnt++] = 255;
+        len -= 255;
+    }
+    dst[cnt++] = len;
+    return cnt;
+}
+
+/*
+ * Compress a block in LZ4 block format. Greedy, with brute force search
+ * for matches.
+ */
+static int
+boot_test_util_lz4_block(const uint8_t *src, int len, uint8_t *dst)
+{
+    int best_len;
+    int best_off;
+    int anchor;
+    int out;
+    int lit;
+    int i;
+    int j;
+    int k;
+
+    anchor = 0;
+    out = 0;
+    best_off = 0;
+    for (i = 0; i < len - 12; ) {
+        best_len = 0;
+        for (j = 0; j < i; j++) {
+            for (k = 0; i + k < len - 5 && src[j + k] == src[i + k]; k++) {
+            }
+            if (k > best_len) {
+                best_len = k;
+                best_off = i - j;
+            }
+        }
+        if (best_len < 4) {
+            i++;
+            continue;
+        }
+        lit = i - anchor;
+        dst[out++] = (min(lit, 15) << 4) | min(best_len - 4, 15);
+        if (lit >= 15) {
+            out += boot_test_util_lz4_len(dst + out, lit);
+        }
+        memcpy(dst + out, src + anchor, lit);
+        out += lit;
+        dst[out++] = best_off;
+        dst[out++] = best_off >> 8;
+        if (best_len - 4 >= 15) {
+            out += boot_test_util_lz4_len(dst + out, best_len - 4);
+        }
+        i += best_len;
+        anchor = i;
+    }
+    lit = len - anchor;
+    dst[out++] = min(lit, 15) << 4;
+    if (lit >= 15) {
+        out += boot_test_util_lz4_len(dst + out, lit);
+    }
+    memcpy(dst + out, src + anchor, lit);
+    out += lit;
+    return out;
+}
+
+/*
+ * Builds an image in RAM; part of the body repeats, so that it compresses.
+ * Returns the size.
+ */
+static uint32_t
+boot_test_util_lz4_img(const struct image_header *hdr, uint8_t *img)
+{
+    mbedtls_sha256_context ctx;
+    struct image_tlv tlv;
+    uint32_t off;
+    uint32_t i;
+
+    memset(img, 0xff, hdr->ih_hdr_size);
+    memcpy(img, hdr, sizeof(*hdr));
+    off = hdr->ih_hdr_size;
+    for (i = 0; i < hdr->ih_img_size; i++) {
+        if (i % 1024 < 512) {
+            img[off + i] = boot_test_util_byte_at(1, i);
+        } else {
+            img[off + i] = img[off + i - 512];
+        }
+    }
+    off += hdr->ih_img_size;
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, img, off);
+    tlv.it_type = IMAGE_TLV_SHA256;
+    tlv._pad = 0;
+    tlv.it_len = 32;
+    memcpy(img + off, &tlv, sizeof(tlv));
+    off += sizeof(tlv);
+    mbedtls_sha256_finish(&ctx, img + off);
+    return off + 32;
+}
+
+/*
+ * Compresses an image, and writes it to slot 1 as the body of a compressed
+ * image.
+ */
+static void
+boot_test_util_write_lz4(const uint8_t *img, uint32_t len)
+{
+    struct image_header hdr;
+    uint8_t *buf;
+    uint32_t off;
+    uint32_t blk;
+    int cnt;
+    int rc;
+
+    buf = malloc(len + len / 8 + 64);
+    TEST_ASSERT_FATAL(buf != NULL);
+    off = 0;
+    for (; len; len -= blk, img += blk) {
+        blk = min(len, IMAGE_LZ4_BLOCK_SZ);
+        cnt = boot_test_util_lz4_block(img, blk, buf + off + 2);
+        buf[off] = cnt;
+        buf[off + 1] = cnt >> 8;
+        off += 2 + cnt;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.ih_magic = IMAGE_MAGIC;
+    hdr.ih_tlv_size = 4 + 32;
+    hdr.ih_hdr_size = BOOT_TEST_HEADER_SIZE;
+    hdr.ih_img_size = off;
+    hdr.ih_flags = IMAGE_F_SHA256 | IMAGE_F_LZ4;
+
+    rc = hal_flash_write(boot_test_img_addrs[1].flash_id,
+                         boot_test_img_addrs[1].address, &hdr, sizeof(hdr));
+    TEST_ASSERT(rc == 0);
+    rc = hal_flash_write(boot_test_img_addrs[1].flash_id,
+                         boot_test_img_addrs[1].address + hdr.ih_hdr_size,
+                         buf, off);
+    TEST_ASSERT(rc == 0);
+    boot_test_util_write_hash(&hdr, 1);
+    free(buf);
+}
+#endif
+
+#ifdef BOOTUTIL_VALIDATE_SLOT0
+static void
+boot_test_util_read_validated(struct boot_img_validated *biv)
+{
+    const struct flash_area *fap;
+    uint32_t off;
+    int rc;
+
+    rc = flash_area_open(FLASH_AREA_IMAGE_0, &fap);
+    TEST_ASSERT(rc == 0);
+
+    off = fap->fa_size - sizeof(struct boot_img_trailer) -
+      32 * sizeof(uint32_t) - sizeof(*biv);
+    rc = flash_area_read(fap, off, biv, sizeof(*biv));
+    TEST_ASSERT(rc == 0);
+}
+
+/*
+ * Checks that the validation record holds the hash of the image in slot 0.
+ */
+static void
+boot_test_util_verify_validated(const struct image_header *hdr)
+{
+    struct boot_img_validated biv;
+    uint8_t hash[32];
+    uint32_t off;
+    int rc;
+
+    boot_test_util_read_validated(&biv);
+    TEST_ASSERT(biv.biv_magic == BOOT_IMG_VALIDATED_MAGIC);
+
+    off = hdr->ih_hdr_size + hdr->ih_img_size + sizeof(struct image_tlv);
+    rc = hal_flash_read(boot_test_img_addrs[0].flash_id,
+                        boot_test_img_addrs[0].address + off, hash,
+                        sizeof(hash));
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(biv.biv_hash, hash, sizeof(hash)) == 0);
+}
+
+static void
+boot_test_util_verify_not_validated(void)
+{
+    struct boot_img_validated biv;
+    int i;
+
+    boot_test_util_read_validated(&biv);
+    for (i = 0; i < sizeof(biv); i++) {
+        TEST_ASSERT(((uint8_t *)&biv)[i] == 0xff);
+    }
+}
+#endif
+
 TEST_CASE(boot_test_setup)
 {
     int rc;
@@ -907,10 +1148,24 @@ TEST_CASE(boot_test_nv_bs_11_2areas)
     boot_test_util_write_hash(&hdr1, 1);
     rc = boot_vect_write_test(FLASH_AREA_IMAGE_1);
 
-    boot_test_util_swap_areas(2, 5);
+    /*
+     * Last area has been swapped, the way the loader does it; status for it
+     * travels from scratch to slot 0.
+     */
+    boot_req_set(&req);
+    status.idx = 0;
+    status.elem_sz = 1;
+    boot_test_util_copy_area(5, BOOT_TEST_AREA_IDX_SCRATCH);
+    status.state = 1;
+    rc = boot_write_status(&status);
+    TEST_ASSERT(rc == 0);
+    boot_test_util_copy_area(2, 5);
+    status.state = 2;
+    rc = boot_write_status(&status);
+    TEST_ASSERT(rc == 0);
+    boot_test_util_copy_area(BOOT_TEST_AREA_IDX_SCRATCH, 2);
 
     status.idx = 1;
-    status.elem_sz = 1;
     status.state = 0;
 
     rc = boot_write_status(&status);
@@ -1157,6 +1412,539 @@ TEST_CASE(boot_test_invalid_hash)
     boot_test_util_verify_status_clear();
 }
 
+#ifdef ARCH_sim
+/*
+ * Image hash is computed in place when flash is memory mapped, otherwise
+ * by reading through the caller's buffer in two halves.
+ */
+TEST_CASE(boot_test_hash_read)
+{
+    static const uint32_t buf_szs[] = { 1024, 256, 37, 2 };
+    uint8_t tmpbuf[1024];
+    uint8_t zero;
+    int mmap;
+    int rc;
+    int i;
+
+    struct image_header hdr = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 12 * 1024 + 7,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 0, 2, 3, 4 },
+    };
+
+    boot_test_util_init_flash();
+    boot_test_util_write_image(&hdr, 0);
+    boot_test_util_write_hash(&hdr, 0);
+
+    for (mmap = 1; mmap >= 0; mmap--) {
+        native_flash_mmap_enable(mmap);
+        for (i = 0; i < sizeof(buf_szs) / sizeof(buf_szs[0]); i++) {
+            rc = bootutil_img_validate(&hdr, boot_test_img_addrs[0].flash_id,
+                                       boot_test_img_addrs[0].address,
+                                       tmpbuf, buf_szs[i]);
+            TEST_ASSERT(rc == 0);
+        }
+    }
+
+    /* Buffer too small to split. */
+    rc = bootutil_img_validate(&hdr, boot_test_img_addrs[0].flash_id,
+                               boot_test_img_addrs[0].address, tmpbuf, 1);
+    TEST_ASSERT(rc != 0);
+
+    /* Change a byte of padding after header; hash no longer matches. */
+    zero = 0;
+    rc = hal_flash_write(boot_test_img_addrs[0].flash_id,
+                         boot_test_img_addrs[0].address + sizeof(hdr) + 1,
+                         &zero, sizeof(zero));
+    TEST_ASSERT(rc == 0);
+    for (mmap = 1; mmap >= 0; mmap--) {
+        native_flash_mmap_enable(mmap);
+        for (i = 0; i < sizeof(buf_szs) / sizeof(buf_szs[0]); i++) {
+            rc = bootutil_img_validate(&hdr, boot_test_img_addrs[0].flash_id,
+                                       boot_test_img_addrs[0].address,
+                                       tmpbuf, buf_szs[i]);
+            TEST_ASSERT(rc != 0);
+        }
+    }
+    native_flash_mmap_enable(1);
+}
+#endif
+
+#ifdef ARCH_sim
+/*
+ * Images are small; only the first and the last area of the slots get
+ * swapped. Power is lost at every flash operation of the swap in turn, and
+ * the next boot must finish it.
+ */
+TEST_CASE(boot_test_power_fail)
+{
+    const struct flash_area *fap;
+    struct boot_img_trailer bit;
+    struct boot_rsp rsp;
+    uint32_t op;
+    int rc;
+
+    struct image_header hdr0 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 5 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 0, 5, 21, 432 },
+    };
+
+    struct image_header hdr1 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 32 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 1, 2, 3, 432 },
+    };
+
+    struct boot_req req = {
+        .br_area_descs = boot_test_area_descs,
+        .br_slot_areas = boot_test_slot_areas,
+        .br_num_image_areas = BOOT_TEST_AREA_IDX_SCRATCH + 1,
+        .br_scratch_area_idx = BOOT_TEST_AREA_IDX_SCRATCH,
+        .br_img_sz = (384 * 1024),
+    };
+
+    rc = flash_area_open(FLASH_AREA_IMAGE_0, &fap);
+    TEST_ASSERT(rc == 0);
+
+    for (op = 1; ; op++) {
+        boot_test_util_init_flash();
+        boot_test_util_write_image(&hdr0, 0);
+        boot_test_util_write_hash(&hdr0, 0);
+        boot_test_util_write_image(&hdr1, 1);
+        boot_test_util_write_hash(&hdr1, 1);
+        rc = boot_vect_write_test(FLASH_AREA_IMAGE_1);
+        TEST_ASSERT(rc == 0);
+
+        if (!boot_test_util_go_fail_at(&req, &rsp, op)) {
+            break;
+        }
+        rc = boot_go(&req, &rsp);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        TEST_ASSERT(memcmp(rsp.br_hdr, &hdr1, sizeof hdr1) == 0);
+        TEST_ASSERT(rsp.br_flash_id == boot_test_img_addrs[0].flash_id);
+        TEST_ASSERT(rsp.br_image_addr == boot_test_img_addrs[0].address);
+
+        boot_test_util_verify_flash(&hdr1, 1, &hdr0, 0);
+        boot_test_util_verify_status_clear();
+
+        /*
+         * Skip count is written first; a torn write of it means a full swap.
+         */
+        rc = flash_area_read(fap, fap->fa_size - sizeof(bit), &bit,
+                             sizeof(bit));
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(op == 1 || bit.bit_copy_skip == 1);
+    }
+
+    /*
+     * Swap itself: skip count, 2 areas of 3 steps with erase, copy and
+     * status write each, and clearing the status.
+     */
+    TEST_ASSERT(op == 1 + 2 * 3 * 3 + 1 + 1);
+    TEST_ASSERT(memcmp(rsp.br_hdr, &hdr1, sizeof hdr1) == 0);
+    boot_test_util_verify_flash(&hdr1, 1, &hdr0, 0);
+    boot_test_util_verify_status_clear();
+}
+
+/*
+ * Power is lost during the swap, and again while resuming it.
+ */
+TEST_CASE(boot_test_power_fail_resume)
+{
+    const struct flash_area *fap;
+    struct boot_img_trailer bit;
+    struct boot_rsp rsp;
+    uint32_t op1;
+    uint32_t op2;
+    int rc;
+
+    struct image_header hdr0 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 150 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 0, 5, 21, 432 },
+    };
+
+    struct image_header hdr1 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 7 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 1, 2, 3, 432 },
+    };
+
+    struct boot_req req = {
+        .br_area_descs = boot_test_area_descs,
+        .br_slot_areas = boot_test_slot_areas,
+        .br_num_image_areas = BOOT_TEST_AREA_IDX_SCRATCH + 1,
+        .br_scratch_area_idx = BOOT_TEST_AREA_IDX_SCRATCH,
+        .br_img_sz = (384 * 1024),
+    };
+
+    rc = flash_area_open(FLASH_AREA_IMAGE_0, &fap);
+    TEST_ASSERT(rc == 0);
+
+    for (op1 = 2; ; op1++) {
+        for (op2 = 1; ; op2++) {
+            boot_test_util_init_flash();
+            boot_test_util_write_image(&hdr0, 0);
+            boot_test_util_write_hash(&hdr0, 0);
+            boot_test_util_write_image(&hdr1, 1);
+            boot_test_util_write_hash(&hdr1, 1);
+            rc = boot_vect_write_test(FLASH_AREA_IMAGE_1);
+            TEST_ASSERT(rc == 0);
+
+            if (!boot_test_util_go_fail_at(&req, &rsp, op1)) {
+                break;
+            }
+            if (!boot_test_util_go_fail_at(&req, &rsp, op2)) {
+                break;
+            }
+            rc = flash_area_read(fap, fap->fa_size - sizeof(bit), &bit,
+                                 sizeof(bit));
+            TEST_ASSERT(rc == 0);
+
+            rc = boot_go(&req, &rsp);
+            TEST_ASSERT_FATAL(rc == 0);
+
+            if (bit.bit_copy_done == 0xff) {
+                TEST_ASSERT(memcmp(rsp.br_hdr, &hdr1, sizeof hdr1) == 0);
+                boot_test_util_verify_flash(&hdr1, 1, &hdr0, 0);
+            } else {
+                /*
+                 * Swap had finished, but new image never ran to confirm
+                 * itself; e.g. power lost while recording slot 0 as
+                 * validated. Same as losing it in the new image.
+                 */
+                TEST_ASSERT(memcmp(rsp.br_hdr, &hdr0, sizeof hdr0) == 0);
+                boot_test_util_verify_flash(&hdr0, 0, &hdr1, 1);
+            }
+            boot_test_util_verify_status_clear();
+        }
+        if (op2 == 1) {
+            /* Swap finished without losing power. */
+            break;
+        }
+        TEST_ASSERT(memcmp(rsp.br_hdr, &hdr1, sizeof hdr1) == 0);
+        boot_test_util_verify_flash(&hdr1, 1, &hdr0, 0);
+        boot_test_util_verify_status_clear();
+    }
+}
+#endif
+
+#ifdef BOOTUTIL_LZ4
+TEST_CASE(boot_test_lz4)
+{
+    struct image_header rd_hdr;
+    struct boot_rsp rsp;
+    uint8_t *img;
+    uint8_t *buf;
+    uint32_t len;
+    int rc;
+
+    struct image_header hdr0 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 12 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 0, 2, 3, 4 },
+    };
+
+    struct image_header hdr1 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 150 * 1024 + 3,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 1, 2, 3, 432 },
+    };
+
+    struct boot_req req = {
+        .br_area_descs = boot_test_area_descs,
+        .br_slot_areas = boot_test_slot_areas,
+        .br_num_image_areas = BOOT_TEST_AREA_IDX_SCRATCH + 1,
+        .br_scratch_area_idx = BOOT_TEST_AREA_IDX_SCRATCH,
+        .br_img_sz = (384 * 1024),
+    };
+
+    img = malloc(IMAGE_SIZE(&hdr1));
+    buf = malloc(IMAGE_SIZE(&hdr1));
+    TEST_ASSERT_FATAL(img != NULL && buf != NULL);
+
+    boot_test_util_init_flash();
+    boot_test_util_write_image(&hdr0, 0);
+    boot_test_util_write_hash(&hdr0, 0);
+    len = boot_test_util_lz4_img(&hdr1, img);
+    boot_test_util_write_lz4(img, len);
+    rc = boot_vect_write_test(FLASH_AREA_IMAGE_1);
+    TEST_ASSERT(rc == 0);
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT(memcmp(rsp.br_hdr, &hdr1, sizeof hdr1) == 0);
+    TEST_ASSERT(rsp.br_flash_id == boot_test_img_addrs[0].flash_id);
+    TEST_ASSERT(rsp.br_image_addr == boot_test_img_addrs[0].address);
+
+    rc = hal_flash_read(boot_test_img_addrs[0].flash_id,
+                        boot_test_img_addrs[0].address, buf, len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(buf, img, len) == 0);
+
+    /* Compressed image is gone, once installed. */
+    rc = hal_flash_read(boot_test_img_addrs[1].flash_id,
+                        boot_test_img_addrs[1].address, &rd_hdr,
+                        sizeof(rd_hdr));
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(rd_hdr.ih_magic == IMAGE_MAGIC_NONE);
+
+    free(img);
+    free(buf);
+}
+
+/*
+ * Decompressed image does not validate; slot 0 must be left alone.
+ */
+TEST_CASE(boot_test_lz4_bad_inner)
+{
+    struct image_header rd_hdr;
+    struct boot_rsp rsp;
+    uint8_t *img;
+    uint32_t len;
+    int rc;
+
+    struct image_header hdr0 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 12 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 0, 2, 3, 4 },
+    };
+
+    struct image_header hdr1 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 20 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 1, 2, 3, 432 },
+    };
+
+    struct boot_req req = {
+        .br_area_descs = boot_test_area_descs,
+        .br_slot_areas = boot_test_slot_areas,
+        .br_num_image_areas = BOOT_TEST_AREA_IDX_SCRATCH + 1,
+        .br_scratch_area_idx = BOOT_TEST_AREA_IDX_SCRATCH,
+        .br_img_sz = (384 * 1024),
+    };
+
+    img = malloc(IMAGE_SIZE(&hdr1));
+    TEST_ASSERT_FATAL(img != NULL);
+
+    boot_test_util_init_flash();
+    boot_test_util_write_image(&hdr0, 0);
+    boot_test_util_write_hash(&hdr0, 0);
+    len = boot_test_util_lz4_img(&hdr1, img);
+    img[len - 1] ^= 1;
+    boot_test_util_write_lz4(img, len);
+    rc = boot_vect_write_test(FLASH_AREA_IMAGE_1);
+    TEST_ASSERT(rc == 0);
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT(memcmp(rsp.br_hdr, &hdr0, sizeof hdr0) == 0);
+    boot_test_util_verify_flash(&hdr0, 0, NULL, 0xff);
+
+    rc = hal_flash_read(boot_test_img_addrs[1].flash_id,
+                        boot_test_img_addrs[1].address, &rd_hdr,
+                        sizeof(rd_hdr));
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(rd_hdr.ih_magic == IMAGE_MAGIC_NONE);
+
+    free(img);
+}
+#endif
+
+#ifdef BOOTUTIL_VALIDATE_SLOT0
+/*
+ * First boot validates slot 0 in full and records it; later boots check
+ * the image against the record.
+ */
+TEST_CASE(boot_test_slot0_validated)
+{
+    struct boot_img_validated biv1;
+    struct boot_img_validated biv2;
+    struct boot_rsp rsp;
+    uint8_t zero;
+    int rc;
+
+    struct image_header hdr0 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 12 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 0, 2, 3, 4 },
+    };
+
+    struct boot_req req = {
+        .br_area_descs = boot_test_area_descs,
+        .br_slot_areas = boot_test_slot_areas,
+        .br_num_image_areas = BOOT_TEST_AREA_IDX_SCRATCH + 1,
+        .br_scratch_area_idx = BOOT_TEST_AREA_IDX_SCRATCH,
+        .br_img_sz = (384 * 1024),
+    };
+
+    boot_test_util_init_flash();
+    boot_test_util_write_image(&hdr0, 0);
+    boot_test_util_write_hash(&hdr0, 0);
+    boot_test_util_verify_not_validated();
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(rsp.br_hdr, &hdr0, sizeof hdr0) == 0);
+    boot_test_util_verify_validated(&hdr0);
+    boot_test_util_read_validated(&biv1);
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(rsp.br_hdr, &hdr0, sizeof hdr0) == 0);
+    boot_test_util_read_validated(&biv2);
+    TEST_ASSERT(memcmp(&biv1, &biv2, sizeof(biv1)) == 0);
+
+    /* Image changes after it was recorded as valid. */
+    zero = 0;
+    rc = hal_flash_write(boot_test_img_addrs[0].flash_id,
+                         boot_test_img_addrs[0].address + sizeof(hdr0) + 1,
+                         &zero, sizeof(zero));
+    TEST_ASSERT(rc == 0);
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc != 0);
+}
+
+/*
+ * Image in slot 0 does not validate; it's not booted, nor recorded.
+ */
+TEST_CASE(boot_test_slot0_invalid)
+{
+    struct boot_rsp rsp;
+    uint8_t zero;
+    int rc;
+
+    struct image_header hdr0 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 12 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 0, 2, 3, 4 },
+    };
+
+    struct boot_req req = {
+        .br_area_descs = boot_test_area_descs,
+        .br_slot_areas = boot_test_slot_areas,
+        .br_num_image_areas = BOOT_TEST_AREA_IDX_SCRATCH + 1,
+        .br_scratch_area_idx = BOOT_TEST_AREA_IDX_SCRATCH,
+        .br_img_sz = (384 * 1024),
+    };
+
+    boot_test_util_init_flash();
+    boot_test_util_write_image(&hdr0, 0);
+    boot_test_util_write_hash(&hdr0, 0);
+
+    zero = 0;
+    rc = hal_flash_write(boot_test_img_addrs[0].flash_id,
+                         boot_test_img_addrs[0].address + sizeof(hdr0) + 1,
+                         &zero, sizeof(zero));
+    TEST_ASSERT(rc == 0);
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc != 0);
+    boot_test_util_verify_not_validated();
+}
+
+/*
+ * Record goes away with the image when a new one is swapped in; the new
+ * one gets recorded once it's confirmed and booted again.
+ */
+TEST_CASE(boot_test_slot0_validated_swap)
+{
+    struct boot_rsp rsp;
+    int rc;
+
+    struct image_header hdr0 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 12 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 0, 2, 3, 4 },
+    };
+
+    struct image_header hdr1 = {
+        .ih_magic = IMAGE_MAGIC,
+        .ih_tlv_size = 4 + 32,
+        .ih_hdr_size = BOOT_TEST_HEADER_SIZE,
+        .ih_img_size = 17 * 1024,
+        .ih_flags = IMAGE_F_SHA256,
+        .ih_ver = { 1, 1, 5, 5 },
+    };
+
+    struct boot_req req = {
+        .br_area_descs = boot_test_area_descs,
+        .br_slot_areas = boot_test_slot_areas,
+        .br_num_image_areas = BOOT_TEST_AREA_IDX_SCRATCH + 1,
+        .br_scratch_area_idx = BOOT_TEST_AREA_IDX_SCRATCH,
+        .br_img_sz = (384 * 1024),
+    };
+
+    boot_test_util_init_flash();
+    boot_test_util_write_image(&hdr0, 0);
+    boot_test_util_write_hash(&hdr0, 0);
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc == 0);
+    boot_test_util_verify_validated(&hdr0);
+
+    boot_test_util_write_image(&hdr1, 1);
+    boot_test_util_write_hash(&hdr1, 1);
+    rc = boot_vect_write_test(FLASH_AREA_IMAGE_1);
+    TEST_ASSERT(rc == 0);
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(rsp.br_hdr, &hdr1, sizeof hdr1) == 0);
+    boot_test_util_verify_flash(&hdr1, 1, &hdr0, 0);
+    boot_test_util_verify_not_validated();
+
+    rc = boot_vect_write_main();
+    TEST_ASSERT(rc == 0);
+
+    rc = boot_go(&req, &rsp);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(rsp.br_hdr, &hdr1, sizeof hdr1) == 0);
+    boot_test_util_verify_validated(&hdr1);
+}
+#endif
+
 TEST_SUITE(boot_test_main)
 {
     boot_test_setup();
@@ -1175,6 +1963,20 @@ TEST_SUITE(boot_test_main)
     boot_test_no_hash();
     boot_test_no_flag_has_hash();
     boot_test_invalid_hash();
+#ifdef ARCH_sim
+    boot_test_hash_read();
+    boot_test_power_fail();
+    boot_test_power_fail_resume();
+#endif
+#ifdef BOOTUTIL_VALIDATE_SLOT0
+    boot_test_slot0_validated();
+    boot_test_slot0_invalid();
+    boot_test_slot0_validated_swap();
+#endif
+#ifdef BOOTUTIL_LZ4
+    boot_test_lz4();
+    boot_test_lz4_bad_inner();
+#endif
 }
 
 int
@@ -20,6 +20,7 @@
 #define __CONSOLE_H__
 
 #include <stdarg.h>
+#include <inttypes.h>
 
 typedef void (*console_rx_cb)(void);
 
@@ -29,6 +30,7 @@ void console_write(const char *str, int cnt);
 int console_read(char *str, int cnt, int *newline);
 void console_blocking_mode(void);
 void console_echo(int on);
+uint32_t console_tx_dropped(void);
 
 void console_printf(const char *fmt, ...)
     __attribute__ ((format (printf, 1, 2)));;
@@ -28,7 +28,9 @@ int g_console_is_init;
 /** Indicates whether the previous line of output was completed. */
 int console_is_midline;
 
-#define CONSOLE_TX_BUF_SZ	32	/* IO buffering, must be power of 2 */
+#ifndef CONSOLE_TX_BUF_SZ
+#define CONSOLE_TX_BUF_SZ	256	/* IO buffering, must be power of 2 */
+#endif
 #define CONSOLE_RX_BUF_SZ	128
 #define CONSOLE_RX_CHUNK	16
 
@@ -45,10 +47,10 @@ int console_is_midline;
 typedef void (*console_write_char)(char);
 
 struct console_ring {
-    uint8_t cr_head;
-    uint8_t cr_tail;
-    uint8_t cr_size;
-    uint8_t _pad;
+    uint16_t cr_head;
+    uint16_t cr_tail;
+    uint16_t cr_size;
+    uint16_t _pad;
     uint8_t *cr_buf;
 };
 
@@ -57,10 +59,15 @@ struct console_tty {
     uint8_t ct_tx_buf[CONSOLE_TX_BUF_SZ]; /* must be after console_ring */
     struct console_ring ct_rx;
     uint8_t ct_rx_buf[CONSOLE_RX_BUF_SZ]; /* must be after console_ring */
+    uint16_t ct_tx_blk_len;	/* span of ct_tx being sent in block mode */
+    uint8_t ct_rx_blk[CONSOLE_RX_CHUNK];
+    uint8_t ct_rx_blk_len;
+    uint8_t ct_rx_blk_off;
     console_rx_cb ct_rx_cb;	/* callback that input is ready */
     console_write_char ct_write_char;
     uint8_t ct_echo_off:1;
     uint8_t ct_esc_seq:2;
+    uint32_t ct_tx_drops;	/* output dropped due to full ct_tx */
 } console_tty;
 
 static void
@@ -70,6 +77,15 @@ console_add_char(struct console_ring *cr, char ch)
     cr->cr_head = CONSOLE_HEAD_INC(cr);
 }
 
+static int
+console_buf_space(struct console_ring *cr)
+{
+    int space;
+
+    space = (cr->cr_tail - cr->cr_head) & (cr->cr_size - 1);
+    return space - 1;
+}
+
 static uint8_t
 console_pull_char(struct console_ring *cr)
 {
@@ -99,18 +115,51 @@ console_queue_char(char ch)
 
     OS_ENTER_CRITICAL(sr);
     while (CONSOLE_HEAD_INC(&ct->ct_tx) == ct->ct_tx.cr_tail) {
-        /* TX needs to drain */
+        if (os_started()) {
+            /*
+             * Don't hold up the caller; output is dropped instead.
+             */
+            ct->ct_tx_drops++;
+            OS_EXIT_CRITICAL(sr);
+            return;
+        }
+        /* Before OS has started; wait for TX to drain */
         hal_uart_start_tx(CONSOLE_UART);
         OS_EXIT_CRITICAL(sr);
-	if (os_started()) {
-            os_time_delay(1);
-	}
         OS_ENTER_CRITICAL(sr);
     }
     console_add_char(&ct->ct_tx, ch);
     OS_EXIT_CRITICAL(sr);
 }
 
+/*
+ * Copy as much of str to output queue as fits, with one critical section.
+ * Returns number of characters of str queued.
+ */
+static int
+console_queue_str(struct console_tty *ct, const char *str, int cnt)
+{
+    struct console_ring *cr = &ct->ct_tx;
+    int sr;
+    int i;
+
+    OS_ENTER_CRITICAL(sr);
+    for (i = 0; i < cnt; i++) {
+        if (console_buf_space(cr) < (str[i] == '\n' ? 2 : 1)) {
+            if (os_started()) {
+                ct->ct_tx_drops += cnt - i;
+            }
+            break;
+        }
+        if (str[i] == '\n') {
+            console_add_char(cr, '\r');
+        }
+        console_add_char(cr, str[i]);
+    }
+    OS_EXIT_CRITICAL(sr);
+    return i;
+}
+
 static void
 console_blocking_tx(char ch)
 {
@@ -147,6 +196,14 @@ console_blocking_mode(void)
     OS_ENTER_CRITICAL(sr);
     ct->ct_write_char = console_blocking_tx;
 
+    /*
+     * In block mode, driver finishes sending the span it has before
+     * blocking TX starts.
+     */
+    ct->ct_tx.cr_tail = (ct->ct_tx.cr_tail + ct->ct_tx_blk_len) &
+      (ct->ct_tx.cr_size - 1);
+    ct->ct_tx_blk_len = 0;
+
     console_tx_flush(ct, CONSOLE_TX_BUF_SZ);
     OS_EXIT_CRITICAL(sr);
 }
@@ -168,7 +225,14 @@ console_file_write(void *arg, const char *str, size_t cnt)
     if (!ct->ct_write_char) {
         return cnt;
     }
-    for (i = 0; i < cnt; i++) {
+    i = 0;
+    if (ct->ct_write_char == console_queue_char) {
+        i = console_queue_str(ct, str, cnt);
+        if (os_started()) {
+            i = cnt;
+        }
+    }
+    for (; i < cnt; i++) {
         if (str[i] == '\n') {
             ct->ct_write_char('\r');
         }
@@ -244,15 +308,6 @@ console_tx_char(void *arg)
     return console_pull_char(cr);
 }
 
-static int
-console_buf_space(struct console_ring *cr)
-{
-    int space;
-
-    space = (cr->cr_tail - cr->cr_head) & (cr->cr_size - 1);
-    return space - 1;
-}
-
 static int
 console_rx_char(void *arg, uint8_t data)
 {
@@ -350,17 +405,79 @@ queue_char:
     }
     if (!ct->ct_echo_off) {
         if (console_buf_space(tx) < tx_space) {
-            console_tx_flush(ct, tx_space);
-        }
-        for (i = 0; i < tx_space; i++) {
-            console_add_char(tx, tx_buf[i]);
+            ct->ct_tx_drops += tx_space;
+        } else {
+            for (i = 0; i < tx_space; i++) {
+                console_add_char(tx, tx_buf[i]);
+            }
+            hal_uart_start_tx(CONSOLE_UART);
         }
-        hal_uart_start_tx(CONSOLE_UART);
     }
 out:
     return 0;
 }
 
+/*
+ * Block mode counterparts of console_tx_char()/console_rx_char(). Output
+ * is sent straight out of the TX queue, a contiguous span at a time; the
+ * span stays in the queue until the driver tells it has been sent. Input
+ * is run through console_rx_char() a block at a time.
+ */
+static int
+console_tx_block(void *arg, int tx_len, uint8_t **buf)
+{
+    struct console_tty *ct = (struct console_tty *)arg;
+    struct console_ring *cr = &ct->ct_tx;
+    int len;
+
+    if (ct->ct_write_char == console_blocking_tx) {
+        /* console_blocking_mode() took over */
+        ct->ct_tx_blk_len = 0;
+        return -1;
+    }
+    cr->cr_tail = (cr->cr_tail + tx_len) & (cr->cr_size - 1);
+    if (cr->cr_head == cr->cr_tail) {
+        ct->ct_tx_blk_len = 0;
+        return -1;
+    }
+    if (cr->cr_head > cr->cr_tail) {
+        len = cr->cr_head - cr->cr_tail;
+    } else {
+        len = cr->cr_size - cr->cr_tail;
+    }
+    ct->ct_tx_blk_len = len;
+    *buf = &cr->cr_buf[cr->cr_tail];
+    return len;
+}
+
+static int
+console_rx_block(void *arg, int rx_len, uint8_t **buf)
+{
+    struct console_tty *ct = (struct console_tty *)arg;
+
+    ct->ct_rx_blk_len += rx_len;
+    while (ct->ct_rx_blk_off < ct->ct_rx_blk_len) {
+        if (console_rx_char(ct, ct->ct_rx_blk[ct->ct_rx_blk_off]) < 0) {
+            /*
+             * Rest is processed when reader makes room, and driver asks
+             * for next block.
+             */
+            return -1;
+        }
+        ct->ct_rx_blk_off++;
+    }
+    ct->ct_rx_blk_len = 0;
+    ct->ct_rx_blk_off = 0;
+    *buf = ct->ct_rx_blk;
+    return sizeof(ct->ct_rx_blk);
+}
+
+uint32_t
+console_tx_dropped(void)
+{
+    return console_tty.ct_tx_drops;
+}
+
 int
 console_is_init(void)
 {
@@ -373,10 +490,17 @@ console_init(console_rx_cb rx_cb)
     struct console_tty *ct = &console_tty;
     int rc;
 
-    rc = hal_uart_init_cbs(CONSOLE_UART, console_tx_char, NULL,
-            console_rx_char, ct);
+    /*
+     * Prefer block mode, so that the driver can use DMA.
+     */
+    rc = hal_uart_init_block_cbs(CONSOLE_UART, console_tx_block, NULL,
+            console_rx_block, ct);
     if (rc) {
-        return rc;
+        rc = hal_uart_init_cbs(CONSOLE_UART, console_tx_char, NULL,
+                console_rx_char, ct);
+        if (rc) {
+            return rc;
+        }
     }
     ct->ct_tx.cr_size = CONSOLE_TX_BUF_SZ;
     ct->ct_tx.cr_buf = ct->ct_tx_buf;
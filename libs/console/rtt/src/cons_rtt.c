@@ -0,0 +1,143 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "os/os.h"
+#include "rtt/rtt.h"
+#include "console/console.h"
+
+#define CONS_OUTPUT_MAX_LINE    128
+
+/* RTT channel 0, in both directions. */
+#define CONSOLE_RTT_CHAN        0
+
+static int console_rtt_is_init;
+static console_rx_cb console_rtt_rx_cb;
+
+/** Indicates whether the previous line of output was completed. */
+int console_is_midline;
+
+int
+console_init(console_rx_cb rx_cb)
+{
+    int rc;
+
+    rc = rtt_init();
+    if (rc) {
+        return rc;
+    }
+    console_rtt_rx_cb = rx_cb;
+    console_rtt_is_init = 1;
+
+    return 0;
+}
+
+int
+console_is_init(void)
+{
+    return console_rtt_is_init;
+}
+
+/*
+ * Output goes to RAM; it never waits for the probe.  What doesn't fit in
+ * the ring is dropped.
+ */
+void
+console_write(const char *str, int cnt)
+{
+    if (!console_rtt_is_init || cnt <= 0) {
+        return;
+    }
+    rtt_write(CONSOLE_RTT_CHAN, str, cnt);
+    console_is_midline = str[cnt - 1] != '\n';
+}
+
+int
+console_read(char *str, int cnt, int *newline)
+{
+    int i;
+    char ch;
+
+    *newline = 0;
+    for (i = 0; i < cnt; i++) {
+        if (rtt_read(CONSOLE_RTT_CHAN, &ch, 1) != 1) {
+            break;
+        }
+        if (ch == '\r') {
+            i--;
+            continue;
+        }
+        if (ch == '\n') {
+            *str = '\0';
+            *newline = 1;
+            break;
+        }
+        *str++ = ch;
+    }
+    return i;
+}
+
+void
+console_rtt_poll(void)
+{
+    if (console_rtt_rx_cb && rtt_rx_avail(CONSOLE_RTT_CHAN)) {
+        console_rtt_rx_cb();
+    }
+}
+
+void
+console_blocking_mode(void)
+{
+    /* Output never blocks, nor is it queued anywhere but the RTT ring. */
+}
+
+void
+console_echo(int on)
+{
+    /* The RTT viewer echoes input locally. */
+}
+
+uint32_t
+console_tx_dropped(void)
+{
+    return rtt_drops(CONSOLE_RTT_CHAN);
+}
+
+void
+console_printf(const char *fmt, ...)
+{
+    va_list args;
+    char buf[CONS_OUTPUT_MAX_LINE];
+    int len;
+
+    /* Prefix each line with a timestamp. */
+    if (!console_is_midline) {
+        len = snprintf(buf, sizeof(buf), "%lu:", (unsigned long)os_time_get());
+        console_write(buf, len);
+    }
+
+    va_start(args, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, args);
+    if (len >= sizeof(buf)) {
+        len = sizeof(buf) - 1;
+    }
+    console_write(buf, len);
+    va_end(args);
+}
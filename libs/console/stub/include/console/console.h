@@ -20,6 +20,7 @@
 #define __CONSOLE_H__
 
 #include <stdarg.h>
+#include <inttypes.h>
 
 typedef void (*console_rx_cb)(void);
 
@@ -65,6 +66,12 @@ console_echo(int on)
 {
 }
 
+static uint32_t inline
+console_tx_dropped(void)
+{
+    return 0;
+}
+
 #define console_is_midline  (0)
 
 #endif /* __CONSOLE__ */
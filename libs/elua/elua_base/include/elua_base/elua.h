@@ -20,8 +20,16 @@
 #ifndef __ELUA_BASE_H__
 #define __ELUA_BASE_H__
 
+struct lua_State;
+
 int lua_main( int argc, char **argv );
 
 int lua_init(void);
 
+/*
+ * Run incremental garbage collection on Lua state L; call when idle, from
+ * the task running L. Allocator statistics are in stats group "elua_mem".
+ */
+void elua_gc_idle(struct lua_State *L);
+
 #endif /* __ELUA_BASE_H__ */
@@ -14,6 +14,12 @@
 
 #ifdef MYNEWT
 #include <console/console.h>
+#include "lmynewt.h"
+#define l_realloc(p,o,n)	elua_mem_realloc(p,o,n)
+#define l_free(p,o)		elua_mem_free(p,o)
+#else
+#define l_realloc(p,o,n)	realloc(p,n)
+#define l_free(p,o)		free(p)
 #endif
 
 /* This file uses only the official API of Lua.
@@ -38,6 +44,12 @@
 #endif
 #ifdef MYNEWT
 #include <fs/fs.h>
+#ifdef ROMFS_PRESENT
+#include <romfs/romfs.h>
+#endif
+#ifdef NFFS_PRESENT
+#include <nffs/nffs.h>
+#endif
 #endif
 
 #define FREELIST_REF	0	/* free list of references */
@@ -589,6 +601,13 @@ typedef struct LoadF {
 #else
   struct fs_file *f;
   int readstatus;
+#ifdef NFFS_PRESENT
+  /* file data read in place from flash, if possible */
+  int mapped;
+  uint32_t off;
+  int seg_idx, seg_cnt;
+  struct nffs_mmap_seg segs[4];
+#endif
 #endif
   char buff[LUAL_BUFFERSIZE];
   const char *srcp;
@@ -614,6 +633,26 @@ static const char *getF (lua_State *L, void *ud, size_t *size) {
     int rc;
     uint32_t out_len;
 
+#ifdef NFFS_PRESENT
+    if (lf->mapped) {
+      /* data stays valid only until NFFS is written to; lua_load() copies
+         it before returning */
+      if (lf->seg_idx == lf->seg_cnt) {
+        lf->seg_idx = 0;
+        rc = nffs_file_mmap(lf->f, lf->off, lf->segs,
+          sizeof(lf->segs) / sizeof(lf->segs[0]), &lf->seg_cnt);
+        if (rc || lf->seg_cnt == 0) {
+          if (rc) {
+            lf->readstatus = rc;
+          }
+          return NULL;
+        }
+      }
+      *size = lf->segs[lf->seg_idx].nms_len;
+      lf->off += *size;
+      return lf->segs[lf->seg_idx++].nms_data;
+    }
+#endif
     rc = fs_read(lf->f, sizeof(lf->buff), lf->buff, &out_len);
     if (rc || out_len == 0) {
       if (rc) {
@@ -752,6 +791,27 @@ LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
   fs_seek(lf.f, fs_getpos(lf.f) - 1);
   lf.readstatus = 0;
   lf.srcp = NULL;
+#ifdef ROMFS_PRESENT
+  {
+    /* execute in place from ROM image; needs 4 byte aligned bytecode */
+    const void *data;
+    uint32_t len;
+    uint32_t pos = fs_getpos(lf.f);
+
+    if (romfs_file_mmap(lf.f, &data, &len) == 0 &&
+      (((uintptr_t)data + pos) & 3) == 0) {
+      lf.srcp = (const char *)data + pos;
+      lf.totsize = len - pos;
+    }
+  }
+#endif
+#ifdef NFFS_PRESENT
+  lf.off = fs_getpos(lf.f);
+  lf.seg_idx = lf.seg_cnt = 0;
+  lf.mapped = (lf.srcp == NULL &&
+    nffs_file_mmap(lf.f, lf.off, lf.segs, 1, &lf.seg_cnt) == 0);
+  lf.seg_cnt = 0;
+#endif
   status = lua_load(L, getF, &lf, lua_tostring(L, -1));
   if (filename) fs_close(lf.f);  /* close file (even in case of errors) */
   if (lf.readstatus) {
@@ -824,7 +884,7 @@ static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
   void *nptr;
 
   if (nsize == 0) {
-    free(ptr);
+    l_free(ptr, osize);
     return NULL;
   }
   if (L != NULL && (mode & EGC_ALWAYS)) /* always collect memory if requested */
@@ -836,10 +896,10 @@ static void *l_alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
     if(G(L)->memlimit > 0 && (mode & EGC_ON_MEM_LIMIT) && l_check_memlimit(L, nsize - osize))
       return NULL;
   }
-  nptr = realloc(ptr, nsize);
+  nptr = l_realloc(ptr, osize, nsize);
   if (nptr == NULL && L != NULL && (mode & EGC_ON_ALLOC_FAILURE)) {
     luaC_fullgc(L); /* emergency full collection. */
-    nptr = realloc(ptr, nsize); /* try allocation again */
+    nptr = l_realloc(ptr, osize, nsize); /* try allocation again */
   }
   return nptr;
 }
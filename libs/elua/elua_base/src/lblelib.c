@@ -0,0 +1,118 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#if defined(MYNEWT) && defined(ELUA_BLE)
+
+/*
+ * Lua module "ble": GATT notifications with binary payloads.
+ *
+ *   m = ble.mbuf()                       mbuf with room for ATT headers
+ *   rc = ble.notify(conn, attr [, data]) data is a string or an mbuf
+ *                                        (taken over); without data, the
+ *                                        value is read from the attribute
+ *   rc = ble.indicate(conn, chr_val)
+ *   ble.chr_updated(chr_val)             notify/indicate subscribed peers
+ */
+
+#include <os/os.h>
+#include <host/ble_hs.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lrotable.h"
+#include "lmynewt.h"
+
+#define MIN_OPT_LEVEL 2
+#include "lrodefs.h"
+
+static int
+ble_lua_mbuf(lua_State *L)
+{
+    struct os_mbuf *om;
+
+    om = ble_hs_mbuf_att_pkt();
+    if (!om) {
+        lua_pushnil(L);
+        return 1;
+    }
+    elua_mbuf_push(L, om);
+    return 1;
+}
+
+static int
+ble_lua_notify(lua_State *L)
+{
+    struct os_mbuf *om;
+    const char *data;
+    uint16_t conn;
+    uint16_t attr;
+    size_t len;
+
+    conn = luaL_checkinteger(L, 1);
+    attr = luaL_checkinteger(L, 2);
+    switch (lua_type(L, 3)) {
+    case LUA_TNONE:
+    case LUA_TNIL:
+        om = NULL;
+        break;
+    case LUA_TSTRING:
+        data = lua_tolstring(L, 3, &len);
+        om = ble_hs_mbuf_from_flat(data, len);
+        if (!om) {
+            lua_pushinteger(L, BLE_HS_ENOMEM);
+            return 1;
+        }
+        break;
+    default:
+        om = elua_mbuf_take(L, 3);
+        break;
+    }
+    lua_pushinteger(L, ble_gattc_notify_custom(conn, attr, om));
+    return 1;
+}
+
+static int
+ble_lua_indicate(lua_State *L)
+{
+    lua_pushinteger(L, ble_gattc_indicate(luaL_checkinteger(L, 1),
+      luaL_checkinteger(L, 2)));
+    return 1;
+}
+
+static int
+ble_lua_chr_updated(lua_State *L)
+{
+    ble_gatts_chr_updated(luaL_checkinteger(L, 1));
+    return 0;
+}
+
+const LUA_REG_TYPE ble_map[] = {
+    { LSTRKEY("mbuf"), LFUNCVAL(ble_lua_mbuf) },
+    { LSTRKEY("notify"), LFUNCVAL(ble_lua_notify) },
+    { LSTRKEY("indicate"), LFUNCVAL(ble_lua_indicate) },
+    { LSTRKEY("chr_updated"), LFUNCVAL(ble_lua_chr_updated) },
+    { LNILKEY, LNILVAL }
+};
+
+int
+luaopen_ble(lua_State *L)
+{
+    LREGISTER(L, "ble", ble_map);
+}
+
+#endif
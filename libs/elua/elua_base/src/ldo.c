@@ -510,10 +510,20 @@ static void f_parser (lua_State *L, void *ud) {
   Closure *cl;
   struct SParser *p = cast(struct SParser *, ud);
   int c = luaZ_lookahead(p->z);
+#if defined(LUA_NO_PARSER)
+  if (c != LUA_SIGNATURE[0]) {
+    luaO_pushfstring(L, "%s: no parser, precompiled chunks only", p->name);
+    luaD_throw(L, LUA_ERRSYNTAX);
+  }
+#endif
   luaC_checkGC(L);
   set_block_gc(L);  /* stop collector during parsing */
+#if defined(LUA_NO_PARSER)
+  tf = luaU_undump(L, p->z, &p->buff, p->name);
+#else
   tf = ((c == LUA_SIGNATURE[0]) ? luaU_undump : luaY_parser)(L, p->z,
                                                              &p->buff, p->name);
+#endif
   cl = luaF_newLclosure(L, tf->nups, hvalue(gt(L)));
   cl->l.p = tf;
   for (i = 0; i < tf->nups; i++)  /* initialize eventual upvalues */
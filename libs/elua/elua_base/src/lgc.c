@@ -23,7 +23,7 @@
 #include "ltm.h"
 #include "lrotable.h"
 
-#define GCSTEPSIZE	1024u
+#define GCSTEPSIZE	LUAI_GCSTEPSIZE
 #define GCSWEEPMAX	40
 #define GCSWEEPCOST	10
 #define GCFINALIZECOST	100
@@ -0,0 +1,258 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifdef MYNEWT
+
+/*
+ * Lua module "mbuf": os_mbuf packets as userdata. Data is moved between
+ * Lua strings and mbuf chains as raw bytes, without formatting.
+ *
+ *   m = mbuf.get()                  new empty packet from msys
+ *   m:append(s)                     append bytes of string s
+ *   m:appendint(v, sz)              append v as sz (1, 2 or 4) byte LE int
+ *   m:data([off [, len]])           bytes as string
+ *   m:int(off, sz)                  unsigned sz byte LE int at off
+ *   m:adj(n)                        trim n bytes from head (tail if n < 0)
+ *   #m, m:len()                     packet length
+ *   m:free()                        free now, instead of at GC
+ *
+ * Functions passing an mbuf to the system (e.g. ble.notify()) take over
+ * the chain; the userdata is empty afterwards.
+ */
+
+#include <string.h>
+
+#include <os/os.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lrotable.h"
+#include "lmynewt.h"
+
+#define MIN_OPT_LEVEL 2
+#include "lrodefs.h"
+
+#define ELUA_MBUF_MT            "mbuf"
+
+static struct os_mbuf **
+elua_mbuf_check(lua_State *L, int idx)
+{
+    struct os_mbuf **omp;
+
+    omp = luaL_checkudata(L, idx, ELUA_MBUF_MT);
+    if (*omp == NULL) {
+        luaL_error(L, "mbuf already freed or passed on");
+    }
+    return omp;
+}
+
+void
+elua_mbuf_push(lua_State *L, struct os_mbuf *om)
+{
+    struct os_mbuf **omp;
+
+    omp = lua_newuserdata(L, sizeof(*omp));
+    *omp = om;
+    luaL_getmetatable(L, ELUA_MBUF_MT);
+    lua_setmetatable(L, -2);
+}
+
+struct os_mbuf *
+elua_mbuf_take(lua_State *L, int idx)
+{
+    struct os_mbuf **omp;
+    struct os_mbuf *om;
+
+    omp = elua_mbuf_check(L, idx);
+    om = *omp;
+    *omp = NULL;
+    return om;
+}
+
+static int
+mbuf_get(lua_State *L)
+{
+    struct os_mbuf *om;
+
+    om = os_msys_get_pkthdr(0, 0);
+    if (!om) {
+        lua_pushnil(L);
+        return 1;
+    }
+    elua_mbuf_push(L, om);
+    return 1;
+}
+
+static int
+mbuf_append(lua_State *L)
+{
+    struct os_mbuf **omp;
+    const char *data;
+    size_t len;
+
+    omp = elua_mbuf_check(L, 1);
+    data = luaL_checklstring(L, 2, &len);
+    lua_pushinteger(L, os_mbuf_append(*omp, data, len));
+    return 1;
+}
+
+static int
+mbuf_appendint(lua_State *L)
+{
+    struct os_mbuf **omp;
+    uint32_t val;
+    uint8_t buf[4];
+    int sz;
+    int i;
+
+    omp = elua_mbuf_check(L, 1);
+    val = luaL_checkinteger(L, 2);
+    sz = luaL_optinteger(L, 3, 1);
+    luaL_argcheck(L, sz == 1 || sz == 2 || sz == 4, 3, "size must be 1/2/4");
+    for (i = 0; i < sz; i++) {
+        buf[i] = val >> (i * 8);
+    }
+    lua_pushinteger(L, os_mbuf_append(*omp, buf, sz));
+    return 1;
+}
+
+static int
+mbuf_data(lua_State *L)
+{
+    struct os_mbuf **omp;
+    luaL_Buffer b;
+    int pktlen;
+    int off;
+    int len;
+    int chunk;
+
+    omp = elua_mbuf_check(L, 1);
+    pktlen = OS_MBUF_PKTLEN(*omp);
+    off = luaL_optinteger(L, 2, 0);
+    luaL_argcheck(L, off >= 0 && off <= pktlen, 2, "offset out of range");
+    len = luaL_optinteger(L, 3, pktlen - off);
+    if (len > pktlen - off) {
+        len = pktlen - off;
+    }
+
+    luaL_buffinit(L, &b);
+    while (len > 0) {
+        chunk = len < LUAL_BUFFERSIZE ? len : LUAL_BUFFERSIZE;
+        os_mbuf_copydata(*omp, off, chunk, luaL_prepbuffer(&b));
+        luaL_addsize(&b, chunk);
+        off += chunk;
+        len -= chunk;
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
+static int
+mbuf_int(lua_State *L)
+{
+    struct os_mbuf **omp;
+    uint8_t buf[4];
+    uint32_t val;
+    int off;
+    int sz;
+    int i;
+
+    omp = elua_mbuf_check(L, 1);
+    off = luaL_checkinteger(L, 2);
+    sz = luaL_optinteger(L, 3, 1);
+    luaL_argcheck(L, sz == 1 || sz == 2 || sz == 4, 3, "size must be 1/2/4");
+    if (off < 0 || os_mbuf_copydata(*omp, off, sz, buf)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    val = 0;
+    for (i = sz - 1; i >= 0; i--) {
+        val = (val << 8) | buf[i];
+    }
+    lua_pushinteger(L, val);
+    return 1;
+}
+
+static int
+mbuf_adj(lua_State *L)
+{
+    struct os_mbuf **omp;
+
+    omp = elua_mbuf_check(L, 1);
+    os_mbuf_adj(*omp, luaL_checkinteger(L, 2));
+    return 0;
+}
+
+static int
+mbuf_len(lua_State *L)
+{
+    lua_pushinteger(L, OS_MBUF_PKTLEN(*elua_mbuf_check(L, 1)));
+    return 1;
+}
+
+static int
+mbuf_free(lua_State *L)
+{
+    struct os_mbuf **omp;
+
+    omp = luaL_checkudata(L, 1, ELUA_MBUF_MT);
+    if (*omp) {
+        os_mbuf_free_chain(*omp);
+        *omp = NULL;
+    }
+    return 0;
+}
+
+const LUA_REG_TYPE mbuf_map[] = {
+    { LSTRKEY("get"), LFUNCVAL(mbuf_get) },
+    { LSTRKEY("append"), LFUNCVAL(mbuf_append) },
+    { LSTRKEY("appendint"), LFUNCVAL(mbuf_appendint) },
+    { LSTRKEY("data"), LFUNCVAL(mbuf_data) },
+    { LSTRKEY("int"), LFUNCVAL(mbuf_int) },
+    { LSTRKEY("adj"), LFUNCVAL(mbuf_adj) },
+    { LSTRKEY("len"), LFUNCVAL(mbuf_len) },
+    { LSTRKEY("free"), LFUNCVAL(mbuf_free) },
+    { LNILKEY, LNILVAL }
+};
+
+/*
+ * Metatable is a regular table, as rotable metatables are not enabled in
+ * cross compiler builds.
+ */
+int
+luaopen_mbuf(lua_State *L)
+{
+    luaL_newmetatable(L, ELUA_MBUF_MT);
+    lua_pushcfunction(L, mbuf_free);
+    lua_setfield(L, -2, "__gc");
+    lua_pushcfunction(L, mbuf_len);
+    lua_setfield(L, -2, "__len");
+#if LUA_OPTIMIZE_MEMORY >= MIN_OPT_LEVEL
+    lua_pushrotable(L, (void *)mbuf_map);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+    return 0;
+#else
+    luaL_register(L, "mbuf", mbuf_map);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -3, "__index");
+    return 1;
+#endif
+}
+
+#endif
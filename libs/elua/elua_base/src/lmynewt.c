@@ -18,6 +18,7 @@
  */
 #include <shell/shell.h>
 #include <elua_base/elua.h>
+#include "lmynewt.h"
 
 #ifdef MYNEWT
 
@@ -40,6 +41,12 @@ lua_cmd(int argc, char **argv)
 int
 lua_init(void)
 {
+    int rc;
+
+    rc = elua_mem_init();
+    if (rc) {
+        return rc;
+    }
 #ifdef SHELL_PRESENT
     return shell_cmd_register(&lua_shell_cmd);
 #else
@@ -0,0 +1,42 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef __LMYNEWT_H__
+#define __LMYNEWT_H__
+
+#include <stddef.h>
+#include "elua_base/elua.h"
+
+/*
+ * Lua allocator. Small blocks come from size class pools dedicated to Lua,
+ * larger ones (and small ones when the pool is exhausted) from os_malloc().
+ */
+void *elua_mem_realloc(void *ptr, size_t osize, size_t nsize);
+void elua_mem_free(void *ptr, size_t osize);
+int elua_mem_init(void);
+
+/*
+ * mbuf userdata of the "mbuf" Lua module. elua_mbuf_take() returns the
+ * chain and leaves the userdata empty; caller owns the chain then.
+ */
+struct lua_State;
+struct os_mbuf;
+void elua_mbuf_push(struct lua_State *L, struct os_mbuf *om);
+struct os_mbuf *elua_mbuf_take(struct lua_State *L, int idx);
+
+#endif /* __LMYNEWT_H__ */
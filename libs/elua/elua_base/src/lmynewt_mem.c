@@ -0,0 +1,251 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifdef MYNEWT
+
+#include <string.h>
+
+#include <os/os.h>
+#include <stats/stats.h>
+
+#include "lua.h"
+#include "lmynewt.h"
+
+/*
+ * Number of blocks in each size class of the Lua arena. Blocks are
+ * 16, 32, 64 and 128 bytes; setting a count to 0 disables the class.
+ */
+#ifndef ELUA_MEM_BLOCKS_16
+#define ELUA_MEM_BLOCKS_16      64
+#endif
+#ifndef ELUA_MEM_BLOCKS_32
+#define ELUA_MEM_BLOCKS_32      64
+#endif
+#ifndef ELUA_MEM_BLOCKS_64
+#define ELUA_MEM_BLOCKS_64      32
+#endif
+#ifndef ELUA_MEM_BLOCKS_128
+#define ELUA_MEM_BLOCKS_128     16
+#endif
+
+/*
+ * Maximum number of incremental GC steps taken by elua_gc_idle().
+ */
+#ifndef ELUA_GC_IDLE_STEPS
+#define ELUA_GC_IDLE_STEPS      8
+#endif
+
+STATS_SECT_START(elua_mem)
+    STATS_SECT_ENTRY(pool_allocs)
+    STATS_SECT_ENTRY(heap_allocs)
+    STATS_SECT_ENTRY(frees)
+    STATS_SECT_ENTRY(exhausted)
+    STATS_SECT_ENTRY(bytes_in_use)
+    STATS_SECT_ENTRY(max_bytes_in_use)
+    STATS_SECT_ENTRY(gc_idle_steps)
+STATS_SECT_END
+
+STATS_NAME_START(elua_mem)
+    STATS_NAME(elua_mem, pool_allocs)
+    STATS_NAME(elua_mem, heap_allocs)
+    STATS_NAME(elua_mem, frees)
+    STATS_NAME(elua_mem, exhausted)
+    STATS_NAME(elua_mem, bytes_in_use)
+    STATS_NAME(elua_mem, max_bytes_in_use)
+    STATS_NAME(elua_mem, gc_idle_steps)
+STATS_NAME_END(elua_mem)
+
+static STATS_SECT_DECL(elua_mem) elua_mem_stats;
+
+#define ELUA_MEM_CLASS_CNT      4
+
+static os_membuf_t elua_mem_16[OS_MEMPOOL_SIZE(ELUA_MEM_BLOCKS_16, 16)];
+static os_membuf_t elua_mem_32[OS_MEMPOOL_SIZE(ELUA_MEM_BLOCKS_32, 32)];
+static os_membuf_t elua_mem_64[OS_MEMPOOL_SIZE(ELUA_MEM_BLOCKS_64, 64)];
+static os_membuf_t elua_mem_128[OS_MEMPOOL_SIZE(ELUA_MEM_BLOCKS_128, 128)];
+
+/* Sorted by ascending block size. */
+static struct os_mempool elua_mem_pools[ELUA_MEM_CLASS_CNT];
+
+static const struct {
+    uint16_t block_size;
+    uint16_t nblocks;
+    os_membuf_t *membuf;
+    char *name;
+} elua_mem_classes[ELUA_MEM_CLASS_CNT] = {
+    { 16, ELUA_MEM_BLOCKS_16, elua_mem_16, "elua16" },
+    { 32, ELUA_MEM_BLOCKS_32, elua_mem_32, "elua32" },
+    { 64, ELUA_MEM_BLOCKS_64, elua_mem_64, "elua64" },
+    { 128, ELUA_MEM_BLOCKS_128, elua_mem_128, "elua128" },
+};
+
+static struct os_mempool *
+elua_mem_pool_find(void *ptr)
+{
+    int i;
+
+    for (i = 0; i < ELUA_MEM_CLASS_CNT; i++) {
+        if (elua_mem_pools[i].mp_num_blocks &&
+          os_memblock_from(&elua_mem_pools[i], ptr)) {
+            return &elua_mem_pools[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Get a block from the smallest size class which fits, and has room.
+ */
+static void *
+elua_mem_pool_get(size_t size)
+{
+    struct os_mempool *mp;
+    void *ptr;
+    int i;
+
+    for (i = 0; i < ELUA_MEM_CLASS_CNT; i++) {
+        mp = &elua_mem_pools[i];
+        if (mp->mp_block_size < size || mp->mp_num_blocks == 0) {
+            continue;
+        }
+        ptr = os_memblock_get(mp);
+        if (ptr) {
+            STATS_INC(elua_mem_stats, pool_allocs);
+            return ptr;
+        }
+        STATS_INC(elua_mem_stats, exhausted);
+    }
+    return NULL;
+}
+
+static void
+elua_mem_account(size_t osize, size_t nsize)
+{
+    elua_mem_stats.sbytes_in_use += nsize - osize;
+    if (elua_mem_stats.sbytes_in_use > elua_mem_stats.smax_bytes_in_use) {
+        elua_mem_stats.smax_bytes_in_use = elua_mem_stats.sbytes_in_use;
+    }
+}
+
+void
+elua_mem_free(void *ptr, size_t osize)
+{
+    struct os_mempool *mp;
+
+    if (!ptr) {
+        return;
+    }
+    mp = elua_mem_pool_find(ptr);
+    if (mp) {
+        os_memblock_put(mp, ptr);
+    } else {
+        os_free(ptr);
+    }
+    STATS_INC(elua_mem_stats, frees);
+    elua_mem_account(osize, 0);
+}
+
+/*
+ * Allocator for Lua; see frealloc in lmem.c for semantics. Shrinking never
+ * fails: a pool block which still fits is kept as is.
+ */
+void *
+elua_mem_realloc(void *ptr, size_t osize, size_t nsize)
+{
+    struct os_mempool *mp;
+    void *nptr;
+
+    mp = NULL;
+    if (ptr) {
+        mp = elua_mem_pool_find(ptr);
+        if (mp && nsize <= mp->mp_block_size) {
+            elua_mem_account(osize, nsize);
+            return ptr;
+        }
+    }
+
+    nptr = elua_mem_pool_get(nsize);
+    if (!nptr) {
+        if (ptr && !mp) {
+            /*
+             * Heap block stays in the heap.
+             */
+            nptr = os_realloc(ptr, nsize);
+            if (nptr) {
+                STATS_INC(elua_mem_stats, heap_allocs);
+                elua_mem_account(osize, nsize);
+            }
+            return nptr;
+        }
+        nptr = os_malloc(nsize);
+        if (!nptr) {
+            return NULL;
+        }
+        STATS_INC(elua_mem_stats, heap_allocs);
+    }
+    elua_mem_account(0, nsize);
+    if (ptr) {
+        memcpy(nptr, ptr, osize < nsize ? osize : nsize);
+        elua_mem_free(ptr, osize);
+    }
+    return nptr;
+}
+
+/*
+ * Do incremental garbage collection while the system is otherwise idle,
+ * so that less of it needs to be done while scripts are running. Must be
+ * called from the task running the Lua state. Stops when the current GC
+ * cycle is finished.
+ */
+void
+elua_gc_idle(lua_State *L)
+{
+    int i;
+
+    for (i = 0; i < ELUA_GC_IDLE_STEPS; i++) {
+        STATS_INC(elua_mem_stats, gc_idle_steps);
+        if (lua_gc(L, LUA_GCSTEP, 0)) {
+            break;
+        }
+    }
+}
+
+int
+elua_mem_init(void)
+{
+    int rc;
+    int i;
+
+    for (i = 0; i < ELUA_MEM_CLASS_CNT; i++) {
+        if (elua_mem_classes[i].nblocks == 0) {
+            continue;
+        }
+        rc = os_mempool_init(&elua_mem_pools[i], elua_mem_classes[i].nblocks,
+          elua_mem_classes[i].block_size, elua_mem_classes[i].membuf,
+          elua_mem_classes[i].name);
+        if (rc) {
+            return rc;
+        }
+    }
+
+    return stats_init_and_reg(STATS_HDR(elua_mem_stats),
+      STATS_SIZE_INIT_PARMS(elua_mem_stats, STATS_SIZE_32),
+      STATS_NAME_INIT_PARMS(elua_mem), "elua_mem");
+}
+
+#endif
@@ -82,7 +82,9 @@ static void f_luaopen (lua_State *L, void *ud) {
   sethvalue(L, registry(L), luaH_new(L, 0, 2));  /* registry */
   luaS_resize(L, MINSTRTABSIZE);  /* initial size of string table */
   luaT_init(L);
+#if !defined(LUA_NO_PARSER)
   luaX_init(L);
+#endif
   luaS_fix(luaS_newliteral(L, MEMERRMSG));
   g->GCthreshold = 4*g->totalbytes;
 }
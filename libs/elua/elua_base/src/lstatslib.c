@@ -0,0 +1,117 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifdef MYNEWT
+
+/*
+ * Lua module "stats": direct access to sys/stats counters.
+ *
+ *   v = stats.get(group, name)      value of one counter, nil if not found
+ *   t = stats.group(group)          table of all counters in the group
+ */
+
+#include <string.h>
+
+#include <os/os.h>
+#include <stats/stats.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lrotable.h"
+#include "lmynewt.h"
+
+#define MIN_OPT_LEVEL 2
+#include "lrodefs.h"
+
+struct stats_lua_find {
+    const char *name;
+    int off;
+};
+
+static int
+stats_lua_find_walk(struct stats_hdr *hdr, void *arg, char *name,
+  uint16_t off)
+{
+    struct stats_lua_find *slf = arg;
+
+    if (!strcmp(name, slf->name)) {
+        slf->off = off;
+        return 1;
+    }
+    return 0;
+}
+
+static int
+stats_lua_get(lua_State *L)
+{
+    struct stats_lua_find slf;
+    struct stats_hdr *hdr;
+
+    hdr = stats_group_find((char *)luaL_checkstring(L, 1));
+    slf.name = luaL_checkstring(L, 2);
+    slf.off = -1;
+    if (hdr) {
+        stats_walk(hdr, stats_lua_find_walk, &slf);
+    }
+    if (slf.off < 0) {
+        lua_pushnil(L);
+    } else {
+        lua_pushinteger(L, stats_value(hdr, slf.off));
+    }
+    return 1;
+}
+
+static int
+stats_lua_group_walk(struct stats_hdr *hdr, void *arg, char *name,
+  uint16_t off)
+{
+    lua_State *L = arg;
+
+    lua_pushinteger(L, stats_value(hdr, off));
+    lua_setfield(L, -2, name);
+    return 0;
+}
+
+static int
+stats_lua_group(lua_State *L)
+{
+    struct stats_hdr *hdr;
+
+    hdr = stats_group_find((char *)luaL_checkstring(L, 1));
+    if (!hdr) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_createtable(L, 0, hdr->s_cnt);
+    stats_walk(hdr, stats_lua_group_walk, L);
+    return 1;
+}
+
+const LUA_REG_TYPE stats_map[] = {
+    { LSTRKEY("get"), LFUNCVAL(stats_lua_get) },
+    { LSTRKEY("group"), LFUNCVAL(stats_lua_group) },
+    { LNILKEY, LNILVAL }
+};
+
+int
+luaopen_stats(lua_State *L)
+{
+    LREGISTER(L, "stats", stats_map);
+}
+
+#endif
@@ -11,6 +11,7 @@
 #include <string.h>
 #ifdef MYNEWT
 #include <console/console.h>
+#include "lmynewt.h"
 #endif
 
 #define lua_c
@@ -194,6 +195,9 @@ static int pushline (lua_State *L, int firstline) {
   char *b = buffer;
   size_t l;
   const char *prmt = get_prompt(L, firstline);
+#ifdef MYNEWT
+  elua_gc_idle(L);  /* collect while waiting for user */
+#endif
   if (lua_readline(L, b, prmt) == 0)
     return 0;  /* no input */
   l = strlen(b);
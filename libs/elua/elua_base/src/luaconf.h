@@ -348,7 +348,9 @@
 ** mean larger pauses which mean slower collection.) You can also change
 ** this value dynamically.
 */
+#ifndef LUAI_GCPAUSE
 #define LUAI_GCPAUSE	110  /* 110% (wait memory to grow 10% before next gc) */
+#endif
 
 
 /*
@@ -359,7 +361,20 @@
 ** infinity, where each step performs a full collection.) You can also
 ** change this value dynamically.
 */
+#ifndef LUAI_GCMUL
 #define LUAI_GCMUL	200 /* GC runs 'twice the speed' of memory allocation */
+#endif
+
+
+/*
+@@ LUAI_GCSTEPSIZE defines the amount of work (in bytes) done by one
+@* incremental garbage-collector step.
+** CHANGE it to trade off GC pause length against per-step overhead.
+** Smaller values mean shorter pauses.
+*/
+#ifndef LUAI_GCSTEPSIZE
+#define LUAI_GCSTEPSIZE	1024u
+#endif
 
 
 
@@ -884,6 +899,19 @@ typedef long int32_t;
 #define LUA_META_ROTABLES 
 #endif
 
+/* System modules, see lmbuflib.c, lstatslib.c and lblelib.c */
+#if defined(MYNEWT)
+#if defined(ELUA_BLE)
+#define ELUA_BLE_LIB_ROM	_ROM("ble", luaopen_ble, ble_map)
+#else
+#define ELUA_BLE_LIB_ROM
+#endif
+#define LUA_PLATFORM_LIBS_ROM\
+  _ROM("mbuf", luaopen_mbuf, mbuf_map)\
+  _ROM("stats", luaopen_stats, stats_map)\
+  ELUA_BLE_LIB_ROM
+#endif
+
 #if LUA_OPTIMIZE_MEMORY == 2 && defined(LUA_USE_POPEN)
 #error "Pipes not supported in aggresive optimization mode (LUA_OPTIMIZE_MEMORY=2)"
 #endif
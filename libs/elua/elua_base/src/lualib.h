@@ -40,6 +40,12 @@ LUALIB_API int (luaopen_debug) (lua_State *L);
 LUALIB_API int (luaopen_package) (lua_State *L);
 
 
+#ifdef MYNEWT
+LUALIB_API int (luaopen_mbuf) (lua_State *L);
+LUALIB_API int (luaopen_stats) (lua_State *L);
+LUALIB_API int (luaopen_ble) (lua_State *L);
+#endif
+
 /* open all previous libraries */
 LUALIB_API void (luaL_openlibs) (lua_State *L); 
 
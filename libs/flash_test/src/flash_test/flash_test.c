@@ -23,16 +23,203 @@
 #include <hal/hal_bsp.h>
 #include <hal/hal_flash.h>
 #include <hal/hal_flash_int.h>
+#include <hal/hal_cputime.h>
 #include <shell/shell.h>
 #include <stdio.h>
 #include <string.h>
 
+/* Largest block for 'flash speed' read and write */
+#define FLASH_SPEED_BUF_SZ      256
+
+/* Latency histogram buckets; bucket n counts ops taking < 2^(n+4) usecs */
+#define FLASH_SPEED_HIST        16
+
+struct flash_speed_stats {
+    uint32_t fss_cnt;
+    uint32_t fss_bytes;
+    uint32_t fss_total;                 /* usecs */
+    uint32_t fss_min;
+    uint32_t fss_max;
+    uint32_t fss_hist[FLASH_SPEED_HIST];
+};
+
+static uint8_t flash_speed_buf[FLASH_SPEED_BUF_SZ];
+
 static int flash_cli_cmd(int argc, char **argv);
 static struct shell_cmd flash_cmd_struct = {
     .sc_cmd = "flash",
     .sc_cmd_func = flash_cli_cmd
 };
 
+static void
+flash_speed_add(struct flash_speed_stats *fss, uint32_t start, uint32_t bytes)
+{
+    uint32_t usecs;
+    int i;
+
+    usecs = cputime_ticks_to_usecs(cputime_get32() - start);
+    if (fss->fss_cnt == 0 || usecs < fss->fss_min) {
+        fss->fss_min = usecs;
+    }
+    if (usecs > fss->fss_max) {
+        fss->fss_max = usecs;
+    }
+    fss->fss_cnt++;
+    fss->fss_bytes += bytes;
+    fss->fss_total += usecs;
+
+    for (i = 0; i < FLASH_SPEED_HIST - 1; i++) {
+        if (usecs < (16UL << i)) {
+            break;
+        }
+    }
+    fss->fss_hist[i]++;
+}
+
+static void
+flash_speed_print(const char *op, struct flash_speed_stats *fss)
+{
+    uint32_t rate;
+    int i;
+
+    if (fss->fss_cnt == 0) {
+        console_printf("Nothing done\n");
+        return;
+    }
+    rate = 0;
+    if (fss->fss_total) {
+        rate = (uint64_t)fss->fss_bytes * 1000 / fss->fss_total;
+    }
+    console_printf("%s %lu bytes in %lu ops, %lu usec, %lu bytes/msec\n", op,
+      (unsigned long)fss->fss_bytes, (unsigned long)fss->fss_cnt,
+      (unsigned long)fss->fss_total, (unsigned long)rate);
+    console_printf("  latency usec min %lu avg %lu max %lu\n",
+      (unsigned long)fss->fss_min,
+      (unsigned long)(fss->fss_total / fss->fss_cnt),
+      (unsigned long)fss->fss_max);
+    for (i = 0; i < FLASH_SPEED_HIST; i++) {
+        if (fss->fss_hist[i] == 0) {
+            continue;
+        }
+        if (i == FLASH_SPEED_HIST - 1) {
+            console_printf("  >= %lu: %lu\n", 8UL << i,
+              (unsigned long)fss->fss_hist[i]);
+        } else {
+            console_printf("  < %lu: %lu\n", 16UL << i,
+              (unsigned long)fss->fss_hist[i]);
+        }
+    }
+}
+
+/*
+ * flash speed <read|write|erase> <offset> <size> [<blksz> [<flash_id>]]
+ *
+ * Times each flash operation over the range with cputime; read and write
+ * are done blksz bytes at a time, erase one sector at a time. Write must
+ * be done to an erased area.
+ */
+static int
+flash_speed_cmd(int argc, char **argv)
+{
+    const struct hal_flash *hf;
+    struct flash_speed_stats fss;
+    uint32_t off;
+    uint32_t end;
+    uint32_t blksz;
+    uint32_t start;
+    uint32_t sec_off;
+    uint32_t sec_sz;
+    uint32_t cnt;
+    int flash_id;
+    char *eptr;
+    int rc;
+    int i;
+
+    if (argc < 5) {
+        console_printf("flash speed <read|write|erase> <offset> <size> "
+          "[<blksz> [<flash_id>]]\n");
+        return -1;
+    }
+    off = strtoul(argv[3], &eptr, 0);
+    if (*eptr != '\0') {
+        console_printf("Invalid offset %s\n", argv[3]);
+        return -1;
+    }
+    end = strtoul(argv[4], &eptr, 0);
+    if (*eptr != '\0') {
+        console_printf("Invalid size %s\n", argv[4]);
+        return -1;
+    }
+    end += off;
+    blksz = FLASH_SPEED_BUF_SZ;
+    if (argc > 5) {
+        blksz = strtoul(argv[5], &eptr, 0);
+        if (*eptr != '\0' || blksz == 0 || blksz > FLASH_SPEED_BUF_SZ) {
+            console_printf("Invalid block size %s, max %d\n", argv[5],
+              FLASH_SPEED_BUF_SZ);
+            return -1;
+        }
+    }
+    flash_id = 0;
+    if (argc > 6) {
+        flash_id = strtoul(argv[6], &eptr, 0);
+        if (*eptr != '\0') {
+            console_printf("Invalid flash id %s\n", argv[6]);
+            return -1;
+        }
+    }
+    hf = bsp_flash_dev(flash_id);
+    if (!hf) {
+        console_printf("No flash device %d\n", flash_id);
+        return -1;
+    }
+
+    memset(&fss, 0, sizeof(fss));
+    rc = 0;
+    if (!strcmp(argv[2], "read")) {
+        for (; off < end && !rc; off += cnt) {
+            cnt = min(blksz, end - off);
+            start = cputime_get32();
+            rc = hal_flash_read(flash_id, off, flash_speed_buf, cnt);
+            flash_speed_add(&fss, start, cnt);
+        }
+    } else if (!strcmp(argv[2], "write")) {
+        for (i = 0; i < blksz; i++) {
+            flash_speed_buf[i] = i;
+        }
+        for (; off < end && !rc; off += cnt) {
+            cnt = min(blksz, end - off);
+            start = cputime_get32();
+            rc = hal_flash_write(flash_id, off, flash_speed_buf, cnt);
+            flash_speed_add(&fss, start, cnt);
+        }
+    } else if (!strcmp(argv[2], "erase")) {
+        for (i = 0; i < hf->hf_sector_cnt && !rc; i++) {
+            if (hf->hf_itf->hff_sector_info(i, &sec_off, &sec_sz)) {
+                break;
+            }
+            if (sec_off >= end || sec_off + sec_sz <= off) {
+                continue;
+            }
+            start = cputime_get32();
+            rc = hal_flash_erase_sector(flash_id, sec_off);
+            flash_speed_add(&fss, start, sec_sz);
+            if (rc) {
+                off = sec_off;
+            }
+        }
+    } else {
+        console_printf("Unknown op %s\n", argv[2]);
+        return -1;
+    }
+    if (rc) {
+        console_printf("flash %s failure at 0x%lx\n", argv[2],
+          (unsigned long)off);
+    }
+    flash_speed_print(argv[2], &fss);
+    return 0;
+}
+
 static int
 flash_cli_cmd(int argc, char **argv)
 {
@@ -75,6 +262,9 @@ flash_cli_cmd(int argc, char **argv)
         }
         return 0;
     }
+    if (!strcmp(argv[1], "speed")) {
+        return flash_speed_cmd(argc, argv);
+    }
     if (argc > 2) {
         off = strtoul(argv[2], &eptr, 0);
         if (*eptr != '\0') {
@@ -141,6 +331,8 @@ flash_cli_cmd(int argc, char **argv)
         console_printf("flash read <offset> <size> -- reads bytes from flash \n");
         console_printf("flash write <offset>  <size>  -- writes incrementing data pattern 0-8 to flash \n");
         console_printf("flash erase <offset> <size> -- erases flash \n");
+        console_printf("flash speed <read|write|erase> <offset> <size> "
+          "[<blksz> [<flash_id>]] -- times flash operations \n");
     }
     return 0;
 err:
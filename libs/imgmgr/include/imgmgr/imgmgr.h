@@ -28,11 +28,27 @@
 #define IMGMGR_NMGR_OP_BOOT2		5
 #define IMGMGR_NMGR_OP_CORELIST		6
 #define IMGMGR_NMGR_OP_CORELOAD		7
+#define IMGMGR_NMGR_OP_UPLOAD_RAW	8
 
 #define IMGMGR_NMGR_MAX_MSG		400
 #define IMGMGR_NMGR_MAX_NAME		64
 #define IMGMGR_NMGR_MAX_VER		25	/* 255.255.65535.4294967295\0 */
 
+/*
+ * Raw upload requests a client may have in flight before waiting for a
+ * response.
+ */
+#ifndef IMGMGR_RAW_WINDOW
+#define IMGMGR_RAW_WINDOW		4
+#endif
+
+/*
+ * How often, in bytes received, progress of an upload is saved.
+ */
+#ifndef IMGMGR_RESUME_INTERVAL
+#define IMGMGR_RESUME_INTERVAL		8192
+#endif
+
 #define IMGMGR_HASH_LEN                 32
 
 int imgmgr_module_init(void);
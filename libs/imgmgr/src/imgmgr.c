@@ -16,6 +16,7 @@
  * specific language governing permissions and limitations
  * under the License.
  */
+#include <os/os.h>
 #include <os/endian.h>
 
 #include <limits.h>
@@ -37,6 +38,8 @@ static int imgr_list(struct nmgr_jbuf *);
 static int imgr_list2(struct nmgr_jbuf *);
 static int imgr_noop(struct nmgr_jbuf *);
 static int imgr_upload(struct nmgr_jbuf *);
+static int imgr_upload_info(struct nmgr_jbuf *);
+static int imgr_upload_raw(struct nmgr_jbuf *);
 
 static const struct nmgr_handler imgr_nmgr_handlers[] = {
     [IMGMGR_NMGR_OP_LIST] = {
@@ -44,7 +47,7 @@ static const struct nmgr_handler imgr_nmgr_handlers[] = {
         .nh_write = imgr_noop
     },
     [IMGMGR_NMGR_OP_UPLOAD] = {
-        .nh_read = imgr_noop,
+        .nh_read = imgr_upload_info,
         .nh_write = imgr_upload
     },
     [IMGMGR_NMGR_OP_BOOT] = {
@@ -85,6 +88,10 @@ static const struct nmgr_handler imgr_nmgr_handlers[] = {
         .nh_read = imgr_noop,
         .nh_write = imgr_noop
 #endif
+    },
+    [IMGMGR_NMGR_OP_UPLOAD_RAW] = {
+        .nh_read = imgr_noop,
+        .nh_write = imgr_upload_raw
     }
 };
 
@@ -93,10 +100,69 @@ static struct nmgr_group imgr_nmgr_group = {
     .ng_handlers_count =
     sizeof(imgr_nmgr_handlers) / sizeof(imgr_nmgr_handlers[0]),
     .ng_group_id = NMGR_GROUP_ID_IMAGE,
+    .ng_flags = NMGR_GROUP_F_WORKER,
 };
 
 struct imgr_state imgr_state;
 
+/*
+ * Abandon upload in progress, if any.
+ */
+static void
+imgr_upload_close(void)
+{
+    if (imgr_state.upload.fa) {
+        flash_area_close(imgr_state.upload.fa);
+        imgr_state.upload.fa = NULL;
+        mbedtls_sha256_free(&imgr_state.upload.sha);
+#ifdef RESUME_PRESENT
+        imgr_resume_clear();
+#endif
+    }
+#ifdef DELTA_PRESENT
+    if (imgr_state.upload.is_delta) {
+        imgr_delta_abort();
+        imgr_state.upload.is_delta = 0;
+    }
+#endif
+}
+
+/*
+ * Results of imgr_read_info() for the image slots. Slot contents only change
+ * through us (or the bootloader, across a reset), so they stay valid until
+ * imgr_info_invalidate() is called for the slot.
+ */
+static struct imgr_info_cache {
+    uint8_t valid;
+    int8_t rc;
+    struct image_version ver;
+    uint8_t hash[IMGMGR_HASH_LEN];
+} imgr_info_cache[IMGMGR_MAX_IMGS];
+
+static struct imgr_info_cache *
+imgr_info_cache_get(int area_id)
+{
+    if (area_id < FLASH_AREA_IMAGE_0 ||
+      area_id >= FLASH_AREA_IMAGE_0 + IMGMGR_MAX_IMGS) {
+        return NULL;
+    }
+    return &imgr_info_cache[area_id - FLASH_AREA_IMAGE_0];
+}
+
+void
+imgr_info_invalidate(int area_id)
+{
+    struct imgr_info_cache *ic;
+
+    ic = imgr_info_cache_get(area_id);
+    if (ic) {
+        ic->valid = 0;
+    }
+}
+
+static int imgr_read_info_flash(int area_id, struct image_version *ver,
+  uint8_t *hash);
+
 /*
  * Read version and build hash from image located in flash area 'area_id'.
  *
@@ -107,6 +173,31 @@ struct imgr_state imgr_state;
  */
 int
 imgr_read_info(int area_id, struct image_version *ver, uint8_t *hash)
+{
+    struct imgr_info_cache *ic;
+    int rc;
+
+    ic = imgr_info_cache_get(area_id);
+    if (!ic) {
+        return imgr_read_info_flash(area_id, ver, hash);
+    }
+    if (!ic->valid) {
+        rc = imgr_read_info_flash(area_id, &ic->ver, ic->hash);
+        if (rc < 0) {
+            return rc;
+        }
+        ic->rc = rc;
+        ic->valid = 1;
+    }
+    memcpy(ver, &ic->ver, sizeof(*ver));
+    if (hash && ic->rc == 0) {
+        memcpy(hash, ic->hash, IMGMGR_HASH_LEN);
+    }
+    return ic->rc;
+}
+
+static int
+imgr_read_info_flash(int area_id, struct image_version *ver, uint8_t *hash)
 {
     struct image_header *hdr;
     struct image_tlv *tlv;
@@ -307,13 +398,262 @@ imgr_noop(struct nmgr_jbuf *njb)
     return 0;
 }
 
+/*
+ * Picks the slot for a new upload, given the header at the start of the
+ * image, and erases it.
+ */
+static int
+imgr_upload_start(struct image_header *hdr, uint32_t size)
+{
+    struct image_version ver;
+    int active;
+    int best;
+    int rc;
+    int delta;
+    int i;
+
+    delta = 0;
+    if (hdr->ih_magic != IMAGE_MAGIC) {
+#ifdef DELTA_PRESENT
+        if (hdr->ih_magic != IMAGE_DELTA_MAGIC) {
+            return NMGR_ERR_EINVAL;
+        }
+        delta = 1;
+#else
+        return NMGR_ERR_EINVAL;
+#endif
+    }
+
+    imgr_state.upload.off = 0;
+    imgr_state.upload.size = size;
+    active = bsp_imgr_current_slot();
+    best = -1;
+
+    for (i = FLASH_AREA_IMAGE_0; i <= FLASH_AREA_IMAGE_1; i++) {
+        rc = imgr_read_info(i, &ver, NULL);
+        if (rc < 0) {
+            continue;
+        }
+        if (rc == 0) {
+            if (!delta && !memcmp(&ver, &hdr->ih_ver, sizeof(ver))) {
+                if (active == i) {
+                    return NMGR_ERR_EINVAL;
+                } else {
+                    best = i;
+                    break;
+                }
+            }
+            /*
+             * Image in slot is ok.
+             */
+            if (active == i) {
+                /*
+                 * Slot is currently active one. Can't upload to this.
+                 */
+                continue;
+            } else {
+                /*
+                 * Not active slot, but image is ok. Use it if there are
+                 * no better candidates.
+                 */
+                best = i;
+            }
+            continue;
+        }
+        best = i;
+        break;
+    }
+    if (best < 0) {
+        /*
+         * No slot where to upload!
+         */
+        return NMGR_ERR_ENOMEM;
+    }
+    imgr_upload_close();
+    rc = flash_area_open(best, &imgr_state.upload.fa);
+    if (rc) {
+        return NMGR_ERR_EINVAL;
+    }
+    if (!delta && IMAGE_SIZE(hdr) > imgr_state.upload.fa->fa_size) {
+        return NMGR_ERR_EINVAL;
+    }
+    /*
+     * XXXX only erase if needed.
+     */
+    flash_area_erase(imgr_state.upload.fa, 0, imgr_state.upload.fa->fa_size);
+    imgr_info_invalidate(best);
+    imgr_state.upload.area_id = best;
+    imgr_state.upload.hash_end = hdr->ih_hdr_size + hdr->ih_img_size;
+    imgr_state.upload.need_hash = !!(hdr->ih_flags & IMAGE_F_SHA256);
+    mbedtls_sha256_init(&imgr_state.upload.sha);
+    mbedtls_sha256_starts(&imgr_state.upload.sha, 0);
+#ifdef DELTA_PRESENT
+    if (delta) {
+        if (imgr_delta_start()) {
+            imgr_upload_close();
+            return NMGR_ERR_EINVAL;
+        }
+        imgr_state.upload.is_delta = 1;
+        imgr_state.upload.hash_end = 0;
+    }
+#endif
+    return 0;
+}
+
+static int
+imgr_upload_write(void *arg, const uint8_t *data, uint16_t len)
+{
+    int rc;
+
+#ifdef DELTA_PRESENT
+    if (imgr_state.upload.is_delta) {
+        /*
+         * Offset is that of delta data; image is written by the decoder.
+         */
+        rc = imgr_delta_write(data, len);
+    } else {
+        rc = flash_area_write(imgr_state.upload.fa, imgr_state.upload.off,
+          (void *)data, len);
+    }
+#else
+    rc = flash_area_write(imgr_state.upload.fa, imgr_state.upload.off,
+      (void *)data, len);
+#endif
+    imgr_info_invalidate(imgr_state.upload.area_id);
+    if (rc) {
+        return NMGR_ERR_EINVAL;
+    }
+    if (imgr_state.upload.off < imgr_state.upload.hash_end) {
+        mbedtls_sha256_update(&imgr_state.upload.sha, data,
+          min(len, imgr_state.upload.hash_end - imgr_state.upload.off));
+    }
+    imgr_state.upload.off += len;
+    return 0;
+}
+
+/*
+ * Check hash of uploaded image against the one computed while receiving it.
+ */
+static int
+imgr_upload_verify(void)
+{
+    struct image_version ver;
+    uint8_t hash[IMGMGR_HASH_LEN];
+    uint8_t tlv_hash[IMGMGR_HASH_LEN];
+    int rc;
+
+    mbedtls_sha256_finish(&imgr_state.upload.sha, hash);
+    rc = imgr_read_info(imgr_state.upload.area_id, &ver, tlv_hash);
+    if (rc == 0) {
+        if (memcmp(hash, tlv_hash, sizeof(hash))) {
+            return -1;
+        }
+    } else if (rc != 1 || imgr_state.upload.need_hash) {
+        return -1;
+    }
+    return 0;
+}
+
+static int
+imgr_upload_done(uint32_t prev_off)
+{
+    int rc;
+
+    if (imgr_state.upload.size != imgr_state.upload.off) {
+#ifdef RESUME_PRESENT
+        if (prev_off / IMGMGR_RESUME_INTERVAL !=
+          imgr_state.upload.off / IMGMGR_RESUME_INTERVAL) {
+            imgr_resume_save();
+        }
+#endif
+        return 0;
+    }
+    /* Done */
+#ifdef DELTA_PRESENT
+    if (imgr_state.upload.is_delta) {
+        imgr_state.upload.is_delta = 0;
+        rc = imgr_delta_finish();
+    } else {
+        rc = imgr_upload_verify();
+    }
+#else
+    rc = imgr_upload_verify();
+#endif
+    if (rc) {
+        /*
+         * Don't leave a broken image behind.
+         */
+        flash_area_erase(imgr_state.upload.fa, 0,
+          imgr_state.upload.fa->fa_size);
+        imgr_info_invalidate(imgr_state.upload.area_id);
+        rc = NMGR_ERR_EINVAL;
+    }
+    imgr_upload_close();
+    return rc;
+}
+
+static int
+imgr_upload_rsp(struct nmgr_jbuf *njb, int win)
+{
+    struct json_encoder *enc;
+    struct json_value jv;
+
+    enc = &njb->njb_enc;
+
+    json_encode_object_start(enc);
+
+    JSON_VALUE_INT(&jv, NMGR_ERR_EOK);
+    json_encode_object_entry(enc, "rc", &jv);
+
+    JSON_VALUE_UINT(&jv, imgr_state.upload.off);
+    json_encode_object_entry(enc, "off", &jv);
+
+    if (win) {
+        JSON_VALUE_UINT(&jv, win);
+        json_encode_object_entry(enc, "win", &jv);
+    }
+
+    json_encode_object_finish(enc);
+
+    return 0;
+}
+
+/*
+ * Reports the offset an upload in progress can be continued from.
+ */
+static int
+imgr_upload_info(struct nmgr_jbuf *njb)
+{
+    struct json_encoder *enc;
+    struct json_value jv;
+
+    enc = &njb->njb_enc;
+
+    json_encode_object_start(enc);
+
+    JSON_VALUE_INT(&jv, NMGR_ERR_EOK);
+    json_encode_object_entry(enc, "rc", &jv);
+
+    if (imgr_state.upload.fa) {
+        JSON_VALUE_UINT(&jv, imgr_state.upload.off);
+        json_encode_object_entry(enc, "off", &jv);
+        JSON_VALUE_UINT(&jv, imgr_state.upload.size);
+        json_encode_object_entry(enc, "len", &jv);
+    }
+
+    json_encode_object_finish(enc);
+
+    return 0;
+}
+
 static int
 imgr_upload(struct nmgr_jbuf *njb)
 {
     char img_data[BASE64_ENCODE_SIZE(IMGMGR_NMGR_MAX_MSG)];
     long long unsigned int off = UINT_MAX;
     long long unsigned int size = UINT_MAX;
-    const struct json_attr_t off_attr[4] = {
+    size_t data_len = 0;
+    const struct json_attr_t off_attr[5] = {
         [0] = {
             .attribute = "off",
             .type = t_uinteger,
@@ -327,33 +667,39 @@ imgr_upload(struct nmgr_jbuf *njb)
             .len = sizeof(img_data)
         },
         [2] = {
+            /* CBOR requests can carry the data without base64. */
+            .attribute = "data",
+            .type = t_bytes,
+            .addr.bytes.data = (uint8_t *)img_data,
+            .addr.bytes.len = &data_len,
+            .len = IMGMGR_NMGR_MAX_MSG
+        },
+        [3] = {
             .attribute = "len",
             .type = t_uinteger,
             .addr.uinteger = &size,
             .nodefault = true
         }
     };
-    struct image_version ver;
-    struct image_header *hdr;
-    struct json_encoder *enc;
-    struct json_value jv;
-    int active;
-    int best;
+    uint32_t prev_off;
     int rc;
     int len;
-    int i;
 
     rc = json_read_object(&njb->njb_buf, off_attr);
     if (rc || off == UINT_MAX) {
         rc = NMGR_ERR_EINVAL;
         goto err;
     }
-    len = strlen(img_data);
-    if (len) {
-        len = base64_decode(img_data, img_data);
-        if (len < 0) {
-            rc = NMGR_ERR_EINVAL;
-            goto err;
+    if (data_len) {
+        len = data_len;
+    } else {
+        len = strlen(img_data);
+        if (len) {
+            len = base64_decode(img_data, img_data);
+            if (len < 0) {
+                rc = NMGR_ERR_EINVAL;
+                goto err;
+            }
         }
     }
 
@@ -365,79 +711,12 @@ imgr_upload(struct nmgr_jbuf *njb)
             rc = NMGR_ERR_EINVAL;
             goto err;
         }
-        hdr = (struct image_header *)img_data;
-        if (hdr->ih_magic != IMAGE_MAGIC) {
-            rc = NMGR_ERR_EINVAL;
-            goto err;
-        }
 
         /*
          * New upload.
          */
-        imgr_state.upload.off = 0;
-        imgr_state.upload.size = size;
-        active = bsp_imgr_current_slot();
-        best = -1;
-
-        for (i = FLASH_AREA_IMAGE_0; i <= FLASH_AREA_IMAGE_1; i++) {
-            rc = imgr_read_info(i, &ver, NULL);
-            if (rc < 0) {
-                continue;
-            }
-            if (rc == 0) {
-                if (!memcmp(&ver, &hdr->ih_ver, sizeof(ver))) {
-                    if (active == i) {
-                        rc = NMGR_ERR_EINVAL;
-                        goto err;
-                    } else {
-                        best = i;
-                        break;
-                    }
-                }
-                /*
-                 * Image in slot is ok.
-                 */
-                if (active == i) {
-                    /*
-                     * Slot is currently active one. Can't upload to this.
-                     */
-                    continue;
-                } else {
-                    /*
-                     * Not active slot, but image is ok. Use it if there are
-                     * no better candidates.
-                     */
-                    best = i;
-                }
-                continue;
-            }
-            best = i;
-            break;
-        }
-        if (best >= 0) {
-            if (imgr_state.upload.fa) {
-                flash_area_close(imgr_state.upload.fa);
-                imgr_state.upload.fa = NULL;
-            }
-            rc = flash_area_open(best, &imgr_state.upload.fa);
-            if (rc) {
-                rc = NMGR_ERR_EINVAL;
-                goto err;
-            }
-	    if (IMAGE_SIZE(hdr) > imgr_state.upload.fa->fa_size) {
-                rc = NMGR_ERR_EINVAL;
-                goto err;
-            }
-            /*
-             * XXXX only erase if needed.
-             */
-            rc = flash_area_erase(imgr_state.upload.fa, 0,
-              imgr_state.upload.fa->fa_size);
-        } else {
-            /*
-             * No slot where to upload!
-             */
-            rc = NMGR_ERR_ENOMEM;
+        rc = imgr_upload_start((struct image_header *)img_data, size);
+        if (rc) {
             goto err;
         }
     } else if (off != imgr_state.upload.off) {
@@ -453,36 +732,90 @@ imgr_upload(struct nmgr_jbuf *njb)
         goto err;
     }
     if (len) {
-        rc = flash_area_write(imgr_state.upload.fa, imgr_state.upload.off,
-          img_data, len);
+        prev_off = imgr_state.upload.off;
+        rc = imgr_upload_write(NULL, (uint8_t *)img_data, len);
         if (rc) {
-            rc = NMGR_ERR_EINVAL;
             goto err_close;
         }
-        imgr_state.upload.off += len;
-        if (imgr_state.upload.size == imgr_state.upload.off) {
-            /* Done */
-            flash_area_close(imgr_state.upload.fa);
-            imgr_state.upload.fa = NULL;
+        rc = imgr_upload_done(prev_off);
+        if (rc) {
+            goto err;
         }
     }
 out:
-    enc = &njb->njb_enc;
-
-    json_encode_object_start(enc);
+    return imgr_upload_rsp(njb, 0);
+err_close:
+    imgr_upload_close();
+err:
+    nmgr_jbuf_setoerr(njb, rc);
+    return 0;
+}
 
-    JSON_VALUE_INT(&jv, NMGR_ERR_EOK);
-    json_encode_object_entry(enc, "rc", &jv);
+/*
+ * Raw upload: the request is a struct imgmgr_upload_cmd followed by image
+ * data, which is written to flash straight from the request mbufs. The
+ * response is the same as for a regular upload, plus the number of
+ * requests the client may have outstanding. A request at the wrong offset
+ * is dropped, so a pipelining client resends from the returned offset.
+ */
+static int
+imgr_upload_raw(struct nmgr_jbuf *njb)
+{
+    struct imgmgr_upload_cmd cmd;
+    struct image_header hdr;
+    struct os_mbuf_cursor cur;
+    uint32_t prev_off;
+    int len;
+    int rc;
 
-    JSON_VALUE_UINT(&jv, imgr_state.upload.off);
-    json_encode_object_entry(enc, "off", &jv);
+    len = njb->njb_end - njb->njb_off - sizeof(cmd);
+    if (len < 0 ||
+      os_mbuf_cursor_init(&cur, njb->njb_in_m, njb->njb_off) ||
+      os_mbuf_cursor_get_be32(&cur, &cmd.iuc_off) ||
+      os_mbuf_cursor_get_be32(&cur, &cmd.iuc_len)) {
+        rc = NMGR_ERR_EINVAL;
+        goto err;
+    }
 
-    json_encode_object_finish(enc);
+    if (cmd.iuc_off == 0) {
+        if (len < sizeof(hdr) ||
+          os_mbuf_copydata(njb->njb_in_m, njb->njb_off + sizeof(cmd),
+            sizeof(hdr), &hdr)) {
+            rc = NMGR_ERR_EINVAL;
+            goto err;
+        }
+        rc = imgr_upload_start(&hdr, cmd.iuc_len);
+        if (rc) {
+            goto err;
+        }
+    } else if (cmd.iuc_off != imgr_state.upload.off) {
+        goto out;
+    }
 
-    return 0;
+    if (!imgr_state.upload.fa) {
+        rc = NMGR_ERR_EINVAL;
+        goto err;
+    }
+    if (imgr_state.upload.off + len > imgr_state.upload.size) {
+        rc = NMGR_ERR_EINVAL;
+        goto err_close;
+    }
+    if (len) {
+        prev_off = imgr_state.upload.off;
+        rc = os_mbuf_cursor_apply(&cur, len, imgr_upload_write, NULL);
+        if (rc) {
+            rc = NMGR_ERR_EINVAL;
+            goto err_close;
+        }
+        rc = imgr_upload_done(prev_off);
+        if (rc) {
+            goto err;
+        }
+    }
+out:
+    return imgr_upload_rsp(njb, IMGMGR_RAW_WINDOW);
 err_close:
-    flash_area_close(imgr_state.upload.fa);
-    imgr_state.upload.fa = NULL;
+    imgr_upload_close();
 err:
     nmgr_jbuf_setoerr(njb, rc);
     return 0;
@@ -496,6 +829,10 @@ imgmgr_module_init(void)
     rc = nmgr_group_register(&imgr_nmgr_group);
     assert(rc == 0);
 
+#ifdef RESUME_PRESENT
+    imgr_resume_init();
+#endif
+
     boot_vect_write_main();
 
     return rc;
@@ -129,6 +129,14 @@ imgr_core_load(struct nmgr_jbuf *njb)
     JSON_VALUE_INT(&jv, off);
     json_encode_object_entry(enc, "off", &jv);
 
+    if (off == 0) {
+        /*
+         * Tell the client how much there is to fetch.
+         */
+        JSON_VALUE_UINT(&jv, hdr->ch_size);
+        json_encode_object_entry(enc, "len", &jv);
+    }
+
     JSON_VALUE_STRINGN(&jv, encoded, sz);
     json_encode_object_entry(enc, "data", &jv);
     json_encode_object_finish(enc);
@@ -163,6 +171,7 @@ imgr_core_erase(struct nmgr_jbuf *njb)
     if (rc == 0 &&
       (hdr.ch_magic == COREDUMP_MAGIC || hdr.ch_magic == 0xffffffff)) {
         rc = flash_area_erase(fa, 0, fa->fa_size);
+        imgr_info_invalidate(FLASH_AREA_CORE);
         if (rc) {
             rc = NMGR_ERR_EINVAL;
         }
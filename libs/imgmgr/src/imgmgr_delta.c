@@ -0,0 +1,317 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef DELTA_PRESENT
+
+#include <string.h>
+
+#include <os/os.h>
+#include <hal/hal_bsp.h>
+#include <hal/flash_map.h>
+#include <newtmgr/newtmgr.h>
+#include <bootutil/image.h>
+
+#include "imgmgr/imgmgr.h"
+#include "imgmgr_priv.h"
+
+#define IMGR_DELTA_S_HDR	0
+#define IMGR_DELTA_S_OP		1
+#define IMGR_DELTA_S_LEN	2
+#define IMGR_DELTA_S_DATA	3
+
+static int
+imgr_delta_flush(struct imgr_delta *d)
+{
+    int rc;
+
+    if (d->out_cnt == 0) {
+        return 0;
+    }
+    rc = flash_area_write(imgr_state.upload.fa, d->out_off, d->out_buf,
+      d->out_cnt);
+    if (rc) {
+        return -1;
+    }
+    d->out_off += d->out_cnt;
+    d->out_cnt = 0;
+    return 0;
+}
+
+/*
+ * Append data to the resulting image. Writes to flash are done in
+ * IMGMGR_DELTA_BUF sized blocks.
+ */
+static int
+imgr_delta_out(struct imgr_delta *d, const uint8_t *data, uint32_t len)
+{
+    uint32_t cnt;
+
+    if (d->out_off + d->out_cnt + len > d->hdr.idh_img_size) {
+        return -1;
+    }
+    mbedtls_sha256_update(&d->sha, data, len);
+    while (len) {
+        cnt = IMGMGR_DELTA_BUF - d->out_cnt;
+        if (cnt > len) {
+            cnt = len;
+        }
+        memcpy(d->out_buf + d->out_cnt, data, cnt);
+        d->out_cnt += cnt;
+        data += cnt;
+        len -= cnt;
+        if (d->out_cnt == IMGMGR_DELTA_BUF && imgr_delta_flush(d)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+imgr_delta_src(struct imgr_delta *d, uint8_t *buf, uint32_t len)
+{
+    if (d->src_off + len > d->src->fa_size) {
+        return -1;
+    }
+    if (flash_area_read(d->src, d->src_off, buf, len)) {
+        return -1;
+    }
+    d->src_off += len;
+    return 0;
+}
+
+static int
+imgr_delta_copy(struct imgr_delta *d)
+{
+    uint8_t buf[IMGMGR_DELTA_BUF];
+    uint32_t cnt;
+
+    while (d->len) {
+        cnt = min(d->len, sizeof(buf));
+        if (imgr_delta_src(d, buf, cnt) || imgr_delta_out(d, buf, cnt)) {
+            return -1;
+        }
+        d->len -= cnt;
+    }
+    return 0;
+}
+
+static int
+imgr_delta_add(struct imgr_delta *d, const uint8_t *data, uint32_t len)
+{
+    uint8_t buf[IMGMGR_DELTA_BUF];
+    uint32_t cnt;
+    int i;
+
+    while (len) {
+        cnt = min(len, sizeof(buf));
+        if (imgr_delta_src(d, buf, cnt)) {
+            return -1;
+        }
+        for (i = 0; i < cnt; i++) {
+            buf[i] += data[i];
+        }
+        if (imgr_delta_out(d, buf, cnt)) {
+            return -1;
+        }
+        data += cnt;
+        len -= cnt;
+    }
+    return 0;
+}
+
+static int
+imgr_delta_seek(struct imgr_delta *d)
+{
+    int64_t off;
+
+    off = (int64_t)d->src_off +
+      (int32_t)((d->len >> 1) ^ -(int32_t)(d->len & 1));
+    if (off < 0 || off > d->src->fa_size) {
+        return -1;
+    }
+    d->src_off = off;
+    return 0;
+}
+
+/*
+ * Delta must be against the image we're running now, and the result must
+ * fit in the upload slot.
+ */
+static int
+imgr_delta_hdr_check(struct imgr_delta *d)
+{
+    struct image_version ver;
+    uint8_t hash[IMGMGR_HASH_LEN];
+
+    if (d->hdr.idh_magic != IMAGE_DELTA_MAGIC ||
+      d->hdr.idh_img_size > imgr_state.upload.fa->fa_size) {
+        return -1;
+    }
+    if (imgr_read_info(bsp_imgr_current_slot(), &ver, hash) != 0 ||
+      memcmp(hash, d->hdr.idh_src_hash, IMGMGR_HASH_LEN)) {
+        return -1;
+    }
+    return 0;
+}
+
+int
+imgr_delta_start(void)
+{
+    struct imgr_delta *d;
+
+    d = &imgr_state.upload.delta;
+    memset(d, 0, sizeof(*d));
+    if (flash_area_open(bsp_imgr_current_slot(), &d->src)) {
+        d->src = NULL;
+        return -1;
+    }
+    mbedtls_sha256_init(&d->sha);
+    mbedtls_sha256_starts(&d->sha, 0);
+    d->state = IMGR_DELTA_S_HDR;
+    return 0;
+}
+
+/*
+ * Decode delta data. Data can be split into calls at any point.
+ */
+int
+imgr_delta_write(const uint8_t *data, uint16_t len)
+{
+    struct imgr_delta *d;
+    uint32_t cnt;
+    int rc;
+
+    d = &imgr_state.upload.delta;
+    while (len) {
+        switch (d->state) {
+        case IMGR_DELTA_S_HDR:
+            /*
+             * d->len counts header bytes received so far.
+             */
+            cnt = min(len, sizeof(d->hdr) - d->len);
+            memcpy((uint8_t *)&d->hdr + d->len, data, cnt);
+            d->len += cnt;
+            if (d->len == sizeof(d->hdr)) {
+                if (imgr_delta_hdr_check(d)) {
+                    return -1;
+                }
+                d->state = IMGR_DELTA_S_OP;
+            }
+            break;
+        case IMGR_DELTA_S_OP:
+            cnt = 1;
+            d->op = *data;
+            if (d->op > IMAGE_DELTA_OP_SEEK) {
+                return -1;
+            }
+            d->len = 0;
+            d->shift = 0;
+            d->state = IMGR_DELTA_S_LEN;
+            break;
+        case IMGR_DELTA_S_LEN:
+            cnt = 1;
+            if (d->shift > 28) {
+                return -1;
+            }
+            d->len |= (uint32_t)(*data & 0x7f) << d->shift;
+            d->shift += 7;
+            if (*data & 0x80) {
+                break;
+            }
+            d->state = IMGR_DELTA_S_OP;
+            switch (d->op) {
+            case IMAGE_DELTA_OP_COPY:
+                rc = imgr_delta_copy(d);
+                break;
+            case IMAGE_DELTA_OP_SEEK:
+                rc = imgr_delta_seek(d);
+                break;
+            default:
+                if (d->len) {
+                    d->state = IMGR_DELTA_S_DATA;
+                }
+                rc = 0;
+                break;
+            }
+            if (rc) {
+                return -1;
+            }
+            break;
+        case IMGR_DELTA_S_DATA:
+            cnt = min(len, d->len);
+            if (d->op == IMAGE_DELTA_OP_INSERT) {
+                rc = imgr_delta_out(d, data, cnt);
+            } else {
+                rc = imgr_delta_add(d, data, cnt);
+            }
+            if (rc) {
+                return -1;
+            }
+            d->len -= cnt;
+            if (d->len == 0) {
+                d->state = IMGR_DELTA_S_OP;
+            }
+            break;
+        default:
+            return -1;
+        }
+        data += cnt;
+        len -= cnt;
+    }
+    return 0;
+}
+
+/*
+ * All of delta has been received. Check that the resulting image is
+ * complete and hashes to what was expected.
+ */
+int
+imgr_delta_finish(void)
+{
+    struct imgr_delta *d;
+    uint8_t hash[IMGMGR_HASH_LEN];
+    int rc;
+
+    d = &imgr_state.upload.delta;
+    rc = -1;
+    if (d->state == IMGR_DELTA_S_OP && imgr_delta_flush(d) == 0 &&
+      d->out_off == d->hdr.idh_img_size) {
+        mbedtls_sha256_finish(&d->sha, hash);
+        if (!memcmp(hash, d->hdr.idh_img_hash, sizeof(hash))) {
+            rc = 0;
+        }
+    }
+    imgr_delta_abort();
+    return rc;
+}
+
+void
+imgr_delta_abort(void)
+{
+    struct imgr_delta *d;
+
+    d = &imgr_state.upload.delta;
+    if (d->src) {
+        flash_area_close(d->src);
+        d->src = NULL;
+        mbedtls_sha256_free(&d->sha);
+    }
+}
+
+#endif
@@ -27,11 +27,12 @@
 #define IMGMGR_HASH_STR		48
 
 /*
- * When accompanied by image, it's this structure followed by data.
- * Response contains just the offset.
+ * Raw upload request; this structure in network byte order followed by
+ * data. Response is the same as to a regular upload, with "win" added.
  */
 struct imgmgr_upload_cmd {
     uint32_t iuc_off;
+    uint32_t iuc_len;		/* image size, inspected when off = 0 */
 };
 
 /*
@@ -82,13 +83,47 @@ struct nmgr_hdr;
 struct os_mbuf;
 struct fs_file;
 
+#include <mbedtls/sha256.h>
+
+#ifdef DELTA_PRESENT
+#include <bootutil/image.h>
+
+#define IMGMGR_DELTA_BUF		64
+
+/*
+ * State of delta decoding. Delta data is decoded as it arrives, and the
+ * resulting image is written to the upload slot.
+ */
+struct imgr_delta {
+    const struct flash_area *src;	/* Image being patched */
+    uint32_t src_off;			/* Read position in src */
+    uint32_t out_off;			/* Write position in upload slot */
+    uint32_t len;			/* Bytes left in current record */
+    uint8_t state;
+    uint8_t op;
+    uint8_t shift;			/* Of LEB128 being parsed */
+    uint8_t out_cnt;			/* Bytes in out_buf */
+    mbedtls_sha256_context sha;
+    struct image_delta_hdr hdr;
+    uint8_t out_buf[IMGMGR_DELTA_BUF];
+};
+#endif
+
 struct imgr_state {
     struct {
         uint32_t off;
         uint32_t size;
+        uint32_t hash_end;		/* Hash covers data up to here */
+        uint8_t area_id;
+        uint8_t need_hash;		/* Image must have a hash TLV */
         const struct flash_area *fa;
+        mbedtls_sha256_context sha;
 #ifdef FS_PRESENT
         struct fs_file *file;
+#endif
+#ifdef DELTA_PRESENT
+        uint8_t is_delta;
+        struct imgr_delta delta;
 #endif
     } upload;
 };
@@ -105,6 +140,31 @@ int imgr_core_list(struct nmgr_jbuf *);
 int imgr_core_load(struct nmgr_jbuf *);
 int imgr_core_erase(struct nmgr_jbuf *);
 
+#ifdef RESUME_PRESENT
+/*
+ * Upload progress checkpoint, persisted so that upload can be resumed after
+ * a reset.
+ */
+struct imgr_upload_ckpt {
+    uint32_t off;
+    uint32_t size;
+    uint32_t hash_end;
+    uint8_t area_id;
+    uint8_t need_hash;
+    mbedtls_sha256_context sha;
+};
+
+void imgr_resume_init(void);
+void imgr_resume_save(void);
+void imgr_resume_clear(void);
+#endif
+
+int imgr_delta_start(void);
+int imgr_delta_write(const uint8_t *data, uint16_t len);
+int imgr_delta_finish(void);
+void imgr_delta_abort(void);
+
+void imgr_info_invalidate(int area_id);
 int imgr_find_by_ver(struct image_version *find, uint8_t *hash);
 int imgr_find_by_hash(uint8_t *find, struct image_version *ver);
 
@@ -0,0 +1,136 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef RESUME_PRESENT
+
+#include <string.h>
+
+#include <hal/hal_bsp.h>
+#include <hal/flash_map.h>
+#include <newtmgr/newtmgr.h>
+#include <config/config.h>
+
+#include "imgmgr/imgmgr.h"
+#include "imgmgr_priv.h"
+
+static int imgr_resume_set(int argc, char **argv, char *val);
+static int imgr_resume_commit(void);
+
+static struct conf_handler imgr_resume_conf = {
+    .ch_name = "imgr",
+    .ch_set = imgr_resume_set,
+    .ch_commit = imgr_resume_commit
+};
+
+/*
+ * Checkpoint read from config; valid if size is non-zero.
+ */
+static struct imgr_upload_ckpt imgr_ckpt;
+
+static int
+imgr_resume_set(int argc, char **argv, char *val)
+{
+    int len;
+
+    if (argc == 1 && !strcmp(argv[0], "upload")) {
+        memset(&imgr_ckpt, 0, sizeof(imgr_ckpt));
+        if (!val || !val[0]) {
+            return 0;
+        }
+        len = sizeof(imgr_ckpt);
+        if (conf_bytes_from_str(val, &imgr_ckpt, &len) ||
+          len != sizeof(imgr_ckpt)) {
+            memset(&imgr_ckpt, 0, sizeof(imgr_ckpt));
+        }
+        return 0;
+    }
+    return OS_ENOENT;
+}
+
+/*
+ * Continue the upload from the checkpoint, unless the slot it was going to
+ * has since become the active one.
+ */
+static int
+imgr_resume_commit(void)
+{
+    if (!imgr_ckpt.size || imgr_state.upload.fa) {
+        return 0;
+    }
+    if (imgr_ckpt.area_id == bsp_imgr_current_slot() ||
+      flash_area_open(imgr_ckpt.area_id, &imgr_state.upload.fa)) {
+        imgr_state.upload.fa = NULL;
+        imgr_resume_clear();
+        return 0;
+    }
+    imgr_state.upload.off = imgr_ckpt.off;
+    imgr_state.upload.size = imgr_ckpt.size;
+    imgr_state.upload.hash_end = imgr_ckpt.hash_end;
+    imgr_state.upload.area_id = imgr_ckpt.area_id;
+    imgr_state.upload.need_hash = imgr_ckpt.need_hash;
+    memcpy(&imgr_state.upload.sha, &imgr_ckpt.sha, sizeof(imgr_ckpt.sha));
+    imgr_ckpt.size = 0;
+    return 0;
+}
+
+void
+imgr_resume_init(void)
+{
+    conf_register(&imgr_resume_conf);
+}
+
+/*
+ * Persist upload progress. Data up to upload.off is already in flash.
+ */
+void
+imgr_resume_save(void)
+{
+    char buf[CONF_STR_FROM_BYTES_LEN(sizeof(imgr_ckpt)) + 1];
+    char *str;
+
+#ifdef DELTA_PRESENT
+    if (imgr_state.upload.is_delta) {
+        /*
+         * Delta decoder state is not saved; those uploads start over.
+         */
+        return;
+    }
+#endif
+    imgr_ckpt.off = imgr_state.upload.off;
+    imgr_ckpt.size = imgr_state.upload.size;
+    imgr_ckpt.hash_end = imgr_state.upload.hash_end;
+    imgr_ckpt.area_id = imgr_state.upload.area_id;
+    imgr_ckpt.need_hash = imgr_state.upload.need_hash;
+    memcpy(&imgr_ckpt.sha, &imgr_state.upload.sha, sizeof(imgr_ckpt.sha));
+
+    str = conf_str_from_bytes(&imgr_ckpt, sizeof(imgr_ckpt), buf, sizeof(buf));
+    imgr_ckpt.size = 0;
+    if (str) {
+        conf_save_one("imgr/upload", str);
+    }
+}
+
+void
+imgr_resume_clear(void)
+{
+    imgr_ckpt.size = 0;
+    conf_save_one("imgr/upload", "");
+}
+
+#endif
@@ -40,6 +40,9 @@ enum inet_def_type {
 #define INET_DEF_FROM_EVENT_TYPE(a) ((a) - OS_EVENT_T_PERUSER)
 #define INET_EVENT_TYPE_FROM_DEF(a) ((a) + OS_EVENT_T_PERUSER)
 
+/* Packets handled per mn_recvmmsg()/mn_sendmmsg() call */
+#define INET_DEF_BATCH       4
+
 #define CHARGEN_WRITE_SZ     512
 static const char chargen_pattern[] = "1234567890";
 #define CHARGEN_PATTERN_SZ   (sizeof(chargen_pattern) - 1)
@@ -219,12 +222,15 @@ inet_def_srv(void *arg)
     struct inet_def_tcp *idt;
     struct mn_socket *sock;
     struct os_event *ev;
-    struct mn_sockaddr_in msin;
+    struct mn_msg msgs[INET_DEF_BATCH];
     struct os_mbuf *m;
     enum inet_def_type type;
     int rc;
     int off;
     int loop_cnt;
+    int cnt;
+    int sent;
+    int i;
 
     inet_def_create_srv(INET_DEF_ECHO, ECHO_PORT);
     inet_def_create_srv(INET_DEF_DISCARD, DISCARD_PORT);
@@ -246,24 +252,34 @@ inet_def_srv(void *arg)
         }
         switch (type) {
         case INET_DEF_ECHO:
-            while (mn_recvfrom(sock, &m, (struct mn_sockaddr *)&msin) == 0) {
-                console_printf("echo %d bytes\n", OS_MBUF_PKTLEN(m));
-                rc = mn_sendto(sock, m, (struct mn_sockaddr *)&msin);
+            while (mn_recvmmsg(sock, msgs, INET_DEF_BATCH, &cnt) == 0) {
+                for (i = 0; i < cnt; i++) {
+                    console_printf("echo %d bytes\n",
+                      OS_MBUF_PKTLEN(msgs[i].mm_data));
+                }
+                rc = mn_sendmmsg(sock, msgs, cnt, &sent);
                 if (rc) {
                     console_printf("  failed: %d!!!!\n", rc);
-                    os_mbuf_free_chain(m);
+                    for (i = sent; i < cnt; i++) {
+                        os_mbuf_free_chain(msgs[i].mm_data);
+                    }
                 }
             }
             break;
         case INET_DEF_DISCARD:
-            while (mn_recvfrom(sock, &m, NULL) == 0) {
-                console_printf("discard %d bytes\n", OS_MBUF_PKTLEN(m));
-                os_mbuf_free_chain(m);
+            while (mn_recvmmsg(sock, msgs, INET_DEF_BATCH, &cnt) == 0) {
+                for (i = 0; i < cnt; i++) {
+                    m = msgs[i].mm_data;
+                    console_printf("discard %d bytes\n", OS_MBUF_PKTLEN(m));
+                    os_mbuf_free_chain(m);
+                }
             }
             break;
         case INET_DEF_CHARGEN:
-            while (mn_recvfrom(sock, &m, NULL) == 0) {
-                os_mbuf_free_chain(m);
+            while (mn_recvmmsg(sock, msgs, INET_DEF_BATCH, &cnt) == 0) {
+                for (i = 0; i < cnt; i++) {
+                    os_mbuf_free_chain(msgs[i].mm_data);
+                }
             }
             if ((int)ev->ev_arg == MN_SOCK_STREAM && idt->closed) {
                 /*
@@ -83,6 +83,7 @@ struct json_encoder {
     json_write_func_t je_write;
     void *je_arg;
     int je_wr_commas:1;
+    int je_cbor:1;              /* Encode as CBOR instead of text */
     char je_encode_buf[64];
 };
 
@@ -112,7 +113,8 @@ typedef enum {
     t_structobject,
     t_array,
     t_check,
-    t_ignore
+    t_ignore,
+    t_bytes                     /* CBOR byte string; not valid in text */
 } json_type;
 
 struct json_enum_t {
@@ -162,6 +164,10 @@ struct json_attr_t {
         char *character;
         struct json_array_t array;
         size_t offset;
+        struct {
+            uint8_t *data;
+            size_t *len;        /* Number of bytes decoded */
+        } bytes;
     } addr;
     union {
         long long int integer;
@@ -191,6 +197,7 @@ struct json_buffer {
     json_buffer_readn_t jb_readn;
     json_buffer_read_next_byte_t jb_read_next;
     json_buffer_read_prev_byte_t jb_read_prev;
+    uint8_t jb_cbor;            /* Input is CBOR instead of text */
 };
 
 #define JSON_ATTR_MAX        31        /* max chars in JSON attribute name */
@@ -199,6 +206,32 @@ struct json_buffer {
 int json_read_object(struct json_buffer *, const struct json_attr_t *);
 int json_read_array(struct json_buffer *, const struct json_array_t *);
 
+/*
+ * CBOR (RFC 7049) form of the same encoder and decoder, used when
+ * je_cbor/jb_cbor is set. Objects and arrays started with json_encode_*()
+ * are encoded with indefinite length.
+ */
+#define JSON_CBOR_UINT          (0)
+#define JSON_CBOR_NINT          (1)
+#define JSON_CBOR_BYTES         (2)
+#define JSON_CBOR_TEXT          (3)
+#define JSON_CBOR_ARRAY         (4)
+#define JSON_CBOR_MAP           (5)
+#define JSON_CBOR_TAG           (6)
+#define JSON_CBOR_SIMPLE        (7)
+
+#define JSON_CBOR_AI_INDEF      (31)
+#define JSON_CBOR_FALSE         (20)
+#define JSON_CBOR_TRUE          (21)
+#define JSON_CBOR_NULL          (22)
+
+int json_cbor_encode_head(struct json_encoder *, uint8_t major, uint64_t val);
+int json_cbor_encode_indef(struct json_encoder *, uint8_t major);
+int json_cbor_encode_break(struct json_encoder *);
+int json_cbor_encode_value(struct json_encoder *, struct json_value *);
+int json_cbor_read_object(struct json_buffer *, const struct json_attr_t *);
+int json_cbor_read_array(struct json_buffer *, const struct json_array_t *);
+
 #define JSON_ERR_OBSTART     1   /* non-WS when expecting object start */
 #define JSON_ERR_ATTRSTART   2   /* non-WS when expecting attrib start */
 #define JSON_ERR_BADATTR     3   /* unknown attribute name */
@@ -222,6 +255,7 @@ int json_read_array(struct json_buffer *, const struct json_array_t *);
 #define JSON_ERR_MISC        20  /* other data conversion error */
 #define JSON_ERR_BADNUM      21  /* error while parsing a numerical argument */
 #define JSON_ERR_NULLPTR     22  /* unexpected null value or attribute pointer */
+#define JSON_ERR_EOF         23  /* input ended inside a value */
 
 /*
  * Use the following macros to declare template initializers for structobject
@@ -0,0 +1,641 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+
+#include <json/json.h>
+
+/*
+ * CBOR encoding and decoding behind the json_encode_*() and
+ * json_read_object() interfaces. The decoder takes the same attribute
+ * templates as the text parser; it does not handle floats, indefinite
+ * length strings, or object arrays.
+ */
+
+#define JSON_CBOR_MAX_DEPTH     (8)
+
+struct json_cbor_head {
+    uint8_t ch_major;
+    uint8_t ch_ai;
+    uint64_t ch_val;
+};
+
+#define JSON_CBOR_IS_BREAK(__h)                                         \
+    ((__h)->ch_major == JSON_CBOR_SIMPLE && (__h)->ch_ai == JSON_CBOR_AI_INDEF)
+
+int
+json_cbor_encode_head(struct json_encoder *encoder, uint8_t major,
+        uint64_t val)
+{
+    uint8_t buf[9];
+    int len;
+    int i;
+
+    if (val < 24) {
+        buf[0] = (major << 5) | val;
+        len = 1;
+    } else {
+        if (val <= UINT8_MAX) {
+            buf[0] = 24;
+            len = 1;
+        } else if (val <= UINT16_MAX) {
+            buf[0] = 25;
+            len = 2;
+        } else if (val <= UINT32_MAX) {
+            buf[0] = 26;
+            len = 4;
+        } else {
+            buf[0] = 27;
+            len = 8;
+        }
+        buf[0] |= major << 5;
+        for (i = len; i > 0; i--) {
+            buf[i] = val;
+            val >>= 8;
+        }
+        len++;
+    }
+    encoder->je_write(encoder->je_arg, (char *)buf, len);
+
+    return (0);
+}
+
+int
+json_cbor_encode_indef(struct json_encoder *encoder, uint8_t major)
+{
+    char c;
+
+    c = (major << 5) | JSON_CBOR_AI_INDEF;
+    encoder->je_write(encoder->je_arg, &c, 1);
+
+    return (0);
+}
+
+int
+json_cbor_encode_break(struct json_encoder *encoder)
+{
+    return json_cbor_encode_indef(encoder, JSON_CBOR_SIMPLE);
+}
+
+int
+json_cbor_encode_value(struct json_encoder *encoder, struct json_value *jv)
+{
+    int64_t sval;
+    int rc;
+    int i;
+
+    switch (jv->jv_type) {
+    case JSON_VALUE_TYPE_BOOL:
+        json_cbor_encode_head(encoder, JSON_CBOR_SIMPLE,
+          jv->jv_val.u ? JSON_CBOR_TRUE : JSON_CBOR_FALSE);
+        break;
+    case JSON_VALUE_TYPE_UINT64:
+        json_cbor_encode_head(encoder, JSON_CBOR_UINT, jv->jv_val.u);
+        break;
+    case JSON_VALUE_TYPE_INT64:
+        sval = (int64_t)jv->jv_val.u;
+        if (sval < 0) {
+            json_cbor_encode_head(encoder, JSON_CBOR_NINT, -1 - sval);
+        } else {
+            json_cbor_encode_head(encoder, JSON_CBOR_UINT, sval);
+        }
+        break;
+    case JSON_VALUE_TYPE_STRING:
+        json_cbor_encode_head(encoder, JSON_CBOR_TEXT, jv->jv_len);
+        encoder->je_write(encoder->je_arg, jv->jv_val.str, jv->jv_len);
+        break;
+    case JSON_VALUE_TYPE_ARRAY:
+        json_cbor_encode_head(encoder, JSON_CBOR_ARRAY, jv->jv_len);
+        for (i = 0; i < jv->jv_len; i++) {
+            rc = json_cbor_encode_value(encoder,
+              jv->jv_val.composite.values[i]);
+            if (rc != 0) {
+                return (rc);
+            }
+        }
+        break;
+    case JSON_VALUE_TYPE_OBJECT:
+        json_cbor_encode_head(encoder, JSON_CBOR_MAP, jv->jv_len);
+        for (i = 0; i < jv->jv_len; i++) {
+            rc = json_encode_object_entry(encoder,
+              jv->jv_val.composite.keys[i], jv->jv_val.composite.values[i]);
+            if (rc != 0) {
+                return (rc);
+            }
+        }
+        break;
+    default:
+        return (-1);
+    }
+
+    return (0);
+}
+
+/*
+ * '\0' is a valid CBOR byte, so input is read through jb_readn(), which
+ * tells the end of the buffer apart from data.
+ */
+static int
+json_cbor_getc(struct json_buffer *jb, uint8_t *c)
+{
+    if (jb->jb_readn(jb, (char *)c, 1) != 1) {
+        return JSON_ERR_EOF;
+    }
+    return 0;
+}
+
+static int
+json_cbor_read_head(struct json_buffer *jb, struct json_cbor_head *head)
+{
+    uint8_t ib;
+    int rc;
+    int n;
+
+    rc = json_cbor_getc(jb, &ib);
+    if (rc) {
+        return rc;
+    }
+    head->ch_major = ib >> 5;
+    head->ch_ai = ib & 0x1f;
+
+    if (head->ch_ai < 24) {
+        head->ch_val = head->ch_ai;
+    } else if (head->ch_ai <= 27) {
+        head->ch_val = 0;
+        for (n = 1 << (head->ch_ai - 24); n > 0; n--) {
+            rc = json_cbor_getc(jb, &ib);
+            if (rc) {
+                return rc;
+            }
+            head->ch_val = (head->ch_val << 8) | ib;
+        }
+    } else if (head->ch_ai == JSON_CBOR_AI_INDEF &&
+      head->ch_major != JSON_CBOR_UINT && head->ch_major != JSON_CBOR_NINT &&
+      head->ch_major != JSON_CBOR_TAG) {
+        head->ch_val = 0;
+    } else {
+        return JSON_ERR_MISC;
+    }
+    return 0;
+}
+
+static int
+json_cbor_read_str(struct json_buffer *jb, struct json_cbor_head *head,
+        char *buf, size_t maxlen)
+{
+    if (head->ch_ai == JSON_CBOR_AI_INDEF) {
+        return JSON_ERR_BADSTRING;
+    }
+    if (head->ch_val > maxlen) {
+        return JSON_ERR_STRLONG;
+    }
+    if (jb->jb_readn(jb, buf, head->ch_val) != head->ch_val) {
+        return JSON_ERR_EOF;
+    }
+    return 0;
+}
+
+static int
+json_cbor_skip(struct json_buffer *jb, struct json_cbor_head *head, int depth)
+{
+    struct json_cbor_head sub;
+    uint64_t cnt;
+    uint64_t i;
+    uint8_t c;
+    int rc;
+
+    if (depth > JSON_CBOR_MAX_DEPTH) {
+        return JSON_ERR_MISC;
+    }
+
+    /*
+     * Lengths and element counts come straight from the input; bound them
+     * before looping. Tags carry a tag number, not a count.
+     */
+    if (head->ch_major >= JSON_CBOR_BYTES && head->ch_major <= JSON_CBOR_MAP &&
+      head->ch_val > JSON_VAL_MAX) {
+        return JSON_ERR_TOKLONG;
+    }
+
+    switch (head->ch_major) {
+    case JSON_CBOR_BYTES:
+    case JSON_CBOR_TEXT:
+        if (head->ch_ai == JSON_CBOR_AI_INDEF) {
+            return JSON_ERR_BADSTRING;
+        }
+        for (i = 0; i < head->ch_val; i++) {
+            rc = json_cbor_getc(jb, &c);
+            if (rc) {
+                return rc;
+            }
+        }
+        return 0;
+    case JSON_CBOR_ARRAY:
+    case JSON_CBOR_MAP:
+    case JSON_CBOR_TAG:
+        if (head->ch_major == JSON_CBOR_TAG) {
+            cnt = 1;
+        } else if (head->ch_major == JSON_CBOR_MAP) {
+            cnt = head->ch_val * 2;
+        } else {
+            cnt = head->ch_val;
+        }
+        if (head->ch_ai == JSON_CBOR_AI_INDEF) {
+            cnt = JSON_VAL_MAX;
+        }
+        for (i = 0; i < cnt; i++) {
+            rc = json_cbor_read_head(jb, &sub);
+            if (rc) {
+                return rc;
+            }
+            if (JSON_CBOR_IS_BREAK(&sub)) {
+                if (head->ch_ai != JSON_CBOR_AI_INDEF) {
+                    return JSON_ERR_MISC;
+                }
+                return 0;
+            }
+            rc = json_cbor_skip(jb, &sub, depth + 1);
+            if (rc) {
+                return rc;
+            }
+        }
+        if (head->ch_ai == JSON_CBOR_AI_INDEF) {
+            return JSON_ERR_SUBTOOLONG;
+        }
+        return 0;
+    default:
+        if (JSON_CBOR_IS_BREAK(head)) {
+            return JSON_ERR_MISC;
+        }
+        return 0;
+    }
+}
+
+/*
+ * Whether the attribute can take a value with this head.
+ */
+static int
+json_cbor_type_match(const struct json_attr_t *cursor,
+        struct json_cbor_head *head)
+{
+    switch (cursor->type) {
+    case t_integer:
+        return head->ch_major == JSON_CBOR_UINT ||
+          head->ch_major == JSON_CBOR_NINT ||
+          (head->ch_major == JSON_CBOR_TEXT && cursor->map);
+    case t_uinteger:
+        return head->ch_major == JSON_CBOR_UINT ||
+          (head->ch_major == JSON_CBOR_TEXT && cursor->map);
+    case t_boolean:
+        return head->ch_major == JSON_CBOR_SIMPLE &&
+          (head->ch_val == JSON_CBOR_TRUE || head->ch_val == JSON_CBOR_FALSE);
+    case t_string:
+    case t_character:
+    case t_check:
+        return head->ch_major == JSON_CBOR_TEXT;
+    case t_bytes:
+        return head->ch_major == JSON_CBOR_BYTES;
+    case t_array:
+        return head->ch_major == JSON_CBOR_ARRAY;
+    case t_ignore:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int
+json_cbor_read_int(struct json_cbor_head *head, long long int *val)
+{
+    if (head->ch_val > INT64_MAX) {
+        return JSON_ERR_BADNUM;
+    }
+    if (head->ch_major == JSON_CBOR_NINT) {
+        *val = -1 - (long long int)head->ch_val;
+    } else {
+        *val = head->ch_val;
+    }
+    return 0;
+}
+
+static int
+json_cbor_read_enum(struct json_buffer *jb, const struct json_attr_t *cursor,
+        struct json_cbor_head *head, long long int *val)
+{
+    char valbuf[JSON_VAL_MAX + 1];
+    const struct json_enum_t *mp;
+    int rc;
+
+    rc = json_cbor_read_str(jb, head, valbuf, JSON_VAL_MAX);
+    if (rc) {
+        return rc;
+    }
+    valbuf[head->ch_val] = '\0';
+    for (mp = cursor->map; mp->name != NULL; mp++) {
+        if (strcmp(mp->name, valbuf) == 0) {
+            *val = mp->value;
+            return 0;
+        }
+    }
+    return JSON_ERR_BADENUM;
+}
+
+static int
+json_cbor_read_elems(struct json_buffer *jb, const struct json_array_t *arr,
+        struct json_cbor_head *head)
+{
+    struct json_cbor_head elem;
+    long long int ival;
+    char *tp;
+    int indef;
+    int offset;
+    int left;
+    int rc;
+
+    indef = (head->ch_ai == JSON_CBOR_AI_INDEF);
+    tp = arr->arr.strings.store;
+
+    for (offset = 0; indef || offset < head->ch_val; offset++) {
+        rc = json_cbor_read_head(jb, &elem);
+        if (rc) {
+            return rc;
+        }
+        if (indef && JSON_CBOR_IS_BREAK(&elem)) {
+            break;
+        }
+        if (offset >= arr->maxlen) {
+            return JSON_ERR_SUBTOOLONG;
+        }
+        switch (arr->element_type) {
+        case t_string:
+            if (elem.ch_major != JSON_CBOR_TEXT) {
+                return JSON_ERR_BADSTRING;
+            }
+            left = arr->arr.strings.storelen - (tp - arr->arr.strings.store);
+            rc = json_cbor_read_str(jb, &elem, tp, left - 1);
+            if (rc) {
+                return JSON_ERR_BADSTRING;
+            }
+            arr->arr.strings.ptrs[offset] = tp;
+            tp += elem.ch_val;
+            *tp++ = '\0';
+            break;
+        case t_integer:
+            if (elem.ch_major != JSON_CBOR_UINT &&
+              elem.ch_major != JSON_CBOR_NINT) {
+                return JSON_ERR_BADNUM;
+            }
+            rc = json_cbor_read_int(&elem, &ival);
+            if (rc) {
+                return rc;
+            }
+            arr->arr.integers.store[offset] = ival;
+            break;
+        case t_uinteger:
+            if (elem.ch_major != JSON_CBOR_UINT) {
+                return JSON_ERR_BADNUM;
+            }
+            arr->arr.uintegers.store[offset] = elem.ch_val;
+            break;
+        case t_boolean:
+            if (elem.ch_major != JSON_CBOR_SIMPLE ||
+              (elem.ch_val != JSON_CBOR_TRUE &&
+               elem.ch_val != JSON_CBOR_FALSE)) {
+                return JSON_ERR_MISC;
+            }
+            arr->arr.booleans.store[offset] = (elem.ch_val == JSON_CBOR_TRUE);
+            break;
+        default:
+            return JSON_ERR_SUBTYPE;
+        }
+    }
+    if (arr->count != NULL) {
+        *(arr->count) = offset;
+    }
+    return 0;
+}
+
+int
+json_cbor_read_array(struct json_buffer *jb, const struct json_array_t *arr)
+{
+    struct json_cbor_head head;
+    int rc;
+
+    rc = json_cbor_read_head(jb, &head);
+    if (rc) {
+        return rc;
+    }
+    if (head.ch_major != JSON_CBOR_ARRAY) {
+        return JSON_ERR_ARRAYSTART;
+    }
+    return json_cbor_read_elems(jb, arr, &head);
+}
+
+static int
+json_cbor_read_value(struct json_buffer *jb, const struct json_attr_t *cursor,
+        struct json_cbor_head *head)
+{
+    char valbuf[JSON_VAL_MAX + 1];
+    long long int ival;
+    int rc;
+
+    switch (cursor->type) {
+    case t_integer:
+    case t_uinteger:
+        if (head->ch_major == JSON_CBOR_TEXT) {
+            rc = json_cbor_read_enum(jb, cursor, head, &ival);
+        } else if (cursor->type == t_integer) {
+            rc = json_cbor_read_int(head, &ival);
+        } else {
+            *cursor->addr.uinteger = head->ch_val;
+            return 0;
+        }
+        if (rc) {
+            return rc;
+        }
+        if (cursor->type == t_integer) {
+            *cursor->addr.integer = ival;
+        } else {
+            *cursor->addr.uinteger = ival;
+        }
+        return 0;
+    case t_boolean:
+        *cursor->addr.boolean = (head->ch_val == JSON_CBOR_TRUE);
+        return 0;
+    case t_string:
+        rc = json_cbor_read_str(jb, head, cursor->addr.string,
+          cursor->len - 1);
+        if (rc) {
+            return rc;
+        }
+        cursor->addr.string[head->ch_val] = '\0';
+        return 0;
+    case t_character:
+        if (head->ch_val > 1) {
+            return JSON_ERR_STRLONG;
+        }
+        return json_cbor_read_str(jb, head, cursor->addr.character, 1);
+    case t_check:
+        rc = json_cbor_read_str(jb, head, valbuf, JSON_VAL_MAX);
+        if (rc) {
+            return rc;
+        }
+        valbuf[head->ch_val] = '\0';
+        if (strcmp(cursor->dflt.check, valbuf) != 0) {
+            return JSON_ERR_CHECKFAIL;
+        }
+        return 0;
+    case t_bytes:
+        rc = json_cbor_read_str(jb, head, (char *)cursor->addr.bytes.data,
+          cursor->len);
+        if (rc) {
+            return rc;
+        }
+        *cursor->addr.bytes.len = head->ch_val;
+        return 0;
+    case t_array:
+        return json_cbor_read_elems(jb, &cursor->addr.array, head);
+    case t_ignore:
+        return json_cbor_skip(jb, head, 0);
+    default:
+        return JSON_ERR_MISC;
+    }
+}
+
+int
+json_cbor_read_object(struct json_buffer *jb, const struct json_attr_t *attrs)
+{
+    char attrbuf[JSON_ATTR_MAX + 1];
+    const struct json_attr_t *cursor;
+    const struct json_attr_t *match;
+    struct json_cbor_head head;
+    uint64_t cnt;
+    uint64_t i;
+    int indef;
+    int rc;
+
+    for (cursor = attrs; cursor->attribute != NULL; cursor++) {
+        if (cursor->nodefault) {
+            continue;
+        }
+        switch (cursor->type) {
+        case t_integer:
+            *cursor->addr.integer = cursor->dflt.integer;
+            break;
+        case t_uinteger:
+            *cursor->addr.uinteger = cursor->dflt.uinteger;
+            break;
+        case t_real:
+            *cursor->addr.real = cursor->dflt.real;
+            break;
+        case t_string:
+            cursor->addr.string[0] = '\0';
+            break;
+        case t_boolean:
+            *cursor->addr.boolean = cursor->dflt.boolean;
+            break;
+        case t_character:
+            *cursor->addr.character = cursor->dflt.character;
+            break;
+        case t_bytes:
+            *cursor->addr.bytes.len = 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    rc = json_cbor_read_head(jb, &head);
+    if (rc) {
+        return rc;
+    }
+    if (head.ch_major != JSON_CBOR_MAP) {
+        return JSON_ERR_OBSTART;
+    }
+    indef = (head.ch_ai == JSON_CBOR_AI_INDEF);
+    cnt = head.ch_val;
+
+    for (i = 0; indef || i < cnt; i++) {
+        rc = json_cbor_read_head(jb, &head);
+        if (rc) {
+            return rc;
+        }
+        if (indef && JSON_CBOR_IS_BREAK(&head)) {
+            break;
+        }
+        if (head.ch_major != JSON_CBOR_TEXT) {
+            return JSON_ERR_ATTRSTART;
+        }
+        if (head.ch_val > JSON_ATTR_MAX) {
+            return JSON_ERR_ATTRLEN;
+        }
+        rc = json_cbor_read_str(jb, &head, attrbuf, JSON_ATTR_MAX);
+        if (rc) {
+            return rc;
+        }
+        attrbuf[head.ch_val] = '\0';
+
+        for (cursor = attrs; cursor->attribute != NULL; cursor++) {
+            if (strcmp(cursor->attribute, attrbuf) == 0) {
+                break;
+            }
+        }
+        if (cursor->attribute == NULL) {
+            return JSON_ERR_BADATTR;
+        }
+
+        rc = json_cbor_read_head(jb, &head);
+        if (rc) {
+            return rc;
+        }
+        if (head.ch_major == JSON_CBOR_SIMPLE &&
+          head.ch_val == JSON_CBOR_NULL) {
+            continue;
+        }
+
+        /*
+         * Several specs may share a name with different types; pick the
+         * one that matches the encoded type.
+         */
+        for (match = cursor; match->attribute != NULL &&
+          strcmp(match->attribute, attrbuf) == 0; match++) {
+            if (json_cbor_type_match(match, &head)) {
+                break;
+            }
+        }
+        if (match->attribute == NULL || strcmp(match->attribute, attrbuf)) {
+            if (head.ch_major == JSON_CBOR_TEXT) {
+                return JSON_ERR_QNONSTRING;
+            }
+            if (head.ch_major == JSON_CBOR_ARRAY) {
+                return JSON_ERR_NOARRAY;
+            }
+            if (cursor->type == t_array) {
+                return JSON_ERR_NOBRAK;
+            }
+            return JSON_ERR_NONQSTRING;
+        }
+
+        rc = json_cbor_read_value(jb, match, &head);
+        if (rc) {
+            return rc;
+        }
+    }
+    return 0;
+}
@@ -103,6 +103,97 @@ json_peek(struct json_buffer *jb)
     return c;
 }
 
+/*
+ * Reads a number token up to the next delimiter, leaving the delimiter
+ * unread. Returns the length of the token.
+ */
+static int
+json_read_token(struct json_buffer *jb, char *buf, int size)
+{
+    char c;
+    int n;
+
+    for (n = 0; n < size - 1; n++) {
+        c = jb->jb_read_next(jb);
+        if (c == '\0') {
+            break;
+        }
+        if (c == ',' || c == ']' || c == '}' || isspace((unsigned char) c)) {
+            jb->jb_read_prev(jb);
+            break;
+        }
+        buf[n] = c;
+    }
+    buf[n] = '\0';
+
+    return n;
+}
+
+/*
+ * Plain decimal integers, which is what encoders send, are converted here.
+ * Anything else (hex, leading zeros, more than 18 digits) is left to
+ * strtoll()/strtoull(). Returns the end of the number, or NULL if it
+ * was not handled.
+ */
+static const char *
+json_fast_dec(const char *s, long long unsigned int *val, bool *neg)
+{
+    long long unsigned int v;
+    const char *p;
+
+    p = s;
+    *neg = (*p == '-');
+    if (*neg) {
+        p++;
+    }
+    if (!isdigit((unsigned char) p[0]) ||
+        (p[0] == '0' && (isalnum((unsigned char) p[1])))) {
+        return NULL;
+    }
+    for (v = 0, s = p; isdigit((unsigned char) *p); p++) {
+        if (p - s >= 18) {
+            return NULL;
+        }
+        v = v * 10 + (*p - '0');
+    }
+    *val = v;
+    return p;
+}
+
+static long long int
+json_strtoll(const char *s, char **end, int base)
+{
+    long long unsigned int v;
+    const char *ep;
+    bool neg;
+
+    ep = json_fast_dec(s, &v, &neg);
+    if (ep == NULL) {
+        return strtoll(s, end, base);
+    }
+    if (end) {
+        *end = (char *)ep;
+    }
+    return neg ? -(long long int)v : (long long int)v;
+}
+
+static long long unsigned int
+json_strtoull(const char *s, char **end, int base)
+{
+    long long unsigned int v;
+    const char *ep;
+    bool neg;
+
+    ep = json_fast_dec(s, &v, &neg);
+    if (ep == NULL || neg) {
+        return strtoull(s, end, base);
+    }
+    if (end) {
+        *end = (char *)ep;
+    }
+    return v;
+}
+
 static char *
 json_target_address(const struct json_attr_t *cursor,
         const struct json_array_t *parent, int offset)
@@ -207,6 +298,7 @@ json_internal_read_object(struct json_buffer *jb,
                 case t_array:
                 case t_check:
                 case t_ignore:
+                case t_bytes:
                     break;
                 }
             }
@@ -245,7 +337,8 @@ json_internal_read_object(struct json_buffer *jb,
             if (c == '"') {
                 *pattr++ = '\0';
                 for (cursor = attrs; cursor->attribute != NULL; cursor++) {
-                    if (strcmp(cursor->attribute, attrbuf) == 0) {
+                    if (cursor->attribute[0] == attrbuf[0] &&
+                        strcmp(cursor->attribute, attrbuf) == 0) {
                         break;
                     }
                 }
@@ -432,13 +525,13 @@ json_internal_read_object(struct json_buffer *jb,
                 switch (cursor->type) {
                 case t_integer: {
                         long long int tmp =
-                            (long long int)strtoll(valbuf, NULL, 10);
+                            json_strtoll(valbuf, NULL, 10);
                         memcpy(lptr, &tmp, sizeof(long long int));
                     }
                     break;
                 case t_uinteger: {
                         long long unsigned int tmp =
-                            (long long unsigned int)strtoull(valbuf, NULL, 10);
+                            json_strtoull(valbuf, NULL, 10);
                         memcpy(lptr, &tmp, sizeof(long long unsigned int));
                     }
                     break;
@@ -474,6 +567,7 @@ json_internal_read_object(struct json_buffer *jb,
                     }
                     break;
                 case t_ignore:        /* silences a compiler warning */
+                case t_bytes:
                 case t_object:        /* silences a compiler warning */
                 case t_structobject:
                 case t_array:
@@ -518,6 +612,9 @@ json_read_array(struct json_buffer *jb, const struct json_array_t *arr)
     char *tp;
     int n, count;
 
+    if (jb->jb_cbor) {
+        return json_cbor_read_array(jb, arr);
+    }
     json_skip_ws(jb);
 
     if (jb->jb_read_next(jb) != '[') {
@@ -570,31 +667,19 @@ json_read_array(struct json_buffer *jb, const struct json_array_t *arr)
             }
             break;
         case t_integer:
-            n = jb->jb_readn(jb, valbuf, sizeof(valbuf)-1);
-            valbuf[n] = '\0';
+            n = json_read_token(jb, valbuf, sizeof(valbuf));
 
-            arr->arr.integers.store[offset] = strtoll(valbuf, &ep, 0);
-            if (ep == valbuf) {
+            arr->arr.integers.store[offset] = json_strtoll(valbuf, &ep, 0);
+            if (n == 0 || ep != valbuf + n) {
                 return JSON_ERR_BADNUM;
-            } else {
-                count = n - (ep - valbuf);
-                while (count-- > 0) {
-                    jb->jb_read_prev(jb);
-                }
             }
             break;
         case t_uinteger:
-            n = jb->jb_readn(jb, valbuf, sizeof(valbuf)-1);
-            valbuf[n] = '\0';
+            n = json_read_token(jb, valbuf, sizeof(valbuf));
 
-            arr->arr.uintegers.store[offset] = strtoull(valbuf, &ep, 0);
-            if (ep == valbuf) {
+            arr->arr.uintegers.store[offset] = json_strtoull(valbuf, &ep, 0);
+            if (n == 0 || ep != valbuf + n) {
                 return JSON_ERR_BADNUM;
-            } else {
-                count = n - (ep - valbuf);
-                while (count-- > 0) {
-                    jb->jb_read_prev(jb);
-                }
             }
             break;
         case t_real:
@@ -638,6 +723,7 @@ json_read_array(struct json_buffer *jb, const struct json_array_t *arr)
         case t_array:
         case t_check:
         case t_ignore:
+        case t_bytes:
             return JSON_ERR_SUBTYPE;
         }
         arrcount++;
@@ -663,6 +749,9 @@ json_read_object(struct json_buffer *jb, const struct json_attr_t *attrs)
 {
     int st;
 
+    if (jb->jb_cbor) {
+        return json_cbor_read_object(jb, attrs);
+    }
     st = json_internal_read_object(jb, attrs, NULL, 0);
     return st;
 }
@@ -38,6 +38,9 @@
 int
 json_encode_object_start(struct json_encoder *encoder)
 {
+    if (encoder->je_cbor) {
+        return json_cbor_encode_indef(encoder, JSON_CBOR_MAP);
+    }
     if (encoder->je_wr_commas) {
         encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
         encoder->je_wr_commas = 0;
@@ -152,6 +155,14 @@ err:
 int
 json_encode_object_key(struct json_encoder *encoder, char *key)
 {
+    int len;
+
+    if (encoder->je_cbor) {
+        len = strlen(key);
+        json_cbor_encode_head(encoder, JSON_CBOR_TEXT, len);
+        encoder->je_write(encoder->je_arg, key, len);
+        return (0);
+    }
     if (encoder->je_wr_commas) {
         encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
         encoder->je_wr_commas = 0;
@@ -171,6 +182,10 @@ json_encode_object_entry(struct json_encoder *encoder, char *key,
 {
     int rc;
 
+    if (encoder->je_cbor) {
+        json_encode_object_key(encoder, key);
+        return json_cbor_encode_value(encoder, val);
+    }
     if (encoder->je_wr_commas) {
         encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
         encoder->je_wr_commas = 0;
@@ -194,6 +209,9 @@ err:
 int
 json_encode_object_finish(struct json_encoder *encoder)
 {
+    if (encoder->je_cbor) {
+        return json_cbor_encode_break(encoder);
+    }
     JSON_ENCODE_OBJECT_END(encoder);
     /* Useful in case of nested objects. */
     encoder->je_wr_commas = 1;
@@ -210,6 +228,9 @@ json_encode_array_name(struct json_encoder *encoder, char *name)
 int
 json_encode_array_start(struct json_encoder *encoder)
 {
+    if (encoder->je_cbor) {
+        return json_cbor_encode_indef(encoder, JSON_CBOR_ARRAY);
+    }
     JSON_ENCODE_ARRAY_START(encoder);
     encoder->je_wr_commas = 0;
 
@@ -221,6 +242,9 @@ json_encode_array_value(struct json_encoder *encoder, struct json_value *jv)
 {
     int rc;
 
+    if (encoder->je_cbor) {
+        return json_cbor_encode_value(encoder, jv);
+    }
     if (encoder->je_wr_commas) {
         encoder->je_write(encoder->je_arg, ",", sizeof(",")-1);
         encoder->je_wr_commas = 0;
@@ -241,6 +265,9 @@ err:
 int
 json_encode_array_finish(struct json_encoder *encoder)
 {
+    if (encoder->je_cbor) {
+        return json_cbor_encode_break(encoder);
+    }
     encoder->je_wr_commas = 1;
     JSON_ENCODE_ARRAY_END(encoder);
 
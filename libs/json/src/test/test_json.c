@@ -23,6 +23,10 @@
 TEST_SUITE(test_json_suite) {
     test_json_simple_encode();
     test_json_simple_decode();
+    test_json_simple_numbers();
+    test_json_cbor_encode();
+    test_json_cbor_decode();
+    test_json_cbor_decode_bad();
 }
 
 #ifdef MYNEWT_SELFTEST
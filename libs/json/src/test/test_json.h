@@ -22,6 +22,10 @@
 
 TEST_CASE_DECL(test_json_simple_encode);
 TEST_CASE_DECL(test_json_simple_decode);
+TEST_CASE_DECL(test_json_simple_numbers);
+TEST_CASE_DECL(test_json_cbor_encode);
+TEST_CASE_DECL(test_json_cbor_decode);
+TEST_CASE_DECL(test_json_cbor_decode_bad);
 
 #endif /* TEST_JSON_H */
 
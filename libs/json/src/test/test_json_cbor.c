@@ -0,0 +1,337 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+#include "testutil/testutil.h"
+#include "test_json.h"
+#include "json/json.h"
+
+/*
+ * {_ "b": true, "i": -1234, "u": 70000, "s": "foo", "a": [_ 1, -2] }
+ */
+static const uint8_t cbor_output[] = {
+    0xbf,
+    0x61, 'b', 0xf5,
+    0x61, 'i', 0x39, 0x04, 0xd1,
+    0x61, 'u', 0x1a, 0x00, 0x01, 0x11, 0x70,
+    0x61, 's', 0x63, 'f', 'o', 'o',
+    0x61, 'a', 0x9f, 0x01, 0x21, 0xff,
+    0xff
+};
+
+static uint8_t cbor_buf[128];
+static int cbor_len;
+static int cbor_off;
+
+static int
+test_cbor_write(void *arg, char *data, int len)
+{
+    memcpy(cbor_buf + cbor_len, data, len);
+    cbor_len += len;
+    return len;
+}
+
+static char
+test_cbor_read_next(struct json_buffer *jb)
+{
+    if (cbor_off >= cbor_len) {
+        return '\0';
+    }
+    return cbor_buf[cbor_off++];
+}
+
+static char
+test_cbor_read_prev(struct json_buffer *jb)
+{
+    if (cbor_off == 0) {
+        return '\0';
+    }
+    return cbor_buf[--cbor_off];
+}
+
+static int
+test_cbor_readn(struct json_buffer *jb, char *buf, int size)
+{
+    if (size > cbor_len - cbor_off) {
+        size = cbor_len - cbor_off;
+    }
+    memcpy(buf, cbor_buf + cbor_off, size);
+    cbor_off += size;
+    return size;
+}
+
+static void
+test_cbor_buf_init(struct json_buffer *jb, const void *data, int len)
+{
+    memset(jb, 0, sizeof(*jb));
+    jb->jb_read_next = test_cbor_read_next;
+    jb->jb_read_prev = test_cbor_read_prev;
+    jb->jb_readn = test_cbor_readn;
+    jb->jb_cbor = 1;
+    memcpy(cbor_buf, data, len);
+    cbor_len = len;
+    cbor_off = 0;
+}
+
+TEST_CASE(test_json_cbor_encode)
+{
+    struct json_encoder encoder;
+    struct json_value value;
+
+    cbor_len = 0;
+    memset(&encoder, 0, sizeof(encoder));
+    encoder.je_write = test_cbor_write;
+    encoder.je_cbor = 1;
+
+    json_encode_object_start(&encoder);
+    JSON_VALUE_BOOL(&value, 1);
+    json_encode_object_entry(&encoder, "b", &value);
+    JSON_VALUE_INT(&value, -1234);
+    json_encode_object_entry(&encoder, "i", &value);
+    JSON_VALUE_UINT(&value, 70000);
+    json_encode_object_entry(&encoder, "u", &value);
+    JSON_VALUE_STRING(&value, "foo");
+    json_encode_object_entry(&encoder, "s", &value);
+    json_encode_array_name(&encoder, "a");
+    json_encode_array_start(&encoder);
+    JSON_VALUE_INT(&value, 1);
+    json_encode_array_value(&encoder, &value);
+    JSON_VALUE_INT(&value, -2);
+    json_encode_array_value(&encoder, &value);
+    json_encode_array_finish(&encoder);
+    json_encode_object_finish(&encoder);
+
+    TEST_ASSERT(cbor_len == sizeof(cbor_output));
+    TEST_ASSERT(!memcmp(cbor_buf, cbor_output, sizeof(cbor_output)));
+}
+
+TEST_CASE(test_json_cbor_decode)
+{
+    /*
+     * { "x": {"y": [1]}, "d": h'000102', "u": 255, "s": "hello" } with
+     * "x" ignored.
+     */
+    static const uint8_t input[] = {
+        0xa4,
+        0x61, 'x', 0xa1, 0x61, 'y', 0x81, 0x01,
+        0x61, 'd', 0x43, 0x00, 0x01, 0x02,
+        0x61, 'u', 0x18, 0xff,
+        0x61, 's', 0x65, 'h', 'e', 'l', 'l', 'o'
+    };
+    static const uint8_t truncated[] = {
+        0xbf, 0x61, 'x', 0x9f, 0x01
+    };
+    struct json_buffer jb;
+    long long unsigned int uint_val;
+    long long int int_val;
+    bool bool_val;
+    long long int intarr[4];
+    int arr_cnt;
+    uint8_t data[4];
+    size_t data_len;
+    char str[8];
+    int rc;
+    struct json_attr_t attrs[] = {
+        [0] = {
+            .attribute = "x",
+            .type = t_ignore,
+        },
+        [1] = {
+            .attribute = "d",
+            .type = t_bytes,
+            .addr.bytes.data = data,
+            .addr.bytes.len = &data_len,
+            .len = sizeof(data)
+        },
+        [2] = {
+            .attribute = "u",
+            .type = t_uinteger,
+            .addr.uinteger = &uint_val,
+            .nodefault = true
+        },
+        [3] = {
+            .attribute = "s",
+            .type = t_string,
+            .addr.string = str,
+            .len = sizeof(str)
+        },
+        [4] = {
+            .attribute = NULL
+        }
+    };
+    struct json_attr_t enc_attrs[] = {
+        [0] = {
+            .attribute = "b",
+            .type = t_boolean,
+            .addr.boolean = &bool_val,
+        },
+        [1] = {
+            .attribute = "i",
+            .type = t_integer,
+            .addr.integer = &int_val,
+        },
+        [2] = {
+            .attribute = "u",
+            .type = t_uinteger,
+            .addr.uinteger = &uint_val,
+        },
+        [3] = {
+            .attribute = "s",
+            .type = t_string,
+            .addr.string = str,
+            .len = sizeof(str)
+        },
+        [4] = {
+            .attribute = "a",
+            .type = t_array,
+            .addr.array = {
+                .element_type = t_integer,
+                .arr.integers.store = intarr,
+                .maxlen = sizeof(intarr) / sizeof(intarr[0]),
+                .count = &arr_cnt,
+            },
+        },
+        [5] = {
+            .attribute = NULL
+        }
+    };
+
+    test_cbor_buf_init(&jb, input, sizeof(input));
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(data_len == 3);
+    TEST_ASSERT(data[0] == 0 && data[1] == 1 && data[2] == 2);
+    TEST_ASSERT(uint_val == 255);
+    TEST_ASSERT(!strcmp(str, "hello"));
+
+    /*
+     * Byte string longer than the template allows.
+     */
+    attrs[1].len = 2;
+    test_cbor_buf_init(&jb, input, sizeof(input));
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc == JSON_ERR_STRLONG);
+    attrs[1].len = sizeof(data);
+
+    /*
+     * Running off the end inside an ignored value fails instead of looping.
+     */
+    test_cbor_buf_init(&jb, truncated, sizeof(truncated));
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc != 0);
+
+    /*
+     * Decode what the encoder produced.
+     */
+    test_cbor_buf_init(&jb, cbor_output, sizeof(cbor_output));
+    rc = json_read_object(&jb, enc_attrs);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(bool_val == true);
+    TEST_ASSERT(int_val == -1234);
+    TEST_ASSERT(uint_val == 70000);
+    TEST_ASSERT(!strcmp(str, "foo"));
+    TEST_ASSERT(arr_cnt == 2);
+    TEST_ASSERT(intarr[0] == 1 && intarr[1] == -2);
+
+    /*
+     * Wrong type for an attribute.
+     */
+    test_cbor_buf_init(&jb, cbor_output, sizeof(cbor_output));
+    enc_attrs[0].type = t_integer;
+    enc_attrs[0].addr.integer = &int_val;
+    rc = json_read_object(&jb, enc_attrs);
+    TEST_ASSERT(rc != 0);
+}
+
+TEST_CASE(test_json_cbor_decode_bad)
+{
+    /*
+     * Ignored "x" is an array of 0x61644300 elements, with the input
+     * ending after a handful of them.
+     */
+    static const uint8_t truncated[] = {
+        0xa4,
+        0x61, 'x', 0xa1, 0x61, 'y', 0x81, 0x9a, 0x61, 0x64, 0x43, 0x00,
+        0x01, 0x02, 0x61, 'u', 0x18, 0xff, 0x61, 's', 0x65, 'h', 'e',
+        'l', 'o'
+    };
+    /*
+     * { "x": [ 2^64 - 1 elements ] }
+     */
+    static const uint8_t oversized[] = {
+        0xa1, 0x61, 'x', 0x9b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    /*
+     * { "x": h'<long>', "u": 0 }, with the string running past the end.
+     */
+    static const uint8_t short_bytes[] = {
+        0xa2, 0x61, 'x', 0x58, 0x10, 0x00, 0x00
+    };
+    /*
+     * { "x": h'0000', "u": 0 }; zero bytes are data, not end of input.
+     */
+    static const uint8_t zeros[] = {
+        0xa2, 0x61, 'x', 0x42, 0x00, 0x00, 0x61, 'u', 0x00
+    };
+    struct json_buffer jb;
+    long long unsigned int uint_val;
+    int rc;
+    struct json_attr_t attrs[] = {
+        [0] = {
+            .attribute = "x",
+            .type = t_ignore,
+        },
+        [1] = {
+            .attribute = "u",
+            .type = t_uinteger,
+            .addr.uinteger = &uint_val,
+            .dflt.uinteger = 1
+        },
+        [2] = {
+            .attribute = NULL
+        }
+    };
+
+    test_cbor_buf_init(&jb, truncated, sizeof(truncated));
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc == JSON_ERR_TOKLONG);
+
+    test_cbor_buf_init(&jb, oversized, sizeof(oversized));
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc == JSON_ERR_TOKLONG);
+
+    test_cbor_buf_init(&jb, short_bytes, sizeof(short_bytes));
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc == JSON_ERR_EOF);
+
+    /*
+     * Cut off inside a head.
+     */
+    test_cbor_buf_init(&jb, oversized, sizeof(oversized) - 1);
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc == JSON_ERR_EOF);
+
+    test_cbor_buf_init(&jb, zeros, sizeof(zeros));
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(uint_val == 0);
+
+    test_cbor_buf_init(&jb, zeros, sizeof(zeros) - 1);
+    rc = json_read_object(&jb, attrs);
+    TEST_ASSERT(rc == JSON_ERR_EOF);
+}
@@ -168,6 +168,7 @@ test_buf_init(struct test_jbuf *ptjb, char *string) {
     ptjb->json_buf.jb_read_next = test_jbuf_read_next;
     ptjb->json_buf.jb_read_prev = test_jbuf_read_prev;
     ptjb->json_buf.jb_readn = test_jbuf_readn;
+    ptjb->json_buf.jb_cbor = 0;
     ptjb->start_buf = string;
     ptjb->end_buf = string + strlen(string);
     /* end buf points to the NULL */
@@ -358,3 +359,59 @@ TEST_CASE(test_json_simple_decode){
     TEST_ASSERT(rcbsa == 6); 
     
 }
+
+static char *outputnums = "{\"KeyInt\": -9223372036854775807, \"KeyUint\": 18446744073709551615, \"KeyIntArr\": [0x1f, -0, 123456789012345678, -1234567890123456789] }";
+static char *outputbadnum = "{\"KeyIntArr\": [12a]}";
+
+TEST_CASE(test_json_simple_numbers)
+{
+    struct test_jbuf tjb;
+    long long unsigned int uint_val;
+    long long int int_val;
+    long long int intarr[4];
+    int array_count;
+    int rc;
+    struct json_attr_t test_attr[4] = {
+        [0] = {
+            .attribute = "KeyInt",
+            .type = t_integer,
+            .addr.integer = &int_val,
+            .nodefault = true
+        },
+        [1] = {
+            .attribute = "KeyUint",
+            .type = t_uinteger,
+            .addr.uinteger = &uint_val,
+            .nodefault = true
+        },
+        [2] = {
+            .attribute = "KeyIntArr",
+            .type = t_array,
+            .addr.array = {
+                .element_type = t_integer,
+                .arr.integers.store = intarr,
+                .maxlen = sizeof intarr / sizeof intarr[0],
+                .count = &array_count,
+            },
+            .nodefault = true,
+        },
+        [3] = {
+            .attribute = NULL
+        }
+    };
+
+    test_buf_init(&tjb, outputnums);
+    rc = json_read_object(&tjb.json_buf, test_attr);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(int_val == -9223372036854775807LL);
+    TEST_ASSERT(uint_val == 18446744073709551615ULL);
+    TEST_ASSERT(array_count == 4);
+    TEST_ASSERT(intarr[0] == 0x1f);
+    TEST_ASSERT(intarr[1] == 0);
+    TEST_ASSERT(intarr[2] == 123456789012345678LL);
+    TEST_ASSERT(intarr[3] == -1234567890123456789LL);
+
+    test_buf_init(&tjb, outputbadnum);
+    rc = json_read_object(&tjb.json_buf, test_attr);
+    TEST_ASSERT(rc == JSON_ERR_BADNUM);
+}
@@ -42,6 +42,14 @@
 
 #define MBEDTLS_SHA256_SMALLER		/* comes with performance hit */
 
+/*
+ * MBEDTLS_HAL_CRYPTO (HAL_CRYPTO feature): AES-128 block encryption and
+ * entropy from the MCU's crypto accelerator, via hal/hal_crypto.h.
+ */
+#ifdef MBEDTLS_HAL_CRYPTO
+#define MBEDTLS_ENTROPY_HARDWARE_ALT
+#endif
+
 /**
  * \name SECTION: Module configuration options
  *
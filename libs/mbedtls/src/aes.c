@@ -42,6 +42,9 @@
 #if defined(MBEDTLS_AESNI_C)
 #include "mbedtls/aesni.h"
 #endif
+#if defined(MBEDTLS_HAL_CRYPTO)
+#include "hal/hal_crypto.h"
+#endif
 
 #if defined(MBEDTLS_SELF_TEST)
 #if defined(MBEDTLS_PLATFORM_C)
@@ -716,6 +719,25 @@ void mbedtls_aes_encrypt( mbedtls_aes_context *ctx,
 {
     int i;
     uint32_t *RK, X0, X1, X2, X3, Y0, Y1, Y2, Y3;
+#if defined(MBEDTLS_HAL_CRYPTO)
+    unsigned char key[16];
+
+    /*
+     * Offload AES-128 to the crypto accelerator; the first round key is
+     * the cipher key itself. Fall through to software if the hardware
+     * cannot take it.
+     */
+    if( ctx->nr == 10 )
+    {
+        RK = ctx->rk;
+        for( i = 0; i < 4; i++ )
+            PUT_UINT32_LE( RK[i], key, i << 2 );
+        i = hal_crypto_aes128_enc( key, input, output );
+        mbedtls_zeroize( key, sizeof( key ) );
+        if( i == 0 )
+            return;
+    }
+#endif
 
     RK = ctx->rk;
 
@@ -37,6 +37,9 @@
 #if defined(MBEDTLS_HAVEGE_C)
 #include "mbedtls/havege.h"
 #endif
+#if defined(MBEDTLS_HAL_CRYPTO)
+#include "hal/hal_crypto.h"
+#endif
 
 #if !defined(MBEDTLS_NO_PLATFORM_ENTROPY)
 #if defined(_WIN32) && !defined(EFIX64) && !defined(EFI32)
@@ -213,4 +216,19 @@ int mbedtls_havege_poll( void *data,
 }
 #endif /* MBEDTLS_HAVEGE_C */
 
+#if defined(MBEDTLS_ENTROPY_HARDWARE_ALT) && defined(MBEDTLS_HAL_CRYPTO)
+int mbedtls_hardware_poll( void *data,
+                           unsigned char *output, size_t len, size_t *olen )
+{
+    ((void) data);
+    *olen = 0;
+
+    if( hal_crypto_rng( output, (int) len ) != 0 )
+        return( 0 );
+
+    *olen = len;
+    return( 0 );
+}
+#endif /* MBEDTLS_ENTROPY_HARDWARE_ALT && MBEDTLS_HAL_CRYPTO */
+
 #endif /* MBEDTLS_ENTROPY_C */
@@ -41,6 +41,7 @@
 #define NMGR_GROUP_ID_CONFIG    (3)
 #define NMGR_GROUP_ID_LOGS      (4)
 #define NMGR_GROUP_ID_CRASH     (5)
+#define NMGR_GROUP_ID_BOOTINIT  (6)
 #define NMGR_GROUP_ID_PERUSER   (64)
 
 #define NMGR_OP_READ            (0)
@@ -48,6 +49,12 @@
 #define NMGR_OP_WRITE           (2)
 #define NMGR_OP_WRITE_RSP       (3)
 
+/*
+ * Header flags. A request with NMGR_F_CBOR set carries a CBOR payload and
+ * gets a CBOR response with the flag set; otherwise both are JSON.
+ */
+#define NMGR_F_CBOR             (0x01)
+
 
 /**
  * Newtmgr JSON error codes
@@ -70,6 +77,7 @@
 #define NMGR_ID_MPSTATS         3
 #define NMGR_ID_DATETIME_STR    4
 #define NMGR_ID_RESET           5
+#define NMGR_ID_TRACE           6
 
 struct nmgr_hdr {
     uint8_t  nh_op;             /* NMGR_OP_XXX */
@@ -80,6 +88,14 @@ struct nmgr_hdr {
     uint8_t  nh_id;             /* message ID within group */
 };
 
+/*
+ * Encoder output is gathered in njb_wbuf and appended to the response
+ * mbuf when it fills up, and once more after the handler returns.
+ */
+#ifndef NMGR_JBUF_WBUF_LEN
+#define NMGR_JBUF_WBUF_LEN      (128)
+#endif
+
 struct nmgr_jbuf {
     /* json_buffer must be first element in the structure */
     struct json_buffer njb_buf;
@@ -89,6 +105,8 @@ struct nmgr_jbuf {
     struct nmgr_hdr *njb_hdr;
     uint16_t njb_off;
     uint16_t njb_end;
+    uint16_t njb_wlen;
+    uint8_t njb_wbuf[NMGR_JBUF_WBUF_LEN];
 };
 int nmgr_jbuf_init(struct nmgr_jbuf *njb);
 int nmgr_jbuf_setoerr(struct nmgr_jbuf *njb, int errcode);
@@ -109,9 +127,18 @@ struct nmgr_group {
     struct nmgr_handler *ng_handlers;
     uint16_t ng_handlers_count;
     uint16_t ng_group_id;
+    uint8_t ng_flags;           /* NMGR_GROUP_F_XXX */
     STAILQ_ENTRY(nmgr_group) ng_next;
 };
 
+/*
+ * Handlers of the group may take long; run them in the worker task, if one
+ * was started with nmgr_worker_init(). Their responses are sent separately,
+ * so they can arrive after those of later requests; match them by nh_seq.
+ * Such handlers must use the nmgr_jbuf passed to them, not nmgr_task_jbuf.
+ */
+#define NMGR_GROUP_F_WORKER     (0x01)
+
 #define NMGR_GROUP_SET_HANDLERS(__group, __handlers)       \
     (__group)->ng_handlers = (__handlers);                 \
     (__group)->ng_handlers_count = (sizeof((__handlers)) / \
@@ -121,13 +148,19 @@ struct nmgr_transport;
 typedef int (*nmgr_transport_out_func_t)(struct nmgr_transport *nt, 
         struct os_mbuf *m);
 
+/*
+ * nt_output gets called from the worker task as well as from the newtmgr
+ * task when the worker is in use.
+ */
 struct nmgr_transport {
     struct os_mqueue nt_imq;
+    struct os_mqueue nt_wq;     /* Requests for the worker */
     nmgr_transport_out_func_t nt_output; 
 };
 
 
 int nmgr_task_init(uint8_t, os_stack_t *, uint16_t);
+int nmgr_worker_init(uint8_t, os_stack_t *, uint16_t);
 int nmgr_transport_init(struct nmgr_transport *nt,
         nmgr_transport_out_func_t output_func);
 int nmgr_rx_req(struct nmgr_transport *nt, struct os_mbuf *req);
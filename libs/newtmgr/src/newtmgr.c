@@ -36,6 +36,10 @@ struct os_mutex g_nmgr_group_list_lock;
 struct os_eventq g_nmgr_evq;
 struct os_task g_nmgr_task;
 
+static struct os_eventq g_nmgr_worker_evq;
+static struct os_task g_nmgr_worker_task;
+static uint8_t g_nmgr_worker_on;
+
 STAILQ_HEAD(, nmgr_group) g_nmgr_group_list =
     STAILQ_HEAD_INITIALIZER(g_nmgr_group_list);
 
@@ -53,11 +57,13 @@ static const struct nmgr_handler nmgr_def_group_handlers[] = {
     [NMGR_ID_MPSTATS] = {nmgr_def_mpstat_read, NULL},
     [NMGR_ID_DATETIME_STR] = {nmgr_datetime_get, nmgr_datetime_set},
     [NMGR_ID_RESET] = {NULL, nmgr_reset},
+    [NMGR_ID_TRACE] = {nmgr_trace_read, nmgr_trace_write},
 };
 
 /* JSON buffer for NMGR task
  */
 struct nmgr_jbuf nmgr_task_jbuf;
+static struct nmgr_jbuf nmgr_worker_jbuf;
 
 static int
 nmgr_def_echo(struct nmgr_jbuf *njb)
@@ -208,7 +214,7 @@ err:
 }
 
 static struct nmgr_handler *
-nmgr_find_handler(uint16_t group_id, uint16_t handler_id)
+nmgr_find_handler(uint16_t group_id, uint16_t handler_id, uint8_t *flags)
 {
     struct nmgr_group *group;
     struct nmgr_handler *handler;
@@ -223,12 +229,39 @@ nmgr_find_handler(uint16_t group_id, uint16_t handler_id)
     }
 
     handler = &group->ng_handlers[handler_id];
+    *flags = group->ng_flags;
 
     return (handler);
 err:
     return (NULL);
 }
 
+/*
+ * Copies one request out of req and queues it for the worker task.
+ */
+static int
+nmgr_worker_put(struct nmgr_transport *nt, struct os_mbuf *req, uint32_t off,
+        uint16_t len)
+{
+    struct os_mbuf *m;
+    int rc;
+
+    m = os_msys_get_pkthdr(len, OS_MBUF_USRHDR_LEN(req));
+    if (!m) {
+        return (OS_ENOMEM);
+    }
+    memcpy(OS_MBUF_USRHDR(m), OS_MBUF_USRHDR(req), OS_MBUF_USRHDR_LEN(req));
+
+    rc = os_mbuf_appendfrom(m, req, off, len);
+    if (rc == 0) {
+        rc = os_mqueue_put(&nt->nt_wq, &g_nmgr_worker_evq, m);
+    }
+    if (rc != 0) {
+        os_mbuf_free_chain(m);
+    }
+    return (rc);
+}
+
 int
 nmgr_rsp_extend(struct nmgr_hdr *hdr, struct os_mbuf *rsp, void *data,
         uint16_t len)
@@ -307,12 +340,28 @@ nmgr_jbuf_readn(struct json_buffer *jb, char *buf, int size)
     if (rc != 0) {
         goto err;
     }
+    njb->njb_off += read;
 
     return (read);
 err:
     return (rc);
 }
 
+static int
+nmgr_jbuf_flush(struct nmgr_jbuf *njb)
+{
+    int rc;
+
+    if (njb->njb_wlen == 0) {
+        return (0);
+    }
+    rc = nmgr_rsp_extend(njb->njb_hdr, njb->njb_out_m, njb->njb_wbuf,
+      njb->njb_wlen);
+    njb->njb_wlen = 0;
+
+    return (rc);
+}
+
 int
 nmgr_jbuf_write(void *arg, char *data, int len)
 {
@@ -321,10 +370,22 @@ nmgr_jbuf_write(void *arg, char *data, int len)
 
     njb = (struct nmgr_jbuf *) arg;
 
-    rc = nmgr_rsp_extend(njb->njb_hdr, njb->njb_out_m, data, len);
-    if (rc != 0) {
-        assert(0);
-        goto err;
+    if (njb->njb_wlen + len > sizeof(njb->njb_wbuf)) {
+        rc = nmgr_jbuf_flush(njb);
+        if (rc != 0) {
+            assert(0);
+            goto err;
+        }
+    }
+    if (len >= sizeof(njb->njb_wbuf)) {
+        rc = nmgr_rsp_extend(njb->njb_hdr, njb->njb_out_m, data, len);
+        if (rc != 0) {
+            assert(0);
+            goto err;
+        }
+    } else {
+        memcpy(njb->njb_wbuf + njb->njb_wlen, data, len);
+        njb->njb_wlen += len;
     }
 
     return (0);
@@ -348,12 +409,14 @@ nmgr_jbuf_init(struct nmgr_jbuf *njb)
 
 static int
 nmgr_jbuf_setibuf(struct nmgr_jbuf *njb, struct os_mbuf *m,
-        uint16_t off, uint16_t len)
+        uint16_t off, uint16_t len, uint8_t flags)
 {
     njb->njb_off = off;
     njb->njb_end = off + len;
     njb->njb_in_m = m;
     njb->njb_enc.je_wr_commas = 0;
+    njb->njb_enc.je_cbor = (flags & NMGR_F_CBOR) != 0;
+    njb->njb_buf.jb_cbor = (flags & NMGR_F_CBOR) != 0;
 
     return (0);
 }
@@ -364,6 +427,7 @@ nmgr_jbuf_setobuf(struct nmgr_jbuf *njb, struct nmgr_hdr *hdr,
 {
     njb->njb_out_m = m;
     njb->njb_hdr = hdr;
+    njb->njb_wlen = 0;
 
     return (0);
 }
@@ -381,13 +445,19 @@ nmgr_jbuf_setoerr(struct nmgr_jbuf *njb, int errcode)
     return (0);
 }
 
+/*
+ * Handles the requests in req, and sends the responses. When called from
+ * the newtmgr task, requests for worker groups are passed on to the worker.
+ */
 static int
-nmgr_handle_req(struct nmgr_transport *nt, struct os_mbuf *req)
+nmgr_handle_req(struct nmgr_transport *nt, struct os_mbuf *req,
+        struct nmgr_jbuf *njb, int in_worker)
 {
     struct os_mbuf *rsp;
     struct nmgr_handler *handler;
     struct nmgr_hdr *rsp_hdr;
     struct nmgr_hdr hdr;
+    uint8_t flags;
     uint32_t off;
     uint32_t len;
     int rc;
@@ -414,12 +484,23 @@ nmgr_handle_req(struct nmgr_transport *nt, struct os_mbuf *req)
         hdr.nh_len = ntohs(hdr.nh_len);
         hdr.nh_group = ntohs(hdr.nh_group);
 
-        handler = nmgr_find_handler(hdr.nh_group, hdr.nh_id);
+        handler = nmgr_find_handler(hdr.nh_group, hdr.nh_id, &flags);
         if (!handler) {
             rc = OS_EINVAL;
             goto err;
         }
 
+        if (!in_worker && g_nmgr_worker_on && (flags & NMGR_GROUP_F_WORKER)) {
+            /*
+             * If the worker can't take it, handle it here.
+             */
+            rc = nmgr_worker_put(nt, req, off, sizeof(hdr) + hdr.nh_len);
+            if (rc == 0) {
+                off += sizeof(hdr) + OS_ALIGN(hdr.nh_len, 4);
+                continue;
+            }
+        }
+
         /* Build response header apriori.  Then pass to the handlers
          * to fill out the response data, and adjust length & flags.
          */
@@ -430,7 +511,7 @@ nmgr_handle_req(struct nmgr_transport *nt, struct os_mbuf *req)
             goto err;
         }
         rsp_hdr->nh_len = 0;
-        rsp_hdr->nh_flags = 0;
+        rsp_hdr->nh_flags = hdr.nh_flags & NMGR_F_CBOR;
         rsp_hdr->nh_op = (hdr.nh_op == NMGR_OP_READ) ? NMGR_OP_READ_RSP :
             NMGR_OP_WRITE_RSP;
         rsp_hdr->nh_group = hdr.nh_group;
@@ -438,27 +519,27 @@ nmgr_handle_req(struct nmgr_transport *nt, struct os_mbuf *req)
         rsp_hdr->nh_id = hdr.nh_id;
 
         /*
-         * Setup state for JSON encoding.
+         * Setup state for JSON or CBOR encoding.
          */
-        rc = nmgr_jbuf_setibuf(&nmgr_task_jbuf, req, off + sizeof(hdr),
-          hdr.nh_len);
+        rc = nmgr_jbuf_setibuf(njb, req, off + sizeof(hdr),
+          hdr.nh_len, hdr.nh_flags);
         if (rc) {
             goto err;
         }
-        rc = nmgr_jbuf_setobuf(&nmgr_task_jbuf, rsp_hdr, rsp);
+        rc = nmgr_jbuf_setobuf(njb, rsp_hdr, rsp);
         if (rc) {
             goto err;
         }
 
         if (hdr.nh_op == NMGR_OP_READ) {
             if (handler->nh_read) {
-                rc = handler->nh_read(&nmgr_task_jbuf);
+                rc = handler->nh_read(njb);
             } else {
                 rc = OS_EINVAL;
             }
         } else if (hdr.nh_op == NMGR_OP_WRITE) {
             if (handler->nh_write) {
-                rc = handler->nh_write(&nmgr_task_jbuf);
+                rc = handler->nh_write(njb);
             } else {
                 rc = OS_EINVAL;
             }
@@ -466,6 +547,10 @@ nmgr_handle_req(struct nmgr_transport *nt, struct os_mbuf *req)
             rc = OS_EINVAL;
         }
 
+        if (rc != 0) {
+            goto err;
+        }
+        rc = nmgr_jbuf_flush(njb);
         if (rc != 0) {
             goto err;
         }
@@ -476,6 +561,11 @@ nmgr_handle_req(struct nmgr_transport *nt, struct os_mbuf *req)
         off += sizeof(hdr) + OS_ALIGN(hdr.nh_len, 4);
     }
 
+    if (OS_MBUF_PKTLEN(rsp) == 0) {
+        /* Everything went to the worker. */
+        os_mbuf_free_chain(rsp);
+        return (0);
+    }
     nt->nt_output(nt, rsp);
 
     return (0);
@@ -496,11 +586,31 @@ nmgr_process(struct nmgr_transport *nt)
             break;
         }
 
-        nmgr_handle_req(nt, m);
+        nmgr_handle_req(nt, m, &nmgr_task_jbuf, 0);
         os_mbuf_free_chain(m);
     }
 }
 
+static void
+nmgr_worker(void *arg)
+{
+    struct nmgr_transport *nt;
+    struct os_event *ev;
+    struct os_mbuf *m;
+
+    while (1) {
+        ev = os_eventq_get(&g_nmgr_worker_evq);
+        if (ev->ev_type != OS_EVENT_T_MQUEUE_DATA) {
+            continue;
+        }
+        nt = (struct nmgr_transport *) ev->ev_arg;
+        while ((m = os_mqueue_get(&nt->nt_wq)) != NULL) {
+            nmgr_handle_req(nt, m, &nmgr_worker_jbuf, 1);
+            os_mbuf_free_chain(m);
+        }
+    }
+}
+
 void
 nmgr_task(void *arg)
 {
@@ -537,6 +647,10 @@ nmgr_transport_init(struct nmgr_transport *nt,
     if (rc != 0) {
         goto err;
     }
+    rc = os_mqueue_init(&nt->nt_wq, nt);
+    if (rc != 0) {
+        goto err;
+    }
 
     return (0);
 err:
@@ -655,3 +769,33 @@ nmgr_task_init(uint8_t prio, os_stack_t *stack_ptr, uint16_t stack_len)
 err:
     return (rc);
 }
+
+/**
+ * Starts a task for running the handlers of groups flagged with
+ * NMGR_GROUP_F_WORKER, so they don't hold up other requests. Without it
+ * all handlers run in the newtmgr task.
+ *
+ * @param prio                  Priority of the worker task; should be lower
+ *                                  than that of the newtmgr task.
+ * @param stack_ptr             Stack for the worker task.
+ * @param stack_len             Size of the stack.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+nmgr_worker_init(uint8_t prio, os_stack_t *stack_ptr, uint16_t stack_len)
+{
+    int rc;
+
+    os_eventq_init(&g_nmgr_worker_evq);
+    nmgr_jbuf_init(&nmgr_worker_jbuf);
+
+    rc = os_task_init(&g_nmgr_worker_task, "newtmgr_wk", nmgr_worker, NULL,
+            prio, OS_WAIT_FOREVER, stack_ptr, stack_len);
+    if (rc != 0) {
+        return (rc);
+    }
+    g_nmgr_worker_on = 1;
+
+    return (0);
+}
@@ -27,6 +27,7 @@
 
 #include <newtmgr/newtmgr.h>
 #include <util/datetime.h>
+#include <util/base64.h>
 #include <reboot/log_reboot.h>
 
 #include "newtmgr_priv.h"
@@ -71,6 +72,12 @@ nmgr_def_taskstat_read(struct nmgr_jbuf *njb)
         json_encode_object_entry(&njb->njb_enc, "cswcnt", &jv);
         JSON_VALUE_UINT(&jv, oti.oti_runtime);
         json_encode_object_entry(&njb->njb_enc, "runtime", &jv);
+        JSON_VALUE_UINT(&jv, oti.oti_cputime);
+        json_encode_object_entry(&njb->njb_enc, "cputime", &jv);
+        JSON_VALUE_UINT(&jv, oti.oti_maxrun);
+        json_encode_object_entry(&njb->njb_enc, "maxrun", &jv);
+        JSON_VALUE_UINT(&jv, oti.oti_preemptcnt);
+        json_encode_object_entry(&njb->njb_enc, "preempt", &jv);
         JSON_VALUE_UINT(&jv, oti.oti_last_checkin);
         json_encode_object_entry(&njb->njb_enc, "last_checkin", &jv);
         JSON_VALUE_UINT(&jv, oti.oti_next_checkin);
@@ -119,6 +126,10 @@ nmgr_def_mpstat_read(struct nmgr_jbuf *njb)
         json_encode_object_entry(&njb->njb_enc, "nblks", &jv);
         JSON_VALUE_UINT(&jv, omi.omi_num_free);
         json_encode_object_entry(&njb->njb_enc, "nfree", &jv);
+        JSON_VALUE_UINT(&jv, omi.omi_min_free);
+        json_encode_object_entry(&njb->njb_enc, "minfree", &jv);
+        JSON_VALUE_UINT(&jv, omi.omi_num_fail);
+        json_encode_object_entry(&njb->njb_enc, "nfail", &jv);
         json_encode_object_finish(&njb->njb_enc);
     }
 
@@ -236,3 +247,92 @@ nmgr_reset(struct nmgr_jbuf *njb)
 
     return OS_OK;
 }
+
+#define NMGR_TRACE_RECS         16
+
+/*
+ * Request: { "off":<seq> }, with seq of the first record wanted.
+ * Response:
+ * {
+ *      "rc":0,
+ *      "off":<seq of first record returned>,
+ *      "recs":<base64 encoded array of struct os_trace_rec>
+ * }
+ * Client asks for off + number of records returned next.  Empty "recs"
+ * means it has caught up.
+ */
+int
+nmgr_trace_read(struct nmgr_jbuf *njb)
+{
+    unsigned long long off = 0;
+    const struct json_attr_t trace_attr[2] = {
+        [0] = {
+            .attribute = "off",
+            .type = t_uinteger,
+            .addr.uinteger = &off
+        }
+    };
+    struct os_trace_rec recs[NMGR_TRACE_RECS];
+    char encoded[BASE64_ENCODE_SIZE(sizeof(recs))];
+    struct json_value jv;
+    uint32_t seq;
+    int cnt;
+    int rc;
+
+    if (!OS_TRACE) {
+        return OS_EINVAL;
+    }
+
+    rc = json_read_object(&njb->njb_buf, trace_attr);
+    if (rc) {
+        return OS_EINVAL;
+    }
+
+    seq = off;
+    cnt = os_trace_read(&seq, recs, NMGR_TRACE_RECS);
+    cnt = base64_encode(recs, cnt * sizeof(recs[0]), encoded, 1);
+
+    json_encode_object_start(&njb->njb_enc);
+    JSON_VALUE_INT(&jv, NMGR_ERR_EOK);
+    json_encode_object_entry(&njb->njb_enc, "rc", &jv);
+    JSON_VALUE_UINT(&jv, seq);
+    json_encode_object_entry(&njb->njb_enc, "off", &jv);
+    JSON_VALUE_STRINGN(&jv, encoded, cnt);
+    json_encode_object_entry(&njb->njb_enc, "recs", &jv);
+    json_encode_object_finish(&njb->njb_enc);
+
+    return OS_OK;
+}
+
+/*
+ * Request: { "on":<0|1> }; turning recording off freezes the ring.
+ */
+int
+nmgr_trace_write(struct nmgr_jbuf *njb)
+{
+    long long on = 1;
+    const struct json_attr_t trace_attr[2] = {
+        [0] = {
+            .attribute = "on",
+            .type = t_integer,
+            .addr.integer = &on
+        }
+    };
+    int rc;
+
+    if (!OS_TRACE) {
+        return OS_EINVAL;
+    }
+
+    rc = json_read_object(&njb->njb_buf, trace_attr);
+    if (rc) {
+        return OS_EINVAL;
+    }
+    os_trace_enable(on);
+
+    json_encode_object_start(&njb->njb_enc);
+    json_encode_object_finish(&njb->njb_enc);
+    nmgr_jbuf_setoerr(njb, 0);
+
+    return OS_OK;
+}
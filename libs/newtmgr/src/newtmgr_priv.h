@@ -27,5 +27,7 @@ int nmgr_def_logs_read(struct nmgr_jbuf *);
 int nmgr_datetime_get(struct nmgr_jbuf *);
 int nmgr_datetime_set(struct nmgr_jbuf *);
 int nmgr_reset(struct nmgr_jbuf *);
+int nmgr_trace_read(struct nmgr_jbuf *);
+int nmgr_trace_write(struct nmgr_jbuf *);
 
 #endif
@@ -24,6 +24,13 @@
 #include <newtmgr/newtmgr.h>
 #include <os/endian.h>
 
+/*
+ * Largest newtmgr request that is reassembled from writes.
+ */
+#ifndef NMGR_BLE_RX_MAX
+#define NMGR_BLE_RX_MAX         (NMGR_MAX_MTU)
+#endif
+
 /* nmgr ble mqueue */
 struct os_mqueue ble_nmgr_mq;
 
@@ -34,12 +41,27 @@ struct nmgr_transport ble_nt;
 uint16_t g_ble_nmgr_attr_handle;
 
 struct os_eventq *app_evq;
+
+/*
+ * Partially received requests, one per connection.
+ */
+static struct nmgr_ble_conn {
+    uint16_t conn_handle;
+    struct os_mbuf *rx_om;
+} nmgr_ble_conns[NIMBLE_OPT(MAX_CONNECTIONS)];
+
 /**
  * The vendor specific "newtmgr" service consists of one write no-rsp
  * characteristic for newtmgr requests: a single-byte characteristic that can
- * only accepts write-without-response commands.  The contents of each write
- * command contains an NMP request.  NMP responses are sent back in the form of
- * unsolicited notifications from the same characteristic.
+ * only accepts write-without-response commands.  NMP responses are sent back
+ * in the form of unsolicited notifications from the same characteristic.
+ *
+ * Requests and responses are a stream of NMP frames, split into writes and
+ * notifications of up to ATT MTU - 3 bytes.  A frame can span several writes,
+ * and a write can carry several frames; the frame length comes from the NMP
+ * header.  Each complete request is passed on as soon as it has arrived, so
+ * a client can have several requests in flight; responses carry the request
+ * sequence number.
  */
 
 /* {8D53DC1D-1DB7-4CD3-868B-8A527460AA84} */
@@ -79,63 +101,142 @@ static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
     },
 };
 
+/*
+ * Returns the reassembly state for the connection, or NULL if there is none
+ * and no room for one. State of connections that have gone away is reused.
+ */
+static struct nmgr_ble_conn *
+nmgr_ble_conn_find(uint16_t conn_handle)
+{
+    struct nmgr_ble_conn *free_nbc;
+    struct nmgr_ble_conn *nbc;
+    int i;
+
+    free_nbc = NULL;
+    for (i = 0; i < NIMBLE_OPT(MAX_CONNECTIONS); i++) {
+        nbc = &nmgr_ble_conns[i];
+        if (nbc->rx_om == NULL) {
+            free_nbc = nbc;
+        } else if (nbc->conn_handle == conn_handle) {
+            return nbc;
+        } else if (ble_att_mtu(nbc->conn_handle) == 0) {
+            /* Peer disconnected in the middle of a request. */
+            os_mbuf_free_chain(nbc->rx_om);
+            nbc->rx_om = NULL;
+            free_nbc = nbc;
+        }
+    }
+    if (free_nbc) {
+        free_nbc->conn_handle = conn_handle;
+    }
+    return free_nbc;
+}
+
+/*
+ * Takes the first len bytes of the reassembly buffer as a request, and
+ * writes the connection handle into its usrhdr so that the response can be
+ * sent to the correct peer.
+ */
+static struct os_mbuf *
+nmgr_ble_req_take(struct nmgr_ble_conn *nbc, int len)
+{
+    struct os_mbuf *m_req;
+    uint16_t conn_handle;
+    int rc;
+
+    conn_handle = nbc->conn_handle;
+    if (OS_MBUF_PKTLEN(nbc->rx_om) == len &&
+      (OS_MBUF_USRHDR_LEN(nbc->rx_om) >= sizeof (conn_handle) ||
+       OS_MBUF_LEADINGSPACE(nbc->rx_om) >= sizeof (conn_handle))) {
+        /* Whole buffer is the request, and it has (or has space for) the
+         * usrhdr; reuse it.
+         */
+        m_req = nbc->rx_om;
+        nbc->rx_om = NULL;
+        if (OS_MBUF_USRHDR_LEN(m_req) < sizeof (conn_handle)) {
+            m_req->om_pkthdr_len += sizeof (conn_handle);
+        }
+    } else {
+        m_req = os_msys_get_pkthdr(len, sizeof (conn_handle));
+        if (!m_req) {
+            return NULL;
+        }
+        rc = os_mbuf_appendfrom(m_req, nbc->rx_om, 0, len);
+        if (rc) {
+            os_mbuf_free_chain(m_req);
+            return NULL;
+        }
+        if (OS_MBUF_PKTLEN(nbc->rx_om) == len) {
+            os_mbuf_free_chain(nbc->rx_om);
+            nbc->rx_om = NULL;
+        } else {
+            os_mbuf_adj(nbc->rx_om, len);
+        }
+    }
+    memcpy(OS_MBUF_USRHDR(m_req), &conn_handle, sizeof(conn_handle));
+
+    return m_req;
+}
+
 static int
 gatt_svr_chr_access_newtmgr(uint16_t conn_handle, uint16_t attr_handle,
                             struct ble_gatt_access_ctxt *ctxt, void *arg)
 {
-    int rc;
+    struct nmgr_ble_conn *nbc;
     struct os_mbuf *m_req;
+    struct nmgr_hdr hdr;
+    int len;
+    int rc;
 
     switch (ctxt->op) {
         case BLE_GATT_ACCESS_OP_WRITE_CHR:
-            /* Try to reuse the BLE packet mbuf as the newtmgr request.  This
-             * requires a two-byte usrhdr to hold the BLE connection handle so
-             * that the newtmgr response can be sent to the correct peer.  If
-             * it is not possible to reuse the mbuf, then allocate a new one
-             * and copy the request contents.
+            nbc = nmgr_ble_conn_find(conn_handle);
+            if (!nbc) {
+                return BLE_ATT_ERR_INSUFFICIENT_RES;
+            }
+
+            /* Take the BLE packet mbuf, and add it to what has arrived
+             * so far.
              */
-            if (OS_MBUF_USRHDR_LEN(ctxt->om) >= sizeof (conn_handle)) {
-                /* Sufficient usrhdr space already present. */
-                m_req = ctxt->om;
-                ctxt->om = NULL;
-            } else if (OS_MBUF_LEADINGSPACE(ctxt->om) >=
-                       sizeof (conn_handle)) {
-
-                /* Usrhdr isn't present, but there is enough leading space to
-                 * add one.
-                 */
-                m_req = ctxt->om;
-                ctxt->om = NULL;
-
-                m_req->om_pkthdr_len += sizeof (conn_handle);
+            if (nbc->rx_om) {
+                os_mbuf_concat(nbc->rx_om, ctxt->om);
             } else {
-                /* The mbuf can't be reused.  Allocate a new one and perform a
-                 * copy.  Don't set ctxt->om to NULL; let the NimBLE host free
-                 * it.
-                 */
-                m_req = os_msys_get_pkthdr(OS_MBUF_PKTLEN(ctxt->om),
-                                           sizeof (conn_handle));
-                if (!m_req) {
-                    return BLE_ATT_ERR_INSUFFICIENT_RES;
-                }
-                rc = os_mbuf_appendfrom(m_req, ctxt->om, 0,
-                                        OS_MBUF_PKTLEN(ctxt->om));
-                if (rc) {
-                    return BLE_ATT_ERR_INSUFFICIENT_RES;
-                }
+                nbc->rx_om = ctxt->om;
             }
+            ctxt->om = NULL;
 
-            /* Write the connection handle to the newtmgr request usrhdr.  This
-             * is necessary so that we later know who to send the newtmgr
-             * response to.
-             */
-            memcpy(OS_MBUF_USRHDR(m_req), &conn_handle, sizeof(conn_handle));
+            /* Pass on the complete requests. */
+            while (1) {
+                rc = os_mbuf_copydata(nbc->rx_om, 0, sizeof(hdr), &hdr);
+                if (rc != 0) {
+                    /* Header hasn't arrived yet. */
+                    return 0;
+                }
+                len = sizeof(hdr) + ntohs(hdr.nh_len);
+                if (len > NMGR_BLE_RX_MAX) {
+                    /* Framing is lost; start over with the next write. */
+                    os_mbuf_free_chain(nbc->rx_om);
+                    nbc->rx_om = NULL;
+                    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+                }
+                if (OS_MBUF_PKTLEN(nbc->rx_om) < len) {
+                    return 0;
+                }
 
-            rc = nmgr_rx_req(&ble_nt, m_req);
-            if (rc != 0) {
-                return BLE_ATT_ERR_UNLIKELY;
+                m_req = nmgr_ble_req_take(nbc, len);
+                if (m_req) {
+                    nmgr_rx_req(&ble_nt, m_req);
+                } else if (OS_MBUF_PKTLEN(nbc->rx_om) > len) {
+                    /* Out of mbufs; drop this request, keep the rest. */
+                    os_mbuf_adj(nbc->rx_om, len);
+                } else {
+                    os_mbuf_free_chain(nbc->rx_om);
+                    nbc->rx_om = NULL;
+                }
+                if (!nbc->rx_om) {
+                    return 0;
+                }
             }
-            return 0;
 
         default:
             assert(0);
@@ -143,6 +244,52 @@ gatt_svr_chr_access_newtmgr(uint16_t conn_handle, uint16_t attr_handle,
     }
 }
 
+/*
+ * Sends a response as notifications of up to ATT MTU - 3 bytes. Consumes
+ * the mbuf.
+ */
+static void
+nmgr_ble_tx(uint16_t conn_handle, struct os_mbuf *m_resp)
+{
+    struct os_mbuf *om;
+    uint16_t mtu;
+    int chunk;
+    int off;
+    int len;
+    int rc;
+
+    mtu = ble_att_mtu(conn_handle);
+    if (mtu == 0) {
+        /* Not connected. */
+        os_mbuf_free_chain(m_resp);
+        return;
+    }
+    chunk = mtu - 3;
+
+    len = OS_MBUF_PKTLEN(m_resp);
+    if (len <= chunk) {
+        ble_gattc_notify_custom(conn_handle, g_ble_nmgr_attr_handle, m_resp);
+        return;
+    }
+
+    for (off = 0; off < len; off += chunk) {
+        om = ble_hs_mbuf_att_pkt();
+        if (!om) {
+            break;
+        }
+        rc = os_mbuf_appendfrom(om, m_resp, off, min(chunk, len - off));
+        if (rc) {
+            os_mbuf_free_chain(om);
+            break;
+        }
+        rc = ble_gattc_notify_custom(conn_handle, g_ble_nmgr_attr_handle, om);
+        if (rc) {
+            break;
+        }
+    }
+    os_mbuf_free_chain(m_resp);
+}
+
 /**
  * Nmgr ble process mqueue event
  * Gets an event from the nmgr mqueue and does a notify with the response
@@ -174,8 +321,7 @@ nmgr_ble_proc_mq_evt(struct os_event *ev)
                 assert(OS_MBUF_USRHDR_LEN(m_resp) >= sizeof (conn_handle));
                 memcpy(&conn_handle, OS_MBUF_USRHDR(m_resp),
                        sizeof (conn_handle));
-                ble_gattc_notify_custom(conn_handle, g_ble_nmgr_attr_handle,
-                                        m_resp);
+                nmgr_ble_tx(conn_handle, m_resp);
             }
             break;
 
@@ -47,10 +47,30 @@ typedef uint32_t os_stack_t;
 #define OS_STACK_ALIGN(__nmemb) \
     (OS_ALIGN((__nmemb), OS_STACK_ALIGNMENT))
 
+/*
+ * Critical sections are inlined: on the M0 a call and return cost more than
+ * the PRIMASK access itself.  The saved state is the previous PRIMASK value
+ * and exiting writes it back, so critical sections nest.
+ */
+static inline os_sr_t
+os_arch_enter_critical(void)
+{
+    os_sr_t sr;
+
+    __asm__ volatile ("mrs %0, primask\n\tcpsid i" : "=r" (sr) : : "memory");
+    return (sr);
+}
+
+static inline void
+os_arch_exit_critical(os_sr_t sr)
+{
+    __asm__ volatile ("msr primask, %0" : : "r" (sr) : "memory");
+}
+
 /* Enter a critical section, save processor state, and block interrupts */
-#define OS_ENTER_CRITICAL(__os_sr) (__os_sr = os_arch_save_sr())
+#define OS_ENTER_CRITICAL(__os_sr) (__os_sr = os_arch_enter_critical())
 /* Exit a critical section, restore processor state and unblock interrupts */
-#define OS_EXIT_CRITICAL(__os_sr) (os_arch_restore_sr(__os_sr))
+#define OS_EXIT_CRITICAL(__os_sr) (os_arch_exit_critical(__os_sr))
 #define OS_ASSERT_CRITICAL() (assert(os_arch_in_critical()))
 
 os_stack_t *os_arch_task_stack_init(struct os_task *, os_stack_t *, int);
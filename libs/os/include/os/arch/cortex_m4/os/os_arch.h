@@ -47,6 +47,16 @@ typedef uint32_t os_stack_t;
 #define OS_STACK_ALIGN(__nmemb) \
     (OS_ALIGN((__nmemb), OS_STACK_ALIGNMENT))
 
+#if OS_STACK_MPU_GUARD
+/*
+ * Size of the MPU guard region at the bottom of each task stack, and the
+ * number of words at the bottom of a stack that may be covered by it (the
+ * region is aligned to its size).  Stack scans stay clear of these words.
+ */
+#define OS_STACK_GUARD_SIZE     (32)
+#define OS_STACK_GUARD_WORDS    ((2 * OS_STACK_GUARD_SIZE) / sizeof (os_stack_t))
+#endif
+
 /* Enter a critical section, save processor state, and block interrupts */
 #define OS_ENTER_CRITICAL(__os_sr) (__os_sr = os_arch_save_sr())
 /* Exit a critical section, restore processor state and unblock interrupts */
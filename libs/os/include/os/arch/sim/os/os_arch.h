@@ -71,4 +71,13 @@ os_error_t os_arch_os_init(void);
 void os_arch_os_stop(void);
 os_error_t os_arch_os_start(void);
 
+/*
+ * Virtual time. Once set, the tick timer is stopped and the idle task calls
+ * this function instead of waiting for real time to pass. It must advance
+ * virtual time by at most 'usecs' and return by how much it did. Called
+ * with interrupts disabled.
+ */
+typedef uint32_t (*os_arch_sim_vtime_func)(uint32_t usecs);
+void os_arch_sim_vtime_set(os_arch_sim_vtime_func func);
+
 #endif /* _OS_ARCH_SIM_H */
@@ -23,6 +23,8 @@
 #include <stdlib.h>
 //#include <stdint.h>
 
+#include "os/os_cfg.h"
+
 #ifndef min
 #define min(a, b) ((a)<(b)?(a):(b))
 #endif
@@ -95,5 +97,7 @@ void os_init_idle_task(void);
 #include "os/os_sem.h"
 #include "os/os_mempool.h"
 #include "os/os_mbuf.h"
+#include "os/os_trace.h"
+#include "os/os_idle.h"
 
 #endif /* _OS_H */
@@ -21,5 +21,171 @@
 #ifndef _OS_CFG_H_
 #define _OS_CFG_H_ 
 
+/*
+ * Run queue implementation used by the scheduler.  When set to 1, ready
+ * tasks are kept in one FIFO list per priority and a two-level bitmap of
+ * non-empty priorities is used to find the highest priority ready task.
+ * Insert, remove and pick-next then take constant time, at the cost of a
+ * list head per priority (2KB of RAM on 32-bit targets).  When set to 0,
+ * a single list sorted by priority is used.
+ */
+#ifndef OS_SCHED_BITMAP
+#define OS_SCHED_BITMAP         (0)
+#endif
+
+/*
+ * Sleep queue implementation used by the scheduler.  When set to 1, tasks
+ * sleeping with a timeout are also kept in a binary min-heap ordered by
+ * wakeup time, so putting a task to sleep and waking it up take O(log n)
+ * and the next wakeup time is always at the root.  The heap holds at most
+ * OS_SCHED_SLEEP_HEAP_SIZE tasks (255 at most).  When set to 0, a single
+ * list sorted by wakeup time is used.
+ */
+#ifndef OS_SCHED_SLEEP_HEAP
+#define OS_SCHED_SLEEP_HEAP     (0)
+#endif
+
+#ifndef OS_SCHED_SLEEP_HEAP_SIZE
+#define OS_SCHED_SLEEP_HEAP_SIZE    (32)
+#endif
+
+/*
+ * Callout timer implementation.  When set to 1, armed callouts are hashed
+ * by expiry tick into OS_CALLOUT_WHEEL_SLOTS unsorted lists (a timing
+ * wheel).  Arming and stopping a callout take constant time and each tick
+ * only examines the callouts in one slot.  When set to 0, a single list
+ * sorted by expiry time is used.
+ */
+#ifndef OS_CALLOUT_WHEEL
+#define OS_CALLOUT_WHEEL        (0)
+#endif
+
+/* Number of timing wheel slots; must be a power of two. */
+#ifndef OS_CALLOUT_WHEEL_SLOTS
+#define OS_CALLOUT_WHEEL_SLOTS  (64)
+#endif
+
+/*
+ * Memory pool free list locking.  When set to 1 on Cortex-M3/M4,
+ * os_memblock_get() and os_memblock_put() update the free list head and
+ * the free block count with LDREX/STREX instead of disabling interrupts.
+ * Ignored on other architectures.
+ */
+#ifndef OS_MEMPOOL_LOCKFREE
+#define OS_MEMPOOL_LOCKFREE     (0)
+#endif
+
+/*
+ * Size-class allocator behind os_malloc().  When set to 1, requests are
+ * served in constant time from the smallest registered size class (see
+ * os_malloc_class_init() in os/os_malloc_class.h) with a free block, and
+ * only fall back to the libc heap when no class fits.  Each class exports
+ * its statistics through sys/stats.  Enabled by the OS_MALLOC_SLAB feature.
+ */
+#ifndef OS_MALLOC_SLAB
+#define OS_MALLOC_SLAB          (0)
+#endif
+
+/*
+ * Maximum length of a mutex priority inheritance chain.  When a task blocks
+ * on a mutex whose owner is itself blocked on a mutex, the boost is passed
+ * along the chain of owners up to this many links.
+ */
+#ifndef OS_MUTEX_PI_MAX_DEPTH
+#define OS_MUTEX_PI_MAX_DEPTH   (8)
+#endif
+
+/*
+ * When set to 1, each mutex counts acquisitions, contended pends, timeouts
+ * and priority boosts, and records the longest wait.
+ */
+#ifndef OS_MUTEX_STATS
+#define OS_MUTEX_STATS          (0)
+#endif
+
+/* Maximum number of event queues in an event set (at most 32). */
+#ifndef OS_EVENTSET_MAX_QUEUES
+#define OS_EVENTSET_MAX_QUEUES  (8)
+#endif
+
+/*
+ * When set to 1, the context switch hook charges each task with the
+ * hal_cputime ticks it ran for, and records how often it was preempted and
+ * its longest uninterrupted run.  Requires cputime to be initialized by the
+ * application.  Enabled by the OS_TASK_CPUTIME feature.
+ */
+#ifndef OS_TASK_CPUTIME
+#define OS_TASK_CPUTIME         (0)
+#endif
+
+/*
+ * When set to 1, os_time_get_usec() fills in the time since the last OS
+ * tick from hal_cputime, giving sub-tick resolution.  Takes effect once
+ * cputime is initialized by the application.  Enabled by the OS_TIME_HIRES
+ * feature.
+ */
+#ifndef OS_TIME_HIRES
+#define OS_TIME_HIRES           (0)
+#endif
+
+/*
+ * When set to 1, context switches, event queue and mutex activity, callout
+ * expiry and instrumented ISRs are recorded in a RAM ring of OS_TRACE_RECS
+ * entries (a power of 2), time stamped with hal_cputime.  Requires cputime
+ * to be initialized by the application.  Enabled by the OS_TRACE feature.
+ */
+#ifndef OS_TRACE
+#define OS_TRACE                (0)
+#endif
+#ifndef OS_TRACE_RECS
+#define OS_TRACE_RECS           (256)
+#endif
+
+/*
+ * When set to 1, the idle task picks the deepest of the sleep states
+ * registered by the BSP with os_idle_states_set() that pays off before the
+ * next wakeup: sleeping tasks, callouts and hal_cputime timers.  Enabled by
+ * the OS_IDLE_STATES feature.
+ */
+#ifndef OS_IDLE_STATES
+#define OS_IDLE_STATES          (0)
+#endif
+
+/*
+ * When set to 1, an msys allocation that finds its best-fit pool empty is
+ * retried from the next larger registered pool.
+ */
+#ifndef OS_MSYS_FALLBACK
+#define OS_MSYS_FALLBACK        (1)
+#endif
+
+/*
+ * Stack high-water marks are found by scanning up from the bottom of the
+ * stack for the first word that no longer holds OS_STACK_PATTERN.  When set
+ * to a non-zero value, the scan instead goes downward from the deepest
+ * point seen so far and stops after this many consecutive pattern words.
+ * That is faster, but under-reports if a frame skipped over as many words
+ * without writing them.
+ */
+#ifndef OS_STACK_SCAN_GAP
+#define OS_STACK_SCAN_GAP       (0)
+#endif
+
+/*
+ * When set to 1, the idle task updates the stack high-water mark of one
+ * task each time it runs.
+ */
+#ifndef OS_STACK_SCAN_IDLE
+#define OS_STACK_SCAN_IDLE      (1)
+#endif
+
+/*
+ * When set to 1, on targets with an MPU the bottom of the running task's
+ * stack is mapped as a no-access region, so that an overflow faults at
+ * once.
+ */
+#ifndef OS_STACK_MPU_GUARD
+#define OS_STACK_MPU_GUARD      (0)
+#endif
 
 #endif /* _OS_CFG_H_ */
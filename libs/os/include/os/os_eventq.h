@@ -21,6 +21,7 @@
 #define _OS_EVENTQ_H
 
 #include <inttypes.h>
+#include <os/os_cfg.h>
 #include <os/os_time.h>
 
 struct os_event {
@@ -36,9 +37,38 @@ struct os_event {
 #define OS_EVENT_T_MQUEUE_DATA (2) 
 #define OS_EVENT_T_PERUSER (16)
 
+/*
+ * A coalescing event counts the posts made to it, and merges their bits,
+ * while it waits on a queue.  The receiving task collects both with
+ * os_cevent_take().
+ */
+struct os_cevent {
+    /* Must be the first element in the structure for casting purposes. */
+    struct os_event ce_ev;
+    uint32_t ce_cnt;
+    uint32_t ce_bits;
+};
+
+struct os_eventset;
+
 struct os_eventq {
     struct os_task *evq_task;
     STAILQ_HEAD(, os_event) evq_list;
+    struct os_eventset *evq_set;    /* Event set this queue belongs to */
+    uint8_t evq_set_idx;            /* Position (priority) in event set */
+};
+
+/*
+ * An event set groups several event queues that are served by one task.
+ * Queues are registered once; a post to any member wakes the waiting task
+ * directly, and events are returned from the highest priority (first
+ * added) non-empty member.
+ */
+struct os_eventset {
+    struct os_task *evs_task;       /* Task waiting on the set */
+    uint32_t evs_ready;             /* Bit n set when member n has events */
+    uint8_t evs_cnt;                /* Number of member queues */
+    struct os_eventq *evs_q[OS_EVENTSET_MAX_QUEUES];
 };
 
 void os_eventq_init(struct os_eventq *);
@@ -47,5 +77,13 @@ struct os_event *os_eventq_get(struct os_eventq *);
 struct os_event *os_eventq_poll(struct os_eventq **, int, os_time_t);
 void os_eventq_remove(struct os_eventq *, struct os_event *);
 
+void os_cevent_init(struct os_cevent *, uint8_t, void *);
+void os_cevent_put(struct os_eventq *, struct os_cevent *, uint32_t);
+uint32_t os_cevent_take(struct os_cevent *, uint32_t *);
+
+void os_eventset_init(struct os_eventset *);
+int os_eventset_add(struct os_eventset *, struct os_eventq *);
+struct os_event *os_eventset_get(struct os_eventset *, os_time_t);
+
 #endif /* _OS_EVENTQ_H */
 
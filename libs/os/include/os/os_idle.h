@@ -0,0 +1,48 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _OS_IDLE_H
+#define _OS_IDLE_H
+
+#include <stdint.h>
+#include "os/os_time.h"
+
+/*
+ * A low power state the idle task can put the MCU in, provided by the BSP.
+ * The state is entered just before os_tick_idle() and left right after it,
+ * both with interrupts disabled.
+ */
+struct os_idle_state {
+    const char *ois_name;
+    uint32_t ois_latency;       /* Entry + exit latency, usecs */
+    uint32_t ois_residency;     /* Shortest sleep it pays off for, usecs */
+    uint8_t ois_wake;           /* OS_IDLE_WAKE_xxx kept working */
+    /* Returns non-zero if the state can't be entered now. */
+    int (*ois_enter)(const struct os_idle_state *ois, os_time_t ticks);
+    void (*ois_exit)(const struct os_idle_state *ois);
+};
+
+/*
+ * Wakeup sources. The OS tick timer must always be able to wake the MCU.
+ */
+#define OS_IDLE_WAKE_CPUTIME    (0x01)  /* hal_cputime timers */
+
+int os_idle_states_set(const struct os_idle_state *states, int cnt);
+void os_idle_latency_max_set(uint32_t usecs);
+
+#endif /* _OS_IDLE_H */
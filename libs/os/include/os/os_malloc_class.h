@@ -0,0 +1,54 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_OS_MALLOC_CLASS_
+#define H_OS_MALLOC_CLASS_
+
+/*
+ * Size classes of os_malloc(); see OS_MALLOC_SLAB.  Kept out of os.h, as
+ * the declarations need the memory pool and statistics definitions.
+ */
+
+#include "os/os.h"
+
+#if OS_MALLOC_SLAB
+
+#include "stats/stats.h"
+
+STATS_SECT_START(os_malloc_class)
+    STATS_SECT_ENTRY(allocs)
+    STATS_SECT_ENTRY(frees)
+    STATS_SECT_ENTRY(exhausted)
+    STATS_SECT_ENTRY(max_in_use)
+STATS_SECT_END
+
+/* A size class of the os_malloc() allocator, backed by a memory pool. */
+struct os_malloc_class {
+    struct os_mempool omc_pool;
+    STATS_SECT_DECL(os_malloc_class) omc_stats;
+    STAILQ_ENTRY(os_malloc_class) omc_next;
+};
+
+int os_malloc_class_init(struct os_malloc_class *omc, int block_size,
+                         int nblocks, void *membuf, char *name);
+void os_malloc_class_reset(void);
+
+#endif
+
+#endif
@@ -112,6 +112,101 @@ struct os_mqueue {
     struct os_event mq_ev;
 };
 
+/**
+ * Single-producer, single-consumer mbuf queue backed by a ring of mbuf
+ * pointers.  Unlike os_mqueue, adding to and removing from the ring never
+ * disable interrupts; only posting the wakeup event does, and only when it
+ * is not already pending.  This makes it suitable for handing packets from
+ * one ISR to one task.  Only one context may put and only one may get.
+ */
+struct os_mring {
+    /**
+     * Ring storage; the number of entries must be a power of two
+     */
+    struct os_mbuf **mr_ring;
+    /**
+     * Number of entries in the ring, minus one
+     */
+    uint16_t mr_mask;
+    /**
+     * Free-running position of the next put; written by the producer only
+     */
+    volatile uint16_t mr_head;
+    /**
+     * Free-running position of the next get; written by the consumer only
+     */
+    volatile uint16_t mr_tail;
+    /**
+     * Event posted when the ring becomes non-empty
+     */
+    struct os_event mr_ev;
+};
+
+/**
+ * A view of one contiguous segment of an mbuf chain.
+ */
+struct os_mbuf_iovec {
+    const uint8_t *omv_base;
+    uint16_t omv_len;
+};
+
+/**
+ * Read position within an mbuf chain.  A cursor walks the chain forward
+ * without copying or modifying it; the chain must not be changed while a
+ * cursor refers to it.
+ */
+struct os_mbuf_cursor {
+    /**
+     * Current mbuf, NULL once the end of the chain is reached
+     */
+    const struct os_mbuf *omc_om;
+    /**
+     * Offset of the next byte within the current mbuf
+     */
+    uint16_t omc_off;
+};
+
+/*
+ * Function called by os_mbuf_cursor_apply() on each contiguous segment.
+ * A non-zero return value stops the walk and is passed back to the caller.
+ */
+typedef int os_mbuf_apply_fn(void *arg, const uint8_t *data, uint16_t len);
+
+struct os_mbuf_ext;
+
+/* Called when the last mbuf referring to an external buffer is freed. */
+typedef void os_mbuf_ext_free_fn(struct os_mbuf_ext *ext);
+
+/**
+ * Descriptor for data that lives outside of an mbuf pool, such as a static,
+ * flash-resident or shared buffer.  Mbufs created with os_mbuf_get_ext()
+ * point into the buffer instead of holding a copy, and each of them holds a
+ * reference to the descriptor.  External data is read-only.
+ */
+struct os_mbuf_ext {
+    /**
+     * Start of the external data
+     */
+    const uint8_t *ome_buf;
+    /**
+     * Called once the reference count drops to zero; may be NULL for
+     * buffers that are never released (e.g. const data)
+     */
+    os_mbuf_ext_free_fn *ome_free;
+    /**
+     * Argument for the owner of the buffer
+     */
+    void *ome_arg;
+    /**
+     * Length of the external data
+     */
+    uint16_t ome_len;
+    /**
+     * Number of mbufs referring to this buffer
+     */
+    uint16_t ome_refcnt;
+};
+
 /*
  * Given a flag number, provide the mask for it
  *
@@ -119,6 +214,20 @@ struct os_mqueue {
  */
 #define OS_MBUF_F_MASK(__n) (1 << (__n))
 
+/*
+ * Flag set on mbufs whose data is held in an os_mbuf_ext.  A pointer to the
+ * descriptor is stored in the otherwise unused data buffer of the mbuf.
+ */
+#define OS_MBUF_F_EXT       (7)
+
+/*
+ * Checks whether a given mbuf refers to external data
+ *
+ * @param __om The mbuf to check
+ */
+#define OS_MBUF_IS_EXT(__om) \
+    ((__om)->om_flags & OS_MBUF_F_MASK(OS_MBUF_F_EXT))
+
 /* 
  * Checks whether a given mbuf is a packet header mbuf 
  *
@@ -176,6 +285,10 @@ _os_mbuf_leadingspace(struct os_mbuf *om)
     uint16_t startoff;
     uint16_t leadingspace;
 
+    if (OS_MBUF_IS_EXT(om)) {
+        return (0);
+    }
+
     startoff = 0;
     if (OS_MBUF_IS_PKTHDR(om)) {
         startoff = om->om_pkthdr_len;
@@ -205,6 +318,10 @@ _os_mbuf_trailingspace(struct os_mbuf *om)
 {
     struct os_mbuf_pool *omp;
 
+    if (OS_MBUF_IS_EXT(om)) {
+        return (0);
+    }
+
     omp = om->om_omp;
 
     return (&om->om_databuf[0] + omp->omp_databuf_len) -
@@ -222,6 +339,32 @@ _os_mbuf_trailingspace(struct os_mbuf *om)
  */
 #define OS_MBUF_TRAILINGSPACE(__om) _os_mbuf_trailingspace(__om)
 
+/**
+ * Calculates the mempool block size for an mbuf pool whose mbufs hold
+ * __dsize bytes of data (or __dsize bytes after a bare packet header, for
+ * OS_MBUF_PKT_BLOCK_SIZE()).
+ */
+#define OS_MBUF_BLOCK_SIZE(__dsize) \
+    OS_ALIGN((__dsize) + sizeof (struct os_mbuf), OS_ALIGNMENT)
+#define OS_MBUF_PKT_BLOCK_SIZE(__dsize) \
+    OS_MBUF_BLOCK_SIZE((__dsize) + sizeof (struct os_mbuf_pkthdr))
+
+/**
+ * Declares an mbuf pool of __n mbufs with mempool blocks of __blksize bytes
+ * (see OS_MBUF_BLOCK_SIZE()), along with its mempool (<__name>_mempool) and
+ * a statically allocated buffer.  All objects have file scope.  The pool
+ * must be initialized with OS_MBUF_POOL_INIT(), using the same dimensions.
+ */
+#define OS_MBUF_POOL_DECLARE(__name, __n, __blksize)                    \
+    OS_MEMPOOL_DECLARE(__name##_mempool, (__n), (__blksize));          \
+    static struct os_mbuf_pool __name
+
+/** Initializes an mbuf pool declared with OS_MBUF_POOL_DECLARE(). */
+#define OS_MBUF_POOL_INIT(__name, __n, __blksize)                       \
+    os_mbuf_pool_create(&(__name), &(__name##_mempool),                \
+                        __name##_mempool_membuf, (__n), (__blksize),   \
+                        #__name)
+
 /* Mbuf queue functions */
 
 /* Initialize a mbuf queue */
@@ -233,6 +376,14 @@ struct os_mbuf *os_mqueue_get(struct os_mqueue *);
 /* Put an element in a mbuf queue */
 int os_mqueue_put(struct os_mqueue *, struct os_eventq *, struct os_mbuf *);
 
+/* Single-producer, single-consumer mbuf ring functions */
+int os_mring_init(struct os_mring *mr, struct os_mbuf **ring, uint16_t size,
+                  void *arg);
+int os_mring_put(struct os_mring *mr, struct os_eventq *evq,
+                 struct os_mbuf *m);
+struct os_mbuf *os_mring_get(struct os_mring *mr);
+int os_mring_get_n(struct os_mring *mr, struct os_mbuf **out, int n);
+
 /* Register an mbuf pool with the system pool registry */
 int os_msys_register(struct os_mbuf_pool *);
 
@@ -249,6 +400,11 @@ struct os_mbuf *os_msys_get_pkthdr(uint16_t dsize, uint16_t user_hdr_len);
 int os_mbuf_pool_init(struct os_mbuf_pool *, struct os_mempool *mp, 
         uint16_t, uint16_t);
 
+/* Initialize a mempool and an mbuf pool on top of it */
+int os_mbuf_pool_create(struct os_mbuf_pool *omp, struct os_mempool *mp,
+                        void *membuf, uint16_t nbufs, uint16_t buf_len,
+                        char *name);
+
 /* Allocate a new mbuf out of the os_mbuf_pool */ 
 struct os_mbuf *os_mbuf_get(struct os_mbuf_pool *omp, uint16_t);
 
@@ -256,6 +412,15 @@ struct os_mbuf *os_mbuf_get(struct os_mbuf_pool *omp, uint16_t);
 struct os_mbuf *os_mbuf_get_pkthdr(struct os_mbuf_pool *omp, 
         uint8_t pkthdr_len);
 
+/* Initialize an external buffer descriptor */
+void os_mbuf_ext_init(struct os_mbuf_ext *ext, const void *buf, uint16_t len,
+                      os_mbuf_ext_free_fn *free_fn, void *arg);
+
+/* Allocate a new mbuf referring to external data */
+struct os_mbuf *os_mbuf_get_ext(struct os_mbuf_pool *omp,
+                                struct os_mbuf_ext *ext, uint16_t off,
+                                uint16_t len);
+
 /* Duplicate a mbuf from the pool */
 struct os_mbuf *os_mbuf_dup(struct os_mbuf *m);
 
@@ -291,4 +456,23 @@ void os_mbuf_concat(struct os_mbuf *first, struct os_mbuf *second);
 void *os_mbuf_extend(struct os_mbuf *om, uint16_t len);
 struct os_mbuf *os_mbuf_pullup(struct os_mbuf *om, uint16_t len);
 
+/* Zero-copy access to mbuf chains */
+int os_mbuf_iov(const struct os_mbuf *om, int off, int len,
+                struct os_mbuf_iovec *iov, int iovcnt);
+int os_mbuf_cursor_init(struct os_mbuf_cursor *cur, const struct os_mbuf *om,
+                        int off);
+int os_mbuf_cursor_seg(struct os_mbuf_cursor *cur, const uint8_t **data,
+                       int maxlen);
+int os_mbuf_cursor_skip(struct os_mbuf_cursor *cur, int len);
+int os_mbuf_cursor_read(struct os_mbuf_cursor *cur, void *dst, int len);
+int os_mbuf_cursor_get_u8(struct os_mbuf_cursor *cur, uint8_t *val);
+int os_mbuf_cursor_get_le16(struct os_mbuf_cursor *cur, uint16_t *val);
+int os_mbuf_cursor_get_le32(struct os_mbuf_cursor *cur, uint32_t *val);
+int os_mbuf_cursor_get_be16(struct os_mbuf_cursor *cur, uint16_t *val);
+int os_mbuf_cursor_get_be32(struct os_mbuf_cursor *cur, uint32_t *val);
+int os_mbuf_cursor_apply(struct os_mbuf_cursor *cur, int len,
+                         os_mbuf_apply_fn *fn, void *arg);
+int os_mbuf_crc16(const struct os_mbuf *om, int off, int len,
+                  uint16_t *crc);
+
 #endif /* _OS_MBUF_H */ 
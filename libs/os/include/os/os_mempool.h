@@ -43,6 +43,8 @@ struct os_mempool {
     int mp_block_size;          /* Size of the memory blocks, in bytes. */
     int mp_num_blocks;          /* The number of memory blocks. */
     int mp_num_free;            /* The number of free blocks left */
+    int mp_min_free;            /* Lowest number of free blocks seen */
+    uint32_t mp_num_fail;       /* Number of failed allocations */
     uint32_t mp_membuf_addr;    /* Address of memory buffer used by pool */
     STAILQ_ENTRY(os_mempool) mp_list;
     SLIST_HEAD(,os_memblock);   /* Pointer to list of free blocks */
@@ -55,6 +57,8 @@ struct os_mempool_info {
     int omi_block_size;
     int omi_num_blocks;
     int omi_num_free;
+    int omi_min_free;
+    uint32_t omi_num_fail;
     char omi_name[OS_MEMPOOL_INFO_NAME_LEN];
 };
 
@@ -78,10 +82,29 @@ typedef uint64_t os_membuf_t;
 #define OS_MEMPOOL_BYTES(n,blksize)     \
     (sizeof (os_membuf_t) * OS_MEMPOOL_SIZE((n), (blksize)))
 
+/**
+ * Declares a memory pool of __n blocks of __blksize bytes along with a
+ * statically allocated buffer for it, so creating the pool needs no heap
+ * and its RAM shows up in the linker map.  The buffer is named
+ * <__name>_membuf.  Both objects have file scope.  The pool must still be
+ * initialized with OS_MEMPOOL_INIT(), using the same dimensions.
+ */
+#define OS_MEMPOOL_DECLARE(__name, __n, __blksize)                      \
+    static os_membuf_t __name##_membuf[OS_MEMPOOL_SIZE((__n), (__blksize))]; \
+    static struct os_mempool __name
+
+/** Initializes a memory pool declared with OS_MEMPOOL_DECLARE(). */
+#define OS_MEMPOOL_INIT(__name, __n, __blksize)                         \
+    os_mempool_init(&(__name), (__n), (__blksize), __name##_membuf,    \
+                    #__name)
+
 /* Initialize a memory pool */
 os_error_t os_mempool_init(struct os_mempool *mp, int blocks, int block_size, 
                            void *membuf, char *name);
 
+/* Remove a memory pool from the list of pools */
+void os_mempool_unregister(struct os_mempool *mp);
+
 /* Checks if a memory block was allocated from the specified mempool. */
 int os_memblock_from(struct os_mempool *mp, void *block_addr);
 
@@ -91,4 +114,10 @@ void *os_memblock_get(struct os_mempool *mp);
 /* Put the memory block back into the pool */
 os_error_t os_memblock_put(struct os_mempool *mp, void *block_addr);
 
+/* Get up to n memory blocks from the pool */
+int os_memblock_get_n(struct os_mempool *mp, void **blocks, int n);
+
+/* Put a NULL-terminated list of memory blocks back into the pool */
+os_error_t os_memblock_put_list(struct os_mempool *mp, void *block_list);
+
 #endif  /* _OS_MEMPOOL_H_ */
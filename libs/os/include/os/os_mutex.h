@@ -30,6 +30,13 @@ struct os_mutex
     uint8_t     mu_prio;            /* owner's default priority*/
     uint16_t    mu_level;           /* call nesting level */
     struct os_task *mu_owner;       /* owners task */
+#if OS_MUTEX_STATS
+    uint32_t    mu_acquires;        /* number of times mutex was granted */
+    uint32_t    mu_contended;       /* number of pends that had to wait */
+    uint32_t    mu_timeouts;        /* number of pends that timed out */
+    uint32_t    mu_boosts;          /* number of owner priority boosts */
+    os_time_t   mu_max_wait;        /* longest wait, in ticks */
+#endif
 };
 
 /* 
@@ -54,18 +54,30 @@ typedef void (*os_task_func_t)(void *);
 
 #define OS_TASK_MAX_NAME_LEN (32)
 
+/*
+ * Declares a statically allocated task stack of __size os_stack_t elements,
+ * rounded and aligned as the architecture requires.  Pass
+ * OS_STACK_ALIGN(__size) as the stack size to os_task_init().
+ */
+#define OS_TASK_STACK_DECLARE(__name, __size)                           \
+    static os_stack_t __name[OS_STACK_ALIGN(__size)]                    \
+        __attribute__((aligned(OS_STACK_ALIGNMENT)))
+
 struct os_task {
     os_stack_t *t_stackptr;
     os_stack_t *t_stacktop;
     
     uint16_t t_stacksize;
-    uint16_t t_pad;
+    uint8_t t_run_prio;     /* Priority task was queued at in run list */
+    uint8_t t_sleep_idx;    /* Position in sleep heap, if one is used */
 
     uint8_t t_taskid;
     uint8_t t_prio;
     uint8_t t_state;
     uint8_t t_flags;
 
+    uint16_t t_stack_hwm;   /* Deepest stack use seen, in os_stack_t units */
+
     char *t_name;
     os_task_func_t t_func;
     void *t_arg;
@@ -77,6 +89,11 @@ struct os_task {
     os_time_t t_next_wakeup;
     os_time_t t_run_time;
     uint32_t t_ctx_sw_cnt;
+#if OS_TASK_CPUTIME
+    uint32_t t_cputime;         /* Total run time, in cputime ticks */
+    uint32_t t_max_run;         /* Longest single run, in cputime ticks */
+    uint32_t t_preempt_cnt;     /* Times switched out while still ready */
+#endif
    
     /* Global list of all tasks, irrespective of run or sleep lists */
     STAILQ_ENTRY(os_task) t_os_task_list;
@@ -93,6 +110,8 @@ int os_task_init(struct os_task *, char *, os_task_func_t, void *, uint8_t,
 
 uint8_t os_task_count(void);
 
+uint16_t os_task_stack_hwm(struct os_task *t);
+
 struct os_task_info {
     uint8_t oti_prio;
     uint8_t oti_taskid;
@@ -102,6 +121,9 @@ struct os_task_info {
     uint16_t oti_stksize;
     uint32_t oti_cswcnt;
     uint32_t oti_runtime;
+    uint32_t oti_cputime;
+    uint32_t oti_maxrun;
+    uint32_t oti_preemptcnt;
     os_time_t oti_last_checkin;
     os_time_t oti_next_checkin;
 
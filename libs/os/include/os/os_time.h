@@ -106,6 +106,7 @@ struct os_timezone {
 int os_settimeofday(struct os_timeval *utctime, struct os_timezone *tz);
 int os_gettimeofday(struct os_timeval *utctime, struct os_timezone *tz);
 int64_t os_get_uptime_usec(void);
+uint64_t os_time_get_usec(void);
 int os_time_ms_to_ticks(uint32_t ms, uint32_t *out_ticks);
 
 #endif /* _OS_TIME_H */
@@ -0,0 +1,63 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _OS_TRACE_H
+#define _OS_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * A trace record.  Records are exported as is, little endian, 12 bytes
+ * each; a host tool turns them into a timeline.
+ */
+struct os_trace_rec {
+    uint32_t otr_time;          /* hal_cputime ticks */
+    uint32_t otr_arg;           /* Depends on type, see below */
+    uint8_t otr_type;           /* OS_TRACE_T_xxx */
+    uint8_t otr_task;           /* Running task id; 0xff before OS start */
+    uint16_t otr_seq;           /* Low bits of sequence number */
+};
+
+#define OS_TRACE_T_TASK_SW      (1)     /* arg: id of task switched to */
+#define OS_TRACE_T_ISR_ENTER    (2)     /* arg: irq number */
+#define OS_TRACE_T_ISR_EXIT     (3)     /* arg: irq number */
+#define OS_TRACE_T_EVQ_PUT      (4)     /* arg: event */
+#define OS_TRACE_T_EVQ_GET      (5)     /* arg: event */
+#define OS_TRACE_T_MUTEX_WAIT   (6)     /* arg: mutex; task blocks on it */
+#define OS_TRACE_T_MUTEX_REL    (7)     /* arg: mutex */
+#define OS_TRACE_T_CALLOUT      (8)     /* arg: expired callout */
+#define OS_TRACE_T_PERUSER      (128)   /* First type free for applications */
+
+#if OS_TRACE
+#define OS_TRACE_REC(type, arg) os_trace((type), (uint32_t)(uintptr_t)(arg))
+#else
+#define OS_TRACE_REC(type, arg)
+#endif
+
+/*
+ * For interrupt handlers which are to show up in the trace.
+ */
+#define OS_TRACE_ISR_ENTER(irq) OS_TRACE_REC(OS_TRACE_T_ISR_ENTER, irq)
+#define OS_TRACE_ISR_EXIT(irq)  OS_TRACE_REC(OS_TRACE_T_ISR_EXIT, irq)
+
+void os_trace(uint8_t type, uint32_t arg);
+void os_trace_enable(int on);
+int os_trace_read(uint32_t *seq, struct os_trace_rec *recs, int max);
+
+#endif /* _OS_TRACE_H */
@@ -144,37 +144,44 @@ PendSV_Handler:
         .fnstart
         .cantunwind
 
-        LDR     R3,=g_os_run_list   /* Get highest priority task ready to run */
-        LDR     R2,[R3]             /* Store in R2 */
+        CPSID   I                   /* Run queue can't change now */
+        PUSH    {R4,LR}             /* Save EXC_RETURN */
+        BL      os_arch_pendsv_next /* Get task to switch to */
+        POP     {R1,R3}             /* R4 is callee saved; skip it */
+        MOV     LR,R3               /* Restore EXC_RETURN */
+        MOV     R2,R0               /* Store in R2 */
         LDR     R3,=g_current_task  /* Get current task */
         LDR     R1,[R3]             /* Current task in R1 */
         CMP     R1,R2
-        BNE     context_switch
-        BX      LR                  /* RETI, no task switch */
-context_switch:
+        BEQ     no_switch           /* Keep the switch path branch-free */
+
         MRS     R0,PSP              /* Read PSP */
         SUBS    R0,R0,#32
+        STR     R0,[R1,#0]          /* Update stack pointer in current task */
         STMIA   R0!,{R4-R7}         /* Save Old context */
         MOV     R4,R8
         MOV     R5,R9
         MOV     R6,R10
         MOV     R7,R11
         STMIA   R0!,{R4-R7}         /* Save Old context */
-        SUBS    R0,R0,#32
-
-        STR     R0,[R1,#0]          /* Update stack pointer in current task */
-        STR     R2,[R3]             /* g_current_task = highest ready */
+        STR     R2,[R3]             /* g_current_task = next task */
 
+        /*
+         * Restore in frame order: R4-R7 straight into place, then R8-R11
+         * through the scratch registers, which are restored by the
+         * exception return.  This saves rewinding the stack pointer.
+         */
         LDR     R0,[R2,#0]          /* get stack pointer of task we will start */
-        ADDS    R0,R0, #16
         LDMIA   R0!,{R4-R7}         /* Restore New Context */
-        MOV     R8,R4
-        MOV     R9,R5
-        MOV     R10,R6
-        MOV     R11,R7
+        LDMIA   R0!,{R1-R3}
+        MOV     R8,R1
+        MOV     R9,R2
+        MOV     R10,R3
+        LDMIA   R0!,{R1}
+        MOV     R11,R1
         MSR     PSP,R0              /* Write PSP */
-        SUBS    R0,R0,#32
-        LDMIA   R0!,{R4-R7}         /* Restore New Context */
+no_switch:
+        CPSIE   I
         BX      LR                  /* Return to Thread Mode */
 
         .fnend
@@ -104,34 +104,47 @@ uint32_t os_flags = OS_RUN_PRIV;
 void
 timer_handler(void)
 {
+    OS_TRACE_ISR_ENTER(SysTick_IRQn);
     os_time_advance(1);
+    OS_TRACE_ISR_EXIT(SysTick_IRQn);
 }
 
 void
 os_arch_ctx_sw(struct os_task *t)
 {
-    os_sched_ctx_sw_hook(t);
-
     /* Set PendSV interrupt pending bit to force context switch */
     SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 }
 
+/*
+ * Called by PendSV_Handler with interrupts disabled; returns the task to
+ * switch to.  The task is picked here, not in os_arch_ctx_sw(), as the run
+ * queue may have changed while PendSV was pending.
+ */
+struct os_task *
+os_arch_pendsv_next(void)
+{
+    struct os_task *t;
+
+    t = os_sched_next_task();
+    os_sched_ctx_sw_hook(t);
+    return t;
+}
+
+/*
+ * Out-of-line versions of OS_ENTER_CRITICAL() and OS_EXIT_CRITICAL(), for
+ * code that needs a function to call.
+ */
 os_sr_t
 os_arch_save_sr(void)
 {
-    uint32_t isr_ctx;
-
-    isr_ctx = __get_PRIMASK();
-    __disable_irq();
-    return (isr_ctx & 1);
+    return (os_arch_enter_critical());
 }
 
 void
 os_arch_restore_sr(os_sr_t isr_ctx)
 {
-    if (!isr_ctx) {
-        __enable_irq();
-    }
+    os_arch_exit_critical(isr_ctx);
 }
 
 int
@@ -146,13 +146,15 @@ PendSV_Handler:
         .fnstart
         .cantunwind
 
-        LDR     R3,=g_os_run_list       /* Get highest priority task ready to run */
-        LDR     R2,[R3]                 /* Store in R2 */
+        CPSID   I                       /* Run queue can't change now */
+        PUSH    {R4,LR}                 /* Save EXC_RETURN */
+        BL      os_arch_pendsv_next     /* Get task to switch to */
+        POP     {R4,LR}                 /* Restore EXC_RETURN */
+        MOV     R2,R0                   /* Store in R2 */
         LDR     R3,=g_current_task      /* Get current task */
         LDR     R1,[R3]                 /* Current task in R1 */
         CMP     R1,R2
-        IT      EQ
-        BXEQ    LR                      /* RETI, no task switch */
+        BEQ     PendSV_Done             /* RETI, no task switch */
 
         MRS     R12,PSP                 /* Read PSP */
         STMDB   R12!,{R4-R11}           /* Save Old context */
@@ -162,6 +164,8 @@ PendSV_Handler:
         LDR     R12,[R2,#0]             /* get stack pointer of task we will start */
         LDMIA   R12!,{R4-R11}           /* Restore New Context */
         MSR     PSP,R12                 /* Write PSP */
+PendSV_Done:
+        CPSIE   I
         BX      LR                      /* Return to Thread Mode */
 
         .fnend
@@ -90,24 +90,77 @@ struct stack_frame {
   );
 #endif
 
+#if OS_STACK_MPU_GUARD
+#if !defined(__MPU_PRESENT) || !__MPU_PRESENT
+#error "OS_STACK_MPU_GUARD requires an MPU"
+#endif
+
+/* MPU region used to guard the bottom of the running task's stack */
+#define OS_STACK_GUARD_REGION   (7)
+
+/*
+ * Maps the OS_STACK_GUARD_SIZE aligned bytes at the bottom of the stack of
+ * task 't' as no-access; any access by the task faults right away.
+ */
+static void
+os_arch_stack_guard_set(struct os_task *t)
+{
+    uint32_t base;
+
+    base = OS_ALIGN((uint32_t)(t->t_stacktop - t->t_stacksize),
+                    OS_STACK_GUARD_SIZE);
+
+    MPU->RNR = OS_STACK_GUARD_REGION;
+    MPU->RBAR = base;
+    MPU->RASR = MPU_RASR_XN_Msk |
+                ((__builtin_ctz(OS_STACK_GUARD_SIZE) - 1) <<
+                 MPU_RASR_SIZE_Pos) |
+                MPU_RASR_ENABLE_Msk;
+    __DSB();
+    __ISB();
+}
+#endif
+
 /* XXX: determine how we will deal with running un-privileged */
 uint32_t os_flags = OS_RUN_PRIV;
 
 void
 timer_handler(void)
 {
+    OS_TRACE_ISR_ENTER(SysTick_IRQn);
     os_time_advance(1);
+    OS_TRACE_ISR_EXIT(SysTick_IRQn);
 }
 
 void
 os_arch_ctx_sw(struct os_task *t)
 {
-    os_sched_ctx_sw_hook(t);
-
     /* Set PendSV interrupt pending bit to force context switch */
     SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 }
 
+/*
+ * Called by PendSV_Handler with interrupts disabled; returns the task to
+ * switch to.  The task is picked here, not in os_arch_ctx_sw(), as the run
+ * queue may have changed while PendSV was pending.  The run queue is not
+ * looked at from assembly, so that it can be laid out differently (see
+ * OS_SCHED_BITMAP).
+ */
+struct os_task *
+os_arch_pendsv_next(void)
+{
+    struct os_task *t;
+
+    t = os_sched_next_task();
+    if (t != os_sched_get_current_task()) {
+#if OS_STACK_MPU_GUARD
+        os_arch_stack_guard_set(t);
+#endif
+        os_sched_ctx_sw_hook(t);
+    }
+    return t;
+}
+
 os_sr_t
 os_arch_save_sr(void)
 {
@@ -169,6 +222,18 @@ os_arch_init(void)
      * Trap on divide-by-zero.
      */
     SCB->CCR |= SCB_CCR_DIV_0_TRP_Msk;
+
+#if OS_STACK_MPU_GUARD
+    /*
+     * Keep the default memory map for everything but the stack guard, and
+     * report guard hits as MemManage faults.
+     */
+    MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+    SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+    __DSB();
+    __ISB();
+#endif
+
     os_init_idle_task();
 }
 
@@ -238,6 +303,9 @@ os_arch_start(void)
     /* Get the highest priority ready to run to set the current task */
     t = os_sched_next_task();
     os_sched_set_current_task(t);
+#if OS_STACK_MPU_GUARD
+    os_arch_stack_guard_set(t);
+#endif
 
     /* Adjust PSP so it looks like this task just took an exception */
     __set_PSP((uint32_t)t->t_stackptr + offsetof(struct stack_frame, r0));
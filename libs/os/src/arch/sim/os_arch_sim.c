@@ -221,6 +221,28 @@ static struct {
 
 #define NUMSIGS     (sizeof(signals)/sizeof(signals[0]))
 
+static os_arch_sim_vtime_func vtime_func;
+static uint32_t vtime_usecs;    /* usecs into the current tick */
+
+static void
+os_tick_idle_vtime(os_time_t ticks)
+{
+    uint32_t usecs;
+
+    /* Wake up at the next tick boundary at the latest when ticks is 0 */
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    usecs = ticks * OS_USEC_PER_TICK - vtime_usecs;
+
+    vtime_usecs += vtime_func(usecs);
+    ticks = vtime_usecs / OS_USEC_PER_TICK;
+    vtime_usecs %= OS_USEC_PER_TICK;
+    if (ticks) {
+        os_time_advance(ticks);
+    }
+}
+
 void
 os_tick_idle(os_time_t ticks)
 {
@@ -230,6 +252,11 @@ os_tick_idle(os_time_t ticks)
 
     OS_ASSERT_CRITICAL();
 
+    if (vtime_func) {
+        os_tick_idle_vtime(ticks);
+        return;
+    }
+
     if (ticks > 0) {
         /*
          * Enter tickless regime and set the timer to fire after 'ticks'
@@ -398,6 +425,16 @@ stop_timer(void)
     assert(rc == 0);
 }
 
+void
+os_arch_sim_vtime_set(os_arch_sim_vtime_func func)
+{
+    vtime_func = func;
+    vtime_usecs = 0;
+    if (g_os_started) {
+        stop_timer();
+    }
+}
+
 os_error_t
 os_arch_os_init(void)
 {
@@ -405,8 +442,6 @@ os_arch_os_init(void)
     g_current_task = NULL;
 
     STAILQ_INIT(&g_os_task_list);
-    TAILQ_INIT(&g_os_run_list);
-    TAILQ_INIT(&g_os_sleep_list);
 
     /*
      * Setup all interrupt handlers.
@@ -439,7 +474,9 @@ os_arch_os_start(void)
     assert(sr == 0);
 
     /* Enable the interrupt sources */
-    start_timer();
+    if (!vtime_func) {
+        start_timer();
+    }
 
     t = os_sched_next_task();
     os_sched_set_current_task(t);
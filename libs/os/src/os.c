@@ -22,6 +22,9 @@
 #include "os_priv.h"
 
 #include "hal/hal_os_tick.h"
+#if OS_IDLE_STATES
+#include "hal/hal_cputime.h"
+#endif
 
 #include <assert.h>
 
@@ -40,6 +43,121 @@ int g_os_started;
 #endif
 #define MAX_IDLE_TICKS  (600 * OS_TICKS_PER_SEC)        /* 10 minutes */
 
+#if OS_IDLE_STATES
+static const struct os_idle_state *os_idle_states;
+static int os_idle_state_cnt;
+static uint32_t os_idle_latency_max = UINT32_MAX;
+
+/**
+ * Sets the low power states the idle task can choose from. Called by the
+ * BSP.
+ *
+ * @param states                Array of states, ordered from the shallowest
+ *                              to the deepest.
+ * @param cnt                   Number of states in the array.
+ *
+ * @return                      0 on success, OS_EINVAL on bad arguments.
+ */
+int
+os_idle_states_set(const struct os_idle_state *states, int cnt)
+{
+    os_sr_t sr;
+
+    if (cnt < 0 || (cnt > 0 && !states)) {
+        return OS_EINVAL;
+    }
+    OS_ENTER_CRITICAL(sr);
+    os_idle_states = states;
+    os_idle_state_cnt = cnt;
+    OS_EXIT_CRITICAL(sr);
+    return 0;
+}
+
+/**
+ * Limits the wakeup latency of the states the idle task may enter, e.g.
+ * while a peripheral needs to be serviced quickly. UINT32_MAX removes the
+ * limit.
+ */
+void
+os_idle_latency_max_set(uint32_t usecs)
+{
+    os_idle_latency_max = usecs;
+}
+
+/*
+ * Picks the deepest state whose target residency fits before the next
+ * wakeup. States which stop hal_cputime are skipped while cputime timers
+ * are running.
+ */
+static const struct os_idle_state *
+os_idle_select(os_time_t iticks)
+{
+    const struct os_idle_state *ois;
+    uint32_t idle_usecs;
+    uint32_t expiry;
+    uint32_t delta;
+    int cputime_pending;
+    int i;
+
+    idle_usecs = (uint64_t)iticks * 1000000 / OS_TICKS_PER_SEC;
+
+    cputime_pending = cputime_next_expiry(&expiry) == 0;
+    if (cputime_pending) {
+        delta = expiry - cputime_get32();
+        if ((int32_t)delta < 0) {
+            return NULL;
+        }
+        delta = cputime_ticks_to_usecs(delta);
+        if (delta < idle_usecs) {
+            idle_usecs = delta;
+        }
+    }
+
+    for (i = os_idle_state_cnt - 1; i >= 0; i--) {
+        ois = &os_idle_states[i];
+        if (ois->ois_latency > os_idle_latency_max ||
+            ois->ois_residency > idle_usecs ||
+            ois->ois_latency >= idle_usecs) {
+            continue;
+        }
+        if (cputime_pending && !(ois->ois_wake & OS_IDLE_WAKE_CPUTIME)) {
+            continue;
+        }
+        return ois;
+    }
+    return NULL;
+}
+
+/*
+ * Sleeps in the chosen low power state, waking up early enough to cover
+ * the state's exit latency.
+ */
+static void
+os_idle_enter(os_time_t iticks)
+{
+    const struct os_idle_state *ois;
+    os_time_t lticks;
+
+    ois = os_idle_select(iticks);
+    if (ois) {
+        lticks = ((uint64_t)ois->ois_latency * OS_TICKS_PER_SEC +
+          999999) / 1000000;
+        if (lticks < iticks) {
+            iticks -= lticks;
+        }
+        if (ois->ois_enter && ois->ois_enter(ois, iticks)) {
+            ois = NULL;
+        }
+    }
+
+    os_tick_idle(iticks);
+
+    if (ois && ois->ois_exit) {
+        ois->ois_exit(ois);
+    }
+}
+#endif
+
 /**
  * Idle operating system task, runs when no other tasks are running.
  * The idle task operates in tickless mode, which means it looks for
@@ -57,6 +175,9 @@ os_idle_task(void *arg)
 
     while (1) {
         ++g_os_idle_ctr;
+#if OS_STACK_SCAN_IDLE
+        os_task_stack_scan_idle();
+#endif
         OS_ENTER_CRITICAL(sr);
         now = os_time_get();
         sticks = os_sched_wakeup_ticks(now);
@@ -72,7 +193,15 @@ os_idle_task(void *arg)
         /* Tell the architecture specific support to put the processor to sleep
          * for 'n' ticks.
          */
+#if OS_IDLE_STATES
+        if (iticks > 0 && os_idle_state_cnt > 0) {
+            os_idle_enter(iticks);
+        } else {
+            os_tick_idle(iticks);
+        }
+#else
         os_tick_idle(iticks);
+#endif
         OS_EXIT_CRITICAL(sr);
     }
 }
@@ -106,8 +235,9 @@ os_init(void)
 {
     os_error_t err;
 
-    TAILQ_INIT(&g_callout_list);
+    os_callout_init();
     STAILQ_INIT(&g_os_task_list);
+    os_sched_init();
 
     err = os_arch_os_init();
     assert(err == OS_OK);
@@ -20,11 +20,100 @@
 #include "os/os.h"
 #include "os_priv.h"
 
+#include <util/util.h>
 #include <assert.h>
 #include <string.h>
 
+#if OS_CALLOUT_WHEEL
+
+#define OS_CALLOUT_WHEEL_MASK   (OS_CALLOUT_WHEEL_SLOTS - 1)
+#define OS_CALLOUT_SLOT(__t)    (&g_callout_wheel[(__t) & OS_CALLOUT_WHEEL_MASK])
+
+CTASSERT((OS_CALLOUT_WHEEL_SLOTS & OS_CALLOUT_WHEEL_MASK) == 0);
+
+/* Armed callouts, hashed by expiry tick.  Slots are not sorted. */
+static struct os_callout_list g_callout_wheel[OS_CALLOUT_WHEEL_SLOTS];
+
+/* Number of armed callouts. */
+static int g_callout_wheel_cnt;
+
+/* Last tick whose slot has been processed by os_callout_tick(). */
+static os_time_t g_callout_wheel_tick;
+
+static void
+os_callout_list_insert(struct os_callout *c)
+{
+    /*
+     * A callout which is already due would land in a slot that has been
+     * processed, and fire only a revolution later.  Put it in the slot
+     * visited on the next tick instead.
+     */
+    if (!OS_TIME_TICK_GT(c->c_ticks, g_callout_wheel_tick)) {
+        c->c_ticks = g_callout_wheel_tick + 1;
+    }
+    TAILQ_INSERT_TAIL(OS_CALLOUT_SLOT(c->c_ticks), c, c_next);
+    g_callout_wheel_cnt++;
+}
+
+static void
+os_callout_list_remove(struct os_callout *c)
+{
+    TAILQ_REMOVE(OS_CALLOUT_SLOT(c->c_ticks), c, c_next);
+    c->c_next.tqe_prev = NULL;
+    g_callout_wheel_cnt--;
+}
+
+#else
+
 struct os_callout_list g_callout_list;
 
+static void
+os_callout_list_insert(struct os_callout *c)
+{
+    struct os_callout *entry;
+
+    TAILQ_FOREACH(entry, &g_callout_list, c_next) {
+        if (OS_TIME_TICK_LT(c->c_ticks, entry->c_ticks)) {
+            break;
+        }
+    }
+
+    if (entry) {
+        TAILQ_INSERT_BEFORE(entry, c, c_next);
+    } else {
+        TAILQ_INSERT_TAIL(&g_callout_list, c, c_next);
+    }
+}
+
+static void
+os_callout_list_remove(struct os_callout *c)
+{
+    TAILQ_REMOVE(&g_callout_list, c, c_next);
+    c->c_next.tqe_prev = NULL;
+}
+
+#endif /* OS_CALLOUT_WHEEL */
+
+/**
+ * Empties the list of armed callouts.  Called when the operating system is
+ * initialized.
+ */
+void
+os_callout_init(void)
+{
+#if OS_CALLOUT_WHEEL
+    int i;
+
+    for (i = 0; i < OS_CALLOUT_WHEEL_SLOTS; i++) {
+        TAILQ_INIT(&g_callout_wheel[i]);
+    }
+    g_callout_wheel_cnt = 0;
+    g_callout_wheel_tick = os_time_get();
+#else
+    TAILQ_INIT(&g_callout_list);
+#endif
+}
+
 static void
 _os_callout_init(struct os_callout *c, struct os_eventq *evq, void *ev_arg)
 {
@@ -72,8 +161,7 @@ os_callout_stop(struct os_callout *c)
     OS_ENTER_CRITICAL(sr);
 
     if (os_callout_queued(c)) {
-        TAILQ_REMOVE(&g_callout_list, c, c_next);
-        c->c_next.tqe_prev = NULL;
+        os_callout_list_remove(c);
     }
 
     if (c->c_evq) {
@@ -94,7 +182,6 @@ os_callout_stop(struct os_callout *c)
 int
 os_callout_reset(struct os_callout *c, int32_t ticks)
 {
-    struct os_callout *entry;
     os_sr_t sr;
     int rc;
 
@@ -112,27 +199,136 @@ os_callout_reset(struct os_callout *c, int32_t ticks)
     }
 
     c->c_ticks = os_time_get() + ticks;
+    os_callout_list_insert(c);
 
-    entry = NULL;
-    TAILQ_FOREACH(entry, &g_callout_list, c_next) {
-        if (OS_TIME_TICK_LT(c->c_ticks, entry->c_ticks)) {
+    OS_EXIT_CRITICAL(sr);
+
+    return (0);
+err:
+    return (rc);
+}
+
+#if OS_CALLOUT_WHEEL
+
+/*
+ * Removes and returns the first callout in the slot for tick 'slot_tick'
+ * which has expired by 'now', or NULL if there is none.
+ */
+static struct os_callout *
+os_callout_wheel_expired(os_time_t slot_tick, os_time_t now)
+{
+    struct os_callout *c;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    TAILQ_FOREACH(c, OS_CALLOUT_SLOT(slot_tick), c_next) {
+        if (OS_TIME_TICK_GEQ(now, c->c_ticks)) {
+            os_callout_list_remove(c);
             break;
         }
     }
+    OS_EXIT_CRITICAL(sr);
 
-    if (entry) {
-        TAILQ_INSERT_BEFORE(entry, c, c_next);
-    } else {
-        TAILQ_INSERT_TAIL(&g_callout_list, c, c_next);
+    return (c);
+}
+
+/**
+ * This function is called by the OS in the time tick.  It visits the wheel
+ * slots of every tick that elapsed since the previous call (at most one full
+ * revolution) and posts an event for each expired callout to the event
+ * queue provided to os_callout_func_init().
+ */
+void
+os_callout_tick(void)
+{
+    struct os_callout *c;
+    os_time_t slot_tick;
+    uint32_t now;
+    uint32_t nslots;
+
+    now = os_time_get();
+
+    nslots = now - g_callout_wheel_tick;
+    if (nslots > OS_CALLOUT_WHEEL_SLOTS) {
+        nslots = OS_CALLOUT_WHEEL_SLOTS;
     }
+    slot_tick = now - nslots;
+    g_callout_wheel_tick = now;
 
-    OS_EXIT_CRITICAL(sr);
+    while (nslots-- > 0) {
+        slot_tick++;
+        while ((c = os_callout_wheel_expired(slot_tick, now)) != NULL) {
+            OS_TRACE_REC(OS_TRACE_T_CALLOUT, c);
+            os_eventq_put(c->c_evq, &c->c_ev);
+        }
+    }
+}
 
-    return (0);
-err:
-    return (rc);
+/*
+ * Returns the number of ticks to the first pending callout. If there are no
+ * pending callouts then return OS_TIMEOUT_NEVER instead.
+ *
+ * Slots between the last one processed by os_callout_tick() and 'now' may
+ * hold callouts which are already due; any of those means 0.  The wheel is
+ * then walked forward from 'now'; the first slot holding a callout that
+ * expires within one revolution gives the answer.  Otherwise every pending
+ * callout is further away than that and the earliest is used.  This is only
+ * called from the idle task, so the walk is not on the tick path.
+ *
+ * @param now The time now
+ *
+ * @return Number of ticks to first pending callout
+ */
+os_time_t
+os_callout_wakeup_ticks(os_time_t now)
+{
+    struct os_callout *c;
+    os_time_t rt;
+    os_time_t delta;
+    os_time_t behind;
+    int i;
+
+    OS_ASSERT_CRITICAL();
+
+    if (g_callout_wheel_cnt == 0) {
+        return (OS_TIMEOUT_NEVER);
+    }
+
+    if (OS_TIME_TICK_GT(now, g_callout_wheel_tick)) {
+        behind = now - g_callout_wheel_tick;
+        if (behind > OS_CALLOUT_WHEEL_SLOTS) {
+            behind = OS_CALLOUT_WHEEL_SLOTS;
+        }
+        for (i = 0; i < behind; i++) {
+            TAILQ_FOREACH(c, OS_CALLOUT_SLOT(now - i), c_next) {
+                if (!OS_TIME_TICK_GT(c->c_ticks, now)) {
+                    return (0);
+                }
+            }
+        }
+    }
+
+    rt = OS_TIMEOUT_NEVER;
+    for (i = 0; i < OS_CALLOUT_WHEEL_SLOTS; i++) {
+        TAILQ_FOREACH(c, OS_CALLOUT_SLOT(now + i), c_next) {
+            if (!OS_TIME_TICK_GT(c->c_ticks, now)) {
+                return (0);     /* callout time is in the past */
+            }
+            delta = c->c_ticks - now;
+            if (delta < rt) {
+                rt = delta;
+            }
+        }
+        if (rt < OS_CALLOUT_WHEEL_SLOTS) {
+            break;
+        }
+    }
+
+    return (rt);
 }
 
+#else
+
 /**
  * This function is called by the OS in the time tick.  It searches the list
  * of callouts, and sees if any of them are ready to run.  If they are ready
@@ -153,8 +349,7 @@ os_callout_tick(void)
         c = TAILQ_FIRST(&g_callout_list);
         if (c) {
             if (OS_TIME_TICK_GEQ(now, c->c_ticks)) {
-                TAILQ_REMOVE(&g_callout_list, c, c_next);
-                c->c_next.tqe_prev = NULL;
+                os_callout_list_remove(c);
             } else {
                 c = NULL;
             }
@@ -162,6 +357,7 @@ os_callout_tick(void)
         OS_EXIT_CRITICAL(sr);
 
         if (c) {
+            OS_TRACE_REC(OS_TRACE_T_CALLOUT, c);
             os_eventq_put(c->c_evq, &c->c_ev);
         } else {
             break;
@@ -198,3 +394,5 @@ os_callout_wakeup_ticks(os_time_t now)
 
     return (rt);
 }
+
+#endif /* OS_CALLOUT_WHEEL */
@@ -20,8 +20,31 @@
 
 #include "os/os.h"
 
+#include <assert.h>
 #include <string.h>
 
+/*
+ * Removes and returns the first event on a queue, or NULL if the queue is
+ * empty.  Must be called with interrupts disabled.
+ */
+static struct os_event *
+os_eventq_pull(struct os_eventq *evq)
+{
+    struct os_event *ev;
+
+    ev = STAILQ_FIRST(&evq->evq_list);
+    if (ev) {
+        STAILQ_REMOVE_HEAD(&evq->evq_list, ev_next);
+        ev->ev_queued = 0;
+        OS_TRACE_REC(OS_TRACE_T_EVQ_GET, ev);
+        if (evq->evq_set && STAILQ_EMPTY(&evq->evq_list)) {
+            evq->evq_set->evs_ready &= ~(1UL << evq->evq_set_idx);
+        }
+    }
+
+    return ev;
+}
+
 /**
  * Initialize the event queue
  *
@@ -34,31 +57,35 @@ os_eventq_init(struct os_eventq *evq)
     STAILQ_INIT(&evq->evq_list);
 }
 
-/**
- * Put an event on the event queue.
+/*
+ * Queue an event and wake up the task waiting on the queue, if any.  Must be
+ * called with interrupts disabled.
  *
- * @param evq The event queue to put an event on 
- * @param ev The event to put on the queue
+ * @return 1 if a task was woken up and a reschedule is needed, 0 otherwise.
  */
-void
-os_eventq_put(struct os_eventq *evq, struct os_event *ev)
+static int
+os_eventq_insert(struct os_eventq *evq, struct os_event *ev)
 {
+    struct os_eventset *set;
     int resched;
-    os_sr_t sr;
-
-    OS_ENTER_CRITICAL(sr);
-
-    /* Do not queue if already queued */
-    if (OS_EVENT_QUEUED(ev)) {
-        OS_EXIT_CRITICAL(sr);
-        return;
-    }
 
     /* Queue the event */
     ev->ev_queued = 1;
     STAILQ_INSERT_TAIL(&evq->evq_list, ev, ev_next);
+    OS_TRACE_REC(OS_TRACE_T_EVQ_PUT, ev);
 
     resched = 0;
+    if (evq->evq_set) {
+        set = evq->evq_set;
+        set->evs_ready |= 1UL << evq->evq_set_idx;
+        if (set->evs_task) {
+            if (set->evs_task->t_state == OS_TASK_SLEEP) {
+                os_sched_wakeup(set->evs_task);
+                resched = 1;
+            }
+            set->evs_task = NULL;
+        }
+    }
     if (evq->evq_task) {
         /* If task waiting on event, wake it up.
          * Check if task is sleeping, because another event 
@@ -74,6 +101,31 @@ os_eventq_put(struct os_eventq *evq, struct os_event *ev)
         evq->evq_task = NULL;
     }
 
+    return (resched);
+}
+
+/**
+ * Put an event on the event queue.
+ *
+ * @param evq The event queue to put an event on 
+ * @param ev The event to put on the queue
+ */
+void
+os_eventq_put(struct os_eventq *evq, struct os_event *ev)
+{
+    int resched;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+
+    /* Do not queue if already queued */
+    if (OS_EVENT_QUEUED(ev)) {
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+
+    resched = os_eventq_insert(evq, ev);
+
     OS_EXIT_CRITICAL(sr);
 
     if (resched) {
@@ -81,6 +133,82 @@ os_eventq_put(struct os_eventq *evq, struct os_event *ev)
     }
 }
 
+/**
+ * Initialize a coalescing event.
+ *
+ * @param cev The coalescing event to initialize
+ * @param type The event type, returned in ev_type when the event is pulled
+ * @param arg The event argument, returned in ev_arg
+ */
+void
+os_cevent_init(struct os_cevent *cev, uint8_t type, void *arg)
+{
+    memset(cev, 0, sizeof(*cev));
+    cev->ce_ev.ev_type = type;
+    cev->ce_ev.ev_arg = arg;
+}
+
+/**
+ * Post a coalescing event.  Each post is counted and its bits are merged
+ * into the event; the event is queued only by the first post since the
+ * last os_cevent_take(), so a burst of posts wakes the receiving task
+ * once.  May be called from interrupt context.
+ *
+ * @param evq The event queue to put the event on
+ * @param cev The coalescing event to post
+ * @param bits Bits to OR into the event's accumulated bits
+ */
+void
+os_cevent_put(struct os_eventq *evq, struct os_cevent *cev, uint32_t bits)
+{
+    int resched;
+    os_sr_t sr;
+
+    resched = 0;
+
+    OS_ENTER_CRITICAL(sr);
+    cev->ce_cnt++;
+    cev->ce_bits |= bits;
+    if (!OS_EVENT_QUEUED(&cev->ce_ev)) {
+        resched = os_eventq_insert(evq, &cev->ce_ev);
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    if (resched) {
+        os_sched(NULL);
+    }
+}
+
+/**
+ * Collect the posts accumulated on a coalescing event and reset it.  Called
+ * by the receiving task after pulling the event.  Posts that arrive after
+ * the event was pulled but before this call are included here, so the
+ * requeued event may later come back with a count of zero.
+ *
+ * @param cev The coalescing event
+ * @param bits On success, the accumulated bits are written here; may be
+ *             NULL.
+ *
+ * @return The number of posts since the previous call.
+ */
+uint32_t
+os_cevent_take(struct os_cevent *cev, uint32_t *bits)
+{
+    uint32_t cnt;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    cnt = cev->ce_cnt;
+    if (bits != NULL) {
+        *bits = cev->ce_bits;
+    }
+    cev->ce_cnt = 0;
+    cev->ce_bits = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    return (cnt);
+}
+
 /**
  * Pull a single item from an event queue.  This function blocks until there 
  * is an item on the event queue to read.
@@ -97,11 +225,8 @@ os_eventq_get(struct os_eventq *evq)
 
     OS_ENTER_CRITICAL(sr);
 pull_one:
-    ev = STAILQ_FIRST(&evq->evq_list);
-    if (ev) {
-        STAILQ_REMOVE(&evq->evq_list, ev, os_event, ev_next);
-        ev->ev_queued = 0;
-    } else {
+    ev = os_eventq_pull(evq);
+    if (!ev) {
         evq->evq_task = os_sched_get_current_task();
         os_sched_sleep(evq->evq_task, OS_TIMEOUT_NEVER);
         OS_EXIT_CRITICAL(sr);
@@ -128,10 +253,8 @@ os_eventq_poll_0timo(struct os_eventq **evq, int nevqs)
 
     OS_ENTER_CRITICAL(sr);
     for (i = 0; i < nevqs; i++) {
-        ev = STAILQ_FIRST(&evq[i]->evq_list);
+        ev = os_eventq_pull(evq[i]);
         if (ev) {
-            STAILQ_REMOVE(&evq[i]->evq_list, ev, os_event, ev_next);
-            ev->ev_queued = 0;
             break;
         }
     }
@@ -173,10 +296,8 @@ os_eventq_poll(struct os_eventq **evq, int nevqs, os_time_t timo)
     cur_t = os_sched_get_current_task();
 
     for (i = 0; i < nevqs; i++) {
-        ev = STAILQ_FIRST(&evq[i]->evq_list);
+        ev = os_eventq_pull(evq[i]);
         if (ev) {
-            STAILQ_REMOVE(&evq[i]->evq_list, ev, os_event, ev_next);
-            ev->ev_queued = 0;
             /* Reset the items that already have an evq task set. */
             for (j = 0; j < i; j++) {
                 evq[j]->evq_task = NULL;
@@ -201,11 +322,7 @@ os_eventq_poll(struct os_eventq **evq, int nevqs, os_time_t timo)
          * we haven't found one.
          */
         if (!ev) {
-            ev = STAILQ_FIRST(&evq[i]->evq_list);
-            if (ev) {
-                STAILQ_REMOVE(&evq[i]->evq_list, ev, os_event, ev_next);
-                ev->ev_queued = 0;
-            }
+            ev = os_eventq_pull(evq[i]);
         }
         evq[i]->evq_task = NULL;
     }
@@ -229,7 +346,99 @@ os_eventq_remove(struct os_eventq *evq, struct os_event *ev)
     OS_ENTER_CRITICAL(sr);
     if (OS_EVENT_QUEUED(ev)) {
         STAILQ_REMOVE(&evq->evq_list, ev, os_event, ev_next);
+        if (evq->evq_set && STAILQ_EMPTY(&evq->evq_list)) {
+            evq->evq_set->evs_ready &= ~(1UL << evq->evq_set_idx);
+        }
     }
     ev->ev_queued = 0;
     OS_EXIT_CRITICAL(sr);
 }
+
+/**
+ * Initialize an event set.
+ *
+ * @param set The event set to initialize
+ */
+void
+os_eventset_init(struct os_eventset *set)
+{
+    memset(set, 0, sizeof(*set));
+}
+
+/**
+ * Add an event queue to an event set.  Queues added first are served first
+ * by os_eventset_get().  A queue can belong to at most one set, and once
+ * added it should only be read through the set.
+ *
+ * @param set The event set to add the queue to
+ * @param evq The event queue to add
+ *
+ * @return 0 on success; OS_EINVAL if the queue already belongs to a set;
+ *         OS_ENOMEM if the set is full.
+ */
+int
+os_eventset_add(struct os_eventset *set, struct os_eventq *evq)
+{
+    os_sr_t sr;
+    int rc;
+
+    OS_ENTER_CRITICAL(sr);
+    if (evq->evq_set != NULL) {
+        rc = OS_EINVAL;
+    } else if (set->evs_cnt >= OS_EVENTSET_MAX_QUEUES) {
+        rc = OS_ENOMEM;
+    } else {
+        evq->evq_set = set;
+        evq->evq_set_idx = set->evs_cnt;
+        set->evs_q[set->evs_cnt++] = evq;
+        if (!STAILQ_EMPTY(&evq->evq_list)) {
+            set->evs_ready |= 1UL << evq->evq_set_idx;
+        }
+        rc = 0;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return rc;
+}
+
+/**
+ * Pull an event from the highest priority non-empty queue of an event set,
+ * waiting up to 'timo' ticks for one to be posted.  Finding the queue takes
+ * constant time, independent of the number of member queues.
+ *
+ * @param set The event set to pull an event from
+ * @param timo Timeout, forever if OS_WAIT_FOREVER is passed; 0 to return
+ *             immediately.
+ *
+ * @return An event, or NULL if the timeout expired first
+ */
+struct os_event *
+os_eventset_get(struct os_eventset *set, os_time_t timo)
+{
+    struct os_event *ev;
+    struct os_task *cur_t;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    if (set->evs_ready == 0 && timo != 0) {
+        cur_t = os_sched_get_current_task();
+        assert(set->evs_task == NULL || set->evs_task == cur_t);
+
+        set->evs_task = cur_t;
+        os_sched_sleep(cur_t, timo);
+        OS_EXIT_CRITICAL(sr);
+
+        os_sched(NULL);
+
+        OS_ENTER_CRITICAL(sr);
+        set->evs_task = NULL;
+    }
+
+    ev = NULL;
+    if (set->evs_ready != 0) {
+        ev = os_eventq_pull(set->evs_q[__builtin_ctz(set->evs_ready)]);
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return ev;
+}
@@ -19,11 +19,148 @@
 
 
 #include <assert.h>
+#include <string.h>
+#include "os/os.h"
 #include "os/os_mutex.h"
 #include "os/os_heap.h"
+#include "os/os_malloc_class.h"
 
 static struct os_mutex os_malloc_mutex;
 
+#if OS_MALLOC_SLAB
+
+STATS_NAME_START(os_malloc_class)
+    STATS_NAME(os_malloc_class, allocs)
+    STATS_NAME(os_malloc_class, frees)
+    STATS_NAME(os_malloc_class, exhausted)
+    STATS_NAME(os_malloc_class, max_in_use)
+STATS_NAME_END(os_malloc_class)
+
+/* Registered size classes, sorted by ascending block size. */
+static STAILQ_HEAD(, os_malloc_class) os_malloc_classes =
+    STAILQ_HEAD_INITIALIZER(os_malloc_classes);
+
+/**
+ * Registers a size class with os_malloc().  Requests of up to 'block_size'
+ * bytes are served from this class, if it is the smallest one that fits and
+ * has a free block.  Classes are expected to be registered during system
+ * initialization, before os_malloc() is used.
+ *
+ * @param omc           The size class to initialize
+ * @param block_size    The size of each block, in bytes
+ * @param nblocks       The number of blocks in the class
+ * @param membuf        Memory to contain the blocks; must be at least
+ *                          OS_MEMPOOL_BYTES(nblocks, block_size) long.
+ * @param name          The name of the class; also used as the name of its
+ *                          statistics group.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+int
+os_malloc_class_init(struct os_malloc_class *omc, int block_size,
+                     int nblocks, void *membuf, char *name)
+{
+    struct os_malloc_class *prev;
+    struct os_malloc_class *cur;
+    int rc;
+
+    rc = os_mempool_init(&omc->omc_pool, nblocks, block_size, membuf, name);
+    if (rc != 0) {
+        return rc;
+    }
+
+    if (stats_group_find(name) == STATS_HDR(omc->omc_stats)) {
+        /*
+         * Registered again after os_malloc_class_reset(); stats groups
+         * can't be unregistered, so keep the group and clear its counts.
+         */
+        memset((uint8_t *)&omc->omc_stats + sizeof(struct stats_hdr), 0,
+               sizeof(omc->omc_stats) - sizeof(struct stats_hdr));
+    } else {
+        rc = stats_init_and_reg(
+            STATS_HDR(omc->omc_stats),
+            STATS_SIZE_INIT_PARMS(omc->omc_stats, STATS_SIZE_32),
+            STATS_NAME_INIT_PARMS(os_malloc_class), name);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    prev = NULL;
+    STAILQ_FOREACH(cur, &os_malloc_classes, omc_next) {
+        if (cur->omc_pool.mp_block_size > block_size) {
+            break;
+        }
+        prev = cur;
+    }
+    if (prev == NULL) {
+        STAILQ_INSERT_HEAD(&os_malloc_classes, omc, omc_next);
+    } else {
+        STAILQ_INSERT_AFTER(&os_malloc_classes, prev, omc, omc_next);
+    }
+
+    return 0;
+}
+
+/**
+ * Unregisters all size classes, and removes their memory pools from the
+ * mempool list.  This is likely only useful for unit tests.
+ */
+void
+os_malloc_class_reset(void)
+{
+    struct os_malloc_class *omc;
+
+    STAILQ_FOREACH(omc, &os_malloc_classes, omc_next) {
+        os_mempool_unregister(&omc->omc_pool);
+    }
+    STAILQ_INIT(&os_malloc_classes);
+}
+
+static void *
+os_malloc_class_get(size_t size)
+{
+    struct os_malloc_class *omc;
+    void *ptr;
+    int in_use;
+
+    STAILQ_FOREACH(omc, &os_malloc_classes, omc_next) {
+        if (omc->omc_pool.mp_block_size < size) {
+            continue;
+        }
+
+        ptr = os_memblock_get(&omc->omc_pool);
+        if (ptr != NULL) {
+            STATS_INC(omc->omc_stats, allocs);
+            in_use = omc->omc_pool.mp_num_blocks - omc->omc_pool.mp_num_free;
+            if (in_use > omc->omc_stats.smax_in_use) {
+                omc->omc_stats.smax_in_use = in_use;
+            }
+            return ptr;
+        }
+
+        STATS_INC(omc->omc_stats, exhausted);
+    }
+
+    return NULL;
+}
+
+static struct os_malloc_class *
+os_malloc_class_find(void *ptr)
+{
+    struct os_malloc_class *omc;
+
+    STAILQ_FOREACH(omc, &os_malloc_classes, omc_next) {
+        if (os_memblock_from(&omc->omc_pool, ptr)) {
+            return omc;
+        }
+    }
+
+    return NULL;
+}
+
+#endif /* OS_MALLOC_SLAB */
+
 static void
 os_malloc_lock(void)
 {
@@ -61,6 +198,14 @@ os_malloc(size_t size)
 {
     void *ptr;
 
+#if OS_MALLOC_SLAB
+    /* Memory pools are interrupt safe; no need for the heap lock. */
+    ptr = os_malloc_class_get(size);
+    if (ptr != NULL) {
+        return ptr;
+    }
+#endif
+
     os_malloc_lock();
     ptr = malloc(size);
     os_malloc_unlock();
@@ -78,6 +223,21 @@ os_malloc(size_t size)
 void
 os_free(void *mem)
 {
+#if OS_MALLOC_SLAB
+    struct os_malloc_class *omc;
+
+    if (mem == NULL) {
+        return;
+    }
+
+    omc = os_malloc_class_find(mem);
+    if (omc != NULL) {
+        os_memblock_put(&omc->omc_pool, mem);
+        STATS_INC(omc->omc_stats, frees);
+        return;
+    }
+#endif
+
     os_malloc_lock();
     free(mem);
     os_malloc_unlock();
@@ -98,6 +258,27 @@ os_realloc(void *ptr, size_t size)
 {
     void *new_ptr;
 
+#if OS_MALLOC_SLAB
+    struct os_malloc_class *omc;
+
+    if (ptr != NULL) {
+        omc = os_malloc_class_find(ptr);
+        if (omc != NULL) {
+            /* Keep the block if the new size still fits in it. */
+            if (size <= omc->omc_pool.mp_block_size) {
+                return ptr;
+            }
+
+            new_ptr = os_malloc(size);
+            if (new_ptr != NULL) {
+                memcpy(new_ptr, ptr, omc->omc_pool.mp_block_size);
+                os_free(ptr);
+            }
+            return new_ptr;
+        }
+    }
+#endif
+
     os_malloc_lock();
     new_ptr = realloc(ptr, size);
     os_malloc_unlock();
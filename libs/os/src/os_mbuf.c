@@ -39,9 +39,14 @@
 #include <string.h>
 #include <limits.h>
 
+#include <util/crc16.h>
+
 STAILQ_HEAD(, os_mbuf_pool) g_msys_pool_list =
     STAILQ_HEAD_INITIALIZER(g_msys_pool_list);
 
+/* Maximum number of mbufs os_mbuf_append() allocates in one pool access. */
+#define OS_MBUF_APPEND_BATCH    (8)
+
 /**
  * Initialize a mbuf queue.  An mbuf queue is a queue of mbufs that tie
  * to a specific task's event queue.  Mbuf queues are a helper API around
@@ -141,6 +146,131 @@ err:
     return (rc);
 }
 
+/*
+ * Keeps the compiler from moving ring accesses across an index update.
+ * Producer and consumer run on the same core, so the hardware observes
+ * stores in program order.
+ */
+#define OS_MRING_BARRIER()  __asm__ volatile ("" : : : "memory")
+
+/**
+ * Initializes a single-producer, single-consumer mbuf ring.
+ *
+ * @param mr The mbuf ring to initialize
+ * @param ring Storage for "size" mbuf pointers
+ * @param size The number of entries in the ring; must be a power of two
+ * @param arg The argument to provide to the event posted on this ring
+ *
+ * @return 0 on success, OS_EINVAL if "size" is not a power of two.
+ */
+int
+os_mring_init(struct os_mring *mr, struct os_mbuf **ring, uint16_t size,
+              void *arg)
+{
+    struct os_event *ev;
+
+    if (size == 0 || (size & (size - 1)) != 0) {
+        return (OS_EINVAL);
+    }
+
+    mr->mr_ring = ring;
+    mr->mr_mask = size - 1;
+    mr->mr_head = 0;
+    mr->mr_tail = 0;
+
+    ev = &mr->mr_ev;
+    memset(ev, 0, sizeof(*ev));
+    ev->ev_arg = arg;
+    ev->ev_type = OS_EVENT_T_MQUEUE_DATA;
+
+    return (0);
+}
+
+/**
+ * Adds an mbuf to the ring and posts the ring's event to "evq".  Must only
+ * be called from the producer context.  The event is only posted if it is
+ * not already queued; the consumer removes it from the event queue before
+ * draining the ring, so no packet is left behind without an event.
+ *
+ * @param mr The mbuf ring to add to
+ * @param evq The event queue to post an OS_EVENT_T_MQUEUE_DATA event to
+ * @param m The mbuf to add
+ *
+ * @return 0 on success, OS_ENOMEM if the ring is full.
+ */
+int
+os_mring_put(struct os_mring *mr, struct os_eventq *evq, struct os_mbuf *m)
+{
+    uint16_t head;
+
+    head = mr->mr_head;
+    if ((uint16_t)(head - mr->mr_tail) > mr->mr_mask) {
+        return (OS_ENOMEM);
+    }
+
+    mr->mr_ring[head & mr->mr_mask] = m;
+    OS_MRING_BARRIER();
+    mr->mr_head = head + 1;
+    OS_MRING_BARRIER();
+
+    if (evq && !OS_EVENT_QUEUED(&mr->mr_ev)) {
+        os_eventq_put(evq, &mr->mr_ev);
+    }
+
+    return (0);
+}
+
+/**
+ * Removes up to "n" mbufs from the ring in one pass.  Must only be called
+ * from the consumer context.
+ *
+ * @param mr The mbuf ring to drain
+ * @param out Array to fill with the removed mbufs, oldest first
+ * @param n The size of "out"
+ *
+ * @return The number of mbufs removed.
+ */
+int
+os_mring_get_n(struct os_mring *mr, struct os_mbuf **out, int n)
+{
+    uint16_t tail;
+    int cnt;
+    int i;
+
+    tail = mr->mr_tail;
+    cnt = min((uint16_t)(mr->mr_head - tail), n);
+    OS_MRING_BARRIER();
+
+    for (i = 0; i < cnt; i++) {
+        out[i] = mr->mr_ring[(tail + i) & mr->mr_mask];
+    }
+
+    OS_MRING_BARRIER();
+    mr->mr_tail = tail + cnt;
+
+    return (cnt);
+}
+
+/**
+ * Removes and returns the oldest mbuf in the ring.  Does not block.  Must
+ * only be called from the consumer context.
+ *
+ * @param mr The mbuf ring to pull an mbuf from
+ *
+ * @return The next mbuf in the ring, or NULL if the ring is empty.
+ */
+struct os_mbuf *
+os_mring_get(struct os_mring *mr)
+{
+    struct os_mbuf *m;
+
+    if (os_mring_get_n(mr, &m, 1) == 0) {
+        return (NULL);
+    }
+
+    return (m);
+}
+
 /**
  * MSYS is a system level mbuf registry.  Allows the system to share
  * packet buffers amongst the various networking stacks that can be running
@@ -148,7 +278,8 @@ err:
  *
  * Mbuf pools are created in the system initialization code, and then when
  * a mbuf is allocated out of msys, it will try and find the best fit based
- * upon estimated mbuf size.
+ * upon estimated mbuf size.  If the best fit pool is exhausted, larger pools
+ * are tried in turn (see OS_MSYS_FALLBACK).
  *
  * os_msys_register() registers a mbuf pool with MSYS, and allows MSYS to
  * allocate mbufs out of it.
@@ -160,19 +291,22 @@ err:
 int
 os_msys_register(struct os_mbuf_pool *new_pool)
 {
+    struct os_mbuf_pool *prev;
     struct os_mbuf_pool *pool;
 
-    pool = NULL;
+    /* Keep the list sorted by increasing buffer size. */
+    prev = NULL;
     STAILQ_FOREACH(pool, &g_msys_pool_list, omp_next) {
-        if (new_pool->omp_databuf_len > pool->omp_databuf_len) {
+        if (new_pool->omp_databuf_len < pool->omp_databuf_len) {
             break;
         }
+        prev = pool;
     }
 
-    if (pool) {
-        STAILQ_INSERT_AFTER(&g_msys_pool_list, pool, new_pool, omp_next);
+    if (prev) {
+        STAILQ_INSERT_AFTER(&g_msys_pool_list, prev, new_pool, omp_next);
     } else {
-        STAILQ_INSERT_TAIL(&g_msys_pool_list, new_pool, omp_next);
+        STAILQ_INSERT_HEAD(&g_msys_pool_list, new_pool, omp_next);
     }
 
     return (0);
@@ -227,7 +361,19 @@ os_msys_get(uint16_t dsize, uint16_t leadingspace)
         goto err;
     }
 
-    m = os_mbuf_get(pool, leadingspace);
+    while (1) {
+        m = os_mbuf_get(pool, leadingspace);
+#if OS_MSYS_FALLBACK
+        if (m == NULL) {
+            pool = STAILQ_NEXT(pool, omp_next);
+            if (pool != NULL) {
+                continue;
+            }
+        }
+#endif
+        break;
+    }
+
     return (m);
 err:
     return (NULL);
@@ -255,7 +401,19 @@ os_msys_get_pkthdr(uint16_t dsize, uint16_t user_hdr_len)
         goto err;
     }
 
-    m = os_mbuf_get_pkthdr(pool, user_hdr_len);
+    while (1) {
+        m = os_mbuf_get_pkthdr(pool, user_hdr_len);
+#if OS_MSYS_FALLBACK
+        if (m == NULL) {
+            pool = STAILQ_NEXT(pool, omp_next);
+            if (pool != NULL) {
+                continue;
+            }
+        }
+#endif
+        break;
+    }
+
     return (m);
 err:
     return (NULL);
@@ -283,6 +441,35 @@ os_mbuf_pool_init(struct os_mbuf_pool *omp, struct os_mempool *mp,
     return (0);
 }
 
+/**
+ * Initialize a memory pool over the supplied buffer, and an mbuf pool on
+ * top of it.  Used by OS_MBUF_POOL_INIT().
+ *
+ * @param omp     The mbuf pool to initialize
+ * @param mp      The memory pool to initialize
+ * @param membuf  The buffer for the memory pool; must be at least
+ *                OS_MEMPOOL_BYTES(nbufs, buf_len) bytes
+ * @param nbufs   The number of buffers in the pool
+ * @param buf_len The length of each buffer, including the mbuf header
+ * @param name    The name of the memory pool
+ *
+ * @return 0 on success, error code on failure.
+ */
+int
+os_mbuf_pool_create(struct os_mbuf_pool *omp, struct os_mempool *mp,
+                    void *membuf, uint16_t nbufs, uint16_t buf_len,
+                    char *name)
+{
+    int rc;
+
+    rc = os_mempool_init(mp, nbufs, buf_len, membuf, name);
+    if (rc != 0) {
+        return (rc);
+    }
+
+    return (os_mbuf_pool_init(omp, mp, buf_len, nbufs));
+}
+
 /**
  * Get an mbuf from the mbuf pool.  The mbuf is allocated, and initialized
  * prior to being returned.
@@ -293,6 +480,82 @@ os_mbuf_pool_init(struct os_mbuf_pool *omp, struct os_mempool *mp,
  *
  * @return An initialized mbuf on success, and NULL on failure.
  */
+static inline void
+_os_mbuf_init(struct os_mbuf *om, struct os_mbuf_pool *omp,
+              uint16_t leadingspace)
+{
+    SLIST_NEXT(om, om_next) = NULL;
+    om->om_flags = 0;
+    om->om_pkthdr_len = 0;
+    om->om_len = 0;
+    om->om_data = (&om->om_databuf[0] + leadingspace);
+    om->om_omp = omp;
+}
+
+/*
+ * The external buffer descriptor is stored at the end of the mbuf's unused
+ * data buffer, so that it stays put when a packet header is moved off the
+ * mbuf.
+ */
+#define OS_MBUF_EXT_PTR(__om)                                       \
+    ((__om)->om_databuf + (__om)->om_omp->omp_databuf_len -         \
+     sizeof (struct os_mbuf_ext *))
+
+static inline struct os_mbuf_ext *
+_os_mbuf_ext(const struct os_mbuf *om)
+{
+    struct os_mbuf_ext *ext;
+
+    memcpy(&ext, OS_MBUF_EXT_PTR(om), sizeof ext);
+    return (ext);
+}
+
+/*
+ * Makes "om" refer to "len" bytes of external data at "data" and takes a
+ * reference to the descriptor.
+ */
+static void
+_os_mbuf_ext_attach(struct os_mbuf *om, struct os_mbuf_ext *ext,
+                    const uint8_t *data, uint16_t len)
+{
+    os_sr_t sr;
+
+    assert(om->om_omp->omp_databuf_len >= om->om_pkthdr_len + sizeof ext);
+
+    memcpy(OS_MBUF_EXT_PTR(om), &ext, sizeof ext);
+    om->om_flags |= OS_MBUF_F_MASK(OS_MBUF_F_EXT);
+    om->om_data = (uint8_t *)data;
+    om->om_len = len;
+
+    OS_ENTER_CRITICAL(sr);
+    ext->ome_refcnt++;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/* Drops the reference an mbuf holds on its external buffer, if any. */
+static void
+_os_mbuf_ext_release(struct os_mbuf *om)
+{
+    struct os_mbuf_ext *ext;
+    os_sr_t sr;
+    int last;
+
+    if (!OS_MBUF_IS_EXT(om)) {
+        return;
+    }
+
+    ext = _os_mbuf_ext(om);
+
+    OS_ENTER_CRITICAL(sr);
+    assert(ext->ome_refcnt > 0);
+    last = --ext->ome_refcnt == 0;
+    OS_EXIT_CRITICAL(sr);
+
+    if (last && ext->ome_free != NULL) {
+        ext->ome_free(ext);
+    }
+}
+
 struct os_mbuf *
 os_mbuf_get(struct os_mbuf_pool *omp, uint16_t leadingspace)
 {
@@ -307,12 +570,7 @@ os_mbuf_get(struct os_mbuf_pool *omp, uint16_t leadingspace)
         goto err;
     }
 
-    SLIST_NEXT(om, om_next) = NULL;
-    om->om_flags = 0;
-    om->om_pkthdr_len = 0;
-    om->om_len = 0;
-    om->om_data = (&om->om_databuf[0] + leadingspace);
-    om->om_omp = omp;
+    _os_mbuf_init(om, omp, leadingspace);
 
     return (om);
 err:
@@ -367,6 +625,8 @@ os_mbuf_free(struct os_mbuf *om)
 {
     int rc;
 
+    _os_mbuf_ext_release(om);
+
     if (om->om_omp != NULL) {
         rc = os_memblock_put(om->om_omp->omp_pool, om);
         if (rc != 0) {
@@ -390,18 +650,50 @@ err:
 int
 os_mbuf_free_chain(struct os_mbuf *om)
 {
+    struct os_mbuf_pool *omp;
+    struct os_memblock *first;
+    struct os_memblock *last;
+    struct os_memblock *block;
     struct os_mbuf *next;
     int rc;
 
+    /*
+     * Consecutive mbufs from the same pool are relinked through their
+     * memory block header and returned to the pool with a single
+     * os_memblock_put_list() call. The block header overlays om_data, so
+     * mbufs that don't belong to a pool are left untouched.
+     */
     while (om != NULL) {
-        next = SLIST_NEXT(om, om_next);
+        omp = om->om_omp;
+        if (omp == NULL) {
+            next = SLIST_NEXT(om, om_next);
+            _os_mbuf_ext_release(om);
+            om = next;
+            continue;
+        }
+
+        first = NULL;
+        last = NULL;
+        while (om != NULL && om->om_omp == omp) {
+            next = SLIST_NEXT(om, om_next);
+            _os_mbuf_ext_release(om);
+
+            block = (struct os_memblock *)om;
+            SLIST_NEXT(block, mb_next) = NULL;
+            if (last == NULL) {
+                first = block;
+            } else {
+                SLIST_NEXT(last, mb_next) = block;
+            }
+            last = block;
+
+            om = next;
+        }
 
-        rc = os_mbuf_free(om);
+        rc = os_memblock_put_list(omp->omp_pool, first);
         if (rc != 0) {
             goto err;
         }
-
-        om = next;
     }
 
     return (0);
@@ -439,12 +731,15 @@ _os_mbuf_copypkthdr(struct os_mbuf *new_buf, struct os_mbuf *old_buf)
 int
 os_mbuf_append(struct os_mbuf *om, const void *data,  uint16_t len)
 {
+    void *blocks[OS_MBUF_APPEND_BATCH];
     struct os_mbuf_pool *omp;
     struct os_mbuf *last;
     struct os_mbuf *new;
     int remainder;
+    int nblocks;
     int space;
     int rc;
+    int i;
 
     if (om == NULL) {
         rc = OS_EINVAL;
@@ -478,20 +773,28 @@ os_mbuf_append(struct os_mbuf *om, const void *data,  uint16_t len)
     }
 
     /* Take the remaining data, and keep allocating new mbufs and copying
-     * data into it, until data is exhausted.
+     * data into it, until data is exhausted.  The mbufs are taken from the
+     * pool in batches to limit the number of critical sections entered.
      */
     while (remainder > 0) {
-        new = os_mbuf_get(omp, 0);
-        if (!new) {
+        nblocks = (remainder + omp->omp_databuf_len - 1) /
+                  omp->omp_databuf_len;
+        nblocks = os_memblock_get_n(omp->omp_pool, blocks,
+                                    min(nblocks, OS_MBUF_APPEND_BATCH));
+        if (nblocks == 0) {
             break;
         }
 
-        new->om_len = min(omp->omp_databuf_len, remainder);
-        memcpy(OS_MBUF_DATA(new, void *), data, new->om_len);
-        data += new->om_len;
-        remainder -= new->om_len;
-        SLIST_NEXT(last, om_next) = new;
-        last = new;
+        for (i = 0; i < nblocks; i++) {
+            new = blocks[i];
+            _os_mbuf_init(new, omp, 0);
+            new->om_len = min(omp->omp_databuf_len, remainder);
+            memcpy(OS_MBUF_DATA(new, void *), data, new->om_len);
+            data += new->om_len;
+            remainder -= new->om_len;
+            SLIST_NEXT(last, om_next) = new;
+            last = new;
+        }
     }
 
     /* Adjust the packet header length in the buffer */
@@ -554,8 +857,65 @@ os_mbuf_appendfrom(struct os_mbuf *dst, const struct os_mbuf *src,
     return 0;
 }
 
+/**
+ * Initializes a descriptor for external data.  The descriptor must remain
+ * valid until its free function is called, or for as long as any mbuf
+ * refers to it if there is none.
+ *
+ * @param ext The descriptor to initialize
+ * @param buf The external data
+ * @param len The length of the external data
+ * @param free_fn Called when the last referring mbuf is freed, or NULL
+ * @param arg Argument stored in the descriptor for the owner's use
+ */
+void
+os_mbuf_ext_init(struct os_mbuf_ext *ext, const void *buf, uint16_t len,
+                 os_mbuf_ext_free_fn *free_fn, void *arg)
+{
+    ext->ome_buf = buf;
+    ext->ome_free = free_fn;
+    ext->ome_arg = arg;
+    ext->ome_len = len;
+    ext->ome_refcnt = 0;
+}
+
+/**
+ * Allocates an mbuf that refers to part of an external buffer rather than
+ * holding a copy of it.  The mbuf has no leading or trailing space, so
+ * data appended to or prepended onto it goes into new mbufs.
+ *
+ * @param omp The mbuf pool to allocate the mbuf header out of
+ * @param ext The external buffer descriptor
+ * @param off The offset of the data within the external buffer
+ * @param len The amount of data to refer to
+ *
+ * @return A freshly allocated mbuf on success, NULL on failure.
+ */
+struct os_mbuf *
+os_mbuf_get_ext(struct os_mbuf_pool *omp, struct os_mbuf_ext *ext,
+                uint16_t off, uint16_t len)
+{
+    struct os_mbuf *om;
+
+    if (off + len > ext->ome_len) {
+        goto err;
+    }
+
+    om = os_mbuf_get(omp, 0);
+    if (!om) {
+        goto err;
+    }
+
+    _os_mbuf_ext_attach(om, ext, ext->ome_buf + off, len);
+
+    return (om);
+err:
+    return (NULL);
+}
+
 /**
  * Duplicate a chain of mbufs.  Return the start of the duplicated chain.
+ * Mbufs referring to external data are duplicated by reference.
  *
  * @param omp The mbuf pool to duplicate out of
  * @param om  The mbuf chain to duplicate
@@ -595,6 +955,12 @@ os_mbuf_dup(struct os_mbuf *om)
             }
             copy = head;
         }
+        if (OS_MBUF_IS_EXT(om)) {
+            copy->om_flags = om->om_flags & ~OS_MBUF_F_MASK(OS_MBUF_F_EXT);
+            _os_mbuf_ext_attach(copy, _os_mbuf_ext(om), om->om_data,
+                                om->om_len);
+            continue;
+        }
         copy->om_flags = om->om_flags;
         copy->om_len = om->om_len;
         memcpy(OS_MBUF_DATA(copy, uint8_t *), OS_MBUF_DATA(om, uint8_t *),
@@ -1032,6 +1398,10 @@ os_mbuf_copyinto(struct os_mbuf *om, int off, const void *src, int len)
     while (1) {
         copylen = min(cur->om_len - cur_off, len);
         if (copylen > 0) {
+            if (OS_MBUF_IS_EXT(cur)) {
+                /* External data is read-only. */
+                return -1;
+            }
             memcpy(cur->om_data + cur_off, sptr, copylen);
             sptr += copylen;
             len -= copylen;
@@ -1241,3 +1611,303 @@ bad:
     os_mbuf_free_chain(om);
     return (NULL);
 }
+
+/* Step over mbufs whose data has been fully consumed by the cursor. */
+static inline void
+os_mbuf_cursor_norm(struct os_mbuf_cursor *cur)
+{
+    while (cur->omc_om != NULL && cur->omc_off >= cur->omc_om->om_len) {
+        cur->omc_off -= cur->omc_om->om_len;
+        cur->omc_om = SLIST_NEXT(cur->omc_om, om_next);
+    }
+}
+
+/**
+ * Describes up to "len" bytes of an mbuf chain, starting "off" bytes from
+ * the beginning, as an array of contiguous segments.  No data is copied;
+ * the segments point directly into the mbufs.
+ *
+ * @param om The mbuf chain to describe
+ * @param off The offset into the mbuf chain to start at
+ * @param len The number of bytes to describe
+ * @param iov The array of segments to fill in
+ * @param iovcnt The number of entries in "iov"
+ *
+ * @return                      The number of segments filled in;
+ *                              -1 if the chain does not contain "len" bytes
+ *                                  or more than "iovcnt" segments are
+ *                                  needed.
+ */
+int
+os_mbuf_iov(const struct os_mbuf *om, int off, int len,
+            struct os_mbuf_iovec *iov, int iovcnt)
+{
+    struct os_mbuf_cursor cur;
+    const uint8_t *data;
+    int cnt;
+    int seg;
+
+    if (os_mbuf_cursor_init(&cur, om, off) != 0) {
+        return (-1);
+    }
+
+    cnt = 0;
+    while (len > 0) {
+        if (cnt >= iovcnt) {
+            return (-1);
+        }
+        seg = os_mbuf_cursor_seg(&cur, &data, len);
+        if (seg == 0) {
+            return (-1);
+        }
+        iov[cnt].omv_base = data;
+        iov[cnt].omv_len = seg;
+        ++cnt;
+        len -= seg;
+    }
+
+    return (cnt);
+}
+
+/**
+ * Positions a cursor "off" bytes from the beginning of an mbuf chain.
+ *
+ * @param cur The cursor to initialize
+ * @param om The mbuf chain to walk
+ * @param off The offset into the mbuf chain
+ *
+ * @return                      0 on success;
+ *                              -1 if the chain is shorter than "off".
+ */
+int
+os_mbuf_cursor_init(struct os_mbuf_cursor *cur, const struct os_mbuf *om,
+                    int off)
+{
+    cur->omc_om = om;
+    cur->omc_off = 0;
+
+    return (os_mbuf_cursor_skip(cur, off));
+}
+
+/**
+ * Returns the longest contiguous run of data at the cursor, up to
+ * "maxlen" bytes, and advances the cursor past it.
+ *
+ * @param cur The cursor to read from
+ * @param data On success, points to the start of the run
+ * @param maxlen The maximum number of bytes to return
+ *
+ * @return                      The length of the run; 0 at the end of the
+ *                                  chain.
+ */
+int
+os_mbuf_cursor_seg(struct os_mbuf_cursor *cur, const uint8_t **data,
+                   int maxlen)
+{
+    int len;
+
+    os_mbuf_cursor_norm(cur);
+    if (cur->omc_om == NULL || maxlen <= 0) {
+        return (0);
+    }
+
+    len = min(cur->omc_om->om_len - cur->omc_off, maxlen);
+    *data = cur->omc_om->om_data + cur->omc_off;
+    cur->omc_off += len;
+
+    return (len);
+}
+
+/**
+ * Advances a cursor by "len" bytes.
+ *
+ * @param cur The cursor to advance
+ * @param len The number of bytes to skip
+ *
+ * @return                      0 on success;
+ *                              -1 if the chain ends first.
+ */
+int
+os_mbuf_cursor_skip(struct os_mbuf_cursor *cur, int len)
+{
+    const uint8_t *data;
+    int seg;
+
+    while (len > 0) {
+        seg = os_mbuf_cursor_seg(cur, &data, len);
+        if (seg == 0) {
+            return (-1);
+        }
+        len -= seg;
+    }
+
+    return (0);
+}
+
+/**
+ * Copies "len" bytes at the cursor into a flat buffer and advances the
+ * cursor past them.
+ *
+ * @param cur The cursor to read from
+ * @param dst The destination buffer
+ * @param len The number of bytes to copy
+ *
+ * @return                      0 on success;
+ *                              -1 if the chain ends first.
+ */
+int
+os_mbuf_cursor_read(struct os_mbuf_cursor *cur, void *dst, int len)
+{
+    const uint8_t *data;
+    uint8_t *udst;
+    int seg;
+
+    udst = dst;
+    while (len > 0) {
+        seg = os_mbuf_cursor_seg(cur, &data, len);
+        if (seg == 0) {
+            return (-1);
+        }
+        memcpy(udst, data, seg);
+        udst += seg;
+        len -= seg;
+    }
+
+    return (0);
+}
+
+/*
+ * Integer readers.  These work regardless of how the value is split across
+ * mbufs and only assemble the bytes they need on the stack.
+ */
+int
+os_mbuf_cursor_get_u8(struct os_mbuf_cursor *cur, uint8_t *val)
+{
+    return (os_mbuf_cursor_read(cur, val, 1));
+}
+
+int
+os_mbuf_cursor_get_le16(struct os_mbuf_cursor *cur, uint16_t *val)
+{
+    uint8_t b[2];
+
+    if (os_mbuf_cursor_read(cur, b, sizeof b) != 0) {
+        return (-1);
+    }
+    *val = (uint16_t)b[0] | ((uint16_t)b[1] << 8);
+
+    return (0);
+}
+
+int
+os_mbuf_cursor_get_le32(struct os_mbuf_cursor *cur, uint32_t *val)
+{
+    uint8_t b[4];
+
+    if (os_mbuf_cursor_read(cur, b, sizeof b) != 0) {
+        return (-1);
+    }
+    *val = (uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+           ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+
+    return (0);
+}
+
+int
+os_mbuf_cursor_get_be16(struct os_mbuf_cursor *cur, uint16_t *val)
+{
+    uint8_t b[2];
+
+    if (os_mbuf_cursor_read(cur, b, sizeof b) != 0) {
+        return (-1);
+    }
+    *val = ((uint16_t)b[0] << 8) | (uint16_t)b[1];
+
+    return (0);
+}
+
+int
+os_mbuf_cursor_get_be32(struct os_mbuf_cursor *cur, uint32_t *val)
+{
+    uint8_t b[4];
+
+    if (os_mbuf_cursor_read(cur, b, sizeof b) != 0) {
+        return (-1);
+    }
+    *val = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+           ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+
+    return (0);
+}
+
+/**
+ * Calls "fn" on each contiguous segment of the next "len" bytes at the
+ * cursor, in order, and advances the cursor past them.  This allows
+ * checksums, hashes and parsers to run directly over the chain.
+ *
+ * @param cur The cursor to read from
+ * @param len The number of bytes to process
+ * @param fn The function to call for each segment
+ * @param arg Argument passed to "fn"
+ *
+ * @return                      0 on success;
+ *                              -1 if the chain ends first;
+ *                              the value returned by "fn" if non-zero.
+ */
+int
+os_mbuf_cursor_apply(struct os_mbuf_cursor *cur, int len,
+                     os_mbuf_apply_fn *fn, void *arg)
+{
+    const uint8_t *data;
+    int seg;
+    int rc;
+
+    while (len > 0) {
+        seg = os_mbuf_cursor_seg(cur, &data, len);
+        if (seg == 0) {
+            return (-1);
+        }
+        rc = fn(arg, data, seg);
+        if (rc != 0) {
+            return (rc);
+        }
+        len -= seg;
+    }
+
+    return (0);
+}
+
+static int
+os_mbuf_crc16_apply(void *arg, const uint8_t *data, uint16_t len)
+{
+    uint16_t *crc;
+
+    crc = arg;
+    *crc = crc16_ccitt(*crc, data, len);
+
+    return (0);
+}
+
+/**
+ * Updates a CRC-16/CCITT with "len" bytes of an mbuf chain starting "off"
+ * bytes from the beginning, without flattening the chain.
+ *
+ * @param om The mbuf chain
+ * @param off The offset into the mbuf chain
+ * @param len The number of bytes to include
+ * @param crc The running CRC; updated in place
+ *
+ * @return                      0 on success;
+ *                              -1 if the chain does not contain enough data.
+ */
+int
+os_mbuf_crc16(const struct os_mbuf *om, int off, int len, uint16_t *crc)
+{
+    struct os_mbuf_cursor cur;
+
+    if (os_mbuf_cursor_init(&cur, om, off) != 0) {
+        return (-1);
+    }
+
+    return (os_mbuf_cursor_apply(&cur, len, os_mbuf_crc16_apply, crc));
+}
@@ -24,9 +24,28 @@
 
 #define OS_MEMPOOL_TRUE_BLOCK_SIZE(bsize)   OS_ALIGN(bsize, OS_ALIGNMENT)
 
+#if OS_MEMPOOL_LOCKFREE && defined(ARCH_cortex_m4)
+#define OS_MEMPOOL_USE_LDREX    (1)
+#else
+#define OS_MEMPOOL_USE_LDREX    (0)
+#endif
+
 STAILQ_HEAD(, os_mempool) g_os_mempool_list = 
     STAILQ_HEAD_INITIALIZER(g_os_mempool_list);
 
+static int
+os_mempool_listed(struct os_mempool *mp)
+{
+    struct os_mempool *cur;
+
+    STAILQ_FOREACH(cur, &g_os_mempool_list, mp_list) {
+        if (cur == mp) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /**
  * os mempool init
  *  
@@ -70,6 +89,8 @@ os_mempool_init(struct os_mempool *mp, int blocks, int block_size,
     /* Initialize the memory pool structure */
     mp->mp_block_size = block_size;
     mp->mp_num_free = blocks;
+    mp->mp_min_free = blocks;
+    mp->mp_num_fail = 0;
     mp->mp_num_blocks = blocks;
     mp->mp_membuf_addr = (uint32_t)membuf;
     mp->name = name;
@@ -88,11 +109,29 @@ os_mempool_init(struct os_mempool *mp, int blocks, int block_size,
     /* Last one in the list should be NULL */
     SLIST_NEXT(block_ptr, mb_next) = NULL;
 
-    STAILQ_INSERT_TAIL(&g_os_mempool_list, mp, mp_list);
+    /* A pool which is initialized again keeps its place in the list. */
+    if (!os_mempool_listed(mp)) {
+        STAILQ_INSERT_TAIL(&g_os_mempool_list, mp, mp_list);
+    }
 
     return OS_OK;
 }
 
+/**
+ * Removes a memory pool from the list reported by
+ * os_mempool_info_get_next().  The pool can still be used; this is for
+ * pools whose memory is about to be reused for something else.
+ *
+ * @param mp The memory pool to remove
+ */
+void
+os_mempool_unregister(struct os_mempool *mp)
+{
+    if (os_mempool_listed(mp)) {
+        STAILQ_REMOVE(&g_os_mempool_list, mp, os_mempool, mp_list);
+    }
+}
+
 /**
  * Checks if a memory block was allocated from the specified mempool.
  *
@@ -129,6 +168,98 @@ os_memblock_from(struct os_mempool *mp, void *block_addr)
     return 1;
 }
 
+/*
+ * Records the number of free blocks left after an allocation, or a failed
+ * allocation if there were none.  These are statistics only; in lock-free
+ * mode a concurrent update may occasionally be lost.
+ */
+static inline void
+os_mempool_stat_get(struct os_mempool *mp, int num_free, int got)
+{
+    if (!got) {
+        mp->mp_num_fail++;
+    } else if (num_free < mp->mp_min_free) {
+        mp->mp_min_free = num_free;
+    }
+}
+
+#if OS_MEMPOOL_USE_LDREX
+
+/*
+ * Exclusive access based free list operations.  A STREX fails if an
+ * exception was taken since the matching LDREX (exception entry and return
+ * clear the local monitor), so a block popped and pushed back by an ISR in
+ * between cannot be mistaken for an unchanged head; no ABA tag is needed on
+ * a single core.
+ *
+ * The free count is reserved before a block is popped and only released
+ * after a block is pushed, so a successful reservation always finds a block
+ * on the list.
+ */
+static int
+os_mempool_reserve(struct os_mempool *mp, int n)
+{
+    volatile uint32_t *cnt;
+    uint32_t val;
+
+    cnt = (volatile uint32_t *)&mp->mp_num_free;
+    do {
+        val = __LDREXW(cnt);
+        if (val == 0) {
+            __CLREX();
+            os_mempool_stat_get(mp, 0, 0);
+            return 0;
+        }
+        if (n > val) {
+            n = val;
+        }
+    } while (__STREXW(val - n, cnt) != 0);
+
+    os_mempool_stat_get(mp, val - n, n);
+
+    return n;
+}
+
+static void
+os_mempool_release(struct os_mempool *mp, int n)
+{
+    volatile uint32_t *cnt;
+    uint32_t val;
+
+    cnt = (volatile uint32_t *)&mp->mp_num_free;
+    do {
+        val = __LDREXW(cnt);
+    } while (__STREXW(val + n, cnt) != 0);
+}
+
+static struct os_memblock *
+os_mempool_pop(struct os_mempool *mp)
+{
+    volatile uint32_t *head;
+    struct os_memblock *block;
+
+    head = (volatile uint32_t *)&SLIST_FIRST(mp);
+    do {
+        block = (struct os_memblock *)__LDREXW(head);
+    } while (__STREXW((uint32_t)SLIST_NEXT(block, mb_next), head) != 0);
+
+    return block;
+}
+
+static void
+os_mempool_push(struct os_mempool *mp, struct os_memblock *first,
+                struct os_memblock *last)
+{
+    volatile uint32_t *head;
+
+    head = (volatile uint32_t *)&SLIST_FIRST(mp);
+    do {
+        SLIST_NEXT(last, mb_next) = (struct os_memblock *)__LDREXW(head);
+    } while (__STREXW((uint32_t)first, head) != 0);
+}
+
+#endif /* OS_MEMPOOL_USE_LDREX */
+
 /**
  * os memblock get 
  *  
@@ -141,6 +272,16 @@ os_memblock_from(struct os_mempool *mp, void *block_addr)
 void *
 os_memblock_get(struct os_mempool *mp)
 {
+#if OS_MEMPOOL_USE_LDREX
+    struct os_memblock *block;
+
+    block = NULL;
+    if (mp && os_mempool_reserve(mp, 1)) {
+        block = os_mempool_pop(mp);
+    }
+
+    return (void *)block;
+#else
     os_sr_t sr;
     struct os_memblock *block;
 
@@ -159,10 +300,12 @@ os_memblock_get(struct os_mempool *mp)
             /* Decrement number free by 1 */
             mp->mp_num_free--;
         }
+        os_mempool_stat_get(mp, mp->mp_num_free, block != NULL);
         OS_EXIT_CRITICAL(sr);
     }
 
     return (void *)block;
+#endif
 }
 
 /**
@@ -178,7 +321,9 @@ os_memblock_get(struct os_mempool *mp)
 os_error_t
 os_memblock_put(struct os_mempool *mp, void *block_addr)
 {
+#if !OS_MEMPOOL_USE_LDREX
     os_sr_t sr;
+#endif
     struct os_memblock *block;
 
     /* Make sure parameters are valid */
@@ -192,6 +337,10 @@ os_memblock_put(struct os_mempool *mp, void *block_addr)
     }
 
     block = (struct os_memblock *)block_addr;
+#if OS_MEMPOOL_USE_LDREX
+    os_mempool_push(mp, block, block);
+    os_mempool_release(mp, 1);
+#else
     OS_ENTER_CRITICAL(sr);
     
     /* Chain current free list pointer to this block; make this block head */
@@ -203,10 +352,108 @@ os_memblock_put(struct os_mempool *mp, void *block_addr)
     mp->mp_num_free++;
 
     OS_EXIT_CRITICAL(sr);
+#endif
 
     return OS_OK;
 }
 
+/**
+ * Get several memory blocks from a memory pool in a single operation.
+ * Fewer than the requested number of blocks are returned if the pool does
+ * not have enough free blocks.
+ *
+ * @param mp        Pointer to the memory pool
+ * @param blocks    Array to fill with pointers to the allocated blocks
+ * @param n         Number of blocks requested (size of 'blocks')
+ *
+ * @return int      The number of blocks allocated (0 to n)
+ */
+int
+os_memblock_get_n(struct os_mempool *mp, void **blocks, int n)
+{
+#if !OS_MEMPOOL_USE_LDREX
+    os_sr_t sr;
+    struct os_memblock *block;
+#endif
+    int cnt;
+    int i;
+
+    if ((mp == NULL) || (blocks == NULL) || (n <= 0)) {
+        return 0;
+    }
+
+#if OS_MEMPOOL_USE_LDREX
+    cnt = os_mempool_reserve(mp, n);
+    for (i = 0; i < cnt; i++) {
+        blocks[i] = os_mempool_pop(mp);
+    }
+#else
+    OS_ENTER_CRITICAL(sr);
+    cnt = min(n, mp->mp_num_free);
+    block = SLIST_FIRST(mp);
+    for (i = 0; i < cnt; i++) {
+        blocks[i] = block;
+        block = SLIST_NEXT(block, mb_next);
+    }
+    SLIST_FIRST(mp) = block;
+    mp->mp_num_free -= cnt;
+    os_mempool_stat_get(mp, mp->mp_num_free, cnt);
+    OS_EXIT_CRITICAL(sr);
+#endif
+
+    return cnt;
+}
+
+/**
+ * Puts a list of memory blocks back into a pool in a single operation.  The
+ * blocks must be chained through their os_memblock header, with the last
+ * block's next pointer set to NULL.  Every block is validated before any of
+ * them is returned to the pool.
+ *
+ * @param mp            Pointer to memory pool
+ * @param block_list    Pointer to the first memory block of the list
+ *
+ * @return os_error_t
+ */
+os_error_t
+os_memblock_put_list(struct os_mempool *mp, void *block_list)
+{
+#if !OS_MEMPOOL_USE_LDREX
+    os_sr_t sr;
+#endif
+    struct os_memblock *first;
+    struct os_memblock *last;
+    int cnt;
+
+    if ((mp == NULL) || (block_list == NULL)) {
+        return OS_INVALID_PARM;
+    }
+
+    first = block_list;
+    cnt = 0;
+    for (last = first; ; last = SLIST_NEXT(last, mb_next)) {
+        if (!os_memblock_from(mp, last)) {
+            return OS_INVALID_PARM;
+        }
+        cnt++;
+        if (SLIST_NEXT(last, mb_next) == NULL) {
+            break;
+        }
+    }
+
+#if OS_MEMPOOL_USE_LDREX
+    os_mempool_push(mp, first, last);
+    os_mempool_release(mp, cnt);
+#else
+    OS_ENTER_CRITICAL(sr);
+    SLIST_NEXT(last, mb_next) = SLIST_FIRST(mp);
+    SLIST_FIRST(mp) = first;
+    mp->mp_num_free += cnt;
+    OS_EXIT_CRITICAL(sr);
+#endif
+
+    return OS_OK;
+}
 
 struct os_mempool *
 os_mempool_info_get_next(struct os_mempool *mp, struct os_mempool_info *omi)
@@ -226,6 +473,8 @@ os_mempool_info_get_next(struct os_mempool *mp, struct os_mempool_info *omi)
     omi->omi_block_size = cur->mp_block_size;
     omi->omi_num_blocks = cur->mp_num_blocks;
     omi->omi_num_free = cur->mp_num_free;
+    omi->omi_min_free = cur->mp_min_free;
+    omi->omi_num_fail = cur->mp_num_fail;
     strncpy(omi->omi_name, cur->name, sizeof(omi->omi_name));
 
     return (cur);
@@ -19,6 +19,71 @@
 
 #include "os/os.h"
 #include <assert.h>
+#include <string.h>
+
+#if OS_MUTEX_STATS
+#define OS_MUTEX_STATS_INC(__mu, __field) ((__mu)->__field++)
+#else
+#define OS_MUTEX_STATS_INC(__mu, __field)
+#endif
+
+/*
+ * Links a task into the list of tasks waiting on a mutex, keeping the list
+ * in priority order.  Must be called with interrupts disabled.
+ */
+static void
+os_mutex_wait_insert(struct os_mutex *mu, struct os_task *t)
+{
+    struct os_task *entry;
+    struct os_task *last;
+
+    last = NULL;
+    SLIST_FOREACH(entry, &mu->mu_head, t_obj_list) {
+        if (t->t_prio < entry->t_prio) {
+            break;
+        }
+        last = entry;
+    }
+
+    if (last) {
+        SLIST_INSERT_AFTER(last, t, t_obj_list);
+    } else {
+        SLIST_INSERT_HEAD(&mu->mu_head, t, t_obj_list);
+    }
+}
+
+/*
+ * Raises the priority of the owner of a mutex to 'prio'.  If the owner is
+ * itself waiting on a mutex, its position in that wait list is updated and
+ * the boost is passed on to the owner of that mutex, and so on along the
+ * chain.  Must be called with interrupts disabled.
+ */
+static void
+os_mutex_inherit(struct os_mutex *mu, uint8_t prio)
+{
+    struct os_task *owner;
+    int depth;
+
+    for (depth = 0; depth < OS_MUTEX_PI_MAX_DEPTH; depth++) {
+        owner = mu->mu_owner;
+        if (owner == NULL || owner->t_prio <= prio) {
+            break;
+        }
+
+        owner->t_prio = prio;
+        os_sched_resort(owner);
+        OS_MUTEX_STATS_INC(mu, mu_boosts);
+
+        if (owner->t_state != OS_TASK_SLEEP || owner->t_obj == NULL ||
+            !(owner->t_flags & OS_TASK_FLAG_MUTEX_WAIT)) {
+            break;
+        }
+
+        mu = owner->t_obj;
+        SLIST_REMOVE(&mu->mu_head, owner, os_task, t_obj_list);
+        os_mutex_wait_insert(mu, owner);
+    }
+}
 
 /**
  * os mutex create
@@ -39,9 +104,7 @@ os_mutex_init(struct os_mutex *mu)
     }
 
     /* Initialize to 0 */
-    mu->mu_prio = 0;
-    mu->mu_level = 0;
-    mu->mu_owner = NULL;
+    memset(mu, 0, sizeof(*mu));
     SLIST_FIRST(&mu->mu_head) = NULL;
 
     return OS_OK;
@@ -88,6 +151,7 @@ os_mutex_release(struct os_mutex *mu)
     if (mu->mu_level != 0) {
         return (OS_OK);
     }
+    OS_TRACE_REC(OS_TRACE_T_MUTEX_REL, mu);
 
     OS_ENTER_CRITICAL(sr);
 
@@ -107,6 +171,7 @@ os_mutex_release(struct os_mutex *mu)
         /* Set mutex internals */
         mu->mu_level = 1;
         mu->mu_prio = rdy->t_prio;
+        OS_MUTEX_STATS_INC(mu, mu_acquires);
     }
 
     /* Set new owner of mutex (or NULL if not owned) */
@@ -150,8 +215,10 @@ os_mutex_pend(struct os_mutex *mu, uint32_t timeout)
     os_sr_t sr;
     os_error_t rc;
     struct os_task *current;
-    struct os_task *entry;
-    struct os_task *last;
+#if OS_MUTEX_STATS
+    os_time_t start;
+    os_time_t waited;
+#endif
 
     /* OS must be started when calling this function */
     if (!g_os_started) {
@@ -171,6 +238,7 @@ os_mutex_pend(struct os_mutex *mu, uint32_t timeout)
         mu->mu_owner = current;
         mu->mu_prio  = current->t_prio;
         mu->mu_level = 1;
+        OS_MUTEX_STATS_INC(mu, mu_acquires);
         OS_EXIT_CRITICAL(sr);
         return OS_OK;
     }
@@ -184,37 +252,25 @@ os_mutex_pend(struct os_mutex *mu, uint32_t timeout)
 
     /* Mutex is not owned by us. If timeout is 0, return immediately */
     if (timeout == 0) {
+        OS_MUTEX_STATS_INC(mu, mu_timeouts);
         OS_EXIT_CRITICAL(sr);
         return OS_TIMEOUT;
     }
+    OS_MUTEX_STATS_INC(mu, mu_contended);
 
-    /* Change priority of owner if needed */
-    if (mu->mu_owner->t_prio > current->t_prio) {
-        mu->mu_owner->t_prio = current->t_prio;
-        os_sched_resort(mu->mu_owner);
-    }
+    /* Change priority of owner (and of the owners it waits on) if needed */
+    os_mutex_inherit(mu, current->t_prio);
 
-    /* Link current task to tasks waiting for mutex */
-    last = NULL;
-    if (!SLIST_EMPTY(&mu->mu_head)) {
-        /* Insert in priority order */
-        SLIST_FOREACH(entry, &mu->mu_head, t_obj_list) {
-            if (current->t_prio < entry->t_prio) { 
-                break;
-            }
-            last = entry;
-        }
-    }
-
-    if (last) {
-        SLIST_INSERT_AFTER(last, current, t_obj_list);
-    } else {
-        SLIST_INSERT_HEAD(&mu->mu_head, current, t_obj_list);
-    }
+    /* Link current task to tasks waiting for mutex, in priority order */
+    os_mutex_wait_insert(mu, current);
 
     /* Set mutex pointer in task */
     current->t_obj = mu;
     current->t_flags |= OS_TASK_FLAG_MUTEX_WAIT;
+    OS_TRACE_REC(OS_TRACE_T_MUTEX_WAIT, mu);
+#if OS_MUTEX_STATS
+    start = os_time_get();
+#endif
     os_sched_sleep(current, timeout);
     OS_EXIT_CRITICAL(sr);
 
@@ -222,14 +278,21 @@ os_mutex_pend(struct os_mutex *mu, uint32_t timeout)
 
     OS_ENTER_CRITICAL(sr);
     current->t_flags &= ~OS_TASK_FLAG_MUTEX_WAIT;
-    OS_EXIT_CRITICAL(sr);
+#if OS_MUTEX_STATS
+    waited = os_time_get() - start;
+    if (waited > mu->mu_max_wait) {
+        mu->mu_max_wait = waited;
+    }
+#endif
 
     /* If we are owner we did not time out. */
     if (mu->mu_owner == current) {
         rc = OS_OK; 
     } else {
+        OS_MUTEX_STATS_INC(mu, mu_timeouts);
         rc = OS_TIMEOUT;
     }
+    OS_EXIT_CRITICAL(sr);
 
     return rc;
 }
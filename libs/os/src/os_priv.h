@@ -20,6 +20,7 @@
 #ifndef H_OS_PRIV_
 #define H_OS_PRIV_
 
+#include "os/os_cfg.h"
 #include "os/queue.h"
 
 TAILQ_HEAD(os_task_list, os_task);
@@ -27,10 +28,20 @@ TAILQ_HEAD(os_callout_list, os_callout);
 STAILQ_HEAD(os_task_stailq, os_task);
 
 extern struct os_task g_idle_task;
+#if !OS_SCHED_BITMAP
 extern struct os_task_list g_os_run_list;
+#endif
 extern struct os_task_list g_os_sleep_list;
 extern struct os_task_stailq g_os_task_list;
 extern struct os_task *g_current_task;
+#if !OS_CALLOUT_WHEEL
 extern struct os_callout_list g_callout_list;
+#endif
+
+void os_sched_init(void);
+void os_callout_init(void);
+#if OS_STACK_SCAN_IDLE
+void os_task_stack_scan_idle(void);
+#endif
 
 #endif
@@ -29,6 +29,10 @@ struct os_mutex g_os_sanity_check_mu;
 
 int g_os_sanity_num_secs;
 
+/* Fires when the earliest registered sanity check falls due. */
+static struct os_eventq g_os_sanity_evq;
+static struct os_callout_func g_os_sanity_timer;
+
 struct os_task g_os_sanity_task;
 os_stack_t g_os_sanity_task_stack[OS_STACK_ALIGN(OS_SANITY_STACK_SIZE)];
 
@@ -147,6 +151,15 @@ os_sanity_check_register(struct os_sanity_check *sc)
         goto err;
     }
 
+    /*
+     * The new check may be due before the timer is set to go off; have the
+     * sanity task work out the next deadline again.  Before the OS starts,
+     * the sanity task's first pass takes care of this.
+     */
+    if (g_os_started) {
+        os_callout_reset(&g_os_sanity_timer.cf_c, 0);
+    }
+
     return (0);
 err:
     return (rc);
@@ -184,56 +197,92 @@ err:
 }
 
 /**
- * The main sanity check task loop.  This executes every SANITY_CHECK_NUM_SECS
- * and goes through to see if any of the registered sanity checks are expired.
- * If the sanity checks have expired, it restarts the operating system.
+ * Go through the registered sanity checks and evaluate the ones that are
+ * due.  Checks with a callback are polled once their interval has elapsed,
+ * or up to g_os_sanity_num_secs early so that checks falling due close
+ * together are handled in one wakeup.  If a check has expired, the
+ * operating system is restarted.
  *
- * @param arg unused 
- *
- * @return never 
+ * @return The number of ticks until the next check falls due, or
+ *         OS_TIMEOUT_NEVER if there are no checks registered.
  */
-static void
-os_sanity_task_loop(void *arg)
+static os_time_t
+os_sanity_run(void)
 {
-    struct os_sanity_check *sc; 
-    int rc; 
+    struct os_sanity_check *sc;
+    os_time_t deadline;
+    os_time_t next;
+    os_time_t now;
+    int rc;
 
-    while (1) {
-        rc = os_sanity_check_list_lock();
-        if (rc != 0) {
-            assert(0);
-        }
+    rc = os_sanity_check_list_lock();
+    if (rc != 0) {
+        assert(0);
+    }
 
-        SLIST_FOREACH(sc, &g_os_sanity_check_list, sc_next) {
-            rc = OS_OK; 
+    now = os_time_get();
+    next = OS_TIMEOUT_NEVER;
 
-            if (sc->sc_func) {
-                rc = sc->sc_func(sc, sc->sc_arg);
-                if (rc == OS_OK) {
-                    sc->sc_checkin_last = os_time_get();
-                    continue;
-                }
-            }
+    SLIST_FOREACH(sc, &g_os_sanity_check_list, sc_next) {
+        /* A check trips once more than sc_checkin_itvl ticks have passed. */
+        deadline = sc->sc_checkin_last + sc->sc_checkin_itvl + 1;
 
-            if (OS_TIME_TICK_GT(os_time_get() - sc->sc_checkin_last, 
-                        sc->sc_checkin_itvl)) {
-                assert(0);
+        if (sc->sc_func &&
+                OS_TIME_TICK_GEQ(now + g_os_sanity_num_secs, deadline)) {
+            rc = sc->sc_func(sc, sc->sc_arg);
+            if (rc == OS_OK) {
+                sc->sc_checkin_last = now;
+                deadline = now + sc->sc_checkin_itvl + 1;
             }
         }
 
-
-        rc = os_sanity_check_list_unlock();
-        if (rc != 0) {
+        if (OS_TIME_TICK_GEQ(now, deadline)) {
             assert(0);
         }
 
-        os_time_delay(g_os_sanity_num_secs); 
+        if (deadline - now < next) {
+            next = deadline - now;
+        }
+    }
+
+    rc = os_sanity_check_list_unlock();
+    if (rc != 0) {
+        assert(0);
+    }
+
+    return (next);
+}
+
+/**
+ * The main sanity check task loop.  Rather than polling at a fixed rate,
+ * the task sleeps until the earliest registered sanity check falls due,
+ * and only evaluates the checks that are due then.
+ *
+ * @param arg unused 
+ *
+ * @return never 
+ */
+static void
+os_sanity_task_loop(void *arg)
+{
+    os_time_t ticks;
+
+    while (1) {
+        ticks = os_sanity_run();
+        if (ticks != OS_TIMEOUT_NEVER) {
+            os_callout_reset(&g_os_sanity_timer.cf_c, ticks);
+        }
+
+        os_eventq_get(&g_os_sanity_evq);
     }
 }
 
 /**
  * Initialize the sanity task and mutex. 
  *
+ * @param num_secs How early, in seconds, checks with a callback may be
+ *                 polled so that they share a wakeup with other checks.
+ *
  * @return 0 on success, error code on failure
  */
 int 
@@ -243,6 +292,9 @@ os_sanity_task_init(int num_secs)
 
     g_os_sanity_num_secs = num_secs * OS_TICKS_PER_SEC;
 
+    os_eventq_init(&g_os_sanity_evq);
+    os_callout_func_init(&g_os_sanity_timer, &g_os_sanity_evq, NULL, NULL);
+
     rc = os_mutex_init(&g_os_sanity_check_mu); 
     if (rc != 0) {
         goto err;
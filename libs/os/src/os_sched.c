@@ -19,17 +19,224 @@
 
 #include "os/os.h"
 #include "os/queue.h"
+#include "os_priv.h"
 
+#include <util/util.h>
 #include <assert.h>
+#if OS_TASK_CPUTIME
+#include <hal/hal_cputime.h>
+#endif
 
-TAILQ_HEAD(, os_task) g_os_run_list = TAILQ_HEAD_INITIALIZER(g_os_run_list); 
+#if OS_SCHED_BITMAP
 
-TAILQ_HEAD(, os_task) g_os_sleep_list = TAILQ_HEAD_INITIALIZER(g_os_sleep_list); 
+#define OS_SCHED_NUM_PRIOS      (OS_TASK_PRI_LOWEST + 1)
+#define OS_SCHED_MAP_WORDS      (OS_SCHED_NUM_PRIOS / 32)
+
+/*
+ * One FIFO list of ready tasks per priority.  Bit 'n' of the map, counting
+ * from the most significant bit of word 0, is set when the list for
+ * priority 'n' is non-empty.  Bit 'w' of the group word is set when map
+ * word 'w' is non-zero.  Using MSB-first ordering lets count-leading-zeros
+ * (a single instruction on Cortex-M3/M4) return the priority directly.
+ */
+static struct os_task_list g_os_run_prio[OS_SCHED_NUM_PRIOS];
+static uint32_t g_os_run_map[OS_SCHED_MAP_WORDS];
+static uint32_t g_os_run_grp;
+
+#define OS_SCHED_BIT(__n)       (0x80000000UL >> ((__n) & 31))
+
+static void
+os_sched_rq_insert(struct os_task *t)
+{
+    uint8_t prio;
+
+    prio = t->t_prio;
+    t->t_run_prio = prio;
+    TAILQ_INSERT_TAIL(&g_os_run_prio[prio], t, t_os_list);
+    g_os_run_map[prio >> 5] |= OS_SCHED_BIT(prio);
+    g_os_run_grp |= OS_SCHED_BIT(prio >> 5);
+}
+
+static void
+os_sched_rq_remove(struct os_task *t)
+{
+    uint8_t prio;
+
+    /* The task priority may have changed since it was queued. */
+    prio = t->t_run_prio;
+    TAILQ_REMOVE(&g_os_run_prio[prio], t, t_os_list);
+    if (TAILQ_EMPTY(&g_os_run_prio[prio])) {
+        g_os_run_map[prio >> 5] &= ~OS_SCHED_BIT(prio);
+        if (g_os_run_map[prio >> 5] == 0) {
+            g_os_run_grp &= ~OS_SCHED_BIT(prio >> 5);
+        }
+    }
+}
+
+static struct os_task *
+os_sched_rq_first(void)
+{
+    uint32_t word;
+    uint32_t bit;
+
+    if (g_os_run_grp == 0) {
+        return (NULL);
+    }
+
+    word = __builtin_clz(g_os_run_grp);
+    bit = __builtin_clz(g_os_run_map[word]);
+
+    return (TAILQ_FIRST(&g_os_run_prio[(word << 5) | bit]));
+}
+
+#else
+
+struct os_task_list g_os_run_list = TAILQ_HEAD_INITIALIZER(g_os_run_list); 
+
+static void
+os_sched_rq_insert(struct os_task *t)
+{
+    struct os_task *entry;
+
+    t->t_run_prio = t->t_prio;
+    TAILQ_FOREACH(entry, &g_os_run_list, t_os_list) {
+        if (t->t_prio < entry->t_prio) { 
+            break;
+        }
+    }
+    if (entry) {
+        TAILQ_INSERT_BEFORE(entry, t, t_os_list);
+    } else {
+        TAILQ_INSERT_TAIL(&g_os_run_list, t, t_os_list);
+    }
+}
+
+static void
+os_sched_rq_remove(struct os_task *t)
+{
+    TAILQ_REMOVE(&g_os_run_list, t, t_os_list);
+}
+
+static struct os_task *
+os_sched_rq_first(void)
+{
+    return (TAILQ_FIRST(&g_os_run_list));
+}
+
+#endif /* OS_SCHED_BITMAP */
+
+struct os_task_list g_os_sleep_list = TAILQ_HEAD_INITIALIZER(g_os_sleep_list); 
+
+#if OS_SCHED_SLEEP_HEAP
+
+CTASSERT(OS_SCHED_SLEEP_HEAP_SIZE <= UINT8_MAX);
+
+/*
+ * Binary min-heap of the tasks sleeping with a timeout, keyed on
+ * t_next_wakeup.  Each task records its position in t_sleep_idx so it can
+ * be removed when woken up early.  All sleeping tasks, including those
+ * waiting forever, are also on the (unsorted) g_os_sleep_list.
+ */
+static struct os_task *g_os_sleep_heap[OS_SCHED_SLEEP_HEAP_SIZE];
+static uint8_t g_os_sleep_heap_cnt;
+
+#define OS_SLEEP_HEAP_LT(__i, __j)                      \
+    OS_TIME_TICK_LT(g_os_sleep_heap[(__i)]->t_next_wakeup,  \
+                    g_os_sleep_heap[(__j)]->t_next_wakeup)
+
+static void
+os_sched_heap_swap(int i, int j)
+{
+    struct os_task *t;
+
+    t = g_os_sleep_heap[i];
+    g_os_sleep_heap[i] = g_os_sleep_heap[j];
+    g_os_sleep_heap[j] = t;
+    g_os_sleep_heap[i]->t_sleep_idx = i;
+    g_os_sleep_heap[j]->t_sleep_idx = j;
+}
+
+static void
+os_sched_heap_up(int i)
+{
+    int parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!OS_SLEEP_HEAP_LT(i, parent)) {
+            break;
+        }
+        os_sched_heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void
+os_sched_heap_down(int i)
+{
+    int child;
+
+    while (1) {
+        child = 2 * i + 1;
+        if (child >= g_os_sleep_heap_cnt) {
+            break;
+        }
+        if (child + 1 < g_os_sleep_heap_cnt &&
+            OS_SLEEP_HEAP_LT(child + 1, child)) {
+            child++;
+        }
+        if (!OS_SLEEP_HEAP_LT(child, i)) {
+            break;
+        }
+        os_sched_heap_swap(i, child);
+        i = child;
+    }
+}
+
+static void
+os_sched_heap_insert(struct os_task *t)
+{
+    int i;
+
+    assert(g_os_sleep_heap_cnt < OS_SCHED_SLEEP_HEAP_SIZE);
+
+    i = g_os_sleep_heap_cnt++;
+    g_os_sleep_heap[i] = t;
+    t->t_sleep_idx = i;
+    os_sched_heap_up(i);
+}
+
+static void
+os_sched_heap_remove(struct os_task *t)
+{
+    int i;
+    int last;
+
+    i = t->t_sleep_idx;
+    assert(i < g_os_sleep_heap_cnt && g_os_sleep_heap[i] == t);
+
+    last = --g_os_sleep_heap_cnt;
+    if (i != last) {
+        g_os_sleep_heap[i] = g_os_sleep_heap[last];
+        g_os_sleep_heap[i]->t_sleep_idx = i;
+        if (i > 0 && OS_SLEEP_HEAP_LT(i, (i - 1) / 2)) {
+            os_sched_heap_up(i);
+        } else {
+            os_sched_heap_down(i);
+        }
+    }
+    g_os_sleep_heap[last] = NULL;
+}
+
+#endif /* OS_SCHED_SLEEP_HEAP */
 
 struct os_task *g_current_task; 
 
 extern os_time_t g_os_time;
 os_time_t g_os_last_ctx_sw_time;
+#if OS_TASK_CPUTIME
+uint32_t g_os_last_ctx_sw_cputime;
+#endif
 
 /**
  * os sched insert
@@ -45,7 +252,6 @@ os_time_t g_os_last_ctx_sw_time;
 os_error_t
 os_sched_insert(struct os_task *t) 
 {
-    struct os_task *entry; 
     os_sr_t sr; 
     os_error_t rc;
 
@@ -54,18 +260,8 @@ os_sched_insert(struct os_task *t)
         goto err;
     }
 
-    entry = NULL;
     OS_ENTER_CRITICAL(sr); 
-    TAILQ_FOREACH(entry, &g_os_run_list, t_os_list) {
-        if (t->t_prio < entry->t_prio) { 
-            break;
-        }
-    }
-    if (entry) {
-        TAILQ_INSERT_BEFORE(entry, (struct os_task *) t, t_os_list);
-    } else {
-        TAILQ_INSERT_TAIL(&g_os_run_list, (struct os_task *) t, t_os_list);
-    }
+    os_sched_rq_insert(t);
     OS_EXIT_CRITICAL(sr);
 
     return (0);
@@ -73,16 +269,46 @@ err:
     return (rc);
 }
 
+/**
+ * os sched ctx sw hook
+ *
+ * Called by the architecture specific code right before switching from the
+ * current task to 'next_t'.  Charges the outgoing task with the time it
+ * has been running.  A task that is switched out while still in the ready
+ * state did not block, so it is counted as preempted.
+ *
+ * @param next_t Pointer to task about to run
+ */
 void
 os_sched_ctx_sw_hook(struct os_task *next_t)
 {
+#if OS_TASK_CPUTIME
+    uint32_t now;
+    uint32_t run;
+#endif
+
     if (g_current_task == next_t) {
         return;
     }
 
+    OS_TRACE_REC(OS_TRACE_T_TASK_SW, next_t->t_taskid);
     next_t->t_ctx_sw_cnt++;
     g_current_task->t_run_time += g_os_time - g_os_last_ctx_sw_time;
     g_os_last_ctx_sw_time = g_os_time;
+
+#if OS_TASK_CPUTIME
+    now = cputime_get32();
+    run = now - g_os_last_ctx_sw_cputime;
+    g_os_last_ctx_sw_cputime = now;
+
+    g_current_task->t_cputime += run;
+    if (run > g_current_task->t_max_run) {
+        g_current_task->t_max_run = run;
+    }
+    if (g_current_task->t_state == OS_TASK_READY) {
+        g_current_task->t_preempt_cnt++;
+    }
+#endif
 }
 
 
@@ -159,17 +385,23 @@ os_sched(struct os_task *next_t)
 int 
 os_sched_sleep(struct os_task *t, os_time_t nticks) 
 {
+#if !OS_SCHED_SLEEP_HEAP
     struct os_task *entry;
 
     entry = NULL; 
+#endif
 
-    TAILQ_REMOVE(&g_os_run_list, t, t_os_list);
+    os_sched_rq_remove(t);
     t->t_state = OS_TASK_SLEEP;
     t->t_next_wakeup = os_time_get() + nticks;
     if (nticks == OS_TIMEOUT_NEVER) {
         t->t_flags |= OS_TASK_FLAG_NO_TIMEOUT;
         TAILQ_INSERT_TAIL(&g_os_sleep_list, t, t_os_list); 
     } else {
+#if OS_SCHED_SLEEP_HEAP
+        TAILQ_INSERT_TAIL(&g_os_sleep_list, t, t_os_list); 
+        os_sched_heap_insert(t);
+#else
         TAILQ_FOREACH(entry, &g_os_sleep_list, t_os_list) {
             if ((entry->t_flags & OS_TASK_FLAG_NO_TIMEOUT) ||
                     OS_TIME_TICK_GT(entry->t_next_wakeup, t->t_next_wakeup)) {
@@ -181,6 +413,7 @@ os_sched_sleep(struct os_task *t, os_time_t nticks)
         } else {
             TAILQ_INSERT_TAIL(&g_os_sleep_list, t, t_os_list); 
         }
+#endif
     }
 
     return (0);
@@ -215,6 +448,11 @@ os_sched_wakeup(struct os_task *t)
     }
 
     /* Remove task from sleep list */
+#if OS_SCHED_SLEEP_HEAP
+    if (!(t->t_flags & OS_TASK_FLAG_NO_TIMEOUT)) {
+        os_sched_heap_remove(t);
+    }
+#endif
     t->t_state = OS_TASK_READY;
     t->t_next_wakeup = 0;
     t->t_flags &= ~OS_TASK_FLAG_NO_TIMEOUT;
@@ -237,7 +475,9 @@ void
 os_sched_os_timer_exp(void)
 {
     struct os_task *t;
+#if !OS_SCHED_SLEEP_HEAP
     struct os_task *next;
+#endif
     os_time_t now; 
     os_sr_t sr;
 
@@ -248,6 +488,15 @@ os_sched_os_timer_exp(void)
     /*
      * Wakeup any tasks that have their sleep timer expired
      */
+#if OS_SCHED_SLEEP_HEAP
+    while (g_os_sleep_heap_cnt > 0) {
+        t = g_os_sleep_heap[0];
+        if (!OS_TIME_TICK_GEQ(now, t->t_next_wakeup)) {
+            break;
+        }
+        os_sched_wakeup(t);
+    }
+#else
     t = TAILQ_FIRST(&g_os_sleep_list);
     while (t) {
         /* If task waiting forever, do not check next wakeup time */
@@ -262,6 +511,7 @@ os_sched_os_timer_exp(void)
         }
         t = next;
     }
+#endif
 
     OS_EXIT_CRITICAL(sr); 
 }
@@ -278,7 +528,11 @@ os_sched_wakeup_ticks(os_time_t now)
 
     OS_ASSERT_CRITICAL();
 
+#if OS_SCHED_SLEEP_HEAP
+    t = g_os_sleep_heap_cnt > 0 ? g_os_sleep_heap[0] : NULL;
+#else
     t = TAILQ_FIRST(&g_os_sleep_list);
+#endif
     if (t == NULL || (t->t_flags & OS_TASK_FLAG_NO_TIMEOUT)) {
         rt = OS_TIMEOUT_NEVER;
     } else if (OS_TIME_TICK_GEQ(t->t_next_wakeup, now)) {
@@ -303,7 +557,7 @@ os_sched_wakeup_ticks(os_time_t now)
 struct os_task *  
 os_sched_next_task(void) 
 {
-    return (TAILQ_FIRST(&g_os_run_list));
+    return (os_sched_rq_first());
 }
 
 /**
@@ -323,8 +577,36 @@ void
 os_sched_resort(struct os_task *t) 
 {
     if (t->t_state == OS_TASK_READY) {
-        TAILQ_REMOVE(&g_os_run_list, t, t_os_list);
+        os_sched_rq_remove(t);
         os_sched_insert(t);
     }
 }
 
+/**
+ * os sched init
+ *
+ * Empties the run and sleep lists.  Called from os_init(), before the
+ * architecture specific code creates the idle task.
+ */
+void
+os_sched_init(void)
+{
+#if OS_SCHED_BITMAP
+    int i;
+
+    for (i = 0; i < OS_SCHED_NUM_PRIOS; i++) {
+        TAILQ_INIT(&g_os_run_prio[i]);
+    }
+    for (i = 0; i < OS_SCHED_MAP_WORDS; i++) {
+        g_os_run_map[i] = 0;
+    }
+    g_os_run_grp = 0;
+#else
+    TAILQ_INIT(&g_os_run_list);
+#endif
+    TAILQ_INIT(&g_os_sleep_list);
+#if OS_SCHED_SLEEP_HEAP
+    g_os_sleep_heap_cnt = 0;
+#endif
+}
+
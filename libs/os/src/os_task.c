@@ -27,6 +27,15 @@ uint8_t g_task_id;
 
 struct os_task_stailq g_os_task_list;
 
+#ifndef OS_STACK_GUARD_WORDS
+#define OS_STACK_GUARD_WORDS    (0)
+#endif
+
+#if OS_STACK_SCAN_IDLE
+/* ID of the next task whose stack the idle task looks at. */
+static uint8_t os_task_scan_id;
+#endif
+
 static void
 _clear_stack(os_stack_t *stack_bottom, int size)
 {
@@ -139,6 +148,80 @@ err:
     return (rc);
 }
 
+/**
+ * Updates and returns the stack high-water mark of a task.
+ *
+ * Only the part of the stack beyond the deepest point seen so far is
+ * looked at.  It is scanned from the bottom up, unless OS_STACK_SCAN_GAP
+ * is set; see os_cfg.h.
+ *
+ * @param t The task to update
+ *
+ * @return The deepest stack usage seen, in os_stack_t units.
+ */
+uint16_t
+os_task_stack_hwm(struct os_task *t)
+{
+    int limit;
+#if OS_STACK_SCAN_GAP
+    int gap;
+#endif
+    int i;
+
+    limit = t->t_stacksize - OS_STACK_GUARD_WORDS;
+#if OS_STACK_SCAN_GAP
+    gap = 0;
+    for (i = t->t_stack_hwm; i < limit && gap < OS_STACK_SCAN_GAP; i++) {
+        if (t->t_stacktop[-(i + 1)] != OS_STACK_PATTERN) {
+            t->t_stack_hwm = i + 1;
+            gap = 0;
+        } else {
+            gap++;
+        }
+    }
+#else
+    for (i = limit; i > t->t_stack_hwm; i--) {
+        if (t->t_stacktop[-i] != OS_STACK_PATTERN) {
+            t->t_stack_hwm = i;
+            break;
+        }
+    }
+#endif
+
+    return (t->t_stack_hwm);
+}
+
+#if OS_STACK_SCAN_IDLE
+/**
+ * Called by the idle task to update the stack high-water mark of one task,
+ * going round all tasks in turn.
+ */
+void
+os_task_stack_scan_idle(void)
+{
+    struct os_task *t;
+
+    /*
+     * Tasks are listed in order of their IDs; go by ID rather than keeping
+     * a pointer, so that the position survives the task list being reset.
+     */
+    STAILQ_FOREACH(t, &g_os_task_list, t_os_task_list) {
+        if (t->t_taskid >= os_task_scan_id) {
+            break;
+        }
+    }
+    if (t == NULL) {
+        t = STAILQ_FIRST(&g_os_task_list);
+        if (t == NULL) {
+            return;
+        }
+    }
+    os_task_scan_id = t->t_taskid + 1;
+
+    os_task_stack_hwm(t);
+}
+#endif
+
 /**
  * Iterate through tasks, and return the following information about them:
  *
@@ -173,8 +256,6 @@ struct os_task *
 os_task_info_get_next(const struct os_task *prev, struct os_task_info *oti)
 {
     struct os_task *next;
-    os_stack_t *top;
-    os_stack_t *bottom;
 
     if (prev != NULL) {
         next = STAILQ_NEXT(prev, t_os_task_list);
@@ -193,19 +274,19 @@ os_task_info_get_next(const struct os_task *prev, struct os_task_info *oti)
     oti->oti_taskid = next->t_taskid;
     oti->oti_state = next->t_state;
 
-    top = next->t_stacktop;
-    bottom = next->t_stacktop - next->t_stacksize;
-    while (bottom < top) {
-        if (*bottom != OS_STACK_PATTERN) {
-            break;
-        }
-        ++bottom;
-    }
-
-    oti->oti_stkusage = (uint16_t) (next->t_stacktop - bottom);
+    oti->oti_stkusage = os_task_stack_hwm(next);
     oti->oti_stksize = next->t_stacksize;
     oti->oti_cswcnt = next->t_ctx_sw_cnt;
     oti->oti_runtime = next->t_run_time;
+#if OS_TASK_CPUTIME
+    oti->oti_cputime = next->t_cputime;
+    oti->oti_maxrun = next->t_max_run;
+    oti->oti_preemptcnt = next->t_preempt_cnt;
+#else
+    oti->oti_cputime = 0;
+    oti->oti_maxrun = 0;
+    oti->oti_preemptcnt = 0;
+#endif
     oti->oti_last_checkin = next->t_sanity_check.sc_checkin_last;
     oti->oti_next_checkin = next->t_sanity_check.sc_checkin_last +
         next->t_sanity_check.sc_checkin_itvl;
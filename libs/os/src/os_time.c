@@ -22,11 +22,12 @@
 
 #include "os/os.h"
 #include "os/queue.h"
+#if OS_TIME_HIRES
+#include <hal/hal_cputime.h>
+#endif
 
 CTASSERT(sizeof(os_time_t) == 4);
 
-#define OS_USEC_PER_TICK    (1000000 / OS_TICKS_PER_SEC)
-
 os_time_t g_os_time;
 
 /*
@@ -34,11 +35,27 @@ os_time_t g_os_time;
  */
 static struct {
     os_time_t ostime;
-    struct os_timeval uptime;
     struct os_timeval utctime;
     struct os_timezone timezone;
 } basetod;
 
+/*
+ * Monotonic microsecond clock.  This is updated with interrupts disabled on
+ * every OS tick; readers retry if they catch an update in progress instead
+ * of entering a critical section.
+ */
+static struct {
+    volatile uint32_t gen;      /* Odd while an update is in progress. */
+    uint64_t ticks;             /* OS ticks since boot. */
+    uint64_t usec;              /* Microseconds since boot at 'ticks'. */
+#if OS_TIME_HIRES
+    uint32_t span;              /* Microseconds until the next tick. */
+    uint32_t cputime;           /* cputime at the last tick. */
+#endif
+} os_time_us;
+
+#define OS_TIME_BARRIER()   __asm__ volatile ("" : : : "memory")
+
 static void
 os_deltatime(os_time_t delta, const struct os_timeval *base,
     struct os_timeval *result)
@@ -46,10 +63,82 @@ os_deltatime(os_time_t delta, const struct os_timeval *base,
     struct os_timeval tvdelta;
 
     tvdelta.tv_sec = delta / OS_TICKS_PER_SEC;
-    tvdelta.tv_usec = (delta % OS_TICKS_PER_SEC) * OS_USEC_PER_TICK;
+    tvdelta.tv_usec = (uint64_t)(delta % OS_TICKS_PER_SEC) * 1000000 /
+        OS_TICKS_PER_SEC;
     os_timeradd(base, &tvdelta, result);
 }
 
+/*
+ * Called with interrupts disabled whenever OS time moves forward.
+ */
+static void
+os_time_usec_update(int ticks)
+{
+#if OS_TIME_HIRES
+    uint64_t next;
+#endif
+
+    os_time_us.gen++;
+    OS_TIME_BARRIER();
+
+    os_time_us.ticks += ticks;
+    os_time_us.usec = os_time_us.ticks * 1000000 / OS_TICKS_PER_SEC;
+#if OS_TIME_HIRES
+    next = (os_time_us.ticks + 1) * 1000000 / OS_TICKS_PER_SEC;
+    os_time_us.span = next - os_time_us.usec;
+    os_time_us.cputime = cputime_get32();
+#endif
+
+    OS_TIME_BARRIER();
+    os_time_us.gen++;
+}
+
+/*
+ * Reads the microsecond clock.  Returns the time of the last OS tick and
+ * fills in how far past that tick we are.  The sub-tick part comes from
+ * cputime when OS_TIME_HIRES is enabled and cputime has been initialized;
+ * it is capped short of the next tick so that the clock never runs ahead
+ * of the OS ticks and never goes backwards.
+ */
+static uint64_t
+os_time_usec_read(os_time_t *ostime, uint32_t *frac)
+{
+    uint64_t usec;
+    uint64_t ticks;
+    uint32_t gen;
+#if OS_TIME_HIRES
+    uint32_t cputime;
+    uint32_t span;
+#endif
+
+    do {
+        gen = os_time_us.gen;
+        OS_TIME_BARRIER();
+        ticks = os_time_us.ticks;
+        usec = os_time_us.usec;
+#if OS_TIME_HIRES
+        span = os_time_us.span;
+        cputime = os_time_us.cputime;
+#endif
+        OS_TIME_BARRIER();
+    } while ((gen & 1) != 0 || gen != os_time_us.gen);
+
+    *frac = 0;
+#if OS_TIME_HIRES
+    if (g_cputime.ticks_per_usec != 0) {
+        *frac = cputime_ticks_to_usecs(cputime_get32() - cputime);
+        if (*frac >= span) {
+            *frac = span - 1;
+        }
+    }
+#endif
+    if (ostime != NULL) {
+        *ostime = ticks;
+    }
+
+    return (usec);
+}
+
 /**
  * Get the current OS time in ticks
  *
@@ -72,6 +161,7 @@ os_time_tick(int ticks)
     OS_ENTER_CRITICAL(sr);
     prev_os_time = g_os_time;
     g_os_time += ticks;
+    os_time_usec_update(ticks);
 
     /*
      * Update 'basetod' when 'g_os_time' crosses the 0x00000000 and
@@ -79,7 +169,6 @@ os_time_tick(int ticks)
      */
     if ((prev_os_time ^ g_os_time) >> 31) {
         delta = g_os_time - basetod.ostime;
-        os_deltatime(delta, &basetod.uptime, &basetod.uptime);
         os_deltatime(delta, &basetod.utctime, &basetod.utctime);
         basetod.ostime = g_os_time;
     }
@@ -99,6 +188,7 @@ os_time_advance(int ticks)
     if (ticks > 0) {
         if (!os_started()) {
             g_os_time += ticks;
+            os_time_usec_update(ticks);
         } else {
             os_time_tick(ticks);
             os_callout_tick();
@@ -148,7 +238,6 @@ os_settimeofday(struct os_timeval *utctime, struct os_timezone *tz)
          * Update all time-of-day base values.
          */
         delta = os_time_get() - basetod.ostime;
-        os_deltatime(delta, &basetod.uptime, &basetod.uptime);
         basetod.utctime = *utctime;
         basetod.ostime += delta;
     }
@@ -174,13 +263,21 @@ os_settimeofday(struct os_timeval *utctime, struct os_timezone *tz)
 int
 os_gettimeofday(struct os_timeval *tv, struct os_timezone *tz)
 {
-    os_sr_t sr;
+    struct os_timeval tvfrac;
+    os_time_t ostime;
     os_time_t delta;
+    uint32_t frac;
+    os_sr_t sr;
 
     OS_ENTER_CRITICAL(sr);
     if (tv != NULL) {
-        delta = os_time_get() - basetod.ostime;
+        os_time_usec_read(&ostime, &frac);
+        delta = ostime - basetod.ostime;
         os_deltatime(delta, &basetod.utctime, tv);
+
+        tvfrac.tv_sec = 0;
+        tvfrac.tv_usec = frac;
+        os_timeradd(tv, &tvfrac, tv);
     }
 
     if (tz != NULL) {
@@ -192,28 +289,33 @@ os_gettimeofday(struct os_timeval *tv, struct os_timezone *tz)
 }
 
 /**
- * Get time since boot in microseconds.
+ * Get the monotonic time since boot in microseconds.  This is the OS tick
+ * count scaled to microseconds; with OS_TIME_HIRES the time elapsed since
+ * the last tick is filled in from cputime.  It does not enter a critical
+ * section, and may be called from interrupt context.
  *
  * @return time since boot in microseconds
  */
-int64_t
-os_get_uptime_usec(void)
+uint64_t
+os_time_get_usec(void)
 {
-  struct os_timeval tv;
-  os_time_t delta;
-  os_sr_t sr;
-  os_time_t ostime;
-
+    uint64_t usec;
+    uint32_t frac;
 
-  OS_ENTER_CRITICAL(sr);
-  tv = basetod.uptime;
-  ostime = basetod.ostime;
-  delta = os_time_get() - ostime;
-  OS_EXIT_CRITICAL(sr);
+    usec = os_time_usec_read(NULL, &frac);
 
-  os_deltatime(delta, &tv, &tv);
+    return (usec + frac);
+}
 
-  return(tv.tv_sec * 1000000 + tv.tv_usec);
+/**
+ * Get time since boot in microseconds.
+ *
+ * @return time since boot in microseconds
+ */
+int64_t
+os_get_uptime_usec(void)
+{
+    return (os_time_get_usec());
 }
 
 /**
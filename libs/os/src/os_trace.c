@@ -0,0 +1,132 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "os/os.h"
+
+#if OS_TRACE
+
+#include <string.h>
+#include <hal/hal_cputime.h>
+
+#if (OS_TRACE_RECS & (OS_TRACE_RECS - 1)) != 0
+#error "OS_TRACE_RECS must be a power of 2"
+#endif
+
+static struct os_trace_rec os_trace_ring[OS_TRACE_RECS];
+
+/* Number of records written since startup; next one goes to seq % size. */
+static uint32_t os_trace_seq;
+static uint8_t os_trace_on = 1;
+
+/**
+ * Records an event in the trace ring, overwriting the oldest record if the
+ * ring is full.  Can be called from interrupt context.
+ *
+ * @param type  One of OS_TRACE_T_xxx, or an application defined type
+ *              starting from OS_TRACE_T_PERUSER.
+ * @param arg   Argument recorded with the event.
+ */
+void
+os_trace(uint8_t type, uint32_t arg)
+{
+    struct os_trace_rec *rec;
+    struct os_task *t;
+    os_sr_t sr;
+
+    if (!os_trace_on) {
+        return;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    rec = &os_trace_ring[os_trace_seq & (OS_TRACE_RECS - 1)];
+    rec->otr_time = cputime_get32();
+    rec->otr_arg = arg;
+    rec->otr_type = type;
+    t = os_sched_get_current_task();
+    rec->otr_task = (g_os_started && t) ? t->t_taskid : 0xff;
+    rec->otr_seq = os_trace_seq;
+    os_trace_seq++;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Turns recording on or off.  While off, the contents of the ring are
+ * kept, and can be read out without new records pushing them out.
+ */
+void
+os_trace_enable(int on)
+{
+    os_trace_on = !!on;
+}
+
+/**
+ * Copies records out of the trace ring, oldest first.
+ *
+ * @param seq   On entry, sequence number of the first record wanted.  If
+ *              that has already been overwritten, copying starts from the
+ *              oldest record still in the ring.  On exit, sequence number
+ *              of the first record copied; *seq plus the return value is
+ *              what to ask for next.
+ * @param recs  Where to copy the records.
+ * @param max   Max number of records to copy.
+ *
+ * @return Number of records copied.
+ */
+int
+os_trace_read(uint32_t *seq, struct os_trace_rec *recs, int max)
+{
+    uint32_t first;
+    uint32_t idx;
+    int cnt;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    first = *seq;
+    if (os_trace_seq - first > OS_TRACE_RECS) {
+        first = os_trace_seq > OS_TRACE_RECS ? os_trace_seq - OS_TRACE_RECS : 0;
+    }
+    for (cnt = 0; cnt < max && first + cnt != os_trace_seq; cnt++) {
+        idx = (first + cnt) & (OS_TRACE_RECS - 1);
+        recs[cnt] = os_trace_ring[idx];
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    *seq = first;
+    return cnt;
+}
+
+#else
+
+void
+os_trace(uint8_t type, uint32_t arg)
+{
+}
+
+void
+os_trace_enable(int on)
+{
+}
+
+int
+os_trace_read(uint32_t *seq, struct os_trace_rec *recs, int max)
+{
+    return 0;
+}
+
+#endif
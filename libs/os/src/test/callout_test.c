@@ -322,9 +322,92 @@ TEST_CASE(callout_test_speak)
 
 }
 
+/* Test case for the time to the next expiry with several armed callouts */
+TEST_CASE(callout_test_wakeup_ticks)
+{
+    struct os_callout_func cf[3];
+    os_time_t now;
+    os_sr_t sr;
+    int i;
+
+    os_init();
+    os_eventq_init(&callout_evq);
+    for (i = 0; i < 3; i++) {
+        os_callout_func_init(&cf[i], &callout_evq, my_callout_func, NULL);
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    now = os_time_get();
+    TEST_ASSERT(os_callout_wakeup_ticks(now) == OS_TIMEOUT_NEVER);
+
+    os_callout_reset(&cf[0].cf_c, 200);
+    os_callout_reset(&cf[1].cf_c, 5);
+    os_callout_reset(&cf[2].cf_c, 70);
+    TEST_ASSERT(os_callout_wakeup_ticks(now) == 5);
+
+    os_callout_stop(&cf[1].cf_c);
+    TEST_ASSERT(os_callout_wakeup_ticks(now) == 70);
+
+    os_callout_stop(&cf[2].cf_c);
+    TEST_ASSERT(os_callout_wakeup_ticks(now) == 200);
+
+    os_callout_stop(&cf[0].cf_c);
+    TEST_ASSERT(os_callout_wakeup_ticks(now) == OS_TIMEOUT_NEVER);
+
+    /* Expired callout which os_callout_tick() hasn't processed yet. */
+    os_callout_reset(&cf[0].cf_c, 2);
+    os_callout_reset(&cf[1].cf_c, 10);
+    os_time_advance(5);
+    now = os_time_get();
+    TEST_ASSERT(os_callout_wakeup_ticks(now) == 0);
+    os_callout_stop(&cf[0].cf_c);
+    TEST_ASSERT(os_callout_wakeup_ticks(now) == 5);
+    os_callout_stop(&cf[1].cf_c);
+    OS_EXIT_CRITICAL(sr);
+}
+
+/* Test case for callouts which are due when they are armed */
+TEST_CASE(callout_test_due)
+{
+    struct os_callout_func cf;
+
+    os_init();
+    os_eventq_init(&callout_evq);
+    os_callout_func_init(&cf, &callout_evq, my_callout_func, NULL);
+
+    /* Zero ticks fires on the next tick. */
+    os_callout_reset(&cf.cf_c, 0);
+    os_time_advance(1);
+    os_callout_tick();
+    TEST_ASSERT(!os_callout_queued(&cf.cf_c));
+    TEST_ASSERT(STAILQ_FIRST(&callout_evq.evq_list) == &cf.cf_c.c_ev);
+    os_callout_stop(&cf.cf_c);
+    TEST_ASSERT(STAILQ_EMPTY(&callout_evq.evq_list));
+
+    /* Expiry which passed before the callouts were processed. */
+    os_callout_reset(&cf.cf_c, 1);
+    os_time_advance(100);
+    os_callout_tick();
+    TEST_ASSERT(!os_callout_queued(&cf.cf_c));
+    TEST_ASSERT(STAILQ_FIRST(&callout_evq.evq_list) == &cf.cf_c.c_ev);
+    os_callout_stop(&cf.cf_c);
+
+    /* Rearming with zero ticks while already due. */
+    os_callout_reset(&cf.cf_c, 0);
+    os_time_advance(3);
+    os_callout_reset(&cf.cf_c, 0);
+    os_time_advance(1);
+    os_callout_tick();
+    TEST_ASSERT(!os_callout_queued(&cf.cf_c));
+    TEST_ASSERT(STAILQ_FIRST(&callout_evq.evq_list) == &cf.cf_c.c_ev);
+    os_callout_stop(&cf.cf_c);
+}
+
 TEST_SUITE(os_callout_test_suite)
 {   
     callout_test();
     callout_test_stop();
     callout_test_speak();
+    callout_test_wakeup_ticks();
+    callout_test_due();
 }
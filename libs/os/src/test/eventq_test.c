@@ -406,6 +406,76 @@ TEST_CASE(event_test_poll_0timo)
     TEST_ASSERT(evp == &ev);
 }
 
+/* To test that an event set serves its queues in priority order */
+TEST_CASE(event_test_set_prio)
+{
+    struct os_eventset set;
+    struct os_eventq evqs[3];
+    struct os_event evs[3];
+    int i;
+
+    os_eventset_init(&set);
+    for (i = 0; i < 3; i++) {
+        os_eventq_init(&evqs[i]);
+        TEST_ASSERT(os_eventset_add(&set, &evqs[i]) == 0);
+        memset(&evs[i], 0, sizeof evs[i]);
+        evs[i].ev_type = OS_EVENT_T_PERUSER + i;
+    }
+
+    /* A queue can only belong to one set. */
+    TEST_ASSERT(os_eventset_add(&set, &evqs[0]) == OS_EINVAL);
+
+    TEST_ASSERT(os_eventset_get(&set, 0) == NULL);
+
+    os_eventq_put(&evqs[2], &evs[2]);
+    os_eventq_put(&evqs[0], &evs[0]);
+    os_eventq_put(&evqs[1], &evs[1]);
+
+    TEST_ASSERT(os_eventset_get(&set, 0) == &evs[0]);
+    TEST_ASSERT(os_eventset_get(&set, 0) == &evs[1]);
+
+    /* Removing the last queued event empties the set. */
+    os_eventq_remove(&evqs[2], &evs[2]);
+    TEST_ASSERT(set.evs_ready == 0);
+    TEST_ASSERT(os_eventset_get(&set, 0) == NULL);
+}
+
+/* To test that repeated posts of a coalescing event are merged */
+TEST_CASE(event_test_coalesce)
+{
+    struct os_eventq *evqp;
+    struct os_cevent cev;
+    uint32_t bits;
+    uint32_t cnt;
+
+    os_eventq_init(&my_eventq);
+    evqp = &my_eventq;
+    os_cevent_init(&cev, 1, &cev);
+
+    /* A burst of posts queues the event once. */
+    os_cevent_put(evqp, &cev, 0x01);
+    os_cevent_put(evqp, &cev, 0x04);
+    os_cevent_put(evqp, &cev, 0);
+
+    TEST_ASSERT(os_eventq_poll(&evqp, 1, 0) == &cev.ce_ev);
+    TEST_ASSERT(cev.ce_ev.ev_type == 1 && cev.ce_ev.ev_arg == &cev);
+    TEST_ASSERT(os_eventq_poll(&evqp, 1, 0) == NULL);
+
+    cnt = os_cevent_take(&cev, &bits);
+    TEST_ASSERT(cnt == 3);
+    TEST_ASSERT(bits == 0x05);
+
+    /* Taking resets the event. */
+    TEST_ASSERT(os_cevent_take(&cev, NULL) == 0);
+
+    /* A post after the event is pulled requeues it. */
+    os_cevent_put(evqp, &cev, 0x02);
+    TEST_ASSERT(os_eventq_poll(&evqp, 1, 0) == &cev.ce_ev);
+    cnt = os_cevent_take(&cev, &bits);
+    TEST_ASSERT(cnt == 1);
+    TEST_ASSERT(bits == 0x02);
+}
+
 TEST_SUITE(os_eventq_test_suite)
 {
     event_test_sr();
@@ -413,4 +483,6 @@ TEST_SUITE(os_eventq_test_suite)
     event_test_poll_timeout_sr();
     event_test_poll_single_sr();
     event_test_poll_0timo();
+    event_test_set_prio();
+    event_test_coalesce();
 }
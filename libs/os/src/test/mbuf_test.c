@@ -22,6 +22,7 @@
 #include "os_test_priv.h"
 
 #include <string.h>
+#include "util/crc16.h"
 
 /* 
  * NOTE: currently, the buffer size cannot be changed as some tests are
@@ -37,6 +38,12 @@ static os_membuf_t os_mbuf_membuf[OS_MEMPOOL_SIZE(MBUF_TEST_POOL_BUF_SIZE,
 
 static struct os_mbuf_pool os_mbuf_pool;
 static struct os_mempool os_mbuf_mempool;
+
+#define MBUF_TEST_SMALL_BUF_SIZE    (64)
+#define MBUF_TEST_SMALL_BUF_COUNT   (2)
+
+OS_MBUF_POOL_DECLARE(os_mbuf_small_pool, MBUF_TEST_SMALL_BUF_COUNT,
+                     MBUF_TEST_SMALL_BUF_SIZE);
 static uint8_t os_mbuf_test_data[MBUF_TEST_DATA_LEN];
 
 static void
@@ -408,6 +415,319 @@ TEST_CASE(os_mbuf_test_adj)
     os_mbuf_test_misc_assert_sane(om, NULL, 0, 0, 18);
 }
 
+TEST_CASE(os_mbuf_test_cursor)
+{
+    struct os_mbuf_iovec iov[4];
+    struct os_mbuf_cursor cur;
+    struct os_mbuf *om;
+    const uint8_t *data;
+    uint16_t crc;
+    uint16_t u16;
+    uint32_t u32;
+    uint8_t buf[8];
+    int first;
+    int rc;
+
+    os_mbuf_test_setup();
+
+    om = os_mbuf_get_pkthdr(&os_mbuf_pool, 10);
+    TEST_ASSERT_FATAL(om != NULL);
+
+    rc = os_mbuf_append(om, os_mbuf_test_data, sizeof os_mbuf_test_data);
+    TEST_ASSERT_FATAL(rc == 0);
+    first = om->om_len;
+    TEST_ASSERT_FATAL(first > 10 && first < 250);
+
+    /*** Segments point into the chain. */
+    rc = os_mbuf_iov(om, 10, 300, iov, 4);
+    TEST_ASSERT(rc == 2);
+    TEST_ASSERT(iov[0].omv_base == om->om_data + 10);
+    TEST_ASSERT(iov[0].omv_len == first - 10);
+    TEST_ASSERT(iov[1].omv_base == SLIST_NEXT(om, om_next)->om_data);
+    TEST_ASSERT(iov[1].omv_len == 300 - (first - 10));
+
+    rc = os_mbuf_iov(om, 0, sizeof os_mbuf_test_data, iov, 2);
+    TEST_ASSERT(rc == -1);
+
+    /*** Integers split across a boundary. */
+    rc = os_mbuf_cursor_init(&cur, om, first - 2);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = os_mbuf_cursor_get_le32(&cur, &u32);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(u32 == ((uint32_t)(first - 2) | (uint32_t)(first - 1) << 8 |
+                        (uint32_t)first << 16 | (uint32_t)(first + 1) << 24));
+
+    rc = os_mbuf_cursor_get_be16(&cur, &u16);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(u16 == ((first + 2) << 8 | (first + 3)));
+
+    rc = os_mbuf_cursor_seg(&cur, &data, 4);
+    TEST_ASSERT(rc == 4);
+    TEST_ASSERT(memcmp(data, os_mbuf_test_data + first + 4, 4) == 0);
+
+    /*** Skip to near the end and read past it. */
+    rc = os_mbuf_cursor_skip(&cur, sizeof os_mbuf_test_data - first - 12);
+    TEST_ASSERT(rc == 0);
+    rc = os_mbuf_cursor_read(&cur, buf, 4);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(buf, os_mbuf_test_data + 1020, 4) == 0);
+    rc = os_mbuf_cursor_get_u8(&cur, buf);
+    TEST_ASSERT(rc == -1);
+    TEST_ASSERT(os_mbuf_cursor_seg(&cur, &data, 1) == 0);
+
+    rc = os_mbuf_cursor_init(&cur, om, sizeof os_mbuf_test_data + 1);
+    TEST_ASSERT(rc == -1);
+
+    /*** CRC over the chain matches the flat buffer. */
+    crc = CRC16_INITIAL_CRC;
+    rc = os_mbuf_crc16(om, 0, sizeof os_mbuf_test_data, &crc);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(crc == crc16_ccitt(CRC16_INITIAL_CRC, os_mbuf_test_data,
+                                   sizeof os_mbuf_test_data));
+
+    os_mbuf_free_chain(om);
+}
+
+static int os_mbuf_test_ext_freed;
+
+static void
+os_mbuf_test_ext_free(struct os_mbuf_ext *ext)
+{
+    os_mbuf_test_ext_freed++;
+}
+
+TEST_CASE(os_mbuf_test_ext)
+{
+    struct os_mbuf_ext ext;
+    struct os_mbuf *om;
+    struct os_mbuf *om2;
+    struct os_mbuf *dup;
+    uint8_t buf[16];
+    int rc;
+
+    os_mbuf_test_setup();
+    os_mbuf_test_ext_freed = 0;
+
+    os_mbuf_ext_init(&ext, os_mbuf_test_data, sizeof os_mbuf_test_data,
+                     os_mbuf_test_ext_free, NULL);
+
+    TEST_ASSERT(os_mbuf_get_ext(&os_mbuf_pool, &ext, 1000, 100) == NULL);
+
+    /*** Header followed by a block of external data. */
+    om = os_mbuf_get_pkthdr(&os_mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = os_mbuf_append(om, "hdr", 3);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    om2 = os_mbuf_get_ext(&os_mbuf_pool, &ext, 10, 500);
+    TEST_ASSERT_FATAL(om2 != NULL);
+    TEST_ASSERT(OS_MBUF_IS_EXT(om2));
+    TEST_ASSERT(om2->om_data == os_mbuf_test_data + 10);
+    TEST_ASSERT(OS_MBUF_LEADINGSPACE(om2) == 0);
+    TEST_ASSERT(OS_MBUF_TRAILINGSPACE(om2) == 0);
+    TEST_ASSERT(ext.ome_refcnt == 1);
+    os_mbuf_concat(om, om2);
+    TEST_ASSERT(OS_MBUF_PKTLEN(om) == 503);
+
+    /*** Appending does not write into the external buffer. */
+    rc = os_mbuf_append(om, "tail", 4);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(SLIST_NEXT(om2, om_next) != NULL);
+    TEST_ASSERT(om2->om_len == 500);
+
+    rc = os_mbuf_copyinto(om, 10, "x", 1);
+    TEST_ASSERT(rc != 0);
+
+    /*** Duplicating shares the external data. */
+    dup = os_mbuf_dup(om);
+    TEST_ASSERT_FATAL(dup != NULL);
+    TEST_ASSERT(ext.ome_refcnt == 2);
+    om2 = SLIST_NEXT(dup, om_next);
+    TEST_ASSERT(OS_MBUF_IS_EXT(om2));
+    TEST_ASSERT(om2->om_data == os_mbuf_test_data + 10);
+    TEST_ASSERT(OS_MBUF_PKTLEN(dup) == 507);
+    rc = os_mbuf_copydata(dup, 0, 16, buf);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(buf, "hdr", 3) == 0);
+    TEST_ASSERT(memcmp(buf + 3, os_mbuf_test_data + 10, 13) == 0);
+
+    /*** Prepending moves the packet header off an external mbuf. */
+    om2 = os_mbuf_get_pkthdr(&os_mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om2 != NULL);
+    os_mbuf_concat(om2, os_mbuf_get_ext(&os_mbuf_pool, &ext, 0, 20));
+    TEST_ASSERT(ext.ome_refcnt == 3);
+    om2 = os_mbuf_prepend(om2, 2);
+    TEST_ASSERT_FATAL(om2 != NULL);
+    os_mbuf_free_chain(om2);
+    TEST_ASSERT(ext.ome_refcnt == 2);
+
+    /*** Released once the last reference is dropped. */
+    os_mbuf_free_chain(om);
+    TEST_ASSERT(ext.ome_refcnt == 1);
+    TEST_ASSERT(os_mbuf_test_ext_freed == 0);
+
+    os_mbuf_free_chain(dup);
+    TEST_ASSERT(ext.ome_refcnt == 0);
+    TEST_ASSERT(os_mbuf_test_ext_freed == 1);
+
+    TEST_ASSERT(os_mbuf_mempool.mp_num_free == MBUF_TEST_POOL_BUF_COUNT);
+}
+
+TEST_CASE(os_mbuf_test_msys)
+{
+    struct os_mbuf *om[MBUF_TEST_SMALL_BUF_COUNT];
+    struct os_mbuf *big;
+    int rc;
+    int i;
+
+    os_mbuf_test_setup();
+
+    rc = OS_MBUF_POOL_INIT(os_mbuf_small_pool, MBUF_TEST_SMALL_BUF_COUNT,
+                           MBUF_TEST_SMALL_BUF_SIZE);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(os_mbuf_small_pool.omp_databuf_len ==
+                MBUF_TEST_SMALL_BUF_SIZE - sizeof (struct os_mbuf));
+
+    /* Registration order does not matter; the smallest fit is used. */
+    os_msys_reset();
+    rc = os_msys_register(&os_mbuf_pool);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = os_msys_register(&os_mbuf_small_pool);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    for (i = 0; i < MBUF_TEST_SMALL_BUF_COUNT; i++) {
+        om[i] = os_msys_get(10, 0);
+        TEST_ASSERT_FATAL(om[i] != NULL);
+        TEST_ASSERT(om[i]->om_omp == &os_mbuf_small_pool);
+    }
+
+    /* The small pool is empty; the allocation falls back to the big one. */
+    big = os_msys_get(10, 0);
+    TEST_ASSERT_FATAL(big != NULL);
+    TEST_ASSERT(big->om_omp == &os_mbuf_pool);
+    TEST_ASSERT(os_mbuf_small_pool_mempool.mp_num_fail == 1);
+    TEST_ASSERT(os_mbuf_small_pool_mempool.mp_min_free == 0);
+
+    os_mbuf_free(big);
+    for (i = 0; i < MBUF_TEST_SMALL_BUF_COUNT; i++) {
+        os_mbuf_free(om[i]);
+    }
+    os_msys_reset();
+}
+
+TEST_CASE(os_mbuf_test_mring)
+{
+    struct os_mbuf *ring[4];
+    struct os_mbuf *out[4];
+    struct os_mbuf *om[6];
+    struct os_mring mr;
+    int rc;
+    int i;
+
+    os_mbuf_test_setup();
+
+    rc = os_mring_init(&mr, ring, 3, NULL);
+    TEST_ASSERT(rc == OS_EINVAL);
+    rc = os_mring_init(&mr, ring, 4, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    for (i = 0; i < 6; i++) {
+        om[i] = os_mbuf_get_pkthdr(&os_mbuf_pool, 0);
+        TEST_ASSERT_FATAL(om[i] != NULL);
+    }
+
+    TEST_ASSERT(os_mring_get(&mr) == NULL);
+
+    /*** Fill the ring. */
+    for (i = 0; i < 4; i++) {
+        rc = os_mring_put(&mr, NULL, om[i]);
+        TEST_ASSERT(rc == 0);
+    }
+    rc = os_mring_put(&mr, NULL, om[4]);
+    TEST_ASSERT(rc == OS_ENOMEM);
+
+    /*** Batched drain returns the oldest entries first. */
+    rc = os_mring_get_n(&mr, out, 3);
+    TEST_ASSERT(rc == 3);
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT(out[i] == om[i]);
+    }
+
+    /*** Wrap around the end of the ring. */
+    rc = os_mring_put(&mr, NULL, om[4]);
+    TEST_ASSERT(rc == 0);
+    rc = os_mring_put(&mr, NULL, om[5]);
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT(os_mring_get(&mr) == om[3]);
+    rc = os_mring_get_n(&mr, out, 4);
+    TEST_ASSERT(rc == 2);
+    TEST_ASSERT(out[0] == om[4]);
+    TEST_ASSERT(out[1] == om[5]);
+    TEST_ASSERT(os_mring_get(&mr) == NULL);
+
+    for (i = 0; i < 6; i++) {
+        os_mbuf_free_chain(om[i]);
+    }
+}
+
+/*
+ * An mbuf which isn't from a pool is left alone when freeing a chain.
+ */
+TEST_CASE(os_mbuf_test_free_chain)
+{
+    static union {
+        struct os_mbuf om;
+        uint8_t buf[sizeof(struct os_mbuf) + 16];
+    } stat;
+    struct os_mbuf *om;
+    struct os_mbuf *om2;
+    int rc;
+
+    os_mbuf_test_setup();
+
+    memset(&stat, 0, sizeof(stat));
+    stat.om.om_data = stat.om.om_databuf;
+    stat.om.om_len = 4;
+
+    om = os_mbuf_get(&os_mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+    om2 = os_mbuf_get(&os_mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om2 != NULL);
+    SLIST_NEXT(om, om_next) = &stat.om;
+    SLIST_NEXT(&stat.om, om_next) = om2;
+
+    rc = os_mbuf_free_chain(om);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(stat.om.om_data == stat.om.om_databuf);
+    TEST_ASSERT(stat.om.om_len == 4);
+    TEST_ASSERT(os_mbuf_mempool.mp_num_free == MBUF_TEST_POOL_BUF_COUNT);
+}
+
+/*
+ * Build a 1kB chain a few bytes at a time, read it back, free it.
+ */
+TEST_BENCH(os_mbuf_test_bench, 15)
+{
+    static uint8_t buf[MBUF_TEST_DATA_LEN];
+    struct os_mbuf *om;
+    int rc;
+    int i;
+
+    om = os_mbuf_get_pkthdr(&os_mbuf_pool, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+
+    for (i = 0; i < MBUF_TEST_DATA_LEN; i += 16) {
+        rc = os_mbuf_append(om, os_mbuf_test_data + i, 16);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    rc = os_mbuf_copydata(om, 0, MBUF_TEST_DATA_LEN, buf);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    os_mbuf_free_chain(om);
+}
+
 TEST_SUITE(os_mbuf_test_suite)
 {
     os_mbuf_test_alloc();
@@ -417,4 +737,12 @@ TEST_SUITE(os_mbuf_test_suite)
     os_mbuf_test_extend();
     os_mbuf_test_adj();
     os_mbuf_test_get_pkthdr();
+    os_mbuf_test_cursor();
+    os_mbuf_test_ext();
+    os_mbuf_test_msys();
+    os_mbuf_test_mring();
+    os_mbuf_test_free_chain();
+
+    os_mbuf_test_setup();
+    os_mbuf_test_bench();
 }
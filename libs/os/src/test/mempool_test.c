@@ -20,6 +20,7 @@
 #include <string.h>
 #include "testutil/testutil.h"
 #include "os/os.h"
+#include "os/os_malloc_class.h"
 #include "os_test_priv.h"
 
 /* Create a memory pool for testing */
@@ -221,7 +222,154 @@ TEST_CASE(os_mempool_test_case)
     mempool_test(NUM_MEM_BLOCKS, MEM_BLOCK_SIZE);
 }
 
+/**
+ * Tests the batch allocation and free functions.
+ */
+TEST_CASE(os_mempool_test_batch)
+{
+    struct os_memblock *block;
+    os_error_t rc;
+    int cnt;
+    int i;
+
+    rc = os_mempool_init(&g_TstMempool, NUM_MEM_BLOCKS, MEM_BLOCK_SIZE,
+                         &TstMembuf[0], "TestMemPool");
+    TEST_ASSERT_FATAL(rc == 0, "Error creating memory pool %d", rc);
+
+    /* Get fewer blocks than the pool holds. */
+    cnt = os_memblock_get_n(&g_TstMempool, block_array, 4);
+    TEST_ASSERT(cnt == 4);
+    TEST_ASSERT(g_TstMempool.mp_num_free == NUM_MEM_BLOCKS - 4);
+
+    /* Asking for more than remain only returns what is left. */
+    cnt = os_memblock_get_n(&g_TstMempool, block_array + 4,
+                            MEMPOOL_TEST_MAX_BLOCKS - 4);
+    TEST_ASSERT(cnt == NUM_MEM_BLOCKS - 4);
+    TEST_ASSERT(g_TstMempool.mp_num_free == 0);
+    TEST_ASSERT(os_memblock_get_n(&g_TstMempool, block_array, 1) == 0);
+    TEST_ASSERT(g_TstMempool.mp_min_free == 0);
+    TEST_ASSERT(g_TstMempool.mp_num_fail == 1);
+
+    for (i = 0; i < NUM_MEM_BLOCKS; i++) {
+        TEST_ASSERT(os_memblock_from(&g_TstMempool, block_array[i]));
+    }
+
+    /* Return all blocks as one list. */
+    for (i = 0; i < NUM_MEM_BLOCKS; i++) {
+        block = block_array[i];
+        if (i == NUM_MEM_BLOCKS - 1) {
+            SLIST_NEXT(block, mb_next) = NULL;
+        } else {
+            SLIST_NEXT(block, mb_next) = block_array[i + 1];
+        }
+    }
+    rc = os_memblock_put_list(&g_TstMempool, block_array[0]);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(g_TstMempool.mp_num_free == NUM_MEM_BLOCKS);
+    TEST_ASSERT(g_TstMempool.mp_min_free == 0);
+
+    /* A list containing a foreign block is rejected as a whole. */
+    cnt = os_memblock_get_n(&g_TstMempool, block_array, 2);
+    TEST_ASSERT_FATAL(cnt == 2);
+    block = block_array[0];
+    SLIST_NEXT(block, mb_next) = (struct os_memblock *)&g_TstMempool;
+    rc = os_memblock_put_list(&g_TstMempool, block);
+    TEST_ASSERT(rc == OS_INVALID_PARM);
+    TEST_ASSERT(g_TstMempool.mp_num_free == NUM_MEM_BLOCKS - 2);
+}
+
+#if OS_MALLOC_SLAB
+static int
+os_malloc_class_test_listed(struct os_mempool *mp)
+{
+    struct os_mempool_info omi;
+    struct os_mempool *cur;
+    int cnt;
+
+    cnt = 0;
+    cur = NULL;
+    while ((cur = os_mempool_info_get_next(cur, &omi)) != NULL) {
+        if (cur == mp) {
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+/**
+ * Tests os_malloc() served from size classes.
+ */
+TEST_CASE(os_malloc_class_test)
+{
+    static os_membuf_t small_buf[OS_MEMPOOL_SIZE(2, 16)];
+    static os_membuf_t large_buf[OS_MEMPOOL_SIZE(2, 64)];
+    static struct os_malloc_class small;
+    static struct os_malloc_class large;
+    void *p[4];
+    int rc;
+
+    os_malloc_class_reset();
+
+    /* Registered out of order; the smallest fitting class is used. */
+    rc = os_malloc_class_init(&large, 64, 2, large_buf, "malloc_64");
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = os_malloc_class_init(&small, 16, 2, small_buf, "malloc_16");
+    TEST_ASSERT_FATAL(rc == 0);
+
+    p[0] = os_malloc(10);
+    TEST_ASSERT(os_memblock_from(&small.omc_pool, p[0]));
+    p[1] = os_malloc(16);
+    TEST_ASSERT(os_memblock_from(&small.omc_pool, p[1]));
+
+    /* Small class is exhausted; the next larger one takes over. */
+    p[2] = os_malloc(10);
+    TEST_ASSERT(os_memblock_from(&large.omc_pool, p[2]));
+    TEST_ASSERT(small.omc_stats.sexhausted == 1);
+
+    /* Too large for any class; comes from the heap. */
+    p[3] = os_malloc(100);
+    TEST_ASSERT_FATAL(p[3] != NULL);
+    TEST_ASSERT(!os_memblock_from(&large.omc_pool, p[3]));
+
+    /* Growing past the block size moves the data to a larger class. */
+    memset(p[0], 0xa5, 16);
+    p[0] = os_realloc(p[0], 40);
+    TEST_ASSERT_FATAL(os_memblock_from(&large.omc_pool, p[0]));
+    TEST_ASSERT(((uint8_t *)p[0])[15] == 0xa5);
+    TEST_ASSERT(small.omc_pool.mp_num_free == 1);
+
+    os_free(p[0]);
+    os_free(p[1]);
+    os_free(p[2]);
+    os_free(p[3]);
+    TEST_ASSERT(small.omc_pool.mp_num_free == 2);
+    TEST_ASSERT(large.omc_pool.mp_num_free == 2);
+    TEST_ASSERT(small.omc_stats.sallocs == small.omc_stats.sfrees);
+    TEST_ASSERT(os_malloc_class_test_listed(&small.omc_pool) == 1);
+
+    /* Reset takes the pools out of the mempool list. */
+    os_malloc_class_reset();
+    TEST_ASSERT(os_malloc_class_test_listed(&small.omc_pool) == 0);
+    TEST_ASSERT(os_malloc_class_test_listed(&large.omc_pool) == 0);
+
+    /* A class can be registered again, and starts with clear counts. */
+    rc = os_malloc_class_init(&small, 16, 2, small_buf, "malloc_16");
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(os_malloc_class_test_listed(&small.omc_pool) == 1);
+    TEST_ASSERT(small.omc_stats.sallocs == 0);
+    p[0] = os_malloc(10);
+    TEST_ASSERT(os_memblock_from(&small.omc_pool, p[0]));
+    os_free(p[0]);
+
+    os_malloc_class_reset();
+}
+#endif
+
 TEST_SUITE(os_mempool_test_suite)
 {
     os_mempool_test_case();
+    os_mempool_test_batch();
+#if OS_MALLOC_SLAB
+    os_malloc_class_test();
+#endif
 }
@@ -32,6 +32,7 @@ os_test_all(void)
     os_mbuf_test_suite();
     os_eventq_test_suite();
     os_callout_test_suite();
+    os_sched_test_suite();
 
     return tu_case_failed;
 }
@@ -28,5 +28,6 @@ int os_mutex_test_suite(void);
 int os_sem_test_suite(void);
 int os_eventq_test_suite(void);
 int os_callout_test_suite(void);
+int os_sched_test_suite(void);
 
 #endif
@@ -0,0 +1,165 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "testutil/testutil.h"
+#include "os/os.h"
+#include "os_test_priv.h"
+
+#define SCHED_TEST_STACK_SIZE   (1024)
+#define SCHED_TEST_NUM_TASKS    (3)
+
+struct os_task sched_test_tasks[SCHED_TEST_NUM_TASKS];
+os_stack_t sched_test_stacks[SCHED_TEST_NUM_TASKS][SCHED_TEST_STACK_SIZE];
+
+static void
+sched_test_task(void *arg)
+{
+    /* Never runs; the OS is not started by this test. */
+}
+
+static void
+sched_test_task_init(int idx, uint8_t prio)
+{
+    int rc;
+
+    rc = os_task_init(&sched_test_tasks[idx], "sched_test", sched_test_task,
+                      NULL, prio, OS_WAIT_FOREVER, sched_test_stacks[idx],
+                      SCHED_TEST_STACK_SIZE);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+TEST_CASE(os_sched_test_order)
+{
+    struct os_task *t;
+    os_sr_t sr;
+
+    os_init();
+
+    sched_test_task_init(0, 10);
+    sched_test_task_init(1, 5);
+    sched_test_task_init(2, 5);
+
+    /* Highest priority first; equal priorities in FIFO order. */
+    TEST_ASSERT(os_sched_next_task() == &sched_test_tasks[1]);
+
+    OS_ENTER_CRITICAL(sr);
+
+    /* Raise the priority of a queued task and resort it. */
+    t = &sched_test_tasks[0];
+    t->t_prio = 1;
+    os_sched_resort(t);
+    TEST_ASSERT(os_sched_next_task() == t);
+
+    /* Lower it again; it goes behind the other ready tasks. */
+    t->t_prio = 100;
+    os_sched_resort(t);
+    TEST_ASSERT(os_sched_next_task() == &sched_test_tasks[1]);
+
+    /* Sleeping tasks are removed from the run list. */
+    os_sched_sleep(&sched_test_tasks[1], OS_TIMEOUT_NEVER);
+    TEST_ASSERT(os_sched_next_task() == &sched_test_tasks[2]);
+    os_sched_sleep(&sched_test_tasks[2], OS_TIMEOUT_NEVER);
+    TEST_ASSERT(os_sched_next_task() == t);
+
+    /* Woken tasks are put back at their priority. */
+    os_sched_wakeup(&sched_test_tasks[2]);
+    TEST_ASSERT(os_sched_next_task() == &sched_test_tasks[2]);
+
+    OS_EXIT_CRITICAL(sr);
+}
+
+TEST_CASE(os_sched_test_sleep)
+{
+    os_time_t now;
+    os_sr_t sr;
+
+    os_init();
+
+    sched_test_task_init(0, 10);
+    sched_test_task_init(1, 11);
+    sched_test_task_init(2, 12);
+
+    OS_ENTER_CRITICAL(sr);
+    now = os_time_get();
+
+    os_sched_sleep(&sched_test_tasks[0], 50);
+    os_sched_sleep(&sched_test_tasks[1], 20);
+    os_sched_sleep(&sched_test_tasks[2], OS_TIMEOUT_NEVER);
+    TEST_ASSERT(os_sched_wakeup_ticks(now) == 20);
+
+    /* Waking the earliest sleeper early exposes the next one. */
+    os_sched_wakeup(&sched_test_tasks[1]);
+    TEST_ASSERT(os_sched_wakeup_ticks(now) == 50);
+
+    os_sched_wakeup(&sched_test_tasks[0]);
+    TEST_ASSERT(os_sched_wakeup_ticks(now) == OS_TIMEOUT_NEVER);
+
+    os_sched_wakeup(&sched_test_tasks[2]);
+    TEST_ASSERT(os_sched_next_task() == &sched_test_tasks[0]);
+    OS_EXIT_CRITICAL(sr);
+}
+
+TEST_CASE(os_sched_test_stack_hwm)
+{
+    struct os_task *t;
+    uint16_t hwm;
+
+    os_init();
+
+    sched_test_task_init(0, 10);
+    t = &sched_test_tasks[0];
+
+    /* The initial stack frame counts as used. */
+    hwm = os_task_stack_hwm(t);
+    TEST_ASSERT(hwm >= t->t_stacktop - t->t_stackptr);
+
+    /* Usage within the scan gap below the mark is picked up. */
+    t->t_stacktop[-(hwm + 10)] = 0;
+    TEST_ASSERT(os_task_stack_hwm(t) == hwm + 10);
+    hwm += 10;
+
+#if OS_STACK_SCAN_GAP
+    /* Usage past a run of untouched words is not looked for. */
+    t->t_stacktop[-(hwm + OS_STACK_SCAN_GAP + 5)] = 0;
+    TEST_ASSERT(os_task_stack_hwm(t) == hwm);
+
+    /* Until the words in between are used as well. */
+    t->t_stacktop[-(hwm + OS_STACK_SCAN_GAP)] = 0;
+    TEST_ASSERT(os_task_stack_hwm(t) == hwm + OS_STACK_SCAN_GAP + 5);
+
+    /* The mark never goes back up. */
+    t->t_stacktop[-(hwm + OS_STACK_SCAN_GAP + 5)] = OS_STACK_PATTERN;
+    TEST_ASSERT(os_task_stack_hwm(t) == hwm + OS_STACK_SCAN_GAP + 5);
+#else
+    /* A frame which skipped over untouched words is still found. */
+    t->t_stacktop[-(hwm + 100)] = 0;
+    TEST_ASSERT(os_task_stack_hwm(t) == hwm + 100);
+
+    /* The mark never goes back up. */
+    t->t_stacktop[-(hwm + 100)] = OS_STACK_PATTERN;
+    TEST_ASSERT(os_task_stack_hwm(t) == hwm + 100);
+#endif
+}
+
+TEST_SUITE(os_sched_test_suite)
+{
+    os_sched_test_order();
+    os_sched_test_sleep();
+    os_sched_test_stack_hwm();
+}
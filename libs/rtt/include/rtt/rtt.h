@@ -0,0 +1,61 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef __RTT_H__
+#define __RTT_H__
+
+#include <inttypes.h>
+
+/*
+ * Ring buffers in RAM, which a debug probe reads (up channels) and writes
+ * (down channels) while the target runs.  The control block has the layout
+ * of SEGGER RTT, so J-Link tools and OpenOCD find and drain it as is.
+ *
+ * Writes never wait for the probe: data which does not fit is dropped.
+ */
+
+#ifndef RTT_MAX_UP_CHANS
+#define RTT_MAX_UP_CHANS        2
+#endif
+#ifndef RTT_MAX_DOWN_CHANS
+#define RTT_MAX_DOWN_CHANS      1
+#endif
+
+/* Size of the buffers of channel 0, set up by rtt_init(). */
+#ifndef RTT_UP_BUF_SZ
+#define RTT_UP_BUF_SZ           1024
+#endif
+#ifndef RTT_DOWN_BUF_SZ
+#define RTT_DOWN_BUF_SZ         16
+#endif
+
+/* Up channel modes when the buffer is full. */
+#define RTT_MODE_SKIP           0       /* Drop the whole write */
+#define RTT_MODE_TRIM           1       /* Write what fits, drop the rest */
+
+int rtt_init(void);
+int rtt_up_config(int chan, const char *name, void *buf, uint32_t size,
+                  int mode);
+int rtt_down_config(int chan, const char *name, void *buf, uint32_t size);
+int rtt_write(int chan, const void *data, uint32_t len);
+int rtt_space(int chan);
+uint32_t rtt_drops(int chan);
+int rtt_read(int chan, void *data, uint32_t len);
+int rtt_rx_avail(int chan);
+
+#endif /* __RTT_H__ */
@@ -0,0 +1,297 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "os/os.h"
+#include "rtt/rtt.h"
+
+struct rtt_buf {
+    const char *rb_name;
+    char *rb_buf;
+    uint32_t rb_size;
+    volatile uint32_t rb_wr_off;
+    volatile uint32_t rb_rd_off;
+    uint32_t rb_flags;
+};
+
+/*
+ * Layout is fixed by the probe side tools.  The debugger finds the block by
+ * searching RAM for the id, or by the symbol name.
+ */
+struct rtt_cb {
+    char rc_id[16];
+    int32_t rc_max_up;
+    int32_t rc_max_down;
+    struct rtt_buf rc_up[RTT_MAX_UP_CHANS];
+    struct rtt_buf rc_down[RTT_MAX_DOWN_CHANS];
+};
+
+struct rtt_cb _SEGGER_RTT;
+
+static uint32_t rtt_up_drops[RTT_MAX_UP_CHANS];
+static char rtt_up_buf[RTT_UP_BUF_SZ];
+static char rtt_down_buf[RTT_DOWN_BUF_SZ];
+
+/*
+ * Buffer contents must be in RAM before the probe sees the new offset.
+ */
+#define RTT_BARRIER()   __asm__ volatile("" ::: "memory")
+
+static int
+rtt_buf_space(const struct rtt_buf *rb)
+{
+    uint32_t rd_off;
+    uint32_t wr_off;
+
+    rd_off = rb->rb_rd_off;
+    wr_off = rb->rb_wr_off;
+    if (rd_off > wr_off) {
+        return rd_off - wr_off - 1;
+    }
+    return rb->rb_size - (wr_off - rd_off) - 1;
+}
+
+int
+rtt_up_config(int chan, const char *name, void *buf, uint32_t size, int mode)
+{
+    struct rtt_buf *rb;
+    os_sr_t sr;
+
+    if (chan < 0 || chan >= RTT_MAX_UP_CHANS || size < 2) {
+        return OS_EINVAL;
+    }
+    rb = &_SEGGER_RTT.rc_up[chan];
+
+    OS_ENTER_CRITICAL(sr);
+    rb->rb_name = name;
+    rb->rb_buf = buf;
+    rb->rb_size = size;
+    rb->rb_wr_off = 0;
+    rb->rb_rd_off = 0;
+    rb->rb_flags = mode;
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
+int
+rtt_down_config(int chan, const char *name, void *buf, uint32_t size)
+{
+    struct rtt_buf *rb;
+    os_sr_t sr;
+
+    if (chan < 0 || chan >= RTT_MAX_DOWN_CHANS || size < 2) {
+        return OS_EINVAL;
+    }
+    rb = &_SEGGER_RTT.rc_down[chan];
+
+    OS_ENTER_CRITICAL(sr);
+    rb->rb_name = name;
+    rb->rb_buf = buf;
+    rb->rb_size = size;
+    rb->rb_wr_off = 0;
+    rb->rb_rd_off = 0;
+    rb->rb_flags = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
+/**
+ * Sets up the control block, with channel 0 in both directions.  Can be
+ * called more than once; subsequent calls do nothing.
+ */
+int
+rtt_init(void)
+{
+    struct rtt_cb *rc;
+
+    rc = &_SEGGER_RTT;
+    if (rc->rc_max_up) {
+        return 0;
+    }
+
+    rc->rc_max_up = RTT_MAX_UP_CHANS;
+    rc->rc_max_down = RTT_MAX_DOWN_CHANS;
+    rtt_up_config(0, "Terminal", rtt_up_buf, sizeof(rtt_up_buf),
+                  RTT_MODE_TRIM);
+    rtt_down_config(0, "Terminal", rtt_down_buf, sizeof(rtt_down_buf));
+
+    /*
+     * The id goes in last, so the probe never finds a block being set up.
+     * It is put together at runtime so that the string isn't found in
+     * flash as well.
+     */
+    RTT_BARRIER();
+    strcpy(&rc->rc_id[7], "RTT");
+    RTT_BARRIER();
+    memcpy(&rc->rc_id[0], "SEGGER", 6);
+    rc->rc_id[6] = ' ';
+
+    return 0;
+}
+
+/**
+ * Writes data to an up channel.  Does not wait for the probe; data which
+ * does not fit is dropped, as per the mode of the channel.
+ *
+ * @return Number of bytes written, OS_EINVAL on bad channel.
+ */
+int
+rtt_write(int chan, const void *data, uint32_t len)
+{
+    struct rtt_buf *rb;
+    const uint8_t *src;
+    uint32_t wr_off;
+    uint32_t cnt;
+    int space;
+    os_sr_t sr;
+
+    if (chan < 0 || chan >= RTT_MAX_UP_CHANS) {
+        return OS_EINVAL;
+    }
+    rb = &_SEGGER_RTT.rc_up[chan];
+    if (!rb->rb_buf) {
+        return OS_EINVAL;
+    }
+
+    src = data;
+    OS_ENTER_CRITICAL(sr);
+    space = rtt_buf_space(rb);
+    if (len > space) {
+        if (rb->rb_flags == RTT_MODE_SKIP) {
+            rtt_up_drops[chan] += len;
+            len = 0;
+        } else {
+            rtt_up_drops[chan] += len - space;
+            len = space;
+        }
+    }
+
+    wr_off = rb->rb_wr_off;
+    cnt = rb->rb_size - wr_off;
+    if (cnt > len) {
+        cnt = len;
+    }
+    memcpy(rb->rb_buf + wr_off, src, cnt);
+    memcpy(rb->rb_buf, src + cnt, len - cnt);
+    wr_off += len;
+    if (wr_off >= rb->rb_size) {
+        wr_off -= rb->rb_size;
+    }
+    RTT_BARRIER();
+    rb->rb_wr_off = wr_off;
+    OS_EXIT_CRITICAL(sr);
+
+    return len;
+}
+
+/**
+ * @return Number of bytes which can be written to an up channel without
+ * dropping any, OS_EINVAL on bad channel.
+ */
+int
+rtt_space(int chan)
+{
+    if (chan < 0 || chan >= RTT_MAX_UP_CHANS ||
+      !_SEGGER_RTT.rc_up[chan].rb_buf) {
+        return OS_EINVAL;
+    }
+    return rtt_buf_space(&_SEGGER_RTT.rc_up[chan]);
+}
+
+/**
+ * @return Number of bytes dropped from an up channel since startup.
+ */
+uint32_t
+rtt_drops(int chan)
+{
+    if (chan < 0 || chan >= RTT_MAX_UP_CHANS) {
+        return 0;
+    }
+    return rtt_up_drops[chan];
+}
+
+/**
+ * Reads data the probe has written to a down channel.
+ *
+ * @return Number of bytes read, OS_EINVAL on bad channel.
+ */
+int
+rtt_read(int chan, void *data, uint32_t len)
+{
+    struct rtt_buf *rb;
+    uint8_t *dst;
+    uint32_t rd_off;
+    uint32_t wr_off;
+    uint32_t cnt;
+    uint32_t total;
+    os_sr_t sr;
+
+    if (chan < 0 || chan >= RTT_MAX_DOWN_CHANS) {
+        return OS_EINVAL;
+    }
+    rb = &_SEGGER_RTT.rc_down[chan];
+    if (!rb->rb_buf) {
+        return OS_EINVAL;
+    }
+
+    dst = data;
+    total = 0;
+    OS_ENTER_CRITICAL(sr);
+    rd_off = rb->rb_rd_off;
+    wr_off = rb->rb_wr_off;
+    while (total < len && rd_off != wr_off) {
+        if (wr_off > rd_off) {
+            cnt = wr_off - rd_off;
+        } else {
+            cnt = rb->rb_size - rd_off;
+        }
+        if (cnt > len - total) {
+            cnt = len - total;
+        }
+        memcpy(dst + total, rb->rb_buf + rd_off, cnt);
+        total += cnt;
+        rd_off += cnt;
+        if (rd_off >= rb->rb_size) {
+            rd_off = 0;
+        }
+    }
+    RTT_BARRIER();
+    rb->rb_rd_off = rd_off;
+    OS_EXIT_CRITICAL(sr);
+
+    return total;
+}
+
+/**
+ * @return Nonzero if the probe has written data to a down channel which
+ * has not been read yet.
+ */
+int
+rtt_rx_avail(int chan)
+{
+    const struct rtt_buf *rb;
+
+    if (chan < 0 || chan >= RTT_MAX_DOWN_CHANS) {
+        return 0;
+    }
+    rb = &_SEGGER_RTT.rc_down[chan];
+    return rb->rb_buf && rb->rb_rd_off != rb->rb_wr_off;
+}
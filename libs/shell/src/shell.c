@@ -41,6 +41,9 @@ static struct os_mqueue g_shell_nlip_mq;
 #define OS_EVENT_T_CONSOLE_RDY  (OS_EVENT_T_PERUSER)
 #define SHELL_HELP_PER_LINE     6
 #define SHELL_MAX_ARGS          20
+#ifndef SHELL_NLIP_MAX_LINE
+#define SHELL_NLIP_MAX_LINE     120     /* base64 chars per NLIP line */
+#endif
 
 static int shell_echo_cmd(int argc, char **argv);
 static int shell_help_cmd(int argc, char **argv);
@@ -68,7 +71,7 @@ static struct shell_cmd g_shell_os_date_cmd = {
 
 static struct os_task shell_task;
 static struct os_eventq shell_evq;
-static struct os_event console_rdy_ev;
+static struct os_cevent console_rdy_ev;
 
 static struct os_mutex g_shell_cmd_list_lock;
 
@@ -119,9 +122,15 @@ err:
     return (rc);
 }
 
+/*
+ * Command list is kept sorted by name; lookup can stop as soon as it's
+ * past the point where the command would be.
+ */
 int
 shell_cmd_register(struct shell_cmd *sc)
 {
+    struct shell_cmd *prev;
+    struct shell_cmd *cur;
     int rc;
 
     /* Add the command that is being registered. */
@@ -130,7 +139,18 @@ shell_cmd_register(struct shell_cmd *sc)
         goto err;
     }
 
-    STAILQ_INSERT_TAIL(&g_shell_cmd_list, sc, sc_next);
+    prev = NULL;
+    STAILQ_FOREACH(cur, &g_shell_cmd_list, sc_next) {
+        if (strcmp(cur->sc_cmd, sc->sc_cmd) > 0) {
+            break;
+        }
+        prev = cur;
+    }
+    if (prev) {
+        STAILQ_INSERT_AFTER(&g_shell_cmd_list, prev, sc, sc_next);
+    } else {
+        STAILQ_INSERT_HEAD(&g_shell_cmd_list, sc, sc_next);
+    }
 
     rc = shell_cmd_list_unlock();
     if (rc != 0) {
@@ -154,7 +174,11 @@ shell_cmd(char *cmd, char **argv, int argc)
     }
 
     STAILQ_FOREACH(sc, &g_shell_cmd_list, sc_next) {
-        if (!strcmp(sc->sc_cmd, cmd)) {
+        rc = strcmp(sc->sc_cmd, cmd);
+        if (rc >= 0) {
+            if (rc > 0) {
+                sc = NULL;
+            }
             break;
         }
     }
@@ -175,20 +199,32 @@ err:
     return (rc);
 }
 
+/*
+ * Splits the line in place; argv entries point to shell_line.
+ */
 static int
 shell_process_command(char *line, int len)
 {
-    char *tok;
-    char *tok_ptr;
+    char *end;
     int argc;
 
-    tok_ptr = NULL;
-    tok = strtok_r(line, " ", &tok_ptr);
+    end = line + len;
     argc = 0;
-    while (argc < SHELL_MAX_ARGS - 1 && tok != NULL) {
-        argv[argc++] = tok;
-
-        tok = strtok_r(NULL, " ", &tok_ptr);
+    while (argc < SHELL_MAX_ARGS - 1) {
+        while (line < end && (*line == ' ' || *line == '\0')) {
+            line++;
+        }
+        if (line >= end) {
+            break;
+        }
+        argv[argc++] = line;
+        while (line < end && *line != ' ' && *line != '\0') {
+            line++;
+        }
+        if (line >= end) {
+            break;
+        }
+        *line++ = '\0';
     }
 
     /* Terminate the argument list with a null pointer. */
@@ -201,44 +237,67 @@ shell_process_command(char *line, int len)
 }
 
 
+/*
+ * Base64 data is decoded straight into the mbuf chain, one 4 character
+ * token at a time.
+ */
 static int
 shell_nlip_process(char *data, int len)
 {
-    uint16_t copy_len;
+    uint8_t hdr[3];
+    uint8_t *ptr;
+    char *end;
     int rc;
+    int over;
     struct os_mbuf *m;
     uint16_t crc;
 
-    rc = base64_decode(data, data);
-    if (rc < 0) {
-        goto err;
-    }
-    len = rc;
-
+    end = data + len;
     if (g_nlip_mbuf == NULL) {
-        if (len < 2) {
+        /* Packet starts with length */
+        rc = base64_decode_n(data, 4, hdr);
+        if (rc < 2) {
             rc = -1;
             goto err;
         }
 
-        g_nlip_expected_len = ntohs(*(uint16_t *) data);
+        g_nlip_expected_len = (hdr[0] << 8) | hdr[1];
         g_nlip_mbuf = os_msys_get_pkthdr(g_nlip_expected_len, 0);
         if (!g_nlip_mbuf) {
             rc = -1;
             goto err;
         }
-
-        data += sizeof(uint16_t);
-        len -= sizeof(uint16_t);
+        if (rc > 2) {
+            rc = os_mbuf_append(g_nlip_mbuf, &hdr[2], rc - 2);
+            if (rc != 0) {
+                goto err;
+            }
+        }
+        data += 4;
     }
 
-    copy_len = min(g_nlip_expected_len - OS_MBUF_PKTHDR(g_nlip_mbuf)->omp_len,
-            len);
-
-    rc = os_mbuf_copyinto(g_nlip_mbuf, OS_MBUF_PKTHDR(g_nlip_mbuf)->omp_len,
-            data, copy_len);
-    if (rc != 0) {
-        goto err;
+    while (data < end &&
+      OS_MBUF_PKTHDR(g_nlip_mbuf)->omp_len < g_nlip_expected_len) {
+        ptr = os_mbuf_extend(g_nlip_mbuf, 3);
+        if (!ptr) {
+            rc = -1;
+            goto err;
+        }
+        rc = base64_decode_n(data, min(end - data, 4), ptr);
+        if (rc < 0) {
+            goto err;
+        }
+        if (rc < 3) {
+            os_mbuf_adj(g_nlip_mbuf, rc - 3);
+        }
+        if (rc == 0) {
+            break;
+        }
+        data += 4;
+    }
+    over = OS_MBUF_PKTHDR(g_nlip_mbuf)->omp_len - g_nlip_expected_len;
+    if (over > 0) {
+        os_mbuf_adj(g_nlip_mbuf, -over);
     }
 
     if (OS_MBUF_PKTHDR(g_nlip_mbuf)->omp_len == g_nlip_expected_len) {
@@ -265,22 +324,23 @@ err:
     return (rc);
 }
 
+/*
+ * Payload bytes per NLIP output line; multiple of 3, so that only the
+ * last line of a packet gets padded.
+ */
+#define SHELL_NLIP_LINE_DATA    ((SHELL_NLIP_MAX_LINE - 1) / 4 * 3)
+
 static int
 shell_nlip_mtx(struct os_mbuf *m)
 {
-#define SHELL_NLIP_MTX_BUF_SIZE (12)
-    uint8_t readbuf[SHELL_NLIP_MTX_BUF_SIZE];
-    char encodebuf[BASE64_ENCODE_SIZE(SHELL_NLIP_MTX_BUF_SIZE)];
-    char pkt_seq[2] = { SHELL_NLIP_PKT_START1, SHELL_NLIP_PKT_START2 };
-    char esc_seq[2] = { SHELL_NLIP_DATA_START1, SHELL_NLIP_DATA_START2 };
+    uint8_t readbuf[SHELL_NLIP_LINE_DATA];
+    char line[2 + BASE64_ENCODE_SIZE(SHELL_NLIP_LINE_DATA) + 1];
     uint16_t totlen;
     uint16_t dlen;
     uint16_t off;
     uint16_t crc;
     int rb_off;
     int elen;
-    uint16_t nwritten;
-    uint16_t linelen;
     int rc;
     struct os_mbuf *tmp;
     void *ptr;
@@ -292,11 +352,14 @@ shell_nlip_mtx(struct os_mbuf *m)
      *  - total packet length (uint16_t)
      *  - data
      *  - crc
-     * base64 encoded data must be less than 122 bytes per line to
-     * avoid overflows and adhere to convention.
+     * base64 encoded data must be less than SHELL_NLIP_MAX_LINE bytes
+     * per line to avoid overflows and adhere to convention.
      *
      * continuation packets are preceded by 04 20 until the entire
      * buffer has been sent.
+     *
+     * Each line is encoded in full, and written out with a single
+     * console_write().
      */
     crc = CRC16_INITIAL_CRC;
     for (tmp = m; tmp; tmp = SLIST_NEXT(tmp, om_next)) {
@@ -311,20 +374,17 @@ shell_nlip_mtx(struct os_mbuf *m)
     memcpy(ptr, &crc, sizeof(crc));
 
     totlen = OS_MBUF_PKTHDR(m)->omp_len;
-    nwritten = 0;
     off = 0;
 
     /* Start a packet */
-    console_write(pkt_seq, sizeof(pkt_seq));
-
-    linelen = 0;
-
-    rb_off = 2;
+    line[0] = SHELL_NLIP_PKT_START1;
+    line[1] = SHELL_NLIP_PKT_START2;
     dlen = htons(totlen);
     memcpy(readbuf, &dlen, sizeof(dlen));
+    rb_off = sizeof(dlen);
 
-    while (totlen > 0) {
-        dlen = min(SHELL_NLIP_MTX_BUF_SIZE - rb_off, totlen);
+    while (1) {
+        dlen = min(SHELL_NLIP_LINE_DATA - rb_off, totlen - off);
 
         rc = os_mbuf_copydata(m, off, dlen, readbuf + rb_off);
         if (rc != 0) {
@@ -332,34 +392,18 @@ shell_nlip_mtx(struct os_mbuf *m)
         }
         off += dlen;
 
-        /* If the next packet will overwhelm the line length, truncate
-         * this line.
-         */
-        if (linelen +
-                BASE64_ENCODE_SIZE(min(SHELL_NLIP_MTX_BUF_SIZE - rb_off,
-                        totlen - dlen)) >= 120) {
-            elen = base64_encode(readbuf, dlen + rb_off, encodebuf, 1);
-            console_write(encodebuf, elen);
-            console_write("\n", 1);
-            console_write(esc_seq, sizeof(esc_seq));
-            linelen = 0;
-        } else {
-            elen = base64_encode(readbuf, dlen + rb_off, encodebuf, 0);
-            console_write(encodebuf, elen);
-            linelen += elen;
-        }
+        elen = base64_encode(readbuf, dlen + rb_off, &line[2], 1);
+        line[2 + elen] = '\n';
+        console_write(line, elen + 3);
 
+        if (off >= totlen) {
+            break;
+        }
+        line[0] = SHELL_NLIP_DATA_START1;
+        line[1] = SHELL_NLIP_DATA_START2;
         rb_off = 0;
-
-        nwritten += elen;
-        totlen -= dlen;
     }
 
-    elen = base64_pad(encodebuf, linelen);
-    console_write(encodebuf, elen);
-
-    console_write("\n", 1);
-
     return (0);
 err:
     return (rc);
@@ -423,7 +467,11 @@ shell_read_console(void)
         }
         shell_line_len += rc;
         if (full_line) {
-            if (shell_line_len > 2) {
+            /*
+             * NLIP frames start with a control character, which never
+             * starts a command line.
+             */
+            if (shell_line_len > 2 && shell_line[0] < ' ') {
                 if (shell_line[0] == SHELL_NLIP_PKT_START1 &&
                         shell_line[1] == SHELL_NLIP_PKT_START2) {
                     if (g_nlip_mbuf) {
@@ -436,8 +484,6 @@ shell_read_console(void)
                 } else if (shell_line[0] == SHELL_NLIP_DATA_START1 &&
                         shell_line[1] == SHELL_NLIP_DATA_START2) {
                     rc = shell_nlip_process(&shell_line[2], shell_line_len - 2);
-                } else {
-                    shell_process_command(shell_line, shell_line_len);
                 }
             } else {
                 shell_process_command(shell_line, shell_line_len);
@@ -453,8 +499,6 @@ shell_task_func(void *arg)
 {
     struct os_event *ev;
 
-    console_rdy_ev.ev_type = OS_EVENT_T_CONSOLE_RDY;
-
     while (1) {
         ev = os_eventq_get(&shell_evq);
         assert(ev != NULL);
@@ -462,6 +506,7 @@ shell_task_func(void *arg)
         switch (ev->ev_type) {
             case OS_EVENT_T_CONSOLE_RDY:
                 // Read and process all available lines on the console.
+                os_cevent_take(&console_rdy_ev, NULL);
                 shell_read_console();
                 break;
             case OS_EVENT_T_MQUEUE_DATA:
@@ -479,7 +524,7 @@ shell_task_func(void *arg)
 void
 shell_console_rx_cb(void)
 {
-    os_eventq_put(&shell_evq, &console_rdy_ev);
+    os_cevent_put(&shell_evq, &console_rdy_ev, 0);
 }
 
 static int
@@ -570,6 +615,7 @@ shell_task_init(uint8_t prio, os_stack_t *stack, uint16_t stack_size,
     }
 
     os_eventq_init(&shell_evq);
+    os_cevent_init(&console_rdy_ev, OS_EVENT_T_CONSOLE_RDY, NULL);
     os_mqueue_init(&g_shell_nlip_mq, NULL);
 
     console_init(shell_console_rx_cb);
@@ -110,9 +110,11 @@ shell_os_mpool_display_cmd(int argc, char **argv)
             }
         }
 
-        console_printf("  %s (blksize: %d, nblocks: %d, nfree: %d)\n",
+        console_printf("  %s (blksize: %d, nblocks: %d, nfree: %d, "
+                "minfree: %d, nfail: %lu)\n",
                 omi.omi_name, omi.omi_block_size, omi.omi_num_blocks,
-                omi.omi_num_free);
+                omi.omi_num_free, omi.omi_min_free,
+                (unsigned long)omi.omi_num_fail);
     }
 
     if (name && !found) {
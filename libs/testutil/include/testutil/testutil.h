@@ -50,6 +50,15 @@ struct tu_config {
 
     tu_restart_fn_t *tc_restart_cb;
     void *tc_restart_arg;
+
+    /*
+     * Sim only: number of top-level suites run at the same time, each in
+     * a forked process; 0 takes it from the TU_JOBS environment variable,
+     * and 1 runs them one after another. Output of each suite is printed
+     * in order once it finishes, and failures are folded into the exit
+     * status of the test binary.
+     */
+    int tc_jobs;
 };
 
 extern struct tu_config tu_config;
@@ -60,6 +69,22 @@ extern int tu_first_idx;
 typedef void tu_post_test_fn_t(void *arg);
 
 void tu_suite_set_post_test_cb(tu_post_test_fn_t *cb, void *cb_arg);
+
+/*
+ * Timing of a TEST_BENCH case, in units of tu_bench_unit: nanoseconds on
+ * sim, CPU cycles on Cortex-M3/M4 (DWT cycle counter), cputime ticks
+ * elsewhere.
+ */
+struct tu_bench_result {
+    uint32_t tbr_min;
+    uint32_t tbr_median;
+    uint32_t tbr_p90;
+    uint32_t tbr_p99;
+    uint32_t tbr_max;
+};
+
+extern struct tu_bench_result tu_bench_last;
+extern const char *tu_bench_unit;
 int tu_parse_args(int argc, char **argv);
 int tu_init(void);
 void tu_restart(void);
@@ -70,6 +95,7 @@ void tu_restart(void);
 
 void tu_suite_complete(void);
 void tu_suite_init(const char *name);
+int tu_suite_fork(void);
 
 void tu_case_init(const char *name);
 void tu_case_complete(void);
@@ -79,6 +105,13 @@ void tu_case_write_pass_auto(void);
 void tu_case_pass_manual(const char *file, int line,
                          const char *format, ...);
 void tu_case_post_test(void);
+void tu_case_write_pass_msg(const char *format, ...);
+
+typedef void tu_bench_fn_t(void);
+#define TU_BENCH_MAX_RUNS   31
+void tu_bench_run(tu_bench_fn_t *fn, int runs);
+void tu_bench_report(uint32_t *times, int cnt);
+uint32_t tu_arch_bench_time(void);
 
 extern int tu_any_failed;
 extern int tu_suite_failed;
@@ -93,6 +126,9 @@ extern jmp_buf tu_case_jb;
     int                                                                       \
     suite_name(void)                                                          \
     {                                                                         \
+        if (tu_suite_fork()) {                                                \
+            return 0;                                                         \
+        }                                                                     \
         tu_suite_init(#suite_name);                                           \
         TEST_SUITE_##suite_name();                                            \
         tu_suite_complete();                                                  \
@@ -131,6 +167,39 @@ extern jmp_buf tu_case_jb;
     static void                                                               \
     TEST_CASE_##case_name(void)
 
+/*
+ * Benchmark case: body is timed runs times, and min/median/max are
+ * reported as the pass message (and so to testreport). Body can use
+ * TEST_ASSERT as usual. Results are left in tu_bench_last.
+ *
+ * Cases which need setup outside the timed region, or per operation
+ * latencies, can be plain TEST_CASEs that collect tu_arch_bench_time()
+ * deltas themselves and pass them to tu_bench_report().
+ */
+#define TEST_BENCH(bench_name, runs)                                          \
+    static void TEST_BENCH_##bench_name(void);                                \
+                                                                              \
+    int                                                                       \
+    bench_name(void)                                                          \
+    {                                                                         \
+        if (tu_case_idx >= tu_first_idx) {                                    \
+            tu_case_init(#bench_name);                                        \
+                                                                              \
+            if (setjmp(tu_case_jb) == 0) {                                    \
+                tu_bench_run(TEST_BENCH_##bench_name, (runs));                \
+                tu_case_post_test();                                          \
+                tu_case_write_pass_auto();                                    \
+            }                                                                 \
+        }                                                                     \
+                                                                              \
+        tu_case_complete();                                                   \
+                                                                              \
+        return tu_case_failed;                                                \
+    }                                                                         \
+                                                                              \
+    static void                                                               \
+    TEST_BENCH_##bench_name(void)
+
 #define FIRST_AUX(first, ...) first
 #define FIRST(...) FIRST_AUX(__VA_ARGS__, _)
 
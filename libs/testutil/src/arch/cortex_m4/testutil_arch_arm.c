@@ -17,7 +17,9 @@
  * under the License.
  */
 
+#include "os/os.h"
 #include "hal/hal_system.h"
+#include "hal/hal_cputime.h"
 #include "testutil_priv.h"
 
 void
@@ -25,3 +27,38 @@ tu_arch_restart(void)
 {
     system_reset();
 }
+
+int
+tu_arch_suite_fork(void)
+{
+    return 0;
+}
+
+void
+tu_arch_suite_exit(void)
+{
+}
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+const char *tu_bench_unit = "cycles";
+
+uint32_t
+tu_arch_bench_time(void)
+{
+    if (!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+    return DWT->CYCCNT;
+}
+#else
+/* No cycle counter; cputime must have been initialized by the app. */
+const char *tu_bench_unit = "cputime ticks";
+
+uint32_t
+tu_arch_bench_time(void)
+{
+    return cputime_get32();
+}
+#endif
@@ -17,6 +17,12 @@
  * under the License.
  */
 
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "os/os.h"
 #include "os/os_arch.h"
 #include "os/os_test.h"
@@ -28,3 +34,181 @@ tu_arch_restart(void)
     os_arch_os_stop();
     tu_case_abort();
 }
+
+const char *tu_bench_unit = "ns";
+
+uint32_t
+tu_arch_bench_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/*
+ * Parallel suites. Each top-level suite is forked off with its output
+ * going to an unlinked temporary file; the parent keeps up to tc_jobs of
+ * them running, and copies their output to its own stdout in the order
+ * they were started.
+ */
+#define TU_SIM_MAX_PENDING  64
+
+struct tu_sim_job {
+    pid_t pid;
+    int fd;
+    int done;
+    int failed;
+};
+
+static struct tu_sim_job tu_sim_jobs[TU_SIM_MAX_PENDING];
+static int tu_sim_head;
+static int tu_sim_pending;
+static int tu_sim_running;
+static int tu_sim_child;
+
+static int
+tu_sim_max_jobs(void)
+{
+    const char *env;
+
+    if (tu_config.tc_jobs == 0) {
+        env = getenv("TU_JOBS");
+        tu_config.tc_jobs = env ? atoi(env) : 1;
+        if (tu_config.tc_jobs < 1) {
+            tu_config.tc_jobs = 1;
+        }
+    }
+    return tu_config.tc_jobs;
+}
+
+static struct tu_sim_job *
+tu_sim_job(int i)
+{
+    return &tu_sim_jobs[(tu_sim_head + i) % TU_SIM_MAX_PENDING];
+}
+
+/* Prints the output of finished suites at the head of the queue. */
+static void
+tu_sim_flush(void)
+{
+    struct tu_sim_job *job;
+    char buf[512];
+    ssize_t len;
+
+    fflush(stdout);
+    while (tu_sim_pending && tu_sim_job(0)->done) {
+        job = tu_sim_job(0);
+        lseek(job->fd, 0, SEEK_SET);
+        while ((len = read(job->fd, buf, sizeof(buf))) > 0) {
+            if (write(STDOUT_FILENO, buf, len) != len) {
+                break;
+            }
+        }
+        close(job->fd);
+        if (job->failed) {
+            tu_any_failed = 1;
+        }
+        tu_sim_head = (tu_sim_head + 1) % TU_SIM_MAX_PENDING;
+        tu_sim_pending--;
+    }
+}
+
+/* Waits for a child (any if pid is -1), and prints what can be printed. */
+static void
+tu_sim_reap(pid_t pid)
+{
+    struct tu_sim_job *job;
+    int status;
+    int i;
+
+    pid = waitpid(pid, &status, 0);
+    assert(pid > 0);
+    for (i = 0; i < tu_sim_pending; i++) {
+        job = tu_sim_job(i);
+        if (job->pid == pid) {
+            job->done = 1;
+            job->failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            tu_sim_running--;
+            break;
+        }
+    }
+    tu_sim_flush();
+}
+
+/*
+ * Runs at exit of the parent, after main() has returned tu_any_failed as
+ * it was before the children finished; exits again with failure status if
+ * any of them failed.
+ */
+static void
+tu_sim_join(void)
+{
+    while (tu_sim_pending) {
+        tu_sim_reap(tu_sim_job(0)->pid);
+    }
+    if (tu_any_failed) {
+        fflush(NULL);
+        _exit(1);
+    }
+}
+
+int
+tu_arch_suite_fork(void)
+{
+    static int registered;
+    struct tu_sim_job *job;
+    char name[] = "/tmp/tu_XXXXXX";
+    pid_t pid;
+    int fd;
+
+    if (tu_sim_child || tu_sim_max_jobs() <= 1) {
+        return 0;
+    }
+    if (!registered) {
+        atexit(tu_sim_join);
+        registered = 1;
+    }
+
+    while (tu_sim_running >= tu_config.tc_jobs) {
+        tu_sim_reap(-1);
+    }
+    while (tu_sim_pending == TU_SIM_MAX_PENDING) {
+        tu_sim_reap(tu_sim_job(0)->pid);
+    }
+
+    fd = mkstemp(name);
+    assert(fd >= 0);
+    unlink(name);
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        tu_sim_child = 1;
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+        return 0;
+    }
+
+    job = tu_sim_job(tu_sim_pending++);
+    job->pid = pid;
+    job->fd = fd;
+    job->done = 0;
+    job->failed = 0;
+    tu_sim_running++;
+
+    return 1;
+}
+
+void
+tu_arch_suite_exit(void)
+{
+    if (tu_sim_child) {
+        fflush(stdout);
+        fflush(stderr);
+        _exit(tu_any_failed);
+    }
+}
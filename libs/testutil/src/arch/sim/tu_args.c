@@ -1,4 +1,5 @@
 #include <errno.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include "testutil/testutil.h"
@@ -8,12 +9,16 @@ tu_parse_args(int argc, char **argv)
 {
     int ch;
 
-    while ((ch = getopt(argc, argv, "s")) != -1) {
+    while ((ch = getopt(argc, argv, "sj:")) != -1) {
         switch (ch) {
         case 's':
             tu_config.tc_system_assert = 1;
             break;
 
+        case 'j':
+            tu_config.tc_jobs = atoi(optarg);
+            break;
+
         default:
             return EINVAL;
         }
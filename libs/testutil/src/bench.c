@@ -0,0 +1,87 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdio.h>
+#include "testutil/testutil.h"
+#include "testutil_priv.h"
+
+struct tu_bench_result tu_bench_last;
+
+void
+tu_bench_run(tu_bench_fn_t *fn, int runs)
+{
+    uint32_t times[TU_BENCH_MAX_RUNS];
+    uint32_t start;
+    int i;
+
+    if (runs > TU_BENCH_MAX_RUNS) {
+        runs = TU_BENCH_MAX_RUNS;
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    for (i = 0; i < runs; i++) {
+        start = tu_arch_bench_time();
+        fn();
+        times[i] = tu_arch_bench_time() - start;
+    }
+
+    tu_bench_report(times, runs);
+}
+
+/*
+ * Sorts cnt samples in place, and reports their distribution as the pass
+ * message of the current case.
+ */
+void
+tu_bench_report(uint32_t *times, int cnt)
+{
+    uint32_t t;
+    int i;
+    int j;
+
+    if (cnt < 1) {
+        return;
+    }
+
+    /* Insertion sort; sample counts are small. */
+    for (i = 1; i < cnt; i++) {
+        t = times[i];
+        for (j = i; j > 0 && times[j - 1] > t; j--) {
+            times[j] = times[j - 1];
+        }
+        times[j] = t;
+    }
+
+    tu_bench_last.tbr_min = times[0];
+    tu_bench_last.tbr_median = times[cnt / 2];
+    tu_bench_last.tbr_p90 = times[(cnt * 9) / 10];
+    tu_bench_last.tbr_p99 = times[(cnt * 99) / 100];
+    tu_bench_last.tbr_max = times[cnt - 1];
+
+    tu_case_write_pass_msg("runs=%d min=%lu median=%lu p90=%lu p99=%lu "
+                           "max=%lu %s", cnt,
+                           (unsigned long)tu_bench_last.tbr_min,
+                           (unsigned long)tu_bench_last.tbr_median,
+                           (unsigned long)tu_bench_last.tbr_p90,
+                           (unsigned long)tu_bench_last.tbr_p99,
+                           (unsigned long)tu_bench_last.tbr_max,
+                           tu_bench_unit);
+}
@@ -185,6 +185,32 @@ tu_case_write_pass_auto(void)
     }
 }
 
+/*
+ * Reports a pass with a message, without ending the case.
+ */
+void
+tu_case_write_pass_msg(const char *format, ...)
+{
+    va_list ap;
+    int rc;
+
+    if (tu_case_reported) {
+        return;
+    }
+
+    tu_case_buf_len = 0;
+
+    va_start(ap, format);
+    rc = tu_case_vappend_buf(format, ap);
+    assert(rc == 0);
+    va_end(ap);
+
+    rc = tu_case_append_buf("\n");
+    assert(rc == 0);
+
+    tu_case_write_pass_buf();
+}
+
 void
 tu_case_fail_assert(int fatal, const char *file, int line,
                     const char *expr, const char *format, ...)
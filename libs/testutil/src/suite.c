@@ -24,6 +24,9 @@
 const char *tu_suite_name = 0;
 int tu_suite_failed = 0;
 
+/* Nesting of suites; only top-level suites are run in their own process. */
+static int tu_suite_depth;
+
 static void
 tu_suite_set_name(const char *name)
 {
@@ -52,6 +55,25 @@ void
 tu_suite_complete(void)
 {
     tu_suite_set_post_test_cb(NULL, NULL);
+
+    if (--tu_suite_depth == 0) {
+        tu_arch_suite_exit();
+    }
+}
+
+/**
+ * Called before a suite runs. Returns nonzero if the suite was handed off
+ * to be run elsewhere (a child process on sim), and the caller should
+ * skip it.
+ */
+int
+tu_suite_fork(void)
+{
+    if (tu_suite_depth == 0 && tu_arch_suite_fork()) {
+        return 1;
+    }
+    tu_suite_depth++;
+    return 0;
 }
 
 void
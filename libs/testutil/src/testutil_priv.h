@@ -26,6 +26,8 @@
 #include "testutil/testutil.h"
 
 void tu_arch_restart(void);
+int tu_arch_suite_fork(void);
+void tu_arch_suite_exit(void);
 void tu_case_abort(void);
 
 extern tu_post_test_fn_t *tu_case_post_test_cb;
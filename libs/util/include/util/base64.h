@@ -24,9 +24,25 @@
 
 int base64_encode(const void *, int, char *, uint8_t);
 int base64_decode(const char *, void *buf);
+int base64_decode_n(const char *, int len, void *buf);
 int base64_pad(char *, int);
 int base64_decode_len(const char *str);
 
+/*
+ * Incremental decoder, for input arriving in pieces. Splits need not
+ * fall on 4 character boundaries.
+ */
+struct base64_decoder {
+    uint32_t bd_val;
+    uint8_t bd_cnt;
+    uint8_t bd_pad;
+};
+
+void base64_decoder_init(struct base64_decoder *bd);
+int base64_decoder_run(struct base64_decoder *bd, const char *str, int len,
+                       void *buf);
+
 #define BASE64_ENCODE_SIZE(__size) ((((__size) * 4) / 3) + 4)
+#define BASE64_DECODE_SIZE(__len) ((((__len) + 3) / 4) * 3)
 
 #endif /* __UTIL_BASE64_H__ */
@@ -24,6 +24,7 @@
 struct cbmem_entry_hdr {
     uint16_t ceh_len;
     uint16_t ceh_flags;
+    uint16_t ceh_prev_len;  /* ceh_len of previous entry, for walking back */
 } __attribute__((packed));
 
 struct cbmem {
@@ -55,8 +56,17 @@ int cbmem_lock_release(struct cbmem *cbmem);
 int cbmem_init(struct cbmem *cbmem, void *buf, uint32_t buf_len);
 int cbmem_append(struct cbmem *cbmem, void *data, uint16_t len);
 void cbmem_iter_start(struct cbmem *cbmem, struct cbmem_iter *iter);
+void cbmem_iter_start_at(struct cbmem *cbmem, struct cbmem_iter *iter,
+        struct cbmem_entry_hdr *hdr);
+void cbmem_iter_start_last(struct cbmem *cbmem, struct cbmem_iter *iter,
+        int cnt);
 struct cbmem_entry_hdr *cbmem_iter_next(struct cbmem *cbmem, 
         struct cbmem_iter *iter);
+void cbmem_iter_start_rev(struct cbmem *cbmem, struct cbmem_iter *iter);
+struct cbmem_entry_hdr *cbmem_iter_prev(struct cbmem *cbmem,
+        struct cbmem_iter *iter);
+struct cbmem_entry_hdr *cbmem_entry_prev(struct cbmem *cbmem,
+        struct cbmem_entry_hdr *hdr);
 int cbmem_read(struct cbmem *cbmem, struct cbmem_entry_hdr *hdr, void *buf, 
         uint16_t off, uint16_t len);
 int cbmem_walk(struct cbmem *cbmem, cbmem_walk_func_t walk_func, void *arg);
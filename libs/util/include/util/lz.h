@@ -0,0 +1,57 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _UTIL_LZ_H_
+#define _UTIL_LZ_H_
+
+#include <inttypes.h>
+
+/*
+ * Byte oriented LZ77 compression with a small dictionary, the last
+ * LZ_WIN_SZ bytes. Compressed data is a sequence of tokens:
+ *   0x00-0x7f: literal run; token + 1 bytes follow.
+ *   0x80-0xff: match of (token & 0x7f) + LZ_MATCH_MIN bytes, copied from
+ *              (following byte) + 1 bytes back.
+ *
+ * The dictionary carries over from one call to the next, so data can be
+ * compressed a piece at a time. Tokens do not span calls; the pieces can
+ * be decompressed one at a time, in the same order, with a state that was
+ * initialized at the same point.
+ */
+#define LZ_WIN_SZ               256
+#define LZ_MATCH_MIN            3
+#define LZ_MATCH_MAX            (0x7f + LZ_MATCH_MIN)
+#define LZ_LIT_MAX              128
+
+/* Worst case size of len bytes compressed. */
+#define LZ_COMPRESS_BOUND(len)  ((len) + ((len) + LZ_LIT_MAX - 1) / LZ_LIT_MAX)
+
+struct lz_state {
+    uint8_t lz_win[LZ_WIN_SZ];
+    uint16_t lz_pos;            /* Where the next byte goes in lz_win */
+    uint16_t lz_len;            /* Valid bytes in lz_win */
+};
+
+void lz_init(struct lz_state *lz);
+int lz_compress(struct lz_state *lz, const void *src, int len, void *dst,
+                int dst_len);
+int lz_decompress(struct lz_state *lz, const void *src, int len, void *dst,
+                  int dst_len);
+
+#endif
@@ -64,4 +64,83 @@ struct tpq_elem *tpq_get(struct tpq *tpq);
  */
 void tpq_init(struct tpq *tpq, uint8_t ev_type, void *ev_arg);
 
+/*
+ * One urgency level of a priority task packet queue.  Owned by the queue;
+ * configure it with tpq_prio_level_cfg().
+ */
+struct tpq_prio_level
+{
+    STAILQ_HEAD(, tpq_elem) tpl_head;
+    uint16_t tpl_cnt;
+    uint16_t tpl_max;       /* Max depth; 0 = unbounded */
+    uint8_t tpl_weight;     /* 0 = strict priority */
+    uint8_t tpl_credit;
+};
+
+/*
+ * Task packet queue with several urgency levels, level 0 being the most
+ * urgent.  A single event is posted for all levels, as with a plain tpq.
+ */
+struct tpq_prio
+{
+    struct tpq_prio_level *tpp_levels;
+    uint8_t tpp_num_levels;
+    struct os_event tpp_ev;
+};
+
+/**
+ * Initialize a priority task packet queue.  All levels start out as
+ * unbounded and strict.
+ *
+ * @param tpp           Pointer to priority task packet queue
+ * @param levels        Array of num_levels level structures
+ * @param num_levels    Number of urgency levels
+ * @param ev_type       Type of event
+ * @param ev_arg        Argument of event
+ */
+void tpq_prio_init(struct tpq_prio *tpp, struct tpq_prio_level *levels,
+                   uint8_t num_levels, uint8_t ev_type, void *ev_arg);
+
+/**
+ * Configure one level of a priority task packet queue.
+ *
+ * @param tpp           Pointer to priority task packet queue
+ * @param level         Level to configure
+ * @param max_depth     Max number of elements queued at this level;
+ *                      0 for no limit
+ * @param weight        0 for strict priority: this level is always served
+ *                      before the less urgent ones.  Otherwise, the number of
+ *                      elements served from this level in a row before one
+ *                      is taken from a less urgent level, if any is waiting.
+ *
+ * @return 0 on success, OS_EINVAL on bad level.
+ */
+int tpq_prio_level_cfg(struct tpq_prio *tpp, uint8_t level,
+                       uint16_t max_depth, uint8_t weight);
+
+/**
+ * Put an element on a given level of a priority task packet queue and post
+ * an event to an event queue.
+ *
+ * @param evq   Pointer to event queue
+ * @param tpp   Pointer to priority task packet queue
+ * @param level Urgency level; 0 is the most urgent
+ * @param elem  Pointer to element to enqueue
+ *
+ * @return 0 on success, OS_ENOMEM if the level is full, OS_EINVAL on bad
+ * level.  The element is not queued on failure.
+ */
+int tpq_prio_put(struct os_eventq *evq, struct tpq_prio *tpp, uint8_t level,
+                 struct tpq_elem *elem);
+
+/**
+ * Retrieve the next element to process from a priority task packet queue.
+ *
+ * @param tpp       Pointer to priority task packet queue
+ * @param out_level If not NULL, level of the element is returned here
+ *
+ * @return struct tpq_elem*, NULL if all levels are empty
+ */
+struct tpq_elem *tpq_prio_get(struct tpq_prio *tpp, uint8_t *out_level);
+
 #endif /* __UTIL_TPQ_H__ */
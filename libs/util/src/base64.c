@@ -39,75 +39,98 @@
  */
 
 #include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 
 #include <stdio.h>
 
 #include <util/base64.h>
 
-static const char base64_chars[] = 
+static const char base64_chars[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-static int 
+#define B64_INV         0xff    /* not in alphabet */
+#define B64_PAD         0xfe    /* '=' */
+
+/*
+ * Reverse of base64_chars[], for 7-bit characters.
+ */
+static const uint8_t base64_vals[128] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff,   62, 0xff, 0xff, 0xff,   63,
+      52,   53,   54,   55,   56,   57,   58,   59,
+      60,   61, 0xff, 0xff, 0xff, 0xfe, 0xff, 0xff,
+    0xff,    0,    1,    2,    3,    4,    5,    6,
+       7,    8,    9,   10,   11,   12,   13,   14,
+      15,   16,   17,   18,   19,   20,   21,   22,
+      23,   24,   25, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff,   26,   27,   28,   29,   30,   31,   32,
+      33,   34,   35,   36,   37,   38,   39,   40,
+      41,   42,   43,   44,   45,   46,   47,   48,
+      49,   50,   51, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+static inline uint8_t
 pos(char c)
 {
-    const char *p;
-    for (p = base64_chars; *p; p++)
-        if (*p == c)
-            return p - base64_chars;
-    return -1;
+    if ((unsigned char)c >= sizeof(base64_vals)) {
+        return B64_INV;
+    }
+    return base64_vals[(unsigned char)c];
 }
 
-int 
+int
 base64_encode(const void *data, int size, char *s, uint8_t should_pad)
 {
+    const unsigned char *q;
+    uint32_t val;
     char *p;
     int i;
-    int c;
-    const unsigned char *q;
-    char *last;
-    int diff;
 
     p = s;
-
     q = (const unsigned char *) data;
-    last = NULL;
-    i = 0;
-    while (i < size) {
-        c = q[i++];
-        c *= 256;
-        if (i < size)
-            c += q[i];
-        i++;
-        c *= 256;
-        if (i < size)
-            c += q[i];
-        i++;
-        p[0] = base64_chars[(c & 0x00fc0000) >> 18];
-        p[1] = base64_chars[(c & 0x0003f000) >> 12];
-        p[2] = base64_chars[(c & 0x00000fc0) >> 6];
-        p[3] = base64_chars[(c & 0x0000003f) >> 0];
-        last = p;
+
+    /* Full 3 byte groups */
+    for (i = 0; i + 3 <= size; i += 3) {
+        val = (q[i] << 16) | (q[i + 1] << 8) | q[i + 2];
+        p[0] = base64_chars[val >> 18];
+        p[1] = base64_chars[(val >> 12) & 0x3f];
+        p[2] = base64_chars[(val >> 6) & 0x3f];
+        p[3] = base64_chars[val & 0x3f];
         p += 4;
     }
 
-    if (last) {
-        diff = i - size;
-        if (diff > 0) {
-            if (should_pad) {
-                memset(last + (4 - diff), '=', diff);
-            } else {
-                p = last + (4 - diff);
+    /* 1 or 2 bytes left over */
+    if (i < size) {
+        val = q[i] << 16;
+        if (i + 1 < size) {
+            val |= q[i + 1] << 8;
+        }
+        p[0] = base64_chars[val >> 18];
+        p[1] = base64_chars[(val >> 12) & 0x3f];
+        if (i + 1 < size) {
+            p[2] = base64_chars[(val >> 6) & 0x3f];
+            p += 3;
+        } else {
+            p += 2;
+        }
+        if (should_pad) {
+            while ((p - s) & 3) {
+                *p++ = '=';
             }
         }
-    } 
+    }
 
     *p = 0;
 
     return (p - s);
 }
 
-int 
+int
 base64_pad(char *buf, int len)
 {
     int remainder;
@@ -122,52 +145,149 @@ base64_pad(char *buf, int len)
     return (4 - remainder);
 }
 
-#define DECODE_ERROR -1
-
-static unsigned int
-token_decode(const char *token)
+/*
+ * Decode at most len characters from str; stops at first character
+ * which is not part of base64 alphabet. len should be a multiple of 4.
+ */
+int
+base64_decode_n(const char *str, int len, void *data)
 {
+    const char *p;
+    const char *end;
+    unsigned char *q;
+    uint8_t v[4];
+    uint32_t val;
+    int pad;
     int i;
-    unsigned int val = 0;
-    int marker = 0;
-    if (strlen(token) < 4)
-        return DECODE_ERROR;
-    for (i = 0; i < 4; i++) {
-        val *= 64;
-        if (token[i] == '=')
-            marker++;
-        else if (marker > 0)
-            return DECODE_ERROR;
-        else
-            val += pos(token[i]);
+
+    q = data;
+    end = str + len;
+    for (p = str; p < end && pos(*p) != B64_INV; p += 4) {
+        for (i = 0; i < 4; i++) {
+            v[i] = pos(p[i]);
+        }
+        if (((v[0] | v[1] | v[2] | v[3]) & 0xc0) == 0) {
+            /* Common case: 4 data characters */
+            val = (v[0] << 18) | (v[1] << 12) | (v[2] << 6) | v[3];
+            q[0] = val >> 16;
+            q[1] = val >> 8;
+            q[2] = val;
+            q += 3;
+            continue;
+        }
+
+        /*
+         * Padding, or error. Also catches token being cut short by NUL.
+         */
+        if ((v[0] | v[1]) & 0xc0) {
+            return -1;
+        }
+        if (v[2] == B64_PAD) {
+            if (v[3] != B64_PAD) {
+                return -1;
+            }
+            pad = 2;
+        } else if (v[2] & 0xc0 || v[3] != B64_PAD) {
+            return -1;
+        } else {
+            pad = 1;
+        }
+        val = (v[0] << 18) | (v[1] << 12) | ((v[2] & 0x3f) << 6);
+        *q++ = val >> 16;
+        if (pad < 2) {
+            *q++ = val >> 8;
+        }
     }
-    if (marker > 2)
-        return DECODE_ERROR;
-    return (marker << 24) | val;
+    return q - (unsigned char *) data;
 }
 
-int 
+int
 base64_decode(const char *str, void *data)
 {
-    const char *p;
+    return base64_decode_n(str, INT_MAX, data);
+}
+
+void
+base64_decoder_init(struct base64_decoder *bd)
+{
+    bd->bd_val = 0;
+    bd->bd_cnt = 0;
+    bd->bd_pad = 0;
+}
+
+/*
+ * Decode len characters from str, continuing from where previous call
+ * left off. Output is what could be completed; a partial group is kept
+ * in bd until the rest of it arrives. data must have room for
+ * BASE64_DECODE_SIZE(len) bytes.
+ *
+ * Returns number of bytes written to data, -1 on malformed input.
+ */
+int
+base64_decoder_run(struct base64_decoder *bd, const char *str, int len,
+                   void *data)
+{
     unsigned char *q;
+    uint32_t val;
+    uint8_t c;
 
     q = data;
-    for (p = str; *p && (*p == '=' || strchr(base64_chars, *p)); p += 4) {
-        unsigned int val = token_decode(p);
-        unsigned int marker = (val >> 24) & 0xff;
-        if (val == DECODE_ERROR)
+    val = bd->bd_val;
+    while (len > 0) {
+        /* Fast path: whole groups, starting at group boundary */
+        if (bd->bd_cnt == 0) {
+            while (len >= 4) {
+                c = pos(str[0]) | pos(str[1]) | pos(str[2]) | pos(str[3]);
+                if (c & 0xc0) {
+                    break;
+                }
+                val = (pos(str[0]) << 18) | (pos(str[1]) << 12) |
+                  (pos(str[2]) << 6) | pos(str[3]);
+                q[0] = val >> 16;
+                q[1] = val >> 8;
+                q[2] = val;
+                q += 3;
+                str += 4;
+                len -= 4;
+            }
+            val = 0;
+            if (len == 0) {
+                break;
+            }
+        }
+
+        c = pos(*str++);
+        len--;
+        if (c == B64_INV) {
             return -1;
-        *q++ = (val >> 16) & 0xff;
-        if (marker < 2)
-            *q++ = (val >> 8) & 0xff;
-        if (marker < 1)
-            *q++ = val & 0xff;
+        }
+        if (c == B64_PAD) {
+            if (bd->bd_cnt < 2) {
+                return -1;
+            }
+            bd->bd_pad++;
+            c = 0;
+        } else if (bd->bd_pad) {
+            return -1;
+        }
+        val = (val << 6) | c;
+        if (++bd->bd_cnt == 4) {
+            *q++ = val >> 16;
+            if (bd->bd_pad < 2) {
+                *q++ = val >> 8;
+            }
+            if (bd->bd_pad < 1) {
+                *q++ = val;
+            }
+            val = 0;
+            bd->bd_cnt = 0;
+            bd->bd_pad = 0;
+        }
     }
+    bd->bd_val = val;
     return q - (unsigned char *) data;
 }
 
-
 int
 base64_decode_len(const char *str)
 {
@@ -78,6 +78,7 @@ int
 cbmem_append(struct cbmem *cbmem, void *data, uint16_t len)
 {
     struct cbmem_entry_hdr *dst;
+    uint16_t prev_len;
     uint8_t *start;
     uint8_t *end;
     int rc;
@@ -89,8 +90,10 @@ cbmem_append(struct cbmem *cbmem, void *data, uint16_t len)
 
     if (cbmem->c_entry_end) {
         dst = CBMEM_ENTRY_NEXT(cbmem->c_entry_end);
+        prev_len = cbmem->c_entry_end->ceh_len;
     } else {
         dst = (struct cbmem_entry_hdr *) cbmem->c_buf;
+        prev_len = 0;
     }
     end = (uint8_t *) dst + len + sizeof(*dst);
 
@@ -126,6 +129,8 @@ cbmem_append(struct cbmem *cbmem, void *data, uint16_t len)
     /* Copy the entry into the log 
      */
     dst->ceh_len = len;
+    dst->ceh_flags = 0;
+    dst->ceh_prev_len = prev_len;
     memcpy((uint8_t *) dst + sizeof(*dst), data, len);
 
     cbmem->c_entry_end = dst;
@@ -151,6 +156,43 @@ cbmem_iter_start(struct cbmem *cbmem, struct cbmem_iter *iter)
     iter->ci_end = cbmem->c_entry_end;
 }
 
+/*
+ * Start iterating from a given entry, which must be in the buffer, towards
+ * the newest one.
+ */
+void
+cbmem_iter_start_at(struct cbmem *cbmem, struct cbmem_iter *iter,
+        struct cbmem_entry_hdr *hdr)
+{
+    iter->ci_start = hdr;
+    iter->ci_cur = hdr;
+    iter->ci_end = hdr ? cbmem->c_entry_end : NULL;
+}
+
+/*
+ * Start iterating over the newest cnt entries, oldest of them first. Costs
+ * cnt steps rather than a walk of the whole buffer.
+ */
+void
+cbmem_iter_start_last(struct cbmem *cbmem, struct cbmem_iter *iter, int cnt)
+{
+    struct cbmem_entry_hdr *hdr;
+    struct cbmem_entry_hdr *prev;
+
+    hdr = NULL;
+    if (cnt > 0) {
+        hdr = cbmem->c_entry_end;
+        while (hdr && --cnt > 0) {
+            prev = cbmem_entry_prev(cbmem, hdr);
+            if (!prev) {
+                break;
+            }
+            hdr = prev;
+        }
+    }
+    cbmem_iter_start_at(cbmem, iter, hdr);
+}
+
 struct cbmem_entry_hdr *
 cbmem_iter_next(struct cbmem *cbmem, struct cbmem_iter *iter)
 {
@@ -181,6 +223,55 @@ err:
     return (hdr);
 }
 
+/*
+ * Returns the entry appended before hdr, or NULL if hdr is the oldest one.
+ */
+struct cbmem_entry_hdr *
+cbmem_entry_prev(struct cbmem *cbmem, struct cbmem_entry_hdr *hdr)
+{
+    uint8_t *end;
+
+    if (!hdr || hdr == cbmem->c_entry_start) {
+        return (NULL);
+    }
+
+    /* The entry at the start of the buffer follows the one which was last
+     * before the wrap.
+     */
+    if ((uint8_t *) hdr == cbmem->c_buf) {
+        end = cbmem->c_buf_cur_end;
+    } else {
+        end = (uint8_t *) hdr;
+    }
+
+    return ((struct cbmem_entry_hdr *) (end - sizeof(*hdr) -
+                hdr->ceh_prev_len));
+}
+
+/*
+ * Start iterating from the newest entry towards the oldest one.
+ */
+void
+cbmem_iter_start_rev(struct cbmem *cbmem, struct cbmem_iter *iter)
+{
+    iter->ci_start = cbmem->c_entry_start;
+    iter->ci_cur = cbmem->c_entry_end;
+    iter->ci_end = cbmem->c_entry_end;
+}
+
+struct cbmem_entry_hdr *
+cbmem_iter_prev(struct cbmem *cbmem, struct cbmem_iter *iter)
+{
+    struct cbmem_entry_hdr *hdr;
+
+    hdr = iter->ci_cur;
+    if (hdr) {
+        iter->ci_cur = cbmem_entry_prev(cbmem, hdr);
+    }
+
+    return (hdr);
+}
+
 int
 cbmem_flush(struct cbmem *cbmem)
 {
@@ -57,6 +57,7 @@
  *    from: src/sys/i386/isa/clock.c,v 1.176 2001/09/04
  */
 
+#include <os/os.h>
 #include <os/os_time.h>
 
 #include <stdio.h>
@@ -75,8 +76,6 @@ struct clocktime {
     int usec;   /* micro seconds */
 };
 
-#define days_in_year(y)     (leapyear(y) ? 366 : 365)
-
 #define    FEBRUARY    2
 #define days_in_month(y, m) \
     (month_days[(m) - 1] + (m == FEBRUARY ? leapyear(y) : 0))
@@ -88,6 +87,34 @@ static const int month_days[12] = {
     31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
 };
 
+/* Days in the year before the first of each month, in a common year */
+static const uint16_t month_days_before[13] = {
+    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365
+};
+
+/* Number of leap years from 1 AD up to and including 'y' */
+#define leapyears_thru(y)   ((y) / 4 - (y) / 100 + (y) / 400)
+
+/* Days from 1/1/1970 to 1/1 of 'y' */
+#define days_before_year(y) \
+    (((y) - POSIX_BASE_YEAR) * 365 + \
+     leapyears_thru((y) - 1) - leapyears_thru(POSIX_BASE_YEAR - 1))
+
+/* Days from 1/1 to the first of month 'm' (1 - 12) of year 'y' */
+#define days_before_month(y, m) \
+    (month_days_before[(m) - 1] + ((m) > FEBRUARY ? leapyear(y) : 0))
+
+/*
+ * Date of the day most recently converted by timeval_to_clocktime();
+ * consecutive timestamps are usually from the same day.
+ */
+static struct {
+    int days;
+    int year;
+    int mon;
+    int day;
+} datetime_last_day = { -1 };
+
 #define POSIX_BASE_YEAR 1970
 #define SECDAY  (24 * 60 * 60)
 
@@ -118,7 +145,7 @@ leapyear(int year)
 static int
 clocktime_to_timeval(const struct clocktime *ct, struct os_timeval *tv)
 {
-    int i, year, days;
+    int year, days;
 
     year = ct->year;
 
@@ -137,14 +164,8 @@ clocktime_to_timeval(const struct clocktime *ct, struct os_timeval *tv)
      * Compute days since start of time
      * First from years, then from months.
      */
-    days = 0;
-    for (i = POSIX_BASE_YEAR; i < year; i++)
-        days += days_in_year(i);
-
-    /* Months */
-    for (i = 1; i < ct->mon; i++)
-          days += days_in_month(year, i);
-    days += (ct->day - 1);
+    days = days_before_year(year) + days_before_month(year, ct->mon) +
+        (ct->day - 1);
 
     tv->tv_sec = (((int64_t)days * 24 + ct->hour) * 60 + ct->min) * 60 +
         ct->sec;
@@ -157,9 +178,10 @@ static int
 timeval_to_clocktime(const struct os_timeval *tv, const struct os_timezone *tz,
     struct clocktime *ct)
 {
-    int i, year, days;
+    int mon, year, days, dayno;
     int64_t rsec;           /* remainder seconds */
     int64_t secs;
+    os_sr_t sr;
 
     secs = tv->tv_sec;
     if (tz != NULL) {
@@ -174,21 +196,47 @@ timeval_to_clocktime(const struct os_timeval *tv, const struct os_timezone *tz,
 
     days = secs / SECDAY;
     rsec = secs % SECDAY;
+    dayno = days;
 
     ct->dow = day_of_week(days);
 
-    /* Subtract out whole years, counting them in i. */
-    for (year = POSIX_BASE_YEAR; days >= days_in_year(year); year++)
-        days -= days_in_year(year);
-    ct->year = year;
+    OS_ENTER_CRITICAL(sr);
+    if (dayno == datetime_last_day.days) {
+        ct->year = datetime_last_day.year;
+        ct->mon = datetime_last_day.mon;
+        ct->day = datetime_last_day.day;
+    } else {
+        ct->year = -1;
+    }
+    OS_EXIT_CRITICAL(sr);
 
-    /* Subtract out whole months, counting them in i. */
-    for (i = 1; days >= days_in_month(year, i); i++)
-        days -= days_in_month(year, i);
-    ct->mon = i;
+    if (ct->year < 0) {
+        /*
+         * The estimate can only be too high; by one year per 1460 years
+         * elapsed, at most.
+         */
+        year = POSIX_BASE_YEAR + days / 365;
+        while (days_before_year(year) > days) {
+            year--;
+        }
+        ct->year = year;
+        days -= days_before_year(year);
 
-    /* Days are what is left over (+1) from all that. */
-    ct->day = days + 1;
+        /* At most 12 steps through the table. */
+        for (mon = 12; days < days_before_month(year, mon); mon--) {
+        }
+        ct->mon = mon;
+
+        /* Days are what is left over (+1) from all that. */
+        ct->day = days - days_before_month(year, mon) + 1;
+
+        OS_ENTER_CRITICAL(sr);
+        datetime_last_day.days = dayno;
+        datetime_last_day.year = ct->year;
+        datetime_last_day.mon = ct->mon;
+        datetime_last_day.day = ct->day;
+        OS_EXIT_CRITICAL(sr);
+    }
 
     /* Hours, minutes, seconds are easy */
     ct->hour = rsec / 3600;
@@ -362,6 +410,21 @@ err:
     return (-1);
 }
 
+/*
+ * Writes 'val' as exactly 'digits' decimal digits, zero padded.
+ */
+static char *
+format_digits(char *cp, int val, int digits)
+{
+    int i;
+
+    for (i = digits - 1; i >= 0; i--) {
+        cp[i] = '0' + val % 10;
+        val /= 10;
+    }
+    return (cp + digits);
+}
+
 int
 format_datetime(const struct os_timeval *tv, const struct os_timezone *tz,
     char *ostr, int olen)
@@ -379,16 +442,26 @@ format_datetime(const struct os_timeval *tv, const struct os_timezone *tz,
     cp = ostr;
     rlen = olen;
 
-    rc = snprintf(cp, rlen, "%04d-%02d-%02dT%02d:%02d:%02d",
-        ct.year, ct.mon, ct.day, ct.hour, ct.min, ct.sec);
-    cp += rc;
-    rlen -= rc;
-    if (rc < 0 || rlen <= 0) {
-        goto err;
-    }
-
-    if (ct.usec != 0) {
-        rc = snprintf(cp, rlen, ".%06d", ct.usec);
+    /* Fixed width fields are written directly; this runs for every log
+     * timestamp rendered.
+     */
+    if (ct.year <= 9999 && rlen > 19) {
+        cp = format_digits(cp, ct.year, 4);
+        *cp++ = '-';
+        cp = format_digits(cp, ct.mon, 2);
+        *cp++ = '-';
+        cp = format_digits(cp, ct.day, 2);
+        *cp++ = 'T';
+        cp = format_digits(cp, ct.hour, 2);
+        *cp++ = ':';
+        cp = format_digits(cp, ct.min, 2);
+        *cp++ = ':';
+        cp = format_digits(cp, ct.sec, 2);
+        *cp = '\0';
+        rlen -= 19;
+    } else {
+        rc = snprintf(cp, rlen, "%04d-%02d-%02dT%02d:%02d:%02d",
+            ct.year, ct.mon, ct.day, ct.hour, ct.min, ct.sec);
         cp += rc;
         rlen -= rc;
         if (rc < 0 || rlen <= 0) {
@@ -396,6 +469,16 @@ format_datetime(const struct os_timeval *tv, const struct os_timezone *tz,
         }
     }
 
+    if (ct.usec != 0) {
+        if (rlen <= 7) {
+            goto err;
+        }
+        *cp++ = '.';
+        cp = format_digits(cp, ct.usec, 6);
+        *cp = '\0';
+        rlen -= 7;
+    }
+
     if (tz != NULL) {
         minswest = tz->tz_minuteswest;
         if (tz->tz_dsttime) {
@@ -0,0 +1,205 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+
+#include "util/lz.h"
+
+#define LZ_WIN_MASK             (LZ_WIN_SZ - 1)
+
+void
+lz_init(struct lz_state *lz)
+{
+    lz->lz_pos = 0;
+    lz->lz_len = 0;
+}
+
+static void
+lz_push(struct lz_state *lz, uint8_t byte)
+{
+    lz->lz_win[lz->lz_pos] = byte;
+    lz->lz_pos = (lz->lz_pos + 1) & LZ_WIN_MASK;
+    if (lz->lz_len < LZ_WIN_SZ) {
+        lz->lz_len++;
+    }
+}
+
+/*
+ * Byte at position pos of the input being compressed; negative positions
+ * are in the dictionary.
+ */
+static uint8_t
+lz_hist(const struct lz_state *lz, const uint8_t *src, int pos)
+{
+    if (pos >= 0) {
+        return src[pos];
+    }
+    return lz->lz_win[(lz->lz_pos + pos) & LZ_WIN_MASK];
+}
+
+/**
+ * Compresses a piece of data, and adds it to the dictionary.
+ *
+ * @param lz                    Compression state.
+ * @param src                   Data to compress.
+ * @param len                   Length of data.
+ * @param dst                   Where to write compressed data.
+ * @param dst_len               Size of dst; LZ_COMPRESS_BOUND(len) is
+ *                                  always enough.
+ *
+ * @return                      Length of compressed data; -1 if it did not
+ *                                  fit in dst.
+ */
+int
+lz_compress(struct lz_state *lz, const void *src, int len, void *dst,
+            int dst_len)
+{
+    const uint8_t *in;
+    uint8_t *out;
+    int best_len;
+    int best_dist;
+    int max_dist;
+    int lit_start;
+    int olen;
+    int dist;
+    int mlen;
+    int lit;
+    int i;
+
+    in = src;
+    out = dst;
+    olen = 0;
+    lit_start = 0;
+    i = 0;
+    while (i <= len) {
+        best_len = 0;
+        best_dist = 0;
+        if (i < len) {
+            max_dist = i + lz->lz_len;
+            if (max_dist > LZ_WIN_SZ) {
+                max_dist = LZ_WIN_SZ;
+            }
+            for (dist = 1; dist <= max_dist; dist++) {
+                for (mlen = 0; i + mlen < len && mlen < LZ_MATCH_MAX; mlen++) {
+                    if (lz_hist(lz, in, i + mlen - dist) != in[i + mlen]) {
+                        break;
+                    }
+                }
+                if (mlen > best_len) {
+                    best_len = mlen;
+                    best_dist = dist;
+                    if (mlen == LZ_MATCH_MAX) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        /* Flush literals before a match, at the end, or when run is full. */
+        lit = i - lit_start;
+        if (lit && (best_len >= LZ_MATCH_MIN || i == len || lit == LZ_LIT_MAX)) {
+            if (olen + 1 + lit > dst_len) {
+                return -1;
+            }
+            out[olen++] = lit - 1;
+            memcpy(out + olen, in + lit_start, lit);
+            olen += lit;
+            lit_start = i;
+        }
+        if (i == len) {
+            break;
+        }
+
+        if (best_len >= LZ_MATCH_MIN) {
+            if (olen + 2 > dst_len) {
+                return -1;
+            }
+            out[olen++] = 0x80 | (best_len - LZ_MATCH_MIN);
+            out[olen++] = best_dist - 1;
+            i += best_len;
+            lit_start = i;
+        } else {
+            i++;
+        }
+    }
+
+    for (i = 0; i < len; i++) {
+        lz_push(lz, in[i]);
+    }
+    return olen;
+}
+
+/**
+ * Decompresses a piece of data compressed with lz_compress().
+ *
+ * @param lz                    Decompression state.
+ * @param src                   Compressed data, whole tokens.
+ * @param len                   Length of compressed data.
+ * @param dst                   Where to write data.
+ * @param dst_len               Size of dst.
+ *
+ * @return                      Length of data; -1 if compressed data is
+ *                                  corrupt, or if dst is too small.
+ */
+int
+lz_decompress(struct lz_state *lz, const void *src, int len, void *dst,
+              int dst_len)
+{
+    const uint8_t *in;
+    uint8_t *out;
+    uint8_t byte;
+    int olen;
+    int dist;
+    int cnt;
+    int i;
+
+    in = src;
+    out = dst;
+    olen = 0;
+    i = 0;
+    while (i < len) {
+        if (in[i] & 0x80) {
+            if (i + 2 > len) {
+                return -1;
+            }
+            cnt = (in[i] & 0x7f) + LZ_MATCH_MIN;
+            dist = in[i + 1] + 1;
+            i += 2;
+            if (dist > lz->lz_len || olen + cnt > dst_len) {
+                return -1;
+            }
+            while (cnt--) {
+                byte = lz->lz_win[(lz->lz_pos - dist) & LZ_WIN_MASK];
+                lz_push(lz, byte);
+                out[olen++] = byte;
+            }
+        } else {
+            cnt = in[i] + 1;
+            i++;
+            if (i + cnt > len || olen + cnt > dst_len) {
+                return -1;
+            }
+            while (cnt--) {
+                lz_push(lz, in[i]);
+                out[olen++] = in[i++];
+            }
+        }
+    }
+    return olen;
+}
@@ -0,0 +1,124 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+
+#include "testutil/testutil.h"
+#include "util/base64.h"
+
+TEST_CASE(base64_test_roundtrip)
+{
+    uint8_t data[32];
+    uint8_t out[32];
+    char enc[BASE64_ENCODE_SIZE(sizeof(data))];
+    int len;
+    int rc;
+    int i;
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = i * 37 + 1;
+    }
+    for (len = 1; len < sizeof(data); len++) {
+        base64_encode(data, len, enc, 1);
+        memset(out, 0, sizeof(out));
+        rc = base64_decode(enc, out);
+        TEST_ASSERT(rc == len, "len=%d rc=%d", len, rc);
+        TEST_ASSERT(!memcmp(data, out, len), "len=%d", len);
+    }
+}
+
+TEST_CASE(base64_test_decode_n)
+{
+    uint8_t out[8];
+    int rc;
+
+    rc = base64_decode_n("Zm9vYmFy", 4, out);
+    TEST_ASSERT(rc == 3);
+    TEST_ASSERT(!memcmp(out, "foo", 3));
+
+    rc = base64_decode_n("Zm9vYmFy", 8, out);
+    TEST_ASSERT(rc == 6);
+    TEST_ASSERT(!memcmp(out, "foobar", 6));
+
+    /* Stops at end of base64 data */
+    rc = base64_decode_n("Zm8=\n", 8, out);
+    TEST_ASSERT(rc == 2);
+    TEST_ASSERT(!memcmp(out, "fo", 2));
+
+    /* Truncated or garbled tokens are errors */
+    TEST_ASSERT(base64_decode("Zm9", out) == -1);
+    TEST_ASSERT(base64_decode("Zm*v", out) == -1);
+}
+
+TEST_CASE(base64_test_nopad)
+{
+    char enc[8];
+
+    TEST_ASSERT(base64_encode("f", 1, enc, 0) == 2);
+    TEST_ASSERT(!strcmp(enc, "Zg"));
+    TEST_ASSERT(base64_encode("fo", 2, enc, 0) == 3);
+    TEST_ASSERT(!strcmp(enc, "Zm8"));
+    TEST_ASSERT(base64_encode("fo", 2, enc, 1) == 4);
+    TEST_ASSERT(!strcmp(enc, "Zm8="));
+    TEST_ASSERT(base64_encode("", 0, enc, 1) == 0);
+}
+
+TEST_CASE(base64_test_stream)
+{
+    struct base64_decoder bd;
+    uint8_t data[64];
+    uint8_t out[64 + 3];
+    char enc[BASE64_ENCODE_SIZE(sizeof(data))];
+    int elen;
+    int split;
+    int len;
+    int rc;
+    int i;
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = i * 101 + 7;
+    }
+    for (len = 1; len < sizeof(data); len += 7) {
+        elen = base64_encode(data, len, enc, 1);
+        for (split = 0; split <= elen; split++) {
+            base64_decoder_init(&bd);
+            rc = base64_decoder_run(&bd, enc, split, out);
+            TEST_ASSERT_FATAL(rc >= 0);
+            i = rc;
+            rc = base64_decoder_run(&bd, enc + split, elen - split, out + i);
+            TEST_ASSERT_FATAL(rc >= 0);
+            i += rc;
+            TEST_ASSERT(i == len, "len=%d split=%d got %d", len, split, i);
+            TEST_ASSERT(!memcmp(data, out, len), "len=%d split=%d",
+              len, split);
+        }
+    }
+
+    base64_decoder_init(&bd);
+    TEST_ASSERT(base64_decoder_run(&bd, "Zm=v", 4, out) == -1);
+    base64_decoder_init(&bd);
+    TEST_ASSERT(base64_decoder_run(&bd, "Zm9\n", 4, out) == -1);
+}
+
+TEST_SUITE(base64_test_suite)
+{
+    base64_test_roundtrip();
+    base64_test_decode_n();
+    base64_test_nopad();
+    base64_test_stream();
+}
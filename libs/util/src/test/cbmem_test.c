@@ -167,10 +167,115 @@ TEST_CASE(cbmem_test_case_3)
     }
 }
 
+TEST_CASE(cbmem_test_case_rev)
+{
+    struct cbmem_entry_hdr *hdr;
+    struct cbmem_iter iter;
+    uint8_t i;
+    uint8_t val;
+    int rc;
+
+    /* Newest first, across the wrap of the buffer. */
+    i = 64;
+    cbmem_iter_start_rev(&cbmem1, &iter);
+    while (1) {
+        hdr = cbmem_iter_prev(&cbmem1, &iter);
+        if (hdr == NULL) {
+            break;
+        }
+
+        rc = cbmem_read(&cbmem1, hdr, &val, 0, sizeof(val));
+        TEST_ASSERT_FATAL(rc == 1, "Couldn't read 1 byte from cbmem");
+        TEST_ASSERT_FATAL(val == i, "Entry index does not match %d vs %d",
+                val, i);
+        TEST_ASSERT_FATAL(hdr->ceh_len == 1024);
+
+        i--;
+    }
+    TEST_ASSERT_FATAL(i == 1, "Walked back %d elements", 64 - i);
+}
+
+TEST_CASE(cbmem_test_case_last)
+{
+    struct cbmem_entry_hdr *hdr;
+    struct cbmem_iter iter;
+    uint8_t val;
+    int cnt;
+    int rc;
+    int i;
+
+    for (cnt = 0; cnt < 70; cnt += 7) {
+        cbmem_iter_start_last(&cbmem1, &iter, cnt);
+        i = cnt < 63 ? 65 - cnt : 2;
+        while (1) {
+            hdr = cbmem_iter_next(&cbmem1, &iter);
+            if (hdr == NULL) {
+                break;
+            }
+
+            rc = cbmem_read(&cbmem1, hdr, &val, 0, sizeof(val));
+            TEST_ASSERT_FATAL(rc == 1, "Couldn't read 1 byte from cbmem");
+            TEST_ASSERT_FATAL(val == i, "cnt=%d: entry %d vs %d", cnt, val,
+                    i);
+            i++;
+        }
+        TEST_ASSERT_FATAL(i == 65, "cnt=%d: ended at %d", cnt, i);
+    }
+}
+
+TEST_CASE(cbmem_test_case_small)
+{
+    static uint8_t buf[64];
+    struct cbmem_entry_hdr *hdr;
+    struct cbmem_iter iter;
+    struct cbmem cbmem;
+    uint8_t data[10];
+    uint8_t val;
+    int rc;
+    int i;
+
+    cbmem_init(&cbmem, buf, sizeof(buf));
+
+    cbmem_iter_start_rev(&cbmem, &iter);
+    TEST_ASSERT(cbmem_iter_prev(&cbmem, &iter) == NULL);
+    cbmem_iter_start_last(&cbmem, &iter, 3);
+    TEST_ASSERT(cbmem_iter_next(&cbmem, &iter) == NULL);
+
+    /* Entries of varying size, wrapping many times over. */
+    for (i = 0; i < 40; i++) {
+        memset(data, i, sizeof(data));
+        rc = cbmem_append(&cbmem, data, 1 + i % sizeof(data));
+        TEST_ASSERT_FATAL(rc == 0);
+
+        val = i;
+        cbmem_iter_start_rev(&cbmem, &iter);
+        while (1) {
+            hdr = cbmem_iter_prev(&cbmem, &iter);
+            if (hdr == NULL) {
+                break;
+            }
+            TEST_ASSERT_FATAL(hdr->ceh_len == 1 + val % sizeof(data));
+            rc = cbmem_read(&cbmem, hdr, data, 0, 1);
+            TEST_ASSERT_FATAL(rc == 1 && data[0] == val, "%d vs %d",
+                    data[0], val);
+            val--;
+        }
+
+        /* The oldest entry seen walking back is the first walking forward. */
+        cbmem_iter_start(&cbmem, &iter);
+        hdr = cbmem_iter_next(&cbmem, &iter);
+        rc = cbmem_read(&cbmem, hdr, data, 0, 1);
+        TEST_ASSERT_FATAL(rc == 1 && data[0] == (uint8_t)(val + 1));
+    }
+}
+
 TEST_SUITE(cbmem_test_suite)
 {
     setup_cbmem1();
     cbmem_test_case_1();
     cbmem_test_case_2();
     cbmem_test_case_3();
+    cbmem_test_case_rev();
+    cbmem_test_case_last();
+    cbmem_test_case_small();
 }
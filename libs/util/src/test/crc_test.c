@@ -0,0 +1,150 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "testutil/testutil.h"
+#include "util/crc8.h"
+#include "util/crc16.h"
+
+#define CRC_TEST_BUF_SIZE       1024
+#define CRC_TEST_BENCH_ITERS    100
+
+static uint8_t crc_test_buf[CRC_TEST_BUF_SIZE];
+
+static const char crc_test_check[] = "123456789";
+
+/*
+ * Bit-at-a-time references; the table driven versions must match these for
+ * every length and alignment.
+ */
+static uint16_t
+crc16_ref(uint16_t crc, const uint8_t *p, int len)
+{
+    int i;
+
+    while (len--) {
+        crc ^= *p++ << 8;
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t
+crc8_ref(uint8_t crc, const uint8_t *p, int len)
+{
+    int i;
+
+    while (len--) {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static void
+crc_test_fill(void)
+{
+    uint32_t x;
+    int i;
+
+    x = 0x12345678;
+    for (i = 0; i < CRC_TEST_BUF_SIZE; i++) {
+        x = x * 1103515245 + 12345;
+        crc_test_buf[i] = x >> 16;
+    }
+}
+
+TEST_CASE(crc_test_vectors)
+{
+    TEST_ASSERT(crc16_ccitt(0, crc_test_check, 9) == 0x31c3);
+    TEST_ASSERT(crc8_calc(crc8_init(), (void *)crc_test_check, 9) == 0xfb);
+    TEST_ASSERT(crc16_ccitt(0x1234, crc_test_check, 0) == 0x1234);
+    TEST_ASSERT(crc8_calc(0x5a, (void *)crc_test_check, 0) == 0x5a);
+}
+
+TEST_CASE(crc_test_lengths)
+{
+    uint16_t crc16;
+    uint8_t crc8;
+    int off;
+    int len;
+
+    crc_test_fill();
+
+    for (off = 0; off < 4; off++) {
+        for (len = 0; len < 67; len++) {
+            crc16 = crc16_ccitt(0xffff, crc_test_buf + off, len);
+            TEST_ASSERT(crc16 == crc16_ref(0xffff, crc_test_buf + off, len),
+              "crc16 mismatch off=%d len=%d", off, len);
+
+            crc8 = crc8_calc(crc8_init(), crc_test_buf + off, len);
+            TEST_ASSERT(crc8 == crc8_ref(0xff, crc_test_buf + off, len),
+              "crc8 mismatch off=%d len=%d", off, len);
+        }
+    }
+
+    /* Computing in pieces must give the same result as in one go. */
+    crc16 = crc16_ccitt(0, crc_test_buf, 13);
+    crc16 = crc16_ccitt(crc16, crc_test_buf + 13, CRC_TEST_BUF_SIZE - 13);
+    TEST_ASSERT(crc16 == crc16_ccitt(0, crc_test_buf, CRC_TEST_BUF_SIZE));
+
+    crc8 = crc8_calc(crc8_init(), crc_test_buf, 7);
+    crc8 = crc8_calc(crc8, crc_test_buf + 7, CRC_TEST_BUF_SIZE - 7);
+    TEST_ASSERT(crc8 == crc8_calc(crc8_init(), crc_test_buf,
+                                  CRC_TEST_BUF_SIZE));
+}
+
+/*
+ * Not pass/fail; report timing so the byte-wise and UTIL_CRC_FAST builds
+ * can be compared.
+ */
+TEST_BENCH(crc_test_bench16, 15)
+{
+    volatile uint16_t crc16;
+    int i;
+
+    for (i = 0; i < CRC_TEST_BENCH_ITERS; i++) {
+        crc16 = crc16_ccitt(0, crc_test_buf, CRC_TEST_BUF_SIZE);
+    }
+    (void)crc16;
+}
+
+TEST_BENCH(crc_test_bench8, 15)
+{
+    volatile uint8_t crc8;
+    int i;
+
+    for (i = 0; i < CRC_TEST_BENCH_ITERS; i++) {
+        crc8 = crc8_calc(crc8_init(), crc_test_buf, CRC_TEST_BUF_SIZE);
+    }
+    (void)crc8;
+}
+
+TEST_SUITE(crc_test_suite)
+{
+    crc_test_vectors();
+    crc_test_lengths();
+    crc_test_fill();
+    crc_test_bench16();
+    crc_test_bench8();
+}
@@ -0,0 +1,111 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+
+#include "testutil/testutil.h"
+#include "os/os_time.h"
+#include "util/datetime.h"
+
+static const struct {
+    int64_t secs;
+    const char *str;
+} datetime_test_vectors[] = {
+    { 0,            "1970-01-01T00:00:00" },
+    { 68255999,     "1972-02-29T23:59:59" },
+    { 951782400,    "2000-02-29T00:00:00" },
+    { 978307199,    "2000-12-31T23:59:59" },
+    { 1451606400,   "2016-01-01T00:00:00" },
+    { 4107542399LL, "2100-02-28T23:59:59" },
+    { 4107542400LL, "2100-03-01T00:00:00" },
+    { 253402300799LL, "9999-12-31T23:59:59" },
+};
+
+TEST_CASE(datetime_test_vectors_fmt)
+{
+    char buf[DATETIME_BUFSIZE];
+    struct os_timeval tv;
+    struct os_timezone tz;
+    int rc;
+    int i;
+
+    for (i = 0; i < sizeof(datetime_test_vectors) /
+                    sizeof(datetime_test_vectors[0]); i++) {
+        tv.tv_sec = datetime_test_vectors[i].secs;
+        tv.tv_usec = 0;
+        rc = format_datetime(&tv, NULL, buf, sizeof(buf));
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(!strcmp(buf, datetime_test_vectors[i].str), "%s vs %s",
+                    buf, datetime_test_vectors[i].str);
+
+        /* Same day as the previous call. */
+        tv.tv_sec |= 1;
+        rc = format_datetime(&tv, NULL, buf, sizeof(buf));
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(!strncmp(buf, datetime_test_vectors[i].str, 10));
+
+        rc = parse_datetime(datetime_test_vectors[i].str, &tv, &tz);
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(tv.tv_sec == datetime_test_vectors[i].secs);
+    }
+
+    tv.tv_sec = 1451606400 + 3600;
+    tv.tv_usec = 500;
+    tz.tz_minuteswest = -330;
+    tz.tz_dsttime = 0;
+    rc = format_datetime(&tv, &tz, buf, sizeof(buf));
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(!strcmp(buf, "2016-01-01T06:30:00.000500+05:30"));
+
+    /* Doesn't fit. */
+    rc = format_datetime(&tv, &tz, buf, 20);
+    TEST_ASSERT(rc != 0);
+    rc = format_datetime(&tv, &tz, buf, 19);
+    TEST_ASSERT(rc != 0);
+}
+
+TEST_CASE(datetime_test_roundtrip)
+{
+    char buf[DATETIME_BUFSIZE];
+    struct os_timeval tv;
+    struct os_timeval tv2;
+    struct os_timezone tz;
+    int64_t secs;
+    int rc;
+
+    /* Crosses month, year and century boundaries. */
+    for (secs = 0; secs < 13000000000LL; secs += 86400 * 13 + 3607) {
+        tv.tv_sec = secs;
+        tv.tv_usec = secs % 1000000;
+        rc = format_datetime(&tv, NULL, buf, sizeof(buf));
+        TEST_ASSERT_FATAL(rc == 0);
+        rc = parse_datetime(buf, &tv2, &tz);
+        TEST_ASSERT_FATAL(rc == 0, "%s", buf);
+        TEST_ASSERT_FATAL(tv2.tv_sec == tv.tv_sec && tv2.tv_usec == tv.tv_usec,
+                          "%s", buf);
+    }
+
+    TEST_ASSERT(parse_datetime("2100-02-29T00:00:00", &tv, &tz) != 0);
+    TEST_ASSERT(parse_datetime("2000-02-29T00:00:00", &tv, &tz) == 0);
+}
+
+TEST_SUITE(datetime_test_suite)
+{
+    datetime_test_vectors_fmt();
+    datetime_test_roundtrip();
+}
@@ -0,0 +1,122 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "testutil/testutil.h"
+#include "util/lz.h"
+
+static int
+lz_test_roundtrip(const uint8_t *data, int len, int piece)
+{
+    struct lz_state enc;
+    struct lz_state dec;
+    uint8_t cbuf[LZ_COMPRESS_BOUND(64)];
+    uint8_t out[600];
+    int clen_total;
+    int clen;
+    int dlen;
+    int off;
+    int n;
+
+    lz_init(&enc);
+    lz_init(&dec);
+    clen_total = 0;
+    for (off = 0; off < len; off += n) {
+        n = len - off;
+        if (n > piece) {
+            n = piece;
+        }
+        clen = lz_compress(&enc, data + off, n, cbuf, sizeof(cbuf));
+        TEST_ASSERT_FATAL(clen > 0 && clen <= LZ_COMPRESS_BOUND(n));
+        dlen = lz_decompress(&dec, cbuf, clen, out + off, sizeof(out) - off);
+        TEST_ASSERT_FATAL(dlen == n, "off=%d n=%d dlen=%d", off, n, dlen);
+        clen_total += clen;
+    }
+    TEST_ASSERT(!memcmp(data, out, len));
+
+    return clen_total;
+}
+
+TEST_CASE(lz_test_text)
+{
+    char data[600];
+    int clen;
+    int len;
+    int i;
+
+    len = 0;
+    for (i = 0; i < 10; i++) {
+        len += sprintf(data + len, "[ts=%d] conn established, handle=%d\n",
+                       1000 + i * 17, i % 3);
+    }
+
+    /* Repetitive text compresses well, in pieces or in one go. */
+    clen = lz_test_roundtrip((uint8_t *)data, len, 64);
+    TEST_ASSERT(clen < len / 2, "len=%d clen=%d", len, clen);
+    lz_test_roundtrip((uint8_t *)data, len, 7);
+    lz_test_roundtrip((uint8_t *)data, len, 1);
+}
+
+TEST_CASE(lz_test_random)
+{
+    uint8_t data[500];
+    uint32_t x;
+    int i;
+
+    /* Incompressible data stays within the bound. */
+    x = 12345;
+    for (i = 0; i < sizeof(data); i++) {
+        x = x * 1103515245 + 12345;
+        data[i] = x >> 16;
+    }
+    lz_test_roundtrip(data, sizeof(data), 64);
+
+    /* Long runs, with matches overlapping their own output. */
+    memset(data, 'a', sizeof(data));
+    TEST_ASSERT(lz_test_roundtrip(data, sizeof(data), 64) < 40);
+}
+
+TEST_CASE(lz_test_corrupt)
+{
+    struct lz_state lz;
+    uint8_t out[16];
+    uint8_t bad_dist[] = { 0x00, 'a', 0x80, 0x05 };
+    uint8_t short_lit[] = { 0x03, 'a', 'b' };
+    uint8_t ok[] = { 0x00, 'a', 0x82, 0x00 };
+
+    lz_init(&lz);
+    TEST_ASSERT(lz_decompress(&lz, bad_dist, sizeof(bad_dist), out,
+                              sizeof(out)) == -1);
+    lz_init(&lz);
+    TEST_ASSERT(lz_decompress(&lz, short_lit, sizeof(short_lit), out,
+                              sizeof(out)) == -1);
+    lz_init(&lz);
+    TEST_ASSERT(lz_decompress(&lz, ok, sizeof(ok), out, 4) == -1);
+    lz_init(&lz);
+    TEST_ASSERT(lz_decompress(&lz, ok, sizeof(ok), out, sizeof(out)) == 6);
+    TEST_ASSERT(!memcmp(out, "aaaaaa", 6));
+}
+
+TEST_SUITE(lz_test_suite)
+{
+    lz_test_text();
+    lz_test_random();
+    lz_test_corrupt();
+}
@@ -0,0 +1,181 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+
+#include "testutil/testutil.h"
+#include "os/os.h"
+#include "util/tpq.h"
+
+#define TPQ_TEST_NUM_ELEMS  16
+
+struct tpq_test_elem {
+    struct tpq_elem tte_elem;
+    int tte_id;
+};
+
+static struct os_eventq tpq_test_evq;
+static struct tpq_prio tpq_test_tpp;
+static struct tpq_prio_level tpq_test_levels[3];
+static struct tpq_test_elem tpq_test_elems[TPQ_TEST_NUM_ELEMS];
+
+static void
+tpq_test_setup(void)
+{
+    int i;
+
+    os_eventq_init(&tpq_test_evq);
+    tpq_prio_init(&tpq_test_tpp, tpq_test_levels, 3, OS_EVENT_T_PERUSER, NULL);
+    for (i = 0; i < TPQ_TEST_NUM_ELEMS; i++) {
+        tpq_test_elems[i].tte_id = i;
+    }
+}
+
+static int
+tpq_test_get(uint8_t *out_level)
+{
+    struct tpq_elem *elem;
+
+    elem = tpq_prio_get(&tpq_test_tpp, out_level);
+    if (!elem) {
+        return -1;
+    }
+    return ((struct tpq_test_elem *)elem)->tte_id;
+}
+
+TEST_CASE(tpq_test_strict)
+{
+    uint8_t level;
+    int rc;
+
+    tpq_test_setup();
+
+    TEST_ASSERT(tpq_test_get(NULL) == -1);
+
+    /* Bulk first, then control; control is still served first. */
+    rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 2,
+                      &tpq_test_elems[0].tte_elem);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(tpq_test_tpp.tpp_ev.ev_queued);
+    os_eventq_remove(&tpq_test_evq, &tpq_test_tpp.tpp_ev);
+    rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 2,
+                      &tpq_test_elems[1].tte_elem);
+    TEST_ASSERT(rc == 0);
+    rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 1,
+                      &tpq_test_elems[2].tte_elem);
+    TEST_ASSERT(rc == 0);
+    rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 0,
+                      &tpq_test_elems[3].tte_elem);
+    TEST_ASSERT(rc == 0);
+    rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 3,
+                      &tpq_test_elems[4].tte_elem);
+    TEST_ASSERT(rc == OS_EINVAL);
+
+    TEST_ASSERT(tpq_test_get(&level) == 3 && level == 0);
+    TEST_ASSERT(tpq_test_get(&level) == 2 && level == 1);
+    TEST_ASSERT(tpq_test_get(&level) == 0 && level == 2);
+    TEST_ASSERT(tpq_test_get(&level) == 1 && level == 2);
+    TEST_ASSERT(tpq_test_get(NULL) == -1);
+}
+
+TEST_CASE(tpq_test_depth)
+{
+    int rc;
+    int i;
+
+    tpq_test_setup();
+
+    rc = tpq_prio_level_cfg(&tpq_test_tpp, 1, 2, 0);
+    TEST_ASSERT(rc == 0);
+    rc = tpq_prio_level_cfg(&tpq_test_tpp, 3, 2, 0);
+    TEST_ASSERT(rc == OS_EINVAL);
+
+    for (i = 0; i < 3; i++) {
+        rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 1,
+                          &tpq_test_elems[i].tte_elem);
+        TEST_ASSERT(rc == (i < 2 ? 0 : OS_ENOMEM));
+    }
+
+    /* Other levels are not affected. */
+    rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 0,
+                      &tpq_test_elems[3].tte_elem);
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT(tpq_test_get(NULL) == 3);
+    TEST_ASSERT(tpq_test_get(NULL) == 0);
+
+    /* Room again. */
+    rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 1,
+                      &tpq_test_elems[2].tte_elem);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(tpq_test_get(NULL) == 1);
+    TEST_ASSERT(tpq_test_get(NULL) == 2);
+    TEST_ASSERT(tpq_test_get(NULL) == -1);
+}
+
+TEST_CASE(tpq_test_weighted)
+{
+    uint8_t levels[TPQ_TEST_NUM_ELEMS];
+    uint8_t level;
+    int rc;
+    int i;
+
+    tpq_test_setup();
+
+    /* Level 0 gets 3 turns for each turn of level 1. */
+    rc = tpq_prio_level_cfg(&tpq_test_tpp, 0, 0, 3);
+    TEST_ASSERT(rc == 0);
+
+    for (i = 0; i < 8; i++) {
+        rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 0,
+                          &tpq_test_elems[i].tte_elem);
+        TEST_ASSERT(rc == 0);
+    }
+    for (; i < 11; i++) {
+        rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 1,
+                          &tpq_test_elems[i].tte_elem);
+        TEST_ASSERT(rc == 0);
+    }
+
+    for (i = 0; i < 11; i++) {
+        TEST_ASSERT(tpq_test_get(&level) >= 0);
+        levels[i] = level;
+    }
+    TEST_ASSERT(tpq_test_get(NULL) == -1);
+
+    TEST_ASSERT(!memcmp(levels, (uint8_t []){ 0, 0, 0, 1, 0, 0, 0, 1,
+                                              0, 0, 1 }, 11));
+
+    /* With nothing less urgent waiting, a weighted level isn't throttled. */
+    for (i = 0; i < 8; i++) {
+        rc = tpq_prio_put(&tpq_test_evq, &tpq_test_tpp, 0,
+                          &tpq_test_elems[i].tte_elem);
+        TEST_ASSERT(rc == 0);
+    }
+    for (i = 0; i < 8; i++) {
+        TEST_ASSERT(tpq_test_get(NULL) == i);
+    }
+    TEST_ASSERT(tpq_test_get(NULL) == -1);
+}
+
+TEST_SUITE(tpq_test_suite)
+{
+    tpq_test_strict();
+    tpq_test_depth();
+    tpq_test_weighted();
+}
@@ -26,6 +26,11 @@ int
 util_test_all(void)
 {
     cbmem_test_suite();
+    crc_test_suite();
+    base64_test_suite();
+    tpq_test_suite();
+    datetime_test_suite();
+    lz_test_suite();
     return tu_case_failed;
 }
 
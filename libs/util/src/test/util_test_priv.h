@@ -21,5 +21,10 @@
 #define __UTIL_TEST_PRIV_
 
 int cbmem_test_suite(void);
+int crc_test_suite(void);
+int base64_test_suite(void);
+int tpq_test_suite(void);
+int datetime_test_suite(void);
+int lz_test_suite(void);
 
 #endif
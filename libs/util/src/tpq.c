@@ -86,3 +86,176 @@ tpq_init(struct tpq *tpq, uint8_t ev_type, void *ev_arg)
     STAILQ_NEXT(ev, ev_next) = NULL;
 }
 
+/**
+ * Initialize a priority task packet queue.  All levels start out as
+ * unbounded and strict.
+ *
+ * @param tpp           Pointer to priority task packet queue
+ * @param levels        Array of num_levels level structures
+ * @param num_levels    Number of urgency levels
+ * @param ev_type       Type of event
+ * @param ev_arg        Argument of event
+ */
+void
+tpq_prio_init(struct tpq_prio *tpp, struct tpq_prio_level *levels,
+              uint8_t num_levels, uint8_t ev_type, void *ev_arg)
+{
+    struct os_event *ev;
+    int i;
+
+    for (i = 0; i < num_levels; i++) {
+        STAILQ_INIT(&levels[i].tpl_head);
+        levels[i].tpl_cnt = 0;
+        levels[i].tpl_max = 0;
+        levels[i].tpl_weight = 0;
+        levels[i].tpl_credit = 0;
+    }
+    tpp->tpp_levels = levels;
+    tpp->tpp_num_levels = num_levels;
+
+    ev = &tpp->tpp_ev;
+    ev->ev_arg = ev_arg;
+    ev->ev_type = ev_type;
+    ev->ev_queued = 0;
+    STAILQ_NEXT(ev, ev_next) = NULL;
+}
+
+/**
+ * Configure one level of a priority task packet queue.
+ *
+ * @param tpp           Pointer to priority task packet queue
+ * @param level         Level to configure
+ * @param max_depth     Max number of elements queued at this level;
+ *                      0 for no limit
+ * @param weight        0 for strict priority, otherwise number of elements
+ *                      served from this level in a row before yielding to
+ *                      a less urgent one
+ *
+ * @return 0 on success, OS_EINVAL on bad level.
+ */
+int
+tpq_prio_level_cfg(struct tpq_prio *tpp, uint8_t level, uint16_t max_depth,
+                   uint8_t weight)
+{
+    struct tpq_prio_level *tpl;
+    os_sr_t sr;
+
+    if (level >= tpp->tpp_num_levels) {
+        return OS_EINVAL;
+    }
+    tpl = &tpp->tpp_levels[level];
+
+    OS_ENTER_CRITICAL(sr);
+    tpl->tpl_max = max_depth;
+    tpl->tpl_weight = weight;
+    tpl->tpl_credit = weight;
+    OS_EXIT_CRITICAL(sr);
+
+    return 0;
+}
+
+/**
+ * Put an element on a given level of a priority task packet queue and post
+ * an event to an event queue.
+ *
+ * @param evq   Pointer to event queue
+ * @param tpp   Pointer to priority task packet queue
+ * @param level Urgency level; 0 is the most urgent
+ * @param elem  Pointer to element to enqueue
+ *
+ * @return 0 on success, OS_ENOMEM if the level is full, OS_EINVAL on bad
+ * level.
+ */
+int
+tpq_prio_put(struct os_eventq *evq, struct tpq_prio *tpp, uint8_t level,
+             struct tpq_elem *elem)
+{
+    struct tpq_prio_level *tpl;
+    os_sr_t sr;
+
+    if (level >= tpp->tpp_num_levels) {
+        return OS_EINVAL;
+    }
+    tpl = &tpp->tpp_levels[level];
+
+    OS_ENTER_CRITICAL(sr);
+    if (tpl->tpl_max && tpl->tpl_cnt >= tpl->tpl_max) {
+        OS_EXIT_CRITICAL(sr);
+        return OS_ENOMEM;
+    }
+    STAILQ_INSERT_TAIL(&tpl->tpl_head, elem, tpq_next);
+    tpl->tpl_cnt++;
+    OS_EXIT_CRITICAL(sr);
+    os_eventq_put(evq, &tpp->tpp_ev);
+
+    return 0;
+}
+
+/**
+ * Retrieve the next element to process from a priority task packet queue.
+ *
+ * The most urgent non-empty level is served, unless it is weighted and has
+ * used up its run of elements while a less urgent level is waiting.  Serving
+ * a level gives back full runs to all the more urgent levels.
+ *
+ * @param tpp       Pointer to priority task packet queue
+ * @param out_level If not NULL, level of the element is returned here
+ *
+ * @return struct tpq_elem*, NULL if all levels are empty
+ */
+struct tpq_elem *
+tpq_prio_get(struct tpq_prio *tpp, uint8_t *out_level)
+{
+    struct tpq_prio_level *tpl;
+    struct tpq_elem *elem;
+    os_sr_t sr;
+    int skipped;
+    int i;
+    int j;
+
+    elem = NULL;
+    skipped = -1;
+
+    OS_ENTER_CRITICAL(sr);
+    for (i = 0; i < tpp->tpp_num_levels; i++) {
+        tpl = &tpp->tpp_levels[i];
+        if (!tpl->tpl_cnt) {
+            continue;
+        }
+        if (tpl->tpl_weight && !tpl->tpl_credit) {
+            /*
+             * Out of credit; yield to a less urgent level if there is one.
+             */
+            if (skipped < 0) {
+                skipped = i;
+            }
+            continue;
+        }
+        break;
+    }
+    if (i == tpp->tpp_num_levels && skipped >= 0) {
+        /*
+         * Nothing less urgent is waiting after all.
+         */
+        i = skipped;
+    }
+    if (i < tpp->tpp_num_levels) {
+        tpl = &tpp->tpp_levels[i];
+        elem = STAILQ_FIRST(&tpl->tpl_head);
+        STAILQ_REMOVE_HEAD(&tpl->tpl_head, tpq_next);
+        tpl->tpl_cnt--;
+        if (tpl->tpl_credit) {
+            tpl->tpl_credit--;
+        }
+        for (j = 0; j < i; j++) {
+            tpp->tpp_levels[j].tpl_credit = tpp->tpp_levels[j].tpl_weight;
+        }
+        if (out_level) {
+            *out_level = i;
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return elem;
+}
+
@@ -59,7 +59,11 @@ struct wifi_if {
     const struct wifi_if_ops *wi_ops;
 
     uint8_t wi_scan_cnt;
+    uint8_t wi_scan_chan;               /* channel to scan, 0 for all */
+    uint8_t wi_reconn;                  /* next step in finding the AP */
     struct wifi_ap wi_scan[WIFI_SCAN_CNT_MAX];
+    struct wifi_ap wi_conn_ap;          /* AP being connected to */
+    struct wifi_ap wi_last_ap;          /* last AP connected to */
     char wi_ssid[WIFI_SSID_MAX + 1];
     char wi_key[WIFI_KEY_MAX + 1];
     uint8_t wi_myip[4];
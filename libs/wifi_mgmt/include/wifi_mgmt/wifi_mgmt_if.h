@@ -21,6 +21,8 @@
 
 /*
  * Interface between Wi-fi management and the driver.
+ * wio_scan_start() should only scan channel wi_scan_chan, if it is
+ * non-zero.
  */
 struct wifi_if_ops {
     int (*wio_init)(struct wifi_if *);
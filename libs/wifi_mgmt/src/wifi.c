@@ -32,6 +32,15 @@
 
 #define WIFI_EV_STATE           OS_EVENT_T_PERUSER
 
+/*
+ * How to find the AP when connecting. First try the cached parameters of
+ * the AP we were last connected to, then scan its channel, and finally do
+ * a scan of all channels.
+ */
+#define WIFI_RECONN_CACHED      0
+#define WIFI_RECONN_CHAN        1
+#define WIFI_RECONN_FULL        2
+
 static struct os_task wifi_os_task;
 struct os_eventq wifi_evq;
 
@@ -116,6 +125,11 @@ wifi_scan_done(struct wifi_if *wi, int status)
     }
     if (ap) {
         wifi_tgt_state(wi, CONNECTING);
+    } else if (wi->wi_scan_chan) {
+        /*
+         * AP was not on its old channel; scan all of them.
+         */
+        wifi_tgt_state(wi, CONNECTING);
     } else {
         wifi_tgt_state(wi, INIT);
     }
@@ -133,6 +147,7 @@ wifi_connect_done(struct wifi_if *wi, int status)
         wifi_tgt_state(wi, INIT);
         return;
     }
+    wi->wi_last_ap = wi->wi_conn_ap;
     wifi_tgt_state(wi, DHCP_WAIT);
 }
 
@@ -157,16 +172,57 @@ wifi_disconnected(struct wifi_if *wi, int status)
     wifi_tgt_state(wi, INIT);
 }
 
+/*
+ * Returns the AP with strongest signal from scan results.
+ */
 static struct wifi_ap *
 wifi_find_ap(struct wifi_if *wi, char *ssid)
 {
+    struct wifi_ap *best = NULL;
     int i;
 
     for (i = 0; i < wi->wi_scan_cnt; i++) {
-        if (!strcmp(wi->wi_scan[i].wa_ssid, ssid)) {
-            return &wi->wi_scan[i];
+        if (!strcmp(wi->wi_scan[i].wa_ssid, ssid) &&
+          (!best || wi->wi_scan[i].wa_rssi > best->wa_rssi)) {
+            best = &wi->wi_scan[i];
         }
     }
+    return best;
+}
+
+static int
+wifi_last_ap_valid(struct wifi_if *wi)
+{
+    return !WIFI_SSID_EMPTY(wi->wi_last_ap.wa_ssid) &&
+      !strcmp(wi->wi_last_ap.wa_ssid, wi->wi_ssid);
+}
+
+/*
+ * Pick the AP to connect to. Returns NULL if a scan is needed;
+ * wi_scan_chan is then set to the channel to scan.
+ */
+static struct wifi_ap *
+wifi_select_ap(struct wifi_if *wi)
+{
+    struct wifi_ap *ap;
+
+    if (wi->wi_reconn == WIFI_RECONN_CACHED) {
+        if (wifi_last_ap_valid(wi)) {
+            wi->wi_reconn = WIFI_RECONN_CHAN;
+            return &wi->wi_last_ap;
+        }
+        wi->wi_reconn = WIFI_RECONN_FULL;
+    }
+    ap = wifi_find_ap(wi, wi->wi_ssid);
+    if (ap) {
+        return ap;
+    }
+    if (wi->wi_reconn == WIFI_RECONN_CHAN && wi->wi_last_ap.wa_channel) {
+        wi->wi_scan_chan = wi->wi_last_ap.wa_channel;
+    } else {
+        wi->wi_scan_chan = 0;
+    }
+    wi->wi_reconn = WIFI_RECONN_FULL;
     return NULL;
 }
 
@@ -215,6 +271,7 @@ wifi_connect(struct wifi_if *wi)
         if (WIFI_SSID_EMPTY(wi->wi_ssid)) {
             return -1;
         }
+        wi->wi_reconn = WIFI_RECONN_CACHED;
         wifi_tgt_state(wi, CONNECTING);
         return 0;
     default:
@@ -230,6 +287,8 @@ int
 wifi_scan_start(struct wifi_if *wi)
 {
     if (wi->wi_state == INIT) {
+        wi->wi_scan_chan = 0;
+        wi->wi_reconn = WIFI_RECONN_FULL;
         wifi_tgt_state(wi, SCANNING);
         return 0;
     }
@@ -266,11 +325,22 @@ wifi_step(struct wifi_if *wi)
             wi->wi_state = wi->wi_tgt;
         } else if (wi->wi_state == CONNECTING) {
             wi->wi_state = wi->wi_tgt;
+            if (wi->wi_reconn == WIFI_RECONN_CHAN) {
+                /*
+                 * Cached AP info was stale, and so are likely the scan
+                 * results. Look for the AP again.
+                 */
+                wi->wi_scan_cnt = 0;
+                wi->wi_tgt = CONNECTING;
+            }
+        } else {
+            wi->wi_state = wi->wi_tgt;
         }
         break;
     case SCANNING:
         if (wi->wi_state == INIT) {
             memset(wi->wi_scan, 0, sizeof(wi->wi_scan));
+            wi->wi_scan_cnt = 0;
             rc = wi->wi_ops->wio_scan_start(wi);
             console_printf("wifi_request_scan : %d\n", rc);
             if (rc != 0) {
@@ -283,12 +353,14 @@ wifi_step(struct wifi_if *wi)
         break;
     case CONNECTING:
         if (wi->wi_state == INIT || wi->wi_state == SCANNING) {
-            ap = wifi_find_ap(wi, wi->wi_ssid);
+            ap = wifi_select_ap(wi);
             if (!ap) {
+                wi->wi_state = INIT;
                 wifi_tgt_state(wi, SCANNING);
                 break;
             }
-            rc = wi->wi_ops->wio_connect(wi, ap);
+            wi->wi_conn_ap = *ap;
+            rc = wi->wi_ops->wio_connect(wi, &wi->wi_conn_ap);
             console_printf("wifi_connect : %d\n", rc);
             if (rc == 0) {
                 wi->wi_state = CONNECTING;
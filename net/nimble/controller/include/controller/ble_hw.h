@@ -94,7 +94,15 @@ void ble_hw_resolv_list_enable(void);
 /* Disables resolving list devices */
 void ble_hw_resolv_list_disable(void);
 
-/* Returns index of resolved address; -1 if not resolved */
+/*
+ * Return codes from ble_hw_resolv_list_match() when the address was not
+ * resolved. NOT_DONE means the hardware has no verdict (no resolver, or it
+ * did not finish) and the address must be resolved in software.
+ */
+#define BLE_HW_RESOLV_NO_MATCH      (-1)
+#define BLE_HW_RESOLV_NOT_DONE      (-2)
+
+/* Returns index of resolved address; negative if not resolved */
 int ble_hw_resolv_list_match(void);
 
 #endif /* H_BLE_HW_ */
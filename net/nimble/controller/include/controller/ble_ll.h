@@ -28,6 +28,13 @@
 /* Controller revision. */
 #define BLE_LL_SUB_VERS_NR      (0x0000)
 
+/*
+ * Number of shared cputime timers the controller may have running at once:
+ * a supervision timer per connection and the scan timer, plus the wait for
+ * response and scheduler timers if no output compare is free for them.
+ */
+#define BLE_LL_CPUTIME_TIMERS   (NIMBLE_OPT_MAX_CONNECTIONS + 3)
+
 /*
  * The amount of time that we will wait to hear the start of a receive
  * packet after we have transmitted a packet. This time is at least
@@ -73,8 +80,11 @@ struct ble_ll_obj
     struct os_event ll_rx_pkt_ev;
     struct ble_ll_pkt_q ll_rx_pkt_q;
 
-    /* Packet transmit queue */
-    struct os_event ll_tx_pkt_ev;
+    /*
+     * Packet transmit queue.  The event counts the packets queued since the
+     * LL task last drained the queue.
+     */
+    struct os_cevent ll_tx_pkt_ev;
     struct ble_ll_pkt_q ll_tx_pkt_q;
 };
 extern struct ble_ll_obj g_ble_ll_data;
@@ -130,6 +140,7 @@ extern STATS_SECT_DECL(ble_ll_stats) ble_ll_stats;
 #define BLE_LL_EVENT_CONN_SPVN_TMO  (OS_EVENT_T_PERUSER + 4)
 #define BLE_LL_EVENT_CONN_EV_END    (OS_EVENT_T_PERUSER + 5)
 #define BLE_LL_EVENT_TX_PKT_IN      (OS_EVENT_T_PERUSER + 6)
+#define BLE_LL_EVENT_RPA_POOL       (OS_EVENT_T_PERUSER + 7)
 
 /* LL Features */
 #define BLE_LL_FEAT_LE_ENCRYPTION   (0x01)
@@ -323,6 +334,9 @@ void ble_ll_acl_data_in(struct os_mbuf *txpkt);
  */
 struct os_mbuf *ble_ll_rxpdu_alloc(uint16_t len);
 
+/* Get a single mbuf from the link layer receive PDU pool (if any) */
+struct os_mbuf *ble_ll_rxpdu_pool_get(void);
+
 /*--- PHY interfaces ---*/
 struct ble_mbuf_hdr;
 
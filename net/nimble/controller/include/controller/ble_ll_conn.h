@@ -25,6 +25,8 @@
 #include "nimble/hci_common.h"
 #include "controller/ble_ll_sched.h"
 #include "controller/ble_ll_ctrl.h"
+#include "controller/ble_ll_prof.h"
+#include "controller/ble_phy.h"
 #include "hal/hal_cputime.h"
 
 /* Roles */
@@ -89,6 +91,39 @@ struct ble_ll_conn_enc_data
 };
 #endif
 
+#if (NIMBLE_OPT_LL_CONN_ADAPT_CHMAP == 1)
+/*
+ * Per data channel receive quality of a connection. The counters are
+ * incremented in interrupt context and evaluated (and cleared) at the end of
+ * a connection event once enough samples have been collected for the channel.
+ */
+struct ble_ll_conn_chq
+{
+    uint8_t rx_ok[BLE_PHY_NUM_DATA_CHANS];
+    uint8_t rx_bad[BLE_PHY_NUM_DATA_CHANS];
+    uint8_t blocked[BLE_LL_CONN_CHMAP_LEN];
+    uint8_t upd_pending;
+    uint16_t retry_cntr;
+};
+#endif
+
+#if (NIMBLE_OPT_LL_CONN_ADAPT_WW == 1)
+/*
+ * Master clock drift tracking for a slave connection. Drift and deviation
+ * are in 1/256 ppm. Anchor point errors are accumulated (in interrupt
+ * context) over a measurement window before the estimate is updated.
+ */
+struct ble_ll_conn_ww
+{
+    int32_t drift;
+    uint32_t dev;
+    int32_t meas_err;
+    uint32_t meas_ticks;
+    int32_t comp_frac;
+    uint8_t windows;
+};
+#endif
+
 /* Connection state machine flags. */
 union ble_ll_conn_sm_flags {
     struct {
@@ -232,6 +267,18 @@ struct ble_ll_conn_sm
     /* For scheduling connections */
     struct ble_ll_sched_item conn_sch;
 
+#if (NIMBLE_OPT_LL_PROF == 1)
+    struct ble_ll_conn_prof prof;
+#endif
+
+#if (NIMBLE_OPT_LL_CONN_ADAPT_CHMAP == 1)
+    struct ble_ll_conn_chq chq;
+#endif
+
+#if (NIMBLE_OPT_LL_CONN_ADAPT_WW == 1)
+    struct ble_ll_conn_ww ww;
+#endif
+
 #if (BLE_LL_CFG_FEAT_LE_PING == 1)
     struct os_callout_func auth_pyld_timer;
 #endif
@@ -0,0 +1,80 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_LL_PROF_
+#define H_BLE_LL_PROF_
+
+#include <inttypes.h>
+#include "nimble/nimble_opt.h"
+
+struct ble_ll_sched_item;
+struct ble_ll_conn_sm;
+
+/* Scheduling and air time counters kept for each connection */
+struct ble_ll_conn_prof
+{
+    uint32_t events;        /* Connection events executed */
+    uint32_t skipped;       /* Events skipped due to scheduling conflicts */
+    uint32_t aborted;       /* Events that ended as soon as they started */
+    uint32_t overruns;      /* Events that ran past their scheduled end */
+    uint32_t radio_usecs;   /* Time spent in connection state */
+    uint32_t rx_crc_errs;   /* Received PDUs with bad CRC */
+};
+
+#if (NIMBLE_OPT_LL_PROF == 1)
+/* Initialize the profiler */
+int ble_ll_prof_init(void);
+
+/* A schedule item has been put on the scheduler queue */
+void ble_ll_prof_sched(struct ble_ll_sched_item *sch);
+
+/* A schedule item is about to execute, and has executed */
+void ble_ll_prof_exec_start(struct ble_ll_sched_item *sch);
+void ble_ll_prof_exec_end(struct ble_ll_sched_item *sch, int rc);
+
+/* The link layer state is changing */
+void ble_ll_prof_state_chg(uint8_t old_state, uint8_t new_state);
+
+/* A connection event was skipped as it could not be scheduled */
+void ble_ll_prof_conn_skip(struct ble_ll_conn_sm *connsm);
+
+/* A PDU was received with a bad CRC */
+void ble_ll_prof_crc_err(uint8_t chan);
+void ble_ll_prof_conn_crc_err(struct ble_ll_conn_sm *connsm);
+
+/* Clear all profiler counters */
+void ble_ll_prof_reset(void);
+
+/* Vendor specific HCI commands reading the profiler counters */
+int ble_ll_prof_hci_rd_ll(uint8_t *rspbuf, uint8_t *rsplen);
+int ble_ll_prof_hci_rd_conn(uint8_t *cmdbuf, uint8_t *rspbuf,
+                            uint8_t *rsplen);
+int ble_ll_prof_hci_rd_chan_crc_errs(uint8_t *cmdbuf, uint8_t *rspbuf,
+                                     uint8_t *rsplen);
+#else
+#define ble_ll_prof_sched(sch)
+#define ble_ll_prof_exec_start(sch)
+#define ble_ll_prof_exec_end(sch, rc)
+#define ble_ll_prof_state_chg(old_state, new_state)
+#define ble_ll_prof_conn_skip(connsm)
+#define ble_ll_prof_crc_err(chan)
+#define ble_ll_prof_conn_crc_err(connsm)
+#endif
+
+#endif /* H_BLE_LL_PROF_ */
@@ -20,21 +20,29 @@
 #ifndef H_BLE_LL_RESOLV_
 #define H_BLE_LL_RESOLV_
 
+#include "nimble/nimble_opt.h"
+
 /*
  * An entry in the resolving list.
  *      The identity address is stored in little endian format.
  *      The local rpa is stored in little endian format.
  *      The IRKs are stored in big endian format.
+ *      The precomputed RPAs are stored in little endian format.
  */
 struct ble_ll_resolv_entry
 {
     uint8_t rl_addr_type;
     uint8_t rl_local_rpa_set;
-    uint16_t rl_reserved;
+    uint8_t rl_next_rpa_set;
+    uint8_t rl_peer_rpa_cnt;
     uint8_t rl_local_irk[16];
     uint8_t rl_peer_irk[16];
     uint8_t rl_identity_addr[BLE_DEV_ADDR_LEN];
     uint8_t rl_local_rpa[BLE_DEV_ADDR_LEN];
+#if (NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE > 0)
+    uint8_t rl_next_local_rpa[BLE_DEV_ADDR_LEN];
+    uint8_t rl_peer_rpas[NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE][BLE_DEV_ADDR_LEN];
+#endif
 };
 
 extern struct ble_ll_resolv_entry g_ble_ll_resolv_list[];
@@ -87,6 +95,12 @@ uint32_t ble_ll_resolv_get_rpa_tmo(void);
 /* Resolve a resolvable private address */
 int ble_ll_resolv_rpa(uint8_t *rpa, uint8_t *irk);
 
+/* Find the resolving list index of a received peer RPA (-1 if none) */
+int ble_ll_resolv_peer_rpa_index(uint8_t *rpa);
+
+/* Refill the precomputed RPA pools. Called from the LL task. */
+void ble_ll_resolv_rpa_pool_fill(void);
+
 /* Initialize resolv*/
 void ble_ll_resolv_init(void);
 
@@ -100,6 +100,12 @@ int ble_phy_rx(void);
 /* Copies the received PHY buffer into the allocated pdu */
 void ble_phy_rxpdu_copy(uint8_t *dptr, struct os_mbuf *rxpdu);
 
+/*
+ * Returns the mbuf the current pdu was received into, if the PHY receives
+ * directly into mbufs; NULL otherwise.
+ */
+struct os_mbuf *ble_phy_rxpdu_take(uint16_t len);
+
 /* Get an RSSI reading */
 int ble_phy_rssi_get(void);
 
@@ -36,9 +36,14 @@
 #include "controller/ble_ll_hci.h"
 #include "controller/ble_ll_whitelist.h"
 #include "controller/ble_ll_resolv.h"
+#include "controller/ble_ll_prof.h"
 #include "ble_ll_conn_priv.h"
 #include "hal/hal_cputime.h"
 
+#if (HAL_CPUTIME_MAX_TIMERS < BLE_LL_CPUTIME_TIMERS)
+#error "HAL_CPUTIME_MAX_TIMERS is too small for NIMBLE_OPT_MAX_CONNECTIONS"
+#endif
+
 /* XXX:
  *
  * 1) use the sanity task!
@@ -187,6 +192,23 @@ os_stack_t g_ble_ll_stack[BLE_LL_STACK_SIZE];
 struct os_mempool g_ble_ll_hci_ev_pool;
 static void *ble_ll_hci_os_event_buf;
 
+#if (NIMBLE_OPT_LL_NUM_RX_PDU_BUFS > 0)
+/*
+ * Dedicated pool of receive PDUs. Each mbuf holds a maximum length data PDU
+ * (header, payload and MIC) plus the four bytes prepended to received PDUs
+ * so no PDU ever needs an mbuf chain.
+ */
+#define BLE_LL_RX_PDU_BUF_SIZE      \
+    OS_ALIGN(4 + BLE_LL_PDU_HDR_LEN + NIMBLE_OPT_LL_SUPP_MAX_RX_BYTES + \
+             BLE_LL_DATA_MIC_LEN, 4)
+#define BLE_LL_RX_PDU_BLOCK_SIZE    \
+    (BLE_LL_RX_PDU_BUF_SIZE + BLE_MBUF_MEMBLOCK_OVERHEAD)
+
+static struct os_mempool g_ble_ll_rx_pdu_mempool;
+static struct os_mbuf_pool g_ble_ll_rx_pdu_mbuf_pool;
+static void *ble_ll_rx_pdu_buf;
+#endif
+
 /* XXX: temporary logging until we transition to real logging */
 #ifdef BLE_LL_LOG
 struct ble_ll_log
@@ -270,6 +292,24 @@ ble_ll_count_rx_adv_pdus(uint8_t pdu_type)
  *
  * @return struct os_mbuf*
  */
+/**
+ * Get a receive PDU from the link layer receive PDU pool. The mbuf is a
+ * single packet header mbuf with room for a maximum size data PDU.
+ *
+ * @return struct os_mbuf* The mbuf; NULL if the pool is empty or there is
+ *         no receive PDU pool.
+ */
+struct os_mbuf *
+ble_ll_rxpdu_pool_get(void)
+{
+#if (NIMBLE_OPT_LL_NUM_RX_PDU_BUFS > 0)
+    return os_mbuf_get_pkthdr(&g_ble_ll_rx_pdu_mbuf_pool,
+                              sizeof(struct ble_mbuf_hdr));
+#else
+    return NULL;
+#endif
+}
+
 struct os_mbuf *
 ble_ll_rxpdu_alloc(uint16_t len)
 {
@@ -279,6 +319,22 @@ ble_ll_rxpdu_alloc(uint16_t len)
     struct os_mbuf *p;
     struct os_mbuf_pkthdr *pkthdr;
 
+    /* Use the mbuf the phy received into if there is one */
+    p = ble_phy_rxpdu_take(len);
+    if (p) {
+        return p;
+    }
+
+    /* Use the receive PDU pool if the PDU fits (it should) */
+    if (len <= BLE_LL_PDU_HDR_LEN + NIMBLE_OPT_LL_SUPP_MAX_RX_BYTES) {
+        p = ble_ll_rxpdu_pool_get();
+        if (p) {
+            OS_MBUF_PKTHDR(p)->omp_len = len;
+            p->om_data += 4;
+            return p;
+        }
+    }
+
     p = os_msys_get_pkthdr(len, sizeof(struct ble_mbuf_hdr));
     if (!p) {
         goto rxpdu_alloc_exit;
@@ -527,7 +583,10 @@ ble_ll_wfr_timer_exp(void *arg)
 void
 ble_ll_wfr_enable(uint32_t cputime)
 {
-    cputime_timer_start(&g_ble_ll_data.ll_wfr_timer, cputime);
+    int rc;
+
+    rc = cputime_timer_start(&g_ble_ll_data.ll_wfr_timer, cputime);
+    assert(rc == 0);
 }
 
 /**
@@ -610,6 +669,7 @@ ble_ll_count_rx_stats(struct ble_mbuf_hdr *hdr, uint16_t len, uint8_t pdu_type)
             ble_ll_count_rx_adv_pdus(pdu_type);
         }
     } else {
+        ble_ll_prof_crc_err(chan);
         if (chan < BLE_PHY_NUM_DATA_CHANS) {
             STATS_INC(ble_ll_stats, rx_data_pdu_crc_err);
             STATS_INCN(ble_ll_stats, rx_data_bytes_crc_err, len);
@@ -712,7 +772,7 @@ ble_ll_acl_data_in(struct os_mbuf *txpkt)
     OS_ENTER_CRITICAL(sr);
     STAILQ_INSERT_TAIL(&g_ble_ll_data.ll_tx_pkt_q, pkthdr, omp_next);
     OS_EXIT_CRITICAL(sr);
-    os_eventq_put(&g_ble_ll_data.ll_evq, &g_ble_ll_data.ll_tx_pkt_ev);
+    os_cevent_put(&g_ble_ll_data.ll_evq, &g_ble_ll_data.ll_tx_pkt_ev, 0);
 }
 
 /**
@@ -949,6 +1009,7 @@ ble_ll_task(void *arg)
             ble_ll_rx_pkt_in();
             break;
         case BLE_LL_EVENT_TX_PKT_IN:
+            os_cevent_take(&g_ble_ll_data.ll_tx_pkt_ev, NULL);
             ble_ll_tx_pkt_in();
             break;
         case BLE_LL_EVENT_CONN_SPVN_TMO:
@@ -957,6 +1018,11 @@ ble_ll_task(void *arg)
         case BLE_LL_EVENT_CONN_EV_END:
             ble_ll_conn_event_end(ev->ev_arg);
             break;
+#if (BLE_LL_CFG_FEAT_LL_PRIVACY == 1)
+        case BLE_LL_EVENT_RPA_POOL:
+            ble_ll_resolv_rpa_pool_fill();
+            break;
+#endif
         default:
             assert(0);
             break;
@@ -976,6 +1042,7 @@ ble_ll_task(void *arg)
 void
 ble_ll_state_set(uint8_t ll_state)
 {
+    ble_ll_prof_state_chg(g_ble_ll_data.ll_state, ll_state);
     g_ble_ll_data.ll_state = ll_state;
 }
 
@@ -1174,11 +1241,14 @@ ble_ll_init(uint8_t ll_task_prio, uint8_t num_acl_pkts, uint16_t acl_pkt_size)
 
     /* Initialize transmit (from host) and receive packet (from phy) event */
     lldata->ll_rx_pkt_ev.ev_type = BLE_LL_EVENT_RX_PKT_IN;
-    lldata->ll_tx_pkt_ev.ev_type = BLE_LL_EVENT_TX_PKT_IN;
+    os_cevent_init(&lldata->ll_tx_pkt_ev, BLE_LL_EVENT_TX_PKT_IN, NULL);
 
-    /* Initialize wait for response timer */
-    cputime_timer_init(&g_ble_ll_data.ll_wfr_timer, ble_ll_wfr_timer_exp,
-                       NULL);
+    /*
+     * Initialize wait for response timer. Give it its own compare channel
+     * where the hardware has one so it is never queued behind other timers.
+     */
+    cputime_timer_init_dedicated(&g_ble_ll_data.ll_wfr_timer,
+                                 ble_ll_wfr_timer_exp, NULL);
 
     ble_ll_hci_os_event_buf = malloc(
         OS_MEMPOOL_BYTES(16, sizeof (struct os_event)));
@@ -1190,6 +1260,26 @@ ble_ll_init(uint8_t ll_task_prio, uint8_t num_acl_pkts, uint16_t acl_pkt_size)
                          "g_ble_ll_hci_ev_pool");
     assert(rc == 0);
 
+#if (NIMBLE_OPT_LL_NUM_RX_PDU_BUFS > 0)
+    ble_ll_rx_pdu_buf = malloc(
+        OS_MEMPOOL_BYTES(NIMBLE_OPT_LL_NUM_RX_PDU_BUFS,
+                         BLE_LL_RX_PDU_BLOCK_SIZE));
+    assert(ble_ll_rx_pdu_buf != NULL);
+
+    /* Create the receive PDU pool */
+    rc = os_mempool_init(&g_ble_ll_rx_pdu_mempool,
+                         NIMBLE_OPT_LL_NUM_RX_PDU_BUFS,
+                         BLE_LL_RX_PDU_BLOCK_SIZE, ble_ll_rx_pdu_buf,
+                         "ble_ll_rx_pdu_pool");
+    assert(rc == 0);
+
+    rc = os_mbuf_pool_init(&g_ble_ll_rx_pdu_mbuf_pool,
+                           &g_ble_ll_rx_pdu_mempool,
+                           BLE_LL_RX_PDU_BLOCK_SIZE,
+                           NIMBLE_OPT_LL_NUM_RX_PDU_BUFS);
+    assert(rc == 0);
+#endif
+
     /* Initialize LL HCI */
     ble_ll_hci_init();
 
@@ -1244,6 +1334,12 @@ ble_ll_init(uint8_t ll_task_prio, uint8_t num_acl_pkts, uint16_t acl_pkt_size)
                             STATS_NAME_INIT_PARMS(ble_ll_stats),
                             "ble_ll");
 
+#if (NIMBLE_OPT_LL_PROF == 1)
+    if (rc == 0) {
+        rc = ble_ll_prof_init();
+    }
+#endif
+
     ble_hci_trans_cfg_ll(ble_ll_hci_cmd_rx, NULL,
                                     ble_ll_hci_acl_rx, NULL);
     return rc;
@@ -958,7 +958,7 @@ ble_ll_adv_rx_req(uint8_t pdu_type, struct os_mbuf *rxpdu)
 
 #if (BLE_LL_CFG_FEAT_LL_PRIVACY == 1)
     if (ble_ll_is_rpa(peer, txadd) && ble_ll_resolv_enabled()) {
-        advsm->adv_rpa_index = ble_hw_resolv_list_match();
+        advsm->adv_rpa_index = ble_ll_resolv_peer_rpa_index(peer);
         if (advsm->adv_rpa_index >= 0) {
             ble_hdr->rxinfo.flags |= BLE_MBUF_HDR_F_RESOLVED;
             if (chk_wl) {
@@ -371,11 +371,132 @@ ble_ll_conn_sm_get(void)
     return connsm;
 }
 
+#if (NIMBLE_OPT_LL_CONN_ADAPT_WW == 1)
+/* Minimum time over which anchor point errors are measured (usecs) */
+#define BLE_LL_CONN_WW_MEAS_USECS       (1000000)
+
+/* Number of measurement windows needed before adaptive widening is used */
+#define BLE_LL_CONN_WW_MIN_WINDOWS      (2)
+
+/* Drift/deviation units (1/256 ppm) per tick of offset per tick elapsed */
+#define BLE_LL_CONN_WW_UNITS            (256 * 1000000LL)
+
+/**
+ * Accumulates the error between the expected and the actual anchor point.
+ * Called when the first packet of a connection event is received as slave.
+ * Events with a transmit window are skipped since the master is free to
+ * transmit anywhere in the window.
+ *
+ * Context: Interrupt
+ *
+ * @param connsm
+ * @param rxtime Start time of the received packet (cputime)
+ */
+static void
+ble_ll_conn_ww_meas(struct ble_ll_conn_sm *connsm, uint32_t rxtime)
+{
+    int32_t elapsed;
+
+    if (connsm->slave_cur_tx_win_usecs) {
+        return;
+    }
+
+    elapsed = (int32_t)(connsm->anchor_point - connsm->last_anchor_point);
+    if (elapsed <= 0) {
+        return;
+    }
+
+    connsm->ww.meas_err += (int32_t)(rxtime - connsm->anchor_point);
+    connsm->ww.meas_ticks += elapsed;
+}
+
+/**
+ * Updates the drift estimate once a measurement window is complete.
+ *
+ * Context: Link Layer task
+ *
+ * @param connsm
+ */
+static void
+ble_ll_conn_ww_event_end(struct ble_ll_conn_sm *connsm)
+{
+    int32_t res;
+    uint32_t abs_res;
+    uint32_t max_drift;
+    struct ble_ll_conn_ww *ww;
+
+    ww = &connsm->ww;
+    if (ww->meas_ticks < cputime_usecs_to_ticks(BLE_LL_CONN_WW_MEAS_USECS)) {
+        return;
+    }
+
+    /* Residual drift not yet compensated for */
+    res = (int32_t)(((int64_t)ww->meas_err * BLE_LL_CONN_WW_UNITS) /
+                    ww->meas_ticks);
+    ww->meas_err = 0;
+    ww->meas_ticks = 0;
+
+    /* Anything beyond the worst-case is bogus; start over */
+    abs_res = (res < 0) ? -res : res;
+    max_drift = (g_ble_sca_ppm_tbl[connsm->master_sca] +
+                 NIMBLE_OPT_LL_OUR_SCA) * 256;
+    if (abs_res > max_drift) {
+        ww->drift = 0;
+        ww->dev = 0;
+        ww->windows = 0;
+        return;
+    }
+
+    ww->drift += res;
+    if (ww->windows == 0) {
+        /* First window measures the drift itself, not the deviation */
+        ww->dev = 0;
+    } else {
+        ww->dev = ww->dev - (ww->dev >> 2) + (abs_res >> 2);
+    }
+    if (ww->windows != 0xff) {
+        ++ww->windows;
+    }
+}
+
+/**
+ * Moves the anchor point by the drift measured over the given interval.
+ *
+ * @param connsm
+ * @param itvl_ticks
+ */
+static void
+ble_ll_conn_ww_compensate(struct ble_ll_conn_sm *connsm, uint32_t itvl_ticks)
+{
+    int64_t acc;
+    int32_t ticks;
+
+    if (connsm->ww.windows == 0) {
+        return;
+    }
+
+    acc = (int64_t)connsm->ww.drift * itvl_ticks + connsm->ww.comp_frac;
+    ticks = (int32_t)(acc / BLE_LL_CONN_WW_UNITS);
+    connsm->ww.comp_frac = (int32_t)(acc - (int64_t)ticks *
+                                            BLE_LL_CONN_WW_UNITS);
+    connsm->anchor_point += ticks;
+}
+#else
+#define ble_ll_conn_ww_meas(connsm, rxtime)
+#define ble_ll_conn_ww_event_end(connsm)
+#define ble_ll_conn_ww_compensate(connsm, itvl_ticks)
+#endif
+
 /**
  * Calculate the amount of window widening for a given connection event. This
  * is the amount of time that a slave has to account for when listening for
  * the start of a connection event.
  *
+ * The worst-case widening follows from the sleep clock accuracies. With
+ * adaptive window widening, once the master's drift has been measured, the
+ * widening is based on the deviation of the measurements instead (but never
+ * exceeds the worst-case).
+ *
  * @param connsm Pointer to connection state machine.
  *
  * @return uint32_t The current window widening amount (in microseconds)
@@ -386,17 +507,36 @@ ble_ll_conn_calc_window_widening(struct ble_ll_conn_sm *connsm)
     uint32_t total_sca_ppm;
     uint32_t window_widening;
     int32_t time_since_last_anchor;
-    uint32_t delta_msec;
+    uint32_t delta_usecs;
+#if (NIMBLE_OPT_LL_CONN_ADAPT_WW == 1)
+    uint32_t adapt_ww;
+    uint64_t uncertainty;
+#endif
 
     window_widening = 0;
 
     time_since_last_anchor = (int32_t)(connsm->anchor_point -
                                        connsm->last_anchor_point);
     if (time_since_last_anchor > 0) {
-        delta_msec = cputime_ticks_to_usecs(time_since_last_anchor) / 1000;
+        delta_usecs = cputime_ticks_to_usecs(time_since_last_anchor);
         total_sca_ppm = g_ble_sca_ppm_tbl[connsm->master_sca] +
             NIMBLE_OPT_LL_OUR_SCA;
-        window_widening = (total_sca_ppm * delta_msec) / 1000;
+        /* Round up; truncating to msecs would under-widen */
+        window_widening = (uint32_t)(((uint64_t)total_sca_ppm * delta_usecs +
+                                      999999) / 1000000);
+
+#if (NIMBLE_OPT_LL_CONN_ADAPT_WW == 1)
+        if (connsm->ww.windows >= BLE_LL_CONN_WW_MIN_WINDOWS) {
+            uncertainty = (uint64_t)connsm->ww.dev * 2 +
+                          NIMBLE_OPT_LL_CONN_ADAPT_WW_MARGIN * 256;
+            adapt_ww = (uint32_t)((uncertainty * delta_usecs +
+                                   BLE_LL_CONN_WW_UNITS - 1) /
+                                  BLE_LL_CONN_WW_UNITS);
+            if (adapt_ww < window_widening) {
+                window_widening = adapt_ww;
+            }
+        }
+#endif
     }
 
     /* XXX: spec gives 16 usecs error btw. Probably should add that in */
@@ -439,6 +579,135 @@ ble_ll_conn_calc_used_chans(uint8_t *chmap)
     return used_channels;
 }
 
+#if (NIMBLE_OPT_LL_CONN_ADAPT_CHMAP == 1)
+/**
+ * Records the outcome of a receive attempt on the current data channel of
+ * the connection. Missed packets and CRC errors count as bad.
+ *
+ * Context: Interrupt
+ *
+ * @param connsm
+ * @param ok
+ */
+static void
+ble_ll_conn_chq_rx(struct ble_ll_conn_sm *connsm, int ok)
+{
+    uint8_t *cntr;
+
+    if (ok) {
+        cntr = &connsm->chq.rx_ok[connsm->data_chan_index];
+    } else {
+        cntr = &connsm->chq.rx_bad[connsm->data_chan_index];
+    }
+    if (*cntr != 0xff) {
+        ++*cntr;
+    }
+}
+
+/**
+ * Builds the channel map the master wants to use for a connection: the
+ * channels classified as usable by the host less the ones blocked due to
+ * poor receive quality. Blocked channels are ignored if too few channels
+ * would remain (can happen if the host changes its classification).
+ *
+ * @param connsm
+ * @param chanmap Pointer to where to store the channel map
+ */
+void
+ble_ll_conn_chq_chanmap(struct ble_ll_conn_sm *connsm, uint8_t *chanmap)
+{
+    int i;
+
+    for (i = 0; i < BLE_LL_CONN_CHMAP_LEN; ++i) {
+        chanmap[i] = g_ble_ll_conn_params.master_chan_map[i] &
+                     ~connsm->chq.blocked[i];
+    }
+
+    if (ble_ll_conn_calc_used_chans(chanmap) <
+        NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_MIN_CHANS) {
+        memcpy(chanmap, g_ble_ll_conn_params.master_chan_map,
+               BLE_LL_CONN_CHMAP_LEN);
+    }
+}
+
+/**
+ * Called at the end of a connection event when we are master. Judges the
+ * channel used during the event once enough samples have been collected on
+ * it, retries blocked channels periodically and starts the channel map
+ * update procedure when the desired channel map differs from the one in use.
+ *
+ * Context: Link Layer task
+ *
+ * @param connsm
+ */
+static void
+ble_ll_conn_chq_event_end(struct ble_ll_conn_sm *connsm)
+{
+    int i;
+    int total;
+    int blocked;
+    uint8_t chan;
+    uint8_t mask;
+    uint8_t chanmap[BLE_LL_CONN_CHMAP_LEN];
+    struct ble_ll_conn_chq *chq;
+
+    chq = &connsm->chq;
+    chan = connsm->data_chan_index;
+    total = chq->rx_ok[chan] + chq->rx_bad[chan];
+    if (total >= NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_SAMPLES) {
+        mask = 1 << (chan & 7);
+        if ((chq->rx_bad[chan] * 100 >=
+             total * NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_ERR_PCT) &&
+            !(chq->blocked[chan >> 3] & mask)) {
+            /* Block channel only if enough usable channels would remain */
+            blocked = 0;
+            for (i = 0; i < BLE_LL_CONN_CHMAP_LEN; ++i) {
+                chanmap[i] = g_ble_ll_conn_params.master_chan_map[i] &
+                             ~chq->blocked[i];
+                blocked |= chq->blocked[i];
+            }
+            chanmap[chan >> 3] &= ~mask;
+            if (ble_ll_conn_calc_used_chans(chanmap) >=
+                NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_MIN_CHANS) {
+                if (!blocked) {
+                    chq->retry_cntr = connsm->event_cntr +
+                                      NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_RETRY;
+                }
+                chq->blocked[chan >> 3] |= mask;
+                chq->upd_pending = 1;
+            }
+        }
+        chq->rx_ok[chan] = 0;
+        chq->rx_bad[chan] = 0;
+    }
+
+    /* Interference moves around; give blocked channels another chance */
+    if ((int16_t)(connsm->event_cntr - chq->retry_cntr) >= 0) {
+        for (i = 0; i < BLE_LL_CONN_CHMAP_LEN; ++i) {
+            if (chq->blocked[i]) {
+                memset(chq->blocked, 0, BLE_LL_CONN_CHMAP_LEN);
+                chq->upd_pending = 1;
+                break;
+            }
+        }
+    }
+
+    /* Wait for any channel map update in progress to finish */
+    if (chq->upd_pending &&
+        !connsm->csmflags.cfbit.chanmap_update_scheduled &&
+        !(connsm->pending_ctrl_procs & (1 << BLE_LL_CTRL_PROC_CHAN_MAP_UPD))) {
+        chq->upd_pending = 0;
+        ble_ll_conn_chq_chanmap(connsm, chanmap);
+        if (memcmp(chanmap, connsm->chanmap, BLE_LL_CONN_CHMAP_LEN)) {
+            ble_ll_ctrl_proc_start(connsm, BLE_LL_CTRL_PROC_CHAN_MAP_UPD);
+        }
+    }
+}
+#else
+#define ble_ll_conn_chq_rx(connsm, ok)
+#define ble_ll_conn_chq_event_end(connsm)
+#endif
+
 static uint32_t
 ble_ll_conn_calc_access_addr(void)
 {
@@ -602,6 +871,7 @@ ble_ll_conn_wfr_timer_exp(void)
     struct ble_ll_conn_sm *connsm;
 
     connsm = g_ble_ll_conn_cur_sm;
+    ble_ll_conn_chq_rx(connsm, 0);
     ble_ll_conn_current_sm_over(connsm);
     STATS_INC(ble_ll_conn_stats, wfr_expirations);
 }
@@ -935,7 +1205,7 @@ ble_ll_conn_tx_data_pdu(struct ble_ll_conn_sm *connsm)
         }
 
         ticks = cputime_usecs_to_ticks(ticks);
-        if ((cputime_get32() + ticks) < next_event_time) {
+        if (CPUTIME_LT(cputime_get32() + ticks, next_event_time)) {
             md = 1;
         }
      }
@@ -1233,6 +1503,12 @@ ble_ll_conn_event_start_cb(struct ble_ll_sched_item *sch)
  * are a master, we must be able to send the next fragment and get a minimum
  * sized response from the slave.
  *
+ * A connection event is not limited to its nominal length: as long as the
+ * MD bit keeps it going and the exchange ends before the next scheduled item
+ * (or the next connection event), the event is extended. The connection end
+ * time is moved out accordingly so that the scheduler does not place new
+ * items on top of the running event.
+ *
  * Context: Interrupt context (rx end isr).
  *
  * @param connsm
@@ -1243,19 +1519,18 @@ ble_ll_conn_event_start_cb(struct ble_ll_sched_item *sch)
 static int
 ble_ll_conn_can_send_next_pdu(struct ble_ll_conn_sm *connsm, uint32_t begtime)
 {
-    int rc;
     uint8_t rem_bytes;
     uint32_t ticks;
+    uint32_t ce_end;
     uint32_t next_sched_time;
     struct os_mbuf *txpdu;
     struct os_mbuf_pkthdr *pkthdr;
     struct ble_mbuf_hdr *txhdr;
 
-    rc = 1;
-    if (connsm->conn_role == BLE_LL_CONN_ROLE_MASTER) {
-        /* Get next scheduled item time */
-        next_sched_time = ble_ll_conn_get_next_sched_time(connsm);
+    /* Get next scheduled item time */
+    next_sched_time = ble_ll_conn_get_next_sched_time(connsm);
 
+    if (connsm->conn_role == BLE_LL_CONN_ROLE_MASTER) {
         txpdu = connsm->cur_tx_pdu;
         if (!txpdu) {
             pkthdr = STAILQ_FIRST(&connsm->conn_txq);
@@ -1279,12 +1554,25 @@ ble_ll_conn_can_send_next_pdu(struct ble_ll_conn_sm *connsm, uint32_t begtime)
         }
         ticks += (BLE_LL_IFS * 2) + connsm->eff_max_rx_time;
         ticks = cputime_usecs_to_ticks(ticks);
-        if ((begtime + ticks) >= next_sched_time) {
-            rc = 0;
+        if (CPUTIME_GEQ(begtime + ticks, next_sched_time)) {
+            return 0;
         }
+    } else {
+        /* A slave must always reply; account for a maximum sized reply */
+        ticks = BLE_LL_IFS + BLE_TX_DUR_USECS_M(connsm->eff_max_tx_octets);
+        ticks = cputime_usecs_to_ticks(ticks);
     }
 
-    return rc;
+    /* Extend the connection event if this exchange runs past its end */
+    ce_end = begtime + ticks;
+    if (CPUTIME_GT(ce_end, connsm->ce_end_time)) {
+        if (CPUTIME_GT(ce_end, next_sched_time)) {
+            ce_end = next_sched_time;
+        }
+        connsm->ce_end_time = ce_end;
+    }
+
+    return 1;
 }
 
 #if (BLE_LL_CFG_FEAT_LE_PING == 1)
@@ -1434,6 +1722,15 @@ ble_ll_conn_sm_new(struct ble_ll_conn_sm *connsm)
     connsm->reject_reason = BLE_ERR_SUCCESS;
     connsm->conn_rssi = BLE_LL_CONN_UNKNOWN_RSSI;
     connsm->rpa_index = -1;
+#if (NIMBLE_OPT_LL_PROF == 1)
+    memset(&connsm->prof, 0, sizeof(connsm->prof));
+#endif
+#if (NIMBLE_OPT_LL_CONN_ADAPT_CHMAP == 1)
+    memset(&connsm->chq, 0, sizeof(connsm->chq));
+#endif
+#if (NIMBLE_OPT_LL_CONN_ADAPT_WW == 1)
+    memset(&connsm->ww, 0, sizeof(connsm->ww));
+#endif
 
     /* Reset current control procedure */
     connsm->cur_ctrl_proc = BLE_LL_CTRL_PROC_IDLE;
@@ -1649,6 +1946,7 @@ ble_ll_conn_end(struct ble_ll_conn_sm *connsm, uint8_t ble_err)
 static int
 ble_ll_conn_next_event(struct ble_ll_conn_sm *connsm)
 {
+    int rc;
     uint16_t latency;
     uint32_t itvl;
     uint32_t tmo;
@@ -1674,6 +1972,9 @@ ble_ll_conn_next_event(struct ble_ll_conn_sm *connsm)
 
     /* Set next connection event start time */
     connsm->anchor_point += cputime_usecs_to_ticks(itvl);
+    if (connsm->conn_role == BLE_LL_CONN_ROLE_SLAVE) {
+        ble_ll_conn_ww_compensate(connsm, cputime_usecs_to_ticks(itvl));
+    }
 
     /*
      * If a connection update has been scheduled and the event counter
@@ -1710,7 +2011,9 @@ ble_ll_conn_next_event(struct ble_ll_conn_sm *connsm)
         tmo = connsm->supervision_tmo;
         tmo = tmo * BLE_HCI_CONN_SPVN_TMO_UNITS * 1000;
         tmo = cputime_usecs_to_ticks(tmo);
-        cputime_timer_start(&connsm->conn_spvn_timer, connsm->anchor_point+tmo);
+        rc = cputime_timer_start(&connsm->conn_spvn_timer,
+                                 connsm->anchor_point + tmo);
+        assert(rc == 0);
 
         /* Reset update scheduled flag */
         connsm->csmflags.cfbit.conn_update_sched = 0;
@@ -1811,7 +2114,8 @@ ble_ll_conn_created(struct ble_ll_conn_sm *connsm, uint32_t endtime)
 
     /* Set supervision timeout */
     usecs = connsm->conn_itvl * BLE_LL_CONN_ITVL_USECS * 6;
-    cputime_timer_relative(&connsm->conn_spvn_timer, usecs);
+    rc = cputime_timer_relative(&connsm->conn_spvn_timer, usecs);
+    assert(rc == 0);
 
     /* Clear packet received flag */
     connsm->csmflags.cfbit.pkt_rxd = 0;
@@ -1940,6 +2244,16 @@ ble_ll_conn_event_end(void *arg)
      */
 #endif
 
+    /*
+     * Track receive quality of the channel used (master) or the drift of
+     * the master's clock (slave)
+     */
+    if (connsm->conn_role == BLE_LL_CONN_ROLE_MASTER) {
+        ble_ll_conn_chq_event_end(connsm);
+    } else {
+        ble_ll_conn_ww_event_end(connsm);
+    }
+
     /* Move to next connection event */
     if (ble_ll_conn_next_event(connsm)) {
         ble_ll_conn_end(connsm, BLE_ERR_CONN_TERM_LOCAL);
@@ -1960,6 +2274,7 @@ ble_ll_conn_event_end(void *arg)
        we may want to force the first event to be scheduled. Not sure */
     /* Schedule the next connection event */
     while (ble_ll_sched_conn_reschedule(connsm)) {
+        ble_ll_prof_conn_skip(connsm);
         if (ble_ll_conn_next_event(connsm)) {
             ble_ll_conn_end(connsm, BLE_ERR_CONN_TERM_LOCAL);
             return;
@@ -2327,7 +2642,7 @@ ble_ll_init_rx_isr_end(uint8_t *rxbuf, uint8_t crcok,
 
 #if (BLE_LL_CFG_FEAT_LL_PRIVACY == 1)
         if (ble_ll_is_rpa(adv_addr, addr_type) && ble_ll_resolv_enabled()) {
-            index = ble_hw_resolv_list_match();
+            index = ble_ll_resolv_peer_rpa_index(adv_addr);
             if (index >= 0) {
                 ble_hdr->rxinfo.flags |= BLE_MBUF_HDR_F_RESOLVED;
                 connsm->rpa_index = index;
@@ -2495,6 +2810,7 @@ ble_ll_conn_rx_isr_start(struct ble_mbuf_hdr *rxhdr, uint32_t aa)
         /* Set anchor point (and last) if 1st rxd frame in connection event */
         if (connsm->csmflags.cfbit.slave_set_last_anchor) {
             connsm->csmflags.cfbit.slave_set_last_anchor = 0;
+            ble_ll_conn_ww_meas(connsm, rxhdr->beg_cputime);
             connsm->last_anchor_point = rxhdr->beg_cputime;
             connsm->anchor_point = connsm->last_anchor_point;
         }
@@ -2513,6 +2829,7 @@ ble_ll_conn_rx_isr_start(struct ble_mbuf_hdr *rxhdr, uint32_t aa)
 void
 ble_ll_conn_rx_data_pdu(struct os_mbuf *rxpdu, struct ble_mbuf_hdr *hdr)
 {
+    int rc;
     uint8_t hdr_byte;
     uint8_t rxd_sn;
     uint8_t *rxbuf;
@@ -2530,7 +2847,8 @@ ble_ll_conn_rx_data_pdu(struct os_mbuf *rxpdu, struct ble_mbuf_hdr *hdr)
             /* Reset the connection supervision timeout */
             cputime_timer_stop(&connsm->conn_spvn_timer);
             tmo = connsm->supervision_tmo * BLE_HCI_CONN_SPVN_TMO_UNITS * 1000;
-            cputime_timer_relative(&connsm->conn_spvn_timer, tmo);
+            rc = cputime_timer_relative(&connsm->conn_spvn_timer, tmo);
+            assert(rc == 0);
 
             /* Check state machine */
             ble_ll_conn_chk_csm_flags(connsm);
@@ -2704,6 +3022,8 @@ ble_ll_conn_rx_isr_end(uint8_t *rxbuf, struct ble_mbuf_hdr *rxhdr)
          * one we will end the connection event.
          */
         ++connsm->cons_rxd_bad_crc;
+        ble_ll_prof_conn_crc_err(connsm);
+        ble_ll_conn_chq_rx(connsm, 0);
         if (connsm->cons_rxd_bad_crc >= 2) {
             reply = 0;
         } else {
@@ -2717,6 +3037,7 @@ ble_ll_conn_rx_isr_end(uint8_t *rxbuf, struct ble_mbuf_hdr *rxhdr)
     } else {
         /* Reset consecutively received bad crcs (since this one was good!) */
         connsm->cons_rxd_bad_crc = 0;
+        ble_ll_conn_chq_rx(connsm, 1);
 
         /*
          * Check for valid LLID before proceeding. We have seen some weird
@@ -120,6 +120,9 @@ int ble_ll_conn_is_lru(struct ble_ll_conn_sm *s1, struct ble_ll_conn_sm *s2);
 uint32_t ble_ll_conn_get_ce_end_time(void);
 void ble_ll_conn_event_halt(void);
 uint8_t ble_ll_conn_calc_used_chans(uint8_t *chmap);
+#if (NIMBLE_OPT_LL_CONN_ADAPT_CHMAP == 1)
+void ble_ll_conn_chq_chanmap(struct ble_ll_conn_sm *connsm, uint8_t *chanmap);
+#endif
 
 /* HCI */
 void ble_ll_disconn_comp_event_send(struct ble_ll_conn_sm *connsm,
@@ -790,8 +790,13 @@ ble_ll_ctrl_version_ind_make(struct ble_ll_conn_sm *connsm, uint8_t *pyld)
 static void
 ble_ll_ctrl_chanmap_req_make(struct ble_ll_conn_sm *connsm, uint8_t *pyld)
 {
+#if (NIMBLE_OPT_LL_CONN_ADAPT_CHMAP == 1)
+    /* Channel map that host desires, less channels with poor quality */
+    ble_ll_conn_chq_chanmap(connsm, pyld);
+#else
     /* Copy channel map that host desires into request */
     memcpy(pyld, g_ble_ll_conn_params.master_chan_map, BLE_LL_CONN_CHMAP_LEN);
+#endif
     memcpy(connsm->req_chanmap, pyld, BLE_LL_CONN_CHMAP_LEN);
 
     /* Place instant into request */
@@ -29,6 +29,7 @@
 #include "controller/ble_ll_scan.h"
 #include "controller/ble_ll.h"
 #include "controller/ble_ll_hci.h"
+#include "controller/ble_ll_prof.h"
 #include "controller/ble_ll_whitelist.h"
 #include "controller/ble_ll_resolv.h"
 #include "ble_ll_conn_priv.h"
@@ -900,6 +901,66 @@ ble_ll_hci_status_params_cmd_proc(uint8_t *cmdbuf, uint16_t ocf, uint8_t *rsplen
     return rc;
 }
 
+#if (NIMBLE_OPT_LL_PROF == 1)
+/**
+ * Process a vendor specific command sent from the host to the controller.
+ *
+ * @param cmdbuf
+ * @param ocf
+ * @param rsplen
+ *
+ * @return int
+ */
+static int
+ble_ll_hci_vendor_cmd_proc(uint8_t *cmdbuf, uint16_t ocf, uint8_t *rsplen)
+{
+    int rc;
+    uint8_t len;
+    uint8_t *rspbuf;
+
+    /* Assume error; if all pass rc gets set to 0 */
+    rc = BLE_ERR_INV_HCI_CMD_PARMS;
+
+    /* Get length from command */
+    len = cmdbuf[sizeof(uint16_t)];
+
+    /* The response overwrites the command; see status params above. */
+    rspbuf = cmdbuf + BLE_HCI_EVENT_CMD_COMPLETE_MIN_LEN;
+
+    /* Move past HCI command header */
+    cmdbuf += BLE_HCI_CMD_HDR_LEN;
+
+    switch (ocf) {
+    case BLE_HCI_OCF_VS_RD_LL_PROF:
+        if (len == 0) {
+            rc = ble_ll_prof_hci_rd_ll(rspbuf, rsplen);
+        }
+        break;
+    case BLE_HCI_OCF_VS_RD_CONN_PROF:
+        if (len == BLE_HCI_VS_RD_CONN_PROF_LEN) {
+            rc = ble_ll_prof_hci_rd_conn(cmdbuf, rspbuf, rsplen);
+        }
+        break;
+    case BLE_HCI_OCF_VS_RD_CHAN_CRC_ERRS:
+        if (len == BLE_HCI_VS_RD_CHAN_CRC_ERRS_LEN) {
+            rc = ble_ll_prof_hci_rd_chan_crc_errs(cmdbuf, rspbuf, rsplen);
+        }
+        break;
+    case BLE_HCI_OCF_VS_CLR_LL_PROF:
+        if (len == 0) {
+            ble_ll_prof_reset();
+            rc = BLE_ERR_SUCCESS;
+        }
+        break;
+    default:
+        rc = BLE_ERR_UNKNOWN_HCI_CMD;
+        break;
+    }
+
+    return rc;
+}
+#endif
+
 /**
  * Called to process an HCI command from the host.
  *
@@ -948,6 +1009,11 @@ ble_ll_hci_cmd_proc(struct os_event *ev)
     case BLE_HCI_OGF_LE:
         rc = ble_ll_hci_le_cmd_proc(cmdbuf, ocf, &rsplen);
         break;
+#if (NIMBLE_OPT_LL_PROF == 1)
+    case BLE_HCI_OGF_VENDOR:
+        rc = ble_ll_hci_vendor_cmd_proc(cmdbuf, ocf, &rsplen);
+        break;
+#endif
     default:
         /* XXX: Need to support other OGF. For now, return unsupported */
         rc = BLE_ERR_UNKNOWN_HCI_CMD;
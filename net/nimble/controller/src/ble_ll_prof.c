@@ -0,0 +1,451 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "os/os.h"
+#include "stats/stats.h"
+#include "nimble/ble.h"
+#include "nimble/nimble_opt.h"
+#include "nimble/hci_common.h"
+#include "controller/ble_phy.h"
+#include "controller/ble_ll.h"
+#include "controller/ble_ll_sched.h"
+#include "controller/ble_ll_prof.h"
+#include "ble_ll_conn_priv.h"
+#include "hal/hal_cputime.h"
+
+#if (NIMBLE_OPT_LL_PROF == 1)
+
+STATS_SECT_START(ble_ll_prof_stats)
+    STATS_SECT_ENTRY(adv_sched)
+    STATS_SECT_ENTRY(adv_exec)
+    STATS_SECT_ENTRY(adv_aborted)
+    STATS_SECT_ENTRY(adv_overruns)
+    STATS_SECT_ENTRY(conn_sched)
+    STATS_SECT_ENTRY(conn_exec)
+    STATS_SECT_ENTRY(conn_aborted)
+    STATS_SECT_ENTRY(conn_overruns)
+    STATS_SECT_ENTRY(conn_skipped)
+    STATS_SECT_ENTRY(adv_usecs)
+    STATS_SECT_ENTRY(scan_usecs)
+    STATS_SECT_ENTRY(init_usecs)
+    STATS_SECT_ENTRY(conn_usecs)
+    STATS_SECT_ENTRY(adv_max_late_usecs)
+    STATS_SECT_ENTRY(conn_max_late_usecs)
+STATS_SECT_END
+STATS_SECT_DECL(ble_ll_prof_stats) ble_ll_prof_stats;
+
+STATS_NAME_START(ble_ll_prof_stats)
+    STATS_NAME(ble_ll_prof_stats, adv_sched)
+    STATS_NAME(ble_ll_prof_stats, adv_exec)
+    STATS_NAME(ble_ll_prof_stats, adv_aborted)
+    STATS_NAME(ble_ll_prof_stats, adv_overruns)
+    STATS_NAME(ble_ll_prof_stats, conn_sched)
+    STATS_NAME(ble_ll_prof_stats, conn_exec)
+    STATS_NAME(ble_ll_prof_stats, conn_aborted)
+    STATS_NAME(ble_ll_prof_stats, conn_overruns)
+    STATS_NAME(ble_ll_prof_stats, conn_skipped)
+    STATS_NAME(ble_ll_prof_stats, adv_usecs)
+    STATS_NAME(ble_ll_prof_stats, scan_usecs)
+    STATS_NAME(ble_ll_prof_stats, init_usecs)
+    STATS_NAME(ble_ll_prof_stats, conn_usecs)
+    STATS_NAME(ble_ll_prof_stats, adv_max_late_usecs)
+    STATS_NAME(ble_ll_prof_stats, conn_max_late_usecs)
+STATS_NAME_END(ble_ll_prof_stats)
+
+#define BLE_LL_PROF_STAT(var)   (ble_ll_prof_stats.STATS_SECT_VAR(var))
+
+struct ble_ll_prof
+{
+    /* Time at which the link layer entered its current state */
+    uint32_t state_start;
+
+    /* The schedule item currently executing, if any */
+    uint8_t cur_type;
+    uint32_t cur_end_time;
+    struct ble_ll_conn_sm *cur_connsm;
+
+    /* Received PDUs with bad CRC, per channel */
+    uint32_t crc_errs[BLE_PHY_NUM_CHANS];
+};
+
+struct ble_ll_prof g_ble_ll_prof;
+
+/**
+ * Called when a schedule item is inserted into the scheduler queue.
+ *
+ * Context: Any (called with interrupts disabled)
+ *
+ * @param sch
+ */
+void
+ble_ll_prof_sched(struct ble_ll_sched_item *sch)
+{
+    switch (sch->sched_type) {
+    case BLE_LL_SCHED_TYPE_ADV:
+        STATS_INC(ble_ll_prof_stats, adv_sched);
+        break;
+    case BLE_LL_SCHED_TYPE_CONN:
+        STATS_INC(ble_ll_prof_stats, conn_sched);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Called by the scheduler right before a schedule item callback is run.
+ * Records how late the item is being executed and remembers the item so
+ * that the time spent in the state it starts can be attributed to it.
+ *
+ * Context: Interrupt (scheduler)
+ *
+ * @param sch
+ */
+void
+ble_ll_prof_exec_start(struct ble_ll_sched_item *sch)
+{
+    uint32_t late;
+    struct ble_ll_conn_sm *connsm;
+
+    late = cputime_ticks_to_usecs(cputime_get32() - sch->start_time);
+
+    g_ble_ll_prof.cur_type = sch->sched_type;
+    g_ble_ll_prof.cur_end_time = sch->end_time;
+    g_ble_ll_prof.cur_connsm = NULL;
+
+    switch (sch->sched_type) {
+    case BLE_LL_SCHED_TYPE_ADV:
+        STATS_INC(ble_ll_prof_stats, adv_exec);
+        if (late > BLE_LL_PROF_STAT(adv_max_late_usecs)) {
+            BLE_LL_PROF_STAT(adv_max_late_usecs) = late;
+        }
+        break;
+    case BLE_LL_SCHED_TYPE_CONN:
+        STATS_INC(ble_ll_prof_stats, conn_exec);
+        if (late > BLE_LL_PROF_STAT(conn_max_late_usecs)) {
+            BLE_LL_PROF_STAT(conn_max_late_usecs) = late;
+        }
+        connsm = (struct ble_ll_conn_sm *)sch->cb_arg;
+        ++connsm->prof.events;
+        g_ble_ll_prof.cur_connsm = connsm;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Called by the scheduler after a schedule item callback has run. An item
+ * whose callback is done immediately (e.g. it was too late to start
+ * transmitting) is counted as aborted.
+ *
+ * Context: Interrupt (scheduler)
+ *
+ * @param sch
+ * @param rc    Return code from the schedule item callback
+ */
+void
+ble_ll_prof_exec_end(struct ble_ll_sched_item *sch, int rc)
+{
+    if (rc != BLE_LL_SCHED_STATE_DONE) {
+        return;
+    }
+
+    switch (sch->sched_type) {
+    case BLE_LL_SCHED_TYPE_ADV:
+        STATS_INC(ble_ll_prof_stats, adv_aborted);
+        break;
+    case BLE_LL_SCHED_TYPE_CONN:
+        STATS_INC(ble_ll_prof_stats, conn_aborted);
+        ++((struct ble_ll_conn_sm *)sch->cb_arg)->prof.aborted;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Called when the link layer state changes. Adds the time spent in the state
+ * being left to that state's counter (and the current connection's, when
+ * leaving connection state) and checks whether the event ran past the end
+ * of its schedule item.
+ *
+ * Context: Link Layer task and interrupt
+ *
+ * @param old_state
+ * @param new_state
+ */
+void
+ble_ll_prof_state_chg(uint8_t old_state, uint8_t new_state)
+{
+    int overrun;
+    uint32_t now;
+    uint32_t usecs;
+    os_sr_t sr;
+
+    if (old_state == new_state) {
+        return;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    now = cputime_get32();
+    usecs = cputime_ticks_to_usecs(now - g_ble_ll_prof.state_start);
+    g_ble_ll_prof.state_start = now;
+
+    overrun = (g_ble_ll_prof.cur_type != 0) &&
+              ((int32_t)(now - g_ble_ll_prof.cur_end_time) > 0);
+
+    switch (old_state) {
+    case BLE_LL_STATE_ADV:
+        STATS_INCN(ble_ll_prof_stats, adv_usecs, usecs);
+        if (overrun && (g_ble_ll_prof.cur_type == BLE_LL_SCHED_TYPE_ADV)) {
+            STATS_INC(ble_ll_prof_stats, adv_overruns);
+        }
+        break;
+    case BLE_LL_STATE_SCANNING:
+        STATS_INCN(ble_ll_prof_stats, scan_usecs, usecs);
+        break;
+    case BLE_LL_STATE_INITIATING:
+        STATS_INCN(ble_ll_prof_stats, init_usecs, usecs);
+        break;
+    case BLE_LL_STATE_CONNECTION:
+        STATS_INCN(ble_ll_prof_stats, conn_usecs, usecs);
+        if (g_ble_ll_prof.cur_connsm) {
+            g_ble_ll_prof.cur_connsm->prof.radio_usecs += usecs;
+            if (overrun) {
+                STATS_INC(ble_ll_prof_stats, conn_overruns);
+                ++g_ble_ll_prof.cur_connsm->prof.overruns;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    /* The schedule item is over once its state has been left */
+    if (old_state != BLE_LL_STATE_STANDBY) {
+        g_ble_ll_prof.cur_type = 0;
+        g_ble_ll_prof.cur_connsm = NULL;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Called when a connection event is skipped because it could not be put on
+ * the schedule.
+ *
+ * Context: Link Layer task
+ *
+ * @param connsm
+ */
+void
+ble_ll_prof_conn_skip(struct ble_ll_conn_sm *connsm)
+{
+    STATS_INC(ble_ll_prof_stats, conn_skipped);
+    ++connsm->prof.skipped;
+}
+
+/**
+ * Count a received PDU with a bad CRC on the given channel.
+ *
+ * Context: Link Layer task
+ *
+ * @param chan
+ */
+void
+ble_ll_prof_crc_err(uint8_t chan)
+{
+    if (chan < BLE_PHY_NUM_CHANS) {
+        ++g_ble_ll_prof.crc_errs[chan];
+    }
+}
+
+/**
+ * Count a received PDU with a bad CRC on the given connection.
+ *
+ * Context: Interrupt
+ *
+ * @param connsm
+ */
+void
+ble_ll_prof_conn_crc_err(struct ble_ll_conn_sm *connsm)
+{
+    ++connsm->prof.rx_crc_errs;
+}
+
+/**
+ * Clears all profiler counters, including those of active connections.
+ *
+ * Context: Link Layer task
+ */
+void
+ble_ll_prof_reset(void)
+{
+    uint16_t handle;
+    os_sr_t sr;
+    struct ble_ll_conn_sm *connsm;
+
+    OS_ENTER_CRITICAL(sr);
+    memset((uint8_t *)&ble_ll_prof_stats + sizeof(struct stats_hdr), 0,
+           sizeof(ble_ll_prof_stats) - sizeof(struct stats_hdr));
+    memset(g_ble_ll_prof.crc_errs, 0, sizeof(g_ble_ll_prof.crc_errs));
+
+    for (handle = 1; handle <= NIMBLE_OPT_MAX_CONNECTIONS; ++handle) {
+        connsm = ble_ll_conn_find_active_conn(handle);
+        if (connsm) {
+            memset(&connsm->prof, 0, sizeof(connsm->prof));
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Vendor specific HCI command: read the link layer profile. All counters
+ * are 32-bit little endian.
+ *
+ * @param rspbuf
+ * @param rsplen
+ *
+ * @return int BLE error code
+ */
+int
+ble_ll_prof_hci_rd_ll(uint8_t *rspbuf, uint8_t *rsplen)
+{
+    htole32(rspbuf, BLE_LL_PROF_STAT(adv_sched));
+    htole32(rspbuf + 4, BLE_LL_PROF_STAT(adv_exec));
+    htole32(rspbuf + 8, BLE_LL_PROF_STAT(adv_aborted));
+    htole32(rspbuf + 12, BLE_LL_PROF_STAT(adv_overruns));
+    htole32(rspbuf + 16, BLE_LL_PROF_STAT(conn_sched));
+    htole32(rspbuf + 20, BLE_LL_PROF_STAT(conn_exec));
+    htole32(rspbuf + 24, BLE_LL_PROF_STAT(conn_aborted));
+    htole32(rspbuf + 28, BLE_LL_PROF_STAT(conn_overruns));
+    htole32(rspbuf + 32, BLE_LL_PROF_STAT(conn_skipped));
+    htole32(rspbuf + 36, BLE_LL_PROF_STAT(adv_usecs));
+    htole32(rspbuf + 40, BLE_LL_PROF_STAT(scan_usecs));
+    htole32(rspbuf + 44, BLE_LL_PROF_STAT(init_usecs));
+    htole32(rspbuf + 48, BLE_LL_PROF_STAT(conn_usecs));
+    htole32(rspbuf + 52, BLE_LL_PROF_STAT(adv_max_late_usecs));
+    htole32(rspbuf + 56, BLE_LL_PROF_STAT(conn_max_late_usecs));
+    *rsplen = BLE_HCI_VS_RD_LL_PROF_RSPLEN;
+
+    return BLE_ERR_SUCCESS;
+}
+
+/**
+ * Vendor specific HCI command: read the profile of a connection.
+ *
+ * @param cmdbuf
+ * @param rspbuf
+ * @param rsplen
+ *
+ * @return int BLE error code
+ */
+int
+ble_ll_prof_hci_rd_conn(uint8_t *cmdbuf, uint8_t *rspbuf, uint8_t *rsplen)
+{
+    uint16_t handle;
+    struct ble_ll_conn_sm *connsm;
+
+    handle = le16toh(cmdbuf);
+    connsm = ble_ll_conn_find_active_conn(handle);
+    if (!connsm) {
+        return BLE_ERR_UNK_CONN_ID;
+    }
+
+    htole16(rspbuf, handle);
+    htole32(rspbuf + 2, connsm->prof.events);
+    htole32(rspbuf + 6, connsm->prof.skipped);
+    htole32(rspbuf + 10, connsm->prof.aborted);
+    htole32(rspbuf + 14, connsm->prof.overruns);
+    htole32(rspbuf + 18, connsm->prof.radio_usecs);
+    htole32(rspbuf + 22, connsm->prof.rx_crc_errs);
+    *rsplen = BLE_HCI_VS_RD_CONN_PROF_RSPLEN;
+
+    return BLE_ERR_SUCCESS;
+}
+
+/**
+ * Vendor specific HCI command: read the number of received PDUs with bad
+ * CRC on each channel, starting at the channel given in the command. The
+ * response holds the first channel, the number of channels that follow and
+ * a 16-bit (saturated) count for each.
+ *
+ * @param cmdbuf
+ * @param rspbuf
+ * @param rsplen
+ *
+ * @return int BLE error code
+ */
+int
+ble_ll_prof_hci_rd_chan_crc_errs(uint8_t *cmdbuf, uint8_t *rspbuf,
+                                 uint8_t *rsplen)
+{
+    int i;
+    uint8_t chan;
+    uint8_t num_chans;
+    uint32_t errs;
+
+    chan = cmdbuf[0];
+    if (chan >= BLE_PHY_NUM_CHANS) {
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    num_chans = BLE_PHY_NUM_CHANS - chan;
+    if (num_chans > BLE_HCI_VS_RD_CHAN_CRC_ERRS_MAX) {
+        num_chans = BLE_HCI_VS_RD_CHAN_CRC_ERRS_MAX;
+    }
+
+    rspbuf[0] = chan;
+    rspbuf[1] = num_chans;
+    for (i = 0; i < num_chans; ++i) {
+        errs = g_ble_ll_prof.crc_errs[chan + i];
+        if (errs > 0xffff) {
+            errs = 0xffff;
+        }
+        htole16(rspbuf + 2 + (i * 2), (uint16_t)errs);
+    }
+    *rsplen = 2 + (num_chans * 2);
+
+    return BLE_ERR_SUCCESS;
+}
+
+/**
+ * Initialize the link layer profiler.
+ *
+ * @return int 0: success
+ */
+int
+ble_ll_prof_init(void)
+{
+    int rc;
+
+    memset(&g_ble_ll_prof, 0, sizeof(g_ble_ll_prof));
+    g_ble_ll_prof.state_start = cputime_get32();
+
+    rc = stats_init_and_reg(STATS_HDR(ble_ll_prof_stats),
+                            STATS_SIZE_INIT_PARMS(ble_ll_prof_stats,
+                                                  STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(ble_ll_prof_stats),
+                            "ble_ll_prof");
+    return rc;
+}
+
+#endif
@@ -40,6 +40,25 @@ uint8_t g_ble_ll_rnum_buf[NIMBLE_OPT_LL_RNG_BUFSIZE];
 #define IS_RNUM_BUF_END(x)  \
     (x == &g_ble_ll_rnum_buf[NIMBLE_OPT_LL_RNG_BUFSIZE - 1])
 
+#if (NIMBLE_OPT_LL_RNG_BUFSIZE < BLE_ENC_BLOCK_SIZE)
+#error "NIMBLE_OPT_LL_RNG_BUFSIZE must hold at least one key of entropy"
+#endif
+
+/*
+ * AES-CTR DRBG. The counter (V) lives in the plain text of the encryption
+ * block. The key is replaced after every request so that earlier output can
+ * not be recomputed from the state, and fresh entropy from the RNG buffer is
+ * mixed into it every NIMBLE_OPT_LL_RNG_RESEED_BLOCKS blocks.
+ */
+struct ble_ll_drbg
+{
+    uint8_t seeded;
+    uint16_t blocks;
+    struct ble_encryption_block ecb;
+};
+
+struct ble_ll_drbg g_ble_ll_drbg;
+
 void
 ble_ll_rand_sample(uint8_t rnum)
 {
@@ -61,9 +80,9 @@ ble_ll_rand_sample(uint8_t rnum)
     OS_EXIT_CRITICAL(sr);
 }
 
-/* Get 'len' bytes of random data */
-int
-ble_ll_rand_data_get(uint8_t *buf, uint8_t len)
+/* Get 'len' bytes of entropy from the RNG buffer, waiting if needed */
+static void
+ble_ll_rand_entropy_get(uint8_t *buf, uint8_t len)
 {
     uint8_t rnums;
     os_sr_t sr;
@@ -99,6 +118,93 @@ ble_ll_rand_data_get(uint8_t *buf, uint8_t len)
             }
         }
     }
+}
+
+static void
+ble_ll_drbg_incr(struct ble_ll_drbg *drbg)
+{
+    int i;
+
+    for (i = BLE_ENC_BLOCK_SIZE - 1; i >= 0; --i) {
+        if (++drbg->ecb.plain_text[i] != 0) {
+            break;
+        }
+    }
+}
+
+/**
+ * Mixes entropy from the RNG buffer into the DRBG key when a reseed is due.
+ * Never waits: if the RNG buffer does not hold a full key yet, the current
+ * key is kept and the reseed is done on a later call. Called with interrupts
+ * disabled.
+ */
+static void
+ble_ll_drbg_reseed(struct ble_ll_drbg *drbg)
+{
+    int i;
+    uint8_t seed[BLE_ENC_BLOCK_SIZE];
+
+    if (drbg->seeded && (drbg->blocks < NIMBLE_OPT_LL_RNG_RESEED_BLOCKS)) {
+        return;
+    }
+    if (g_ble_ll_rnum_data.rnd_size < BLE_ENC_BLOCK_SIZE) {
+        ble_hw_rng_start();
+        return;
+    }
+
+    ble_ll_rand_entropy_get(seed, BLE_ENC_BLOCK_SIZE);
+    for (i = 0; i < BLE_ENC_BLOCK_SIZE; ++i) {
+        drbg->ecb.key[i] ^= seed[i];
+    }
+    drbg->blocks = 0;
+    drbg->seeded = 1;
+}
+
+/* Get 'len' bytes of random data */
+int
+ble_ll_rand_data_get(uint8_t *buf, uint8_t len)
+{
+    uint8_t chunk;
+    os_sr_t sr;
+    struct ble_ll_drbg *drbg;
+
+    drbg = &g_ble_ll_drbg;
+
+    /*
+     * The encryption block is shared with other users of the AES hardware
+     * and the DRBG is used from interrupt context as well. The first key has
+     * to come from the RNG; wait for it with interrupts enabled.
+     */
+    while (1) {
+        while (!drbg->seeded &&
+               (g_ble_ll_rnum_data.rnd_size < BLE_ENC_BLOCK_SIZE)) {
+            ble_hw_rng_start();
+        }
+
+        OS_ENTER_CRITICAL(sr);
+        ble_ll_drbg_reseed(drbg);
+        if (drbg->seeded) {
+            break;
+        }
+        OS_EXIT_CRITICAL(sr);
+    }
+
+    while (len != 0) {
+        ble_ll_drbg_incr(drbg);
+        ble_hw_encrypt_block(&drbg->ecb);
+        ++drbg->blocks;
+
+        chunk = min(len, BLE_ENC_BLOCK_SIZE);
+        memcpy(buf, drbg->ecb.cipher_text, chunk);
+        buf += chunk;
+        len -= chunk;
+    }
+
+    /* New key; output handed out above can't be regenerated */
+    ble_ll_drbg_incr(drbg);
+    ble_hw_encrypt_block(&drbg->ecb);
+    memcpy(drbg->ecb.key, drbg->ecb.cipher_text, BLE_ENC_BLOCK_SIZE);
+    OS_EXIT_CRITICAL(sr);
 
     return BLE_ERR_SUCCESS;
 }
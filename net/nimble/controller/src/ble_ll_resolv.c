@@ -43,6 +43,146 @@ struct ble_ll_resolv_data g_ble_ll_resolv_data;
 
 struct ble_ll_resolv_entry g_ble_ll_resolv_list[NIMBLE_OPT_LL_RESOLV_LIST_SIZE];
 
+#if (NIMBLE_OPT_LL_RESOLV_CACHE_SIZE > 0)
+/*
+ * Cache of peer RPAs recently run through the software resolver. The index
+ * is the resolving list index the RPA resolved to or -1 if it did not
+ * resolve. Entries are replaced round-robin.
+ */
+struct ble_ll_resolv_cache_entry
+{
+    int8_t rc_index;
+    uint8_t rc_rpa[BLE_DEV_ADDR_LEN];
+};
+
+struct ble_ll_resolv_cache
+{
+    uint8_t rc_cnt;
+    uint8_t rc_next;
+    struct ble_ll_resolv_cache_entry rc_entries[NIMBLE_OPT_LL_RESOLV_CACHE_SIZE];
+};
+struct ble_ll_resolv_cache g_ble_ll_resolv_cache;
+
+/**
+ * Flushes the RPA cache. Called when the resolving list changes and when the
+ * RPA timer expires (peers will have generated new RPAs by then).
+ */
+static void
+ble_ll_resolv_cache_flush(void)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    g_ble_ll_resolv_cache.rc_cnt = 0;
+    g_ble_ll_resolv_cache.rc_next = 0;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Looks up a peer RPA in the cache.
+ *
+ * @param rpa       The RPA (little endian)
+ * @param index     Set to the cached resolving list index (-1: no match)
+ *
+ * @return int 1: RPA found in cache. 0: not found.
+ */
+static int
+ble_ll_resolv_cache_find(uint8_t *rpa, int *index)
+{
+    int i;
+    struct ble_ll_resolv_cache_entry *rce;
+
+    rce = &g_ble_ll_resolv_cache.rc_entries[0];
+    for (i = 0; i < g_ble_ll_resolv_cache.rc_cnt; ++i) {
+        if (!memcmp(rce->rc_rpa, rpa, BLE_DEV_ADDR_LEN)) {
+            *index = rce->rc_index;
+            return 1;
+        }
+        ++rce;
+    }
+
+    return 0;
+}
+
+static void
+ble_ll_resolv_cache_add(uint8_t *rpa, int index)
+{
+    struct ble_ll_resolv_cache_entry *rce;
+
+    rce = &g_ble_ll_resolv_cache.rc_entries[g_ble_ll_resolv_cache.rc_next];
+    memcpy(rce->rc_rpa, rpa, BLE_DEV_ADDR_LEN);
+    rce->rc_index = (int8_t)index;
+
+    ++g_ble_ll_resolv_cache.rc_next;
+    if (g_ble_ll_resolv_cache.rc_next == NIMBLE_OPT_LL_RESOLV_CACHE_SIZE) {
+        g_ble_ll_resolv_cache.rc_next = 0;
+    }
+    if (g_ble_ll_resolv_cache.rc_cnt < NIMBLE_OPT_LL_RESOLV_CACHE_SIZE) {
+        ++g_ble_ll_resolv_cache.rc_cnt;
+    }
+}
+#else
+#define ble_ll_resolv_cache_flush()
+#endif
+
+#if (NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE > 0)
+/*
+ * Posted to the LL task whenever a precomputed RPA is consumed (or the
+ * resolving list gains an entry) to get the pools refilled.
+ */
+static struct os_event g_ble_ll_resolv_pool_ev = {
+    .ev_type = BLE_LL_EVENT_RPA_POOL,
+};
+
+static void
+ble_ll_resolv_rpa_pool_refill(void)
+{
+    os_eventq_put(&g_ble_ll_data.ll_evq, &g_ble_ll_resolv_pool_ev);
+}
+
+/**
+ * Takes a precomputed RPA from the pool of a resolving list entry. Does not
+ * do any AES work so can be called from interrupt context.
+ *
+ * @param rl
+ * @param local     1: take the next local RPA. 0: take a peer RPA.
+ * @param addr      Filled with the RPA (little endian)
+ *
+ * @return int 1: RPA taken. 0: pool is empty.
+ */
+static int
+ble_ll_resolv_rpa_pool_take(struct ble_ll_resolv_entry *rl, int local,
+                            uint8_t *addr)
+{
+    int rc;
+    os_sr_t sr;
+
+    rc = 0;
+    OS_ENTER_CRITICAL(sr);
+    if (local) {
+        if (rl->rl_next_rpa_set) {
+            memcpy(addr, rl->rl_next_local_rpa, BLE_DEV_ADDR_LEN);
+            rl->rl_next_rpa_set = 0;
+            rc = 1;
+        }
+    } else {
+        if (rl->rl_peer_rpa_cnt) {
+            --rl->rl_peer_rpa_cnt;
+            memcpy(addr, rl->rl_peer_rpas[rl->rl_peer_rpa_cnt],
+                   BLE_DEV_ADDR_LEN);
+            rc = 1;
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    ble_ll_resolv_rpa_pool_refill();
+
+    return rc;
+}
+#else
+#define ble_ll_resolv_rpa_pool_refill()
+#endif
+
 /**
  * Called to determine if a change is allowed to the resolving list at this
  * time. We are not allowed to modify the resolving list if address translation
@@ -88,6 +228,7 @@ ble_ll_resolv_rpa_timer_cb(void *arg)
         OS_EXIT_CRITICAL(sr);
         ++rl;
     }
+    ble_ll_resolv_cache_flush();
     os_callout_reset(&g_ble_ll_resolv_data.rpa_timer.cf_c,
                      (int32_t)g_ble_ll_resolv_data.rpa_tmo);
 }
@@ -133,6 +274,7 @@ ble_ll_resolv_list_clr(void)
     /* Sets total on list to 0. Clears HW resolve list */
     g_ble_ll_resolv_data.rl_cnt = 0;
     ble_hw_resolv_list_clear();
+    ble_ll_resolv_cache_flush();
 
     return BLE_ERR_SUCCESS;
 }
@@ -238,6 +380,8 @@ ble_ll_resolv_list_add(uint8_t *cmdbuf)
         rl = &g_ble_ll_resolv_list[g_ble_ll_resolv_data.rl_cnt];
         rl->rl_addr_type = addr_type;
         rl->rl_local_rpa_set = 0;
+        rl->rl_next_rpa_set = 0;
+        rl->rl_peer_rpa_cnt = 0;
         memcpy(&rl->rl_identity_addr[0], ident_addr, BLE_DEV_ADDR_LEN);
         swap_buf(rl->rl_peer_irk, cmdbuf + 7, 16);
         swap_buf(rl->rl_local_irk, cmdbuf + 23, 16);
@@ -252,6 +396,8 @@ ble_ll_resolv_list_add(uint8_t *cmdbuf)
             rl->rl_local_rpa_set = 1;
         }
         ++g_ble_ll_resolv_data.rl_cnt;
+        ble_ll_resolv_cache_flush();
+        ble_ll_resolv_rpa_pool_refill();
     }
 
     return rc;
@@ -281,14 +427,16 @@ ble_ll_resolv_list_rmv(uint8_t *cmdbuf)
 
     /* Remove from IRK records */
     position = ble_ll_is_on_resolv_list(ident_addr, addr_type);
-    if (position && (position < g_ble_ll_resolv_data.rl_cnt)) {
+    if (position) {
         memmove(&g_ble_ll_resolv_list[position - 1],
                 &g_ble_ll_resolv_list[position],
-                g_ble_ll_resolv_data.rl_cnt - position);
+                (g_ble_ll_resolv_data.rl_cnt - position) *
+                sizeof(struct ble_ll_resolv_entry));
         --g_ble_ll_resolv_data.rl_cnt;
 
         /* Remove from HW list */
         ble_hw_resolv_list_rmv(position - 1);
+        ble_ll_resolv_cache_flush();
     }
 
     return BLE_ERR_SUCCESS;
@@ -385,43 +533,25 @@ ble_ll_resolv_get_rpa_tmo(void)
 }
 
 /**
- * Called to generate a resolvable private address
+ * Calculates a new resolvable private address from an IRK
  *
- * @param rl
- * @param local
- * @param addr Pointer to resolvable private address
+ * @param irk   The IRK (big endian)
+ * @param addr  Pointer to resolvable private address
  */
-void
-ble_ll_resolv_gen_priv_addr(struct ble_ll_resolv_entry *rl, int local,
-                            uint8_t *addr)
+static void
+ble_ll_resolv_calc_rpa(uint8_t *irk, uint8_t *addr)
 {
-    uint8_t *irk;
     uint8_t *prand;
     uint32_t *irk32;
     uint32_t *key32;
     uint32_t *pt32;
     struct ble_encryption_block ecb;
 
-    assert(rl != NULL);
-    assert(addr != NULL);
-
-    /* If the local rpa has already been generated, just copy it */
-    if (local && rl->rl_local_rpa_set) {
-        memcpy(addr, rl->rl_local_rpa, BLE_DEV_ADDR_LEN);
-        return;
-    }
-
     /* Get prand */
     prand = addr + 3;
     ble_ll_rand_prand_get(prand);
 
-    /* Calculate hash, hash = ah(local IRK, prand) */
-    if (local) {
-        irk = rl->rl_local_irk;
-    } else {
-        irk = rl->rl_peer_irk;
-    }
-
+    /* Calculate hash, hash = ah(IRK, prand) */
     irk32 = (uint32_t *)irk;
     key32 = (uint32_t *)&ecb.key[0];
     key32[0] = irk32[0];
@@ -445,6 +575,85 @@ ble_ll_resolv_gen_priv_addr(struct ble_ll_resolv_entry *rl, int local,
     addr[2] = ecb.cipher_text[13];
 }
 
+/**
+ * Called to generate a resolvable private address. A precomputed RPA is
+ * used if one is available.
+ *
+ * @param rl
+ * @param local
+ * @param addr Pointer to resolvable private address
+ */
+void
+ble_ll_resolv_gen_priv_addr(struct ble_ll_resolv_entry *rl, int local,
+                            uint8_t *addr)
+{
+    assert(rl != NULL);
+    assert(addr != NULL);
+
+    /* If the local rpa has already been generated, just copy it */
+    if (local && rl->rl_local_rpa_set) {
+        memcpy(addr, rl->rl_local_rpa, BLE_DEV_ADDR_LEN);
+        return;
+    }
+
+#if (NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE > 0)
+    if (ble_ll_resolv_rpa_pool_take(rl, local, addr)) {
+        return;
+    }
+#endif
+
+    if (local) {
+        ble_ll_resolv_calc_rpa(rl->rl_local_irk, addr);
+    } else {
+        ble_ll_resolv_calc_rpa(rl->rl_peer_irk, addr);
+    }
+}
+
+/**
+ * Refills the precomputed RPA pool of each resolving list entry: the next
+ * local RPA (used when the RPA timer expires) and up to
+ * NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE peer RPAs. Entries with an all-zero IRK
+ * are skipped as no RPA is generated for them.
+ *
+ * The resolving list is only modified from the LL task so the RPAs can be
+ * calculated outside of a critical section; only adding them to the pool
+ * needs protection from interrupt context consumers.
+ */
+void
+ble_ll_resolv_rpa_pool_fill(void)
+{
+#if (NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE > 0)
+    int i;
+    os_sr_t sr;
+    uint8_t rpa[BLE_DEV_ADDR_LEN];
+    struct ble_ll_resolv_entry *rl;
+
+    rl = &g_ble_ll_resolv_list[0];
+    for (i = 0; i < g_ble_ll_resolv_data.rl_cnt; ++i) {
+        if (!rl->rl_next_rpa_set &&
+            ble_ll_resolv_irk_nonzero(rl->rl_local_irk)) {
+            ble_ll_resolv_calc_rpa(rl->rl_local_irk, rpa);
+            OS_ENTER_CRITICAL(sr);
+            memcpy(rl->rl_next_local_rpa, rpa, BLE_DEV_ADDR_LEN);
+            rl->rl_next_rpa_set = 1;
+            OS_EXIT_CRITICAL(sr);
+        }
+
+        if (ble_ll_resolv_irk_nonzero(rl->rl_peer_irk)) {
+            while (rl->rl_peer_rpa_cnt < NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE) {
+                ble_ll_resolv_calc_rpa(rl->rl_peer_irk, rpa);
+                OS_ENTER_CRITICAL(sr);
+                memcpy(rl->rl_peer_rpas[rl->rl_peer_rpa_cnt], rpa,
+                       BLE_DEV_ADDR_LEN);
+                ++rl->rl_peer_rpa_cnt;
+                OS_EXIT_CRITICAL(sr);
+            }
+        }
+        ++rl;
+    }
+#endif
+}
+
 /**
  * Generate a resolvable private address.
  *
@@ -524,6 +733,55 @@ ble_ll_resolv_rpa(uint8_t *rpa, uint8_t *irk)
     return rc;
 }
 
+/**
+ * Finds the resolving list entry a received peer RPA resolves to. The result
+ * of the hardware resolver (if any) is used when available. Otherwise, the
+ * RPA is looked up in the RPA cache and, if not present, resolved in software
+ * against each peer IRK and the result cached so the same RPA is not run
+ * through AES again until the cache is flushed.
+ *
+ * Called from interrupt context when a PDU has been received.
+ *
+ * @param rpa The peer RPA (little endian)
+ *
+ * @return int Index into the resolving list; -1 if the RPA did not resolve.
+ */
+int
+ble_ll_resolv_peer_rpa_index(uint8_t *rpa)
+{
+    int i;
+    int index;
+    struct ble_ll_resolv_entry *rl;
+
+    index = ble_hw_resolv_list_match();
+    if (index != BLE_HW_RESOLV_NOT_DONE) {
+        return (index >= 0) ? index : -1;
+    }
+
+#if (NIMBLE_OPT_LL_RESOLV_CACHE_SIZE > 0)
+    if (ble_ll_resolv_cache_find(rpa, &index)) {
+        return index;
+    }
+#endif
+
+    index = -1;
+    rl = &g_ble_ll_resolv_list[0];
+    for (i = 0; i < g_ble_ll_resolv_data.rl_cnt; ++i) {
+        if (ble_ll_resolv_irk_nonzero(rl->rl_peer_irk) &&
+            ble_ll_resolv_rpa(rpa, rl->rl_peer_irk)) {
+            index = i;
+            break;
+        }
+        ++rl;
+    }
+
+#if (NIMBLE_OPT_LL_RESOLV_CACHE_SIZE > 0)
+    ble_ll_resolv_cache_add(rpa, index);
+#endif
+
+    return index;
+}
+
 /**
  * Returns whether or not address resolution is enabled.
  *
@@ -543,6 +801,9 @@ ble_ll_resolv_list_reset(void)
 {
     g_ble_ll_resolv_data.addr_res_enabled = 0;
     os_callout_stop(&g_ble_ll_resolv_data.rpa_timer.cf_c);
+#if (NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE > 0)
+    os_eventq_remove(&g_ble_ll_data.ll_evq, &g_ble_ll_resolv_pool_ev);
+#endif
     ble_ll_resolv_list_clr();
     ble_ll_resolv_init();
 }
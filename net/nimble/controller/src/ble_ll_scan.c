@@ -49,14 +49,6 @@
  * receive a scan response from? Implement this.
  */
 
-/* Dont allow more than 255 of these entries */
-#if NIMBLE_OPT_LL_NUM_SCAN_DUP_ADVS > 255
-    #error "Cannot have more than 255 duplicate entries!"
-#endif
-#if NIMBLE_OPT_LL_NUM_SCAN_RSP_ADVS > 255
-    #error "Cannot have more than 255 scan response entries!"
-#endif
-
 /* The scanning state machine global object */
 struct ble_ll_scan_sm g_ble_ll_scan_sm;
 
@@ -75,16 +67,66 @@ struct ble_ll_scan_advertisers
 #define BLE_LL_SC_ADV_F_SCAN_RSP_RXD    (0x02)
 #define BLE_LL_SC_ADV_F_DIRECT_RPT_SENT (0x04)
 #define BLE_LL_SC_ADV_F_ADV_RPT_SENT    (0x08)
+#define BLE_LL_SC_ADV_F_IN_USE          (0x10)
+
+/*
+ * The advertiser lists are set-associative hash tables. An advertiser hashes
+ * to one set of BLE_LL_SCAN_ADV_WAYS entries, which are kept in most recently
+ * used order; when a set is full the least recently used advertiser in it is
+ * forgotten. Lookups and inserts are thus constant time regardless of the
+ * table size, and a full table keeps filtering recently heard advertisers
+ * instead of letting new ones through.
+ */
+#define BLE_LL_SCAN_ADV_WAYS            (4)
+#define BLE_LL_SCAN_ADV_SETS(n)         \
+    (((n) + BLE_LL_SCAN_ADV_WAYS - 1) / BLE_LL_SCAN_ADV_WAYS)
+
+#define BLE_LL_SCAN_RSP_ADV_SETS    \
+    BLE_LL_SCAN_ADV_SETS(NIMBLE_OPT_LL_NUM_SCAN_RSP_ADVS)
+#define BLE_LL_SCAN_DUP_ADV_SETS    \
+    BLE_LL_SCAN_ADV_SETS(NIMBLE_OPT_LL_NUM_SCAN_DUP_ADVS)
 
 /* Contains list of advertisers that we have heard scan responses from */
-static uint8_t g_ble_ll_scan_num_rsp_advs;
 struct ble_ll_scan_advertisers
-g_ble_ll_scan_rsp_advs[NIMBLE_OPT_LL_NUM_SCAN_RSP_ADVS];
+g_ble_ll_scan_rsp_advs[BLE_LL_SCAN_RSP_ADV_SETS][BLE_LL_SCAN_ADV_WAYS];
 
 /* Used to filter duplicate advertising events to host */
-static uint8_t g_ble_ll_scan_num_dup_advs;
 struct ble_ll_scan_advertisers
-g_ble_ll_scan_dup_advs[NIMBLE_OPT_LL_NUM_SCAN_DUP_ADVS];
+g_ble_ll_scan_dup_advs[BLE_LL_SCAN_DUP_ADV_SETS][BLE_LL_SCAN_ADV_WAYS];
+
+#if (NIMBLE_OPT_LL_ADV_RPT_BATCH_MS > 0)
+/*
+ * Advertising reports waiting to be sent to the host in one LE Advertising
+ * Report event. A report without data takes 10 bytes of event parameters;
+ * that bounds the number of reports that can share an event.
+ */
+struct ble_ll_scan_rpt
+{
+    uint8_t evtype;
+    uint8_t addr_type;
+    uint8_t addr[BLE_DEV_ADDR_LEN];
+    uint8_t data_len;
+    int8_t rssi;
+    uint8_t data[BLE_ADV_DATA_MAX_LEN];
+};
+
+#define BLE_LL_SCAN_RPT_HDR_LEN     (2)
+#define BLE_LL_SCAN_RPT_MIN_LEN     (BLE_HCI_LE_ADV_RPT_MIN_LEN - \
+                                     BLE_LL_SCAN_RPT_HDR_LEN)
+#define BLE_LL_SCAN_RPT_MAX         \
+    ((NIMBLE_OPT_LL_ADV_RPT_BATCH_LEN - BLE_LL_SCAN_RPT_HDR_LEN) / \
+     BLE_LL_SCAN_RPT_MIN_LEN)
+
+#if (NIMBLE_OPT_LL_ADV_RPT_BATCH_LEN < BLE_HCI_LE_ADV_RPT_MIN_LEN + \
+     BLE_ADV_DATA_MAX_LEN) || (NIMBLE_OPT_LL_ADV_RPT_BATCH_LEN > 255)
+    #error "Advertising report batch length must be between 43 and 255!"
+#endif
+
+static struct ble_ll_scan_rpt g_ble_ll_scan_rpts[BLE_LL_SCAN_RPT_MAX];
+static uint8_t g_ble_ll_scan_num_rpts;
+static uint8_t g_ble_ll_scan_rpts_len;
+static struct os_callout_func g_ble_ll_scan_rpt_timer;
+#endif
 
 /* See Vol 6 Part B Section 4.4.3.2. Active scanning backoff */
 static void
@@ -190,46 +232,116 @@ ble_ll_scan_req_pdu_make(struct ble_ll_scan_sm *scansm, uint8_t *adv_addr,
 }
 
 /**
- * Checks to see if an advertiser is on the duplicate address list.
+ * Returns the set of an advertiser table that the given advertiser hashes to.
  *
+ * @param table Pointer to first set of table
+ * @param num_sets Number of sets in table
  * @param addr Pointer to address
  * @param txadd TxAdd bit. 0: public; random otherwise
  *
- * @return uint8_t 0: not on list; any other value is
+ * @return struct ble_ll_scan_advertisers* Pointer to first entry of set
  */
 static struct ble_ll_scan_advertisers *
-ble_ll_scan_find_dup_adv(uint8_t *addr, uint8_t txadd)
+ble_ll_scan_adv_set(struct ble_ll_scan_advertisers *table, uint16_t num_sets,
+                    uint8_t *addr, uint8_t txadd)
 {
-    uint8_t num_advs;
-    struct ble_ll_scan_advertisers *adv;
+    int i;
+    uint32_t hash;
 
-    /* Do we have an address match? Must match address type */
-    adv = &g_ble_ll_scan_dup_advs[0];
-    num_advs = g_ble_ll_scan_num_dup_advs;
-    while (num_advs) {
-        if (!memcmp(&adv->adv_addr, addr, BLE_DEV_ADDR_LEN)) {
-            /* Address type must match */
-            if (txadd) {
-                if ((adv->sc_adv_flags & BLE_LL_SC_ADV_F_RANDOM_ADDR) == 0) {
-                    goto next_dup_adv;
-                }
-            } else {
-                if (adv->sc_adv_flags & BLE_LL_SC_ADV_F_RANDOM_ADDR) {
-                    goto next_dup_adv;
-                }
-            }
+    hash = txadd ? 1 : 0;
+    for (i = 0; i < BLE_DEV_ADDR_LEN; ++i) {
+        hash = (hash * 31) + addr[i];
+    }
+
+    return table + ((hash % num_sets) * BLE_LL_SCAN_ADV_WAYS);
+}
 
-            return adv;
+/**
+ * Looks up an advertiser in a set. If found, the advertiser is moved to the
+ * front of the set (most recently used).
+ *
+ * @param set Pointer to first entry of set
+ * @param addr Pointer to address
+ * @param txadd TxAdd bit. 0: public; random otherwise
+ *
+ * @return struct ble_ll_scan_advertisers* NULL if not found; pointer to
+ *         entry otherwise.
+ */
+static struct ble_ll_scan_advertisers *
+ble_ll_scan_adv_lookup(struct ble_ll_scan_advertisers *set, uint8_t *addr,
+                       uint8_t txadd)
+{
+    int i;
+    uint16_t rand_flag;
+    struct ble_ll_scan_advertisers adv;
+
+    rand_flag = txadd ? BLE_LL_SC_ADV_F_RANDOM_ADDR : 0;
+    for (i = 0; i < BLE_LL_SCAN_ADV_WAYS; ++i) {
+        /* Used entries are always at the front of the set */
+        if ((set[i].sc_adv_flags & BLE_LL_SC_ADV_F_IN_USE) == 0) {
+            break;
         }
 
-next_dup_adv:
-        ++adv;
-        --num_advs;
+        /* Address and address type must match */
+        if (((set[i].sc_adv_flags & BLE_LL_SC_ADV_F_RANDOM_ADDR) ==
+             rand_flag) &&
+            !memcmp(&set[i].adv_addr, addr, BLE_DEV_ADDR_LEN)) {
+            if (i != 0) {
+                adv = set[i];
+                memmove(&set[1], &set[0], i * sizeof(set[0]));
+                set[0] = adv;
+            }
+            return &set[0];
+        }
     }
 
     return NULL;
 }
 
+/**
+ * Adds an advertiser to the front of a set, forgetting the least recently
+ * used advertiser if the set is full. The advertiser must not already be in
+ * the set.
+ *
+ * @param set Pointer to first entry of set
+ * @param addr Pointer to address
+ * @param txadd TxAdd bit. 0: public; random otherwise
+ *
+ * @return struct ble_ll_scan_advertisers* Pointer to new entry
+ */
+static struct ble_ll_scan_advertisers *
+ble_ll_scan_adv_insert(struct ble_ll_scan_advertisers *set, uint8_t *addr,
+                       uint8_t txadd)
+{
+    memmove(&set[1], &set[0], (BLE_LL_SCAN_ADV_WAYS - 1) * sizeof(set[0]));
+    memcpy(&set[0].adv_addr, addr, BLE_DEV_ADDR_LEN);
+    set[0].sc_adv_flags = BLE_LL_SC_ADV_F_IN_USE;
+    if (txadd) {
+        set[0].sc_adv_flags |= BLE_LL_SC_ADV_F_RANDOM_ADDR;
+    }
+
+    return &set[0];
+}
+
+/**
+ * Checks to see if an advertiser is on the duplicate address list.
+ *
+ * @param addr Pointer to address
+ * @param txadd TxAdd bit. 0: public; random otherwise
+ *
+ * @return struct ble_ll_scan_advertisers* NULL if not on list; pointer to
+ *         entry otherwise.
+ */
+static struct ble_ll_scan_advertisers *
+ble_ll_scan_find_dup_adv(uint8_t *addr, uint8_t txadd)
+{
+    struct ble_ll_scan_advertisers *set;
+
+    set = ble_ll_scan_adv_set(&g_ble_ll_scan_dup_advs[0][0],
+                              BLE_LL_SCAN_DUP_ADV_SETS, addr, txadd);
+    return ble_ll_scan_adv_lookup(set, addr, txadd);
+}
+
 /**
  * Check if a packet is a duplicate advertising packet.
  *
@@ -272,27 +384,15 @@ ble_ll_scan_is_dup_adv(uint8_t pdu_type, uint8_t txadd, uint8_t *addr)
 void
 ble_ll_scan_add_dup_adv(uint8_t *addr, uint8_t txadd, uint8_t subev)
 {
-    uint8_t num_advs;
+    struct ble_ll_scan_advertisers *set;
     struct ble_ll_scan_advertisers *adv;
 
-    /* Check to see if on list. */
-    adv = ble_ll_scan_find_dup_adv(addr, txadd);
+    /* Check to see if on list; add it (evicting the oldest) if not */
+    set = ble_ll_scan_adv_set(&g_ble_ll_scan_dup_advs[0][0],
+                              BLE_LL_SCAN_DUP_ADV_SETS, addr, txadd);
+    adv = ble_ll_scan_adv_lookup(set, addr, txadd);
     if (!adv) {
-        /* XXX: for now, if we dont have room, just leave */
-        num_advs = g_ble_ll_scan_num_dup_advs;
-        if (num_advs == NIMBLE_OPT_LL_NUM_SCAN_DUP_ADVS) {
-            return;
-        }
-
-        /* Add the advertiser to the array */
-        adv = &g_ble_ll_scan_dup_advs[num_advs];
-        memcpy(&adv->adv_addr, addr, BLE_DEV_ADDR_LEN);
-        ++g_ble_ll_scan_num_dup_advs;
-
-        adv->sc_adv_flags = 0;
-        if (txadd) {
-            adv->sc_adv_flags |= BLE_LL_SC_ADV_F_RANDOM_ADDR;
-        }
+        adv = ble_ll_scan_adv_insert(set, addr, txadd);
     }
 
     if (subev == BLE_HCI_LE_SUBEV_DIRECT_ADV_RPT) {
@@ -313,66 +413,164 @@ ble_ll_scan_add_dup_adv(uint8_t *addr, uint8_t txadd, uint8_t subev)
 static int
 ble_ll_scan_have_rxd_scan_rsp(uint8_t *addr, uint8_t txadd)
 {
-    uint8_t num_advs;
+    struct ble_ll_scan_advertisers *set;
+
+    set = ble_ll_scan_adv_set(&g_ble_ll_scan_rsp_advs[0][0],
+                              BLE_LL_SCAN_RSP_ADV_SETS, addr, txadd);
+    return ble_ll_scan_adv_lookup(set, addr, txadd) != NULL;
+}
+
+static void
+ble_ll_scan_add_scan_rsp_adv(uint8_t *addr, uint8_t txadd)
+{
+    struct ble_ll_scan_advertisers *set;
     struct ble_ll_scan_advertisers *adv;
 
-    /* Do we have an address match? Must match address type */
-    adv = &g_ble_ll_scan_rsp_advs[0];
-    num_advs = g_ble_ll_scan_num_rsp_advs;
-    while (num_advs) {
-        if (!memcmp(&adv->adv_addr, addr, BLE_DEV_ADDR_LEN)) {
-            /* Address type must match */
-            if (txadd) {
-                if (adv->sc_adv_flags & BLE_LL_SC_ADV_F_RANDOM_ADDR) {
-                    return 1;
-                }
-            } else {
-                if ((adv->sc_adv_flags & BLE_LL_SC_ADV_F_RANDOM_ADDR) == 0) {
-                    return 1;
-                }
-            }
-        }
-        ++adv;
-        --num_advs;
+    /* Check if address is already on the list */
+    set = ble_ll_scan_adv_set(&g_ble_ll_scan_rsp_advs[0][0],
+                              BLE_LL_SCAN_RSP_ADV_SETS, addr, txadd);
+    if (ble_ll_scan_adv_lookup(set, addr, txadd)) {
+        return;
     }
 
-    return 0;
+    /* Add the advertiser, forgetting the oldest one in its set if full */
+    adv = ble_ll_scan_adv_insert(set, addr, txadd);
+    adv->sc_adv_flags |= BLE_LL_SC_ADV_F_SCAN_RSP_RXD;
 }
 
+#if (NIMBLE_OPT_LL_ADV_RPT_BATCH_MS > 0)
+/**
+ * Sends all pending advertising reports to the host in one LE Advertising
+ * Report event. The report fields are laid out as arrays, one entry per
+ * report, as required by the specification.
+ *
+ * Context: Link Layer task.
+ */
 static void
-ble_ll_scan_add_scan_rsp_adv(uint8_t *addr, uint8_t txadd)
+ble_ll_scan_rpt_flush(void)
 {
-    uint8_t num_advs;
-    struct ble_ll_scan_advertisers *adv;
+    int i;
+    uint8_t num_rpts;
+    uint8_t *evbuf;
+    uint8_t *dptr;
+    struct ble_ll_scan_rpt *rpt;
 
-    /* XXX: for now, if we dont have room, just leave */
-    num_advs = g_ble_ll_scan_num_rsp_advs;
-    if (num_advs == NIMBLE_OPT_LL_NUM_SCAN_RSP_ADVS) {
+    os_callout_stop(&g_ble_ll_scan_rpt_timer.cf_c);
+
+    num_rpts = g_ble_ll_scan_num_rpts;
+    if (num_rpts == 0) {
         return;
     }
+    g_ble_ll_scan_num_rpts = 0;
 
-    /* Check if address is already on the list */
-    if (ble_ll_scan_have_rxd_scan_rsp(addr, txadd)) {
+    evbuf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
+    if (!evbuf) {
         return;
     }
 
-    /* Add the advertiser to the array */
-    adv = &g_ble_ll_scan_rsp_advs[num_advs];
-    memcpy(&adv->adv_addr, addr, BLE_DEV_ADDR_LEN);
-    adv->sc_adv_flags = BLE_LL_SC_ADV_F_SCAN_RSP_RXD;
-    if (txadd) {
-        adv->sc_adv_flags |= BLE_LL_SC_ADV_F_RANDOM_ADDR;
+    evbuf[0] = BLE_HCI_EVCODE_LE_META;
+    evbuf[1] = g_ble_ll_scan_rpts_len;
+    evbuf[2] = BLE_HCI_LE_SUBEV_ADV_RPT;
+    evbuf[3] = num_rpts;
+
+    dptr = evbuf + 4;
+    for (i = 0; i < num_rpts; ++i) {
+        dptr[i] = g_ble_ll_scan_rpts[i].evtype;
+    }
+    dptr += num_rpts;
+    for (i = 0; i < num_rpts; ++i) {
+        dptr[i] = g_ble_ll_scan_rpts[i].addr_type;
+    }
+    dptr += num_rpts;
+    for (i = 0; i < num_rpts; ++i) {
+        memcpy(dptr, g_ble_ll_scan_rpts[i].addr, BLE_DEV_ADDR_LEN);
+        dptr += BLE_DEV_ADDR_LEN;
+    }
+    for (i = 0; i < num_rpts; ++i) {
+        dptr[i] = g_ble_ll_scan_rpts[i].data_len;
+    }
+    dptr += num_rpts;
+    for (i = 0; i < num_rpts; ++i) {
+        rpt = &g_ble_ll_scan_rpts[i];
+        memcpy(dptr, rpt->data, rpt->data_len);
+        dptr += rpt->data_len;
+    }
+    for (i = 0; i < num_rpts; ++i) {
+        dptr[i] = g_ble_ll_scan_rpts[i].rssi;
     }
-    ++g_ble_ll_scan_num_rsp_advs;
 
-    return;
+    ble_ll_hci_event_send(evbuf);
+}
+
+/**
+ * Called when the advertising report latency window expires.
+ *
+ * Context: Link Layer task.
+ *
+ * @param arg
+ */
+static void
+ble_ll_scan_rpt_timer_cb(void *arg)
+{
+    ble_ll_scan_rpt_flush();
 }
 
+/**
+ * Queues an advertising report for the next batched LE Advertising Report
+ * event. The batch is sent when the latency window expires or when the next
+ * report could not fit in it.
+ *
+ * Context: Link Layer task.
+ */
+static void
+ble_ll_scan_rpt_add(uint8_t evtype, uint8_t addr_type, uint8_t *addr,
+                    uint8_t *data, uint8_t data_len, int8_t rssi)
+{
+    uint32_t ticks;
+    struct ble_ll_scan_rpt *rpt;
+
+    /* Make room if this report does not fit */
+    if ((g_ble_ll_scan_num_rpts == BLE_LL_SCAN_RPT_MAX) ||
+        ((g_ble_ll_scan_rpts_len + BLE_LL_SCAN_RPT_MIN_LEN + data_len) >
+         NIMBLE_OPT_LL_ADV_RPT_BATCH_LEN)) {
+        ble_ll_scan_rpt_flush();
+    }
+
+    if (g_ble_ll_scan_num_rpts == 0) {
+        g_ble_ll_scan_rpts_len = BLE_LL_SCAN_RPT_HDR_LEN;
+        ticks = (NIMBLE_OPT_LL_ADV_RPT_BATCH_MS * OS_TICKS_PER_SEC) / 1000;
+        if (ticks == 0) {
+            ticks = 1;
+        }
+        os_callout_reset(&g_ble_ll_scan_rpt_timer.cf_c, ticks);
+    }
+
+    rpt = &g_ble_ll_scan_rpts[g_ble_ll_scan_num_rpts];
+    rpt->evtype = evtype;
+    rpt->addr_type = addr_type;
+    memcpy(rpt->addr, addr, BLE_DEV_ADDR_LEN);
+    rpt->data_len = data_len;
+    memcpy(rpt->data, data, data_len);
+    rpt->rssi = rssi;
+
+    ++g_ble_ll_scan_num_rpts;
+    g_ble_ll_scan_rpts_len += BLE_LL_SCAN_RPT_MIN_LEN + data_len;
+
+    /* Send now if even the smallest report would not fit */
+    if ((g_ble_ll_scan_num_rpts == BLE_LL_SCAN_RPT_MAX) ||
+        ((g_ble_ll_scan_rpts_len + BLE_LL_SCAN_RPT_MIN_LEN) >
+         NIMBLE_OPT_LL_ADV_RPT_BATCH_LEN)) {
+        ble_ll_scan_rpt_flush();
+    }
+}
+#endif
+
 /**
  * Send an advertising report to the host.
  *
- * NOTE: while we are allowed to send multiple devices in one report, we
- * will just send for one for now.
+ * If NIMBLE_OPT_LL_ADV_RPT_BATCH_MS is non-zero, (undirected) reports are
+ * held for up to that long and packed into one event with other reports;
+ * otherwise each report is sent in its own event.
  *
  * @param pdu_type
  * @param txadd
@@ -427,6 +625,41 @@ ble_ll_hci_send_adv_report(uint8_t pdu_type, uint8_t txadd, uint8_t *rxbuf,
     }
 
     if (ble_ll_hci_is_le_event_enabled(subev)) {
+#if (NIMBLE_OPT_LL_ADV_RPT_BATCH_MS > 0)
+        if (subev == BLE_HCI_LE_SUBEV_ADV_RPT) {
+            if (txadd) {
+                addr_type = BLE_HCI_ADV_OWN_ADDR_RANDOM;
+            } else {
+                addr_type = BLE_HCI_ADV_OWN_ADDR_PUBLIC;
+            }
+
+            rxbuf += BLE_LL_PDU_HDR_LEN;
+            adv_addr = rxbuf;
+#if (BLE_LL_CFG_FEAT_LL_PRIVACY == 1)
+            if (BLE_MBUF_HDR_RESOLVED(hdr)) {
+                index = scansm->scan_rpa_index;
+                adv_addr = g_ble_ll_resolv_list[index].rl_identity_addr;
+                addr_type = g_ble_ll_resolv_list[index].rl_addr_type + 2;
+            }
+#endif
+            ble_ll_scan_rpt_add(evtype, addr_type, adv_addr,
+                                rxbuf + BLE_DEV_ADDR_LEN, adv_data_len,
+                                hdr->rxinfo.rssi);
+
+            /*
+             * Filter duplicates from now on; later copies of this report
+             * must not be batched behind it.
+             */
+            if (g_ble_ll_scan_sm.scan_filt_dups) {
+                ble_ll_scan_add_dup_adv(adv_addr, txadd, subev);
+            }
+            return;
+        }
+
+        /* Keep reports in order */
+        ble_ll_scan_rpt_flush();
+#endif
+
         evbuf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
         if (evbuf) {
             evbuf[0] = BLE_HCI_EVCODE_LE_META;
@@ -723,8 +956,8 @@ ble_ll_scan_sm_start(struct ble_ll_scan_sm *scansm)
     scansm->scan_rsp_pending = 0;
 
     /* Forget filtered advertisers from previous scan. */
-    g_ble_ll_scan_num_rsp_advs = 0;
-    g_ble_ll_scan_num_dup_advs = 0;
+    memset(g_ble_ll_scan_rsp_advs, 0, sizeof(g_ble_ll_scan_rsp_advs));
+    memset(g_ble_ll_scan_dup_advs, 0, sizeof(g_ble_ll_scan_dup_advs));
 
     /* XXX: align to current or next slot???. */
     /* Schedule start time now */
@@ -747,6 +980,7 @@ void
 ble_ll_scan_event_proc(void *arg)
 {
     os_sr_t sr;
+    int rc;
     int rxstate;
     int start_scan;
     uint8_t chan;
@@ -826,7 +1060,8 @@ ble_ll_scan_event_proc(void *arg)
     }
     OS_EXIT_CRITICAL(sr);
 
-    cputime_timer_start(&scansm->scan_timer, next_event_time);
+    rc = cputime_timer_start(&scansm->scan_timer, next_event_time);
+    assert(rc == 0);
 }
 
 /**
@@ -978,7 +1213,7 @@ ble_ll_scan_rx_isr_end(struct os_mbuf *rxpdu, uint8_t crcok)
     index = -1;
 #if (BLE_LL_CFG_FEAT_LL_PRIVACY == 1)
     if (ble_ll_is_rpa(peer, peer_addr_type) && ble_ll_resolv_enabled()) {
-        index = ble_hw_resolv_list_match();
+        index = ble_ll_resolv_peer_rpa_index(peer);
         if (index >= 0) {
             ble_hdr->rxinfo.flags |= BLE_MBUF_HDR_F_RESOLVED;
             peer = g_ble_ll_resolv_list[index].rl_identity_addr;
@@ -1446,11 +1681,14 @@ ble_ll_scan_reset(void)
     os_mbuf_free_chain(scansm->scan_req_pdu);
 
     /* Reset duplicate advertisers and those from which we rxd a response */
-    g_ble_ll_scan_num_rsp_advs = 0;
-    memset(&g_ble_ll_scan_rsp_advs[0], 0, sizeof(g_ble_ll_scan_rsp_advs));
+    memset(g_ble_ll_scan_rsp_advs, 0, sizeof(g_ble_ll_scan_rsp_advs));
+    memset(g_ble_ll_scan_dup_advs, 0, sizeof(g_ble_ll_scan_dup_advs));
 
-    g_ble_ll_scan_num_dup_advs = 0;
-    memset(&g_ble_ll_scan_dup_advs[0], 0, sizeof(g_ble_ll_scan_dup_advs));
+#if (NIMBLE_OPT_LL_ADV_RPT_BATCH_MS > 0)
+    /* Discard any reports not yet sent to the host */
+    os_callout_stop(&g_ble_ll_scan_rpt_timer.cf_c);
+    g_ble_ll_scan_num_rpts = 0;
+#endif
 
     /* Call the init function again */
     ble_ll_scan_init();
@@ -1486,4 +1724,10 @@ ble_ll_scan_init(void)
     scansm->scan_req_pdu = os_msys_get_pkthdr(BLE_MBUF_PAYLOAD_SIZE,
                                               sizeof(struct ble_mbuf_hdr));
     assert(scansm->scan_req_pdu != NULL);
+
+#if (NIMBLE_OPT_LL_ADV_RPT_BATCH_MS > 0)
+    /* Initialize advertising report latency timer */
+    os_callout_func_init(&g_ble_ll_scan_rpt_timer, &g_ble_ll_data.ll_evq,
+                         ble_ll_scan_rpt_timer_cb, NULL);
+#endif
 }
@@ -26,6 +26,7 @@
 #include "controller/ble_ll_sched.h"
 #include "controller/ble_ll_adv.h"
 #include "controller/ble_ll_scan.h"
+#include "controller/ble_ll_prof.h"
 #include "ble_ll_conn_priv.h"
 #include "hal/hal_cputime.h"
 
@@ -51,6 +52,19 @@ int32_t g_ble_ll_sched_max_late;
 /* Queue for timers */
 TAILQ_HEAD(ll_sched_qhead, ble_ll_sched_item) g_ble_ll_sched_q;
 
+/*
+ * Start the scheduler timer. The shared timer heap is sized for the
+ * controller (see BLE_LL_CPUTIME_TIMERS), so this cannot fail.
+ */
+static void
+ble_ll_sched_timer_start(uint32_t cputime)
+{
+    int rc;
+
+    rc = cputime_timer_start(&g_ble_ll_sched_timer, cputime);
+    assert(rc == 0);
+}
+
 /**
  * Checks if two events in the schedule will overlap in time. NOTE: consecutive
  * schedule items can end and start at the same time.
@@ -122,6 +136,42 @@ ble_ll_sched_conn_overlap(struct ble_ll_sched_item *entry)
     return rc;
 }
 
+/**
+ * Finds the first schedule item that ends after the given time. Items in the
+ * schedule never overlap, so they are ordered by end time as well as start
+ * time; every item before the returned one ends at or before 'start_time'
+ * and can neither overlap nor follow an item starting then. Callers looking
+ * for a place to insert can begin their walk at the returned item.
+ *
+ * The search runs from the tail since new items (the next event of a
+ * connection or advertiser) are nearly always placed near the end of the
+ * schedule, which keeps rescheduling cheap as the number of connections
+ * grows.
+ *
+ * Context: Must be called with interrupts disabled.
+ *
+ * @param start_time
+ *
+ * @return struct ble_ll_sched_item* First item ending after start_time, or
+ *         NULL if there is no such item.
+ */
+static struct ble_ll_sched_item *
+ble_ll_sched_first_after(uint32_t start_time)
+{
+    struct ble_ll_sched_item *entry;
+    struct ble_ll_sched_item *first;
+
+    first = NULL;
+    TAILQ_FOREACH_REVERSE(entry, &g_ble_ll_sched_q, ll_sched_qhead, link) {
+        if ((int32_t)(entry->end_time - start_time) <= 0) {
+            break;
+        }
+        first = entry;
+    }
+
+    return first;
+}
+
 struct ble_ll_sched_item *
 ble_ll_sched_insert_if_empty(struct ble_ll_sched_item *sch)
 {
@@ -131,6 +181,7 @@ ble_ll_sched_insert_if_empty(struct ble_ll_sched_item *sch)
     if (!entry) {
         TAILQ_INSERT_HEAD(&g_ble_ll_sched_q, sch, link);
         sch->enqueued = 1;
+        ble_ll_prof_sched(sch);
     }
     return entry;
 }
@@ -179,7 +230,9 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
     start_overlap = NULL;
     end_overlap = NULL;
     rc = 0;
-    TAILQ_FOREACH(entry, &g_ble_ll_sched_q, link) {
+    for (entry = ble_ll_sched_first_after(sch->start_time);
+         entry != NULL;
+         entry = TAILQ_NEXT(entry, link)) {
         if (ble_ll_sched_is_overlap(sch, entry)) {
             /* Only insert if this element is older than all that we overlap */
             if ((entry->sched_type == BLE_LL_SCHED_TYPE_ADV) ||
@@ -209,6 +262,7 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
             TAILQ_INSERT_TAIL(&g_ble_ll_sched_q, sch, link);
         }
         sch->enqueued = 1;
+        ble_ll_prof_sched(sch);
     }
 
     /* Remove first to last scheduled elements */
@@ -235,7 +289,117 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
     OS_EXIT_CRITICAL(sr);
 
     /* Restart timer */
-    cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
+    ble_ll_sched_timer_start(sch->start_time);
+
+    return rc;
+}
+
+/**
+ * Returns the time of the first occurrence of a scheduled event that ends
+ * after 'start_time'. Connection events repeat every connection interval, so
+ * for a connection the queued event is projected forward; other items are
+ * returned as is.
+ *
+ * @param sch
+ * @param start_time
+ * @param out_start Start time of the occurrence
+ * @param out_end End time of the occurrence
+ */
+static void
+ble_ll_sched_next_occurrence(struct ble_ll_sched_item *sch,
+                             uint32_t start_time, uint32_t *out_start,
+                             uint32_t *out_end)
+{
+    uint32_t itvl_t;
+    struct ble_ll_conn_sm *connsm;
+
+    *out_start = sch->start_time;
+    *out_end = sch->end_time;
+
+    if (sch->sched_type == BLE_LL_SCHED_TYPE_CONN) {
+        connsm = (struct ble_ll_conn_sm *)sch->cb_arg;
+        itvl_t = cputime_usecs_to_ticks(connsm->conn_itvl *
+                                        BLE_LL_CONN_ITVL_USECS);
+        while ((int32_t)(*out_end - start_time) <= 0) {
+            *out_start += itvl_t;
+            *out_end += itvl_t;
+        }
+    }
+}
+
+/**
+ * Plans the first connection event of a new master connection so that it
+ * directly follows the connection events of an existing master connection
+ * with the same interval. Connections sharing an interval keep their
+ * relative offsets forever, so packing their events back to back keeps them
+ * from ever colliding and leaves the rest of the interval in one contiguous
+ * free block for further links. Holes left by connections that have gone
+ * away are refilled first since the earliest candidate wins.
+ *
+ * Context: Must be called with interrupts disabled.
+ *
+ * @param connsm The new master connection
+ * @param earliest_start Earliest allowed start of the first event
+ * @param dur Duration of a connection event
+ * @param itvl_t Connection interval, in cputime ticks
+ * @param out_start Planned start of the first event
+ *
+ * @return int 0: a packed start was found; -1 otherwise.
+ */
+static int
+ble_ll_sched_master_plan(struct ble_ll_conn_sm *connsm,
+                         uint32_t earliest_start, uint32_t dur,
+                         uint32_t itvl_t, uint32_t *out_start)
+{
+    int rc;
+    uint32_t cand_start;
+    uint32_t cand_end;
+    uint32_t occ_start;
+    uint32_t occ_end;
+    struct ble_ll_sched_item *entry;
+    struct ble_ll_sched_item *other;
+    struct ble_ll_conn_sm *tmp;
+
+    rc = -1;
+    TAILQ_FOREACH(entry, &g_ble_ll_sched_q, link) {
+        if (entry->sched_type != BLE_LL_SCHED_TYPE_CONN) {
+            continue;
+        }
+        tmp = (struct ble_ll_conn_sm *)entry->cb_arg;
+        if ((tmp == connsm) || !CONN_IS_MASTER(tmp) ||
+            (tmp->conn_itvl != connsm->conn_itvl)) {
+            continue;
+        }
+
+        /* Candidate: right after this connection's next event */
+        cand_start = entry->end_time;
+        while ((int32_t)(cand_start - earliest_start) < 0) {
+            cand_start += itvl_t;
+        }
+        if ((cand_start - earliest_start) > itvl_t) {
+            continue;
+        }
+        if (!rc && ((int32_t)(cand_start - *out_start) >= 0)) {
+            continue;
+        }
+        cand_end = cand_start + dur;
+
+        /* Candidate must not collide with anything else in the schedule */
+        TAILQ_FOREACH(other, &g_ble_ll_sched_q, link) {
+            ble_ll_sched_next_occurrence(other, cand_start, &occ_start,
+                                         &occ_end);
+            if (((int32_t)(occ_end - cand_start) > 0) &&
+                ((int32_t)(cand_end - occ_start) > 0)) {
+                break;
+            }
+        }
+        if (other) {
+            continue;
+        }
+
+        *out_start = cand_start;
+        rc = 0;
+    }
 
     return rc;
 }
@@ -309,7 +473,16 @@ ble_ll_sched_master_new(struct ble_ll_conn_sm *connsm, uint32_t adv_rxend,
         connsm->tx_win_off = 0;
     } else {
         cputime_timer_stop(&g_ble_ll_sched_timer);
-        TAILQ_FOREACH(entry, &g_ble_ll_sched_q, link) {
+
+        /* Prefer packing behind an existing master; else take first fit */
+        if (!ble_ll_sched_master_plan(connsm, initial_start, dur, itvl_t,
+                                      &earliest_start)) {
+            earliest_end = earliest_start + dur;
+        }
+
+        for (entry = ble_ll_sched_first_after(earliest_start);
+             entry != NULL;
+             entry = TAILQ_NEXT(entry, link)) {
             /* Set these because overlap function needs them to be set */
             sch->start_time = earliest_start;
             sch->end_time = earliest_end;
@@ -341,6 +514,7 @@ ble_ll_sched_master_new(struct ble_ll_conn_sm *connsm, uint32_t adv_rxend,
         if (!rc) {
             /* calculate number of connection intervals before start */
             sch->enqueued = 1;
+            ble_ll_prof_sched(sch);
             connsm->tx_win_off = (earliest_start - initial_start) /
                 cputime_usecs_to_ticks(BLE_LL_CONN_ITVL_USECS);
         }
@@ -359,7 +533,7 @@ ble_ll_sched_master_new(struct ble_ll_conn_sm *connsm, uint32_t adv_rxend,
 
     OS_EXIT_CRITICAL(sr);
 
-    cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
+    ble_ll_sched_timer_start(sch->start_time);
 
     return rc;
 }
@@ -398,7 +572,15 @@ ble_ll_sched_slave_new(struct ble_ll_conn_sm *connsm)
         rc = 0;
     } else {
         cputime_timer_stop(&g_ble_ll_sched_timer);
+        entry = ble_ll_sched_first_after(sch->start_time);
         while (1) {
+            /* Insert at tail if none left to check */
+            if (!entry) {
+                rc = 0;
+                TAILQ_INSERT_TAIL(&g_ble_ll_sched_q, sch, link);
+                break;
+            }
+
             next_sch = entry->link.tqe_next;
             /* Insert if event ends before next starts */
             if ((int32_t)(sch->end_time - entry->start_time) < 0) {
@@ -416,24 +598,18 @@ ble_ll_sched_slave_new(struct ble_ll_conn_sm *connsm)
 
             /* Move to next entry */
             entry = next_sch;
-
-            /* Insert at tail if none left to check */
-            if (!entry) {
-                rc = 0;
-                TAILQ_INSERT_TAIL(&g_ble_ll_sched_q, sch, link);
-                break;
-            }
         }
 
         if (!rc) {
             sch->enqueued = 1;
+            ble_ll_prof_sched(sch);
         }
         sch = TAILQ_FIRST(&g_ble_ll_sched_q);
     }
 
     OS_EXIT_CRITICAL(sr);
 
-    cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
+    ble_ll_sched_timer_start(sch->start_time);
 
     return rc;
 }
@@ -474,7 +650,9 @@ ble_ll_sched_adv_new(struct ble_ll_sched_item *sch)
         adv_start = sch->start_time;
     } else {
         cputime_timer_stop(&g_ble_ll_sched_timer);
-        TAILQ_FOREACH(entry, &g_ble_ll_sched_q, link) {
+        for (entry = ble_ll_sched_first_after(sch->start_time);
+             entry != NULL;
+             entry = TAILQ_NEXT(entry, link)) {
             /* We can insert if before entry in list */
             if ((int32_t)(sch->end_time - entry->start_time) < 0) {
                 rc = 0;
@@ -498,6 +676,7 @@ ble_ll_sched_adv_new(struct ble_ll_sched_item *sch)
 
         if (!rc) {
             sch->enqueued = 1;
+            ble_ll_prof_sched(sch);
         }
 
         /* Restart with head of list */
@@ -514,7 +693,7 @@ ble_ll_sched_adv_new(struct ble_ll_sched_item *sch)
      * that we actually go back to scanning. I need to make sure
        we re-enable the receive. Put an event in the log! */
 
-    cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
+    ble_ll_sched_timer_start(sch->start_time);
 
     return rc;
 }
@@ -539,7 +718,15 @@ ble_ll_sched_adv_reschedule(struct ble_ll_sched_item *sch)
     entry = ble_ll_sched_insert_if_empty(sch);
     if (entry) {
         cputime_timer_stop(&g_ble_ll_sched_timer);
+        entry = ble_ll_sched_first_after(sch->start_time);
         while (1) {
+            /* Insert at tail if none left to check */
+            if (!entry) {
+                rc = 0;
+                TAILQ_INSERT_TAIL(&g_ble_ll_sched_q, sch, link);
+                break;
+            }
+
             /* Insert before if adv event is before this event */
             next_sch = entry->link.tqe_next;
             if ((int32_t)(sch->end_time - entry->start_time) < 0) {
@@ -556,17 +743,11 @@ ble_ll_sched_adv_reschedule(struct ble_ll_sched_item *sch)
 
             /* Move to next entry */
             entry = next_sch;
-
-            /* Insert at tail if none left to check */
-            if (!entry) {
-                rc = 0;
-                TAILQ_INSERT_TAIL(&g_ble_ll_sched_q, sch, link);
-                break;
-            }
         }
 
         if (!rc) {
             sch->enqueued = 1;
+            ble_ll_prof_sched(sch);
         }
 
         sch = TAILQ_FIRST(&g_ble_ll_sched_q);
@@ -574,7 +755,7 @@ ble_ll_sched_adv_reschedule(struct ble_ll_sched_item *sch)
 
     OS_EXIT_CRITICAL(sr);
 
-    cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
+    ble_ll_sched_timer_start(sch->start_time);
 
     return rc;
 }
@@ -609,7 +790,7 @@ ble_ll_sched_rmv_elem(struct ble_ll_sched_item *sch)
         if (first == sch) {
             first = TAILQ_FIRST(&g_ble_ll_sched_q);
             if (first) {
-                cputime_timer_start(&g_ble_ll_sched_timer, first->start_time);
+                ble_ll_sched_timer_start(first->start_time);
             }
         }
     }
@@ -654,7 +835,9 @@ ble_ll_sched_execute_item(struct ble_ll_sched_item *sch)
     }
 
     assert(sch->sched_cb);
+    ble_ll_prof_exec_start(sch);
     rc = sch->sched_cb(sch);
+    ble_ll_prof_exec_end(sch, rc);
     return rc;
 }
 
@@ -686,7 +869,7 @@ ble_ll_sched_run(void *arg)
             sch->enqueued = 0;
             ble_ll_sched_execute_item(sch);
         } else {
-            cputime_timer_start(&g_ble_ll_sched_timer, sch->start_time);
+            ble_ll_sched_timer_start(sch->start_time);
             break;
         }
     }
@@ -741,7 +924,7 @@ ble_ll_sched_stop(void)
 int
 ble_ll_sched_init(void)
 {
-    /* Initialize cputimer for the scheduler */
-    cputime_timer_init(&g_ble_ll_sched_timer, ble_ll_sched_run, NULL);
+    /* Initialize cputimer for the scheduler; dedicated channel if possible */
+    cputime_timer_init_dedicated(&g_ble_ll_sched_timer, ble_ll_sched_run, NULL);
     return 0;
 }
@@ -30,21 +30,78 @@
 #include "controller/ble_hw.h"
 #include "hal/hal_cputime.h"
 
-#if (NIMBLE_OPT_LL_WHITELIST_SIZE < BLE_HW_WHITE_LIST_SIZE)
+/*
+ * The whitelist is not limited by the size of the hardware whitelist. Entries
+ * are placed in hardware while they fit; once an entry cannot be placed in
+ * hardware, matching is done in software until enough entries are removed.
+ */
 #define BLE_LL_WHITELIST_SIZE       NIMBLE_OPT_LL_WHITELIST_SIZE
-#else
-#define BLE_LL_WHITELIST_SIZE       BLE_HW_WHITE_LIST_SIZE
-#endif
+
+/*
+ * Number of slots in the open addressing hash table used to search the
+ * whitelist. Kept at least twice the whitelist size to keep probes short.
+ */
+#define BLE_LL_WHITELIST_HASH_SIZE  (2 * BLE_LL_WHITELIST_SIZE + 1)
 
 struct ble_ll_whitelist_entry
 {
     uint8_t wl_valid;
     uint8_t wl_addr_type;
+    uint8_t wl_in_hw;
     uint8_t wl_dev_addr[BLE_DEV_ADDR_LEN];
 };
 
 struct ble_ll_whitelist_entry g_ble_ll_whitelist[BLE_LL_WHITELIST_SIZE];
 
+/* Hash table slots hold whitelist 'position' (index plus 1); 0 is empty */
+static uint8_t g_ble_ll_whitelist_hash[BLE_LL_WHITELIST_HASH_SIZE];
+
+/* Number of valid whitelist entries that are not in the hardware whitelist */
+static uint8_t g_ble_ll_whitelist_sw_cnt;
+
+static int
+ble_ll_whitelist_hash(uint8_t *addr, uint8_t addr_type)
+{
+    int i;
+    uint32_t h;
+
+    h = addr_type;
+    for (i = 0; i < BLE_DEV_ADDR_LEN; ++i) {
+        h = (h * 31) + addr[i];
+    }
+
+    return (int)(h % BLE_LL_WHITELIST_HASH_SIZE);
+}
+
+/**
+ * Rebuilds the whitelist hash table from the whitelist. Called whenever the
+ * whitelist changes; this only happens when the whitelist is not in use.
+ */
+static void
+ble_ll_whitelist_hash_rebuild(void)
+{
+    int i;
+    int slot;
+    struct ble_ll_whitelist_entry *wl;
+
+    memset(g_ble_ll_whitelist_hash, 0, sizeof g_ble_ll_whitelist_hash);
+
+    wl = &g_ble_ll_whitelist[0];
+    for (i = 0; i < BLE_LL_WHITELIST_SIZE; ++i) {
+        if (wl->wl_valid) {
+            slot = ble_ll_whitelist_hash(wl->wl_dev_addr, wl->wl_addr_type);
+            while (g_ble_ll_whitelist_hash[slot] != 0) {
+                ++slot;
+                if (slot == BLE_LL_WHITELIST_HASH_SIZE) {
+                    slot = 0;
+                }
+            }
+            g_ble_ll_whitelist_hash[slot] = i + 1;
+        }
+        ++wl;
+    }
+}
+
 static int
 ble_ll_whitelist_chg_allowed(void)
 {
@@ -84,8 +141,11 @@ ble_ll_whitelist_clear(void)
     wl = &g_ble_ll_whitelist[0];
     for (i = 0; i < BLE_LL_WHITELIST_SIZE; ++i) {
         wl->wl_valid = 0;
+        wl->wl_in_hw = 0;
         ++wl;
     }
+    g_ble_ll_whitelist_sw_cnt = 0;
+    ble_ll_whitelist_hash_rebuild();
 
 #if (BLE_USES_HW_WHITELIST == 1)
     ble_hw_whitelist_clear();
@@ -125,16 +185,21 @@ ble_ll_whitelist_read_size(uint8_t *rspbuf, uint8_t *rsplen)
 static int
 ble_ll_whitelist_search(uint8_t *addr, uint8_t addr_type)
 {
-    int i;
+    int slot;
+    int position;
     struct ble_ll_whitelist_entry *wl;
 
-    wl = &g_ble_ll_whitelist[0];
-    for (i = 0; i < BLE_LL_WHITELIST_SIZE; ++i) {
-        if ((wl->wl_valid) && (wl->wl_addr_type == addr_type) &&
+    slot = ble_ll_whitelist_hash(addr, addr_type);
+    while ((position = g_ble_ll_whitelist_hash[slot]) != 0) {
+        wl = &g_ble_ll_whitelist[position - 1];
+        if ((wl->wl_addr_type == addr_type) &&
             (!memcmp(&wl->wl_dev_addr[0], addr, BLE_DEV_ADDR_LEN))) {
-            return i + 1;
+            return position;
+        }
+        ++slot;
+        if (slot == BLE_LL_WHITELIST_HASH_SIZE) {
+            slot = 0;
         }
-        ++wl;
     }
 
     return 0;
@@ -145,7 +210,8 @@ ble_ll_whitelist_search(uint8_t *addr, uint8_t addr_type)
  *
  * NOTE: This API uses the HW, if present, to determine if there was a match
  * between a received address and an address in the whitelist. If the HW does
- * not support whitelisting this API is the same as the whitelist search API
+ * not support whitelisting, or the whitelist does not fit in the HW, this API
+ * is the same as the whitelist search API
  *
  * @param addr
  * @param addr_type Public address (0) or random address (1)
@@ -163,7 +229,7 @@ ble_ll_whitelist_match(uint8_t *addr, uint8_t addr_type, int is_ident)
      * to both resolve a private address and perform a whitelist check. The
      * current BLE hw cannot support this.
      */
-    if (is_ident) {
+    if (is_ident || g_ble_ll_whitelist_sw_cnt) {
         rc = ble_ll_whitelist_search(addr, addr_type);
     } else {
         rc = ble_hw_whitelist_match();
@@ -200,6 +266,7 @@ ble_ll_whitelist_add(uint8_t *addr, uint8_t addr_type)
                 memcpy(&wl->wl_dev_addr[0], addr, BLE_DEV_ADDR_LEN);
                 wl->wl_addr_type = addr_type;
                 wl->wl_valid = 1;
+                wl->wl_in_hw = 0;
                 break;
             }
             ++wl;
@@ -209,8 +276,14 @@ ble_ll_whitelist_add(uint8_t *addr, uint8_t addr_type)
             rc = BLE_ERR_MEM_CAPACITY;
         } else {
 #if (BLE_USES_HW_WHITELIST == 1)
-            rc = ble_hw_whitelist_add(addr, addr_type);
+            if (!ble_hw_whitelist_add(addr, addr_type)) {
+                wl->wl_in_hw = 1;
+            }
 #endif
+            if (!wl->wl_in_hw) {
+                ++g_ble_ll_whitelist_sw_cnt;
+            }
+            ble_ll_whitelist_hash_rebuild();
         }
     }
 
@@ -227,7 +300,11 @@ ble_ll_whitelist_add(uint8_t *addr, uint8_t addr_type)
 int
 ble_ll_whitelist_rmv(uint8_t *addr, uint8_t addr_type)
 {
+#if (BLE_USES_HW_WHITELIST == 1)
+    int i;
+#endif
     int position;
+    struct ble_ll_whitelist_entry *wl;
 
     /* Must be in proper state */
     if (!ble_ll_whitelist_chg_allowed()) {
@@ -236,12 +313,34 @@ ble_ll_whitelist_rmv(uint8_t *addr, uint8_t addr_type)
 
     position = ble_ll_whitelist_search(addr, addr_type);
     if (position) {
-        g_ble_ll_whitelist[position - 1].wl_valid = 0;
-    }
-
+        wl = &g_ble_ll_whitelist[position - 1];
+        wl->wl_valid = 0;
+        if (wl->wl_in_hw) {
+            wl->wl_in_hw = 0;
 #if (BLE_USES_HW_WHITELIST == 1)
-    ble_hw_whitelist_rmv(addr, addr_type);
+            ble_hw_whitelist_rmv(addr, addr_type);
+
+            /* A hw entry is free; move a software only entry into it */
+            if (g_ble_ll_whitelist_sw_cnt) {
+                wl = &g_ble_ll_whitelist[0];
+                for (i = 0; i < BLE_LL_WHITELIST_SIZE; ++i) {
+                    if (wl->wl_valid && !wl->wl_in_hw) {
+                        if (!ble_hw_whitelist_add(wl->wl_dev_addr,
+                                                  wl->wl_addr_type)) {
+                            wl->wl_in_hw = 1;
+                            --g_ble_ll_whitelist_sw_cnt;
+                        }
+                        break;
+                    }
+                    ++wl;
+                }
+            }
 #endif
+        } else {
+            --g_ble_ll_whitelist_sw_cnt;
+        }
+        ble_ll_whitelist_hash_rebuild();
+    }
 
     return BLE_ERR_SUCCESS;
 }
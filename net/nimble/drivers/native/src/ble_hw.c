@@ -215,10 +215,12 @@ ble_hw_resolv_list_size(void)
  *
  * @return int  Negative values indicate unresolved address; positive values
  *              indicate index in resolving list of resolved address.
+ *              There is no hardware resolver so this always returns
+ *              BLE_HW_RESOLV_NOT_DONE.
  */
 int
 ble_hw_resolv_list_match(void)
 {
-    return -1;
+    return BLE_HW_RESOLV_NOT_DONE;
 }
 #endif
@@ -24,8 +24,10 @@
 #include "ble/xcvr.h"
 #include "nimble/ble.h"
 #include "nimble/nimble_opt.h"
+#include "hal/hal_cputime.h"
 #include "controller/ble_phy.h"
 #include "controller/ble_ll.h"
+#include "mcu/native_air.h"
 
 /* BLE PHY data structure */
 struct ble_phy_obj
@@ -39,21 +41,34 @@ struct ble_phy_obj
     uint8_t phy_encrypted;
     uint8_t phy_privacy;
     uint8_t phy_tx_pyld_len;
+    uint8_t phy_rx_crcok;
+    uint8_t phy_in_rx_end;
+    uint8_t phy_tx_start_set;
     uint32_t phy_aar_scratch;
     uint32_t phy_access_address;
     struct ble_mbuf_hdr rxhdr;
     void *txend_arg;
     uint8_t *rxdptr;
     ble_phy_tx_end_func txend_cb;
+
+    /* Virtual air times (usecs) */
+    uint64_t phy_tx_start;
+    uint64_t phy_rx_start;
+    uint64_t phy_rx_end;
+    struct native_air_timer phy_air_timer;
 };
 struct ble_phy_obj g_ble_phy_data;
 
+/* Receive buffer. Word aligned for ble_phy_rxpdu_copy() */
+static uint32_t g_ble_phy_rx_buf[(BLE_PHY_MAX_PDU_LEN + 3) / 4];
+
 /* Statistics */
 struct ble_phy_statistics
 {
     uint32_t tx_good;
     uint32_t tx_fail;
     uint32_t tx_late;
+    uint32_t rx_late;
     uint32_t tx_bytes;
     uint32_t rx_starts;
     uint32_t rx_aborts;
@@ -216,6 +231,20 @@ ble_phy_rxpdu_copy(uint8_t *dptr, struct os_mbuf *rxpdu)
     memcpy(ble_hdr, &g_ble_phy_data.rxhdr, sizeof(struct ble_mbuf_hdr));
 }
 
+/**
+ * Returns the mbuf the current pdu was received into. This phy always
+ * receives into its own buffer so the pdu has to be copied out.
+ *
+ * @param len Total length of the PDU (header plus payload)
+ *
+ * @return struct os_mbuf* NULL
+ */
+struct os_mbuf *
+ble_phy_rxpdu_take(uint16_t len)
+{
+    return NULL;
+}
+
 void
 ble_phy_isr(void)
 {
@@ -233,14 +262,22 @@ ble_phy_isr(void)
         assert(g_ble_phy_data.phy_state == BLE_PHY_STATE_TX);
         ble_xcvr_clear_irq(BLE_XCVR_IRQ_F_TX_END);
 
+        /* Call transmit end callback */
+        if (g_ble_phy_data.txend_cb) {
+            g_ble_phy_data.txend_cb(g_ble_phy_data.txend_arg);
+        }
+
         transition = g_ble_phy_data.phy_transition;
         if (transition == BLE_PHY_TRANSITION_TX_RX) {
-            /* Disable the phy */
-            /* XXX: count no bufs? */
-            ble_phy_disable();
+            /* Start receiving and enable the wait for response timer */
+            g_ble_phy_data.phy_state = BLE_PHY_STATE_RX;
+            g_ble_phy_data.phy_rx_start = native_air_time();
+            ble_ll_wfr_enable(cputime_get32() +
+                              cputime_usecs_to_ticks(BLE_LL_WFR_USECS));
         } else {
             /* Better not be going from rx to tx! */
             assert(transition == BLE_PHY_TRANSITION_NONE);
+            g_ble_phy_data.phy_state = BLE_PHY_STATE_IDLE;
         }
     }
 
@@ -253,7 +290,10 @@ ble_phy_isr(void)
         rc = ble_ll_rx_start(g_ble_phy_data.rxdptr, g_ble_phy_data.phy_chan,
                              &g_ble_phy_data.rxhdr);
         if (rc >= 0) {
-            /* XXX: set rx end enable isr */
+            /* Receive end is signalled when the frame is over */
+            g_ble_phy_data.phy_rx_started = 1;
+            native_air_timer_start(&g_ble_phy_data.phy_air_timer,
+                                   g_ble_phy_data.phy_rx_end);
         } else {
             /* Disable PHY */
             ble_phy_disable();
@@ -270,14 +310,12 @@ ble_phy_isr(void)
 
         ble_xcvr_clear_irq(BLE_XCVR_IRQ_F_RX_END);
 
-        /* Construct BLE header before handing up */
+        /* Finish BLE header (flags set at rx start) before handing up */
         ble_hdr = &g_ble_phy_data.rxhdr;
-        ble_hdr->rxinfo.flags = 0;
         ble_hdr->rxinfo.rssi = -77;    /* XXX: dummy rssi */
-        ble_hdr->rxinfo.channel = g_ble_phy_data.phy_chan;
 
         /* Count PHY crc errors and valid packets */
-        crcok = 1;
+        crcok = g_ble_phy_data.phy_rx_crcok;
         if (!crcok) {
             ++g_ble_phy_stats.rx_crc_err;
         } else {
@@ -285,8 +323,17 @@ ble_phy_isr(void)
             ble_hdr->rxinfo.flags |= BLE_MBUF_HDR_F_CRC_OK;
         }
 
+        /*
+         * Radio is done receiving. A transmit started from the receive end
+         * callback goes out T_IFS after the end of this frame.
+         */
+        g_ble_phy_data.phy_rx_started = 0;
+        g_ble_phy_data.phy_state = BLE_PHY_STATE_IDLE;
+        g_ble_phy_data.phy_in_rx_end = 1;
+
         /* Call Link Layer receive payload function */
         rc = ble_ll_rx_end(g_ble_phy_data.rxdptr, ble_hdr);
+        g_ble_phy_data.phy_in_rx_end = 0;
         if (rc < 0) {
             /* Disable the PHY. */
             ble_phy_disable();
@@ -297,6 +344,68 @@ ble_phy_isr(void)
     ++g_ble_phy_stats.phy_isrs;
 }
 
+/**
+ * Called by the virtual air when a frame starts. Emulates the receive start
+ * interrupt if we are listening on the channel and access address.
+ *
+ * @param frame
+ */
+static void
+ble_phy_air_rx(struct native_air_frame *frame)
+{
+    struct ble_mbuf_hdr *ble_hdr;
+
+    if ((g_ble_phy_data.phy_state != BLE_PHY_STATE_RX) ||
+        (frame->naf_chan != g_ble_phy_data.phy_chan)) {
+        return;
+    }
+
+    /* Another frame on our channel while receiving: collision */
+    if (g_ble_phy_data.phy_rx_started) {
+        g_ble_phy_data.phy_rx_crcok = 0;
+        return;
+    }
+
+    if ((frame->naf_aa != g_ble_phy_data.phy_access_address) ||
+        (frame->naf_start < g_ble_phy_data.phy_rx_start) ||
+        (frame->naf_len < BLE_LL_PDU_HDR_LEN)) {
+        return;
+    }
+
+    memcpy(g_ble_phy_data.rxdptr, frame->naf_pdu, frame->naf_len);
+    g_ble_phy_data.phy_rx_crcok = 1;
+    g_ble_phy_data.phy_rx_end = frame->naf_start +
+        BLE_TX_DUR_USECS_M(frame->naf_len - BLE_LL_PDU_HDR_LEN);
+
+    /* Initialize flags, channel and state in ble header at rx start */
+    ble_hdr = &g_ble_phy_data.rxhdr;
+    ble_hdr->rxinfo.flags = ble_ll_state_get();
+    ble_hdr->rxinfo.channel = g_ble_phy_data.phy_chan;
+    ble_hdr->rxinfo.handle = 0;
+    ble_hdr->beg_cputime = cputime_get32();
+
+    g_xcvr_data.irq_status |= BLE_XCVR_IRQ_F_RX_START;
+    ble_phy_isr();
+}
+
+/**
+ * Virtual air timer: end of the frame being transmitted or received.
+ *
+ * @param arg
+ */
+static void
+ble_phy_air_timer_cb(void *arg)
+{
+    if (g_ble_phy_data.phy_state == BLE_PHY_STATE_TX) {
+        g_xcvr_data.irq_status |= BLE_XCVR_IRQ_F_TX_END;
+    } else if (g_ble_phy_data.phy_rx_started) {
+        g_xcvr_data.irq_status |= BLE_XCVR_IRQ_F_RX_END;
+    } else {
+        return;
+    }
+    ble_phy_isr();
+}
+
 /**
  * ble phy init
  *
@@ -310,8 +419,14 @@ ble_phy_init(void)
     /* Set phy channel to an invalid channel so first set channel works */
     g_ble_phy_data.phy_state = BLE_PHY_STATE_IDLE;
     g_ble_phy_data.phy_chan = BLE_PHY_NUM_CHANS;
+    g_ble_phy_data.rxdptr = (uint8_t *)&g_ble_phy_rx_buf[0];
 
-    /* XXX: emulate ISR? */
+    /* Interrupts are emulated from the virtual air, if there is one */
+    native_air_timer_init(&g_ble_phy_data.phy_air_timer,
+                          ble_phy_air_timer_cb, NULL);
+    if (native_air_enabled()) {
+        native_air_set_rx_cb(ble_phy_air_rx);
+    }
 
     return 0;
 }
@@ -383,6 +498,14 @@ ble_phy_set_txend_cb(ble_phy_tx_end_func txend_cb, void *arg)
 int
 ble_phy_tx_set_start_time(uint32_t cputime)
 {
+    if ((int32_t)(cputime_get32() - cputime) >= 0) {
+        ++g_ble_phy_stats.tx_late;
+        ble_phy_disable();
+        return BLE_PHY_ERR_TX_LATE;
+    }
+
+    g_ble_phy_data.phy_tx_start = native_cputime_to_air_time(cputime);
+    g_ble_phy_data.phy_tx_start_set = 1;
     return 0;
 }
 
@@ -402,10 +525,60 @@ ble_phy_tx_set_start_time(uint32_t cputime)
 int
 ble_phy_rx_set_start_time(uint32_t cputime)
 {
+    g_ble_phy_data.phy_rx_start = native_cputime_to_air_time(cputime);
+    if ((int32_t)(cputime_get32() - cputime) >= 0) {
+        ++g_ble_phy_stats.rx_late;
+        return BLE_PHY_ERR_TX_LATE;
+    }
     return 0;
 }
 
 
+/**
+ * Puts the frame on the virtual air. It starts T_IFS after the end of the
+ * received frame when called from the receive end interrupt, at the time
+ * set by ble_phy_tx_set_start_time() or else now.
+ *
+ * @param txpdu
+ *
+ * @return int 0: success; -1 if the frame could not be sent
+ */
+static int
+ble_phy_air_tx(struct os_mbuf *txpdu)
+{
+    int rc;
+    uint8_t payload_len;
+    struct ble_mbuf_hdr *ble_hdr;
+    struct native_air_frame frame;
+
+    ble_hdr = BLE_MBUF_HDR_PTR(txpdu);
+    payload_len = ble_hdr->txinfo.pyld_len;
+
+    frame.naf_pdu[0] = ble_hdr->txinfo.hdr_byte;
+    frame.naf_pdu[1] = payload_len;
+    os_mbuf_copydata(txpdu, ble_hdr->txinfo.offset, payload_len,
+                     &frame.naf_pdu[BLE_LL_PDU_HDR_LEN]);
+    frame.naf_len = payload_len + BLE_LL_PDU_HDR_LEN;
+    frame.naf_chan = g_ble_phy_data.phy_chan;
+    frame.naf_aa = g_ble_phy_data.phy_access_address;
+
+    if (g_ble_phy_data.phy_in_rx_end) {
+        frame.naf_start = g_ble_phy_data.phy_rx_end + BLE_LL_IFS;
+    } else if (g_ble_phy_data.phy_tx_start_set) {
+        frame.naf_start = g_ble_phy_data.phy_tx_start;
+    } else {
+        frame.naf_start = native_air_time();
+    }
+    g_ble_phy_data.phy_tx_start_set = 0;
+
+    /* Transmit end is signalled when the frame is over */
+    native_air_timer_start(&g_ble_phy_data.phy_air_timer,
+                           frame.naf_start + BLE_TX_DUR_USECS_M(payload_len));
+
+    rc = native_air_tx(&frame);
+    return rc;
+}
+
 int
 ble_phy_tx(struct os_mbuf *txpdu, uint8_t end_trans)
 {
@@ -422,19 +595,14 @@ ble_phy_tx(struct os_mbuf *txpdu, uint8_t end_trans)
         return BLE_PHY_ERR_RADIO_STATE;
     }
 
-    /* Select tx address */
-    if (g_ble_phy_data.phy_chan < BLE_PHY_NUM_DATA_CHANS) {
-        /* XXX: fix this */
-        assert(0);
-    } else {
-    }
-
-
     /* Set the PHY transition */
     g_ble_phy_data.phy_transition = end_trans;
 
     /* Make sure transceiver in correct state */
     state = BLE_PHY_STATE_TX;
+    if (native_air_enabled() && ble_phy_air_tx(txpdu)) {
+        state = BLE_PHY_STATE_IDLE;
+    }
     if (state == BLE_PHY_STATE_TX) {
         /* Set phy state to transmitting and count packet statistics */
         g_ble_phy_data.phy_state = BLE_PHY_STATE_TX;
@@ -544,6 +712,10 @@ void
 ble_phy_disable(void)
 {
     g_ble_phy_data.phy_state = BLE_PHY_STATE_IDLE;
+    g_ble_phy_data.phy_rx_started = 0;
+    g_ble_phy_data.phy_tx_start_set = 0;
+    g_ble_phy_data.phy_rx_start = 0;
+    native_air_timer_stop(&g_ble_phy_data.phy_air_timer);
 }
 
 /* Gets the current access address */
@@ -141,7 +141,7 @@ ble_hw_whitelist_rmv(uint8_t *addr, uint8_t addr_type)
 
     if (i < BLE_HW_WHITE_LIST_SIZE) {
         g_ble_hw_whitelist_mask &= ~mask;
-        NRF_RADIO->DACNF &= ~mask;
+        NRF_RADIO->DACNF &= ~(mask | (mask << 8));
     }
 }
 
@@ -389,9 +389,9 @@ ble_hw_resolv_list_rmv(int index)
 
     if (index < g_nrf_num_irks) {
         --g_nrf_num_irks;
-        irk_entry = &g_nrf_irk_list[index];
+        irk_entry = &g_nrf_irk_list[4 * index];
         if (g_nrf_num_irks > index) {
-            memmove(irk_entry, irk_entry + 4, g_nrf_num_irks - index);
+            memmove(irk_entry, irk_entry + 4, (g_nrf_num_irks - index) * 16);
         }
     }
 }
@@ -413,6 +413,8 @@ ble_hw_resolv_list_size(void)
  *
  * @return int  Negative values indicate unresolved address; positive values
  *              indicate index in resolving list of resolved address.
+ *              BLE_HW_RESOLV_NOT_DONE is returned if the AAR has not
+ *              finished.
  */
 int
 ble_hw_resolv_list_match(void)
@@ -424,8 +426,9 @@ ble_hw_resolv_list_match(void)
             index = NRF_AAR->STATUS;
             return (int)index;
         }
+        return BLE_HW_RESOLV_NO_MATCH;
     }
 
-    return -1;
+    return BLE_HW_RESOLV_NOT_DONE;
 }
 #endif
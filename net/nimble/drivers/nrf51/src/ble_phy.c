@@ -255,6 +255,20 @@ ble_phy_rxpdu_copy(uint8_t *dptr, struct os_mbuf *rxpdu)
     memcpy(ble_hdr, &g_ble_phy_data.rxhdr, sizeof(struct ble_mbuf_hdr));
 }
 
+/**
+ * Returns the mbuf the current pdu was received into. This phy always
+ * receives into its own buffer so the pdu has to be copied out.
+ *
+ * @param len Total length of the PDU (header plus payload)
+ *
+ * @return struct os_mbuf* NULL
+ */
+struct os_mbuf *
+ble_phy_rxpdu_take(uint16_t len)
+{
+    return NULL;
+}
+
 /**
  * Called when we want to wait if the radio is in either the rx or tx
  * disable states. We want to wait until that state is over before doing
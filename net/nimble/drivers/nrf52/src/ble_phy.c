@@ -72,6 +72,8 @@ struct ble_phy_obj
     uint8_t phy_encrypted;
     uint8_t phy_privacy;
     uint8_t phy_tx_pyld_len;
+    uint8_t phy_rx_in_mbuf;
+    uint8_t *phy_rx_dptr;
     uint32_t phy_aar_scratch;
     uint32_t phy_access_address;
     struct ble_mbuf_hdr rxhdr;
@@ -85,6 +87,22 @@ struct ble_phy_obj g_ble_phy_data;
 static uint32_t g_ble_phy_tx_buf[(BLE_PHY_MAX_PDU_LEN + 3) / 4];
 static uint32_t g_ble_phy_rx_buf[(BLE_PHY_MAX_PDU_LEN + 3) / 4];
 
+/*
+ * Mbuf the radio receives into directly. Allocated when receive is set up
+ * and handed to the link layer by ble_phy_rxpdu_take(). If a large enough
+ * mbuf cannot be allocated, g_ble_phy_rx_buf is used and the link layer
+ * copies the PDU out of it.
+ *
+ * The radio writes S0, LENGTH and a RAM-only S1 byte before the payload.
+ * The header is shifted over the S1 byte at the end of reception so the PDU
+ * starts one byte after the radio packet pointer. The packet pointer is
+ * placed so that, like ble_ll_rxpdu_alloc(), four bytes are left in front
+ * of the PDU for the link layer to prepend.
+ */
+static struct os_mbuf *g_ble_phy_rx_mbuf;
+#define NRF_RX_MBUF_OFFSET      (3)
+#define NRF_RX_MBUF_DATA_LEN    (NRF_RX_MBUF_OFFSET + 3 + NRF_MAXLEN)
+
 #if (BLE_LL_CFG_FEAT_LE_ENCRYPTION == 1)
 /* Make sure word-aligned for faster copies */
 static uint32_t g_ble_phy_enc_buf[(BLE_PHY_MAX_PDU_LEN + 3) / 4];
@@ -200,6 +218,11 @@ ble_phy_rxpdu_copy(uint8_t *dptr, struct os_mbuf *rxpdu)
     struct ble_mbuf_hdr *ble_hdr;
     struct os_mbuf_pkthdr *pkthdr;
 
+    /* Nothing to copy if the PDU was received directly into this mbuf */
+    if (rxpdu->om_data == dptr) {
+        goto copy_ble_hdr;
+    }
+
     /* Better be aligned */
     assert(((uint32_t)dptr & 3) == 0);
 
@@ -251,11 +274,78 @@ ble_phy_rxpdu_copy(uint8_t *dptr, struct os_mbuf *rxpdu)
         }
     }
 
+copy_ble_hdr:
     /* Copy ble header */
     ble_hdr = BLE_MBUF_HDR_PTR(rxpdu);
     memcpy(ble_hdr, &g_ble_phy_data.rxhdr, sizeof(struct ble_mbuf_hdr));
 }
 
+/**
+ * Returns the mbuf the radio received the current PDU into, if the PDU was
+ * received directly into an mbuf. The mbuf is no longer owned by the phy; a
+ * new one is allocated the next time receive is set up.
+ *
+ * @param len Total length of the PDU (header plus payload)
+ *
+ * @return struct os_mbuf* The mbuf holding the PDU; NULL if the PDU was
+ *         received into the phy receive buffer.
+ */
+struct os_mbuf *
+ble_phy_rxpdu_take(uint16_t len)
+{
+    struct os_mbuf *m;
+
+    if (!g_ble_phy_data.phy_rx_in_mbuf) {
+        return NULL;
+    }
+
+    m = g_ble_phy_rx_mbuf;
+    g_ble_phy_rx_mbuf = NULL;
+    g_ble_phy_data.phy_rx_in_mbuf = 0;
+
+    m->om_data = g_ble_phy_data.phy_rx_dptr + 1;
+    m->om_len = len;
+    OS_MBUF_PKTHDR(m)->omp_len = len;
+
+    return m;
+}
+
+/**
+ * Returns the buffer the radio should receive the next PDU into. This is the
+ * data area of a pre-allocated mbuf if one can be had; otherwise it is the
+ * phy receive buffer.
+ *
+ * @return uint8_t* Pointer to set the radio packet pointer to
+ */
+static uint8_t *
+ble_phy_rx_dptr_get(void)
+{
+    struct os_mbuf *m;
+
+    if (g_ble_phy_rx_mbuf == NULL) {
+        m = ble_ll_rxpdu_pool_get();
+        if (m == NULL) {
+            m = os_msys_get_pkthdr(NRF_RX_MBUF_DATA_LEN,
+                                   sizeof(struct ble_mbuf_hdr));
+        }
+        if (m != NULL) {
+            if (OS_MBUF_TRAILINGSPACE(m) < NRF_RX_MBUF_DATA_LEN) {
+                os_mbuf_free_chain(m);
+                m = NULL;
+            }
+        }
+        g_ble_phy_rx_mbuf = m;
+    }
+
+    if (g_ble_phy_rx_mbuf != NULL) {
+        g_ble_phy_data.phy_rx_in_mbuf = 1;
+        return g_ble_phy_rx_mbuf->om_data + NRF_RX_MBUF_OFFSET;
+    }
+
+    g_ble_phy_data.phy_rx_in_mbuf = 0;
+    return (uint8_t *)&g_ble_phy_rx_buf[0] + 3;
+}
+
 /**
  * Called when we want to wait if the radio is in either the rx or tx
  * disable states. We want to wait until that state is over before doing
@@ -287,8 +377,8 @@ ble_phy_rx_xcvr_setup(void)
 {
     uint8_t *dptr;
 
-    dptr = (uint8_t *)&g_ble_phy_rx_buf[0];
-    dptr += 3;
+    dptr = ble_phy_rx_dptr_get();
+    g_ble_phy_data.phy_rx_dptr = dptr;
 
 #if (BLE_LL_CFG_FEAT_LE_ENCRYPTION == 1)
     if (g_ble_phy_data.phy_encrypted) {
@@ -390,7 +480,7 @@ ble_phy_tx_end_isr(void)
      * For now I just count a stat but continue on like all is good.
      */
     if (was_encrypted) {
-        if (NRF_CCM->EVENTS_ERROR) {
+        if (NRF_CCM->EVENTS_ERROR || (NRF_CCM->EVENTS_ENDCRYPT == 0)) {
             STATS_INC(ble_phy_stats, tx_hw_err);
             NRF_CCM->EVENTS_ERROR = 0;
         }
@@ -446,8 +536,7 @@ ble_phy_rx_end_isr(void)
     assert(NRF_RADIO->EVENTS_RSSIEND != 0);
     ble_hdr->rxinfo.rssi = -1 * NRF_RADIO->RSSISAMPLE;
 
-    dptr = (uint8_t *)&g_ble_phy_rx_buf[0];
-    dptr += 3;
+    dptr = g_ble_phy_data.phy_rx_dptr;
 
     /* Count PHY crc errors and valid packets */
     crcok = (uint8_t)NRF_RADIO->CRCSTATUS;
@@ -538,7 +627,7 @@ ble_phy_rx_start_isr(void)
         BLE_TX_LEN_USECS_M(NRF_RX_START_OFFSET);
 
     /* Call Link Layer receive start function */
-    rc = ble_ll_rx_start((uint8_t *)&g_ble_phy_rx_buf[0] + 3,
+    rc = ble_ll_rx_start(g_ble_phy_data.phy_rx_dptr,
                          g_ble_phy_data.phy_chan,
                          &g_ble_phy_data.rxhdr);
     if (rc >= 0) {
@@ -752,9 +841,14 @@ ble_phy_encrypt_enable(uint64_t pkt_counter, uint8_t *iv, uint8_t *key,
     memcpy(g_nrf_ccm_data.iv, iv, 8);
     g_nrf_ccm_data.dir_bit = is_master;
     g_ble_phy_data.phy_encrypted = 1;
-    /* Enable the module (AAR cannot be on while CCM on) */
+    /*
+     * Enable the module (AAR cannot be on while CCM on). This is called at
+     * the start of every connection event; leave CCM alone if it is on.
+     */
     NRF_AAR->ENABLE = AAR_ENABLE_ENABLE_Disabled;
-    NRF_CCM->ENABLE = CCM_ENABLE_ENABLE_Enabled;
+    if (NRF_CCM->ENABLE != CCM_ENABLE_ENABLE_Enabled) {
+        NRF_CCM->ENABLE = CCM_ENABLE_ENABLE_Enabled;
+    }
 }
 
 void
@@ -875,15 +969,24 @@ ble_phy_tx(struct os_mbuf *txpdu, uint8_t end_trans)
         dptr = (uint8_t *)&g_ble_phy_enc_buf[0];
         ++dptr;
         pktptr = (uint8_t *)&g_ble_phy_tx_buf[0];
-        NRF_CCM->SHORTS = 1;
+        NRF_CCM->SHORTS = CCM_SHORTS_ENDKSGEN_CRYPT_Msk;
         NRF_CCM->INPTR = (uint32_t)dptr;
         NRF_CCM->OUTPTR = (uint32_t)pktptr;
         NRF_CCM->SCRATCHPTR = (uint32_t)&g_nrf_encrypt_scratchpad[0];
         NRF_CCM->EVENTS_ERROR = 0;
+        NRF_CCM->EVENTS_ENDCRYPT = 0;
         NRF_CCM->MODE = CCM_MODE_LENGTH_Msk;
         NRF_CCM->CNFPTR = (uint32_t)&g_nrf_ccm_data;
-        NRF_PPI->CHENCLR = PPI_CHEN_CH25_Msk | PPI_CHEN_CH23_Msk;
-        NRF_PPI->CHENSET = PPI_CHEN_CH24_Msk;
+
+        /*
+         * The PDU is encrypted as soon as it has been copied (see below),
+         * while the radio is still in its turnaround, instead of on the
+         * radio READY event. Keystream generation and encryption then
+         * overlap the IFS and ramp-up, so they add nothing to the time the
+         * packet takes on air.
+         */
+        NRF_PPI->CHENCLR = PPI_CHEN_CH25_Msk | PPI_CHEN_CH24_Msk |
+                           PPI_CHEN_CH23_Msk;
     } else {
 #if (BLE_LL_CFG_FEAT_LL_PRIVACY == 1)
         NRF_PPI->CHENCLR = PPI_CHEN_CH23_Msk;
@@ -934,6 +1037,12 @@ ble_phy_tx(struct os_mbuf *txpdu, uint8_t end_trans)
         /* Copy data from mbuf into transmit buffer */
         os_mbuf_copydata(txpdu, ble_hdr->txinfo.offset, payload_len, dptr);
 
+#if (BLE_LL_CFG_FEAT_LE_ENCRYPTION == 1)
+        if (g_ble_phy_data.phy_encrypted) {
+            NRF_CCM->TASKS_KSGEN = 1;
+        }
+#endif
+
         /* Set phy state to transmitting and count packet statistics */
         g_ble_phy_data.phy_state = BLE_PHY_STATE_TX;
         STATS_INC(ble_phy_stats, tx_good);
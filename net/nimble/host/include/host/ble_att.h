@@ -94,6 +94,36 @@ struct os_mbuf;
 #define BLE_ATT_MTU_MAX                 240
 #define BLE_ATT_MTU_PREFERRED_DFLT      240
 
+typedef int ble_att_svr_access_fn(uint16_t conn_handle, uint16_t attr_handle,
+                                  uint8_t op, uint16_t offset,
+                                  struct os_mbuf **om, void *arg);
+
+/**
+ * An attribute in the ATT server's database.  Registered attributes are
+ * allocated from a pool; the attributes of a flash table (see
+ * ble_gatts_set_tbl()) are const, have zeroed list links and handle id, and
+ * take their handle from their position in the table.
+ */
+struct ble_att_svr_entry {
+    STAILQ_ENTRY(ble_att_svr_entry) ha_next;
+    struct ble_att_svr_entry *ha_uuid_next;   /* Next with the same UUID. */
+    struct ble_att_svr_entry *ha_hash_next;   /* Next UUID in hash bucket. */
+
+    uint8_t ha_flags;
+    uint8_t ha_uuid_type;                     /* BLE_UUID_TYPE_[...] */
+    uint16_t ha_handle_id;
+    union {
+        /* 16/32-bit UUID, or index of registered attribute's 128-bit UUID
+         * in the server's UUID table.
+         */
+        uint32_t ha_uuid;
+        /* 128-bit UUID of a flash table attribute. */
+        const uint8_t *ha_uuid128;
+    };
+    ble_att_svr_access_fn *ha_cb;
+    void *ha_cb_arg;
+};
+
 int ble_att_svr_read_local(uint16_t attr_handle, struct os_mbuf **out_om);
 int ble_att_svr_write_local(uint16_t attr_handle, struct os_mbuf *om);
 
@@ -52,5 +52,6 @@ int ble_eddystone_set_adv_data_uid(struct ble_hs_adv_fields *adv_fields,
 int ble_eddystone_set_adv_data_url(struct ble_hs_adv_fields *adv_fields,
                                    uint8_t url_scheme, char *url_body,
                                    uint8_t url_body_len, uint8_t suffix);
+int ble_eddystone_update_adv_data_uid(void *uid);
 
 #endif
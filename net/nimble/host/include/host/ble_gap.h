@@ -194,6 +194,26 @@ struct ble_gap_disc_params {
     uint8_t limited:1;
     uint8_t passive:1;
     uint8_t filter_duplicates:1;
+
+    /**
+     * If set, advertising reports are not decoded into a ble_hs_adv_fields
+     * struct; the disc descriptor's fields pointer is null and the
+     * application inspects the raw data with ble_hs_adv_parse() or
+     * ble_hs_adv_find().
+     */
+    uint8_t skip_fields:1;
+};
+
+/**
+ * The duty cycle of a multi-role procedure (ble_gap_multi_start()).  Each
+ * period begins with an advertising window of adv_pct percent of the period,
+ * followed by a discovery window of disc_pct percent; the radio is idle for
+ * the rest of the period.  A percentage of 0 leaves that role out.
+ */
+struct ble_gap_multi_params {
+    uint32_t period_ms;
+    uint8_t adv_pct;
+    uint8_t disc_pct;
 };
 
 struct ble_gap_upd_params {
@@ -205,6 +225,35 @@ struct ble_gap_upd_params {
     uint16_t max_ce_len;
 };
 
+#define BLE_GAP_TUNE_PROFILE_NONE           0
+#define BLE_GAP_TUNE_PROFILE_POWER          1
+#define BLE_GAP_TUNE_PROFILE_THROUGHPUT     2
+
+/**
+ * Connection auto-tuning policy (ble_gap_tune()).  The host samples each
+ * tuned connection's ACL traffic periodically.  When the connection is busy,
+ * i.e., at least busy_queued bytes are waiting for transmission or the data
+ * rate in either direction reaches busy_rate bytes per second, the throughput
+ * parameters are requested; a busy threshold of 0 is ignored.  After
+ * idle_samples consecutive samples below idle_rate with nothing queued, the
+ * power parameters are requested.  A tx_octets value of 0 leaves the
+ * profile's data length unchanged.
+ */
+struct ble_gap_tune_params {
+    struct ble_gap_upd_params throughput;
+    uint16_t throughput_tx_octets;
+    uint16_t throughput_tx_time;
+
+    struct ble_gap_upd_params power;
+    uint16_t power_tx_octets;
+    uint16_t power_tx_time;
+
+    uint16_t busy_queued;
+    uint32_t busy_rate;
+    uint32_t idle_rate;
+    uint8_t idle_samples;
+};
+
 struct ble_gap_passkey_params {
     uint8_t action;
     uint32_t numcmp;
@@ -218,7 +267,10 @@ struct ble_gap_disc_desc {
     int8_t rssi;
     uint8_t addr[6];
 
-    /*** LE advertising report fields; both null if no data present. */
+    /***
+     * LE advertising report fields; both null if no data present.  fields is
+     * also null if the discovery procedure was started with skip_fields set.
+     */
     uint8_t *data;
     struct ble_hs_adv_fields *fields;
 
@@ -538,11 +590,25 @@ int ble_gap_adv_stop(void);
 int ble_gap_adv_active(void);
 int ble_gap_adv_set_fields(const struct ble_hs_adv_fields *adv_fields);
 int ble_gap_adv_rsp_set_fields(const struct ble_hs_adv_fields *rsp_fields);
+int ble_gap_adv_set_data(const void *data, uint8_t data_len);
+int ble_gap_adv_rsp_set_data(const void *data, uint8_t data_len);
+int ble_gap_adv_find_field(uint8_t type, uint8_t *out_off, uint8_t *out_len);
+int ble_gap_adv_rsp_find_field(uint8_t type, uint8_t *out_off,
+                               uint8_t *out_len);
+int ble_gap_adv_patch_data(uint8_t off, const void *src, uint8_t len);
+int ble_gap_adv_rsp_patch_data(uint8_t off, const void *src, uint8_t len);
 int ble_gap_disc(uint8_t own_addr_type, int32_t duration_ms,
                  const struct ble_gap_disc_params *disc_params,
                  ble_gap_event_fn *cb, void *cb_arg);
 int ble_gap_disc_cancel(void);
 int ble_gap_disc_active(void);
+int ble_gap_multi_start(uint8_t own_addr_type,
+                        const struct ble_gap_adv_params *adv_params,
+                        const struct ble_gap_disc_params *disc_params,
+                        const struct ble_gap_multi_params *multi_params,
+                        ble_gap_event_fn *cb, void *cb_arg);
+int ble_gap_multi_stop(void);
+int ble_gap_multi_active(void);
 int ble_gap_connect(uint8_t own_addr_type,
                     uint8_t peer_addr_type, const uint8_t *peer_addr,
                     int32_t duration_ms,
@@ -556,6 +622,9 @@ int ble_gap_wl_set(const struct ble_gap_white_entry *white_list,
 int ble_gap_update_params(uint16_t conn_handle,
                           const struct ble_gap_upd_params *params);
 int ble_gap_dbg_update_active(uint16_t conn_handle);
+int ble_gap_tune(uint16_t conn_handle,
+                 const struct ble_gap_tune_params *params);
+int ble_gap_tune_profile(uint16_t conn_handle, uint8_t *out_profile);
 int ble_gap_security_initiate(uint16_t conn_handle);
 int ble_gap_pair_initiate(uint16_t conn_handle);
 int ble_gap_encryption_initiate(uint16_t conn_handle, const uint8_t *ltk,
@@ -22,6 +22,7 @@
 
 #include <inttypes.h>
 #include "host/ble_att.h"
+#include "host/ble_uuid.h"
 struct ble_hs_conn;
 struct ble_att_error_rsp;
 struct ble_hs_cfg;
@@ -183,6 +184,8 @@ int ble_gattc_write_reliable(uint16_t conn_handle,
 int ble_gattc_notify_custom(uint16_t conn_handle, uint16_t att_handle,
                             struct os_mbuf *om);
 int ble_gattc_notify(uint16_t conn_handle, uint16_t chr_val_handle);
+int ble_gattc_notify_multi(const uint16_t *conn_handles, int num_conns,
+                           uint16_t chr_val_handle);
 int ble_gattc_indicate(uint16_t conn_handle, uint16_t chr_val_handle);
 
 int ble_gattc_init(void);
@@ -221,6 +224,18 @@ struct ble_gatt_chr_def {
     /** Specifies the set of permitted operations for this characteristic. */
     ble_gatt_chr_flags flags;
 
+    /**
+     * Optional constant value.  If non-NULL, the host serves reads of the
+     * characteristic value straight from this buffer without calling
+     * access_cb.  access_cb may be NULL if the characteristic is not
+     * writable.  The buffer must remain valid for as long as the
+     * characteristic is registered.
+     */
+    const void *static_val;
+
+    /** Length of static_val, in bytes. */
+    uint16_t static_val_len;
+
     /** 
      * At registration time, this is filled in with the characteristic's value
      * attribute handle.
@@ -272,6 +287,16 @@ struct ble_gatt_dsc_def {
 
     /** Optional argument for callback. */
     void *arg;
+
+    /**
+     * Optional constant value.  If non-NULL, the host serves reads of the
+     * descriptor straight from this buffer without calling access_cb.
+     * access_cb may be NULL if the descriptor is not writable.
+     */
+    const void *static_val;
+
+    /** Length of static_val, in bytes. */
+    uint16_t static_val_len;
 };
 
 /**
@@ -447,4 +472,92 @@ int ble_gatts_find_chr(const void *svc_uuid128, const void *chr_uuid128,
 int ble_gatts_find_dsc(const void *svc_uuid128, const void *chr_uuid128,
                        const void *dsc_uuid128, uint16_t *out_dsc_handle);
 
+/*** @server flash table. */
+
+/*
+ * A GATT database can be laid out at compile time as a const array of
+ * attributes built with the BLE_GATTS_TBL_[...] macros below, and handed to
+ * ble_gatts_set_tbl() instead of registering its services.  The attribute at
+ * index i gets handle i + 1; no RAM is used per attribute, only the CCCD
+ * state is kept in RAM.  Services registered in the usual way get handles
+ * following the table.
+ *
+ * The service, characteristic and descriptor definitions are referenced by
+ * the table, so they must be named objects (not compound literals).  The
+ * attribute UUIDs and flags given to the macros must agree with the
+ * definitions; this is checked when the host is initialized.  Include
+ * declarations are not supported.
+ *
+ *     static const struct ble_att_svr_entry gatt_tbl[] = {
+ *         BLE_GATTS_TBL_PRIMARY(&svc),
+ *         BLE_GATTS_TBL_CHR(&chrs[0], BLE_GATTS_TBL_UUID16(0x2a19),
+ *                           BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY),
+ *         BLE_GATTS_TBL_CCCD(),
+ *         BLE_GATTS_TBL_DSC(&dscs[0], BLE_GATTS_TBL_UUID16(0x2904),
+ *                           BLE_ATT_F_READ),
+ *     };
+ */
+
+/* Attribute UUIDs; a UUID derived from the Bluetooth base UUID must be given
+ * in its 16- or 32-bit form.
+ */
+#define BLE_GATTS_TBL_UUID16(uuid16)                                        \
+    .ha_uuid_type = BLE_UUID_TYPE_16, .ha_uuid = (uuid16)
+#define BLE_GATTS_TBL_UUID32(uuid32)                                        \
+    .ha_uuid_type = BLE_UUID_TYPE_32, .ha_uuid = (uuid32)
+#define BLE_GATTS_TBL_UUID128(uuid128)                                      \
+    .ha_uuid_type = BLE_UUID_TYPE_128, .ha_uuid128 = (uuid128)
+
+/* ATT permissions of a characteristic value with the specified flags. */
+#define BLE_GATTS_TBL_ATT_FLAGS(chr_flags) (                                \
+    ((chr_flags) & BLE_GATT_CHR_F_READ ? BLE_ATT_F_READ : 0) |              \
+    ((chr_flags) & (BLE_GATT_CHR_F_WRITE_NO_RSP | BLE_GATT_CHR_F_WRITE) ?   \
+        BLE_ATT_F_WRITE : 0) |                                              \
+    ((chr_flags) & BLE_GATT_CHR_F_READ_ENC ? BLE_ATT_F_READ_ENC : 0) |      \
+    ((chr_flags) & BLE_GATT_CHR_F_READ_AUTHEN ? BLE_ATT_F_READ_AUTHEN : 0) |\
+    ((chr_flags) & BLE_GATT_CHR_F_READ_AUTHOR ? BLE_ATT_F_READ_AUTHOR : 0) |\
+    ((chr_flags) & BLE_GATT_CHR_F_WRITE_ENC ? BLE_ATT_F_WRITE_ENC : 0) |    \
+    ((chr_flags) & BLE_GATT_CHR_F_WRITE_AUTHEN ? BLE_ATT_F_WRITE_AUTHEN : 0) |\
+    ((chr_flags) & BLE_GATT_CHR_F_WRITE_AUTHOR ? BLE_ATT_F_WRITE_AUTHOR : 0))
+
+/* The trailing argument is one of the BLE_GATTS_TBL_UUID[...] macros. */
+#define BLE_GATTS_TBL_ATTR(flags, cb, arg, ...)                             \
+    { __VA_ARGS__, .ha_flags = (flags), .ha_cb = (cb),                      \
+      .ha_cb_arg = (void *)(arg) }
+
+/* Service declaration. */
+#define BLE_GATTS_TBL_PRIMARY(svc)                                          \
+    BLE_GATTS_TBL_ATTR(BLE_ATT_F_READ, ble_gatts_svc_access, (svc),         \
+                       BLE_GATTS_TBL_UUID16(BLE_ATT_UUID_PRIMARY_SERVICE))
+#define BLE_GATTS_TBL_SECONDARY(svc)                                        \
+    BLE_GATTS_TBL_ATTR(BLE_ATT_F_READ, ble_gatts_svc_access, (svc),         \
+                       BLE_GATTS_TBL_UUID16(BLE_ATT_UUID_SECONDARY_SERVICE))
+
+/* Characteristic declaration and value; two attributes. */
+#define BLE_GATTS_TBL_CHR(chr, uuid, chr_flags)                             \
+    BLE_GATTS_TBL_ATTR(BLE_ATT_F_READ, ble_gatts_chr_def_access, (chr),     \
+                       BLE_GATTS_TBL_UUID16(BLE_ATT_UUID_CHARACTERISTIC)),  \
+    BLE_GATTS_TBL_ATTR(BLE_GATTS_TBL_ATT_FLAGS(chr_flags),                  \
+                       ble_gatts_chr_val_access, (chr), uuid)
+
+/* Client characteristic configuration descriptor; must immediately follow
+ * the value of a characteristic which can be notified or indicated.
+ */
+#define BLE_GATTS_TBL_CCCD()                                                \
+    BLE_GATTS_TBL_ATTR(BLE_ATT_F_READ | BLE_ATT_F_WRITE,                    \
+                       ble_gatts_clt_cfg_access, NULL,                      \
+                       BLE_GATTS_TBL_UUID16(BLE_GATT_DSC_CLT_CFG_UUID16))
+
+/* Descriptor of the preceding characteristic. */
+#define BLE_GATTS_TBL_DSC(dsc, uuid, att_flags)                             \
+    BLE_GATTS_TBL_ATTR((att_flags), ble_gatts_dsc_access, (dsc), uuid)
+
+ble_att_svr_access_fn ble_gatts_svc_access;
+ble_att_svr_access_fn ble_gatts_chr_def_access;
+ble_att_svr_access_fn ble_gatts_chr_val_access;
+ble_att_svr_access_fn ble_gatts_clt_cfg_access;
+ble_att_svr_access_fn ble_gatts_dsc_access;
+
+int ble_gatts_set_tbl(const struct ble_att_svr_entry *attrs, int num_attrs);
+
 #endif
@@ -29,6 +29,7 @@
 #include "host/ble_hs_adv.h"
 #include "host/ble_hs_id.h"
 #include "host/ble_hs_log.h"
+#include "host/ble_hs_mem.h"
 #include "host/ble_hs_test.h"
 #include "host/ble_hs_mbuf.h"
 #include "host/ble_sm.h"
@@ -92,6 +93,12 @@ struct os_event;
 
 typedef void ble_hs_reset_fn(int reason);
 typedef void ble_hs_sync_fn(void);
+typedef int ble_hs_aes_fn(const uint8_t *key, const uint8_t *plaintext,
+                          uint8_t *enc_data);
+typedef int ble_hs_ecc_gen_key_pair_fn(uint8_t *pub, uint8_t *priv);
+typedef int ble_hs_ecc_gen_dhkey_fn(const uint8_t *peer_pub_x,
+                                    const uint8_t *peer_pub_y,
+                                    const uint8_t *priv, uint8_t *out_dhkey);
 
 struct ble_hs_cfg {
     /**
@@ -104,6 +111,14 @@ struct ble_hs_cfg {
      */
     uint8_t max_hci_bufs;
 
+    /**
+     * The maximum number of incoming ACL data packets the host processes
+     * before it checks for pending HCI events again.  HCI events (connection
+     * updates, disconnects, etc.) are always handled ahead of ACL data; this
+     * bound keeps a burst of data from delaying them.  0 means no limit.
+     */
+    uint8_t max_acl_per_pass;
+
     /*** Connection settings. */
     /**
      * The maximum number of concurrent connections.  This is set
@@ -112,6 +127,28 @@ struct ble_hs_cfg {
      */
     uint8_t max_connections;
 
+    /**
+     * The maximum number of msys mbufs that a single connection's outgoing
+     * data may occupy while it waits for controller buffers.  A connection
+     * at its quota is refused new ATT transactions and L2CAP channel data
+     * (BLE_HS_ENOMEM) until its queue drains; the peer's ATT requests are
+     * answered with an "Insufficient Resources" error and its write commands
+     * are dropped.  Security manager and L2CAP signalling traffic is exempt.
+     * This keeps one slow or misbehaving peer from draining the pool shared
+     * by all connections.  0 means no limit.
+     */
+    uint8_t max_conn_tx_mbufs;
+
+    /**
+     * The maximum number of msys mbufs that a single connection's partially
+     * reassembled incoming L2CAP packet may occupy.  With a limit set,
+     * fragments are copied into the reassembly buffer rather than chained,
+     * so a peer sending many small fragments cannot pin one mbuf per
+     * fragment; a packet that still does not fit is dropped.  0 means no
+     * limit.
+     */
+    uint8_t max_conn_rx_mbufs;
+
     /*** GATT server settings. */
     /**
      * These are acquired at service registration time and never freed.  You
@@ -174,24 +211,37 @@ struct ble_hs_cfg {
      */
     uint8_t max_prep_entries;
 
+    /**
+     * The maximum number of bytes of attribute data a single connection may
+     * hold in its prepare queue.  Queued data stays in the received mbufs
+     * until the peer executes or cancels the queue, so this bounds the
+     * msys blocks one peer can pin.
+     */
+    uint16_t max_prep_write_len;
+
     /*** L2CAP settings. */
     /**
      * Each connection requires three L2CAP channels (signal, ATT, and security
-     * manager).  In addition, the nimble host may allow channels to be created
-     * "on the fly" (connection-oriented channels).  This functionality is not
-     * available at the moment, so a safe formula to use is:
-     *     (max-connections * 3)
+     * manager).  In addition, each open LE credit based connection-oriented
+     * channel uses one, so a safe formula to use is:
+     *     (max-connections * 3) + max-coc-channels
      */
     uint8_t max_l2cap_chans;
 
     /**
-     * The maximum number of concurrent L2CAP signalling procedures.  Only one
-     * L2CAP signalling procedure is supported: slave-initiated connection
-     * update.  You will never need more of these than the max number of
-     * connections.
+     * The maximum number of concurrent L2CAP signalling procedures.  Each
+     * slave-initiated connection update, LE credit based connection, and
+     * channel disconnection in progress uses one.
      */
     uint8_t max_l2cap_sig_procs;
 
+    /**
+     * The maximum number of PSMs accepting LE credit based connections
+     * (ble_l2cap_coc_create_server()).  Zero disables incoming
+     * connection-oriented channels.
+     */
+    uint8_t max_l2cap_coc_servers;
+
     /**
      * The maximum number of concurrent security manager procedures.  Security
      * manager procedures include pairing and restoration of a bonded link.
@@ -208,6 +258,37 @@ struct ble_hs_cfg {
     uint8_t sm_our_key_dist;
     uint8_t sm_their_key_dist;
 
+    /**
+     * Optional AES-128 block cipher used by the security manager instead of
+     * the software implementation; e.g., the nRF5x ECB peripheral.  All
+     * pairing functions, including the AES-CMAC based LE Secure Connections
+     * functions, are built on it.  Key, plaintext, and ciphertext are in
+     * FIPS-197 byte order (most significant octet first).  If the callback
+     * returns nonzero, the block is encrypted in software instead.
+     */
+    ble_hs_aes_fn *sm_aes_cb;
+
+    /**
+     * Optional P-256 implementation used for LE Secure Connections in place
+     * of the built-in one.  Keys are in the little-endian format of the
+     * pairing public key PDU: pub is 64 bytes (X then Y), priv and the DH key
+     * are 32 bytes.  Both callbacks return 0 on success; a generated key
+     * pair must not be the debug key pair.
+     */
+    ble_hs_ecc_gen_key_pair_fn *sm_ecc_gen_key_pair_cb;
+    ble_hs_ecc_gen_dhkey_fn *sm_ecc_gen_dhkey_cb;
+
+    /**
+     * The priority and stack size (in os_stack_t units) of the task that
+     * performs LE Secure Connections P-256 computations: key pair generation
+     * and DH key calculation.  The task should have a lower priority than the
+     * host's parent task, which then keeps processing other events while a
+     * computation is in progress.  A stack size of 0 disables the task; the
+     * computations are then performed synchronously by the parent task.
+     */
+    uint8_t sm_sc_task_prio;
+    uint16_t sm_sc_task_stack_size;
+
     /*** HCI settings */
     /**
      * This callback is executed when the host resets itself and the controller
@@ -243,5 +324,6 @@ extern const struct ble_hs_cfg ble_hs_cfg_dflt;
 int ble_hs_synced(void);
 int ble_hs_start(void);
 int ble_hs_init(struct os_eventq *app_evq, struct ble_hs_cfg *cfg);
+int ble_hs_rand(void *dst, int len);
 
 #endif
@@ -174,4 +174,19 @@ struct ble_hs_adv_fields {
 
 #define BLE_HS_ADV_SVC_DATA_UUID128_MIN_LEN     16
 
+/** A single field within encoded advertising data. */
+struct ble_hs_adv_field {
+    uint8_t type;
+    uint8_t value_len;
+    const uint8_t *value;
+};
+
+typedef int ble_hs_adv_parse_fn(const struct ble_hs_adv_field *field,
+                                void *arg);
+
+int ble_hs_adv_parse(const uint8_t *data, uint8_t length,
+                     ble_hs_adv_parse_fn *cb, void *cb_arg);
+int ble_hs_adv_find(const uint8_t *data, uint8_t length, uint8_t type,
+                    struct ble_hs_adv_field *out_field);
+
 #endif
@@ -0,0 +1,56 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_HS_MEM_
+#define H_BLE_HS_MEM_
+
+#include <inttypes.h>
+struct ble_hs_cfg;
+
+/**
+ * RAM consumed by one of the host's preallocated resources, as sized by a
+ * ble_hs_cfg count.
+ */
+struct ble_hs_mem_pool {
+    const char *name;
+
+    /** Size of one element, in bytes. */
+    uint16_t elem_size;
+
+    /** Number of elements; the ble_hs_cfg count the resource is sized by. */
+    uint16_t num_elems;
+
+    /** Total bytes allocated for the resource, including alignment padding. */
+    uint32_t bytes;
+
+    /**
+     * Runtime statistics; only filled in for memory pools of the running
+     * host.  max_used is the most elements that were ever allocated at once;
+     * num_fail counts allocations that failed because the pool was empty.
+     */
+    uint16_t max_used;
+    uint32_t num_fail;
+};
+
+int ble_hs_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                    struct ble_hs_mem_pool *out_pool);
+uint32_t ble_hs_mem_total(const struct ble_hs_cfg *cfg);
+void ble_hs_mem_report(const struct ble_hs_cfg *cfg);
+
+#endif
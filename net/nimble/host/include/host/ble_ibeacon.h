@@ -21,5 +21,6 @@
 #define H_BLE_IBEACON_
 
 int ble_ibeacon_set_adv_data(void *uuid128, uint16_t major, uint16_t minor);
+int ble_ibeacon_update_adv_data(uint16_t major, uint16_t minor);
 
 #endif
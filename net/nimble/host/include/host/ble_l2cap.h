@@ -23,6 +23,7 @@
 #include "nimble/nimble_opt.h"
 struct ble_l2cap_sig_update_req;
 struct ble_hs_conn;
+struct os_mbuf;
 
 #define BLE_L2CAP_SIG_OP_REJECT                 0x01
 #define BLE_L2CAP_SIG_OP_CONNECT_REQ            0x02
@@ -52,6 +53,20 @@ struct ble_hs_conn;
 #define BLE_L2CAP_SIG_ERR_MTU_EXCEEDED          0x0001
 #define BLE_L2CAP_SIG_ERR_INVALID_CID           0x0002
 
+/** LE credit based connection response results. */
+#define BLE_L2CAP_COC_ERR_NO_PSM                0x0002
+#define BLE_L2CAP_COC_ERR_NO_RESOURCES          0x0004
+#define BLE_L2CAP_COC_ERR_INSUFFICIENT_AUTHEN   0x0005
+#define BLE_L2CAP_COC_ERR_INSUFFICIENT_AUTHOR   0x0006
+#define BLE_L2CAP_COC_ERR_INSUFFICIENT_KEY_SZ   0x0007
+#define BLE_L2CAP_COC_ERR_INSUFFICIENT_ENC      0x0008
+#define BLE_L2CAP_COC_ERR_INVALID_SOURCE_CID    0x0009
+#define BLE_L2CAP_COC_ERR_SOURCE_CID_USED       0x000a
+#define BLE_L2CAP_COC_ERR_UNACCEPTABLE_PARAMS   0x000b
+
+/** The smallest SDU size an LE credit based channel may use. */
+#define BLE_L2CAP_COC_MTU_MIN                   23
+
 typedef void ble_l2cap_sig_update_fn(uint16_t conn_handle, int status,
                                      void *arg);
 
@@ -66,4 +81,67 @@ int ble_l2cap_sig_update(uint16_t conn_handle,
                          struct ble_l2cap_sig_update_params *params,
                          ble_l2cap_sig_update_fn *cb, void *cb_arg);
 
+/*** LE credit based connection-oriented channels. */
+
+#define BLE_L2CAP_COC_EVENT_CONNECT             0
+#define BLE_L2CAP_COC_EVENT_DISCONNECT          1
+#define BLE_L2CAP_COC_EVENT_RX                  2
+
+struct ble_l2cap_coc_event {
+    uint8_t type;
+    uint16_t conn_handle;
+
+    /** The local CID of the channel. */
+    uint16_t cid;
+
+    union {
+        /**
+         * Represents a completed channel establishment attempt, whether we or
+         * the peer initiated it.  Valid for the following event types:
+         *     o BLE_L2CAP_COC_EVENT_CONNECT
+         */
+        struct {
+            /**
+             * 0: The channel is open.
+             * BLE_HS_L2C_ERR(<result>): The peer refused the connection; the
+             *     result is one of the BLE_L2CAP_COC_ERR_[...] codes.
+             * Other nonzero: The procedure failed; the channel does not
+             *     exist.
+             */
+            int status;
+
+            /** The largest SDU the peer accepts. */
+            uint16_t peer_mtu;
+        } connect;
+
+        /**
+         * Represents a complete SDU received over the channel.  The host
+         * frees the SDU after the callback returns; the application must
+         * copy any data it wants to keep.  Valid for the following event
+         * types:
+         *     o BLE_L2CAP_COC_EVENT_RX
+         */
+        struct {
+            struct os_mbuf *sdu;
+        } rx;
+    };
+};
+
+/**
+ * Called for each connection-oriented channel event.  A disconnect event
+ * (BLE_L2CAP_COC_EVENT_DISCONNECT) has no additional fields; it is reported
+ * when the channel closes for any reason, including the underlying
+ * connection terminating.
+ */
+typedef int ble_l2cap_coc_event_fn(struct ble_l2cap_coc_event *event,
+                                   void *arg);
+
+int ble_l2cap_coc_create_server(uint16_t psm, uint16_t mtu,
+                                ble_l2cap_coc_event_fn *cb, void *cb_arg);
+int ble_l2cap_coc_connect(uint16_t conn_handle, uint16_t psm, uint16_t mtu,
+                          ble_l2cap_coc_event_fn *cb, void *cb_arg);
+int ble_l2cap_coc_disconnect(uint16_t conn_handle, uint16_t cid);
+int ble_l2cap_coc_send(uint16_t conn_handle, uint16_t cid,
+                       struct os_mbuf *sdu);
+
 #endif
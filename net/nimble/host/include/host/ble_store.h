@@ -25,6 +25,7 @@
 #define BLE_STORE_OBJ_TYPE_OUR_SEC      1
 #define BLE_STORE_OBJ_TYPE_PEER_SEC     2
 #define BLE_STORE_OBJ_TYPE_CCCD         3
+#define BLE_STORE_OBJ_TYPE_GATT         4
 
 #define BLE_STORE_ADDR_TYPE_NONE        0xff
 
@@ -118,6 +119,65 @@ struct ble_store_value_cccd {
     unsigned value_changed:1;
 };
 
+/** Cached GATT attribute types (ble_store_value_gatt.type). */
+#define BLE_STORE_GATT_TYPE_DB          0   /* Service list is complete. */
+#define BLE_STORE_GATT_TYPE_SVC         1
+#define BLE_STORE_GATT_TYPE_CHR         2
+#define BLE_STORE_GATT_TYPE_DSC         3
+#define BLE_STORE_GATT_TYPE_ANY         0xff
+
+/**
+ * Cached GATT attribute flags; BLE_STORE_GATT_F_COMPLETE indicates that all
+ * characteristics of the service, or all descriptors of the characteristic,
+ * are cached as well.
+ */
+#define BLE_STORE_GATT_F_COMPLETE       0x01
+
+/**
+ * Used as a key for lookups of a bonded peer's cached GATT database.  This
+ * struct corresponds to the BLE_STORE_OBJ_TYPE_GATT store object type.
+ */
+struct ble_store_key_gatt {
+    /**
+     * Key by peer identity address;
+     * peer_addr_type=BLE_STORE_ADDR_TYPE_NONE means don't key off peer.
+     */
+    uint8_t peer_addr[6];
+    uint8_t peer_addr_type;
+
+    /**
+     * Key by attribute type and handle;
+     * type=BLE_STORE_GATT_TYPE_ANY means don't key off attribute.
+     */
+    uint8_t type;
+    uint16_t handle;
+
+    /** Number of results to skip; 0 means retrieve the first match. */
+    uint8_t idx;
+};
+
+/**
+ * Represents a cached service, characteristic or descriptor of a bonded peer.
+ * This struct corresponds to the BLE_STORE_OBJ_TYPE_GATT store object type.
+ */
+struct ble_store_value_gatt {
+    uint8_t peer_addr[6];
+    uint8_t peer_addr_type;
+    uint8_t type;               /* BLE_STORE_GATT_TYPE_[...] */
+    uint8_t flags;              /* BLE_STORE_GATT_F_[...] */
+    uint8_t properties;         /* Characteristic properties. */
+
+    /**
+     * Service: start and end handle; characteristic: definition handle and
+     * last handle of its descriptors (0 until they are cached); descriptor:
+     * handle.
+     */
+    uint16_t handle;
+    uint16_t end_handle;
+    uint16_t val_handle;        /* Characteristic value handle. */
+    uint8_t uuid128[16];
+};
+
 /**
  * Used as a key for store lookups.  This union must be accompanied by an
  * object type code to indicate which field is valid.
@@ -125,6 +185,7 @@ struct ble_store_value_cccd {
 union ble_store_key {
     struct ble_store_key_sec sec;
     struct ble_store_key_cccd cccd;
+    struct ble_store_key_gatt gatt;
 };
 
 /**
@@ -134,6 +195,7 @@ union ble_store_key {
 union ble_store_value {
     struct ble_store_value_sec sec;
     struct ble_store_value_cccd cccd;
+    struct ble_store_value_gatt gatt;
 };
 
 /**
@@ -197,16 +259,25 @@ int ble_store_write_our_sec(struct ble_store_value_sec *value_sec);
 int ble_store_read_peer_sec(struct ble_store_key_sec *key_sec,
                             struct ble_store_value_sec *value_sec);
 int ble_store_write_peer_sec(struct ble_store_value_sec *value_sec);
+int ble_store_delete_peer_sec(struct ble_store_key_sec *key_sec);
 
 int ble_store_read_cccd(struct ble_store_key_cccd *key,
                         struct ble_store_value_cccd *out_value);
 int ble_store_write_cccd(struct ble_store_value_cccd *value);
 int ble_store_delete_cccd(struct ble_store_key_cccd *key);
 
+int ble_store_read_gatt(struct ble_store_key_gatt *key,
+                        struct ble_store_value_gatt *out_value);
+int ble_store_write_gatt(struct ble_store_value_gatt *value);
+int ble_store_delete_gatt(struct ble_store_key_gatt *key);
+int ble_store_clear_gatt(uint8_t peer_addr_type, const uint8_t *peer_addr);
+
 void ble_store_key_from_value_sec(struct ble_store_key_sec *out_key,
                                   struct ble_store_value_sec *value);
 void ble_store_key_from_value_cccd(struct ble_store_key_cccd *out_key,
                                    struct ble_store_value_cccd *value);
+void ble_store_key_from_value_gatt(struct ble_store_key_gatt *out_key,
+                                   struct ble_store_value_gatt *value);
 
 typedef int ble_store_iterator_fn(int obj_type,
                                   union ble_store_value *val,
@@ -23,6 +23,11 @@
 #include <inttypes.h>
 struct os_mbuf;
 
+/* Type of a compact UUID is its length in bytes. */
+#define BLE_UUID_TYPE_16        2
+#define BLE_UUID_TYPE_32        4
+#define BLE_UUID_TYPE_128       16
+
 uint16_t ble_uuid_128_to_16(const void *uuid128);
 int ble_uuid_16_to_128(uint16_t uuid16, void *dst);
 
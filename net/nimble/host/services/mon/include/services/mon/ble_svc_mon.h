@@ -0,0 +1,96 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_SVC_MON_
+#define H_BLE_SVC_MON_
+
+#include <inttypes.h>
+#include <os/os.h>
+
+struct ble_hs_cfg;
+struct ble_gap_event;
+struct log_handler;
+struct stats_hdr;
+
+/*
+ * Monitoring service. Peers subscribe to stats groups and to log entries
+ * at or above a level, and are sent notifications with what changed instead
+ * of polling newtmgr.
+ *
+ * Characteristics:
+ *   o Groups (read): names of the streamable stats groups, each followed
+ *     by a NUL. The position of a name is its group index.
+ *   o Control (read, write): the subscription of the connection, a
+ *     little-endian uint32 mask of group indices followed by the minimum
+ *     log level (BLE_SVC_MON_LOG_OFF for none).
+ *   o Data (notify): records, one or more per notification, described
+ *     below. Nothing is sent until the peer enables notifications.
+ *
+ * Stats record, for the counters of a group which changed during the last
+ * period:
+ *     u8 BLE_SVC_MON_REC_STATS, u8 group index, u8 pair count,
+ *     <count> pairs of counter index and change since the previous record,
+ *     both base 128 varints (low 7 bits first, top bit set if more follow).
+ * A group with many changes is split over several records.
+ *
+ * Log record:
+ *     u8 BLE_SVC_MON_REC_LOG, u8 body length, struct log_entry_hdr
+ *     (little-endian), then the entry body, truncated to fit.
+ */
+extern const uint8_t ble_svc_mon_uuid128[16];
+extern const uint8_t ble_svc_mon_chr_groups_uuid128[16];
+extern const uint8_t ble_svc_mon_chr_ctrl_uuid128[16];
+extern const uint8_t ble_svc_mon_chr_data_uuid128[16];
+
+#define BLE_SVC_MON_REC_STATS       0
+#define BLE_SVC_MON_REC_LOG         1
+
+#define BLE_SVC_MON_LOG_OFF         0xff
+
+#define BLE_SVC_MON_MAX_GROUPS      32
+
+/* Connections which can subscribe at the same time. */
+#ifndef BLE_SVC_MON_MAX_SUBS
+#define BLE_SVC_MON_MAX_SUBS        (2)
+#endif
+
+/* Largest notification sent, further limited by the ATT MTU. */
+#ifndef BLE_SVC_MON_NOTIFY_MAX
+#define BLE_SVC_MON_NOTIFY_MAX      (64)
+#endif
+
+struct ble_svc_mon_cfg {
+    /*
+     * Streamable groups. Snapshots must be enabled for each of them, and
+     * belong to the service from then on; see stats_snap_enable().
+     */
+    struct stats_hdr **groups;
+    uint8_t group_cnt;
+
+    /* Stats changes are collected every period ticks, on this queue. */
+    struct os_eventq *evq;
+    os_time_t period;
+};
+
+int ble_svc_mon_init(struct ble_hs_cfg *cfg,
+                     const struct ble_svc_mon_cfg *mon_cfg);
+void ble_svc_mon_on_gap_event(struct ble_gap_event *event);
+int ble_svc_mon_log_handler_init(struct log_handler *handler);
+
+#endif
@@ -0,0 +1,581 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "host/ble_hs.h"
+#include "stats/stats.h"
+#include "log/log.h"
+#include "services/mon/ble_svc_mon.h"
+
+/* 8d5e2a40-3c1b-4f7e-9a2d-6b0c1e4f5a10 */
+const uint8_t ble_svc_mon_uuid128[16] = {
+    0x10, 0x5a, 0x4f, 0x1e, 0x0c, 0x6b, 0x2d, 0x9a,
+    0x7e, 0x4f, 0x1b, 0x3c, 0x40, 0x2a, 0x5e, 0x8d
+};
+
+/* 8d5e2a41-3c1b-4f7e-9a2d-6b0c1e4f5a10 */
+const uint8_t ble_svc_mon_chr_groups_uuid128[16] = {
+    0x10, 0x5a, 0x4f, 0x1e, 0x0c, 0x6b, 0x2d, 0x9a,
+    0x7e, 0x4f, 0x1b, 0x3c, 0x41, 0x2a, 0x5e, 0x8d
+};
+
+/* 8d5e2a42-3c1b-4f7e-9a2d-6b0c1e4f5a10 */
+const uint8_t ble_svc_mon_chr_ctrl_uuid128[16] = {
+    0x10, 0x5a, 0x4f, 0x1e, 0x0c, 0x6b, 0x2d, 0x9a,
+    0x7e, 0x4f, 0x1b, 0x3c, 0x42, 0x2a, 0x5e, 0x8d
+};
+
+/* 8d5e2a43-3c1b-4f7e-9a2d-6b0c1e4f5a10 */
+const uint8_t ble_svc_mon_chr_data_uuid128[16] = {
+    0x10, 0x5a, 0x4f, 0x1e, 0x0c, 0x6b, 0x2d, 0x9a,
+    0x7e, 0x4f, 0x1b, 0x3c, 0x43, 0x2a, 0x5e, 0x8d
+};
+
+/* Control characteristic value: group mask and log level. */
+#define BLE_SVC_MON_CTRL_LEN        5
+
+#define BLE_SVC_MON_STATS_HDR_LEN   3
+#define BLE_SVC_MON_LOG_HDR_LEN     (2 + LOG_ENTRY_HDR_SIZE)
+
+/* Longest index/change pair: 16-bit index and 64-bit change as varints. */
+#define BLE_SVC_MON_PAIR_MAX        (3 + 10)
+
+struct ble_svc_mon_sub {
+    uint16_t conn_handle;
+    uint8_t notify;
+    uint8_t log_level;
+    uint32_t group_mask;
+};
+
+/* Stats record being built by ble_svc_mon_delta_func(). */
+struct ble_svc_mon_rec {
+    uint8_t buf[BLE_SVC_MON_NOTIFY_MAX];
+    uint16_t len;
+    uint16_t max_len;
+    uint8_t group;
+};
+
+static struct ble_svc_mon_cfg ble_svc_mon_cfg;
+static struct ble_svc_mon_sub ble_svc_mon_subs[BLE_SVC_MON_MAX_SUBS];
+static struct os_callout_func ble_svc_mon_timer;
+static uint16_t ble_svc_mon_data_handle;
+
+static int
+ble_svc_mon_access(uint16_t conn_handle, uint16_t attr_handle,
+                   struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+static const struct ble_gatt_svc_def ble_svc_mon_defs[] = {
+    {
+        /*** Service: Monitoring. */
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid128 = ble_svc_mon_uuid128,
+        .characteristics = (struct ble_gatt_chr_def[]) { {
+            /*** Characteristic: Groups. */
+            .uuid128 = ble_svc_mon_chr_groups_uuid128,
+            .access_cb = ble_svc_mon_access,
+            .flags = BLE_GATT_CHR_F_READ,
+        }, {
+            /*** Characteristic: Control. */
+            .uuid128 = ble_svc_mon_chr_ctrl_uuid128,
+            .access_cb = ble_svc_mon_access,
+            .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+        }, {
+            /*** Characteristic: Data. */
+            .uuid128 = ble_svc_mon_chr_data_uuid128,
+            .access_cb = ble_svc_mon_access,
+            .val_handle = &ble_svc_mon_data_handle,
+            .flags = BLE_GATT_CHR_F_NOTIFY,
+        }, {
+            0, /* No more characteristics in this service. */
+        } },
+    },
+
+    {
+        0, /* No more services. */
+    },
+};
+
+static struct ble_svc_mon_sub *
+ble_svc_mon_sub_find(uint16_t conn_handle)
+{
+    int i;
+
+    for (i = 0; i < BLE_SVC_MON_MAX_SUBS; i++) {
+        if (ble_svc_mon_subs[i].conn_handle == conn_handle) {
+            return &ble_svc_mon_subs[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Finds the subscription of a connection, claiming a free one if the
+ * connection has none.
+ */
+static struct ble_svc_mon_sub *
+ble_svc_mon_sub_get(uint16_t conn_handle)
+{
+    struct ble_svc_mon_sub *sub;
+
+    sub = ble_svc_mon_sub_find(conn_handle);
+    if (sub == NULL) {
+        sub = ble_svc_mon_sub_find(BLE_HS_CONN_HANDLE_NONE);
+        if (sub != NULL) {
+            sub->conn_handle = conn_handle;
+            sub->notify = 0;
+            sub->log_level = BLE_SVC_MON_LOG_OFF;
+            sub->group_mask = 0;
+        }
+    }
+    return sub;
+}
+
+/**
+ * Returns the largest notification which can be sent over a connection.
+ */
+static uint16_t
+ble_svc_mon_max_len(uint16_t conn_handle)
+{
+    uint16_t mtu;
+
+    mtu = ble_att_mtu(conn_handle);
+    if (mtu < BLE_ATT_MTU_DFLT) {
+        mtu = BLE_ATT_MTU_DFLT;
+    }
+    mtu -= 3;
+    if (mtu > BLE_SVC_MON_NOTIFY_MAX) {
+        mtu = BLE_SVC_MON_NOTIFY_MAX;
+    }
+    return mtu;
+}
+
+static void
+ble_svc_mon_notify(uint16_t conn_handle, const void *buf, uint16_t len)
+{
+    struct os_mbuf *om;
+
+    om = ble_hs_mbuf_from_flat(buf, len);
+    if (om != NULL) {
+        ble_gattc_notify_custom(conn_handle, ble_svc_mon_data_handle, om);
+    }
+}
+
+static void
+ble_svc_mon_rec_send(struct ble_svc_mon_rec *rec)
+{
+    struct ble_svc_mon_sub *sub;
+    int i;
+
+    for (i = 0; i < BLE_SVC_MON_MAX_SUBS; i++) {
+        sub = &ble_svc_mon_subs[i];
+        if (sub->conn_handle != BLE_HS_CONN_HANDLE_NONE && sub->notify &&
+          (sub->group_mask & (1UL << rec->group))) {
+            ble_svc_mon_notify(sub->conn_handle, rec->buf, rec->len);
+        }
+    }
+    rec->len = BLE_SVC_MON_STATS_HDR_LEN;
+    rec->buf[2] = 0;
+}
+
+static int
+ble_svc_mon_put_varint(uint8_t *buf, uint64_t val)
+{
+    int len;
+
+    len = 0;
+    do {
+        buf[len] = val & 0x7f;
+        val >>= 7;
+        if (val) {
+            buf[len] |= 0x80;
+        }
+        len++;
+    } while (val);
+
+    return len;
+}
+
+static int
+ble_svc_mon_delta_func(struct stats_hdr *hdr, void *arg, char *name,
+                       uint16_t off, uint64_t delta)
+{
+    struct ble_svc_mon_rec *rec;
+    uint8_t pair[BLE_SVC_MON_PAIR_MAX];
+    int len;
+
+    rec = arg;
+    len = ble_svc_mon_put_varint(pair, (off - sizeof(*hdr)) / hdr->s_size);
+    len += ble_svc_mon_put_varint(pair + len, delta);
+
+    if (rec->len + len > rec->max_len || rec->buf[2] == UINT8_MAX) {
+        ble_svc_mon_rec_send(rec);
+    }
+    memcpy(rec->buf + rec->len, pair, len);
+    rec->len += len;
+    rec->buf[2]++;
+
+    return 0;
+}
+
+/**
+ * Sends the changes of a group since the previous period to the peers
+ * subscribed to it.
+ */
+static void
+ble_svc_mon_stats_send(uint8_t group)
+{
+    struct ble_svc_mon_rec rec;
+    struct ble_svc_mon_sub *sub;
+    uint16_t len;
+    int i;
+
+    rec.max_len = BLE_SVC_MON_NOTIFY_MAX;
+    for (i = 0; i < BLE_SVC_MON_MAX_SUBS; i++) {
+        sub = &ble_svc_mon_subs[i];
+        if (sub->conn_handle != BLE_HS_CONN_HANDLE_NONE && sub->notify &&
+          (sub->group_mask & (1UL << group))) {
+            len = ble_svc_mon_max_len(sub->conn_handle);
+            if (len < rec.max_len) {
+                rec.max_len = len;
+            }
+        }
+    }
+
+    rec.group = group;
+    rec.buf[0] = BLE_SVC_MON_REC_STATS;
+    rec.buf[1] = group;
+    rec.buf[2] = 0;
+    rec.len = BLE_SVC_MON_STATS_HDR_LEN;
+
+    stats_walk_delta(ble_svc_mon_cfg.groups[group], ble_svc_mon_delta_func,
+                     &rec);
+    if (rec.buf[2] != 0) {
+        ble_svc_mon_rec_send(&rec);
+    }
+}
+
+static void
+ble_svc_mon_tmo(void *arg)
+{
+    uint32_t mask;
+    int i;
+
+    mask = 0;
+    for (i = 0; i < BLE_SVC_MON_MAX_SUBS; i++) {
+        if (ble_svc_mon_subs[i].conn_handle != BLE_HS_CONN_HANDLE_NONE &&
+          ble_svc_mon_subs[i].notify) {
+            mask |= ble_svc_mon_subs[i].group_mask;
+        }
+    }
+
+    /*
+     * Groups nobody listens to are snapshotted too, so that a new
+     * subscriber only hears about changes from now on.
+     */
+    for (i = 0; i < ble_svc_mon_cfg.group_cnt; i++) {
+        if (mask & (1UL << i)) {
+            ble_svc_mon_stats_send(i);
+        }
+        stats_snap(ble_svc_mon_cfg.groups[i]);
+    }
+
+    os_callout_reset(&ble_svc_mon_timer.cf_c, ble_svc_mon_cfg.period);
+}
+
+static int
+ble_svc_mon_groups_read(struct os_mbuf *om)
+{
+    const char *name;
+    int rc;
+    int i;
+
+    for (i = 0; i < ble_svc_mon_cfg.group_cnt; i++) {
+        name = ble_svc_mon_cfg.groups[i]->s_name;
+        rc = os_mbuf_append(om, name, strlen(name) + 1);
+        if (rc != 0) {
+            return BLE_ATT_ERR_INSUFFICIENT_RES;
+        }
+    }
+    return 0;
+}
+
+static int
+ble_svc_mon_ctrl_read(uint16_t conn_handle, struct os_mbuf *om)
+{
+    struct ble_svc_mon_sub *sub;
+    uint8_t buf[BLE_SVC_MON_CTRL_LEN];
+    uint32_t mask;
+    int rc;
+
+    sub = ble_svc_mon_sub_find(conn_handle);
+    if (sub != NULL) {
+        mask = sub->group_mask;
+        buf[4] = sub->log_level;
+    } else {
+        mask = 0;
+        buf[4] = BLE_SVC_MON_LOG_OFF;
+    }
+    buf[0] = mask;
+    buf[1] = mask >> 8;
+    buf[2] = mask >> 16;
+    buf[3] = mask >> 24;
+
+    rc = os_mbuf_append(om, buf, sizeof buf);
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int
+ble_svc_mon_ctrl_write(uint16_t conn_handle, struct os_mbuf *om)
+{
+    struct ble_svc_mon_sub *sub;
+    uint8_t buf[BLE_SVC_MON_CTRL_LEN];
+    uint32_t mask;
+    int rc;
+
+    if (OS_MBUF_PKTLEN(om) != sizeof buf) {
+        return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    rc = ble_hs_mbuf_to_flat(om, buf, sizeof buf, NULL);
+    if (rc != 0) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    sub = ble_svc_mon_sub_get(conn_handle);
+    if (sub == NULL) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    mask = buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) |
+           ((uint32_t)buf[3] << 24);
+    if (ble_svc_mon_cfg.group_cnt < BLE_SVC_MON_MAX_GROUPS) {
+        /* Ignore groups which do not exist. */
+        mask &= (1UL << ble_svc_mon_cfg.group_cnt) - 1;
+    }
+
+    sub->group_mask = mask;
+    sub->log_level = buf[4];
+
+    return 0;
+}
+
+static int
+ble_svc_mon_access(uint16_t conn_handle, uint16_t attr_handle,
+                   struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    const struct ble_gatt_chr_def *chrs;
+
+    chrs = ble_svc_mon_defs[0].characteristics;
+
+    switch (ctxt->op) {
+    case BLE_GATT_ACCESS_OP_READ_CHR:
+        if (ctxt->chr == &chrs[0]) {
+            return ble_svc_mon_groups_read(ctxt->om);
+        }
+        if (ctxt->chr == &chrs[1]) {
+            return ble_svc_mon_ctrl_read(conn_handle, ctxt->om);
+        }
+        /* The data characteristic is notify only. */
+        return BLE_ATT_ERR_READ_NOT_PERMITTED;
+
+    case BLE_GATT_ACCESS_OP_WRITE_CHR:
+        assert(ctxt->chr == &chrs[1]);
+        return ble_svc_mon_ctrl_write(conn_handle, ctxt->om);
+
+    default:
+        assert(0);
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+/**
+ * Tracks subscriptions to the data characteristic. The application must
+ * pass its GAP events to this function; only BLE_GAP_EVENT_SUBSCRIBE and
+ * BLE_GAP_EVENT_DISCONNECT are looked at.
+ *
+ * @param event                 The GAP event received by the application.
+ */
+void
+ble_svc_mon_on_gap_event(struct ble_gap_event *event)
+{
+    struct ble_svc_mon_sub *sub;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        if (event->subscribe.attr_handle != ble_svc_mon_data_handle) {
+            break;
+        }
+        if (event->subscribe.cur_notify) {
+            sub = ble_svc_mon_sub_get(event->subscribe.conn_handle);
+        } else {
+            sub = ble_svc_mon_sub_find(event->subscribe.conn_handle);
+        }
+        if (sub != NULL) {
+            sub->notify = event->subscribe.cur_notify;
+        }
+        break;
+
+    case BLE_GAP_EVENT_DISCONNECT:
+        sub = ble_svc_mon_sub_find(event->disconnect.conn.conn_handle);
+        if (sub != NULL) {
+            sub->conn_handle = BLE_HS_CONN_HANDLE_NONE;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * Log handler which sends each entry to the peers subscribed to its level.
+ * Entries of the BLE host and controller are not sent, as sending them
+ * would log again.
+ */
+static int
+ble_svc_mon_log_append(struct log *log, void *buf, int len)
+{
+    struct ble_svc_mon_sub sub;
+    struct log_entry_hdr *hdr;
+    uint8_t rec[BLE_SVC_MON_NOTIFY_MAX];
+    uint16_t max_len;
+    int body_len;
+    int sr;
+    int i;
+
+    hdr = buf;
+    if (hdr->ue_module == LOG_MODULE_NIMBLE_HOST ||
+      hdr->ue_module == LOG_MODULE_NIMBLE_CTLR) {
+        return 0;
+    }
+
+    for (i = 0; i < BLE_SVC_MON_MAX_SUBS; i++) {
+        OS_ENTER_CRITICAL(sr);
+        sub = ble_svc_mon_subs[i];
+        OS_EXIT_CRITICAL(sr);
+
+        if (sub.conn_handle == BLE_HS_CONN_HANDLE_NONE || !sub.notify ||
+          sub.log_level == BLE_SVC_MON_LOG_OFF ||
+          hdr->ue_level < sub.log_level) {
+            continue;
+        }
+
+        max_len = ble_svc_mon_max_len(sub.conn_handle);
+        body_len = len - LOG_ENTRY_HDR_SIZE;
+        if (body_len > max_len - BLE_SVC_MON_LOG_HDR_LEN) {
+            body_len = max_len - BLE_SVC_MON_LOG_HDR_LEN;
+        }
+
+        rec[0] = BLE_SVC_MON_REC_LOG;
+        rec[1] = body_len;
+        memcpy(rec + 2, buf, LOG_ENTRY_HDR_SIZE + body_len);
+        ble_svc_mon_notify(sub.conn_handle, rec,
+                           BLE_SVC_MON_LOG_HDR_LEN + body_len);
+    }
+
+    return 0;
+}
+
+static int
+ble_svc_mon_log_read(struct log *log, void *dptr, void *buf, uint16_t offset,
+                     uint16_t len)
+{
+    return OS_EINVAL;
+}
+
+static int
+ble_svc_mon_log_walk(struct log *log, log_walk_func_t walk_func, void *arg)
+{
+    return OS_EINVAL;
+}
+
+static int
+ble_svc_mon_log_flush(struct log *log)
+{
+    return OS_EINVAL;
+}
+
+/**
+ * Initializes a stream log handler which sends entries to subscribed
+ * peers. Use it as a child of a fan-out handler to stream an existing log.
+ * Notifications are sent from the task which appends, so the log must not
+ * be written from interrupts unless a staging handler is put in front.
+ */
+int
+ble_svc_mon_log_handler_init(struct log_handler *handler)
+{
+    handler->log_type = LOG_TYPE_STREAM;
+    handler->log_read = ble_svc_mon_log_read;
+    handler->log_append = ble_svc_mon_log_append;
+    handler->log_walk = ble_svc_mon_log_walk;
+    handler->log_walk_from = NULL;
+    handler->log_flush = ble_svc_mon_log_flush;
+    handler->log_arg = NULL;
+    handler->log_rtr_erase = NULL;
+
+    return 0;
+}
+
+/**
+ * Initializes the monitoring service.
+ *
+ * @param cfg                   Host configuration to count the service in.
+ * @param mon_cfg               The streamable groups and collection period.
+ *                                  The group array must stay valid.
+ *
+ * @return                      0 on success; BLE_HS_EINVAL if there are too
+ *                                  many groups, the period is 0, or a group
+ *                                  does not have snapshots enabled;
+ *                                  other nonzero on GATT registration
+ *                                  failure.
+ */
+int
+ble_svc_mon_init(struct ble_hs_cfg *cfg, const struct ble_svc_mon_cfg *mon_cfg)
+{
+    int rc;
+    int i;
+
+    if (mon_cfg->group_cnt > BLE_SVC_MON_MAX_GROUPS || mon_cfg->period == 0) {
+        return BLE_HS_EINVAL;
+    }
+    for (i = 0; i < mon_cfg->group_cnt; i++) {
+        if (!mon_cfg->groups[i]->s_snap) {
+            return BLE_HS_EINVAL;
+        }
+    }
+
+    ble_svc_mon_cfg = *mon_cfg;
+    for (i = 0; i < BLE_SVC_MON_MAX_SUBS; i++) {
+        ble_svc_mon_subs[i].conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    }
+
+    rc = ble_gatts_count_cfg(ble_svc_mon_defs, cfg);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = ble_gatts_add_svcs(ble_svc_mon_defs);
+    if (rc != 0) {
+        return rc;
+    }
+
+    os_callout_func_init(&ble_svc_mon_timer, mon_cfg->evq, ble_svc_mon_tmo,
+                         NULL);
+    return os_callout_reset(&ble_svc_mon_timer.cf_c, mon_cfg->period);
+}
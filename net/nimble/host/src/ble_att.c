@@ -439,8 +439,49 @@ ble_att_set_peer_mtu(struct ble_l2cap_chan *chan, uint16_t peer_mtu)
     chan->blc_peer_mtu = peer_mtu;
 }
 
+/**
+ * Indicates whether an incoming ATT PDU has to be refused because the
+ * connection's outgoing data is at its mbuf quota.  Only requests to the
+ * local server and write commands are refused; responses, notifications and
+ * indications are accepted so that procedures in progress can finish, and
+ * so are MTU exchanges.
+ */
 static int
-ble_att_rx(uint16_t conn_handle, struct os_mbuf **om)
+ble_att_rx_over_quota(uint16_t conn_handle, uint8_t op)
+{
+    struct ble_hs_conn *conn;
+    int full;
+
+    switch (op) {
+    case BLE_ATT_OP_FIND_INFO_REQ:
+    case BLE_ATT_OP_FIND_TYPE_VALUE_REQ:
+    case BLE_ATT_OP_READ_TYPE_REQ:
+    case BLE_ATT_OP_READ_REQ:
+    case BLE_ATT_OP_READ_BLOB_REQ:
+    case BLE_ATT_OP_READ_MULT_REQ:
+    case BLE_ATT_OP_READ_GROUP_TYPE_REQ:
+    case BLE_ATT_OP_WRITE_REQ:
+    case BLE_ATT_OP_PREP_WRITE_REQ:
+    case BLE_ATT_OP_EXEC_WRITE_REQ:
+    case BLE_ATT_OP_WRITE_CMD:
+        break;
+
+    default:
+        return 0;
+    }
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    full = conn != NULL && ble_hs_conn_tx_quota_full(conn);
+
+    ble_hs_unlock();
+
+    return full;
+}
+
+static int
+ble_att_rx(uint16_t conn_handle, uint16_t cid, struct os_mbuf **om)
 {
     const struct ble_att_rx_dispatch_entry *entry;
     uint8_t op;
@@ -458,6 +499,10 @@ ble_att_rx(uint16_t conn_handle, struct os_mbuf **om)
 
     ble_att_inc_rx_stat(op);
 
+    if (ble_att_rx_over_quota(conn_handle, op)) {
+        return ble_att_svr_rx_busy(conn_handle, *om);
+    }
+
     rc = entry->bde_fn(conn_handle, om);
     if (rc != 0) {
         return rc;
@@ -71,8 +71,15 @@ ble_att_clt_tx_req(uint16_t conn_handle, struct os_mbuf *txom)
     ble_hs_lock();
 
     ble_att_conn_chan_find(conn_handle, &conn, &chan);
-    ble_att_truncate_to_mtu(chan, txom);
-    rc = ble_l2cap_tx(conn, chan, txom);
+    if (txom->om_data[0] != BLE_ATT_OP_INDICATE_RSP &&
+        ble_hs_conn_tx_quota_full(conn)) {
+
+        STATS_INC(ble_hs_stats, conn_tx_quota);
+        rc = BLE_HS_ENOMEM;
+    } else {
+        ble_att_truncate_to_mtu(chan, txom);
+        rc = ble_l2cap_tx(conn, chan, txom);
+    }
 
     ble_hs_unlock();
 
@@ -1127,6 +1134,91 @@ err:
     return rc;
 }
 
+/**
+ * Sends the same notification over several connections.  Each packet in txoms
+ * carries the attribute value for the corresponding connection; the
+ * notification header is prepended here and all packets are queued while the
+ * host lock is held once.  This function consumes all the supplied mbufs
+ * regardless of the outcome.
+ *
+ * @param conn_handles          The connections to send over.
+ * @param num_conns             The number of entries in each array.
+ * @param req                   The notification header to send.
+ * @param txoms                 The attribute value to send over each
+ *                                  connection; a null entry indicates
+ *                                  memory exhaustion for that connection.
+ * @param out_rcs               On return, the result code for each
+ *                                  connection.
+ */
+void
+ble_att_clt_tx_notify_multi(const uint16_t *conn_handles, int num_conns,
+                            const struct ble_att_notify_req *req,
+                            struct os_mbuf **txoms, int *out_rcs)
+{
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    int rc;
+    int i;
+
+    for (i = 0; i < num_conns; i++) {
+#if !NIMBLE_OPT(ATT_CLT_NOTIFY)
+        rc = BLE_HS_ENOTSUP;
+#else
+        if (req->banq_handle == 0) {
+            rc = BLE_HS_EINVAL;
+        } else if (txoms[i] == NULL) {
+            rc = BLE_HS_ENOMEM;
+        } else {
+            txoms[i] = os_mbuf_prepend_pullup(txoms[i],
+                                              BLE_ATT_NOTIFY_REQ_BASE_SZ);
+            if (txoms[i] == NULL) {
+                rc = BLE_HS_ENOMEM;
+            } else {
+                ble_att_notify_req_write(txoms[i]->om_data,
+                                         BLE_ATT_NOTIFY_REQ_BASE_SZ, req);
+                rc = 0;
+            }
+        }
+#endif
+        out_rcs[i] = rc;
+    }
+
+    ble_hs_lock();
+
+    for (i = 0; i < num_conns; i++) {
+        if (out_rcs[i] != 0) {
+            continue;
+        }
+
+        rc = ble_hs_misc_conn_chan_find(conn_handles[i], BLE_L2CAP_CID_ATT,
+                                        &conn, &chan);
+        if (rc == 0 && ble_hs_conn_tx_quota_full(conn)) {
+            STATS_INC(ble_hs_stats, conn_tx_quota);
+            rc = BLE_HS_ENOMEM;
+        }
+        if (rc == 0) {
+            ble_att_inc_tx_stat(BLE_ATT_OP_NOTIFY_REQ);
+            ble_att_truncate_to_mtu(chan, txoms[i]);
+            rc = ble_l2cap_tx(conn, chan, txoms[i]);
+            if (rc == 0) {
+                txoms[i] = NULL;
+            }
+        }
+        out_rcs[i] = rc;
+    }
+
+    ble_hs_unlock();
+
+    for (i = 0; i < num_conns; i++) {
+        os_mbuf_free_chain(txoms[i]);
+        txoms[i] = NULL;
+        if (out_rcs[i] == 0) {
+            BLE_ATT_LOG_CMD(1, "notify req", conn_handles[i],
+                            ble_att_notify_req_log, req);
+        }
+    }
+}
+
 /*****************************************************************************
  * $handle value indication                                                  *
  *****************************************************************************/
@@ -26,6 +26,9 @@
 #include "host/ble_att.h"
 struct os_mbuf;
 struct ble_hs_conn;
+struct ble_uuid_any;
+struct ble_hs_cfg;
+struct ble_hs_mem_pool;
 struct ble_l2cap_chan;
 struct ble_att_find_info_req;
 struct ble_att_error_rsp;
@@ -105,8 +108,8 @@ struct ble_att_prep_entry {
     uint16_t bape_handle;
     uint16_t bape_offset;
 
-    /* XXX: This is wasteful; we should use one mbuf chain for the entire
-     * prepared write, and compress the data into as few mbufs as possible.
+    /* The received request mbuf with its header stripped; the entries for
+     * an attribute are chained together when the queue is executed.
      */
     struct os_mbuf *bape_value;
 };
@@ -117,6 +120,9 @@ struct ble_att_svr_conn {
     /** This list is sorted by attribute handle ID. */
     struct ble_att_prep_entry_list basc_prep_list;
     uint32_t basc_prep_write_rx_time;
+
+    /** Total attribute data in the prepare queue, in bytes. */
+    uint16_t basc_prep_len;
 };
 
 /**
@@ -131,10 +137,6 @@ struct ble_att_svr_conn {
  *                              One of the BLE_ATT_ERR_[...] codes on
  *                                  failure.
  */
-typedef int ble_att_svr_access_fn(uint16_t conn_handle, uint16_t attr_handle,
-                                  uint8_t op, uint16_t offset,
-                                  struct os_mbuf **om, void *arg);
-
 int ble_att_svr_register(const uint8_t *uuid, uint8_t flags,
                          uint16_t *handle_id,
                          ble_att_svr_access_fn *cb, void *cb_arg);
@@ -142,17 +144,6 @@ int ble_att_svr_register_uuid16(uint16_t uuid16, uint8_t flags,
                                 uint16_t *handle_id, ble_att_svr_access_fn *cb,
                                 void *cb_arg);
 
-struct ble_att_svr_entry {
-    STAILQ_ENTRY(ble_att_svr_entry) ha_next;
-
-    uint8_t ha_uuid[16];
-    uint8_t ha_flags;
-    uint8_t ha_pad1;
-    uint16_t ha_handle_id;
-    ble_att_svr_access_fn *ha_cb;
-    void *ha_cb_arg;
-};
-
 SLIST_HEAD(ble_att_clt_entry_list, ble_att_clt_entry);
 
 /*** @gen */
@@ -176,9 +167,16 @@ int ble_att_init(void);
 
 struct ble_att_svr_entry *
 ble_att_svr_find_by_uuid(struct ble_att_svr_entry *start_at,
-                         const uint8_t *uuid,
+                         const struct ble_uuid_any *uuid,
                          uint16_t end_handle);
+void ble_att_svr_entry_uuid(const struct ble_att_svr_entry *entry,
+                            struct ble_uuid_any *out_uuid);
+uint16_t ble_att_svr_entry_handle(const struct ble_att_svr_entry *entry);
+struct ble_att_svr_entry *
+ble_att_svr_entry_next(const struct ble_att_svr_entry *entry);
 uint16_t ble_att_svr_prev_handle(void);
+int ble_att_svr_set_tbl(const struct ble_att_svr_entry *tbl,
+                        uint16_t num_entries);
 int ble_att_svr_rx_mtu(uint16_t conn_handle, struct os_mbuf **rxom);
 struct ble_att_svr_entry *ble_att_svr_find_by_handle(uint16_t handle_id);
 int ble_att_svr_rx_find_info(uint16_t conn_handle, struct os_mbuf **rxom);
@@ -205,10 +203,13 @@ int ble_att_svr_rx_notify(uint16_t conn_handle,
                           struct os_mbuf **rxom);
 int ble_att_svr_rx_indicate(uint16_t conn_handle,
                             struct os_mbuf **rxom);
+int ble_att_svr_rx_busy(uint16_t conn_handle, struct os_mbuf *rxom);
 void ble_att_svr_prep_clear(struct ble_att_prep_entry_list *prep_list);
 int ble_att_svr_read_handle(uint16_t conn_handle, uint16_t attr_handle,
                             uint16_t offset, struct os_mbuf *om,
                             uint8_t *out_att_err);
+int ble_att_svr_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                         struct ble_hs_mem_pool *out_pool);
 int ble_att_svr_init(void);
 
 
@@ -289,6 +290,9 @@ int ble_att_clt_rx_write(uint16_t conn_handle, struct os_mbuf **rxom);
 int ble_att_clt_tx_notify(uint16_t conn_handle,
                           const struct ble_att_notify_req *req,
                           struct os_mbuf *txom);
+void ble_att_clt_tx_notify_multi(const uint16_t *conn_handles, int num_conns,
+                                 const struct ble_att_notify_req *req,
+                                 struct os_mbuf **txoms, int *out_rcs);
 int ble_att_clt_tx_indicate(uint16_t conn_handle,
                             const struct ble_att_indicate_req *req,
                             struct os_mbuf *txom);
@@ -30,6 +30,31 @@ static struct ble_att_svr_entry_list ble_att_svr_list;
 
 static uint16_t ble_att_svr_id;
 
+/* Flash table; its attributes hold handles 1 to ble_att_svr_tbl_len, and
+ * registered attributes follow.
+ */
+static const struct ble_att_svr_entry *ble_att_svr_tbl;
+static uint16_t ble_att_svr_tbl_len;
+
+/* Registered handles are allocated densely from the end of the flash table,
+ * so entry for handle h is at h - ble_att_svr_tbl_len - 1.
+ */
+static struct ble_att_svr_entry **ble_att_svr_idx;
+
+/* First entry of each UUID, chained through ha_hash_next; the remaining
+ * entries with that UUID follow in handle order through ha_uuid_next.
+ */
+#define BLE_ATT_SVR_UUID_HASH_SIZE  16
+static struct ble_att_svr_entry *
+    ble_att_svr_uuid_hash[BLE_ATT_SVR_UUID_HASH_SIZE];
+
+/* 128-bit UUIDs of the registered attributes, each stored once; entries
+ * refer to them by index.  Every other UUID is held in the entry itself.
+ */
+#define BLE_ATT_SVR_UUID128_GROW    4
+static uint8_t (*ble_att_svr_uuid128s)[16];
+static uint16_t ble_att_svr_num_uuid128s;
+
 static void *ble_att_svr_entry_mem;
 static struct os_mempool ble_att_svr_entry_pool;
 
@@ -49,6 +74,153 @@ ble_att_svr_entry_alloc(void)
     return entry;
 }
 
+/**
+ * Looks up the value that an entry with the specified UUID holds in
+ * ha_uuid.  If add is set, a 128-bit UUID not yet in the UUID table is
+ * added to it.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if no attribute can have the
+ *                                  UUID;
+ *                              BLE_HS_ENOMEM on heap exhaustion.
+ */
+static int
+ble_att_svr_uuid_key(const struct ble_uuid_any *uuid, int add,
+                     uint32_t *out_key)
+{
+    void *p;
+    int i;
+
+    if (uuid->type != BLE_UUID_TYPE_128) {
+        *out_key = uuid->u32;
+        return 0;
+    }
+
+    for (i = 0; i < ble_att_svr_num_uuid128s; i++) {
+        if (memcmp(ble_att_svr_uuid128s[i], uuid->u128, 16) == 0) {
+            *out_key = i;
+            return 0;
+        }
+    }
+    if (!add) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (ble_att_svr_num_uuid128s % BLE_ATT_SVR_UUID128_GROW == 0) {
+        p = realloc(ble_att_svr_uuid128s,
+                    (ble_att_svr_num_uuid128s + BLE_ATT_SVR_UUID128_GROW) *
+                    sizeof *ble_att_svr_uuid128s);
+        if (p == NULL) {
+            return BLE_HS_ENOMEM;
+        }
+        ble_att_svr_uuid128s = p;
+    }
+    memcpy(ble_att_svr_uuid128s[i], uuid->u128, 16);
+    ble_att_svr_num_uuid128s++;
+
+    *out_key = i;
+    return 0;
+}
+
+static int
+ble_att_svr_entry_in_tbl(const struct ble_att_svr_entry *entry)
+{
+    return entry >= ble_att_svr_tbl &&
+           entry < ble_att_svr_tbl + ble_att_svr_tbl_len;
+}
+
+/**
+ * Retrieves the handle of the specified attribute.
+ */
+uint16_t
+ble_att_svr_entry_handle(const struct ble_att_svr_entry *entry)
+{
+    if (entry->ha_handle_id != 0) {
+        return entry->ha_handle_id;
+    }
+
+    BLE_HS_DBG_ASSERT(ble_att_svr_entry_in_tbl(entry));
+    return entry - ble_att_svr_tbl + 1;
+}
+
+/**
+ * Returns the attribute following the specified one in handle order, or NULL
+ * if it is the last one.
+ */
+struct ble_att_svr_entry *
+ble_att_svr_entry_next(const struct ble_att_svr_entry *entry)
+{
+    if (!ble_att_svr_entry_in_tbl(entry)) {
+        return STAILQ_NEXT(entry, ha_next);
+    }
+
+    if (entry + 1 < ble_att_svr_tbl + ble_att_svr_tbl_len) {
+        return (struct ble_att_svr_entry *)(entry + 1);
+    }
+    return STAILQ_FIRST(&ble_att_svr_list);
+}
+
+/**
+ * Retrieves the UUID of the specified attribute.
+ */
+void
+ble_att_svr_entry_uuid(const struct ble_att_svr_entry *entry,
+                       struct ble_uuid_any *out_uuid)
+{
+    out_uuid->type = entry->ha_uuid_type;
+    if (entry->ha_uuid_type != BLE_UUID_TYPE_128) {
+        out_uuid->u32 = entry->ha_uuid;
+    } else if (ble_att_svr_entry_in_tbl(entry)) {
+        memcpy(out_uuid->u128, entry->ha_uuid128, 16);
+    } else {
+        memcpy(out_uuid->u128, ble_att_svr_uuid128s[entry->ha_uuid], 16);
+    }
+}
+
+static int
+ble_att_svr_uuid_hash_idx(uint8_t type, uint32_t key)
+{
+    return (key * 31 + type) % BLE_ATT_SVR_UUID_HASH_SIZE;
+}
+
+/**
+ * Returns the first registered entry with the specified UUID.
+ */
+static struct ble_att_svr_entry *
+ble_att_svr_uuid_first(uint8_t type, uint32_t key)
+{
+    struct ble_att_svr_entry *entry;
+
+    entry = ble_att_svr_uuid_hash[ble_att_svr_uuid_hash_idx(type, key)];
+    while (entry != NULL) {
+        if (entry->ha_uuid == key && entry->ha_uuid_type == type) {
+            return entry;
+        }
+        entry = entry->ha_hash_next;
+    }
+
+    return NULL;
+}
+
+static void
+ble_att_svr_uuid_insert(struct ble_att_svr_entry *entry)
+{
+    struct ble_att_svr_entry *cur;
+    int idx;
+
+    cur = ble_att_svr_uuid_first(entry->ha_uuid_type, entry->ha_uuid);
+    if (cur == NULL) {
+        idx = ble_att_svr_uuid_hash_idx(entry->ha_uuid_type, entry->ha_uuid);
+        entry->ha_hash_next = ble_att_svr_uuid_hash[idx];
+        ble_att_svr_uuid_hash[idx] = entry;
+    } else {
+        while (cur->ha_uuid_next != NULL) {
+            cur = cur->ha_uuid_next;
+        }
+        cur->ha_uuid_next = entry;
+    }
+}
+
 /**
  * Allocate the next handle id and return it.
  *
@@ -73,24 +245,35 @@ ble_att_svr_next_id(void)
  *
  * @return 0 on success, non-zero error code on failure.
  */
-int
-ble_att_svr_register(const uint8_t *uuid, uint8_t flags, uint16_t *handle_id,
-                     ble_att_svr_access_fn *cb, void *cb_arg)
+static int
+ble_att_svr_register_any(const struct ble_uuid_any *uuid, uint8_t flags,
+                         uint16_t *handle_id, ble_att_svr_access_fn *cb,
+                         void *cb_arg)
 {
     struct ble_att_svr_entry *entry;
+    uint32_t key;
+    int rc;
+
+    rc = ble_att_svr_uuid_key(uuid, 1, &key);
+    if (rc != 0) {
+        return rc;
+    }
 
     entry = ble_att_svr_entry_alloc();
     if (entry == NULL) {
         return BLE_HS_ENOMEM;
     }
 
-    memcpy(&entry->ha_uuid, uuid, sizeof entry->ha_uuid);
+    entry->ha_uuid_type = uuid->type;
+    entry->ha_uuid = key;
     entry->ha_flags = flags;
     entry->ha_handle_id = ble_att_svr_next_id();
     entry->ha_cb = cb;
     entry->ha_cb_arg = cb_arg;
 
     STAILQ_INSERT_TAIL(&ble_att_svr_list, entry, ha_next);
+    ble_att_svr_idx[entry->ha_handle_id - ble_att_svr_tbl_len - 1] = entry;
+    ble_att_svr_uuid_insert(entry);
 
     if (handle_id != NULL) {
         *handle_id = entry->ha_handle_id;
@@ -99,25 +282,29 @@ ble_att_svr_register(const uint8_t *uuid, uint8_t flags, uint16_t *handle_id,
     return 0;
 }
 
+int
+ble_att_svr_register(const uint8_t *uuid, uint8_t flags, uint16_t *handle_id,
+                     ble_att_svr_access_fn *cb, void *cb_arg)
+{
+    struct ble_uuid_any uuid_any;
+
+    ble_uuid_any_from_128(&uuid_any, uuid);
+    return ble_att_svr_register_any(&uuid_any, flags, handle_id, cb, cb_arg);
+}
+
 int
 ble_att_svr_register_uuid16(uint16_t uuid16, uint8_t flags,
                             uint16_t *handle_id, ble_att_svr_access_fn *cb,
                             void *cb_arg)
 {
-    uint8_t uuid128[16];
-    int rc;
-
-    rc = ble_uuid_16_to_128(uuid16, uuid128);
-    if (rc != 0) {
-        return rc;
-    }
+    struct ble_uuid_any uuid_any;
 
-    rc = ble_att_svr_register(uuid128, flags, handle_id, cb, cb_arg);
-    if (rc != 0) {
-        return rc;
+    if (uuid16 == 0) {
+        return BLE_HS_EINVAL;
     }
 
-    return 0;
+    ble_uuid_any_from_16(&uuid_any, uuid16);
+    return ble_att_svr_register_any(&uuid_any, flags, handle_id, cb, cb_arg);
 }
 
 uint16_t
@@ -126,6 +313,29 @@ ble_att_svr_prev_handle(void)
     return ble_att_svr_id;
 }
 
+/**
+ * Serves the specified const attributes as handles 1 to num_entries.  Must be
+ * called before any attribute is registered; registered attributes follow the
+ * table.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if attributes have already been
+ *                                  registered.
+ */
+int
+ble_att_svr_set_tbl(const struct ble_att_svr_entry *tbl, uint16_t num_entries)
+{
+    if (ble_att_svr_id != 0) {
+        return BLE_HS_EALREADY;
+    }
+
+    ble_att_svr_tbl = tbl;
+    ble_att_svr_tbl_len = num_entries;
+    ble_att_svr_id = num_entries;
+
+    return 0;
+}
+
 /**
  * Find a host attribute by handle id.
  *
@@ -143,18 +353,28 @@ ble_att_svr_prev_handle(void)
 struct ble_att_svr_entry *
 ble_att_svr_find_by_handle(uint16_t handle_id)
 {
-    struct ble_att_svr_entry *entry;
+    if (handle_id == 0 || handle_id > ble_att_svr_id) {
+        return NULL;
+    }
 
-    for (entry = STAILQ_FIRST(&ble_att_svr_list);
-         entry != NULL;
-         entry = STAILQ_NEXT(entry, ha_next)) {
+    if (handle_id <= ble_att_svr_tbl_len) {
+        return (struct ble_att_svr_entry *)(ble_att_svr_tbl + handle_id - 1);
+    }
+    return ble_att_svr_idx[handle_id - ble_att_svr_tbl_len - 1];
+}
 
-        if (entry->ha_handle_id == handle_id) {
-            return entry;
-        }
+/**
+ * Returns the entry with the lowest handle greater than or equal to the one
+ * specified; the remaining entries follow through ble_att_svr_entry_next().
+ */
+static struct ble_att_svr_entry *
+ble_att_svr_find_from(uint16_t handle_id)
+{
+    if (handle_id == 0) {
+        handle_id = 1;
     }
 
-    return NULL;
+    return ble_att_svr_find_by_handle(handle_id);
 }
 
 /**
@@ -172,27 +392,56 @@ ble_att_svr_find_by_handle(uint16_t handle_id)
  * @return                      0 on success; BLE_HS_ENOENT on not found.
  */
 struct ble_att_svr_entry *
-ble_att_svr_find_by_uuid(struct ble_att_svr_entry *prev, const uint8_t *uuid,
+ble_att_svr_find_by_uuid(struct ble_att_svr_entry *prev,
+                         const struct ble_uuid_any *uuid,
                          uint16_t end_handle)
 {
+    const struct ble_att_svr_entry *tbl_entry;
     struct ble_att_svr_entry *entry;
+    struct ble_uuid_any entry_uuid;
+    uint32_t key;
+    int rc;
 
-    if (prev == NULL) {
-        entry = STAILQ_FIRST(&ble_att_svr_list);
-    } else {
-        entry = STAILQ_NEXT(prev, ha_next);
+    /* The flash table has no UUID index; scan it in handle order. */
+    if (prev == NULL || ble_att_svr_entry_in_tbl(prev)) {
+        tbl_entry = prev == NULL ? ble_att_svr_tbl : prev + 1;
+        for (; ble_att_svr_entry_in_tbl(tbl_entry); tbl_entry++) {
+            if (ble_att_svr_entry_handle(tbl_entry) > end_handle) {
+                return NULL;
+            }
+            if (tbl_entry->ha_uuid_type == uuid->type) {
+                ble_att_svr_entry_uuid(tbl_entry, &entry_uuid);
+                if (ble_uuid_any_cmp(&entry_uuid, uuid) == 0) {
+                    return (struct ble_att_svr_entry *)tbl_entry;
+                }
+            }
+        }
+        prev = NULL;
     }
 
-    for (;
-         entry != NULL && entry->ha_handle_id <= end_handle;
-         entry = STAILQ_NEXT(entry, ha_next)) {
+    rc = ble_att_svr_uuid_key(uuid, 0, &key);
+    if (rc != 0) {
+        return NULL;
+    }
 
-        if (memcmp(entry->ha_uuid, uuid, sizeof entry->ha_uuid) == 0) {
-            return entry;
+    if (prev != NULL &&
+        prev->ha_uuid == key && prev->ha_uuid_type == uuid->type) {
+
+        entry = prev->ha_uuid_next;
+    } else {
+        entry = ble_att_svr_uuid_first(uuid->type, key);
+        while (prev != NULL && entry != NULL &&
+               entry->ha_handle_id <= prev->ha_handle_id) {
+
+            entry = entry->ha_uuid_next;
         }
     }
 
-    return NULL;
+    if (entry == NULL || entry->ha_handle_id > end_handle) {
+        return NULL;
+    }
+
+    return entry;
 }
 
 static int
@@ -306,7 +555,7 @@ ble_att_svr_read(uint16_t conn_handle,
     }
 
     BLE_HS_DBG_ASSERT(entry->ha_cb != NULL);
-    rc = entry->ha_cb(conn_handle, entry->ha_handle_id,
+    rc = entry->ha_cb(conn_handle, ble_att_svr_entry_handle(entry),
                       BLE_ATT_ACCESS_OP_READ, offset, &om, entry->ha_cb_arg);
     if (rc != 0) {
         att_err = rc;
@@ -448,7 +697,7 @@ ble_att_svr_write(uint16_t conn_handle, struct ble_att_svr_entry *entry,
     }
 
     BLE_HS_DBG_ASSERT(entry->ha_cb != NULL);
-    rc = entry->ha_cb(conn_handle, entry->ha_handle_id,
+    rc = entry->ha_cb(conn_handle, ble_att_svr_entry_handle(entry),
                       BLE_ATT_ACCESS_OP_WRITE, offset, om, entry->ha_cb_arg);
     if (rc != 0) {
         att_err = rc;
@@ -608,6 +857,37 @@ ble_att_svr_tx_rsp(uint16_t conn_handle, int rc, struct os_mbuf *om,
     return rc;
 }
 
+/**
+ * Refuses a request from the peer because the connection's outgoing data is
+ * at its mbuf quota.  Requests are answered with an "Insufficient Resources"
+ * error; write commands have no response and are dropped.
+ */
+int
+ble_att_svr_rx_busy(uint16_t conn_handle, struct os_mbuf *rxom)
+{
+    uint16_t err_handle;
+    uint8_t buf[3];
+    int rc;
+
+    STATS_INC(ble_hs_stats, conn_tx_quota);
+
+    rc = os_mbuf_copydata(rxom, 0, 1, buf);
+    if (rc != 0 || buf[0] == BLE_ATT_OP_WRITE_CMD) {
+        return BLE_HS_ENOMEM;
+    }
+
+    /* All refused requests other than execute write start with a handle. */
+    err_handle = 0;
+    if (buf[0] != BLE_ATT_OP_EXEC_WRITE_REQ &&
+        os_mbuf_copydata(rxom, 0, sizeof buf, buf) == 0) {
+
+        err_handle = le16toh(buf + 1);
+    }
+
+    return ble_att_svr_tx_rsp(conn_handle, BLE_HS_ENOMEM, NULL, buf[0],
+                              BLE_ATT_ERR_INSUFFICIENT_RES, err_handle);
+}
+
 static int
 ble_att_svr_build_mtu_rsp(uint16_t conn_handle, struct os_mbuf **out_txom,
                           uint8_t *att_err)
@@ -720,7 +1000,7 @@ ble_att_svr_fill_info(struct ble_att_find_info_req *req, struct os_mbuf *om,
                       uint16_t mtu, uint8_t *format)
 {
     struct ble_att_svr_entry *ha;
-    uint16_t uuid16;
+    struct ble_uuid_any uuid;
     uint8_t *buf;
     int num_entries;
     int entry_sz;
@@ -730,15 +1010,16 @@ ble_att_svr_fill_info(struct ble_att_find_info_req *req, struct os_mbuf *om,
     num_entries = 0;
     rc = 0;
 
-    STAILQ_FOREACH(ha, &ble_att_svr_list, ha_next) {
-        if (ha->ha_handle_id > req->bafq_end_handle) {
+    for (ha = ble_att_svr_find_from(req->bafq_start_handle);
+         ha != NULL;
+         ha = ble_att_svr_entry_next(ha)) {
+
+        if (ble_att_svr_entry_handle(ha) > req->bafq_end_handle) {
             rc = 0;
             goto done;
         }
-        if (ha->ha_handle_id >= req->bafq_start_handle) {
-            uuid16 = ble_uuid_128_to_16(ha->ha_uuid);
-
-            if (uuid16 != 0) {
+        if (ble_att_svr_entry_handle(ha) >= req->bafq_start_handle) {
+            if (ha->ha_uuid_type == BLE_UUID_TYPE_16) {
                 if (*format == 0) {
                     *format = BLE_ATT_FIND_INFO_RSP_FORMAT_16BIT;
                 } else if (*format != BLE_ATT_FIND_INFO_RSP_FORMAT_16BIT) {
@@ -768,15 +1049,16 @@ ble_att_svr_fill_info(struct ble_att_find_info_req *req, struct os_mbuf *om,
                 goto done;
             }
 
-            htole16(buf + 0, ha->ha_handle_id);
+            htole16(buf + 0, ble_att_svr_entry_handle(ha));
 
             switch (*format) {
             case BLE_ATT_FIND_INFO_RSP_FORMAT_16BIT:
-                htole16(buf + 2, uuid16);
+                htole16(buf + 2, ha->ha_uuid);
                 break;
 
             case BLE_ATT_FIND_INFO_RSP_FORMAT_128BIT:
-                memcpy(buf + 2, ha->ha_uuid, sizeof ha->ha_uuid);
+                ble_att_svr_entry_uuid(ha, &uuid);
+                ble_uuid_any_to_128(&uuid, buf + 2);
                 break;
 
             default:
@@ -1043,7 +1325,7 @@ ble_att_svr_fill_type_value(uint16_t conn_handle,
     struct ble_att_svr_entry *ha;
     uint8_t buf[16];
     uint16_t attr_len;
-    uint16_t uuid16;
+    uint16_t handle;
     uint16_t first;
     uint16_t prev;
     int any_entries;
@@ -1058,19 +1340,23 @@ ble_att_svr_fill_type_value(uint16_t conn_handle,
      * matching group.  For each attribute entry, determine if data needs to be
      * written to the response.
      */
-    STAILQ_FOREACH(ha, &ble_att_svr_list, ha_next) {
+    for (ha = ble_att_svr_find_from(req->bavq_start_handle);
+         ha != NULL;
+         ha = ble_att_svr_entry_next(ha)) {
+
         match = 0;
 
-        if (ha->ha_handle_id > req->bavq_end_handle) {
+        handle = ble_att_svr_entry_handle(ha);
+        if (handle > req->bavq_end_handle) {
             break;
         }
 
-        if (ha->ha_handle_id >= req->bavq_start_handle) {
+        if (handle >= req->bavq_start_handle) {
             /* Compare the attribute type and value to the request fields to
              * determine if this attribute matches.
              */
-            uuid16 = ble_uuid_128_to_16(ha->ha_uuid);
-            if (uuid16 == req->bavq_attr_type) {
+            if (ha->ha_uuid_type == BLE_UUID_TYPE_16 &&
+                ha->ha_uuid == req->bavq_attr_type) {
                 rc = ble_att_svr_read_flat(conn_handle, ha, 0, sizeof buf, buf,
                                            &attr_len, out_att_err);
                 if (rc != 0) {
@@ -1086,8 +1372,7 @@ ble_att_svr_fill_type_value(uint16_t conn_handle,
 
         if (match) {
             rc = ble_att_svr_fill_type_value_match(txom, &first, &prev,
-                                                   ha->ha_handle_id, mtu,
-                                                   out_att_err);
+                                                   handle, mtu, out_att_err);
         } else {
             rc = ble_att_svr_fill_type_value_no_match(txom, &first, &prev,
                                                       mtu, out_att_err);
@@ -1224,7 +1509,7 @@ done:
 static int
 ble_att_svr_build_read_type_rsp(uint16_t conn_handle,
                                 struct ble_att_read_type_req *req,
-                                uint8_t *uuid128,
+                                const struct ble_uuid_any *uuid,
                                 struct os_mbuf **out_txom,
                                 uint8_t *att_err,
                                 uint16_t *err_handle)
@@ -1271,17 +1556,17 @@ ble_att_svr_build_read_type_rsp(uint16_t conn_handle,
     /* Find all matching attributes, writing a record for each. */
     entry = NULL;
     while (1) {
-        entry = ble_att_svr_find_by_uuid(entry, uuid128, req->batq_end_handle);
+        entry = ble_att_svr_find_by_uuid(entry, uuid, req->batq_end_handle);
         if (entry == NULL) {
             rc = BLE_HS_ENOENT;
             break;
         }
 
-        if (entry->ha_handle_id >= req->batq_start_handle) {
+        if (ble_att_svr_entry_handle(entry) >= req->batq_start_handle) {
             rc = ble_att_svr_read_flat(conn_handle, entry, 0, sizeof buf, buf,
                                        &attr_len, att_err);
             if (rc != 0) {
-                *err_handle = entry->ha_handle_id;
+                *err_handle = ble_att_svr_entry_handle(entry);
                 goto done;
             }
 
@@ -1303,12 +1588,12 @@ ble_att_svr_build_read_type_rsp(uint16_t conn_handle,
             dptr = os_mbuf_extend(txom, 2 + attr_len);
             if (dptr == NULL) {
                 *att_err = BLE_ATT_ERR_INSUFFICIENT_RES;
-                *err_handle = entry->ha_handle_id;
+                *err_handle = ble_att_svr_entry_handle(entry);
                 rc = BLE_HS_ENOMEM;
                 goto done;
             }
 
-            htole16(dptr + 0, entry->ha_handle_id);
+            htole16(dptr + 0, ble_att_svr_entry_handle(entry));
             memcpy(dptr + 2, buf, attr_len);
             entry_written = 1;
         }
@@ -1348,11 +1633,11 @@ ble_att_svr_rx_read_type(uint16_t conn_handle, struct os_mbuf **rxom)
 #endif
 
     struct ble_att_read_type_req req;
+    struct ble_uuid_any uuid;
     struct os_mbuf *txom;
     uint16_t err_handle;
     uint16_t uuid16;
     uint16_t pktlen;
-    uint8_t uuid128[16];
     uint8_t att_err;
     int rc;
 
@@ -1390,17 +1675,17 @@ ble_att_svr_rx_read_type(uint16_t conn_handle, struct os_mbuf **rxom)
     switch ((*rxom)->om_len) {
     case BLE_ATT_READ_TYPE_REQ_SZ_16:
         uuid16 = le16toh((*rxom)->om_data + 5);
-        rc = ble_uuid_16_to_128(uuid16, uuid128);
-        if (rc != 0) {
+        if (uuid16 == 0) {
             att_err = BLE_ATT_ERR_ATTR_NOT_FOUND;
             err_handle = 0;
             rc = BLE_HS_EBADDATA;
             goto done;
         }
+        ble_uuid_any_from_16(&uuid, uuid16);
         break;
 
     case BLE_ATT_READ_TYPE_REQ_SZ_128:
-        memcpy(uuid128, (*rxom)->om_data + 5, 16);
+        ble_uuid_any_from_128(&uuid, (*rxom)->om_data + 5);
         break;
 
     default:
@@ -1410,7 +1695,7 @@ ble_att_svr_rx_read_type(uint16_t conn_handle, struct os_mbuf **rxom)
         goto done;
     }
 
-    rc = ble_att_svr_build_read_type_rsp(conn_handle, &req, uuid128,
+    rc = ble_att_svr_build_read_type_rsp(conn_handle, &req, &uuid,
                                          &txom, &att_err, &err_handle);
     if (rc != 0) {
         goto done;
@@ -1654,14 +1939,11 @@ done:
 }
 
 static int
-ble_att_svr_is_valid_group_type(uint8_t *uuid128)
+ble_att_svr_is_valid_group_type(uint8_t uuid_type, uint32_t uuid)
 {
-    uint16_t uuid16;
-
-    uuid16 = ble_uuid_128_to_16(uuid128);
-
-    return uuid16 == BLE_ATT_UUID_PRIMARY_SERVICE ||
-           uuid16 == BLE_ATT_UUID_SECONDARY_SERVICE;
+    return uuid_type == BLE_UUID_TYPE_16 &&
+           (uuid == BLE_ATT_UUID_PRIMARY_SERVICE ||
+            uuid == BLE_ATT_UUID_SECONDARY_SERVICE);
 }
 
 static int
@@ -1735,7 +2017,7 @@ ble_att_svr_read_group_type_entry_write(struct os_mbuf *om, uint16_t mtu,
 static int
 ble_att_svr_build_read_group_type_rsp(uint16_t conn_handle,
                                       struct ble_att_read_group_type_req *req,
-                                      uint8_t *group_uuid128,
+                                      const struct ble_uuid_any *group_uuid,
                                       struct os_mbuf **out_txom,
                                       uint8_t *att_err,
                                       uint16_t *err_handle)
@@ -1778,11 +2060,14 @@ ble_att_svr_build_read_group_type_rsp(uint16_t conn_handle,
 
     start_group_handle = 0;
     rsp.bagp_length = 0;
-    STAILQ_FOREACH(entry, &ble_att_svr_list, ha_next) {
-        if (entry->ha_handle_id < req->bagq_start_handle) {
+    for (entry = ble_att_svr_find_from(req->bagq_start_handle);
+         entry != NULL;
+         entry = ble_att_svr_entry_next(entry)) {
+
+        if (ble_att_svr_entry_handle(entry) < req->bagq_start_handle) {
             continue;
         }
-        if (entry->ha_handle_id > req->bagq_end_handle) {
+        if (ble_att_svr_entry_handle(entry) > req->bagq_end_handle) {
             /* The full input range has been searched. */
             rc = 0;
             goto done;
@@ -1790,9 +2075,10 @@ ble_att_svr_build_read_group_type_rsp(uint16_t conn_handle,
 
         if (start_group_handle != 0) {
             /* We have already found the start of a group. */
-            if (!ble_att_svr_is_valid_group_type(entry->ha_uuid)) {
+            if (!ble_att_svr_is_valid_group_type(entry->ha_uuid_type,
+                                                 entry->ha_uuid)) {
                 /* This attribute is part of the current group. */
-                end_group_handle = entry->ha_handle_id;
+                end_group_handle = ble_att_svr_entry_handle(entry);
             } else {
                 /* This attribute marks the end of the group.  Write an entry
                  * representing the group to the response.
@@ -1803,7 +2089,7 @@ ble_att_svr_build_read_group_type_rsp(uint16_t conn_handle,
                 start_group_handle = 0;
                 end_group_handle = 0;
                 if (rc != 0) {
-                    *err_handle = entry->ha_handle_id;
+                    *err_handle = ble_att_svr_entry_handle(entry);
                     if (rc == BLE_HS_ENOMEM) {
                         *att_err = BLE_ATT_ERR_INSUFFICIENT_RES;
                     } else {
@@ -1816,12 +2102,13 @@ ble_att_svr_build_read_group_type_rsp(uint16_t conn_handle,
 
         if (start_group_handle == 0) {
             /* We are looking for the start of a group. */
-            if (memcmp(entry->ha_uuid, group_uuid128, 16) == 0) {
+            if (entry->ha_uuid_type == group_uuid->type &&
+                entry->ha_uuid == group_uuid->u32) {
                 /* Found a group start.  Read the group UUID. */
                 rc = ble_att_svr_service_uuid(entry, &service_uuid16,
                                               service_uuid128);
                 if (rc != 0) {
-                    *err_handle = entry->ha_handle_id;
+                    *err_handle = ble_att_svr_entry_handle(entry);
                     *att_err = BLE_ATT_ERR_UNLIKELY;
                     rc = BLE_HS_ENOTSUP;
                     goto done;
@@ -1859,8 +2146,8 @@ ble_att_svr_build_read_group_type_rsp(uint16_t conn_handle,
                     goto done;
                 }
 
-                start_group_handle = entry->ha_handle_id;
-                end_group_handle = entry->ha_handle_id;
+                start_group_handle = ble_att_svr_entry_handle(entry);
+                end_group_handle = ble_att_svr_entry_handle(entry);
             }
         }
     }
@@ -1917,8 +2204,8 @@ ble_att_svr_rx_read_group_type(uint16_t conn_handle, struct os_mbuf **rxom)
 #endif
 
     struct ble_att_read_group_type_req req;
+    struct ble_uuid_any uuid;
     struct os_mbuf *txom;
-    uint8_t uuid128[16];
     uint16_t err_handle;
     uint16_t pktlen;
     uint8_t att_err;
@@ -1954,8 +2241,8 @@ ble_att_svr_rx_read_group_type(uint16_t conn_handle, struct os_mbuf **rxom)
         goto done;
     }
 
-    rc = ble_uuid_extract(*rxom, BLE_ATT_READ_GROUP_TYPE_REQ_BASE_SZ,
-                          uuid128);
+    rc = ble_uuid_any_extract(*rxom, BLE_ATT_READ_GROUP_TYPE_REQ_BASE_SZ,
+                              &uuid);
     if (rc != 0) {
         att_err = BLE_ATT_ERR_INVALID_PDU;
         err_handle = req.bagq_start_handle;
@@ -1963,14 +2250,14 @@ ble_att_svr_rx_read_group_type(uint16_t conn_handle, struct os_mbuf **rxom)
         goto done;
     }
 
-    if (!ble_att_svr_is_valid_group_type(uuid128)) {
+    if (!ble_att_svr_is_valid_group_type(uuid.type, uuid.u32)) {
         att_err = BLE_ATT_ERR_UNSUPPORTED_GROUP;
         err_handle = req.bagq_start_handle;
         rc = BLE_HS_ENOTSUP;
         goto done;
     }
 
-    rc = ble_att_svr_build_read_group_type_rsp(conn_handle, &req, uuid128,
+    rc = ble_att_svr_build_read_group_type_rsp(conn_handle, &req, &uuid,
                                                &txom, &att_err, &err_handle);
     if (rc != 0) {
         goto done;
@@ -2151,11 +2438,6 @@ ble_att_svr_prep_alloc(void)
     }
 
     memset(entry, 0, sizeof *entry);
-    entry->bape_value = ble_hs_mbuf_l2cap_pkt();
-    if (entry->bape_value == NULL) {
-        ble_att_svr_prep_free(entry);
-        return NULL;
-    }
 
     return entry;
 }
@@ -2314,19 +2596,35 @@ ble_att_svr_prep_write(uint16_t conn_handle,
     return 0;
 }
 
+/**
+ * Queues the value carried by a prepare write request.  The request mbuf
+ * itself becomes the queued value: its header is stripped, and the chain is
+ * concatenated with the attribute's other fragments when the queue is
+ * executed.  The mbuf is consumed on success.
+ *
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ */
 static int
 ble_att_svr_insert_prep_entry(uint16_t conn_handle,
                               const struct ble_att_prep_write_cmd *req,
-                              const struct os_mbuf *rxom,
+                              struct os_mbuf **rxom,
                               uint8_t *out_att_err)
 {
     struct ble_att_prep_entry *prep_entry;
     struct ble_att_prep_entry *prep_prev;
     struct ble_hs_conn *conn;
-    int rc;
+    uint16_t value_len;
 
     conn = ble_hs_conn_find_assert(conn_handle);
 
+    value_len = OS_MBUF_PKTLEN(*rxom) - BLE_ATT_PREP_WRITE_CMD_BASE_SZ;
+    if (conn->bhc_att_svr.basc_prep_len + value_len >
+        ble_hs_cfg.max_prep_write_len) {
+
+        *out_att_err = BLE_ATT_ERR_PREPARE_QUEUE_FULL;
+        return BLE_HS_ENOMEM;
+    }
+
     prep_entry = ble_att_svr_prep_alloc();
     if (prep_entry == NULL) {
         *out_att_err = BLE_ATT_ERR_PREPARE_QUEUE_FULL;
@@ -2335,17 +2633,11 @@ ble_att_svr_insert_prep_entry(uint16_t conn_handle,
     prep_entry->bape_handle = req->bapc_handle;
     prep_entry->bape_offset = req->bapc_offset;
 
-    /* Append attribute value from request onto prep mbuf. */
-    rc = os_mbuf_appendfrom(
-        prep_entry->bape_value,
-        rxom,
-        BLE_ATT_PREP_WRITE_CMD_BASE_SZ,
-        OS_MBUF_PKTLEN(rxom) - BLE_ATT_PREP_WRITE_CMD_BASE_SZ);
-    if (rc != 0) {
-        ble_att_svr_prep_free(prep_entry);
-        *out_att_err = BLE_ATT_ERR_PREPARE_QUEUE_FULL;
-        return rc;
-    }
+    os_mbuf_adj(*rxom, BLE_ATT_PREP_WRITE_CMD_BASE_SZ);
+    prep_entry->bape_value = *rxom;
+    *rxom = NULL;
+
+    conn->bhc_att_svr.basc_prep_len += value_len;
 
     prep_prev = ble_att_svr_prep_find_prev(&conn->bhc_att_svr,
                                            req->bapc_handle,
@@ -2360,6 +2652,49 @@ ble_att_svr_insert_prep_entry(uint16_t conn_handle,
     return 0;
 }
 
+/**
+ * Builds a prepare write response.  The response echoes the request, so the
+ * value is copied out of the request mbuf before the request gets queued.
+ */
+static int
+ble_att_svr_build_prep_write_rsp(const struct ble_att_prep_write_cmd *req,
+                                 const struct os_mbuf *rxom,
+                                 struct os_mbuf **out_txom, uint8_t *att_err)
+{
+    struct os_mbuf *txom;
+    void *buf;
+    int rc;
+
+    txom = ble_hs_mbuf_l2cap_pkt();
+    if (txom == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto err;
+    }
+
+    buf = os_mbuf_extend(txom, BLE_ATT_PREP_WRITE_CMD_BASE_SZ);
+    if (buf == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto err;
+    }
+    ble_att_prep_write_rsp_write(buf, BLE_ATT_PREP_WRITE_CMD_BASE_SZ, req);
+
+    rc = os_mbuf_appendfrom(txom, rxom, BLE_ATT_PREP_WRITE_CMD_BASE_SZ,
+                            OS_MBUF_PKTLEN(rxom) -
+                            BLE_ATT_PREP_WRITE_CMD_BASE_SZ);
+    if (rc != 0) {
+        rc = BLE_HS_ENOMEM;
+        goto err;
+    }
+
+    *out_txom = txom;
+    return 0;
+
+err:
+    os_mbuf_free_chain(txom);
+    *att_err = BLE_ATT_ERR_INSUFFICIENT_RES;
+    return rc;
+}
+
 int
 ble_att_svr_rx_prep_write(uint16_t conn_handle, struct os_mbuf **rxom)
 {
@@ -2415,21 +2750,22 @@ ble_att_svr_rx_prep_write(uint16_t conn_handle, struct os_mbuf **rxom)
         goto done;
     }
 
+    /* Response is identical to request except for op code. */
+    rc = ble_att_svr_build_prep_write_rsp(&req, *rxom, &txom, &att_err);
+    if (rc != 0) {
+        goto done;
+    }
+
     ble_hs_lock();
-    rc = ble_att_svr_insert_prep_entry(conn_handle, &req, *rxom, &att_err);
+    rc = ble_att_svr_insert_prep_entry(conn_handle, &req, rxom, &att_err);
     ble_hs_unlock();
 
     if (rc != 0) {
+        os_mbuf_free_chain(txom);
+        txom = NULL;
         goto done;
     }
 
-    /* Reuse rxom for response.  Response is identical to request except for
-     * op code.
-     */
-    txom = *rxom;
-    *rxom = NULL;
-    txom->om_data[0] = BLE_ATT_OP_PREP_WRITE_RSP;
-
     BLE_ATT_LOG_CMD(1, "prep write rsp", conn_handle,
                     ble_att_prep_write_cmd_log, &req);
 
@@ -2523,6 +2859,7 @@ done:
          */
         prep_list = conn->bhc_att_svr.basc_prep_list;
         SLIST_INIT(&conn->bhc_att_svr.basc_prep_list);
+        conn->bhc_att_svr.basc_prep_len = 0;
         ble_hs_unlock();
 
         if (req.baeq_flags & BLE_ATT_EXEC_WRITE_F_CONFIRM) {
@@ -2646,6 +2983,7 @@ ble_att_svr_rx_indicate(uint16_t conn_handle, struct os_mbuf **rxom)
     /* Strip the request base from the front of the mbuf. */
     os_mbuf_adj(*rxom, BLE_ATT_INDICATE_REQ_BASE_SZ);
 
+    ble_gattc_cache_rx_indicate(conn_handle, req.baiq_handle);
     ble_gap_notify_rx_event(conn_handle, req.baiq_handle, *rxom, 1);
     *rxom = NULL;
 
@@ -2668,6 +3006,64 @@ ble_att_svr_free_mem(void)
 {
     free(ble_att_svr_entry_mem);
     ble_att_svr_entry_mem = NULL;
+
+    free(ble_att_svr_idx);
+    ble_att_svr_idx = NULL;
+
+    free(ble_att_svr_uuid128s);
+    ble_att_svr_uuid128s = NULL;
+    ble_att_svr_num_uuid128s = 0;
+}
+
+int
+ble_att_svr_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                     struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *entry_pool;
+    const struct os_mempool *prep_pool;
+    int num_uuid128s;
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        entry_pool = &ble_att_svr_entry_pool;
+        prep_pool = &ble_att_svr_prep_entry_pool;
+
+        /* The 128-bit UUID table grows as services are registered. */
+        num_uuid128s = ble_att_svr_num_uuid128s +
+                       BLE_ATT_SVR_UUID128_GROW - 1;
+        num_uuid128s -= num_uuid128s % BLE_ATT_SVR_UUID128_GROW;
+    } else {
+        entry_pool = NULL;
+        prep_pool = NULL;
+        num_uuid128s = 0;
+    }
+
+    switch (idx) {
+    case 0:
+        ble_hs_mem_pool_fill(out_pool, "ble_att_svr_entry_pool",
+                             cfg->max_attrs,
+                             sizeof (struct ble_att_svr_entry), entry_pool);
+        return 0;
+
+    case 1:
+        ble_hs_mem_pool_fill(out_pool, "ble_att_svr_idx", cfg->max_attrs,
+                             sizeof *ble_att_svr_idx, NULL);
+        return 0;
+
+    case 2:
+        ble_hs_mem_pool_fill(out_pool, "ble_att_svr_prep_entry_pool",
+                             cfg->max_prep_entries,
+                             sizeof (struct ble_att_prep_entry), prep_pool);
+        return 0;
+
+    case 3:
+        ble_hs_mem_pool_fill(out_pool, "ble_att_svr_uuid128s", num_uuid128s,
+                             sizeof *ble_att_svr_uuid128s, NULL);
+        return 0;
+
+    default:
+        return BLE_HS_ENOENT;
+    }
 }
 
 int
@@ -2693,6 +3089,13 @@ ble_att_svr_init(void)
             rc = BLE_HS_EOS;
             goto err;
         }
+
+        ble_att_svr_idx = malloc(ble_hs_cfg.max_attrs *
+                                 sizeof *ble_att_svr_idx);
+        if (ble_att_svr_idx == NULL) {
+            rc = BLE_HS_ENOMEM;
+            goto err;
+        }
     }
 
     if (ble_hs_cfg.max_prep_entries > 0) {
@@ -2716,8 +3119,11 @@ ble_att_svr_init(void)
     }
 
     STAILQ_INIT(&ble_att_svr_list);
+    memset(ble_att_svr_uuid_hash, 0, sizeof ble_att_svr_uuid_hash);
 
     ble_att_svr_id = 0;
+    ble_att_svr_tbl = NULL;
+    ble_att_svr_tbl_len = 0;
 
     return 0;
 
@@ -204,3 +204,41 @@ ble_eddystone_set_adv_data_url(struct ble_hs_adv_fields *adv_fields,
 
     return 0;
 }
+
+/**
+ * Updates the UID of the eddystone UID beacon configured with
+ * ble_eddystone_set_adv_data_uid().  Only the UID bytes are rewritten; if
+ * advertising is in progress, it continues with the new UID.
+ *
+ * @param uid                   The new 16-byte UID.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if no eddystone UID beacon is
+ *                                  configured;
+ *                              Other nonzero on failure.
+ */
+int
+ble_eddystone_update_adv_data_uid(void *uid)
+{
+#if !NIMBLE_OPT(EDDYSTONE)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    uint8_t len;
+    uint8_t off;
+    int rc;
+
+    rc = ble_gap_adv_find_field(BLE_HS_ADV_TYPE_SVC_DATA_UUID16, &off, &len);
+    if (rc != 0) {
+        return rc;
+    }
+    if (len != BLE_EDDYSTONE_SVC_DATA_BASE_SZ + 16 ||
+        ble_eddystone_svc_data[2] != BLE_EDDYSTONE_FRAME_TYPE_UID) {
+
+        return BLE_HS_ENOENT;
+    }
+
+    memcpy(ble_eddystone_svc_data + BLE_EDDYSTONE_SVC_DATA_BASE_SZ, uid, 16);
+    rc = ble_gap_adv_patch_data(off + BLE_EDDYSTONE_SVC_DATA_BASE_SZ, uid, 16);
+    return rc;
+}
@@ -22,7 +22,6 @@
 #include <errno.h>
 #include "bsp/bsp.h"
 #include "os/os.h"
-#include "util/mem.h"
 #include "nimble/nimble_opt.h"
 #include "host/ble_hs_adv.h"
 #include "ble_hs_priv.h"
@@ -83,6 +82,15 @@
 
 #define BLE_GAP_MAX_UPDATE_ENTRIES      1
 
+#define BLE_GAP_TUNE_PERIOD \
+    (BLE_GAP_TUNE_PERIOD_MS * OS_TICKS_PER_SEC / 1000)
+
+/**
+ * The maximum number of profile switches initiated per tuning sample; any
+ * further switches are deferred to the next sample.
+ */
+#define BLE_GAP_TUNE_MAX_SWITCHES       4
+
 static const struct ble_gap_conn_params ble_gap_conn_params_dflt = {
     .scan_itvl = 0x0010,
     .scan_window = 0x0010,
@@ -117,6 +125,7 @@ struct ble_gap_master_state {
 
         struct {
             uint8_t limited:1;
+            uint8_t skip_fields:1;
         } disc;
     };
 };
@@ -146,6 +155,40 @@ static bssnz_t struct {
     unsigned adv_auto_flags:1;
 } ble_gap_slave;
 
+#define BLE_GAP_MULTI_PHASE_NULL                0
+#define BLE_GAP_MULTI_PHASE_ADV                 1
+#define BLE_GAP_MULTI_PHASE_DISC                2
+#define BLE_GAP_MULTI_PHASE_IDLE                3
+#define BLE_GAP_MULTI_PHASE_CNT                 3
+
+/**
+ * The state of the multi-role scheduler.  Each period is split into an
+ * advertising window, a discovery window, and idle time; phase indicates the
+ * current window, or BLE_GAP_MULTI_PHASE_NULL if the scheduler is stopped.
+ */
+static bssnz_t struct {
+    uint8_t phase;
+    uint8_t own_addr_type;
+    os_time_t exp_os_ticks;
+
+    /* Window lengths, indexed by phase - 1. */
+    uint32_t window_ticks[BLE_GAP_MULTI_PHASE_CNT];
+
+    struct ble_gap_adv_params adv_params;
+    struct ble_gap_disc_params disc_params;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
+} ble_gap_multi;
+
+/**
+ * The connection auto-tuning sample timer.  The timer runs while at least one
+ * connection has a tuning policy.
+ */
+static bssnz_t struct {
+    unsigned exp_set:1;
+    os_time_t exp_os_ticks;
+} ble_gap_tune_timer;
+
 struct ble_gap_update_entry {
     SLIST_ENTRY(ble_gap_update_entry) next;
     struct ble_gap_upd_params params;
@@ -160,8 +203,8 @@ struct ble_gap_snapshot {
     void *cb_arg;
 };
 
-static void *ble_gap_update_entry_mem;
-static struct os_mempool ble_gap_update_entry_pool;
+OS_MEMPOOL_DECLARE(ble_gap_update_entry_pool, BLE_GAP_MAX_UPDATE_ENTRIES,
+                   sizeof (struct ble_gap_update_entry));
 static struct ble_gap_update_entry_list ble_gap_update_entries;
 
 static void ble_gap_update_entry_free(struct ble_gap_update_entry *entry);
@@ -176,6 +219,8 @@ ble_gap_update_l2cap_cb(uint16_t conn_handle, int status, void *arg);
 static int ble_gap_adv_enable_tx(int enable);
 static int ble_gap_conn_cancel_tx(void);
 static int ble_gap_disc_enable_tx(int enable, int filter_duplicates);
+static int32_t ble_gap_multi_heartbeat(void);
+static int32_t ble_gap_tune_heartbeat(void);
 
 STATS_SECT_DECL(ble_gap_stats) ble_gap_stats;
 STATS_NAME_START(ble_gap_stats)
@@ -210,6 +255,12 @@ STATS_NAME_START(ble_gap_stats)
     STATS_NAME(ble_gap_stats, discover_cancel_fail)
     STATS_NAME(ble_gap_stats, security_initiate)
     STATS_NAME(ble_gap_stats, security_initiate_fail)
+    STATS_NAME(ble_gap_stats, multi_start)
+    STATS_NAME(ble_gap_stats, multi_start_fail)
+    STATS_NAME(ble_gap_stats, multi_stop)
+    STATS_NAME(ble_gap_stats, multi_window_fail)
+    STATS_NAME(ble_gap_stats, tune_switch)
+    STATS_NAME(ble_gap_stats, tune_switch_fail)
 STATS_NAME_END(ble_gap_stats)
 
 /*****************************************************************************
@@ -269,9 +320,10 @@ ble_gap_log_disc(uint8_t own_addr_type, int32_t duration_ms,
                  const struct ble_gap_disc_params *disc_params)
 {
     BLE_HS_LOG(INFO, "own_addr_type=%d filter_policy=%d passive=%d limited=%d "
-                     "filter_duplicates=%d ",
+                     "filter_duplicates=%d skip_fields=%d ",
                own_addr_type, disc_params->filter_policy, disc_params->passive,
-               disc_params->limited, disc_params->filter_duplicates);
+               disc_params->limited, disc_params->filter_duplicates,
+               disc_params->skip_fields);
     ble_gap_log_duration(duration_ms);
 }
 
@@ -677,6 +729,26 @@ ble_gap_master_ticks_until_exp(void)
     return 0;
 }
 
+static uint32_t
+ble_gap_multi_ticks_until_exp(void)
+{
+    int32_t ticks;
+
+    if (ble_gap_multi.phase == BLE_GAP_MULTI_PHASE_NULL) {
+        /* Timer not set; infinity ticks until next event. */
+        return BLE_HS_FOREVER;
+    }
+
+    ticks = ble_gap_multi.exp_os_ticks - os_time_get();
+    if (ticks > 0) {
+        /* Timer not expired yet. */
+        return ticks;
+    }
+
+    /* Timer just expired. */
+    return 0;
+}
+
 static uint32_t
 ble_gap_slave_ticks_until_exp(void)
 {
@@ -741,18 +813,43 @@ ble_gap_update_ticks_until_exp(void)
     return ticks;
 }
 
+static uint32_t
+ble_gap_tune_ticks_until_exp(void)
+{
+    int32_t ticks;
+
+    if (!ble_gap_tune_timer.exp_set) {
+        /* Timer not set; infinity ticks until next event. */
+        return BLE_HS_FOREVER;
+    }
+
+    ticks = ble_gap_tune_timer.exp_os_ticks - os_time_get();
+    if (ticks > 0) {
+        /* Timer not expired yet. */
+        return ticks;
+    }
+
+    /* Timer just expired. */
+    return 0;
+}
+
 static void
 ble_gap_heartbeat_sched(void)
 {
     int32_t mst_ticks;
     int32_t slv_ticks;
     int32_t upd_ticks;
+    int32_t mlt_ticks;
+    int32_t tun_ticks;
     int32_t ticks;
 
     mst_ticks = ble_gap_master_ticks_until_exp();
     slv_ticks = ble_gap_slave_ticks_until_exp();
     upd_ticks = ble_gap_update_ticks_until_exp();
-    ticks = min(min(mst_ticks, slv_ticks), upd_ticks);
+    mlt_ticks = ble_gap_multi_ticks_until_exp();
+    tun_ticks = ble_gap_tune_ticks_until_exp();
+    ticks = min(min(mst_ticks, slv_ticks), min(upd_ticks, mlt_ticks));
+    ticks = min(ticks, tun_ticks);
 
     ble_hs_heartbeat_sched(ticks);
 }
@@ -1078,6 +1175,7 @@ ble_gap_rx_adv_report(struct ble_gap_disc_desc *desc)
 #endif
 
     struct ble_hs_adv_fields fields;
+    struct ble_hs_adv_field flags;
     int rc;
 
     STATS_INC(ble_gap_stats, rx_adv_report);
@@ -1086,6 +1184,25 @@ ble_gap_rx_adv_report(struct ble_gap_disc_desc *desc)
         return;
     }
 
+    if (ble_gap_master.disc.skip_fields) {
+        /* The application inspects the raw data itself; only look at the
+         * flags field, and only if a limited discovery procedure is active.
+         */
+        if (ble_gap_master.disc.limited) {
+            rc = ble_hs_adv_find(desc->data, desc->length_data,
+                                 BLE_HS_ADV_TYPE_FLAGS, &flags);
+            if (rc != 0 || flags.value_len < BLE_HS_ADV_FLAGS_LEN ||
+                !(flags.value[0] & BLE_HS_ADV_F_DISC_LTD)) {
+
+                return;
+            }
+        }
+
+        desc->fields = NULL;
+        ble_gap_disc_report(desc);
+        return;
+    }
+
     rc = ble_hs_adv_parse_fields(&fields, desc->data, desc->length_data);
     if (rc != 0) {
         /* XXX: Increment stat. */
@@ -1206,6 +1323,11 @@ ble_gap_rx_conn_complete(struct hci_le_conn_complete *evt)
         conn->bhc_cb_arg = ble_gap_slave.cb_arg;
         conn->bhc_our_addr_type = ble_gap_slave.our_addr_type;
         ble_gap_slave_reset_state();
+
+        /* Like a plain advertising procedure, the multi-role procedure ends
+         * when advertising results in a connection.
+         */
+        ble_gap_multi.phase = BLE_GAP_MULTI_PHASE_NULL;
     }
 
     memcpy(conn->bhc_our_rpa_addr, evt->local_rpa, 6);
@@ -1218,6 +1340,9 @@ ble_gap_rx_conn_complete(struct hci_le_conn_complete *evt)
 
     ble_hs_unlock();
 
+    /* Have our key ready in case the peer restores encryption. */
+    ble_sm_ltk_index_prime(evt->connection_handle);
+
     event.type = BLE_GAP_EVENT_CONNECT;
     event.connect.conn_handle = evt->connection_handle;
     event.connect.status = 0;
@@ -1355,7 +1480,7 @@ ble_gap_update_heartbeat(void)
 /**
  * Handles timed-out master procedures.
  *
- * Called by the heartbeat timer; executed at least once a second.
+ * Called by the heartbeat timer when a GAP deadline may have expired.
  *
  * @return                      The number of ticks until this function should
  *                                  be called again.
@@ -1365,13 +1490,19 @@ ble_gap_heartbeat(void)
 {
     int32_t update_ticks;
     int32_t master_ticks;
+    int32_t multi_ticks;
     int32_t slave_ticks;
+    int32_t tune_ticks;
 
     master_ticks = ble_gap_master_heartbeat();
     slave_ticks = ble_gap_slave_heartbeat();
     update_ticks = ble_gap_update_heartbeat();
+    multi_ticks = ble_gap_multi_heartbeat();
+    tune_ticks = ble_gap_tune_heartbeat();
 
-    return min(min(master_ticks, slave_ticks), update_ticks);
+    return min(min(min(master_ticks, slave_ticks),
+                   min(update_ticks, multi_ticks)),
+               tune_ticks);
 }
 
 /*****************************************************************************
@@ -1392,39 +1523,55 @@ ble_gap_wl_busy(void)
            ble_gap_master.conn.using_wl;
 }
 
+/**
+ * Clears the controller's white list and adds the specified entries.  The
+ * commands are pipelined to the controller, BLE_HS_HCI_MAX_PIPELINE at a
+ * time.
+ */
 static int
-ble_gap_wl_tx_add(const struct ble_gap_white_entry *entry)
+ble_gap_wl_tx(const struct ble_gap_white_entry *white_list,
+              uint8_t white_list_count)
 {
-    uint8_t buf[BLE_HCI_CMD_HDR_LEN + BLE_HCI_CHG_WHITE_LIST_LEN];
+    uint8_t bufs[BLE_HS_HCI_MAX_PIPELINE]
+                [BLE_HCI_CMD_HDR_LEN + BLE_HCI_CHG_WHITE_LIST_LEN];
+    struct ble_hs_hci_batch_cmd cmds[BLE_HS_HCI_MAX_PIPELINE];
+    int num_cmds;
     int rc;
+    int i;
+    int j;
 
-    rc = ble_hs_hci_cmd_build_le_add_to_whitelist(
-        entry->addr, entry->addr_type, buf, sizeof buf);
-    if (rc != 0) {
-        return rc;
-    }
+    ble_hs_hci_cmd_build_le_clear_whitelist(bufs[0], sizeof bufs[0]);
+    num_cmds = 1;
 
-    rc = ble_hs_hci_cmd_tx_empty_ack(buf);
-    if (rc != 0) {
-        return rc;
-    }
+    i = 0;
+    while (1) {
+        while (i < white_list_count && num_cmds < BLE_HS_HCI_MAX_PIPELINE) {
+            rc = ble_hs_hci_cmd_build_le_add_to_whitelist(
+                white_list[i].addr, white_list[i].addr_type,
+                bufs[num_cmds], sizeof bufs[num_cmds]);
+            if (rc != 0) {
+                return rc;
+            }
+            num_cmds++;
+            i++;
+        }
 
-    return 0;
-}
+        if (num_cmds == 0) {
+            return 0;
+        }
 
-static int
-ble_gap_wl_tx_clear(void)
-{
-    uint8_t buf[BLE_HCI_CMD_HDR_LEN];
-    int rc;
+        memset(cmds, 0, sizeof cmds);
+        for (j = 0; j < num_cmds; j++) {
+            cmds[j].bhc_cmd = bufs[j];
+        }
 
-    ble_hs_hci_cmd_build_le_clear_whitelist(buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx_empty_ack(buf);
-    if (rc != 0) {
-        return rc;
-    }
+        rc = ble_hs_hci_cmd_tx_batch(cmds, num_cmds);
+        if (rc != 0) {
+            return rc;
+        }
 
-    return 0;
+        num_cmds = 0;
+    }
 }
 
 /**
@@ -1473,20 +1620,11 @@ ble_gap_wl_set(const struct ble_gap_white_entry *white_list,
     ble_gap_log_wl(white_list, white_list_count);
     BLE_HS_LOG(INFO, "\n");
 
-    rc = ble_gap_wl_tx_clear();
+    rc = ble_gap_wl_tx(white_list, white_list_count);
     if (rc != 0) {
         goto done;
     }
 
-    for (i = 0; i < white_list_count; i++) {
-        rc = ble_gap_wl_tx_add(white_list + i);
-        if (rc != 0) {
-            goto done;
-        }
-    }
-
-    rc = 0;
-
 done:
     ble_hs_unlock();
 
@@ -2057,6 +2195,224 @@ done:
     return rc;
 }
 
+/**
+ * Configures pre-encoded data to include in subsequent advertisements.  The
+ * data is used as is; unlike ble_gap_adv_set_fields(), no flags field is
+ * added automatically.
+ *
+ * @param data                  The encoded advertising data.
+ * @param data_len              The length of the data, in bytes.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EBUSY if advertising is in progress;
+ *                              BLE_HS_EMSGSIZE if the specified data is too
+ *                                  large to fit in an advertisement.
+ */
+int
+ble_gap_adv_set_data(const void *data, uint8_t data_len)
+{
+#if !NIMBLE_OPT(ADVERTISE)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    int rc;
+
+    if (data_len > BLE_HCI_MAX_ADV_DATA_LEN) {
+        return BLE_HS_EMSGSIZE;
+    }
+
+    ble_hs_lock();
+
+    if (ble_gap_slave.op != BLE_GAP_OP_NULL) {
+        rc = BLE_HS_EBUSY;
+    } else {
+        memcpy(ble_gap_slave.adv_data, data, data_len);
+        ble_gap_slave.adv_data_len = data_len;
+        ble_gap_slave.adv_auto_flags = 0;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Configures pre-encoded data to include in subsequent scan responses.
+ *
+ * @param data                  The encoded scan response data.
+ * @param data_len              The length of the data, in bytes.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EBUSY if advertising is in progress;
+ *                              BLE_HS_EMSGSIZE if the specified data is too
+ *                                  large to fit in a scan response.
+ */
+int
+ble_gap_adv_rsp_set_data(const void *data, uint8_t data_len)
+{
+#if !NIMBLE_OPT(ADVERTISE)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    int rc;
+
+    if (data_len > BLE_HCI_MAX_ADV_DATA_LEN) {
+        return BLE_HS_EMSGSIZE;
+    }
+
+    ble_hs_lock();
+
+    if (ble_gap_slave.op != BLE_GAP_OP_NULL) {
+        rc = BLE_HS_EBUSY;
+    } else {
+        memcpy(ble_gap_slave.rsp_data, data, data_len);
+        ble_gap_slave.rsp_data_len = data_len;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Locates a field in the configured advertising data.  The returned offset
+ * can be passed to ble_gap_adv_patch_data() to update the field's value
+ * without re-encoding the whole advertisement.
+ *
+ * @param type                  The AD type to search for.
+ * @param out_off               On success, the offset of the field's value
+ *                                  gets written here.
+ * @param out_len               On success, the length of the field's value
+ *                                  gets written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there is no such field.
+ */
+int
+ble_gap_adv_find_field(uint8_t type, uint8_t *out_off, uint8_t *out_len)
+{
+    int rc;
+
+    ble_hs_lock();
+    rc = ble_hs_adv_find_field(type, ble_gap_slave.adv_data,
+                               ble_gap_slave.adv_data_len, out_off, out_len);
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Locates a field in the configured scan response data.  The returned offset
+ * can be passed to ble_gap_adv_rsp_patch_data().
+ *
+ * @param type                  The AD type to search for.
+ * @param out_off               On success, the offset of the field's value
+ *                                  gets written here.
+ * @param out_len               On success, the length of the field's value
+ *                                  gets written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there is no such field.
+ */
+int
+ble_gap_adv_rsp_find_field(uint8_t type, uint8_t *out_off, uint8_t *out_len)
+{
+    int rc;
+
+    ble_hs_lock();
+    rc = ble_hs_adv_find_field(type, ble_gap_slave.rsp_data,
+                               ble_gap_slave.rsp_data_len, out_off, out_len);
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Overwrites a range of the configured advertising data in place.  If
+ * advertising is in progress, the updated data is sent to the controller
+ * immediately; advertising does not need to be stopped.
+ *
+ * @param off                   The offset within the advertising data of the
+ *                                  first byte to overwrite.
+ * @param src                   The replacement bytes.
+ * @param len                   The number of bytes to overwrite.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the range extends past the
+ *                                  end of the configured data;
+ *                              Other nonzero on HCI failure.
+ */
+int
+ble_gap_adv_patch_data(uint8_t off, const void *src, uint8_t len)
+{
+#if !NIMBLE_OPT(ADVERTISE)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    int rc;
+
+    ble_hs_lock();
+
+    if (off + len > ble_gap_slave.adv_data_len) {
+        rc = BLE_HS_EINVAL;
+    } else {
+        memcpy(ble_gap_slave.adv_data + off, src, len);
+        if (ble_gap_adv_active()) {
+            rc = ble_gap_adv_data_tx();
+        } else {
+            rc = 0;
+        }
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Overwrites a range of the configured scan response data in place.  If
+ * advertising is in progress, the updated data is sent to the controller
+ * immediately.
+ *
+ * @param off                   The offset within the scan response data of
+ *                                  the first byte to overwrite.
+ * @param src                   The replacement bytes.
+ * @param len                   The number of bytes to overwrite.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the range extends past the
+ *                                  end of the configured data;
+ *                              Other nonzero on HCI failure.
+ */
+int
+ble_gap_adv_rsp_patch_data(uint8_t off, const void *src, uint8_t len)
+{
+#if !NIMBLE_OPT(ADVERTISE)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    int rc;
+
+    ble_hs_lock();
+
+    if (off + len > ble_gap_slave.rsp_data_len) {
+        rc = BLE_HS_EINVAL;
+    } else {
+        memcpy(ble_gap_slave.rsp_data + off, src, len);
+        if (ble_gap_adv_active()) {
+            rc = ble_gap_adv_rsp_data_tx();
+        } else {
+            rc = 0;
+        }
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
 /**
  * Indicates whether an advertisement procedure is currently in progress.
  *
@@ -2282,6 +2638,7 @@ ble_gap_disc(uint8_t own_addr_type, int32_t duration_ms,
     }
 
     ble_gap_master.disc.limited = params.limited;
+    ble_gap_master.disc.skip_fields = params.skip_fields;
     ble_gap_master.cb = cb;
     ble_gap_master.cb_arg = cb_arg;
 
@@ -2331,15 +2688,337 @@ ble_gap_disc_active(void)
 }
 
 /*****************************************************************************
- * $connection establishment procedures                                      *
+ * $multi-role discovery                                                     *
  *****************************************************************************/
 
+/**
+ * Starts the window for the specified phase.  If the advertising or discovery
+ * procedure cannot be started (e.g., all connections are in use), the radio
+ * stays idle until the window ends.
+ *
+ * @return                      0 if the window's procedure was started;
+ *                                  nonzero otherwise.
+ */
 static int
-ble_gap_conn_create_tx(uint8_t own_addr_type,
-                       uint8_t peer_addr_type, const uint8_t *peer_addr,
-                       const struct ble_gap_conn_params *params)
+ble_gap_multi_enter(uint8_t phase)
 {
-    uint8_t buf[BLE_HCI_CMD_HDR_LEN + BLE_HCI_CREATE_CONN_LEN];
+    int rc;
+
+    switch (phase) {
+    case BLE_GAP_MULTI_PHASE_ADV:
+        rc = ble_gap_adv_start(ble_gap_multi.own_addr_type, 0, NULL,
+                               BLE_HS_FOREVER, &ble_gap_multi.adv_params,
+                               ble_gap_multi.cb, ble_gap_multi.cb_arg);
+        break;
+
+    case BLE_GAP_MULTI_PHASE_DISC:
+        rc = ble_gap_disc(ble_gap_multi.own_addr_type, BLE_HS_FOREVER,
+                          &ble_gap_multi.disc_params,
+                          ble_gap_multi.cb, ble_gap_multi.cb_arg);
+        break;
+
+    default:
+        rc = 0;
+        break;
+    }
+
+    if (rc != 0) {
+        STATS_INC(ble_gap_stats, multi_window_fail);
+    }
+
+    ble_gap_multi.phase = phase;
+    ble_gap_multi.exp_os_ticks = os_time_get() +
+                                 ble_gap_multi.window_ticks[phase - 1];
+
+    return rc;
+}
+
+/**
+ * Ends the current window.
+ *
+ * @return                      0 on success; nonzero if the controller
+ *                                  failed to stop advertising or scanning.
+ */
+static int
+ble_gap_multi_leave(void)
+{
+    int rc;
+
+    switch (ble_gap_multi.phase) {
+    case BLE_GAP_MULTI_PHASE_ADV:
+        rc = ble_gap_adv_stop();
+        break;
+
+    case BLE_GAP_MULTI_PHASE_DISC:
+        rc = ble_gap_disc_cancel();
+        break;
+
+    default:
+        rc = 0;
+        break;
+    }
+
+    /* The window's procedure may have failed to start. */
+    if (rc == BLE_HS_EALREADY) {
+        rc = 0;
+    }
+
+    return rc;
+}
+
+static uint8_t
+ble_gap_multi_next_phase(uint8_t phase)
+{
+    /* Windows of zero length are skipped; at least one is nonzero. */
+    do {
+        phase = phase % BLE_GAP_MULTI_PHASE_CNT + 1;
+    } while (ble_gap_multi.window_ticks[phase - 1] == 0);
+
+    return phase;
+}
+
+static int32_t
+ble_gap_multi_heartbeat(void)
+{
+    uint32_t ticks_until_exp;
+    int rc;
+
+    ticks_until_exp = ble_gap_multi_ticks_until_exp();
+    if (ticks_until_exp != 0) {
+        /* Timer not expired yet. */
+        return ticks_until_exp;
+    }
+
+    /*** Timer expired; advance to the next window. */
+
+    rc = ble_gap_multi_leave();
+    if (rc != 0) {
+        /* Failed to stop the current window; try again in 100 ms. */
+        return BLE_GAP_CANCEL_RETRY_RATE;
+    }
+
+    ble_gap_multi_enter(ble_gap_multi_next_phase(ble_gap_multi.phase));
+
+    return ble_gap_multi_ticks_until_exp();
+}
+
+static int
+ble_gap_multi_validate(const struct ble_gap_adv_params *adv_params,
+                       const struct ble_gap_disc_params *disc_params,
+                       const struct ble_gap_multi_params *multi_params)
+{
+    if (multi_params == NULL) {
+        return BLE_HS_EINVAL;
+    }
+
+    if (multi_params->period_ms == 0 ||
+        multi_params->adv_pct + multi_params->disc_pct == 0 ||
+        multi_params->adv_pct + multi_params->disc_pct > 100) {
+
+        return BLE_HS_EINVAL;
+    }
+
+    if (multi_params->adv_pct > 0) {
+        /* Directed advertising times out on its own. */
+        if (adv_params == NULL ||
+            adv_params->conn_mode == BLE_GAP_CONN_MODE_DIR) {
+
+            return BLE_HS_EINVAL;
+        }
+    }
+
+    if (multi_params->disc_pct > 0 && disc_params == NULL) {
+        return BLE_HS_EINVAL;
+    }
+
+    if (ble_gap_multi.phase != BLE_GAP_MULTI_PHASE_NULL ||
+        ble_gap_adv_active() || ble_gap_disc_active()) {
+
+        return BLE_HS_EALREADY;
+    }
+
+    if (ble_gap_conn_active()) {
+        return BLE_HS_EBUSY;
+    }
+
+    return 0;
+}
+
+/**
+ * Starts a multi-role procedure: advertising and discovery are interleaved
+ * according to the specified duty cycle.  Each period begins with an
+ * advertising window, followed by a discovery window; the radio is idle for
+ * the rest of the period.  The two roles never run at the same time, so the
+ * controller does not need to preempt scanning for advertising events, and
+ * each window gets the radio to itself.
+ *
+ * If the discovery interval and window are both unspecified, the controller
+ * scans continuously during the discovery window; the duty cycle already
+ * limits the time spent scanning.
+ *
+ * Advertising reports and connection events are reported through the
+ * specified callback, as they are for ble_gap_disc() and
+ * ble_gap_adv_start().  If advertising results in a connection, the
+ * procedure ends.  Stop the procedure before initiating a connection to a
+ * discovered device.
+ *
+ * @param own_addr_type         The type of address the stack should use for
+ *                                  itself.
+ * @param adv_params            The advertising parameters; may be null if
+ *                                  adv_pct is 0.  Directed advertising is not
+ *                                  supported.
+ * @param disc_params           The discovery parameters; may be null if
+ *                                  disc_pct is 0.
+ * @param multi_params          The duty cycle.
+ * @param cb                    The callback to associate with this procedure.
+ * @param cb_arg                The optional argument to pass to the callback
+ *                                  function.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if advertising or discovery is
+ *                                  already in progress;
+ *                              BLE_HS_EBUSY if a connect procedure is in
+ *                                  progress;
+ *                              Other nonzero on error.
+ */
+int
+ble_gap_multi_start(uint8_t own_addr_type,
+                    const struct ble_gap_adv_params *adv_params,
+                    const struct ble_gap_disc_params *disc_params,
+                    const struct ble_gap_multi_params *multi_params,
+                    ble_gap_event_fn *cb, void *cb_arg)
+{
+    uint32_t period_ticks;
+    uint32_t adv_ticks;
+    uint32_t disc_ticks;
+    int rc;
+
+    STATS_INC(ble_gap_stats, multi_start);
+
+    ble_hs_lock();
+
+    rc = ble_gap_multi_validate(adv_params, disc_params, multi_params);
+    if (rc != 0) {
+        goto err;
+    }
+
+    rc = os_time_ms_to_ticks(multi_params->period_ms, &period_ticks);
+    if (rc != 0) {
+        /* Period too great. */
+        rc = BLE_HS_EINVAL;
+        goto err;
+    }
+
+    adv_ticks = (uint64_t)period_ticks * multi_params->adv_pct / 100;
+    disc_ticks = (uint64_t)period_ticks * multi_params->disc_pct / 100;
+    if ((multi_params->adv_pct > 0 && adv_ticks == 0) ||
+        (multi_params->disc_pct > 0 && disc_ticks == 0)) {
+
+        /* Window too short. */
+        rc = BLE_HS_EINVAL;
+        goto err;
+    }
+
+    memset(&ble_gap_multi, 0, sizeof ble_gap_multi);
+    ble_gap_multi.own_addr_type = own_addr_type;
+    ble_gap_multi.window_ticks[BLE_GAP_MULTI_PHASE_ADV - 1] = adv_ticks;
+    ble_gap_multi.window_ticks[BLE_GAP_MULTI_PHASE_DISC - 1] = disc_ticks;
+    ble_gap_multi.window_ticks[BLE_GAP_MULTI_PHASE_IDLE - 1] =
+        period_ticks - adv_ticks - disc_ticks;
+    if (adv_params != NULL) {
+        ble_gap_multi.adv_params = *adv_params;
+    }
+    if (disc_params != NULL) {
+        ble_gap_multi.disc_params = *disc_params;
+        if (disc_params->itvl == 0 && disc_params->window == 0) {
+            ble_gap_multi.disc_params.itvl = BLE_GAP_SCAN_FAST_WINDOW;
+            ble_gap_multi.disc_params.window = BLE_GAP_SCAN_FAST_WINDOW;
+        }
+    }
+    ble_gap_multi.cb = cb;
+    ble_gap_multi.cb_arg = cb_arg;
+
+    ble_hs_unlock();
+
+    BLE_HS_LOG(INFO, "GAP procedure initiated: multi-role; period=%lu "
+                     "adv_pct=%d disc_pct=%d\n",
+               (unsigned long)multi_params->period_ms,
+               multi_params->adv_pct, multi_params->disc_pct);
+
+    rc = ble_gap_multi_enter(
+        ble_gap_multi_next_phase(BLE_GAP_MULTI_PHASE_IDLE));
+    if (rc != 0) {
+        ble_gap_multi.phase = BLE_GAP_MULTI_PHASE_NULL;
+        goto done;
+    }
+
+    ble_hs_lock();
+    ble_gap_heartbeat_sched();
+    ble_hs_unlock();
+
+    return 0;
+
+err:
+    ble_hs_unlock();
+
+done:
+    STATS_INC(ble_gap_stats, multi_start_fail);
+    return rc;
+}
+
+/**
+ * Stops the multi-role procedure, along with the advertising or discovery
+ * window in progress.  No event is reported.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if there is no multi-role
+ *                                  procedure in progress;
+ *                              Other nonzero on error.
+ */
+int
+ble_gap_multi_stop(void)
+{
+    int rc;
+
+    STATS_INC(ble_gap_stats, multi_stop);
+
+    if (!ble_gap_multi_active()) {
+        return BLE_HS_EALREADY;
+    }
+
+    rc = ble_gap_multi_leave();
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_gap_multi.phase = BLE_GAP_MULTI_PHASE_NULL;
+
+    return 0;
+}
+
+/**
+ * Indicates whether a multi-role procedure is currently in progress.
+ *
+ * @return                      0: No multi-role procedure in progress;
+ *                              1: Multi-role procedure in progress.
+ */
+int
+ble_gap_multi_active(void)
+{
+    /* Assume read is atomic; mutex not necessary. */
+    return ble_gap_multi.phase != BLE_GAP_MULTI_PHASE_NULL;
+}
+
+/*****************************************************************************
+ * $connection establishment procedures                                      *
+ *****************************************************************************/
+
+static int
+ble_gap_conn_create_tx(uint8_t own_addr_type,
+                       uint8_t peer_addr_type, const uint8_t *peer_addr,
+                       const struct ble_gap_conn_params *params)
+{
+    uint8_t buf[BLE_HCI_CMD_HDR_LEN + BLE_HCI_CREATE_CONN_LEN];
     struct hci_create_conn hcc;
     int rc;
 
@@ -2946,6 +3625,7 @@ done:
     ble_hs_lock();
     if (rc == 0) {
         SLIST_INSERT_HEAD(&ble_gap_update_entries, entry, next);
+        ble_hs_heartbeat_sched(BLE_GAP_UPDATE_TIMEOUT);
     } else {
         STATS_INC(ble_gap_stats, update_fail);
     }
@@ -2954,6 +3634,282 @@ done:
     return rc;
 }
 
+/*****************************************************************************
+ * $tune                                                                     *
+ *****************************************************************************/
+
+/**
+ * Samples a tuned connection's traffic since the previous sample and decides
+ * which profile the connection should use.
+ *
+ * @return                      The profile to switch to;
+ *                              BLE_GAP_TUNE_PROFILE_NONE if the connection
+ *                                  should keep its current parameters.
+ */
+static uint8_t
+ble_gap_tune_sample(struct ble_hs_conn *conn)
+{
+    const struct ble_gap_tune_params *params;
+    struct os_mbuf_pkthdr *omp;
+    uint32_t queued;
+    uint32_t rate;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    params = conn->bhc_tune;
+
+    queued = 0;
+    STAILQ_FOREACH(omp, &conn->bhc_tx_q, omp_next) {
+        queued += omp->omp_len;
+    }
+
+    rate = conn->bhc_tune_bytes * 1000 / BLE_GAP_TUNE_PERIOD_MS;
+    conn->bhc_tune_bytes = 0;
+
+    if ((params->busy_queued != 0 && queued >= params->busy_queued) ||
+        (params->busy_rate != 0 && rate >= params->busy_rate)) {
+
+        conn->bhc_tune_idle = 0;
+        if (conn->bhc_tune_profile != BLE_GAP_TUNE_PROFILE_THROUGHPUT) {
+            return BLE_GAP_TUNE_PROFILE_THROUGHPUT;
+        }
+        return BLE_GAP_TUNE_PROFILE_NONE;
+    }
+
+    if (queued != 0 || rate >= params->idle_rate) {
+        conn->bhc_tune_idle = 0;
+        return BLE_GAP_TUNE_PROFILE_NONE;
+    }
+
+    if (conn->bhc_tune_idle < params->idle_samples) {
+        conn->bhc_tune_idle++;
+    }
+    if (conn->bhc_tune_idle >= params->idle_samples &&
+        conn->bhc_tune_profile != BLE_GAP_TUNE_PROFILE_POWER) {
+
+        return BLE_GAP_TUNE_PROFILE_POWER;
+    }
+
+    return BLE_GAP_TUNE_PROFILE_NONE;
+}
+
+/**
+ * Requests the parameters of the specified profile.  The connection only
+ * records the new profile if the controller accepted the connection update;
+ * otherwise (e.g., another update is still in progress), the switch is
+ * retried at the next sample.  A failed data length update is not retried;
+ * the controller may simply not support the feature.
+ */
+static void
+ble_gap_tune_apply(uint16_t conn_handle,
+                   const struct ble_gap_tune_params *params, uint8_t profile)
+{
+    const struct ble_gap_upd_params *upd_params;
+    struct ble_hs_conn *conn;
+    uint16_t tx_octets;
+    uint16_t tx_time;
+    int rc;
+
+    if (profile == BLE_GAP_TUNE_PROFILE_THROUGHPUT) {
+        upd_params = &params->throughput;
+        tx_octets = params->throughput_tx_octets;
+        tx_time = params->throughput_tx_time;
+    } else {
+        upd_params = &params->power;
+        tx_octets = params->power_tx_octets;
+        tx_time = params->power_tx_time;
+    }
+
+    rc = ble_gap_update_params(conn_handle, upd_params);
+    if (rc != 0) {
+        STATS_INC(ble_gap_stats, tune_switch_fail);
+        return;
+    }
+
+    if (tx_octets != 0) {
+        ble_hs_hci_util_set_data_len(conn_handle, tx_octets, tx_time);
+    }
+
+    ble_hs_lock();
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL && conn->bhc_tune == params) {
+        conn->bhc_tune_profile = profile;
+    }
+    ble_hs_unlock();
+
+    STATS_INC(ble_gap_stats, tune_switch);
+}
+
+/**
+ * Samples every tuned connection and switches the profile of those whose
+ * traffic has changed.  The sample timer is stopped when no connection has a
+ * tuning policy.
+ *
+ * @return                      The number of ticks until this function should
+ *                                  be called again.
+ */
+static int32_t
+ble_gap_tune_heartbeat(void)
+{
+    struct {
+        const struct ble_gap_tune_params *params;
+        uint16_t conn_handle;
+        uint8_t profile;
+    } switches[BLE_GAP_TUNE_MAX_SWITCHES];
+    struct ble_hs_conn *conn;
+    int32_t ticks_until_exp;
+    uint8_t profile;
+    int num_switches;
+    int num_tuned;
+    int i;
+
+    ticks_until_exp = ble_gap_tune_ticks_until_exp();
+    if (ticks_until_exp != 0) {
+        /* Timer not expired yet. */
+        return ticks_until_exp;
+    }
+
+    num_switches = 0;
+    num_tuned = 0;
+
+    ble_hs_lock();
+
+    for (conn = ble_hs_conn_first();
+         conn != NULL;
+         conn = SLIST_NEXT(conn, bhc_next)) {
+
+        if (conn->bhc_tune == NULL) {
+            continue;
+        }
+        num_tuned++;
+
+        profile = ble_gap_tune_sample(conn);
+        if (profile != BLE_GAP_TUNE_PROFILE_NONE &&
+            num_switches < BLE_GAP_TUNE_MAX_SWITCHES) {
+
+            switches[num_switches].params = conn->bhc_tune;
+            switches[num_switches].conn_handle = conn->bhc_handle;
+            switches[num_switches].profile = profile;
+            num_switches++;
+        }
+    }
+
+    if (num_tuned == 0) {
+        ble_gap_tune_timer.exp_set = 0;
+    } else {
+        ble_gap_tune_timer.exp_os_ticks = os_time_get() + BLE_GAP_TUNE_PERIOD;
+    }
+
+    ble_hs_unlock();
+
+    /* Connection updates must be initiated with the host unlocked. */
+    for (i = 0; i < num_switches; i++) {
+        ble_gap_tune_apply(switches[i].conn_handle, switches[i].params,
+                           switches[i].profile);
+    }
+
+    return ble_gap_tune_ticks_until_exp();
+}
+
+/**
+ * Enables or disables automatic tuning of a connection's parameters.  While
+ * tuning is enabled, the host samples the connection's ACL traffic every
+ * BLE_GAP_TUNE_PERIOD_MS milliseconds, and switches between the policy's
+ * throughput and power parameters as the traffic changes.  Each switch
+ * performs the connection parameter update procedure and, if the profile
+ * specifies a data length, the data length update procedure.  The
+ * application is notified of each completed update with a
+ * BLE_GAP_EVENT_CONN_UPDATE event, as with ble_gap_update_params().
+ *
+ * @param conn_handle           The handle corresponding to the connection to
+ *                                  tune.
+ * @param params                The tuning policy, or NULL to disable tuning.
+ *                                  The policy is not copied; it must remain
+ *                                  valid while tuning is enabled.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTCONN if the there is no connection
+ *                                  with the specified handle;
+ *                              BLE_HS_EINVAL if the policy's idle rate is
+ *                                  not below its busy rate.
+ */
+int
+ble_gap_tune(uint16_t conn_handle, const struct ble_gap_tune_params *params)
+{
+#if !NIMBLE_OPT(CONNECT)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    struct ble_hs_conn *conn;
+    int rc;
+
+    if (params != NULL &&
+        params->busy_rate != 0 && params->idle_rate >= params->busy_rate) {
+
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        rc = BLE_HS_ENOTCONN;
+    } else {
+        conn->bhc_tune = params;
+        conn->bhc_tune_bytes = 0;
+        conn->bhc_tune_profile = BLE_GAP_TUNE_PROFILE_NONE;
+        conn->bhc_tune_idle = 0;
+
+        if (params != NULL && !ble_gap_tune_timer.exp_set) {
+            ble_gap_tune_timer.exp_os_ticks = os_time_get() +
+                                              BLE_GAP_TUNE_PERIOD;
+            ble_gap_tune_timer.exp_set = 1;
+            ble_gap_heartbeat_sched();
+        }
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Retrieves the profile that connection auto-tuning last applied to the
+ * specified connection.
+ *
+ * @param conn_handle           The connection to query.
+ * @param out_profile           On success, one of the
+ *                                  BLE_GAP_TUNE_PROFILE_[...] values is
+ *                                  written here.  BLE_GAP_TUNE_PROFILE_NONE
+ *                                  indicates that tuning is disabled or has
+ *                                  not switched the connection yet.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTCONN if the there is no connection
+ *                                  with the specified handle.
+ */
+int
+ble_gap_tune_profile(uint16_t conn_handle, uint8_t *out_profile)
+{
+    struct ble_hs_conn *conn;
+    int rc;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        rc = BLE_HS_ENOTCONN;
+    } else {
+        *out_profile = conn->bhc_tune_profile;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
 /*****************************************************************************
  * $security                                                                 *
  *****************************************************************************/
@@ -3243,25 +4199,17 @@ ble_gap_init(void)
 {
     int rc;
 
-    free(ble_gap_update_entry_mem);
-
     memset(&ble_gap_master, 0, sizeof ble_gap_master);
     memset(&ble_gap_slave, 0, sizeof ble_gap_slave);
+    memset(&ble_gap_multi, 0, sizeof ble_gap_multi);
+    memset(&ble_gap_tune_timer, 0, sizeof ble_gap_tune_timer);
 
     SLIST_INIT(&ble_gap_update_entries);
 
-    rc = mem_malloc_mempool(&ble_gap_update_entry_pool,
-                            BLE_GAP_MAX_UPDATE_ENTRIES,
-                            sizeof (struct ble_gap_update_entry),
-                            "ble_gap_update",
-                            &ble_gap_update_entry_mem);
-    switch (rc) {
-    case 0:
-        break;
-    case OS_ENOMEM:
-        rc = BLE_HS_ENOMEM;
-        goto err;
-    default:
+    rc = OS_MEMPOOL_INIT(ble_gap_update_entry_pool,
+                         BLE_GAP_MAX_UPDATE_ENTRIES,
+                         sizeof (struct ble_gap_update_entry));
+    if (rc != 0) {
         rc = BLE_HS_EOS;
         goto err;
     }
@@ -3276,8 +4224,5 @@ ble_gap_init(void)
     return 0;
 
 err:
-    free(ble_gap_update_entry_mem);
-    ble_gap_update_entry_mem = NULL;
-
     return rc;
 }
@@ -63,10 +63,19 @@ STATS_SECT_START(ble_gap_stats)
     STATS_SECT_ENTRY(discover_cancel_fail)
     STATS_SECT_ENTRY(security_initiate)
     STATS_SECT_ENTRY(security_initiate_fail)
+    STATS_SECT_ENTRY(multi_start)
+    STATS_SECT_ENTRY(multi_start_fail)
+    STATS_SECT_ENTRY(multi_stop)
+    STATS_SECT_ENTRY(multi_window_fail)
+    STATS_SECT_ENTRY(tune_switch)
+    STATS_SECT_ENTRY(tune_switch_fail)
 STATS_SECT_END
 
 extern STATS_SECT_DECL(ble_gap_stats) ble_gap_stats;
 
+/** Interval at which auto-tuned connections' traffic is sampled (ms). */
+#define BLE_GAP_TUNE_PERIOD_MS              250
+
 #define BLE_GAP_CONN_MODE_MAX               3
 #define BLE_GAP_DISC_MODE_MAX               3
 
@@ -25,6 +25,8 @@
 struct ble_att_read_type_adata;
 struct ble_att_find_type_value_hinfo;
 struct ble_att_find_info_idata;
+struct ble_hs_cfg;
+struct ble_hs_mem_pool;
 struct ble_att_read_group_type_adata;
 struct ble_att_prep_write_cmd;
 
@@ -64,6 +66,8 @@ STATS_SECT_START(ble_gattc_stats)
     STATS_SECT_ENTRY(indicate)
     STATS_SECT_ENTRY(indicate_fail)
     STATS_SECT_ENTRY(proc_timeout)
+    STATS_SECT_ENTRY(cache_hit)
+    STATS_SECT_ENTRY(cache_clear)
 STATS_SECT_END
 extern STATS_SECT_DECL(ble_gattc_stats) ble_gattc_stats;
 
@@ -125,9 +129,13 @@ void ble_gattc_rx_find_info_idata(uint16_t conn_handle,
 void ble_gattc_rx_find_info_complete(uint16_t conn_handle, int status);
 void ble_gattc_connection_txable(uint16_t conn_handle);
 void ble_gattc_connection_broken(uint16_t conn_handle);
+void ble_gattc_cache_rx_indicate(uint16_t conn_handle, uint16_t attr_handle);
+void ble_gattc_cache_replay(void);
 int32_t ble_gattc_heartbeat(void);
 
 int ble_gattc_any_jobs(void);
+int ble_gattc_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                       struct ble_hs_mem_pool *out_pool);
 int ble_gattc_init(void);
 
 /*** @server. */
@@ -149,6 +157,8 @@ void ble_gatts_connection_broken(uint16_t conn_handle);
 int ble_gatts_conn_can_alloc(void);
 int ble_gatts_conn_init(struct ble_gatts_conn *gatts_conn);
 int ble_gatts_start(void);
+int ble_gatts_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                       struct ble_hs_mem_pool *out_pool);
 int ble_gatts_init(void);
 
 #endif
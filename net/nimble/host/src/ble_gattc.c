@@ -36,9 +36,10 @@
  * Notes on thread-safety:
  * 1. The ble_hs mutex must never be locked when an application callback is
  *    executed.  A callback is free to initiate additional host procedures.
- * 2. The only resource protected by the mutex is the list of active procedures
- *    (ble_gattc_procs).  Thread-safety is achieved by locking the mutex during
- *    removal and insertion operations.  Procedure objects are only modified
+ * 2. The only resources protected by the mutex are the lists of active
+ *    procedures (ble_gattc_procs, indexed by connection handle, and
+ *    ble_gattc_exp_procs, ordered by expiry time).  Thread-safety is achieved
+ *    by locking the mutex during removal and insertion operations.  Procedure objects are only modified
  *    while they are not in the list.  This is sufficient, as the host parent
  *    task is the only task which inspects or modifies individual procedure
  *    entries.  Tasks have the following permissions regarding procedure
@@ -48,6 +49,15 @@
  *    ------------+---------+-----------|-----------|---------
  *    parent task | X       | X         | X         | X
  *    other tasks | X       |           |           |
+ *
+ * Discovery cache:
+ * The results of the discover-all-services, -characteristics and
+ * -descriptors procedures on a bonded peer are written to the store.  When
+ * the store already holds the complete result of such a procedure, the
+ * procedure is answered from the store instead of the peer; it is put in
+ * ble_gattc_cache_procs and its callbacks are executed from a host event.
+ * The cache of a peer is cleared when it sends a Service Changed
+ * indication, and when a new bond with it is created.
  */
 
 #include <stddef.h>
@@ -84,13 +94,20 @@
 #define BLE_GATT_OP_INDICATE                    14
 #define BLE_GATT_OP_MAX                         15
 
+/** Procedure results are written to the discovery cache. */
+#define BLE_GATTC_PROC_F_CACHE                  0x01
+
+#define BLE_GATTC_SVC_CHANGED_UUID16            0x2a05
+
 /** Represents an in-progress GATT procedure. */
 struct ble_gattc_proc {
     STAILQ_ENTRY(ble_gattc_proc) next;
+    TAILQ_ENTRY(ble_gattc_proc) exp_next;
 
     uint32_t exp_os_ticks;
     uint16_t conn_handle;
     uint8_t op;
+    uint8_t flags;
 
     union {
         struct {
@@ -105,7 +122,7 @@ struct ble_gattc_proc {
         } disc_all_svcs;
 
         struct {
-            uint8_t service_uuid[16];
+            struct ble_uuid_any service_uuid;
             uint16_t prev_handle;
             ble_gatt_disc_svc_fn *cb;
             void *cb_arg;
@@ -123,6 +140,7 @@ struct ble_gattc_proc {
         } find_inc_svcs;
 
         struct {
+            uint16_t start_handle;
             uint16_t prev_handle;
             uint16_t end_handle;
             ble_gatt_chr_fn *cb;
@@ -130,7 +148,7 @@ struct ble_gattc_proc {
         } disc_all_chrs;
 
         struct {
-            uint8_t chr_uuid[16];
+            struct ble_uuid_any chr_uuid;
             uint16_t prev_handle;
             uint16_t end_handle;
             ble_gatt_chr_fn *cb;
@@ -197,6 +215,7 @@ struct ble_gattc_proc {
 };
 
 STAILQ_HEAD(ble_gattc_proc_list, ble_gattc_proc);
+TAILQ_HEAD(ble_gattc_exp_list, ble_gattc_proc);
 
 /**
  * Error functions - these handle an incoming ATT error response and apply it
@@ -316,10 +335,21 @@ static const struct ble_gattc_rx_exec_entry {
     { BLE_GATT_OP_WRITE_RELIABLE,   ble_gattc_write_reliable_rx_exec },
 };
 
-/* Maintains the list of active GATT client procedures. */
+/* Maintains the lists of active GATT client procedures.  Each procedure is
+ * in the bucket for its connection handle and in the expiry list.
+ */
+#define BLE_GATTC_PROC_BUCKETS                  8
+
+/* Maximum number of notifications queued per host lock acquisition. */
+#define BLE_GATTC_NOTIFY_MULTI_BATCH            8
+
 static void *ble_gattc_proc_mem;
 static struct os_mempool ble_gattc_proc_pool;
-static struct ble_gattc_proc_list ble_gattc_procs;
+static struct ble_gattc_proc_list ble_gattc_procs[BLE_GATTC_PROC_BUCKETS];
+static struct ble_gattc_exp_list ble_gattc_exp_procs;
+#if NIMBLE_OPT(GATT_CACHE)
+static struct ble_gattc_proc_list ble_gattc_cache_procs;
+#endif
 
 /* Statistics. */
 STATS_SECT_DECL(ble_gattc_stats) ble_gattc_stats;
@@ -359,6 +389,8 @@ STATS_NAME_START(ble_gattc_stats)
     STATS_NAME(ble_gattc_stats, indicate)
     STATS_NAME(ble_gattc_stats, indicate_fail)
     STATS_NAME(ble_gattc_stats, proc_timeout)
+    STATS_NAME(ble_gattc_stats, cache_hit)
+    STATS_NAME(ble_gattc_stats, cache_clear)
 STATS_NAME_END(ble_gattc_stats)
 
 /*****************************************************************************
@@ -373,7 +405,7 @@ ble_gattc_dbg_assert_proc_not_inserted(struct ble_gattc_proc *proc)
 
     ble_hs_lock();
 
-    STAILQ_FOREACH(cur, &ble_gattc_procs, next) {
+    TAILQ_FOREACH(cur, &ble_gattc_exp_procs, exp_next) {
         BLE_HS_DBG_ASSERT(cur != proc);
     }
 
@@ -405,11 +437,27 @@ ble_gattc_log_uuid(const void *uuid128)
                u8p[3], u8p[2], u8p[1], u8p[0]);
 }
 
+static void
+ble_gattc_log_uuid_any(const struct ble_uuid_any *uuid)
+{
+    switch (uuid->type) {
+    case BLE_UUID_TYPE_16:
+        BLE_HS_LOG(INFO, "0x%04x", (unsigned)uuid->u32);
+        break;
+    case BLE_UUID_TYPE_32:
+        BLE_HS_LOG(INFO, "0x%08x", (unsigned)uuid->u32);
+        break;
+    default:
+        ble_gattc_log_uuid(uuid->u128);
+        break;
+    }
+}
+
 static void
 ble_gattc_log_disc_svc_uuid(struct ble_gattc_proc *proc)
 {
     ble_gattc_log_proc_init("discover service by uuid; uuid=");
-    ble_gattc_log_uuid(proc->disc_svc_uuid.service_uuid);
+    ble_gattc_log_uuid_any(&proc->disc_svc_uuid.service_uuid);
     BLE_HS_LOG(INFO, "\n");
 }
 
@@ -438,7 +486,7 @@ ble_gattc_log_disc_chr_uuid(struct ble_gattc_proc *proc)
     BLE_HS_LOG(INFO, "start_handle=%d end_handle=%d uuid=",
                proc->disc_chr_uuid.prev_handle + 1,
                proc->disc_chr_uuid.end_handle);
-    ble_gattc_log_uuid(proc->disc_chr_uuid.chr_uuid);
+    ble_gattc_log_uuid_any(&proc->disc_chr_uuid.chr_uuid);
     BLE_HS_LOG(INFO, "\n");
 }
 
@@ -628,20 +676,62 @@ ble_gattc_proc_free(struct ble_gattc_proc *proc)
     }
 }
 
+static struct ble_gattc_proc_list *
+ble_gattc_proc_bucket(uint16_t conn_handle)
+{
+    return &ble_gattc_procs[conn_handle % BLE_GATTC_PROC_BUCKETS];
+}
+
 static void
 ble_gattc_proc_insert(struct ble_gattc_proc *proc)
 {
+    struct ble_gattc_proc *prev;
+
     ble_gattc_dbg_assert_proc_not_inserted(proc);
 
     ble_hs_lock();
-    STAILQ_INSERT_TAIL(&ble_gattc_procs, proc, next);
+
+    STAILQ_INSERT_TAIL(ble_gattc_proc_bucket(proc->conn_handle), proc, next);
+
+    /* All procedures get the same timeout when inserted, so this normally
+     * appends.
+     */
+    prev = TAILQ_LAST(&ble_gattc_exp_procs, ble_gattc_exp_list);
+    while (prev != NULL && (int32_t)(prev->exp_os_ticks -
+                                     proc->exp_os_ticks) > 0) {
+        prev = TAILQ_PREV(prev, ble_gattc_exp_list, exp_next);
+    }
+    if (prev == NULL) {
+        TAILQ_INSERT_HEAD(&ble_gattc_exp_procs, proc, exp_next);
+    } else {
+        TAILQ_INSERT_AFTER(&ble_gattc_exp_procs, prev, proc, exp_next);
+    }
+
     ble_hs_unlock();
 }
 
+/**
+ * Removes a procedure from both lists; prev is its predecessor in the
+ * connection bucket, or null if it is first.  Called with the host mutex
+ * locked.
+ */
+static void
+ble_gattc_proc_remove(struct ble_gattc_proc_list *bucket,
+                      struct ble_gattc_proc *prev, struct ble_gattc_proc *proc)
+{
+    if (prev == NULL) {
+        STAILQ_REMOVE_HEAD(bucket, next);
+    } else {
+        STAILQ_REMOVE_AFTER(bucket, prev, next);
+    }
+    TAILQ_REMOVE(&ble_gattc_exp_procs, proc, exp_next);
+}
+
 static void
 ble_gattc_proc_set_timer(struct ble_gattc_proc *proc)
 {
     proc->exp_os_ticks = os_time_get() + BLE_GATT_UNRESPONSIVE_TIMEOUT;
+    ble_hs_heartbeat_sched(BLE_GATT_UNRESPONSIVE_TIMEOUT);
 }
 
 static void
@@ -697,22 +787,21 @@ ble_gattc_proc_matches(struct ble_gattc_proc *proc, uint16_t conn_handle,
 static struct ble_gattc_proc *
 ble_gattc_extract(uint16_t conn_handle, uint8_t op)
 {
+    struct ble_gattc_proc_list *bucket;
     struct ble_gattc_proc *proc;
     struct ble_gattc_proc *prev;
 
     /* Only the parent task is allowed to remove entries from the list. */
     BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
 
+    bucket = ble_gattc_proc_bucket(conn_handle);
+
     ble_hs_lock();
 
     prev = NULL;
-    STAILQ_FOREACH(proc, &ble_gattc_procs, next) {
+    STAILQ_FOREACH(proc, bucket, next) {
         if (ble_gattc_proc_matches(proc, conn_handle, op)) {
-            if (prev == NULL) {
-                STAILQ_REMOVE_HEAD(&ble_gattc_procs, next);
-            } else {
-                STAILQ_REMOVE_AFTER(&ble_gattc_procs, prev, next);
-            }
+            ble_gattc_proc_remove(bucket, prev, proc);
             break;
         }
         prev = proc;
@@ -744,9 +833,11 @@ static void
 ble_gattc_extract_by_conn_op(uint16_t conn_handle, uint8_t op,
                              struct ble_gattc_proc_list *dst_list)
 {
+    struct ble_gattc_proc_list *bucket;
     struct ble_gattc_proc *proc;
     struct ble_gattc_proc *prev;
     struct ble_gattc_proc *next;
+    int i;
 
     /* Only the parent task is allowed to remove entries from the list. */
     BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
@@ -755,36 +846,48 @@ ble_gattc_extract_by_conn_op(uint16_t conn_handle, uint8_t op,
 
     ble_hs_lock();
 
-    prev = NULL;
-    proc = STAILQ_FIRST(&ble_gattc_procs);
-    while (proc != NULL) {
-        next = STAILQ_NEXT(proc, next);
+    for (i = 0; i < BLE_GATTC_PROC_BUCKETS; i++) {
+        bucket = &ble_gattc_procs[i];
+        if (conn_handle != BLE_HS_CONN_HANDLE_NONE &&
+            bucket != ble_gattc_proc_bucket(conn_handle)) {
+
+            continue;
+        }
 
-        if (ble_gattc_conn_op_matches(proc, conn_handle, op)) {
-            if (prev == NULL) {
-                STAILQ_REMOVE_HEAD(&ble_gattc_procs, next);
+        prev = NULL;
+        proc = STAILQ_FIRST(bucket);
+        while (proc != NULL) {
+            next = STAILQ_NEXT(proc, next);
+
+            if (ble_gattc_conn_op_matches(proc, conn_handle, op)) {
+                ble_gattc_proc_remove(bucket, prev, proc);
+                STAILQ_INSERT_TAIL(dst_list, proc, next);
             } else {
-                STAILQ_REMOVE_AFTER(&ble_gattc_procs, prev, next);
+                prev = proc;
             }
-            STAILQ_INSERT_TAIL(dst_list, proc, next);
-        } else {
-            prev = proc;
-        }
 
-        proc = next;
+            proc = next;
+        }
     }
 
     ble_hs_unlock();
 }
 
-static void
+/**
+ * Removes all expired procedures and inserts them into the specified list.
+ *
+ * @return                      The number of ticks until the next remaining
+ *                                  procedure expires; BLE_HS_FOREVER if
+ *                                  none remain.
+ */
+static int32_t
 ble_gattc_extract_expired(struct ble_gattc_proc_list *dst_list)
 {
+    struct ble_gattc_proc_list *bucket;
     struct ble_gattc_proc *proc;
-    struct ble_gattc_proc *prev;
-    struct ble_gattc_proc *next;
-    uint32_t now;
+    int32_t next_exp_in;
     int32_t time_diff;
+    uint32_t now;
 
     /* Only the parent task is allowed to remove entries from the list. */
     BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
@@ -794,26 +897,24 @@ ble_gattc_extract_expired(struct ble_gattc_proc_list *dst_list)
 
     ble_hs_lock();
 
-    prev = NULL;
-    proc = STAILQ_FIRST(&ble_gattc_procs);
-    while (proc != NULL) {
-        next = STAILQ_NEXT(proc, next);
-
+    /* The expiry list is ordered, so stop at the first live procedure. */
+    next_exp_in = BLE_HS_FOREVER;
+    while ((proc = TAILQ_FIRST(&ble_gattc_exp_procs)) != NULL) {
         time_diff = now - proc->exp_os_ticks;
-        if (time_diff >= 0) {
-            if (prev == NULL) {
-                STAILQ_REMOVE_HEAD(&ble_gattc_procs, next);
-            } else {
-                STAILQ_REMOVE_AFTER(&ble_gattc_procs, prev, next);
-            }
-            STAILQ_INSERT_TAIL(dst_list, proc, next);
+        if (time_diff < 0) {
+            next_exp_in = -time_diff;
+            break;
         }
 
-        prev = proc;
-        proc = next;
+        bucket = ble_gattc_proc_bucket(proc->conn_handle);
+        STAILQ_REMOVE(bucket, proc, ble_gattc_proc, next);
+        TAILQ_REMOVE(&ble_gattc_exp_procs, proc, exp_next);
+        STAILQ_INSERT_TAIL(dst_list, proc, next);
     }
 
     ble_hs_unlock();
+
+    return next_exp_in;
 }
 
 static struct ble_gattc_proc *
@@ -821,6 +922,7 @@ ble_gattc_extract_with_rx_entry(uint16_t conn_handle,
                                 const void *rx_entries, int num_entries,
                                 const void **out_rx_entry)
 {
+    struct ble_gattc_proc_list *bucket;
     struct ble_gattc_proc *proc;
     struct ble_gattc_proc *prev;
     const void *rx_entry;
@@ -828,19 +930,17 @@ ble_gattc_extract_with_rx_entry(uint16_t conn_handle,
     /* Only the parent task is allowed to remove entries from the list. */
     BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
 
+    bucket = ble_gattc_proc_bucket(conn_handle);
+
     ble_hs_lock();
 
     prev = NULL;
-    STAILQ_FOREACH(proc, &ble_gattc_procs, next) {
+    STAILQ_FOREACH(proc, bucket, next) {
         if (proc->conn_handle == conn_handle) {
             rx_entry = ble_gattc_rx_entry_find(proc->op, rx_entries,
                                                num_entries);
             if (rx_entry != NULL) {
-                if (prev == NULL) {
-                    STAILQ_REMOVE_HEAD(&ble_gattc_procs, next);
-                } else {
-                    STAILQ_REMOVE_AFTER(&ble_gattc_procs, prev, next);
-                }
+                ble_gattc_proc_remove(bucket, prev, proc);
 
                 *out_rx_entry = rx_entry;
                 break;
@@ -905,28 +1005,29 @@ ble_gattc_fail_procs(uint16_t conn_handle, uint8_t op, int status)
 }
 
 /**
- * Applies periodic checks and actions to all active procedures.
+ * Times out expired procedures.
  *
  * All procedures that have been expecting a response for longer than 30
  * seconds are aborted and their corresponding connection is terminated.
  *
- * Called by the heartbeat timer; executed at least once a second.
+ * Called by the heartbeat timer when a GATT deadline may have expired.
  *
  * @return                      The number of ticks until this function should
- *                                  be called again; currently always
- *                                  UINT32_MAX.
+ *                                  be called again; BLE_HS_FOREVER if no
+ *                                  procedures are pending.
  */
 int32_t
 ble_gattc_heartbeat(void)
 {
     struct ble_gattc_proc_list exp_list;
     struct ble_gattc_proc *proc;
+    int32_t ticks_until_exp;
 
     /* Remove timed-out procedures from the main list and insert them into a
      * temporary list.  For any stalled procedures, set their pending bit so
      * they can be retried.
      */
-    ble_gattc_extract_expired(&exp_list);
+    ticks_until_exp = ble_gattc_extract_expired(&exp_list);
 
     /* Terminate the connection associated with each timed-out procedure. */
     while ((proc = STAILQ_FIRST(&exp_list)) != NULL) {
@@ -937,7 +1038,7 @@ ble_gattc_heartbeat(void)
         ble_gattc_proc_free(proc);
     }
 
-    return BLE_HS_FOREVER;
+    return ticks_until_exp;
 }
 
 /**
@@ -960,6 +1061,437 @@ ble_gattc_error(int status, uint16_t att_handle)
     return &error;
 }
 
+/*****************************************************************************
+ * $cache                                                                    *
+ *****************************************************************************/
+
+#if NIMBLE_OPT(GATT_CACHE)
+
+static int ble_gattc_disc_all_svcs_cb(struct ble_gattc_proc *proc,
+                                      uint16_t status, uint16_t att_handle,
+                                      struct ble_gatt_svc *service);
+static int ble_gattc_disc_all_chrs_cb(struct ble_gattc_proc *proc, int status,
+                                      uint16_t att_handle,
+                                      struct ble_gatt_chr *chr);
+static int ble_gattc_disc_all_dscs_cb(struct ble_gattc_proc *proc, int status,
+                                      uint16_t att_handle,
+                                      struct ble_gatt_dsc *dsc);
+
+static struct os_event ble_gattc_cache_ev = {
+    .ev_type = BLE_HS_EVENT_GATTC_CACHE,
+};
+
+/**
+ * Fills in a store key matching all cached attributes of the peer on the
+ * specified connection.  Only bonded peers have a cache.
+ *
+ * @return                      0 on success; BLE_HS_ENOENT if the peer is not
+ *                                  connected or not bonded.
+ */
+static int
+ble_gattc_cache_peer(uint16_t conn_handle, struct ble_store_key_gatt *key)
+{
+    struct ble_gap_conn_desc desc;
+    int rc;
+
+    rc = ble_gap_conn_find(conn_handle, &desc);
+    if (rc != 0 || !desc.sec_state.bonded) {
+        return BLE_HS_ENOENT;
+    }
+
+    memset(key, 0, sizeof *key);
+    key->peer_addr_type = desc.peer_id_addr_type;
+    memcpy(key->peer_addr, desc.peer_id_addr, sizeof key->peer_addr);
+    key->type = BLE_STORE_GATT_TYPE_ANY;
+
+    return 0;
+}
+
+static int
+ble_gattc_cache_read(struct ble_store_key_gatt *key, uint8_t type,
+                     uint16_t handle, struct ble_store_value_gatt *value)
+{
+    struct ble_store_key_gatt attr_key;
+
+    attr_key = *key;
+    attr_key.type = type;
+    attr_key.handle = handle;
+
+    return ble_store_read_gatt(&attr_key, value);
+}
+
+/**
+ * Writes a discovery result to the cache.  attr is the service,
+ * characteristic or descriptor reported with a status of 0; a status of
+ * BLE_HS_EDONE marks the procedure's range as completely cached.  If the
+ * store can't take the result, the rest of the procedure is not cached.
+ */
+static void
+ble_gattc_cache_record(struct ble_gattc_proc *proc, int status,
+                       const void *attr)
+{
+    struct ble_store_value_gatt value;
+    struct ble_store_key_gatt key;
+    const struct ble_gatt_svc *svc;
+    const struct ble_gatt_chr *chr;
+    const struct ble_gatt_dsc *dsc;
+    int rc;
+
+    if (!(proc->flags & BLE_GATTC_PROC_F_CACHE)) {
+        return;
+    }
+
+    if (status != 0 && status != BLE_HS_EDONE) {
+        rc = status;
+        goto done;
+    }
+
+    rc = ble_gattc_cache_peer(proc->conn_handle, &key);
+    if (rc != 0) {
+        goto done;
+    }
+
+    if (status == 0) {
+        memset(&value, 0, sizeof value);
+        value.peer_addr_type = key.peer_addr_type;
+        memcpy(value.peer_addr, key.peer_addr, sizeof value.peer_addr);
+
+        switch (proc->op) {
+        case BLE_GATT_OP_DISC_ALL_SVCS:
+            svc = attr;
+            value.type = BLE_STORE_GATT_TYPE_SVC;
+            value.handle = svc->start_handle;
+            value.end_handle = svc->end_handle;
+            memcpy(value.uuid128, svc->uuid128, 16);
+            break;
+
+        case BLE_GATT_OP_DISC_ALL_CHRS:
+            chr = attr;
+            value.type = BLE_STORE_GATT_TYPE_CHR;
+            value.handle = chr->def_handle;
+            value.val_handle = chr->val_handle;
+            value.properties = chr->properties;
+            memcpy(value.uuid128, chr->uuid128, 16);
+            break;
+
+        case BLE_GATT_OP_DISC_ALL_DSCS:
+            dsc = attr;
+            value.type = BLE_STORE_GATT_TYPE_DSC;
+            value.handle = dsc->handle;
+            memcpy(value.uuid128, dsc->uuid128, 16);
+            break;
+
+        default:
+            BLE_HS_DBG_ASSERT(0);
+            break;
+        }
+
+        rc = ble_store_write_gatt(&value);
+        goto done;
+    }
+
+    /* Procedure complete; mark its range. */
+    switch (proc->op) {
+    case BLE_GATT_OP_DISC_ALL_SVCS:
+        memset(&value, 0, sizeof value);
+        value.peer_addr_type = key.peer_addr_type;
+        memcpy(value.peer_addr, key.peer_addr, sizeof value.peer_addr);
+        value.type = BLE_STORE_GATT_TYPE_DB;
+        value.flags = BLE_STORE_GATT_F_COMPLETE;
+        break;
+
+    case BLE_GATT_OP_DISC_ALL_CHRS:
+        rc = ble_gattc_cache_read(&key, BLE_STORE_GATT_TYPE_SVC,
+                                  proc->disc_all_chrs.start_handle, &value);
+        if (rc != 0 ||
+            value.end_handle != proc->disc_all_chrs.end_handle) {
+
+            /* Not a whole service. */
+            return;
+        }
+        value.flags |= BLE_STORE_GATT_F_COMPLETE;
+        break;
+
+    case BLE_GATT_OP_DISC_ALL_DSCS:
+        rc = ble_gattc_cache_read(&key, BLE_STORE_GATT_TYPE_CHR,
+                                  proc->disc_all_dscs.chr_val_handle - 1,
+                                  &value);
+        if (rc != 0 ||
+            value.val_handle != proc->disc_all_dscs.chr_val_handle) {
+
+            return;
+        }
+        value.end_handle = proc->disc_all_dscs.end_handle;
+        value.flags |= BLE_STORE_GATT_F_COMPLETE;
+        break;
+
+    default:
+        BLE_HS_DBG_ASSERT(0);
+        return;
+    }
+
+    rc = ble_store_write_gatt(&value);
+
+done:
+    if (rc != 0) {
+        proc->flags &= ~BLE_GATTC_PROC_F_CACHE;
+    }
+}
+
+/**
+ * Checks if the complete result of the specified discovery procedure is
+ * cached.  If so, the procedure is scheduled to be answered from the cache.
+ * Otherwise, if the peer is bonded, the procedure's results are recorded as
+ * they arrive.
+ *
+ * @return                      1 if the procedure is answered from the cache;
+ *                              0 if it has to be executed.
+ */
+static int
+ble_gattc_cache_hit(struct ble_gattc_proc *proc)
+{
+    struct ble_store_value_gatt value;
+    struct ble_store_key_gatt key;
+    int rc;
+
+    rc = ble_gattc_cache_peer(proc->conn_handle, &key);
+    if (rc != 0) {
+        return 0;
+    }
+
+    switch (proc->op) {
+    case BLE_GATT_OP_DISC_ALL_SVCS:
+        rc = ble_gattc_cache_read(&key, BLE_STORE_GATT_TYPE_DB, 0, &value);
+        break;
+
+    case BLE_GATT_OP_DISC_ALL_CHRS:
+        rc = ble_gattc_cache_read(&key, BLE_STORE_GATT_TYPE_SVC,
+                                  proc->disc_all_chrs.start_handle, &value);
+        if (rc == 0 &&
+            (!(value.flags & BLE_STORE_GATT_F_COMPLETE) ||
+             value.end_handle != proc->disc_all_chrs.end_handle)) {
+
+            rc = BLE_HS_ENOENT;
+        }
+        break;
+
+    case BLE_GATT_OP_DISC_ALL_DSCS:
+        rc = ble_gattc_cache_read(&key, BLE_STORE_GATT_TYPE_CHR,
+                                  proc->disc_all_dscs.chr_val_handle - 1,
+                                  &value);
+        if (rc == 0 &&
+            (!(value.flags & BLE_STORE_GATT_F_COMPLETE) ||
+             value.val_handle != proc->disc_all_dscs.chr_val_handle ||
+             value.end_handle != proc->disc_all_dscs.end_handle)) {
+
+            rc = BLE_HS_ENOENT;
+        }
+        break;
+
+    default:
+        BLE_HS_DBG_ASSERT(0);
+        return 0;
+    }
+
+    if (rc != 0) {
+        proc->flags |= BLE_GATTC_PROC_F_CACHE;
+        return 0;
+    }
+
+    STATS_INC(ble_gattc_stats, cache_hit);
+
+    ble_hs_lock();
+    STAILQ_INSERT_TAIL(&ble_gattc_cache_procs, proc, next);
+    ble_hs_unlock();
+
+    ble_hs_event_enqueue(&ble_gattc_cache_ev);
+
+    return 1;
+}
+
+/**
+ * Reports the cached results of a procedure to the application.
+ */
+static void
+ble_gattc_cache_replay_proc(struct ble_gattc_proc *proc)
+{
+    struct ble_store_value_gatt value;
+    struct ble_store_key_gatt key;
+    struct ble_gatt_svc svc;
+    struct ble_gatt_chr chr;
+    struct ble_gatt_dsc dsc;
+    uint16_t start_handle;
+    uint16_t end_handle;
+    uint8_t type;
+    int status;
+    int rc;
+    int i;
+
+    switch (proc->op) {
+    case BLE_GATT_OP_DISC_ALL_SVCS:
+        type = BLE_STORE_GATT_TYPE_SVC;
+        start_handle = 0x0001;
+        end_handle = 0xffff;
+        break;
+
+    case BLE_GATT_OP_DISC_ALL_CHRS:
+        type = BLE_STORE_GATT_TYPE_CHR;
+        start_handle = proc->disc_all_chrs.start_handle;
+        end_handle = proc->disc_all_chrs.end_handle;
+        break;
+
+    case BLE_GATT_OP_DISC_ALL_DSCS:
+        type = BLE_STORE_GATT_TYPE_DSC;
+        start_handle = proc->disc_all_dscs.chr_val_handle + 1;
+        end_handle = proc->disc_all_dscs.end_handle;
+        break;
+
+    default:
+        BLE_HS_DBG_ASSERT(0);
+        return;
+    }
+
+    rc = ble_gattc_cache_peer(proc->conn_handle, &key);
+    if (rc != 0) {
+        status = BLE_HS_ENOTCONN;
+        goto done;
+    }
+
+    /* Attributes are cached in the order they were discovered. */
+    for (i = 0; i <= UINT8_MAX; i++) {
+        key.idx = i;
+        rc = ble_store_read_gatt(&key, &value);
+        if (rc != 0) {
+            break;
+        }
+
+        if (value.type != type ||
+            value.handle < start_handle || value.handle > end_handle) {
+
+            continue;
+        }
+
+        switch (proc->op) {
+        case BLE_GATT_OP_DISC_ALL_SVCS:
+            svc.start_handle = value.handle;
+            svc.end_handle = value.end_handle;
+            memcpy(svc.uuid128, value.uuid128, 16);
+            rc = ble_gattc_disc_all_svcs_cb(proc, 0, 0, &svc);
+            break;
+
+        case BLE_GATT_OP_DISC_ALL_CHRS:
+            chr.def_handle = value.handle;
+            chr.val_handle = value.val_handle;
+            chr.properties = value.properties;
+            memcpy(chr.uuid128, value.uuid128, 16);
+            rc = ble_gattc_disc_all_chrs_cb(proc, 0, 0, &chr);
+            break;
+
+        default:
+            dsc.handle = value.handle;
+            memcpy(dsc.uuid128, value.uuid128, 16);
+            rc = ble_gattc_disc_all_dscs_cb(proc, 0, 0, &dsc);
+            break;
+        }
+        if (rc != 0) {
+            /* Application aborted the procedure. */
+            return;
+        }
+    }
+
+    status = BLE_HS_EDONE;
+
+done:
+    switch (proc->op) {
+    case BLE_GATT_OP_DISC_ALL_SVCS:
+        ble_gattc_disc_all_svcs_cb(proc, status, 0, NULL);
+        break;
+
+    case BLE_GATT_OP_DISC_ALL_CHRS:
+        ble_gattc_disc_all_chrs_cb(proc, status, 0, NULL);
+        break;
+
+    default:
+        ble_gattc_disc_all_dscs_cb(proc, status, 0, NULL);
+        break;
+    }
+}
+
+#else
+
+#define ble_gattc_cache_record(proc, status, attr)
+#define ble_gattc_cache_hit(proc)               0
+
+#endif
+
+/**
+ * Answers the procedures scheduled by ble_gattc_cache_hit().  Called from
+ * the host parent task.
+ */
+void
+ble_gattc_cache_replay(void)
+{
+#if NIMBLE_OPT(GATT_CACHE)
+    struct ble_gattc_proc *proc;
+
+    while (1) {
+        ble_hs_lock();
+        proc = STAILQ_FIRST(&ble_gattc_cache_procs);
+        if (proc != NULL) {
+            STAILQ_REMOVE_HEAD(&ble_gattc_cache_procs, next);
+        }
+        ble_hs_unlock();
+
+        if (proc == NULL) {
+            break;
+        }
+
+        ble_gattc_cache_replay_proc(proc);
+        ble_gattc_proc_free(proc);
+    }
+#endif
+}
+
+/**
+ * Clears the peer's cache if the received indication is a Service Changed
+ * indication.  Called before the indication is reported to the application,
+ * so that rediscovery started from the application's handler goes to the
+ * peer.
+ */
+void
+ble_gattc_cache_rx_indicate(uint16_t conn_handle, uint16_t attr_handle)
+{
+#if NIMBLE_OPT(GATT_CACHE)
+    struct ble_store_value_gatt value;
+    struct ble_store_key_gatt key;
+    int rc;
+    int i;
+
+    rc = ble_gattc_cache_peer(conn_handle, &key);
+    if (rc != 0) {
+        return;
+    }
+
+    for (i = 0; i <= UINT8_MAX; i++) {
+        key.idx = i;
+        rc = ble_store_read_gatt(&key, &value);
+        if (rc != 0) {
+            return;
+        }
+
+        if (value.type == BLE_STORE_GATT_TYPE_CHR &&
+            value.val_handle == attr_handle &&
+            ble_uuid_128_to_16(value.uuid128) ==
+                BLE_GATTC_SVC_CHANGED_UUID16) {
+
+            STATS_INC(ble_gattc_stats, cache_clear);
+            ble_store_clear_gatt(key.peer_addr_type, key.peer_addr);
+            return;
+        }
+    }
+#endif
+}
+
 /*****************************************************************************
  * $mtu                                                                      *
  *****************************************************************************/
@@ -1086,6 +1618,8 @@ ble_gattc_disc_all_svcs_cb(struct ble_gattc_proc *proc,
         STATS_INC(ble_gattc_stats, disc_all_svcs_fail);
     }
 
+    ble_gattc_cache_record(proc, status, service);
+
     if (proc->disc_all_svcs.cb == NULL) {
         rc = 0;
     } else {
@@ -1265,6 +1799,10 @@ ble_gattc_disc_all_svcs(uint16_t conn_handle, ble_gatt_disc_svc_fn *cb,
     proc->disc_all_svcs.cb = cb;
     proc->disc_all_svcs.cb_arg = cb_arg;
 
+    if (ble_gattc_cache_hit(proc)) {
+        return 0;
+    }
+
     ble_gattc_log_proc_init("discover all services\n");
 
     rc = ble_gattc_disc_all_svcs_go(proc, 0);
@@ -1325,6 +1863,7 @@ static int
 ble_gattc_disc_svc_uuid_go(struct ble_gattc_proc *proc, int cb_on_err)
 {
     struct ble_att_find_type_value_req req;
+    uint8_t val[16];
     int rc;
 
     ble_gattc_dbg_assert_proc_not_inserted(proc);
@@ -1333,8 +1872,16 @@ ble_gattc_disc_svc_uuid_go(struct ble_gattc_proc *proc, int cb_on_err)
     req.bavq_end_handle = 0xffff;
     req.bavq_attr_type = BLE_ATT_UUID_PRIMARY_SERVICE;
 
-    rc = ble_att_clt_tx_find_type_value(proc->conn_handle, &req,
-                                        proc->disc_svc_uuid.service_uuid, 16);
+    /* The value of a service declaration is the UUID in its 16-bit form,
+     * if it has one.
+     */
+    if (proc->disc_svc_uuid.service_uuid.type == BLE_UUID_TYPE_16) {
+        htole16(val, proc->disc_svc_uuid.service_uuid.u32);
+        rc = ble_att_clt_tx_find_type_value(proc->conn_handle, &req, val, 2);
+    } else {
+        ble_uuid_any_to_128(&proc->disc_svc_uuid.service_uuid, val);
+        rc = ble_att_clt_tx_find_type_value(proc->conn_handle, &req, val, 16);
+    }
     if (rc != 0) {
         if (cb_on_err) {
             ble_gattc_disc_svc_uuid_cb(proc, rc, 0, NULL);
@@ -1387,7 +1934,7 @@ ble_gattc_disc_svc_uuid_rx_hinfo(struct ble_gattc_proc *proc,
 
     service.start_handle = hinfo->attr_handle;
     service.end_handle = hinfo->group_end_handle;
-    memcpy(service.uuid128, proc->disc_svc_uuid.service_uuid, 16);
+    ble_uuid_any_to_128(&proc->disc_svc_uuid.service_uuid, service.uuid128);
 
     rc = 0;
 
@@ -1465,7 +2012,7 @@ ble_gattc_disc_svc_by_uuid(uint16_t conn_handle, const void *svc_uuid128,
 
     proc->op = BLE_GATT_OP_DISC_SVC_UUID;
     proc->conn_handle = conn_handle;
-    memcpy(proc->disc_svc_uuid.service_uuid, svc_uuid128, 16);
+    ble_uuid_any_from_128(&proc->disc_svc_uuid.service_uuid, svc_uuid128);
     proc->disc_svc_uuid.prev_handle = 0x0000;
     proc->disc_svc_uuid.cb = cb;
     proc->disc_svc_uuid.cb_arg = cb_arg;
@@ -1832,6 +2379,8 @@ ble_gattc_disc_all_chrs_cb(struct ble_gattc_proc *proc, int status,
         STATS_INC(ble_gattc_stats, disc_all_chrs_fail);
     }
 
+    ble_gattc_cache_record(proc, status, chr);
+
     if (proc->disc_all_chrs.cb == NULL) {
         rc = 0;
     } else {
@@ -2018,11 +2567,16 @@ ble_gattc_disc_all_chrs(uint16_t conn_handle, uint16_t start_handle,
 
     proc->op = BLE_GATT_OP_DISC_ALL_CHRS;
     proc->conn_handle = conn_handle;
+    proc->disc_all_chrs.start_handle = start_handle;
     proc->disc_all_chrs.prev_handle = start_handle - 1;
     proc->disc_all_chrs.end_handle = end_handle;
     proc->disc_all_chrs.cb = cb;
     proc->disc_all_chrs.cb_arg = cb_arg;
 
+    if (ble_gattc_cache_hit(proc)) {
+        return 0;
+    }
+
     ble_gattc_log_disc_all_chrs(proc);
 
     rc = ble_gattc_disc_all_chrs_go(proc, 0);
@@ -2132,6 +2686,7 @@ static int
 ble_gattc_disc_chr_uuid_rx_adata(struct ble_gattc_proc *proc,
                                  struct ble_att_read_type_adata *adata)
 {
+    struct ble_uuid_any uuid;
     struct ble_gatt_chr chr;
     uint16_t uuid16;
     int cbrc;
@@ -2145,15 +2700,15 @@ ble_gattc_disc_chr_uuid_rx_adata(struct ble_gattc_proc *proc,
     switch (adata->value_len) {
     case BLE_GATT_CHR_DECL_SZ_16:
         uuid16 = le16toh(adata->value + 3);
-        rc = ble_uuid_16_to_128(uuid16, chr.uuid128);
-        if (rc != 0) {
+        if (uuid16 == 0) {
             rc = BLE_HS_EBADDATA;
             goto done;
         }
+        ble_uuid_any_from_16(&uuid, uuid16);
         break;
 
     case BLE_GATT_CHR_DECL_SZ_128:
-        memcpy(chr.uuid128, adata->value + 3, 16);
+        ble_uuid_any_from_128(&uuid, adata->value + 3);
         break;
 
     default:
@@ -2178,8 +2733,9 @@ done:
     if (rc != 0) {
         /* Failure. */
         cbrc = ble_gattc_disc_chr_uuid_cb(proc, rc, 0, NULL);
-    } else if (memcmp(chr.uuid128, proc->disc_chr_uuid.chr_uuid, 16) == 0) {
+    } else if (ble_uuid_any_cmp(&uuid, &proc->disc_chr_uuid.chr_uuid) == 0) {
         /* Requested characteristic discovered. */
+        ble_uuid_any_to_128(&uuid, chr.uuid128);
         cbrc = ble_gattc_disc_chr_uuid_cb(proc, 0, 0, &chr);
     } else {
         /* Uninteresting characteristic; ignore. */
@@ -2263,7 +2819,7 @@ ble_gattc_disc_chrs_by_uuid(uint16_t conn_handle, uint16_t start_handle,
 
     proc->op = BLE_GATT_OP_DISC_CHR_UUID;
     proc->conn_handle = conn_handle;
-    memcpy(proc->disc_chr_uuid.chr_uuid, uuid128, 16);
+    ble_uuid_any_from_128(&proc->disc_chr_uuid.chr_uuid, uuid128);
     proc->disc_chr_uuid.prev_handle = start_handle - 1;
     proc->disc_chr_uuid.end_handle = end_handle;
     proc->disc_chr_uuid.cb = cb;
@@ -2310,6 +2866,8 @@ ble_gattc_disc_all_dscs_cb(struct ble_gattc_proc *proc, int status,
         STATS_INC(ble_gattc_stats, disc_all_dscs_fail);
     }
 
+    ble_gattc_cache_record(proc, status, dsc);
+
     if (proc->disc_all_dscs.cb == NULL) {
         rc = 0;
     } else {
@@ -2475,6 +3033,10 @@ ble_gattc_disc_all_dscs(uint16_t conn_handle, uint16_t chr_val_handle,
     proc->disc_all_dscs.cb = cb;
     proc->disc_all_dscs.cb_arg = cb_arg;
 
+    if (ble_gattc_cache_hit(proc)) {
+        return 0;
+    }
+
     ble_gattc_log_disc_all_dscs(proc);
 
     rc = ble_gattc_disc_all_dscs_go(proc, 0);
@@ -4003,6 +4565,157 @@ ble_gattc_notify(uint16_t conn_handle, uint16_t chr_val_handle)
     return rc;
 }
 
+static void
+ble_gattc_notify_multi_free(struct os_mbuf_ext *ext)
+{
+    os_mbuf_free_chain(ext->ome_arg);
+}
+
+/**
+ * Sends a characteristic notification over several connections.  The content
+ * of the message is read from the specified characteristic once.  When it
+ * fits in a single msys buffer, the value is shared by reference among all
+ * the outgoing packets rather than copied for each connection.  The packets
+ * are queued in batches of BLE_GATTC_NOTIFY_MULTI_BATCH, with a single
+ * acquisition of the host lock per batch.
+ *
+ * The application is informed of each transmission attempt via a
+ * BLE_GAP_EVENT_NOTIFY_TX event, as with ble_gattc_notify().
+ *
+ * @param conn_handles          The connections over which to execute the
+ *                                  procedure.
+ * @param num_conns             The number of entries in conn_handles.
+ * @param chr_val_handle        The value attribute handle of the
+ *                                  characteristic to include in the outgoing
+ *                                  notification.
+ *
+ * @return                      0 if every notification was queued; the
+ *                                  last error code otherwise.
+ */
+int
+ble_gattc_notify_multi(const uint16_t *conn_handles, int num_conns,
+                       uint16_t chr_val_handle)
+{
+#if !NIMBLE_OPT(GATT_NOTIFY)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    struct os_mbuf *txoms[BLE_GATTC_NOTIFY_MULTI_BATCH];
+    int rcs[BLE_GATTC_NOTIFY_MULTI_BATCH];
+    struct ble_att_notify_req req;
+    struct os_mbuf_ext *ext;
+    struct os_mbuf *holder;
+    struct os_mbuf *valom;
+    struct os_mbuf *ref;
+    struct os_mbuf *om;
+    uint16_t len;
+    int batch;
+    int rc;
+    int i;
+    int j;
+
+    ble_gattc_log_notify(chr_val_handle);
+
+    ext = NULL;
+    ref = NULL;
+
+    valom = ble_hs_mbuf_att_pkt();
+    if (valom == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto err;
+    }
+    rc = ble_att_svr_read_handle(BLE_HS_CONN_HANDLE_NONE,
+                                 chr_val_handle, 0, valom, NULL);
+    if (rc != 0) {
+        /* Fatal error; application disallowed attribute read. */
+        rc = BLE_HS_EAPP;
+        goto err;
+    }
+    len = OS_MBUF_PKTLEN(valom);
+
+    /* Flatten the value into a buffer that all the packets can refer to.  The
+     * buffer starts with its own descriptor.  If this is not possible, each
+     * packet gets a copy of the value instead.
+     */
+    holder = os_msys_get(sizeof *ext + len, 0);
+    if (holder != NULL) {
+        if (OS_MBUF_TRAILINGSPACE(holder) < sizeof *ext + len) {
+            os_mbuf_free_chain(holder);
+        } else {
+            ext = (struct os_mbuf_ext *)holder->om_data;
+            os_mbuf_copydata(valom, 0, len, ext + 1);
+            os_mbuf_ext_init(ext, ext + 1, len, ble_gattc_notify_multi_free,
+                             holder);
+
+            /* Hold a reference until all packets have been built. */
+            ref = os_mbuf_get_ext(valom->om_omp, ext, 0, len);
+            if (ref == NULL) {
+                os_mbuf_free_chain(holder);
+                ext = NULL;
+            }
+        }
+    }
+
+    req.banq_handle = chr_val_handle;
+
+    rc = 0;
+    for (i = 0; i < num_conns; i += batch) {
+        batch = min(num_conns - i, BLE_GATTC_NOTIFY_MULTI_BATCH);
+
+        for (j = 0; j < batch; j++) {
+            STATS_INC(ble_gattc_stats, notify);
+
+            txoms[j] = ble_hs_mbuf_att_pkt();
+            if (txoms[j] == NULL) {
+                continue;
+            }
+
+            if (ext != NULL) {
+                om = os_mbuf_get_ext(txoms[j]->om_omp, ext, 0, len);
+                if (om != NULL) {
+                    os_mbuf_concat(txoms[j], om);
+                }
+            } else {
+                om = txoms[j];
+                if (os_mbuf_appendfrom(txoms[j], valom, 0, len) != 0) {
+                    om = NULL;
+                }
+            }
+            if (om == NULL) {
+                os_mbuf_free_chain(txoms[j]);
+                txoms[j] = NULL;
+            }
+        }
+
+        ble_att_clt_tx_notify_multi(conn_handles + i, batch, &req, txoms, rcs);
+
+        for (j = 0; j < batch; j++) {
+            if (rcs[j] != 0) {
+                STATS_INC(ble_gattc_stats, notify_fail);
+                rc = rcs[j];
+            }
+            ble_gap_notify_tx_event(rcs[j], conn_handles[i + j],
+                                    chr_val_handle, 0);
+        }
+    }
+
+    os_mbuf_free_chain(ref);
+    os_mbuf_free_chain(valom);
+
+    return rc;
+
+err:
+    for (i = 0; i < num_conns; i++) {
+        STATS_INC(ble_gattc_stats, notify);
+        STATS_INC(ble_gattc_stats, notify_fail);
+        ble_gap_notify_tx_event(rc, conn_handles[i], chr_val_handle, 0);
+    }
+
+    os_mbuf_free_chain(valom);
+
+    return rc;
+}
+
 /*****************************************************************************
  * $indicate                                                                 *
  *****************************************************************************/
@@ -4556,17 +5269,46 @@ ble_gattc_connection_broken(uint16_t conn_handle)
 int
 ble_gattc_any_jobs(void)
 {
-    return !STAILQ_EMPTY(&ble_gattc_procs);
+    return !TAILQ_EMPTY(&ble_gattc_exp_procs);
+}
+
+int
+ble_gattc_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                   struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *live_pool;
+
+    if (idx != 0) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        live_pool = &ble_gattc_proc_pool;
+    } else {
+        live_pool = NULL;
+    }
+
+    ble_hs_mem_pool_fill(out_pool, "ble_gattc_proc_pool", cfg->max_gattc_procs,
+                         sizeof (struct ble_gattc_proc), live_pool);
+    return 0;
 }
 
 int
 ble_gattc_init(void)
 {
     int rc;
+    int i;
 
     free(ble_gattc_proc_mem);
 
-    STAILQ_INIT(&ble_gattc_procs);
+    for (i = 0; i < BLE_GATTC_PROC_BUCKETS; i++) {
+        STAILQ_INIT(&ble_gattc_procs[i]);
+    }
+    TAILQ_INIT(&ble_gattc_exp_procs);
+#if NIMBLE_OPT(GATT_CACHE)
+    STAILQ_INIT(&ble_gattc_cache_procs);
+#endif
 
     if (ble_hs_cfg.max_gattc_procs > 0) {
         ble_gattc_proc_mem = malloc(
@@ -27,6 +27,7 @@
 
 #define BLE_GATTS_INCLUDE_SZ    6
 #define BLE_GATTS_CHR_MAX_SZ    19
+#define BLE_GATTS_NOTIFY_BATCH  8
 
 static const struct ble_gatt_svc_def **ble_gatts_svc_defs;
 static int ble_gatts_num_svc_defs;
@@ -40,6 +41,10 @@ struct ble_gatts_svc_entry {
 static struct ble_gatts_svc_entry *ble_gatts_svc_entries;
 static uint16_t ble_gatts_num_svc_entries;
 
+/* Flash table set with ble_gatts_set_tbl(); handles 1 to ble_gatts_tbl_len. */
+static const struct ble_att_svr_entry *ble_gatts_tbl;
+static uint16_t ble_gatts_tbl_len;
+
 static os_membuf_t *ble_gatts_clt_cfg_mem;
 static struct os_mempool ble_gatts_clt_cfg_pool;
 
@@ -67,7 +72,7 @@ STATS_NAME_START(ble_gatts_stats)
     STATS_NAME(ble_gatts_stats, dsc_writes)
 STATS_NAME_END(ble_gatts_stats)
 
-static int
+int
 ble_gatts_svc_access(uint16_t conn_handle, uint16_t attr_handle,
                      uint8_t op, uint16_t offset, struct os_mbuf **om,
                      void *arg)
@@ -222,7 +227,7 @@ ble_gatts_chr_properties(const struct ble_gatt_chr_def *chr)
     return properties;
 }
 
-static int
+int
 ble_gatts_chr_def_access(uint16_t conn_handle, uint16_t attr_handle,
                          uint8_t op, uint16_t offset, struct os_mbuf **om,
                          void *arg)
@@ -272,7 +277,17 @@ ble_gatts_chr_is_sane(const struct ble_gatt_chr_def *chr)
         return 0;
     }
 
-    if (chr->access_cb == NULL) {
+    /* A characteristic with a static value only needs a callback if it can
+     * be written.
+     */
+    if (chr->access_cb == NULL &&
+        (chr->static_val == NULL ||
+         chr->flags & (BLE_GATT_CHR_F_WRITE_NO_RSP |
+                       BLE_GATT_CHR_F_WRITE |
+                       BLE_GATT_CHR_F_AUTH_SIGN_WRITE |
+                       BLE_GATT_CHR_F_RELIABLE_WRITE |
+                       BLE_GATT_CHR_F_AUX_WRITE))) {
+
         return 0;
     }
 
@@ -355,7 +370,29 @@ ble_gatts_val_access(uint16_t conn_handle, uint16_t attr_handle,
     }
 }
 
+/**
+ * Serves a read of a value registered with a static buffer.  The value is
+ * appended to the response directly; no application callback is involved.
+ */
 static int
+ble_gatts_static_val_read(const void *val, uint16_t val_len,
+                          uint16_t offset, struct os_mbuf *om)
+{
+    int rc;
+
+    if (offset >= val_len) {
+        return 0;
+    }
+
+    rc = os_mbuf_append(om, (const uint8_t *)val + offset, val_len - offset);
+    if (rc != 0) {
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+
+    return 0;
+}
+
+int
 ble_gatts_chr_val_access(uint16_t conn_handle, uint16_t attr_handle,
                          uint8_t att_op, uint16_t offset,
                          struct os_mbuf **om, void *arg)
@@ -365,12 +402,22 @@ ble_gatts_chr_val_access(uint16_t conn_handle, uint16_t attr_handle,
     int rc;
 
     chr_def = arg;
-    BLE_HS_DBG_ASSERT(chr_def != NULL && chr_def->access_cb != NULL);
+    BLE_HS_DBG_ASSERT(chr_def != NULL);
 
     gatt_ctxt.op = ble_gatts_chr_op(att_op);
     gatt_ctxt.chr = chr_def;
 
     ble_gatts_chr_inc_val_stat(gatt_ctxt.op);
+
+    if (gatt_ctxt.op == BLE_GATT_ACCESS_OP_READ_CHR &&
+        chr_def->static_val != NULL) {
+
+        return ble_gatts_static_val_read(chr_def->static_val,
+                                         chr_def->static_val_len,
+                                         offset, *om);
+    }
+
+    BLE_HS_DBG_ASSERT(chr_def->access_cb != NULL);
     rc = ble_gatts_val_access(conn_handle, attr_handle, offset, &gatt_ctxt, om,
                               chr_def->access_cb, chr_def->arg);
 
@@ -463,7 +510,7 @@ ble_gatts_dsc_inc_stat(uint8_t gatt_op)
     }
 }
 
-static int
+int
 ble_gatts_dsc_access(uint16_t conn_handle, uint16_t attr_handle,
                      uint8_t att_op, uint16_t offset, struct os_mbuf **om,
                      void *arg)
@@ -473,12 +520,22 @@ ble_gatts_dsc_access(uint16_t conn_handle, uint16_t attr_handle,
     int rc;
 
     dsc_def = arg;
-    BLE_HS_DBG_ASSERT(dsc_def != NULL && dsc_def->access_cb != NULL);
+    BLE_HS_DBG_ASSERT(dsc_def != NULL);
 
     gatt_ctxt.op = ble_gatts_dsc_op(att_op);
     gatt_ctxt.dsc = dsc_def;
 
     ble_gatts_dsc_inc_stat(gatt_ctxt.op);
+
+    if (gatt_ctxt.op == BLE_GATT_ACCESS_OP_READ_DSC &&
+        dsc_def->static_val != NULL) {
+
+        return ble_gatts_static_val_read(dsc_def->static_val,
+                                         dsc_def->static_val_len,
+                                         offset, *om);
+    }
+
+    BLE_HS_DBG_ASSERT(dsc_def->access_cb != NULL);
     rc = ble_gatts_val_access(conn_handle, attr_handle, offset, &gatt_ctxt, om,
                               dsc_def->access_cb, dsc_def->arg);
 
@@ -492,7 +549,9 @@ ble_gatts_dsc_is_sane(const struct ble_gatt_dsc_def *dsc)
         return 0;
     }
 
-    if (dsc->access_cb == NULL) {
+    if (dsc->access_cb == NULL &&
+        (dsc->static_val == NULL || dsc->att_flags & BLE_ATT_F_WRITE)) {
+
         return 0;
     }
 
@@ -688,7 +747,7 @@ ble_gatts_clt_cfg_access_locked(struct ble_hs_conn *conn, uint16_t attr_handle,
     return 0;
 }
 
-static int
+int
 ble_gatts_clt_cfg_access(uint16_t conn_handle, uint16_t attr_handle,
                          uint8_t op, uint16_t offset, struct os_mbuf **om,
                          void *arg)
@@ -742,16 +801,12 @@ ble_gatts_clt_cfg_access(uint16_t conn_handle, uint16_t attr_handle,
 static int
 ble_gatts_register_clt_cfg_dsc(uint16_t *att_handle)
 {
-    uint8_t uuid128[16];
     int rc;
 
-    rc = ble_uuid_16_to_128(BLE_GATT_DSC_CLT_CFG_UUID16, uuid128);
-    if (rc != 0) {
-        return rc;
-    }
-
-    rc = ble_att_svr_register(uuid128, BLE_ATT_F_READ | BLE_ATT_F_WRITE,
-                              att_handle, ble_gatts_clt_cfg_access, NULL);
+    rc = ble_att_svr_register_uuid16(BLE_GATT_DSC_CLT_CFG_UUID16,
+                                     BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+                                     att_handle, ble_gatts_clt_cfg_access,
+                                     NULL);
     if (rc != 0) {
         return rc;
     }
@@ -1043,6 +1098,156 @@ ble_gatts_register_svcs(const struct ble_gatt_svc_def *svcs,
     return 0;
 }
 
+static int
+ble_gatts_tbl_uuid_is(const struct ble_att_svr_entry *attr,
+                      const uint8_t *uuid128)
+{
+    struct ble_uuid_any attr_uuid;
+    struct ble_uuid_any uuid;
+
+    ble_att_svr_entry_uuid(attr, &attr_uuid);
+    ble_uuid_any_from_128(&uuid, uuid128);
+
+    return ble_uuid_any_cmp(&attr_uuid, &uuid) == 0;
+}
+
+/**
+ * Checks that the attributes of the flash table are laid out the way
+ * registration would have laid out the definitions they refer to, fills in
+ * the characteristic value handles and reports the table to the register
+ * callback.
+ */
+static int
+ble_gatts_tbl_start(ble_gatt_register_fn *register_cb, void *cb_arg)
+{
+    struct ble_gatt_register_ctxt register_ctxt;
+    const struct ble_att_svr_entry *attr;
+    const struct ble_gatt_svc_def *svc;
+    const struct ble_gatt_chr_def *chr;
+    const struct ble_gatt_dsc_def *dsc;
+    uint16_t uuid16;
+    uint16_t handle;
+    int rc;
+    int i;
+
+    rc = ble_att_svr_set_tbl(ble_gatts_tbl, ble_gatts_tbl_len);
+    if (rc != 0) {
+        return rc;
+    }
+
+    svc = NULL;
+    chr = NULL;
+    for (i = 0; i < ble_gatts_tbl_len; i++) {
+        attr = ble_gatts_tbl + i;
+        handle = i + 1;
+
+        if (attr->ha_handle_id != 0) {
+            goto err;
+        }
+
+        if (attr->ha_cb == ble_gatts_svc_access) {
+            svc = attr->ha_cb_arg;
+            chr = NULL;
+            if (!ble_gatts_svc_is_sane(svc) ||
+                ble_gatts_svc_type_to_uuid(svc->type, &uuid16) != 0 ||
+                attr->ha_uuid_type != BLE_UUID_TYPE_16 ||
+                attr->ha_uuid != uuid16) {
+
+                goto err;
+            }
+
+            if (register_cb != NULL) {
+                register_ctxt.op = BLE_GATT_REGISTER_OP_SVC;
+                register_ctxt.svc.handle = handle;
+                register_ctxt.svc.svc_def = svc;
+                register_cb(&register_ctxt, cb_arg);
+            }
+            STATS_INC(ble_gatts_stats, svcs);
+        } else if (attr->ha_cb == ble_gatts_chr_def_access) {
+            /* The value attribute must immediately follow. */
+            chr = attr->ha_cb_arg;
+            if (svc == NULL || !ble_gatts_chr_is_sane(chr) ||
+                i + 1 >= ble_gatts_tbl_len ||
+                attr[1].ha_cb != ble_gatts_chr_val_access ||
+                attr[1].ha_cb_arg != chr) {
+
+                goto err;
+            }
+        } else if (attr->ha_cb == ble_gatts_chr_val_access) {
+            if (i == 0 || attr[-1].ha_cb != ble_gatts_chr_def_access ||
+                !ble_gatts_tbl_uuid_is(attr, chr->uuid128) ||
+                attr->ha_flags !=
+                    ble_gatts_att_flags_from_chr_flags(chr->flags)) {
+
+                goto err;
+            }
+
+            if (ble_gatts_chr_clt_cfg_allowed(chr) != 0) {
+                if (i + 1 >= ble_gatts_tbl_len ||
+                    attr[1].ha_cb != ble_gatts_clt_cfg_access) {
+
+                    goto err;
+                }
+                if (ble_gatts_num_cfgable_chrs >
+                    ble_hs_cfg.max_client_configs) {
+
+                    return BLE_HS_ENOMEM;
+                }
+                ble_gatts_num_cfgable_chrs++;
+            }
+
+            if (chr->val_handle != NULL) {
+                *chr->val_handle = handle;
+            }
+
+            if (register_cb != NULL) {
+                register_ctxt.op = BLE_GATT_REGISTER_OP_CHR;
+                register_ctxt.chr.def_handle = handle - 1;
+                register_ctxt.chr.val_handle = handle;
+                register_ctxt.chr.svc_def = svc;
+                register_ctxt.chr.chr_def = chr;
+                register_cb(&register_ctxt, cb_arg);
+            }
+            STATS_INC(ble_gatts_stats, chrs);
+        } else if (attr->ha_cb == ble_gatts_clt_cfg_access) {
+            if (i == 0 || attr[-1].ha_cb != ble_gatts_chr_val_access ||
+                ble_gatts_chr_clt_cfg_allowed(chr) == 0 ||
+                attr->ha_uuid_type != BLE_UUID_TYPE_16 ||
+                attr->ha_uuid != BLE_GATT_DSC_CLT_CFG_UUID16) {
+
+                goto err;
+            }
+            STATS_INC(ble_gatts_stats, dscs);
+        } else if (attr->ha_cb == ble_gatts_dsc_access) {
+            dsc = attr->ha_cb_arg;
+            if (chr == NULL || !ble_gatts_dsc_is_sane(dsc) ||
+                !ble_gatts_tbl_uuid_is(attr, dsc->uuid128) ||
+                attr->ha_flags != dsc->att_flags) {
+
+                goto err;
+            }
+
+            if (register_cb != NULL) {
+                register_ctxt.op = BLE_GATT_REGISTER_OP_DSC;
+                register_ctxt.dsc.handle = handle;
+                register_ctxt.dsc.svc_def = svc;
+                register_ctxt.dsc.chr_def = chr;
+                register_ctxt.dsc.dsc_def = dsc;
+                register_cb(&register_ctxt, cb_arg);
+            }
+            STATS_INC(ble_gatts_stats, dscs);
+        } else {
+            goto err;
+        }
+    }
+
+    return 0;
+
+err:
+    BLE_HS_DBG_ASSERT(0);
+    return BLE_HS_EINVAL;
+}
+
 static int
 ble_gatts_clt_cfg_size(void)
 {
@@ -1115,8 +1320,8 @@ ble_gatts_start(void)
 {
     struct ble_att_svr_entry *ha;
     struct ble_gatt_chr_def *chr;
+    struct ble_uuid_any uuid;
     uint16_t allowed_flags;
-    uint8_t uuid128[16];
     int num_elems;
     int idx;
     int rc;
@@ -1143,17 +1348,17 @@ ble_gatts_start(void)
     }
 
     /* Fill the cache. */
-    rc = ble_uuid_16_to_128(BLE_ATT_UUID_CHARACTERISTIC, uuid128);
-    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+    ble_uuid_any_from_16(&uuid, BLE_ATT_UUID_CHARACTERISTIC);
     idx = 0;
     ha = NULL;
-    while ((ha = ble_att_svr_find_by_uuid(ha, uuid128, 0xffff)) != NULL) {
+    while ((ha = ble_att_svr_find_by_uuid(ha, &uuid, 0xffff)) != NULL) {
         chr = ha->ha_cb_arg;
         allowed_flags = ble_gatts_chr_clt_cfg_allowed(chr);
         if (allowed_flags != 0) {
             BLE_HS_DBG_ASSERT_EVAL(idx < ble_gatts_num_cfgable_chrs);
 
-            ble_gatts_clt_cfgs[idx].chr_val_handle = ha->ha_handle_id + 1;
+            ble_gatts_clt_cfgs[idx].chr_val_handle =
+                ble_att_svr_entry_handle(ha) + 1;
             ble_gatts_clt_cfgs[idx].allowed = allowed_flags;
             ble_gatts_clt_cfgs[idx].flags = 0;
             idx++;
@@ -1476,10 +1681,12 @@ ble_gatts_chr_updated(uint16_t chr_val_handle)
 static void
 ble_gatts_tx_notifications_one_chr(uint16_t chr_val_handle)
 {
+    uint16_t notify_handles[BLE_GATTS_NOTIFY_BATCH];
     struct ble_gatts_clt_cfg *clt_cfg;
     struct ble_hs_conn *conn;
     uint16_t conn_handle;
     uint8_t att_op;
+    int num_notify;
     int clt_cfg_idx;
     int i;
 
@@ -1492,6 +1699,7 @@ ble_gatts_tx_notifications_one_chr(uint16_t chr_val_handle)
         return;
     }
 
+    num_notify = 0;
     for (i = 0; ; i++) {
         ble_hs_lock();
 
@@ -1522,7 +1730,15 @@ ble_gatts_tx_notifications_one_chr(uint16_t chr_val_handle)
             break;
 
         case BLE_ATT_OP_NOTIFY_REQ:
-            ble_gattc_notify(conn_handle, chr_val_handle);
+            /* Notifications are sent in batches so that the attribute value
+             * only gets read once per batch.
+             */
+            notify_handles[num_notify++] = conn_handle;
+            if (num_notify == BLE_GATTS_NOTIFY_BATCH) {
+                ble_gattc_notify_multi(notify_handles, num_notify,
+                                       chr_val_handle);
+                num_notify = 0;
+            }
             break;
 
         case BLE_ATT_OP_INDICATE_REQ:
@@ -1534,6 +1750,10 @@ ble_gatts_tx_notifications_one_chr(uint16_t chr_val_handle)
             break;
         }
     }
+
+    if (num_notify > 0) {
+        ble_gattc_notify_multi(notify_handles, num_notify, chr_val_handle);
+    }
 }
 
 /**
@@ -1647,68 +1867,106 @@ ble_gatts_bonding_restored(uint16_t conn_handle)
     }
 }
 
-static struct ble_gatts_svc_entry *
-ble_gatts_find_svc_entry(const void *uuid128)
+/**
+ * Looks up a service, in the flash table or among the registered ones, and
+ * retrieves its handle and end group handle.
+ */
+static int
+ble_gatts_find_svc_entry(const void *uuid128, uint16_t *out_handle,
+                         uint16_t *out_end_group_handle)
 {
+    const struct ble_gatt_svc_def *svc;
     struct ble_gatts_svc_entry *entry;
+    int found;
     int i;
 
+    found = 0;
+    for (i = 0; i < ble_gatts_tbl_len; i++) {
+        if (ble_gatts_tbl[i].ha_cb != ble_gatts_svc_access) {
+            continue;
+        }
+        if (found) {
+            *out_end_group_handle = i;
+            return 0;
+        }
+
+        svc = ble_gatts_tbl[i].ha_cb_arg;
+        if (memcmp(uuid128, svc->uuid128, 16) == 0) {
+            *out_handle = i + 1;
+            found = 1;
+        }
+    }
+    if (found) {
+        *out_end_group_handle = ble_gatts_tbl_len;
+        return 0;
+    }
+
     for (i = 0; i < ble_gatts_num_svc_entries; i++) {
         entry = ble_gatts_svc_entries + i;
         if (memcmp(uuid128, entry->svc->uuid128, 16) == 0) {
-            return entry;
+            *out_handle = entry->handle;
+            *out_end_group_handle = entry->end_group_handle;
+            return 0;
         }
     }
 
-    return NULL;
+    return BLE_HS_ENOENT;
 }
 
 static int
 ble_gatts_find_svc_chr_attr(const void *svc_uuid128, const void *chr_uuid128,
-                            struct ble_gatts_svc_entry **out_svc_entry,
+                            uint16_t *out_end_group_handle,
                             struct ble_att_svr_entry **out_att_chr)
 {
-    struct ble_gatts_svc_entry *svc_entry;
     struct ble_att_svr_entry *att_svc;
     struct ble_att_svr_entry *next;
     struct ble_att_svr_entry *cur;
-    uint16_t uuid16;
+    struct ble_uuid_any chr_uuid;
+    struct ble_uuid_any uuid;
+    uint16_t end_group_handle;
+    uint16_t svc_handle;
+    int rc;
 
-    svc_entry = ble_gatts_find_svc_entry(svc_uuid128);
-    if (svc_entry == NULL) {
-        return BLE_HS_ENOENT;
+    rc = ble_gatts_find_svc_entry(svc_uuid128, &svc_handle,
+                                  &end_group_handle);
+    if (rc != 0) {
+        return rc;
     }
 
-    att_svc = ble_att_svr_find_by_handle(svc_entry->handle);
+    ble_uuid_any_from_128(&chr_uuid, chr_uuid128);
+
+    att_svc = ble_att_svr_find_by_handle(svc_handle);
     if (att_svc == NULL) {
         return BLE_HS_EUNKNOWN;
     }
 
-    cur = STAILQ_NEXT(att_svc, ha_next);
+    cur = ble_att_svr_entry_next(att_svc);
     while (1) {
         if (cur == NULL) {
             /* Reached end of attribute list without a match. */
             return BLE_HS_ENOENT;
         }
-        next = STAILQ_NEXT(cur, ha_next);
+        next = ble_att_svr_entry_next(cur);
 
-        if (cur->ha_handle_id == svc_entry->end_group_handle) {
+        if (ble_att_svr_entry_handle(cur) == end_group_handle) {
             /* Reached end of service without a match. */
             return BLE_HS_ENOENT;
         }
 
-        uuid16 = ble_uuid_128_to_16(cur->ha_uuid);
-        if (uuid16 == BLE_ATT_UUID_CHARACTERISTIC &&
-            next != NULL &&
-            memcmp(next->ha_uuid, chr_uuid128, 16) == 0) {
+        if (cur->ha_uuid_type == BLE_UUID_TYPE_16 &&
+            cur->ha_uuid == BLE_ATT_UUID_CHARACTERISTIC &&
+            next != NULL) {
 
-            if (out_svc_entry != NULL) {
-                *out_svc_entry = svc_entry;
-            }
-            if (out_att_chr != NULL) {
-                *out_att_chr = next;
+            ble_att_svr_entry_uuid(next, &uuid);
+            if (ble_uuid_any_cmp(&uuid, &chr_uuid) == 0) {
+                if (out_end_group_handle != NULL) {
+                    *out_end_group_handle = end_group_handle;
+                }
+                if (out_att_chr != NULL) {
+                    *out_att_chr = next;
+                }
+                return 0;
             }
-            return 0;
         }
 
         cur = next;
@@ -1730,15 +1988,17 @@ ble_gatts_find_svc_chr_attr(const void *svc_uuid128, const void *chr_uuid128,
 int
 ble_gatts_find_svc(const void *uuid128, uint16_t *out_handle)
 {
-    struct ble_gatts_svc_entry *entry;
+    uint16_t end_group_handle;
+    uint16_t handle;
+    int rc;
 
-    entry = ble_gatts_find_svc_entry(uuid128);
-    if (entry == NULL) {
-        return BLE_HS_ENOENT;
+    rc = ble_gatts_find_svc_entry(uuid128, &handle, &end_group_handle);
+    if (rc != 0) {
+        return rc;
     }
 
     if (out_handle != NULL) {
-        *out_handle = entry->handle;
+        *out_handle = handle;
     }
     return 0;
 }
@@ -1773,10 +2033,10 @@ ble_gatts_find_chr(const void *svc_uuid128, const void *chr_uuid128,
     }
 
     if (out_def_handle) {
-        *out_def_handle = att_chr->ha_handle_id - 1;
+        *out_def_handle = ble_att_svr_entry_handle(att_chr) - 1;
     }
     if (out_val_handle) {
-        *out_val_handle = att_chr->ha_handle_id;
+        *out_val_handle = ble_att_svr_entry_handle(att_chr);
     }
     return 0;
 }
@@ -1800,43 +2060,47 @@ int
 ble_gatts_find_dsc(const void *svc_uuid128, const void *chr_uuid128,
                    const void *dsc_uuid128, uint16_t *out_handle)
 {
-    struct ble_gatts_svc_entry *svc_entry;
     struct ble_att_svr_entry *att_chr;
     struct ble_att_svr_entry *cur;
-    uint16_t uuid16;
+    struct ble_uuid_any dsc_uuid;
+    struct ble_uuid_any uuid;
+    uint16_t end_group_handle;
     int rc;
 
-    rc = ble_gatts_find_svc_chr_attr(svc_uuid128, chr_uuid128, &svc_entry,
-                                     &att_chr);
+    rc = ble_gatts_find_svc_chr_attr(svc_uuid128, chr_uuid128,
+                                     &end_group_handle, &att_chr);
     if (rc != 0) {
         return rc;
     }
 
-    cur = STAILQ_NEXT(att_chr, ha_next);
+    ble_uuid_any_from_128(&dsc_uuid, dsc_uuid128);
+
+    cur = ble_att_svr_entry_next(att_chr);
     while (1) {
         if (cur == NULL) {
             /* Reached end of attribute list without a match. */
             return BLE_HS_ENOENT;
         }
 
-        if (cur->ha_handle_id == svc_entry->end_group_handle) {
+        if (ble_att_svr_entry_handle(cur) > end_group_handle) {
             /* Reached end of service without a match. */
             return BLE_HS_ENOENT;
         }
 
-        uuid16 = ble_uuid_128_to_16(cur->ha_uuid);
-        if (uuid16 == BLE_ATT_UUID_CHARACTERISTIC) {
+        if (cur->ha_uuid_type == BLE_UUID_TYPE_16 &&
+            cur->ha_uuid == BLE_ATT_UUID_CHARACTERISTIC) {
             /* Reached end of characteristic without a match. */
             return BLE_HS_ENOENT;
         }
 
-        if (memcmp(cur->ha_uuid, dsc_uuid128, 16) == 0) {
+        ble_att_svr_entry_uuid(cur, &uuid);
+        if (ble_uuid_any_cmp(&uuid, &dsc_uuid) == 0) {
             if (out_handle != NULL) {
-                *out_handle = cur->ha_handle_id;
+                *out_handle = ble_att_svr_entry_handle(cur);
                 return 0;
             }
         }
-        cur = STAILQ_NEXT(cur, ha_next);
+        cur = ble_att_svr_entry_next(cur);
     }
 }
 
@@ -1870,6 +2134,33 @@ ble_gatts_add_svcs(const struct ble_gatt_svc_def *svcs)
     return 0;
 }
 
+/**
+ * Sets a const attribute table, laid out with the BLE_GATTS_TBL_[...]
+ * macros, to be served when ble_hs_init() is called.  The table occupies
+ * handles 1 to num_attrs; services queued with ble_gatts_add_svcs() are
+ * registered after it.  Table attributes do not count towards the
+ * max_attrs or max_services settings.
+ *
+ * @param attrs                 The attribute table; must remain valid for as
+ *                                  long as the host runs.
+ * @param num_attrs             The number of attributes in the table.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if num_attrs is out of range.
+ */
+int
+ble_gatts_set_tbl(const struct ble_att_svr_entry *attrs, int num_attrs)
+{
+    if (num_attrs < 0 || num_attrs >= UINT16_MAX) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_gatts_tbl = num_attrs > 0 ? attrs : NULL;
+    ble_gatts_tbl_len = num_attrs;
+
+    return 0;
+}
+
 /**
  * Accumulates counts of each resource type required by the specified service
  * definition array.  This function is generally used to calculate some host
@@ -2035,6 +2326,47 @@ ble_gatts_free_mem(void)
     ble_gatts_svc_entries = NULL;
 }
 
+int
+ble_gatts_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                   struct ble_hs_mem_pool *out_pool)
+{
+    int live;
+
+    live = cfg == NULL;
+    if (live) {
+        cfg = &ble_hs_cfg;
+    }
+
+    switch (idx) {
+    case 0:
+        ble_hs_mem_pool_fill(out_pool, "ble_gatts_clt_cfg_pool",
+                             cfg->max_client_configs,
+                             sizeof (struct ble_gatts_clt_cfg), NULL);
+
+        /* Each pool block holds the configs of every subscribable
+         * characteristic for one connection.
+         */
+        if (live && ble_gatts_num_cfgable_chrs > 0 &&
+            ble_gatts_clt_cfg_pool.mp_num_blocks > 0) {
+
+            out_pool->max_used = ble_gatts_num_cfgable_chrs *
+                                 (ble_gatts_clt_cfg_pool.mp_num_blocks -
+                                  ble_gatts_clt_cfg_pool.mp_min_free);
+            out_pool->num_fail = ble_gatts_clt_cfg_pool.mp_num_fail;
+        }
+        return 0;
+
+    case 1:
+        ble_hs_mem_pool_fill(out_pool, "ble_gatts_svc_entries",
+                             cfg->max_services,
+                             sizeof *ble_gatts_svc_entries, NULL);
+        return 0;
+
+    default:
+        return BLE_HS_ENOENT;
+    }
+}
+
 int
 ble_gatts_init(void)
 {
@@ -2065,6 +2397,15 @@ ble_gatts_init(void)
     }
 
     ble_gatts_num_svc_entries = 0;
+
+    if (ble_gatts_tbl != NULL) {
+        rc = ble_gatts_tbl_start(ble_hs_cfg.gatts_register_cb,
+                                 ble_hs_cfg.gatts_register_arg);
+        if (rc != 0) {
+            goto err;
+        }
+    }
+
     for (i = 0; i < ble_gatts_num_svc_defs; i++) {
         rc = ble_gatts_register_svcs(ble_gatts_svc_defs[i],
                                      ble_hs_cfg.gatts_register_cb,
@@ -52,13 +52,6 @@ static struct os_event ble_hs_event_reset = {
 uint8_t ble_hs_sync_state;
 static int ble_hs_reset_reason;
 
-#if MYNEWT_SELFTEST
-/** Use a higher frequency timer to allow tests to run faster. */
-#define BLE_HS_HEARTBEAT_OS_TICKS       (OS_TICKS_PER_SEC / 10)
-#else
-#define BLE_HS_HEARTBEAT_OS_TICKS       OS_TICKS_PER_SEC
-#endif
-
 #define BLE_HS_SYNC_RETRY_RATE          (OS_TICKS_PER_SEC / 10)    
 
 /**
@@ -68,7 +61,12 @@ static int ble_hs_reset_reason;
 static struct os_callout_func ble_hs_heartbeat_timer;
 static struct os_callout_func ble_hs_event_co;
 
-/* Queue for host-specific OS events. */
+/**
+ * Queues for host-specific OS events.  HCI events and other control events go
+ * on the control queue; ACL data, timers, and notification transmission go on
+ * the data queue.  The control queue is always serviced first.
+ */
+static struct os_eventq ble_hs_ctrl_evq;
 static struct os_eventq ble_hs_evq;
 
 /* Task structures for the host's parent task. */
@@ -95,6 +93,9 @@ STATS_NAME_START(ble_hs_stats)
     STATS_NAME(ble_hs_stats, hci_timeout)
     STATS_NAME(ble_hs_stats, reset)
     STATS_NAME(ble_hs_stats, sync)
+    STATS_NAME(ble_hs_stats, acl_tx_fail)
+    STATS_NAME(ble_hs_stats, conn_tx_quota)
+    STATS_NAME(ble_hs_stats, conn_rx_quota)
 STATS_NAME_END(ble_hs_stats)
 
 int
@@ -166,14 +167,39 @@ ble_hs_process_tx_data_queue(void)
     }
 }
 
-void
-ble_hs_process_rx_data_queue(void)
+/**
+ * Processes up to the specified number of incoming ACL data packets.
+ *
+ * @param max_pkts              The maximum number of packets to process; 0
+ *                                  for no limit.
+ *
+ * @return                      1 if packets remain in the receive queue;
+ *                              0 if the queue was drained.
+ */
+static int
+ble_hs_process_rx_data_batch(int max_pkts)
 {
     struct os_mbuf *om;
+    int num_pkts;
+
+    num_pkts = 0;
+    while (max_pkts == 0 || num_pkts < max_pkts) {
+        om = os_mqueue_get(&ble_hs_rx_q);
+        if (om == NULL) {
+            return 0;
+        }
 
-    while ((om = os_mqueue_get(&ble_hs_rx_q)) != NULL) {
         ble_hs_hci_evt_acl_process(om);
+        num_pkts++;
     }
+
+    return !STAILQ_EMPTY(&ble_hs_rx_q.mq_head);
+}
+
+void
+ble_hs_process_rx_data_queue(void)
+{
+    ble_hs_process_rx_data_batch(0);
 }
 
 static void
@@ -240,6 +266,7 @@ ble_hs_sync(void)
     rc = ble_hs_startup_go();
     if (rc == 0) {
         ble_hs_sync_state = BLE_HS_SYNC_STATE_GOOD;
+        ble_sm_sc_pregen_keys();
         if (ble_hs_cfg.sync_cb != NULL) {
             ble_hs_cfg.sync_cb();
         }
@@ -293,8 +320,10 @@ ble_hs_reset(void)
 }
 
 /**
- * Called once a second by the ble_hs heartbeat timer.  Handles unresponsive
- * timeouts and periodic retries in case of resource shortage.
+ * Called by the ble_hs heartbeat timer when the earliest registered deadline
+ * expires.  Handles unresponsive timeouts and sync retries.  Each subsystem
+ * reports when it next needs attention; the timer is left idle when nothing
+ * is pending.
  */
 static void
 ble_hs_heartbeat(void *unused)
@@ -306,13 +335,6 @@ ble_hs_heartbeat(void *unused)
         return;
     }
 
-    /* Ensure the timer expires at least once in the next second.
-     * XXX: This is not very power efficient.  We will need separate timers for
-     * each module.
-     */
-    ticks_until_next = BLE_HS_HEARTBEAT_OS_TICKS;
-    ble_hs_heartbeat_sched(ticks_until_next);
-
     ticks_until_next = ble_gattc_heartbeat();
     ble_hs_heartbeat_sched(ticks_until_next);
 
@@ -330,13 +352,15 @@ static void
 ble_hs_event_handle(void *unused)
 {
     struct os_callout_func *cf;
-    struct os_eventq *evqp;
+    struct os_eventq *evqs[2];
     struct os_event *ev;
     uint8_t *hci_evt;
     int rc;
     int i;
 
-    evqp = &ble_hs_evq;
+    /* Control events take precedence over data. */
+    evqs[0] = &ble_hs_ctrl_evq;
+    evqs[1] = &ble_hs_evq;
 
     i = 0;
     while (1) {
@@ -350,7 +374,7 @@ ble_hs_event_handle(void *unused)
         }
         i++;
 
-        ev = os_eventq_poll(&evqp, 1, 0);
+        ev = os_eventq_poll(evqs, 2, 0);
         if (ev == NULL) {
             break;
         }
@@ -377,7 +401,13 @@ ble_hs_event_handle(void *unused)
 
         case OS_EVENT_T_MQUEUE_DATA:
             ble_hs_process_tx_data_queue();
-            ble_hs_process_rx_data_queue();
+            if (ble_hs_process_rx_data_batch(ble_hs_cfg.max_acl_per_pass)) {
+                /* More data pending; revisit it after any control events
+                 * that arrived in the meantime.
+                 */
+                os_eventq_put(&ble_hs_evq, &ble_hs_rx_q.mq_ev);
+                os_eventq_put(ble_hs_parent_evq, &ble_hs_event_co.cf_c.c_ev);
+            }
             break;
 
         case BLE_HS_EVENT_RESET:
@@ -385,6 +415,14 @@ ble_hs_event_handle(void *unused)
             ble_hs_reset();
             break;
 
+        case BLE_HS_EVENT_SM_SC_DONE:
+            ble_sm_sc_jobs_done();
+            break;
+
+        case BLE_HS_EVENT_GATTC_CACHE:
+            ble_gattc_cache_replay();
+            break;
+
         default:
             BLE_HS_DBG_ASSERT(0);
             break;
@@ -395,7 +433,7 @@ ble_hs_event_handle(void *unused)
 void
 ble_hs_event_enqueue(struct os_event *ev)
 {
-    os_eventq_put(&ble_hs_evq, ev);
+    os_eventq_put(&ble_hs_ctrl_evq, ev);
     os_eventq_put(ble_hs_parent_evq, &ble_hs_event_co.cf_c.c_ev);
 }
 
@@ -429,7 +467,8 @@ ble_hs_notifications_sched(void)
     }
 #endif
 
-    ble_hs_event_enqueue(&ble_hs_event_tx_notifications);
+    os_eventq_put(&ble_hs_evq, &ble_hs_event_tx_notifications);
+    os_eventq_put(ble_hs_parent_evq, &ble_hs_event_co.cf_c.c_ev);
 }
 
 void
@@ -521,6 +560,28 @@ ble_hs_tx_data(struct os_mbuf *om)
     return 0;
 }
 
+int
+ble_hs_hci_ev_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                       struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *live_pool;
+
+    if (idx != 0) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        live_pool = &ble_hs_hci_ev_pool;
+    } else {
+        live_pool = NULL;
+    }
+
+    ble_hs_mem_pool_fill(out_pool, "ble_hs_hci_ev_pool", cfg->max_hci_bufs,
+                         sizeof (struct os_event), live_pool);
+    return 0;
+}
+
 static void
 ble_hs_free_mem(void)
 {
@@ -577,7 +638,8 @@ ble_hs_init(struct os_eventq *app_evq, struct ble_hs_cfg *cfg)
                          "ble_hs_hci_ev_pool");
     assert(rc == 0);
 
-    /* Initialize eventq */
+    /* Initialize eventqs */
+    os_eventq_init(&ble_hs_ctrl_evq);
     os_eventq_init(&ble_hs_evq);
 
     /* Initialize stats. */
@@ -621,3 +621,153 @@ ble_hs_adv_parse_fields(struct ble_hs_adv_fields *adv_fields, uint8_t *src,
 
     return 0;
 }
+
+/**
+ * Reads the field at the specified offset of encoded advertising data and
+ * advances the offset past it.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there are no more fields;
+ *                              BLE_HS_EBADDATA if the data is malformed.
+ */
+static int
+ble_hs_adv_next_field(const uint8_t *src, uint8_t src_len, uint8_t *off,
+                      struct ble_hs_adv_field *out_field)
+{
+    uint8_t field_len;
+
+    if (*off >= src_len) {
+        return BLE_HS_ENOENT;
+    }
+
+    field_len = src[*off];
+    if (field_len == 0) {
+        /* Early termination of the significant part. */
+        return BLE_HS_ENOENT;
+    }
+    if (*off + 1 + field_len > src_len) {
+        return BLE_HS_EBADDATA;
+    }
+
+    out_field->type = src[*off + 1];
+    out_field->value_len = field_len - 1;
+    out_field->value = src + *off + 2;
+
+    *off += 1 + field_len;
+
+    return 0;
+}
+
+/**
+ * Iterates the fields in encoded advertising data without copying or
+ * decoding them.  This is a lightweight alternative to parsing a full
+ * ble_hs_adv_fields struct; it is intended for scanners that only care about
+ * a few fields of each advertising report.
+ *
+ * @param data                  The encoded advertising data.
+ * @param length                The length of the encoded data.
+ * @param cb                    The function to call for each field.  The
+ *                                  field's value points into the source
+ *                                  buffer.  Return 0 to continue
+ *                                  iterating; nonzero to stop.
+ * @param cb_arg                The optional argument to pass to the callback
+ *                                  function.
+ *
+ * @return                      0 if every field was visited;
+ *                              BLE_HS_EBADDATA if the data is malformed (the
+ *                                  fields preceding the bad one have already
+ *                                  been reported);
+ *                              Other nonzero on callback abort.
+ */
+int
+ble_hs_adv_parse(const uint8_t *data, uint8_t length,
+                 ble_hs_adv_parse_fn *cb, void *cb_arg)
+{
+    struct ble_hs_adv_field field;
+    uint8_t off;
+    int rc;
+
+    off = 0;
+    while (1) {
+        rc = ble_hs_adv_next_field(data, length, &off, &field);
+        if (rc == BLE_HS_ENOENT) {
+            return 0;
+        }
+        if (rc != 0) {
+            return rc;
+        }
+
+        rc = cb(&field, cb_arg);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+}
+
+/**
+ * Locates the first field of the specified type in encoded advertising data.
+ *
+ * @param data                  The encoded advertising data.
+ * @param length                The length of the encoded data.
+ * @param type                  The AD type to search for.
+ * @param out_field             On success, the matching field gets written
+ *                                  here.  Its value points into the
+ *                                  source buffer.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there is no such field;
+ *                              BLE_HS_EBADDATA if the data is malformed.
+ */
+int
+ble_hs_adv_find(const uint8_t *data, uint8_t length, uint8_t type,
+                struct ble_hs_adv_field *out_field)
+{
+    uint8_t off;
+    int rc;
+
+    off = 0;
+    while (1) {
+        rc = ble_hs_adv_next_field(data, length, &off, out_field);
+        if (rc != 0) {
+            return rc;
+        }
+
+        if (out_field->type == type) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Locates the first field of the specified type in encoded advertising data.
+ *
+ * @param type                  The AD type to search for.
+ * @param src                   The encoded advertising data.
+ * @param src_len               The length of the encoded data.
+ * @param out_off               On success, the offset of the field's value
+ *                                  (past the two-byte field header) gets
+ *                                  written here.
+ * @param out_len               On success, the length of the field's value
+ *                                  gets written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there is no such field;
+ *                              BLE_HS_EBADDATA if the data is malformed.
+ */
+int
+ble_hs_adv_find_field(uint8_t type, const uint8_t *src, uint8_t src_len,
+                      uint8_t *out_off, uint8_t *out_len)
+{
+    struct ble_hs_adv_field field;
+    int rc;
+
+    rc = ble_hs_adv_find(src, src_len, type, &field);
+    if (rc != 0) {
+        return rc;
+    }
+
+    *out_off = field.value - src;
+    *out_len = field.value_len;
+
+    return 0;
+}
@@ -26,5 +26,7 @@ int ble_hs_adv_set_fields(const struct ble_hs_adv_fields *adv_fields,
                           uint8_t *dst, uint8_t *dst_len, uint8_t max_len);
 int ble_hs_adv_parse_fields(struct ble_hs_adv_fields *adv_fields, uint8_t *src,
                             uint8_t src_len);
+int ble_hs_adv_find_field(uint8_t type, const uint8_t *src, uint8_t src_len,
+                          uint8_t *out_off, uint8_t *out_len);
 
 #endif
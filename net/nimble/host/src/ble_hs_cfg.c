@@ -28,9 +28,12 @@
 const struct ble_hs_cfg ble_hs_cfg_dflt = {
     /** HCI settings. */
     .max_hci_bufs = 14,
+    .max_acl_per_pass = 4,
 
     /** Connection settings. */
     .max_connections = BLE_HS_CFG_MAX_CONNECTIONS,
+    .max_conn_tx_mbufs = 0,
+    .max_conn_rx_mbufs = 0,
 
     /** GATT server settings. */
     /* These get set to zero with the expectation that they will be increased
@@ -46,11 +49,13 @@ const struct ble_hs_cfg ble_hs_cfg_dflt = {
     /* This is set to 0; see note above re: GATT server settings. */
     .max_attrs = 0,
     .max_prep_entries = 6,
+    .max_prep_write_len = 1024,
 
     /** L2CAP settings. */
     /* Three channels per connection (sig, att, and sm). */
     .max_l2cap_chans = 3 * BLE_HS_CFG_MAX_CONNECTIONS,
     .max_l2cap_sig_procs = 1,
+    .max_l2cap_coc_servers = 0,
     .max_l2cap_sm_procs = 1,
 
     /** Security manager settings. */
@@ -62,6 +67,8 @@ const struct ble_hs_cfg ble_hs_cfg_dflt = {
     .sm_keypress = 0,
     .sm_our_key_dist = 0,
     .sm_their_key_dist = 0,
+    .sm_sc_task_prio = 0,
+    .sm_sc_task_stack_size = 0,
 
     /** Privacy settings. */
     .rpa_timeout = 300,
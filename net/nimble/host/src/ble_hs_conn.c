@@ -29,6 +29,12 @@
 static SLIST_HEAD(, ble_hs_conn) ble_hs_conns;
 static struct os_mempool ble_hs_conn_pool;
 
+/** Connections hashed by handle; the size is a power of two no smaller than
+ * the maximum number of connections, so chains are normally one long.
+ */
+static struct ble_hs_conn **ble_hs_conn_hash;
+static uint16_t ble_hs_conn_hash_mask;
+
 static os_membuf_t *ble_hs_conn_elem_mem;
 
 static const uint8_t ble_hs_conn_null_addr[6];
@@ -54,6 +60,10 @@ ble_hs_conn_chan_find(struct ble_hs_conn *conn, uint16_t cid)
 
     struct ble_l2cap_chan *chan;
 
+    if (cid >= BLE_HS_CONN_FIXED_CID_MIN && cid <= BLE_HS_CONN_FIXED_CID_MAX) {
+        return conn->bhc_fixed_chans[cid - BLE_HS_CONN_FIXED_CID_MIN];
+    }
+
     SLIST_FOREACH(chan, &conn->bhc_channels, blc_next) {
         if (chan->blc_cid == cid) {
             return chan;
@@ -94,6 +104,13 @@ ble_hs_conn_chan_insert(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan)
         SLIST_INSERT_AFTER(prev, chan, blc_next);
     }
 
+    if (chan->blc_cid >= BLE_HS_CONN_FIXED_CID_MIN &&
+        chan->blc_cid <= BLE_HS_CONN_FIXED_CID_MAX) {
+
+        conn->bhc_fixed_chans[chan->blc_cid - BLE_HS_CONN_FIXED_CID_MIN] =
+            chan;
+    }
+
     return 0;
 }
 
@@ -115,6 +132,7 @@ ble_hs_conn_alloc(void)
     memset(conn, 0, sizeof *conn);
 
     SLIST_INIT(&conn->bhc_channels);
+    STAILQ_INIT(&conn->bhc_tx_q);
 
     chan = ble_att_create_chan();
     if (chan == NULL) {
@@ -162,12 +180,18 @@ err:
     return NULL;
 }
 
-static void
+void
 ble_hs_conn_delete_chan(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan)
 {
     if (conn->bhc_rx_chan == chan) {
         conn->bhc_rx_chan = NULL;
     }
+    if (chan->blc_cid >= BLE_HS_CONN_FIXED_CID_MIN &&
+        chan->blc_cid <= BLE_HS_CONN_FIXED_CID_MAX) {
+
+        conn->bhc_fixed_chans[chan->blc_cid - BLE_HS_CONN_FIXED_CID_MIN] =
+            NULL;
+    }
 
     SLIST_REMOVE(&conn->bhc_channels, chan, ble_l2cap_chan, blc_next);
     ble_l2cap_chan_free(chan);
@@ -208,8 +232,14 @@ ble_hs_conn_insert(struct ble_hs_conn *conn)
 
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
+    struct ble_hs_conn **slot;
+
     BLE_HS_DBG_ASSERT_EVAL(ble_hs_conn_find(conn->bhc_handle) == NULL);
     SLIST_INSERT_HEAD(&ble_hs_conns, conn, bhc_next);
+
+    slot = &ble_hs_conn_hash[conn->bhc_handle & ble_hs_conn_hash_mask];
+    conn->bhc_hash_next = *slot;
+    *slot = conn;
 }
 
 void
@@ -219,9 +249,19 @@ ble_hs_conn_remove(struct ble_hs_conn *conn)
     return;
 #endif
 
+    struct ble_hs_conn **slot;
+
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
     SLIST_REMOVE(&ble_hs_conns, conn, ble_hs_conn, bhc_next);
+    ble_hs_hci_acl_tx_flush(conn);
+
+    slot = &ble_hs_conn_hash[conn->bhc_handle & ble_hs_conn_hash_mask];
+    while (*slot != conn) {
+        BLE_HS_DBG_ASSERT(*slot != NULL);
+        slot = &(*slot)->bhc_hash_next;
+    }
+    *slot = conn->bhc_hash_next;
 }
 
 struct ble_hs_conn *
@@ -235,7 +275,10 @@ ble_hs_conn_find(uint16_t conn_handle)
 
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
-    SLIST_FOREACH(conn, &ble_hs_conns, bhc_next) {
+    for (conn = ble_hs_conn_hash[conn_handle & ble_hs_conn_hash_mask];
+         conn != NULL;
+         conn = conn->bhc_hash_next) {
+
         if (conn->bhc_handle == conn_handle) {
             return conn;
         }
@@ -310,6 +353,19 @@ ble_hs_conn_exists(uint16_t conn_handle)
     return ble_hs_conn_find(conn_handle) != NULL;
 }
 
+/**
+ * Indicates whether a connection's queued outgoing data has used up its
+ * share of the msys pool (ble_hs_cfg.max_conn_tx_mbufs).
+ *
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ */
+int
+ble_hs_conn_tx_quota_full(const struct ble_hs_conn *conn)
+{
+    return ble_hs_cfg.max_conn_tx_mbufs != 0 &&
+           conn->bhc_tx_mbufs >= ble_hs_cfg.max_conn_tx_mbufs;
+}
+
 /**
  * Retrieves the first connection in the list.
  */
@@ -379,11 +435,59 @@ ble_hs_conn_free_mem(void)
 {
     free(ble_hs_conn_elem_mem);
     ble_hs_conn_elem_mem = NULL;
+
+    free(ble_hs_conn_hash);
+    ble_hs_conn_hash = NULL;
+}
+
+static int
+ble_hs_conn_hash_size(int max_connections)
+{
+    int hash_size;
+
+    hash_size = 1;
+    while (hash_size < max_connections) {
+        hash_size <<= 1;
+    }
+
+    return hash_size;
+}
+
+int
+ble_hs_conn_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                     struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *live_pool;
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        live_pool = &ble_hs_conn_pool;
+    } else {
+        live_pool = NULL;
+    }
+
+    switch (idx) {
+    case 0:
+        ble_hs_mem_pool_fill(out_pool, "ble_hs_conn_pool",
+                             cfg->max_connections,
+                             sizeof (struct ble_hs_conn), live_pool);
+        return 0;
+
+    case 1:
+        ble_hs_mem_pool_fill(out_pool, "ble_hs_conn_hash",
+                             ble_hs_conn_hash_size(cfg->max_connections),
+                             sizeof *ble_hs_conn_hash, NULL);
+        return 0;
+
+    default:
+        return BLE_HS_ENOENT;
+    }
 }
 
 int 
 ble_hs_conn_init(void)
 {
+    int hash_size;
     int rc;
 
     ble_hs_conn_free_mem();
@@ -403,6 +507,14 @@ ble_hs_conn_init(void)
         goto err;
     }
 
+    hash_size = ble_hs_conn_hash_size(ble_hs_cfg.max_connections);
+    ble_hs_conn_hash = calloc(hash_size, sizeof *ble_hs_conn_hash);
+    if (ble_hs_conn_hash == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto err;
+    }
+    ble_hs_conn_hash_mask = hash_size - 1;
+
     SLIST_INIT(&ble_hs_conns);
 
     return 0;
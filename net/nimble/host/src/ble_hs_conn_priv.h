@@ -27,13 +27,24 @@
 struct hci_le_conn_complete;
 struct hci_create_conn;
 struct ble_l2cap_chan;
+struct ble_hs_cfg;
+struct ble_hs_mem_pool;
 
 typedef uint8_t ble_hs_conn_flags_t;
 
 #define BLE_HS_CONN_F_MASTER        0x01
+#define BLE_HS_CONN_F_TX_SCHED      0x02    /* In the ACL tx schedule. */
+#define BLE_HS_CONN_F_TX_FRAG       0x04    /* Head tx packet partly sent. */
+
+/** Channels with CIDs in this range are also kept in bhc_fixed_chans. */
+#define BLE_HS_CONN_FIXED_CID_MIN   BLE_L2CAP_CID_ATT
+#define BLE_HS_CONN_FIXED_CID_MAX   BLE_L2CAP_CID_SM
+#define BLE_HS_CONN_NUM_FIXED_CHANS \
+    (BLE_HS_CONN_FIXED_CID_MAX - BLE_HS_CONN_FIXED_CID_MIN + 1)
 
 struct ble_hs_conn {
     SLIST_ENTRY(ble_hs_conn) bhc_next;
+    struct ble_hs_conn *bhc_hash_next;
     uint16_t bhc_handle;
     uint8_t bhc_peer_addr_type;
     uint8_t bhc_our_addr_type;
@@ -49,9 +60,22 @@ struct ble_hs_conn {
     ble_hs_conn_flags_t bhc_flags;
 
     struct ble_l2cap_chan_list bhc_channels;
+    struct ble_l2cap_chan *bhc_fixed_chans[BLE_HS_CONN_NUM_FIXED_CHANS];
     struct ble_l2cap_chan *bhc_rx_chan; /* Channel rxing current packet. */
     uint16_t bhc_outstanding_pkts;
 
+    /* Connection auto-tuning (ble_gap_tune()). */
+    const struct ble_gap_tune_params *bhc_tune;
+    uint32_t bhc_tune_bytes;    /* ACL bytes tx'd / rx'd this sample. */
+    uint8_t bhc_tune_profile;
+    uint8_t bhc_tune_idle;      /* Consecutive idle samples. */
+
+    /* Outgoing ACL data packets waiting for controller buffers. */
+    STAILQ_HEAD(, os_mbuf_pkthdr) bhc_tx_q;
+    uint16_t bhc_tx_mbufs;      /* mbufs held by bhc_tx_q. */
+    uint16_t bhc_rx_mbufs;      /* mbufs held by bhc_rx_chan's packet. */
+    STAILQ_ENTRY(ble_hs_conn) bhc_tx_next;
+
     struct ble_att_svr_conn bhc_att_svr;
     struct ble_gatts_conn bhc_gatt_svr;
 
@@ -82,14 +106,19 @@ struct ble_hs_conn *ble_hs_conn_find_assert(uint16_t conn_handle);
 struct ble_hs_conn *ble_hs_conn_find_by_addr(uint8_t addr_type, uint8_t *addr);
 struct ble_hs_conn *ble_hs_conn_find_by_idx(int idx);
 int ble_hs_conn_exists(uint16_t conn_handle);
+int ble_hs_conn_tx_quota_full(const struct ble_hs_conn *conn);
 struct ble_hs_conn *ble_hs_conn_first(void);
 struct ble_l2cap_chan *ble_hs_conn_chan_find(struct ble_hs_conn *conn,
                                              uint16_t cid);
 int ble_hs_conn_chan_insert(struct ble_hs_conn *conn,
                             struct ble_l2cap_chan *chan);
+void ble_hs_conn_delete_chan(struct ble_hs_conn *conn,
+                             struct ble_l2cap_chan *chan);
 void ble_hs_conn_addrs(const struct ble_hs_conn *conn,
                        struct ble_hs_conn_addrs *addrs);
 
+int ble_hs_conn_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                         struct ble_hs_mem_pool *out_pool);
 int ble_hs_conn_init(void);
 
 #endif
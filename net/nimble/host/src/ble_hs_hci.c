@@ -30,10 +30,33 @@
 static struct os_mutex ble_hs_hci_mutex;
 static struct os_sem ble_hs_hci_sem;
 
-static uint8_t *ble_hs_hci_ack;
+#if PHONY_HCI_ACKS
+/* Phony acks are generated synchronously, one per command. */
+#define BLE_HS_HCI_PIPELINE_DEPTH   1
+#else
+#define BLE_HS_HCI_PIPELINE_DEPTH   BLE_HS_HCI_MAX_PIPELINE
+#endif
+
+/* Received acknowledgements not yet processed, oldest first. */
+static uint8_t *ble_hs_hci_acks[BLE_HS_HCI_MAX_PIPELINE];
+static uint8_t ble_hs_hci_ack_head;
+static uint8_t ble_hs_hci_num_acks;
+
+/* Number of sent commands whose acknowledgement hasn't arrived yet. */
+static uint8_t ble_hs_hci_num_pending;
+
+/* Number of commands the controller is currently willing to accept. */
+static uint8_t ble_hs_hci_cmd_credits;
+
 static uint16_t ble_hs_hci_buf_sz;
 static uint8_t ble_hs_hci_max_pkts;
 
+/* Number of controller ACL data buffers not holding host data. */
+static uint8_t ble_hs_hci_avail_pkts;
+
+/* Connections with queued ACL data, in the order they get to send. */
+static STAILQ_HEAD(, ble_hs_conn) ble_hs_hci_tx_conns;
+
 #if PHONY_HCI_ACKS
 static ble_hs_hci_phony_ack_fn *ble_hs_hci_phony_ack_cb;
 #endif
@@ -73,6 +96,7 @@ ble_hs_hci_set_buf_sz(uint16_t pktlen, uint8_t max_pkts)
 
     ble_hs_hci_buf_sz = pktlen;
     ble_hs_hci_max_pkts = max_pkts;
+    ble_hs_hci_avail_pkts = max_pkts;
 
     return 0;
 }
@@ -94,8 +118,7 @@ ble_hs_hci_rx_cmd_complete(uint8_t event_code, uint8_t *data, int len,
     opcode = le16toh(data + 3);
     params = data + 5;
 
-    /* XXX: Process num_pkts field. */
-    (void)num_pkts;
+    ble_hs_hci_cmd_credits = num_pkts;
 
     out_ack->bha_opcode = opcode;
 
@@ -136,8 +159,7 @@ ble_hs_hci_rx_cmd_status(uint8_t event_code, uint8_t *data, int len,
     num_pkts = data[3];
     opcode = le16toh(data + 4);
 
-    /* XXX: Process num_pkts field. */
-    (void)num_pkts;
+    ble_hs_hci_cmd_credits = num_pkts;
 
     out_ack->bha_opcode = opcode;
     out_ack->bha_params = NULL;
@@ -148,25 +170,21 @@ ble_hs_hci_rx_cmd_status(uint8_t event_code, uint8_t *data, int len,
 }
 
 static int
-ble_hs_hci_process_ack(uint16_t expected_opcode,
-                       uint8_t *params_buf, uint8_t params_buf_len,
-                       struct ble_hs_hci_ack *out_ack)
+ble_hs_hci_process_ack(uint8_t *ack_ev, struct ble_hs_hci_ack *out_ack)
 {
     uint8_t event_code;
     uint8_t param_len;
     uint8_t event_len;
     int rc;
 
-    BLE_HS_DBG_ASSERT(ble_hs_hci_ack != NULL);
-
     /* Count events received */
     STATS_INC(ble_hs_stats, hci_event);
 
     /* Display to console */
-    ble_hs_dbg_event_disp(ble_hs_hci_ack);
+    ble_hs_dbg_event_disp(ack_ev);
 
-    event_code = ble_hs_hci_ack[0];
-    param_len = ble_hs_hci_ack[1];
+    event_code = ack_ev[0];
+    param_len = ack_ev[1];
     event_len = param_len + 2;
 
     /* Clear ack fields up front to silence spurious gcc warnings. */
@@ -174,13 +192,12 @@ ble_hs_hci_process_ack(uint16_t expected_opcode,
 
     switch (event_code) {
     case BLE_HCI_EVCODE_COMMAND_COMPLETE:
-        rc = ble_hs_hci_rx_cmd_complete(event_code, ble_hs_hci_ack,
-                                         event_len, out_ack);
+        rc = ble_hs_hci_rx_cmd_complete(event_code, ack_ev, event_len,
+                                        out_ack);
         break;
 
     case BLE_HCI_EVCODE_COMMAND_STATUS:
-        rc = ble_hs_hci_rx_cmd_status(event_code, ble_hs_hci_ack,
-                                       event_len, out_ack);
+        rc = ble_hs_hci_rx_cmd_status(event_code, ack_ev, event_len, out_ack);
         break;
 
     default:
@@ -189,32 +206,62 @@ ble_hs_hci_process_ack(uint16_t expected_opcode,
         break;
     }
 
-    if (rc == 0) {
-        if (params_buf == NULL) {
-            out_ack->bha_params_len = 0;
-        } else {
-            if (out_ack->bha_params_len > params_buf_len) {
-                out_ack->bha_params_len = params_buf_len;
-                rc = BLE_HS_ECONTROLLER;
-            }
-            memcpy(params_buf, out_ack->bha_params, out_ack->bha_params_len);
-        }
-        out_ack->bha_params = params_buf;
+    return rc;
+}
 
-        if (out_ack->bha_opcode != expected_opcode) {
-            rc = BLE_HS_ECONTROLLER;
+/**
+ * Applies a received acknowledgement to the oldest unacknowledged command in
+ * the specified range with a matching opcode.  The ack parameters are copied
+ * into the command's event buffer.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ECONTROLLER if the ack does not
+ *                                  correspond to any command in the range
+ *                                  or its parameters don't fit.
+ */
+static int
+ble_hs_hci_batch_ack(struct ble_hs_hci_batch_cmd *cmds, int num_cmds,
+                     const struct ble_hs_hci_ack *ack)
+{
+    struct ble_hs_hci_batch_cmd *cmd;
+    uint8_t params_len;
+    int rc;
+    int i;
+
+    cmd = NULL;
+    for (i = 0; i < num_cmds; i++) {
+        if (!cmds[i].bhc_acked &&
+            le16toh(cmds[i].bhc_cmd) == ack->bha_opcode) {
+
+            cmd = cmds + i;
+            break;
         }
     }
+    if (cmd == NULL) {
+        return BLE_HS_ECONTROLLER;
+    }
 
-    if (rc != 0) {
-        STATS_INC(ble_hs_stats, hci_invalid_ack);
+    rc = 0;
+    params_len = ack->bha_params_len;
+    if (cmd->bhc_evt_buf == NULL) {
+        params_len = 0;
+    } else if (params_len > cmd->bhc_evt_buf_len) {
+        params_len = cmd->bhc_evt_buf_len;
+        rc = BLE_HS_ECONTROLLER;
     }
+    if (params_len > 0) {
+        memcpy(cmd->bhc_evt_buf, ack->bha_params, params_len);
+    }
+
+    cmd->bhc_evt_len = params_len;
+    cmd->bhc_status = ack->bha_status;
+    cmd->bhc_acked = 1;
 
     return rc;
 }
 
 static int
-ble_hs_hci_wait_for_ack(void)
+ble_hs_hci_wait_for_ack(uint8_t **out_ack)
 {
     int rc;
 
@@ -222,16 +269,28 @@ ble_hs_hci_wait_for_ack(void)
     if (ble_hs_hci_phony_ack_cb == NULL) {
         rc = BLE_HS_ETIMEOUT_HCI;
     } else {
-        ble_hs_hci_ack =
-            ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_CMD);
-        BLE_HS_DBG_ASSERT(ble_hs_hci_ack != NULL);
-        rc = ble_hs_hci_phony_ack_cb(ble_hs_hci_ack, 260);
+        *out_ack = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_CMD);
+        BLE_HS_DBG_ASSERT(*out_ack != NULL);
+        rc = ble_hs_hci_phony_ack_cb(*out_ack, 260);
+        if (rc != 0) {
+            ble_hci_trans_buf_free(*out_ack);
+        } else {
+            ble_hs_hci_num_pending--;
+        }
     }
 #else
+    os_sr_t sr;
+
     rc = os_sem_pend(&ble_hs_hci_sem, BLE_HCI_CMD_TIMEOUT);
     switch (rc) {
     case 0:
-        BLE_HS_DBG_ASSERT(ble_hs_hci_ack != NULL);
+        OS_ENTER_CRITICAL(sr);
+        BLE_HS_DBG_ASSERT(ble_hs_hci_num_acks > 0);
+        *out_ack = ble_hs_hci_acks[ble_hs_hci_ack_head];
+        ble_hs_hci_ack_head =
+            (ble_hs_hci_ack_head + 1) % BLE_HS_HCI_MAX_PIPELINE;
+        ble_hs_hci_num_acks--;
+        OS_EXIT_CRITICAL(sr);
         break;
     case OS_TIMEOUT:
         rc = BLE_HS_ETIMEOUT_HCI;
@@ -246,52 +305,177 @@ ble_hs_hci_wait_for_ack(void)
     return rc;
 }
 
+/**
+ * Discards acknowledgements of commands that are no longer being waited on.
+ * Any that are still in flight get dropped as unexpected when they arrive.
+ */
+static void
+ble_hs_hci_flush_acks(void)
+{
+    uint8_t *ack;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    ble_hs_hci_num_pending = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    while (ble_hs_hci_num_acks > 0) {
+        OS_ENTER_CRITICAL(sr);
+        ack = ble_hs_hci_acks[ble_hs_hci_ack_head];
+        ble_hs_hci_ack_head =
+            (ble_hs_hci_ack_head + 1) % BLE_HS_HCI_MAX_PIPELINE;
+        ble_hs_hci_num_acks--;
+        OS_EXIT_CRITICAL(sr);
+
+        ble_hci_trans_buf_free(ack);
+    }
+
+    /* Consume the semaphore tokens of the discarded acks. */
+    while (os_sem_pend(&ble_hs_hci_sem, 0) == 0) {
+    }
+}
+
+/**
+ * Sends a batch of independent HCI commands and waits for all of their
+ * acknowledgements.  Up to BLE_HS_HCI_MAX_PIPELINE commands are kept in
+ * flight, as far as the controller's Num_HCI_Command_Packets allows, so the
+ * round trips overlap instead of adding up.
+ *
+ * Once a command fails, no further commands from the batch are sent; those
+ * already in flight are still acknowledged.
+ *
+ * @param cmds                  The commands to send, in order.
+ * @param num_cmds              The number of entries in cmds.
+ *
+ * @return                      0 if every command succeeded;
+ *                              otherwise, the first failure in command
+ *                                  order: a BLE host core return code or the
+ *                                  command's HCI status.
+ */
 int
-ble_hs_hci_cmd_tx(void *cmd, void *evt_buf, uint8_t evt_buf_len,
-                  uint8_t *out_evt_buf_len)
+ble_hs_hci_cmd_tx_batch(struct ble_hs_hci_batch_cmd *cmds, int num_cmds)
 {
     struct ble_hs_hci_ack ack;
-    uint16_t opcode;
+    uint8_t *ack_ev;
+    os_sr_t sr;
+    int next_ack;
+    int next_tx;
+    int failed;
     int rc;
+    int i;
 
-    opcode = le16toh(cmd);
+    for (i = 0; i < num_cmds; i++) {
+        cmds[i].bhc_evt_len = 0;
+        cmds[i].bhc_acked = 0;
+        cmds[i].bhc_status = BLE_HS_EAGAIN;
+    }
 
-    BLE_HS_DBG_ASSERT(ble_hs_hci_ack == NULL);
     ble_hs_hci_lock();
 
-    rc = ble_hs_hci_cmd_send_buf(cmd);
-    if (rc != 0) {
-        goto done;
-    }
+    next_tx = 0;
+    next_ack = 0;
+    failed = 0;
+    rc = 0;
+    while (next_ack < next_tx || (!failed && next_tx < num_cmds)) {
+        /* Fill the pipeline as far as the controller allows.  A command is
+         * always sent if none are outstanding, in case the controller
+         * restored its credits via a no-op ack that bypassed us.
+         */
+        while (!failed && next_tx < num_cmds &&
+               next_tx - next_ack < BLE_HS_HCI_PIPELINE_DEPTH &&
+               (next_tx == next_ack || ble_hs_hci_cmd_credits > 0)) {
+
+            OS_ENTER_CRITICAL(sr);
+            ble_hs_hci_num_pending++;
+            OS_EXIT_CRITICAL(sr);
+
+            rc = ble_hs_hci_cmd_send_buf(cmds[next_tx].bhc_cmd);
+            if (rc != 0) {
+                OS_ENTER_CRITICAL(sr);
+                ble_hs_hci_num_pending--;
+                OS_EXIT_CRITICAL(sr);
+
+                cmds[next_tx].bhc_status = rc;
+                failed = 1;
+                break;
+            }
 
-    rc = ble_hs_hci_wait_for_ack();
-    if (rc != 0) {
-        ble_hs_sched_reset(rc);
-        goto done;
-    }
+            if (ble_hs_hci_cmd_credits > 0) {
+                ble_hs_hci_cmd_credits--;
+            }
+            next_tx++;
+        }
 
-    rc = ble_hs_hci_process_ack(opcode, evt_buf, evt_buf_len, &ack);
-    if (rc != 0) {
-        ble_hs_sched_reset(rc);
-        goto done;
-    }
+        if (next_ack == next_tx) {
+            break;
+        }
 
-    if (out_evt_buf_len != NULL) {
-        *out_evt_buf_len = ack.bha_params_len;
+        rc = ble_hs_hci_wait_for_ack(&ack_ev);
+        if (rc != 0) {
+            ble_hs_sched_reset(rc);
+            goto done;
+        }
+
+        rc = ble_hs_hci_process_ack(ack_ev, &ack);
+        if (rc == 0) {
+            rc = ble_hs_hci_batch_ack(cmds + next_ack, next_tx - next_ack,
+                                      &ack);
+        }
+        ble_hci_trans_buf_free(ack_ev);
+        if (rc != 0) {
+            STATS_INC(ble_hs_stats, hci_invalid_ack);
+            ble_hs_sched_reset(rc);
+            goto done;
+        }
+
+        while (next_ack < next_tx && cmds[next_ack].bhc_acked) {
+            if (cmds[next_ack].bhc_status != 0) {
+                failed = 1;
+            }
+            next_ack++;
+        }
     }
 
-    rc = ack.bha_status;
+    /* Commands that were never sent still hold BLE_HS_EAGAIN, but only
+     * follow the one that failed.
+     */
+    rc = 0;
+    for (i = 0; i < num_cmds; i++) {
+        if (cmds[i].bhc_status != 0) {
+            rc = cmds[i].bhc_status;
+            break;
+        }
+    }
 
 done:
-    if (ble_hs_hci_ack != NULL) {
-        ble_hci_trans_buf_free(ble_hs_hci_ack);
-        ble_hs_hci_ack = NULL;
+    if (next_ack != next_tx) {
+        ble_hs_hci_flush_acks();
     }
 
     ble_hs_hci_unlock();
     return rc;
 }
 
+int
+ble_hs_hci_cmd_tx(void *cmd, void *evt_buf, uint8_t evt_buf_len,
+                  uint8_t *out_evt_buf_len)
+{
+    struct ble_hs_hci_batch_cmd batch_cmd;
+    int rc;
+
+    batch_cmd.bhc_cmd = cmd;
+    batch_cmd.bhc_evt_buf = evt_buf;
+    batch_cmd.bhc_evt_buf_len = evt_buf_len;
+
+    rc = ble_hs_hci_cmd_tx_batch(&batch_cmd, 1);
+
+    if (out_evt_buf_len != NULL) {
+        *out_evt_buf_len = batch_cmd.bhc_evt_len;
+    }
+
+    return rc;
+}
+
 int
 ble_hs_hci_cmd_tx_empty_ack(void *cmd)
 {
@@ -308,17 +492,27 @@ ble_hs_hci_cmd_tx_empty_ack(void *cmd)
 void
 ble_hs_hci_rx_ack(uint8_t *ack_ev)
 {
-    if (ble_hs_hci_sem.sem_tokens != 0) {
+    os_sr_t sr;
+    int idx;
+
+    OS_ENTER_CRITICAL(sr);
+    if (ble_hs_hci_num_pending == 0) {
+        OS_EXIT_CRITICAL(sr);
+
         /* This ack is unexpected; ignore it. */
         ble_hci_trans_buf_free(ack_ev);
         return;
     }
-    BLE_HS_DBG_ASSERT(ble_hs_hci_ack == NULL);
+    BLE_HS_DBG_ASSERT(ble_hs_hci_num_acks < BLE_HS_HCI_MAX_PIPELINE);
 
-    /* Unblock the application now that the HCI command buffer is populated
-     * with the acknowledgement.
-     */
-    ble_hs_hci_ack = ack_ev;
+    idx = (ble_hs_hci_ack_head + ble_hs_hci_num_acks) %
+          BLE_HS_HCI_MAX_PIPELINE;
+    ble_hs_hci_acks[idx] = ack_ev;
+    ble_hs_hci_num_acks++;
+    ble_hs_hci_num_pending--;
+    OS_EXIT_CRITICAL(sr);
+
+    /* Unblock the application now that the acknowledgement is queued. */
     os_sem_release(&ble_hs_hci_sem);
 }
 
@@ -440,69 +634,187 @@ ble_hs_hci_acl_hdr_prepend(struct os_mbuf *om, uint16_t handle,
 }
 
 /**
- * Transmits an HCI ACL data packet.  This function consumes the supplied mbuf,
- * regardless of the outcome.
- *
- * XXX: Ensure the controller has sufficient buffer capacity for the outgoing
- * fragments.
+ * Sends a single ACL data fragment to the controller.  This function consumes
+ * the supplied mbuf, regardless of the outcome.
  */
-int
-ble_hs_hci_acl_tx(struct ble_hs_conn *connection, struct os_mbuf *txom)
+static int
+ble_hs_hci_acl_tx_frag(struct ble_hs_conn *conn, struct os_mbuf *frag,
+                       uint8_t pb)
 {
-    struct os_mbuf *frag;
-    uint8_t pb;
     int rc;
 
-    /* The first fragment uses the first-non-flush packet boundary value.
-     * After sending the first fragment, pb gets set appropriately for all
-     * subsequent fragments in this packet.
+    frag = ble_hs_hci_acl_hdr_prepend(frag, conn->bhc_handle, pb);
+    if (frag == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    BLE_HS_LOG(DEBUG, "ble_hs_hci_acl_tx(): ");
+    ble_hs_log_mbuf(frag);
+    BLE_HS_LOG(DEBUG, "\n");
+
+    /* XXX: Try to pullup the entire fragment.  The controller currently
+     * requires the entire fragment to fit in a single buffer.  When this
+     * restriction is removed from the controller, this operation can be
+     * removed.
      */
-    pb = BLE_HCI_PB_FIRST_NON_FLUSH;
+    frag = os_mbuf_pullup(frag, OS_MBUF_PKTLEN(frag));
+    if (frag == NULL) {
+        return BLE_HS_ENOMEM;
+    }
 
-    /* Send fragments until the entire packet has been sent. */
-    while (txom != NULL) {
-        rc = ble_hs_hci_split_frag(&txom, &frag);
-        if (rc != 0) {
-            goto err;
-        }
+    rc = ble_hs_tx_data(frag);
+    if (rc != 0) {
+        return rc;
+    }
+
+    conn->bhc_outstanding_pkts++;
+    ble_hs_hci_avail_pkts--;
+
+    return 0;
+}
+
+static void
+ble_hs_hci_acl_tx_sched_conn(struct ble_hs_conn *conn)
+{
+    if (!(conn->bhc_flags & BLE_HS_CONN_F_TX_SCHED) &&
+        !STAILQ_EMPTY(&conn->bhc_tx_q)) {
+
+        STAILQ_INSERT_TAIL(&ble_hs_hci_tx_conns, conn, bhc_tx_next);
+        conn->bhc_flags |= BLE_HS_CONN_F_TX_SCHED;
+    }
+}
+
+/**
+ * Sends queued ACL data fragments for as long as the controller has free
+ * buffers.  Connections with pending data take turns, one fragment each, so
+ * that a single busy connection cannot occupy all of the controller's
+ * buffers.
+ */
+static void
+ble_hs_hci_acl_tx_sched(void)
+{
+    struct ble_hs_conn *conn;
+    struct os_mbuf *txom;
+    struct os_mbuf *frag;
+    int num_mbufs;
+    uint8_t pb;
+    int rc;
 
-        frag = ble_hs_hci_acl_hdr_prepend(frag, connection->bhc_handle, pb);
-        if (frag == NULL) {
-            rc = BLE_HS_ENOMEM;
-            goto err;
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    while (ble_hs_hci_avail_pkts > 0) {
+        conn = STAILQ_FIRST(&ble_hs_hci_tx_conns);
+        if (conn == NULL) {
+            break;
         }
-        pb = BLE_HCI_PB_MIDDLE;
+        STAILQ_REMOVE_HEAD(&ble_hs_hci_tx_conns, bhc_tx_next);
+        conn->bhc_flags &= ~BLE_HS_CONN_F_TX_SCHED;
 
-        BLE_HS_LOG(DEBUG, "ble_hs_hci_acl_tx(): ");
-        ble_hs_log_mbuf(frag);
-        BLE_HS_LOG(DEBUG, "\n");
+        txom = OS_MBUF_PKTHDR_TO_MBUF(STAILQ_FIRST(&conn->bhc_tx_q));
+        num_mbufs = ble_hs_mbuf_count(txom);
 
-        /* XXX: Try to pullup the entire fragment.  The controller currently
-         * requires the entire fragment to fit in a single buffer.  When this
-         * restriction is removed from the controller, this operation can be
-         * removed.
+        /* The first fragment uses the first-non-flush packet boundary value;
+         * the rest of the packet's fragments are continuations.
          */
-        frag = os_mbuf_pullup(frag, OS_MBUF_PKTLEN(frag));
-        if (frag == NULL) {
-            rc = BLE_HS_ENOMEM;
-            goto err;
+        if (conn->bhc_flags & BLE_HS_CONN_F_TX_FRAG) {
+            pb = BLE_HCI_PB_MIDDLE;
+        } else {
+            pb = BLE_HCI_PB_FIRST_NON_FLUSH;
         }
 
-        rc = ble_hs_tx_data(frag);
+        rc = ble_hs_hci_split_frag(&txom, &frag);
+        if (rc != 0 || txom == NULL) {
+            /* Either this is the final fragment or the rest of the packet
+             * has to be discarded.
+             */
+            STAILQ_REMOVE_HEAD(&conn->bhc_tx_q, omp_next);
+            conn->bhc_flags &= ~BLE_HS_CONN_F_TX_FRAG;
+            conn->bhc_tx_mbufs -= num_mbufs;
+            os_mbuf_free_chain(txom);
+        } else {
+            conn->bhc_flags |= BLE_HS_CONN_F_TX_FRAG;
+        }
+
+        if (rc == 0) {
+            rc = ble_hs_hci_acl_tx_frag(conn, frag, pb);
+        }
         if (rc != 0) {
-            goto err;
+            STATS_INC(ble_hs_stats, acl_tx_fail);
         }
 
-        connection->bhc_outstanding_pkts++;
+        ble_hs_hci_acl_tx_sched_conn(conn);
     }
+}
+
+/**
+ * Queues an HCI ACL data packet for transmission.  The packet is fragmented
+ * and sent as controller buffers become available.  This function consumes
+ * the supplied mbuf, regardless of the outcome.
+ */
+int
+ble_hs_hci_acl_tx(struct ble_hs_conn *connection, struct os_mbuf *txom)
+{
+    BLE_HS_DBG_ASSERT(OS_MBUF_IS_PKTHDR(txom));
+
+    connection->bhc_tune_bytes += OS_MBUF_PKTLEN(txom);
+    connection->bhc_tx_mbufs += ble_hs_mbuf_count(txom);
+    STAILQ_INSERT_TAIL(&connection->bhc_tx_q, OS_MBUF_PKTHDR(txom),
+                       omp_next);
+    ble_hs_hci_acl_tx_sched_conn(connection);
+    ble_hs_hci_acl_tx_sched();
 
     return 0;
+}
 
-err:
-    BLE_HS_DBG_ASSERT(rc != 0);
+/**
+ * Returns controller data buffers to the host, as reported by a number of
+ * completed packets event, and sends any data that was waiting for them.
+ *
+ * @param conn                  The connection whose packets completed.
+ * @param num_pkts              The number of completed packets.
+ */
+void
+ble_hs_hci_acl_tx_done(struct ble_hs_conn *conn, uint16_t num_pkts)
+{
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
-    os_mbuf_free_chain(txom);
-    return rc;
+    if (num_pkts > conn->bhc_outstanding_pkts) {
+        /* Controller reported more packets than it was given. */
+        num_pkts = conn->bhc_outstanding_pkts;
+    }
+    conn->bhc_outstanding_pkts -= num_pkts;
+    ble_hs_hci_avail_pkts += num_pkts;
+
+    ble_hs_hci_acl_tx_sched();
+}
+
+/**
+ * Discards all of a connection's queued ACL data.  The controller flushes
+ * the data of a terminated connection, so the buffers it was holding for the
+ * connection are returned to the host.
+ *
+ * @param conn                  The connection being removed.
+ */
+void
+ble_hs_hci_acl_tx_flush(struct ble_hs_conn *conn)
+{
+    struct os_mbuf_pkthdr *omp;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    if (conn->bhc_flags & BLE_HS_CONN_F_TX_SCHED) {
+        STAILQ_REMOVE(&ble_hs_hci_tx_conns, conn, ble_hs_conn, bhc_tx_next);
+        conn->bhc_flags &= ~BLE_HS_CONN_F_TX_SCHED;
+    }
+
+    while ((omp = STAILQ_FIRST(&conn->bhc_tx_q)) != NULL) {
+        STAILQ_REMOVE_HEAD(&conn->bhc_tx_q, omp_next);
+        os_mbuf_free_chain(OS_MBUF_PKTHDR_TO_MBUF(omp));
+    }
+    conn->bhc_tx_mbufs = 0;
+    conn->bhc_flags &= ~BLE_HS_CONN_F_TX_FRAG;
+
+    ble_hs_hci_acl_tx_done(conn, conn->bhc_outstanding_pkts);
 }
 
 void
@@ -515,4 +827,9 @@ ble_hs_hci_init(void)
 
     rc = os_mutex_init(&ble_hs_hci_mutex);
     BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+    /* The controller accepts one command until it says otherwise. */
+    ble_hs_hci_cmd_credits = 1;
+
+    STAILQ_INIT(&ble_hs_hci_tx_conns);
 }
@@ -58,89 +58,145 @@ struct host_hci_stats
 
 #define BLE_HS_HCI_EVT_TIMEOUT        50      /* Milliseconds. */
 
-/** Dispatch table for incoming HCI events.  Sorted by event code field. */
-struct ble_hs_hci_evt_dispatch_entry {
-    uint8_t event_code;
-    ble_hs_hci_evt_fn *cb;
-};
-
-static const struct ble_hs_hci_evt_dispatch_entry ble_hs_hci_evt_dispatch[] = {
-    { BLE_HCI_EVCODE_DISCONN_CMP, ble_hs_hci_evt_disconn_complete },
-    { BLE_HCI_EVCODE_ENCRYPT_CHG, ble_hs_hci_evt_encrypt_change },
-    { BLE_HCI_EVCODE_HW_ERROR, ble_hs_hci_evt_hw_error },
-    { BLE_HCI_EVCODE_NUM_COMP_PKTS, ble_hs_hci_evt_num_completed_pkts },
-    { BLE_HCI_EVCODE_ENC_KEY_REFRESH, ble_hs_hci_evt_enc_key_refresh },
-    { BLE_HCI_EVCODE_LE_META, ble_hs_hci_evt_le_meta },
+/**
+ * Dispatch table for incoming HCI events, indexed by event code.  Handlers
+ * are passed the event parameters, without the event header.
+ */
+static ble_hs_hci_evt_fn * const ble_hs_hci_evt_dispatch[] = {
+    [BLE_HCI_EVCODE_DISCONN_CMP] = ble_hs_hci_evt_disconn_complete,
+    [BLE_HCI_EVCODE_ENCRYPT_CHG] = ble_hs_hci_evt_encrypt_change,
+    [BLE_HCI_EVCODE_HW_ERROR] = ble_hs_hci_evt_hw_error,
+    [BLE_HCI_EVCODE_NUM_COMP_PKTS] = ble_hs_hci_evt_num_completed_pkts,
+    [BLE_HCI_EVCODE_ENC_KEY_REFRESH] = ble_hs_hci_evt_enc_key_refresh,
+    [BLE_HCI_EVCODE_LE_META] = ble_hs_hci_evt_le_meta,
 };
 
 #define BLE_HS_HCI_EVT_DISPATCH_SZ \
     (sizeof ble_hs_hci_evt_dispatch / sizeof ble_hs_hci_evt_dispatch[0])
 
-/** Dispatch table for incoming LE meta events.  Sorted by subevent field. */
-struct ble_hs_hci_evt_le_dispatch_entry {
-    uint8_t subevent;
-    ble_hs_hci_evt_le_fn *cb;
-};
-
-static const struct ble_hs_hci_evt_le_dispatch_entry
-        ble_hs_hci_evt_le_dispatch[] = {
-    { BLE_HCI_LE_SUBEV_CONN_COMPLETE, ble_hs_hci_evt_le_conn_complete },
-    { BLE_HCI_LE_SUBEV_ADV_RPT, ble_hs_hci_evt_le_adv_rpt },
-    { BLE_HCI_LE_SUBEV_CONN_UPD_COMPLETE,
-          ble_hs_hci_evt_le_conn_upd_complete },
-    { BLE_HCI_LE_SUBEV_LT_KEY_REQ, ble_hs_hci_evt_le_lt_key_req },
-    { BLE_HCI_LE_SUBEV_REM_CONN_PARM_REQ, ble_hs_hci_evt_le_conn_parm_req },
-    { BLE_HCI_LE_SUBEV_ENH_CONN_COMPLETE, ble_hs_hci_evt_le_conn_complete },
-    { BLE_HCI_LE_SUBEV_DIRECT_ADV_RPT, ble_hs_hci_evt_le_dir_adv_rpt },
+/**
+ * Dispatch table for incoming LE meta events, indexed by subevent code.
+ * Handlers are passed the subevent code followed by its parameters.
+ */
+static ble_hs_hci_evt_le_fn * const ble_hs_hci_evt_le_dispatch[] = {
+    [BLE_HCI_LE_SUBEV_CONN_COMPLETE] = ble_hs_hci_evt_le_conn_complete,
+    [BLE_HCI_LE_SUBEV_ADV_RPT] = ble_hs_hci_evt_le_adv_rpt,
+    [BLE_HCI_LE_SUBEV_CONN_UPD_COMPLETE] =
+        ble_hs_hci_evt_le_conn_upd_complete,
+    [BLE_HCI_LE_SUBEV_LT_KEY_REQ] = ble_hs_hci_evt_le_lt_key_req,
+    [BLE_HCI_LE_SUBEV_REM_CONN_PARM_REQ] = ble_hs_hci_evt_le_conn_parm_req,
+    [BLE_HCI_LE_SUBEV_ENH_CONN_COMPLETE] = ble_hs_hci_evt_le_conn_complete,
+    [BLE_HCI_LE_SUBEV_DIRECT_ADV_RPT] = ble_hs_hci_evt_le_dir_adv_rpt,
 };
 
 #define BLE_HS_HCI_EVT_LE_DISPATCH_SZ \
     (sizeof ble_hs_hci_evt_le_dispatch / sizeof ble_hs_hci_evt_le_dispatch[0])
 
-static const struct ble_hs_hci_evt_dispatch_entry *
-ble_hs_hci_evt_dispatch_find(uint8_t event_code)
-{
-    const struct ble_hs_hci_evt_dispatch_entry *entry;
-    int i;
+/*
+ * Views of fixed-size event parameters, overlaid on the event buffer.
+ * Multi-byte fields are little-endian byte arrays, read with le16toh() and
+ * le64toh().
+ */
+struct ble_hs_hci_evt_disconn_view {
+    uint8_t status;
+    uint8_t conn_handle[2];
+    uint8_t reason;
+} __attribute__((packed));
+
+struct ble_hs_hci_evt_enc_change_view {
+    uint8_t status;
+    uint8_t conn_handle[2];
+    uint8_t enabled;
+} __attribute__((packed));
+
+struct ble_hs_hci_evt_key_refresh_view {
+    uint8_t status;
+    uint8_t conn_handle[2];
+} __attribute__((packed));
+
+/* Enhanced connection complete inserts the two RPAs before the params. */
+struct ble_hs_hci_evt_le_conn_view {
+    uint8_t subevent;
+    uint8_t status;
+    uint8_t conn_handle[2];
+    uint8_t role;
+    uint8_t peer_addr_type;
+    uint8_t peer_addr[BLE_DEV_ADDR_LEN];
+} __attribute__((packed));
+
+struct ble_hs_hci_evt_le_conn_rpa_view {
+    uint8_t local_rpa[BLE_DEV_ADDR_LEN];
+    uint8_t peer_rpa[BLE_DEV_ADDR_LEN];
+} __attribute__((packed));
+
+struct ble_hs_hci_evt_le_conn_params_view {
+    uint8_t itvl[2];
+    uint8_t latency[2];
+    uint8_t spvn_tmo[2];
+    uint8_t master_clk_acc;
+} __attribute__((packed));
+
+struct ble_hs_hci_evt_le_conn_upd_view {
+    uint8_t subevent;
+    uint8_t status;
+    uint8_t conn_handle[2];
+    uint8_t itvl[2];
+    uint8_t latency[2];
+    uint8_t spvn_tmo[2];
+} __attribute__((packed));
+
+struct ble_hs_hci_evt_le_ltk_req_view {
+    uint8_t subevent;
+    uint8_t conn_handle[2];
+    uint8_t rand[8];
+    uint8_t ediv[2];
+} __attribute__((packed));
 
-    for (i = 0; i < BLE_HS_HCI_EVT_DISPATCH_SZ; i++) {
-        entry = ble_hs_hci_evt_dispatch + i;
-        if (entry->event_code == event_code) {
-            return entry;
-        }
-    }
+struct ble_hs_hci_evt_le_param_req_view {
+    uint8_t subevent;
+    uint8_t conn_handle[2];
+    uint8_t itvl_min[2];
+    uint8_t itvl_max[2];
+    uint8_t latency[2];
+    uint8_t timeout[2];
+} __attribute__((packed));
 
-    return NULL;
-}
+/**
+ * The event buffer currently being processed; NULL once it has been
+ * released.
+ */
+static uint8_t *ble_hs_hci_evt_buf;
 
-static const struct ble_hs_hci_evt_le_dispatch_entry *
-ble_hs_hci_evt_le_dispatch_find(uint8_t event_code)
+/**
+ * Frees the event buffer being processed.  Handlers call this as soon as
+ * they have read everything they need from the event, so that the buffer
+ * is back in the transport's pool before GAP and the application get to
+ * run.  Otherwise, the buffer is freed when the handler returns.
+ */
+static void
+ble_hs_hci_evt_release(void)
 {
-    const struct ble_hs_hci_evt_le_dispatch_entry *entry;
-    int i;
-
-    for (i = 0; i < BLE_HS_HCI_EVT_LE_DISPATCH_SZ; i++) {
-        entry = ble_hs_hci_evt_le_dispatch + i;
-        if (entry->subevent == event_code) {
-            return entry;
-        }
+    if (ble_hs_hci_evt_buf != NULL) {
+        ble_hci_trans_buf_free(ble_hs_hci_evt_buf);
+        ble_hs_hci_evt_buf = NULL;
     }
-
-    return NULL;
 }
 
 static int
 ble_hs_hci_evt_disconn_complete(uint8_t event_code, uint8_t *data, int len)
 {
+    const struct ble_hs_hci_evt_disconn_view *v;
     struct hci_disconn_complete evt;
 
     if (len < BLE_HCI_EVENT_DISCONN_COMPLETE_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    evt.status = data[2];
-    evt.connection_handle = le16toh(data + 3);
-    evt.reason = data[5];
+    v = (const void *)data;
+    evt.status = v->status;
+    evt.connection_handle = le16toh(v->conn_handle);
+    evt.reason = v->reason;
+    ble_hs_hci_evt_release();
 
     ble_gap_rx_disconn_complete(&evt);
 
@@ -150,15 +206,18 @@ ble_hs_hci_evt_disconn_complete(uint8_t event_code, uint8_t *data, int len)
 static int
 ble_hs_hci_evt_encrypt_change(uint8_t event_code, uint8_t *data, int len)
 {
+    const struct ble_hs_hci_evt_enc_change_view *v;
     struct hci_encrypt_change evt;
 
     if (len < BLE_HCI_EVENT_ENCRYPT_CHG_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    evt.status = data[2];
-    evt.connection_handle = le16toh(data + 3);
-    evt.encryption_enabled = data[5];
+    v = (const void *)data;
+    evt.status = v->status;
+    evt.connection_handle = le16toh(v->conn_handle);
+    evt.encryption_enabled = v->enabled;
+    ble_hs_hci_evt_release();
 
     ble_sm_enc_change_rx(&evt);
 
@@ -175,6 +234,8 @@ ble_hs_hci_evt_hw_error(uint8_t event_code, uint8_t *data, int len)
     }
 
     hw_code = data[0];
+    ble_hs_hci_evt_release();
+
     ble_hs_hw_error(hw_code);
 
     return 0;
@@ -183,14 +244,17 @@ ble_hs_hci_evt_hw_error(uint8_t event_code, uint8_t *data, int len)
 static int
 ble_hs_hci_evt_enc_key_refresh(uint8_t event_code, uint8_t *data, int len)
 {
+    const struct ble_hs_hci_evt_key_refresh_view *v;
     struct hci_encrypt_key_refresh evt;
 
     if (len < BLE_HCI_EVENT_ENC_KEY_REFRESH_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    evt.status = data[2];
-    evt.connection_handle = le16toh(data + 3);
+    v = (const void *)data;
+    evt.status = v->status;
+    evt.connection_handle = le16toh(v->conn_handle);
+    ble_hs_hci_evt_release();
 
     ble_sm_enc_key_refresh_rx(&evt);
 
@@ -200,65 +264,71 @@ ble_hs_hci_evt_enc_key_refresh(uint8_t event_code, uint8_t *data, int len)
 static int
 ble_hs_hci_evt_num_completed_pkts(uint8_t event_code, uint8_t *data, int len)
 {
+    struct ble_hs_conn *conn;
     uint16_t num_pkts;
     uint16_t handle;
     uint8_t num_handles;
     int off;
     int i;
 
-    if (len < BLE_HCI_EVENT_HDR_LEN + BLE_HCI_EVENT_NUM_COMP_PKTS_HDR_LEN) {
+    if (len < BLE_HCI_EVENT_NUM_COMP_PKTS_HDR_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    off = BLE_HCI_EVENT_HDR_LEN;
-    num_handles = data[off];
+    num_handles = data[0];
     if (len < BLE_HCI_EVENT_NUM_COMP_PKTS_HDR_LEN +
               num_handles * BLE_HCI_EVENT_NUM_COMP_PKTS_ENT_LEN) {
         return BLE_HS_ECONTROLLER;
     }
-    off++;
+    off = BLE_HCI_EVENT_NUM_COMP_PKTS_HDR_LEN;
+
+    ble_hs_lock();
 
     for (i = 0; i < num_handles; i++) {
         handle = le16toh(data + off + 2 * i);
         num_pkts = le16toh(data + off + 2 * num_handles + 2 * i);
 
-        /* XXX: Do something with these values. */
-        (void)handle;
-        (void)num_pkts;
+        conn = ble_hs_conn_find(handle);
+        if (conn != NULL) {
+            ble_hs_hci_acl_tx_done(conn, num_pkts);
+        }
     }
 
+    ble_hs_unlock();
+
     return 0;
 }
 
 static int
 ble_hs_hci_evt_le_meta(uint8_t event_code, uint8_t *data, int len)
 {
-    const struct ble_hs_hci_evt_le_dispatch_entry *entry;
+    ble_hs_hci_evt_le_fn *cb;
     uint8_t subevent;
-    int rc;
 
-    if (len < BLE_HCI_EVENT_HDR_LEN + BLE_HCI_LE_MIN_LEN) {
+    if (len < BLE_HCI_LE_MIN_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    subevent = data[2];
-    entry = ble_hs_hci_evt_le_dispatch_find(subevent);
-    if (entry != NULL) {
-        rc = entry->cb(subevent, data + BLE_HCI_EVENT_HDR_LEN,
-                           len - BLE_HCI_EVENT_HDR_LEN);
-        if (rc != 0) {
-            return rc;
-        }
+    subevent = data[0];
+    if (subevent >= BLE_HS_HCI_EVT_LE_DISPATCH_SZ) {
+        return 0;
     }
 
-    return 0;
+    cb = ble_hs_hci_evt_le_dispatch[subevent];
+    if (cb == NULL) {
+        return 0;
+    }
+
+    return cb(subevent, data, len);
 }
 
 static int
 ble_hs_hci_evt_le_conn_complete(uint8_t subevent, uint8_t *data, int len)
 {
+    const struct ble_hs_hci_evt_le_conn_params_view *params;
+    const struct ble_hs_hci_evt_le_conn_rpa_view *rpa;
+    const struct ble_hs_hci_evt_le_conn_view *v;
     struct hci_le_conn_complete evt;
-    int extended_offset = 0;
     int rc;
 
     if (len < BLE_HCI_LE_CONN_COMPLETE_LEN) {
@@ -271,28 +341,32 @@ ble_hs_hci_evt_le_conn_complete(uint8_t subevent, uint8_t *data, int len)
         return BLE_HS_ECONTROLLER;
     }
 
-    evt.subevent_code = data[0];
-    evt.status = data[1];
-    evt.connection_handle = le16toh(data + 2);
-    evt.role = data[4];
-    evt.peer_addr_type = data[5];
-    memcpy(evt.peer_addr, data + 6, BLE_DEV_ADDR_LEN);
+    v = (const void *)data;
+    evt.subevent_code = v->subevent;
+    evt.status = v->status;
+    evt.connection_handle = le16toh(v->conn_handle);
+    evt.role = v->role;
+    evt.peer_addr_type = v->peer_addr_type;
+    memcpy(evt.peer_addr, v->peer_addr, BLE_DEV_ADDR_LEN);
 
     /* enhanced connection event has the same information with these
      * extra fields stuffed into the middle */
     if (subevent == BLE_HCI_LE_SUBEV_ENH_CONN_COMPLETE) {
-        memcpy(evt.local_rpa, data + 12, BLE_DEV_ADDR_LEN);
-        memcpy(evt.peer_rpa, data + 18, BLE_DEV_ADDR_LEN);
-        extended_offset = 12;
+        rpa = (const void *)(v + 1);
+        memcpy(evt.local_rpa, rpa->local_rpa, BLE_DEV_ADDR_LEN);
+        memcpy(evt.peer_rpa, rpa->peer_rpa, BLE_DEV_ADDR_LEN);
+        params = (const void *)(rpa + 1);
     } else {
         memset(evt.local_rpa, 0, BLE_DEV_ADDR_LEN);
         memset(evt.peer_rpa, 0, BLE_DEV_ADDR_LEN);
+        params = (const void *)(v + 1);
     }
 
-    evt.conn_itvl = le16toh(data + 12 + extended_offset);
-    evt.conn_latency = le16toh(data + 14 + extended_offset);
-    evt.supervision_timeout = le16toh(data + 16 + extended_offset);
-    evt.master_clk_acc = data[18 + extended_offset];
+    evt.conn_itvl = le16toh(params->itvl);
+    evt.conn_latency = le16toh(params->latency);
+    evt.supervision_timeout = le16toh(params->spvn_tmo);
+    evt.master_clk_acc = params->master_clk_acc;
+    ble_hs_hci_evt_release();
 
     if (evt.status == 0) {
         if (evt.role != BLE_HCI_LE_CONN_COMPLETE_ROLE_MASTER &&
@@ -472,18 +546,21 @@ ble_hs_hci_evt_le_dir_adv_rpt(uint8_t subevent, uint8_t *data, int len)
 static int
 ble_hs_hci_evt_le_conn_upd_complete(uint8_t subevent, uint8_t *data, int len)
 {
+    const struct ble_hs_hci_evt_le_conn_upd_view *v;
     struct hci_le_conn_upd_complete evt;
 
     if (len < BLE_HCI_LE_CONN_UPD_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    evt.subevent_code = data[0];
-    evt.status = data[1];
-    evt.connection_handle = le16toh(data + 2);
-    evt.conn_itvl = le16toh(data + 4);
-    evt.conn_latency = le16toh(data + 6);
-    evt.supervision_timeout = le16toh(data + 8);
+    v = (const void *)data;
+    evt.subevent_code = v->subevent;
+    evt.status = v->status;
+    evt.connection_handle = le16toh(v->conn_handle);
+    evt.conn_itvl = le16toh(v->itvl);
+    evt.conn_latency = le16toh(v->latency);
+    evt.supervision_timeout = le16toh(v->spvn_tmo);
+    ble_hs_hci_evt_release();
 
     if (evt.status == 0) {
         if (evt.conn_itvl < BLE_HCI_CONN_ITVL_MIN ||
@@ -511,16 +588,19 @@ ble_hs_hci_evt_le_conn_upd_complete(uint8_t subevent, uint8_t *data, int len)
 static int
 ble_hs_hci_evt_le_lt_key_req(uint8_t subevent, uint8_t *data, int len)
 {
+    const struct ble_hs_hci_evt_le_ltk_req_view *v;
     struct hci_le_lt_key_req evt;
 
     if (len < BLE_HCI_LE_LT_KEY_REQ_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    evt.subevent_code = data[0];
-    evt.connection_handle = le16toh(data + 1);
-    evt.random_number = le64toh(data + 3);
-    evt.encrypted_diversifier = le16toh(data + 11);
+    v = (const void *)data;
+    evt.subevent_code = v->subevent;
+    evt.connection_handle = le16toh(v->conn_handle);
+    evt.random_number = le64toh(v->rand);
+    evt.encrypted_diversifier = le16toh(v->ediv);
+    ble_hs_hci_evt_release();
 
     ble_sm_ltk_req_rx(&evt);
 
@@ -530,18 +610,21 @@ ble_hs_hci_evt_le_lt_key_req(uint8_t subevent, uint8_t *data, int len)
 static int
 ble_hs_hci_evt_le_conn_parm_req(uint8_t subevent, uint8_t *data, int len)
 {
+    const struct ble_hs_hci_evt_le_param_req_view *v;
     struct hci_le_conn_param_req evt;
 
     if (len < BLE_HCI_LE_REM_CONN_PARM_REQ_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    evt.subevent_code = data[0];
-    evt.connection_handle = le16toh(data + 1);
-    evt.itvl_min = le16toh(data + 3);
-    evt.itvl_max = le16toh(data + 5);
-    evt.latency = le16toh(data + 7);
-    evt.timeout = le16toh(data + 9);
+    v = (const void *)data;
+    evt.subevent_code = v->subevent;
+    evt.connection_handle = le16toh(v->conn_handle);
+    evt.itvl_min = le16toh(v->itvl_min);
+    evt.itvl_max = le16toh(v->itvl_max);
+    evt.latency = le16toh(v->latency);
+    evt.timeout = le16toh(v->timeout);
+    ble_hs_hci_evt_release();
 
     if (evt.itvl_min < BLE_HCI_CONN_ITVL_MIN ||
         evt.itvl_max > BLE_HCI_CONN_ITVL_MAX ||
@@ -568,10 +651,10 @@ ble_hs_hci_evt_le_conn_parm_req(uint8_t subevent, uint8_t *data, int len)
 int
 ble_hs_hci_evt_process(uint8_t *data)
 {
-    const struct ble_hs_hci_evt_dispatch_entry *entry;
+    ble_hs_hci_evt_fn *cb;
+    uint8_t *prev_buf;
     uint8_t event_code;
     uint8_t param_len;
-    int event_len;
     int rc;
 
     /* Count events received */
@@ -584,17 +667,26 @@ ble_hs_hci_evt_process(uint8_t *data)
     event_code = data[0];
     param_len = data[1];
 
-    event_len = param_len + 2;
+    if (event_code < BLE_HS_HCI_EVT_DISPATCH_SZ) {
+        cb = ble_hs_hci_evt_dispatch[event_code];
+    } else {
+        cb = NULL;
+    }
 
-    entry = ble_hs_hci_evt_dispatch_find(event_code);
-    if (entry == NULL) {
+    if (cb == NULL) {
         STATS_INC(ble_hs_stats, hci_unknown_event);
-        rc = BLE_HS_ENOTSUP;
-    } else {
-        rc = entry->cb(event_code, data, event_len);
+        ble_hci_trans_buf_free(data);
+        return BLE_HS_ENOTSUP;
     }
 
-    ble_hci_trans_buf_free(data);
+    /* Handlers may release the buffer early; free it here if they don't. */
+    prev_buf = ble_hs_hci_evt_buf;
+    ble_hs_hci_evt_buf = data;
+
+    rc = cb(event_code, data + BLE_HCI_EVENT_HDR_LEN, param_len);
+
+    ble_hs_hci_evt_release();
+    ble_hs_hci_evt_buf = prev_buf;
 
     return rc;
 }
@@ -615,6 +707,7 @@ ble_hs_hci_evt_acl_process(struct os_mbuf *om)
     struct ble_hs_conn *conn;
     ble_l2cap_rx_fn *rx_cb;
     struct os_mbuf *rx_buf;
+    uint16_t rx_cid;
     uint16_t handle;
     int rc;
 
@@ -646,7 +739,8 @@ ble_hs_hci_evt_acl_process(struct os_mbuf *om)
     if (conn == NULL) {
         rc = BLE_HS_ENOTCONN;
     } else {
-        rc = ble_l2cap_rx(conn, &hci_hdr, om, &rx_cb, &rx_buf);
+        conn->bhc_tune_bytes += hci_hdr.hdh_len;
+        rc = ble_l2cap_rx(conn, &hci_hdr, om, &rx_cb, &rx_cid, &rx_buf);
         om = NULL;
     }
 
@@ -657,7 +751,7 @@ ble_hs_hci_evt_acl_process(struct os_mbuf *om)
         /* Final fragment received. */
         BLE_HS_DBG_ASSERT(rx_cb != NULL);
         BLE_HS_DBG_ASSERT(rx_buf != NULL);
-        rc = rx_cb(handle, &rx_buf);
+        rc = rx_cb(handle, rx_cid, &rx_buf);
         os_mbuf_free_chain(rx_buf);
         break;
 
@@ -32,8 +32,24 @@ struct ble_hs_hci_ack {
     uint8_t bha_hci_handle;
 };
 
+/** Maximum number of HCI commands the host keeps in flight at once. */
+#define BLE_HS_HCI_MAX_PIPELINE     4
+
+/**
+ * One command in a batch passed to ble_hs_hci_cmd_tx_batch().
+ */
+struct ble_hs_hci_batch_cmd {
+    void *bhc_cmd;              /* Command built by ble_hs_hci_cmd_build_*. */
+    void *bhc_evt_buf;          /* Receives ack parameters; may be NULL. */
+    uint8_t bhc_evt_buf_len;
+    uint8_t bhc_evt_len;        /* Out: length of received ack parameters. */
+    uint8_t bhc_acked;          /* Out: set once the ack has been received. */
+    int bhc_status;             /* Out: BLE_HS_E<...> result of command. */
+};
+
 int ble_hs_hci_cmd_tx(void *cmd, void *evt_buf, uint8_t evt_buf_len,
                       uint8_t *out_evt_buf_len);
+int ble_hs_hci_cmd_tx_batch(struct ble_hs_hci_batch_cmd *cmds, int num_cmds);
 int ble_hs_hci_cmd_tx_empty_ack(void *cmd);
 void ble_hs_hci_rx_ack(uint8_t *ack_ev);
 void ble_hs_hci_init(void);
@@ -130,6 +146,8 @@ uint16_t ble_hs_hci_util_handle_pb_bc_join(uint16_t handle, uint8_t pb,
                                            uint8_t bc);
 
 int ble_hs_hci_acl_tx(struct ble_hs_conn *connection, struct os_mbuf *txom);
+void ble_hs_hci_acl_tx_done(struct ble_hs_conn *conn, uint16_t num_pkts);
+void ble_hs_hci_acl_tx_flush(struct ble_hs_conn *conn);
 
 int ble_hs_hci_cmd_build_set_data_len(uint16_t connection_handle,
                                       uint16_t tx_octets, uint16_t tx_time,
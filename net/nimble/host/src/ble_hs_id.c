@@ -50,7 +50,7 @@ ble_hs_id_gen_rnd(int nrpa, uint8_t *out_addr)
 {
     int rc;
 
-    rc = ble_hs_hci_util_rand(out_addr, 6);
+    rc = ble_hs_rand(out_addr, 6);
     if (rc != 0) {
         return rc;
     }
@@ -196,3 +196,20 @@ ble_hs_mbuf_pullup_base(struct os_mbuf **om, int base_len)
 
     return 0;
 }
+
+/**
+ * Counts the mbufs in a chain; i.e., the number of pool blocks it holds.
+ */
+int
+ble_hs_mbuf_count(const struct os_mbuf *om)
+{
+    int count;
+
+    count = 0;
+    while (om != NULL) {
+        count++;
+        om = SLIST_NEXT(om, om_next);
+    }
+
+    return count;
+}
@@ -0,0 +1,160 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <string.h>
+#include "os/os.h"
+#include "ble_hs_priv.h"
+
+/**
+ * Every host module that preallocates memory according to the ble_hs_cfg
+ * counts, in initialization order.
+ */
+static ble_hs_mem_pool_fn * const ble_hs_mem_pool_fns[] = {
+    ble_hs_hci_ev_mem_pool,
+    ble_hs_conn_mem_pool,
+    ble_l2cap_chan_mem_pool,
+    ble_l2cap_sig_mem_pool,
+    ble_l2cap_coc_mem_pool,
+#if NIMBLE_OPT(SM)
+    ble_sm_mem_pool,
+#endif
+#if NIMBLE_OPT(SM_SC)
+    ble_sm_sc_mem_pool,
+#endif
+    ble_gattc_mem_pool,
+    ble_att_svr_mem_pool,
+    ble_gatts_mem_pool,
+};
+
+#define BLE_HS_MEM_NUM_FNS \
+    (sizeof ble_hs_mem_pool_fns / sizeof ble_hs_mem_pool_fns[0])
+
+void
+ble_hs_mem_pool_fill(struct ble_hs_mem_pool *out_pool, const char *name,
+                     int num_elems, int elem_size,
+                     const struct os_mempool *live_pool)
+{
+    memset(out_pool, 0, sizeof *out_pool);
+
+    out_pool->name = name;
+    out_pool->elem_size = elem_size;
+    out_pool->num_elems = num_elems;
+    if (num_elems > 0) {
+        out_pool->bytes = OS_MEMPOOL_BYTES(num_elems, elem_size);
+    }
+
+    /* A pool that was never initialized has no blocks. */
+    if (live_pool != NULL && live_pool->mp_num_blocks > 0) {
+        out_pool->max_used = live_pool->mp_num_blocks - live_pool->mp_min_free;
+        out_pool->num_fail = live_pool->mp_num_fail;
+    }
+}
+
+/**
+ * Describes one of the host's preallocated resources.  Iterate idx from 0
+ * until BLE_HS_ENOENT is returned to enumerate all of them.
+ *
+ * @param cfg                   The configuration to compute sizes for.  Specify
+ *                                  null for the running host; the report then
+ *                                  includes runtime usage statistics.
+ * @param idx                   The index of the resource to describe.
+ * @param out_pool              On success, the resource description gets
+ *                                  written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if idx is out of range.
+ */
+int
+ble_hs_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                struct ble_hs_mem_pool *out_pool)
+{
+    int rc;
+    int i;
+    int j;
+
+    for (i = 0; i < BLE_HS_MEM_NUM_FNS; i++) {
+        for (j = 0; ; j++) {
+            rc = ble_hs_mem_pool_fns[i](cfg, j, out_pool);
+            if (rc != 0) {
+                break;
+            }
+
+            if (idx == 0) {
+                return 0;
+            }
+            idx--;
+        }
+    }
+
+    return BLE_HS_ENOENT;
+}
+
+/**
+ * Calculates the total RAM the host preallocates for the specified
+ * configuration.
+ *
+ * @param cfg                   The configuration to compute the total for.
+ *                                  Specify null for the running host.
+ *
+ * @return                      The number of bytes.
+ */
+uint32_t
+ble_hs_mem_total(const struct ble_hs_cfg *cfg)
+{
+    struct ble_hs_mem_pool pool;
+    uint32_t total;
+    int idx;
+
+    total = 0;
+    for (idx = 0; ble_hs_mem_pool(cfg, idx, &pool) == 0; idx++) {
+        total += pool.bytes;
+    }
+
+    return total;
+}
+
+/**
+ * Logs the RAM used by each of the host's preallocated resources.  For the
+ * running host (null cfg), the most elements ever in use and the number of
+ * failed allocations are logged as well; a resource whose high-water mark
+ * stays well below its count can be trimmed.
+ *
+ * @param cfg                   The configuration to report on.  Specify null
+ *                                  for the running host.
+ */
+void
+ble_hs_mem_report(const struct ble_hs_cfg *cfg)
+{
+    struct ble_hs_mem_pool pool;
+    int idx;
+
+    for (idx = 0; ble_hs_mem_pool(cfg, idx, &pool) == 0; idx++) {
+        BLE_HS_LOG(INFO, "%s: %d * %d = %lu bytes", pool.name,
+                   pool.num_elems, pool.elem_size, (unsigned long)pool.bytes);
+        if (cfg == NULL) {
+            BLE_HS_LOG(INFO, "; max_used=%d num_fail=%lu", pool.max_used,
+                       (unsigned long)pool.num_fail);
+        }
+        BLE_HS_LOG(INFO, "\n");
+    }
+
+    BLE_HS_LOG(INFO, "total: %lu bytes\n",
+               (unsigned long)ble_hs_mem_total(cfg));
+}
@@ -35,6 +35,7 @@
 #include "ble_hs_mbuf_priv.h"
 #include "ble_hs_startup_priv.h"
 #include "ble_l2cap_priv.h"
+#include "ble_l2cap_coc_priv.h"
 #include "ble_l2cap_sig_priv.h"
 #include "ble_sm_priv.h"
 #include "ble_hs_adv_priv.h"
@@ -53,6 +54,8 @@ struct os_event;
 #define BLE_HOST_HCI_EVENT_CTLR_EVENT   (OS_EVENT_T_PERUSER + 0)
 #define BLE_HS_EVENT_TX_NOTIFICATIONS   (OS_EVENT_T_PERUSER + 1)
 #define BLE_HS_EVENT_RESET              (OS_EVENT_T_PERUSER + 2)
+#define BLE_HS_EVENT_SM_SC_DONE         (OS_EVENT_T_PERUSER + 3)
+#define BLE_HS_EVENT_GATTC_CACHE        (OS_EVENT_T_PERUSER + 4)
 
 #define BLE_HS_SYNC_STATE_BAD           0
 #define BLE_HS_SYNC_STATE_BRINGUP       1
@@ -68,6 +71,9 @@ STATS_SECT_START(ble_hs_stats)
     STATS_SECT_ENTRY(hci_timeout)
     STATS_SECT_ENTRY(reset)
     STATS_SECT_ENTRY(sync)
+    STATS_SECT_ENTRY(acl_tx_fail)
+    STATS_SECT_ENTRY(conn_tx_quota)
+    STATS_SECT_ENTRY(conn_rx_quota)
 STATS_SECT_END
 extern STATS_SECT_DECL(ble_hs_stats) ble_hs_stats;
 
@@ -98,6 +104,19 @@ uint8_t ble_hs_misc_addr_type_to_id(uint8_t addr_type);
 
 void ble_hs_cfg_init(struct ble_hs_cfg *cfg);
 
+/**
+ * Describes the idx'th preallocated resource of a host module.  If cfg is
+ * NULL, the running host's configuration is used and runtime statistics are
+ * included.  Returns BLE_HS_ENOENT if idx is past the module's last resource.
+ */
+typedef int ble_hs_mem_pool_fn(const struct ble_hs_cfg *cfg, int idx,
+                               struct ble_hs_mem_pool *out_pool);
+void ble_hs_mem_pool_fill(struct ble_hs_mem_pool *out_pool, const char *name,
+                          int num_elems, int elem_size,
+                          const struct os_mempool *live_pool);
+int ble_hs_hci_ev_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                           struct ble_hs_mem_pool *out_pool);
+
 int ble_hs_locked_by_cur_task(void);
 int ble_hs_is_parent_task(void);
 void ble_hs_lock(void);
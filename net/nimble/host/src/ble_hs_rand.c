@@ -0,0 +1,121 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "tinycrypt/constants.h"
+#include "tinycrypt/hmac_prng.h"
+#include "ble_hs_priv.h"
+
+/** Fresh entropy is requested from the controller after this many uses. */
+#define BLE_HS_RAND_RESEED_GENS     64
+
+/** Number of bytes of entropy used for each (re)seed. */
+#define BLE_HS_RAND_SEED_LEN        32
+
+static const uint8_t ble_hs_rand_pers[] = "nimble host";
+
+static struct tc_hmac_prng_struct ble_hs_rand_prng;
+static uint8_t ble_hs_rand_seeded;
+static uint8_t ble_hs_rand_gens;
+
+/**
+ * Mixes entropy from the controller into the generator.  The controller is
+ * queried with LE Rand commands, so this must be called without the host
+ * lock held.
+ */
+static int
+ble_hs_rand_reseed(void)
+{
+    uint8_t seed[BLE_HS_RAND_SEED_LEN];
+    int rc;
+
+    rc = ble_hs_hci_util_rand(seed, sizeof seed);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_hs_lock();
+
+    if (!ble_hs_rand_seeded) {
+        tc_hmac_prng_init(&ble_hs_rand_prng, ble_hs_rand_pers,
+                          sizeof ble_hs_rand_pers);
+    }
+    rc = tc_hmac_prng_reseed(&ble_hs_rand_prng, seed, sizeof seed, NULL, 0);
+    if (rc == TC_CRYPTO_SUCCESS) {
+        ble_hs_rand_seeded = 1;
+        ble_hs_rand_gens = 0;
+        rc = 0;
+    } else {
+        rc = BLE_HS_EUNKNOWN;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Fills the specified buffer with cryptographically secure random data.
+ * Data comes from an HMAC-DRBG which is seeded and periodically reseeded
+ * with entropy from the controller, so a request does not cost an HCI
+ * command per eight bytes.
+ *
+ * @param dst                   The buffer to fill.
+ * @param len                   The number of bytes to write.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ECONTROLLER or other BLE host core
+ *                                  return code if the controller could not
+ *                                  supply entropy.
+ */
+int
+ble_hs_rand(void *dst, int len)
+{
+    int rc;
+
+    while (1) {
+        ble_hs_lock();
+
+        if (ble_hs_rand_seeded &&
+            ble_hs_rand_gens < BLE_HS_RAND_RESEED_GENS) {
+
+            rc = tc_hmac_prng_generate(dst, len, &ble_hs_rand_prng);
+            ble_hs_rand_gens++;
+        } else {
+            rc = TC_HMAC_PRNG_RESEED_REQ;
+        }
+
+        ble_hs_unlock();
+
+        switch (rc) {
+        case TC_CRYPTO_SUCCESS:
+            return 0;
+
+        case TC_HMAC_PRNG_RESEED_REQ:
+            rc = ble_hs_rand_reseed();
+            if (rc != 0) {
+                return rc;
+            }
+            break;
+
+        default:
+            return BLE_HS_EUNKNOWN;
+        }
+    }
+}
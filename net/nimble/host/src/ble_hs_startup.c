@@ -23,20 +23,9 @@
 #include "ble_hs_priv.h"
 
 static int
-ble_hs_startup_le_read_sup_f_tx(void)
+ble_hs_startup_le_read_sup_f_rsp(const uint8_t *ack_params,
+                                 uint8_t ack_params_len)
 {
-    uint8_t ack_params[BLE_HCI_RD_LOC_SUPP_FEAT_RSPLEN];
-    uint8_t buf[BLE_HCI_CMD_HDR_LEN];
-    uint8_t ack_params_len;
-    int rc;
-
-    ble_hs_hci_cmd_build_le_read_loc_supp_feat(buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx(buf, ack_params, sizeof ack_params,
-                           &ack_params_len);
-    if (rc != 0) {
-        return rc;
-    }
-
     if (ack_params_len != BLE_HCI_RD_LOC_SUPP_FEAT_RSPLEN) {
         return BLE_HS_ECONTROLLER;
     }
@@ -47,22 +36,13 @@ ble_hs_startup_le_read_sup_f_tx(void)
 }
 
 static int
-ble_hs_startup_le_read_buf_sz_tx(void)
+ble_hs_startup_le_read_buf_sz_rsp(const uint8_t *ack_params,
+                                  uint8_t ack_params_len)
 {
     uint16_t pktlen;
-    uint8_t ack_params[BLE_HCI_RD_BUF_SIZE_RSPLEN];
-    uint8_t buf[BLE_HCI_CMD_HDR_LEN];
-    uint8_t ack_params_len;
     uint8_t max_pkts;
     int rc;
 
-    ble_hs_hci_cmd_build_le_read_buffer_size(buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx(buf, ack_params, sizeof ack_params,
-                           &ack_params_len);
-    if (rc != 0) {
-        return rc;
-    }
-
     if (ack_params_len != BLE_HCI_RD_BUF_SIZE_RSPLEN) {
         return BLE_HS_ECONTROLLER;
     }
@@ -79,21 +59,10 @@ ble_hs_startup_le_read_buf_sz_tx(void)
 }
 
 static int
-ble_hs_startup_read_bd_addr(void)
+ble_hs_startup_read_bd_addr_rsp(const uint8_t *ack_params,
+                                uint8_t ack_params_len)
 {
-    uint8_t ack_params[BLE_HCI_IP_RD_BD_ADDR_ACK_PARAM_LEN];
-    uint8_t buf[BLE_HCI_CMD_HDR_LEN];
-    uint8_t ack_params_len;
-    int rc;
-
-    ble_hs_hci_cmd_build_read_bd_addr(buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx(buf, ack_params, sizeof ack_params,
-                           &ack_params_len);
-    if (rc != 0) {
-        return rc;
-    }
-
-    if (ack_params_len != sizeof ack_params) {
+    if (ack_params_len != BLE_HCI_IP_RD_BD_ADDR_ACK_PARAM_LEN) {
         return BLE_HS_ECONTROLLER;
     }
 
@@ -101,12 +70,9 @@ ble_hs_startup_read_bd_addr(void)
     return 0;
 }
 
-static int
-ble_hs_startup_le_set_evmask_tx(void)
+static void
+ble_hs_startup_le_set_evmask_build(uint8_t *buf, int buf_len)
 {
-    uint8_t buf[BLE_HCI_CMD_HDR_LEN + BLE_HCI_SET_LE_EVENT_MASK_LEN];
-    int rc;
-
     /**
      * Enable the following LE events:
      *     0x0000000000000001 LE Connection Complete Event
@@ -119,21 +85,12 @@ ble_hs_startup_le_set_evmask_tx(void)
      *     0x0000000000000200 LE Enhanced Connection Complete Event
      */
     ble_hs_hci_cmd_build_le_set_event_mask(0x000000000000027f,
-                                           buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx_empty_ack(buf);
-    if (rc != 0) {
-        return rc;
-    }
-
-    return 0;
+                                           buf, buf_len);
 }
 
-static int
-ble_hs_startup_set_evmask_tx(void)
+static void
+ble_hs_startup_set_evmask_build(uint8_t *buf, uint8_t *buf2, int buf_len)
 {
-    uint8_t buf[BLE_HCI_CMD_HDR_LEN + BLE_HCI_SET_EVENT_MASK_LEN];
-    int rc;
-
     /**
      * Enable the following events:
      *     0x0000000000000001 Inquiry Complete Event
@@ -176,23 +133,13 @@ ble_hs_startup_set_evmask_tx(void)
      *     0x0000800000000000 Encryption Key Refresh Complete Event
      *     0x2000000000000000 LE Meta-Event
      */
-    ble_hs_hci_cmd_build_set_event_mask(0x20009fffffffffff, buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx_empty_ack(buf);
-    if (rc != 0) {
-        return rc;
-    }
+    ble_hs_hci_cmd_build_set_event_mask(0x20009fffffffffff, buf, buf_len);
 
     /**
      * Enable the following events:
      *     0x0000000000800000 Authenticated Payload Timeout Event
      */
-    ble_hs_hci_cmd_build_set_event_mask2(0x0000000000800000, buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx_empty_ack(buf);
-    if (rc != 0) {
-        return rc;
-    }
-
-    return 0;
+    ble_hs_hci_cmd_build_set_event_mask2(0x0000000000800000, buf2, buf_len);
 }
 
 static int
@@ -210,9 +157,28 @@ ble_hs_startup_reset_tx(void)
     return 0;
 }
 
+static void
+ble_hs_startup_batch_set(struct ble_hs_hci_batch_cmd *cmd, void *buf,
+                         void *evt_buf, uint8_t evt_buf_len)
+{
+    cmd->bhc_cmd = buf;
+    cmd->bhc_evt_buf = evt_buf;
+    cmd->bhc_evt_buf_len = evt_buf_len;
+}
+
 int
 ble_hs_startup_go(void)
 {
+    uint8_t evmask[BLE_HCI_CMD_HDR_LEN + BLE_HCI_SET_EVENT_MASK_LEN];
+    uint8_t evmask2[BLE_HCI_CMD_HDR_LEN + BLE_HCI_SET_EVENT_MASK_LEN];
+    uint8_t le_evmask[BLE_HCI_CMD_HDR_LEN + BLE_HCI_SET_LE_EVENT_MASK_LEN];
+    uint8_t read_buf_sz[BLE_HCI_CMD_HDR_LEN];
+    uint8_t read_sup_f[BLE_HCI_CMD_HDR_LEN];
+    uint8_t read_bd_addr[BLE_HCI_CMD_HDR_LEN];
+    uint8_t buf_sz_rsp[BLE_HCI_RD_BUF_SIZE_RSPLEN];
+    uint8_t sup_f_rsp[BLE_HCI_RD_LOC_SUPP_FEAT_RSPLEN];
+    uint8_t bd_addr_rsp[BLE_HCI_IP_RD_BD_ADDR_ACK_PARAM_LEN];
+    struct ble_hs_hci_batch_cmd cmds[6];
     int rc;
 
     rc = ble_hs_startup_reset_tx();
@@ -222,30 +188,41 @@ ble_hs_startup_go(void)
 
     /* XXX: Read local supported commands. */
     /* XXX: Read local supported features. */
+    /* XXX: Read buffer size. */
 
-    rc = ble_hs_startup_set_evmask_tx();
-    if (rc != 0) {
-        return rc;
-    }
-
-    rc = ble_hs_startup_le_set_evmask_tx();
+    /* The rest of the sequence is independent; pipeline it. */
+    ble_hs_startup_set_evmask_build(evmask, evmask2, sizeof evmask);
+    ble_hs_startup_le_set_evmask_build(le_evmask, sizeof le_evmask);
+    ble_hs_hci_cmd_build_le_read_buffer_size(read_buf_sz, sizeof read_buf_sz);
+    ble_hs_hci_cmd_build_le_read_loc_supp_feat(read_sup_f, sizeof read_sup_f);
+    ble_hs_hci_cmd_build_read_bd_addr(read_bd_addr, sizeof read_bd_addr);
+
+    ble_hs_startup_batch_set(cmds + 0, evmask, NULL, 0);
+    ble_hs_startup_batch_set(cmds + 1, evmask2, NULL, 0);
+    ble_hs_startup_batch_set(cmds + 2, le_evmask, NULL, 0);
+    ble_hs_startup_batch_set(cmds + 3, read_buf_sz,
+                             buf_sz_rsp, sizeof buf_sz_rsp);
+    ble_hs_startup_batch_set(cmds + 4, read_sup_f,
+                             sup_f_rsp, sizeof sup_f_rsp);
+    ble_hs_startup_batch_set(cmds + 5, read_bd_addr,
+                             bd_addr_rsp, sizeof bd_addr_rsp);
+
+    rc = ble_hs_hci_cmd_tx_batch(cmds, sizeof cmds / sizeof cmds[0]);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_hs_startup_le_read_buf_sz_tx();
+    rc = ble_hs_startup_le_read_buf_sz_rsp(buf_sz_rsp, cmds[3].bhc_evt_len);
     if (rc != 0) {
         return rc;
     }
 
-    /* XXX: Read buffer size. */
-
-    rc = ble_hs_startup_le_read_sup_f_tx();
+    rc = ble_hs_startup_le_read_sup_f_rsp(sup_f_rsp, cmds[4].bhc_evt_len);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_hs_startup_read_bd_addr();
+    rc = ble_hs_startup_read_bd_addr_rsp(bd_addr_rsp, cmds[5].bhc_evt_len);
     if (rc != 0) {
         return rc;
     }
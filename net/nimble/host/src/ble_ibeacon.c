@@ -74,3 +74,38 @@ ble_ibeacon_set_adv_data(void *uuid128, uint16_t major, uint16_t minor)
     rc = ble_gap_adv_set_fields(&fields);
     return rc;
 }
+
+/**
+ * Updates the major and minor numbers of the iBeacon configured with
+ * ble_ibeacon_set_adv_data().  Only the four affected bytes are rewritten;
+ * if advertising is in progress, it continues with the new values.
+ *
+ * @param major                 The new major version number.
+ * @param minor                 The new minor version number.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if no iBeacon is configured;
+ *                              Other nonzero on failure.
+ */
+int
+ble_ibeacon_update_adv_data(uint16_t major, uint16_t minor)
+{
+    uint8_t buf[4];
+    uint8_t len;
+    uint8_t off;
+    int rc;
+
+    rc = ble_gap_adv_find_field(BLE_HS_ADV_TYPE_MFG_DATA, &off, &len);
+    if (rc != 0) {
+        return rc;
+    }
+    if (len != BLE_IBEACON_MFG_DATA_SIZE) {
+        return BLE_HS_ENOENT;
+    }
+
+    htobe16(buf + 0, major);
+    htobe16(buf + 2, minor);
+
+    rc = ble_gap_adv_patch_data(off + 20, buf, sizeof buf);
+    return rc;
+}
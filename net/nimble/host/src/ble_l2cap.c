@@ -65,12 +65,21 @@ ble_l2cap_chan_alloc(void)
 void
 ble_l2cap_chan_free(struct ble_l2cap_chan *chan)
 {
+    struct os_mbuf_pkthdr *omp;
     int rc;
 
     if (chan == NULL) {
         return;
     }
 
+    if (chan->blc_flags & BLE_L2CAP_CHAN_F_COC) {
+        os_mbuf_free_chain(chan->blc_rx_sdu);
+        while ((omp = STAILQ_FIRST(&chan->blc_tx_sdus)) != NULL) {
+            STAILQ_REMOVE_HEAD(&chan->blc_tx_sdus, omp_next);
+            os_mbuf_free_chain(OS_MBUF_PKTHDR_TO_MBUF(omp));
+        }
+    }
+
     rc = os_memblock_put(&ble_l2cap_chan_pool, chan);
     BLE_HS_DBG_ASSERT_EVAL(rc == 0);
 
@@ -151,15 +160,32 @@ ble_l2cap_discard_rx(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan)
 static int
 ble_l2cap_rx_payload(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan,
                      struct os_mbuf *om,
-                     ble_l2cap_rx_fn **out_rx_cb, struct os_mbuf **out_rx_buf)
+                     ble_l2cap_rx_fn **out_rx_cb, uint16_t *out_rx_cid,
+                     struct os_mbuf **out_rx_buf)
 {
     int len_diff;
     int rc;
 
     if (chan->blc_rx_buf == NULL) {
         chan->blc_rx_buf = om;
-    } else {
+        conn->bhc_rx_mbufs = ble_hs_mbuf_count(om);
+    } else if (ble_hs_cfg.max_conn_rx_mbufs == 0) {
         os_mbuf_concat(chan->blc_rx_buf, om);
+    } else {
+        /* Copy the fragment into the end of the packet rather than chaining
+         * its mostly empty mbufs, so that the packet occupies as few mbufs as
+         * its length allows.
+         */
+        rc = os_mbuf_appendfrom(chan->blc_rx_buf, om, 0, OS_MBUF_PKTLEN(om));
+        os_mbuf_free_chain(om);
+        conn->bhc_rx_mbufs = ble_hs_mbuf_count(chan->blc_rx_buf);
+        if (rc != 0 ||
+            conn->bhc_rx_mbufs > ble_hs_cfg.max_conn_rx_mbufs) {
+
+            STATS_INC(ble_hs_stats, conn_rx_quota);
+            ble_l2cap_discard_rx(conn, chan);
+            return BLE_HS_ENOMEM;
+        }
     }
 
     /* Determine if packet is fully reassembled. */
@@ -171,6 +197,7 @@ ble_l2cap_rx_payload(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan,
     } else if (len_diff == 0) {
         /* All fragments received. */
         *out_rx_cb = chan->blc_rx_fn;
+        *out_rx_cid = chan->blc_cid;
         *out_rx_buf = chan->blc_rx_buf;
         ble_l2cap_forget_rx(conn, chan);
         rc = 0;
@@ -187,6 +214,7 @@ ble_l2cap_rx(struct ble_hs_conn *conn,
              struct hci_data_hdr *hci_hdr,
              struct os_mbuf *om,
              ble_l2cap_rx_fn **out_rx_cb,
+             uint16_t *out_rx_cid,
              struct os_mbuf **out_rx_buf)
 {
     struct ble_l2cap_chan *chan;
@@ -251,7 +279,8 @@ ble_l2cap_rx(struct ble_hs_conn *conn,
         goto err;
     }
 
-    rc = ble_l2cap_rx_payload(conn, chan, om, out_rx_cb, out_rx_buf);
+    rc = ble_l2cap_rx_payload(conn, chan, om, out_rx_cb, out_rx_cid,
+                              out_rx_buf);
     om = NULL;
     if (rc != 0) {
         goto err;
@@ -299,6 +328,28 @@ ble_l2cap_free_mem(void)
     ble_l2cap_chan_mem = NULL;
 }
 
+int
+ble_l2cap_chan_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                        struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *live_pool;
+
+    if (idx != 0) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        live_pool = &ble_l2cap_chan_pool;
+    } else {
+        live_pool = NULL;
+    }
+
+    ble_hs_mem_pool_fill(out_pool, "ble_l2cap_chan_pool", cfg->max_l2cap_chans,
+                         sizeof (struct ble_l2cap_chan), live_pool);
+    return 0;
+}
+
 int
 ble_l2cap_init(void)
 {
@@ -327,6 +378,11 @@ ble_l2cap_init(void)
         goto err;
     }
 
+    rc = ble_l2cap_coc_init();
+    if (rc != 0) {
+        goto err;
+    }
+
     rc = ble_sm_init();
     if (rc != 0) {
         goto err;
@@ -0,0 +1,700 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * L2CAP LE credit based connection-oriented channels: data path.
+ *
+ * An SDU larger than the peer's MPS is segmented into K-frames; the first
+ * K-frame of each SDU carries the 2-byte SDU length.  Each K-frame costs one
+ * credit.  Frames are sent as long as the peer has granted credits, so a
+ * large SDU streams out back-to-back rather than one frame per round trip.
+ *
+ * On the receive side we grant enough credits for one full SDU up front, and
+ * return the credits an SDU consumed as soon as the application has been
+ * handed that SDU.
+ *
+ * Channel establishment and teardown live in ble_l2cap_sig.c.
+ */
+
+#include <string.h>
+#include "os/os.h"
+#include "nimble/ble.h"
+#include "ble_hs_priv.h"
+
+/** LE PSMs are one byte wide; 0x0001-0x007f are SIG-assigned. */
+#define BLE_L2CAP_COC_PSM_MAX           0x00ff
+
+struct ble_l2cap_coc_srv {
+    STAILQ_ENTRY(ble_l2cap_coc_srv) next;
+    uint16_t psm;
+    uint16_t mtu;
+    ble_l2cap_coc_event_fn *cb;
+    void *cb_arg;
+};
+
+static STAILQ_HEAD(, ble_l2cap_coc_srv) ble_l2cap_coc_srvs;
+
+static void *ble_l2cap_coc_srv_mem;
+static struct os_mempool ble_l2cap_coc_srv_pool;
+
+static ble_l2cap_rx_fn ble_l2cap_coc_rx;
+
+/*****************************************************************************
+ * $misc                                                                     *
+ *****************************************************************************/
+
+static struct ble_l2cap_coc_srv *
+ble_l2cap_coc_srv_find(uint16_t psm)
+{
+    struct ble_l2cap_coc_srv *srv;
+
+    STAILQ_FOREACH(srv, &ble_l2cap_coc_srvs, next) {
+        if (srv->psm == psm) {
+            return srv;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Calculates the number of K-frames required to carry an SDU of the specified
+ * size.
+ */
+static uint16_t
+ble_l2cap_coc_sdu_frames(uint16_t sdu_len, uint16_t mps)
+{
+    return (sdu_len + BLE_L2CAP_COC_SDU_HDR_SZ + mps - 1) / mps;
+}
+
+/**
+ * Selects an unused CID from the dynamic range.  The connection's channel
+ * list is sorted by CID, so the first gap is found in a single pass.
+ *
+ * @return                      The CID on success; 0 if the range is
+ *                                  exhausted.
+ */
+static uint16_t
+ble_l2cap_coc_cid_alloc(struct ble_hs_conn *conn)
+{
+    struct ble_l2cap_chan *chan;
+    uint16_t cid;
+
+    cid = BLE_L2CAP_CID_DYN_MIN;
+    SLIST_FOREACH(chan, &conn->bhc_channels, blc_next) {
+        if (chan->blc_cid == cid) {
+            cid++;
+        } else if (chan->blc_cid > cid) {
+            break;
+        }
+    }
+
+    if (cid > BLE_L2CAP_CID_DYN_MAX) {
+        return 0;
+    }
+
+    return cid;
+}
+
+static int
+ble_l2cap_coc_chan_is_open(const struct ble_l2cap_chan *chan)
+{
+    return chan != NULL &&
+           (chan->blc_flags & BLE_L2CAP_CHAN_F_COC) &&
+           (chan->blc_flags & BLE_L2CAP_CHAN_F_CONNECTED);
+}
+
+void
+ble_l2cap_coc_call_cb(ble_l2cap_coc_event_fn *cb, void *cb_arg,
+                      struct ble_l2cap_coc_event *event)
+{
+    BLE_HS_DBG_ASSERT(!ble_hs_locked_by_cur_task());
+
+    if (cb != NULL) {
+        cb(event, cb_arg);
+    }
+}
+
+/**
+ * Creates an LE credit based channel on the specified connection and inserts
+ * it into the connection's channel list.  The channel is not usable until
+ * ble_l2cap_coc_connected() is called for it.
+ *
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ *
+ * @return                      The new channel on success; null if no
+ *                                  channel or CID is available.
+ */
+struct ble_l2cap_chan *
+ble_l2cap_coc_chan_create(struct ble_hs_conn *conn, uint16_t psm,
+                          uint16_t mtu, ble_l2cap_coc_event_fn *cb,
+                          void *cb_arg)
+{
+    struct ble_l2cap_chan *chan;
+    uint16_t cid;
+    int rc;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    cid = ble_l2cap_coc_cid_alloc(conn);
+    if (cid == 0) {
+        return NULL;
+    }
+
+    chan = ble_l2cap_chan_alloc();
+    if (chan == NULL) {
+        return NULL;
+    }
+
+    chan->blc_cid = cid;
+    chan->blc_flags = BLE_L2CAP_CHAN_F_COC;
+    chan->blc_psm = psm;
+    chan->blc_my_mtu = mtu;
+    chan->blc_default_mtu = mtu;
+    chan->blc_my_mps = min(BLE_L2CAP_COC_MPS, mtu + BLE_L2CAP_COC_SDU_HDR_SZ);
+    chan->blc_rx_credits = ble_l2cap_coc_sdu_frames(mtu, chan->blc_my_mps);
+    STAILQ_INIT(&chan->blc_tx_sdus);
+    chan->blc_rx_fn = ble_l2cap_coc_rx;
+    chan->blc_coc_cb = cb;
+    chan->blc_coc_cb_arg = cb_arg;
+
+    rc = ble_hs_conn_chan_insert(conn, chan);
+    if (rc != 0) {
+        ble_l2cap_chan_free(chan);
+        return NULL;
+    }
+
+    return chan;
+}
+
+/**
+ * Creates a channel for an incoming connection request.
+ *
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ *
+ * @return                      0 on success; a BLE_L2CAP_COC_ERR_[...]
+ *                                  result code on failure.
+ */
+uint16_t
+ble_l2cap_coc_accept(struct ble_hs_conn *conn, uint16_t psm,
+                     struct ble_l2cap_chan **out_chan)
+{
+    struct ble_l2cap_coc_srv *srv;
+    struct ble_l2cap_chan *chan;
+
+    srv = ble_l2cap_coc_srv_find(psm);
+    if (srv == NULL) {
+        return BLE_L2CAP_COC_ERR_NO_PSM;
+    }
+
+    chan = ble_l2cap_coc_chan_create(conn, psm, srv->mtu, srv->cb,
+                                     srv->cb_arg);
+    if (chan == NULL) {
+        return BLE_L2CAP_COC_ERR_NO_RESOURCES;
+    }
+
+    *out_chan = chan;
+    return 0;
+}
+
+/**
+ * Records the peer's channel parameters and opens the channel for data.
+ *
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ */
+void
+ble_l2cap_coc_connected(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan,
+                        uint16_t peer_cid, uint16_t peer_mtu,
+                        uint16_t peer_mps, uint16_t credits)
+{
+    chan->blc_peer_cid = peer_cid;
+    chan->blc_peer_mtu = peer_mtu;
+    chan->blc_peer_mps = peer_mps;
+    chan->blc_tx_credits = credits;
+    chan->blc_flags |= BLE_L2CAP_CHAN_F_CONNECTED;
+}
+
+struct ble_l2cap_chan *
+ble_l2cap_coc_chan_find_peer(struct ble_hs_conn *conn, uint16_t peer_cid)
+{
+    struct ble_l2cap_chan *chan;
+
+    SLIST_FOREACH(chan, &conn->bhc_channels, blc_next) {
+        if (chan->blc_flags & BLE_L2CAP_CHAN_F_COC &&
+            chan->blc_peer_cid == peer_cid) {
+
+            return chan;
+        }
+    }
+
+    return NULL;
+}
+
+struct ble_l2cap_chan *
+ble_l2cap_coc_chan_first(struct ble_hs_conn *conn)
+{
+    struct ble_l2cap_chan *chan;
+
+    SLIST_FOREACH(chan, &conn->bhc_channels, blc_next) {
+        if (chan->blc_flags & BLE_L2CAP_CHAN_F_COC) {
+            return chan;
+        }
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************
+ * $tx                                                                       *
+ *****************************************************************************/
+
+/**
+ * Sends as many K-frames from the channel's SDU queue as the peer's credits
+ * allow.  If an mbuf cannot be allocated, transmission resumes on the next
+ * send or credit grant.
+ *
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ */
+static void
+ble_l2cap_coc_tx_pump(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan)
+{
+    struct os_mbuf_pkthdr *omp;
+    struct os_mbuf *txom;
+    struct os_mbuf *sdu;
+    uint16_t seg_len;
+    uint16_t space;
+    uint8_t hdr[BLE_L2CAP_COC_SDU_HDR_SZ];
+    int rc;
+
+    while (chan->blc_tx_credits > 0) {
+        omp = STAILQ_FIRST(&chan->blc_tx_sdus);
+        if (omp == NULL) {
+            break;
+        }
+        sdu = OS_MBUF_PKTHDR_TO_MBUF(omp);
+
+        txom = ble_hs_mbuf_l2cap_pkt();
+        if (txom == NULL) {
+            break;
+        }
+
+        space = chan->blc_peer_mps;
+        if (!(chan->blc_flags & BLE_L2CAP_CHAN_F_TX_SDU_STARTED)) {
+            htole16(hdr, OS_MBUF_PKTLEN(sdu));
+            rc = os_mbuf_append(txom, hdr, sizeof hdr);
+            if (rc != 0) {
+                os_mbuf_free_chain(txom);
+                break;
+            }
+            space -= sizeof hdr;
+        }
+
+        seg_len = min(OS_MBUF_PKTLEN(sdu), space);
+        rc = os_mbuf_appendfrom(txom, sdu, 0, seg_len);
+        if (rc != 0) {
+            os_mbuf_free_chain(txom);
+            break;
+        }
+
+        /* The L2CAP header goes into the leading space reserved by
+         * ble_hs_mbuf_l2cap_pkt(); prepend before consuming the SDU data so
+         * that a failure leaves the SDU intact.
+         */
+        txom = ble_l2cap_prepend_hdr(txom, chan->blc_peer_cid,
+                                     OS_MBUF_PKTLEN(txom));
+        if (txom == NULL) {
+            break;
+        }
+
+        os_mbuf_adj(sdu, seg_len);
+        if (OS_MBUF_PKTLEN(sdu) == 0) {
+            STAILQ_REMOVE_HEAD(&chan->blc_tx_sdus, omp_next);
+            os_mbuf_free_chain(sdu);
+            chan->blc_flags &= ~BLE_L2CAP_CHAN_F_TX_SDU_STARTED;
+        } else {
+            chan->blc_flags |= BLE_L2CAP_CHAN_F_TX_SDU_STARTED;
+        }
+
+        chan->blc_tx_credits--;
+        ble_hs_hci_acl_tx(conn, txom);
+    }
+}
+
+/**
+ * Adds credits granted by the peer and resumes transmission.
+ *
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ *
+ * @return                      0 on success; BLE_HS_EBADDATA if the grant
+ *                                  would overflow the credit count.  The
+ *                                  channel should be disconnected in this
+ *                                  case.
+ */
+int
+ble_l2cap_coc_rx_credits(struct ble_hs_conn *conn,
+                         struct ble_l2cap_chan *chan, uint16_t credits)
+{
+    if (chan->blc_tx_credits + credits > UINT16_MAX) {
+        return BLE_HS_EBADDATA;
+    }
+
+    chan->blc_tx_credits += credits;
+    ble_l2cap_coc_tx_pump(conn, chan);
+
+    return 0;
+}
+
+/**
+ * Queues an SDU for transmission over an LE credit based channel.  The SDU
+ * is segmented into K-frames of the peer's MPS; frames are sent
+ * immediately while credits are available, and the remainder is sent as
+ * the peer grants more.  The supplied mbuf is consumed, regardless of the
+ * outcome of the function call.
+ *
+ * @param conn_handle           The connection the channel belongs to.
+ * @param cid                   The local CID of the channel.
+ * @param sdu                   The SDU to send; must be a packet header
+ *                                  mbuf.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the SDU is empty or not a
+ *                                  packet header mbuf;
+ *                              BLE_HS_ENOTCONN if the channel is not open;
+ *                              BLE_HS_EMSGSIZE if the SDU exceeds the
+ *                                  peer's MTU;
+ *                              BLE_HS_ENOMEM if the connection's outgoing
+ *                                  data is at its mbuf quota.
+ */
+int
+ble_l2cap_coc_send(uint16_t conn_handle, uint16_t cid, struct os_mbuf *sdu)
+{
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    int rc;
+
+    if (!OS_MBUF_IS_PKTHDR(sdu) || OS_MBUF_PKTLEN(sdu) == 0) {
+        rc = BLE_HS_EINVAL;
+        goto err;
+    }
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        chan = NULL;
+    } else {
+        chan = ble_hs_conn_chan_find(conn, cid);
+    }
+
+    if (!ble_l2cap_coc_chan_is_open(chan)) {
+        rc = BLE_HS_ENOTCONN;
+    } else if (OS_MBUF_PKTLEN(sdu) > chan->blc_peer_mtu) {
+        rc = BLE_HS_EMSGSIZE;
+    } else if (ble_hs_conn_tx_quota_full(conn)) {
+        STATS_INC(ble_hs_stats, conn_tx_quota);
+        rc = BLE_HS_ENOMEM;
+    } else {
+        STAILQ_INSERT_TAIL(&chan->blc_tx_sdus, OS_MBUF_PKTHDR(sdu), omp_next);
+        ble_l2cap_coc_tx_pump(conn, chan);
+        sdu = NULL;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    if (rc != 0) {
+        goto err;
+    }
+
+    return 0;
+
+err:
+    os_mbuf_free_chain(sdu);
+    return rc;
+}
+
+/*****************************************************************************
+ * $rx                                                                       *
+ *****************************************************************************/
+
+/**
+ * Adds a received K-frame to the SDU being reassembled.  The frame is
+ * consumed on success.
+ *
+ * @param out_sdu               On success, points to the SDU if this frame
+ *                                  completed it; null otherwise.
+ * @param out_credits           On SDU completion, the number of credits the
+ *                                  SDU consumed.
+ *
+ * @return                      0 on success; BLE_HS_EBADDATA if the peer
+ *                                  violated the channel parameters.
+ */
+static int
+ble_l2cap_coc_rx_frame(struct ble_l2cap_chan *chan, struct os_mbuf **om,
+                       struct os_mbuf **out_sdu, uint16_t *out_credits)
+{
+    uint16_t sdu_len;
+    int rc;
+
+    *out_sdu = NULL;
+
+    if (chan->blc_rx_credits == 0 ||
+        OS_MBUF_PKTLEN(*om) > chan->blc_my_mps) {
+
+        return BLE_HS_EBADDATA;
+    }
+
+    chan->blc_rx_credits--;
+    chan->blc_rx_sdu_frames++;
+
+    if (chan->blc_rx_sdu == NULL) {
+        rc = ble_hs_mbuf_pullup_base(om, BLE_L2CAP_COC_SDU_HDR_SZ);
+        if (rc != 0) {
+            return rc;
+        }
+
+        sdu_len = le16toh((*om)->om_data);
+        if (sdu_len > chan->blc_my_mtu) {
+            return BLE_HS_EBADDATA;
+        }
+
+        os_mbuf_adj(*om, BLE_L2CAP_COC_SDU_HDR_SZ);
+        chan->blc_rx_sdu = *om;
+        chan->blc_rx_sdu_len = sdu_len;
+    } else {
+        os_mbuf_concat(chan->blc_rx_sdu, *om);
+    }
+    *om = NULL;
+
+    if (OS_MBUF_PKTLEN(chan->blc_rx_sdu) > chan->blc_rx_sdu_len) {
+        os_mbuf_free_chain(chan->blc_rx_sdu);
+        chan->blc_rx_sdu = NULL;
+        return BLE_HS_EBADDATA;
+    }
+
+    if (OS_MBUF_PKTLEN(chan->blc_rx_sdu) == chan->blc_rx_sdu_len) {
+        *out_sdu = chan->blc_rx_sdu;
+        *out_credits = chan->blc_rx_sdu_frames;
+        chan->blc_rx_sdu = NULL;
+        chan->blc_rx_sdu_frames = 0;
+    }
+
+    return 0;
+}
+
+static int
+ble_l2cap_coc_rx(uint16_t conn_handle, uint16_t cid, struct os_mbuf **om)
+{
+    struct ble_l2cap_coc_event event;
+    ble_l2cap_coc_event_fn *cb;
+    struct ble_l2cap_chan *sig_chan;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    struct os_mbuf *sdu;
+    uint16_t credits;
+    void *cb_arg;
+    int rc;
+
+    sdu = NULL;
+    cb = NULL;
+    cb_arg = NULL;
+    credits = 0;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        chan = NULL;
+    } else {
+        chan = ble_hs_conn_chan_find(conn, cid);
+    }
+
+    if (!ble_l2cap_coc_chan_is_open(chan)) {
+        rc = BLE_HS_ENOTCONN;
+    } else {
+        rc = ble_l2cap_coc_rx_frame(chan, om, &sdu, &credits);
+        cb = chan->blc_coc_cb;
+        cb_arg = chan->blc_coc_cb_arg;
+    }
+
+    ble_hs_unlock();
+
+    if (rc == BLE_HS_EBADDATA) {
+        /* The peer ignored our MPS, MTU, or credits; close the channel. */
+        ble_l2cap_coc_disconnect(conn_handle, cid);
+        return rc;
+    }
+
+    if (sdu == NULL) {
+        return rc;
+    }
+
+    memset(&event, 0, sizeof event);
+    event.type = BLE_L2CAP_COC_EVENT_RX;
+    event.conn_handle = conn_handle;
+    event.cid = cid;
+    event.rx.sdu = sdu;
+    ble_l2cap_coc_call_cb(cb, cb_arg, &event);
+    os_mbuf_free_chain(sdu);
+
+    /* The SDU has been consumed; allow the peer to send another. */
+    ble_hs_lock();
+
+    rc = ble_hs_misc_conn_chan_find(conn_handle, BLE_L2CAP_CID_SIG,
+                                    &conn, &sig_chan);
+    if (rc == 0) {
+        chan = ble_hs_conn_chan_find(conn, cid);
+        if (ble_l2cap_coc_chan_is_open(chan)) {
+            chan->blc_rx_credits += credits;
+            rc = ble_l2cap_sig_le_credits_tx(conn, sig_chan, cid, credits);
+        }
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/*****************************************************************************
+ * $server                                                                   *
+ *****************************************************************************/
+
+/**
+ * Registers a server for LE credit based connections on the specified PSM.
+ * Incoming connection requests to the PSM are accepted automatically; the
+ * callback receives a BLE_L2CAP_COC_EVENT_CONNECT event for each new
+ * channel, followed by that channel's receive and disconnect events.
+ *
+ * @param psm                   The LE PSM to listen on (0x0001-0x00ff).
+ * @param mtu                   The largest SDU this server can receive.
+ * @param cb                    The callback to report channel events to.
+ * @param cb_arg                The optional argument to pass to the
+ *                                  callback.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if an argument is invalid;
+ *                              BLE_HS_EALREADY if the PSM already has a
+ *                                  server;
+ *                              BLE_HS_ENOMEM if the maximum number of
+ *                                  servers is registered.
+ */
+int
+ble_l2cap_coc_create_server(uint16_t psm, uint16_t mtu,
+                            ble_l2cap_coc_event_fn *cb, void *cb_arg)
+{
+    struct ble_l2cap_coc_srv *srv;
+    int rc;
+
+    if (psm == 0 || psm > BLE_L2CAP_COC_PSM_MAX ||
+        mtu < BLE_L2CAP_COC_MTU_MIN || cb == NULL) {
+
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    if (ble_l2cap_coc_srv_find(psm) != NULL) {
+        rc = BLE_HS_EALREADY;
+        goto done;
+    }
+
+    srv = os_memblock_get(&ble_l2cap_coc_srv_pool);
+    if (srv == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto done;
+    }
+
+    memset(srv, 0, sizeof *srv);
+    srv->psm = psm;
+    srv->mtu = mtu;
+    srv->cb = cb;
+    srv->cb_arg = cb_arg;
+    STAILQ_INSERT_TAIL(&ble_l2cap_coc_srvs, srv, next);
+
+    rc = 0;
+
+done:
+    ble_hs_unlock();
+    return rc;
+}
+
+static void
+ble_l2cap_coc_free_mem(void)
+{
+    free(ble_l2cap_coc_srv_mem);
+    ble_l2cap_coc_srv_mem = NULL;
+}
+
+int
+ble_l2cap_coc_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                       struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *live_pool;
+
+    if (idx != 0) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        live_pool = &ble_l2cap_coc_srv_pool;
+    } else {
+        live_pool = NULL;
+    }
+
+    ble_hs_mem_pool_fill(out_pool, "ble_l2cap_coc_srv_pool", cfg->max_l2cap_coc_servers,
+                         sizeof (struct ble_l2cap_coc_srv), live_pool);
+    return 0;
+}
+
+int
+ble_l2cap_coc_init(void)
+{
+    int rc;
+
+    ble_l2cap_coc_free_mem();
+
+    STAILQ_INIT(&ble_l2cap_coc_srvs);
+
+    if (ble_hs_cfg.max_l2cap_coc_servers > 0) {
+        ble_l2cap_coc_srv_mem = malloc(
+            OS_MEMPOOL_BYTES(ble_hs_cfg.max_l2cap_coc_servers,
+                             sizeof (struct ble_l2cap_coc_srv)));
+        if (ble_l2cap_coc_srv_mem == NULL) {
+            rc = BLE_HS_ENOMEM;
+            goto err;
+        }
+
+        rc = os_mempool_init(&ble_l2cap_coc_srv_pool,
+                             ble_hs_cfg.max_l2cap_coc_servers,
+                             sizeof (struct ble_l2cap_coc_srv),
+                             ble_l2cap_coc_srv_mem,
+                             "ble_l2cap_coc_srv_pool");
+        if (rc != 0) {
+            rc = BLE_HS_EOS;
+            goto err;
+        }
+    }
+
+    return 0;
+
+err:
+    ble_l2cap_coc_free_mem();
+    return rc;
+}
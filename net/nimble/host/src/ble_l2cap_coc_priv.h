@@ -0,0 +1,64 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_L2CAP_COC_PRIV_
+#define H_BLE_L2CAP_COC_PRIV_
+
+#include <inttypes.h>
+#include "host/ble_l2cap.h"
+struct ble_hs_conn;
+struct ble_l2cap_chan;
+struct ble_hs_cfg;
+struct ble_hs_mem_pool;
+
+/**
+ * Our K-frame payload size (MPS).  247 bytes plus the 4-byte L2CAP header
+ * fill a maximum size (251 byte) LL data PDU, so each K-frame costs exactly
+ * one air packet when the link supports data length extension.
+ */
+#define BLE_L2CAP_COC_MPS               247
+
+/** Smallest MPS either side may use. */
+#define BLE_L2CAP_COC_MPS_MIN           23
+
+/** Size of the SDU length field at the start of each SDU's first K-frame. */
+#define BLE_L2CAP_COC_SDU_HDR_SZ        2
+
+struct ble_l2cap_chan *ble_l2cap_coc_chan_create(struct ble_hs_conn *conn,
+                                                 uint16_t psm, uint16_t mtu,
+                                                 ble_l2cap_coc_event_fn *cb,
+                                                 void *cb_arg);
+uint16_t ble_l2cap_coc_accept(struct ble_hs_conn *conn, uint16_t psm,
+                              struct ble_l2cap_chan **out_chan);
+void ble_l2cap_coc_connected(struct ble_hs_conn *conn,
+                             struct ble_l2cap_chan *chan, uint16_t peer_cid,
+                             uint16_t peer_mtu, uint16_t peer_mps,
+                             uint16_t credits);
+int ble_l2cap_coc_rx_credits(struct ble_hs_conn *conn,
+                             struct ble_l2cap_chan *chan, uint16_t credits);
+struct ble_l2cap_chan *ble_l2cap_coc_chan_find_peer(struct ble_hs_conn *conn,
+                                                    uint16_t peer_cid);
+struct ble_l2cap_chan *ble_l2cap_coc_chan_first(struct ble_hs_conn *conn);
+void ble_l2cap_coc_call_cb(ble_l2cap_coc_event_fn *cb, void *cb_arg,
+                           struct ble_l2cap_coc_event *event);
+int ble_l2cap_coc_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                           struct ble_hs_mem_pool *out_pool);
+int ble_l2cap_coc_init(void);
+
+#endif
@@ -27,6 +27,8 @@
 #include "os/os_mbuf.h"
 struct ble_hs_conn;
 struct hci_data_hdr;
+struct ble_hs_cfg;
+struct ble_hs_mem_pool;
 
 STATS_SECT_START(ble_l2cap_stats)
     STATS_SECT_ENTRY(chan_create)
@@ -53,11 +55,16 @@ extern struct os_mempool ble_l2cap_chan_pool;
  */
 #define BLE_L2CAP_CID_BLACK_HOLE    0xffff
 
+/* Dynamically allocated channels (LE credit based). */
+#define BLE_L2CAP_CID_DYN_MIN       0x0040
+#define BLE_L2CAP_CID_DYN_MAX       0x007f
+
 #define BLE_L2CAP_HDR_SZ    4
 
 typedef uint8_t ble_l2cap_chan_flags;
 
-typedef int ble_l2cap_rx_fn(uint16_t conn_handle, struct os_mbuf **rxom);
+typedef int ble_l2cap_rx_fn(uint16_t conn_handle, uint16_t cid,
+                            struct os_mbuf **rxom);
 
 struct ble_l2cap_chan {
     SLIST_ENTRY(ble_l2cap_chan) blc_next;
@@ -71,6 +78,26 @@ struct ble_l2cap_chan {
     uint16_t blc_rx_len;        /* Length of current reassembled rx packet. */
 
     ble_l2cap_rx_fn *blc_rx_fn;
+
+    /*** LE credit based channels only; blc_my_mtu / blc_peer_mtu hold the
+     *   SDU sizes.
+     */
+    uint16_t blc_psm;
+    uint16_t blc_peer_cid;
+    uint16_t blc_my_mps;
+    uint16_t blc_peer_mps;
+    uint16_t blc_rx_credits;    /* K-frames the peer may still send. */
+    uint16_t blc_tx_credits;    /* K-frames we may still send. */
+
+    struct os_mbuf *blc_rx_sdu; /* SDU being reassembled. */
+    uint16_t blc_rx_sdu_len;    /* Length from the first K-frame. */
+    uint16_t blc_rx_sdu_frames; /* K-frames consumed by current SDU. */
+
+    /* SDUs waiting for credits; the head may be partly sent. */
+    STAILQ_HEAD(, os_mbuf_pkthdr) blc_tx_sdus;
+
+    ble_l2cap_coc_event_fn *blc_coc_cb;
+    void *blc_coc_cb_arg;
 };
 
 struct ble_l2cap_hdr {
@@ -82,6 +109,9 @@ typedef int ble_l2cap_tx_fn(struct ble_hs_conn *conn,
                             struct ble_l2cap_chan *chan);
 
 #define BLE_L2CAP_CHAN_F_TXED_MTU       0x01    /* We have sent our MTU. */
+#define BLE_L2CAP_CHAN_F_COC            0x02    /* LE credit based channel. */
+#define BLE_L2CAP_CHAN_F_CONNECTED      0x04    /* CoC established. */
+#define BLE_L2CAP_CHAN_F_TX_SDU_STARTED 0x08    /* Head tx SDU partly sent. */
 
 SLIST_HEAD(ble_l2cap_chan_list, ble_l2cap_chan);
 
@@ -100,10 +130,13 @@ int ble_l2cap_rx(struct ble_hs_conn *conn,
                  struct hci_data_hdr *hci_hdr,
                  struct os_mbuf *om,
                  ble_l2cap_rx_fn **out_rx_cb,
+                 uint16_t *out_rx_cid,
                  struct os_mbuf **out_rx_buf);
 int ble_l2cap_tx(struct ble_hs_conn *conn, struct ble_l2cap_chan *chan,
                  struct os_mbuf *txom);
 
+int ble_l2cap_chan_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                            struct ble_hs_mem_pool *out_pool);
 int ble_l2cap_init(void);
 
 #endif
@@ -55,7 +55,9 @@
 #define BLE_L2CAP_SIG_UNRESPONSIVE_TIMEOUT      30000   /* Milliseconds. */
 
 #define BLE_L2CAP_SIG_PROC_OP_UPDATE            0
-#define BLE_L2CAP_SIG_PROC_OP_MAX               1
+#define BLE_L2CAP_SIG_PROC_OP_CONNECT           1
+#define BLE_L2CAP_SIG_PROC_OP_DISCONNECT        2
+#define BLE_L2CAP_SIG_PROC_OP_MAX               3
 
 struct ble_l2cap_sig_proc {
     STAILQ_ENTRY(ble_l2cap_sig_proc) next;
@@ -70,6 +72,13 @@ struct ble_l2cap_sig_proc {
             ble_l2cap_sig_update_fn *cb;
             void *cb_arg;
         } update;
+
+        /* LE credit based connect / disconnect; the channel holds the
+         * application callback.
+         */
+        struct {
+            uint16_t cid;
+        } coc;
     };
 };
 
@@ -84,12 +93,19 @@ typedef int ble_l2cap_sig_rx_fn(uint16_t conn_handle,
 static ble_l2cap_sig_rx_fn ble_l2cap_sig_rx_noop;
 static ble_l2cap_sig_rx_fn ble_l2cap_sig_update_req_rx;
 static ble_l2cap_sig_rx_fn ble_l2cap_sig_update_rsp_rx;
+static ble_l2cap_sig_rx_fn ble_l2cap_sig_reject_rx;
+static ble_l2cap_sig_rx_fn ble_l2cap_sig_coc_req_rx;
+static ble_l2cap_sig_rx_fn ble_l2cap_sig_coc_rsp_rx;
+static ble_l2cap_sig_rx_fn ble_l2cap_sig_le_credits_rx;
+static ble_l2cap_sig_rx_fn ble_l2cap_sig_disconn_req_rx;
+static ble_l2cap_sig_rx_fn ble_l2cap_sig_disconn_rsp_rx;
 
 static ble_l2cap_sig_rx_fn * const ble_l2cap_sig_dispatch[] = {
-    [BLE_L2CAP_SIG_OP_REJECT]               = ble_l2cap_sig_rx_noop,
+    [BLE_L2CAP_SIG_OP_REJECT]               = ble_l2cap_sig_reject_rx,
     [BLE_L2CAP_SIG_OP_CONNECT_RSP]          = ble_l2cap_sig_rx_noop,
     [BLE_L2CAP_SIG_OP_CONFIG_RSP]           = ble_l2cap_sig_rx_noop,
-    [BLE_L2CAP_SIG_OP_DISCONN_RSP]          = ble_l2cap_sig_rx_noop,
+    [BLE_L2CAP_SIG_OP_DISCONN_REQ]          = ble_l2cap_sig_disconn_req_rx,
+    [BLE_L2CAP_SIG_OP_DISCONN_RSP]          = ble_l2cap_sig_disconn_rsp_rx,
     [BLE_L2CAP_SIG_OP_ECHO_RSP]             = ble_l2cap_sig_rx_noop,
     [BLE_L2CAP_SIG_OP_INFO_RSP]             = ble_l2cap_sig_rx_noop,
     [BLE_L2CAP_SIG_OP_CREATE_CHAN_RSP]      = ble_l2cap_sig_rx_noop,
@@ -97,7 +113,9 @@ static ble_l2cap_sig_rx_fn * const ble_l2cap_sig_dispatch[] = {
     [BLE_L2CAP_SIG_OP_MOVE_CHAN_CONF_RSP]   = ble_l2cap_sig_rx_noop,
     [BLE_L2CAP_SIG_OP_UPDATE_REQ]           = ble_l2cap_sig_update_req_rx,
     [BLE_L2CAP_SIG_OP_UPDATE_RSP]           = ble_l2cap_sig_update_rsp_rx,
-    [BLE_L2CAP_SIG_OP_CREDIT_CONNECT_RSP]   = ble_l2cap_sig_rx_noop,
+    [BLE_L2CAP_SIG_OP_CREDIT_CONNECT_REQ]   = ble_l2cap_sig_coc_req_rx,
+    [BLE_L2CAP_SIG_OP_CREDIT_CONNECT_RSP]   = ble_l2cap_sig_coc_rsp_rx,
+    [BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT]     = ble_l2cap_sig_le_credits_rx,
 };
 
 static uint8_t ble_l2cap_sig_cur_id;
@@ -125,7 +143,7 @@ ble_l2cap_sig_dbg_assert_proc_not_inserted(struct ble_l2cap_sig_proc *proc)
  * $misc                                                                     *
  *****************************************************************************/
 
-static uint8_t
+uint8_t
 ble_l2cap_sig_next_id(void)
 {
     ble_l2cap_sig_cur_id++;
@@ -140,7 +158,9 @@ ble_l2cap_sig_next_id(void)
 static ble_l2cap_sig_rx_fn *
 ble_l2cap_sig_dispatch_get(uint8_t op)
 {
-    if (op > BLE_L2CAP_SIG_OP_MAX) {
+    if (op >= sizeof ble_l2cap_sig_dispatch /
+              sizeof ble_l2cap_sig_dispatch[0]) {
+
         return NULL;
     }
 
@@ -181,6 +201,13 @@ ble_l2cap_sig_proc_free(struct ble_l2cap_sig_proc *proc)
     }
 }
 
+static void
+ble_l2cap_sig_proc_set_timer(struct ble_l2cap_sig_proc *proc)
+{
+    proc->exp_os_ticks = os_time_get() + BLE_L2CAP_SIG_UNRESPONSIVE_TIMEOUT;
+    ble_hs_heartbeat_sched(BLE_L2CAP_SIG_UNRESPONSIVE_TIMEOUT);
+}
+
 static void
 ble_l2cap_sig_proc_insert(struct ble_l2cap_sig_proc *proc)
 {
@@ -440,7 +467,7 @@ ble_l2cap_sig_update(uint16_t conn_handle,
     proc->op = BLE_L2CAP_SIG_PROC_OP_UPDATE;
     proc->id = ble_l2cap_sig_next_id();
     proc->conn_handle = conn_handle;
-    proc->exp_os_ticks = os_time_get() + BLE_L2CAP_SIG_UNRESPONSIVE_TIMEOUT;
+    ble_l2cap_sig_proc_set_timer(proc);
     proc->update.cb = cb;
     proc->update.cb_arg = cb_arg;
 
@@ -464,8 +491,564 @@ done:
     return rc;
 }
 
+/*****************************************************************************
+ * $coc                                                                      *
+ *****************************************************************************/
+
+static int
+ble_l2cap_sig_coc_cid_is_dyn(uint16_t cid)
+{
+    return cid >= BLE_L2CAP_CID_DYN_MIN && cid <= BLE_L2CAP_CID_DYN_MAX;
+}
+
+/**
+ * Deletes the specified LE credit based channel and reports its closure to
+ * the application.  No-op if the channel no longer exists.
+ *
+ * @param event_type            BLE_L2CAP_COC_EVENT_CONNECT if the channel
+ *                                  was never established;
+ *                                  BLE_L2CAP_COC_EVENT_DISCONNECT otherwise.
+ * @param status                The connect event status; ignored for
+ *                                  disconnect events.
+ */
+static void
+ble_l2cap_sig_coc_remove(uint16_t conn_handle, uint16_t cid,
+                         uint8_t event_type, int status)
+{
+    struct ble_l2cap_coc_event event;
+    ble_l2cap_coc_event_fn *cb;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    void *cb_arg;
+    int found;
+
+    cb = NULL;
+    cb_arg = NULL;
+    found = 0;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL) {
+        chan = ble_hs_conn_chan_find(conn, cid);
+        if (chan != NULL && chan->blc_flags & BLE_L2CAP_CHAN_F_COC) {
+            cb = chan->blc_coc_cb;
+            cb_arg = chan->blc_coc_cb_arg;
+            ble_hs_conn_delete_chan(conn, chan);
+            found = 1;
+        }
+    }
+
+    ble_hs_unlock();
+
+    if (!found) {
+        return;
+    }
+
+    memset(&event, 0, sizeof event);
+    event.type = event_type;
+    event.conn_handle = conn_handle;
+    event.cid = cid;
+    if (event_type == BLE_L2CAP_COC_EVENT_CONNECT) {
+        event.connect.status = status;
+    }
+    ble_l2cap_coc_call_cb(cb, cb_arg, &event);
+}
+
+/**
+ * Reports the failure of a procedure that did not receive a usable
+ * response.
+ */
+static void
+ble_l2cap_sig_proc_fail(struct ble_l2cap_sig_proc *proc, int status)
+{
+    switch (proc->op) {
+    case BLE_L2CAP_SIG_PROC_OP_UPDATE:
+        ble_l2cap_sig_update_call_cb(proc, status);
+        break;
+
+    case BLE_L2CAP_SIG_PROC_OP_CONNECT:
+        ble_l2cap_sig_coc_remove(proc->conn_handle, proc->coc.cid,
+                                 BLE_L2CAP_COC_EVENT_CONNECT, status);
+        break;
+
+    case BLE_L2CAP_SIG_PROC_OP_DISCONNECT:
+        /* The channel is closed locally whether or not the peer confirms. */
+        ble_l2cap_sig_coc_remove(proc->conn_handle, proc->coc.cid,
+                                 BLE_L2CAP_COC_EVENT_DISCONNECT, 0);
+        break;
+
+    default:
+        BLE_HS_DBG_ASSERT(0);
+        break;
+    }
+}
+
+static int
+ble_l2cap_sig_reject_rx(uint16_t conn_handle,
+                        struct ble_l2cap_sig_hdr *hdr,
+                        struct os_mbuf **om)
+{
+    struct ble_l2cap_sig_proc *proc;
+    uint16_t reason;
+    int rc;
+
+    if (hdr->identifier == 0) {
+        return BLE_HS_ENOENT;
+    }
+
+    rc = ble_hs_mbuf_pullup_base(om, BLE_L2CAP_SIG_REJECT_MIN_SZ);
+    if (rc != 0) {
+        return rc;
+    }
+    reason = le16toh((*om)->om_data);
+
+    /* A peer without LE credit based channel support rejects the request
+     * outright; fail the procedure now rather than waiting for it to time
+     * out.
+     */
+    proc = ble_l2cap_sig_proc_extract(conn_handle,
+                                      BLE_L2CAP_SIG_PROC_OP_CONNECT,
+                                      hdr->identifier);
+    if (proc == NULL) {
+        proc = ble_l2cap_sig_proc_extract(conn_handle,
+                                          BLE_L2CAP_SIG_PROC_OP_DISCONNECT,
+                                          hdr->identifier);
+    }
+    if (proc == NULL) {
+        return BLE_HS_ENOENT;
+    }
+
+    ble_l2cap_sig_proc_fail(proc, BLE_HS_L2C_ERR(reason));
+    ble_l2cap_sig_proc_free(proc);
+
+    return 0;
+}
+
+static int
+ble_l2cap_sig_coc_req_rx(uint16_t conn_handle,
+                         struct ble_l2cap_sig_hdr *hdr,
+                         struct os_mbuf **om)
+{
+    struct ble_l2cap_sig_coc_req req;
+    struct ble_l2cap_sig_coc_rsp rsp;
+    struct ble_l2cap_coc_event event;
+    ble_l2cap_coc_event_fn *cb;
+    struct ble_l2cap_chan *sig_chan;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    void *cb_arg;
+    int rc;
+
+    rc = ble_hs_mbuf_pullup_base(om, BLE_L2CAP_SIG_COC_REQ_SZ);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_l2cap_sig_coc_req_parse((*om)->om_data, (*om)->om_len, &req);
+
+    memset(&rsp, 0, sizeof rsp);
+    memset(&event, 0, sizeof event);
+    chan = NULL;
+    cb = NULL;
+    cb_arg = NULL;
+
+    ble_hs_lock();
+
+    ble_hs_misc_conn_chan_find_reqd(conn_handle, BLE_L2CAP_CID_SIG,
+                                    &conn, &sig_chan);
+
+    if (req.mtu < BLE_L2CAP_COC_MTU_MIN || req.mps < BLE_L2CAP_COC_MPS_MIN) {
+        rsp.result = BLE_L2CAP_COC_ERR_UNACCEPTABLE_PARAMS;
+    } else if (!ble_l2cap_sig_coc_cid_is_dyn(req.scid)) {
+        rsp.result = BLE_L2CAP_COC_ERR_INVALID_SOURCE_CID;
+    } else if (ble_l2cap_coc_chan_find_peer(conn, req.scid) != NULL) {
+        rsp.result = BLE_L2CAP_COC_ERR_SOURCE_CID_USED;
+    } else {
+        rsp.result = ble_l2cap_coc_accept(conn, req.psm, &chan);
+    }
+
+    if (rsp.result == 0) {
+        ble_l2cap_coc_connected(conn, chan, req.scid, req.mtu, req.mps,
+                                req.credits);
+
+        rsp.dcid = chan->blc_cid;
+        rsp.mtu = chan->blc_my_mtu;
+        rsp.mps = chan->blc_my_mps;
+        rsp.credits = chan->blc_rx_credits;
+
+        event.type = BLE_L2CAP_COC_EVENT_CONNECT;
+        event.conn_handle = conn_handle;
+        event.cid = chan->blc_cid;
+        event.connect.peer_mtu = req.mtu;
+        cb = chan->blc_coc_cb;
+        cb_arg = chan->blc_coc_cb_arg;
+    }
+
+    rc = ble_l2cap_sig_coc_rsp_tx(conn, sig_chan, hdr->identifier, &rsp);
+    if (rc != 0 && chan != NULL) {
+        ble_hs_conn_delete_chan(conn, chan);
+        chan = NULL;
+    }
+
+    ble_hs_unlock();
+
+    if (chan != NULL) {
+        ble_l2cap_coc_call_cb(cb, cb_arg, &event);
+    }
+
+    return rc;
+}
+
+static int
+ble_l2cap_sig_coc_rsp_rx(uint16_t conn_handle,
+                         struct ble_l2cap_sig_hdr *hdr,
+                         struct os_mbuf **om)
+{
+    struct ble_l2cap_sig_coc_rsp rsp;
+    struct ble_l2cap_coc_event event;
+    struct ble_l2cap_sig_proc *proc;
+    ble_l2cap_coc_event_fn *cb;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    void *cb_arg;
+    int status;
+    int rc;
+
+    proc = ble_l2cap_sig_proc_extract(conn_handle,
+                                      BLE_L2CAP_SIG_PROC_OP_CONNECT,
+                                      hdr->identifier);
+    if (proc == NULL) {
+        return BLE_HS_ENOENT;
+    }
+
+    rc = ble_hs_mbuf_pullup_base(om, BLE_L2CAP_SIG_COC_RSP_SZ);
+    if (rc != 0) {
+        status = rc;
+        goto fail;
+    }
+
+    ble_l2cap_sig_coc_rsp_parse((*om)->om_data, (*om)->om_len, &rsp);
+
+    if (rsp.result != 0) {
+        status = BLE_HS_L2C_ERR(rsp.result);
+        rc = 0;
+        goto fail;
+    }
+
+    if (!ble_l2cap_sig_coc_cid_is_dyn(rsp.dcid) ||
+        rsp.mtu < BLE_L2CAP_COC_MTU_MIN ||
+        rsp.mps < BLE_L2CAP_COC_MPS_MIN) {
+
+        status = BLE_HS_EBADDATA;
+        rc = BLE_HS_EBADDATA;
+        goto fail;
+    }
+
+    cb = NULL;
+    cb_arg = NULL;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        chan = NULL;
+    } else {
+        chan = ble_hs_conn_chan_find(conn, proc->coc.cid);
+    }
+    if (chan != NULL) {
+        ble_l2cap_coc_connected(conn, chan, rsp.dcid, rsp.mtu, rsp.mps,
+                                rsp.credits);
+        cb = chan->blc_coc_cb;
+        cb_arg = chan->blc_coc_cb_arg;
+        rc = 0;
+    } else {
+        rc = BLE_HS_ENOTCONN;
+    }
+
+    ble_hs_unlock();
+
+    if (rc == 0) {
+        memset(&event, 0, sizeof event);
+        event.type = BLE_L2CAP_COC_EVENT_CONNECT;
+        event.conn_handle = conn_handle;
+        event.cid = proc->coc.cid;
+        event.connect.peer_mtu = rsp.mtu;
+        ble_l2cap_coc_call_cb(cb, cb_arg, &event);
+    }
+
+    ble_l2cap_sig_proc_free(proc);
+    return rc;
+
+fail:
+    ble_l2cap_sig_proc_fail(proc, status);
+    ble_l2cap_sig_proc_free(proc);
+    return rc;
+}
+
+static int
+ble_l2cap_sig_le_credits_rx(uint16_t conn_handle,
+                            struct ble_l2cap_sig_hdr *hdr,
+                            struct os_mbuf **om)
+{
+    struct ble_l2cap_sig_le_credits cmd;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    uint16_t cid;
+    int rc;
+
+    rc = ble_hs_mbuf_pullup_base(om, BLE_L2CAP_SIG_LE_CREDITS_SZ);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_l2cap_sig_le_credits_parse((*om)->om_data, (*om)->om_len, &cmd);
+
+    cid = 0;
+
+    ble_hs_lock();
+
+    /* The command carries the sender's CID, i.e., our destination CID. */
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL) {
+        chan = NULL;
+    } else {
+        chan = ble_l2cap_coc_chan_find_peer(conn, cmd.cid);
+    }
+
+    if (chan == NULL || !(chan->blc_flags & BLE_L2CAP_CHAN_F_CONNECTED)) {
+        rc = BLE_HS_ENOENT;
+    } else {
+        cid = chan->blc_cid;
+        rc = ble_l2cap_coc_rx_credits(conn, chan, cmd.credits);
+    }
+
+    ble_hs_unlock();
+
+    if (rc == BLE_HS_EBADDATA) {
+        /* Credit count overflow; the peer is misbehaving. */
+        ble_l2cap_coc_disconnect(conn_handle, cid);
+    }
+
+    return rc;
+}
+
+static int
+ble_l2cap_sig_disconn_req_rx(uint16_t conn_handle,
+                             struct ble_l2cap_sig_hdr *hdr,
+                             struct os_mbuf **om)
+{
+    struct ble_l2cap_sig_disconn req;
+    struct ble_l2cap_chan *sig_chan;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    int rc;
+
+    rc = ble_hs_mbuf_pullup_base(om, BLE_L2CAP_SIG_DISCONN_REQ_SZ);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_l2cap_sig_disconn_parse((*om)->om_data, (*om)->om_len, &req);
+
+    ble_hs_lock();
+
+    ble_hs_misc_conn_chan_find_reqd(conn_handle, BLE_L2CAP_CID_SIG,
+                                    &conn, &sig_chan);
+
+    chan = ble_hs_conn_chan_find(conn, req.dcid);
+    if (chan == NULL || !(chan->blc_flags & BLE_L2CAP_CHAN_F_COC) ||
+        chan->blc_peer_cid != req.scid) {
+
+        ble_l2cap_sig_reject_invalid_cid_tx(conn, sig_chan, hdr->identifier,
+                                            req.scid, req.dcid);
+        ble_hs_unlock();
+        return BLE_HS_L2C_ERR(BLE_L2CAP_SIG_ERR_INVALID_CID);
+    }
+
+    rc = ble_l2cap_sig_disconn_tx(conn, sig_chan, BLE_L2CAP_SIG_OP_DISCONN_RSP,
+                                  hdr->identifier, req.dcid, req.scid);
+
+    ble_hs_unlock();
+
+    ble_l2cap_sig_coc_remove(conn_handle, req.dcid,
+                             BLE_L2CAP_COC_EVENT_DISCONNECT, 0);
+
+    return rc;
+}
+
+static int
+ble_l2cap_sig_disconn_rsp_rx(uint16_t conn_handle,
+                             struct ble_l2cap_sig_hdr *hdr,
+                             struct os_mbuf **om)
+{
+    struct ble_l2cap_sig_proc *proc;
+
+    proc = ble_l2cap_sig_proc_extract(conn_handle,
+                                      BLE_L2CAP_SIG_PROC_OP_DISCONNECT,
+                                      hdr->identifier);
+    if (proc == NULL) {
+        return BLE_HS_ENOENT;
+    }
+
+    ble_l2cap_sig_coc_remove(conn_handle, proc->coc.cid,
+                             BLE_L2CAP_COC_EVENT_DISCONNECT, 0);
+    ble_l2cap_sig_proc_free(proc);
+
+    return 0;
+}
+
+/**
+ * Initiates an LE credit based connection to the specified PSM on the peer.
+ * The outcome is reported to the callback as a BLE_L2CAP_COC_EVENT_CONNECT
+ * event; on success, the event's cid identifies the new channel in all
+ * subsequent calls and events.
+ *
+ * @param conn_handle           The connection to open the channel on.
+ * @param psm                   The peer's LE PSM.
+ * @param mtu                   The largest SDU we can receive.
+ * @param cb                    The callback to report channel events to.
+ * @param cb_arg                The optional argument to pass to the
+ *                                  callback.
+ *
+ * @return                      0 if the connection request was sent;
+ *                              BLE_HS_EINVAL if an argument is invalid;
+ *                              BLE_HS_ENOTCONN if there is no such
+ *                                  connection;
+ *                              BLE_HS_ENOMEM if no signalling procedure or
+ *                                  channel is available.
+ */
+int
+ble_l2cap_coc_connect(uint16_t conn_handle, uint16_t psm, uint16_t mtu,
+                      ble_l2cap_coc_event_fn *cb, void *cb_arg)
+{
+    struct ble_l2cap_sig_coc_req req;
+    struct ble_l2cap_sig_proc *proc;
+    struct ble_l2cap_chan *sig_chan;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    int rc;
+
+    if (psm == 0 || mtu < BLE_L2CAP_COC_MTU_MIN || cb == NULL) {
+        return BLE_HS_EINVAL;
+    }
+
+    proc = ble_l2cap_sig_proc_alloc();
+    if (proc == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    ble_hs_lock();
+
+    rc = ble_hs_misc_conn_chan_find(conn_handle, BLE_L2CAP_CID_SIG,
+                                    &conn, &sig_chan);
+    if (rc != 0) {
+        goto done;
+    }
+
+    chan = ble_l2cap_coc_chan_create(conn, psm, mtu, cb, cb_arg);
+    if (chan == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto done;
+    }
+
+    proc->op = BLE_L2CAP_SIG_PROC_OP_CONNECT;
+    proc->id = ble_l2cap_sig_next_id();
+    proc->conn_handle = conn_handle;
+    ble_l2cap_sig_proc_set_timer(proc);
+    proc->coc.cid = chan->blc_cid;
+
+    req.psm = psm;
+    req.scid = chan->blc_cid;
+    req.mtu = chan->blc_my_mtu;
+    req.mps = chan->blc_my_mps;
+    req.credits = chan->blc_rx_credits;
+
+    rc = ble_l2cap_sig_coc_req_tx(conn, sig_chan, proc->id, &req);
+    if (rc == 0) {
+        ble_l2cap_sig_proc_insert(proc);
+    } else {
+        ble_hs_conn_delete_chan(conn, chan);
+    }
+
+done:
+    ble_hs_unlock();
+
+    if (rc != 0) {
+        ble_l2cap_sig_proc_free(proc);
+    }
+
+    return rc;
+}
+
+/**
+ * Closes an LE credit based channel.  No data is sent or delivered on the
+ * channel once this function returns.  A BLE_L2CAP_COC_EVENT_DISCONNECT
+ * event is reported when the peer responds (or the procedure times out).
+ *
+ * @param conn_handle           The connection the channel belongs to.
+ * @param cid                   The local CID of the channel.
+ *
+ * @return                      0 if the disconnection request was sent;
+ *                              BLE_HS_ENOTCONN if the channel is not open;
+ *                              BLE_HS_ENOMEM if no signalling procedure is
+ *                                  available.
+ */
+int
+ble_l2cap_coc_disconnect(uint16_t conn_handle, uint16_t cid)
+{
+    struct ble_l2cap_sig_proc *proc;
+    struct ble_l2cap_chan *sig_chan;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    int rc;
+
+    proc = ble_l2cap_sig_proc_alloc();
+    if (proc == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    ble_hs_lock();
+
+    rc = ble_hs_misc_conn_chan_find(conn_handle, BLE_L2CAP_CID_SIG,
+                                    &conn, &sig_chan);
+    if (rc != 0) {
+        goto done;
+    }
+
+    chan = ble_hs_conn_chan_find(conn, cid);
+    if (chan == NULL || !(chan->blc_flags & BLE_L2CAP_CHAN_F_COC) ||
+        !(chan->blc_flags & BLE_L2CAP_CHAN_F_CONNECTED)) {
+
+        rc = BLE_HS_ENOTCONN;
+        goto done;
+    }
+
+    proc->op = BLE_L2CAP_SIG_PROC_OP_DISCONNECT;
+    proc->id = ble_l2cap_sig_next_id();
+    proc->conn_handle = conn_handle;
+    ble_l2cap_sig_proc_set_timer(proc);
+    proc->coc.cid = cid;
+
+    rc = ble_l2cap_sig_disconn_tx(conn, sig_chan, BLE_L2CAP_SIG_OP_DISCONN_REQ,
+                                  proc->id, chan->blc_peer_cid, cid);
+    if (rc == 0) {
+        chan->blc_flags &= ~BLE_L2CAP_CHAN_F_CONNECTED;
+        ble_l2cap_sig_proc_insert(proc);
+    }
+
+done:
+    ble_hs_unlock();
+
+    if (rc != 0) {
+        ble_l2cap_sig_proc_free(proc);
+    }
+
+    return rc;
+}
+
 static int
-ble_l2cap_sig_rx(uint16_t conn_handle, struct os_mbuf **om)
+ble_l2cap_sig_rx(uint16_t conn_handle, uint16_t cid, struct os_mbuf **om)
 {
     struct ble_l2cap_sig_hdr hdr;
     struct ble_l2cap_chan *chan;
@@ -527,17 +1110,26 @@ ble_l2cap_sig_create_chan(void)
     return chan;
 }
 
-static void
+/**
+ * Removes all expired procedures and inserts them into the specified list.
+ *
+ * @return                      The number of ticks until the next remaining
+ *                                  procedure expires; BLE_HS_FOREVER if
+ *                                  none remain.
+ */
+static int32_t
 ble_l2cap_sig_extract_expired(struct ble_l2cap_sig_proc_list *dst_list)
 {
     struct ble_l2cap_sig_proc *proc;
     struct ble_l2cap_sig_proc *prev;
     struct ble_l2cap_sig_proc *next;
-    uint32_t now;
+    int32_t next_exp_in;
     int32_t time_diff;
+    uint32_t now;
 
     now = os_time_get();
     STAILQ_INIT(dst_list);
+    next_exp_in = BLE_HS_FOREVER;
 
     ble_hs_lock();
 
@@ -554,18 +1146,29 @@ ble_l2cap_sig_extract_expired(struct ble_l2cap_sig_proc_list *dst_list)
                 STAILQ_REMOVE_AFTER(&ble_l2cap_sig_procs, prev, next);
             }
             STAILQ_INSERT_TAIL(dst_list, proc, next);
+        } else {
+            if (-time_diff < next_exp_in) {
+                next_exp_in = -time_diff;
+            }
+            prev = proc;
         }
 
         proc = next;
     }
 
     ble_hs_unlock();
+
+    return next_exp_in;
 }
 
 void
 ble_l2cap_sig_conn_broken(uint16_t conn_handle, int reason)
 {
     struct ble_l2cap_sig_proc *proc;
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    uint16_t cid;
+    uint8_t op;
 
     /* If there was a connection update in progress, indicate to the
      * application that it did not complete.
@@ -578,41 +1181,102 @@ ble_l2cap_sig_conn_broken(uint16_t conn_handle, int reason)
         ble_l2cap_sig_update_call_cb(proc, reason);
         ble_l2cap_sig_proc_free(proc);
     }
+
+    /* Fail pending channel establishments and teardowns... */
+    for (op = BLE_L2CAP_SIG_PROC_OP_CONNECT;
+         op <= BLE_L2CAP_SIG_PROC_OP_DISCONNECT;
+         op++) {
+
+        while (1) {
+            proc = ble_l2cap_sig_proc_extract(conn_handle, op, 0);
+            if (proc == NULL) {
+                break;
+            }
+
+            ble_l2cap_sig_proc_fail(proc, reason);
+            ble_l2cap_sig_proc_free(proc);
+        }
+    }
+
+    /* ...and close the remaining open channels. */
+    while (1) {
+        ble_hs_lock();
+
+        conn = ble_hs_conn_find(conn_handle);
+        if (conn == NULL) {
+            chan = NULL;
+        } else {
+            chan = ble_l2cap_coc_chan_first(conn);
+        }
+        cid = chan != NULL ? chan->blc_cid : 0;
+
+        ble_hs_unlock();
+
+        if (cid == 0) {
+            break;
+        }
+
+        ble_l2cap_sig_coc_remove(conn_handle, cid,
+                                 BLE_L2CAP_COC_EVENT_DISCONNECT, 0);
+    }
 }
 
 /**
- * Applies periodic checks and actions to all active procedures.
+ * Times out expired procedures.
  *
  * All procedures that have been expecting a response for longer than 30
  * seconds are aborted and their corresponding connection is terminated.
  *
- * Called by the heartbeat timer; executed at least once a second.
+ * Called by the heartbeat timer when a signalling deadline may have expired.
  *
  * @return                      The number of ticks until this function should
- *                                  be called again; currently always
- *                                  UINT32_MAX.
+ *                                  be called again; BLE_HS_FOREVER if no
+ *                                  procedures are pending.
  */
 int32_t
 ble_l2cap_sig_heartbeat(void)
 {
     struct ble_l2cap_sig_proc_list temp_list;
     struct ble_l2cap_sig_proc *proc;
+    int32_t ticks_until_exp;
 
     /* Remove timed-out procedures from the main list and insert them into a
      * temporary list.
      */
-    ble_l2cap_sig_extract_expired(&temp_list);
+    ticks_until_exp = ble_l2cap_sig_extract_expired(&temp_list);
 
     /* Report a failure for each timed out procedure. */
     while ((proc = STAILQ_FIRST(&temp_list)) != NULL) {
         STATS_INC(ble_l2cap_stats, proc_timeout);
-        ble_l2cap_sig_update_call_cb(proc, BLE_HS_ETIMEOUT);
+        ble_l2cap_sig_proc_fail(proc, BLE_HS_ETIMEOUT);
 
         STAILQ_REMOVE_HEAD(&temp_list, next);
         ble_l2cap_sig_proc_free(proc);
     }
 
-    return BLE_HS_FOREVER;
+    return ticks_until_exp;
+}
+
+int
+ble_l2cap_sig_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                       struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *live_pool;
+
+    if (idx != 0) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        live_pool = &ble_l2cap_sig_proc_pool;
+    } else {
+        live_pool = NULL;
+    }
+
+    ble_hs_mem_pool_fill(out_pool, "ble_l2cap_sig_proc_pool", cfg->max_l2cap_sig_procs,
+                         sizeof (struct ble_l2cap_sig_proc), live_pool);
+    return 0;
 }
 
 int
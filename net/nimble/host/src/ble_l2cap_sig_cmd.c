@@ -262,3 +262,223 @@ ble_l2cap_sig_update_rsp_tx(struct ble_hs_conn *conn,
 
     return 0;
 }
+
+static void
+ble_l2cap_sig_coc_req_swap(struct ble_l2cap_sig_coc_req *dst,
+                           struct ble_l2cap_sig_coc_req *src)
+{
+    dst->psm = TOFROMLE16(src->psm);
+    dst->scid = TOFROMLE16(src->scid);
+    dst->mtu = TOFROMLE16(src->mtu);
+    dst->mps = TOFROMLE16(src->mps);
+    dst->credits = TOFROMLE16(src->credits);
+}
+
+void
+ble_l2cap_sig_coc_req_parse(void *payload, int len,
+                            struct ble_l2cap_sig_coc_req *dst)
+{
+    BLE_HS_DBG_ASSERT(len >= BLE_L2CAP_SIG_COC_REQ_SZ);
+    ble_l2cap_sig_coc_req_swap(dst, payload);
+}
+
+void
+ble_l2cap_sig_coc_req_write(void *payload, int len,
+                            struct ble_l2cap_sig_coc_req *src)
+{
+    BLE_HS_DBG_ASSERT(len >= BLE_L2CAP_SIG_COC_REQ_SZ);
+    ble_l2cap_sig_coc_req_swap(payload, src);
+}
+
+int
+ble_l2cap_sig_coc_req_tx(struct ble_hs_conn *conn,
+                         struct ble_l2cap_chan *chan, uint8_t id,
+                         struct ble_l2cap_sig_coc_req *req)
+{
+    struct os_mbuf *txom;
+    void *payload_buf;
+    int rc;
+
+    rc = ble_l2cap_sig_init_cmd(BLE_L2CAP_SIG_OP_CREDIT_CONNECT_REQ, id,
+                                BLE_L2CAP_SIG_COC_REQ_SZ, &txom,
+                                &payload_buf);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_l2cap_sig_coc_req_write(payload_buf, BLE_L2CAP_SIG_COC_REQ_SZ, req);
+
+    rc = ble_l2cap_tx(conn, chan, txom);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return 0;
+}
+
+static void
+ble_l2cap_sig_coc_rsp_swap(struct ble_l2cap_sig_coc_rsp *dst,
+                           struct ble_l2cap_sig_coc_rsp *src)
+{
+    dst->dcid = TOFROMLE16(src->dcid);
+    dst->mtu = TOFROMLE16(src->mtu);
+    dst->mps = TOFROMLE16(src->mps);
+    dst->credits = TOFROMLE16(src->credits);
+    dst->result = TOFROMLE16(src->result);
+}
+
+void
+ble_l2cap_sig_coc_rsp_parse(void *payload, int len,
+                            struct ble_l2cap_sig_coc_rsp *dst)
+{
+    BLE_HS_DBG_ASSERT(len >= BLE_L2CAP_SIG_COC_RSP_SZ);
+    ble_l2cap_sig_coc_rsp_swap(dst, payload);
+}
+
+void
+ble_l2cap_sig_coc_rsp_write(void *payload, int len,
+                            struct ble_l2cap_sig_coc_rsp *src)
+{
+    BLE_HS_DBG_ASSERT(len >= BLE_L2CAP_SIG_COC_RSP_SZ);
+    ble_l2cap_sig_coc_rsp_swap(payload, src);
+}
+
+int
+ble_l2cap_sig_coc_rsp_tx(struct ble_hs_conn *conn,
+                         struct ble_l2cap_chan *chan, uint8_t id,
+                         struct ble_l2cap_sig_coc_rsp *rsp)
+{
+    struct os_mbuf *txom;
+    void *payload_buf;
+    int rc;
+
+    rc = ble_l2cap_sig_init_cmd(BLE_L2CAP_SIG_OP_CREDIT_CONNECT_RSP, id,
+                                BLE_L2CAP_SIG_COC_RSP_SZ, &txom,
+                                &payload_buf);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_l2cap_sig_coc_rsp_write(payload_buf, BLE_L2CAP_SIG_COC_RSP_SZ, rsp);
+
+    rc = ble_l2cap_tx(conn, chan, txom);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return 0;
+}
+
+static void
+ble_l2cap_sig_le_credits_swap(struct ble_l2cap_sig_le_credits *dst,
+                              struct ble_l2cap_sig_le_credits *src)
+{
+    dst->cid = TOFROMLE16(src->cid);
+    dst->credits = TOFROMLE16(src->credits);
+}
+
+void
+ble_l2cap_sig_le_credits_parse(void *payload, int len,
+                               struct ble_l2cap_sig_le_credits *dst)
+{
+    BLE_HS_DBG_ASSERT(len >= BLE_L2CAP_SIG_LE_CREDITS_SZ);
+    ble_l2cap_sig_le_credits_swap(dst, payload);
+}
+
+void
+ble_l2cap_sig_le_credits_write(void *payload, int len,
+                               struct ble_l2cap_sig_le_credits *src)
+{
+    BLE_HS_DBG_ASSERT(len >= BLE_L2CAP_SIG_LE_CREDITS_SZ);
+    ble_l2cap_sig_le_credits_swap(payload, src);
+}
+
+int
+ble_l2cap_sig_le_credits_tx(struct ble_hs_conn *conn,
+                            struct ble_l2cap_chan *chan,
+                            uint16_t cid, uint16_t credits)
+{
+    struct ble_l2cap_sig_le_credits cmd;
+    struct os_mbuf *txom;
+    void *payload_buf;
+    int rc;
+
+    rc = ble_l2cap_sig_init_cmd(BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT,
+                                ble_l2cap_sig_next_id(),
+                                BLE_L2CAP_SIG_LE_CREDITS_SZ, &txom,
+                                &payload_buf);
+    if (rc != 0) {
+        return rc;
+    }
+
+    cmd.cid = cid;
+    cmd.credits = credits;
+    ble_l2cap_sig_le_credits_write(payload_buf, BLE_L2CAP_SIG_LE_CREDITS_SZ,
+                                   &cmd);
+
+    rc = ble_l2cap_tx(conn, chan, txom);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return 0;
+}
+
+static void
+ble_l2cap_sig_disconn_swap(struct ble_l2cap_sig_disconn *dst,
+                           struct ble_l2cap_sig_disconn *src)
+{
+    dst->dcid = TOFROMLE16(src->dcid);
+    dst->scid = TOFROMLE16(src->scid);
+}
+
+void
+ble_l2cap_sig_disconn_parse(void *payload, int len,
+                            struct ble_l2cap_sig_disconn *dst)
+{
+    BLE_HS_DBG_ASSERT(len >= BLE_L2CAP_SIG_DISCONN_REQ_SZ);
+    ble_l2cap_sig_disconn_swap(dst, payload);
+}
+
+void
+ble_l2cap_sig_disconn_write(void *payload, int len,
+                            struct ble_l2cap_sig_disconn *src)
+{
+    BLE_HS_DBG_ASSERT(len >= BLE_L2CAP_SIG_DISCONN_REQ_SZ);
+    ble_l2cap_sig_disconn_swap(payload, src);
+}
+
+/**
+ * Sends a disconnection request or response; both carry the same payload.
+ *
+ * @param op                    BLE_L2CAP_SIG_OP_DISCONN_REQ or
+ *                                  BLE_L2CAP_SIG_OP_DISCONN_RSP.
+ */
+int
+ble_l2cap_sig_disconn_tx(struct ble_hs_conn *conn,
+                         struct ble_l2cap_chan *chan, uint8_t op,
+                         uint8_t id, uint16_t dcid, uint16_t scid)
+{
+    struct ble_l2cap_sig_disconn cmd;
+    struct os_mbuf *txom;
+    void *payload_buf;
+    int rc;
+
+    rc = ble_l2cap_sig_init_cmd(op, id, BLE_L2CAP_SIG_DISCONN_REQ_SZ, &txom,
+                                &payload_buf);
+    if (rc != 0) {
+        return rc;
+    }
+
+    cmd.dcid = dcid;
+    cmd.scid = scid;
+    ble_l2cap_sig_disconn_write(payload_buf, BLE_L2CAP_SIG_DISCONN_REQ_SZ,
+                                &cmd);
+
+    rc = ble_l2cap_tx(conn, chan, txom);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return 0;
+}
@@ -20,6 +20,9 @@
 #ifndef H_BLE_L2CAP_SIG_
 #define H_BLE_L2CAP_SIG_
 
+struct ble_hs_cfg;
+struct ble_hs_mem_pool;
+
 #define BLE_L2CAP_SIG_MTU           100  /* This is our own default. */
 
 #define BLE_L2CAP_SIG_HDR_SZ                4
@@ -50,6 +53,38 @@ struct ble_l2cap_sig_update_rsp {
 #define BLE_L2CAP_SIG_UPDATE_RSP_RESULT_ACCEPT  0x0000
 #define BLE_L2CAP_SIG_UPDATE_RSP_RESULT_REJECT  0x0001
 
+#define BLE_L2CAP_SIG_COC_REQ_SZ            10
+struct ble_l2cap_sig_coc_req {
+    uint16_t psm;
+    uint16_t scid;
+    uint16_t mtu;
+    uint16_t mps;
+    uint16_t credits;
+} __attribute__((packed));
+
+#define BLE_L2CAP_SIG_COC_RSP_SZ            10
+struct ble_l2cap_sig_coc_rsp {
+    uint16_t dcid;
+    uint16_t mtu;
+    uint16_t mps;
+    uint16_t credits;
+    uint16_t result;
+} __attribute__((packed));
+
+#define BLE_L2CAP_SIG_LE_CREDITS_SZ         4
+struct ble_l2cap_sig_le_credits {
+    uint16_t cid;
+    uint16_t credits;
+} __attribute__((packed));
+
+#define BLE_L2CAP_SIG_DISCONN_REQ_SZ        4
+#define BLE_L2CAP_SIG_DISCONN_RSP_SZ        4
+struct ble_l2cap_sig_disconn {
+    uint16_t dcid;
+    uint16_t scid;
+} __attribute__((packed));
+
+uint8_t ble_l2cap_sig_next_id(void);
 int ble_l2cap_sig_init_cmd(uint8_t op, uint8_t id, uint8_t payload_len,
                            struct os_mbuf **out_om, void **out_payload_buf);
 void ble_l2cap_sig_hdr_parse(void *payload, uint16_t len,
@@ -75,6 +110,35 @@ int ble_l2cap_sig_update_rsp_tx(struct ble_hs_conn *conn,
                                 struct ble_l2cap_chan *chan, uint8_t id,
                                 uint16_t result);
 
+void ble_l2cap_sig_coc_req_parse(void *payload, int len,
+                                 struct ble_l2cap_sig_coc_req *dst);
+void ble_l2cap_sig_coc_req_write(void *payload, int len,
+                                 struct ble_l2cap_sig_coc_req *src);
+int ble_l2cap_sig_coc_req_tx(struct ble_hs_conn *conn,
+                             struct ble_l2cap_chan *chan, uint8_t id,
+                             struct ble_l2cap_sig_coc_req *req);
+void ble_l2cap_sig_coc_rsp_parse(void *payload, int len,
+                                 struct ble_l2cap_sig_coc_rsp *dst);
+void ble_l2cap_sig_coc_rsp_write(void *payload, int len,
+                                 struct ble_l2cap_sig_coc_rsp *src);
+int ble_l2cap_sig_coc_rsp_tx(struct ble_hs_conn *conn,
+                             struct ble_l2cap_chan *chan, uint8_t id,
+                             struct ble_l2cap_sig_coc_rsp *rsp);
+void ble_l2cap_sig_le_credits_parse(void *payload, int len,
+                                    struct ble_l2cap_sig_le_credits *dst);
+void ble_l2cap_sig_le_credits_write(void *payload, int len,
+                                    struct ble_l2cap_sig_le_credits *src);
+int ble_l2cap_sig_le_credits_tx(struct ble_hs_conn *conn,
+                                struct ble_l2cap_chan *chan,
+                                uint16_t cid, uint16_t credits);
+void ble_l2cap_sig_disconn_parse(void *payload, int len,
+                                 struct ble_l2cap_sig_disconn *dst);
+void ble_l2cap_sig_disconn_write(void *payload, int len,
+                                 struct ble_l2cap_sig_disconn *src);
+int ble_l2cap_sig_disconn_tx(struct ble_hs_conn *conn,
+                             struct ble_l2cap_chan *chan, uint8_t op,
+                             uint8_t id, uint16_t dcid, uint16_t scid);
+
 int ble_l2cap_sig_reject_invalid_cid_tx(struct ble_hs_conn *conn,
                                         struct ble_l2cap_chan *chan,
                                         uint8_t id,
@@ -83,6 +147,8 @@ int ble_l2cap_sig_reject_invalid_cid_tx(struct ble_hs_conn *conn,
 void ble_l2cap_sig_conn_broken(uint16_t conn_handle, int reason);
 int32_t ble_l2cap_sig_heartbeat(void);
 struct ble_l2cap_chan *ble_l2cap_sig_create_chan(void);
+int ble_l2cap_sig_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                           struct ble_hs_mem_pool *out_pool);
 int ble_l2cap_sig_init(void);
 
 #endif
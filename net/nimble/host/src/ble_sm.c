@@ -259,7 +259,7 @@ ble_sm_gen_pair_rand(uint8_t *pair_rand)
     }
 #endif
 
-    rc = ble_hs_hci_util_rand(pair_rand, 16);
+    rc = ble_hs_rand(pair_rand, 16);
     if (rc != 0) {
         return rc;
     }
@@ -280,7 +280,7 @@ ble_sm_gen_ediv(uint16_t *ediv)
     }
 #endif
 
-    rc = ble_hs_hci_util_rand(ediv, sizeof *ediv);
+    rc = ble_hs_rand(ediv, sizeof *ediv);
     if (rc != 0) {
         return rc;
     }
@@ -301,7 +301,7 @@ ble_sm_gen_master_id_rand(uint64_t *master_id_rand)
     }
 #endif
 
-    rc = ble_hs_hci_util_rand(master_id_rand, sizeof *master_id_rand);
+    rc = ble_hs_rand(master_id_rand, sizeof *master_id_rand);
     if (rc != 0) {
         return rc;
     }
@@ -323,7 +323,7 @@ ble_sm_gen_ltk(struct ble_sm_proc *proc, uint8_t *ltk)
     }
 #endif
 
-    rc = ble_hs_hci_util_rand(ltk, 16);
+    rc = ble_hs_rand(ltk, 16);
     if (rc != 0) {
         return rc;
     }
@@ -345,7 +345,7 @@ ble_sm_gen_csrk(struct ble_sm_proc *proc, uint8_t *csrk)
     }
 #endif
 
-    rc = ble_hs_hci_util_rand(csrk, 16);
+    rc = ble_hs_rand(csrk, 16);
     if (rc != 0) {
         return rc;
     }
@@ -380,6 +380,7 @@ ble_sm_proc_set_timer(struct ble_sm_proc *proc)
 {
     /* Set a timeout of 30 seconds. */
     proc->exp_os_ticks = os_time_get() + BLE_SM_TIMEOUT_OS_TICKS;
+    ble_hs_heartbeat_sched(BLE_SM_TIMEOUT_OS_TICKS);
 }
 
 static ble_sm_rx_fn *
@@ -633,17 +634,26 @@ ble_sm_insert(struct ble_sm_proc *proc)
     STAILQ_INSERT_HEAD(&ble_sm_procs, proc, next);
 }
 
-static void
+/**
+ * Removes all expired procedures and inserts them into the specified list.
+ *
+ * @return                      The number of ticks until the next remaining
+ *                                  procedure expires; BLE_HS_FOREVER if
+ *                                  none remain.
+ */
+static int32_t
 ble_sm_extract_expired(struct ble_sm_proc_list *dst_list)
 {
     struct ble_sm_proc *proc;
     struct ble_sm_proc *prev;
     struct ble_sm_proc *next;
-    uint32_t now;
+    int32_t next_exp_in;
     int32_t time_diff;
+    uint32_t now;
 
     now = os_time_get();
     STAILQ_INIT(dst_list);
+    next_exp_in = BLE_HS_FOREVER;
 
     ble_hs_lock();
 
@@ -660,15 +670,21 @@ ble_sm_extract_expired(struct ble_sm_proc_list *dst_list)
                 STAILQ_REMOVE_AFTER(&ble_sm_procs, prev, next);
             }
             STAILQ_INSERT_HEAD(dst_list, proc, next);
+        } else {
+            if (-time_diff < next_exp_in) {
+                next_exp_in = -time_diff;
+            }
+            prev = proc;
         }
 
-        prev = proc;
         proc = next;
     }
 
     ble_sm_dbg_assert_no_cycles();
 
     ble_hs_unlock();
+
+    return next_exp_in;
 }
 
 static void
@@ -1219,6 +1235,206 @@ ble_sm_ltk_req_rx(struct hci_le_lt_key_req *evt)
     return 0;
 }
 
+/*****************************************************************************
+ * $ltk index                                                                *
+ *****************************************************************************/
+
+#if NIMBLE_OPT_SM_LTK_INDEX_SIZE > 0
+
+/**
+ * Our security material for recently seen bonded peers, one entry per peer.
+ * Entries are added when our keys are written to or read from the store, and
+ * when a bonded peer connects to us (ble_sm_ltk_index_prime()).  All writes
+ * and deletes of our keys go through ble_store, which keeps the index
+ * coherent.  When full, entries are replaced in round-robin order.
+ */
+static struct ble_store_value_sec
+    ble_sm_ltk_index[NIMBLE_OPT_SM_LTK_INDEX_SIZE];
+static uint8_t ble_sm_ltk_index_num;
+static uint8_t ble_sm_ltk_index_next;
+
+/**
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ */
+static int
+ble_sm_ltk_index_find(uint8_t peer_addr_type, const uint8_t *peer_addr)
+{
+    struct ble_store_value_sec *entry;
+    int i;
+
+    for (i = 0; i < ble_sm_ltk_index_num; i++) {
+        entry = ble_sm_ltk_index + i;
+        if (entry->peer_addr_type == peer_addr_type &&
+            memcmp(entry->peer_addr, peer_addr, 6) == 0) {
+
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Lock restrictions: Caller must lock ble_hs_mutex.
+ */
+static void
+ble_sm_ltk_index_remove(int idx)
+{
+    ble_sm_ltk_index_num--;
+    memmove(ble_sm_ltk_index + idx, ble_sm_ltk_index + idx + 1,
+            (ble_sm_ltk_index_num - idx) * sizeof ble_sm_ltk_index[0]);
+    ble_sm_ltk_index_next = 0;
+}
+
+/**
+ * Looks up our LTK for an encryption restore.  Only lookups by peer address
+ * and EDIV/Rand (as done when the controller requests an LTK) are answered
+ * from the index.
+ *
+ * @return                      0 on success; BLE_HS_ENOENT if the index can't
+ *                                  answer the lookup.
+ */
+int
+ble_sm_ltk_index_read(const struct ble_store_key_sec *key_sec,
+                      struct ble_store_value_sec *value_sec)
+{
+    struct ble_store_value_sec *entry;
+    int idx;
+    int rc;
+
+    if (!key_sec->ediv_rand_present ||
+        key_sec->peer_addr_type == BLE_STORE_ADDR_TYPE_NONE ||
+        key_sec->idx != 0) {
+
+        return BLE_HS_ENOENT;
+    }
+
+    ble_hs_lock();
+
+    idx = ble_sm_ltk_index_find(key_sec->peer_addr_type, key_sec->peer_addr);
+    if (idx == -1) {
+        rc = BLE_HS_ENOENT;
+    } else {
+        entry = ble_sm_ltk_index + idx;
+        if (entry->ediv != key_sec->ediv ||
+            entry->rand_num != key_sec->rand_num) {
+
+            rc = BLE_HS_ENOENT;
+        } else {
+            *value_sec = *entry;
+            rc = 0;
+        }
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Adds or replaces the index entry of the peer the specified security
+ * material belongs to.  Material without an LTK is not indexed.
+ */
+void
+ble_sm_ltk_index_write(const struct ble_store_value_sec *value_sec)
+{
+    int idx;
+
+    if (value_sec->peer_addr_type == BLE_STORE_ADDR_TYPE_NONE) {
+        return;
+    }
+
+    ble_hs_lock();
+
+    idx = ble_sm_ltk_index_find(value_sec->peer_addr_type,
+                                value_sec->peer_addr);
+    if (!value_sec->ltk_present) {
+        if (idx != -1) {
+            ble_sm_ltk_index_remove(idx);
+        }
+    } else {
+        if (idx == -1) {
+            if (ble_sm_ltk_index_num < NIMBLE_OPT_SM_LTK_INDEX_SIZE) {
+                idx = ble_sm_ltk_index_num++;
+            } else {
+                idx = ble_sm_ltk_index_next;
+                ble_sm_ltk_index_next =
+                    (ble_sm_ltk_index_next + 1) % NIMBLE_OPT_SM_LTK_INDEX_SIZE;
+            }
+        }
+        ble_sm_ltk_index[idx] = *value_sec;
+    }
+
+    ble_hs_unlock();
+}
+
+/**
+ * Removes the index entries matching the specified store key.  A key without
+ * a peer address matches every entry.
+ */
+void
+ble_sm_ltk_index_delete(const struct ble_store_key_sec *key_sec)
+{
+    int idx;
+
+    ble_hs_lock();
+
+    if (key_sec->peer_addr_type == BLE_STORE_ADDR_TYPE_NONE) {
+        ble_sm_ltk_index_num = 0;
+        ble_sm_ltk_index_next = 0;
+    } else {
+        idx = ble_sm_ltk_index_find(key_sec->peer_addr_type,
+                                    key_sec->peer_addr);
+        if (idx != -1) {
+            ble_sm_ltk_index_remove(idx);
+        }
+    }
+
+    ble_hs_unlock();
+}
+
+/**
+ * Loads our LTK for the peer on the specified connection into the index, so
+ * that the LTK request the controller issues if the peer restores encryption
+ * is answered without a store lookup.  Only done when we are the slave; as
+ * master we supply the key ourselves when initiating encryption.
+ */
+void
+ble_sm_ltk_index_prime(uint16_t conn_handle)
+{
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    struct ble_hs_conn_addrs addrs;
+    struct ble_hs_conn *conn;
+    int rc;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn == NULL || conn->bhc_flags & BLE_HS_CONN_F_MASTER) {
+        rc = BLE_HS_ENOENT;
+    } else {
+        ble_hs_conn_addrs(conn, &addrs);
+        memset(&key_sec, 0, sizeof key_sec);
+        key_sec.peer_addr_type = addrs.peer_id_addr_type;
+        memcpy(key_sec.peer_addr, addrs.peer_id_addr, 6);
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    if (rc != 0) {
+        return;
+    }
+
+    rc = ble_store_read_our_sec(&key_sec, &value_sec);
+    if (rc == 0) {
+        ble_sm_ltk_index_write(&value_sec);
+    }
+}
+
+#endif
+
 /*****************************************************************************
  * $random                                                                   *
  *****************************************************************************/
@@ -2012,27 +2228,28 @@ ble_sm_fail_rx(uint16_t conn_handle, uint8_t op, struct os_mbuf **om,
  *****************************************************************************/
 
 /**
- * Applies periodic checks and actions to all active procedures.
+ * Times out expired procedures.
  *
  * All procedures that have been expecting a response for longer than 30
  * seconds are aborted.
  *
- * Called by the heartbeat timer; executed at least once a second.
+ * Called by the heartbeat timer when an SM deadline may have expired.
  *
  * @return                      The number of ticks until this function should
- *                                  be called again; currently always
- *                                  UINT32_MAX.
+ *                                  be called again; BLE_HS_FOREVER if no
+ *                                  procedures are pending.
  */
 int32_t
 ble_sm_heartbeat(void)
 {
     struct ble_sm_proc_list exp_list;
     struct ble_sm_proc *proc;
+    int32_t ticks_until_exp;
 
     /* Remove all timed out procedures and insert them into a temporary
      * list.
      */
-    ble_sm_extract_expired(&exp_list);
+    ticks_until_exp = ble_sm_extract_expired(&exp_list);
 
     /* Notify application of each failure and free the corresponding procedure
      * object.
@@ -2046,7 +2263,7 @@ ble_sm_heartbeat(void)
         ble_sm_proc_free(proc);
     }
 
-    return BLE_HS_FOREVER;
+    return ticks_until_exp;
 }
 
 /**
@@ -2181,7 +2398,7 @@ ble_sm_enc_initiate(uint16_t conn_handle, const uint8_t *ltk, uint16_t ediv,
 }
 
 static int
-ble_sm_rx(uint16_t conn_handle, struct os_mbuf **om)
+ble_sm_rx(uint16_t conn_handle, uint16_t cid, struct os_mbuf **om)
 {
     struct ble_sm_result res;
     ble_sm_rx_fn *rx_cb;
@@ -2340,6 +2557,28 @@ ble_sm_free_mem(void)
     free(ble_sm_proc_mem);
 }
 
+int
+ble_sm_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *live_pool;
+
+    if (idx != 0) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        live_pool = &ble_sm_proc_pool;
+    } else {
+        live_pool = NULL;
+    }
+
+    ble_hs_mem_pool_fill(out_pool, "ble_sm_proc_pool", cfg->max_l2cap_sm_procs,
+                         sizeof (struct ble_sm_proc), live_pool);
+    return 0;
+}
+
 int
 ble_sm_init(void)
 {
@@ -2349,6 +2588,11 @@ ble_sm_init(void)
 
     STAILQ_INIT(&ble_sm_procs);
 
+#if NIMBLE_OPT_SM_LTK_INDEX_SIZE > 0
+    ble_sm_ltk_index_num = 0;
+    ble_sm_ltk_index_next = 0;
+#endif
+
     if (ble_hs_cfg.max_l2cap_sm_procs > 0) {
         ble_sm_proc_mem = malloc(
             OS_MEMPOOL_BYTES(ble_hs_cfg.max_l2cap_sm_procs,
@@ -2367,7 +2611,10 @@ ble_sm_init(void)
         }
     }
 
-    ble_sm_sc_init();
+    rc = ble_sm_sc_init();
+    if (rc != 0) {
+        goto err;
+    }
 
     return 0;
 
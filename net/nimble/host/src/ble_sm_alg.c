@@ -21,10 +21,8 @@
 #include <inttypes.h>
 #include <string.h>
 #include "mbedtls/aes.h"
-#include "tinycrypt/aes.h"
 #include "tinycrypt/constants.h"
 #include "tinycrypt/utils.h"
-#include "tinycrypt/cmac_mode.h"
 #include "tinycrypt/ecc_dh.h"
 #include "nimble/ble.h"
 #include "nimble/nimble_opt.h"
@@ -33,6 +31,8 @@
 #if NIMBLE_OPT(SM)
 
 static mbedtls_aes_context ble_sm_alg_ctxt;
+static uint8_t ble_sm_alg_ctxt_key[16];
+static int ble_sm_alg_ctxt_key_valid;
 
 /* based on Core Specification 4.2 Vol 3. Part H 2.3.5.6.1 */
 static const uint32_t ble_sm_alg_dbg_priv_key[8] = {
@@ -58,26 +58,62 @@ ble_sm_alg_xor_128(uint8_t *p, uint8_t *q, uint8_t *r)
     }
 }
 
+/**
+ * Encrypts a single block with AES-128.  The configured hardware cipher is
+ * preferred; the software implementation is used if there is none or if it
+ * fails.  All buffers are in FIPS-197 byte order.
+ */
 static int
-ble_sm_alg_encrypt(uint8_t *key, uint8_t *plaintext, uint8_t *enc_data)
+ble_sm_alg_aes128(const uint8_t *key, const uint8_t *plaintext,
+                  uint8_t *enc_data)
 {
-    mbedtls_aes_init(&ble_sm_alg_ctxt);
-    uint8_t tmp[16];
     int rc;
 
-    swap_buf(tmp, key, 16);
+    if (ble_hs_cfg.sm_aes_cb != NULL) {
+        rc = ble_hs_cfg.sm_aes_cb(key, plaintext, enc_data);
+        if (rc == 0) {
+            return 0;
+        }
+    }
+
+    /* Avoid recomputing the key schedule when consecutive blocks use the same
+     * key, as every AES-CMAC invocation does.
+     */
+    if (!ble_sm_alg_ctxt_key_valid ||
+        memcmp(ble_sm_alg_ctxt_key, key, 16) != 0) {
+
+        mbedtls_aes_init(&ble_sm_alg_ctxt);
+        rc = mbedtls_aes_setkey_enc(&ble_sm_alg_ctxt, key, 128);
+        if (rc != 0) {
+            ble_sm_alg_ctxt_key_valid = 0;
+            return BLE_HS_EUNKNOWN;
+        }
+        memcpy(ble_sm_alg_ctxt_key, key, 16);
+        ble_sm_alg_ctxt_key_valid = 1;
+    }
 
-    rc = mbedtls_aes_setkey_enc(&ble_sm_alg_ctxt, tmp, 128);
+    rc = mbedtls_aes_crypt_ecb(&ble_sm_alg_ctxt, MBEDTLS_AES_ENCRYPT,
+                               plaintext, enc_data);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
 
+    return 0;
+}
+
+static int
+ble_sm_alg_encrypt(uint8_t *key, uint8_t *plaintext, uint8_t *enc_data)
+{
+    uint8_t tmp_key[16];
+    uint8_t tmp[16];
+    int rc;
+
+    swap_buf(tmp_key, key, 16);
     swap_buf(tmp, plaintext, 16);
 
-    rc = mbedtls_aes_crypt_ecb(&ble_sm_alg_ctxt, MBEDTLS_AES_ENCRYPT,
-                               tmp, enc_data);
+    rc = ble_sm_alg_aes128(tmp_key, tmp, enc_data);
     if (rc != 0) {
-        return BLE_HS_EUNKNOWN;
+        return rc;
     }
 
     swap_in_place(enc_data, 16);
@@ -85,8 +121,28 @@ ble_sm_alg_encrypt(uint8_t *key, uint8_t *plaintext, uint8_t *enc_data)
     return 0;
 }
 
+/**
+ * Derives a CMAC subkey: left shift by one bit, then conditionally xor with
+ * the constant Rb (RFC 4493, section 2.3).
+ */
+static void
+ble_sm_alg_cmac_subkey(const uint8_t *in, uint8_t *out)
+{
+    int i;
+
+    for (i = 0; i < 15; i++) {
+        out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+    }
+    out[15] = in[15] << 1;
+
+    if (in[0] & 0x80) {
+        out[15] ^= 0x87;
+    }
+}
+
 /**
  * Cypher based Message Authentication Code (CMAC) with AES 128 bit
+ * (RFC 4493).
  *
  * @param key                   128-bit key.
  * @param in                    Message to be authenticated.
@@ -97,19 +153,53 @@ static int
 ble_sm_alg_aes_cmac(const uint8_t *key, const uint8_t *in, size_t len,
                     uint8_t *out)
 {
-    struct tc_aes_key_sched_struct sched;
-    struct tc_cmac_struct state;
+    uint8_t last[16];
+    uint8_t k1[16];
+    uint8_t k2[16];
+    uint8_t x[16];
+    uint8_t y[16];
+    size_t num_blocks;
+    size_t rem;
+    size_t i;
+    int rc;
 
-    if (tc_cmac_setup(&state, key, &sched) == TC_FAIL) {
-        return BLE_HS_EUNKNOWN;
+    memset(x, 0, sizeof x);
+    rc = ble_sm_alg_aes128(key, x, k2);
+    if (rc != 0) {
+        return rc;
+    }
+    ble_sm_alg_cmac_subkey(k2, k1);
+    ble_sm_alg_cmac_subkey(k1, k2);
+
+    num_blocks = (len + 15) / 16;
+    rem = len % 16;
+
+    if (num_blocks != 0 && rem == 0) {
+        /* Complete final block. */
+        ble_sm_alg_xor_128((uint8_t *)in + (num_blocks - 1) * 16, k1, last);
+    } else {
+        /* Padded final block. */
+        if (num_blocks == 0) {
+            num_blocks = 1;
+        }
+        memset(last, 0, sizeof last);
+        memcpy(last, in + (num_blocks - 1) * 16, rem);
+        last[rem] = 0x80;
+        ble_sm_alg_xor_128(last, k2, last);
     }
 
-    if (tc_cmac_update(&state, in, len) == TC_FAIL) {
-        return BLE_HS_EUNKNOWN;
+    for (i = 0; i < num_blocks - 1; i++) {
+        ble_sm_alg_xor_128(x, (uint8_t *)in + i * 16, y);
+        rc = ble_sm_alg_aes128(key, y, x);
+        if (rc != 0) {
+            return rc;
+        }
     }
 
-    if (tc_cmac_final(out, &state) == TC_FAIL) {
-        return BLE_HS_EUNKNOWN;
+    ble_sm_alg_xor_128(x, last, y);
+    rc = ble_sm_alg_aes128(key, y, out);
+    if (rc != 0) {
+        return rc;
     }
 
     return 0;
@@ -420,6 +510,17 @@ ble_sm_alg_gen_dhkey(uint8_t *peer_pub_key_x, uint8_t *peer_pub_key_y,
 {
     uint32_t dh[8];
     EccPoint pk;
+    int rc;
+
+    if (ble_hs_cfg.sm_ecc_gen_dhkey_cb != NULL) {
+        rc = ble_hs_cfg.sm_ecc_gen_dhkey_cb(peer_pub_key_x, peer_pub_key_y,
+                                            (uint8_t *)our_priv_key,
+                                            out_dhkey);
+        if (rc != 0) {
+            return BLE_HS_EUNKNOWN;
+        }
+        return 0;
+    }
 
     memcpy(pk.x, peer_pub_key_x, 32);
     memcpy(pk.y, peer_pub_key_y, 32);
@@ -448,8 +549,16 @@ ble_sm_alg_gen_key_pair(void *pub, uint32_t *priv)
     EccPoint pkey;
     int rc;
 
+    if (ble_hs_cfg.sm_ecc_gen_key_pair_cb != NULL) {
+        rc = ble_hs_cfg.sm_ecc_gen_key_pair_cb(pub, (uint8_t *)priv);
+        if (rc != 0) {
+            return BLE_HS_EUNKNOWN;
+        }
+        return 0;
+    }
+
     do {
-        rc = ble_hs_hci_util_rand(random, sizeof random);
+        rc = ble_hs_rand(random, sizeof random);
         if (rc != 0) {
             return rc;
         }
@@ -25,6 +25,8 @@
 #include "nimble/nimble_opt.h"
 
 struct ble_gap_sec_state;
+struct ble_hs_cfg;
+struct ble_hs_mem_pool;
 struct hci_le_lt_key_req;
 struct hci_encrypt_change;
 
@@ -219,6 +221,8 @@ struct ble_sm_dhkey_check {
 #define BLE_SM_PROC_F_AUTHENTICATED         0x08
 #define BLE_SM_PROC_F_SC                    0x10
 #define BLE_SM_PROC_F_BONDING               0x20
+#define BLE_SM_PROC_F_DHKEY_PENDING         0x40
+#define BLE_SM_PROC_F_RANDOM_PENDING        0x80
 
 #define BLE_SM_KE_F_ENC_INFO                0x01
 #define BLE_SM_KE_F_MASTER_ID               0x02
@@ -423,7 +427,11 @@ void ble_sm_sc_dhkey_check_exec(struct ble_sm_proc *proc,
 void ble_sm_sc_dhkey_check_rx(uint16_t conn_handle, uint8_t op,
                               struct os_mbuf **rxom,
                               struct ble_sm_result *res);
-void ble_sm_sc_init(void);
+void ble_sm_sc_pregen_keys(void);
+void ble_sm_sc_jobs_done(void);
+int ble_sm_sc_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                       struct ble_hs_mem_pool *out_pool);
+int ble_sm_sc_init(void);
 #else
 #define ble_sm_sc_io_action(proc) (BLE_SM_IOACT_NONE)
 #define ble_sm_sc_confirm_exec(proc, res)
@@ -433,7 +441,9 @@ void ble_sm_sc_init(void);
 #define ble_sm_sc_public_key_rx(conn_handle, op, om, res)
 #define ble_sm_sc_dhkey_check_exec(proc, res, arg)
 #define ble_sm_sc_dhkey_check_rx(conn_handle, op, om, res)
-#define ble_sm_sc_init()
+#define ble_sm_sc_pregen_keys()
+#define ble_sm_sc_jobs_done()
+#define ble_sm_sc_init() 0
 
 #endif
 
@@ -458,8 +468,25 @@ int ble_sm_pair_initiate(uint16_t conn_handle);
 int ble_sm_slave_initiate(uint16_t conn_handle);
 int ble_sm_enc_initiate(uint16_t conn_handle, const uint8_t *ltk,
                         uint16_t ediv, uint64_t rand_val, int auth);
+int ble_sm_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                    struct ble_hs_mem_pool *out_pool);
 int ble_sm_init(void);
 
+struct ble_store_key_sec;
+struct ble_store_value_sec;
+#if NIMBLE_OPT_SM_LTK_INDEX_SIZE > 0
+int ble_sm_ltk_index_read(const struct ble_store_key_sec *key_sec,
+                          struct ble_store_value_sec *value_sec);
+void ble_sm_ltk_index_write(const struct ble_store_value_sec *value_sec);
+void ble_sm_ltk_index_delete(const struct ble_store_key_sec *key_sec);
+void ble_sm_ltk_index_prime(uint16_t conn_handle);
+#else
+#define ble_sm_ltk_index_read(key_sec, value_sec) BLE_HS_ENOENT
+#define ble_sm_ltk_index_write(value_sec)
+#define ble_sm_ltk_index_delete(key_sec)
+#define ble_sm_ltk_index_prime(conn_handle)
+#endif
+
 #define BLE_SM_LOG_CMD(is_tx, cmd_name, conn_handle, log_cb, cmd) \
     BLE_HS_LOG_CMD((is_tx), "sm", (cmd_name), (conn_handle), (log_cb), (cmd))
 
@@ -480,6 +507,14 @@ int ble_sm_init(void);
 
 #define ble_sm_init() 0
 
+#define ble_sm_ltk_index_read(key_sec, value_sec) BLE_HS_ENOENT
+#define ble_sm_ltk_index_write(value_sec)
+#define ble_sm_ltk_index_delete(key_sec)
+#define ble_sm_ltk_index_prime(conn_handle)
+
+#define ble_sm_sc_pregen_keys()
+#define ble_sm_sc_jobs_done()
+
 #endif
 
 #endif
@@ -17,8 +17,10 @@
  * under the License.
  */
 
+#include <stdlib.h>
 #include <string.h>
 
+#include "os/os.h"
 #include "nimble/nimble_opt.h"
 #include "host/ble_sm.h"
 #include "ble_hs_priv.h"
@@ -49,6 +51,60 @@ static union {
  */
 static uint8_t ble_sm_sc_keys_generated;
 
+#define BLE_SM_SC_JOB_KEY_PAIR      0
+#define BLE_SM_SC_JOB_DHKEY         1
+
+/**
+ * A P-256 computation handed to the SC task.  A job carries copies of its
+ * inputs, so the procedure it was started for may be freed (e.g., on
+ * disconnect) while the computation is in progress.
+ */
+struct ble_sm_sc_job {
+    STAILQ_ENTRY(ble_sm_sc_job) next;
+
+    uint8_t type;
+    uint16_t conn_handle;
+    int status;
+
+    struct ble_sm_public_key peer_pub_key;
+    uint32_t pub_key[16];
+    uint32_t priv_key[8];
+    uint8_t dhkey[32];
+};
+
+STAILQ_HEAD(ble_sm_sc_job_list, ble_sm_sc_job);
+
+static void *ble_sm_sc_job_mem;
+static struct os_mempool ble_sm_sc_job_pool;
+
+/**
+ * Jobs waiting for the SC task, and jobs the SC task has finished.  Both
+ * lists are shared between the SC task and the host parent task; they are
+ * protected by critical sections.
+ */
+static struct ble_sm_sc_job_list ble_sm_sc_jobs_pending;
+static struct ble_sm_sc_job_list ble_sm_sc_jobs_finished;
+
+static struct os_task ble_sm_sc_task;
+static os_stack_t *ble_sm_sc_stack;
+static struct os_eventq ble_sm_sc_evq;
+static uint8_t ble_sm_sc_task_started;
+
+/** OS event - wakes the SC task up to process pending jobs. */
+static struct os_event ble_sm_sc_event_job = {
+    .ev_type = OS_EVENT_T_PERUSER,
+    .ev_arg = NULL,
+};
+
+/** OS event - tells the host parent task that jobs have finished. */
+static struct os_event ble_sm_sc_event_done = {
+    .ev_type = BLE_HS_EVENT_SM_SC_DONE,
+    .ev_arg = NULL,
+};
+
+/** Whether a key pair is currently being generated by the SC task. */
+static uint8_t ble_sm_sc_keys_pending;
+
 /**
  * Create some shortened names for the passkey actions so that the table is
  * easier to read.
@@ -137,6 +193,304 @@ ble_sm_sc_io_action(struct ble_sm_proc *proc)
     return action;
 }
 
+/*****************************************************************************
+ * $task                                                                     *
+ *****************************************************************************/
+
+static struct ble_sm_sc_job *
+ble_sm_sc_job_alloc(uint8_t type, uint16_t conn_handle)
+{
+    struct ble_sm_sc_job *job;
+
+    if (!ble_sm_sc_task_started) {
+        return NULL;
+    }
+
+    job = os_memblock_get(&ble_sm_sc_job_pool);
+    if (job != NULL) {
+        memset(job, 0, sizeof *job);
+        job->type = type;
+        job->conn_handle = conn_handle;
+    }
+
+    return job;
+}
+
+static void
+ble_sm_sc_job_submit(struct ble_sm_sc_job *job)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    STAILQ_INSERT_TAIL(&ble_sm_sc_jobs_pending, job, next);
+    OS_EXIT_CRITICAL(sr);
+
+    os_eventq_put(&ble_sm_sc_evq, &ble_sm_sc_event_job);
+}
+
+static struct ble_sm_sc_job *
+ble_sm_sc_job_pop(struct ble_sm_sc_job_list *list)
+{
+    struct ble_sm_sc_job *job;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    job = STAILQ_FIRST(list);
+    if (job != NULL) {
+        STAILQ_REMOVE_HEAD(list, next);
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return job;
+}
+
+static void
+ble_sm_sc_job_run(struct ble_sm_sc_job *job)
+{
+    switch (job->type) {
+    case BLE_SM_SC_JOB_KEY_PAIR:
+        job->status = ble_sm_gen_pub_priv(job->pub_key, job->priv_key);
+        break;
+
+    case BLE_SM_SC_JOB_DHKEY:
+        job->status = ble_sm_alg_gen_dhkey(job->peer_pub_key.x,
+                                           job->peer_pub_key.y,
+                                           job->priv_key, job->dhkey);
+        break;
+
+    default:
+        BLE_HS_DBG_ASSERT(0);
+        job->status = BLE_HS_EUNKNOWN;
+        break;
+    }
+}
+
+/**
+ * Entry point of the SC task.  Runs jobs in submission order and hands each
+ * one back to the host parent task as soon as it finishes.
+ */
+static void
+ble_sm_sc_task_handler(void *arg)
+{
+    struct ble_sm_sc_job *job;
+    os_sr_t sr;
+
+    while (1) {
+        os_eventq_get(&ble_sm_sc_evq);
+
+        while ((job = ble_sm_sc_job_pop(&ble_sm_sc_jobs_pending)) != NULL) {
+            ble_sm_sc_job_run(job);
+
+            OS_ENTER_CRITICAL(sr);
+            STAILQ_INSERT_TAIL(&ble_sm_sc_jobs_finished, job, next);
+            OS_EXIT_CRITICAL(sr);
+
+            ble_hs_event_enqueue(&ble_sm_sc_event_done);
+        }
+    }
+}
+
+/**
+ * Starts generating our key pair in the background, so that it is ready
+ * before the first LE Secure Connections pairing needs it.  Has no effect if
+ * the SC task is disabled.
+ */
+void
+ble_sm_sc_pregen_keys(void)
+{
+    struct ble_sm_sc_job *job;
+
+    if (!ble_hs_cfg.sm_sc ||
+        ble_sm_sc_keys_generated ||
+        ble_sm_sc_keys_pending) {
+
+        return;
+    }
+
+    job = ble_sm_sc_job_alloc(BLE_SM_SC_JOB_KEY_PAIR,
+                              BLE_HS_CONN_HANDLE_NONE);
+    if (job == NULL) {
+        /* The keys get generated on demand instead. */
+        return;
+    }
+
+    ble_sm_sc_keys_pending = 1;
+    ble_sm_sc_job_submit(job);
+}
+
+/**
+ * Calculates the DH key for the specified procedure.  If the SC task is
+ * enabled, the calculation is only started; the procedure is flagged as
+ * pending and proc->dhkey is filled in later by ble_sm_sc_jobs_done().
+ * Otherwise, the key is calculated before this function returns.
+ */
+static int
+ble_sm_sc_gen_dhkey(struct ble_sm_proc *proc)
+{
+    struct ble_sm_sc_job *job;
+    int rc;
+
+    job = ble_sm_sc_job_alloc(BLE_SM_SC_JOB_DHKEY, proc->conn_handle);
+    if (job == NULL) {
+        rc = ble_sm_alg_gen_dhkey(proc->pub_key_peer.x,
+                                  proc->pub_key_peer.y,
+                                  ble_sm_sc_priv_key.u32,
+                                  proc->dhkey);
+        return rc;
+    }
+
+    job->peer_pub_key = proc->pub_key_peer;
+    memcpy(job->priv_key, ble_sm_sc_priv_key.u32, sizeof job->priv_key);
+
+    proc->flags |= BLE_SM_PROC_F_DHKEY_PENDING;
+    ble_sm_sc_job_submit(job);
+
+    return 0;
+}
+
+static void
+ble_sm_sc_dhkey_done(struct ble_sm_sc_job *job)
+{
+    struct ble_sm_result res;
+    struct ble_sm_proc *proc;
+    struct ble_sm_proc *prev;
+
+    memset(&res, 0, sizeof res);
+
+    ble_hs_lock();
+
+    proc = ble_sm_proc_find(job->conn_handle, BLE_SM_PROC_STATE_NONE, -1,
+                            &prev);
+    if (proc != NULL) {
+        if (!(proc->flags & BLE_SM_PROC_F_DHKEY_PENDING) ||
+            memcmp(&proc->pub_key_peer, &job->peer_pub_key,
+                   sizeof job->peer_pub_key) != 0) {
+
+            /* The job belongs to a procedure that no longer exists. */
+            proc = NULL;
+        }
+    }
+
+    if (proc != NULL) {
+        proc->flags &= ~BLE_SM_PROC_F_DHKEY_PENDING;
+
+        if (job->status != 0) {
+            res.app_status = BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY);
+            res.sm_err = BLE_SM_ERR_DHKEY;
+            res.enc_cb = 1;
+        } else {
+            memcpy(proc->dhkey, job->dhkey, sizeof proc->dhkey);
+
+            if (proc->flags & BLE_SM_PROC_F_RANDOM_PENDING) {
+                proc->flags &= ~BLE_SM_PROC_F_RANDOM_PENDING;
+                ble_sm_sc_random_rx(proc, &res);
+            }
+        }
+    }
+
+    ble_hs_unlock();
+
+    if (proc != NULL) {
+        ble_sm_process_result(job->conn_handle, &res);
+    }
+}
+
+/**
+ * Applies the results of all jobs the SC task has finished.  Called in the
+ * host parent task.
+ */
+void
+ble_sm_sc_jobs_done(void)
+{
+    struct ble_sm_sc_job *job;
+    int rc;
+
+    while ((job = ble_sm_sc_job_pop(&ble_sm_sc_jobs_finished)) != NULL) {
+        switch (job->type) {
+        case BLE_SM_SC_JOB_KEY_PAIR:
+            ble_sm_sc_keys_pending = 0;
+            if (job->status == 0 && !ble_sm_sc_keys_generated) {
+                memcpy(ble_sm_sc_pub_key.u32, job->pub_key,
+                       sizeof ble_sm_sc_pub_key);
+                memcpy(ble_sm_sc_priv_key.u32, job->priv_key,
+                       sizeof ble_sm_sc_priv_key);
+                ble_sm_sc_keys_generated = 1;
+            }
+            break;
+
+        case BLE_SM_SC_JOB_DHKEY:
+            ble_sm_sc_dhkey_done(job);
+            break;
+
+        default:
+            BLE_HS_DBG_ASSERT(0);
+            break;
+        }
+
+        rc = os_memblock_put(&ble_sm_sc_job_pool, job);
+        BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+    }
+}
+
+static int
+ble_sm_sc_task_init(void)
+{
+    int num_jobs;
+    int rc;
+
+    /* The task cannot be stopped; once it is running, it is kept across
+     * host reinitialization.
+     */
+    if (ble_sm_sc_task_started || ble_hs_cfg.sm_sc_task_stack_size == 0) {
+        return 0;
+    }
+
+    /* One key pair job plus one DH key job per procedure. */
+    num_jobs = ble_hs_cfg.max_l2cap_sm_procs + 1;
+    ble_sm_sc_job_mem = malloc(
+        OS_MEMPOOL_BYTES(num_jobs, sizeof (struct ble_sm_sc_job)));
+    ble_sm_sc_stack = malloc(ble_hs_cfg.sm_sc_task_stack_size *
+                             sizeof (os_stack_t));
+    if (ble_sm_sc_job_mem == NULL || ble_sm_sc_stack == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto err;
+    }
+
+    rc = os_mempool_init(&ble_sm_sc_job_pool, num_jobs,
+                         sizeof (struct ble_sm_sc_job), ble_sm_sc_job_mem,
+                         "ble_sm_sc_job_pool");
+    if (rc != 0) {
+        rc = BLE_HS_EOS;
+        goto err;
+    }
+
+    STAILQ_INIT(&ble_sm_sc_jobs_pending);
+    STAILQ_INIT(&ble_sm_sc_jobs_finished);
+    os_eventq_init(&ble_sm_sc_evq);
+
+    rc = os_task_init(&ble_sm_sc_task, "ble_sm_sc", ble_sm_sc_task_handler,
+                      NULL, ble_hs_cfg.sm_sc_task_prio, OS_WAIT_FOREVER,
+                      ble_sm_sc_stack, ble_hs_cfg.sm_sc_task_stack_size);
+    if (rc != 0) {
+        rc = BLE_HS_EOS;
+        goto err;
+    }
+
+    ble_sm_sc_task_started = 1;
+    return 0;
+
+err:
+    free(ble_sm_sc_job_mem);
+    ble_sm_sc_job_mem = NULL;
+    free(ble_sm_sc_stack);
+    ble_sm_sc_stack = NULL;
+    return rc;
+}
+
+/*****************************************************************************
+ * $keys                                                                     *
+ *****************************************************************************/
+
 static int
 ble_sm_sc_ensure_keys_generated(void)
 {
@@ -221,7 +575,7 @@ ble_sm_sc_gen_ri(struct ble_sm_proc *proc)
         return 0;
 
     case BLE_SM_PAIR_ALG_OOB:
-        rc = ble_hs_hci_util_rand(&proc->ri, 1);
+        rc = ble_hs_rand(&proc->ri, 1);
         return rc;
 
     default:
@@ -359,6 +713,14 @@ ble_sm_sc_random_rx(struct ble_sm_proc *proc, struct ble_sm_result *res)
     uint8_t rat;
     int rc;
 
+    if (proc->flags & BLE_SM_PROC_F_DHKEY_PENDING) {
+        /* The DH key is needed below; finish processing the random once the
+         * SC task has calculated it.
+         */
+        proc->flags |= BLE_SM_PROC_F_RANDOM_PENDING;
+        return;
+    }
+
     if (proc->flags & BLE_SM_PROC_F_INITIATOR ||
         ble_sm_sc_responder_verifies_random(proc)) {
 
@@ -500,10 +862,7 @@ ble_sm_sc_public_key_rx(uint16_t conn_handle, uint8_t op, struct os_mbuf **om,
         res->sm_err = BLE_SM_ERR_UNSPECIFIED;
     } else {
         proc->pub_key_peer = cmd;
-        rc = ble_sm_alg_gen_dhkey(proc->pub_key_peer.x,
-                                  proc->pub_key_peer.y,
-                                  ble_sm_sc_priv_key.u32,
-                                  proc->dhkey);
+        rc = ble_sm_sc_gen_dhkey(proc);
         if (rc != 0) {
             res->app_status = BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY);
             res->sm_err = BLE_SM_ERR_DHKEY;
@@ -700,10 +1059,61 @@ ble_sm_sc_dhkey_check_rx(uint16_t conn_handle, uint8_t op, struct os_mbuf **om,
     ble_hs_unlock();
 }
 
-void
+int
+ble_sm_sc_mem_pool(const struct ble_hs_cfg *cfg, int idx,
+                   struct ble_hs_mem_pool *out_pool)
+{
+    const struct os_mempool *live_pool;
+    int num_jobs;
+    int stack_size;
+
+    if (cfg == NULL) {
+        cfg = &ble_hs_cfg;
+        live_pool = ble_sm_sc_task_started ? &ble_sm_sc_job_pool : NULL;
+    } else {
+        live_pool = NULL;
+    }
+
+    /* Nothing is allocated if the computations are done by the parent
+     * task.
+     */
+    stack_size = cfg->sm_sc_task_stack_size;
+    if (stack_size == 0) {
+        num_jobs = 0;
+    } else {
+        num_jobs = cfg->max_l2cap_sm_procs + 1;
+    }
+
+    switch (idx) {
+    case 0:
+        ble_hs_mem_pool_fill(out_pool, "ble_sm_sc_job_pool", num_jobs,
+                             sizeof (struct ble_sm_sc_job), live_pool);
+        return 0;
+
+    case 1:
+        ble_hs_mem_pool_fill(out_pool, "ble_sm_sc_stack", stack_size,
+                             sizeof (os_stack_t), NULL);
+        return 0;
+
+    default:
+        return BLE_HS_ENOENT;
+    }
+}
+
+int
 ble_sm_sc_init(void)
 {
+    int rc;
+
     ble_sm_sc_keys_generated = 0;
+    ble_sm_sc_keys_pending = 0;
+
+    rc = ble_sm_sc_task_init();
+    if (rc != 0) {
+        return rc;
+    }
+
+    return 0;
 }
 
 #endif  /* NIMBLE_OPT_SM_SC */
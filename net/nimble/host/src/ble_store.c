@@ -48,6 +48,10 @@ ble_store_write(int obj_type, union ble_store_value *val)
         rc = ble_hs_cfg.store_write_cb(obj_type, val);
     }
 
+    if (rc == 0 && obj_type == BLE_STORE_OBJ_TYPE_OUR_SEC) {
+        ble_sm_ltk_index_write(&val->sec);
+    }
+
     return rc;
 }
 
@@ -56,6 +60,10 @@ ble_store_delete(int obj_type, union ble_store_key *key)
 {
     int rc;
 
+    if (obj_type == BLE_STORE_OBJ_TYPE_OUR_SEC) {
+        ble_sm_ltk_index_delete(&key->sec);
+    }
+
     if (ble_hs_cfg.store_delete_cb == NULL) {
         rc = BLE_HS_ENOTSUP;
     } else {
@@ -77,9 +85,19 @@ ble_store_read_our_sec(struct ble_store_key_sec *key_sec,
                       key_sec->peer_addr_type == BLE_ADDR_TYPE_RANDOM ||
                       key_sec->peer_addr_type == BLE_STORE_ADDR_TYPE_NONE);
 
+    /* An LTK request from a reconnecting peer is usually answered here. */
+    rc = ble_sm_ltk_index_read(key_sec, value_sec);
+    if (rc == 0) {
+        return 0;
+    }
+
     store_key = (void *)key_sec;
     store_value = (void *)value_sec;
     rc = ble_store_read(BLE_STORE_OBJ_TYPE_OUR_SEC, store_key, store_value);
+    if (rc == 0 && key_sec->ediv_rand_present) {
+        ble_sm_ltk_index_write(value_sec);
+    }
+
     return rc;
 }
 
@@ -154,6 +172,11 @@ ble_store_write_peer_sec(struct ble_store_value_sec *value_sec)
         return rc;
     }
 
+    /* A new bond; whatever was cached of the peer's GATT database may be
+     * out of date.
+     */
+    ble_store_clear_gatt(value_sec->peer_addr_type, value_sec->peer_addr);
+
     if (value_sec->peer_addr_type != BLE_STORE_ADDR_TYPE_NONE &&
         value_sec->irk_present) {
 
@@ -179,6 +202,10 @@ ble_store_delete_peer_sec(struct ble_store_key_sec *key_sec)
     store_key = (void *)key_sec;
     rc = ble_store_delete(BLE_STORE_OBJ_TYPE_PEER_SEC, store_key);
 
+    if (key_sec->peer_addr_type != BLE_STORE_ADDR_TYPE_NONE) {
+        ble_store_clear_gatt(key_sec->peer_addr_type, key_sec->peer_addr);
+    }
+
     if(key_sec->peer_addr_type == BLE_STORE_ADDR_TYPE_NONE) {
         /* don't error check this since we don't know without looking up
          * the value whether it had a valid IRK */
@@ -225,6 +252,71 @@ ble_store_delete_cccd(struct ble_store_key_cccd *key)
     return rc;
 }
 
+int
+ble_store_read_gatt(struct ble_store_key_gatt *key,
+                    struct ble_store_value_gatt *out_value)
+{
+    union ble_store_value *store_value;
+    union ble_store_key *store_key;
+    int rc;
+
+    store_key = (void *)key;
+    store_value = (void *)out_value;
+    rc = ble_store_read(BLE_STORE_OBJ_TYPE_GATT, store_key, store_value);
+    return rc;
+}
+
+int
+ble_store_write_gatt(struct ble_store_value_gatt *value)
+{
+    union ble_store_value *store_value;
+    int rc;
+
+    store_value = (void *)value;
+    rc = ble_store_write(BLE_STORE_OBJ_TYPE_GATT, store_value);
+    return rc;
+}
+
+int
+ble_store_delete_gatt(struct ble_store_key_gatt *key)
+{
+    union ble_store_key *store_key;
+    int rc;
+
+    store_key = (void *)key;
+    rc = ble_store_delete(BLE_STORE_OBJ_TYPE_GATT, store_key);
+    return rc;
+}
+
+/**
+ * Deletes the cached GATT database of the specified peer.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTSUP if the store can't delete
+ *                                  objects;
+ *                              Other nonzero on error.
+ */
+int
+ble_store_clear_gatt(uint8_t peer_addr_type, const uint8_t *peer_addr)
+{
+    struct ble_store_key_gatt key;
+    int rc;
+
+    memset(&key, 0, sizeof key);
+    key.peer_addr_type = peer_addr_type;
+    memcpy(key.peer_addr, peer_addr, sizeof key.peer_addr);
+    key.type = BLE_STORE_GATT_TYPE_ANY;
+
+    do {
+        rc = ble_store_delete_gatt(&key);
+    } while (rc == 0);
+
+    if (rc == BLE_HS_ENOENT) {
+        rc = 0;
+    }
+    return rc;
+}
+
 void
 ble_store_key_from_value_cccd(struct ble_store_key_cccd *out_key,
                               struct ble_store_value_cccd *value)
@@ -235,6 +327,17 @@ ble_store_key_from_value_cccd(struct ble_store_key_cccd *out_key,
     out_key->idx = 0;
 }
 
+void
+ble_store_key_from_value_gatt(struct ble_store_key_gatt *out_key,
+                              struct ble_store_value_gatt *value)
+{
+    out_key->peer_addr_type = value->peer_addr_type;
+    memcpy(out_key->peer_addr, value->peer_addr, 6);
+    out_key->type = value->type;
+    out_key->handle = value->handle;
+    out_key->idx = 0;
+}
+
 void
 ble_store_key_from_value_sec(struct ble_store_key_sec *out_key,
                              struct ble_store_value_sec *value)
@@ -268,6 +371,12 @@ void ble_store_iterate(int obj_type,
         case BLE_STORE_OBJ_TYPE_CCCD:
             key.cccd.peer_addr_type = BLE_STORE_ADDR_TYPE_NONE;
             pidx = &key.cccd.idx;
+            break;
+        case BLE_STORE_OBJ_TYPE_GATT:
+            key.gatt.peer_addr_type = BLE_STORE_ADDR_TYPE_NONE;
+            key.gatt.type = BLE_STORE_GATT_TYPE_ANY;
+            pidx = &key.gatt.idx;
+            break;
         default:
             return;
     }
@@ -154,3 +154,139 @@ ble_uuid_extract(struct os_mbuf *om, int off, void *uuid128)
         return BLE_HS_EMSGSIZE;
     }
 }
+
+void
+ble_uuid_any_from_16(struct ble_uuid_any *uuid, uint16_t uuid16)
+{
+    uuid->type = BLE_UUID_TYPE_16;
+    uuid->u32 = uuid16;
+}
+
+/**
+ * Converts the supplied 128-bit UUID into its shortest form.
+ */
+void
+ble_uuid_any_from_128(struct ble_uuid_any *uuid, const void *uuid128)
+{
+    const uint8_t *u8ptr;
+
+    u8ptr = uuid128;
+    if (memcmp(u8ptr, ble_uuid_base, sizeof ble_uuid_base - 4) == 0) {
+        uuid->u32 = le32toh(u8ptr + 12);
+        if (uuid->u32 == 0) {
+            /* Not a valid 16-bit UUID; keep it as is. */
+        } else if (uuid->u32 <= UINT16_MAX) {
+            uuid->type = BLE_UUID_TYPE_16;
+            return;
+        } else {
+            uuid->type = BLE_UUID_TYPE_32;
+            return;
+        }
+    }
+
+    uuid->type = BLE_UUID_TYPE_128;
+    memcpy(uuid->u128, u8ptr, 16);
+}
+
+/**
+ * @return                      The 16-bit form of the UUID;
+ *                              0 if the UUID does not have one.
+ */
+uint16_t
+ble_uuid_any_to_16(const struct ble_uuid_any *uuid)
+{
+    if (uuid->type != BLE_UUID_TYPE_16) {
+        return 0;
+    }
+    return uuid->u32;
+}
+
+void
+ble_uuid_any_to_128(const struct ble_uuid_any *uuid, void *uuid128)
+{
+    uint8_t *u8ptr;
+
+    u8ptr = uuid128;
+    if (uuid->type == BLE_UUID_TYPE_128) {
+        memcpy(u8ptr, uuid->u128, 16);
+    } else {
+        memcpy(u8ptr, ble_uuid_base, 16);
+        htole32(u8ptr + 12, uuid->u32);
+    }
+}
+
+/**
+ * @return                      0 if the UUIDs are equal; nonzero otherwise.
+ */
+int
+ble_uuid_any_cmp(const struct ble_uuid_any *a, const struct ble_uuid_any *b)
+{
+    if (a->type != b->type) {
+        return 1;
+    }
+    if (a->type == BLE_UUID_TYPE_128) {
+        return memcmp(a->u128, b->u128, 16);
+    }
+    return a->u32 != b->u32;
+}
+
+/**
+ * Appends the UUID in the form used in ATT PDUs: 2 bytes for a 16-bit UUID,
+ * 16 bytes otherwise.
+ */
+int
+ble_uuid_any_append(struct os_mbuf *om, const struct ble_uuid_any *uuid)
+{
+    uint8_t *buf;
+
+    if (uuid->type == BLE_UUID_TYPE_16) {
+        buf = os_mbuf_extend(om, 2);
+        if (buf == NULL) {
+            return BLE_HS_ENOMEM;
+        }
+        htole16(buf, uuid->u32);
+    } else {
+        buf = os_mbuf_extend(om, 16);
+        if (buf == NULL) {
+            return BLE_HS_ENOMEM;
+        }
+        ble_uuid_any_to_128(uuid, buf);
+    }
+
+    return 0;
+}
+
+/**
+ * Reads a UUID from the end of an ATT PDU; the remainder of the mbuf
+ * starting at off must be 2 or 16 bytes.
+ */
+int
+ble_uuid_any_extract(struct os_mbuf *om, int off, struct ble_uuid_any *uuid)
+{
+    uint8_t buf[16];
+    int remlen;
+    int rc;
+
+    remlen = OS_MBUF_PKTHDR(om)->omp_len - off;
+    switch (remlen) {
+    case 2:
+        rc = os_mbuf_copydata(om, off, 2, buf);
+        BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+        if (le16toh(buf) == 0) {
+            return BLE_HS_EINVAL;
+        }
+        ble_uuid_any_from_16(uuid, le16toh(buf));
+        return 0;
+
+    case 16:
+        rc = os_mbuf_copydata(om, off, 16, buf);
+        BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+        ble_uuid_any_from_128(uuid, buf);
+        return 0;
+
+    default:
+        return BLE_HS_EMSGSIZE;
+    }
+}
@@ -20,9 +20,34 @@
 #ifndef H_BLE_UUID_PRIV_
 #define H_BLE_UUID_PRIV_
 
+#include <inttypes.h>
+#include "host/ble_uuid.h"
 struct os_mbuf;
 
+/**
+ * UUID in its shortest form. 16- and 32-bit UUIDs are held and compared as
+ * integers; only a UUID which is not derived from the Bluetooth base UUID
+ * is kept as 128 bits.
+ */
+struct ble_uuid_any {
+    uint8_t type;
+    union {
+        uint32_t u32;           /* BLE_UUID_TYPE_16 and BLE_UUID_TYPE_32 */
+        uint8_t u128[16];       /* BLE_UUID_TYPE_128 */
+    };
+};
+
 int ble_uuid_append(struct os_mbuf *om, const void *uuid128);
 int ble_uuid_extract(struct os_mbuf *om, int off, void *uuid128);
 
+void ble_uuid_any_from_16(struct ble_uuid_any *uuid, uint16_t uuid16);
+void ble_uuid_any_from_128(struct ble_uuid_any *uuid, const void *uuid128);
+uint16_t ble_uuid_any_to_16(const struct ble_uuid_any *uuid);
+void ble_uuid_any_to_128(const struct ble_uuid_any *uuid, void *uuid128);
+int ble_uuid_any_cmp(const struct ble_uuid_any *a,
+                     const struct ble_uuid_any *b);
+int ble_uuid_any_append(struct os_mbuf *om, const struct ble_uuid_any *uuid);
+int ble_uuid_any_extract(struct os_mbuf *om, int off,
+                         struct ble_uuid_any *uuid);
+
 #endif
@@ -2141,6 +2141,21 @@ TEST_CASE(ble_att_svr_test_prep_write)
                                      BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN, 1);
     ble_att_svr_test_misc_verify_w_1(NULL, 0);
 
+    /*** Failure for exceeding the per-connection prepare queue limit. */
+    ble_hs_cfg.max_prep_write_len = 50;
+    ble_att_svr_test_misc_prep_write(conn_handle, 1, 0, data, 30, 0);
+    ble_att_svr_test_misc_prep_write(conn_handle, 1, 30, data + 30, 30,
+                                     BLE_ATT_ERR_PREPARE_QUEUE_FULL);
+    ble_att_svr_test_misc_prep_write(conn_handle, 1, 30, data + 30, 20, 0);
+    ble_att_svr_test_misc_exec_write(conn_handle, BLE_ATT_EXEC_WRITE_F_CONFIRM,
+                                     0, 0);
+    ble_att_svr_test_misc_verify_w_1(data, 50);
+
+    /* Executing the queue frees its space. */
+    ble_att_svr_test_misc_prep_write(conn_handle, 1, 0, data, 40, 0);
+    ble_att_svr_test_misc_exec_write(conn_handle, 0, 0, 0);
+    ble_hs_cfg.max_prep_write_len = ble_hs_cfg_dflt.max_prep_write_len;
+
     /*** Successful two part write. */
     ble_att_svr_test_misc_prep_write(conn_handle, 1, 0, data, 20, 0);
     ble_att_svr_test_misc_prep_write(conn_handle, 1, 20, data + 20, 20, 0);
@@ -2240,6 +2255,64 @@ TEST_CASE(ble_att_svr_test_indicate)
 
 }
 
+TEST_CASE(ble_att_svr_test_find_index)
+{
+    struct ble_att_svr_entry *entry;
+    struct ble_uuid_any uuid;
+    uint16_t handles[6];
+    uint8_t uuid1[16];
+    uint8_t uuid2[16];
+    int rc;
+    int i;
+
+    ble_att_svr_test_misc_init(0);
+
+    rc = ble_uuid_16_to_128(0x1111, uuid1);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_uuid_16_to_128(0x2222, uuid2);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Interleave two UUIDs. */
+    for (i = 0; i < 6; i++) {
+        rc = ble_att_svr_register(i % 2 ? uuid2 : uuid1, HA_FLAG_PERM_RW,
+                                  &handles[i],
+                                  ble_att_svr_test_misc_attr_fn_r_1, NULL);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    /*** Lookup by handle. */
+    for (i = 0; i < 6; i++) {
+        entry = ble_att_svr_find_by_handle(handles[i]);
+        TEST_ASSERT_FATAL(entry != NULL);
+        TEST_ASSERT(entry->ha_handle_id == handles[i]);
+    }
+    TEST_ASSERT(ble_att_svr_find_by_handle(0) == NULL);
+    TEST_ASSERT(ble_att_svr_find_by_handle(handles[5] + 1) == NULL);
+
+    /*** Lookup by UUID visits matching entries in handle order. */
+    ble_uuid_any_from_128(&uuid, uuid2);
+    entry = NULL;
+    for (i = 1; i < 6; i += 2) {
+        entry = ble_att_svr_find_by_uuid(entry, &uuid, 0xffff);
+        TEST_ASSERT_FATAL(entry != NULL);
+        TEST_ASSERT(entry->ha_handle_id == handles[i]);
+    }
+    TEST_ASSERT(ble_att_svr_find_by_uuid(entry, &uuid, 0xffff) == NULL);
+
+    /*** End handle limits the search. */
+    entry = ble_att_svr_find_by_uuid(NULL, &uuid, handles[3]);
+    entry = ble_att_svr_find_by_uuid(entry, &uuid, handles[3]);
+    TEST_ASSERT_FATAL(entry != NULL);
+    TEST_ASSERT(entry->ha_handle_id == handles[3]);
+    TEST_ASSERT(ble_att_svr_find_by_uuid(entry, &uuid, handles[4]) == NULL);
+
+    /*** Starting point with a different UUID. */
+    entry = ble_att_svr_find_by_handle(handles[2]);
+    entry = ble_att_svr_find_by_uuid(entry, &uuid, 0xffff);
+    TEST_ASSERT_FATAL(entry != NULL);
+    TEST_ASSERT(entry->ha_handle_id == handles[3]);
+}
+
 TEST_SUITE(ble_att_svr_suite)
 {
     /* When checking for mbuf leaks, ensure no stale prep entries. */
@@ -2263,6 +2336,7 @@ TEST_SUITE(ble_att_svr_suite)
     ble_att_svr_test_prep_write();
     ble_att_svr_test_notify();
     ble_att_svr_test_indicate();
+    ble_att_svr_test_find_index();
 }
 
 int
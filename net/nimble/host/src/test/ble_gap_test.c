@@ -2897,6 +2897,373 @@ TEST_SUITE(ble_gap_test_suite_mtu)
     ble_gap_test_case_mtu_peer();
 }
 
+/*****************************************************************************
+ * $multi-role                                                               *
+ *****************************************************************************/
+
+static void
+ble_gap_test_util_multi_set_adv_acks(int stop_disc)
+{
+    struct ble_hs_test_util_phony_ack acks[6];
+    int i;
+
+    i = 0;
+    if (stop_disc) {
+        acks[i++] = (struct ble_hs_test_util_phony_ack) {
+            BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_ENABLE), 0
+        };
+    }
+    acks[i++] = (struct ble_hs_test_util_phony_ack) {
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_ADV_PARAMS), 0
+    };
+    acks[i++] = (struct ble_hs_test_util_phony_ack) {
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_ADV_DATA), 0
+    };
+    acks[i++] = (struct ble_hs_test_util_phony_ack) {
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_RSP_DATA), 0
+    };
+    acks[i++] = (struct ble_hs_test_util_phony_ack) {
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_ADV_ENABLE), 0
+    };
+    memset(acks + i, 0, sizeof acks[i]);
+
+    ble_hs_test_util_set_ack_seq(acks);
+}
+
+static void
+ble_gap_test_util_multi_verify_window(int32_t exp_ms)
+{
+    uint32_t exp_ticks;
+    int32_t ticks;
+    int rc;
+
+    rc = os_time_ms_to_ticks(exp_ms, &exp_ticks);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ticks = ble_gap_heartbeat();
+    TEST_ASSERT(ticks == exp_ticks);
+
+    os_time_advance(ticks);
+}
+
+TEST_CASE(ble_gap_test_case_multi_cycle)
+{
+    struct ble_gap_multi_params multi_params;
+    struct ble_gap_disc_params disc_params;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    memset(&disc_params, 0, sizeof disc_params);
+    multi_params = (struct ble_gap_multi_params) {
+        .period_ms = 1000,
+        .adv_pct = 20,
+        .disc_pct = 30,
+    };
+
+    /*** Invalid duty cycles. */
+    multi_params.disc_pct = 81;
+    rc = ble_gap_multi_start(BLE_ADDR_TYPE_PUBLIC, &ble_hs_test_util_adv_params,
+                             &disc_params, &multi_params,
+                             ble_gap_test_util_disc_cb, NULL);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    multi_params.disc_pct = 30;
+    rc = ble_gap_multi_start(BLE_ADDR_TYPE_PUBLIC, &ble_hs_test_util_adv_params,
+                             NULL, &multi_params,
+                             ble_gap_test_util_disc_cb, NULL);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    TEST_ASSERT(!ble_gap_multi_active());
+
+    /*** Advertising window. */
+    ble_gap_test_util_multi_set_adv_acks(0);
+    rc = ble_gap_multi_start(BLE_ADDR_TYPE_PUBLIC, &ble_hs_test_util_adv_params,
+                             &disc_params, &multi_params,
+                             ble_gap_test_util_disc_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_gap_multi_active());
+    TEST_ASSERT(ble_gap_adv_active());
+    TEST_ASSERT(!ble_gap_disc_active());
+
+    rc = ble_gap_multi_start(BLE_ADDR_TYPE_PUBLIC, &ble_hs_test_util_adv_params,
+                             &disc_params, &multi_params,
+                             ble_gap_test_util_disc_cb, NULL);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /*** Discovery window; scanning is continuous within it. */
+    ble_hs_test_util_set_ack_seq(((struct ble_hs_test_util_phony_ack[]) {
+        { BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_ADV_ENABLE), 0 },
+        { BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_PARAMS), 0 },
+        { BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_ENABLE), 0 },
+        { 0 }
+    }));
+    ble_gap_test_util_multi_verify_window(200);
+    ble_hs_test_util_prev_hci_tx_clear();
+    ble_gap_heartbeat();
+    TEST_ASSERT(!ble_gap_adv_active());
+    TEST_ASSERT(ble_gap_disc_active());
+    ble_hs_test_util_verify_tx_hci(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_SET_ADV_ENABLE, NULL);
+    ble_gap_test_util_verify_tx_set_scan_params(BLE_ADDR_TYPE_PUBLIC,
+                                                BLE_HCI_SCAN_TYPE_ACTIVE,
+                                                BLE_GAP_SCAN_FAST_WINDOW,
+                                                BLE_GAP_SCAN_FAST_WINDOW,
+                                                BLE_HCI_SCAN_FILT_NO_WL);
+
+    /*** Idle for the rest of the period. */
+    ble_hs_test_util_set_ack(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_SCAN_ENABLE), 0);
+    ble_gap_test_util_multi_verify_window(300);
+    ble_gap_heartbeat();
+    TEST_ASSERT(ble_gap_multi_active());
+    TEST_ASSERT(!ble_gap_adv_active());
+    TEST_ASSERT(!ble_gap_disc_active());
+
+    /*** Next period. */
+    ble_gap_test_util_multi_set_adv_acks(0);
+    ble_gap_test_util_multi_verify_window(500);
+    ble_gap_heartbeat();
+    TEST_ASSERT(ble_gap_adv_active());
+
+    /*** Stop. */
+    ble_hs_test_util_set_ack(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_ADV_ENABLE), 0);
+    rc = ble_gap_multi_stop();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(!ble_gap_multi_active());
+    TEST_ASSERT(ble_gap_heartbeat() == BLE_HS_FOREVER);
+
+    rc = ble_gap_multi_stop();
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+}
+
+TEST_CASE(ble_gap_test_case_multi_conn)
+{
+    struct ble_gap_multi_params multi_params;
+    struct ble_gap_disc_params disc_params;
+    struct hci_le_conn_complete evt;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    memset(&disc_params, 0, sizeof disc_params);
+    multi_params = (struct ble_gap_multi_params) {
+        .period_ms = 1000,
+        .adv_pct = 50,
+        .disc_pct = 50,
+    };
+
+    ble_gap_test_util_multi_set_adv_acks(0);
+    rc = ble_gap_multi_start(BLE_ADDR_TYPE_PUBLIC, &ble_hs_test_util_adv_params,
+                             &disc_params, &multi_params,
+                             ble_gap_test_util_connect_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* A connection ends the procedure. */
+    memset(&evt, 0, sizeof evt);
+    evt.subevent_code = BLE_HCI_LE_SUBEV_CONN_COMPLETE;
+    evt.status = BLE_ERR_SUCCESS;
+    evt.connection_handle = 2;
+    evt.role = BLE_HCI_LE_CONN_COMPLETE_ROLE_SLAVE;
+    memcpy(evt.peer_addr, ((uint8_t[]){ 1, 2, 3, 4, 5, 6 }), 6);
+    rc = ble_gap_rx_conn_complete(&evt);
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT(ble_gap_test_event.type == BLE_GAP_EVENT_CONNECT);
+    TEST_ASSERT(!ble_gap_multi_active());
+    TEST_ASSERT(!ble_gap_adv_active());
+    TEST_ASSERT(ble_gap_heartbeat() == BLE_HS_FOREVER);
+}
+
+TEST_SUITE(ble_gap_test_suite_multi)
+{
+    tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
+
+    ble_gap_test_case_multi_cycle();
+    ble_gap_test_case_multi_conn();
+}
+
+/*****************************************************************************
+ * $tune                                                                     *
+ *****************************************************************************/
+
+static const struct ble_gap_tune_params ble_gap_test_tune_params = {
+    .throughput = {
+        .itvl_min = 6,
+        .itvl_max = 12,
+        .latency = 0,
+        .supervision_timeout = 200,
+    },
+    .throughput_tx_octets = 251,
+    .throughput_tx_time = 2120,
+    .power = {
+        .itvl_min = 400,
+        .itvl_max = 800,
+        .latency = 4,
+        .supervision_timeout = 600,
+    },
+    .busy_queued = 512,
+    .busy_rate = 1000,
+    .idle_rate = 100,
+    .idle_samples = 2,
+};
+
+static void
+ble_gap_test_util_tune_sample(uint32_t bytes)
+{
+    struct ble_hs_conn *conn;
+
+    ble_hs_lock();
+    conn = ble_hs_conn_find(2);
+    TEST_ASSERT_FATAL(conn != NULL);
+    conn->bhc_tune_bytes = bytes;
+    ble_hs_unlock();
+
+    os_time_advance(BLE_GAP_TUNE_PERIOD_MS * OS_TICKS_PER_SEC / 1000);
+    ble_gap_heartbeat();
+}
+
+static void
+ble_gap_test_util_tune_verify_profile(uint8_t exp_profile)
+{
+    uint8_t profile;
+    int rc;
+
+    rc = ble_gap_tune_profile(2, &profile);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(profile == exp_profile);
+}
+
+TEST_CASE(ble_gap_test_case_tune_switch)
+{
+    struct ble_gap_upd_params params;
+    uint8_t param_len;
+    uint8_t *param;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    ble_hs_test_util_create_conn(2, ((uint8_t[]){ 1, 2, 3, 4, 5, 6 }),
+                                 ble_gap_test_util_connect_cb, NULL);
+
+    rc = ble_gap_tune(2, &ble_gap_test_tune_params);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_gap_test_util_tune_verify_profile(BLE_GAP_TUNE_PROFILE_NONE);
+
+    /* Moderate traffic; neither busy nor idle. */
+    ble_gap_test_util_tune_sample(BLE_GAP_TUNE_PERIOD_MS / 2);
+    TEST_ASSERT(ble_hs_test_util_get_first_hci_tx() == NULL);
+    ble_gap_test_util_tune_verify_profile(BLE_GAP_TUNE_PROFILE_NONE);
+
+    /* Busy; switch to throughput parameters and data length. */
+    ble_hs_test_util_set_ack_seq(((struct ble_hs_test_util_phony_ack[]) {
+        {
+            .opcode = BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CONN_UPDATE),
+        },
+        {
+            .opcode = BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_DATA_LEN),
+            .evt_params = { 2, 0 },
+            .evt_params_len = 2,
+        },
+        { 0 }
+    }));
+    ble_gap_test_util_tune_sample(BLE_GAP_TUNE_PERIOD_MS * 2);
+
+    params = ble_gap_test_tune_params.throughput;
+    ble_gap_test_util_verify_tx_update_conn(&params);
+    param = ble_hs_test_util_verify_tx_hci(BLE_HCI_OGF_LE,
+                                           BLE_HCI_OCF_LE_SET_DATA_LEN,
+                                           &param_len);
+    TEST_ASSERT(param_len == BLE_HCI_SET_DATALEN_LEN);
+    TEST_ASSERT(le16toh(param + 0) == 2);
+    TEST_ASSERT(le16toh(param + 2) == 251);
+    TEST_ASSERT(le16toh(param + 4) == 2120);
+    ble_gap_test_util_tune_verify_profile(BLE_GAP_TUNE_PROFILE_THROUGHPUT);
+
+    ble_gap_test_util_rx_update_complete(0, &params);
+    TEST_ASSERT(ble_gap_test_event.type == BLE_GAP_EVENT_CONN_UPDATE);
+    TEST_ASSERT(ble_gap_test_conn_desc.conn_itvl == params.itvl_max);
+
+    /* Still busy; no further update. */
+    ble_gap_test_util_tune_sample(BLE_GAP_TUNE_PERIOD_MS * 2);
+    TEST_ASSERT(ble_hs_test_util_get_first_hci_tx() == NULL);
+
+    /* Two idle samples are required before switching to power parameters.
+     * The power profile leaves the data length unchanged.
+     */
+    ble_gap_test_util_tune_sample(0);
+    TEST_ASSERT(ble_hs_test_util_get_first_hci_tx() == NULL);
+    ble_gap_test_util_tune_verify_profile(BLE_GAP_TUNE_PROFILE_THROUGHPUT);
+
+    ble_hs_test_util_set_ack(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CONN_UPDATE), 0);
+    ble_gap_test_util_tune_sample(0);
+
+    params = ble_gap_test_tune_params.power;
+    ble_gap_test_util_verify_tx_update_conn(&params);
+    TEST_ASSERT(ble_hs_test_util_get_first_hci_tx() == NULL);
+    ble_gap_test_util_tune_verify_profile(BLE_GAP_TUNE_PROFILE_POWER);
+}
+
+TEST_CASE(ble_gap_test_case_tune_deferred)
+{
+    int32_t ticks_from_now;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    ble_hs_test_util_create_conn(2, ((uint8_t[]){ 1, 2, 3, 4, 5, 6 }),
+                                 ble_gap_test_util_connect_cb, NULL);
+
+    /* An application-initiated update is in progress. */
+    rc = ble_hs_test_util_conn_update(2,
+                                      &ble_gap_test_tune_params.power, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_hs_test_util_get_first_hci_tx();
+
+    rc = ble_gap_tune(2, &ble_gap_test_tune_params);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* The switch fails and is retried at the next sample. */
+    ble_gap_test_util_tune_sample(BLE_GAP_TUNE_PERIOD_MS * 2);
+    TEST_ASSERT(ble_hs_test_util_get_first_hci_tx() == NULL);
+    ble_gap_test_util_tune_verify_profile(BLE_GAP_TUNE_PROFILE_NONE);
+
+    ble_gap_test_util_rx_update_complete(0, &ble_gap_test_tune_params.power);
+
+    ble_hs_test_util_set_ack_seq(((struct ble_hs_test_util_phony_ack[]) {
+        {
+            .opcode = BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CONN_UPDATE),
+        },
+        {
+            .opcode = BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_DATA_LEN),
+            .evt_params = { 2, 0 },
+            .evt_params_len = 2,
+        },
+        { 0 }
+    }));
+    ble_gap_test_util_tune_sample(BLE_GAP_TUNE_PERIOD_MS * 2);
+    ble_gap_test_util_tune_verify_profile(BLE_GAP_TUNE_PROFILE_THROUGHPUT);
+
+    /* Disabling tuning stops the sample timer. */
+    rc = ble_gap_tune(2, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_gap_test_util_rx_update_complete(
+        0, &ble_gap_test_tune_params.throughput);
+
+    os_time_advance(BLE_GAP_TUNE_PERIOD_MS * OS_TICKS_PER_SEC / 1000);
+    ticks_from_now = ble_gap_heartbeat();
+    TEST_ASSERT(ticks_from_now == BLE_HS_FOREVER);
+}
+
+TEST_SUITE(ble_gap_test_suite_tune)
+{
+    tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
+
+    ble_gap_test_case_tune_switch();
+    ble_gap_test_case_tune_deferred();
+}
+
 /*****************************************************************************
  * $all                                                                      *
  *****************************************************************************/
@@ -2915,6 +3282,8 @@ ble_gap_test_all(void)
     ble_gap_test_suite_update_conn();
     ble_gap_test_suite_timeout();
     ble_gap_test_suite_mtu();
+    ble_gap_test_suite_multi();
+    ble_gap_test_suite_tune();
 
     return tu_any_failed;
 }
@@ -517,11 +517,75 @@ TEST_CASE(ble_gatt_conn_test_disconnect)
     TEST_ASSERT(write_rel_arg.called == 1);
 }
 
+static void
+ble_gatt_conn_test_verify_tx_disconnect(uint16_t conn_handle)
+{
+    uint8_t param_len;
+    uint8_t *param;
+
+    param = ble_hs_test_util_verify_tx_hci(BLE_HCI_OGF_LINK_CTRL,
+                                           BLE_HCI_OCF_DISCONNECT_CMD,
+                                           &param_len);
+    TEST_ASSERT(param_len == BLE_HCI_DISCONNECT_CMD_LEN);
+    TEST_ASSERT(le16toh(param + 0) == conn_handle);
+}
+
+TEST_CASE(ble_gatt_conn_test_timeout)
+{
+    struct ble_gatt_conn_test_cb_arg mtu_arg1 = { 0 };
+    struct ble_gatt_conn_test_cb_arg mtu_arg9 = { 0 };
+    int32_t ticks_from_now;
+    int rc;
+
+    ble_hs_test_util_init();
+
+    /* Connection handles 1 and 9 share a procedure bucket. */
+    ble_hs_test_util_create_conn(1, ((uint8_t[]){1,2,3,4,5,6,7,8}),
+                                 NULL, NULL);
+    ble_hs_test_util_create_conn(9, ((uint8_t[]){2,3,4,5,6,7,8,9}),
+                                 NULL, NULL);
+
+    mtu_arg1.exp_conn_handle = 1;
+    rc = ble_gattc_exchange_mtu(1, ble_gatt_conn_test_mtu_cb, &mtu_arg1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    os_time_advance(10 * OS_TICKS_PER_SEC);
+
+    mtu_arg9.exp_conn_handle = 9;
+    rc = ble_gattc_exchange_mtu(9, ble_gatt_conn_test_mtu_cb, &mtu_arg9);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_tx_all();
+
+    /*** First procedure expires; its connection gets terminated. */
+    os_time_advance(20 * OS_TICKS_PER_SEC);
+    ble_hs_test_util_set_ack_disconnect(0);
+    ticks_from_now = ble_gattc_heartbeat();
+    ble_gatt_conn_test_verify_tx_disconnect(1);
+    TEST_ASSERT(ble_gattc_any_jobs());
+
+    /* The heartbeat reports when the second procedure expires. */
+    TEST_ASSERT(ticks_from_now == 10 * OS_TICKS_PER_SEC);
+
+    /*** Second procedure expires. */
+    os_time_advance(10 * OS_TICKS_PER_SEC);
+    ble_hs_test_util_set_ack_disconnect(0);
+    ticks_from_now = ble_gattc_heartbeat();
+    ble_gatt_conn_test_verify_tx_disconnect(9);
+    TEST_ASSERT(!ble_gattc_any_jobs());
+    TEST_ASSERT(ticks_from_now == BLE_HS_FOREVER);
+
+    /* Timed out procedures are not reported through the callback. */
+    TEST_ASSERT(mtu_arg1.called == 0);
+    TEST_ASSERT(mtu_arg9.called == 0);
+}
+
 TEST_SUITE(ble_gatt_break_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
     ble_gatt_conn_test_disconnect();
+    ble_gatt_conn_test_timeout();
 }
 
 int
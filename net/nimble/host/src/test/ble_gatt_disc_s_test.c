@@ -24,6 +24,7 @@
 #include "host/ble_hs_test.h"
 #include "host/ble_uuid.h"
 #include "ble_hs_test_util.h"
+#include "ble_hs_test_util_store.h"
 
 struct ble_gatt_disc_s_test_svc {
     uint16_t start_handle;
@@ -326,6 +327,70 @@ TEST_CASE(ble_gatt_disc_s_test_disc_all)
     });
 }
 
+TEST_CASE(ble_gatt_disc_s_test_disc_all_cached)
+{
+    struct ble_gatt_disc_s_test_svc services[] = {
+        { 1, 5, 0,      {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 }, },
+        { 6, 7, 0x1234 },
+        { 0 }
+    };
+    struct ble_store_key_sec key_sec;
+    struct ble_hs_conn *conn;
+    int rc;
+
+    ble_gatt_disc_s_test_init();
+
+    ble_hs_test_util_store_init(10, 10, 10);
+    ble_hs_cfg.store_read_cb = ble_hs_test_util_store_read;
+    ble_hs_cfg.store_write_cb = ble_hs_test_util_store_write;
+    ble_hs_cfg.store_delete_cb = ble_hs_test_util_store_delete;
+
+    ble_hs_test_util_create_conn(2, ((uint8_t[]){2,3,4,5,6,7,8,9}),
+                                 NULL, NULL);
+
+    ble_hs_lock();
+    conn = ble_hs_conn_find(2);
+    TEST_ASSERT_FATAL(conn != NULL);
+    conn->bhc_sec_state.encrypted = 1;
+    conn->bhc_sec_state.bonded = 1;
+    ble_hs_unlock();
+
+    /*** First discovery goes to the peer and fills the cache. */
+    rc = ble_gattc_disc_all_svcs(2, ble_gatt_disc_s_test_misc_disc_cb, NULL);
+    TEST_ASSERT(rc == 0);
+    ble_gatt_disc_s_test_misc_rx_all_rsp(2, services);
+    ble_gatt_disc_s_test_misc_verify_services(services);
+
+    /* Two services plus the complete marker. */
+    TEST_ASSERT(ble_hs_test_util_store_num_gatts == 3);
+
+    /*** Second discovery is answered from the cache. */
+    ble_gatt_disc_s_test_num_svcs = 0;
+    ble_gatt_disc_s_test_rx_complete = 0;
+    ble_hs_test_util_tx_all();
+    ble_hs_test_util_prev_tx_queue_clear();
+
+    rc = ble_gattc_disc_all_svcs(2, ble_gatt_disc_s_test_misc_disc_cb, NULL);
+    TEST_ASSERT(rc == 0);
+    ble_hs_test_util_tx_all();
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+    TEST_ASSERT(!ble_gatt_disc_s_test_rx_complete);
+
+    ble_gattc_cache_replay();
+    ble_gatt_disc_s_test_misc_verify_services(services);
+
+    /*** Cache is discarded when the bond is deleted. */
+    memset(&key_sec, 0, sizeof key_sec);
+    key_sec.peer_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    memcpy(key_sec.peer_addr, ((uint8_t[]){2,3,4,5,6,7}), 6);
+    ble_store_delete_peer_sec(&key_sec);
+    TEST_ASSERT(ble_hs_test_util_store_num_gatts == 0);
+
+    ble_hs_cfg.store_read_cb = NULL;
+    ble_hs_cfg.store_write_cb = NULL;
+    ble_hs_cfg.store_delete_cb = NULL;
+}
+
 TEST_CASE(ble_gatt_disc_s_test_disc_service_uuid)
 {
     /*** 128-bit service; one entry. */
@@ -394,6 +459,7 @@ TEST_SUITE(ble_gatt_disc_s_test_suite)
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
     ble_gatt_disc_s_test_disc_all();
+    ble_gatt_disc_s_test_disc_all_cached();
     ble_gatt_disc_s_test_disc_service_uuid();
 }
 
@@ -1045,6 +1045,68 @@ TEST_CASE(ble_gatts_notify_test_disallowed)
         2, chr3_val_handle - 1, BLE_GATTS_CLT_CFG_F_INDICATE, 0);
 }
 
+TEST_CASE(ble_gatts_notify_test_multi)
+{
+    uint16_t conn_handles[3];
+    uint16_t attr_handle;
+    uint16_t conn_handle;
+    int rc;
+    int i;
+
+    ble_gatts_notify_test_misc_init(&conn_handle, 0,
+                                    BLE_GATTS_CLT_CFG_F_NOTIFY, 0);
+
+    /* Subscribe a second peer to characteristic 1. */
+    ble_hs_test_util_create_conn(3, ((uint8_t[]){3,4,5,6,7,8}),
+                                 ble_gatts_notify_test_util_gap_event, NULL);
+    ble_gatts_notify_test_misc_enable_notify(
+        3, ble_gatts_notify_test_chr_1_def_handle,
+        BLE_GATTS_CLT_CFG_F_NOTIFY);
+    ble_gatts_notify_test_util_verify_sub_event(
+        3, ble_gatts_notify_test_chr_1_def_handle + 1,
+        BLE_GAP_SUBSCRIBE_REASON_WRITE, 0, 1, 0, 0);
+    ble_hs_test_util_prev_tx_queue_clear();
+
+    attr_handle = ble_gatts_notify_test_chr_1_def_handle + 1;
+    ble_gatts_notify_test_chr_1_len = 16;
+    memcpy(ble_gatts_notify_test_chr_1_val,
+           ((uint8_t[]){0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15}), 16);
+
+    /* A value update is sent to both subscribers, in connection table
+     * order.
+     */
+    ble_gatts_chr_updated(attr_handle);
+    for (i = 0; i < 2; i++) {
+        conn_handles[i] = ble_gatts_notify_test_events[0].notify_tx.conn_handle;
+        ble_gatts_notify_test_misc_verify_tx_n(
+            conn_handles[i], attr_handle,
+            ble_gatts_notify_test_chr_1_val,
+            ble_gatts_notify_test_chr_1_len);
+    }
+    TEST_ASSERT(conn_handles[0] + conn_handles[1] == 5);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+
+    /* An unknown connection fails without affecting the others.  No
+     * application callback exists for the unknown connection.
+     */
+    conn_handles[0] = 2;
+    conn_handles[1] = 9;
+    conn_handles[2] = 3;
+    rc = ble_gattc_notify_multi(conn_handles, 3, attr_handle);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    ble_gatts_notify_test_misc_verify_tx_n(
+        2, attr_handle,
+        ble_gatts_notify_test_chr_1_val,
+        ble_gatts_notify_test_chr_1_len);
+
+    ble_gatts_notify_test_misc_verify_tx_n(
+        3, attr_handle,
+        ble_gatts_notify_test_chr_1_val,
+        ble_gatts_notify_test_chr_1_len);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+}
+
 TEST_SUITE(ble_gatts_notify_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -1059,6 +1121,8 @@ TEST_SUITE(ble_gatts_notify_suite)
 
     ble_gatts_notify_test_disallowed();
 
+    ble_gatts_notify_test_multi();
+
     /* XXX: Test corner cases:
      *     o Bonding after CCCD configuration.
      *     o Disconnect prior to rx of indicate ack.
@@ -26,6 +26,7 @@
 
 #define BLE_GATTS_READ_TEST_CHR_1_UUID    0x1111
 #define BLE_GATTS_READ_TEST_CHR_2_UUID    0x2222
+#define BLE_GATTS_READ_TEST_CHR_3_UUID    0x3333
 
 static uint8_t ble_gatts_read_test_peer_addr[6] = {2,3,4,5,6,7};
 
@@ -44,6 +45,12 @@ static void
 ble_gatts_read_test_misc_reg_cb(struct ble_gatt_register_ctxt *ctxt,
                                 void *arg);
 
+static const uint8_t ble_gatts_read_test_chr_3_val[30] = {
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,
+    10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+    20, 21, 22, 23, 24, 25, 26, 27, 28, 29,
+};
+
 static const struct ble_gatt_svc_def ble_gatts_read_test_svcs[] = { {
     .type = BLE_GATT_SVC_TYPE_PRIMARY,
     .uuid128 = BLE_UUID16(0x1234),
@@ -55,6 +62,11 @@ static const struct ble_gatt_svc_def ble_gatts_read_test_svcs[] = { {
         .uuid128 = BLE_UUID16(BLE_GATTS_READ_TEST_CHR_2_UUID),
         .access_cb = ble_gatts_read_test_util_access_2,
         .flags = BLE_GATT_CHR_F_READ
+    }, {
+        .uuid128 = BLE_UUID16(BLE_GATTS_READ_TEST_CHR_3_UUID),
+        .flags = BLE_GATT_CHR_F_READ,
+        .static_val = ble_gatts_read_test_chr_3_val,
+        .static_val_len = sizeof ble_gatts_read_test_chr_3_val,
     }, {
         0
     } },
@@ -69,6 +81,7 @@ static uint8_t ble_gatts_read_test_chr_1_val[1024];
 static int ble_gatts_read_test_chr_1_len;
 static uint16_t ble_gatts_read_test_chr_2_def_handle;
 static uint16_t ble_gatts_read_test_chr_2_val_handle;
+static uint16_t ble_gatts_read_test_chr_3_val_handle;
 
 static void
 ble_gatts_read_test_misc_init(uint16_t *out_conn_handle)
@@ -115,6 +128,10 @@ ble_gatts_read_test_misc_reg_cb(struct ble_gatt_register_ctxt *ctxt,
             ble_gatts_read_test_chr_2_val_handle = ctxt->chr.val_handle;
             break;
 
+        case BLE_GATTS_READ_TEST_CHR_3_UUID:
+            ble_gatts_read_test_chr_3_val_handle = ctxt->chr.val_handle;
+            break;
+
         default:
             TEST_ASSERT_FATAL(0);
             break;
@@ -252,10 +269,38 @@ TEST_CASE(ble_gatts_read_test_case_long)
         ble_gatts_read_test_chr_1_val + 22, 18);
 }
 
+TEST_CASE(ble_gatts_read_test_case_static)
+{
+    struct ble_att_read_blob_req read_blob_req;
+    uint8_t buf[BLE_ATT_READ_BLOB_REQ_SZ];
+    uint16_t conn_handle;
+    int rc;
+
+    ble_gatts_read_test_misc_init(&conn_handle);
+
+    /*** Value is served without an access callback. */
+    ble_gatts_read_test_once(conn_handle,
+                             ble_gatts_read_test_chr_3_val_handle,
+                             (void *)ble_gatts_read_test_chr_3_val, 22);
+
+    /*** Read blob at an offset. */
+    read_blob_req.babq_handle = ble_gatts_read_test_chr_3_val_handle;
+    read_blob_req.babq_offset = 22;
+    ble_att_read_blob_req_write(buf, sizeof buf, &read_blob_req);
+
+    rc = ble_hs_test_util_l2cap_rx_payload_flat(conn_handle, BLE_L2CAP_CID_ATT,
+                                                buf, sizeof buf);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_verify_tx_read_blob_rsp(
+        (void *)(ble_gatts_read_test_chr_3_val + 22), 8);
+}
+
 TEST_SUITE(ble_gatts_read_test_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
     ble_gatts_read_test_case_basic();
     ble_gatts_read_test_case_long();
+    ble_gatts_read_test_case_static();
 }
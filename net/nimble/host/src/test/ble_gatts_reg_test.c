@@ -696,6 +696,143 @@ TEST_CASE(ble_gatts_reg_test_dsc_cb)
     } });
 }
 
+static int
+ble_gatts_reg_test_tbl_access(uint16_t conn_handle, uint16_t attr_handle,
+                              struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    uint8_t val;
+
+    val = attr_handle;
+    return os_mbuf_append(ctxt->om, &val, 1);
+}
+
+static const uint8_t ble_gatts_reg_test_tbl_uuid[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+
+static uint16_t ble_gatts_reg_test_tbl_val_handle;
+
+static struct ble_gatt_dsc_def ble_gatts_reg_test_tbl_dscs[] = { {
+    .uuid128 = (uint8_t *)ble_gatts_reg_test_tbl_uuid,
+    .att_flags = BLE_ATT_F_READ,
+    .access_cb = ble_gatts_reg_test_tbl_access,
+}, {
+    0
+} };
+
+static const struct ble_gatt_chr_def ble_gatts_reg_test_tbl_chrs[] = { {
+    .uuid128 = BLE_UUID16(0x1111),
+    .access_cb = ble_gatts_reg_test_tbl_access,
+    .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+    .descriptors = ble_gatts_reg_test_tbl_dscs,
+    .val_handle = &ble_gatts_reg_test_tbl_val_handle,
+}, {
+    .uuid128 = BLE_UUID16(0x2222),
+    .access_cb = ble_gatts_reg_test_tbl_access,
+    .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+}, {
+    0
+} };
+
+static const struct ble_gatt_svc_def ble_gatts_reg_test_tbl_svcs[] = { {
+    .type = BLE_GATT_SVC_TYPE_PRIMARY,
+    .uuid128 = BLE_UUID16(0x1234),
+    .characteristics = ble_gatts_reg_test_tbl_chrs,
+}, {
+    .type = BLE_GATT_SVC_TYPE_SECONDARY,
+    .uuid128 = ble_gatts_reg_test_tbl_uuid,
+}, {
+    0
+} };
+
+static const struct ble_att_svr_entry ble_gatts_reg_test_tbl_attrs[] = {
+    BLE_GATTS_TBL_PRIMARY(&ble_gatts_reg_test_tbl_svcs[0]),
+    BLE_GATTS_TBL_CHR(&ble_gatts_reg_test_tbl_chrs[0],
+                      BLE_GATTS_TBL_UUID16(0x1111),
+                      BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY),
+    BLE_GATTS_TBL_CCCD(),
+    BLE_GATTS_TBL_DSC(&ble_gatts_reg_test_tbl_dscs[0],
+                      BLE_GATTS_TBL_UUID128(ble_gatts_reg_test_tbl_uuid),
+                      BLE_ATT_F_READ),
+    BLE_GATTS_TBL_CHR(&ble_gatts_reg_test_tbl_chrs[1],
+                      BLE_GATTS_TBL_UUID16(0x2222),
+                      BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE),
+    BLE_GATTS_TBL_SECONDARY(&ble_gatts_reg_test_tbl_svcs[1]),
+};
+
+TEST_CASE(ble_gatts_reg_test_tbl)
+{
+    struct os_mbuf *om;
+    uint16_t def_handle;
+    uint16_t val_handle;
+    uint16_t handle;
+    uint8_t chr_def[5];
+    int rc;
+
+    rc = ble_gatts_set_tbl(ble_gatts_reg_test_tbl_attrs,
+                           sizeof ble_gatts_reg_test_tbl_attrs /
+                           sizeof ble_gatts_reg_test_tbl_attrs[0]);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_gatts_reg_test_init();
+
+    /* Handles follow table order. */
+    TEST_ASSERT(ble_gatts_reg_test_tbl_val_handle == 3);
+
+    rc = ble_gatts_find_svc(BLE_UUID16(0x1234), &handle);
+    TEST_ASSERT(rc == 0 && handle == 1);
+    rc = ble_gatts_find_svc(ble_gatts_reg_test_tbl_uuid, &handle);
+    TEST_ASSERT(rc == 0 && handle == 8);
+
+    rc = ble_gatts_find_chr(BLE_UUID16(0x1234), BLE_UUID16(0x2222),
+                            &def_handle, &val_handle);
+    TEST_ASSERT(rc == 0 && def_handle == 6 && val_handle == 7);
+
+    rc = ble_gatts_find_dsc(BLE_UUID16(0x1234), BLE_UUID16(0x1111),
+                            ble_gatts_reg_test_tbl_uuid, &handle);
+    TEST_ASSERT(rc == 0 && handle == 5);
+    rc = ble_gatts_find_dsc(BLE_UUID16(0x1234), BLE_UUID16(0x1111),
+                            BLE_UUID16(BLE_GATT_DSC_CLT_CFG_UUID16), &handle);
+    TEST_ASSERT(rc == 0 && handle == 4);
+
+    /* Characteristic declaration. */
+    rc = ble_att_svr_read_local(2, &om);
+    TEST_ASSERT_FATAL(rc == 0);
+    chr_def[0] = BLE_GATT_CHR_PROP_READ | BLE_GATT_CHR_PROP_NOTIFY;
+    chr_def[1] = 3;
+    chr_def[2] = 0;
+    chr_def[3] = 0x11;
+    chr_def[4] = 0x11;
+    TEST_ASSERT(OS_MBUF_PKTLEN(om) == 5);
+    TEST_ASSERT(os_mbuf_cmpf(om, 0, chr_def, 5) == 0);
+    os_mbuf_free_chain(om);
+
+    /* Value and descriptor accesses reach the application callback. */
+    rc = ble_att_svr_read_local(3, &om);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(OS_MBUF_PKTLEN(om) == 1 && om->om_data[0] == 3);
+    os_mbuf_free_chain(om);
+
+    rc = ble_att_svr_read_local(5, &om);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(OS_MBUF_PKTLEN(om) == 1 && om->om_data[0] == 5);
+    os_mbuf_free_chain(om);
+
+    /* Registered services follow the table. */
+    rc = ble_gatts_register_svcs((struct ble_gatt_svc_def[]) { {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid128 = BLE_UUID16(0x5678),
+    }, {
+        0
+    } }, NULL, NULL);
+    TEST_ASSERT(rc == 0);
+    rc = ble_gatts_find_svc(BLE_UUID16(0x5678), &handle);
+    TEST_ASSERT(rc == 0 && handle == 9);
+
+    rc = ble_gatts_set_tbl(NULL, 0);
+    TEST_ASSERT(rc == 0);
+}
+
 TEST_SUITE(ble_gatts_reg_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -707,6 +844,8 @@ TEST_SUITE(ble_gatts_reg_suite)
     ble_gatts_reg_test_svc_cb();
     ble_gatts_reg_test_chr_cb();
     ble_gatts_reg_test_dsc_cb();
+
+    ble_gatts_reg_test_tbl();
 }
 
 int
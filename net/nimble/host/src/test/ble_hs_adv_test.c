@@ -1466,6 +1466,136 @@ TEST_CASE(ble_hs_adv_test_case_user_full_payload)
     TEST_ASSERT(rc == BLE_HS_EMSGSIZE);
 }
 
+TEST_CASE(ble_hs_adv_test_case_patch)
+{
+    static const uint8_t mfg_data[4] = { 0x01, 0x02, 0x03, 0x04 };
+    static const uint8_t counter[2] = { 0xaa, 0xbb };
+
+    struct ble_hs_adv_fields adv_fields;
+    uint8_t off;
+    uint8_t len;
+    int rc;
+
+    ble_hs_test_util_init();
+
+    memset(&adv_fields, 0, sizeof adv_fields);
+    adv_fields.tx_pwr_lvl_is_present = 1;
+    adv_fields.tx_pwr_lvl = 5;
+    adv_fields.mfg_data = (void *)mfg_data;
+    adv_fields.mfg_data_len = sizeof mfg_data;
+    rc = ble_gap_adv_set_fields(&adv_fields);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Locate the manufacturer data; it follows the tx power field. */
+    rc = ble_gap_adv_find_field(BLE_HS_ADV_TYPE_MFG_DATA, &off, &len);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(off == 5);
+    TEST_ASSERT(len == sizeof mfg_data);
+
+    rc = ble_gap_adv_find_field(BLE_HS_ADV_TYPE_URI, &off, &len);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    /*** Out of range patch. */
+    rc = ble_gap_adv_patch_data(5, mfg_data, 5);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    rc = ble_hs_test_util_adv_start(BLE_ADDR_TYPE_PUBLIC, 0, NULL,
+                                    &ble_hs_test_util_adv_params,
+                                    NULL, NULL, 0, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_hs_test_util_prev_hci_tx_clear();
+
+    /*** Patch while advertising; only the data gets resent. */
+    ble_hs_test_util_set_ack(
+        ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE,
+                                    BLE_HCI_OCF_LE_SET_ADV_DATA), 0);
+    rc = ble_gap_adv_patch_data(7, counter, sizeof counter);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_adv_test_misc_verify_tx_adv_data(
+        (struct ble_hs_adv_test_field[]) {
+            {
+                .type = BLE_HS_ADV_TYPE_TX_PWR_LVL,
+                .val = (uint8_t[]){ 5 },
+                .val_len = 1,
+            },
+            {
+                .type = BLE_HS_ADV_TYPE_MFG_DATA,
+                .val = (uint8_t[]){ 0x01, 0x02, 0xaa, 0xbb },
+                .val_len = 4,
+            },
+            { 0 },
+        });
+    TEST_ASSERT(ble_hs_test_util_get_first_hci_tx() == NULL);
+}
+
+static int
+ble_hs_adv_test_parse_cb(const struct ble_hs_adv_field *field, void *arg)
+{
+    int *num_fields;
+
+    num_fields = arg;
+    (*num_fields)++;
+
+    /* Abort on the manufacturer data field. */
+    if (field->type == BLE_HS_ADV_TYPE_MFG_DATA) {
+        return 99;
+    }
+
+    return 0;
+}
+
+TEST_CASE(ble_hs_adv_test_case_parse)
+{
+    static const uint8_t data[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_DISC_GEN,
+        0x02, BLE_HS_ADV_TYPE_TX_PWR_LVL, 0x05,
+        0x03, BLE_HS_ADV_TYPE_MFG_DATA, 0x01, 0x02,
+        0x00, 0x00, /* Non-significant part. */
+    };
+    static const uint8_t bad[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, BLE_HS_ADV_F_DISC_GEN,
+        0x05, BLE_HS_ADV_TYPE_TX_PWR_LVL, 0x05,
+    };
+
+    struct ble_hs_adv_field field;
+    int num_fields;
+    int rc;
+
+    /*** Find a field without decoding the rest. */
+    rc = ble_hs_adv_find(data, sizeof data, BLE_HS_ADV_TYPE_MFG_DATA, &field);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(field.type == BLE_HS_ADV_TYPE_MFG_DATA);
+    TEST_ASSERT(field.value_len == 2);
+    TEST_ASSERT(field.value == data + 8);
+
+    rc = ble_hs_adv_find(data, sizeof data, BLE_HS_ADV_TYPE_URI, &field);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    /*** Iterate all fields; trailing zeros terminate the data. */
+    num_fields = 0;
+    rc = ble_hs_adv_parse(data, 6, ble_hs_adv_test_parse_cb, &num_fields);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(num_fields == 2);
+
+    /*** Callback abort. */
+    num_fields = 0;
+    rc = ble_hs_adv_parse(data, sizeof data, ble_hs_adv_test_parse_cb,
+                          &num_fields);
+    TEST_ASSERT(rc == 99);
+    TEST_ASSERT(num_fields == 3);
+
+    /*** Truncated field; preceding fields still get reported. */
+    num_fields = 0;
+    rc = ble_hs_adv_parse(bad, sizeof bad, ble_hs_adv_test_parse_cb,
+                          &num_fields);
+    TEST_ASSERT(rc == BLE_HS_EBADDATA);
+    TEST_ASSERT(num_fields == 1);
+
+    rc = ble_hs_adv_find(bad, sizeof bad, BLE_HS_ADV_TYPE_URI, &field);
+    TEST_ASSERT(rc == BLE_HS_EBADDATA);
+}
+
 TEST_SUITE(ble_hs_adv_test_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -1474,6 +1604,8 @@ TEST_SUITE(ble_hs_adv_test_suite)
     ble_hs_adv_test_case_user();
     ble_hs_adv_test_case_user_rsp();
     ble_hs_adv_test_case_user_full_payload();
+    ble_hs_adv_test_case_patch();
+    ble_hs_adv_test_case_parse();
 }
 
 int
@@ -201,6 +201,112 @@ TEST_CASE(ble_hs_conn_test_undirect_connectable_success)
     ble_hs_unlock();
 }
 
+TEST_CASE(ble_hs_conn_test_find)
+{
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    int i;
+
+    static const uint16_t handles[] = { 0x001, 0x101, 0x201 };
+
+    ble_hs_test_util_init();
+
+    /* Handles which differ only above the low bits share a hash chain. */
+    for (i = 0; i < 3; i++) {
+        ble_hs_test_util_create_conn(handles[i],
+                                     ((uint8_t[]){ i, 2, 3, 4, 5, 6 }),
+                                     NULL, NULL);
+    }
+
+    ble_hs_lock();
+
+    for (i = 0; i < 3; i++) {
+        conn = ble_hs_conn_find(handles[i]);
+        TEST_ASSERT_FATAL(conn != NULL);
+        TEST_ASSERT(conn->bhc_handle == handles[i]);
+    }
+    TEST_ASSERT(ble_hs_conn_find(0x301) == NULL);
+
+    /*** Fixed channels. */
+    conn = ble_hs_conn_find(handles[0]);
+    chan = ble_hs_conn_chan_find(conn, BLE_L2CAP_CID_ATT);
+    TEST_ASSERT_FATAL(chan != NULL);
+    TEST_ASSERT(chan->blc_cid == BLE_L2CAP_CID_ATT);
+    chan = ble_hs_conn_chan_find(conn, BLE_L2CAP_CID_SIG);
+    TEST_ASSERT_FATAL(chan != NULL);
+    TEST_ASSERT(chan->blc_cid == BLE_L2CAP_CID_SIG);
+    chan = ble_hs_conn_chan_find(conn, BLE_L2CAP_CID_SM);
+    TEST_ASSERT_FATAL(chan != NULL);
+    TEST_ASSERT(chan->blc_cid == BLE_L2CAP_CID_SM);
+    TEST_ASSERT(ble_hs_conn_chan_find(conn, 0x40) == NULL);
+
+    /*** Remove from the middle of a chain. */
+    conn = ble_hs_conn_find(handles[1]);
+    ble_hs_conn_remove(conn);
+    ble_hs_conn_free(conn);
+
+    TEST_ASSERT(ble_hs_conn_find(handles[0]) != NULL);
+    TEST_ASSERT(ble_hs_conn_find(handles[1]) == NULL);
+    TEST_ASSERT(ble_hs_conn_find(handles[2]) != NULL);
+
+    ble_hs_unlock();
+}
+
+TEST_CASE(ble_hs_conn_test_mem)
+{
+    struct ble_hs_mem_pool pool;
+    struct ble_hs_conn *conn;
+    struct ble_hs_cfg cfg;
+    uint32_t total;
+    int idx;
+    int rc;
+
+    ble_hs_test_util_init();
+
+    /*** Sizes follow the configured counts. */
+    cfg = ble_hs_cfg;
+    rc = ble_hs_mem_pool(&cfg, 1, &pool);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(strcmp(pool.name, "ble_hs_conn_pool") == 0);
+    TEST_ASSERT(pool.num_elems == cfg.max_connections);
+    TEST_ASSERT(pool.elem_size == sizeof (struct ble_hs_conn));
+    TEST_ASSERT(pool.bytes >= pool.num_elems * pool.elem_size);
+    TEST_ASSERT(pool.max_used == 0);
+
+    total = 0;
+    for (idx = 0; ble_hs_mem_pool(&cfg, idx, &pool) == 0; idx++) {
+        total += pool.bytes;
+    }
+    TEST_ASSERT(idx > 1);
+    TEST_ASSERT(total == ble_hs_mem_total(&cfg));
+
+    cfg.max_connections *= 2;
+    TEST_ASSERT(ble_hs_mem_total(&cfg) > total);
+
+    /*** The running host reports high-water marks. */
+    ble_hs_test_util_create_conn(2, ((uint8_t[]){ 1, 2, 3, 4, 5, 6 }),
+                                 NULL, NULL);
+    ble_hs_test_util_create_conn(3, ((uint8_t[]){ 2, 2, 3, 4, 5, 6 }),
+                                 NULL, NULL);
+
+    ble_hs_lock();
+    conn = ble_hs_conn_find(3);
+    ble_hs_conn_remove(conn);
+    ble_hs_conn_free(conn);
+    ble_hs_unlock();
+
+    rc = ble_hs_mem_pool(NULL, 1, &pool);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(pool.max_used == 2);
+    TEST_ASSERT(pool.num_fail == 0);
+
+    rc = ble_hs_mem_pool(NULL, 2, &pool);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(strcmp(pool.name, "ble_hs_conn_hash") == 0);
+
+    TEST_ASSERT(ble_hs_mem_pool(NULL, idx, &pool) == BLE_HS_ENOENT);
+}
+
 TEST_SUITE(conn_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -208,6 +314,8 @@ TEST_SUITE(conn_suite)
     ble_hs_conn_test_direct_connect_success();
     ble_hs_conn_test_direct_connectable_success();
     ble_hs_conn_test_undirect_connectable_success();
+    ble_hs_conn_test_find();
+    ble_hs_conn_test_mem();
 }
 
 int
@@ -83,12 +83,282 @@ TEST_CASE(ble_hs_hci_test_rssi)
     TEST_ASSERT(rc == BLE_HS_ECONTROLLER);
 }
 
+static void
+ble_hs_hci_test_acl_tx(uint16_t conn_handle, int payload_len)
+{
+    struct ble_l2cap_chan *chan;
+    struct ble_hs_conn *conn;
+    struct os_mbuf *om;
+    uint8_t byte;
+    int rc;
+    int i;
+
+    om = ble_hs_mbuf_l2cap_pkt();
+    TEST_ASSERT_FATAL(om != NULL);
+
+    for (i = 0; i < payload_len; i++) {
+        byte = i;
+        rc = os_mbuf_append(om, &byte, 1);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    ble_hs_lock();
+
+    rc = ble_hs_misc_conn_chan_find(conn_handle, BLE_L2CAP_CID_ATT,
+                                    &conn, &chan);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_l2cap_tx(conn, chan, om);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_unlock();
+}
+
+static void
+ble_hs_hci_test_acl_verify_frags(const uint16_t *conn_handles, int num_frags)
+{
+    struct hci_data_hdr hci_hdr;
+    struct os_mbuf *om;
+    int i;
+
+    ble_hs_test_util_tx_all();
+
+    for (i = 0; i < num_frags; i++) {
+        om = ble_hs_test_util_prev_tx_dequeue_frag(&hci_hdr);
+        TEST_ASSERT_FATAL(om != NULL);
+        TEST_ASSERT(BLE_HCI_DATA_HANDLE(hci_hdr.hdh_handle_pb_bc) ==
+                    conn_handles[i]);
+        os_mbuf_free_chain(om);
+    }
+
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue_frag(&hci_hdr) == NULL);
+}
+
+static void
+ble_hs_hci_test_acl_verify_outstanding(uint16_t conn_handle,
+                                       uint16_t exp_outstanding,
+                                       int exp_queued)
+{
+    struct ble_hs_conn *conn;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    TEST_ASSERT_FATAL(conn != NULL);
+    TEST_ASSERT(conn->bhc_outstanding_pkts == exp_outstanding);
+    TEST_ASSERT(STAILQ_EMPTY(&conn->bhc_tx_q) == !exp_queued);
+
+    ble_hs_unlock();
+}
+
+TEST_CASE(ble_hs_hci_test_acl_flow_ctrl)
+{
+    uint16_t exp_handles[32];
+    int rc;
+    int i;
+
+    ble_hs_test_util_init();
+    ble_hs_test_util_acl_auto_complete = 0;
+
+    /* 16-byte fragments; 32 controller buffers. */
+    rc = ble_hs_hci_set_buf_sz(16, 32);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_create_conn(1, ((uint8_t[]){1,2,3,4,5,6}), NULL, NULL);
+    ble_hs_test_util_create_conn(2, ((uint8_t[]){2,3,4,5,6,7}), NULL, NULL);
+
+    /*** Connection 1 sends 41 fragments; only 32 fit in the controller. */
+    ble_hs_hci_test_acl_tx(1, 41 * 16 - BLE_L2CAP_HDR_SZ);
+    ble_hs_hci_test_acl_verify_outstanding(1, 32, 1);
+    for (i = 0; i < 32; i++) {
+        exp_handles[i] = 1;
+    }
+    ble_hs_hci_test_acl_verify_frags(exp_handles, 32);
+
+    /*** Connection 2's two fragments wait for free buffers. */
+    ble_hs_hci_test_acl_tx(2, 2 * 16 - BLE_L2CAP_HDR_SZ);
+    ble_hs_hci_test_acl_verify_outstanding(2, 0, 1);
+
+    /*** Freed buffers are shared between the connections. */
+    ble_hs_test_util_rx_num_completed_pkts_event(
+        (struct ble_hs_test_util_num_completed_pkts_entry []) {
+            { 1, 4 },
+            { 0 }
+        });
+    ble_hs_hci_test_acl_verify_outstanding(1, 30, 1);
+    ble_hs_hci_test_acl_verify_outstanding(2, 2, 0);
+    ble_hs_hci_test_acl_verify_frags((uint16_t[]){ 1, 2, 1, 2 }, 4);
+
+    /*** Controller reports more packets than it holds; extra is ignored. */
+    ble_hs_test_util_rx_num_completed_pkts_event(
+        (struct ble_hs_test_util_num_completed_pkts_entry []) {
+            { 2, 5 },
+            { 0 }
+        });
+    ble_hs_hci_test_acl_verify_outstanding(1, 32, 1);
+    ble_hs_hci_test_acl_verify_outstanding(2, 0, 0);
+    ble_hs_hci_test_acl_verify_frags((uint16_t[]){ 1, 1 }, 2);
+
+    /*** Terminating connection 1 returns its buffers. */
+    ble_hs_test_util_conn_disconnect(1);
+    ble_hs_hci_test_acl_tx(2, 32 * 16 - BLE_L2CAP_HDR_SZ);
+    ble_hs_hci_test_acl_verify_outstanding(2, 32, 0);
+    for (i = 0; i < 32; i++) {
+        exp_handles[i] = 2;
+    }
+    ble_hs_hci_test_acl_verify_frags(exp_handles, 32);
+}
+
+static void
+ble_hs_hci_test_verify_tx_mbufs(uint16_t conn_handle, uint16_t exp_mbufs)
+{
+    struct ble_hs_conn *conn;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    TEST_ASSERT_FATAL(conn != NULL);
+    TEST_ASSERT(conn->bhc_tx_mbufs == exp_mbufs);
+
+    ble_hs_unlock();
+}
+
+TEST_CASE(ble_hs_hci_test_conn_tx_quota)
+{
+    struct os_mbuf *om;
+    int rc;
+    int i;
+
+    ble_hs_test_util_init();
+    ble_hs_test_util_acl_auto_complete = 0;
+    ble_hs_cfg.max_conn_tx_mbufs = 2;
+
+    /* One controller buffer. */
+    rc = ble_hs_hci_set_buf_sz(64, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_create_conn(1, ((uint8_t[]){1,2,3,4,5,6}), NULL, NULL);
+
+    /*** First packet goes to the controller; the next two are queued. */
+    for (i = 0; i < 3; i++) {
+        ble_hs_hci_test_acl_tx(1, 10);
+    }
+    ble_hs_hci_test_verify_tx_mbufs(1, 2);
+
+    /*** Connection is at its quota; notification refused. */
+    om = ble_hs_mbuf_from_flat((uint8_t[]){ 1, 2, 3 }, 3);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = ble_gattc_notify_custom(1, 0x0010, om);
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+
+    /*** Peer's request is refused with an error; write command dropped. */
+    ble_hs_test_util_l2cap_rx_payload_flat(1, BLE_L2CAP_CID_ATT,
+                                           ((uint8_t[]){
+                                               BLE_ATT_OP_READ_REQ, 1, 0 }),
+                                           3);
+    ble_hs_test_util_l2cap_rx_payload_flat(1, BLE_L2CAP_CID_ATT,
+                                           ((uint8_t[]){
+                                               BLE_ATT_OP_WRITE_CMD, 1, 0, 9 }),
+                                           4);
+    ble_hs_hci_test_verify_tx_mbufs(1, 3);
+
+    /*** Controller frees its buffers; queue drains. */
+    for (i = 0; i < 3; i++) {
+        ble_hs_test_util_rx_num_completed_pkts_event(
+            (struct ble_hs_test_util_num_completed_pkts_entry []) {
+                { 1, 1 },
+                { 0 }
+            });
+    }
+    ble_hs_hci_test_verify_tx_mbufs(1, 0);
+
+    ble_hs_test_util_tx_all();
+    for (i = 0; i < 3; i++) {
+        om = ble_hs_test_util_prev_tx_dequeue();
+        TEST_ASSERT_FATAL(om != NULL);
+        TEST_ASSERT(OS_MBUF_PKTLEN(om) == 10);
+    }
+    ble_hs_test_util_verify_tx_err_rsp(BLE_ATT_OP_READ_REQ, 1,
+                                       BLE_ATT_ERR_INSUFFICIENT_RES);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+
+    /*** Below quota again. */
+    om = ble_hs_mbuf_from_flat((uint8_t[]){ 1, 2, 3 }, 3);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = ble_gattc_notify_custom(1, 0x0010, om);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_rx_num_completed_pkts_event(
+        (struct ble_hs_test_util_num_completed_pkts_entry []) {
+            { 1, 1 },
+            { 0 }
+        });
+    ble_hs_test_util_tx_all();
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() != NULL);
+}
+
+#define BLE_HS_HCI_TEST_MAX_EVT_BUFS     64
+
+static int ble_hs_hci_test_evt_buf_avail;
+
+static int
+ble_hs_hci_test_release_gap_cb(struct ble_gap_event *event, void *arg)
+{
+    uint8_t *buf;
+
+    if (event->type == BLE_GAP_EVENT_DISCONNECT) {
+        buf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
+        ble_hs_hci_test_evt_buf_avail = buf != NULL;
+        if (buf != NULL) {
+            ble_hci_trans_buf_free(buf);
+        }
+    }
+
+    return 0;
+}
+
+TEST_CASE(ble_hs_hci_test_evt_release)
+{
+    struct hci_disconn_complete evt;
+    uint8_t *bufs[BLE_HS_HCI_TEST_MAX_EVT_BUFS];
+    int num_bufs;
+    int i;
+
+    ble_hs_test_util_init();
+
+    ble_hs_test_util_create_conn(2, ((uint8_t[]){2,3,4,5,6,7}),
+                                 ble_hs_hci_test_release_gap_cb, NULL);
+
+    /* Leave only one event buffer; the disconnect event will use it. */
+    for (num_bufs = 0; num_bufs < BLE_HS_HCI_TEST_MAX_EVT_BUFS; num_bufs++) {
+        bufs[num_bufs] = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
+        if (bufs[num_bufs] == NULL) {
+            break;
+        }
+    }
+    TEST_ASSERT_FATAL(num_bufs > 0 && num_bufs < BLE_HS_HCI_TEST_MAX_EVT_BUFS);
+    ble_hci_trans_buf_free(bufs[--num_bufs]);
+
+    /*** The buffer is back in the pool by the time the app is notified. */
+    evt.connection_handle = 2;
+    evt.status = 0;
+    evt.reason = BLE_ERR_CONN_TERM_LOCAL;
+    ble_hs_test_util_rx_disconn_complete_event(&evt);
+    TEST_ASSERT(ble_hs_hci_test_evt_buf_avail);
+
+    for (i = 0; i < num_bufs; i++) {
+        ble_hci_trans_buf_free(bufs[i]);
+    }
+}
+
 TEST_SUITE(ble_hs_hci_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
     ble_hs_hci_test_event_bad();
     ble_hs_hci_test_rssi();
+    ble_hs_hci_test_acl_flow_ctrl();
+    ble_hs_hci_test_evt_release();
+    ble_hs_hci_test_conn_tx_quota();
 }
 
 int
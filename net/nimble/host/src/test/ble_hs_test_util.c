@@ -42,9 +42,6 @@ uint8_t g_dev_addr[BLE_DEV_ADDR_LEN];
 #define BLE_HS_TEST_UTIL_MEMPOOL_SIZE   \
     OS_MEMPOOL_SIZE(BLE_HS_TEST_UTIL_NUM_MBUFS, BLE_HS_TEST_UTIL_MEMBLOCK_SIZE)
 
-#define BLE_HS_TEST_UTIL_LE_OPCODE(ocf) \
-    ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE, (ocf))
-
 struct os_eventq ble_hs_test_util_evq;
 
 os_membuf_t ble_hs_test_util_mbuf_mpool_data[BLE_HS_TEST_UTIL_MEMPOOL_SIZE];
@@ -61,6 +58,9 @@ int ble_hs_test_util_num_prev_hci_txes;
 
 uint8_t ble_hs_test_util_cur_hci_tx[260];
 
+/** Whether transmitted ACL data packets are immediately marked completed. */
+int ble_hs_test_util_acl_auto_complete;
+
 const struct ble_gap_adv_params ble_hs_test_util_adv_params = {
     .conn_mode = BLE_GAP_CONN_MODE_UND,
     .disc_mode = BLE_GAP_DISC_MODE_GEN,
@@ -87,8 +87,12 @@ ble_hs_test_util_prev_tx_enqueue(struct os_mbuf *om)
     }
 }
 
-static struct os_mbuf *
-ble_hs_test_util_prev_tx_dequeue_once(struct hci_data_hdr *out_hci_hdr)
+/**
+ * Removes a single ACL data fragment from the queue of transmitted packets.
+ * The caller is responsible for freeing the returned mbuf.
+ */
+struct os_mbuf *
+ble_hs_test_util_prev_tx_dequeue_frag(struct hci_data_hdr *out_hci_hdr)
 {
     struct os_mbuf_pkthdr *omp;
     struct os_mbuf *om;
@@ -120,7 +124,7 @@ ble_hs_test_util_prev_tx_dequeue(void)
 
     os_mbuf_free_chain(ble_hs_test_util_prev_tx_cur);
 
-    om = ble_hs_test_util_prev_tx_dequeue_once(&hci_hdr);
+    om = ble_hs_test_util_prev_tx_dequeue_frag(&hci_hdr);
     if (om != NULL) {
         pb = BLE_HCI_DATA_PB(hci_hdr.hdh_handle_pb_bc);
         TEST_ASSERT_FATAL(pb == BLE_HCI_PB_FIRST_NON_FLUSH);
@@ -134,7 +138,7 @@ ble_hs_test_util_prev_tx_dequeue(void)
         while (OS_MBUF_PKTLEN(ble_hs_test_util_prev_tx_cur) <
                l2cap_hdr.blh_len) {
 
-            om = ble_hs_test_util_prev_tx_dequeue_once(&hci_hdr);
+            om = ble_hs_test_util_prev_tx_dequeue_frag(&hci_hdr);
             TEST_ASSERT_FATAL(om != NULL);
 
             pb = BLE_HCI_DATA_PB(hci_hdr.hdh_handle_pb_bc);
@@ -250,15 +254,15 @@ ble_hs_test_util_rx_hci_evt(uint8_t *evt)
     totlen = BLE_HCI_EVENT_HDR_LEN + evt[1];
     TEST_ASSERT_FATAL(totlen <= UINT8_MAX + BLE_HCI_EVENT_HDR_LEN);
 
-    if (os_started()) {
-        evbuf = ble_hci_trans_buf_alloc(
-            BLE_HCI_TRANS_BUF_EVT_LO);
-        TEST_ASSERT_FATAL(evbuf != NULL);
+    /* The host frees the event buffer after processing it. */
+    evbuf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
+    TEST_ASSERT_FATAL(evbuf != NULL);
+    memcpy(evbuf, evt, totlen);
 
-        memcpy(evbuf, evt, totlen);
+    if (os_started()) {
         rc = ble_hci_trans_ll_evt_tx(evbuf);
     } else {
-        rc = ble_hs_hci_evt_process(evt);
+        rc = ble_hs_hci_evt_process(evbuf);
     }
 
     TEST_ASSERT_FATAL(rc == 0);
@@ -292,12 +296,6 @@ ble_hs_test_util_build_cmd_status(uint8_t *dst, int len,
 }
 
 #define BLE_HS_TEST_UTIL_PHONY_ACK_MAX  64
-struct ble_hs_test_util_phony_ack {
-    uint16_t opcode;
-    uint8_t status;
-    uint8_t evt_params[256];
-    uint8_t evt_params_len;
-};
 
 static struct ble_hs_test_util_phony_ack
 ble_hs_test_util_phony_acks[BLE_HS_TEST_UTIL_PHONY_ACK_MAX];
@@ -357,7 +355,7 @@ ble_hs_test_util_set_ack(uint16_t opcode, uint8_t status)
     ble_hs_test_util_set_ack_params(opcode, status, NULL, 0);
 }
 
-static void
+void
 ble_hs_test_util_set_ack_seq(struct ble_hs_test_util_phony_ack *acks)
 {
     int i;
@@ -769,7 +767,7 @@ ble_hs_test_util_wl_set(struct ble_gap_white_entry *white_list,
 
 int
 ble_hs_test_util_conn_update(uint16_t conn_handle,
-                             struct ble_gap_upd_params *params,
+                             const struct ble_gap_upd_params *params,
                              uint8_t hci_status)
 {
     int rc;
@@ -847,13 +845,14 @@ ble_hs_test_util_l2cap_rx(uint16_t conn_handle,
     struct ble_hs_conn *conn;
     ble_l2cap_rx_fn *rx_cb;
     struct os_mbuf *rx_buf;
+    uint16_t rx_cid;
     int rc;
 
     ble_hs_lock();
 
     conn = ble_hs_conn_find(conn_handle);
     if (conn != NULL) {
-        rc = ble_l2cap_rx(conn, hci_hdr, om, &rx_cb, &rx_buf);
+        rc = ble_l2cap_rx(conn, hci_hdr, om, &rx_cb, &rx_cid, &rx_buf);
     } else {
         os_mbuf_free_chain(om);
     }
@@ -865,7 +864,7 @@ ble_hs_test_util_l2cap_rx(uint16_t conn_handle,
     } else if (rc == 0) {
         TEST_ASSERT_FATAL(rx_cb != NULL);
         TEST_ASSERT_FATAL(rx_buf != NULL);
-        rc = rx_cb(conn_handle, &rx_buf);
+        rc = rx_cb(conn_handle, rx_cid, &rx_buf);
         os_mbuf_free_chain(rx_buf);
     } else if (rc == BLE_HS_EAGAIN) {
         /* More fragments on the way. */
@@ -1502,6 +1501,14 @@ ble_hs_test_util_mbuf_count(const struct ble_hs_test_util_mbuf_params *params)
         if (params->rx_queue) {
             SLIST_FOREACH(chan, &conn->bhc_channels, blc_next) {
                 count += ble_hs_test_util_mbuf_chain_len(chan->blc_rx_buf);
+                if (chan->blc_flags & BLE_L2CAP_CHAN_F_COC) {
+                    count += ble_hs_test_util_mbuf_chain_len(
+                        chan->blc_rx_sdu);
+                    STAILQ_FOREACH(omp, &chan->blc_tx_sdus, omp_next) {
+                        om = OS_MBUF_PKTHDR_TO_MBUF(omp);
+                        count += ble_hs_test_util_mbuf_chain_len(om);
+                    }
+                }
             }
         }
 
@@ -1545,7 +1552,21 @@ ble_hs_test_util_post_test(void *arg)
 static int
 ble_hs_test_util_pkt_txed(struct os_mbuf *om, void *arg)
 {
+    struct ble_hs_test_util_num_completed_pkts_entry entries[2];
+
+    if (ble_hs_test_util_acl_auto_complete) {
+        /* Act as a controller that frees each data buffer immediately. */
+        memset(entries, 0, sizeof entries);
+        entries[0].handle_id = BLE_HCI_DATA_HANDLE(le16toh(om->om_data));
+        entries[0].num_pkts = 1;
+    }
+
     ble_hs_test_util_prev_tx_enqueue(om);
+
+    if (ble_hs_test_util_acl_auto_complete) {
+        ble_hs_test_util_rx_num_completed_pkts_event(entries);
+    }
+
     return 0;
 }
 
@@ -1575,7 +1596,8 @@ ble_hs_test_util_init(void)
 
     cfg = ble_hs_cfg_dflt;
     cfg.max_connections = 8;
-    cfg.max_l2cap_chans = 3 * cfg.max_connections;
+    cfg.max_l2cap_chans = 3 * cfg.max_connections + 4;
+    cfg.max_l2cap_coc_servers = 2;
     cfg.max_services = 16;
     cfg.max_client_configs = 32;
     cfg.max_attrs = 64;
@@ -1602,6 +1624,8 @@ ble_hs_test_util_init(void)
 
     ble_hs_hci_set_phony_ack_cb(NULL);
 
+    ble_hs_test_util_acl_auto_complete = 1;
+
     ble_hci_trans_cfg_ll(ble_hs_test_util_hci_txed, NULL,
                          ble_hs_test_util_pkt_txed, NULL);
 
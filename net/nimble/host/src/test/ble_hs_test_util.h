@@ -31,6 +31,7 @@ struct hci_create_conn;
 
 extern struct os_eventq ble_hs_test_util_evq;
 extern const struct ble_gap_adv_params ble_hs_test_util_adv_params;
+extern int ble_hs_test_util_acl_auto_complete;
 
 struct ble_hs_test_util_num_completed_pkts_entry {
     uint16_t handle_id; /* 0 for terminating entry in array. */
@@ -50,6 +51,17 @@ struct ble_hs_test_util_mbuf_params {
     unsigned prep_list:1;
 };
 
+/** Array of phony acks is terminated by an entry with an opcode of 0. */
+struct ble_hs_test_util_phony_ack {
+    uint16_t opcode;
+    uint8_t status;
+    uint8_t evt_params[256];
+    uint8_t evt_params_len;
+};
+
+#define BLE_HS_TEST_UTIL_LE_OPCODE(ocf) \
+    ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE, (ocf))
+
 #define BLE_HS_TEST_UTIL_L2CAP_HCI_HDR(handle, pb, len) \
     ((struct hci_data_hdr) {                            \
         .hdh_handle_pb_bc = ((handle)  << 0) |          \
@@ -62,10 +74,13 @@ struct os_mbuf *ble_hs_test_util_prev_tx_dequeue(void);
 struct os_mbuf *ble_hs_test_util_prev_tx_dequeue_pullup(void);
 int ble_hs_test_util_prev_tx_queue_sz(void);
 void ble_hs_test_util_prev_tx_queue_clear(void);
+struct os_mbuf *ble_hs_test_util_prev_tx_dequeue_frag(
+    struct hci_data_hdr *out_hci_hdr);
 
 void ble_hs_test_util_set_ack_params(uint16_t opcode, uint8_t status,
                                      void *params, uint8_t params_len);
 void ble_hs_test_util_set_ack(uint16_t opcode, uint8_t status);
+void ble_hs_test_util_set_ack_seq(struct ble_hs_test_util_phony_ack *acks);
 void *ble_hs_test_util_get_first_hci_tx(void);
 void *ble_hs_test_util_get_last_hci_tx(void);
 void ble_hs_test_util_enqueue_hci_tx(void *cmd);
@@ -118,7 +133,7 @@ int ble_hs_test_util_wl_set(struct ble_gap_white_entry *white_list,
                             uint8_t white_list_count,
                             int fail_idx, uint8_t fail_status);
 int ble_hs_test_util_conn_update(uint16_t conn_handle,
-                                 struct ble_gap_upd_params *params,
+                                 const struct ble_gap_upd_params *params,
                                  uint8_t hci_status);
 int ble_hs_test_util_set_our_irk(const uint8_t *irk, int fail_idx,
                                  uint8_t hci_status);
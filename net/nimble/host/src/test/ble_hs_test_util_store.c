@@ -34,6 +34,10 @@ int ble_hs_test_util_store_num_our_secs;
 int ble_hs_test_util_store_num_peer_secs;
 int ble_hs_test_util_store_num_cccds;
 
+#define BLE_HS_TEST_UTIL_STORE_MAX_GATTS    64
+static struct ble_store_value_gatt
+    ble_hs_test_util_store_gatts[BLE_HS_TEST_UTIL_STORE_MAX_GATTS];
+int ble_hs_test_util_store_num_gatts;
 
 #define BLE_HS_TEST_UTIL_STORE_WRITE_GEN(store, num_vals, max_vals, \
                                          val, idx) do               \
@@ -78,6 +82,7 @@ ble_hs_test_util_store_init(int max_our_secs, int max_peer_secs, int max_cccds)
     ble_hs_test_util_store_num_our_secs = 0;
     ble_hs_test_util_store_num_peer_secs = 0;
     ble_hs_test_util_store_num_cccds = 0;
+    ble_hs_test_util_store_num_gatts = 0;
 }
 
 static int
@@ -181,6 +186,59 @@ ble_hs_test_util_store_read_cccd(struct ble_store_key_cccd *key,
     return 0;
 }
 
+static int
+ble_hs_test_util_store_find_gatt(struct ble_store_key_gatt *key)
+{
+    struct ble_store_value_gatt *cur;
+    int skipped;
+    int i;
+
+    skipped = 0;
+    for (i = 0; i < ble_hs_test_util_store_num_gatts; i++) {
+        cur = ble_hs_test_util_store_gatts + i;
+
+        if (key->peer_addr_type != BLE_STORE_ADDR_TYPE_NONE) {
+            if (cur->peer_addr_type != key->peer_addr_type) {
+                continue;
+            }
+
+            if (memcmp(cur->peer_addr, key->peer_addr, 6) != 0) {
+                continue;
+            }
+        }
+
+        if (key->type != BLE_STORE_GATT_TYPE_ANY) {
+            if (cur->type != key->type || cur->handle != key->handle) {
+                continue;
+            }
+        }
+
+        if (key->idx > skipped) {
+            skipped++;
+            continue;
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+static int
+ble_hs_test_util_store_read_gatt(struct ble_store_key_gatt *key,
+                                 struct ble_store_value_gatt *value)
+{
+    int idx;
+
+    idx = ble_hs_test_util_store_find_gatt(key);
+    if (idx == -1) {
+        return BLE_HS_ENOENT;
+    }
+
+    *value = ble_hs_test_util_store_gatts[idx];
+    return 0;
+}
+
 int
 ble_hs_test_util_store_read(int obj_type, union ble_store_key *key,
                             union ble_store_value *dst)
@@ -203,6 +261,9 @@ ble_hs_test_util_store_read(int obj_type, union ble_store_key *key,
     case BLE_STORE_OBJ_TYPE_CCCD:
         return ble_hs_test_util_store_read_cccd(&key->cccd, &dst->cccd);
 
+    case BLE_STORE_OBJ_TYPE_GATT:
+        return ble_hs_test_util_store_read_gatt(&key->gatt, &dst->gatt);
+
     default:
         TEST_ASSERT_FATAL(0);
         return BLE_HS_EUNKNOWN;
@@ -212,6 +273,7 @@ ble_hs_test_util_store_read(int obj_type, union ble_store_key *key,
 int
 ble_hs_test_util_store_write(int obj_type, union ble_store_value *value)
 {
+    struct ble_store_key_gatt key_gatt;
     struct ble_store_key_cccd key_cccd;
     int idx;
 
@@ -239,6 +301,15 @@ ble_hs_test_util_store_write(int obj_type, union ble_store_value *value)
             ble_hs_test_util_store_max_cccds,
             value->cccd, idx);
 
+    case BLE_STORE_OBJ_TYPE_GATT:
+        ble_store_key_from_value_gatt(&key_gatt, &value->gatt);
+        idx = ble_hs_test_util_store_find_gatt(&key_gatt);
+        BLE_HS_TEST_UTIL_STORE_WRITE_GEN(
+            ble_hs_test_util_store_gatts,
+            ble_hs_test_util_store_num_gatts,
+            BLE_HS_TEST_UTIL_STORE_MAX_GATTS,
+            value->gatt, idx);
+
     default:
         TEST_ASSERT_FATAL(0);
         return BLE_HS_EUNKNOWN;
@@ -246,3 +317,27 @@ ble_hs_test_util_store_write(int obj_type, union ble_store_value *value)
 
     return 0;
 }
+
+int
+ble_hs_test_util_store_delete(int obj_type, union ble_store_key *key)
+{
+    int idx;
+
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_GATT:
+        idx = ble_hs_test_util_store_find_gatt(&key->gatt);
+        if (idx == -1) {
+            return BLE_HS_ENOENT;
+        }
+
+        ble_hs_test_util_store_num_gatts--;
+        memmove(ble_hs_test_util_store_gatts + idx,
+                ble_hs_test_util_store_gatts + idx + 1,
+                (ble_hs_test_util_store_num_gatts - idx) *
+                    sizeof ble_hs_test_util_store_gatts[0]);
+        return 0;
+
+    default:
+        return BLE_HS_ENOTSUP;
+    }
+}
@@ -18,6 +18,7 @@
  */
 
 #include <stddef.h>
+#include <string.h>
 #include <errno.h>
 #include "testutil/testutil.h"
 #include "nimble/hci_common.h"
@@ -96,7 +97,8 @@ ble_l2cap_test_util_verify_tx_update_conn(
 }
 
 static int
-ble_l2cap_test_util_dummy_rx(uint16_t conn_handle, struct os_mbuf **om)
+ble_l2cap_test_util_dummy_rx(uint16_t conn_handle, uint16_t cid,
+                             struct os_mbuf **om)
 {
     return 0;
 }
@@ -317,6 +319,59 @@ TEST_CASE(ble_l2cap_test_case_frag_multiple)
     ble_l2cap_test_util_verify_last_frag(2, 1);
 }
 
+static void
+ble_l2cap_test_util_verify_rx_mbufs(uint16_t conn_handle, int in_progress,
+                                    int max_mbufs)
+{
+    struct ble_hs_conn *conn;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    TEST_ASSERT_FATAL(conn != NULL);
+    TEST_ASSERT((conn->bhc_rx_chan != NULL) == in_progress);
+    if (in_progress) {
+        TEST_ASSERT(conn->bhc_rx_mbufs <= max_mbufs);
+    }
+
+    ble_hs_unlock();
+}
+
+TEST_CASE(ble_l2cap_test_case_frag_rx_quota)
+{
+    int rc;
+    int i;
+
+    ble_l2cap_test_util_init();
+    ble_hs_cfg.max_conn_rx_mbufs = 3;
+
+    ble_l2cap_test_util_create_conn(2, ((uint8_t[]){1,2,3,4,5,6}),
+                                    NULL, NULL);
+
+    /*** Small fragments get packed; the packet stays within the quota. */
+    rc = ble_l2cap_test_util_rx_first_frag(2, 15, BLE_L2CAP_TEST_CID, 150);
+    TEST_ASSERT(rc == 0);
+    for (i = 1; i < 10; i++) {
+        rc = ble_l2cap_test_util_rx_next_frag(2, 15);
+        TEST_ASSERT(rc == 0);
+        ble_l2cap_test_util_verify_rx_mbufs(2, i < 9, 3);
+    }
+
+    /*** A packet that does not fit even when packed is dropped. */
+    ble_hs_cfg.max_conn_rx_mbufs = 2;
+    rc = ble_l2cap_test_util_rx_first_frag(2, 15, BLE_L2CAP_TEST_CID, 240);
+    TEST_ASSERT(rc == 0);
+    for (i = 1; i < 16; i++) {
+        rc = ble_l2cap_test_util_rx_next_frag(2, 15);
+        if (rc != 0) {
+            break;
+        }
+    }
+    TEST_ASSERT(i < 16);
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+    ble_l2cap_test_util_verify_rx_mbufs(2, 0, 0);
+}
+
 TEST_CASE(ble_l2cap_test_case_frag_channels)
 {
     struct ble_hs_conn *conn;
@@ -561,6 +616,580 @@ TEST_CASE(ble_l2cap_test_case_sig_update_init_fail_bad_id)
     TEST_ASSERT(ble_l2cap_test_update_arg == NULL);
 }
 
+/*****************************************************************************
+ * $coc                                                                      *
+ *****************************************************************************/
+
+#define BLE_L2CAP_TEST_COC_PSM          0x0080
+#define BLE_L2CAP_TEST_COC_PEER_CID     0x0041
+
+#define BLE_L2CAP_TEST_COC_MAX_EVENTS   8
+
+static struct ble_l2cap_coc_event
+    ble_l2cap_test_coc_events[BLE_L2CAP_TEST_COC_MAX_EVENTS];
+static int ble_l2cap_test_num_coc_events;
+
+/** Contents of the most recently received SDU. */
+static uint8_t ble_l2cap_test_coc_rx_data[512];
+static int ble_l2cap_test_coc_rx_len;
+
+static int
+ble_l2cap_test_util_coc_cb(struct ble_l2cap_coc_event *event, void *arg)
+{
+    int rc;
+
+    TEST_ASSERT_FATAL(ble_l2cap_test_num_coc_events <
+                      BLE_L2CAP_TEST_COC_MAX_EVENTS);
+
+    ble_l2cap_test_coc_events[ble_l2cap_test_num_coc_events++] = *event;
+
+    if (event->type == BLE_L2CAP_COC_EVENT_RX) {
+        ble_l2cap_test_coc_rx_len = OS_MBUF_PKTLEN(event->rx.sdu);
+        TEST_ASSERT_FATAL(ble_l2cap_test_coc_rx_len <=
+                          sizeof ble_l2cap_test_coc_rx_data);
+        rc = os_mbuf_copydata(event->rx.sdu, 0, ble_l2cap_test_coc_rx_len,
+                              ble_l2cap_test_coc_rx_data);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    return 0;
+}
+
+static void
+ble_l2cap_test_util_coc_init(void)
+{
+    ble_l2cap_test_util_init();
+    ble_l2cap_test_num_coc_events = 0;
+    ble_l2cap_test_coc_rx_len = 0;
+}
+
+static int
+ble_l2cap_test_util_rx_sig_cmd(uint16_t conn_handle, uint8_t op, uint8_t id,
+                               const void *payload, int len)
+{
+    struct hci_data_hdr hci_hdr;
+    struct os_mbuf *om;
+    void *v;
+    int rc;
+
+    hci_hdr = BLE_HS_TEST_UTIL_L2CAP_HCI_HDR(
+        conn_handle, BLE_HCI_PB_FIRST_FLUSH,
+        BLE_L2CAP_HDR_SZ + BLE_L2CAP_SIG_HDR_SZ + len);
+
+    rc = ble_l2cap_sig_init_cmd(op, id, len, &om, &v);
+    TEST_ASSERT_FATAL(rc == 0);
+    memcpy(v, payload, len);
+
+    return ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SIG,
+                                                &hci_hdr, om);
+}
+
+static int
+ble_l2cap_test_util_rx_coc_req(uint16_t conn_handle, uint8_t id,
+                               uint16_t psm, uint16_t scid, uint16_t mtu,
+                               uint16_t mps, uint16_t credits)
+{
+    struct ble_l2cap_sig_coc_req req;
+    uint8_t buf[BLE_L2CAP_SIG_COC_REQ_SZ];
+
+    req.psm = psm;
+    req.scid = scid;
+    req.mtu = mtu;
+    req.mps = mps;
+    req.credits = credits;
+    ble_l2cap_sig_coc_req_write(buf, sizeof buf, &req);
+
+    return ble_l2cap_test_util_rx_sig_cmd(conn_handle,
+                                          BLE_L2CAP_SIG_OP_CREDIT_CONNECT_REQ,
+                                          id, buf, sizeof buf);
+}
+
+static int
+ble_l2cap_test_util_rx_coc_rsp(uint16_t conn_handle, uint8_t id,
+                               uint16_t dcid, uint16_t mtu, uint16_t mps,
+                               uint16_t credits, uint16_t result)
+{
+    struct ble_l2cap_sig_coc_rsp rsp;
+    uint8_t buf[BLE_L2CAP_SIG_COC_RSP_SZ];
+
+    rsp.dcid = dcid;
+    rsp.mtu = mtu;
+    rsp.mps = mps;
+    rsp.credits = credits;
+    rsp.result = result;
+    ble_l2cap_sig_coc_rsp_write(buf, sizeof buf, &rsp);
+
+    return ble_l2cap_test_util_rx_sig_cmd(conn_handle,
+                                          BLE_L2CAP_SIG_OP_CREDIT_CONNECT_RSP,
+                                          id, buf, sizeof buf);
+}
+
+static int
+ble_l2cap_test_util_rx_le_credits(uint16_t conn_handle, uint16_t cid,
+                                  uint16_t credits)
+{
+    struct ble_l2cap_sig_le_credits cmd;
+    uint8_t buf[BLE_L2CAP_SIG_LE_CREDITS_SZ];
+
+    cmd.cid = cid;
+    cmd.credits = credits;
+    ble_l2cap_sig_le_credits_write(buf, sizeof buf, &cmd);
+
+    return ble_l2cap_test_util_rx_sig_cmd(conn_handle,
+                                          BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT,
+                                          1, buf, sizeof buf);
+}
+
+static int
+ble_l2cap_test_util_rx_disconn(uint16_t conn_handle, uint8_t op, uint8_t id,
+                               uint16_t dcid, uint16_t scid)
+{
+    struct ble_l2cap_sig_disconn cmd;
+    uint8_t buf[BLE_L2CAP_SIG_DISCONN_REQ_SZ];
+
+    cmd.dcid = dcid;
+    cmd.scid = scid;
+    ble_l2cap_sig_disconn_write(buf, sizeof buf, &cmd);
+
+    return ble_l2cap_test_util_rx_sig_cmd(conn_handle, op, id,
+                                          buf, sizeof buf);
+}
+
+/**
+ * Receives a single K-frame.  If sdu_len is nonzero, the frame is the first
+ * of its SDU and starts with the SDU length field.
+ */
+static int
+ble_l2cap_test_util_rx_kframe(uint16_t conn_handle, uint16_t cid,
+                              uint16_t sdu_len, const uint8_t *data, int len)
+{
+    uint8_t buf[BLE_L2CAP_COC_MPS];
+    int off;
+
+    off = 0;
+    if (sdu_len != 0) {
+        htole16(buf, sdu_len);
+        off = BLE_L2CAP_COC_SDU_HDR_SZ;
+    }
+    TEST_ASSERT_FATAL(off + len <= sizeof buf);
+    memcpy(buf + off, data, len);
+
+    return ble_hs_test_util_l2cap_rx_payload_flat(conn_handle, cid, buf,
+                                                  off + len);
+}
+
+/**
+ * Verifies that a signalling command was sent and returns its payload.
+ */
+static struct os_mbuf *
+ble_l2cap_test_util_verify_tx_sig_cmd(uint8_t op, uint16_t payload_len,
+                                      struct ble_l2cap_sig_hdr *out_hdr)
+{
+    struct os_mbuf *om;
+
+    ble_hs_test_util_tx_all();
+
+    om = ble_hs_test_util_prev_tx_dequeue_pullup();
+    TEST_ASSERT_FATAL(om != NULL);
+    TEST_ASSERT_FATAL(OS_MBUF_PKTLEN(om) ==
+                      BLE_L2CAP_SIG_HDR_SZ + payload_len);
+
+    ble_l2cap_sig_hdr_parse(om->om_data, om->om_len, out_hdr);
+    TEST_ASSERT(out_hdr->op == op);
+    TEST_ASSERT(out_hdr->length == payload_len);
+
+    os_mbuf_adj(om, BLE_L2CAP_SIG_HDR_SZ);
+    return om;
+}
+
+static void
+ble_l2cap_test_util_verify_tx_le_credits(uint16_t exp_cid,
+                                         uint16_t exp_credits)
+{
+    struct ble_l2cap_sig_le_credits cmd;
+    struct ble_l2cap_sig_hdr hdr;
+    struct os_mbuf *om;
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_FLOW_CTRL_CREDIT, BLE_L2CAP_SIG_LE_CREDITS_SZ, &hdr);
+    ble_l2cap_sig_le_credits_parse(om->om_data, om->om_len, &cmd);
+    TEST_ASSERT(cmd.cid == exp_cid);
+    TEST_ASSERT(cmd.credits == exp_credits);
+}
+
+/**
+ * Verifies that a K-frame was sent to the peer.
+ *
+ * @param exp_sdu_len           The expected SDU length field; 0 if the
+ *                                  frame is not the first of its SDU.
+ */
+static void
+ble_l2cap_test_util_verify_tx_kframe(uint16_t exp_sdu_len,
+                                     const uint8_t *exp_data, int exp_len)
+{
+    struct os_mbuf *om;
+    int off;
+
+    om = ble_hs_test_util_prev_tx_dequeue_pullup();
+    TEST_ASSERT_FATAL(om != NULL);
+
+    off = 0;
+    if (exp_sdu_len != 0) {
+        TEST_ASSERT_FATAL(om->om_len >= BLE_L2CAP_COC_SDU_HDR_SZ);
+        TEST_ASSERT(le16toh(om->om_data) == exp_sdu_len);
+        off = BLE_L2CAP_COC_SDU_HDR_SZ;
+    }
+
+    TEST_ASSERT_FATAL(om->om_len == off + exp_len);
+    TEST_ASSERT(memcmp(om->om_data + off, exp_data, exp_len) == 0);
+}
+
+/**
+ * Has the peer open a channel to our server and returns the local CID.
+ */
+static uint16_t
+ble_l2cap_test_util_coc_peer_connects(uint16_t mtu, uint16_t mps,
+                                      uint16_t credits)
+{
+    struct ble_l2cap_sig_coc_rsp rsp;
+    struct ble_l2cap_sig_hdr hdr;
+    struct os_mbuf *om;
+    int rc;
+
+    rc = ble_l2cap_coc_create_server(BLE_L2CAP_TEST_COC_PSM, 300,
+                                     ble_l2cap_test_util_coc_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_l2cap_test_util_rx_coc_req(2, 5, BLE_L2CAP_TEST_COC_PSM,
+                                        BLE_L2CAP_TEST_COC_PEER_CID,
+                                        mtu, mps, credits);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_CREDIT_CONNECT_RSP, BLE_L2CAP_SIG_COC_RSP_SZ, &hdr);
+    TEST_ASSERT(hdr.identifier == 5);
+    ble_l2cap_sig_coc_rsp_parse(om->om_data, om->om_len, &rsp);
+    TEST_ASSERT_FATAL(rsp.result == 0);
+    TEST_ASSERT(rsp.dcid >= BLE_L2CAP_CID_DYN_MIN &&
+                rsp.dcid <= BLE_L2CAP_CID_DYN_MAX);
+    TEST_ASSERT(rsp.mtu == 300);
+    TEST_ASSERT(rsp.mps == BLE_L2CAP_COC_MPS);
+
+    /* Enough credits for one full SDU. */
+    TEST_ASSERT(rsp.credits == 2);
+
+    TEST_ASSERT_FATAL(ble_l2cap_test_num_coc_events == 1);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].type ==
+                BLE_L2CAP_COC_EVENT_CONNECT);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].conn_handle == 2);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].cid == rsp.dcid);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].connect.status == 0);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].connect.peer_mtu == mtu);
+
+    ble_l2cap_test_num_coc_events = 0;
+
+    return rsp.dcid;
+}
+
+/**
+ * Opens a channel to the peer's PSM and returns the local CID.
+ */
+static uint16_t
+ble_l2cap_test_util_coc_we_connect(uint16_t peer_mtu, uint16_t peer_mps,
+                                   uint16_t credits)
+{
+    struct ble_l2cap_sig_coc_req req;
+    struct ble_l2cap_sig_hdr hdr;
+    struct os_mbuf *om;
+    int rc;
+
+    rc = ble_l2cap_coc_connect(2, BLE_L2CAP_TEST_COC_PSM, 100,
+                               ble_l2cap_test_util_coc_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_CREDIT_CONNECT_REQ, BLE_L2CAP_SIG_COC_REQ_SZ, &hdr);
+    ble_l2cap_sig_coc_req_parse(om->om_data, om->om_len, &req);
+    TEST_ASSERT(req.psm == BLE_L2CAP_TEST_COC_PSM);
+    TEST_ASSERT(req.mtu == 100);
+    TEST_ASSERT(req.mps == 100 + BLE_L2CAP_COC_SDU_HDR_SZ);
+    TEST_ASSERT(req.credits == 1);
+
+    /* No event until the peer responds. */
+    TEST_ASSERT(ble_l2cap_test_num_coc_events == 0);
+
+    rc = ble_l2cap_test_util_rx_coc_rsp(2, hdr.identifier,
+                                        BLE_L2CAP_TEST_COC_PEER_CID,
+                                        peer_mtu, peer_mps, credits, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    TEST_ASSERT_FATAL(ble_l2cap_test_num_coc_events == 1);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].type ==
+                BLE_L2CAP_COC_EVENT_CONNECT);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].cid == req.scid);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].connect.status == 0);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].connect.peer_mtu == peer_mtu);
+
+    ble_l2cap_test_num_coc_events = 0;
+
+    return req.scid;
+}
+
+TEST_CASE(ble_l2cap_test_case_coc_peer_connects)
+{
+    uint8_t data[300];
+    uint16_t cid;
+    int rc;
+    int i;
+
+    ble_l2cap_test_util_coc_init();
+    ble_l2cap_test_util_create_conn(2, ((uint8_t[]){1,2,3,4,5,6}),
+                                    NULL, NULL);
+
+    cid = ble_l2cap_test_util_coc_peer_connects(100, 50, 4);
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i;
+    }
+
+    /* Receive a 300-byte SDU split across two K-frames. */
+    rc = ble_l2cap_test_util_rx_kframe(2, cid, 300, data,
+                                       BLE_L2CAP_COC_MPS -
+                                       BLE_L2CAP_COC_SDU_HDR_SZ);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_l2cap_test_num_coc_events == 0);
+
+    rc = ble_l2cap_test_util_rx_kframe(
+        2, cid, 0, data + BLE_L2CAP_COC_MPS - BLE_L2CAP_COC_SDU_HDR_SZ,
+        300 - (BLE_L2CAP_COC_MPS - BLE_L2CAP_COC_SDU_HDR_SZ));
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT_FATAL(ble_l2cap_test_num_coc_events == 1);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].type == BLE_L2CAP_COC_EVENT_RX);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].cid == cid);
+    TEST_ASSERT(ble_l2cap_test_coc_rx_len == 300);
+    TEST_ASSERT(memcmp(ble_l2cap_test_coc_rx_data, data, 300) == 0);
+
+    /* Ensure the consumed credits were returned to the peer. */
+    ble_l2cap_test_util_verify_tx_le_credits(cid, 2);
+}
+
+TEST_CASE(ble_l2cap_test_case_coc_peer_connects_fail)
+{
+    struct ble_l2cap_sig_coc_rsp rsp;
+    struct ble_l2cap_sig_hdr hdr;
+    struct os_mbuf *om;
+    int rc;
+
+    ble_l2cap_test_util_coc_init();
+    ble_l2cap_test_util_create_conn(2, ((uint8_t[]){1,2,3,4,5,6}),
+                                    NULL, NULL);
+
+    /*** No server on the requested PSM. */
+    rc = ble_l2cap_test_util_rx_coc_req(2, 5, BLE_L2CAP_TEST_COC_PSM,
+                                        BLE_L2CAP_TEST_COC_PEER_CID,
+                                        100, 50, 4);
+    TEST_ASSERT(rc == 0);
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_CREDIT_CONNECT_RSP, BLE_L2CAP_SIG_COC_RSP_SZ, &hdr);
+    ble_l2cap_sig_coc_rsp_parse(om->om_data, om->om_len, &rsp);
+    TEST_ASSERT(rsp.result == BLE_L2CAP_COC_ERR_NO_PSM);
+
+    /*** MPS too small. */
+    rc = ble_l2cap_coc_create_server(BLE_L2CAP_TEST_COC_PSM, 300,
+                                     ble_l2cap_test_util_coc_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_l2cap_test_util_rx_coc_req(2, 6, BLE_L2CAP_TEST_COC_PSM,
+                                        BLE_L2CAP_TEST_COC_PEER_CID,
+                                        100, 22, 4);
+    TEST_ASSERT(rc == 0);
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_CREDIT_CONNECT_RSP, BLE_L2CAP_SIG_COC_RSP_SZ, &hdr);
+    ble_l2cap_sig_coc_rsp_parse(om->om_data, om->om_len, &rsp);
+    TEST_ASSERT(rsp.result == BLE_L2CAP_COC_ERR_UNACCEPTABLE_PARAMS);
+
+    /*** Source CID outside the dynamic range. */
+    rc = ble_l2cap_test_util_rx_coc_req(2, 7, BLE_L2CAP_TEST_COC_PSM,
+                                        BLE_L2CAP_CID_ATT, 100, 50, 4);
+    TEST_ASSERT(rc == 0);
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_CREDIT_CONNECT_RSP, BLE_L2CAP_SIG_COC_RSP_SZ, &hdr);
+    ble_l2cap_sig_coc_rsp_parse(om->om_data, om->om_len, &rsp);
+    TEST_ASSERT(rsp.result == BLE_L2CAP_COC_ERR_INVALID_SOURCE_CID);
+
+    /* The application never heard about any of these. */
+    TEST_ASSERT(ble_l2cap_test_num_coc_events == 0);
+}
+
+TEST_CASE(ble_l2cap_test_case_coc_tx_credits)
+{
+    uint8_t data[100];
+    uint16_t cid;
+    int rc;
+    int i;
+
+    ble_l2cap_test_util_coc_init();
+    ble_l2cap_test_util_create_conn(2, ((uint8_t[]){1,2,3,4,5,6}),
+                                    NULL, NULL);
+
+    /* Peer accepts 100-byte SDUs in 30-byte K-frames, with two credits. */
+    cid = ble_l2cap_test_util_coc_we_connect(100, 30, 2);
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i;
+    }
+
+    /*** SDU too big for the peer. */
+    rc = ble_l2cap_coc_send(2, cid, ble_hs_test_util_om_from_flat(data, 101));
+    TEST_ASSERT(rc == BLE_HS_EMSGSIZE);
+
+    /*** SDU of the peer's MTU. */
+    rc = ble_l2cap_coc_send(2, cid, ble_hs_test_util_om_from_flat(data, 100));
+    TEST_ASSERT(rc == 0);
+
+    /* The 100-byte SDU needs four K-frames; only two go out. */
+    ble_hs_test_util_tx_all();
+    ble_l2cap_test_util_verify_tx_kframe(100, data, 28);
+    ble_l2cap_test_util_verify_tx_kframe(0, data + 28, 30);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+
+    /* Peer grants more credits; the rest of the SDU follows. */
+    rc = ble_l2cap_test_util_rx_le_credits(2, BLE_L2CAP_TEST_COC_PEER_CID, 5);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_tx_all();
+    ble_l2cap_test_util_verify_tx_kframe(0, data + 58, 30);
+    ble_l2cap_test_util_verify_tx_kframe(0, data + 88, 12);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+
+    /*** Credits for an unknown channel. */
+    rc = ble_l2cap_test_util_rx_le_credits(2, BLE_L2CAP_TEST_COC_PEER_CID + 1,
+                                           5);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+}
+
+TEST_CASE(ble_l2cap_test_case_coc_we_connect_reject)
+{
+    struct ble_l2cap_sig_coc_req req;
+    struct ble_l2cap_sig_hdr hdr;
+    struct os_mbuf *om;
+    int rc;
+
+    ble_l2cap_test_util_coc_init();
+    ble_l2cap_test_util_create_conn(2, ((uint8_t[]){1,2,3,4,5,6}),
+                                    NULL, NULL);
+
+    rc = ble_l2cap_coc_connect(2, BLE_L2CAP_TEST_COC_PSM, 100,
+                               ble_l2cap_test_util_coc_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_CREDIT_CONNECT_REQ, BLE_L2CAP_SIG_COC_REQ_SZ, &hdr);
+    ble_l2cap_sig_coc_req_parse(om->om_data, om->om_len, &req);
+
+    rc = ble_l2cap_test_util_rx_coc_rsp(2, hdr.identifier, 0, 0, 0, 0,
+                                        BLE_L2CAP_COC_ERR_NO_PSM);
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT_FATAL(ble_l2cap_test_num_coc_events == 1);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].type ==
+                BLE_L2CAP_COC_EVENT_CONNECT);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].cid == req.scid);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].connect.status ==
+                BLE_HS_L2C_ERR(BLE_L2CAP_COC_ERR_NO_PSM));
+
+    /* The channel is gone. */
+    rc = ble_l2cap_coc_send(2, req.scid,
+                            ble_hs_test_util_om_from_flat("a", 1));
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+}
+
+TEST_CASE(ble_l2cap_test_case_coc_disconnect)
+{
+    struct ble_l2cap_sig_disconn cmd;
+    struct ble_l2cap_sig_hdr hdr;
+    struct os_mbuf *om;
+    uint16_t cid;
+    int rc;
+
+    ble_l2cap_test_util_coc_init();
+    ble_l2cap_test_util_create_conn(2, ((uint8_t[]){1,2,3,4,5,6}),
+                                    NULL, NULL);
+
+    /*** We disconnect. */
+    cid = ble_l2cap_test_util_coc_we_connect(100, 30, 2);
+
+    rc = ble_l2cap_coc_disconnect(2, cid);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_DISCONN_REQ, BLE_L2CAP_SIG_DISCONN_REQ_SZ, &hdr);
+    ble_l2cap_sig_disconn_parse(om->om_data, om->om_len, &cmd);
+    TEST_ASSERT(cmd.dcid == BLE_L2CAP_TEST_COC_PEER_CID);
+    TEST_ASSERT(cmd.scid == cid);
+
+    /* No data goes out while the disconnect is pending. */
+    rc = ble_l2cap_coc_send(2, cid, ble_hs_test_util_om_from_flat("a", 1));
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    rc = ble_l2cap_test_util_rx_disconn(2, BLE_L2CAP_SIG_OP_DISCONN_RSP,
+                                        hdr.identifier,
+                                        BLE_L2CAP_TEST_COC_PEER_CID, cid);
+    TEST_ASSERT(rc == 0);
+
+    TEST_ASSERT_FATAL(ble_l2cap_test_num_coc_events == 1);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].type ==
+                BLE_L2CAP_COC_EVENT_DISCONNECT);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].cid == cid);
+
+    /*** Peer disconnects. */
+    ble_l2cap_test_num_coc_events = 0;
+    cid = ble_l2cap_test_util_coc_we_connect(100, 30, 2);
+
+    rc = ble_l2cap_test_util_rx_disconn(2, BLE_L2CAP_SIG_OP_DISCONN_REQ, 9,
+                                        cid, BLE_L2CAP_TEST_COC_PEER_CID);
+    TEST_ASSERT(rc == 0);
+
+    om = ble_l2cap_test_util_verify_tx_sig_cmd(
+        BLE_L2CAP_SIG_OP_DISCONN_RSP, BLE_L2CAP_SIG_DISCONN_RSP_SZ, &hdr);
+    TEST_ASSERT(hdr.identifier == 9);
+    ble_l2cap_sig_disconn_parse(om->om_data, om->om_len, &cmd);
+    TEST_ASSERT(cmd.dcid == cid);
+    TEST_ASSERT(cmd.scid == BLE_L2CAP_TEST_COC_PEER_CID);
+
+    TEST_ASSERT_FATAL(ble_l2cap_test_num_coc_events == 1);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].type ==
+                BLE_L2CAP_COC_EVENT_DISCONNECT);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].cid == cid);
+}
+
+TEST_CASE(ble_l2cap_test_case_coc_conn_broken)
+{
+    uint16_t cid;
+    int rc;
+
+    ble_l2cap_test_util_coc_init();
+    ble_l2cap_test_util_create_conn(2, ((uint8_t[]){1,2,3,4,5,6}),
+                                    NULL, NULL);
+
+    cid = ble_l2cap_test_util_coc_we_connect(100, 30, 0);
+
+    /* Queue an SDU that cannot be sent for lack of credits. */
+    rc = ble_l2cap_coc_send(2, cid, ble_hs_test_util_om_from_flat("a", 1));
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_conn_disconnect(2);
+
+    TEST_ASSERT_FATAL(ble_l2cap_test_num_coc_events == 1);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].type ==
+                BLE_L2CAP_COC_EVENT_DISCONNECT);
+    TEST_ASSERT(ble_l2cap_test_coc_events[0].cid == cid);
+}
+
 TEST_SUITE(ble_l2cap_test_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -569,6 +1198,7 @@ TEST_SUITE(ble_l2cap_test_suite)
     ble_l2cap_test_case_frag_single();
     ble_l2cap_test_case_frag_multiple();
     ble_l2cap_test_case_frag_channels();
+    ble_l2cap_test_case_frag_rx_quota();
     ble_l2cap_test_case_sig_unsol_rsp();
     ble_l2cap_test_case_sig_update_accept();
     ble_l2cap_test_case_sig_update_reject();
@@ -576,6 +1206,12 @@ TEST_SUITE(ble_l2cap_test_suite)
     ble_l2cap_test_case_sig_update_init_reject();
     ble_l2cap_test_case_sig_update_init_fail_master();
     ble_l2cap_test_case_sig_update_init_fail_bad_id();
+    ble_l2cap_test_case_coc_peer_connects();
+    ble_l2cap_test_case_coc_peer_connects_fail();
+    ble_l2cap_test_case_coc_tx_credits();
+    ble_l2cap_test_case_coc_we_connect_reject();
+    ble_l2cap_test_case_coc_disconnect();
+    ble_l2cap_test_case_coc_conn_broken();
 }
 
 int
@@ -77,11 +77,55 @@ TEST_CASE(ble_uuid_test_128_to_16)
     }));
 }
 
+TEST_CASE(ble_uuid_test_any)
+{
+    struct ble_uuid_any uuid1;
+    struct ble_uuid_any uuid2;
+    uint8_t uuid128[16];
+
+    /*** 16-bit form from either representation. */
+    ble_uuid_any_from_128(&uuid1, BLE_UUID16(0x2a37));
+    TEST_ASSERT(uuid1.type == BLE_UUID_TYPE_16);
+    TEST_ASSERT(uuid1.u32 == 0x2a37);
+    TEST_ASSERT(ble_uuid_any_to_16(&uuid1) == 0x2a37);
+
+    ble_uuid_any_from_16(&uuid2, 0x2a37);
+    TEST_ASSERT(ble_uuid_any_cmp(&uuid1, &uuid2) == 0);
+
+    ble_uuid_any_to_128(&uuid1, uuid128);
+    TEST_ASSERT(memcmp(uuid128, BLE_UUID16(0x2a37), 16) == 0);
+
+    /*** 32-bit form. */
+    memcpy(uuid128, BLE_UUID16(0x2a37), 16);
+    uuid128[15] = 0x12;
+    ble_uuid_any_from_128(&uuid1, uuid128);
+    TEST_ASSERT(uuid1.type == BLE_UUID_TYPE_32);
+    TEST_ASSERT(uuid1.u32 == 0x12002a37);
+    TEST_ASSERT(ble_uuid_any_to_16(&uuid1) == 0);
+    TEST_ASSERT(ble_uuid_any_cmp(&uuid1, &uuid2) != 0);
+
+    /*** Full 128-bit UUID. */
+    memcpy(uuid128, BLE_UUID16(0x2a37), 16);
+    uuid128[0] = 0x00;
+    ble_uuid_any_from_128(&uuid1, uuid128);
+    TEST_ASSERT(uuid1.type == BLE_UUID_TYPE_128);
+    TEST_ASSERT(memcmp(uuid1.u128, uuid128, 16) == 0);
+    TEST_ASSERT(ble_uuid_any_cmp(&uuid1, &uuid2) != 0);
+
+    ble_uuid_any_from_128(&uuid2, uuid128);
+    TEST_ASSERT(ble_uuid_any_cmp(&uuid1, &uuid2) == 0);
+
+    /*** Base UUID itself has no short form. */
+    ble_uuid_any_from_128(&uuid1, BLE_UUID16(0));
+    TEST_ASSERT(uuid1.type == BLE_UUID_TYPE_128);
+}
+
 TEST_SUITE(ble_uuid_test_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
     ble_uuid_test_128_to_16();
+    ble_uuid_test_any();
 }
 
 int
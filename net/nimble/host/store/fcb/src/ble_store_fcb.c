@@ -0,0 +1,1034 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * This file implements a flash-backed key database for BLE host security
+ * material, CCCDs and cached GATT databases of peers.  Every write and delete is appended to a flash circular
+ * buffer (FCB) as a fixed-size record; at init the FCB is replayed into a RAM
+ * mirror so that bonds survive a reboot.  Security entries are indexed by peer
+ * identity address and by ediv/rand, so the lookups performed when a bonded
+ * peer reconnects do not need to scan the whole table.
+ *
+ * When the FCB fills up, live records in the oldest sector are copied forward
+ * into the scratch sector and the oldest sector is erased.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "hal/flash_map.h"
+#include "fcb/fcb.h"
+#include "host/ble_hs.h"
+#include "store/fcb/ble_store_fcb.h"
+
+#ifndef BLE_STORE_FCB_MAX_OUR_SECS
+#define BLE_STORE_FCB_MAX_OUR_SECS      8
+#endif
+
+#ifndef BLE_STORE_FCB_MAX_PEER_SECS
+#define BLE_STORE_FCB_MAX_PEER_SECS     8
+#endif
+
+#ifndef BLE_STORE_FCB_MAX_CCCDS
+#define BLE_STORE_FCB_MAX_CCCDS         16
+#endif
+
+#ifndef BLE_STORE_FCB_MAX_GATTS
+#define BLE_STORE_FCB_MAX_GATTS         64
+#endif
+
+/** Number of hash buckets per security index; must be a power of two. */
+#define BLE_STORE_FCB_SEC_BUCKETS       8
+
+#define BLE_STORE_FCB_MAGIC             0xb1e5b0d5
+#define BLE_STORE_FCB_VERS              1
+
+#define BLE_STORE_FCB_OP_WRITE          1
+#define BLE_STORE_FCB_OP_DELETE         2
+
+/** Maximum number of compressions attempted by a single append. */
+#define BLE_STORE_FCB_APPEND_TRIES      10
+
+/** Layout of a single record in flash. */
+struct ble_store_fcb_rec {
+    uint8_t obj_type;
+    uint8_t op;
+    union ble_store_value value;
+};
+
+struct ble_store_fcb_sec_entry {
+    struct ble_store_value_sec value;
+
+    /** Location of the record that most recently wrote this entry. */
+    struct fcb_entry loc;
+
+    /** Next entry in the same hash bucket; -1 terminates the chain. */
+    int8_t addr_next;
+    int8_t ediv_next;
+};
+
+struct ble_store_fcb_sec_tbl {
+    struct ble_store_fcb_sec_entry *entries;
+    int max;
+    int num;
+
+    int8_t addr_buckets[BLE_STORE_FCB_SEC_BUCKETS];
+    int8_t ediv_buckets[BLE_STORE_FCB_SEC_BUCKETS];
+};
+
+struct ble_store_fcb_cccd_entry {
+    struct ble_store_value_cccd value;
+    struct fcb_entry loc;
+};
+
+struct ble_store_fcb_gatt_entry {
+    struct ble_store_value_gatt value;
+    struct fcb_entry loc;
+};
+
+static struct fcb *ble_store_fcb;
+
+static struct ble_store_fcb_sec_entry
+    ble_store_fcb_our_sec_entries[BLE_STORE_FCB_MAX_OUR_SECS];
+static struct ble_store_fcb_sec_tbl ble_store_fcb_our_secs = {
+    .entries = ble_store_fcb_our_sec_entries,
+    .max = BLE_STORE_FCB_MAX_OUR_SECS,
+};
+
+static struct ble_store_fcb_sec_entry
+    ble_store_fcb_peer_sec_entries[BLE_STORE_FCB_MAX_PEER_SECS];
+static struct ble_store_fcb_sec_tbl ble_store_fcb_peer_secs = {
+    .entries = ble_store_fcb_peer_sec_entries,
+    .max = BLE_STORE_FCB_MAX_PEER_SECS,
+};
+
+static struct ble_store_fcb_cccd_entry
+    ble_store_fcb_cccds[BLE_STORE_FCB_MAX_CCCDS];
+static int ble_store_fcb_num_cccds;
+
+static struct ble_store_fcb_gatt_entry
+    ble_store_fcb_gatts[BLE_STORE_FCB_MAX_GATTS];
+static int ble_store_fcb_num_gatts;
+
+/*****************************************************************************
+ * $sec                                                                      *
+ *****************************************************************************/
+
+static uint32_t
+ble_store_fcb_hash(uint32_t hash, const void *data, int len)
+{
+    const uint8_t *u8p;
+    int i;
+
+    u8p = data;
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ u8p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int
+ble_store_fcb_addr_bucket(uint8_t addr_type, const uint8_t *addr)
+{
+    uint32_t hash;
+
+    hash = ble_store_fcb_hash(2166136261u, &addr_type, 1);
+    hash = ble_store_fcb_hash(hash, addr, 6);
+    return hash & (BLE_STORE_FCB_SEC_BUCKETS - 1);
+}
+
+static int
+ble_store_fcb_ediv_bucket(uint16_t ediv, uint64_t rand_num)
+{
+    uint32_t hash;
+
+    hash = ble_store_fcb_hash(2166136261u, &ediv, sizeof ediv);
+    hash = ble_store_fcb_hash(hash, &rand_num, sizeof rand_num);
+    return hash & (BLE_STORE_FCB_SEC_BUCKETS - 1);
+}
+
+/**
+ * Rebuilds both hash indexes of a security table.  Entries are pushed in
+ * reverse order so that each chain lists its entries by ascending table
+ * index, i.e., in the same order a linear scan would encounter them.
+ */
+static void
+ble_store_fcb_sec_idx_build(struct ble_store_fcb_sec_tbl *tbl)
+{
+    struct ble_store_fcb_sec_entry *entry;
+    int bucket;
+    int i;
+
+    memset(tbl->addr_buckets, -1, sizeof tbl->addr_buckets);
+    memset(tbl->ediv_buckets, -1, sizeof tbl->ediv_buckets);
+
+    for (i = tbl->num - 1; i >= 0; i--) {
+        entry = tbl->entries + i;
+
+        bucket = ble_store_fcb_addr_bucket(entry->value.peer_addr_type,
+                                           entry->value.peer_addr);
+        entry->addr_next = tbl->addr_buckets[bucket];
+        tbl->addr_buckets[bucket] = i;
+
+        bucket = ble_store_fcb_ediv_bucket(entry->value.ediv,
+                                           entry->value.rand_num);
+        entry->ediv_next = tbl->ediv_buckets[bucket];
+        tbl->ediv_buckets[bucket] = i;
+    }
+}
+
+static int
+ble_store_fcb_sec_matches(struct ble_store_value_sec *cur,
+                          struct ble_store_key_sec *key_sec)
+{
+    if (key_sec->peer_addr_type != BLE_STORE_ADDR_TYPE_NONE) {
+        if (cur->peer_addr_type != key_sec->peer_addr_type) {
+            return 0;
+        }
+
+        if (memcmp(cur->peer_addr, key_sec->peer_addr,
+                   sizeof cur->peer_addr) != 0) {
+            return 0;
+        }
+    }
+
+    if (key_sec->ediv_rand_present) {
+        if (cur->ediv != key_sec->ediv) {
+            return 0;
+        }
+
+        if (cur->rand_num != key_sec->rand_num) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int
+ble_store_fcb_find_sec(struct ble_store_fcb_sec_tbl *tbl,
+                       struct ble_store_key_sec *key_sec)
+{
+    struct ble_store_fcb_sec_entry *entry;
+    int skipped;
+    int bucket;
+    int i;
+
+    /* The common lookups (by peer address or by ediv/rand, first match only)
+     * are served from the hash indexes.
+     */
+    if (key_sec->idx == 0) {
+        if (key_sec->peer_addr_type != BLE_STORE_ADDR_TYPE_NONE) {
+            bucket = ble_store_fcb_addr_bucket(key_sec->peer_addr_type,
+                                               key_sec->peer_addr);
+            for (i = tbl->addr_buckets[bucket]; i != -1;
+                 i = tbl->entries[i].addr_next) {
+
+                if (ble_store_fcb_sec_matches(&tbl->entries[i].value,
+                                              key_sec)) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        if (key_sec->ediv_rand_present) {
+            bucket = ble_store_fcb_ediv_bucket(key_sec->ediv,
+                                               key_sec->rand_num);
+            for (i = tbl->ediv_buckets[bucket]; i != -1;
+                 i = tbl->entries[i].ediv_next) {
+
+                if (ble_store_fcb_sec_matches(&tbl->entries[i].value,
+                                              key_sec)) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+    }
+
+    /* Iteration; fall back to a linear scan. */
+    skipped = 0;
+    for (i = 0; i < tbl->num; i++) {
+        entry = tbl->entries + i;
+
+        if (!ble_store_fcb_sec_matches(&entry->value, key_sec)) {
+            continue;
+        }
+
+        if (key_sec->idx > skipped) {
+            skipped++;
+            continue;
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+static int
+ble_store_fcb_read_sec(struct ble_store_fcb_sec_tbl *tbl,
+                       struct ble_store_key_sec *key_sec,
+                       struct ble_store_value_sec *value_sec)
+{
+    int idx;
+
+    idx = ble_store_fcb_find_sec(tbl, key_sec);
+    if (idx == -1) {
+        return BLE_HS_ENOENT;
+    }
+
+    *value_sec = tbl->entries[idx].value;
+    return 0;
+}
+
+/**
+ * Finds the table slot that a write of the specified value would occupy.
+ *
+ * @return                      The slot index on success; -1 if the table is
+ *                                  full.
+ */
+static int
+ble_store_fcb_sec_slot(struct ble_store_fcb_sec_tbl *tbl,
+                       struct ble_store_value_sec *value_sec)
+{
+    struct ble_store_key_sec key_sec;
+    int idx;
+
+    ble_store_key_from_value_sec(&key_sec, value_sec);
+    idx = ble_store_fcb_find_sec(tbl, &key_sec);
+    if (idx == -1) {
+        if (tbl->num >= tbl->max) {
+            return -1;
+        }
+        idx = tbl->num;
+    }
+
+    return idx;
+}
+
+static void
+ble_store_fcb_sec_set(struct ble_store_fcb_sec_tbl *tbl, int idx,
+                      struct ble_store_value_sec *value_sec,
+                      struct fcb_entry *loc)
+{
+    if (idx == tbl->num) {
+        tbl->num++;
+    }
+
+    tbl->entries[idx].value = *value_sec;
+    tbl->entries[idx].loc = *loc;
+    ble_store_fcb_sec_idx_build(tbl);
+}
+
+static void
+ble_store_fcb_sec_remove(struct ble_store_fcb_sec_tbl *tbl, int idx)
+{
+    tbl->num--;
+    memmove(tbl->entries + idx, tbl->entries + idx + 1,
+            (tbl->num - idx) * sizeof tbl->entries[0]);
+    ble_store_fcb_sec_idx_build(tbl);
+}
+
+/*****************************************************************************
+ * $cccd                                                                     *
+ *****************************************************************************/
+
+static int
+ble_store_fcb_find_cccd(struct ble_store_key_cccd *key)
+{
+    struct ble_store_value_cccd *cccd;
+    int skipped;
+    int i;
+
+    skipped = 0;
+    for (i = 0; i < ble_store_fcb_num_cccds; i++) {
+        cccd = &ble_store_fcb_cccds[i].value;
+
+        if (key->peer_addr_type != BLE_STORE_ADDR_TYPE_NONE) {
+            if (cccd->peer_addr_type != key->peer_addr_type) {
+                continue;
+            }
+
+            if (memcmp(cccd->peer_addr, key->peer_addr, 6) != 0) {
+                continue;
+            }
+        }
+
+        if (key->chr_val_handle != 0) {
+            if (cccd->chr_val_handle != key->chr_val_handle) {
+                continue;
+            }
+        }
+
+        if (key->idx > skipped) {
+            skipped++;
+            continue;
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+static int
+ble_store_fcb_read_cccd(struct ble_store_key_cccd *key_cccd,
+                        struct ble_store_value_cccd *value_cccd)
+{
+    int idx;
+
+    idx = ble_store_fcb_find_cccd(key_cccd);
+    if (idx == -1) {
+        return BLE_HS_ENOENT;
+    }
+
+    *value_cccd = ble_store_fcb_cccds[idx].value;
+    return 0;
+}
+
+static int
+ble_store_fcb_cccd_slot(struct ble_store_value_cccd *value_cccd)
+{
+    struct ble_store_key_cccd key_cccd;
+    int idx;
+
+    ble_store_key_from_value_cccd(&key_cccd, value_cccd);
+    idx = ble_store_fcb_find_cccd(&key_cccd);
+    if (idx == -1) {
+        if (ble_store_fcb_num_cccds >= BLE_STORE_FCB_MAX_CCCDS) {
+            return -1;
+        }
+        idx = ble_store_fcb_num_cccds;
+    }
+
+    return idx;
+}
+
+static void
+ble_store_fcb_cccd_set(int idx, struct ble_store_value_cccd *value_cccd,
+                       struct fcb_entry *loc)
+{
+    if (idx == ble_store_fcb_num_cccds) {
+        ble_store_fcb_num_cccds++;
+    }
+
+    ble_store_fcb_cccds[idx].value = *value_cccd;
+    ble_store_fcb_cccds[idx].loc = *loc;
+}
+
+static void
+ble_store_fcb_cccd_remove(int idx)
+{
+    ble_store_fcb_num_cccds--;
+    memmove(ble_store_fcb_cccds + idx, ble_store_fcb_cccds + idx + 1,
+            (ble_store_fcb_num_cccds - idx) * sizeof ble_store_fcb_cccds[0]);
+}
+
+/*****************************************************************************
+ * $gatt                                                                     *
+ *****************************************************************************/
+
+static int
+ble_store_fcb_find_gatt(struct ble_store_key_gatt *key)
+{
+    struct ble_store_value_gatt *gatt;
+    int skipped;
+    int i;
+
+    skipped = 0;
+    for (i = 0; i < ble_store_fcb_num_gatts; i++) {
+        gatt = &ble_store_fcb_gatts[i].value;
+
+        if (key->peer_addr_type != BLE_STORE_ADDR_TYPE_NONE) {
+            if (gatt->peer_addr_type != key->peer_addr_type) {
+                continue;
+            }
+
+            if (memcmp(gatt->peer_addr, key->peer_addr, 6) != 0) {
+                continue;
+            }
+        }
+
+        if (key->type != BLE_STORE_GATT_TYPE_ANY) {
+            if (gatt->type != key->type || gatt->handle != key->handle) {
+                continue;
+            }
+        }
+
+        if (key->idx > skipped) {
+            skipped++;
+            continue;
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+static int
+ble_store_fcb_read_gatt(struct ble_store_key_gatt *key_gatt,
+                        struct ble_store_value_gatt *value_gatt)
+{
+    int idx;
+
+    idx = ble_store_fcb_find_gatt(key_gatt);
+    if (idx == -1) {
+        return BLE_HS_ENOENT;
+    }
+
+    *value_gatt = ble_store_fcb_gatts[idx].value;
+    return 0;
+}
+
+static int
+ble_store_fcb_gatt_slot(struct ble_store_value_gatt *value_gatt)
+{
+    struct ble_store_key_gatt key_gatt;
+    int idx;
+
+    ble_store_key_from_value_gatt(&key_gatt, value_gatt);
+    idx = ble_store_fcb_find_gatt(&key_gatt);
+    if (idx == -1) {
+        if (ble_store_fcb_num_gatts >= BLE_STORE_FCB_MAX_GATTS) {
+            return -1;
+        }
+        idx = ble_store_fcb_num_gatts;
+    }
+
+    return idx;
+}
+
+static void
+ble_store_fcb_gatt_set(int idx, struct ble_store_value_gatt *value_gatt,
+                       struct fcb_entry *loc)
+{
+    if (idx == ble_store_fcb_num_gatts) {
+        ble_store_fcb_num_gatts++;
+    }
+
+    ble_store_fcb_gatts[idx].value = *value_gatt;
+    ble_store_fcb_gatts[idx].loc = *loc;
+}
+
+static void
+ble_store_fcb_gatt_remove(int idx)
+{
+    ble_store_fcb_num_gatts--;
+    memmove(ble_store_fcb_gatts + idx, ble_store_fcb_gatts + idx + 1,
+            (ble_store_fcb_num_gatts - idx) * sizeof ble_store_fcb_gatts[0]);
+}
+
+/*****************************************************************************
+ * $flash                                                                    *
+ *****************************************************************************/
+
+static struct ble_store_fcb_sec_tbl *
+ble_store_fcb_sec_tbl(int obj_type)
+{
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+        return &ble_store_fcb_our_secs;
+
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+        return &ble_store_fcb_peer_secs;
+
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * Retrieves the mirror entry that the specified write record applies to.
+ *
+ * @return                      The location of the entry's latest record if
+ *                                  the entry exists; NULL otherwise.
+ */
+static struct fcb_entry *
+ble_store_fcb_rec_loc(struct ble_store_fcb_rec *rec)
+{
+    struct ble_store_fcb_sec_tbl *tbl;
+    struct ble_store_key_cccd key_cccd;
+    struct ble_store_key_gatt key_gatt;
+    struct ble_store_key_sec key_sec;
+    int idx;
+
+    if (rec->obj_type == BLE_STORE_OBJ_TYPE_CCCD) {
+        ble_store_key_from_value_cccd(&key_cccd, &rec->value.cccd);
+        idx = ble_store_fcb_find_cccd(&key_cccd);
+        if (idx == -1) {
+            return NULL;
+        }
+        return &ble_store_fcb_cccds[idx].loc;
+    }
+
+    if (rec->obj_type == BLE_STORE_OBJ_TYPE_GATT) {
+        ble_store_key_from_value_gatt(&key_gatt, &rec->value.gatt);
+        idx = ble_store_fcb_find_gatt(&key_gatt);
+        if (idx == -1) {
+            return NULL;
+        }
+        return &ble_store_fcb_gatts[idx].loc;
+    }
+
+    tbl = ble_store_fcb_sec_tbl(rec->obj_type);
+    if (tbl == NULL) {
+        return NULL;
+    }
+
+    ble_store_key_from_value_sec(&key_sec, &rec->value.sec);
+    idx = ble_store_fcb_find_sec(tbl, &key_sec);
+    if (idx == -1) {
+        return NULL;
+    }
+    return &tbl->entries[idx].loc;
+}
+
+static int
+ble_store_fcb_rec_read(struct fcb_entry *loc, struct ble_store_fcb_rec *rec)
+{
+    int rc;
+
+    if (loc->fe_data_len != sizeof *rec) {
+        return BLE_HS_EBADDATA;
+    }
+
+    rc = flash_area_read(loc->fe_area, loc->fe_data_off, rec, sizeof *rec);
+    if (rc != 0) {
+        return BLE_HS_EOS;
+    }
+
+    return 0;
+}
+
+/**
+ * Frees the oldest sector.  Write records in that sector which are still the
+ * latest record for their entry are copied into the scratch sector first.
+ * Delete records are dropped: any record they cancel is at least as old, so
+ * it disappears along with them.
+ */
+static void
+ble_store_fcb_compress(void)
+{
+    struct ble_store_fcb_rec rec;
+    struct fcb_entry *live_loc;
+    struct fcb_entry loc1;
+    struct fcb_entry loc2;
+    int rc;
+
+    rc = fcb_append_to_scratch(ble_store_fcb);
+    if (rc != 0) {
+        return;
+    }
+
+    loc1.fe_area = NULL;
+    loc1.fe_elem_off = 0;
+    while (fcb_getnext(ble_store_fcb, &loc1) == 0) {
+        if (loc1.fe_area != ble_store_fcb->f_oldest) {
+            break;
+        }
+
+        rc = ble_store_fcb_rec_read(&loc1, &rec);
+        if (rc != 0 || rec.op != BLE_STORE_FCB_OP_WRITE) {
+            continue;
+        }
+
+        live_loc = ble_store_fcb_rec_loc(&rec);
+        if (live_loc == NULL ||
+            live_loc->fe_area != loc1.fe_area ||
+            live_loc->fe_data_off != loc1.fe_data_off) {
+
+            /* Superseded by a newer record. */
+            continue;
+        }
+
+        rc = fcb_append(ble_store_fcb, sizeof rec, &loc2);
+        if (rc != 0) {
+            continue;
+        }
+        rc = flash_area_write(loc2.fe_area, loc2.fe_data_off, &rec,
+                              sizeof rec);
+        if (rc != 0) {
+            fcb_append_abort(ble_store_fcb, &loc2);
+            continue;
+        }
+        fcb_append_finish(ble_store_fcb, &loc2);
+
+        *live_loc = loc2;
+    }
+
+    fcb_rotate(ble_store_fcb);
+}
+
+static int
+ble_store_fcb_append(int obj_type, int op, union ble_store_value *val,
+                     struct fcb_entry *loc)
+{
+    struct ble_store_fcb_rec rec;
+    int rc;
+    int i;
+
+    if (ble_store_fcb == NULL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    memset(&rec, 0, sizeof rec);
+    rec.obj_type = obj_type;
+    rec.op = op;
+    if (obj_type == BLE_STORE_OBJ_TYPE_CCCD) {
+        rec.value.cccd = val->cccd;
+    } else if (obj_type == BLE_STORE_OBJ_TYPE_GATT) {
+        rec.value.gatt = val->gatt;
+    } else {
+        rec.value.sec = val->sec;
+    }
+
+    for (i = 0; i < BLE_STORE_FCB_APPEND_TRIES; i++) {
+        rc = fcb_append(ble_store_fcb, sizeof rec, loc);
+        if (rc != FCB_ERR_NOSPACE) {
+            break;
+        }
+        ble_store_fcb_compress();
+    }
+    if (rc != 0) {
+        return BLE_HS_ENOMEM;
+    }
+
+    rc = flash_area_write(loc->fe_area, loc->fe_data_off, &rec, sizeof rec);
+    if (rc != 0) {
+        fcb_append_abort(ble_store_fcb, loc);
+        return BLE_HS_EOS;
+    }
+
+    rc = fcb_append_finish(ble_store_fcb, loc);
+    if (rc != 0) {
+        return BLE_HS_EOS;
+    }
+
+    return 0;
+}
+
+/**
+ * Applies a record read from flash to the RAM mirror.
+ */
+static void
+ble_store_fcb_replay(struct ble_store_fcb_rec *rec, struct fcb_entry *loc)
+{
+    struct ble_store_fcb_sec_tbl *tbl;
+    struct ble_store_key_cccd key_cccd;
+    struct ble_store_key_gatt key_gatt;
+    struct ble_store_key_sec key_sec;
+    int idx;
+
+    if (rec->obj_type == BLE_STORE_OBJ_TYPE_GATT) {
+        if (rec->op == BLE_STORE_FCB_OP_WRITE) {
+            idx = ble_store_fcb_gatt_slot(&rec->value.gatt);
+            if (idx != -1) {
+                ble_store_fcb_gatt_set(idx, &rec->value.gatt, loc);
+            }
+        } else {
+            ble_store_key_from_value_gatt(&key_gatt, &rec->value.gatt);
+            idx = ble_store_fcb_find_gatt(&key_gatt);
+            if (idx != -1) {
+                ble_store_fcb_gatt_remove(idx);
+            }
+        }
+        return;
+    }
+
+    if (rec->obj_type == BLE_STORE_OBJ_TYPE_CCCD) {
+        if (rec->op == BLE_STORE_FCB_OP_WRITE) {
+            idx = ble_store_fcb_cccd_slot(&rec->value.cccd);
+            if (idx != -1) {
+                ble_store_fcb_cccd_set(idx, &rec->value.cccd, loc);
+            }
+        } else {
+            ble_store_key_from_value_cccd(&key_cccd, &rec->value.cccd);
+            idx = ble_store_fcb_find_cccd(&key_cccd);
+            if (idx != -1) {
+                ble_store_fcb_cccd_remove(idx);
+            }
+        }
+        return;
+    }
+
+    tbl = ble_store_fcb_sec_tbl(rec->obj_type);
+    if (tbl == NULL) {
+        return;
+    }
+
+    if (rec->op == BLE_STORE_FCB_OP_WRITE) {
+        idx = ble_store_fcb_sec_slot(tbl, &rec->value.sec);
+        if (idx != -1) {
+            ble_store_fcb_sec_set(tbl, idx, &rec->value.sec, loc);
+        }
+    } else {
+        ble_store_key_from_value_sec(&key_sec, &rec->value.sec);
+        idx = ble_store_fcb_find_sec(tbl, &key_sec);
+        if (idx != -1) {
+            ble_store_fcb_sec_remove(tbl, idx);
+        }
+    }
+}
+
+/*****************************************************************************
+ * $api                                                                      *
+ *****************************************************************************/
+
+/**
+ * Searches the database for an object matching the specified criteria.
+ *
+ * @return                      0 if a key was found; else BLE_HS_ENOENT.
+ */
+int
+ble_store_fcb_read(int obj_type, union ble_store_key *key,
+                   union ble_store_value *value)
+{
+    struct ble_store_fcb_sec_tbl *tbl;
+    int rc;
+
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+        tbl = ble_store_fcb_sec_tbl(obj_type);
+        rc = ble_store_fcb_read_sec(tbl, &key->sec, &value->sec);
+        return rc;
+
+    case BLE_STORE_OBJ_TYPE_CCCD:
+        rc = ble_store_fcb_read_cccd(&key->cccd, &value->cccd);
+        return rc;
+
+    case BLE_STORE_OBJ_TYPE_GATT:
+        rc = ble_store_fcb_read_gatt(&key->gatt, &value->gatt);
+        return rc;
+
+    default:
+        return BLE_HS_ENOTSUP;
+    }
+}
+
+/**
+ * Adds the specified object to the database, replacing any existing object
+ * with the same key.  The object is persisted to flash before this function
+ * returns.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOMEM if the database or the FCB is
+ *                                  full;
+ *                              BLE_HS_EOS on flash error.
+ */
+int
+ble_store_fcb_write(int obj_type, union ble_store_value *val)
+{
+    struct ble_store_fcb_sec_tbl *tbl;
+    struct fcb_entry loc;
+    int idx;
+    int rc;
+
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+        tbl = ble_store_fcb_sec_tbl(obj_type);
+        idx = ble_store_fcb_sec_slot(tbl, &val->sec);
+        if (idx == -1) {
+            BLE_HS_LOG(DEBUG, "error persisting sec; too many entries "
+                              "(%d)\n", tbl->num);
+            return BLE_HS_ENOMEM;
+        }
+
+        rc = ble_store_fcb_append(obj_type, BLE_STORE_FCB_OP_WRITE, val, &loc);
+        if (rc != 0) {
+            return rc;
+        }
+
+        /* A compression during the append only relocates records; table
+         * slots are unchanged, so idx is still valid.
+         */
+        ble_store_fcb_sec_set(tbl, idx, &val->sec, &loc);
+        return 0;
+
+    case BLE_STORE_OBJ_TYPE_CCCD:
+        idx = ble_store_fcb_cccd_slot(&val->cccd);
+        if (idx == -1) {
+            BLE_HS_LOG(DEBUG, "error persisting cccd; too many entries (%d)\n",
+                       ble_store_fcb_num_cccds);
+            return BLE_HS_ENOMEM;
+        }
+
+        rc = ble_store_fcb_append(obj_type, BLE_STORE_FCB_OP_WRITE, val, &loc);
+        if (rc != 0) {
+            return rc;
+        }
+
+        ble_store_fcb_cccd_set(idx, &val->cccd, &loc);
+        return 0;
+
+    case BLE_STORE_OBJ_TYPE_GATT:
+        idx = ble_store_fcb_gatt_slot(&val->gatt);
+        if (idx == -1) {
+            BLE_HS_LOG(DEBUG, "error persisting gatt; too many entries (%d)\n",
+                       ble_store_fcb_num_gatts);
+            return BLE_HS_ENOMEM;
+        }
+
+        rc = ble_store_fcb_append(obj_type, BLE_STORE_FCB_OP_WRITE, val, &loc);
+        if (rc != 0) {
+            return rc;
+        }
+
+        ble_store_fcb_gatt_set(idx, &val->gatt, &loc);
+        return 0;
+
+    default:
+        return BLE_HS_ENOTSUP;
+    }
+}
+
+/**
+ * Removes the first object matching the specified key from the database.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if no matching object exists;
+ *                              Other nonzero on flash error.
+ */
+int
+ble_store_fcb_delete(int obj_type, union ble_store_key *key)
+{
+    struct ble_store_fcb_sec_tbl *tbl;
+    union ble_store_value val;
+    struct fcb_entry loc;
+    int idx;
+    int rc;
+
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+        tbl = ble_store_fcb_sec_tbl(obj_type);
+        idx = ble_store_fcb_find_sec(tbl, &key->sec);
+        if (idx == -1) {
+            return BLE_HS_ENOENT;
+        }
+
+        val.sec = tbl->entries[idx].value;
+        rc = ble_store_fcb_append(obj_type, BLE_STORE_FCB_OP_DELETE, &val,
+                                  &loc);
+        if (rc != 0) {
+            return rc;
+        }
+
+        ble_store_fcb_sec_remove(tbl, idx);
+        return 0;
+
+    case BLE_STORE_OBJ_TYPE_CCCD:
+        idx = ble_store_fcb_find_cccd(&key->cccd);
+        if (idx == -1) {
+            return BLE_HS_ENOENT;
+        }
+
+        val.cccd = ble_store_fcb_cccds[idx].value;
+        rc = ble_store_fcb_append(obj_type, BLE_STORE_FCB_OP_DELETE, &val,
+                                  &loc);
+        if (rc != 0) {
+            return rc;
+        }
+
+        ble_store_fcb_cccd_remove(idx);
+        return 0;
+
+    case BLE_STORE_OBJ_TYPE_GATT:
+        idx = ble_store_fcb_find_gatt(&key->gatt);
+        if (idx == -1) {
+            return BLE_HS_ENOENT;
+        }
+
+        val.gatt = ble_store_fcb_gatts[idx].value;
+        rc = ble_store_fcb_append(obj_type, BLE_STORE_FCB_OP_DELETE, &val,
+                                  &loc);
+        if (rc != 0) {
+            return rc;
+        }
+
+        ble_store_fcb_gatt_remove(idx);
+        return 0;
+
+    default:
+        return BLE_HS_ENOTSUP;
+    }
+}
+
+/**
+ * Initializes the store on top of the specified FCB and loads its contents.
+ * The caller must fill in the FCB's f_sectors and f_sector_cnt fields; at
+ * least two sectors are required, one of which is held in reserve as scratch
+ * space.
+ *
+ * @return                      0 on success; BLE_HS_EINVAL if the FCB could
+ *                                  not be initialized.
+ */
+int
+ble_store_fcb_init(struct fcb *fcb)
+{
+    struct ble_store_fcb_rec rec;
+    struct fcb_entry loc;
+    int rc;
+
+    fcb->f_magic = BLE_STORE_FCB_MAGIC;
+    fcb->f_version = BLE_STORE_FCB_VERS;
+    fcb->f_scratch_cnt = 1;
+
+    while (1) {
+        rc = fcb_init(fcb);
+        if (rc != 0) {
+            return BLE_HS_EINVAL;
+        }
+
+        /* Check if the system was reset in the middle of emptying a sector.
+         * This situation is recognized by checking if the scratch block is
+         * missing.
+         */
+        if (fcb_free_sector_cnt(fcb) < 1) {
+            flash_area_erase(fcb->f_active.fe_area, 0,
+                             fcb->f_active.fe_area->fa_size);
+        } else {
+            break;
+        }
+    }
+
+    ble_store_fcb = fcb;
+
+    ble_store_fcb_our_secs.num = 0;
+    ble_store_fcb_sec_idx_build(&ble_store_fcb_our_secs);
+    ble_store_fcb_peer_secs.num = 0;
+    ble_store_fcb_sec_idx_build(&ble_store_fcb_peer_secs);
+    ble_store_fcb_num_cccds = 0;
+    ble_store_fcb_num_gatts = 0;
+
+    loc.fe_area = NULL;
+    loc.fe_elem_off = 0;
+    while (fcb_getnext(fcb, &loc) == 0) {
+        rc = ble_store_fcb_rec_read(&loc, &rec);
+        if (rc == 0) {
+            ble_store_fcb_replay(&rec, &loc);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,412 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <os/os.h>
+#include <testutil/testutil.h>
+
+#include "hal/flash_map.h"
+#include "fcb/fcb.h"
+#include "host/ble_hs.h"
+#include "store/fcb/ble_store_fcb.h"
+
+static struct fcb ble_store_fcb_test_fcb;
+
+static struct flash_area ble_store_fcb_test_area[] = {
+    [0] = {
+        .fa_flash_id = 0,
+        .fa_off = 0,
+        .fa_size = 0x4000, /* 16K */
+    },
+    [1] = {
+        .fa_flash_id = 0,
+        .fa_off = 0x4000,
+        .fa_size = 0x4000
+    },
+    [2] = {
+        .fa_flash_id = 0,
+        .fa_off = 0x8000,
+        .fa_size = 0x4000
+    },
+};
+
+#define BLE_STORE_FCB_TEST_NUM_AREAS                            \
+    (sizeof ble_store_fcb_test_area / sizeof ble_store_fcb_test_area[0])
+
+static void
+ble_store_fcb_test_wipe(void)
+{
+    struct flash_area *fap;
+    int rc;
+    int i;
+
+    for (i = 0; i < BLE_STORE_FCB_TEST_NUM_AREAS; i++) {
+        fap = &ble_store_fcb_test_area[i];
+        rc = flash_area_erase(fap, 0, fap->fa_size);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+}
+
+/**
+ * Simulates a reboot: the store is reloaded from flash into a fresh FCB.
+ */
+static void
+ble_store_fcb_test_restart(void)
+{
+    int rc;
+
+    memset(&ble_store_fcb_test_fcb, 0, sizeof ble_store_fcb_test_fcb);
+    ble_store_fcb_test_fcb.f_sectors = ble_store_fcb_test_area;
+    ble_store_fcb_test_fcb.f_sector_cnt = BLE_STORE_FCB_TEST_NUM_AREAS;
+
+    rc = ble_store_fcb_init(&ble_store_fcb_test_fcb);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static void
+ble_store_fcb_test_init(void)
+{
+    ble_store_fcb_test_wipe();
+    ble_store_fcb_test_restart();
+}
+
+static void
+ble_store_fcb_test_sec(struct ble_store_value_sec *value_sec, uint8_t id)
+{
+    int i;
+
+    memset(value_sec, 0, sizeof *value_sec);
+    value_sec->peer_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    memcpy(value_sec->peer_addr, ((uint8_t[]){ id, 2, 3, 4, 5, 6 }), 6);
+    value_sec->ediv = 0x1000 + id;
+    value_sec->rand_num = 0x1122334455667700ULL + id;
+    for (i = 0; i < sizeof value_sec->ltk; i++) {
+        value_sec->ltk[i] = id + i;
+    }
+    value_sec->ltk_present = 1;
+}
+
+static void
+ble_store_fcb_test_cccd(struct ble_store_value_cccd *value_cccd, uint8_t id,
+                        uint16_t chr_val_handle, uint16_t flags)
+{
+    memset(value_cccd, 0, sizeof *value_cccd);
+    value_cccd->peer_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    memcpy(value_cccd->peer_addr, ((uint8_t[]){ id, 2, 3, 4, 5, 6 }), 6);
+    value_cccd->chr_val_handle = chr_val_handle;
+    value_cccd->flags = flags;
+}
+
+static int
+ble_store_fcb_test_read_sec(int obj_type, struct ble_store_value_sec *expected)
+{
+    union ble_store_value value;
+    union ble_store_key key;
+    int rc;
+
+    ble_store_key_from_value_sec(&key.sec, expected);
+    rc = ble_store_fcb_read(obj_type, &key, &value);
+    if (rc == 0) {
+        TEST_ASSERT(memcmp(&value.sec, expected, sizeof *expected) == 0);
+    }
+    return rc;
+}
+
+static int
+ble_store_fcb_test_read_cccd(struct ble_store_value_cccd *expected)
+{
+    union ble_store_value value;
+    union ble_store_key key;
+    int rc;
+
+    ble_store_key_from_value_cccd(&key.cccd, expected);
+    rc = ble_store_fcb_read(BLE_STORE_OBJ_TYPE_CCCD, &key, &value);
+    if (rc == 0) {
+        TEST_ASSERT(memcmp(&value.cccd, expected, sizeof *expected) == 0);
+    }
+    return rc;
+}
+
+TEST_CASE(ble_store_fcb_test_write_read)
+{
+    struct ble_store_value_cccd cccd;
+    struct ble_store_value_sec sec1;
+    struct ble_store_value_sec sec2;
+    union ble_store_value value;
+    union ble_store_key key;
+    int rc;
+
+    ble_store_fcb_test_init();
+
+    ble_store_fcb_test_sec(&sec1, 1);
+    ble_store_fcb_test_sec(&sec2, 2);
+    ble_store_fcb_test_cccd(&cccd, 1, 10, 1);
+
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec1) == BLE_HS_ENOENT);
+
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                             (union ble_store_value *)&sec1);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_OUR_SEC,
+                             (union ble_store_value *)&sec2);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_CCCD,
+                             (union ble_store_value *)&cccd);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec1) == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_OUR_SEC,
+                                            &sec2) == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_cccd(&cccd) == 0);
+
+    /* Our and peer security material are kept apart. */
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_OUR_SEC,
+                                            &sec1) == BLE_HS_ENOENT);
+
+    /* Lookup by ediv and rand, as done when a bonded peer reconnects. */
+    memset(&key, 0, sizeof key);
+    key.sec.peer_addr_type = BLE_STORE_ADDR_TYPE_NONE;
+    key.sec.ediv = sec1.ediv;
+    key.sec.rand_num = sec1.rand_num;
+    key.sec.ediv_rand_present = 1;
+    rc = ble_store_fcb_read(BLE_STORE_OBJ_TYPE_PEER_SEC, &key, &value);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(memcmp(&value.sec, &sec1, sizeof sec1) == 0);
+
+    /* A write with the same key replaces the entry. */
+    sec1.authenticated = 1;
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                             (union ble_store_value *)&sec1);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec1) == 0);
+
+    ble_store_key_from_value_sec(&key.sec, &sec1);
+    key.sec.idx = 1;
+    rc = ble_store_fcb_read(BLE_STORE_OBJ_TYPE_PEER_SEC, &key, &value);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+}
+
+TEST_CASE(ble_store_fcb_test_delete)
+{
+    struct ble_store_value_cccd cccd;
+    struct ble_store_value_sec sec1;
+    struct ble_store_value_sec sec2;
+    union ble_store_key key;
+    int rc;
+
+    ble_store_fcb_test_init();
+
+    ble_store_fcb_test_sec(&sec1, 1);
+    ble_store_fcb_test_sec(&sec2, 2);
+    ble_store_fcb_test_cccd(&cccd, 1, 10, 1);
+
+    ble_store_key_from_value_sec(&key.sec, &sec1);
+    rc = ble_store_fcb_delete(BLE_STORE_OBJ_TYPE_PEER_SEC, &key);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                             (union ble_store_value *)&sec1);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                             (union ble_store_value *)&sec2);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_CCCD,
+                             (union ble_store_value *)&cccd);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_store_fcb_delete(BLE_STORE_OBJ_TYPE_PEER_SEC, &key);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec1) == BLE_HS_ENOENT);
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec2) == 0);
+
+    ble_store_key_from_value_cccd(&key.cccd, &cccd);
+    rc = ble_store_fcb_delete(BLE_STORE_OBJ_TYPE_CCCD, &key);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_cccd(&cccd) == BLE_HS_ENOENT);
+    rc = ble_store_fcb_delete(BLE_STORE_OBJ_TYPE_CCCD, &key);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    /* The deleted entry can be written again. */
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                             (union ble_store_value *)&sec1);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec1) == 0);
+}
+
+TEST_CASE(ble_store_fcb_test_restart_load)
+{
+    struct ble_store_value_cccd cccd1;
+    struct ble_store_value_cccd cccd2;
+    struct ble_store_value_sec sec1;
+    struct ble_store_value_sec sec2;
+    union ble_store_key key;
+    int rc;
+
+    ble_store_fcb_test_init();
+
+    ble_store_fcb_test_sec(&sec1, 1);
+    ble_store_fcb_test_sec(&sec2, 2);
+    ble_store_fcb_test_cccd(&cccd1, 1, 10, 1);
+    ble_store_fcb_test_cccd(&cccd2, 1, 20, 2);
+
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                             (union ble_store_value *)&sec1);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_OUR_SEC,
+                             (union ble_store_value *)&sec2);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_CCCD,
+                             (union ble_store_value *)&cccd1);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_CCCD,
+                             (union ble_store_value *)&cccd2);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Overwrite and delete before the restart; only the outcome survives. */
+    cccd1.flags = 2;
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_CCCD,
+                             (union ble_store_value *)&cccd1);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_key_from_value_cccd(&key.cccd, &cccd2);
+    rc = ble_store_fcb_delete(BLE_STORE_OBJ_TYPE_CCCD, &key);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_store_fcb_test_restart();
+
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec1) == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_OUR_SEC,
+                                            &sec2) == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_cccd(&cccd1) == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_cccd(&cccd2) == BLE_HS_ENOENT);
+
+    /* The reloaded store keeps working. */
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_CCCD,
+                             (union ble_store_value *)&cccd2);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_fcb_test_restart();
+    TEST_ASSERT(ble_store_fcb_test_read_cccd(&cccd2) == 0);
+}
+
+TEST_CASE(ble_store_fcb_test_compress)
+{
+    struct ble_store_value_cccd cccd;
+    struct ble_store_value_sec sec;
+    int rc;
+    int i;
+
+    ble_store_fcb_test_init();
+
+    ble_store_fcb_test_sec(&sec, 1);
+    rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                             (union ble_store_value *)&sec);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Far more writes than the FCB holds; the oldest sector is repeatedly
+     * compressed, carrying the live records forward.
+     */
+    for (i = 0; i < 2000; i++) {
+        ble_store_fcb_test_cccd(&cccd, 1, 10, i);
+        rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_CCCD,
+                                 (union ble_store_value *)&cccd);
+        TEST_ASSERT_FATAL(rc == 0, "write %d failed; rc=%d", i, rc);
+    }
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec) == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_cccd(&cccd) == 0);
+
+    /* The sector holding the original security record was reused. */
+    TEST_ASSERT(ble_store_fcb_test_fcb.f_active_id >=
+                BLE_STORE_FCB_TEST_NUM_AREAS);
+
+    ble_store_fcb_test_restart();
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec) == 0);
+    TEST_ASSERT(ble_store_fcb_test_read_cccd(&cccd) == 0);
+}
+
+TEST_CASE(ble_store_fcb_test_full)
+{
+    struct ble_store_value_sec sec;
+    int rc;
+    int i;
+
+    ble_store_fcb_test_init();
+
+    /* The RAM mirror limits the number of entries, not the FCB. */
+    for (i = 0; ; i++) {
+        ble_store_fcb_test_sec(&sec, i);
+        rc = ble_store_fcb_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                 (union ble_store_value *)&sec);
+        if (rc != 0) {
+            break;
+        }
+        TEST_ASSERT_FATAL(i < 256);
+    }
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+    TEST_ASSERT(i > 0);
+
+    /* The rejected entry was not persisted. */
+    ble_store_fcb_test_restart();
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec) == BLE_HS_ENOENT);
+    ble_store_fcb_test_sec(&sec, i - 1);
+    TEST_ASSERT(ble_store_fcb_test_read_sec(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                                            &sec) == 0);
+}
+
+TEST_SUITE(ble_store_fcb_test_suite)
+{
+    ble_store_fcb_test_write_read();
+    ble_store_fcb_test_delete();
+    ble_store_fcb_test_restart_load();
+    ble_store_fcb_test_compress();
+    ble_store_fcb_test_full();
+}
+
+int
+ble_store_fcb_test_all(void)
+{
+    ble_store_fcb_test_suite();
+
+    return tu_any_failed;
+}
+
+#ifdef MYNEWT_SELFTEST
+
+int
+main(int argc, char **argv)
+{
+    tu_config.tc_print_results = 1;
+    tu_init();
+
+    ble_store_fcb_test_all();
+
+    return tu_any_failed;
+}
+
+#endif
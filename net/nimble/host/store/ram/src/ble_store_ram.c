@@ -19,7 +19,7 @@
 
 /**
  * This file implements a simple in-RAM key database for BLE host security
- * material and CCCDs.  As this database is only ble_store_ramd in RAM, its
+ * material, CCCDs and cached GATT databases of peers.  As this database is only ble_store_ramd in RAM, its
  * contents are lost when the application terminates.
  */
 
@@ -33,6 +33,7 @@
 #define STORE_MAX_SLV_LTKS   4
 #define STORE_MAX_MST_LTKS   4
 #define STORE_MAX_CCCDS      16
+#define STORE_MAX_GATTS      64
 
 static struct ble_store_value_sec ble_store_ram_our_secs[STORE_MAX_SLV_LTKS];
 static int ble_store_ram_num_our_secs;
@@ -43,6 +44,9 @@ static int ble_store_ram_num_peer_secs;
 static struct ble_store_value_cccd ble_store_ram_cccds[STORE_MAX_CCCDS];
 static int ble_store_ram_num_cccds;
 
+static struct ble_store_value_gatt ble_store_ram_gatts[STORE_MAX_GATTS];
+static int ble_store_ram_num_gatts;
+
 /*****************************************************************************
  * $sec                                                                      *
  *****************************************************************************/
@@ -296,6 +300,102 @@ ble_store_ram_write_cccd(struct ble_store_value_cccd *value_cccd)
     return 0;
 }
 
+/*****************************************************************************
+ * $gatt                                                                     *
+ *****************************************************************************/
+
+static int
+ble_store_ram_find_gatt(struct ble_store_key_gatt *key)
+{
+    struct ble_store_value_gatt *gatt;
+    int skipped;
+    int i;
+
+    skipped = 0;
+    for (i = 0; i < ble_store_ram_num_gatts; i++) {
+        gatt = ble_store_ram_gatts + i;
+
+        if (key->peer_addr_type != BLE_STORE_ADDR_TYPE_NONE) {
+            if (gatt->peer_addr_type != key->peer_addr_type) {
+                continue;
+            }
+
+            if (memcmp(gatt->peer_addr, key->peer_addr, 6) != 0) {
+                continue;
+            }
+        }
+
+        if (key->type != BLE_STORE_GATT_TYPE_ANY) {
+            if (gatt->type != key->type || gatt->handle != key->handle) {
+                continue;
+            }
+        }
+
+        if (key->idx > skipped) {
+            skipped++;
+            continue;
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+static int
+ble_store_ram_read_gatt(struct ble_store_key_gatt *key_gatt,
+                        struct ble_store_value_gatt *value_gatt)
+{
+    int idx;
+
+    idx = ble_store_ram_find_gatt(key_gatt);
+    if (idx == -1) {
+        return BLE_HS_ENOENT;
+    }
+
+    *value_gatt = ble_store_ram_gatts[idx];
+    return 0;
+}
+
+static int
+ble_store_ram_write_gatt(struct ble_store_value_gatt *value_gatt)
+{
+    struct ble_store_key_gatt key_gatt;
+    int idx;
+
+    ble_store_key_from_value_gatt(&key_gatt, value_gatt);
+    idx = ble_store_ram_find_gatt(&key_gatt);
+    if (idx == -1) {
+        if (ble_store_ram_num_gatts >= STORE_MAX_GATTS) {
+            BLE_HS_LOG(DEBUG, "error persisting gatt; too many entries (%d)\n",
+                       ble_store_ram_num_gatts);
+            return BLE_HS_ENOMEM;
+        }
+
+        idx = ble_store_ram_num_gatts;
+        ble_store_ram_num_gatts++;
+    }
+
+    ble_store_ram_gatts[idx] = *value_gatt;
+    return 0;
+}
+
+static int
+ble_store_ram_delete_gatt(struct ble_store_key_gatt *key_gatt)
+{
+    int idx;
+
+    idx = ble_store_ram_find_gatt(key_gatt);
+    if (idx == -1) {
+        return BLE_HS_ENOENT;
+    }
+
+    ble_store_ram_num_gatts--;
+    memmove(ble_store_ram_gatts + idx, ble_store_ram_gatts + idx + 1,
+            (ble_store_ram_num_gatts - idx) * sizeof ble_store_ram_gatts[0]);
+    return 0;
+}
+
 /*****************************************************************************
  * $api                                                                      *
  *****************************************************************************/
@@ -338,6 +438,10 @@ ble_store_ram_read(int obj_type, union ble_store_key *key,
         rc = ble_store_ram_read_cccd(&key->cccd, &value->cccd);
         return rc;
 
+    case BLE_STORE_OBJ_TYPE_GATT:
+        rc = ble_store_ram_read_gatt(&key->gatt, &value->gatt);
+        return rc;
+
     default:
         return BLE_HS_ENOTSUP;
     }
@@ -367,6 +471,32 @@ ble_store_ram_write(int obj_type, union ble_store_value *val)
         rc = ble_store_ram_write_cccd(&val->cccd);
         return rc;
 
+    case BLE_STORE_OBJ_TYPE_GATT:
+        rc = ble_store_ram_write_gatt(&val->gatt);
+        return rc;
+
+    default:
+        return BLE_HS_ENOTSUP;
+    }
+}
+
+/**
+ * Removes the first object matching the specified key from the database.
+ * Only cached GATT attributes can be deleted.
+ *
+ * @return                      0 on success; BLE_HS_ENOENT if no matching
+ *                                  object exists.
+ */
+int
+ble_store_ram_delete(int obj_type, union ble_store_key *key)
+{
+    int rc;
+
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_GATT:
+        rc = ble_store_ram_delete_gatt(&key->gatt);
+        return rc;
+
     default:
         return BLE_HS_ENOTSUP;
     }
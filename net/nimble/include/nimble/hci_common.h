@@ -47,6 +47,7 @@
 #define BLE_HCI_OGF_STATUS_PARAMS           (0x05)
 #define BLE_HCI_OGF_TESTING                 (0x06)
 #define BLE_HCI_OGF_LE                      (0x08)
+#define BLE_HCI_OGF_VENDOR                  (0x3F)
 
 /*
  * Number of LE commands. NOTE: this is really just used to size the array
@@ -75,6 +76,12 @@
 /* List of OCF for Status parameters commands (OGF = 0x05) */
 #define BLE_HCI_OCF_RD_RSSI                 (0x0005)
 
+/* List of OCF for vendor specific commands (OGF = 0x3F) */
+#define BLE_HCI_OCF_VS_RD_LL_PROF           (0x0001)
+#define BLE_HCI_OCF_VS_RD_CONN_PROF         (0x0002)
+#define BLE_HCI_OCF_VS_RD_CHAN_CRC_ERRS     (0x0003)
+#define BLE_HCI_OCF_VS_CLR_LL_PROF          (0x0004)
+
 /* List of OCF for LE commands (OGF = 0x08) */
 #define BLE_HCI_OCF_LE_SET_EVENT_MASK       (0x0001)
 #define BLE_HCI_OCF_LE_RD_BUF_SIZE          (0x0002)
@@ -147,6 +154,17 @@
 #define BLE_HCI_READ_RSSI_LEN               (2)
 #define BLE_HCI_READ_RSSI_ACK_PARAM_LEN     (3)  /* No status byte. */
 
+/* --- Vendor: read LL profile (OGF 0x3F, OCF 0x0001) --- */
+#define BLE_HCI_VS_RD_LL_PROF_RSPLEN        (60)
+
+/* --- Vendor: read connection profile (OGF 0x3F, OCF 0x0002) --- */
+#define BLE_HCI_VS_RD_CONN_PROF_LEN         (2)
+#define BLE_HCI_VS_RD_CONN_PROF_RSPLEN      (26)
+
+/* --- Vendor: read per channel CRC errors (OGF 0x3F, OCF 0x0003) --- */
+#define BLE_HCI_VS_RD_CHAN_CRC_ERRS_LEN     (1)
+#define BLE_HCI_VS_RD_CHAN_CRC_ERRS_MAX     (20) /* Channels per response */
+
 /* --- LE set event mask (OCF 0x0001) --- */
 #define BLE_HCI_SET_LE_EVENT_MASK_LEN       (8)
 
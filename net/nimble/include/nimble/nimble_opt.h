@@ -64,6 +64,17 @@
 #define NIMBLE_OPT_SM_SC                        0
 #endif
 
+/**
+ * HOST: Number of our LTKs kept in RAM, indexed by peer address and
+ * EDIV/Rand, so that an LTK request from a reconnecting bonded peer is
+ * answered without a store lookup.  The key of a peer is loaded when it
+ * connects to us.  0 disables the index.
+ */
+
+#ifndef NIMBLE_OPT_SM_LTK_INDEX_SIZE
+#define NIMBLE_OPT_SM_LTK_INDEX_SIZE            NIMBLE_OPT_MAX_CONNECTIONS
+#endif
+
 /**
  * HOST: Supported GATT procedures.  By default:
  *     o Notify and indicate are enabled;
@@ -140,6 +151,13 @@
 
 /** HOST: GATT options. */
 
+/* Cache the GATT databases of bonded peers in the store; discovery procedures
+ * are answered from the cache when it covers them.
+ */
+#ifndef NIMBLE_OPT_GATT_CACHE
+#define NIMBLE_OPT_GATT_CACHE                   NIMBLE_OPT_ROLE_CENTRAL
+#endif
+
 /* The maximum number of attributes that can be written with a single GATT
  * Reliable Write procedure.
  */
@@ -279,14 +297,32 @@
 
 /*
  * Configuration items for the number of duplicate advertisers and the
- * number of advertisers from which we have heard a scan response.
+ * number of advertisers from which we have heard a scan response. These are
+ * rounded up to a multiple of four; once full, the least recently heard
+ * advertisers are forgotten.
  */
 #ifndef NIMBLE_OPT_LL_NUM_SCAN_DUP_ADVS
-#define NIMBLE_OPT_LL_NUM_SCAN_DUP_ADVS         (8)
+#define NIMBLE_OPT_LL_NUM_SCAN_DUP_ADVS         (32)
 #endif
 
 #ifndef NIMBLE_OPT_LL_NUM_SCAN_RSP_ADVS
-#define NIMBLE_OPT_LL_NUM_SCAN_RSP_ADVS         (8)
+#define NIMBLE_OPT_LL_NUM_SCAN_RSP_ADVS         (32)
+#endif
+
+/*
+ * Advertising report batching. When the window is non-zero, the controller
+ * holds advertising reports for up to this many milliseconds and packs them
+ * into one LE Advertising Report event, as long as the event parameters do
+ * not exceed NIMBLE_OPT_LL_ADV_RPT_BATCH_LEN bytes. The HCI event buffers
+ * must hold at least two bytes more than that. A window of 0 sends each
+ * report in its own event.
+ */
+#ifndef NIMBLE_OPT_LL_ADV_RPT_BATCH_MS
+#define NIMBLE_OPT_LL_ADV_RPT_BATCH_MS          (0)
+#endif
+
+#ifndef NIMBLE_OPT_LL_ADV_RPT_BATCH_LEN
+#define NIMBLE_OPT_LL_ADV_RPT_BATCH_LEN         (68)
 #endif
 
 /* Size of the LL whitelist */
@@ -299,6 +335,28 @@
 #define NIMBLE_OPT_LL_RESOLV_LIST_SIZE          (4)
 #endif
 
+/*
+ * Number of recently seen peer RPAs (and the resolving list entry they
+ * resolved to, if any) remembered by the controller. Used when the hardware
+ * could not resolve an address so that the same RPA is only run through the
+ * software resolver once. The cache is flushed on RPA timeout and whenever
+ * the resolving list changes. Set to 0 to disable.
+ */
+#ifndef NIMBLE_OPT_LL_RESOLV_CACHE_SIZE
+#define NIMBLE_OPT_LL_RESOLV_CACHE_SIZE         (8)
+#endif
+
+/*
+ * Number of peer RPAs precomputed for each resolving list entry. The pool
+ * (plus the next local RPA of each entry) is refilled from the LL task so
+ * that an RPA needed when advertising or initiating starts, or when the RPA
+ * timer expires, does not have to be run through AES at that time. Set to 0
+ * to disable.
+ */
+#ifndef NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE
+#define NIMBLE_OPT_LL_RESOLV_RPA_POOL_SIZE      (2)
+#endif
+
 /*
  * Data length management definitions for connections. These define the maximum
  * size of the PDU's that will be sent and/or received in a connection.
@@ -315,6 +373,17 @@
 #define NIMBLE_OPT_LL_SUPP_MAX_TX_BYTES         (NIMBLE_OPT_LL_MAX_PKT_SIZE)
 #endif
 
+/*
+ * Number of receive PDU buffers the link layer reserves for itself. Each
+ * buffer is a single mbuf large enough to hold a PDU with the maximum
+ * supported receive payload (NIMBLE_OPT_LL_SUPP_MAX_RX_BYTES) plus MIC.
+ * Received PDUs are only allocated from msys when this pool is empty. Set
+ * to 0 to always allocate received PDUs from msys.
+ */
+#ifndef NIMBLE_OPT_LL_NUM_RX_PDU_BUFS
+#define NIMBLE_OPT_LL_NUM_RX_PDU_BUFS           (0)
+#endif
+
 #ifndef NIMBLE_OPT_LL_CONN_INIT_MAX_TX_BYTES
 #define NIMBLE_OPT_LL_CONN_INIT_MAX_TX_BYTES    (27)
 #endif
@@ -324,11 +393,83 @@
 #define NIMBLE_OPT_LL_CONN_INIT_SLOTS           (2)
 #endif
 
-/* The number of random bytes to store */
+/* The number of random bytes to store (at least 16) */
 #ifndef NIMBLE_OPT_LL_RNG_BUFSIZE
 #define NIMBLE_OPT_LL_RNG_BUFSIZE               (32)
 #endif
 
+/*
+ * Random data handed out by the controller comes from an AES-CTR DRBG keyed
+ * from the RNG buffer above, so callers never wait on the RNG peripheral
+ * once the first 16 bytes have been collected. This is the number of 16 byte
+ * blocks generated before fresh entropy is mixed into the key.
+ */
+#ifndef NIMBLE_OPT_LL_RNG_RESEED_BLOCKS
+#define NIMBLE_OPT_LL_RNG_RESEED_BLOCKS         (64)
+#endif
+
+/*
+ * Enables the link layer profiler: scheduled vs. executed events, aborted
+ * and overrunning events, skipped connection events, time spent in each
+ * state and RX CRC errors per channel. Counters are exposed through the
+ * "ble_ll_prof" stats group and vendor specific HCI commands. Costs a few
+ * cputime reads per scheduled item.
+ */
+#ifndef NIMBLE_OPT_LL_PROF
+#define NIMBLE_OPT_LL_PROF                      (0)
+#endif
+
+/*
+ * Enables adaptive channel maps. As master, the link layer tracks per data
+ * channel CRC errors and missed responses for each connection and removes
+ * channels that perform badly (e.g. due to Wi-Fi interference) from that
+ * connection's channel map. Only channels the host has classified as usable
+ * are ever used.
+ */
+#ifndef NIMBLE_OPT_LL_CONN_ADAPT_CHMAP
+#define NIMBLE_OPT_LL_CONN_ADAPT_CHMAP          (0)
+#endif
+
+/* Number of packets received (or missed) on a channel before it is judged */
+#ifndef NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_SAMPLES
+#define NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_SAMPLES  (16)
+#endif
+
+/* Error percentage at or above which a channel is removed from the map */
+#ifndef NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_ERR_PCT
+#define NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_ERR_PCT  (50)
+#endif
+
+/* Never remove channels if it would leave fewer than this many in use */
+#ifndef NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_MIN_CHANS
+#define NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_MIN_CHANS (8)
+#endif
+
+/*
+ * Number of connection events after which removed channels are retried.
+ * Must not exceed 32767.
+ */
+#ifndef NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_RETRY
+#define NIMBLE_OPT_LL_CONN_ADAPT_CHMAP_RETRY    (2000)
+#endif
+
+/*
+ * Enables adaptive window widening. As slave, the link layer measures the
+ * drift of the master's clock relative to ours from the anchor points it
+ * observes, moves its expected anchor points to compensate and sizes the
+ * receive window from the measured deviation instead of the worst-case
+ * sleep clock accuracies. Window widening never exceeds the worst-case
+ * value.
+ */
+#ifndef NIMBLE_OPT_LL_CONN_ADAPT_WW
+#define NIMBLE_OPT_LL_CONN_ADAPT_WW             (0)
+#endif
+
+/* Drift (in ppm) always allowed for on top of the measured deviation */
+#ifndef NIMBLE_OPT_LL_CONN_ADAPT_WW_MARGIN
+#define NIMBLE_OPT_LL_CONN_ADAPT_WW_MARGIN      (20)
+#endif
+
 /*
  * Configuration for LL supported features.
  *
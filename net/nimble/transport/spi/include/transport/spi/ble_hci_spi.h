@@ -0,0 +1,62 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_HCI_SPI_
+#define H_BLE_HCI_SPI_
+
+#include <inttypes.h>
+
+struct hal_spi;
+
+/** The host side is the SPI master; the controller side is the slave. */
+#define BLE_HCI_SPI_ROLE_MASTER     0
+#define BLE_HCI_SPI_ROLE_SLAVE      1
+
+struct ble_hci_spi_cfg {
+    /**
+     * The SPI device, created and configured (mode, speed) by the BSP.  On
+     * the slave side, the device must support hal_spi_slave_txrx(); its chip
+     * select input is handled by the SPI peripheral.
+     */
+    struct hal_spi *spi;
+
+    /** One of the BLE_HCI_SPI_ROLE_[...] constants. */
+    uint8_t role;
+
+    /** Chip select, driven by the master.  Unused on the slave side. */
+    int cs_pin;
+
+    /**
+     * Slave to master: the slave has set up the buffers for the next
+     * transfer.  The master starts a transfer only after a rising edge.
+     */
+    int rdy_pin;
+
+    /** Slave to master: the slave has packets to send. */
+    int int_pin;
+
+    uint16_t num_evt_bufs;
+    uint16_t evt_buf_sz;
+};
+
+extern const struct ble_hci_spi_cfg ble_hci_spi_cfg_dflt;
+
+int ble_hci_spi_init(const struct ble_hci_spi_cfg *cfg);
+
+#endif
@@ -0,0 +1,966 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include "os/os.h"
+#include "util/mem.h"
+#include "hal/hal_gpio.h"
+#include "hal/hal_spi.h"
+
+/* BLE */
+#include "nimble/ble.h"
+#include "nimble/hci_common.h"
+#include "nimble/ble_hci_trans.h"
+
+#include "transport/spi/ble_hci_spi.h"
+
+/***
+ * NOTE:
+ * Like the UART transport, the SPI transport doesn't use event buffer
+ * priorities.  All incoming and outgoing events and commands use buffers from
+ * the same pool.
+ *
+ * Protocol:
+ * Each exchange starts with a transfer of a four byte header in both
+ * directions: the H4 packet type (0 if there is no packet), the packet length
+ * (little endian), and BLE_HCI_SPI_SYNC.  Both sides thereby learn the length
+ * of the packet coming from the other side.  The packets follow in payload
+ * transfers of at most BLE_HCI_SPI_SEG_MAX bytes, both directions at once;
+ * the shorter packet ends early.  Packets are sent from and received into
+ * their buffers (command / event buffer, or ACL data mbuf) directly, so the
+ * SPI drivers' DMA moves the data without copying.
+ *
+ * The slave raises RDY once it has set up its buffers for the next transfer,
+ * and drops it when the transfer ends; the master starts each transfer only
+ * after a rising edge of RDY.  INT is high while the slave has packets to
+ * send.  The master starts an exchange when it has a packet to send or INT is
+ * high.  A packet queued by the slave after its header has been set up goes
+ * out in the next exchange.
+ */
+
+#define BLE_HCI_SPI_H4_NONE         0x00
+#define BLE_HCI_SPI_H4_CMD          0x01
+#define BLE_HCI_SPI_H4_ACL          0x02
+#define BLE_HCI_SPI_H4_EVT          0x04
+
+#define BLE_HCI_SPI_HDR_LEN         4
+#define BLE_HCI_SPI_SYNC            0xa5
+
+/** Largest transfer the nRF52832 SPIS EasyDMA can do. */
+#define BLE_HCI_SPI_SEG_MAX         255
+
+#define BLE_HCI_SPI_STATE_IDLE      0   /* Master: no exchange in progress. */
+#define BLE_HCI_SPI_STATE_HDR       1   /* Header transfer. */
+#define BLE_HCI_SPI_STATE_SEG_WAIT  2   /* Master: payload waits for RDY. */
+#define BLE_HCI_SPI_STATE_SEG       3   /* Payload transfer. */
+
+/** Default configuration. */
+const struct ble_hci_spi_cfg ble_hci_spi_cfg_dflt = {
+    .spi = NULL,
+    .role = BLE_HCI_SPI_ROLE_MASTER,
+    .cs_pin = -1,
+    .rdy_pin = -1,
+    .int_pin = -1,
+
+    .num_evt_bufs = 8,
+    .evt_buf_sz = BLE_HCI_TRANS_CMD_SZ,
+};
+
+static ble_hci_trans_rx_cmd_fn *ble_hci_spi_rx_cmd_cb;
+static void *ble_hci_spi_rx_cmd_arg;
+
+static ble_hci_trans_rx_acl_fn *ble_hci_spi_rx_acl_cb;
+static void *ble_hci_spi_rx_acl_arg;
+
+static struct os_mempool ble_hci_spi_evt_pool;
+static void *ble_hci_spi_evt_buf;
+
+static struct os_mempool ble_hci_spi_pkt_pool;
+static void *ble_hci_spi_pkt_buf;
+
+/**
+ * A queued packet to be sent over SPI.  This can be a command, an event, or
+ * ACL data.
+ */
+struct ble_hci_spi_pkt {
+    STAILQ_ENTRY(ble_hci_spi_pkt) next;
+    void *data;
+    uint8_t type;
+};
+
+/**
+ * The packet sent or received in the current exchange.
+ */
+struct ble_hci_spi_xfer {
+    uint8_t type;       /* BLE_HCI_SPI_H4_NONE if nothing / dropped. */
+    uint16_t len;
+    uint8_t *buf;       /* Contiguous packet data. */
+    struct os_mbuf *om; /* ACL data packet holding buf. */
+};
+
+static struct {
+    uint8_t state;
+    volatile uint8_t slave_rdy; /* Master: RDY rose since last transfer. */
+
+    uint8_t tx_hdr[BLE_HCI_SPI_HDR_LEN];
+    uint8_t rx_hdr[BLE_HCI_SPI_HDR_LEN];
+    struct ble_hci_spi_xfer tx;
+    struct ble_hci_spi_xfer rx;
+
+    uint16_t off;       /* Payload bytes exchanged in earlier transfers. */
+    uint16_t seg_len;   /* Length of the current payload transfer. */
+    uint16_t seg_done;  /* Master: bytes of seg_len done. */
+    uint16_t piece_len; /* Master: length of the SPI transfer in progress. */
+
+    STAILQ_HEAD(, ble_hci_spi_pkt) tx_pkts; /* Packet queue to send. */
+} ble_hci_spi_state;
+
+static struct ble_hci_spi_cfg ble_hci_spi_cfg;
+
+static void ble_hci_spi_m_run(void);
+static void ble_hci_spi_s_int_update(void);
+
+static void
+ble_hci_spi_free_pkt(uint8_t type, uint8_t *cmdevt, struct os_mbuf *acl)
+{
+    switch (type) {
+    case BLE_HCI_SPI_H4_NONE:
+        break;
+
+    case BLE_HCI_SPI_H4_CMD:
+    case BLE_HCI_SPI_H4_EVT:
+        ble_hci_trans_buf_free(cmdevt);
+        break;
+
+    case BLE_HCI_SPI_H4_ACL:
+        os_mbuf_free_chain(acl);
+        break;
+
+    default:
+        assert(0);
+        break;
+    }
+}
+
+static int
+ble_hci_spi_pkt_tx(void *data, uint8_t type)
+{
+    struct ble_hci_spi_pkt *pkt;
+    os_sr_t sr;
+
+    pkt = os_memblock_get(&ble_hci_spi_pkt_pool);
+    if (pkt == NULL) {
+        ble_hci_spi_free_pkt(type, data, data);
+        return BLE_ERR_MEM_CAPACITY;
+    }
+
+    pkt->type = type;
+    pkt->data = data;
+
+    OS_ENTER_CRITICAL(sr);
+    STAILQ_INSERT_TAIL(&ble_hci_spi_state.tx_pkts, pkt, next);
+    OS_EXIT_CRITICAL(sr);
+
+    if (ble_hci_spi_cfg.role == BLE_HCI_SPI_ROLE_MASTER) {
+        ble_hci_spi_m_run();
+    } else {
+        ble_hci_spi_s_int_update();
+    }
+
+    return 0;
+}
+
+static int
+ble_hci_spi_acl_tx(struct os_mbuf *om)
+{
+    /* DMA needs the packet in one piece. */
+    if (SLIST_NEXT(om, om_next) != NULL) {
+        om = os_mbuf_pullup(om, OS_MBUF_PKTLEN(om));
+        if (om == NULL) {
+            return BLE_ERR_MEM_CAPACITY;
+        }
+    }
+
+    return ble_hci_spi_pkt_tx(om, BLE_HCI_SPI_H4_ACL);
+}
+
+/**
+ * Makes the next queued packet the one to send, unless a packet is already
+ * pending.  Must be called with interrupts disabled.
+ */
+static void
+ble_hci_spi_tx_next(void)
+{
+    struct ble_hci_spi_xfer *tx;
+    struct ble_hci_spi_pkt *pkt;
+
+    tx = &ble_hci_spi_state.tx;
+    if (tx->type != BLE_HCI_SPI_H4_NONE) {
+        return;
+    }
+
+    pkt = STAILQ_FIRST(&ble_hci_spi_state.tx_pkts);
+    if (pkt == NULL) {
+        return;
+    }
+    STAILQ_REMOVE_HEAD(&ble_hci_spi_state.tx_pkts, next);
+
+    tx->type = pkt->type;
+    switch (pkt->type) {
+    case BLE_HCI_SPI_H4_CMD:
+        tx->buf = pkt->data;
+        tx->len = tx->buf[2] + BLE_HCI_CMD_HDR_LEN;
+        break;
+
+    case BLE_HCI_SPI_H4_EVT:
+        tx->buf = pkt->data;
+        tx->len = tx->buf[1] + BLE_HCI_EVENT_HDR_LEN;
+        break;
+
+    case BLE_HCI_SPI_H4_ACL:
+        tx->om = pkt->data;
+        tx->buf = tx->om->om_data;
+        tx->len = OS_MBUF_PKTLEN(tx->om);
+        break;
+    }
+
+    os_memblock_put(&ble_hci_spi_pkt_pool, pkt);
+}
+
+static void
+ble_hci_spi_hdr_build(void)
+{
+    ble_hci_spi_state.tx_hdr[0] = ble_hci_spi_state.tx.type;
+    htole16(ble_hci_spi_state.tx_hdr + 1, ble_hci_spi_state.tx.len);
+    ble_hci_spi_state.tx_hdr[3] = BLE_HCI_SPI_SYNC;
+}
+
+/**
+ * Gets a buffer for the packet announced in the received header.  If the
+ * packet type is unexpected or no buffer is available, the packet is still
+ * clocked in to keep both sides in step, but it is dropped.
+ */
+static void
+ble_hci_spi_rx_alloc(void)
+{
+    struct ble_hci_spi_xfer *rx;
+    uint8_t type;
+
+    rx = &ble_hci_spi_state.rx;
+    memset(rx, 0, sizeof *rx);
+
+    type = ble_hci_spi_state.rx_hdr[0];
+    rx->len = le16toh(ble_hci_spi_state.rx_hdr + 1);
+    if (rx->len == 0) {
+        return;
+    }
+
+    switch (type) {
+    case BLE_HCI_SPI_H4_CMD:
+    case BLE_HCI_SPI_H4_EVT:
+        if ((type == BLE_HCI_SPI_H4_CMD) !=
+            (ble_hci_spi_cfg.role == BLE_HCI_SPI_ROLE_SLAVE)) {
+            break;
+        }
+        if (rx->len > ble_hci_spi_cfg.evt_buf_sz) {
+            break;
+        }
+        rx->buf = ble_hci_trans_buf_alloc(type == BLE_HCI_SPI_H4_CMD ?
+                                          BLE_HCI_TRANS_BUF_CMD :
+                                          BLE_HCI_TRANS_BUF_EVT_HI);
+        break;
+
+    case BLE_HCI_SPI_H4_ACL:
+        rx->om = os_msys_get_pkthdr(rx->len, 0);
+        if (rx->om != NULL && OS_MBUF_TRAILINGSPACE(rx->om) < rx->len) {
+            os_mbuf_free_chain(rx->om);
+            rx->om = NULL;
+        }
+        if (rx->om != NULL) {
+            rx->buf = rx->om->om_data;
+        }
+        break;
+    }
+
+    if (rx->buf != NULL) {
+        rx->type = type;
+    }
+}
+
+/**
+ * Determines the length of the next payload transfer, and how much of it
+ * each packet fills.  Both sides arrive at the same figures.
+ */
+static void
+ble_hci_spi_seg(int *out_tx_len, int *out_rx_len)
+{
+    int total;
+    int tx_len;
+    int rx_len;
+    int off;
+
+    off = ble_hci_spi_state.off;
+    total = max(ble_hci_spi_state.tx.len, ble_hci_spi_state.rx.len);
+    ble_hci_spi_state.seg_len = min(total - off, BLE_HCI_SPI_SEG_MAX);
+
+    tx_len = ble_hci_spi_state.tx.len - off;
+    rx_len = ble_hci_spi_state.rx.len - off;
+    *out_tx_len = max(0, min(tx_len, ble_hci_spi_state.seg_len));
+    *out_rx_len = max(0, min(rx_len, ble_hci_spi_state.seg_len));
+}
+
+static int
+ble_hci_spi_payload_done(void)
+{
+    ble_hci_spi_state.off += ble_hci_spi_state.seg_len;
+    return ble_hci_spi_state.off >= max(ble_hci_spi_state.tx.len,
+                                        ble_hci_spi_state.rx.len);
+}
+
+/**
+ * Ends an exchange: passes the received packet up, and frees the sent one.
+ */
+static void
+ble_hci_spi_complete(void)
+{
+    struct ble_hci_spi_xfer *rx;
+    struct ble_hci_spi_xfer *tx;
+    int rc;
+
+    rx = &ble_hci_spi_state.rx;
+    switch (rx->type) {
+    case BLE_HCI_SPI_H4_CMD:
+    case BLE_HCI_SPI_H4_EVT:
+        assert(ble_hci_spi_rx_cmd_cb != NULL);
+        rc = ble_hci_spi_rx_cmd_cb(rx->buf, ble_hci_spi_rx_cmd_arg);
+        if (rc != 0) {
+            ble_hci_trans_buf_free(rx->buf);
+        }
+        break;
+
+    case BLE_HCI_SPI_H4_ACL:
+        assert(ble_hci_spi_rx_acl_cb != NULL);
+        rx->om->om_len = rx->len;
+        OS_MBUF_PKTHDR(rx->om)->omp_len = rx->len;
+        ble_hci_spi_rx_acl_cb(rx->om, ble_hci_spi_rx_acl_arg);
+        break;
+    }
+    memset(rx, 0, sizeof *rx);
+
+    tx = &ble_hci_spi_state.tx;
+    ble_hci_spi_free_pkt(tx->type, tx->buf, tx->om);
+    memset(tx, 0, sizeof *tx);
+}
+
+/*****************************************************************************
+ * $master                                                                   *
+ *****************************************************************************/
+
+static void ble_hci_spi_m_piece_done(void *arg, int len);
+
+/**
+ * Starts the next SPI transfer of the current payload transfer.  The part
+ * where both packets have data goes first; the rest of the longer packet
+ * follows, with the driver sending filler or dropping what it receives.
+ */
+static void
+ble_hci_spi_m_piece(void)
+{
+    uint8_t *txp;
+    uint8_t *rxp;
+    int common;
+    int tx_len;
+    int rx_len;
+    int done;
+    int off;
+    int rc;
+
+    ble_hci_spi_seg(&tx_len, &rx_len);
+    off = ble_hci_spi_state.off;
+    done = ble_hci_spi_state.seg_done;
+    common = min(tx_len, rx_len);
+
+    if (done < common) {
+        ble_hci_spi_state.piece_len = common - done;
+    } else {
+        ble_hci_spi_state.piece_len = ble_hci_spi_state.seg_len - done;
+    }
+
+    txp = NULL;
+    if (done < tx_len) {
+        txp = ble_hci_spi_state.tx.buf + off + done;
+    }
+    rxp = NULL;
+    if (done < rx_len && ble_hci_spi_state.rx.buf != NULL) {
+        rxp = ble_hci_spi_state.rx.buf + off + done;
+    }
+
+    rc = hal_spi_txrx_nonblock(ble_hci_spi_cfg.spi, txp, rxp,
+                               ble_hci_spi_state.piece_len,
+                               ble_hci_spi_m_piece_done, NULL);
+    assert(rc == 0);
+}
+
+static void
+ble_hci_spi_m_piece_done(void *arg, int len)
+{
+    ble_hci_spi_state.seg_done += ble_hci_spi_state.piece_len;
+    if (ble_hci_spi_state.seg_done < ble_hci_spi_state.seg_len) {
+        ble_hci_spi_m_piece();
+        return;
+    }
+
+    hal_gpio_write(ble_hci_spi_cfg.cs_pin, 1);
+
+    if (ble_hci_spi_payload_done()) {
+        ble_hci_spi_complete();
+        ble_hci_spi_state.state = BLE_HCI_SPI_STATE_IDLE;
+    } else {
+        ble_hci_spi_state.state = BLE_HCI_SPI_STATE_SEG_WAIT;
+    }
+    ble_hci_spi_m_run();
+}
+
+static void
+ble_hci_spi_m_hdr_done(void *arg, int len)
+{
+    hal_gpio_write(ble_hci_spi_cfg.cs_pin, 1);
+
+    if (ble_hci_spi_state.rx_hdr[3] != BLE_HCI_SPI_SYNC) {
+        /* The slave wasn't listening; try again after its next RDY. */
+        ble_hci_spi_state.state = BLE_HCI_SPI_STATE_IDLE;
+        return;
+    }
+
+    ble_hci_spi_rx_alloc();
+    ble_hci_spi_state.off = 0;
+
+    if (ble_hci_spi_state.tx.len == 0 && ble_hci_spi_state.rx.len == 0) {
+        ble_hci_spi_state.state = BLE_HCI_SPI_STATE_IDLE;
+    } else {
+        ble_hci_spi_state.state = BLE_HCI_SPI_STATE_SEG_WAIT;
+    }
+    ble_hci_spi_m_run();
+}
+
+/**
+ * Starts the next transfer if the slave is ready for it, and there is
+ * something to do.  Called from task and interrupt context.
+ */
+static void
+ble_hci_spi_m_run(void)
+{
+    os_sr_t sr;
+    int rc;
+
+    OS_ENTER_CRITICAL(sr);
+
+    if (!ble_hci_spi_state.slave_rdy) {
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+
+    switch (ble_hci_spi_state.state) {
+    case BLE_HCI_SPI_STATE_IDLE:
+        ble_hci_spi_tx_next();
+        if (ble_hci_spi_state.tx.type == BLE_HCI_SPI_H4_NONE &&
+            !hal_gpio_read(ble_hci_spi_cfg.int_pin)) {
+
+            break;
+        }
+        ble_hci_spi_state.state = BLE_HCI_SPI_STATE_HDR;
+        ble_hci_spi_state.slave_rdy = 0;
+        OS_EXIT_CRITICAL(sr);
+
+        ble_hci_spi_hdr_build();
+        hal_gpio_write(ble_hci_spi_cfg.cs_pin, 0);
+        rc = hal_spi_txrx_nonblock(ble_hci_spi_cfg.spi,
+                                   ble_hci_spi_state.tx_hdr,
+                                   ble_hci_spi_state.rx_hdr,
+                                   BLE_HCI_SPI_HDR_LEN,
+                                   ble_hci_spi_m_hdr_done, NULL);
+        assert(rc == 0);
+        return;
+
+    case BLE_HCI_SPI_STATE_SEG_WAIT:
+        ble_hci_spi_state.state = BLE_HCI_SPI_STATE_SEG;
+        ble_hci_spi_state.slave_rdy = 0;
+        ble_hci_spi_state.seg_done = 0;
+        OS_EXIT_CRITICAL(sr);
+
+        hal_gpio_write(ble_hci_spi_cfg.cs_pin, 0);
+        ble_hci_spi_m_piece();
+        return;
+
+    default:
+        break;
+    }
+
+    OS_EXIT_CRITICAL(sr);
+}
+
+static void
+ble_hci_spi_m_rdy_irq(void *arg)
+{
+    ble_hci_spi_state.slave_rdy = 1;
+    ble_hci_spi_m_run();
+}
+
+static void
+ble_hci_spi_m_int_irq(void *arg)
+{
+    ble_hci_spi_m_run();
+}
+
+/*****************************************************************************
+ * $slave                                                                    *
+ *****************************************************************************/
+
+static void ble_hci_spi_s_done(void *arg, int len);
+
+static void
+ble_hci_spi_s_int_update(void)
+{
+    os_sr_t sr;
+    int pending;
+
+    OS_ENTER_CRITICAL(sr);
+    pending = ble_hci_spi_state.tx.type != BLE_HCI_SPI_H4_NONE ||
+              !STAILQ_EMPTY(&ble_hci_spi_state.tx_pkts);
+    hal_gpio_write(ble_hci_spi_cfg.int_pin, pending);
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Sets up the buffers for the next transfer, and tells the master with RDY.
+ */
+static void
+ble_hci_spi_s_arm(void)
+{
+    uint8_t *txp;
+    uint8_t *rxp;
+    int tx_len;
+    int rx_len;
+    int rc;
+
+    if (ble_hci_spi_state.state == BLE_HCI_SPI_STATE_HDR) {
+        txp = ble_hci_spi_state.tx_hdr;
+        rxp = ble_hci_spi_state.rx_hdr;
+        tx_len = BLE_HCI_SPI_HDR_LEN;
+        rx_len = BLE_HCI_SPI_HDR_LEN;
+    } else {
+        ble_hci_spi_seg(&tx_len, &rx_len);
+        txp = NULL;
+        if (tx_len > 0) {
+            txp = ble_hci_spi_state.tx.buf + ble_hci_spi_state.off;
+        }
+        rxp = NULL;
+        if (rx_len > 0 && ble_hci_spi_state.rx.buf != NULL) {
+            rxp = ble_hci_spi_state.rx.buf + ble_hci_spi_state.off;
+        } else {
+            rx_len = 0;
+        }
+    }
+
+    rc = hal_spi_slave_txrx(ble_hci_spi_cfg.spi, txp, tx_len, rxp, rx_len,
+                            ble_hci_spi_s_done, NULL);
+    assert(rc == 0);
+
+    hal_gpio_write(ble_hci_spi_cfg.rdy_pin, 1);
+}
+
+static void
+ble_hci_spi_s_hdr(void)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    ble_hci_spi_tx_next();
+    OS_EXIT_CRITICAL(sr);
+
+    ble_hci_spi_hdr_build();
+    ble_hci_spi_state.state = BLE_HCI_SPI_STATE_HDR;
+    ble_hci_spi_s_int_update();
+    ble_hci_spi_s_arm();
+}
+
+static void
+ble_hci_spi_s_done(void *arg, int len)
+{
+    hal_gpio_write(ble_hci_spi_cfg.rdy_pin, 0);
+
+    if (ble_hci_spi_state.state == BLE_HCI_SPI_STATE_HDR) {
+        if (len < BLE_HCI_SPI_HDR_LEN ||
+            ble_hci_spi_state.rx_hdr[3] != BLE_HCI_SPI_SYNC) {
+
+            /* Incomplete header; offer the same one again. */
+            ble_hci_spi_s_arm();
+            return;
+        }
+
+        ble_hci_spi_rx_alloc();
+        ble_hci_spi_state.off = 0;
+
+        if (ble_hci_spi_state.tx.len == 0 && ble_hci_spi_state.rx.len == 0) {
+            ble_hci_spi_s_hdr();
+        } else {
+            ble_hci_spi_state.state = BLE_HCI_SPI_STATE_SEG;
+            ble_hci_spi_s_arm();
+        }
+        return;
+    }
+
+    if (ble_hci_spi_payload_done()) {
+        ble_hci_spi_complete();
+        ble_hci_spi_s_hdr();
+    } else {
+        ble_hci_spi_s_arm();
+    }
+}
+
+/*****************************************************************************
+ * $api                                                                      *
+ *****************************************************************************/
+
+static void
+ble_hci_spi_set_rx_cbs(ble_hci_trans_rx_cmd_fn *cmd_cb,
+                       void *cmd_arg,
+                       ble_hci_trans_rx_acl_fn *acl_cb,
+                       void *acl_arg)
+{
+    ble_hci_spi_rx_cmd_cb = cmd_cb;
+    ble_hci_spi_rx_cmd_arg = cmd_arg;
+    ble_hci_spi_rx_acl_cb = acl_cb;
+    ble_hci_spi_rx_acl_arg = acl_arg;
+}
+
+static void
+ble_hci_spi_free_mem(void)
+{
+    free(ble_hci_spi_evt_buf);
+    ble_hci_spi_evt_buf = NULL;
+
+    free(ble_hci_spi_pkt_buf);
+    ble_hci_spi_pkt_buf = NULL;
+}
+
+/**
+ * Sets up the flow control lines and starts the protocol: the master waits
+ * for RDY, the slave sets up its first header transfer.
+ */
+static int
+ble_hci_spi_config(void)
+{
+    int rc;
+
+    if (ble_hci_spi_cfg.role == BLE_HCI_SPI_ROLE_MASTER) {
+        rc = hal_gpio_init_out(ble_hci_spi_cfg.cs_pin, 1);
+        if (rc != 0) {
+            return BLE_ERR_HW_FAIL;
+        }
+
+        rc = hal_gpio_irq_init(ble_hci_spi_cfg.rdy_pin, ble_hci_spi_m_rdy_irq,
+                               NULL, GPIO_TRIG_RISING, GPIO_PULL_DOWN);
+        if (rc != 0) {
+            return BLE_ERR_HW_FAIL;
+        }
+
+        rc = hal_gpio_irq_init(ble_hci_spi_cfg.int_pin, ble_hci_spi_m_int_irq,
+                               NULL, GPIO_TRIG_RISING, GPIO_PULL_DOWN);
+        if (rc != 0) {
+            hal_gpio_irq_release(ble_hci_spi_cfg.rdy_pin);
+            return BLE_ERR_HW_FAIL;
+        }
+
+        /* The slave may have been ready before we were. */
+        ble_hci_spi_state.slave_rdy = hal_gpio_read(ble_hci_spi_cfg.rdy_pin);
+
+        hal_gpio_irq_enable(ble_hci_spi_cfg.rdy_pin);
+        hal_gpio_irq_enable(ble_hci_spi_cfg.int_pin);
+        ble_hci_spi_m_run();
+    } else {
+        rc = hal_gpio_init_out(ble_hci_spi_cfg.rdy_pin, 0);
+        if (rc != 0) {
+            return BLE_ERR_HW_FAIL;
+        }
+
+        rc = hal_gpio_init_out(ble_hci_spi_cfg.int_pin, 0);
+        if (rc != 0) {
+            return BLE_ERR_HW_FAIL;
+        }
+
+        ble_hci_spi_s_hdr();
+    }
+
+    return 0;
+}
+
+/**
+ * Sends an HCI event from the controller to the host.
+ *
+ * @param cmd                   The HCI event to send.  This buffer must be
+ *                                  allocated via ble_hci_trans_buf_alloc().
+ *
+ * @return                      0 on success;
+ *                              A BLE_ERR_[...] error code on failure.
+ */
+int
+ble_hci_trans_ll_evt_tx(uint8_t *cmd)
+{
+    return ble_hci_spi_pkt_tx(cmd, BLE_HCI_SPI_H4_EVT);
+}
+
+/**
+ * Sends ACL data from controller to host.
+ *
+ * @param om                    The ACL data packet to send.
+ *
+ * @return                      0 on success;
+ *                              A BLE_ERR_[...] error code on failure.
+ */
+int
+ble_hci_trans_ll_acl_tx(struct os_mbuf *om)
+{
+    return ble_hci_spi_acl_tx(om);
+}
+
+/**
+ * Sends an HCI command from the host to the controller.
+ *
+ * @param cmd                   The HCI command to send.  This buffer must be
+ *                                  allocated via ble_hci_trans_buf_alloc().
+ *
+ * @return                      0 on success;
+ *                              A BLE_ERR_[...] error code on failure.
+ */
+int
+ble_hci_trans_hs_cmd_tx(uint8_t *cmd)
+{
+    return ble_hci_spi_pkt_tx(cmd, BLE_HCI_SPI_H4_CMD);
+}
+
+/**
+ * Sends ACL data from host to controller.
+ *
+ * @param om                    The ACL data packet to send.
+ *
+ * @return                      0 on success;
+ *                              A BLE_ERR_[...] error code on failure.
+ */
+int
+ble_hci_trans_hs_acl_tx(struct os_mbuf *om)
+{
+    return ble_hci_spi_acl_tx(om);
+}
+
+/**
+ * Configures the HCI transport to call the specified callback upon receiving
+ * HCI packets from the controller.  This function should only be called by by
+ * host.
+ *
+ * @param cmd_cb                The callback to execute upon receiving an HCI
+ *                                  event.
+ * @param cmd_arg               Optional argument to pass to the command
+ *                                  callback.
+ * @param acl_cb                The callback to execute upon receiving ACL
+ *                                  data.
+ * @param acl_arg               Optional argument to pass to the ACL
+ *                                  callback.
+ */
+void
+ble_hci_trans_cfg_hs(ble_hci_trans_rx_cmd_fn *cmd_cb,
+                     void *cmd_arg,
+                     ble_hci_trans_rx_acl_fn *acl_cb,
+                     void *acl_arg)
+{
+    ble_hci_spi_set_rx_cbs(cmd_cb, cmd_arg, acl_cb, acl_arg);
+}
+
+/**
+ * Configures the HCI transport to operate with a host.  The transport will
+ * execute specified callbacks upon receiving HCI packets from the host.
+ *
+ * @param cmd_cb                The callback to execute upon receiving an HCI
+ *                                  command.
+ * @param cmd_arg               Optional argument to pass to the command
+ *                                  callback.
+ * @param acl_cb                The callback to execute upon receiving ACL
+ *                                  data.
+ * @param acl_arg               Optional argument to pass to the ACL
+ *                                  callback.
+ */
+void
+ble_hci_trans_cfg_ll(ble_hci_trans_rx_cmd_fn *cmd_cb,
+                     void *cmd_arg,
+                     ble_hci_trans_rx_acl_fn *acl_cb,
+                     void *acl_arg)
+{
+    ble_hci_spi_set_rx_cbs(cmd_cb, cmd_arg, acl_cb, acl_arg);
+}
+
+/**
+ * Allocates a flat buffer of the specified type.
+ *
+ * @param type                  The type of buffer to allocate; one of the
+ *                                  BLE_HCI_TRANS_BUF_[...] constants.
+ *
+ * @return                      The allocated buffer on success;
+ *                              NULL on buffer exhaustion.
+ */
+uint8_t *
+ble_hci_trans_buf_alloc(int type)
+{
+    uint8_t *buf;
+
+    switch (type) {
+    case BLE_HCI_TRANS_BUF_CMD:
+    case BLE_HCI_TRANS_BUF_EVT_LO:
+    case BLE_HCI_TRANS_BUF_EVT_HI:
+        buf = os_memblock_get(&ble_hci_spi_evt_pool);
+        break;
+
+    default:
+        assert(0);
+        buf = NULL;
+    }
+
+    return buf;
+}
+
+/**
+ * Frees the specified flat buffer.  The buffer must have been allocated via
+ * ble_hci_trans_buf_alloc().
+ *
+ * @param buf                   The buffer to free.
+ */
+void
+ble_hci_trans_buf_free(uint8_t *buf)
+{
+    int rc;
+
+    rc = os_memblock_put(&ble_hci_spi_evt_pool, buf);
+    assert(rc == 0);
+}
+
+/**
+ * Resets the HCI SPI transport to a clean state.  Frees all buffers and
+ * restarts the protocol.  Both sides are expected to reset together, with
+ * no transfer in progress.
+ *
+ * @return                      0 on success;
+ *                              A BLE_ERR_[...] error code on failure.
+ */
+int
+ble_hci_trans_reset(void)
+{
+    struct ble_hci_spi_pkt *pkt;
+    os_sr_t sr;
+
+    if (ble_hci_spi_cfg.role == BLE_HCI_SPI_ROLE_MASTER) {
+        hal_gpio_irq_release(ble_hci_spi_cfg.rdy_pin);
+        hal_gpio_irq_release(ble_hci_spi_cfg.int_pin);
+    } else {
+        hal_gpio_write(ble_hci_spi_cfg.rdy_pin, 0);
+    }
+
+    OS_ENTER_CRITICAL(sr);
+
+    ble_hci_spi_free_pkt(ble_hci_spi_state.rx.type,
+                         ble_hci_spi_state.rx.buf,
+                         ble_hci_spi_state.rx.om);
+    ble_hci_spi_free_pkt(ble_hci_spi_state.tx.type,
+                         ble_hci_spi_state.tx.buf,
+                         ble_hci_spi_state.tx.om);
+
+    while ((pkt = STAILQ_FIRST(&ble_hci_spi_state.tx_pkts)) != NULL) {
+        STAILQ_REMOVE_HEAD(&ble_hci_spi_state.tx_pkts, next);
+        ble_hci_spi_free_pkt(pkt->type, pkt->data, pkt->data);
+        os_memblock_put(&ble_hci_spi_pkt_pool, pkt);
+    }
+
+    memset(&ble_hci_spi_state, 0, sizeof ble_hci_spi_state);
+    STAILQ_INIT(&ble_hci_spi_state.tx_pkts);
+
+    OS_EXIT_CRITICAL(sr);
+
+    return ble_hci_spi_config();
+}
+
+/**
+ * Initializes the SPI HCI transport module.
+ *
+ * @param cfg                   The settings to initialize the HCI SPI
+ *                                  transport with.
+ *
+ * @return                      0 on success;
+ *                              A BLE_ERR_[...] error code on failure.
+ */
+int
+ble_hci_spi_init(const struct ble_hci_spi_cfg *cfg)
+{
+    int rc;
+
+    if (cfg->spi == NULL || cfg->rdy_pin < 0 || cfg->int_pin < 0 ||
+        (cfg->role == BLE_HCI_SPI_ROLE_MASTER && cfg->cs_pin < 0)) {
+
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    ble_hci_spi_free_mem();
+
+    ble_hci_spi_cfg = *cfg;
+
+    /* Create memory pool of HCI command / event buffers */
+    rc = mem_malloc_mempool(&ble_hci_spi_evt_pool,
+                            cfg->num_evt_bufs,
+                            cfg->evt_buf_sz,
+                            "ble_hci_spi_evt_pool",
+                            &ble_hci_spi_evt_buf);
+    if (rc != 0) {
+        rc = ble_err_from_os(rc);
+        goto err;
+    }
+
+    /* Create memory pool of packet list nodes. */
+    rc = mem_malloc_mempool(&ble_hci_spi_pkt_pool,
+                            cfg->num_evt_bufs,
+                            sizeof (struct ble_hci_spi_pkt),
+                            "ble_hci_spi_pkt_pool",
+                            &ble_hci_spi_pkt_buf);
+    if (rc != 0) {
+        rc = ble_err_from_os(rc);
+        goto err;
+    }
+
+    memset(&ble_hci_spi_state, 0, sizeof ble_hci_spi_state);
+    STAILQ_INIT(&ble_hci_spi_state.tx_pkts);
+
+    rc = ble_hci_spi_config();
+    if (rc != 0) {
+        goto err;
+    }
+
+    return 0;
+
+err:
+    ble_hci_spi_free_mem();
+    return rc;
+}
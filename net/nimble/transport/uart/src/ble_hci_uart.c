@@ -87,6 +87,7 @@ struct ble_hci_uart_cmd {
  */
 struct ble_hci_uart_acl {
     struct os_mbuf *buf; /* Buffer containing the data */
+    struct os_mbuf *cur; /* Last mbuf in chain; block mode receives into it */
     uint16_t len;        /* Target size when buf is considered complete */
 };
 
@@ -103,6 +104,7 @@ struct ble_hci_uart_pkt {
 static struct {
     /*** State of data received over UART. */
     uint8_t rx_type;    /* Pending packet type. 0 means nothing pending */
+    uint8_t rx_h4;      /* Packet type indicator; block mode receives here */
     union {
         struct ble_hci_uart_cmd rx_cmd;
         struct ble_hci_uart_acl rx_acl;
@@ -110,10 +112,13 @@ static struct {
 
     /*** State of data transmitted over UART. */
     uint8_t tx_type;    /* Pending packet type. 0 means nothing pending */
+    uint8_t tx_h4;      /* Block mode: type indicator still to be sent */
     union {
         struct ble_hci_uart_cmd tx_cmd;
         struct os_mbuf *tx_acl;
     };
+    struct os_mbuf *tx_acl_cur; /* Block mode: mbuf of tx_acl being sent */
+    uint16_t tx_acl_off;        /* Block mode: bytes of tx_acl_cur sent */
     STAILQ_HEAD(, ble_hci_uart_pkt) tx_pkts; /* Packet queue to send to UART */
 } ble_hci_uart_state;
 
@@ -260,6 +265,104 @@ ble_hci_uart_tx_char(void *arg)
     return rc;
 }
 
+/**
+ * Accounts for data sent out of the block most recently handed to the UART
+ * driver.  Frees a command or event once all of it has been sent.
+ */
+static void
+ble_hci_uart_tx_block_done(int tx_len)
+{
+    if (ble_hci_uart_state.tx_h4 != BLE_HCI_UART_H4_NONE) {
+        /* The packet type indicator went out on its own. */
+        ble_hci_uart_state.tx_h4 = BLE_HCI_UART_H4_NONE;
+        return;
+    }
+
+    switch (ble_hci_uart_state.tx_type) {
+    case BLE_HCI_UART_H4_CMD:
+    case BLE_HCI_UART_H4_EVT:
+        ble_hci_uart_state.tx_cmd.cur += tx_len;
+        if (ble_hci_uart_state.tx_cmd.cur == ble_hci_uart_state.tx_cmd.len) {
+            ble_hci_trans_buf_free(ble_hci_uart_state.tx_cmd.data);
+            ble_hci_uart_state.tx_type = BLE_HCI_UART_H4_NONE;
+        }
+        break;
+
+    case BLE_HCI_UART_H4_ACL:
+        ble_hci_uart_state.tx_acl_off += tx_len;
+        break;
+    }
+}
+
+/**
+ * Block mode counterpart of ble_hci_uart_tx_char().  Hands the UART driver
+ * contiguous spans of the pending packet to send directly: the whole
+ * command or event buffer, or one mbuf of an ACL data packet at a time.
+ *
+ * @param tx_len                The number of bytes sent from the previous
+ *                                  block.
+ * @param buf                   On success, points to the data to send.
+ *
+ * @return                      The length of the block on success;
+ *                              -1 if there is nothing to send.
+ */
+static int
+ble_hci_uart_tx_block(void *arg, int tx_len, uint8_t **buf)
+{
+    struct os_mbuf *om;
+    int rc;
+
+    if (tx_len > 0) {
+        ble_hci_uart_tx_block_done(tx_len);
+    }
+
+    if (ble_hci_uart_state.tx_type == BLE_HCI_UART_H4_NONE) {
+        rc = ble_hci_uart_tx_pkt_type();
+        if (rc < 0) {
+            return -1;
+        }
+        ble_hci_uart_state.tx_h4 = rc;
+        if (rc == BLE_HCI_UART_H4_ACL) {
+            ble_hci_uart_state.tx_acl_cur = ble_hci_uart_state.tx_acl;
+            ble_hci_uart_state.tx_acl_off = 0;
+        }
+    }
+
+    if (ble_hci_uart_state.tx_h4 != BLE_HCI_UART_H4_NONE) {
+        *buf = &ble_hci_uart_state.tx_h4;
+        return 1;
+    }
+
+    switch (ble_hci_uart_state.tx_type) {
+    case BLE_HCI_UART_H4_CMD:
+    case BLE_HCI_UART_H4_EVT:
+        *buf = ble_hci_uart_state.tx_cmd.data + ble_hci_uart_state.tx_cmd.cur;
+        return ble_hci_uart_state.tx_cmd.len - ble_hci_uart_state.tx_cmd.cur;
+
+    case BLE_HCI_UART_H4_ACL:
+        /* Skip over sent and empty mbufs. */
+        om = ble_hci_uart_state.tx_acl_cur;
+        while (om != NULL && ble_hci_uart_state.tx_acl_off >= om->om_len) {
+            om = SLIST_NEXT(om, om_next);
+            ble_hci_uart_state.tx_acl_off = 0;
+        }
+        ble_hci_uart_state.tx_acl_cur = om;
+
+        if (om == NULL) {
+            /* Whole packet sent; move on to the next one. */
+            os_mbuf_free_chain(ble_hci_uart_state.tx_acl);
+            ble_hci_uart_state.tx_type = BLE_HCI_UART_H4_NONE;
+            return ble_hci_uart_tx_block(arg, 0, buf);
+        }
+
+        *buf = om->om_data + ble_hci_uart_state.tx_acl_off;
+        return om->om_len - ble_hci_uart_state.tx_acl_off;
+
+    default:
+        return -1;
+    }
+}
+
 /**
  * @return                      The type of packet to follow success;
  *                              -1 if there is no valid packet to receive.
@@ -300,6 +403,7 @@ ble_hci_uart_rx_pkt_type(uint8_t data)
             os_msys_get_pkthdr(BLE_HCI_DATA_HDR_SZ, 0);
         assert(ble_hci_uart_state.rx_acl.buf != NULL);
 
+        ble_hci_uart_state.rx_acl.cur = ble_hci_uart_state.rx_acl.buf;
         ble_hci_uart_state.rx_acl.len = 0;
         break;
 
@@ -311,20 +415,26 @@ ble_hci_uart_rx_pkt_type(uint8_t data)
     return 0;
 }
 
+/**
+ * Checks the command or event being received after more of it has arrived.
+ * Once the header is in, records the total length; once the whole packet is
+ * in, passes it up.
+ *
+ * @param hdr_len               The header length of the packet; the last
+ *                                  header byte holds the parameter length.
+ */
 static void
-ble_hci_uart_rx_cmd(uint8_t data)
+ble_hci_uart_rx_cmdevt_update(uint8_t hdr_len)
 {
     int rc;
 
-    ble_hci_uart_state.rx_cmd.data[ble_hci_uart_state.rx_cmd.cur++] = data;
-
-    if (ble_hci_uart_state.rx_cmd.cur < BLE_HCI_CMD_HDR_LEN) {
+    if (ble_hci_uart_state.rx_cmd.cur < hdr_len) {
         return;
     }
 
-    if (ble_hci_uart_state.rx_cmd.cur == BLE_HCI_CMD_HDR_LEN) {
-        ble_hci_uart_state.rx_cmd.len = ble_hci_uart_state.rx_cmd.data[2] +
-                                         BLE_HCI_CMD_HDR_LEN;
+    if (ble_hci_uart_state.rx_cmd.cur == hdr_len) {
+        ble_hci_uart_state.rx_cmd.len =
+            ble_hci_uart_state.rx_cmd.data[hdr_len - 1] + hdr_len;
     }
 
     if (ble_hci_uart_state.rx_cmd.cur == ble_hci_uart_state.rx_cmd.len) {
@@ -339,39 +449,29 @@ ble_hci_uart_rx_cmd(uint8_t data)
 }
 
 static void
-ble_hci_uart_rx_evt(uint8_t data)
+ble_hci_uart_rx_cmd(uint8_t data)
 {
-    int rc;
-
     ble_hci_uart_state.rx_cmd.data[ble_hci_uart_state.rx_cmd.cur++] = data;
+    ble_hci_uart_rx_cmdevt_update(BLE_HCI_CMD_HDR_LEN);
+}
 
-    if (ble_hci_uart_state.rx_cmd.cur < BLE_HCI_EVENT_HDR_LEN) {
-        return;
-    }
-
-    if (ble_hci_uart_state.rx_cmd.cur == BLE_HCI_EVENT_HDR_LEN) {
-        ble_hci_uart_state.rx_cmd.len = ble_hci_uart_state.rx_cmd.data[1] +
-                                        BLE_HCI_EVENT_HDR_LEN;
-    }
-
-    if (ble_hci_uart_state.rx_cmd.cur == ble_hci_uart_state.rx_cmd.len) {
-        assert(ble_hci_uart_rx_cmd_cb != NULL);
-        rc = ble_hci_uart_rx_cmd_cb(ble_hci_uart_state.rx_cmd.data,
-                                    ble_hci_uart_rx_cmd_arg);
-        if (rc != 0) {
-            ble_hci_trans_buf_free(ble_hci_uart_state.rx_cmd.data);
-        }
-        ble_hci_uart_state.rx_type = BLE_HCI_UART_H4_NONE;
-    }
+static void
+ble_hci_uart_rx_evt(uint8_t data)
+{
+    ble_hci_uart_state.rx_cmd.data[ble_hci_uart_state.rx_cmd.cur++] = data;
+    ble_hci_uart_rx_cmdevt_update(BLE_HCI_EVENT_HDR_LEN);
 }
 
+/**
+ * Checks the ACL data packet being received after more of it has arrived.
+ * Once the header is in, records the total length; once the whole packet is
+ * in, passes it up.
+ */
 static void
-ble_hci_uart_rx_acl(uint8_t data)
+ble_hci_uart_rx_acl_update(void)
 {
     uint16_t pktlen;
 
-    os_mbuf_append(ble_hci_uart_state.rx_acl.buf, &data, 1);
-
     pktlen = OS_MBUF_PKTLEN(ble_hci_uart_state.rx_acl.buf);
 
     if (pktlen < BLE_HCI_DATA_HDR_SZ) {
@@ -394,6 +494,13 @@ ble_hci_uart_rx_acl(uint8_t data)
     }
 }
 
+static void
+ble_hci_uart_rx_acl(uint8_t data)
+{
+    os_mbuf_append(ble_hci_uart_state.rx_acl.buf, &data, 1);
+    ble_hci_uart_rx_acl_update();
+}
+
 static int
 ble_hci_uart_rx_char(void *arg, uint8_t data)
 {
@@ -414,6 +521,123 @@ ble_hci_uart_rx_char(void *arg, uint8_t data)
     }
 }
 
+/**
+ * Block mode: returns the number of bytes of the command or event still
+ * wanted and where they go.  The header is asked for on its own, since its
+ * last byte gives the length of the rest.
+ */
+static int
+ble_hci_uart_rx_cmdevt_next(uint8_t hdr_len, uint8_t **buf)
+{
+    *buf = ble_hci_uart_state.rx_cmd.data + ble_hci_uart_state.rx_cmd.cur;
+    if (ble_hci_uart_state.rx_cmd.cur < hdr_len) {
+        return hdr_len - ble_hci_uart_state.rx_cmd.cur;
+    }
+    return ble_hci_uart_state.rx_cmd.len - ble_hci_uart_state.rx_cmd.cur;
+}
+
+/**
+ * Block mode: returns the number of bytes of the ACL data packet wanted next
+ * and where they go.  Data is received straight into the trailing space of
+ * the last mbuf in the chain; a new mbuf is chained on when that fills up.
+ */
+static int
+ble_hci_uart_rx_acl_next(uint8_t **buf)
+{
+    struct ble_hci_uart_acl *acl;
+    struct os_mbuf *om;
+    uint16_t pktlen;
+    uint16_t space;
+    int len;
+
+    acl = &ble_hci_uart_state.rx_acl;
+
+    pktlen = OS_MBUF_PKTLEN(acl->buf);
+    if (pktlen < BLE_HCI_DATA_HDR_SZ) {
+        len = BLE_HCI_DATA_HDR_SZ - pktlen;
+    } else {
+        len = acl->len - pktlen;
+    }
+
+    om = acl->cur;
+    space = OS_MBUF_TRAILINGSPACE(om);
+    if (space == 0) {
+        /* XXX: See ble_hci_uart_rx_pkt_type() regarding allocation failure. */
+        om = os_msys_get(len, 0);
+        assert(om != NULL);
+
+        SLIST_NEXT(acl->cur, om_next) = om;
+        acl->cur = om;
+        space = OS_MBUF_TRAILINGSPACE(om);
+    }
+
+    if (len > space) {
+        len = space;
+    }
+    *buf = om->om_data + om->om_len;
+    return len;
+}
+
+/**
+ * Block mode counterpart of ble_hci_uart_rx_char().  The H4 framing tells
+ * exactly how much to expect, so the UART driver is asked for the type
+ * indicator, the header and the remainder of each packet as separate
+ * blocks, received directly into the destination buffer.
+ *
+ * @param rx_len                The number of bytes received into the
+ *                                  previous block.
+ * @param buf                   On success, points to where the next block
+ *                                  should be received.
+ *
+ * @return                      The number of bytes wanted on success;
+ *                              -1 if no more data can be accepted.
+ */
+static int
+ble_hci_uart_rx_block(void *arg, int rx_len, uint8_t **buf)
+{
+    struct os_mbuf *om;
+
+    if (rx_len > 0) {
+        switch (ble_hci_uart_state.rx_type) {
+        case BLE_HCI_UART_H4_NONE:
+            /* Unknown packet types are dropped a byte at a time. */
+            ble_hci_uart_rx_pkt_type(ble_hci_uart_state.rx_h4);
+            break;
+
+        case BLE_HCI_UART_H4_CMD:
+            ble_hci_uart_state.rx_cmd.cur += rx_len;
+            ble_hci_uart_rx_cmdevt_update(BLE_HCI_CMD_HDR_LEN);
+            break;
+
+        case BLE_HCI_UART_H4_EVT:
+            ble_hci_uart_state.rx_cmd.cur += rx_len;
+            ble_hci_uart_rx_cmdevt_update(BLE_HCI_EVENT_HDR_LEN);
+            break;
+
+        case BLE_HCI_UART_H4_ACL:
+            om = ble_hci_uart_state.rx_acl.cur;
+            om->om_len += rx_len;
+            OS_MBUF_PKTHDR(ble_hci_uart_state.rx_acl.buf)->omp_len += rx_len;
+            ble_hci_uart_rx_acl_update();
+            break;
+        }
+    }
+
+    switch (ble_hci_uart_state.rx_type) {
+    case BLE_HCI_UART_H4_NONE:
+        *buf = &ble_hci_uart_state.rx_h4;
+        return 1;
+    case BLE_HCI_UART_H4_CMD:
+        return ble_hci_uart_rx_cmdevt_next(BLE_HCI_CMD_HDR_LEN, buf);
+    case BLE_HCI_UART_H4_EVT:
+        return ble_hci_uart_rx_cmdevt_next(BLE_HCI_EVENT_HDR_LEN, buf);
+    case BLE_HCI_UART_H4_ACL:
+        return ble_hci_uart_rx_acl_next(buf);
+    default:
+        return -1;
+    }
+}
+
 static void
 ble_hci_uart_set_rx_cbs(ble_hci_trans_rx_cmd_fn *cmd_cb,
                         void *cmd_arg,
@@ -463,11 +687,19 @@ ble_hci_uart_config(void)
 {
     int rc;
 
-    rc = hal_uart_init_cbs(ble_hci_uart_cfg.uart_port,
-                           ble_hci_uart_tx_char, NULL,
-                           ble_hci_uart_rx_char, NULL);
+    /* Prefer block mode; fall back to a callback per byte if the UART driver
+     * can't do it.
+     */
+    rc = hal_uart_init_block_cbs(ble_hci_uart_cfg.uart_port,
+                                 ble_hci_uart_tx_block, NULL,
+                                 ble_hci_uart_rx_block, NULL);
     if (rc != 0) {
-        return BLE_ERR_UNSPECIFIED;
+        rc = hal_uart_init_cbs(ble_hci_uart_cfg.uart_port,
+                               ble_hci_uart_tx_char, NULL,
+                               ble_hci_uart_rx_char, NULL);
+        if (rc != 0) {
+            return BLE_ERR_UNSPECIFIED;
+        }
     }
 
     rc = hal_uart_config(ble_hci_uart_cfg.uart_port,
@@ -670,6 +902,7 @@ ble_hci_trans_reset(void)
                           ble_hci_uart_state.tx_cmd.data,
                           ble_hci_uart_state.tx_acl);
     ble_hci_uart_state.tx_type = BLE_HCI_UART_H4_NONE;
+    ble_hci_uart_state.tx_h4 = BLE_HCI_UART_H4_NONE;
 
     while ((pkt = STAILQ_FIRST(&ble_hci_uart_state.tx_pkts)) != NULL) {
         STAILQ_REMOVE(&ble_hci_uart_state.tx_pkts, pkt, ble_hci_uart_pkt,
@@ -727,14 +960,15 @@ ble_hci_uart_init(const struct ble_hci_uart_cfg *cfg)
         goto err;
     }
 
+    /* The UART may start receiving as soon as it is configured. */
+    memset(&ble_hci_uart_state, 0, sizeof ble_hci_uart_state);
+    STAILQ_INIT(&ble_hci_uart_state.tx_pkts);
+
     rc = ble_hci_uart_config();
     if (rc != 0) {
         goto err;
     }
 
-    memset(&ble_hci_uart_state, 0, sizeof ble_hci_uart_state);
-    STAILQ_INIT(&ble_hci_uart_state.tx_pkts);
-
     return 0;
 
 err:
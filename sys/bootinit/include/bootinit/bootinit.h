@@ -0,0 +1,90 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef __BOOTINIT_H__
+#define __BOOTINIT_H__
+
+#include <inttypes.h>
+#include <os/queue.h>
+
+/*
+ * Boot timeline. Steps are timestamped with hal_cputime, so cputime_init()
+ * must be called before the first step is recorded.
+ */
+#ifndef BOOTINIT_MAX_STEPS
+#define BOOTINIT_MAX_STEPS      (24)
+#endif
+
+struct bootinit_step {
+    const char *bs_name;
+    uint32_t bs_start;                  /* cputime */
+    uint32_t bs_end;                    /* cputime */
+    uint8_t bs_done:1;                  /* 0 while the step is running */
+    uint8_t bs_deferred:1;              /* Ran as deferred init */
+};
+
+int bootinit_step_start(const char *name);
+void bootinit_step_end(int step);
+void bootinit_ready(void);
+
+/*
+ * Records a call as a step on the boot timeline.
+ *
+ *     BOOTINIT_STEP("conf_load", conf_load());
+ */
+#define BOOTINIT_STEP(name, call)                                       \
+    do {                                                                \
+        int __step = bootinit_step_start(name);                         \
+        call;                                                           \
+        bootinit_step_end(__step);                                      \
+    } while (0)
+
+/*
+ * Deferred initialization. Subsystems which are not needed to reach
+ * "ready" register here, and are initialized later from a low priority
+ * task by bootinit_defer_run(). Entries run in ascending bd_order;
+ * entries with the same order run in registration order.
+ */
+typedef int bootinit_func_t(void);
+
+struct bootinit_deferred {
+    const char *bd_name;
+    bootinit_func_t *bd_func;
+    uint8_t bd_order;
+    int bd_rc;                          /* Return code of bd_func */
+    SLIST_ENTRY(bootinit_deferred) bd_next;
+};
+
+#define BOOTINIT_DEFERRED(name, func, order)                            \
+    { .bd_name = (name), .bd_func = (func), .bd_order = (order) }
+
+int bootinit_defer(struct bootinit_deferred *bd);
+int bootinit_defer_run(void);
+
+/*
+ * Read back the timeline.
+ */
+int bootinit_step_get(int idx, struct bootinit_step *step);
+int bootinit_ready_time(uint32_t *when);
+
+/*
+ * Registers the newtmgr group; call after nmgr_task_init().
+ */
+int bootinit_module_init(void);
+
+#endif /* __BOOTINIT_H__ */
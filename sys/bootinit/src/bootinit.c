@@ -0,0 +1,198 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <os/os.h>
+#include <hal/hal_cputime.h>
+
+#ifdef NEWTMGR_PRESENT
+#include <newtmgr/newtmgr.h>
+#endif
+
+#include "bootinit/bootinit.h"
+#include "bootinit_priv.h"
+
+static struct bootinit_step bootinit_steps[BOOTINIT_MAX_STEPS];
+static int bootinit_step_cnt;
+static uint32_t bootinit_ready_at;
+static uint8_t bootinit_is_ready;
+
+static SLIST_HEAD(, bootinit_deferred) bootinit_deferred_list =
+    SLIST_HEAD_INITIALIZER(&bootinit_deferred_list);
+
+/**
+ * Starts a step on the boot timeline.
+ *
+ * @param name                  Name of the step; must stay valid.
+ *
+ * @return                      Step ID to pass to bootinit_step_end(), -1 if
+ *                              the timeline is full.
+ */
+int
+bootinit_step_start(const char *name)
+{
+    struct bootinit_step *bs;
+    os_sr_t sr;
+    int step;
+
+    OS_ENTER_CRITICAL(sr);
+    if (bootinit_step_cnt >= BOOTINIT_MAX_STEPS) {
+        OS_EXIT_CRITICAL(sr);
+        return -1;
+    }
+    step = bootinit_step_cnt++;
+    OS_EXIT_CRITICAL(sr);
+
+    bs = &bootinit_steps[step];
+    bs->bs_name = name;
+    bs->bs_start = cputime_get32();
+
+    return step;
+}
+
+void
+bootinit_step_end(int step)
+{
+    struct bootinit_step *bs;
+
+    if (step < 0 || step >= BOOTINIT_MAX_STEPS) {
+        return;
+    }
+    bs = &bootinit_steps[step];
+    bs->bs_end = cputime_get32();
+    bs->bs_done = 1;
+}
+
+/**
+ * Marks the point where the device is ready for use. Only the first call
+ * is recorded.
+ */
+void
+bootinit_ready(void)
+{
+    if (!bootinit_is_ready) {
+        bootinit_ready_at = cputime_get32();
+        bootinit_is_ready = 1;
+    }
+}
+
+/**
+ * Returns the cputime at which bootinit_ready() was called.
+ *
+ * @return                      0 on success, -1 if not ready yet.
+ */
+int
+bootinit_ready_time(uint32_t *when)
+{
+    if (!bootinit_is_ready) {
+        return -1;
+    }
+    *when = bootinit_ready_at;
+    return 0;
+}
+
+/**
+ * Copies out a step from the timeline.
+ *
+ * @return                      0 on success, -1 if there's no such step.
+ */
+int
+bootinit_step_get(int idx, struct bootinit_step *step)
+{
+    if (idx < 0 || idx >= bootinit_step_cnt) {
+        return -1;
+    }
+    *step = bootinit_steps[idx];
+    return 0;
+}
+
+/**
+ * Registers a subsystem for deferred initialization. The structure must
+ * stay valid until bootinit_defer_run() has been called.
+ */
+int
+bootinit_defer(struct bootinit_deferred *bd)
+{
+    struct bootinit_deferred *cur;
+    struct bootinit_deferred *prev;
+
+    if (!bd->bd_func) {
+        return OS_EINVAL;
+    }
+
+    prev = NULL;
+    SLIST_FOREACH(cur, &bootinit_deferred_list, bd_next) {
+        if (cur == bd) {
+            return OS_EINVAL;
+        }
+        if (cur->bd_order > bd->bd_order) {
+            break;
+        }
+        prev = cur;
+    }
+    if (prev) {
+        SLIST_INSERT_AFTER(prev, bd, bd_next);
+    } else {
+        SLIST_INSERT_HEAD(&bootinit_deferred_list, bd, bd_next);
+    }
+    bd->bd_rc = 0;
+    return 0;
+}
+
+/**
+ * Runs the registered deferred init functions, in order, in the context of
+ * the calling task. Meant to be called once from a low priority task after
+ * os_start(). Each function is recorded as a step on the timeline.
+ *
+ * @return                      0 if all functions succeeded, otherwise the
+ *                              first non-zero return code.
+ */
+int
+bootinit_defer_run(void)
+{
+    struct bootinit_deferred *bd;
+    int step;
+    int rc;
+
+    rc = 0;
+    while ((bd = SLIST_FIRST(&bootinit_deferred_list))) {
+        SLIST_REMOVE_HEAD(&bootinit_deferred_list, bd_next);
+
+        step = bootinit_step_start(bd->bd_name);
+        if (step >= 0) {
+            bootinit_steps[step].bs_deferred = 1;
+        }
+        bd->bd_rc = bd->bd_func();
+        bootinit_step_end(step);
+
+        if (bd->bd_rc && !rc) {
+            rc = bd->bd_rc;
+        }
+    }
+    return rc;
+}
+
+int
+bootinit_module_init(void)
+{
+#ifdef NEWTMGR_PRESENT
+    return nmgr_group_register(&bootinit_nmgr_group);
+#else
+    return 0;
+#endif
+}
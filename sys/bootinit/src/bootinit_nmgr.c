@@ -0,0 +1,106 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef NEWTMGR_PRESENT
+
+#include <string.h>
+
+#include <os/os.h>
+#include <hal/hal_cputime.h>
+#include <newtmgr/newtmgr.h>
+#include <json/json.h>
+
+#include "bootinit/bootinit.h"
+#include "bootinit_priv.h"
+
+static int bootinit_nmgr_read(struct nmgr_jbuf *);
+
+static const struct nmgr_handler bootinit_nmgr_handler[] = {
+    [0] = { bootinit_nmgr_read, bootinit_nmgr_read }
+};
+
+struct nmgr_group bootinit_nmgr_group = {
+    .ng_handlers = (struct nmgr_handler *)bootinit_nmgr_handler,
+    .ng_handlers_count = 1,
+    .ng_group_id = NMGR_GROUP_ID_BOOTINIT
+};
+
+/*
+ * Response:
+ * {
+ *      "rc":0,
+ *      "ready":<usecs>,
+ *      "steps":[{"name":<name>, "start":<usecs>, "dur":<usecs>,
+ *                "def":<bool>}, ...]
+ * }
+ * Times are relative to the start of the first step. "ready" is missing
+ * until bootinit_ready() has been called, "dur" for steps which are still
+ * running.
+ */
+static int
+bootinit_nmgr_read(struct nmgr_jbuf *njb)
+{
+    struct bootinit_step bs;
+    struct json_encoder *enc;
+    struct json_value jv;
+    uint32_t base;
+    uint32_t ready;
+    int i;
+
+    enc = &njb->njb_enc;
+
+    base = 0;
+    if (bootinit_step_get(0, &bs) == 0) {
+        base = bs.bs_start;
+    }
+
+    json_encode_object_start(enc);
+    JSON_VALUE_INT(&jv, 0);
+    json_encode_object_entry(enc, "rc", &jv);
+
+    if (bootinit_ready_time(&ready) == 0) {
+        JSON_VALUE_UINT(&jv, cputime_ticks_to_usecs(ready - base));
+        json_encode_object_entry(enc, "ready", &jv);
+    }
+
+    json_encode_array_name(enc, "steps");
+    json_encode_array_start(enc);
+    for (i = 0; bootinit_step_get(i, &bs) == 0; i++) {
+        json_encode_object_start(enc);
+        JSON_VALUE_STRING(&jv, (char *)bs.bs_name);
+        json_encode_object_entry(enc, "name", &jv);
+        JSON_VALUE_UINT(&jv, cputime_ticks_to_usecs(bs.bs_start - base));
+        json_encode_object_entry(enc, "start", &jv);
+        if (bs.bs_done) {
+            JSON_VALUE_UINT(&jv,
+              cputime_ticks_to_usecs(bs.bs_end - bs.bs_start));
+            json_encode_object_entry(enc, "dur", &jv);
+        }
+        JSON_VALUE_BOOL(&jv, bs.bs_deferred);
+        json_encode_object_entry(enc, "def", &jv);
+        json_encode_object_finish(enc);
+    }
+    json_encode_array_finish(enc);
+
+    json_encode_object_finish(enc);
+
+    return 0;
+}
+
+#endif
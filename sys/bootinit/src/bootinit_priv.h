@@ -16,41 +16,11 @@
  * specific language governing permissions and limitations
  * under the License.
  */
-#ifdef NEWTMGR_PRESENT
-
-#include "config/config.h"
-#include "config_priv.h"
-
-#include <json/json.h>
-
-int
-conf_json_line(struct json_buffer *jb, char *name, int nlen, char *value,
-  int vlen)
-{
-    const struct json_attr_t val_attr[3] = {
-        [0] = {
-            .attribute = "name",
-            .type = t_string,
-            .addr.string = name,
-            .len = nlen
-        },
-        [1] = {
-            .attribute = "val",
-            .type = t_string,
-            .addr.string = value,
-            .len = vlen
-        },
-        [2] = {
-            .attribute = NULL
-        }
-    };
-    int rc;
-
-    rc = json_read_object(jb, val_attr);
-    if (rc) {
-        return rc;
-    }
-    return 0;
-}
+#ifndef __BOOTINIT_PRIV_H__
+#define __BOOTINIT_PRIV_H__
 
+#ifdef NEWTMGR_PRESENT
+extern struct nmgr_group bootinit_nmgr_group;
 #endif
+
+#endif /* __BOOTINIT_PRIV_H__ */
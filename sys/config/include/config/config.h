@@ -55,11 +55,15 @@ struct conf_handler {
     int (*ch_commit)(void);
     int (*ch_export)(void (*export_func)(char *name, char *val),
       enum conf_export_tgt tgt);
+    uint8_t ch_lazy;            /* Load values on first access */
+    uint8_t ch_dirty;           /* Set since last commit, internal */
+    uint8_t ch_loaded;          /* Lazy handler has been loaded, internal */
 };
 
 int conf_init(void);
 int conf_register(struct conf_handler *);
 int conf_load(void);
+int conf_load_handler(struct conf_handler *ch);
 
 int conf_save(void);
 int conf_save_one(const char *name, char *var);
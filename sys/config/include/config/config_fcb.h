@@ -21,9 +21,23 @@
 
 #include "config/config.h"
 
+/*
+ * Slot in hash table mapping config name to its latest entry in FCB.
+ */
+struct conf_fcb_idx {
+    uint32_t cfi_hash;
+    uint32_t cfi_root_hash;             /* Of first element of name */
+    struct flash_area *cfi_area;        /* NULL if slot is empty */
+    uint32_t cfi_data_off;
+    uint16_t cfi_data_len;
+};
+
 struct conf_fcb {
     struct conf_store cf_store;
     struct fcb cf_fcb;
+    struct conf_fcb_idx *cf_idx;        /* Optional, cf_idx_cnt entries */
+    uint16_t cf_idx_cnt;
+    uint8_t cf_idx_valid;
 };
 
 int conf_fcb_src(struct conf_fcb *fcb);
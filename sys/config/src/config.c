@@ -56,6 +56,11 @@ done:
 int
 conf_register(struct conf_handler *handler)
 {
+    /*
+     * First commit after registration goes to this handler.
+     */
+    handler->ch_dirty = 1;
+    handler->ch_loaded = 0;
     SLIST_INSERT_HEAD(&conf_handlers, handler, ch_list);
     return 0;
 }
@@ -76,6 +81,30 @@ conf_handler_lookup(char *name)
     return NULL;
 }
 
+/*
+ * Find conf_handler for the first element of a full variable name.
+ */
+struct conf_handler *
+conf_handler_lookup_root(const char *name)
+{
+    struct conf_handler *ch;
+    const char *sep;
+    int len;
+
+    sep = strchr(name, CONF_NAME_SEPARATOR[0]);
+    if (sep) {
+        len = sep - name;
+    } else {
+        len = strlen(name);
+    }
+    SLIST_FOREACH(ch, &conf_handlers, ch_list) {
+        if (!strncmp(name, ch->ch_name, len) && ch->ch_name[len] == '\0') {
+            return ch;
+        }
+    }
+    return NULL;
+}
+
 /*
  * Separate string into argv array.
  */
@@ -219,13 +248,19 @@ conf_set_value(char *name, char *val_str)
     int name_argc;
     char *name_argv[CONF_MAX_DIR_DEPTH];
     struct conf_handler *ch;
+    int rc;
 
     ch = conf_parse_and_lookup(name, &name_argc, name_argv);
     if (!ch) {
         return OS_INVALID_PARM;
     }
+    conf_handler_access(ch);
 
-    return ch->ch_set(name_argc - 1, &name_argv[1], val_str);
+    rc = ch->ch_set(name_argc - 1, &name_argv[1], val_str);
+    if (!rc) {
+        ch->ch_dirty = 1;
+    }
+    return rc;
 }
 
 /*
@@ -245,10 +280,16 @@ conf_get_value(char *name, char *buf, int buf_len)
     if (!ch) {
         return NULL;
     }
+    conf_handler_access(ch);
 
     return ch->ch_get(name_argc - 1, &name_argv[1], buf, buf_len);
 }
 
+/*
+ * Commit named handler, or with name NULL, all handlers which have had
+ * values set since their last commit. Lazy handlers which have not been
+ * loaded yet get committed when they are.
+ */
 int
 conf_commit(char *name)
 {
@@ -263,6 +304,8 @@ conf_commit(char *name)
         if (!ch) {
             return OS_INVALID_PARM;
         }
+        conf_handler_access(ch);
+        ch->ch_dirty = 0;
         if (ch->ch_commit) {
             return ch->ch_commit();
         } else {
@@ -271,6 +314,10 @@ conf_commit(char *name)
     } else {
         rc = 0;
         SLIST_FOREACH(ch, &conf_handlers, ch_list) {
+            if (!ch->ch_dirty || (ch->ch_lazy && !ch->ch_loaded)) {
+                continue;
+            }
+            ch->ch_dirty = 0;
             if (ch->ch_commit) {
                 rc2 = ch->ch_commit();
                 if (!rc) {
@@ -47,6 +47,7 @@ conf_dump_running(void)
     struct conf_handler *ch;
 
     SLIST_FOREACH(ch, &conf_handlers, ch_list) {
+        conf_handler_access(ch);
         if (ch->ch_export) {
             ch->ch_export(conf_running_one, CONF_EXPORT_SHOW);
         }
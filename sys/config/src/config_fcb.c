@@ -29,20 +29,25 @@
 #define CONF_FCB_MAGIC		0xc0ffeeee
 #define CONF_FCB_VERS		1
 
-struct conf_fcb_load_cb_arg {
-    load_cb cb;
-    void *cb_arg;
-};
+#define CONF_FCB_RD_BUF_SZ	128
 
 static int conf_fcb_load(struct conf_store *, load_cb cb, void *cb_arg);
+static int conf_fcb_lookup(struct conf_store *, const char *name, load_cb cb,
+  void *cb_arg);
+static int conf_fcb_load_subtree(struct conf_store *, const char *root,
+  load_cb cb, void *cb_arg);
 static int conf_fcb_save(struct conf_store *, const char *name,
   const char *value);
 
 static struct conf_store_itf conf_fcb_itf = {
     .csi_load = conf_fcb_load,
+    .csi_lookup = conf_fcb_lookup,
+    .csi_load_subtree = conf_fcb_load_subtree,
     .csi_save = conf_fcb_save,
 };
 
+static void conf_fcb_idx_build(struct conf_fcb *cf);
+
 int
 conf_fcb_src(struct conf_fcb *cf)
 {
@@ -70,6 +75,8 @@ conf_fcb_src(struct conf_fcb *cf)
         }
     }
 
+    conf_fcb_idx_build(cf);
+
     cf->cf_store.cs_itf = &conf_fcb_itf;
     conf_src_register(&cf->cf_store);
 
@@ -86,64 +93,242 @@ conf_fcb_dst(struct conf_fcb *cf)
 }
 
 static int
-conf_fcb_load_cb(struct fcb_entry *loc, void *arg)
+conf_fcb_load(struct conf_store *cs, load_cb cb, void *cb_arg)
 {
-    struct conf_fcb_load_cb_arg *argp;
+    struct conf_fcb *cf = (struct conf_fcb *)cs;
+    struct fcb_cursor cur;
+    uint8_t rd_buf[CONF_FCB_RD_BUF_SZ];
     char buf[CONF_MAX_NAME_LEN + CONF_MAX_VAL_LEN + 32];
     char *name_str;
     char *val_str;
     int rc;
     int len;
 
-    argp = (struct conf_fcb_load_cb_arg *)arg;
+    fcb_cursor_init(&cur, NULL, rd_buf, sizeof(rd_buf), 0);
+    while ((rc = fcb_cursor_next(&cf->cf_fcb, &cur)) == 0) {
+        len = fcb_cursor_read(&cur, 0, buf, sizeof(buf) - 1);
+        if (len < 0) {
+            continue;
+        }
 
-    len = loc->fe_data_len;
-    if (len >= sizeof(buf)) {
-        len = sizeof(buf) - 1;
+        rc = conf_rec_parse(buf, len, &name_str, &val_str);
+        if (rc) {
+            continue;
+        }
+        cb(name_str, val_str, cb_arg);
+    }
+    if (rc != FCB_ERR_NOVAR) {
+        return OS_EINVAL;
     }
+    return OS_OK;
+}
+
+static int
+conf_fcb_var_read(struct fcb_entry *loc, char *buf, char **name, char **val)
+{
+    int rc;
 
-    rc = flash_area_read(loc->fe_area, loc->fe_data_off, buf, len);
+    rc = flash_area_read(loc->fe_area, loc->fe_data_off, buf, loc->fe_data_len);
     if (rc) {
-        return 0;
+        return rc;
     }
-    buf[len] = '\0';
+    rc = conf_rec_parse(buf, loc->fe_data_len, name, val);
+    return rc;
+}
 
-    rc = conf_line_parse(buf, &name_str, &val_str);
-    if (rc) {
-        return 0;
+static uint32_t
+conf_fcb_hash(const char *name)
+{
+    uint32_t hash;
+
+    hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
     }
-    argp->cb(name_str, val_str, argp->cb_arg);
-    return 0;
+    return hash;
 }
 
+/*
+ * Hash of the first element of name.
+ */
+static uint32_t
+conf_fcb_root_hash(const char *name)
+{
+    uint32_t hash;
+
+    hash = 2166136261u;
+    while (*name && *name != CONF_NAME_SEPARATOR[0]) {
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+static void
+conf_fcb_idx_loc(struct conf_fcb_idx *cfi, struct fcb_entry *loc)
+{
+    loc->fe_area = cfi->cfi_area;
+    loc->fe_data_off = cfi->cfi_data_off;
+    loc->fe_data_len = cfi->cfi_data_len;
+}
+
+/*
+ * Finds the index slot for name. Returns 0 if name is in the index, and
+ * OS_ENOENT if not. In the latter case, *slot is set to the empty slot where
+ * name should go, or -1 if the table is full.
+ */
 static int
-conf_fcb_load(struct conf_store *cs, load_cb cb, void *cb_arg)
+conf_fcb_idx_find(struct conf_fcb *cf, const char *name, uint32_t hash,
+  int *slot)
+{
+    struct conf_fcb_idx *cfi;
+    struct fcb_entry loc;
+    char buf[CONF_MAX_NAME_LEN + CONF_MAX_VAL_LEN + 32];
+    char *name2, *val2;
+    int idx;
+    int i;
+
+    *slot = -1;
+    for (i = 0; i < cf->cf_idx_cnt; i++) {
+        idx = (hash + i) % cf->cf_idx_cnt;
+        cfi = &cf->cf_idx[idx];
+        if (!cfi->cfi_area) {
+            *slot = idx;
+            return OS_ENOENT;
+        }
+        if (cfi->cfi_hash != hash) {
+            continue;
+        }
+        conf_fcb_idx_loc(cfi, &loc);
+        if (conf_fcb_var_read(&loc, buf, &name2, &val2)) {
+            continue;
+        }
+        if (!strcmp(name, name2)) {
+            *slot = idx;
+            return 0;
+        }
+    }
+    return OS_ENOENT;
+}
+
+/*
+ * Records loc as the latest entry for name. If the table fills up, the
+ * index is disabled.
+ */
+static void
+conf_fcb_idx_set(struct conf_fcb *cf, const char *name,
+  struct fcb_entry *loc)
+{
+    struct conf_fcb_idx *cfi;
+    uint32_t hash;
+    int slot;
+
+    if (!cf->cf_idx_valid) {
+        return;
+    }
+    hash = conf_fcb_hash(name);
+    conf_fcb_idx_find(cf, name, hash, &slot);
+    if (slot < 0) {
+        cf->cf_idx_valid = 0;
+        return;
+    }
+    cfi = &cf->cf_idx[slot];
+    cfi->cfi_hash = hash;
+    cfi->cfi_root_hash = conf_fcb_root_hash(name);
+    cfi->cfi_area = loc->fe_area;
+    cfi->cfi_data_off = loc->fe_data_off;
+    cfi->cfi_data_len = loc->fe_data_len;
+}
+
+static void
+conf_fcb_idx_build(struct conf_fcb *cf)
+{
+    struct fcb_entry loc;
+    char buf[CONF_MAX_NAME_LEN + CONF_MAX_VAL_LEN + 32];
+    char *name, *val;
+
+    cf->cf_idx_valid = 0;
+    if (!cf->cf_idx || !cf->cf_idx_cnt) {
+        return;
+    }
+    memset(cf->cf_idx, 0, cf->cf_idx_cnt * sizeof(cf->cf_idx[0]));
+    cf->cf_idx_valid = 1;
+
+    loc.fe_area = NULL;
+    loc.fe_elem_off = 0;
+    while (cf->cf_idx_valid && fcb_getnext(&cf->cf_fcb, &loc) == 0) {
+        if (conf_fcb_var_read(&loc, buf, &name, &val)) {
+            continue;
+        }
+        conf_fcb_idx_set(cf, name, &loc);
+    }
+}
+
+/*
+ * Calls cb with the latest value of name. Returns non-zero if the index
+ * cannot be used, and the caller has to scan the whole FCB instead.
+ */
+static int
+conf_fcb_lookup(struct conf_store *cs, const char *name, load_cb cb,
+  void *cb_arg)
 {
     struct conf_fcb *cf = (struct conf_fcb *)cs;
-    struct conf_fcb_load_cb_arg arg;
-    int rc;
+    struct fcb_entry loc;
+    char buf[CONF_MAX_NAME_LEN + CONF_MAX_VAL_LEN + 32];
+    char *name2, *val2;
+    int slot;
 
-    arg.cb = cb;
-    arg.cb_arg = cb_arg;
-    rc = fcb_walk(&cf->cf_fcb, 0, conf_fcb_load_cb, &arg);
-    if (rc) {
+    if (!cf->cf_idx_valid) {
         return OS_EINVAL;
     }
-    return OS_OK;
+    if (conf_fcb_idx_find(cf, name, conf_fcb_hash(name), &slot)) {
+        return 0;
+    }
+    conf_fcb_idx_loc(&cf->cf_idx[slot], &loc);
+    if (conf_fcb_var_read(&loc, buf, &name2, &val2)) {
+        return OS_EINVAL;
+    }
+    cb(name2, val2, cb_arg);
+    return 0;
 }
 
+/*
+ * Calls cb with the latest values of all names under root, reading only
+ * those entries from flash. Returns non-zero if the index cannot be used.
+ */
 static int
-conf_fcb_var_read(struct fcb_entry *loc, char *buf, char **name, char **val)
+conf_fcb_load_subtree(struct conf_store *cs, const char *root, load_cb cb,
+  void *cb_arg)
 {
-    int rc;
+    struct conf_fcb *cf = (struct conf_fcb *)cs;
+    struct conf_fcb_idx *cfi;
+    struct fcb_entry loc;
+    char buf[CONF_MAX_NAME_LEN + CONF_MAX_VAL_LEN + 32];
+    char *name, *val;
+    uint32_t hash;
+    int len;
+    int i;
 
-    rc = flash_area_read(loc->fe_area, loc->fe_data_off, buf, loc->fe_data_len);
-    if (rc) {
-        return rc;
+    if (!cf->cf_idx_valid) {
+        return OS_EINVAL;
     }
-    buf[loc->fe_data_len] = '\0';
-    rc = conf_line_parse(buf, name, val);
-    return rc;
+    hash = conf_fcb_root_hash(root);
+    len = strlen(root);
+    for (i = 0; i < cf->cf_idx_cnt; i++) {
+        cfi = &cf->cf_idx[i];
+        if (!cfi->cfi_area || cfi->cfi_root_hash != hash) {
+            continue;
+        }
+        conf_fcb_idx_loc(cfi, &loc);
+        if (conf_fcb_var_read(&loc, buf, &name, &val)) {
+            return OS_EINVAL;
+        }
+        if (strncmp(name, root, len) ||
+          (name[len] != '\0' && name[len] != CONF_NAME_SEPARATOR[0])) {
+            continue;
+        }
+        cb(name, val, cb_arg);
+    }
+    return 0;
 }
 
 static void
@@ -157,6 +342,7 @@ conf_fcb_compress(struct conf_fcb *cf)
     char *name1, *val1;
     char *name2, *val2;
     int copy;
+    int slot;
 
     rc = fcb_append_to_scratch(&cf->cf_fcb);
     if (rc) {
@@ -173,16 +359,29 @@ conf_fcb_compress(struct conf_fcb *cf)
         if (rc) {
             continue;
         }
-        loc2 = loc1;
         copy = 1;
-        while (fcb_getnext(&cf->cf_fcb, &loc2) == 0) {
-            rc = conf_fcb_var_read(&loc2, buf2, &name2, &val2);
-            if (rc) {
-                continue;
-            }
-            if (!strcmp(name1, name2)) {
+        slot = -1;
+        if (cf->cf_idx_valid) {
+            /*
+             * Index tells whether a newer entry exists.
+             */
+            if (conf_fcb_idx_find(cf, name1, conf_fcb_hash(name1), &slot)) {
+                slot = -1;
+            } else if (cf->cf_idx[slot].cfi_area != loc1.fe_area ||
+              cf->cf_idx[slot].cfi_data_off != loc1.fe_data_off) {
                 copy = 0;
-                break;
+            }
+        } else {
+            loc2 = loc1;
+            while (fcb_getnext(&cf->cf_fcb, &loc2) == 0) {
+                rc = conf_fcb_var_read(&loc2, buf2, &name2, &val2);
+                if (rc) {
+                    continue;
+                }
+                if (!strcmp(name1, name2)) {
+                    copy = 0;
+                    break;
+                }
             }
         }
         if (!copy) {
@@ -195,18 +394,26 @@ conf_fcb_compress(struct conf_fcb *cf)
         rc = flash_area_read(loc1.fe_area, loc1.fe_data_off, buf1,
           loc1.fe_data_len);
         if (rc) {
+            cf->cf_idx_valid = 0;
             continue;
         }
         rc = fcb_append(&cf->cf_fcb, loc1.fe_data_len, &loc2);
         if (rc) {
+            cf->cf_idx_valid = 0;
             continue;
         }
         rc = flash_area_write(loc2.fe_area, loc2.fe_data_off, buf1,
           loc1.fe_data_len);
         if (rc) {
+            fcb_append_abort(&cf->cf_fcb, &loc2);
+            cf->cf_idx_valid = 0;
             continue;
         }
         fcb_append_finish(&cf->cf_fcb, &loc2);
+        if (slot >= 0) {
+            cf->cf_idx[slot].cfi_area = loc2.fe_area;
+            cf->cf_idx[slot].cfi_data_off = loc2.fe_data_off;
+        }
     }
     rc = fcb_rotate(&cf->cf_fcb);
     if (rc) {
@@ -216,14 +423,14 @@ conf_fcb_compress(struct conf_fcb *cf)
 }
 
 static int
-conf_fcb_append(struct conf_fcb *cf, char *buf, int len)
+conf_fcb_append(struct conf_fcb *cf, char *buf, int len,
+  struct fcb_entry *loc)
 {
     int rc;
     int i;
-    struct fcb_entry loc;
 
     for (i = 0; i < 10; i++) {
-        rc = fcb_append(&cf->cf_fcb, len, &loc);
+        rc = fcb_append(&cf->cf_fcb, len, loc);
         if (rc != FCB_ERR_NOSPACE) {
             break;
         }
@@ -232,11 +439,12 @@ conf_fcb_append(struct conf_fcb *cf, char *buf, int len)
     if (rc) {
         return OS_EINVAL;
     }
-    rc = flash_area_write(loc.fe_area, loc.fe_data_off, buf, len);
+    rc = flash_area_write(loc->fe_area, loc->fe_data_off, buf, len);
     if (rc) {
+        fcb_append_abort(&cf->cf_fcb, loc);
         return OS_EINVAL;
     }
-    fcb_append_finish(&cf->cf_fcb, &loc);
+    fcb_append_finish(&cf->cf_fcb, loc);
     return OS_OK;
 }
 
@@ -245,17 +453,23 @@ conf_fcb_save(struct conf_store *cs, const char *name, const char *value)
 {
     struct conf_fcb *cf = (struct conf_fcb *)cs;
     char buf[CONF_MAX_NAME_LEN + CONF_MAX_VAL_LEN + 32];
+    struct fcb_entry loc;
     int len;
+    int rc;
 
     if (!name) {
         return OS_INVALID_PARM;
     }
 
-    len = conf_line_make(buf, sizeof(buf), name, value);
+    len = conf_rec_make(buf, sizeof(buf), name, value);
     if (len < 0 || len + 2 > sizeof(buf)) {
         return OS_INVALID_PARM;
     }
-    return conf_fcb_append(cf, buf, len);
+    rc = conf_fcb_append(cf, buf, len, &loc);
+    if (rc == 0) {
+        conf_fcb_idx_set(cf, name, &loc);
+    }
+    return rc;
 }
 
 #endif
@@ -97,3 +97,55 @@ conf_line_make(char *dst, int dlen, const char *name, const char *value)
 
     return off;
 }
+
+/*
+ * Binary record: type tag, name, NUL, value. Type is CONF_STRING, or
+ * CONF_NONE for a deleted value.
+ */
+int
+conf_rec_make(char *dst, int dlen, const char *name, const char *value)
+{
+    int nlen;
+    int vlen;
+
+    nlen = strlen(name);
+    if (value) {
+        vlen = strlen(value);
+    } else {
+        vlen = 0;
+    }
+    if (nlen + vlen + 2 > dlen) {
+        return -1;
+    }
+    dst[0] = vlen ? CONF_STRING : CONF_NONE;
+    memcpy(dst + 1, name, nlen + 1);
+    memcpy(dst + nlen + 2, value, vlen);
+
+    return nlen + vlen + 2;
+}
+
+/*
+ * Parses either a binary record or a text line. buf must have space for
+ * len + 1 bytes.
+ */
+int
+conf_rec_parse(char *buf, int len, char **namep, char **valp)
+{
+    char *cp;
+
+    buf[len] = '\0';
+    if (len < 1 || (buf[0] != CONF_STRING && buf[0] != CONF_NONE)) {
+        return conf_line_parse(buf, namep, valp);
+    }
+    cp = memchr(buf + 1, '\0', len - 1);
+    if (!cp || cp == buf + 1) {
+        return -1;
+    }
+    *namep = buf + 1;
+    if (buf[0] == CONF_NONE) {
+        *valp = NULL;
+    } else {
+        *valp = cp + 1;
+    }
+    return 0;
+}
@@ -79,15 +79,51 @@ conf_nmgr_read(struct nmgr_jbuf *njb)
     return 0;
 }
 
+/*
+ * Sets a value. For bulk updates, client can send "commit":false with all
+ * but the last write; the last one then commits changed handlers, and
+ * with "save":true, persists the configuration once.
+ */
 static int
 conf_nmgr_write(struct nmgr_jbuf *njb)
 {
     int rc;
     char name_str[CONF_MAX_NAME_LEN];
     char val_str[CONF_MAX_VAL_LEN];
+    bool do_commit;
+    bool do_save;
+
+    const struct json_attr_t attr[5] = {
+        [0] = {
+            .attribute = "name",
+            .type = t_string,
+            .addr.string = name_str,
+            .len = sizeof(name_str)
+        },
+        [1] = {
+            .attribute = "val",
+            .type = t_string,
+            .addr.string = val_str,
+            .len = sizeof(val_str)
+        },
+        [2] = {
+            .attribute = "commit",
+            .type = t_boolean,
+            .addr.boolean = &do_commit,
+            .dflt.boolean = true
+        },
+        [3] = {
+            .attribute = "save",
+            .type = t_boolean,
+            .addr.boolean = &do_save,
+            .dflt.boolean = false
+        },
+        [4] = {
+            .attribute = NULL
+        }
+    };
 
-    rc = conf_json_line(&njb->njb_buf, name_str, sizeof(name_str), val_str,
-      sizeof(val_str));
+    rc = json_read_object(&njb->njb_buf, attr);
     if (rc) {
         return OS_EINVAL;
     }
@@ -97,10 +133,19 @@ conf_nmgr_write(struct nmgr_jbuf *njb)
         return OS_EINVAL;
     }
 
+    if (!do_commit) {
+        return 0;
+    }
     rc = conf_commit(NULL);
     if (rc) {
         return OS_EINVAL;
     }
+    if (do_save) {
+        rc = conf_save();
+        if (rc) {
+            return OS_EINVAL;
+        }
+    }
     return 0;
 }
 
@@ -23,13 +23,11 @@
 int conf_cli_register(void);
 int conf_nmgr_register(void);
 
-struct json_buffer;
-int conf_json_line(struct json_buffer *jb, char *name, int nlen, char *value,
-  int vlen);
-
 int conf_line_parse(char *buf, char **namep, char **valp);
 int conf_line_make(char *dst, int dlen, const char *name, const char *val);
 int conf_line_make2(char *dst, int dlen, const char *name, const char *value);
+int conf_rec_make(char *dst, int dlen, const char *name, const char *val);
+int conf_rec_parse(char *buf, int len, char **namep, char **valp);
 
 /*
  * API for config storage.
@@ -37,12 +35,20 @@ int conf_line_make2(char *dst, int dlen, const char *name, const char *value);
 typedef void (*load_cb)(char *name, char *val, void *cb_arg);
 struct conf_store_itf {
     int (*csi_load)(struct conf_store *cs, load_cb cb, void *cb_arg);
+    /* Optional; calls cb only for the latest value of name. */
+    int (*csi_lookup)(struct conf_store *cs, const char *name, load_cb cb,
+      void *cb_arg);
+    /* Optional; calls cb for the latest values of names under root. */
+    int (*csi_load_subtree)(struct conf_store *cs, const char *root,
+      load_cb cb, void *cb_arg);
     int (*csi_save_start)(struct conf_store *cs);
     int (*csi_save)(struct conf_store *cs, const char *name, const char *value);
     int (*csi_save_end)(struct conf_store *cs);
 };
 
 void conf_src_register(struct conf_store *cs);
+struct conf_handler *conf_handler_lookup_root(const char *name);
+void conf_handler_access(struct conf_handler *ch);
 void conf_dst_register(struct conf_store *cs);
 
 SLIST_HEAD(conf_store_head, conf_store);
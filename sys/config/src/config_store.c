@@ -56,12 +56,64 @@ conf_dst_register(struct conf_store *cs)
     conf_save_dst = cs;
 }
 
+/*
+ * With cb_arg set, only values of that handler are applied. Otherwise values
+ * go to all handlers, except lazy ones which have not been accessed yet.
+ */
 static void
 conf_load_cb(char *name, char *val, void *cb_arg)
 {
+    struct conf_handler *ch;
+
+    ch = conf_handler_lookup_root(name);
+    if (!ch) {
+        return;
+    }
+    if (cb_arg) {
+        if (ch != cb_arg) {
+            return;
+        }
+    } else if (ch->ch_lazy && !ch->ch_loaded) {
+        return;
+    }
     conf_set_value(name, val);
 }
 
+/*
+ * Load values of handler ch from store cs, or with ch NULL, values of all
+ * handlers which are due to be loaded. Stores which can look up subtrees
+ * only read the entries asked for.
+ */
+static void
+conf_load_src(struct conf_store *cs, struct conf_handler *ch)
+{
+    const struct conf_store_itf *csi;
+    struct conf_handler *ch2;
+
+    csi = cs->cs_itf;
+    if (csi->csi_load_subtree) {
+        if (ch) {
+            if (!csi->csi_load_subtree(cs, ch->ch_name, conf_load_cb, ch)) {
+                return;
+            }
+        } else {
+            SLIST_FOREACH(ch2, &conf_handlers, ch_list) {
+                if (ch2->ch_lazy && !ch2->ch_loaded) {
+                    continue;
+                }
+                if (csi->csi_load_subtree(cs, ch2->ch_name, conf_load_cb,
+                    ch2)) {
+                    break;
+                }
+            }
+            if (!ch2) {
+                return;
+            }
+        }
+    }
+    csi->csi_load(cs, conf_load_cb, ch);
+}
+
 int
 conf_load(void)
 {
@@ -72,14 +124,44 @@ conf_load(void)
      *    load config
      *    apply config
      *    commit all
+     *
+     * Lazy handlers are left alone until they're accessed.
      */
 
     SLIST_FOREACH(cs, &conf_load_srcs, cs_next) {
-        cs->cs_itf->csi_load(cs, conf_load_cb, NULL);
+        conf_load_src(cs, NULL);
     }
     return conf_commit(NULL);
 }
 
+/*
+ * Load and commit values of a single handler. Called on first access of
+ * handlers which have ch_lazy set.
+ */
+int
+conf_load_handler(struct conf_handler *ch)
+{
+    struct conf_store *cs;
+
+    ch->ch_loaded = 1;
+    SLIST_FOREACH(cs, &conf_load_srcs, cs_next) {
+        conf_load_src(cs, ch);
+    }
+    ch->ch_dirty = 0;
+    if (ch->ch_commit) {
+        return ch->ch_commit();
+    }
+    return 0;
+}
+
+void
+conf_handler_access(struct conf_handler *ch)
+{
+    if (ch->ch_lazy && !ch->ch_loaded) {
+        conf_load_handler(ch);
+    }
+}
+
 static void
 conf_dup_check_cb(char *name, char *val, void *cb_arg)
 {
@@ -123,7 +205,10 @@ conf_save_one(const char *name, char *value)
     cdca.name = name;
     cdca.val = value;
     cdca.is_dup = 0;
-    cs->cs_itf->csi_load(cs, conf_dup_check_cb, &cdca);
+    if (!cs->cs_itf->csi_lookup ||
+      cs->cs_itf->csi_lookup(cs, name, conf_dup_check_cb, &cdca)) {
+        cs->cs_itf->csi_load(cs, conf_dup_check_cb, &cdca);
+    }
     if (cdca.is_dup == 1) {
         return 0;
     }
@@ -153,6 +238,13 @@ conf_save(void)
         return OS_ENOENT;
     }
 
+    /*
+     * Values not loaded yet would be overwritten by defaults.
+     */
+    SLIST_FOREACH(ch, &conf_handlers, ch_list) {
+        conf_handler_access(ch);
+    }
+
     if (cs->cs_itf->csi_save_start) {
         cs->cs_itf->csi_save_start(cs);
     }
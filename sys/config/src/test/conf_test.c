@@ -36,6 +36,9 @@ int c2_var_count = 1;
 static char val_string[64][CONF_MAX_VAL_LEN];
 
 static uint32_t val32;
+static uint32_t lazy_val;
+static int lazy_set_cnt;
+static int lazy_commit_cnt;
 
 static int test_get_called;
 static int test_set_called;
@@ -58,6 +61,12 @@ static char *c3_handle_get(int argc, char **argv, char *val,
 static int c3_handle_set(int argc, char **argv, char *val);
 static int c3_handle_export(void (*cb)(char *name, char *value),
   enum conf_export_tgt tgt);
+static char *c4_handle_get(int argc, char **argv, char *val,
+  int val_len_max);
+static int c4_handle_set(int argc, char **argv, char *val);
+static int c4_handle_commit(void);
+static int c4_handle_export(void (*cb)(char *name, char *value),
+  enum conf_export_tgt tgt);
 
 struct conf_handler config_test_handler = {
     .ch_name = "myfoo",
@@ -238,6 +247,59 @@ c3_handle_export(void (*cb)(char *name, char *value),
     return 0;
 }
 
+struct conf_handler c4_test_handler = {
+    .ch_name = "lazy",
+    .ch_get = c4_handle_get,
+    .ch_set = c4_handle_set,
+    .ch_commit = c4_handle_commit,
+    .ch_export = c4_handle_export,
+    .ch_lazy = 1
+};
+
+static char *
+c4_handle_get(int argc, char **argv, char *val, int val_len_max)
+{
+    if (argc == 1 && !strcmp(argv[0], "v")) {
+        return conf_str_from_value(CONF_INT32, &lazy_val, val, val_len_max);
+    }
+    return NULL;
+}
+
+static int
+c4_handle_set(int argc, char **argv, char *val)
+{
+    uint32_t newval;
+    int rc;
+
+    lazy_set_cnt++;
+    if (argc == 1 && !strcmp(argv[0], "v")) {
+        rc = CONF_VALUE_SET(val, CONF_INT32, newval);
+        TEST_ASSERT(rc == 0);
+        lazy_val = newval;
+        return 0;
+    }
+    return OS_ENOENT;
+}
+
+static int
+c4_handle_commit(void)
+{
+    lazy_commit_cnt++;
+    return 0;
+}
+
+static int
+c4_handle_export(void (*cb)(char *name, char *value),
+  enum conf_export_tgt tgt)
+{
+    char value[32];
+
+    conf_str_from_value(CONF_INT32, &lazy_val, value, sizeof(value));
+    cb("lazy/v", value);
+
+    return 0;
+}
+
 static void
 ctest_clear_call_state(void)
 {
@@ -385,6 +447,47 @@ TEST_CASE(config_test_commit)
     ctest_clear_call_state();
 }
 
+TEST_CASE(config_test_commit_dirty)
+{
+    char name[80];
+    int rc;
+
+    /*
+     * Nothing set since last commit.
+     */
+    rc = conf_commit(NULL);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(test_commit_called == 0);
+
+    strcpy(name, "myfoo/mybar");
+    rc = conf_set_value(name, "43");
+    TEST_ASSERT(rc == 0);
+    strcpy(name, "myfoo/mybar");
+    rc = conf_set_value(name, "42");
+    TEST_ASSERT(rc == 0);
+    ctest_clear_call_state();
+
+    rc = conf_commit(NULL);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(test_commit_called == 1);
+    ctest_clear_call_state();
+
+    rc = conf_commit(NULL);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(test_commit_called == 0);
+
+    /*
+     * Failed set does not mark handler dirty.
+     */
+    strcpy(name, "myfoo/bar");
+    rc = conf_set_value(name, "1");
+    TEST_ASSERT(rc != 0);
+    ctest_clear_call_state();
+    rc = conf_commit(NULL);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(test_commit_called == 0);
+}
+
 static const struct nffs_area_desc config_nffs[] = {
     { 0x00000000, 16 * 1024 },
     { 0x00004000, 16 * 1024 },
@@ -651,6 +754,7 @@ TEST_CASE(config_test_empty_fcb)
     config_wipe_srcs();
     config_wipe_fcb(fcb_areas, sizeof(fcb_areas) / sizeof(fcb_areas[0]));
 
+    memset(&cf, 0, sizeof(cf));
     cf.cf_fcb.f_sectors = fcb_areas;
     cf.cf_fcb.f_sector_cnt = sizeof(fcb_areas) / sizeof(fcb_areas[0]);
 
@@ -673,6 +777,7 @@ TEST_CASE(config_test_save_1_fcb)
 
     config_wipe_srcs();
 
+    memset(&cf, 0, sizeof(cf));
     cf.cf_fcb.f_sectors = fcb_areas;
     cf.cf_fcb.f_sector_cnt = sizeof(fcb_areas) / sizeof(fcb_areas[0]);
 
@@ -715,6 +820,7 @@ TEST_CASE(config_test_save_2_fcb)
 
     config_wipe_srcs();
 
+    memset(&cf, 0, sizeof(cf));
     cf.cf_fcb.f_sectors = fcb_areas;
     cf.cf_fcb.f_sector_cnt = sizeof(fcb_areas) / sizeof(fcb_areas[0]);
 
@@ -780,6 +886,7 @@ TEST_CASE(config_test_save_3_fcb)
     config_wipe_srcs();
     config_wipe_fcb(fcb_areas, sizeof(fcb_areas) / sizeof(fcb_areas[0]));
 
+    memset(&cf, 0, sizeof(cf));
     cf.cf_fcb.f_sectors = fcb_areas;
     cf.cf_fcb.f_sector_cnt = 4;
 
@@ -815,6 +922,7 @@ TEST_CASE(config_test_compress_reset)
     config_wipe_srcs();
     config_wipe_fcb(fcb_areas, sizeof(fcb_areas) / sizeof(fcb_areas[0]));
 
+    memset(&cf, 0, sizeof(cf));
     cf.cf_fcb.f_sectors = fcb_areas;
     cf.cf_fcb.f_sector_cnt = sizeof(fcb_areas) / sizeof(fcb_areas[0]);
 
@@ -880,6 +988,7 @@ TEST_CASE(config_test_save_one_fcb)
     config_wipe_srcs();
     config_wipe_fcb(fcb_areas, sizeof(fcb_areas) / sizeof(fcb_areas[0]));
 
+    memset(&cf, 0, sizeof(cf));
     cf.cf_fcb.f_sectors = fcb_areas;
     cf.cf_fcb.f_sector_cnt = sizeof(fcb_areas) / sizeof(fcb_areas[0]);
 
@@ -908,6 +1017,240 @@ TEST_CASE(config_test_save_one_fcb)
     TEST_ASSERT(val8 == 44);
 }
 
+TEST_CASE(config_test_save_idx_fcb)
+{
+    int rc;
+    struct conf_fcb cf;
+    struct conf_fcb_idx idx[80];
+    struct fcb_entry loc;
+    char test_value[64][CONF_MAX_VAL_LEN];
+    int i;
+
+    config_wipe_srcs();
+    config_wipe_fcb(fcb_areas, sizeof(fcb_areas) / sizeof(fcb_areas[0]));
+
+    memset(&cf, 0, sizeof(cf));
+    cf.cf_fcb.f_sectors = fcb_areas;
+    cf.cf_fcb.f_sector_cnt = sizeof(fcb_areas) / sizeof(fcb_areas[0]);
+    cf.cf_idx = idx;
+    cf.cf_idx_cnt = sizeof(idx) / sizeof(idx[0]);
+
+    rc = conf_fcb_src(&cf);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cf.cf_idx_valid == 1);
+
+    rc = conf_fcb_dst(&cf);
+    TEST_ASSERT(rc == 0);
+
+    /*
+     * Enough saves to force compression several times.
+     */
+    c2_var_count = 64;
+    for (i = 0; i < 32; i++) {
+        config_test_fill_area(test_value, i);
+        memcpy(val_string, test_value, sizeof(val_string));
+
+        rc = conf_save();
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(cf.cf_idx_valid == 1);
+
+        memset(val_string, 0, sizeof(val_string));
+        rc = conf_load();
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(!memcmp(val_string, test_value, sizeof(val_string)));
+    }
+
+    /*
+     * Unchanged values are not written again.
+     */
+    loc = cf.cf_fcb.f_active;
+    rc = conf_save();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(loc.fe_area == cf.cf_fcb.f_active.fe_area);
+    TEST_ASSERT(loc.fe_elem_off == cf.cf_fcb.f_active.fe_elem_off);
+
+    /*
+     * Index is rebuilt from flash.
+     */
+    config_wipe_srcs();
+    cf.cf_idx_valid = 0;
+    rc = conf_fcb_src(&cf);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cf.cf_idx_valid == 1);
+    rc = conf_fcb_dst(&cf);
+    TEST_ASSERT(rc == 0);
+
+    rc = conf_save();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(loc.fe_elem_off == cf.cf_fcb.f_active.fe_elem_off);
+
+    /*
+     * Too small a table disables the index, and saving still works.
+     */
+    config_wipe_srcs();
+    cf.cf_idx_cnt = 8;
+    rc = conf_fcb_src(&cf);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cf.cf_idx_valid == 0);
+    rc = conf_fcb_dst(&cf);
+    TEST_ASSERT(rc == 0);
+
+    config_test_fill_area(test_value, 33);
+    memcpy(val_string, test_value, sizeof(val_string));
+    rc = conf_save();
+    TEST_ASSERT(rc == 0);
+
+    memset(val_string, 0, sizeof(val_string));
+    rc = conf_load();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(!memcmp(val_string, test_value, sizeof(val_string)));
+
+    c2_var_count = 0;
+}
+
+TEST_CASE(config_test_fcb_rec_format)
+{
+    int rc;
+    struct conf_fcb cf;
+    struct fcb_entry loc;
+    char buf[32];
+    static char text_rec[] = "myfoo/mybar=17";
+
+    config_wipe_srcs();
+    config_wipe_fcb(fcb_areas, sizeof(fcb_areas) / sizeof(fcb_areas[0]));
+
+    memset(&cf, 0, sizeof(cf));
+    cf.cf_fcb.f_sectors = fcb_areas;
+    cf.cf_fcb.f_sector_cnt = sizeof(fcb_areas) / sizeof(fcb_areas[0]);
+
+    rc = conf_fcb_src(&cf);
+    TEST_ASSERT(rc == 0);
+    rc = conf_fcb_dst(&cf);
+    TEST_ASSERT(rc == 0);
+
+    /*
+     * Text records written by older versions still load.
+     */
+    rc = fcb_append(&cf.cf_fcb, sizeof(text_rec) - 1, &loc);
+    TEST_ASSERT(rc == 0);
+    rc = flash_area_write(loc.fe_area, loc.fe_data_off, text_rec,
+      sizeof(text_rec) - 1);
+    TEST_ASSERT(rc == 0);
+    rc = fcb_append_finish(&cf.cf_fcb, &loc);
+    TEST_ASSERT(rc == 0);
+
+    val8 = 0;
+    rc = conf_load();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(val8 == 17);
+
+    /*
+     * New values are stored as binary records.
+     */
+    rc = conf_save_one("myfoo/mybar", "18");
+    TEST_ASSERT(rc == 0);
+
+    memset(&loc, 0, sizeof(loc));
+    rc = fcb_getnext(&cf.cf_fcb, &loc);
+    TEST_ASSERT(rc == 0);
+    rc = fcb_getnext(&cf.cf_fcb, &loc);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(loc.fe_data_len == sizeof("myfoo/mybar") + 3);
+    rc = flash_area_read(loc.fe_area, loc.fe_data_off, buf, loc.fe_data_len);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(buf[0] == CONF_STRING);
+    TEST_ASSERT(!strcmp(buf + 1, "myfoo/mybar"));
+    TEST_ASSERT(!memcmp(buf + sizeof("myfoo/mybar") + 1, "18", 2));
+
+    val8 = 0;
+    rc = conf_load();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(val8 == 18);
+}
+
+TEST_CASE(config_test_lazy_fcb)
+{
+    int rc;
+    struct conf_fcb cf;
+    struct conf_fcb_idx idx[16];
+    char name[16];
+    char buf[16];
+    char *str;
+
+    config_wipe_srcs();
+    config_wipe_fcb(fcb_areas, sizeof(fcb_areas) / sizeof(fcb_areas[0]));
+
+    memset(&cf, 0, sizeof(cf));
+    cf.cf_fcb.f_sectors = fcb_areas;
+    cf.cf_fcb.f_sector_cnt = sizeof(fcb_areas) / sizeof(fcb_areas[0]);
+    cf.cf_idx = idx;
+    cf.cf_idx_cnt = sizeof(idx) / sizeof(idx[0]);
+
+    rc = conf_fcb_src(&cf);
+    TEST_ASSERT(rc == 0);
+    rc = conf_fcb_dst(&cf);
+    TEST_ASSERT(rc == 0);
+
+    rc = conf_register(&c4_test_handler);
+    TEST_ASSERT(rc == 0);
+
+    rc = conf_save_one("lazy/v", "5");
+    TEST_ASSERT(rc == 0);
+    rc = conf_save_one("myfoo/mybar", "7");
+    TEST_ASSERT(rc == 0);
+    rc = conf_save_one("lazy/v", "6");
+    TEST_ASSERT(rc == 0);
+
+    /*
+     * Lazy handler is not touched at load.
+     */
+    val8 = 0;
+    rc = conf_load();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(val8 == 7);
+    TEST_ASSERT(lazy_set_cnt == 0);
+    TEST_ASSERT(lazy_commit_cnt == 0);
+
+    /*
+     * First access loads and commits it, using the index for the latest
+     * value only.
+     */
+    strcpy(name, "lazy/v");
+    str = conf_get_value(name, buf, sizeof(buf));
+    TEST_ASSERT(str && !strcmp(str, "6"));
+    TEST_ASSERT(lazy_set_cnt == 1);
+    TEST_ASSERT(lazy_commit_cnt == 1);
+
+    strcpy(name, "lazy/v");
+    str = conf_get_value(name, buf, sizeof(buf));
+    TEST_ASSERT(str && !strcmp(str, "6"));
+    TEST_ASSERT(lazy_set_cnt == 1);
+
+    /*
+     * Without the index, all entries are read. Saving loads the handler
+     * first, so the stored value is kept.
+     */
+    config_wipe_srcs();
+    cf.cf_idx = NULL;
+    cf.cf_idx_cnt = 0;
+    rc = conf_fcb_src(&cf);
+    TEST_ASSERT(rc == 0);
+    rc = conf_fcb_dst(&cf);
+    TEST_ASSERT(rc == 0);
+
+    c4_test_handler.ch_loaded = 0;
+    lazy_val = 0;
+    lazy_set_cnt = 0;
+    rc = conf_save();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(lazy_val == 6);
+    TEST_ASSERT(lazy_set_cnt == 2);
+
+    strcpy(name, "lazy/v");
+    str = conf_get_value(name, buf, sizeof(buf));
+    TEST_ASSERT(str && !strcmp(str, "6"));
+}
+
 TEST_SUITE(config_test_all)
 {
     /*
@@ -920,6 +1263,7 @@ TEST_SUITE(config_test_all)
     config_test_getset_bytes();
 
     config_test_commit();
+    config_test_commit_dirty();
 
     /*
      * NFFS as backing storage.
@@ -949,5 +1293,11 @@ TEST_SUITE(config_test_all)
     config_test_compress_reset();
 
     config_test_save_one_fcb();
+
+    config_test_save_idx_fcb();
+
+    config_test_fcb_rec_format();
+
+    config_test_lazy_fcb();
 }
 
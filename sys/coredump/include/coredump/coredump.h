@@ -25,6 +25,7 @@ extern "C" {
 #endif
 
 #include <inttypes.h>
+#include <os/queue.h>
 
 #define COREDUMP_MAGIC              0x690c47c3
 
@@ -34,6 +35,14 @@ extern "C" {
 #define COREDUMP_TLV_IMAGE          1   /* SHA256 of image creating this */
 #define COREDUMP_TLV_MEM            2   /* Memory dump */
 #define COREDUMP_TLV_REGS           3   /* CPU registers */
+#define COREDUMP_TLV_MEM_RLE        4   /* Memory dump, run-length encoded */
+
+/*
+ * COREDUMP_TLV_MEM_RLE data is a sequence of control bytes, each followed
+ * by 32-bit words. Control byte n < 128 is followed by n + 1 words to copy
+ * as is; n >= 128 by one word which repeats n - 126 times.
+ */
+#define COREDUMP_RLE_REPEAT         0x80
 
 struct coredump_tlv {
     uint8_t ct_type;
@@ -50,8 +59,29 @@ struct coredump_header {
     uint32_t ch_size;                   /* Size of everything */
 };
 
+/*
+ * Memory region to include in coredump.
+ */
+struct coredump_region {
+    SLIST_ENTRY(coredump_region) cr_next;
+    void *cr_start;
+    uint32_t cr_size;
+};
+
 void coredump_dump(void *regs, int regs_sz);
 
+/*
+ * Add a region to dump. If any regions are registered, or
+ * coredump_task_stacks is set, only those are dumped instead of all of
+ * the memory BSP lists.
+ */
+int coredump_region_add(struct coredump_region *cr);
+
+/*
+ * Set this to non-zero to include stacks of all tasks.
+ */
+extern uint8_t coredump_task_stacks;
+
 /*
  * Set this to non-zero to prevent coredump from taking place.
  */
@@ -17,6 +17,7 @@
  * under the License.
  */
 #include <limits.h>
+#include <os/os.h>
 #include <hal/hal_bsp.h>
 #include <hal/flash_map.h>
 #include <bootutil/image.h>
@@ -24,6 +25,22 @@
 #include <coredump/coredump.h>
 
 uint8_t coredump_disabled;
+uint8_t coredump_task_stacks;
+
+static SLIST_HEAD(, coredump_region) coredump_regions =
+    SLIST_HEAD_INITIALIZER(coredump_regions);
+
+/*
+ * Largest amount of memory put in one TLV.
+ */
+#define COREDUMP_MEM_CHUNK          (SHRT_MAX + 1)
+
+int
+coredump_region_add(struct coredump_region *cr)
+{
+    SLIST_INSERT_HEAD(&coredump_regions, cr, cr_next);
+    return 0;
+}
 
 static void
 dump_core_tlv(const struct flash_area *fa, uint32_t *off,
@@ -36,6 +53,94 @@ dump_core_tlv(const struct flash_area *fa, uint32_t *off,
     *off += tlv->ct_len;
 }
 
+#ifdef COREDUMP_RLE
+/*
+ * Run-length encode len bytes of word aligned memory at start to flash at
+ * *off, and return the number of bytes written. Data goes straight from
+ * memory to flash; literal runs are not copied.
+ */
+static uint32_t
+dump_core_rle(const struct flash_area *fa, uint32_t off, uint32_t *start,
+  uint32_t len)
+{
+    uint32_t *end;
+    uint32_t *p;
+    uint32_t *lit;
+    uint32_t orig;
+    uint8_t ctl;
+    int rpt;
+
+    orig = off;
+    end = start + len / sizeof(uint32_t);
+    p = start;
+    lit = start;
+    while (p < end) {
+        for (rpt = 1; p + rpt < end && rpt < 129 && p[rpt] == p[0]; rpt++);
+        if (rpt < 2 && p - lit < 128) {
+            p++;
+            if (p < end) {
+                continue;
+            }
+        }
+        if (p > lit) {
+            ctl = p - lit - 1;
+            flash_area_write(fa, off, &ctl, sizeof(ctl));
+            off += sizeof(ctl);
+            flash_area_write(fa, off, lit, (p - lit) * sizeof(uint32_t));
+            off += (p - lit) * sizeof(uint32_t);
+        }
+        if (rpt >= 2) {
+            ctl = COREDUMP_RLE_REPEAT + rpt - 2;
+            flash_area_write(fa, off, &ctl, sizeof(ctl));
+            off += sizeof(ctl);
+            flash_area_write(fa, off, p, sizeof(uint32_t));
+            off += sizeof(uint32_t);
+            p += rpt;
+        }
+        lit = p;
+    }
+    return off - orig;
+}
+#endif
+
+/*
+ * Dump a memory region, split into TLVs of at most COREDUMP_MEM_CHUNK bytes.
+ */
+static void
+dump_core_mem(const struct flash_area *fa, uint32_t *off, uint32_t area_off,
+  uint32_t area_sz)
+{
+    struct coredump_tlv tlv;
+    uint32_t area_end;
+    uint32_t len;
+
+    area_end = area_off + area_sz;
+    tlv._pad = 0;
+    while (area_off < area_end) {
+        len = min(area_end - area_off, COREDUMP_MEM_CHUNK);
+        tlv.ct_off = area_off;
+#ifdef COREDUMP_RLE
+        if ((area_off | len) % sizeof(uint32_t) == 0) {
+            /*
+             * Encoded size is not known until done, so TLV header is
+             * written after data.
+             */
+            tlv.ct_type = COREDUMP_TLV_MEM_RLE;
+            tlv.ct_len = dump_core_rle(fa, *off + sizeof(tlv),
+              (uint32_t *)area_off, len);
+            flash_area_write(fa, *off, &tlv, sizeof(tlv));
+            *off += sizeof(tlv) + tlv.ct_len;
+            area_off += len;
+            continue;
+        }
+#endif
+        tlv.ct_type = COREDUMP_TLV_MEM;
+        tlv.ct_len = len;
+        dump_core_tlv(fa, off, &tlv, (void *)area_off);
+        area_off += len;
+    }
+}
+
 void
 coredump_dump(void *regs, int regs_sz)
 {
@@ -43,11 +148,13 @@ coredump_dump(void *regs, int regs_sz)
     struct coredump_tlv tlv;
     const struct flash_area *fa;
     struct image_version ver;
-    const struct bsp_mem_dump *mem, *cur;
+    const struct bsp_mem_dump *mem;
+    struct coredump_region *cr;
+    struct os_task_info oti;
+    struct os_task *t;
     int area_cnt, i;
     uint8_t hash[IMGMGR_HASH_LEN];
     uint32_t off;
-    uint32_t area_off, area_end;
 
     if (coredump_disabled) {
         return;
@@ -88,21 +195,23 @@ coredump_dump(void *regs, int regs_sz)
         dump_core_tlv(fa, &off, &tlv, hash);
     }
 
-    mem = bsp_core_dump(&area_cnt);
-    for (i = 0; i < area_cnt; i++) {
-        cur = &mem[i];
-        area_off = (uint32_t)cur->bmd_start;
-        area_end = area_off + cur->bmd_size;
-        while (area_off < area_end) {
-            tlv.ct_type = COREDUMP_TLV_MEM;
-            if (cur->bmd_size > USHRT_MAX) {
-                tlv.ct_len = SHRT_MAX + 1;
-            } else {
-                tlv.ct_len = cur->bmd_size;
+    if (coredump_task_stacks || !SLIST_EMPTY(&coredump_regions)) {
+        if (coredump_task_stacks) {
+            t = NULL;
+            while ((t = os_task_info_get_next(t, &oti)) != NULL) {
+                dump_core_mem(fa, &off,
+                  (uint32_t)(t->t_stacktop - t->t_stacksize),
+                  t->t_stacksize * sizeof(os_stack_t));
             }
-            tlv.ct_off = area_off;
-            dump_core_tlv(fa, &off, &tlv, (void *)area_off);
-            area_off += tlv.ct_len;
+        }
+        SLIST_FOREACH(cr, &coredump_regions, cr_next) {
+            dump_core_mem(fa, &off, (uint32_t)cr->cr_start, cr->cr_size);
+        }
+    } else {
+        mem = bsp_core_dump(&area_cnt);
+        for (i = 0; i < area_cnt; i++) {
+            dump_core_mem(fa, &off, (uint32_t)mem[i].bmd_start,
+              mem[i].bmd_size);
         }
     }
     hdr.ch_magic = COREDUMP_MAGIC;
@@ -28,6 +28,8 @@
 #include <hal/flash_map.h>
 
 #include <os/os_mutex.h>
+#include <os/os_eventq.h>
+#include <os/os_callout.h>
 
 #define FCB_MAX_LEN	(CHAR_MAX | CHAR_MAX << 7) /* Max length of element */
 
@@ -42,6 +44,30 @@ struct fcb_entry {
     uint16_t fe_data_len;	/* size of data area */
 };
 
+/*
+ * Optional per-sector summary, kept in RAM. fsi_key holds the leading
+ * bytes of the first entry's data (e.g. a timestamp); unused bytes are 0xff.
+ */
+#define FCB_SECTOR_KEY_LEN	8
+
+struct fcb_sector_idx {
+    uint16_t fsi_cnt;		/* number of entries in sector */
+    uint8_t fsi_key[FCB_SECTOR_KEY_LEN];
+};
+
+/*
+ * Number of appends which can be in progress at the same time, i.e.
+ * reserved with fcb_append() but not yet finished.
+ */
+#ifndef FCB_MAX_PENDING
+#define FCB_MAX_PENDING		4
+#endif
+
+struct fcb_pending {
+    struct fcb_entry fp_loc;
+    uint8_t fp_state;
+};
+
 struct fcb {
     /* Caller of fcb_init fills this in */
     uint32_t f_magic;		/* As placed on the disk */
@@ -49,6 +75,7 @@ struct fcb {
     uint8_t f_sector_cnt;	/* Number of elements in sector array */
     uint8_t f_scratch_cnt;	/* How many sectors should be kept empty */
     struct flash_area *f_sectors; /* Array of sectors, must be contiguous */
+    struct fcb_sector_idx *f_sector_idx; /* Optional, f_sector_cnt entries */
 
     /* Flash circular buffer internal state */
     struct os_mutex f_mtx;	/* Locking for accessing the FCB data */
@@ -56,6 +83,13 @@ struct fcb {
     struct fcb_entry f_active;
     uint16_t f_active_id;
     uint8_t f_align;		/* writes to flash have to aligned to this */
+    uint8_t f_pend_first;	/* oldest reservation within f_pend */
+    uint8_t f_pend_cnt;		/* number of reservations in f_pend */
+    uint8_t f_spare_cnt;	/* erased sectors kept by fcb_bg_start() */
+    struct flash_area *f_erasing; /* sector fcb_rotate() is erasing */
+    SLIST_HEAD(, fcb_waiter) f_waiters; /* tasks in fcb_pend_wait() */
+    struct fcb_pending f_pend[FCB_MAX_PENDING];
+    struct os_callout_func f_bg_erase;
 };
 
 /*
@@ -69,6 +103,7 @@ struct fcb {
 #define FCB_ERR_NOMEM	-5
 #define FCB_ERR_CRC	-6
 #define FCB_ERR_MAGIC   -7
+#define FCB_ERR_BUSY	-8
 
 int fcb_init(struct fcb *fcb);
 
@@ -76,10 +111,18 @@ int fcb_init(struct fcb *fcb);
  * fcb_append() appends an entry to circular buffer. When writing the
  * contents for the entry, use loc->fl_area and loc->fl_data_off with
  * flash_area_write(). When you're finished, call fcb_append_finish() with
- * loc as argument.
+ * loc as argument. If the entry can't be written after all, call
+ * fcb_append_abort() instead; the entry is then skipped like a corrupt one.
+ *
+ * fcb_append() only reserves space for the entry, so several tasks can
+ * be writing their entries at the same time. Entries are committed in the
+ * order they were reserved: readers don't see an entry until it, and all
+ * entries reserved before it, have been finished or aborted. Up to
+ * FCB_MAX_PENDING entries can be in progress; further appends wait.
  */
 int fcb_append(struct fcb *, uint16_t len, struct fcb_entry *loc);
 int fcb_append_finish(struct fcb *, struct fcb_entry *append_loc);
+void fcb_append_abort(struct fcb *, struct fcb_entry *append_loc);
 
 /*
  * Walk over all log entries in FCB, or entries in a given flash_area.
@@ -94,10 +137,76 @@ int fcb_walk(struct fcb *, struct flash_area *, fcb_walk_cb cb, void *cb_arg);
 int fcb_getnext(struct fcb *, struct fcb_entry *loc);
 
 /*
- * Erases the data from oldest sector.
+ * Cursor for scanning many entries quickly. Flash is read into the caller's
+ * buffer a window at a time, and entry headers, data and CRCs are parsed out
+ * of it. The buffer should be a few times larger than a typical entry.
+ *
+ * fcb_cursor_next() returns 0 and fills in fc_entry with the next entry, or
+ * FCB_ERR_NOVAR once there are no more. If fap is given to
+ * fcb_cursor_init(), only entries within that area are reported.
+ * fcb_cursor_read() reads the current entry's data, and returns the
+ * number of bytes read.
+ *
+ * With FCB_CURSOR_F_NOCRC, entry CRCs are not checked; use it only when
+ * the contents are known to be good.
+ */
+struct fcb_cursor {
+    struct fcb_entry fc_entry;	/* current entry */
+    struct flash_area *fc_filter; /* area to restrict the walk to */
+    uint8_t *fc_buf;
+    uint16_t fc_buf_sz;
+    uint16_t fc_buf_len;	/* amount of valid data in fc_buf */
+    struct flash_area *fc_buf_area; /* area where fc_buf data is from */
+    uint32_t fc_buf_off;	/* offset of fc_buf[0] within that area */
+    uint8_t fc_flags;
+};
+
+#define FCB_CURSOR_F_NOCRC	0x01
+
+void fcb_cursor_init(struct fcb_cursor *, struct flash_area *fap,
+  uint8_t *buf, uint16_t buf_sz, uint8_t flags);
+int fcb_cursor_next(struct fcb *, struct fcb_cursor *);
+int fcb_cursor_read(struct fcb_cursor *, uint16_t off, void *dst,
+  uint16_t len);
+
+/*
+ * Seeking, using the sector index. Both position loc so that the following
+ * fcb_getnext() returns the desired entry; they return FCB_ERR_ARGS if the
+ * fcb has no sector index.
+ *
+ * fcb_seek_nth() positions before the n'th oldest entry; FCB_ERR_NOVAR if
+ * there are not that many.
+ *
+ * fcb_seek_key() positions at the start of the newest sector whose key
+ * compares lower than the target, or at the oldest entry if there is none.
+ * cmp returns <0, 0 or >0 as key is lower than, equal to or greater than
+ * the target. Keys must not decrease from one entry to the next for the
+ * result to be meaningful.
+ */
+typedef int (*fcb_key_cmp_func)(const uint8_t *key, void *arg);
+int fcb_seek_nth(struct fcb *, uint32_t n, struct fcb_entry *loc);
+int fcb_seek_key(struct fcb *, fcb_key_cmp_func cmp, void *arg,
+  struct fcb_entry *loc);
+
+/*
+ * Erases the data from oldest sector. If an append to that sector is still
+ * in progress, waits for it to finish; FCB_ERR_BUSY if the OS is not
+ * running. Unless the oldest sector is also the one being appended to,
+ * appends and reads can proceed while it is being erased.
  */
 int fcb_rotate(struct fcb *);
 
+/*
+ * Background erase. Keeps spare_cnt erased sectors on top of the scratch
+ * ones, so that appends find an erased sector when they move on, and
+ * don't need to wait for fcb_rotate(). Oldest sectors are erased as soon
+ * as the count drops, i.e. the data kept is spare_cnt sectors less. The
+ * erase runs from evq, so the task serving evq must dispatch callout
+ * functions. Call after fcb_init().
+ */
+int fcb_bg_start(struct fcb *, struct os_eventq *evq, uint8_t spare_cnt);
+void fcb_bg_stop(struct fcb *);
+
 /*
  * Start using the scratch block.
  */
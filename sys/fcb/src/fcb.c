@@ -79,6 +79,11 @@ fcb_init(struct fcb *fcb)
     fcb->f_active.fe_area = newest_fap;
     fcb->f_active.fe_elem_off = sizeof(struct fcb_disk_area);
     fcb->f_active_id = newest;
+    fcb->f_pend_first = 0;
+    fcb->f_pend_cnt = 0;
+    fcb->f_erasing = NULL;
+    fcb->f_spare_cnt = 0;
+    SLIST_INIT(&fcb->f_waiters);
 
     while (1) {
         rc = fcb_getnext_in_area(fcb, &fcb->f_active);
@@ -90,6 +95,9 @@ fcb_init(struct fcb *fcb)
             break;
         }
     }
+    if (rc == 0) {
+        rc = fcb_idx_build(fcb);
+    }
     os_mutex_init(&fcb->f_mtx);
     return rc;
 }
@@ -103,7 +111,7 @@ fcb_free_sector_cnt(struct fcb *fcb)
     fa = fcb->f_active.fe_area;
     for (i = 0; i < fcb->f_sector_cnt; i++) {
         fa = fcb_getnext_area(fcb, fa);
-        if (fa == fcb->f_oldest) {
+        if (fa == fcb->f_oldest || fa == fcb->f_erasing) {
             break;
         }
     }
@@ -172,6 +180,7 @@ fcb_sector_hdr_init(struct fcb *fcb, struct flash_area *fap, uint16_t id)
     if (rc) {
         return FCB_ERR_FLASH;
     }
+    fcb_idx_clear(fcb, fap);
     return 0;
 }
 
@@ -216,8 +225,39 @@ fcb_offset_last_n(struct fcb *fcb, uint8_t entries, uint32_t *last_n_off)
 {
     struct fcb_entry loc;
     struct fcb_entry start;
+    uint32_t total;
+    uint32_t keep;
     int i;
 
+    if (fcb->f_sector_idx) {
+        /*
+         * Count the entries using the index, and jump straight to the
+         * same entry the walk below would end up at.
+         */
+        total = 0;
+        for (i = 0; i < fcb->f_sector_cnt; i++) {
+            total += fcb->f_sector_idx[i].fsi_cnt;
+        }
+        if (total == 0) {
+            return 0;
+        }
+        keep = entries ? entries - 1 : 0;
+        if (total <= keep) {
+            total = 0;
+        } else if (keep == 0) {
+            *last_n_off = fcb->f_active.fe_elem_off;
+            return 0;
+        } else {
+            total -= keep;
+        }
+        memset(&loc, 0, sizeof(loc));
+        if (fcb_seek_nth(fcb, total, &loc) == 0 &&
+          fcb_getnext(fcb, &loc) == 0) {
+            *last_n_off = loc.fe_elem_off;
+        }
+        return 0;
+    }
+
     i = 0;
     memset(&loc, 0, sizeof(loc));
     while (!fcb_getnext(fcb, &loc)) {
@@ -18,6 +18,7 @@
  */
 #include <stddef.h>
 
+#include "os/os.h"
 #include "fcb/fcb.h"
 #include "fcb_priv.h"
 
@@ -36,7 +37,7 @@ fcb_new_area(struct fcb *fcb, int cnt)
         if (!rfa) {
             rfa = fa;
         }
-        if (fa == fcb->f_oldest) {
+        if (fa == fcb->f_oldest || fa == fcb->f_erasing) {
             return NULL;
         }
     } while (i++ < cnt);
@@ -66,9 +67,160 @@ fcb_append_to_scratch(struct fcb *fcb)
     return FCB_OK;
 }
 
+/*
+ * Whether loc is at or past the oldest entry still being written, i.e. not
+ * yet visible to readers.
+ */
+int
+fcb_is_pending(struct fcb *fcb, struct fcb_entry *loc)
+{
+    struct fcb_entry *first;
+    struct flash_area *fap;
+
+    if (!fcb->f_pend_cnt) {
+        return 0;
+    }
+    first = &fcb->f_pend[fcb->f_pend_first].fp_loc;
+    fap = first->fe_area;
+    if (loc->fe_area == fap) {
+        return loc->fe_elem_off >= first->fe_elem_off;
+    }
+    while (fap != fcb->f_active.fe_area) {
+        fap = fcb_getnext_area(fcb, fap);
+        if (fap == loc->fe_area) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Whether there are uncommitted entries within the area.
+ */
+int
+fcb_pend_in_area(struct fcb *fcb, struct flash_area *fap)
+{
+    struct fcb_pending *fp;
+    int i;
+
+    for (i = 0; i < fcb->f_pend_cnt; i++) {
+        fp = &fcb->f_pend[(fcb->f_pend_first + i) % FCB_MAX_PENDING];
+        if (fp->fp_loc.fe_area == fap) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Called with f_mtx held to wait for the writers of pending entries, or for
+ * a sector erase. The lock is dropped while waiting; fcb_pend_wake() ends
+ * the wait. Returns non-zero if there's no point in waiting, as the OS is
+ * not running.
+ */
+int
+fcb_pend_wait(struct fcb *fcb)
+{
+    struct fcb_waiter waiter;
+
+    if (!os_started()) {
+        return -1;
+    }
+    os_sem_init(&waiter.fw_sem, 0);
+    SLIST_INSERT_HEAD(&fcb->f_waiters, &waiter, fw_next);
+    os_mutex_release(&fcb->f_mtx);
+    os_sem_pend(&waiter.fw_sem, OS_WAIT_FOREVER);
+    os_mutex_pend(&fcb->f_mtx, OS_WAIT_FOREVER);
+    return 0;
+}
+
+/*
+ * Called with f_mtx held after a pending entry is finished or an erase
+ * completes. Every waiter is woken to recheck what it was waiting for.
+ */
+void
+fcb_pend_wake(struct fcb *fcb)
+{
+    struct fcb_waiter *waiter;
+
+    while ((waiter = SLIST_FIRST(&fcb->f_waiters)) != NULL) {
+        SLIST_REMOVE_HEAD(&fcb->f_waiters, fw_next);
+        os_sem_release(&waiter->fw_sem);
+    }
+}
+
+static struct fcb_pending *
+fcb_pend_find(struct fcb *fcb, struct fcb_entry *loc)
+{
+    struct fcb_pending *fp;
+    int i;
+
+    for (i = 0; i < fcb->f_pend_cnt; i++) {
+        fp = &fcb->f_pend[(fcb->f_pend_first + i) % FCB_MAX_PENDING];
+        if (fp->fp_loc.fe_area == loc->fe_area &&
+          fp->fp_loc.fe_elem_off == loc->fe_elem_off) {
+            return fp;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Commits entries which are no longer being written, up to the oldest
+ * one which still is.
+ */
+static int
+fcb_pend_commit(struct fcb *fcb)
+{
+    struct fcb_pending *fp;
+    int rc;
+    int rc2;
+
+    rc = 0;
+    while (fcb->f_pend_cnt) {
+        fp = &fcb->f_pend[fcb->f_pend_first];
+        if (fp->fp_state == FCB_PEND_WRITING) {
+            break;
+        }
+        if (fp->fp_state == FCB_PEND_DONE) {
+            rc2 = fcb_idx_add(fcb, &fp->fp_loc);
+            if (!rc) {
+                rc = rc2;
+            }
+        }
+        fcb->f_pend_first = (fcb->f_pend_first + 1) % FCB_MAX_PENDING;
+        fcb->f_pend_cnt--;
+    }
+    return rc;
+}
+
+static int
+fcb_pend_end(struct fcb *fcb, struct fcb_entry *loc, uint8_t state)
+{
+    struct fcb_pending *fp;
+    int rc;
+
+    rc = os_mutex_pend(&fcb->f_mtx, OS_WAIT_FOREVER);
+    if (rc && rc != OS_NOT_STARTED) {
+        return FCB_ERR_ARGS;
+    }
+    fp = fcb_pend_find(fcb, loc);
+    if (fp) {
+        fp->fp_loc = *loc;
+        fp->fp_state = state;
+        rc = fcb_pend_commit(fcb);
+        fcb_pend_wake(fcb);
+    } else {
+        rc = FCB_ERR_ARGS;
+    }
+    os_mutex_release(&fcb->f_mtx);
+    return rc;
+}
+
 int
 fcb_append(struct fcb *fcb, uint16_t len, struct fcb_entry *append_loc)
 {
+    struct fcb_pending *fp;
     struct fcb_entry *active;
     struct flash_area *fa;
     uint8_t tmp_str[2];
@@ -86,11 +238,18 @@ fcb_append(struct fcb *fcb, uint16_t len, struct fcb_entry *append_loc)
     if (rc && rc != OS_NOT_STARTED) {
         return FCB_ERR_ARGS;
     }
+    while (fcb->f_pend_cnt >= FCB_MAX_PENDING) {
+        if (fcb_pend_wait(fcb)) {
+            rc = FCB_ERR_NOMEM;
+            goto err;
+        }
+    }
     active = &fcb->f_active;
     if (active->fe_elem_off + len + cnt > active->fe_area->fa_size) {
         fa = fcb_new_area(fcb, fcb->f_scratch_cnt);
         if (!fa || (fa->fa_size <
             sizeof(struct fcb_disk_area) + len + cnt)) {
+            fcb_bg_kick(fcb);
             rc = FCB_ERR_NOSPACE;
             goto err;
         }
@@ -101,6 +260,7 @@ fcb_append(struct fcb *fcb, uint16_t len, struct fcb_entry *append_loc)
         fcb->f_active.fe_area = fa;
         fcb->f_active.fe_elem_off = sizeof(struct fcb_disk_area);
         fcb->f_active_id++;
+        fcb_bg_kick(fcb);
     }
 
     rc = flash_area_write(active->fe_area, active->fe_elem_off, tmp_str, cnt);
@@ -114,6 +274,12 @@ fcb_append(struct fcb *fcb, uint16_t len, struct fcb_entry *append_loc)
 
     active->fe_elem_off = append_loc->fe_data_off + len;
 
+    fp = &fcb->f_pend[(fcb->f_pend_first + fcb->f_pend_cnt) %
+      FCB_MAX_PENDING];
+    fp->fp_loc = *append_loc;
+    fp->fp_state = FCB_PEND_WRITING;
+    fcb->f_pend_cnt++;
+
     os_mutex_release(&fcb->f_mtx);
 
     return FCB_OK;
@@ -129,15 +295,27 @@ fcb_append_finish(struct fcb *fcb, struct fcb_entry *loc)
     uint8_t crc8;
     uint32_t off;
 
+    /*
+     * CRC is computed and written without holding the lock; the entry
+     * becomes visible once it, and the entries before it, are committed.
+     */
     rc = fcb_elem_crc8(fcb, loc, &crc8);
     if (rc) {
+        fcb_pend_end(fcb, loc, FCB_PEND_ABORTED);
         return rc;
     }
     off = loc->fe_data_off + fcb_len_in_flash(fcb, loc->fe_data_len);
 
     rc = flash_area_write(loc->fe_area, off, &crc8, sizeof(crc8));
     if (rc) {
+        fcb_pend_end(fcb, loc, FCB_PEND_ABORTED);
         return FCB_ERR_FLASH;
     }
-    return 0;
+    return fcb_pend_end(fcb, loc, FCB_PEND_DONE);
+}
+
+void
+fcb_append_abort(struct fcb *fcb, struct fcb_entry *loc)
+{
+    fcb_pend_end(fcb, loc, FCB_PEND_ABORTED);
 }
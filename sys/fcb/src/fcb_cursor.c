@@ -0,0 +1,262 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+
+#include <util/crc8.h>
+
+#include "fcb/fcb.h"
+#include "fcb_priv.h"
+
+void
+fcb_cursor_init(struct fcb_cursor *cur, struct flash_area *fap, uint8_t *buf,
+  uint16_t buf_sz, uint8_t flags)
+{
+    memset(cur, 0, sizeof(*cur));
+    cur->fc_entry.fe_area = fap;
+    cur->fc_filter = fap;
+    cur->fc_buf = buf;
+    cur->fc_buf_sz = buf_sz;
+    cur->fc_flags = flags;
+}
+
+/*
+ * Returns a pointer to len bytes at offset off within the area, reading
+ * a new window into the buffer if they're not already there. len must not
+ * exceed the buffer size. If refresh is set, the data is always read from
+ * flash again.
+ */
+static const uint8_t *
+fcb_cursor_map(struct fcb_cursor *cur, uint32_t off, uint16_t len, int refresh)
+{
+    struct flash_area *fap;
+    uint32_t rd_len;
+
+    fap = cur->fc_entry.fe_area;
+    if (!refresh && cur->fc_buf_area == fap && off >= cur->fc_buf_off &&
+      off + len <= cur->fc_buf_off + cur->fc_buf_len) {
+        return cur->fc_buf + (off - cur->fc_buf_off);
+    }
+
+    rd_len = fap->fa_size - off;
+    if (rd_len > cur->fc_buf_sz) {
+        rd_len = cur->fc_buf_sz;
+    }
+    cur->fc_buf_area = NULL;
+    if (flash_area_read(fap, off, cur->fc_buf, rd_len)) {
+        return NULL;
+    }
+    cur->fc_buf_area = fap;
+    cur->fc_buf_off = off;
+    cur->fc_buf_len = rd_len;
+    return cur->fc_buf;
+}
+
+/*
+ * fcb_elem_info() equivalent which reads through the cursor buffer.
+ */
+static int
+fcb_cursor_elem_info(struct fcb *fcb, struct fcb_cursor *cur)
+{
+    struct fcb_entry *loc;
+    const uint8_t *p;
+    uint8_t hdr[2];
+    uint8_t crc8;
+    uint16_t len;
+    uint32_t off;
+    uint32_t end;
+    int blk_sz;
+    int cnt;
+
+    loc = &cur->fc_entry;
+    if (loc->fe_elem_off + 2 > loc->fe_area->fa_size) {
+        return FCB_ERR_NOVAR;
+    }
+    p = fcb_cursor_map(cur, loc->fe_elem_off, 2, 0);
+    if (!p) {
+        return FCB_ERR_FLASH;
+    }
+    memcpy(hdr, p, 2);
+
+    cnt = fcb_get_len(hdr, &len);
+    if (cnt == FCB_ERR_NOVAR) {
+        /*
+         * The buffer may hold erased flash which has been written to
+         * since; check again before declaring this the end.
+         */
+        p = fcb_cursor_map(cur, loc->fe_elem_off, 2, 1);
+        if (!p) {
+            return FCB_ERR_FLASH;
+        }
+        memcpy(hdr, p, 2);
+        cnt = fcb_get_len(hdr, &len);
+    }
+    if (cnt < 0) {
+        return cnt;
+    }
+    loc->fe_data_off = loc->fe_elem_off + fcb_len_in_flash(fcb, cnt);
+    loc->fe_data_len = len;
+
+    if (cur->fc_flags & FCB_CURSOR_F_NOCRC) {
+        return 0;
+    }
+
+    crc8 = crc8_init();
+    crc8 = crc8_calc(crc8, hdr, cnt);
+
+    off = loc->fe_data_off;
+    end = loc->fe_data_off + len;
+    for (; off < end; off += blk_sz) {
+        blk_sz = end - off;
+        if (blk_sz > cur->fc_buf_sz) {
+            blk_sz = cur->fc_buf_sz;
+        }
+        p = fcb_cursor_map(cur, off, blk_sz, 0);
+        if (!p) {
+            return FCB_ERR_FLASH;
+        }
+        crc8 = crc8_calc(crc8, (void *)p, blk_sz);
+    }
+
+    off = loc->fe_data_off + fcb_len_in_flash(fcb, len);
+    p = fcb_cursor_map(cur, off, FCB_CRC_SZ, 0);
+    if (!p) {
+        return FCB_ERR_FLASH;
+    }
+    if (*p != crc8) {
+        return FCB_ERR_CRC;
+    }
+    return 0;
+}
+
+/*
+ * Advances the cursor to the next valid entry. Entries with a bad CRC are
+ * skipped, as with fcb_getnext(). On failure the cursor is left unchanged.
+ */
+int
+fcb_cursor_next(struct fcb *fcb, struct fcb_cursor *cur)
+{
+    struct fcb_entry *loc;
+    struct fcb_entry prev;
+    int refreshed;
+    int rc;
+
+    loc = &cur->fc_entry;
+    prev = *loc;
+
+    rc = os_mutex_pend(&fcb->f_mtx, OS_WAIT_FOREVER);
+    if (rc && rc != OS_NOT_STARTED) {
+        return FCB_ERR_ARGS;
+    }
+
+    if (loc->fe_area == NULL) {
+        loc->fe_area = fcb->f_oldest;
+    }
+    if (loc->fe_elem_off == 0) {
+        loc->fe_elem_off = sizeof(struct fcb_disk_area);
+    } else {
+        loc->fe_elem_off = loc->fe_data_off +
+          fcb_len_in_flash(fcb, loc->fe_data_len) +
+          fcb_len_in_flash(fcb, FCB_CRC_SZ);
+    }
+
+    refreshed = 0;
+    while (1) {
+        if (fcb_is_pending(fcb, loc)) {
+            /*
+             * Buffer may have the entry as it was while being written.
+             */
+            cur->fc_buf_area = NULL;
+            rc = FCB_ERR_NOVAR;
+            break;
+        }
+        rc = fcb_cursor_elem_info(fcb, cur);
+        if (rc == 0) {
+            break;
+        }
+        if (rc == FCB_ERR_CRC && !refreshed) {
+            /*
+             * Entry might have been committed after it was read into the
+             * buffer. Read it again from flash before skipping it.
+             */
+            cur->fc_buf_area = NULL;
+            refreshed = 1;
+            continue;
+        }
+        refreshed = 0;
+        if (rc == FCB_ERR_CRC) {
+            loc->fe_elem_off = loc->fe_data_off +
+              fcb_len_in_flash(fcb, loc->fe_data_len) +
+              fcb_len_in_flash(fcb, FCB_CRC_SZ);
+            continue;
+        }
+
+        /*
+         * Moving to next sector.
+         */
+        if (loc->fe_area == fcb->f_active.fe_area ||
+          loc->fe_area == cur->fc_filter) {
+            rc = FCB_ERR_NOVAR;
+            break;
+        }
+        loc->fe_area = fcb_getnext_area(fcb, loc->fe_area);
+        loc->fe_elem_off = sizeof(struct fcb_disk_area);
+    }
+    if (rc) {
+        /*
+         * Stay at the last entry returned, so that the walk can be resumed
+         * once more entries have been appended.
+         */
+        *loc = prev;
+    }
+
+    os_mutex_release(&fcb->f_mtx);
+    return rc;
+}
+
+/*
+ * Reads data of the current entry, from the cursor buffer if it is there.
+ * Returns the number of bytes read, or an error code.
+ */
+int
+fcb_cursor_read(struct fcb_cursor *cur, uint16_t off, void *dst, uint16_t len)
+{
+    struct fcb_entry *loc;
+    const uint8_t *p;
+
+    loc = &cur->fc_entry;
+    if (off >= loc->fe_data_len) {
+        return 0;
+    }
+    if (off + len > loc->fe_data_len) {
+        len = loc->fe_data_len - off;
+    }
+    if (len > cur->fc_buf_sz) {
+        if (flash_area_read(loc->fe_area, loc->fe_data_off + off, dst, len)) {
+            return FCB_ERR_FLASH;
+        }
+        return len;
+    }
+    p = fcb_cursor_map(cur, loc->fe_data_off + off, len, 0);
+    if (!p) {
+        return FCB_ERR_FLASH;
+    }
+    memcpy(dst, p, len);
+    return len;
+}
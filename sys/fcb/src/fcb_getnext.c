@@ -51,8 +51,8 @@ fcb_getnext_area(struct fcb *fcb, struct flash_area *fap)
     return fap;
 }
 
-int
-fcb_getnext_nolock(struct fcb *fcb, struct fcb_entry *loc)
+static int
+fcb_getnext_flash(struct fcb *fcb, struct fcb_entry *loc)
 {
     int rc;
 
@@ -116,6 +116,26 @@ next_sector:
     return 0;
 }
 
+/*
+ * Entries still being written, and the ones after them, are not reported.
+ * loc is left at the last entry returned, so the walk can continue from
+ * there once they've been committed.
+ */
+int
+fcb_getnext_nolock(struct fcb *fcb, struct fcb_entry *loc)
+{
+    struct fcb_entry next;
+    int rc;
+
+    next = *loc;
+    rc = fcb_getnext_flash(fcb, &next);
+    if (rc == 0 && fcb_is_pending(fcb, &next)) {
+        return FCB_ERR_NOVAR;
+    }
+    *loc = next;
+    return rc;
+}
+
 int
 fcb_getnext(struct fcb *fcb, struct fcb_entry *loc)
 {
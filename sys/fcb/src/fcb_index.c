@@ -0,0 +1,202 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+
+#include "fcb/fcb.h"
+#include "fcb_priv.h"
+
+static struct fcb_sector_idx *
+fcb_idx(struct fcb *fcb, struct flash_area *fap)
+{
+    return &fcb->f_sector_idx[fap - fcb->f_sectors];
+}
+
+/*
+ * Marks sector as empty.
+ */
+void
+fcb_idx_clear(struct fcb *fcb, struct flash_area *fap)
+{
+    struct fcb_sector_idx *fsi;
+
+    if (!fcb->f_sector_idx) {
+        return;
+    }
+    fsi = fcb_idx(fcb, fap);
+    fsi->fsi_cnt = 0;
+    memset(fsi->fsi_key, 0xff, sizeof(fsi->fsi_key));
+}
+
+/*
+ * Accounts for a new entry at loc.
+ */
+int
+fcb_idx_add(struct fcb *fcb, struct fcb_entry *loc)
+{
+    struct fcb_sector_idx *fsi;
+    int len;
+
+    if (!fcb->f_sector_idx) {
+        return 0;
+    }
+    fsi = fcb_idx(fcb, loc->fe_area);
+    if (fsi->fsi_cnt == 0) {
+        memset(fsi->fsi_key, 0xff, sizeof(fsi->fsi_key));
+        len = loc->fe_data_len;
+        if (len > sizeof(fsi->fsi_key)) {
+            len = sizeof(fsi->fsi_key);
+        }
+        if (flash_area_read(loc->fe_area, loc->fe_data_off, fsi->fsi_key,
+            len)) {
+            return FCB_ERR_FLASH;
+        }
+    }
+    fsi->fsi_cnt++;
+    return 0;
+}
+
+/*
+ * Rebuilds the index from flash contents. Called from fcb_init().
+ */
+int
+fcb_idx_build(struct fcb *fcb)
+{
+    struct fcb_entry loc;
+    int rc;
+    int i;
+
+    if (!fcb->f_sector_idx) {
+        return 0;
+    }
+    for (i = 0; i < fcb->f_sector_cnt; i++) {
+        fcb_idx_clear(fcb, &fcb->f_sectors[i]);
+    }
+    memset(&loc, 0, sizeof(loc));
+    while (fcb_getnext_nolock(fcb, &loc) == 0) {
+        rc = fcb_idx_add(fcb, &loc);
+        if (rc) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Walks within a sector, leaving loc at the cnt'th entry (cnt > 0).
+ */
+static int
+fcb_seek_in_area(struct fcb *fcb, struct flash_area *fap, uint32_t cnt,
+  struct fcb_entry *loc)
+{
+    int rc;
+
+    loc->fe_area = fap;
+    loc->fe_elem_off = 0;
+    while (cnt--) {
+        rc = fcb_getnext_nolock(fcb, loc);
+        if (rc) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+int
+fcb_seek_nth(struct fcb *fcb, uint32_t n, struct fcb_entry *loc)
+{
+    struct fcb_sector_idx *fsi;
+    struct flash_area *fap;
+    int rc;
+
+    if (!fcb->f_sector_idx) {
+        return FCB_ERR_ARGS;
+    }
+    rc = os_mutex_pend(&fcb->f_mtx, OS_WAIT_FOREVER);
+    if (rc && rc != OS_NOT_STARTED) {
+        return FCB_ERR_ARGS;
+    }
+
+    fap = fcb->f_oldest;
+    while (1) {
+        fsi = fcb_idx(fcb, fap);
+        if (n < fsi->fsi_cnt) {
+            break;
+        }
+        n -= fsi->fsi_cnt;
+        if (fap == fcb->f_active.fe_area) {
+            rc = FCB_ERR_NOVAR;
+            goto out;
+        }
+        fap = fcb_getnext_area(fcb, fap);
+    }
+
+    if (n == 0) {
+        loc->fe_area = fap;
+        loc->fe_elem_off = 0;
+        rc = 0;
+    } else {
+        rc = fcb_seek_in_area(fcb, fap, n, loc);
+    }
+out:
+    os_mutex_release(&fcb->f_mtx);
+    return rc;
+}
+
+int
+fcb_seek_key(struct fcb *fcb, fcb_key_cmp_func cmp, void *arg,
+  struct fcb_entry *loc)
+{
+    struct fcb_sector_idx *fsi;
+    struct flash_area *fap;
+    struct flash_area *start;
+    int rc;
+
+    if (!fcb->f_sector_idx) {
+        return FCB_ERR_ARGS;
+    }
+    rc = os_mutex_pend(&fcb->f_mtx, OS_WAIT_FOREVER);
+    if (rc && rc != OS_NOT_STARTED) {
+        return FCB_ERR_ARGS;
+    }
+
+    start = NULL;
+    fap = fcb->f_oldest;
+    while (1) {
+        fsi = fcb_idx(fcb, fap);
+        if (fsi->fsi_cnt) {
+            if (cmp(fsi->fsi_key, arg) >= 0) {
+                break;
+            }
+            start = fap;
+        }
+        if (fap == fcb->f_active.fe_area) {
+            break;
+        }
+        fap = fcb_getnext_area(fcb, fap);
+    }
+    if (!start) {
+        start = fcb->f_oldest;
+    }
+    loc->fe_area = start;
+    loc->fe_elem_off = 0;
+
+    os_mutex_release(&fcb->f_mtx);
+    return 0;
+}
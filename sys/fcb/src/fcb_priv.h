@@ -47,9 +47,42 @@ int fcb_getnext_in_area(struct fcb *fcb, struct fcb_entry *loc);
 struct flash_area *fcb_getnext_area(struct fcb *fcb, struct flash_area *fap);
 int fcb_getnext_nolock(struct fcb *fcb, struct fcb_entry *loc);
 
+/*
+ * States of reservations in fcb->f_pend.
+ */
+#define FCB_PEND_WRITING	0
+#define FCB_PEND_DONE		1
+#define FCB_PEND_ABORTED	2
+
+/*
+ * Task blocked in fcb_pend_wait(). Each has a semaphore of its own, so a
+ * wakeup can't be taken by a task which started waiting afterwards.
+ */
+struct fcb_waiter {
+    struct os_sem fw_sem;
+    SLIST_ENTRY(fcb_waiter) fw_next;
+};
+
+static inline void
+fcb_bg_kick(struct fcb *fcb)
+{
+    if (fcb->f_spare_cnt) {
+        os_callout_reset(&fcb->f_bg_erase.cf_c, 0);
+    }
+}
+
+int fcb_is_pending(struct fcb *, struct fcb_entry *loc);
+int fcb_pend_in_area(struct fcb *, struct flash_area *fap);
+int fcb_pend_wait(struct fcb *);
+void fcb_pend_wake(struct fcb *);
+
 int fcb_elem_info(struct fcb *, struct fcb_entry *);
 int fcb_elem_crc8(struct fcb *, struct fcb_entry *loc, uint8_t *crc8p);
 
+void fcb_idx_clear(struct fcb *, struct flash_area *fap);
+int fcb_idx_add(struct fcb *, struct fcb_entry *loc);
+int fcb_idx_build(struct fcb *);
+
 int fcb_sector_hdr_init(struct fcb *, struct flash_area *fap, uint16_t id);
 int fcb_sector_hdr_read(struct fcb *, struct flash_area *fap,
   struct fcb_disk_area *fdap);
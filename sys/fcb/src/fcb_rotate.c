@@ -17,11 +17,27 @@
  * under the License.
  */
 
+#include "os/os.h"
 #include "fcb/fcb.h"
 #include "fcb_priv.h"
 
-int
-fcb_rotate(struct fcb *fcb)
+/*
+ * Lets other tasks run while the oldest sector is being erased.
+ */
+static void
+fcb_erase_wait(void *arg)
+{
+    if (os_started()) {
+        os_time_delay(1);
+    }
+}
+
+/*
+ * Erases the oldest sector. With spare set, only if there are fewer erased
+ * sectors than fcb_bg_start() asked for; FCB_ERR_NOVAR if not.
+ */
+static int
+fcb_rotate_oldest(struct fcb *fcb, int spare)
 {
     struct flash_area *fap;
     int rc = 0;
@@ -31,26 +47,102 @@ fcb_rotate(struct fcb *fcb)
         return FCB_ERR_ARGS;
     }
 
-    rc = flash_area_erase(fcb->f_oldest, 0, fcb->f_oldest->fa_size);
-    if (rc) {
-        rc = FCB_ERR_FLASH;
+    while (fcb->f_erasing || fcb_pend_in_area(fcb, fcb->f_oldest)) {
+        if (fcb_pend_wait(fcb)) {
+            rc = FCB_ERR_BUSY;
+            goto out;
+        }
+    }
+    if (spare && (fcb->f_oldest == fcb->f_active.fe_area ||
+        fcb_free_sector_cnt(fcb) >= fcb->f_scratch_cnt + fcb->f_spare_cnt)) {
+        rc = FCB_ERR_NOVAR;
         goto out;
     }
-    if (fcb->f_oldest == fcb->f_active.fe_area) {
+
+    fap = fcb->f_oldest;
+    if (fap != fcb->f_active.fe_area) {
         /*
-         * Need to create a new active area, as we're wiping the current.
+         * Take the sector out of use, and erase it without holding the
+         * lock. fcb_new_area() won't pick it until the erase is done.
          */
-        fap = fcb_getnext_area(fcb, fcb->f_oldest);
-        rc = fcb_sector_hdr_init(fcb, fap, fcb->f_active_id + 1);
+        fcb_idx_clear(fcb, fap);
+        fcb->f_oldest = fcb_getnext_area(fcb, fap);
+        fcb->f_erasing = fap;
+        os_mutex_release(&fcb->f_mtx);
+
+        rc = flash_area_erase_wait(fap, 0, fap->fa_size, fcb_erase_wait,
+          NULL);
+
+        os_mutex_pend(&fcb->f_mtx, OS_WAIT_FOREVER);
+        fcb->f_erasing = NULL;
+        fcb_pend_wake(fcb);
         if (rc) {
-            goto out;
+            rc = FCB_ERR_FLASH;
         }
-        fcb->f_active.fe_area = fap;
-        fcb->f_active.fe_elem_off = sizeof(struct fcb_disk_area);
-        fcb->f_active_id++;
+        goto out;
     }
-    fcb->f_oldest = fcb_getnext_area(fcb, fcb->f_oldest);
+
+    rc = flash_area_erase_wait(fap, 0, fap->fa_size, fcb_erase_wait, NULL);
+    if (rc) {
+        rc = FCB_ERR_FLASH;
+        goto out;
+    }
+    fcb_idx_clear(fcb, fap);
+
+    /*
+     * Need to create a new active area, as we're wiping the current.
+     */
+    fap = fcb_getnext_area(fcb, fap);
+    rc = fcb_sector_hdr_init(fcb, fap, fcb->f_active_id + 1);
+    if (rc) {
+        goto out;
+    }
+    fcb->f_active.fe_area = fap;
+    fcb->f_active.fe_elem_off = sizeof(struct fcb_disk_area);
+    fcb->f_active_id++;
+    fcb->f_oldest = fap;
 out:
     os_mutex_release(&fcb->f_mtx);
     return rc;
 }
+
+int
+fcb_rotate(struct fcb *fcb)
+{
+    return fcb_rotate_oldest(fcb, 0);
+}
+
+static void
+fcb_bg_erase(void *arg)
+{
+    struct fcb *fcb;
+
+    fcb = arg;
+
+    /*
+     * A sector at a time; come back for the next one after other events
+     * have been processed.
+     */
+    if (fcb_rotate_oldest(fcb, 1) == 0) {
+        fcb_bg_kick(fcb);
+    }
+}
+
+int
+fcb_bg_start(struct fcb *fcb, struct os_eventq *evq, uint8_t spare_cnt)
+{
+    if (!spare_cnt || fcb->f_scratch_cnt + spare_cnt >= fcb->f_sector_cnt) {
+        return FCB_ERR_ARGS;
+    }
+    os_callout_func_init(&fcb->f_bg_erase, evq, fcb_bg_erase, fcb);
+    fcb->f_spare_cnt = spare_cnt;
+    fcb_bg_kick(fcb);
+    return 0;
+}
+
+void
+fcb_bg_stop(struct fcb *fcb)
+{
+    fcb->f_spare_cnt = 0;
+    os_callout_stop(&fcb->f_bg_erase.cf_c);
+}
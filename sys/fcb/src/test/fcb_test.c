@@ -196,6 +196,393 @@ TEST_CASE(fcb_test_append)
     TEST_ASSERT(var_cnt == sizeof(test_data));
 }
 
+static void
+fcb_test_cursor_fill(struct fcb *fcb, int cnt)
+{
+    struct fcb_entry loc;
+    uint8_t test_data[128];
+    int rc;
+    int i;
+    int j;
+
+    for (i = 0; i < cnt; i++) {
+        for (j = 0; j < i; j++) {
+            test_data[j] = fcb_test_append_data(i, j);
+        }
+        rc = fcb_append(fcb, i, &loc);
+        TEST_ASSERT_FATAL(rc == 0);
+        rc = flash_area_write(loc.fe_area, loc.fe_data_off, test_data, i);
+        TEST_ASSERT(rc == 0);
+        rc = fcb_append_finish(fcb, &loc);
+        TEST_ASSERT(rc == 0);
+    }
+}
+
+static int
+fcb_test_cursor_walk(struct fcb *fcb, uint8_t flags, int skip)
+{
+    struct fcb_cursor cur;
+    uint8_t buf[48];
+    uint8_t test_data[128];
+    int expected;
+    int cnt;
+    int len;
+    int i;
+
+    fcb_cursor_init(&cur, NULL, buf, sizeof(buf), flags);
+    cnt = 0;
+    expected = 0;
+    while (fcb_cursor_next(fcb, &cur) == 0) {
+        if (expected == skip) {
+            expected++;
+        }
+        TEST_ASSERT(cur.fc_entry.fe_data_len == expected);
+        len = fcb_cursor_read(&cur, 0, test_data, sizeof(test_data));
+        TEST_ASSERT(len == expected);
+        if (skip < 0) {
+            for (i = 0; i < len; i++) {
+                TEST_ASSERT(test_data[i] == fcb_test_append_data(len, i));
+            }
+        }
+        expected++;
+        cnt++;
+    }
+    return cnt;
+}
+
+TEST_CASE(fcb_test_cursor)
+{
+    struct fcb *fcb;
+    struct fcb_cursor cur;
+    struct fcb_entry loc;
+    uint8_t buf[48];
+    uint8_t data[4];
+    uint8_t data5[10];
+    uint8_t crc8;
+    int rc;
+    int i;
+    int j;
+
+    fcb_test_wipe();
+    fcb = &test_fcb;
+    memset(fcb, 0, sizeof(*fcb));
+    fcb->f_sector_cnt = 2;
+    fcb->f_sectors = test_fcb_area;
+
+    rc = fcb_init(fcb);
+    TEST_ASSERT(rc == 0);
+
+    /* Empty. */
+    fcb_cursor_init(&cur, NULL, buf, sizeof(buf), 0);
+    rc = fcb_cursor_next(fcb, &cur);
+    TEST_ASSERT(rc == FCB_ERR_NOVAR);
+
+    /* Entries both smaller and bigger than the cursor buffer. */
+    fcb_test_cursor_fill(fcb, 128);
+    TEST_ASSERT(fcb_test_cursor_walk(fcb, 0, -1) == 128);
+
+    /* Entry appended after the cursor reached the end is found. */
+    rc = fcb_cursor_next(fcb, &cur);
+    TEST_ASSERT(rc == 0);
+    while (fcb_cursor_next(fcb, &cur) == 0) {
+    }
+    rc = fcb_append(fcb, sizeof(data), &loc);
+    TEST_ASSERT(rc == 0);
+    memset(data, 0xa5, sizeof(data));
+    rc = flash_area_write(loc.fe_area, loc.fe_data_off, data, sizeof(data));
+    TEST_ASSERT(rc == 0);
+    rc = fcb_append_finish(fcb, &loc);
+    TEST_ASSERT(rc == 0);
+    rc = fcb_cursor_next(fcb, &cur);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cur.fc_entry.fe_elem_off == loc.fe_elem_off);
+    TEST_ASSERT(fcb_cursor_read(&cur, 1, data5, sizeof(data5)) == 3);
+    TEST_ASSERT(data5[0] == 0xa5);
+
+    /* Entry #5 has a bad CRC; it is skipped unless CRCs are ignored. */
+    fcb_test_wipe();
+    rc = fcb_init(fcb);
+    TEST_ASSERT(rc == 0);
+    fcb_test_cursor_fill(fcb, 5);
+
+    rc = fcb_append(fcb, 5, &loc);
+    TEST_ASSERT_FATAL(rc == 0);
+    for (i = 0; i < 5; i++) {
+        data5[i] = fcb_test_append_data(5, i);
+    }
+    rc = flash_area_write(loc.fe_area, loc.fe_data_off, data5, 5);
+    TEST_ASSERT(rc == 0);
+    rc = fcb_elem_crc8(fcb, &loc, &crc8);
+    TEST_ASSERT(rc == 0);
+    crc8 = ~crc8;
+    rc = flash_area_write(loc.fe_area,
+      loc.fe_data_off + fcb_len_in_flash(fcb, 5), &crc8, sizeof(crc8));
+    TEST_ASSERT(rc == 0);
+    fcb_append_abort(fcb, &loc);
+
+    for (i = 6; i < 10; i++) {
+        for (j = 0; j < i; j++) {
+            data5[j] = fcb_test_append_data(i, j);
+        }
+        rc = fcb_append(fcb, i, &loc);
+        TEST_ASSERT_FATAL(rc == 0);
+        rc = flash_area_write(loc.fe_area, loc.fe_data_off, data5, i);
+        TEST_ASSERT(rc == 0);
+        rc = fcb_append_finish(fcb, &loc);
+        TEST_ASSERT(rc == 0);
+    }
+
+    TEST_ASSERT(fcb_test_cursor_walk(fcb, 0, 5) == 9);
+    TEST_ASSERT(fcb_test_cursor_walk(fcb, FCB_CURSOR_F_NOCRC, -2) == 10);
+}
+
+static int
+fcb_test_idx_cmp(const uint8_t *key, void *arg)
+{
+    uint32_t val;
+
+    memcpy(&val, key, sizeof(val));
+    if (val < *(uint32_t *)arg) {
+        return -1;
+    }
+    return val > *(uint32_t *)arg;
+}
+
+static void
+fcb_test_idx_append(struct fcb *fcb, uint32_t val)
+{
+    struct fcb_entry loc;
+    int rc;
+
+    rc = fcb_append(fcb, sizeof(val), &loc);
+    if (rc == FCB_ERR_NOSPACE) {
+        rc = fcb_rotate(fcb);
+        TEST_ASSERT_FATAL(rc == 0);
+        rc = fcb_append(fcb, sizeof(val), &loc);
+    }
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = flash_area_write(loc.fe_area, loc.fe_data_off, &val, sizeof(val));
+    TEST_ASSERT(rc == 0);
+    rc = fcb_append_finish(fcb, &loc);
+    TEST_ASSERT(rc == 0);
+}
+
+static void
+fcb_test_idx_check(struct fcb *fcb, uint32_t first, uint32_t last)
+{
+    struct fcb_entry loc;
+    struct fcb_sector_idx *fsi;
+    uint32_t total;
+    uint32_t val;
+    uint32_t prev;
+    int rc;
+    int i;
+
+    total = 0;
+    for (i = 0; i < fcb->f_sector_cnt; i++) {
+        total += fcb->f_sector_idx[i].fsi_cnt;
+    }
+    TEST_ASSERT(total == last - first + 1);
+
+    for (val = first; val <= last; val += 37) {
+        rc = fcb_seek_nth(fcb, val - first, &loc);
+        TEST_ASSERT_FATAL(rc == 0);
+        rc = fcb_getnext(fcb, &loc);
+        TEST_ASSERT_FATAL(rc == 0);
+        rc = flash_area_read(loc.fe_area, loc.fe_data_off, &prev,
+          sizeof(prev));
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(prev == val);
+
+        /*
+         * Sector found by key holds entries before val, and the first
+         * entry in the next sector is not below val.
+         */
+        rc = fcb_seek_key(fcb, fcb_test_idx_cmp, &val, &loc);
+        TEST_ASSERT_FATAL(rc == 0);
+        fsi = &fcb->f_sector_idx[loc.fe_area - fcb->f_sectors];
+        memcpy(&prev, fsi->fsi_key, sizeof(prev));
+        TEST_ASSERT(prev <= val);
+        TEST_ASSERT(prev + fsi->fsi_cnt > val || val == first);
+    }
+    rc = fcb_seek_nth(fcb, total, &loc);
+    TEST_ASSERT(rc == FCB_ERR_NOVAR);
+}
+
+TEST_CASE(fcb_test_index)
+{
+    struct fcb *fcb;
+    struct fcb_sector_idx idx[3];
+    struct fcb_entry loc;
+    struct fcb_entry loc2;
+    uint32_t val;
+    uint32_t first;
+    int rc;
+    int i;
+
+    fcb_test_wipe();
+    fcb = &test_fcb;
+    memset(fcb, 0, sizeof(*fcb));
+    fcb->f_sector_cnt = 3;
+    fcb->f_sectors = test_fcb_area;
+    fcb->f_sector_idx = idx;
+
+    rc = fcb_init(fcb);
+    TEST_ASSERT(rc == 0);
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT(idx[i].fsi_cnt == 0);
+    }
+    rc = fcb_seek_nth(fcb, 0, &loc);
+    TEST_ASSERT(rc == FCB_ERR_NOVAR);
+
+    /* Fill past the first rotation. */
+    for (val = 0; val < 12000; val++) {
+        fcb_test_idx_append(fcb, val);
+    }
+    TEST_ASSERT_FATAL(fcb->f_oldest != &test_fcb_area[0]);
+    memcpy(&first, idx[fcb->f_oldest - fcb->f_sectors].fsi_key,
+      sizeof(first));
+    fcb_test_idx_check(fcb, first, val - 1);
+
+    /* Index is rebuilt from flash. */
+    memset(idx, 0, sizeof(idx));
+    rc = fcb_init(fcb);
+    TEST_ASSERT(rc == 0);
+    fcb_test_idx_check(fcb, first, val - 1);
+
+    /* Same answer as without the index. */
+    for (i = 1; i < 300; i += 50) {
+        rc = fcb_offset_last_n(fcb, i, &loc.fe_elem_off);
+        TEST_ASSERT(rc == 0);
+        fcb->f_sector_idx = NULL;
+        rc = fcb_offset_last_n(fcb, i, &loc2.fe_elem_off);
+        TEST_ASSERT(rc == 0);
+        fcb->f_sector_idx = idx;
+        TEST_ASSERT(loc.fe_elem_off == loc2.fe_elem_off);
+    }
+}
+
+static int
+fcb_test_pend_walk_cb(struct fcb_entry *loc, void *arg)
+{
+    uint32_t *vals = arg;
+    uint32_t val;
+    int rc;
+
+    rc = flash_area_read(loc->fe_area, loc->fe_data_off, &val, sizeof(val));
+    TEST_ASSERT(rc == 0);
+    vals[++vals[0]] = val;
+    return 0;
+}
+
+static void
+fcb_test_pend_write(struct fcb *fcb, struct fcb_entry *loc, uint32_t val)
+{
+    int rc;
+
+    rc = flash_area_write(loc->fe_area, loc->fe_data_off, &val, sizeof(val));
+    TEST_ASSERT(rc == 0);
+    rc = fcb_append_finish(fcb, loc);
+    TEST_ASSERT(rc == 0);
+}
+
+TEST_CASE(fcb_test_append_pending)
+{
+    struct fcb *fcb;
+    struct fcb_sector_idx idx[2];
+    struct fcb_entry loc[FCB_MAX_PENDING + 1];
+    struct fcb_cursor cur;
+    uint8_t buf[64];
+    uint32_t vals[FCB_MAX_PENDING + 4];
+    uint32_t key;
+    int rc;
+    int i;
+
+    fcb_test_wipe();
+    fcb = &test_fcb;
+    memset(fcb, 0, sizeof(*fcb));
+    fcb->f_sector_cnt = 2;
+    fcb->f_sectors = test_fcb_area;
+    fcb->f_sector_idx = idx;
+
+    rc = fcb_init(fcb);
+    TEST_ASSERT(rc == 0);
+    fcb_cursor_init(&cur, NULL, buf, sizeof(buf), 0);
+
+    for (i = 0; i < 3; i++) {
+        rc = fcb_append(fcb, sizeof(uint32_t), &loc[i]);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    /* Finished out of order; not visible until the first one is done. */
+    fcb_test_pend_write(fcb, &loc[1], 2);
+    vals[0] = 0;
+    rc = fcb_walk(fcb, NULL, fcb_test_pend_walk_cb, vals);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(vals[0] == 0);
+    TEST_ASSERT(fcb_cursor_next(fcb, &cur) == FCB_ERR_NOVAR);
+    TEST_ASSERT(idx[0].fsi_cnt == 0);
+
+    fcb_test_pend_write(fcb, &loc[0], 1);
+    vals[0] = 0;
+    rc = fcb_walk(fcb, NULL, fcb_test_pend_walk_cb, vals);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(vals[0] == 2);
+    TEST_ASSERT(vals[1] == 1 && vals[2] == 2);
+    TEST_ASSERT(idx[0].fsi_cnt == 2);
+    memcpy(&key, idx[0].fsi_key, sizeof(key));
+    TEST_ASSERT(key == 1);
+
+    rc = fcb_cursor_next(fcb, &cur);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cur.fc_entry.fe_elem_off == loc[0].fe_elem_off);
+    rc = fcb_cursor_next(fcb, &cur);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cur.fc_entry.fe_elem_off == loc[1].fe_elem_off);
+    TEST_ASSERT(fcb_cursor_next(fcb, &cur) == FCB_ERR_NOVAR);
+
+    /* Aborted entry is skipped, and doesn't hold back the ones after. */
+    rc = fcb_append(fcb, sizeof(uint32_t), &loc[3]);
+    TEST_ASSERT_FATAL(rc == 0);
+    fcb_test_pend_write(fcb, &loc[3], 4);
+    TEST_ASSERT(fcb_cursor_next(fcb, &cur) == FCB_ERR_NOVAR);
+    fcb_append_abort(fcb, &loc[2]);
+    rc = fcb_cursor_next(fcb, &cur);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cur.fc_entry.fe_elem_off == loc[3].fe_elem_off);
+    vals[0] = 0;
+    rc = fcb_walk(fcb, NULL, fcb_test_pend_walk_cb, vals);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(vals[0] == 3);
+    TEST_ASSERT(vals[3] == 4);
+    TEST_ASSERT(idx[0].fsi_cnt == 3);
+
+    /* Without the OS running, appends don't wait for a free slot. */
+    for (i = 0; i < FCB_MAX_PENDING; i++) {
+        rc = fcb_append(fcb, sizeof(uint32_t), &loc[i]);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    rc = fcb_append(fcb, sizeof(uint32_t), &loc[i]);
+    TEST_ASSERT(rc == FCB_ERR_NOMEM);
+
+    /* Nor does rotate wait for appends to the oldest sector. */
+    rc = fcb_rotate(fcb);
+    TEST_ASSERT(rc == FCB_ERR_BUSY);
+
+    for (i = FCB_MAX_PENDING - 1; i >= 0; i--) {
+        fcb_test_pend_write(fcb, &loc[i], 10 + i);
+    }
+    TEST_ASSERT(idx[0].fsi_cnt == 3 + FCB_MAX_PENDING);
+    vals[0] = 0;
+    rc = fcb_walk(fcb, NULL, fcb_test_pend_walk_cb, vals);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(vals[0] == 3 + FCB_MAX_PENDING);
+    TEST_ASSERT(vals[4] == 10);
+
+    rc = fcb_rotate(fcb);
+    TEST_ASSERT(rc == 0);
+}
+
 TEST_CASE(fcb_test_append_too_big)
 {
     struct fcb *fcb;
@@ -543,6 +930,67 @@ TEST_CASE(fcb_test_rotate)
     TEST_ASSERT(aa_arg.elem_cnts[0] == 0 || aa_arg.elem_cnts[1] == 0);
 }
 
+static void
+fcb_test_bg_append(struct fcb *fcb, uint32_t val)
+{
+    struct fcb_entry loc;
+    int rc;
+
+    rc = fcb_append(fcb, sizeof(val), &loc);
+    TEST_ASSERT_FATAL(rc == 0);
+    fcb_test_pend_write(fcb, &loc, val);
+}
+
+TEST_CASE(fcb_test_bg_erase)
+{
+    static struct os_eventq evq;
+    struct fcb *fcb;
+    uint32_t val;
+    int rc;
+
+    fcb_test_wipe();
+    fcb = &test_fcb;
+    memset(fcb, 0, sizeof(*fcb));
+    fcb->f_sector_cnt = 4;
+    fcb->f_sectors = test_fcb_area;
+
+    rc = fcb_init(fcb);
+    TEST_ASSERT(rc == 0);
+    os_eventq_init(&evq);
+
+    rc = fcb_bg_start(fcb, &evq, 4);
+    TEST_ASSERT(rc == FCB_ERR_ARGS);
+    rc = fcb_bg_start(fcb, &evq, 1);
+    TEST_ASSERT(rc == 0);
+
+    /* Enough erased sectors, nothing to do. */
+    fcb->f_bg_erase.cf_func(fcb);
+    TEST_ASSERT(fcb_free_sector_cnt(fcb) == 3);
+    os_callout_stop(&fcb->f_bg_erase.cf_c);
+
+    /* Taking the last erased sector into use schedules an erase. */
+    val = 0;
+    while (fcb->f_active.fe_area != &test_fcb_area[3]) {
+        fcb_test_bg_append(fcb, val++);
+    }
+    TEST_ASSERT(fcb_free_sector_cnt(fcb) == 0);
+    TEST_ASSERT(os_callout_queued(&fcb->f_bg_erase.cf_c));
+
+    fcb->f_bg_erase.cf_func(fcb);
+    TEST_ASSERT(fcb_free_sector_cnt(fcb) == 1);
+    TEST_ASSERT(fcb->f_oldest == &test_fcb_area[1]);
+    TEST_ASSERT(fcb->f_erasing == NULL);
+
+    /* Appends move on to it without needing fcb_rotate(). */
+    while (fcb->f_active.fe_area != &test_fcb_area[0]) {
+        fcb_test_bg_append(fcb, val++);
+    }
+    TEST_ASSERT(fcb_free_sector_cnt(fcb) == 0);
+
+    fcb_bg_stop(fcb);
+    TEST_ASSERT(!os_callout_queued(&fcb->f_bg_erase.cf_c));
+}
+
 TEST_CASE(fcb_test_multiple_scratch)
 {
     struct fcb *fcb;
@@ -644,6 +1092,12 @@ TEST_SUITE(fcb_test_all)
 
     fcb_test_append();
 
+    fcb_test_cursor();
+
+    fcb_test_index();
+
+    fcb_test_append_pending();
+
     fcb_test_append_too_big();
 
     fcb_test_append_fill();
@@ -652,9 +1106,153 @@ TEST_SUITE(fcb_test_all)
 
     fcb_test_rotate();
 
+    fcb_test_bg_erase();
+
     fcb_test_multiple_scratch();
 }
 
+/*
+ * Benchmarks; numbers are for the sectors in test_fcb_area, and
+ * FCB_BENCH_LEN byte entries.
+ */
+#ifndef FCB_BENCH_LEN
+#define FCB_BENCH_LEN           32
+#endif
+#define FCB_BENCH_SAMPLES       128
+
+static uint32_t fcb_bench_samples[FCB_BENCH_SAMPLES];
+
+static void
+fcb_bench_setup(void)
+{
+    struct fcb *fcb;
+    int rc;
+
+    fcb_test_wipe();
+    fcb = &test_fcb;
+    memset(fcb, 0, sizeof(*fcb));
+    fcb->f_sector_cnt = sizeof(test_fcb_area) / sizeof(test_fcb_area[0]);
+    fcb->f_sectors = test_fcb_area;
+
+    rc = fcb_init(fcb);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static int
+fcb_bench_append_one(struct fcb *fcb)
+{
+    static uint8_t data[FCB_BENCH_LEN];
+    struct fcb_entry loc;
+    int rc;
+
+    rc = fcb_append(fcb, sizeof(data), &loc);
+    if (rc) {
+        return rc;
+    }
+    rc = flash_area_write(loc.fe_area, loc.fe_data_off, data, sizeof(data));
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = fcb_append_finish(fcb, &loc);
+    TEST_ASSERT_FATAL(rc == 0);
+    return 0;
+}
+
+static void
+fcb_bench_fill(struct fcb *fcb)
+{
+    while (fcb_bench_append_one(fcb) == 0);
+}
+
+/*
+ * Latency distribution of appends, including the ones moving to a new
+ * sector.
+ */
+TEST_CASE(fcb_bench_append)
+{
+    uint32_t start;
+    int rc;
+    int i;
+
+    fcb_bench_setup();
+    for (i = 0; i < FCB_BENCH_SAMPLES; i++) {
+        start = tu_arch_bench_time();
+        rc = fcb_bench_append_one(&test_fcb);
+        fcb_bench_samples[i] = tu_arch_bench_time() - start;
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    tu_bench_report(fcb_bench_samples, FCB_BENCH_SAMPLES);
+}
+
+static int
+fcb_bench_walk_cb(struct fcb_entry *loc, void *arg)
+{
+    uint8_t data[FCB_BENCH_LEN];
+
+    return flash_area_read(loc->fe_area, loc->fe_data_off, data,
+                           loc->fe_data_len);
+}
+
+/* Walk of a full FCB, reading every entry. Set up by fcb_bench_mount. */
+TEST_BENCH(fcb_bench_walk, 9)
+{
+    int rc;
+
+    rc = fcb_walk(&test_fcb, NULL, fcb_bench_walk_cb, NULL);
+    TEST_ASSERT(rc == 0);
+}
+
+/* fcb_init() of a full FCB; it scans to find the last entry. */
+TEST_CASE(fcb_bench_mount)
+{
+    uint32_t start;
+    int rc;
+    int i;
+
+    fcb_bench_setup();
+    fcb_bench_fill(&test_fcb);
+
+    for (i = 0; i < 9; i++) {
+        memset(&test_fcb, 0, sizeof(test_fcb));
+        test_fcb.f_sector_cnt =
+          sizeof(test_fcb_area) / sizeof(test_fcb_area[0]);
+        test_fcb.f_sectors = test_fcb_area;
+
+        start = tu_arch_bench_time();
+        rc = fcb_init(&test_fcb);
+        fcb_bench_samples[i] = tu_arch_bench_time() - start;
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    tu_bench_report(fcb_bench_samples, 9);
+}
+
+/* Pause when the oldest sector is erased to make room. */
+TEST_CASE(fcb_bench_rotate)
+{
+    uint32_t start;
+    int rc;
+    int i;
+
+    fcb_bench_setup();
+    for (i = 0; i < 16; i++) {
+        fcb_bench_fill(&test_fcb);
+        start = tu_arch_bench_time();
+        rc = fcb_rotate(&test_fcb);
+        fcb_bench_samples[i] = tu_arch_bench_time() - start;
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    tu_bench_report(fcb_bench_samples, 16);
+}
+
+TEST_SUITE(fcb_bench_all)
+{
+    fcb_bench_append();
+
+    fcb_bench_mount();
+
+    fcb_bench_walk();
+
+    fcb_bench_rotate();
+}
+
 #ifdef MYNEWT_SELFTEST
 
 int
@@ -664,6 +1262,7 @@ main(int argc, char **argv)
     tu_init();
 
     fcb_test_all();
+    fcb_bench_all();
 
     return tu_any_failed;
 }
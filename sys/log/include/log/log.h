@@ -21,6 +21,7 @@
 
 #include "log/ignore.h"
 #include "util/cbmem.h"
+#include "util/lz.h"
 
 #include <os/queue.h>
 
@@ -40,6 +41,12 @@ typedef int (*lh_read_func_t)(struct log *, void *dptr, void *buf,
 typedef int (*lh_append_func_t)(struct log *, void *buf, int len);
 typedef int (*lh_walk_func_t)(struct log *,
         log_walk_func_t walk_func, void *arg);
+/*
+ * Optional; like lh_walk_func_t, but may skip entries with timestamps lower
+ * than ts.
+ */
+typedef int (*lh_walk_from_func_t)(struct log *, int64_t ts,
+        log_walk_func_t walk_func, void *arg);
 typedef int (*lh_flush_func_t)(struct log *);
 /*
  * This function pointer points to a function that restores the numebr
@@ -56,6 +63,7 @@ struct log_handler {
     lh_read_func_t log_read;
     lh_append_func_t log_append;
     lh_walk_func_t log_walk;
+    lh_walk_from_func_t log_walk_from;
     lh_flush_func_t log_flush;
     lh_rtr_erase_func_t log_rtr_erase;
     void *log_arg;
@@ -116,41 +124,104 @@ struct log_entry_hdr {
 #define LOG_LEVEL LOG_LEVEL_DEBUG
 #endif
 
+/*
+ * Minimum level per module, checked at compile time when module and level
+ * are constants. Can be overridden, e.g. to drop NFFS messages below error:
+ * (mod) == LOG_MODULE_NFFS ? LOG_LEVEL_ERROR : LOG_LEVEL
+ */
+#ifndef LOG_MODULE_MIN_LEVEL
+#define LOG_MODULE_MIN_LEVEL(__mod) (LOG_LEVEL)
+#endif
+
+/* Runtime minimum level per module, 4 bits each. */
+extern uint8_t g_log_module_levels[(LOG_MODULE_MAX + 1) / 2];
+
+static inline uint8_t
+log_level_get(uint16_t module)
+{
+    uint8_t levels;
+
+    if (module > LOG_MODULE_MAX) {
+        return 0;
+    }
+    levels = g_log_module_levels[module >> 1];
+    return (module & 1) ? (levels >> 4) : (levels & 0x0f);
+}
+
+int log_level_set(uint16_t module, uint8_t level);
+
+#define LOG_FILTERED(__l, __mod, __level, __msg, ...)                   \
+    do {                                                                \
+        if ((__level) >= LOG_MODULE_MIN_LEVEL(__mod) &&                 \
+          (__level) >= log_level_get(__mod)) {                          \
+            log_printf(__l, __mod, __level, __msg, ##__VA_ARGS__);      \
+        }                                                               \
+    } while (0)
+
 #if LOG_LEVEL <= LOG_LEVEL_DEBUG
-#define LOG_DEBUG(__l, __mod, __msg, ...) log_printf(__l, __mod, \
+#define LOG_DEBUG(__l, __mod, __msg, ...) LOG_FILTERED(__l, __mod, \
         LOG_LEVEL_DEBUG, __msg, ##__VA_ARGS__)
 #else
 #define LOG_DEBUG(__l, __mod, ...) IGNORE(__VA_ARGS__)
 #endif
 
 #if LOG_LEVEL <= LOG_LEVEL_INFO
-#define LOG_INFO(__l, __mod, __msg, ...) log_printf(__l, __mod, \
+#define LOG_INFO(__l, __mod, __msg, ...) LOG_FILTERED(__l, __mod, \
         LOG_LEVEL_INFO, __msg, ##__VA_ARGS__)
 #else
 #define LOG_INFO(__l, __mod, ...) IGNORE(__VA_ARGS__)
 #endif
 
-#if LOG_LEVEL <= LOG_LEVEL_INFO
-#define LOG_WARN(__l, __mod, __msg, ...) log_printf(__l, __mod, \
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(__l, __mod, __msg, ...) LOG_FILTERED(__l, __mod, \
         LOG_LEVEL_WARN, __msg, ##__VA_ARGS__)
 #else
 #define LOG_WARN(__l, __mod, ...) IGNORE(__VA_ARGS__)
 #endif
 
 #if LOG_LEVEL <= LOG_LEVEL_ERROR
-#define LOG_ERROR(__l, __mod, __msg, ...) log_printf(__l, __mod, \
+#define LOG_ERROR(__l, __mod, __msg, ...) LOG_FILTERED(__l, __mod, \
         LOG_LEVEL_ERROR, __msg, ##__VA_ARGS__)
 #else
 #define LOG_ERROR(__l, __mod, ...) IGNORE(__VA_ARGS__)
 #endif
 
 #if LOG_LEVEL <= LOG_LEVEL_CRITICAL
-#define LOG_CRITICAL(__l, __mod, __msg, ...) log_printf(__l, __mod, \
+#define LOG_CRITICAL(__l, __mod, __msg, ...) LOG_FILTERED(__l, __mod, \
         LOG_LEVEL_CRITICAL, __msg, ##__VA_ARGS__)
 #else
 #define LOG_CRITICAL(__l, __mod, ...) IGNORE(__VA_ARGS__)
 #endif
 
+/*
+ * Deferred logging. Entry stores the address of the format string and
+ * the raw arguments, and is formatted only when read. Arguments must be
+ * int-sized; %s arguments must point to constant strings. The format
+ * address can also be resolved from the image ELF file off-target.
+ */
+#define LOG_BIN_MAGIC               (0xfb00)    /* First byte is 0 */
+#define LOG_BIN_MAX_ARGS            (8)
+
+struct log_bin_hdr {
+    uint16_t lb_magic;
+    uint8_t lb_nargs;
+    uintptr_t lb_fmt;
+    /* Followed by lb_nargs uint32_t arguments. */
+} __attribute__((__packed__));
+
+#define LOG_BIN_NARGS(...)                                              \
+    LOG_BIN_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_BIN_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+#define LOG_DEFERRED(__l, __mod, __level, __msg, ...)                   \
+    do {                                                                \
+        if ((__level) >= LOG_MODULE_MIN_LEVEL(__mod) &&                 \
+          (__level) >= log_level_get(__mod)) {                          \
+            log_printf_bin(__l, __mod, __level, __msg,                  \
+              LOG_BIN_NARGS(__VA_ARGS__), ##__VA_ARGS__);               \
+        }                                                               \
+    } while (0)
+
 struct log {
     char *l_name;
     struct log_handler *l_log;
@@ -175,10 +246,15 @@ int log_append(struct log *, uint16_t, uint16_t, void *, uint16_t);
 
 #define LOG_PRINTF_MAX_ENTRY_LEN (128)
 void log_printf(struct log *log, uint16_t, uint16_t, char *, ...);
+void log_printf_bin(struct log *log, uint16_t, uint16_t, const char *,
+        int nargs, ...);
+int log_bin_format(const void *data, int len, char *buf, int buf_len);
 int log_read(struct log *log, void *dptr, void *buf, uint16_t off,
         uint16_t len);
 int log_walk(struct log *log, log_walk_func_t walk_func,
         void *arg);
+int log_walk_from(struct log *log, int64_t ts, log_walk_func_t walk_func,
+        void *arg);
 int log_flush(struct log *log);
 int log_rtr_erase(struct log *log, void *arg);
 
@@ -187,10 +263,87 @@ int log_rtr_erase(struct log *log, void *arg);
 /* Handler exports */
 int log_cbmem_handler_init(struct log_handler *, struct cbmem *);
 int log_console_handler_init(struct log_handler *);
+int log_rtt_handler_init(struct log_handler *, int chan);
 struct fcb;
 int log_fcb_handler_init(struct log_handler *, struct fcb *,
                          uint8_t entries);
 
+/*
+ * Archive of an FCB log in rotating, compressed files. Every la_period
+ * ticks, sealed FCB sectors (ones which are no longer appended to) are
+ * compressed into <la_path>.0 and then erased, oldest first, until at most
+ * la_keep are left for reading through the log. When <la_path>.0 has grown
+ * to la_file_max bytes, the files are rotated: <la_path>.<la_file_cnt - 1>
+ * is removed and the others renamed up by one. The directory of la_path
+ * must exist.
+ *
+ * A file is a sequence of records, one per log entry: a little-endian
+ * uint16 length of the compressed data which follows, with
+ * LOG_ARCHIVE_REC_RESET set if the dictionary starts over (see util/lz.h).
+ * The dictionary is reset at the start of each sector.
+ */
+#define LOG_ARCHIVE_REC_RESET       0x8000
+#define LOG_ARCHIVE_REC_LEN_MASK    0x7fff
+
+struct log_archive {
+    struct fcb *la_fcb;
+    const char *la_path;
+    uint32_t la_file_max;
+    uint8_t la_file_cnt;
+    uint8_t la_keep;
+    os_time_t la_period;
+    struct os_callout_func la_timer;
+    struct lz_state la_lz;
+};
+
+typedef int (*log_archive_walk_func_t)(void *arg, void *entry, uint16_t len);
+
+int log_archive_start(struct log_archive *, struct os_eventq *evq);
+void log_archive_stop(struct log_archive *);
+int log_archive_run(struct log_archive *);
+int log_archive_walk(struct log_archive *, int file_idx,
+                     log_archive_walk_func_t walk_func, void *arg);
+
+/*
+ * Staging handler. Appends are copied into a ring without taking locks or
+ * blocking, so they can be made from any task or ISR. Entries are moved to
+ * the backing handler by log_stage_drain(), called from a low priority
+ * task when it receives ls_ev.
+ */
+struct log_stage {
+    struct log ls_log;              /* Backing handler */
+    struct os_event ls_ev;          /* Posted when ring becomes non-empty */
+    struct os_eventq *ls_evq;
+    uint8_t *ls_buf;
+    uint16_t ls_size;
+    uint16_t ls_head;
+    uint16_t ls_tail;
+    uint16_t ls_used;
+    uint32_t ls_drops;              /* Entries lost to ring full */
+};
+
+int log_stage_handler_init(struct log_handler *, struct log_stage *,
+                           struct log_handler *backing, void *buf,
+                           uint16_t buf_len, struct os_eventq *evq);
+int log_stage_drain(struct log_stage *);
+
+/*
+ * Fan-out handler. Each append is passed, as the same buffer, to all
+ * child handlers. Reads and walks go to the first child which is not a
+ * stream. Put a staging handler in front of it to dispatch to the children
+ * from the draining task.
+ */
+#define LOG_FANOUT_MAX              (4)
+
+struct log_fanout {
+    struct log lf_logs[LOG_FANOUT_MAX];
+    uint8_t lf_cnt;
+    uint8_t lf_primary;             /* Child used for reads */
+};
+
+int log_fanout_handler_init(struct log_handler *, struct log_fanout *,
+                            struct log_handler **children, int cnt);
+
 /* Private */
 #ifdef NEWTMGR_PRESENT
 int log_nmgr_register_group(void);
@@ -34,6 +34,7 @@
 #endif
 
 static STAILQ_HEAD(, log) g_log_list = STAILQ_HEAD_INITIALIZER(g_log_list);
+uint8_t g_log_module_levels[(LOG_MODULE_MAX + 1) / 2];
 static uint8_t log_inited;
 
 #ifdef SHELL_PRESENT
@@ -95,6 +96,30 @@ log_register(char *name, struct log *log, struct log_handler *lh)
     return (0);
 }
 
+/*
+ * Set the minimum level of messages logged for module. Levels above 15 are
+ * stored as 15.
+ */
+int
+log_level_set(uint16_t module, uint8_t level)
+{
+    uint8_t *levels;
+
+    if (module > LOG_MODULE_MAX) {
+        return OS_EINVAL;
+    }
+    if (level > 0x0f) {
+        level = 0x0f;
+    }
+    levels = &g_log_module_levels[module >> 1];
+    if (module & 1) {
+        *levels = (*levels & 0x0f) | (level << 4);
+    } else {
+        *levels = (*levels & 0xf0) | level;
+    }
+    return 0;
+}
+
 int
 log_append(struct log *log, uint16_t module, uint16_t level, void *data,
         uint16_t len)
@@ -109,6 +134,10 @@ log_append(struct log *log, uint16_t module, uint16_t level, void *data,
         goto err;
     }
 
+    if (level < log_level_get(module)) {
+        return (0);
+    }
+
     ue = (struct log_entry_hdr *) data;
 
     g_log_info.li_index++;
@@ -142,15 +171,13 @@ err:
     return (rc);
 }
 
-void
-log_printf(struct log *log, uint16_t module, uint16_t level, char *msg,
-        ...)
+static void
+log_vprintf(struct log *log, uint16_t module, uint16_t level,
+        const char *msg, va_list args)
 {
-    va_list args;
     char buf[LOG_ENTRY_HDR_SIZE + LOG_PRINTF_MAX_ENTRY_LEN];
     int len;
 
-    va_start(args, msg);
     len = vsnprintf(&buf[LOG_ENTRY_HDR_SIZE], LOG_PRINTF_MAX_ENTRY_LEN, msg,
             args);
     if (len >= LOG_PRINTF_MAX_ENTRY_LEN) {
@@ -160,6 +187,160 @@ log_printf(struct log *log, uint16_t module, uint16_t level, char *msg,
     log_append(log, module, level, (uint8_t *) buf, len);
 }
 
+void
+log_printf(struct log *log, uint16_t module, uint16_t level, char *msg,
+        ...)
+{
+    va_list args;
+
+    if (level < log_level_get(module)) {
+        return;
+    }
+
+    va_start(args, msg);
+    log_vprintf(log, module, level, msg, args);
+    va_end(args);
+}
+
+/*
+ * Log format string and arguments without formatting them. Use through
+ * LOG_DEFERRED(). Stream logs have no later reader, so for them the
+ * message is formatted right away.
+ */
+void
+log_printf_bin(struct log *log, uint16_t module, uint16_t level,
+        const char *msg, int nargs, ...)
+{
+    va_list args;
+    uint8_t buf[LOG_ENTRY_HDR_SIZE + sizeof(struct log_bin_hdr) +
+      LOG_BIN_MAX_ARGS * sizeof(uint32_t)];
+    struct log_bin_hdr lbh;
+    uint32_t arg;
+    int off;
+    int i;
+
+    if (log->l_log == NULL || level < log_level_get(module)) {
+        return;
+    }
+
+    va_start(args, nargs);
+    if (log->l_log->log_type == LOG_TYPE_STREAM) {
+        log_vprintf(log, module, level, msg, args);
+        va_end(args);
+        return;
+    }
+
+    if (nargs > LOG_BIN_MAX_ARGS) {
+        nargs = LOG_BIN_MAX_ARGS;
+    }
+    lbh.lb_magic = LOG_BIN_MAGIC;
+    lbh.lb_nargs = nargs;
+    lbh.lb_fmt = (uintptr_t)msg;
+    memcpy(&buf[LOG_ENTRY_HDR_SIZE], &lbh, sizeof(lbh));
+
+    off = LOG_ENTRY_HDR_SIZE + sizeof(lbh);
+    for (i = 0; i < nargs; i++) {
+        arg = va_arg(args, uint32_t);
+        memcpy(&buf[off], &arg, sizeof(arg));
+        off += sizeof(arg);
+    }
+    va_end(args);
+
+    log_append(log, module, level, buf, off - LOG_ENTRY_HDR_SIZE);
+}
+
+/*
+ * Formats the entry data written by log_printf_bin() to buf. Returns the
+ * length of the resulting string, or -1 if data is not a deferred entry.
+ */
+int
+log_bin_format(const void *data, int len, char *buf, int buf_len)
+{
+    struct log_bin_hdr lbh;
+    const uint8_t *argp;
+    const char *cp;
+    const char *str;
+    char spec[16];
+    uint32_t arg;
+    int argi;
+    int off;
+    int sp;
+    int rc;
+
+    if (len < sizeof(lbh) || buf_len < 1) {
+        return -1;
+    }
+    memcpy(&lbh, data, sizeof(lbh));
+    if (lbh.lb_magic != LOG_BIN_MAGIC || lbh.lb_nargs > LOG_BIN_MAX_ARGS ||
+      len != sizeof(lbh) + lbh.lb_nargs * sizeof(uint32_t)) {
+        return -1;
+    }
+    argp = (const uint8_t *)data + sizeof(lbh);
+
+    off = 0;
+    argi = 0;
+    cp = (const char *)lbh.lb_fmt;
+    while (*cp && off < buf_len - 1) {
+        if (*cp != '%') {
+            buf[off++] = *cp++;
+            continue;
+        }
+        if (cp[1] == '%') {
+            buf[off++] = '%';
+            cp += 2;
+            continue;
+        }
+
+        /*
+         * Copy the conversion spec, leaving out length modifiers as all
+         * arguments are 32 bits.
+         */
+        sp = 0;
+        spec[sp++] = *cp++;
+        while (*cp && !strchr("diouxXcsp", *cp) && sp < sizeof(spec) - 2) {
+            if (!strchr("hlLqjzt", *cp)) {
+                spec[sp++] = *cp;
+            }
+            cp++;
+        }
+        if (!*cp) {
+            break;
+        }
+        spec[sp++] = *cp;
+        spec[sp] = '\0';
+
+        arg = 0;
+        if (argi < lbh.lb_nargs) {
+            memcpy(&arg, argp + argi * sizeof(arg), sizeof(arg));
+            argi++;
+        }
+        if (*cp == 's') {
+            if (sizeof(str) == sizeof(arg)) {
+                str = (const char *)(uintptr_t)arg;
+            } else {
+                str = "?";
+            }
+            rc = snprintf(buf + off, buf_len - off, spec, str);
+        } else if (*cp == 'p') {
+            rc = snprintf(buf + off, buf_len - off, spec,
+              (void *)(uintptr_t)arg);
+        } else {
+            rc = snprintf(buf + off, buf_len - off, spec, arg);
+        }
+        cp++;
+        if (rc < 0) {
+            break;
+        }
+        off += rc;
+        if (off >= buf_len) {
+            off = buf_len - 1;
+        }
+    }
+    buf[off] = '\0';
+
+    return off;
+}
+
 int
 log_walk(struct log *log, log_walk_func_t walk_func, void *arg)
 {
@@ -175,6 +356,20 @@ err:
     return (rc);
 }
 
+/*
+ * Walks log entries, possibly skipping ones older than ts. The walk function
+ * still has to filter entries by timestamp.
+ */
+int
+log_walk_from(struct log *log, int64_t ts, log_walk_func_t walk_func,
+        void *arg)
+{
+    if (!log->l_log->log_walk_from) {
+        return log_walk(log, walk_func, arg);
+    }
+    return log->l_log->log_walk_from(log, ts, walk_func, arg);
+}
+
 int
 log_read(struct log *log, void *dptr, void *buf, uint16_t off,
         uint16_t len)
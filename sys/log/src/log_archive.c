@@ -0,0 +1,308 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#if defined(FCB_PRESENT) && defined(FS_PRESENT)
+#include <stdio.h>
+#include <string.h>
+
+#include <os/os.h>
+
+#include <hal/flash_map.h>
+#include <fcb/fcb.h>
+#include <fs/fs.h>
+#include <util/lz.h>
+
+#include "log/log.h"
+
+#define LOG_ARCHIVE_NAME_MAX        48
+#define LOG_ARCHIVE_READ_BUF_SZ     64
+#define LOG_ARCHIVE_ENTRY_MAX       (LOG_PRINTF_MAX_ENTRY_LEN + \
+                                     LOG_ENTRY_HDR_SIZE)
+#define LOG_ARCHIVE_REC_MAX         (2 + LZ_COMPRESS_BOUND(LOG_ARCHIVE_ENTRY_MAX))
+
+/*
+ * Records are collected and written this much at a time, as every write
+ * becomes a data block in NFFS.
+ */
+#ifndef LOG_ARCHIVE_WRITE_BUF_SZ
+#define LOG_ARCHIVE_WRITE_BUF_SZ    256
+#endif
+
+static void
+log_archive_name(struct log_archive *la, int idx, char *buf)
+{
+    snprintf(buf, LOG_ARCHIVE_NAME_MAX, "%s.%d", la->la_path, idx);
+}
+
+/*
+ * Removes the oldest file, and renames the others up by one.
+ */
+static int
+log_archive_rotate(struct log_archive *la)
+{
+    char from[LOG_ARCHIVE_NAME_MAX];
+    char to[LOG_ARCHIVE_NAME_MAX];
+    int rc;
+    int i;
+
+    log_archive_name(la, la->la_file_cnt - 1, to);
+    rc = fs_unlink(to);
+    if (rc && rc != FS_ENOENT) {
+        return rc;
+    }
+    for (i = la->la_file_cnt - 2; i >= 0; i--) {
+        log_archive_name(la, i, from);
+        log_archive_name(la, i + 1, to);
+        rc = fs_rename(from, to);
+        if (rc && rc != FS_ENOENT) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Number of sectors between the oldest one and the one being appended to.
+ */
+static int
+log_archive_sealed_cnt(struct fcb *fcb)
+{
+    int oldest;
+    int active;
+
+    oldest = fcb->f_oldest - fcb->f_sectors;
+    active = fcb->f_active.fe_area - fcb->f_sectors;
+    return (active - oldest + fcb->f_sector_cnt) % fcb->f_sector_cnt;
+}
+
+/*
+ * Compresses the entries of a sector, and appends them to the newest file.
+ */
+static int
+log_archive_sector(struct log_archive *la, struct flash_area *fa)
+{
+    char name[LOG_ARCHIVE_NAME_MAX];
+    uint8_t buf[LOG_ARCHIVE_READ_BUF_SZ];
+    uint8_t data[LOG_ARCHIVE_ENTRY_MAX];
+    uint8_t wbuf[LOG_ARCHIVE_WRITE_BUF_SZ + LOG_ARCHIVE_REC_MAX];
+    struct fcb_cursor cur;
+    struct fs_file *file;
+    uint32_t flen;
+    uint16_t hdr;
+    int wlen;
+    int len;
+    int rc;
+
+    log_archive_name(la, 0, name);
+    rc = fs_open(name, FS_ACCESS_WRITE | FS_ACCESS_APPEND, &file);
+    if (rc) {
+        return rc;
+    }
+    rc = fs_filelen(file, &flen);
+    if (rc == 0 && flen >= la->la_file_max) {
+        fs_close(file);
+        rc = log_archive_rotate(la);
+        if (rc) {
+            return rc;
+        }
+        rc = fs_open(name, FS_ACCESS_WRITE | FS_ACCESS_TRUNCATE, &file);
+    }
+    if (rc) {
+        return rc;
+    }
+
+    lz_init(&la->la_lz);
+    hdr = LOG_ARCHIVE_REC_RESET;
+    wlen = 0;
+
+    fcb_cursor_init(&cur, fa, buf, sizeof(buf), 0);
+    while (fcb_cursor_next(la->la_fcb, &cur) == 0) {
+        len = cur.fc_entry.fe_data_len;
+        if (len > sizeof(data)) {
+            len = sizeof(data);
+        }
+        len = fcb_cursor_read(&cur, 0, data, len);
+        len = lz_compress(&la->la_lz, data, len, wbuf + wlen + 2,
+                          LOG_ARCHIVE_REC_MAX - 2);
+        if (len < 0) {
+            rc = OS_ENOMEM;
+            break;
+        }
+        hdr |= len;
+        wbuf[wlen] = hdr;
+        wbuf[wlen + 1] = hdr >> 8;
+        wlen += len + 2;
+        hdr = 0;
+
+        if (wlen >= LOG_ARCHIVE_WRITE_BUF_SZ) {
+            rc = fs_write(file, wbuf, wlen);
+            if (rc) {
+                break;
+            }
+            wlen = 0;
+        }
+    }
+    if (rc == 0 && wlen) {
+        rc = fs_write(file, wbuf, wlen);
+    }
+
+    fs_close(file);
+    return rc;
+}
+
+/**
+ * Archives sealed sectors until at most la_keep of them are left in the
+ * FCB. Called periodically once log_archive_start() has been called.
+ *
+ * @return                      0 on success; file system or FCB error
+ *                                  otherwise.
+ */
+int
+log_archive_run(struct log_archive *la)
+{
+    struct flash_area *oldest;
+    int rc;
+
+    while (log_archive_sealed_cnt(la->la_fcb) > la->la_keep) {
+        oldest = la->la_fcb->f_oldest;
+        rc = log_archive_sector(la, oldest);
+        if (rc) {
+            return rc;
+        }
+
+        /* A full FCB may have rotated the sector out in the meantime. */
+        if (la->la_fcb->f_oldest == oldest) {
+            rc = fcb_rotate(la->la_fcb);
+            if (rc) {
+                return rc;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Calls walk_func with every entry in an archive file, oldest first. The
+ * entry is as it was stored in the log, starting with its
+ * struct log_entry_hdr.
+ *
+ * @param file_idx              Which file; 0 is the newest.
+ *
+ * @return                      0 on success, or the nonzero return code of
+ *                                  walk_func; OS_EINVAL if the file is
+ *                                  corrupt; file system error otherwise.
+ */
+int
+log_archive_walk(struct log_archive *la, int file_idx,
+                 log_archive_walk_func_t walk_func, void *arg)
+{
+    char name[LOG_ARCHIVE_NAME_MAX];
+    uint8_t data[LOG_ARCHIVE_ENTRY_MAX];
+    uint8_t rec[LOG_ARCHIVE_REC_MAX];
+    struct lz_state lz;
+    struct fs_file *file;
+    uint32_t got;
+    uint16_t hdr;
+    int len;
+    int rc;
+
+    log_archive_name(la, file_idx, name);
+    rc = fs_open(name, FS_ACCESS_READ, &file);
+    if (rc) {
+        return rc;
+    }
+
+    lz_init(&lz);
+    while (1) {
+        rc = fs_read(file, 2, rec, &got);
+        if (rc || got == 0) {
+            break;
+        }
+        hdr = rec[0] | (rec[1] << 8);
+        len = hdr & LOG_ARCHIVE_REC_LEN_MASK;
+        if (got != 2 || len > sizeof(rec)) {
+            rc = OS_EINVAL;
+            break;
+        }
+        rc = fs_read(file, len, rec, &got);
+        if (rc == 0 && got != len) {
+            rc = OS_EINVAL;
+        }
+        if (rc) {
+            break;
+        }
+
+        if (hdr & LOG_ARCHIVE_REC_RESET) {
+            lz_init(&lz);
+        }
+        len = lz_decompress(&lz, rec, len, data, sizeof(data));
+        if (len < 0) {
+            rc = OS_EINVAL;
+            break;
+        }
+        rc = walk_func(arg, data, len);
+        if (rc) {
+            break;
+        }
+    }
+
+    fs_close(file);
+    return rc;
+}
+
+static void
+log_archive_tmo(void *arg)
+{
+    struct log_archive *la;
+
+    la = arg;
+    log_archive_run(la);
+    os_callout_reset(&la->la_timer.cf_c, la->la_period);
+}
+
+/**
+ * Starts periodic archival. la_fcb, la_path, la_file_max, la_file_cnt,
+ * la_keep and la_period must be filled in.
+ *
+ * @param evq                   Queue to archive from.
+ *
+ * @return                      0 on success; OS_EINVAL if the configuration
+ *                                  is not valid.
+ */
+int
+log_archive_start(struct log_archive *la, struct os_eventq *evq)
+{
+    if (la->la_period == 0 || la->la_file_cnt == 0 ||
+      strlen(la->la_path) + 5 > LOG_ARCHIVE_NAME_MAX) {
+        return OS_EINVAL;
+    }
+
+    os_callout_func_init(&la->la_timer, evq, log_archive_tmo, la);
+    return os_callout_reset(&la->la_timer.cf_c, la->la_period);
+}
+
+/**
+ * Stops periodic archival.
+ */
+void
+log_archive_stop(struct log_archive *la)
+{
+    os_callout_stop(&la->la_timer.cf_c);
+}
+
+#endif
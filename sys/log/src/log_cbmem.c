@@ -18,6 +18,7 @@
  */
 
 #include <os/os.h>
+#include <string.h>
 
 #include <util/cbmem.h>
 
@@ -58,11 +59,33 @@ log_cbmem_read(struct log *log, void *dptr, void *buf, uint16_t offset,
     return (rc);
 }
 
+/*
+ * Walks entries from the iterator onwards. Caller holds the cbmem lock.
+ */
+static void
+log_cbmem_walk_iter(struct log *log, struct cbmem *cbmem,
+        struct cbmem_iter *iter, log_walk_func_t walk_func, void *arg)
+{
+    struct cbmem_entry_hdr *hdr;
+    int rc;
+
+    while (1) {
+        hdr = cbmem_iter_next(cbmem, iter);
+        if (!hdr) {
+            break;
+        }
+
+        rc = walk_func(log, arg, (void *)hdr, hdr->ceh_len);
+        if (rc == 1) {
+            break;
+        }
+    }
+}
+
 static int
 log_cbmem_walk(struct log *log, log_walk_func_t walk_func, void *arg)
 {
     struct cbmem *cbmem;
-    struct cbmem_entry_hdr *hdr;
     struct cbmem_iter iter;
     int rc;
 
@@ -74,18 +97,58 @@ log_cbmem_walk(struct log *log, log_walk_func_t walk_func, void *arg)
     }
 
     cbmem_iter_start(cbmem, &iter);
+    log_cbmem_walk_iter(log, cbmem, &iter, walk_func, arg);
+
+    rc = cbmem_lock_release(cbmem);
+    if (rc != 0) {
+        goto err;
+    }
+
+    return (0);
+err:
+    return (rc);
+}
+
+/*
+ * Searches back from the newest entry for the oldest one with timestamp
+ * ts or later, and walks from there; the cost is proportional to the number
+ * of entries walked.
+ */
+static int
+log_cbmem_walk_from(struct log *log, int64_t ts, log_walk_func_t walk_func,
+        void *arg)
+{
+    struct cbmem *cbmem;
+    struct cbmem_entry_hdr *hdr;
+    struct cbmem_entry_hdr *first;
+    struct cbmem_iter iter;
+    struct log_entry_hdr ueh;
+    int rc;
+
+    cbmem = (struct cbmem *) log->l_log->log_arg;
+
+    rc = cbmem_lock_acquire(cbmem);
+    if (rc != 0) {
+        goto err;
+    }
+
+    first = NULL;
+    cbmem_iter_start_rev(cbmem, &iter);
     while (1) {
-        hdr = cbmem_iter_next(cbmem, &iter);
-        if (!hdr) {
+        hdr = cbmem_iter_prev(cbmem, &iter);
+        if (!hdr || hdr->ceh_len < sizeof(ueh)) {
             break;
         }
-
-        rc = walk_func(log, arg, (void *)hdr, hdr->ceh_len);
-        if (rc == 1) {
+        memcpy(&ueh, hdr + 1, sizeof(ueh));
+        if (ueh.ue_ts < ts) {
             break;
         }
+        first = hdr;
     }
 
+    cbmem_iter_start_at(cbmem, &iter, first);
+    log_cbmem_walk_iter(log, cbmem, &iter, walk_func, arg);
+
     rc = cbmem_lock_release(cbmem);
     if (rc != 0) {
         goto err;
@@ -121,6 +184,7 @@ log_cbmem_handler_init(struct log_handler *handler, struct cbmem *cbmem)
     handler->log_read = log_cbmem_read;
     handler->log_append = log_cbmem_append;
     handler->log_walk = log_cbmem_walk;
+    handler->log_walk_from = log_cbmem_walk_from;
     handler->log_flush = log_cbmem_flush;
     handler->log_arg = (void *) cbmem;
     handler->log_rtr_erase = NULL;
@@ -76,6 +76,7 @@ log_console_handler_init(struct log_handler *handler)
     handler->log_read = log_console_read;
     handler->log_append = log_console_append;
     handler->log_walk = log_console_walk;
+    handler->log_walk_from = NULL;
     handler->log_flush = log_console_flush;
     handler->log_arg = NULL;
     handler->log_rtr_erase = NULL;
@@ -0,0 +1,165 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <os/os.h>
+
+#include <string.h>
+
+#include "log/log.h"
+
+static int
+log_fanout_append(struct log *log, void *buf, int len)
+{
+    struct log_fanout *lf;
+    struct log *child;
+    int rc;
+    int rc2;
+    int i;
+
+    lf = (struct log_fanout *)log->l_log->log_arg;
+
+    rc = 0;
+    for (i = 0; i < lf->lf_cnt; i++) {
+        child = &lf->lf_logs[i];
+        rc2 = child->l_log->log_append(child, buf, len);
+        if (!rc) {
+            rc = rc2;
+        }
+    }
+    return (rc);
+}
+
+static int
+log_fanout_read(struct log *log, void *dptr, void *buf, uint16_t offset,
+        uint16_t len)
+{
+    struct log_fanout *lf;
+    struct log *child;
+
+    lf = (struct log_fanout *)log->l_log->log_arg;
+    child = &lf->lf_logs[lf->lf_primary];
+
+    return child->l_log->log_read(child, dptr, buf, offset, len);
+}
+
+static int
+log_fanout_walk(struct log *log, log_walk_func_t walk_func, void *arg)
+{
+    struct log_fanout *lf;
+    struct log *child;
+
+    lf = (struct log_fanout *)log->l_log->log_arg;
+    child = &lf->lf_logs[lf->lf_primary];
+
+    return child->l_log->log_walk(child, walk_func, arg);
+}
+
+static int
+log_fanout_walk_from(struct log *log, int64_t ts, log_walk_func_t walk_func,
+        void *arg)
+{
+    struct log_fanout *lf;
+
+    lf = (struct log_fanout *)log->l_log->log_arg;
+
+    return log_walk_from(&lf->lf_logs[lf->lf_primary], ts, walk_func, arg);
+}
+
+static int
+log_fanout_flush(struct log *log)
+{
+    struct log_fanout *lf;
+    struct log *child;
+    int rc;
+    int rc2;
+    int i;
+
+    lf = (struct log_fanout *)log->l_log->log_arg;
+
+    rc = 0;
+    for (i = 0; i < lf->lf_cnt; i++) {
+        child = &lf->lf_logs[i];
+        if (child->l_log->log_flush) {
+            rc2 = child->l_log->log_flush(child);
+            if (!rc) {
+                rc = rc2;
+            }
+        }
+    }
+    return (rc);
+}
+
+static int
+log_fanout_rtr_erase(struct log *log, void *arg)
+{
+    struct log_fanout *lf;
+    struct log *child;
+
+    lf = (struct log_fanout *)log->l_log->log_arg;
+    child = &lf->lf_logs[lf->lf_primary];
+
+    return child->l_log->log_rtr_erase(child, arg);
+}
+
+/**
+ * Initializes a handler which forwards entries to several handlers.
+ *
+ * @param handler               The fan-out handler to initialize.
+ * @param lf                    Fan-out state.
+ * @param children              Initialized child handlers.
+ * @param cnt                   Number of children, up to LOG_FANOUT_MAX.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+log_fanout_handler_init(struct log_handler *handler, struct log_fanout *lf,
+                        struct log_handler **children, int cnt)
+{
+    struct log_handler *primary;
+    int i;
+
+    if (cnt <= 0 || cnt > LOG_FANOUT_MAX) {
+        return (OS_EINVAL);
+    }
+
+    memset(lf, 0, sizeof(*lf));
+    for (i = cnt - 1; i >= 0; i--) {
+        lf->lf_logs[i].l_log = children[i];
+        if (children[i]->log_type != LOG_TYPE_STREAM) {
+            lf->lf_primary = i;
+        }
+    }
+    lf->lf_cnt = cnt;
+    primary = children[lf->lf_primary];
+
+    handler->log_type = primary->log_type;
+    handler->log_read = log_fanout_read;
+    handler->log_append = log_fanout_append;
+    handler->log_walk = log_fanout_walk;
+    handler->log_walk_from = log_fanout_walk_from;
+    handler->log_flush = log_fanout_flush;
+    if (primary->log_rtr_erase) {
+        handler->log_rtr_erase = log_fanout_rtr_erase;
+    } else {
+        handler->log_rtr_erase = NULL;
+    }
+    handler->log_arg = lf;
+
+    return (0);
+}
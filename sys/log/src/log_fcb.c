@@ -26,6 +26,8 @@
 
 #include "log/log.h"
 
+#define LOG_FCB_WALK_BUF_SZ	64
+
 static struct flash_area sector;
 struct fcb_log {
     uint8_t fl_entries;
@@ -69,6 +71,7 @@ log_fcb_append(struct log *log, void *buf, int len)
 
     rc = flash_area_write(loc.fe_area, loc.fe_data_off, buf, len);
     if (rc) {
+        fcb_append_abort(fcb, &loc);
         goto err;
     }
 
@@ -98,20 +101,27 @@ log_fcb_read(struct log *log, void *dptr, void *buf, uint16_t offset,
     }
 }
 
+/*
+ * Calls walk_func for entries following start.
+ */
 static int
-log_fcb_walk(struct log *log, log_walk_func_t walk_func, void *arg)
+log_fcb_walk_loc(struct log *log, struct fcb_entry *start,
+  log_walk_func_t walk_func, void *arg)
 {
     struct fcb *fcb;
-    struct fcb_entry loc;
+    struct fcb_cursor cur;
+    uint8_t buf[LOG_FCB_WALK_BUF_SZ];
     int rc;
 
     rc = 0;
     fcb = ((struct fcb_log *)log->l_log->log_arg)->fl_fcb;
 
-    memset(&loc, 0, sizeof(loc));
+    fcb_cursor_init(&cur, NULL, buf, sizeof(buf), 0);
+    cur.fc_entry = *start;
 
-    while (fcb_getnext(fcb, &loc) == 0) {
-        rc = walk_func(log, arg, (void *) &loc, loc.fe_data_len);
+    while (fcb_cursor_next(fcb, &cur) == 0) {
+        rc = walk_func(log, arg, (void *) &cur.fc_entry,
+          cur.fc_entry.fe_data_len);
         if (rc) {
             break;
         }
@@ -119,6 +129,50 @@ log_fcb_walk(struct log *log, log_walk_func_t walk_func, void *arg)
     return (rc);
 }
 
+static int
+log_fcb_walk(struct log *log, log_walk_func_t walk_func, void *arg)
+{
+    struct fcb_entry loc;
+
+    memset(&loc, 0, sizeof(loc));
+    return log_fcb_walk_loc(log, &loc, walk_func, arg);
+}
+
+/*
+ * Compares the timestamp at the start of an entry against the target.
+ */
+static int
+log_fcb_ts_cmp(const uint8_t *key, void *arg)
+{
+    int64_t ts;
+
+    memcpy(&ts, key, sizeof(ts));
+    if (ts < *(int64_t *)arg) {
+        return -1;
+    }
+    return ts > *(int64_t *)arg;
+}
+
+/*
+ * Uses the FCB sector index, if there is one, to start the walk from the
+ * sector holding entries with timestamp ts.
+ */
+static int
+log_fcb_walk_from(struct log *log, int64_t ts, log_walk_func_t walk_func,
+  void *arg)
+{
+    struct fcb *fcb;
+    struct fcb_entry loc;
+
+    fcb = ((struct fcb_log *)log->l_log->log_arg)->fl_fcb;
+
+    memset(&loc, 0, sizeof(loc));
+    if (fcb_seek_key(fcb, log_fcb_ts_cmp, &ts, &loc)) {
+        memset(&loc, 0, sizeof(loc));
+    }
+    return log_fcb_walk_loc(log, &loc, walk_func, arg);
+}
+
 static int
 log_fcb_flush(struct log *log)
 {
@@ -283,6 +337,7 @@ log_fcb_handler_init(struct log_handler *handler, struct fcb *fcb, uint8_t entri
     handler->log_read = log_fcb_read;
     handler->log_append = log_fcb_append;
     handler->log_walk = log_fcb_walk;
+    handler->log_walk_from = log_fcb_walk_from;
     handler->log_flush = log_fcb_flush;
     handler->log_rtr_erase = log_fcb_rtr_erase;
     fcb_log.fl_entries = entries;
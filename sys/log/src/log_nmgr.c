@@ -56,7 +56,10 @@ struct encode_off {
     struct json_encoder *eo_encoder;
     int64_t eo_ts;
     uint8_t eo_index;
+    uint8_t eo_more;            /* Stopped before end of log */
+    uint8_t eo_sent;            /* Entries encoded in this response */
     uint32_t rsp_len;
+    uint32_t eo_max_len;        /* Response size limit */
 };
 
 /**
@@ -70,6 +73,8 @@ log_nmgr_encode_entry(struct log *log, void *arg, void *dptr, uint16_t len)
     struct encode_off *encode_off = (struct encode_off *)arg;
     struct log_entry_hdr ueh;
     char data[128];
+    char text[128];
+    char *msg;
     int dlen;
     struct json_value jv;
     int rc;
@@ -98,9 +103,17 @@ log_nmgr_encode_entry(struct log *log, void *arg, void *dptr, uint16_t len)
     }
     data[rc] = 0;
 
+    /* Deferred entries are formatted here */
+    msg = data;
+    dlen = log_bin_format(data, rc, text, sizeof(text));
+    if (dlen >= 0) {
+        msg = text;
+        rc = dlen;
+    }
+
     rsp_len = encode_off->rsp_len;
     /* Calculating entry len */
-    rsp_len += strlen(data);
+    rsp_len += strlen(msg);
 
     /* Pre calculating MAX length of the json string */
     rsp_len += (sizeof(STR(INT64_MAX))  + sizeof("{,ts:")    +
@@ -108,14 +121,20 @@ log_nmgr_encode_entry(struct log *log, void *arg, void *dptr, uint16_t len)
                 sizeof(STR(UINT32_MAX)) + sizeof(",index:")  +
                 sizeof(STR(UINT16_MAX)) + sizeof(",module:}"));
 
-    if (rsp_len > NMGR_MAX_MTU) {
-        rc = OS_ENOMEM;
+    if (rsp_len > NMGR_MAX_MTU ||
+        (rsp_len > encode_off->eo_max_len && encode_off->eo_sent)) {
+        /*
+         * Page is full; the client continues from the last entry sent.
+         * At least one entry is sent so that a read always progresses.
+         */
+        encode_off->eo_more = 1;
+        rc = 1;
         goto err;
     }
 
     json_encode_object_start(encode_off->eo_encoder);
 
-    JSON_VALUE_STRINGN(&jv, data, rc);
+    JSON_VALUE_STRINGN(&jv, msg, rc);
     rc = json_encode_object_entry(encode_off->eo_encoder, "msg", &jv);
     if (rc) {
         goto err;
@@ -146,7 +165,10 @@ log_nmgr_encode_entry(struct log *log, void *arg, void *dptr, uint16_t len)
     }
 
     json_encode_object_finish(encode_off->eo_encoder);
-    encode_off->rsp_len += rsp_len;
+    encode_off->rsp_len = rsp_len;
+    encode_off->eo_ts = ueh.ue_ts;
+    encode_off->eo_index = ueh.ue_index;
+    encode_off->eo_sent = 1;
 
     return (0);
 err:
@@ -155,23 +177,23 @@ err:
 
 /**
  * Log encode entries
- * @param log structure, the encoder, timestamp, index
+ * @param log structure, the encoder, encode state with the resume point
  * @return 0 on success; non-zero on failure
  */
 static int
 log_encode_entries(struct log *log, struct json_encoder *encoder,
-                   int64_t ts, uint32_t index)
+                   struct encode_off *encode_off)
 {
     int rc;
-    struct encode_off encode_off;
     int rsp_len;
 
-    memset(&encode_off, 0, sizeof(encode_off));
     /* Already encoded json string */
     rsp_len = strlen(encoder->je_encode_buf);
-    /* Pre calculating json length */
+    /* Pre calculating json length, including the resume point */
     rsp_len += (sizeof("entries") + 3);
-    rsp_len += encode_off.rsp_len;
+    rsp_len += (sizeof(",more:false") + sizeof(",next_ts:") +
+                sizeof(STR(INT64_MAX)) + sizeof(",next_index:") +
+                sizeof(STR(UINT8_MAX)));
 
     if (rsp_len > NMGR_MAX_MTU) {
         rc = OS_ENOMEM;
@@ -181,13 +203,14 @@ log_encode_entries(struct log *log, struct json_encoder *encoder,
     json_encode_array_name(encoder, "entries");
     json_encode_array_start(encoder);
 
-    encode_off.eo_encoder  = encoder;
-    encode_off.eo_index    = index;
-    encode_off.eo_ts       = ts;
-
-    encode_off.rsp_len = rsp_len;
+    encode_off->eo_encoder = encoder;
+    encode_off->rsp_len = rsp_len;
 
-    rc = log_walk(log, log_nmgr_encode_entry, &encode_off);
+    rc = log_walk_from(log, encode_off->eo_ts, log_nmgr_encode_entry,
+                       encode_off);
+    if (encode_off->eo_more) {
+        rc = 0;
+    }
     json_encode_array_finish(encoder);
 
 err:
@@ -196,13 +219,12 @@ err:
 
 /**
  * Log encode function
- * @param log structure, the encoder, json_value,
- *        timestamp, index
+ * @param log structure, the encoder, json_value, encode state
  * @return 0 on success; non-zero on failure
  */
 static int
 log_encode(struct log *log, struct json_encoder *encoder,
-           struct json_value *jv, int64_t ts, uint32_t index)
+           struct json_value *jv, struct encode_off *encode_off)
 {
     int rc;
 
@@ -213,7 +235,16 @@ log_encode(struct log *log, struct json_encoder *encoder,
     JSON_VALUE_UINT(jv, log->l_log->log_type);
     json_encode_object_entry(encoder, "type", jv);
 
-    rc = log_encode_entries(log, encoder, ts, index);
+    rc = log_encode_entries(log, encoder, encode_off);
+    if (rc == 0) {
+        /* Where the next read should continue from */
+        JSON_VALUE_BOOL(jv, encode_off->eo_more);
+        json_encode_object_entry(encoder, "more", jv);
+        JSON_VALUE_INT(jv, encode_off->eo_ts);
+        json_encode_object_entry(encoder, "next_ts", jv);
+        JSON_VALUE_UINT(jv, encode_off->eo_index);
+        json_encode_object_entry(encoder, "next_index", jv);
+    }
     json_encode_object_finish(encoder);
 
     return rc;
@@ -235,8 +266,11 @@ log_nmgr_read(struct nmgr_jbuf *njb)
     int name_len;
     int64_t ts;
     uint64_t index;
+    uint64_t max_len;
+    struct encode_off encode_off;
+    uint8_t sent;
 
-    const struct json_attr_t attr[4] = {
+    const struct json_attr_t attr[5] = {
         [0] = {
             .attribute = "log_name",
             .type = t_string,
@@ -254,6 +288,11 @@ log_nmgr_read(struct nmgr_jbuf *njb)
             .addr.uinteger = &index
         },
         [3] = {
+            .attribute = "max_len",
+            .type = t_uinteger,
+            .addr.uinteger = &max_len
+        },
+        [4] = {
             .attribute = NULL
         }
     };
@@ -270,6 +309,7 @@ log_nmgr_read(struct nmgr_jbuf *njb)
     json_encode_array_start(encoder);
 
     name_len = strlen(name);
+    encode_off.eo_sent = 0;
     log = NULL;
     while (1) {
         log = log_list_get_next(log);
@@ -286,13 +326,23 @@ log_nmgr_read(struct nmgr_jbuf *njb)
             continue;
         }
 
-        rc = log_encode(log, encoder, &jv, ts, index);
+        sent = encode_off.eo_sent;
+        memset(&encode_off, 0, sizeof(encode_off));
+        encode_off.eo_sent = sent;
+        encode_off.eo_ts = ts;
+        encode_off.eo_index = index;
+        encode_off.eo_max_len = NMGR_MAX_MTU;
+        if (max_len && max_len < NMGR_MAX_MTU) {
+            encode_off.eo_max_len = max_len;
+        }
+
+        rc = log_encode(log, encoder, &jv, &encode_off);
         if (rc) {
             goto err;
         }
 
-        /* If a log was found, encode and break */
-        if (name_len > 0) {
+        /* If a log was found, or the page is full, break */
+        if (name_len > 0 || encode_off.eo_more) {
             break;
         }
     }
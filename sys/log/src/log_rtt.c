@@ -0,0 +1,116 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef RTT_PRESENT
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <os/os.h>
+#include <rtt/rtt.h>
+
+#include "log/log.h"
+
+/*
+ * Log entries are written as text to an RTT up channel.  An entry which
+ * does not fit in the ring is dropped whole, so that what the probe reads
+ * is never a partial line.
+ */
+static int
+log_rtt_append(struct log *log, void *buf, int len)
+{
+    struct log_entry_hdr *hdr;
+    char prefix[48];
+    int plen;
+    int chan;
+    int rc;
+    os_sr_t sr;
+
+    chan = (intptr_t)log->l_log->log_arg;
+    hdr = (struct log_entry_hdr *) buf;
+    len -= LOG_ENTRY_HDR_SIZE;
+
+    plen = snprintf(prefix, sizeof(prefix), "[ts=%lussb, mod=%u level=%u] ",
+            (unsigned long) hdr->ue_ts, hdr->ue_module, hdr->ue_level);
+
+    OS_ENTER_CRITICAL(sr);
+    rc = rtt_space(chan);
+    if (rc >= plen + len) {
+        rtt_write(chan, prefix, plen);
+        rtt_write(chan, (char *) buf + LOG_ENTRY_HDR_SIZE, len);
+        rc = 0;
+    } else if (rc >= 0) {
+        rc = OS_ENOMEM;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    return (rc);
+}
+
+static int
+log_rtt_read(struct log *log, void *dptr, void *buf, uint16_t offset,
+        uint16_t len)
+{
+    /* Entries are gone once written; the probe has them. */
+    return (OS_EINVAL);
+}
+
+static int
+log_rtt_walk(struct log *log, log_walk_func_t walk_func, void *arg)
+{
+    return (OS_EINVAL);
+}
+
+static int
+log_rtt_flush(struct log *log)
+{
+    return (OS_EINVAL);
+}
+
+/**
+ * Sets up a log handler writing to an RTT up channel.  Channel 0 is shared
+ * with the RTT console, if there is one; channels other than 0 must have
+ * been set up with rtt_up_config() first.
+ */
+int
+log_rtt_handler_init(struct log_handler *handler, int chan)
+{
+    int rc;
+
+    rc = rtt_init();
+    if (rc != 0) {
+        return (rc);
+    }
+    if (rtt_space(chan) < 0) {
+        return (OS_EINVAL);
+    }
+
+    handler->log_type = LOG_TYPE_STREAM;
+    handler->log_read = log_rtt_read;
+    handler->log_append = log_rtt_append;
+    handler->log_walk = log_rtt_walk;
+    handler->log_walk_from = NULL;
+    handler->log_flush = log_rtt_flush;
+    handler->log_arg = (void *)(intptr_t) chan;
+    handler->log_rtr_erase = NULL;
+
+    return (0);
+}
+
+#endif
@@ -41,6 +41,8 @@ shell_log_dump_entry(struct log *log, void *arg, void *dptr, uint16_t len)
 {
     struct log_entry_hdr ueh;
     char data[128];
+    char text[128];
+    char *msg;
     int dlen;
     int rc;
 
@@ -57,11 +59,16 @@ shell_log_dump_entry(struct log *log, void *arg, void *dptr, uint16_t len)
     }
     data[rc] = 0;
 
+    msg = data;
+    if (log_bin_format(data, rc, text, sizeof(text)) >= 0) {
+        msg = text;
+    }
+
     /* XXX: This is evil.  newlib printf does not like 64-bit 
      * values, and this causes memory to be overwritten.  Cast to a 
      * unsigned 32-bit value for now.
      */
-    console_printf("[%lu] %s\n", (unsigned long) ueh.ue_ts, data);
+    console_printf("[%lu] %s\n", (unsigned long) ueh.ue_ts, msg);
 
     return (0);
 err:
@@ -0,0 +1,250 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <os/os.h>
+
+#include <string.h>
+
+#include "log/log.h"
+
+/*
+ * Ring entry header. Entries are 4 byte aligned; a pad entry fills the end
+ * of the ring when the next entry does not fit there.
+ */
+struct log_stage_hdr {
+    uint16_t lsh_len;
+    volatile uint8_t lsh_state;
+    uint8_t _pad;
+};
+
+#define LOG_STAGE_RESERVED  (0)     /* Being copied in */
+#define LOG_STAGE_READY     (1)
+#define LOG_STAGE_PAD       (2)
+
+#define LOG_STAGE_ALIGN(len)    (((len) + 3) & ~3)
+
+/*
+ * Entry contents must be written before the entry is marked ready, and read
+ * only after it has been seen as ready.
+ */
+#define LOG_STAGE_BARRIER()     __asm__ volatile("" ::: "memory")
+
+static int
+log_stage_append(struct log *log, void *buf, int len)
+{
+    struct log_stage *ls;
+    struct log_stage_hdr *hdr;
+    os_sr_t sr;
+    int contig;
+    int need;
+
+    ls = (struct log_stage *)log->l_log->log_arg;
+    need = LOG_STAGE_ALIGN(sizeof(*hdr) + len);
+
+    OS_ENTER_CRITICAL(sr);
+    contig = ls->ls_size - ls->ls_head;
+    if (need > contig) {
+        if (ls->ls_used + contig + need > ls->ls_size) {
+            goto full;
+        }
+        hdr = (struct log_stage_hdr *)&ls->ls_buf[ls->ls_head];
+        hdr->lsh_len = contig;
+        hdr->lsh_state = LOG_STAGE_PAD;
+        ls->ls_used += contig;
+        ls->ls_head = 0;
+    } else if (ls->ls_used + need > ls->ls_size) {
+        goto full;
+    }
+    hdr = (struct log_stage_hdr *)&ls->ls_buf[ls->ls_head];
+    hdr->lsh_len = need;
+    hdr->lsh_state = LOG_STAGE_RESERVED;
+    ls->ls_used += need;
+    ls->ls_head += need;
+    if (ls->ls_head == ls->ls_size) {
+        ls->ls_head = 0;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    /*
+     * Space is reserved; copy with interrupts enabled.
+     */
+    memcpy(hdr + 1, buf, len);
+    hdr->lsh_len = sizeof(*hdr) + len;
+    LOG_STAGE_BARRIER();
+    hdr->lsh_state = LOG_STAGE_READY;
+
+    if (ls->ls_evq) {
+        os_eventq_put(ls->ls_evq, &ls->ls_ev);
+    }
+    return 0;
+full:
+    ls->ls_drops++;
+    OS_EXIT_CRITICAL(sr);
+    return OS_ENOMEM;
+}
+
+/**
+ * Moves staged entries to the backing handler. Stops at the first entry
+ * which is still being written; it will be drained on the next call.
+ *
+ * @param ls                    The staging handler state.
+ *
+ * @return                      0 on success; nonzero on backing handler
+ *                                  failure.
+ */
+int
+log_stage_drain(struct log_stage *ls)
+{
+    struct log_stage_hdr *hdr;
+    os_sr_t sr;
+    int need;
+    int rc;
+
+    rc = 0;
+    while (1) {
+        OS_ENTER_CRITICAL(sr);
+        if (ls->ls_used == 0) {
+            OS_EXIT_CRITICAL(sr);
+            break;
+        }
+        hdr = (struct log_stage_hdr *)&ls->ls_buf[ls->ls_tail];
+        if (hdr->lsh_state == LOG_STAGE_PAD) {
+            ls->ls_used -= hdr->lsh_len;
+            ls->ls_tail = 0;
+            OS_EXIT_CRITICAL(sr);
+            continue;
+        }
+        OS_EXIT_CRITICAL(sr);
+        if (hdr->lsh_state != LOG_STAGE_READY) {
+            break;
+        }
+        LOG_STAGE_BARRIER();
+
+        rc = ls->ls_log.l_log->log_append(&ls->ls_log, hdr + 1,
+          hdr->lsh_len - sizeof(*hdr));
+
+        need = LOG_STAGE_ALIGN(hdr->lsh_len);
+        OS_ENTER_CRITICAL(sr);
+        ls->ls_used -= need;
+        ls->ls_tail += need;
+        if (ls->ls_tail == ls->ls_size) {
+            ls->ls_tail = 0;
+        }
+        OS_EXIT_CRITICAL(sr);
+        if (rc) {
+            break;
+        }
+    }
+    return rc;
+}
+
+static int
+log_stage_read(struct log *log, void *dptr, void *buf, uint16_t offset,
+        uint16_t len)
+{
+    struct log_stage *ls;
+
+    ls = (struct log_stage *)log->l_log->log_arg;
+    return ls->ls_log.l_log->log_read(&ls->ls_log, dptr, buf, offset, len);
+}
+
+static int
+log_stage_walk(struct log *log, log_walk_func_t walk_func, void *arg)
+{
+    struct log_stage *ls;
+
+    ls = (struct log_stage *)log->l_log->log_arg;
+    return ls->ls_log.l_log->log_walk(&ls->ls_log, walk_func, arg);
+}
+
+static int
+log_stage_walk_from(struct log *log, int64_t ts, log_walk_func_t walk_func,
+        void *arg)
+{
+    struct log_stage *ls;
+
+    ls = (struct log_stage *)log->l_log->log_arg;
+    return log_walk_from(&ls->ls_log, ts, walk_func, arg);
+}
+
+static int
+log_stage_flush(struct log *log)
+{
+    struct log_stage *ls;
+
+    ls = (struct log_stage *)log->l_log->log_arg;
+    return ls->ls_log.l_log->log_flush(&ls->ls_log);
+}
+
+static int
+log_stage_rtr_erase(struct log *log, void *arg)
+{
+    struct log_stage *ls;
+
+    ls = (struct log_stage *)log->l_log->log_arg;
+    return ls->ls_log.l_log->log_rtr_erase(&ls->ls_log, arg);
+}
+
+/**
+ * Initializes a staging handler in front of an already initialized
+ * backing handler.
+ *
+ * @param handler               The staging handler to initialize.
+ * @param ls                    Staging state.
+ * @param backing               Handler the entries are drained into.
+ * @param buf                   Ring buffer, 4 byte aligned.
+ * @param buf_len               Size of the ring, a multiple of 4.
+ * @param evq                   Queue of the draining task; ls_ev is posted
+ *                                  there with ev_arg pointing to ls. May
+ *                                  be NULL if the caller drains by polling.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+log_stage_handler_init(struct log_handler *handler, struct log_stage *ls,
+                       struct log_handler *backing, void *buf,
+                       uint16_t buf_len, struct os_eventq *evq)
+{
+    if (((uintptr_t)buf & 3) || (buf_len & 3) || buf_len == 0) {
+        return OS_EINVAL;
+    }
+
+    memset(ls, 0, sizeof(*ls));
+    ls->ls_log.l_log = backing;
+    ls->ls_ev.ev_type = OS_EVENT_T_PERUSER;
+    ls->ls_ev.ev_arg = ls;
+    ls->ls_evq = evq;
+    ls->ls_buf = buf;
+    ls->ls_size = buf_len;
+
+    handler->log_type = backing->log_type;
+    handler->log_read = log_stage_read;
+    handler->log_append = log_stage_append;
+    handler->log_walk = log_stage_walk;
+    handler->log_walk_from = log_stage_walk_from;
+    handler->log_flush = log_stage_flush;
+    if (backing->log_rtr_erase) {
+        handler->log_rtr_erase = log_stage_rtr_erase;
+    } else {
+        handler->log_rtr_erase = NULL;
+    }
+    handler->log_arg = ls;
+
+    return 0;
+}
@@ -137,12 +137,334 @@ TEST_CASE(log_flush_fcb)
     TEST_ASSERT(rc == 0);
 }
 
+static int
+log_test_walk3(struct log *log, void *arg, void *dptr, uint16_t len)
+{
+    int *cnt = arg;
+    char data[128];
+    char text[64];
+    int dlen;
+    int rc;
+
+    dlen = len - sizeof(struct log_entry_hdr);
+    TEST_ASSERT(dlen < sizeof(data));
+    rc = log_read(log, dptr, data, sizeof(struct log_entry_hdr), dlen);
+    TEST_ASSERT(rc == dlen);
+
+    rc = log_bin_format(data, dlen, text, sizeof(text));
+    switch ((*cnt)++) {
+    case 0:
+        TEST_ASSERT(dlen == sizeof(struct log_bin_hdr));
+        TEST_ASSERT(rc == strlen("no args"));
+        TEST_ASSERT(!strcmp(text, "no args"));
+        break;
+    case 1:
+        TEST_ASSERT(dlen == sizeof(struct log_bin_hdr) + 3 * sizeof(uint32_t));
+        TEST_ASSERT(!strcmp(text, "val -5 00ab 100% 7"));
+        break;
+    case 2:
+        /* Text entry */
+        TEST_ASSERT(rc == -1);
+        break;
+    case 3:
+        /* Truncated to buffer */
+        TEST_ASSERT(rc == sizeof(text) - 1);
+        TEST_ASSERT(strlen(text) == sizeof(text) - 1);
+        break;
+    default:
+        TEST_ASSERT(0);
+    }
+    return 0;
+}
+
+TEST_CASE(log_deferred_fcb)
+{
+    int cnt;
+    int rc;
+
+    LOG_DEFERRED(&my_log, 0, 0, "no args");
+    LOG_DEFERRED(&my_log, 0, 0, "val %d %04x 100%% %lu", -5, 0xab, 7);
+    log_printf(&my_log, 0, 0, "text %d", 1);
+    LOG_DEFERRED(&my_log, 0, 0, "%40d%40d", 1, 2);
+
+    cnt = 0;
+    rc = log_walk(&my_log, log_test_walk3, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cnt == 4);
+}
+
+static int
+log_test_walk4(struct log *log, void *arg, void *dptr, uint16_t len)
+{
+    int *cnt = arg;
+    char data[16];
+    int rc;
+
+    TEST_ASSERT(len == sizeof(struct log_entry_hdr) + 8);
+    rc = log_read(log, dptr, data, sizeof(struct log_entry_hdr), 8);
+    TEST_ASSERT(rc == 8);
+    TEST_ASSERT(!memcmp(data, "stage", 5));
+    TEST_ASSERT(data[5] - '0' == *cnt % 10);
+    (*cnt)++;
+    return 0;
+}
+
+TEST_CASE(log_stage_cbmem)
+{
+    static uint32_t ring[16];
+    static uint8_t cbmem_buf[2048];
+    struct log_handler cbmem_handler;
+    struct log_handler stage_handler;
+    struct log_stage ls;
+    struct log stage_log;
+    struct cbmem cbmem;
+    int seq;
+    int cnt;
+    int rc;
+    int i;
+
+    cbmem_init(&cbmem, cbmem_buf, sizeof(cbmem_buf));
+    log_cbmem_handler_init(&cbmem_handler, &cbmem);
+    rc = log_stage_handler_init(&stage_handler, &ls, &cbmem_handler, ring,
+      sizeof(ring), NULL);
+    TEST_ASSERT(rc == 0);
+    stage_log.l_name = "stage";
+    stage_log.l_log = &stage_handler;
+
+    /*
+     * Entries are 24 bytes in the ring; third one does not fit.
+     */
+    seq = 0;
+    for (i = 0; i < 3; i++) {
+        log_printf(&stage_log, 0, 0, "stage%d..", seq++ % 10);
+    }
+    TEST_ASSERT(ls.ls_drops == 1);
+    seq--;
+
+    cnt = 0;
+    rc = log_walk(&stage_log, log_test_walk4, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cnt == 0);
+
+    rc = log_stage_drain(&ls);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ls.ls_used == 0);
+    rc = log_walk(&stage_log, log_test_walk4, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cnt == 2);
+
+    /*
+     * Wrap around the ring several times.
+     */
+    for (i = 0; i < 20; i++) {
+        log_printf(&stage_log, 0, 0, "stage%d..", seq++ % 10);
+        log_printf(&stage_log, 0, 0, "stage%d..", seq++ % 10);
+        rc = log_stage_drain(&ls);
+        TEST_ASSERT(rc == 0);
+    }
+    TEST_ASSERT(ls.ls_drops == 1);
+    TEST_ASSERT(ls.ls_used == 0);
+
+    cnt = 0;
+    rc = log_walk(&stage_log, log_test_walk4, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cnt == seq);
+}
+
+TEST_CASE(log_fanout_cbmem)
+{
+    static uint32_t ring[16];
+    static uint8_t cbmem_buf[2][1024];
+    struct log_handler cbmem_handler[2];
+    struct log_handler console_handler;
+    struct log_handler fanout_handler;
+    struct log_handler stage_handler;
+    struct log_handler *children[3];
+    struct log_fanout lf;
+    struct log_stage ls;
+    struct log fanout_log;
+    struct log cbmem_log;
+    struct cbmem cbmem[2];
+    int cnt;
+    int rc;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        cbmem_init(&cbmem[i], cbmem_buf[i], sizeof(cbmem_buf[i]));
+        log_cbmem_handler_init(&cbmem_handler[i], &cbmem[i]);
+    }
+    log_console_handler_init(&console_handler);
+    children[0] = &console_handler;
+    children[1] = &cbmem_handler[0];
+    children[2] = &cbmem_handler[1];
+
+    rc = log_fanout_handler_init(&fanout_handler, &lf, children, 0);
+    TEST_ASSERT(rc != 0);
+    rc = log_fanout_handler_init(&fanout_handler, &lf, children, 3);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(lf.lf_primary == 1);
+    TEST_ASSERT(fanout_handler.log_type == LOG_TYPE_MEMORY);
+
+    rc = log_stage_handler_init(&stage_handler, &ls, &fanout_handler, ring,
+      sizeof(ring), NULL);
+    TEST_ASSERT(rc == 0);
+    fanout_log.l_name = "fanout";
+    fanout_log.l_log = &stage_handler;
+
+    for (i = 0; i < 10; i++) {
+        log_printf(&fanout_log, 0, 0, "stage%d..", i);
+        rc = log_stage_drain(&ls);
+        TEST_ASSERT(rc == 0);
+    }
+
+    cnt = 0;
+    rc = log_walk(&fanout_log, log_test_walk4, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cnt == 10);
+
+    /*
+     * Second child got the same entries.
+     */
+    cbmem_log.l_name = "cbmem";
+    cbmem_log.l_log = &cbmem_handler[1];
+    cnt = 0;
+    rc = log_walk(&cbmem_log, log_test_walk4, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cnt == 10);
+}
+
+static int
+log_test_walk_cnt(struct log *log, void *arg, void *dptr, uint16_t len)
+{
+    struct log_entry_hdr ueh;
+    int rc;
+
+    rc = log_read(log, dptr, &ueh, 0, sizeof(ueh));
+    TEST_ASSERT(rc == sizeof(ueh));
+    TEST_ASSERT(ueh.ue_level >= LOG_LEVEL_WARN || ueh.ue_module != 7);
+    (*(int *)arg)++;
+    return 0;
+}
+
+TEST_CASE(log_level_filter)
+{
+    static uint8_t cbmem_buf[1024];
+    struct log_handler cbmem_handler;
+    struct log cbmem_log;
+    struct cbmem cbmem;
+    int cnt;
+    int rc;
+
+    cbmem_init(&cbmem, cbmem_buf, sizeof(cbmem_buf));
+    log_cbmem_handler_init(&cbmem_handler, &cbmem);
+    cbmem_log.l_name = "lvl";
+    cbmem_log.l_log = &cbmem_handler;
+
+    TEST_ASSERT(log_level_get(7) == 0);
+    rc = log_level_set(7, LOG_LEVEL_WARN);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(log_level_get(7) == LOG_LEVEL_WARN);
+    TEST_ASSERT(log_level_get(6) == 0);
+    TEST_ASSERT(log_level_get(8) == 0);
+    rc = log_level_set(LOG_MODULE_MAX + 1, LOG_LEVEL_WARN);
+    TEST_ASSERT(rc != 0);
+
+    LOG_DEBUG(&cbmem_log, 7, "dropped %d", 1);
+    LOG_INFO(&cbmem_log, 7, "dropped %d", 2);
+    LOG_WARN(&cbmem_log, 7, "kept %d", 3);
+    LOG_DEFERRED(&cbmem_log, 7, LOG_LEVEL_DEBUG, "dropped %d", 4);
+    LOG_DEFERRED(&cbmem_log, 7, LOG_LEVEL_ERROR, "kept %d", 5);
+    log_printf(&cbmem_log, 7, LOG_LEVEL_INFO, "dropped");
+    log_append(&cbmem_log, 7, LOG_LEVEL_DEBUG, cbmem_buf, 0);
+    LOG_DEBUG(&cbmem_log, 6, "kept %d", 6);
+
+    cnt = 0;
+    rc = log_walk(&cbmem_log, log_test_walk_cnt, &cnt);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(cnt == 3);
+
+    log_level_set(7, 0);
+}
+
+struct log_test_ts {
+    int64_t ts[64];
+    int cnt;
+};
+
+static int
+log_test_walk_ts(struct log *log, void *arg, void *dptr, uint16_t len)
+{
+    struct log_test_ts *lts;
+    struct log_entry_hdr ueh;
+    int rc;
+
+    lts = arg;
+    rc = log_read(log, dptr, &ueh, 0, sizeof(ueh));
+    TEST_ASSERT(rc == sizeof(ueh));
+    TEST_ASSERT(lts->cnt < 64);
+    lts->ts[lts->cnt++] = ueh.ue_ts;
+    return 0;
+}
+
+TEST_CASE(log_walk_from_cbmem)
+{
+    static uint8_t cbmem_buf[512];
+    struct log_handler cbmem_handler;
+    struct log_test_ts all;
+    struct log_test_ts from;
+    struct log cbmem_log;
+    struct cbmem cbmem;
+    int64_t ts;
+    int rc;
+    int i;
+    int j;
+
+    cbmem_init(&cbmem, cbmem_buf, sizeof(cbmem_buf));
+    log_cbmem_handler_init(&cbmem_handler, &cbmem);
+    cbmem_log.l_name = "from";
+    cbmem_log.l_log = &cbmem_handler;
+
+    /* Wraps the buffer a few times over. */
+    for (i = 0; i < 40; i++) {
+        log_printf(&cbmem_log, 0, 0, "entry%d", i);
+    }
+
+    all.cnt = 0;
+    rc = log_walk(&cbmem_log, log_test_walk_ts, &all);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(all.cnt > 5 && all.cnt < 40);
+
+    /* Entries from a given timestamp on, and nothing older. */
+    for (i = 0; i < all.cnt; i++) {
+        ts = all.ts[i];
+        for (j = 0; all.ts[j] < ts; j++) {
+        }
+
+        from.cnt = 0;
+        rc = log_walk_from(&cbmem_log, ts, log_test_walk_ts, &from);
+        TEST_ASSERT(rc == 0);
+        TEST_ASSERT(from.cnt == all.cnt - j);
+        TEST_ASSERT(!memcmp(from.ts, all.ts + j, from.cnt * sizeof(ts)));
+    }
+
+    from.cnt = 0;
+    rc = log_walk_from(&cbmem_log, all.ts[all.cnt - 1] + 1, log_test_walk_ts,
+      &from);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(from.cnt == 0);
+}
+
 TEST_SUITE(log_test_all)
 {
     log_setup_fcb();
     log_append_fcb();
     log_walk_fcb();
     log_flush_fcb();
+    log_deferred_fcb();
+    log_stage_cbmem();
+    log_fanout_cbmem();
+    log_level_filter();
+    log_walk_from_cbmem();
 }
 
 #ifdef MYNEWT_SELFTEST
@@ -0,0 +1,74 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef __SYS_MN_POLL_H_
+#define __SYS_MN_POLL_H_
+
+#include <inttypes.h>
+#include <os/queue.h>
+#include <os/os_eventq.h>
+
+/*
+ * Readiness set for sockets. One task can serve many sockets: socket
+ * upcalls mark the socket ready in the set, and post a single event to
+ * the task's event queue. The task then collects all the ready sockets
+ * with mn_poll_get().
+ *
+ * Readiness is edge triggered. After MN_POLL_READ is reported, socket must
+ * be drained with mn_recvfrom()/mn_recvmmsg() until it returns MN_EAGAIN;
+ * MN_POLL_WRITE is reported when provider calls (*writable), i.e. after
+ * connect completes, or when there's room again after a failed send.
+ * MN_POLL_ERR is reported together with the error from the upcall.
+ *
+ * Adding a socket to the set takes over its socket callbacks. Listen
+ * sockets still need their own newconn callback.
+ */
+#define MN_POLL_READ            0x01
+#define MN_POLL_WRITE           0x02
+#define MN_POLL_ERR             0x04
+
+struct mn_socket;
+struct mn_poll;
+
+struct mn_poll_ent {
+    struct mn_socket *mpe_sock;
+    void *mpe_arg;                      /* filled in by user */
+    struct mn_poll *mpe_set;
+    STAILQ_ENTRY(mn_poll_ent) mpe_next; /* on ready list */
+    uint8_t mpe_events;                 /* events user is interested in */
+    uint8_t mpe_pending;                /* seen, not yet reported */
+    uint8_t mpe_ready;                  /* reported by mn_poll_get() */
+    uint8_t mpe_queued;
+    int mpe_err;
+};
+
+struct mn_poll {
+    struct os_event mp_ev;              /* posted when sockets get ready */
+    struct os_eventq *mp_evq;
+    STAILQ_HEAD(, mn_poll_ent) mp_ready;
+};
+
+void mn_poll_init(struct mn_poll *, struct os_eventq *evq, uint8_t ev_type,
+  void *ev_arg);
+void mn_poll_add(struct mn_poll *, struct mn_poll_ent *, struct mn_socket *,
+  uint8_t events, void *arg);
+void mn_poll_modify(struct mn_poll_ent *, uint8_t events);
+void mn_poll_del(struct mn_poll_ent *);
+int mn_poll_get(struct mn_poll *, struct mn_poll_ent **ents, int max);
+
+#endif /* __SYS_MN_POLL_H_ */
@@ -96,6 +96,16 @@ struct mn_sockaddr_in6 {
     uint32_t msin6_addr[4];
 };
 
+/*
+ * Datagram for batched send and receive. mm_addr is large enough to hold
+ * address of either family; mm_addr.msin6_len 0 means no address (e.g. for
+ * connected socket).
+ */
+struct mn_msg {
+    struct os_mbuf *mm_data;
+    struct mn_sockaddr_in6 mm_addr;
+};
+
 /*
  * Socket calls.
  *
@@ -112,6 +122,12 @@ struct mn_sockaddr_in6 {
  *
  * If remote end closes the socket, socket callback (*readable) will be
  * called.
+ *
+ * mn_recvmmsg() drains up to max queued packets from the socket in one call,
+ * and mn_sendmmsg() queues cnt packets for transmission. Number of packets
+ * actually received or sent is returned in *out_cnt. Ownership of mbufs
+ * of unsent packets stays with the caller. mn_recvmmsg() returns MN_EAGAIN
+ * if nothing was queued.
  */
 int mn_socket(struct mn_socket **, uint8_t domain, uint8_t type, uint8_t proto);
 int mn_bind(struct mn_socket *, struct mn_sockaddr *);
@@ -121,6 +137,10 @@ int mn_listen(struct mn_socket *, uint8_t qlen);
 int mn_recvfrom(struct mn_socket *, struct os_mbuf **,
   struct mn_sockaddr *from);
 int mn_sendto(struct mn_socket *, struct os_mbuf *, struct mn_sockaddr *to);
+int mn_recvmmsg(struct mn_socket *, struct mn_msg *msgs, int max,
+  int *out_cnt);
+int mn_sendmmsg(struct mn_socket *, struct mn_msg *msgs, int cnt,
+  int *out_cnt);
 
 int mn_getsockopt(struct mn_socket *, uint8_t level, uint8_t optname,
   void *optval);
@@ -27,6 +27,9 @@
  *   the socket provider.
  * - mso_close() closes the socket, memory should be freed. User should not
  *   be using the socket pointer once it has been closed.
+ * - mso_recvmmsg() and mso_sendmmsg() are optional. Provider can implement
+ *   them to move several packets while taking its locks only once. If not
+ *   present, mso_recvfrom()/mso_sendto() are called for each packet.
  */
 struct mn_socket_ops {
     int (*mso_create)(struct mn_socket **, uint8_t domain, uint8_t type,
@@ -41,6 +44,10 @@ struct mn_socket_ops {
       struct mn_sockaddr *to);
     int (*mso_recvfrom)(struct mn_socket *, struct os_mbuf **,
       struct mn_sockaddr *from);
+    int (*mso_sendmmsg)(struct mn_socket *, struct mn_msg *msgs, int cnt,
+      int *out_cnt);
+    int (*mso_recvmmsg)(struct mn_socket *, struct mn_msg *msgs, int max,
+      int *out_cnt);
 
     int (*mso_getsockopt)(struct mn_socket *, uint8_t level, uint8_t name,
       void *val);
@@ -0,0 +1,178 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <inttypes.h>
+#include <string.h>
+
+#include <os/os.h>
+
+#include "mn_socket/mn_socket.h"
+#include "mn_socket/mn_socket_ops.h"
+#include "mn_socket/mn_poll.h"
+
+/*
+ * Queue the entry on ready list if it has pending events which user is
+ * interested in. Must be called within critical section. Returns 1 if
+ * event needs to be posted.
+ */
+static int
+mn_poll_queue(struct mn_poll_ent *mpe)
+{
+    if (mpe->mpe_queued ||
+      !(mpe->mpe_pending & (mpe->mpe_events | MN_POLL_ERR))) {
+        return 0;
+    }
+    STAILQ_INSERT_TAIL(&mpe->mpe_set->mp_ready, mpe, mpe_next);
+    mpe->mpe_queued = 1;
+    return 1;
+}
+
+static void
+mn_poll_upcall(struct mn_poll_ent *mpe, uint8_t events, int err)
+{
+    struct mn_poll *mp;
+    os_sr_t sr;
+    int post;
+
+    mp = mpe->mpe_set;
+
+    OS_ENTER_CRITICAL(sr);
+    if (err) {
+        mpe->mpe_err = err;
+        events |= MN_POLL_ERR;
+    }
+    mpe->mpe_pending |= events;
+    post = mn_poll_queue(mpe);
+    OS_EXIT_CRITICAL(sr);
+
+    if (post) {
+        os_eventq_put(mp->mp_evq, &mp->mp_ev);
+    }
+}
+
+/*
+ * Socket callbacks. Called in context of IP stack task.
+ */
+static void
+mn_poll_readable(void *arg, int err)
+{
+    mn_poll_upcall(arg, MN_POLL_READ, err);
+}
+
+static void
+mn_poll_writable(void *arg, int err)
+{
+    mn_poll_upcall(arg, MN_POLL_WRITE, err);
+}
+
+static const union mn_socket_cb mn_poll_cbs = {
+    .socket.readable = mn_poll_readable,
+    .socket.writable = mn_poll_writable,
+};
+
+void
+mn_poll_init(struct mn_poll *mp, struct os_eventq *evq, uint8_t ev_type,
+  void *ev_arg)
+{
+    memset(mp, 0, sizeof(*mp));
+    mp->mp_ev.ev_type = ev_type;
+    mp->mp_ev.ev_arg = ev_arg;
+    mp->mp_evq = evq;
+    STAILQ_INIT(&mp->mp_ready);
+}
+
+void
+mn_poll_add(struct mn_poll *mp, struct mn_poll_ent *mpe, struct mn_socket *s,
+  uint8_t events, void *arg)
+{
+    memset(mpe, 0, sizeof(*mpe));
+    mpe->mpe_sock = s;
+    mpe->mpe_arg = arg;
+    mpe->mpe_set = mp;
+    mpe->mpe_events = events;
+    mn_socket_set_cbs(s, mpe, &mn_poll_cbs);
+}
+
+void
+mn_poll_modify(struct mn_poll_ent *mpe, uint8_t events)
+{
+    struct mn_poll *mp;
+    os_sr_t sr;
+    int post;
+
+    mp = mpe->mpe_set;
+
+    OS_ENTER_CRITICAL(sr);
+    mpe->mpe_events = events;
+    post = mn_poll_queue(mpe);
+    OS_EXIT_CRITICAL(sr);
+
+    if (post) {
+        os_eventq_put(mp->mp_evq, &mp->mp_ev);
+    }
+}
+
+void
+mn_poll_del(struct mn_poll_ent *mpe)
+{
+    struct mn_poll *mp;
+    os_sr_t sr;
+
+    mp = mpe->mpe_set;
+
+    mn_socket_set_cbs(mpe->mpe_sock, NULL, NULL);
+    OS_ENTER_CRITICAL(sr);
+    if (mpe->mpe_queued) {
+        STAILQ_REMOVE(&mp->mp_ready, mpe, mn_poll_ent, mpe_next);
+        mpe->mpe_queued = 0;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+/*
+ * Collect up to max ready sockets. Events reported for each are in
+ * mpe_ready, error in mpe_err. If more sockets remain ready, the event is
+ * posted again.
+ *
+ * @return Number of entries filled in.
+ */
+int
+mn_poll_get(struct mn_poll *mp, struct mn_poll_ent **ents, int max)
+{
+    struct mn_poll_ent *mpe;
+    os_sr_t sr;
+    int cnt;
+    int post;
+
+    cnt = 0;
+    OS_ENTER_CRITICAL(sr);
+    while (cnt < max && (mpe = STAILQ_FIRST(&mp->mp_ready)) != NULL) {
+        STAILQ_REMOVE_HEAD(&mp->mp_ready, mpe_next);
+        mpe->mpe_queued = 0;
+        mpe->mpe_ready = mpe->mpe_pending & (mpe->mpe_events | MN_POLL_ERR);
+        mpe->mpe_pending &= ~mpe->mpe_ready;
+        ents[cnt++] = mpe;
+    }
+    post = !STAILQ_EMPTY(&mp->mp_ready);
+    OS_EXIT_CRITICAL(sr);
+
+    if (post) {
+        os_eventq_put(mp->mp_evq, &mp->mp_ev);
+    }
+    return cnt;
+}
@@ -92,6 +92,57 @@ mn_sendto(struct mn_socket *s, struct os_mbuf *m, struct mn_sockaddr *to)
     return s->ms_ops->mso_sendto(s, m, to);
 }
 
+int
+mn_recvmmsg(struct mn_socket *s, struct mn_msg *msgs, int max, int *out_cnt)
+{
+    int cnt;
+    int rc;
+
+    if (s->ms_ops->mso_recvmmsg) {
+        return s->ms_ops->mso_recvmmsg(s, msgs, max, out_cnt);
+    }
+    rc = 0;
+    for (cnt = 0; cnt < max; cnt++) {
+        msgs[cnt].mm_addr.msin6_len = 0;
+        rc = s->ms_ops->mso_recvfrom(s, &msgs[cnt].mm_data,
+          (struct mn_sockaddr *)&msgs[cnt].mm_addr);
+        if (rc) {
+            break;
+        }
+    }
+    *out_cnt = cnt;
+    if (cnt > 0) {
+        return 0;
+    }
+    return rc;
+}
+
+int
+mn_sendmmsg(struct mn_socket *s, struct mn_msg *msgs, int cnt, int *out_cnt)
+{
+    struct mn_sockaddr *to;
+    int i;
+    int rc;
+
+    if (s->ms_ops->mso_sendmmsg) {
+        return s->ms_ops->mso_sendmmsg(s, msgs, cnt, out_cnt);
+    }
+    rc = 0;
+    for (i = 0; i < cnt; i++) {
+        if (msgs[i].mm_addr.msin6_len) {
+            to = (struct mn_sockaddr *)&msgs[i].mm_addr;
+        } else {
+            to = NULL;
+        }
+        rc = s->ms_ops->mso_sendto(s, msgs[i].mm_data, to);
+        if (rc) {
+            break;
+        }
+    }
+    *out_cnt = i;
+    return rc;
+}
+
 int
 mn_getsockopt(struct mn_socket *s, uint8_t level, uint8_t name, void *val)
 {
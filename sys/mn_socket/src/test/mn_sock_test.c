@@ -24,6 +24,8 @@
 #include <testutil/testutil.h>
 
 #include "mn_socket/mn_socket.h"
+#include "mn_socket/mn_socket_ops.h"
+#include "mn_socket/mn_poll.h"
 
 TEST_CASE(inet_pton_test)
 {
@@ -61,9 +63,148 @@ TEST_CASE(inet_pton_test)
     }
 }
 
+/*
+ * Provider with only per-packet calls; mbufs are just tokens here.
+ */
+static struct mn_socket mn_test_sock;
+static int mn_test_rx_cnt;
+static int mn_test_tx_cnt;
+static int mn_test_tx_room;
+
+static int
+mn_test_create(struct mn_socket **sp, uint8_t domain, uint8_t type,
+  uint8_t proto)
+{
+    *sp = &mn_test_sock;
+    return 0;
+}
+
+static int
+mn_test_recvfrom(struct mn_socket *s, struct os_mbuf **mp,
+  struct mn_sockaddr *from)
+{
+    struct mn_sockaddr_in *msin = (struct mn_sockaddr_in *)from;
+
+    if (mn_test_rx_cnt == 0) {
+        return MN_EAGAIN;
+    }
+    *mp = (struct os_mbuf *)(uintptr_t)mn_test_rx_cnt;
+    msin->msin_len = sizeof(*msin);
+    msin->msin_family = MN_AF_INET;
+    msin->msin_port = mn_test_rx_cnt;
+    mn_test_rx_cnt--;
+    return 0;
+}
+
+static int
+mn_test_sendto(struct mn_socket *s, struct os_mbuf *m, struct mn_sockaddr *to)
+{
+    if (mn_test_tx_room == 0) {
+        return MN_ENOBUFS;
+    }
+    TEST_ASSERT(to != NULL);
+    TEST_ASSERT(((struct mn_sockaddr_in *)to)->msin_port ==
+      (uintptr_t)m);
+    mn_test_tx_room--;
+    mn_test_tx_cnt++;
+    return 0;
+}
+
+static const struct mn_socket_ops mn_test_ops = {
+    .mso_create = mn_test_create,
+    .mso_sendto = mn_test_sendto,
+    .mso_recvfrom = mn_test_recvfrom,
+};
+
+TEST_CASE(mmsg_fallback_test)
+{
+    struct mn_socket *sock;
+    struct mn_msg msgs[4];
+    int cnt;
+    int sent;
+    int rc;
+
+    rc = mn_socket_ops_reg(&mn_test_ops);
+    TEST_ASSERT(rc == 0);
+    rc = mn_socket(&sock, MN_PF_INET, MN_SOCK_DGRAM, 0);
+    TEST_ASSERT(rc == 0 && sock == &mn_test_sock);
+
+    mn_test_rx_cnt = 6;
+    rc = mn_recvmmsg(sock, msgs, 4, &cnt);
+    TEST_ASSERT(rc == 0 && cnt == 4);
+    TEST_ASSERT((uintptr_t)msgs[0].mm_data == 6);
+    TEST_ASSERT((uintptr_t)msgs[3].mm_data == 3);
+
+    mn_test_tx_room = 3;
+    rc = mn_sendmmsg(sock, msgs, cnt, &sent);
+    TEST_ASSERT(rc == MN_ENOBUFS && sent == 3);
+    TEST_ASSERT(mn_test_tx_cnt == 3);
+
+    rc = mn_recvmmsg(sock, msgs, 4, &cnt);
+    TEST_ASSERT(rc == 0 && cnt == 2);
+    rc = mn_recvmmsg(sock, msgs, 4, &cnt);
+    TEST_ASSERT(rc == MN_EAGAIN && cnt == 0);
+}
+
+TEST_CASE(poll_test)
+{
+    struct os_eventq evq;
+    struct mn_poll mp;
+    struct mn_poll_ent mpe[3];
+    struct mn_poll_ent *ready[2];
+    struct mn_socket socks[3];
+    int cnt;
+    int i;
+
+    os_eventq_init(&evq);
+    mn_poll_init(&mp, &evq, OS_EVENT_T_PERUSER, NULL);
+    for (i = 0; i < 3; i++) {
+        memset(&socks[i], 0, sizeof(socks[i]));
+        mn_poll_add(&mp, &mpe[i], &socks[i], MN_POLL_READ, &socks[i]);
+    }
+
+    /*
+     * Several upcalls, one event.
+     */
+    mn_socket_readable(&socks[2], 0);
+    mn_socket_readable(&socks[0], 0);
+    mn_socket_readable(&socks[2], 0);
+    mn_socket_writable(&socks[1], 0);
+    TEST_ASSERT(OS_EVENT_QUEUED(&mp.mp_ev));
+    os_eventq_remove(&evq, &mp.mp_ev);
+
+    cnt = mn_poll_get(&mp, ready, 2);
+    TEST_ASSERT(cnt == 2);
+    TEST_ASSERT(ready[0] == &mpe[2] && ready[0]->mpe_ready == MN_POLL_READ);
+    TEST_ASSERT(ready[1] == &mpe[0] && ready[1]->mpe_arg == &socks[0]);
+    cnt = mn_poll_get(&mp, ready, 2);
+    TEST_ASSERT(cnt == 0);
+
+    /*
+     * Write readiness was remembered; reported once asked for.
+     */
+    mn_poll_modify(&mpe[1], MN_POLL_READ | MN_POLL_WRITE);
+    TEST_ASSERT(OS_EVENT_QUEUED(&mp.mp_ev));
+    os_eventq_remove(&evq, &mp.mp_ev);
+    mn_socket_readable(&socks[1], MN_ECONNABORTED);
+    cnt = mn_poll_get(&mp, ready, 2);
+    TEST_ASSERT(cnt == 1 && ready[0] == &mpe[1]);
+    TEST_ASSERT(ready[0]->mpe_ready ==
+      (MN_POLL_READ | MN_POLL_WRITE | MN_POLL_ERR));
+    TEST_ASSERT(ready[0]->mpe_err == MN_ECONNABORTED);
+
+    mn_socket_readable(&socks[0], 0);
+    mn_poll_del(&mpe[0]);
+    cnt = mn_poll_get(&mp, ready, 2);
+    TEST_ASSERT(cnt == 0);
+    os_eventq_remove(&evq, &mp.mp_ev);
+}
+
 TEST_SUITE(mn_socket_test_all)
 {
     inet_pton_test();
+    mmsg_fallback_test();
+    poll_test();
 }
 
 #ifdef MYNEWT_SELFTEST
@@ -19,24 +19,53 @@
 #ifndef __UTIL_STATS_H__ 
 #define __UTIL_STATS_H__ 
 
+#include <os/os.h>
 #include <os/queue.h>
 #include <stdint.h>
 
 struct stats_name_map {
     uint16_t snm_off;
-    char *snm_name;
+    const char *snm_name;
+    uint8_t snm_cnt;            /* Entries named, if more than one */
 };
 
+struct stats_snap;
+
+/*
+ * Define STATS_GROUP_HASH_SIZE to a power of two to look groups up by name
+ * hash instead of scanning all of them.
+ */
+#ifndef STATS_GROUP_HASH_SIZE
+#define STATS_GROUP_HASH_SIZE (0)
+#endif
+
 struct stats_hdr {
-    char *s_name;
+    const char *s_name;
     uint8_t s_size;
     uint8_t s_cnt;
     uint16_t s_pad1;
 #ifdef STATS_NAME_ENABLE
-    struct stats_name_map *s_map;
+    const struct stats_name_map *s_map;
     int s_map_cnt;
 #endif
+    struct stats_snap *s_snap;
     STAILQ_ENTRY(stats_hdr) s_next;
+#if STATS_GROUP_HASH_SIZE
+    struct stats_hdr *s_hnext;
+#endif
+};
+
+/*
+ * Snapshot of a section, for reporting what changed since it was taken.
+ * ss_vals holds s_cnt counters of s_size bytes. If ss_rates is set, each
+ * stats_snap() also updates a running average of counts per second for
+ * every counter (s_cnt entries).
+ */
+struct stats_snap {
+    void *ss_vals;
+    uint32_t *ss_rates;
+    os_time_t ss_time;
+    uint8_t ss_rates_valid;
 };
 
 #define STATS_SECT_DECL(__name)             \
@@ -72,17 +101,52 @@ STATS_SECT_DECL(__name) {                   \
 #define STATS_INCN(__sectvarname, __var, __n)  \
     ((__sectvarname).STATS_SECT_VAR(__var) += (__n))
 
+/*
+ * Histogram with power of two buckets, for 32-bit sections. Bucket 0 counts
+ * values 0 and 1, bucket n values from 2^n up to 2^(n+1) - 1, and the last
+ * bucket everything above. Each bucket is walked as its own counter,
+ * named <entry>_<bucket>.
+ */
+#ifndef STATS_HIST_BUCKETS
+#define STATS_HIST_BUCKETS (16)
+#endif
+
+#define STATS_SECT_HIST(__var) \
+    uint32_t STATS_SECT_VAR(__var)[STATS_HIST_BUCKETS];
+
+static inline int
+stats_hist_bucket(uint32_t val)
+{
+    int bucket;
+
+    if (val < 2) {
+        return 0;
+    }
+    bucket = 31 - __builtin_clz(val);
+    if (bucket >= STATS_HIST_BUCKETS) {
+        bucket = STATS_HIST_BUCKETS - 1;
+    }
+    return bucket;
+}
+
+#define STATS_HIST_ADD(__sectvarname, __var, __val)                         \
+    ((__sectvarname).STATS_SECT_VAR(__var)[stats_hist_bucket(__val)]++)
+
 #ifdef STATS_NAME_ENABLE
 
 #define STATS_NAME_MAP_NAME(__sectname) g_stats_map_ ## __sectname
 
 #define STATS_NAME_START(__sectname)                                        \
-struct stats_name_map STATS_NAME_MAP_NAME(__sectname)[] = {
+const struct stats_name_map STATS_NAME_MAP_NAME(__sectname)[] = {
 
 #define STATS_NAME(__sectname, __entry)                                     \
     { offsetof(STATS_SECT_DECL(__sectname), STATS_SECT_VAR(__entry)),       \
       #__entry },
 
+#define STATS_NAME_HIST(__sectname, __entry)                                \
+    { offsetof(STATS_SECT_DECL(__sectname), STATS_SECT_VAR(__entry)),       \
+      #__entry, STATS_HIST_BUCKETS },
+
 #define STATS_NAME_END(__sectname)                                          \
 };
 
@@ -90,22 +154,51 @@ struct stats_name_map STATS_NAME_MAP_NAME(__sectname)[] = {
     &(STATS_NAME_MAP_NAME(__name)[0]),                                      \
     (sizeof(STATS_NAME_MAP_NAME(__name)) / sizeof(struct stats_name_map))
 
+#define STATS_NAME_HDR_INIT(__name)                                         \
+    .s_map = &(STATS_NAME_MAP_NAME(__name)[0]),                             \
+    .s_map_cnt = (sizeof(STATS_NAME_MAP_NAME(__name)) /                     \
+                  sizeof(struct stats_name_map)),
+
 #else /* STATS_NAME_ENABLE */
 
 #define STATS_NAME_START(__name)
 #define STATS_NAME(__name, __entry)
+#define STATS_NAME_HIST(__name, __entry)
 #define STATS_NAME_END(__name)
 #define STATS_NAME_INIT_PARMS(__name) NULL, 0
+#define STATS_NAME_HDR_INIT(__name)
 
 #endif /* STATS_NAME_ENABLE */
 
+/*
+ * Defines a statistics section which is registered at link time; its
+ * header is initialized statically, and a pointer to it is placed in the
+ * read-only "stats_reg" section which stats_group_walk() and
+ * stats_group_find() scan alongside the runtime registry. The name map, if
+ * any, must be defined before this. Usage:
+ *
+ *     STATS_SECT_STATIC(my_stats, g_my_stats, STATS_SIZE_32, "my_stats");
+ */
+#define STATS_SECT_STATIC(__sectname, __sectvarname, __size, __name)        \
+STATS_SECT_DECL(__sectname) __sectvarname = {                               \
+    .s_hdr = {                                                              \
+        .s_name = (__name),                                                 \
+        .s_size = (__size),                                                 \
+        .s_cnt = (sizeof(STATS_SECT_DECL(__sectname)) -                     \
+                  sizeof(struct stats_hdr)) / (__size),                     \
+        STATS_NAME_HDR_INIT(__sectname)                                     \
+    }                                                                       \
+};                                                                          \
+static struct stats_hdr * const stats_reg_ ## __sectvarname                 \
+  __attribute__((section("stats_reg"), used)) = &(__sectvarname).s_hdr
+
 int stats_module_init(void);
 void stats_module_reset(void);
 int stats_init(struct stats_hdr *shdr, uint8_t size, uint8_t cnt, 
-    struct stats_name_map *map, uint8_t map_cnt);
+    const struct stats_name_map *map, uint8_t map_cnt);
 int stats_register(char *name, struct stats_hdr *shdr);
 int stats_init_and_reg(struct stats_hdr *shdr, uint8_t size, uint8_t cnt,
-                       struct stats_name_map *map, uint8_t map_cnt,
+                       const struct stats_name_map *map, uint8_t map_cnt,
                        char *name);
 
 typedef int (*stats_walk_func_t)(struct stats_hdr *, void *, char *, 
@@ -117,6 +210,52 @@ int stats_group_walk(stats_group_walk_func_t, void *);
 
 struct stats_hdr *stats_group_find(char *name);
 
+uint64_t stats_value(struct stats_hdr *, uint16_t off);
+int stats_snap_enable(struct stats_hdr *, struct stats_snap *, void *vals,
+                      uint32_t *rates);
+int stats_snap(struct stats_hdr *);
+os_time_t stats_snap_elapsed(struct stats_hdr *);
+
+typedef int (*stats_delta_walk_func_t)(struct stats_hdr *, void *, char *,
+        uint16_t off, uint64_t delta);
+int stats_walk_delta(struct stats_hdr *, stats_delta_walk_func_t, void *);
+
+/*
+ * Export of section deltas to a flash circular buffer. Each FCB entry holds
+ * one section: a struct stats_fcb_rec, sfr_name_len bytes of section name,
+ * then sfr_cnt pairs of counter index and change since the previous record,
+ * both base 128 varints (low 7 bits first, top bit set if more follow).
+ * Counters which did not change are left out.
+ */
+#ifndef STATS_FCB_REC_MAX
+#define STATS_FCB_REC_MAX (128)
+#endif
+
+struct stats_fcb_rec {
+    uint32_t sfr_time;          /* os_time_get() when written */
+    uint32_t sfr_elapsed;       /* Ticks covered by the changes */
+    uint8_t sfr_name_len;
+    uint8_t sfr_cnt;            /* Number of counters which changed */
+    uint16_t _pad;
+};
+
+struct fcb;
+
+struct stats_fcb {
+    struct fcb *sf_fcb;
+    struct stats_hdr **sf_hdrs;
+    uint8_t sf_hdr_cnt;
+    os_time_t sf_period;
+    struct os_callout_func sf_timer;
+};
+
+int stats_fcb_save_group(struct fcb *, struct stats_hdr *);
+int stats_fcb_save(struct stats_fcb *);
+int stats_fcb_start(struct stats_fcb *, struct fcb *,
+                    struct stats_hdr **hdrs, uint8_t hdr_cnt,
+                    struct os_eventq *evq, os_time_t period);
+void stats_fcb_stop(struct stats_fcb *);
+
 /* Private */
 #ifdef NEWTMGR_PRESENT 
 int stats_nmgr_register_group(void);
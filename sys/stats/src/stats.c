@@ -29,30 +29,91 @@ STATS_SECT_START(stats)
     STATS_SECT_ENTRY(num_registered)
 STATS_SECT_END
 
-STATS_SECT_DECL(stats) g_stats_stats;
-
 STATS_NAME_START(stats)
     STATS_NAME(stats, num_registered)
 STATS_NAME_END(stats)
 
+STATS_SECT_STATIC(stats, g_stats_stats, STATS_SIZE_32, "stat");
+
 STAILQ_HEAD(, stats_hdr) g_stats_registry =
     STAILQ_HEAD_INITIALIZER(g_stats_registry);
 
+/*
+ * Bounds of the link time registry, provided by the linker. Weak, so that
+ * an image with no static sections still links.
+ */
+extern struct stats_hdr * const __start_stats_reg[] __attribute__((weak));
+extern struct stats_hdr * const __stop_stats_reg[] __attribute__((weak));
+
+#if STATS_GROUP_HASH_SIZE
+static struct stats_hdr *stats_group_hash[STATS_GROUP_HASH_SIZE];
+
+static int
+stats_group_hash_idx(const char *name)
+{
+    uint32_t hash;
+
+    hash = 5381;
+    while (*name) {
+        hash = (hash * 33) ^ (uint8_t)*name++;
+    }
+    return hash & (STATS_GROUP_HASH_SIZE - 1);
+}
+
+static void
+stats_group_hash_add(struct stats_hdr *shdr)
+{
+    int idx;
+
+    idx = stats_group_hash_idx(shdr->s_name);
+    shdr->s_hnext = stats_group_hash[idx];
+    stats_group_hash[idx] = shdr;
+}
+#endif
+
 static uint8_t stats_module_inited;
 
+#define STATS_NAME_BUF_LEN  (32)
+
+/*
+ * Name of the entry at offset "cur"; either from the name map, or built in
+ * name_buf.
+ */
+static char *
+stats_entry_name(struct stats_hdr *hdr, uint16_t cur, char *name_buf,
+                 int buf_len)
+{
+#ifdef STATS_NAME_ENABLE
+    const struct stats_name_map *map;
+    int idx;
+    int i;
+
+    for (i = 0; i < hdr->s_map_cnt; ++i) {
+        map = &hdr->s_map[i];
+        if (map->snm_off == cur && map->snm_cnt <= 1) {
+            return (char *)map->snm_name;
+        }
+        if (cur >= map->snm_off &&
+          cur < map->snm_off + map->snm_cnt * hdr->s_size) {
+            idx = (cur - map->snm_off) / hdr->s_size;
+            snprintf(name_buf, buf_len, "%s_%d", map->snm_name, idx);
+            return name_buf;
+        }
+    }
+#endif
+    snprintf(name_buf, buf_len, "s%d",
+      (int)((cur - sizeof(*hdr)) / hdr->s_size));
+    return name_buf;
+}
+
 int
 stats_walk(struct stats_hdr *hdr, stats_walk_func_t walk_func, void *arg)
 {
     char *name;
-    char name_buf[12];
+    char name_buf[STATS_NAME_BUF_LEN];
     uint16_t cur;
     uint16_t end;
-    int ent_n;
-    int len;
     int rc;
-#ifdef STATS_NAME_ENABLE
-    int i;
-#endif
 
     cur = sizeof(*hdr);
     end = sizeof(*hdr) + (hdr->s_size * hdr->s_cnt);
@@ -62,21 +123,7 @@ stats_walk(struct stats_hdr *hdr, stats_walk_func_t walk_func, void *arg)
          * Access and display the statistic name.  Pass that to the
          * walk function
          */
-        name = NULL;
-#ifdef STATS_NAME_ENABLE
-        for (i = 0; i < hdr->s_map_cnt; ++i) {
-            if (hdr->s_map[i].snm_off == cur) {
-                name = hdr->s_map[i].snm_name;
-                break;
-            }
-        }
-#endif
-        if (name == NULL) {
-            ent_n = (cur - sizeof(*hdr)) / hdr->s_size;
-            len = snprintf(name_buf, sizeof(name_buf), "s%d", ent_n);
-            name_buf[len] = '\0';
-            name = name_buf;
-        }
+        name = stats_entry_name(hdr, cur, name_buf, sizeof(name_buf));
 
         rc = walk_func(hdr, arg, name, cur);
         if (rc != 0) {
@@ -92,10 +139,184 @@ err:
 }
 
 
+/**
+ * Returns the value of the counter at offset "off" in the section.
+ */
+static uint64_t
+stats_read(void *val, uint8_t size)
+{
+    switch (size) {
+    case sizeof(uint16_t):
+        return *(uint16_t *)val;
+    case sizeof(uint32_t):
+        return *(uint32_t *)val;
+    default:
+        return *(uint64_t *)val;
+    }
+}
+
+uint64_t
+stats_value(struct stats_hdr *hdr, uint16_t off)
+{
+    return stats_read((uint8_t *)hdr + off, hdr->s_size);
+}
+
+/**
+ * Attaches snapshot storage to a section and takes the first snapshot.
+ *
+ * @param hdr                   The section.
+ * @param snap                  Snapshot state.
+ * @param vals                  Room for s_size * s_cnt bytes.
+ * @param rates                 Room for s_cnt rates; may be NULL if rates
+ *                                  are not wanted.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+stats_snap_enable(struct stats_hdr *hdr, struct stats_snap *snap, void *vals,
+                  uint32_t *rates)
+{
+    if (!vals) {
+        return OS_EINVAL;
+    }
+    memset(snap, 0, sizeof(*snap));
+    snap->ss_vals = vals;
+    snap->ss_rates = rates;
+    memcpy(vals, hdr + 1, hdr->s_size * hdr->s_cnt);
+    snap->ss_time = os_time_get();
+    hdr->s_snap = snap;
+
+    return 0;
+}
+
+/*
+ * Change of the counter at "off" since the snapshot, allowing for the
+ * counter having wrapped.
+ */
+static uint64_t
+stats_snap_delta(struct stats_hdr *hdr, uint16_t off)
+{
+    uint64_t delta;
+    uint8_t *old;
+
+    old = (uint8_t *)hdr->s_snap->ss_vals + off - sizeof(*hdr);
+    delta = stats_value(hdr, off) - stats_read(old, hdr->s_size);
+    if (hdr->s_size == sizeof(uint16_t)) {
+        delta &= UINT16_MAX;
+    } else if (hdr->s_size == sizeof(uint32_t)) {
+        delta &= UINT32_MAX;
+    }
+    return delta;
+}
+
+/**
+ * Returns the number of ticks since the last snapshot of the section, or
+ * 0 if it has no snapshot.
+ */
+os_time_t
+stats_snap_elapsed(struct stats_hdr *hdr)
+{
+    if (!hdr->s_snap) {
+        return 0;
+    }
+    return os_time_get() - hdr->s_snap->ss_time;
+}
+
+/**
+ * Takes a new snapshot of the section, updating the rate averages if the
+ * section keeps them.
+ *
+ * @return                      0 on success; OS_EINVAL if snapshots are
+ *                                  not enabled for the section.
+ */
+int
+stats_snap(struct stats_hdr *hdr)
+{
+    struct stats_snap *snap;
+    uint64_t rate;
+    os_time_t now;
+    os_time_t elapsed;
+    uint16_t off;
+    int i;
+
+    snap = hdr->s_snap;
+    if (!snap) {
+        return OS_EINVAL;
+    }
+
+    now = os_time_get();
+    elapsed = now - snap->ss_time;
+    if (snap->ss_rates && elapsed) {
+        for (i = 0; i < hdr->s_cnt; i++) {
+            off = sizeof(*hdr) + i * hdr->s_size;
+            rate = stats_snap_delta(hdr, off) * OS_TICKS_PER_SEC / elapsed;
+            if (rate > UINT32_MAX) {
+                rate = UINT32_MAX;
+            }
+            if (snap->ss_rates_valid) {
+                /* Running average, 1/4 weight to the newest sample. */
+                rate = (snap->ss_rates[i] * 3ULL + rate) / 4;
+            }
+            snap->ss_rates[i] = rate;
+        }
+        snap->ss_rates_valid = 1;
+    }
+    memcpy(snap->ss_vals, hdr + 1, hdr->s_size * hdr->s_cnt);
+    snap->ss_time = now;
+
+    return 0;
+}
+
+/**
+ * Walks the counters which have changed since the last snapshot, passing
+ * the change to the walk function.
+ *
+ * @return                      0 on success; OS_EINVAL if snapshots are
+ *                                  not enabled for the section; otherwise
+ *                                  what the walk function returned.
+ */
+int
+stats_walk_delta(struct stats_hdr *hdr, stats_delta_walk_func_t walk_func,
+                 void *arg)
+{
+    char *name;
+    char name_buf[STATS_NAME_BUF_LEN];
+    uint64_t delta;
+    uint16_t cur;
+    uint16_t end;
+    int rc;
+
+    if (!hdr->s_snap) {
+        return OS_EINVAL;
+    }
+
+    cur = sizeof(*hdr);
+    end = sizeof(*hdr) + (hdr->s_size * hdr->s_cnt);
+
+    for (; cur < end; cur += hdr->s_size) {
+        delta = stats_snap_delta(hdr, cur);
+        if (delta == 0) {
+            continue;
+        }
+
+        name = stats_entry_name(hdr, cur, name_buf, sizeof(name_buf));
+
+        rc = walk_func(hdr, arg, name, cur, delta);
+        if (rc != 0) {
+            return (rc);
+        }
+    }
+
+    return (0);
+}
+
 int
 stats_module_init(void)
 {
+    struct stats_hdr * const *reg;
+#if defined(SHELL_PRESENT) || defined(NEWTMGR_PRESENT)
     int rc;
+#endif
 
     if (stats_module_inited) {
         return 0;
@@ -116,21 +337,22 @@ stats_module_init(void)
     }
 #endif
 
-    rc = stats_init(STATS_HDR(g_stats_stats),
-                    STATS_SIZE_INIT_PARMS(g_stats_stats, STATS_SIZE_32),
-                    STATS_NAME_INIT_PARMS(stats));
-    if (rc != 0) {
-        goto err;
-    }
-
-    rc = stats_register("stat", STATS_HDR(g_stats_stats));
-    if (rc != 0) {
-        goto err;
+    /*
+     * Sections registered at link time need no setup, other than going
+     * into the hash table.
+     */
+    for (reg = __start_stats_reg; reg < __stop_stats_reg; reg++) {
+#if STATS_GROUP_HASH_SIZE
+        stats_group_hash_add(*reg);
+#endif
+        STATS_INC(g_stats_stats, num_registered);
     }
 
     return (0);
+#if defined(SHELL_PRESENT) || defined(NEWTMGR_PRESENT)
 err:
     return (rc);
+#endif
 }
 
 /**
@@ -143,11 +365,15 @@ stats_module_reset(void)
     stats_module_inited = 0;
 
     STAILQ_INIT(&g_stats_registry);
+#if STATS_GROUP_HASH_SIZE
+    memset(stats_group_hash, 0, sizeof(stats_group_hash));
+#endif
+    g_stats_stats.STATS_SECT_VAR(num_registered) = 0;
 }
 
 int
 stats_init(struct stats_hdr *shdr, uint8_t size, uint8_t cnt,
-        struct stats_name_map *map, uint8_t map_cnt)
+        const struct stats_name_map *map, uint8_t map_cnt)
 {
     memset((uint8_t *) shdr, 0, sizeof(*shdr) + (size * cnt));
 
@@ -164,9 +390,16 @@ stats_init(struct stats_hdr *shdr, uint8_t size, uint8_t cnt,
 int
 stats_group_walk(stats_group_walk_func_t walk_func, void *arg)
 {
+    struct stats_hdr * const *reg;
     struct stats_hdr *hdr;
     int rc;
 
+    for (reg = __start_stats_reg; reg < __stop_stats_reg; reg++) {
+        rc = walk_func(*reg, arg);
+        if (rc != 0) {
+            goto err;
+        }
+    }
     STAILQ_FOREACH(hdr, &g_stats_registry, s_next) {
         rc = walk_func(hdr, arg);
         if (rc != 0) {
@@ -182,6 +415,23 @@ struct stats_hdr *
 stats_group_find(char *name)
 {
     struct stats_hdr *cur;
+#if !STATS_GROUP_HASH_SIZE
+    struct stats_hdr * const *reg;
+#endif
+
+#if STATS_GROUP_HASH_SIZE
+    cur = stats_group_hash[stats_group_hash_idx(name)];
+    for (; cur; cur = cur->s_hnext) {
+        if (!strcmp(cur->s_name, name)) {
+            break;
+        }
+    }
+#else
+    for (reg = __start_stats_reg; reg < __stop_stats_reg; reg++) {
+        if (!strcmp((*reg)->s_name, name)) {
+            return *reg;
+        }
+    }
 
     cur = NULL;
     STAILQ_FOREACH(cur, &g_stats_registry, s_next) {
@@ -189,6 +439,7 @@ stats_group_find(char *name)
             break;
         }
     }
+#endif
 
     return (cur);
 }
@@ -202,16 +453,18 @@ stats_register(char *name, struct stats_hdr *shdr)
     /* Don't allow duplicate entries, return an error if this stat
      * is already registered.
      */
-    STAILQ_FOREACH(cur, &g_stats_registry, s_next) {
-        if (!strcmp(cur->s_name, name)) {
-            rc = -1;
-            goto err;
-        }
+    cur = stats_group_find(name);
+    if (cur) {
+        rc = -1;
+        goto err;
     }
 
     shdr->s_name = name;
 
     STAILQ_INSERT_TAIL(&g_stats_registry, shdr, s_next);
+#if STATS_GROUP_HASH_SIZE
+    stats_group_hash_add(shdr);
+#endif
 
     STATS_INC(g_stats_stats, num_registered);
 
@@ -225,7 +478,8 @@ err:
  */
 int
 stats_init_and_reg(struct stats_hdr *shdr, uint8_t size, uint8_t cnt,
-                   struct stats_name_map *map, uint8_t map_cnt, char *name)
+                   const struct stats_name_map *map, uint8_t map_cnt,
+                   char *name)
 {
     int rc;
 
@@ -0,0 +1,251 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef FCB_PRESENT
+
+#include <os/os.h>
+
+#include <string.h>
+
+#include <hal/flash_map.h>
+#include <fcb/fcb.h>
+
+#include "stats/stats.h"
+
+/*
+ * Record being built by stats_fcb_delta_func().
+ */
+struct stats_fcb_buf {
+    struct stats_fcb_rec *sfb_rec;
+    uint8_t *sfb_buf;
+    uint16_t sfb_len;
+};
+
+/*
+ * Appends val as a base 128 varint: 7 bits per byte, low bits first, with
+ * the top bit set on all but the last byte.
+ */
+static int
+stats_fcb_put_varint(struct stats_fcb_buf *sfb, uint64_t val)
+{
+    do {
+        if (sfb->sfb_len >= STATS_FCB_REC_MAX) {
+            return OS_ENOMEM;
+        }
+        sfb->sfb_buf[sfb->sfb_len] = val & 0x7f;
+        val >>= 7;
+        if (val) {
+            sfb->sfb_buf[sfb->sfb_len] |= 0x80;
+        }
+        sfb->sfb_len++;
+    } while (val);
+
+    return 0;
+}
+
+static int
+stats_fcb_delta_func(struct stats_hdr *hdr, void *arg, char *name,
+                     uint16_t off, uint64_t delta)
+{
+    struct stats_fcb_buf *sfb;
+    int rc;
+
+    sfb = arg;
+    rc = stats_fcb_put_varint(sfb, (off - sizeof(*hdr)) / hdr->s_size);
+    if (rc) {
+        return rc;
+    }
+    rc = stats_fcb_put_varint(sfb, delta);
+    if (rc) {
+        return rc;
+    }
+    sfb->sfb_rec->sfr_cnt++;
+
+    return 0;
+}
+
+static int
+stats_fcb_append(struct fcb *fcb, void *buf, int len)
+{
+    struct fcb_entry loc;
+    int rc;
+
+    while (1) {
+        rc = fcb_append(fcb, len, &loc);
+        if (rc == 0) {
+            break;
+        }
+        if (rc != FCB_ERR_NOSPACE) {
+            return rc;
+        }
+        rc = fcb_rotate(fcb);
+        if (rc) {
+            return rc;
+        }
+    }
+
+    rc = flash_area_write(loc.fe_area, loc.fe_data_off, buf, len);
+    if (rc) {
+        fcb_append_abort(fcb, &loc);
+        return rc;
+    }
+
+    return fcb_append_finish(fcb, &loc);
+}
+
+/**
+ * Writes the changes since the previous save of one section to the FCB,
+ * and takes a new snapshot. Nothing is written if no counter changed.
+ *
+ * @param fcb                   The FCB to append to.
+ * @param hdr                   The section; snapshots must be enabled.
+ *
+ * @return                      0 on success; OS_EINVAL if snapshots are not
+ *                                  enabled, OS_ENOMEM if the record does not
+ *                                  fit in STATS_FCB_REC_MAX bytes; FCB or
+ *                                  flash error otherwise.
+ */
+int
+stats_fcb_save_group(struct fcb *fcb, struct stats_hdr *hdr)
+{
+    uint8_t buf[STATS_FCB_REC_MAX];
+    struct stats_fcb_rec rec;
+    struct stats_fcb_buf sfb;
+    int name_len;
+    int rc;
+
+    if (!hdr->s_snap) {
+        return OS_EINVAL;
+    }
+
+    name_len = strlen(hdr->s_name);
+    if (sizeof(rec) + name_len > sizeof(buf)) {
+        return OS_ENOMEM;
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    rec.sfr_time = os_time_get();
+    rec.sfr_elapsed = stats_snap_elapsed(hdr);
+    rec.sfr_name_len = name_len;
+
+    sfb.sfb_rec = &rec;
+    sfb.sfb_buf = buf;
+    sfb.sfb_len = sizeof(rec);
+    memcpy(buf + sfb.sfb_len, hdr->s_name, name_len);
+    sfb.sfb_len += name_len;
+
+    rc = stats_walk_delta(hdr, stats_fcb_delta_func, &sfb);
+    if (rc) {
+        return rc;
+    }
+    if (rec.sfr_cnt) {
+        memcpy(buf, &rec, sizeof(rec));
+        rc = stats_fcb_append(fcb, buf, sfb.sfb_len);
+        if (rc) {
+            return rc;
+        }
+    }
+
+    return stats_snap(hdr);
+}
+
+/**
+ * Saves all sections of an exporter. Sections which fail are skipped.
+ *
+ * @return                      0 on success; error from the last section
+ *                                  which failed.
+ */
+int
+stats_fcb_save(struct stats_fcb *sf)
+{
+    int rc;
+    int rc2;
+    int i;
+
+    rc = 0;
+    for (i = 0; i < sf->sf_hdr_cnt; i++) {
+        rc2 = stats_fcb_save_group(sf->sf_fcb, sf->sf_hdrs[i]);
+        if (rc2) {
+            rc = rc2;
+        }
+    }
+    return rc;
+}
+
+static void
+stats_fcb_tmo(void *arg)
+{
+    struct stats_fcb *sf;
+
+    sf = arg;
+    stats_fcb_save(sf);
+    os_callout_reset(&sf->sf_timer.cf_c, sf->sf_period);
+}
+
+/**
+ * Starts periodic export of a set of sections. The sections must have
+ * snapshots enabled; the first record of each covers the time since its
+ * last snapshot. The timer runs from evq, so the task serving evq must
+ * dispatch callout functions, and does the flash writes.
+ *
+ * @param sf                    Exporter state.
+ * @param fcb                   Initialized FCB the records go to.
+ * @param hdrs                  Sections to export; the array must stay
+ *                                  valid while the exporter runs.
+ * @param hdr_cnt               Number of elements in hdrs.
+ * @param evq                   Event queue for the timer.
+ * @param period                Ticks between saves.
+ *
+ * @return                      0 on success; OS_EINVAL on bad arguments.
+ */
+int
+stats_fcb_start(struct stats_fcb *sf, struct fcb *fcb,
+                struct stats_hdr **hdrs, uint8_t hdr_cnt,
+                struct os_eventq *evq, os_time_t period)
+{
+    int i;
+
+    if (period == 0) {
+        return OS_EINVAL;
+    }
+    for (i = 0; i < hdr_cnt; i++) {
+        if (!hdrs[i]->s_snap) {
+            return OS_EINVAL;
+        }
+    }
+
+    sf->sf_fcb = fcb;
+    sf->sf_hdrs = hdrs;
+    sf->sf_hdr_cnt = hdr_cnt;
+    sf->sf_period = period;
+    os_callout_func_init(&sf->sf_timer, evq, stats_fcb_tmo, sf);
+
+    return os_callout_reset(&sf->sf_timer.cf_c, period);
+}
+
+/**
+ * Stops periodic export.
+ */
+void
+stats_fcb_stop(struct stats_fcb *sf)
+{
+    os_callout_stop(&sf->sf_timer.cf_c);
+}
+
+#endif /* FCB_PRESENT */
@@ -83,6 +83,28 @@ err:
     return (rc);
 }
 
+static int
+stats_nmgr_delta_func(struct stats_hdr *hdr, void *arg, char *sname,
+        uint16_t stat_off, uint64_t delta)
+{
+    struct json_value jv;
+
+    JSON_VALUE_UINT(&jv, delta);
+    return json_encode_object_entry((struct json_encoder *)arg, sname, &jv);
+}
+
+static int
+stats_nmgr_rate_func(struct stats_hdr *hdr, void *arg, char *sname,
+        uint16_t stat_off, uint64_t delta)
+{
+    struct json_value jv;
+    int idx;
+
+    idx = (stat_off - sizeof(*hdr)) / hdr->s_size;
+    JSON_VALUE_UINT(&jv, hdr->s_snap->ss_rates[idx]);
+    return json_encode_object_entry((struct json_encoder *)arg, sname, &jv);
+}
+
 static int
 stats_nmgr_encode_name(struct stats_hdr *hdr, void *arg)
 {
@@ -90,7 +112,7 @@ stats_nmgr_encode_name(struct stats_hdr *hdr, void *arg)
     struct json_value jv;
 
     encoder = (struct json_encoder *)arg;
-    JSON_VALUE_STRING(&jv, hdr->s_name);
+    JSON_VALUE_STRING(&jv, (char *)hdr->s_name);
     json_encode_array_value(encoder, &jv);
 
     return (0);
@@ -102,12 +124,17 @@ stats_nmgr_read(struct nmgr_jbuf *njb)
     struct stats_hdr *hdr;
 #define STATS_NMGR_NAME_LEN (32)
     char stats_name[STATS_NMGR_NAME_LEN];
+    bool delta = false;
+    bool snap = false;
     struct json_attr_t attrs[] = {
         { "name", t_string, .addr.string = &stats_name[0],
             .len = sizeof(stats_name) },
+        { "delta", t_boolean, .addr.boolean = &delta, .nodefault = true },
+        { "snap", t_boolean, .addr.boolean = &snap, .nodefault = true },
         { NULL },
     };
     struct json_value jv;
+    os_time_t elapsed;
     int rc;
 
     rc = json_read_object((struct json_buffer *) njb, attrs);
@@ -121,6 +148,10 @@ stats_nmgr_read(struct nmgr_jbuf *njb)
         rc = NMGR_ERR_EINVAL;
         goto err;
     }
+    if ((delta || snap) && !hdr->s_snap) {
+        rc = NMGR_ERR_EINVAL;
+        goto err;
+    }
 
     json_encode_object_start(&njb->njb_enc);
     JSON_VALUE_INT(&jv, NMGR_ERR_EOK);
@@ -131,10 +162,32 @@ stats_nmgr_read(struct nmgr_jbuf *njb)
     json_encode_object_entry(&nmgr_task_jbuf.njb_enc, "group", &jv);
     json_encode_object_key(&nmgr_task_jbuf.njb_enc, "fields");
     json_encode_object_start(&nmgr_task_jbuf.njb_enc);
-    stats_walk(hdr, stats_nmgr_walk_func, &nmgr_task_jbuf.njb_enc);
+    if (delta) {
+        /*
+         * Only the counters which changed since the snapshot.
+         */
+        stats_walk_delta(hdr, stats_nmgr_delta_func, &njb->njb_enc);
+    } else {
+        stats_walk(hdr, stats_nmgr_walk_func, &nmgr_task_jbuf.njb_enc);
+    }
     json_encode_object_finish(&njb->njb_enc);
+    if (delta) {
+        elapsed = stats_snap_elapsed(hdr);
+        JSON_VALUE_UINT(&jv, (uint64_t)elapsed * 1000 / OS_TICKS_PER_SEC);
+        json_encode_object_entry(&njb->njb_enc, "elapsed", &jv);
+        if (hdr->s_snap->ss_rates_valid) {
+            json_encode_object_key(&njb->njb_enc, "rates");
+            json_encode_object_start(&njb->njb_enc);
+            stats_walk_delta(hdr, stats_nmgr_rate_func, &njb->njb_enc);
+            json_encode_object_finish(&njb->njb_enc);
+        }
+    }
     json_encode_object_finish(&njb->njb_enc);
 
+    if (snap) {
+        stats_snap(hdr);
+    }
+
     return (0);
 err:
     nmgr_jbuf_setoerr(njb, rc);